@@ -0,0 +1,227 @@
+#!/usr/bin/env python3
+#
+# replay-blocks.py: Time the validation of a range of real blocks against a
+# fresh data directory.
+#
+# Copyright (c) 2018 The NIX Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+#
+
+import argparse
+import base64
+import http.client
+import json
+import os
+import resource
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+RPCUSER = 'replay'
+RPCPASSWORD = 'replay'
+
+class NixRPC:
+    def __init__(self, port, username, password):
+        authpair = ('%s:%s' % (username, password)).encode('utf-8')
+        self.authhdr = b'Basic ' + base64.b64encode(authpair)
+        self.port = port
+
+    def call(self, method, *params):
+        conn = http.client.HTTPConnection('127.0.0.1', port=self.port, timeout=60)
+        try:
+            conn.request('POST', '/', json.dumps({'version': '1.1', 'method': method, 'params': list(params), 'id': 1}),
+                         {'Authorization': self.authhdr, 'Content-type': 'application/json'})
+            resp = json.loads(conn.getresponse().read().decode('utf-8'))
+        finally:
+            conn.close()
+        if resp.get('error') is not None:
+            raise RuntimeError('%s: %s' % (method, resp['error']))
+        return resp['result']
+
+def is_block_file(path):
+    name = os.path.basename(path)
+    return name.startswith('blk') and name.endswith('.dat')
+
+def peak_rss_kb(pid):
+    """Peak resident set size of a running process, from /proc where there is one."""
+    try:
+        with open('/proc/%d/status' % pid, 'r', encoding='utf8') as f:
+            for line in f:
+                if line.startswith('VmHWM:'):
+                    return int(line.split()[1])
+    except OSError:
+        pass
+    return None
+
+def wait_for_rpc(rpc, process, timeout):
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        if process.poll() is not None:
+            raise RuntimeError('nixd exited with code %d during startup' % process.returncode)
+        try:
+            return rpc.call('getblockcount')
+        except (OSError, RuntimeError, http.client.HTTPException):
+            # Refused connections while starting, then RPC_IN_WARMUP until the index is loaded
+            time.sleep(0.5)
+    raise RuntimeError('nixd did not answer RPC within %d seconds' % timeout)
+
+def prepare_datadir(args, datadir):
+    """Write nix.conf, put raw block files in place and return the options that import the blocks."""
+    with open(os.path.join(datadir, 'nix.conf'), 'w', encoding='utf8') as f:
+        f.write('server=1\nlisten=0\nconnect=0\ndnsseed=0\nupnp=0\nprinttoconsole=0\n')
+        f.write('rpcuser=%s\nrpcpassword=%s\nrpcport=%d\n' % (RPCUSER, RPCPASSWORD, args.rpcport))
+
+    options = []
+    raw_files = [path for path in args.blocks if is_block_file(path)]
+    if raw_files:
+        # blk*.dat files are in arrival order rather than height order, which only -reindex copes with
+        blocksdir = os.path.join(datadir, 'blocks')
+        os.makedirs(blocksdir)
+        for path in sorted(raw_files):
+            dest = os.path.join(blocksdir, os.path.basename(path))
+            try:
+                os.link(path, dest)
+            except OSError:
+                shutil.copyfile(path, dest)
+        options.append('-reindex')
+    for path in args.blocks:
+        if not is_block_file(path):
+            options.append('-loadblock=%s' % os.path.abspath(path))
+    return options
+
+def replay(args, datadir):
+    command = [args.nixd, '-datadir=%s' % datadir, '-dbcache=%d' % args.dbcache, '-par=%d' % args.par]
+    if args.zerocoin == 'on':
+        # Without an assumed valid block every script and zerocoin spend proof is checked
+        command.append('-assumevalid=0')
+    command += prepare_datadir(args, datadir)
+    command += args.nixd_args
+
+    rpc = NixRPC(args.rpcport, RPCUSER, RPCPASSWORD)
+    process = subprocess.Popen(command, stdout=subprocess.DEVNULL)
+    try:
+        height = wait_for_rpc(rpc, process, args.startup_timeout)
+
+        # Blocks up to the start height only set up the chain state, they are not measured
+        while height < args.start_height:
+            time.sleep(args.poll_interval)
+            height = rpc.call('getblockcount')
+        rpc.call('getblockconnectstats', True)
+        start_height, start_time = height, time.time()
+
+        last_height, last_progress = height, start_time
+        while args.stop_height is None or height < args.stop_height:
+            time.sleep(args.poll_interval)
+            if process.poll() is not None:
+                raise RuntimeError('nixd exited with code %d during the replay' % process.returncode)
+            height = rpc.call('getblockcount')
+            now = time.time()
+            if height != last_height:
+                last_height, last_progress = height, now
+            elif now - last_progress > args.idle_timeout:
+                # The imported blocks ran out before the stop height
+                break
+        end_time = last_progress
+        phases = rpc.call('getblockconnectstats')
+        rss = peak_rss_kb(process.pid)
+
+        rpc.call('stop')
+        process.wait()
+        if rss is None:
+            rss = resource.getrusage(resource.RUSAGE_CHILDREN).ru_maxrss
+    finally:
+        if process.poll() is None:
+            process.terminate()
+            process.wait()
+
+    elapsed = max(end_time - start_time, 1e-6)
+    return {
+        'start_height': start_height,
+        'end_height': height,
+        'blocks': height - start_height,
+        'seconds': elapsed,
+        'blocks_per_second': (height - start_height) / elapsed,
+        'peak_rss_kb': rss,
+        'dbcache': args.dbcache,
+        'par': args.par,
+        'zerocoin': args.zerocoin,
+        'phases': phases,
+    }
+
+def print_report(result):
+    print('Replayed blocks %d to %d: %d blocks in %.2f s, %.2f blocks/s' % (
+        result['start_height'] + 1, result['end_height'], result['blocks'], result['seconds'], result['blocks_per_second']))
+    print('Peak RSS: %.1f MiB (dbcache=%d MiB, par=%d, zerocoin=%s)' % (
+        result['peak_rss_kb'] / 1024.0, result['dbcache'], result['par'], result['zerocoin']))
+    print()
+    print('%-20s %10s %12s %12s %12s' % ('phase', 'count', 'total (ms)', 'avg (us)', 'max (us)'))
+    for phase in result['phases']:
+        if phase['count'] == 0:
+            continue
+        print('%-20s %10d %12.1f %12.1f %12d' % (phase['phase'], phase['count'], phase['total'] / 1000.0,
+                                                  phase['total'] / phase['count'], phase['max']))
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Replay a range of blocks into a fresh data directory and report the validation speed.')
+    parser.add_argument('blocks', nargs='+',
+                        help='blk*.dat files of a node, or linearize-data.py output / bootstrap.dat files')
+    parser.add_argument('--nixd', default=os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'src', 'nixd'),
+                        help='nixd binary to run (default: %(default)s)')
+    parser.add_argument('--start-height', type=int, default=0,
+                        help='height after which blocks are measured, earlier ones only build the chain state (default: %(default)s)')
+    parser.add_argument('--stop-height', type=int, default=None,
+                        help='stop once the chain reaches this height (default: when the blocks run out)')
+    parser.add_argument('--dbcache', type=int, default=450, help='-dbcache in MiB (default: %(default)s)')
+    parser.add_argument('--par', type=int, default=0, help='-par script verification threads (default: %(default)s)')
+    parser.add_argument('--zerocoin', choices=['on', 'off'], default='on',
+                        help='verify zerocoin spend proofs and scripts of every block, or only after the assumed valid block (default: %(default)s)')
+    parser.add_argument('--rpcport', type=int, default=16299, help='RPC port of the replaying node (default: %(default)s)')
+    parser.add_argument('--datadir', help='empty directory to replay into (default: a temporary directory)')
+    parser.add_argument('--keep', action='store_true', help='keep the data directory afterwards')
+    parser.add_argument('--json', action='store_true', help='print the result as JSON')
+    parser.add_argument('--poll-interval', type=float, default=1.0, help='seconds between polls of the height (default: %(default)s)')
+    parser.add_argument('--idle-timeout', type=float, default=60.0,
+                        help='seconds without a new block after which the replay is over (default: %(default)s)')
+    parser.add_argument('--startup-timeout', type=float, default=600.0,
+                        help='seconds to wait for nixd to answer RPC (default: %(default)s)')
+    parser.epilog = 'Options after a -- are passed on to nixd.'
+    argv = sys.argv[1:]
+    nixd_args = []
+    if '--' in argv:
+        nixd_args = argv[argv.index('--') + 1:]
+        argv = argv[:argv.index('--')]
+    args = parser.parse_args(argv)
+    args.nixd_args = nixd_args
+
+    for path in args.blocks:
+        if not os.path.isfile(path):
+            print('Block file %s does not exist' % path, file=sys.stderr)
+            return 1
+
+    if args.datadir:
+        if os.path.exists(args.datadir) and os.listdir(args.datadir):
+            print('Data directory %s is not empty' % args.datadir, file=sys.stderr)
+            return 1
+        os.makedirs(args.datadir, exist_ok=True)
+        datadir = args.datadir
+    else:
+        datadir = tempfile.mkdtemp(prefix='nix_replay_')
+
+    try:
+        result = replay(args, datadir)
+    finally:
+        if not args.keep:
+            shutil.rmtree(datadir, ignore_errors=True)
+
+    if args.json:
+        print(json.dumps(result, indent=4))
+    else:
+        print_report(result)
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -16,6 +16,21 @@
 
 namespace {
 
+/** Data that is serialized already, written out as it is */
+class CSerializedData
+{
+    const CDataStream& stream;
+
+public:
+    explicit CSerializedData(const CDataStream& streamIn) : stream(streamIn) {}
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        s.write(stream.data(), stream.size());
+    }
+};
+
 template <typename Stream, typename Data>
 bool SerializeDB(Stream& stream, const Data& data)
 {
@@ -126,7 +141,11 @@ CAddrDB::CAddrDB()
 
 bool CAddrDB::Write(const CAddrMan& addr)
 {
-    return SerializeFileDB("peers", pathAddr, addr);
+    // Serialize once, in memory, so addrman is only locked for that and not for hashing and
+    // writing out the file
+    CDataStream ssPeers(SER_DISK, CLIENT_VERSION);
+    ssPeers << addr;
+    return SerializeFileDB("peers", pathAddr, CSerializedData(ssPeers));
 }
 
 bool CAddrDB::Read(CAddrMan& addr)
@@ -60,6 +60,10 @@ struct CAddressUnspentKey {
         txhash.SetNull();
         index = 0;
     }
+
+    friend bool operator==(const CAddressUnspentKey& a, const CAddressUnspentKey& b) {
+        return a.type == b.type && a.hashBytes == b.hashBytes && a.txhash == b.txhash && a.index == b.index;
+    }
 };
 
 struct CAddressUnspentValue {
@@ -157,6 +161,11 @@ struct CAddressIndexKey {
         index = 0;
         spending = false;
     }
+
+    friend bool operator==(const CAddressIndexKey& a, const CAddressIndexKey& b) {
+        return a.type == b.type && a.hashBytes == b.hashBytes && a.blockHeight == b.blockHeight &&
+               a.txindex == b.txindex && a.txhash == b.txhash && a.index == b.index && a.spending == b.spending;
+    }
 };
 
 struct CAddressIndexIteratorKey {
@@ -230,6 +239,36 @@ struct CAddressIndexIteratorHeightKey {
     }
 };
 
+/** Running totals of an address, kept with the address index so a balance is a single read */
+struct CAddressBalance {
+    CAmount balance;
+    CAmount received;
+    int64_t nTxCount;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(balance);
+        READWRITE(received);
+        READWRITE(nTxCount);
+    }
+
+    CAddressBalance() {
+        SetNull();
+    }
+
+    void SetNull() {
+        balance = 0;
+        received = 0;
+        nTxCount = 0;
+    }
+
+    bool IsNull() const {
+        return balance == 0 && received == 0 && nTxCount == 0;
+    }
+};
+
 struct CMempoolAddressDelta
 {
     int64_t time;
@@ -300,6 +339,30 @@ struct CMempoolAddressDeltaKeyCompare
     }
 };
 
+/** An address of the mempool address index */
+struct CMempoolAddressKey
+{
+    uint256 hash;
+    int type;
+
+    CMempoolAddressKey(int addressType, const uint256 &addressHash) : hash(addressHash), type(addressType) {}
+
+    friend bool operator==(const CMempoolAddressKey& a, const CMempoolAddressKey& b) {
+        return a.type == b.type && a.hash == b.hash;
+    }
+};
+
+/** A mempool address index entry, without the address it is stored under */
+struct CMempoolAddressEntry
+{
+    uint256 txhash;
+    unsigned int index;
+    int spending;
+    CMempoolAddressDelta delta;
+
+    CMempoolAddressEntry(const uint256 &hash, unsigned int i, int s, const CMempoolAddressDelta &d) : txhash(hash), index(i), spending(s), delta(d) {}
+};
+
 bool ExtractIndexInfo(const CScript *pScript, int &scriptType, std::vector<uint8_t> &hashBytes);
 bool ExtractIndexInfo(const CTxOut *out, int &scriptType, std::vector<uint8_t> &hashBytes, CAmount &nValue, const CScript *&pScript);
 
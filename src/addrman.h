@@ -6,6 +6,8 @@
 #ifndef BITCOIN_ADDRMAN_H
 #define BITCOIN_ADDRMAN_H
 
+#include <hash.h>
+#include <memusage.h>
 #include <netaddress.h>
 #include <protocol.h>
 #include <random.h>
@@ -16,6 +18,7 @@
 #include <map>
 #include <set>
 #include <stdint.h>
+#include <unordered_map>
 #include <vector>
 
 /**
@@ -179,6 +182,24 @@ public:
 /** 
  * Stochastical (IP) address manager 
  */
+/** Salted hasher for the network addresses that index the address table */
+class CNetAddrHasher
+{
+private:
+    /** Salt */
+    const uint64_t k0, k1;
+
+public:
+    CNetAddrHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+    size_t operator()(const CNetAddr& addr) const {
+        unsigned char vch[16];
+        for (int i = 0; i < 16; i++)
+            vch[i] = addr.GetByte(i);
+        return CSipHasher(k0, k1).Write(vch, sizeof(vch)).Finalize();
+    }
+};
+
 class CAddrMan
 {
 private:
@@ -189,10 +210,10 @@ private:
     int nIdCount;
 
     //! table with information about all nIds
-    std::map<int, CAddrInfo> mapInfo;
+    std::unordered_map<int, CAddrInfo> mapInfo;
 
     //! find an nId based on its network address
-    std::map<CNetAddr, int> mapAddr;
+    std::unordered_map<CNetAddr, int, CNetAddrHasher> mapAddr;
 
     //! randomly-ordered vector of all nIds
     std::vector<int> vRandom;
@@ -376,6 +397,9 @@ public:
             throw std::ios_base::failure("Corrupt CAddrMan serialization, nTried exceeds limit.");
         }
 
+        mapInfo.reserve(nNew + nTried);
+        mapAddr.reserve(nNew + nTried);
+
         // Deserialize entries from the new table.
         for (int n = 0; n < nNew; n++) {
             CAddrInfo &info = mapInfo[n];
@@ -437,9 +461,9 @@ public:
 
         // Prune new entries with refcount 0 (as a result of collisions).
         int nLostUnk = 0;
-        for (std::map<int, CAddrInfo>::const_iterator it = mapInfo.begin(); it != mapInfo.end(); ) {
+        for (std::unordered_map<int, CAddrInfo>::const_iterator it = mapInfo.begin(); it != mapInfo.end(); ) {
             if (it->second.fInTried == false && it->second.nRefCount == 0) {
-                std::map<int, CAddrInfo>::const_iterator itCopy = it++;
+                std::unordered_map<int, CAddrInfo>::const_iterator itCopy = it++;
                 Delete(itCopy->first);
                 nLostUnk++;
             } else {
@@ -494,6 +518,13 @@ public:
         return vRandom.size();
     }
 
+    //! Estimate of the heap memory used by the address tables.
+    size_t DynamicMemoryUsage() const
+    {
+        LOCK(cs);
+        return memusage::DynamicUsage(mapInfo) + memusage::DynamicUsage(mapAddr) + memusage::DynamicUsage(vRandom);
+    }
+
     //! Consistency check
     void Check()
     {
@@ -12,35 +12,37 @@
 #include <regex>
 #include <numeric>
 
-void benchmark::ConsolePrinter::header()
-{
-    std::cout << "# Benchmark, evals, iterations, total, min, max, median" << std::endl;
-}
-
-void benchmark::ConsolePrinter::result(const State& state)
+benchmark::Summary benchmark::Summarize(const State& state)
 {
     auto results = state.m_elapsed_results;
     std::sort(results.begin(), results.end());
 
-    double total = state.m_num_iters * std::accumulate(results.begin(), results.end(), 0.0);
-
-    double front = 0;
-    double back = 0;
-    double median = 0;
+    Summary summary{state.m_num_iters * std::accumulate(results.begin(), results.end(), 0.0), 0, 0, 0};
 
     if (!results.empty()) {
-        front = results.front();
-        back = results.back();
+        summary.min = results.front();
+        summary.max = results.back();
 
         size_t mid = results.size() / 2;
-        median = results[mid];
+        summary.median = results[mid];
         if (0 == results.size() % 2) {
-            median = (results[mid] + results[mid + 1]) / 2;
+            summary.median = (results[mid - 1] + results[mid]) / 2;
         }
     }
+    return summary;
+}
+
+void benchmark::ConsolePrinter::header()
+{
+    std::cout << "# Benchmark, evals, iterations, total, min, max, median" << std::endl;
+}
+
+void benchmark::ConsolePrinter::result(const State& state)
+{
+    Summary summary = Summarize(state);
 
     std::cout << std::setprecision(6);
-    std::cout << state.m_name << ", " << state.m_num_evals << ", " << state.m_num_iters << ", " << total << ", " << front << ", " << back << ", " << median << std::endl;
+    std::cout << state.m_name << ", " << state.m_num_evals << ", " << state.m_num_iters << ", " << summary.total << ", " << summary.min << ", " << summary.max << ", " << summary.median << std::endl;
 }
 
 void benchmark::ConsolePrinter::footer() {}
@@ -82,6 +84,86 @@ void benchmark::PlotlyPrinter::footer()
               << "</script></body></html>";
 }
 
+void benchmark::JsonPrinter::header()
+{
+    std::cout << "{\"benchmarks\": [";
+}
+
+void benchmark::JsonPrinter::result(const State& state)
+{
+    Summary summary = Summarize(state);
+
+    std::cout << (m_first ? "" : ",") << std::endl
+              << std::setprecision(9)
+              << "  {\"name\": \"" << state.m_name << "\", \"evals\": " << state.m_num_evals << ", \"iterations\": " << state.m_num_iters
+              << ", \"total\": " << summary.total << ", \"min\": " << summary.min << ", \"max\": " << summary.max << ", \"median\": " << summary.median
+              << ", \"results\": [";
+    const char* prefix = "";
+    for (const auto& e : state.m_elapsed_results) {
+        std::cout << prefix << e;
+        prefix = ", ";
+    }
+    std::cout << "]}";
+    m_first = false;
+}
+
+void benchmark::JsonPrinter::footer()
+{
+    std::cout << std::endl << "]}" << std::endl;
+}
+
+void benchmark::CsvPrinter::header()
+{
+    std::cout << "name,evals,iterations,total,min,max,median" << std::endl;
+}
+
+void benchmark::CsvPrinter::result(const State& state)
+{
+    Summary summary = Summarize(state);
+
+    std::cout << std::setprecision(9);
+    std::cout << state.m_name << "," << state.m_num_evals << "," << state.m_num_iters << "," << summary.total << "," << summary.min << "," << summary.max << "," << summary.median << std::endl;
+}
+
+void benchmark::CsvPrinter::footer() {}
+
+benchmark::ComparePrinter::ComparePrinter(Printer& printer, std::map<std::string, double> baseline, double tolerance)
+    : m_printer(printer), m_baseline(std::move(baseline)), m_tolerance(tolerance)
+{
+}
+
+void benchmark::ComparePrinter::header()
+{
+    m_printer.header();
+    std::cerr << "# Benchmark, median, baseline median, change" << std::endl;
+}
+
+void benchmark::ComparePrinter::result(const State& state)
+{
+    m_printer.result(state);
+
+    auto it = m_baseline.find(state.m_name);
+    if (state.m_elapsed_results.empty() || it == m_baseline.end() || it->second <= 0) {
+        std::cerr << state.m_name << ", not in the baseline" << std::endl;
+        return;
+    }
+    double median = Summarize(state).median;
+    double change = median / it->second - 1;
+    bool is_regression = change > m_tolerance;
+    if (is_regression) {
+        m_regressions++;
+    }
+    std::cerr << std::setprecision(6) << state.m_name << ", " << median << ", " << it->second << ", "
+              << std::fixed << std::setprecision(1) << std::showpos << change * 100 << "%" << std::noshowpos << std::defaultfloat
+              << (is_regression ? ", SLOWER" : "") << std::endl;
+}
+
+void benchmark::ComparePrinter::footer()
+{
+    m_printer.footer();
+    std::cerr << std::setprecision(6) << "# " << m_regressions << " benchmark(s) slower than the baseline by more than " << m_tolerance * 100 << "%" << std::endl;
+}
+
 
 benchmark::BenchRunner::BenchmarkMap& benchmark::BenchRunner::benchmarks()
 {
@@ -94,7 +176,7 @@ benchmark::BenchRunner::BenchRunner(std::string name, benchmark::BenchFunction f
     benchmarks().insert(std::make_pair(name, Bench{func, num_iters_for_one_second}));
 }
 
-void benchmark::BenchRunner::RunAll(Printer& printer, uint64_t num_evals, double scaling, const std::string& filter, bool is_list_only)
+void benchmark::BenchRunner::RunAll(Printer& printer, const Args& args)
 {
     perf_init();
     if (!std::ratio_less_equal<benchmark::clock::period, std::micro>::value) {
@@ -104,7 +186,8 @@ void benchmark::BenchRunner::RunAll(Printer& printer, uint64_t num_evals, double
     std::cerr << "WARNING: This is a debug build - may result in slower benchmarks.\n";
 #endif
 
-    std::regex reFilter(filter);
+    std::regex reFilter(args.regex_filter);
+    std::regex reExclude(args.regex_exclude);
     std::smatch baseMatch;
 
     printer.header();
@@ -113,16 +196,31 @@ void benchmark::BenchRunner::RunAll(Printer& printer, uint64_t num_evals, double
         if (!std::regex_match(p.first, baseMatch, reFilter)) {
             continue;
         }
+        if (!args.regex_exclude.empty() && std::regex_match(p.first, baseMatch, reExclude)) {
+            continue;
+        }
 
-        uint64_t num_iters = static_cast<uint64_t>(p.second.num_iters_for_one_second * scaling);
+        uint64_t num_iters = static_cast<uint64_t>(p.second.num_iters_for_one_second * args.scaling);
         if (0 == num_iters) {
             num_iters = 1;
         }
-        State state(p.first, num_evals, num_iters, printer);
-        if (!is_list_only) {
+        while (true) {
+            State state(p.first, args.num_evals, num_iters, printer);
+            if (args.is_list_only) {
+                printer.result(state);
+                break;
+            }
             p.second.func(state);
+
+            // too short to measure reliably: run it again with more iterations, at most ten times as many
+            double total = Summarize(state).total;
+            if (total >= args.min_time || num_iters >= std::numeric_limits<uint64_t>::max() / 10) {
+                printer.result(state);
+                break;
+            }
+            double factor = total > 0 ? args.min_time / total * 1.1 : 10;
+            num_iters = static_cast<uint64_t>(num_iters * std::max(2.0, std::min(10.0, factor)));
         }
-        printer.result(state);
     }
 
     printer.footer();
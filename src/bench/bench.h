@@ -82,6 +82,16 @@ public:
 
 typedef std::function<void(State&)> BenchFunction;
 
+/** What to run and how, from the bench_nix command line */
+struct Args {
+    uint64_t num_evals;
+    double scaling;
+    std::string regex_filter;
+    std::string regex_exclude; //!< skip the benchmarks matching this, if set
+    double min_time;           //!< seconds all evaluations of a benchmark take at least, 0 to run the given iterations only
+    bool is_list_only;
+};
+
 class BenchRunner
 {
     struct Bench {
@@ -94,8 +104,17 @@ class BenchRunner
 public:
     BenchRunner(std::string name, BenchFunction func, uint64_t num_iters_for_one_second);
 
-    static void RunAll(Printer& printer, uint64_t num_evals, double scaling, const std::string& filter, bool is_list_only);
+    static void RunAll(Printer& printer, const Args& args);
+};
+
+/** Time per iteration of the fastest, the slowest and the median evaluation of a finished benchmark */
+struct Summary {
+    double total;
+    double min;
+    double max;
+    double median;
 };
+Summary Summarize(const State& state);
 
 // interface to output benchmark results.
 class Printer
@@ -130,6 +149,46 @@ private:
     int64_t m_width;
     int64_t m_height;
 };
+
+// one JSON document with the summary and every evaluation of each benchmark, the format -compare reads
+class JsonPrinter : public Printer
+{
+public:
+    void header();
+    void result(const State& state);
+    void footer();
+
+private:
+    bool m_first = true;
+};
+
+// one comma separated line per benchmark
+class CsvPrinter : public Printer
+{
+public:
+    void header();
+    void result(const State& state);
+    void footer();
+};
+
+// passes the results on to another printer and reports on stderr how each median compares to
+// that of a baseline run, flagging the ones slower by more than the tolerance
+class ComparePrinter : public Printer
+{
+public:
+    ComparePrinter(Printer& printer, std::map<std::string, double> baseline, double tolerance);
+    void header();
+    void result(const State& state);
+    void footer();
+
+    int GetRegressions() const { return m_regressions; }
+
+private:
+    Printer& m_printer;
+    std::map<std::string, double> m_baseline;
+    double m_tolerance;
+    int m_regressions = 0;
+};
 }
 
 
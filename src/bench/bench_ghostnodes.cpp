@@ -0,0 +1,477 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+//
+// Ghostnode network simulator: announces, pings, payment votes, list requests and
+// InstantSend lock votes of N synthetic ghostnodes fed into the managers without sockets,
+// reporting the cost of each message, the locks held processing them and the memory they take.
+
+#include <chain.h>
+#include <chainparams.h>
+#include <coins.h>
+#include <crypto/ripemd160.h>
+#include <crypto/sha256.h>
+#include <crypto/sha512.h>
+#include <crypto/Lyra2RE/Lyra2RE.h>
+#include <ghostnode/activeghostnode.h>
+#include <ghostnode/darksend.h>
+#include <ghostnode/ghostnode-payments.h>
+#include <ghostnode/ghostnode-sync.h>
+#include <ghostnode/ghostnodeman.h>
+#include <ghostnode/instantx.h>
+#include <ghostnode/spork.h>
+#include <key.h>
+#include <net.h>
+#include <netbase.h>
+#include <protocol.h>
+#include <random.h>
+#include <scheduler.h>
+#include <script/standard.h>
+#include <streams.h>
+#include <sync.h>
+#include <txmempool.h>
+#include <util.h>
+#include <utilstrencodings.h>
+#include <utiltime.h>
+#include <validation.h>
+#include <validationinterface.h>
+
+#include <algorithm>
+#include <ctime>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/thread.hpp>
+
+#include <stdio.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+static const char* DEFAULT_GHOSTNODE_COUNTS = "1000,5000,20000";
+//! Height of the simulated chain, below nGhostnodeInitialize so the node counts as synced
+static const int SIM_CHAIN_HEIGHT = 500;
+//! Future blocks voted on by the top ghostnodes of each
+static const int SIM_VOTE_BLOCKS = 20;
+//! Transactions locked, each spending an output of a different height
+static const int SIM_LOCK_REQUESTS = 20;
+//! Peers asking for the whole list
+static const int SIM_LIST_REQUESTS = 10;
+
+namespace {
+
+struct SimGhostnode {
+    CKey keyCollateral;
+    CKey keyGhostnode;
+    CTxIn vin;
+    CService addr;
+};
+
+/** Resident memory of the process in bytes, 0 where it cannot be read */
+int64_t GetResidentBytes()
+{
+#ifndef WIN32
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (!file)
+        return 0;
+    long nPages = 0, nResident = 0;
+    int nRead = fscanf(file, "%ld %ld", &nPages, &nResident);
+    fclose(file);
+    return nRead == 2 ? (int64_t)nResident * sysconf(_SC_PAGESIZE) : 0;
+#else
+    return 0;
+#endif
+}
+
+int64_t GetCpuMicros()
+{
+    return (int64_t)std::clock() * 1000000 / CLOCKS_PER_SEC;
+}
+
+std::vector<unsigned char> SignMessageHash(const uint256& hash, const CKey& key)
+{
+    // darkSendSigner.SignHash() would verify the signature too, leaving it in the signature cache
+    std::vector<unsigned char> vchSig;
+    if (!key.SignCompact(hash, vchSig))
+        throw std::runtime_error("SignCompact failed");
+    return vchSig;
+}
+
+/** A peer without a socket, the messages it sends are handed to the managers directly */
+std::unique_ptr<CNode> MakePeer(NodeId id, const CService& addr)
+{
+    std::unique_ptr<CNode> pnode(new CNode(id, NODE_NETWORK, 0, INVALID_SOCKET, CAddress(addr, NODE_NETWORK), 0, 0, CAddress(), "", true));
+    pnode->nVersion = PROTOCOL_VERSION;
+    pnode->SetSendVersion(PROTOCOL_VERSION);
+    return pnode;
+}
+
+/** A mainnet address that passes CGhostnode::IsValidNetAddr, one per ghostnode */
+CService GetGhostnodeAddr(int n)
+{
+    return LookupNumeric(strprintf("%d.%d.%d.%d", 20 + (n >> 16), (n >> 8) & 0xff, n & 0xff, 1).c_str(), Params().GetDefaultPort());
+}
+
+struct PhaseResult {
+    std::string strName;
+    size_t nMessages;
+    size_t nAccepted;
+    int64_t nWallMicros;
+    int64_t nCpuMicros;
+    int64_t nResidentDelta;
+    std::vector<LockSiteStats> vLocks;
+};
+
+/** Feed every message to process, timing it with the lock profile reset beforehand */
+PhaseResult RunPhase(const std::string& strName, std::vector<CDataStream>& vMessages, std::function<bool(CDataStream&)> process)
+{
+    PhaseResult result;
+    result.strName = strName;
+    result.nMessages = vMessages.size();
+    result.nAccepted = 0;
+
+    GetLockStats(true);
+    int64_t nResidentStart = GetResidentBytes();
+    int64_t nCpuStart = GetCpuMicros();
+    int64_t nWallStart = GetTimeMicros();
+    for (CDataStream& ss : vMessages) {
+        if (process(ss))
+            result.nAccepted++;
+    }
+    result.nWallMicros = GetTimeMicros() - nWallStart;
+    result.nCpuMicros = GetCpuMicros() - nCpuStart;
+    result.nResidentDelta = GetResidentBytes() - nResidentStart;
+
+    // sites of the same lock are summed, by lock name and file
+    std::map<std::string, LockSiteStats> mapLocks;
+    for (const LockSiteStats& site : GetLockStats(true)) {
+        std::string strFile = site.file.substr(site.file.find_last_of("/\\") + 1);
+        std::string strKey = site.name + " (" + strFile + ")";
+        std::map<std::string, LockSiteStats>::iterator it = mapLocks.find(strKey);
+        if (it == mapLocks.end()) {
+            LockSiteStats stats = site;
+            stats.name = strKey;
+            mapLocks.insert(std::make_pair(strKey, stats));
+        } else {
+            it->second.nLocks += site.nLocks;
+            it->second.nContended += site.nContended;
+            it->second.nTotalHoldMicros += site.nTotalHoldMicros;
+            it->second.nMaxHoldMicros = std::max(it->second.nMaxHoldMicros, site.nMaxHoldMicros);
+        }
+    }
+    for (const std::pair<const std::string, LockSiteStats>& lock : mapLocks)
+        result.vLocks.push_back(lock.second);
+    std::sort(result.vLocks.begin(), result.vLocks.end(), [](const LockSiteStats& a, const LockSiteStats& b) {
+        return a.nTotalHoldMicros > b.nTotalHoldMicros;
+    });
+
+    // let the queued validation interface callbacks run before the next phase
+    GetMainSignals().FlushBackgroundCallbacks();
+    return result;
+}
+
+void PrintResult(const PhaseResult& result)
+{
+    size_t n = std::max<size_t>(result.nMessages, 1);
+    std::cout << strprintf("%-8s %8u %9u %12.1f %12.1f %14.1f\n", result.strName, result.nMessages, result.nAccepted,
+                           (double)result.nWallMicros / n, (double)result.nCpuMicros / n, (double)result.nResidentDelta / 1024);
+    for (size_t i = 0; i < result.vLocks.size() && i < 3; i++) {
+        const LockSiteStats& lock = result.vLocks[i];
+        std::cout << strprintf("         held %-40s %6.2f times, %8.1f us/msg, longest %d us\n", lock.name,
+                               (double)lock.nLocks / n, (double)lock.nTotalHoldMicros / n, lock.nMaxHoldMicros);
+    }
+}
+
+class GhostnodeSimulation
+{
+private:
+    CCoinsView viewEmpty;
+    std::vector<CBlockIndex> vBlocks;
+    std::vector<SimGhostnode> vNodes;
+    std::map<COutPoint, size_t> mapNodeByOutpoint;
+    std::unique_ptr<CNode> peer;
+    NodeId nNextPeerId;
+    int64_t nTime;
+
+    const CBlockIndex* Tip() const { return &vBlocks.back(); }
+
+    /** The enabled ghostnodes ranked highest for a block, the way CGhostnodeMan::GetScoredGhostnodes() ranks them */
+    std::vector<COutPoint> GetTopGhostnodes(std::vector<CGhostnode>& vList, int nHeight, int nMinProtocol, int nCount) const
+    {
+        uint256 blockHash = vBlocks[nHeight].GetBlockHash();
+        std::vector<std::pair<int64_t, COutPoint> > vecScores;
+        for (CGhostnode& mn : vList) {
+            if (mn.nProtocolVersion >= nMinProtocol && mn.IsEnabled())
+                vecScores.push_back(std::make_pair(mn.CalculateScore(blockHash).GetCompact(false), mn.vin.prevout));
+        }
+        std::sort(vecScores.rbegin(), vecScores.rend());
+        std::vector<COutPoint> vTop;
+        for (size_t i = 0; i < vecScores.size() && (int)i < nCount; i++)
+            vTop.push_back(vecScores[i].second);
+        return vTop;
+    }
+
+    void AddCollateral(const SimGhostnode& node, CMutableTransaction& mtx)
+    {
+        CTransactionRef tx = MakeTransactionRef(mtx);
+        pcoinsTip->AddCoin(COutPoint(tx->GetHash(), 0), Coin(tx->vout[0], 1, false), false);
+        // IsVinAssociatedWithPubkey() finds the collateral transaction through GetTransaction()
+        mempool.addUnchecked(tx->GetHash(), CTxMemPoolEntry(tx, 0, nTime, 1, false, 0, LockPoints()));
+    }
+
+public:
+    GhostnodeSimulation() : nNextPeerId(0), nTime(GetTime())
+    {
+        // a chain of block headers only, the ghostnode code needs their hashes and heights
+        LOCK(cs_main);
+        vBlocks.resize(SIM_CHAIN_HEIGHT + 1);
+        for (int nHeight = 0; nHeight <= SIM_CHAIN_HEIGHT; nHeight++) {
+            CBlockIndex& block = vBlocks[nHeight];
+            block.nHeight = nHeight;
+            block.nTime = nTime - (SIM_CHAIN_HEIGHT - nHeight) * Params().GetConsensus().nPowTargetSpacing;
+            block.pprev = nHeight > 0 ? &vBlocks[nHeight - 1] : nullptr;
+            block.BuildSkip();
+            BlockMap::iterator mi = mapBlockIndex.insert(std::make_pair(GetRandHash(), &block)).first;
+            block.phashBlock = &mi->first;
+        }
+        chainActive.SetTip(&vBlocks.back());
+        pindexBestHeader = &vBlocks.back();
+
+        ghostnodeSync.UpdatedBlockTip(Tip());
+        while (ghostnodeSync.GetAssetID() != GHOSTNODE_SYNC_FINISHED)
+            ghostnodeSync.SwitchToNextAsset();
+
+        peer = MakePeer(nNextPeerId++, LookupNumeric("30.0.0.1", Params().GetDefaultPort()));
+    }
+
+    ~GhostnodeSimulation()
+    {
+        Reset();
+        LOCK(cs_main);
+        chainActive.SetTip(nullptr);
+        pindexBestHeader = nullptr;
+        mapBlockIndex.clear();
+    }
+
+    void Reset()
+    {
+        mnodeman.Clear();
+        mnpayments.Clear();
+        mempool.clear();
+        vNodes.clear();
+        mapNodeByOutpoint.clear();
+        pcoinsTip.reset(new CCoinsViewCache(&viewEmpty));
+    }
+
+    void Run(int nGhostnodes)
+    {
+        Reset();
+        // a day later than the previous run, so the expired lock quorums of that one are dropped
+        nTime += 24 * 60 * 60;
+        SetMockTime(nTime);
+        instantsend.CheckAndRemove();
+        mnodeman.UpdatedBlockTip(Tip());
+        mnpayments.UpdatedBlockTip(Tip());
+        instantsend.UpdatedBlockTip(Tip());
+        bool fNewSigs = sporkManager.IsSporkActive(SPORK_6_NEW_SIGS);
+
+        int64_t nResidentStart = GetResidentBytes();
+        int64_t nGenerateStart = GetTimeMicros();
+        std::vector<CDataStream> vMnb;
+        {
+            LOCK(cs_main);
+            for (int i = 0; i < nGhostnodes; i++) {
+                SimGhostnode node;
+                node.keyCollateral.MakeNewKey(true);
+                node.keyGhostnode.MakeNewKey(true);
+                node.addr = GetGhostnodeAddr(i);
+
+                CMutableTransaction mtx;
+                mtx.vin.resize(1);
+                mtx.vin[0].prevout = COutPoint(GetRandHash(), 0);
+                mtx.vout.push_back(CTxOut(GHOSTNODE_COIN_REQUIRED * COIN, GetScriptForDestination(node.keyCollateral.GetPubKey().GetID())));
+                node.vin = CTxIn(COutPoint(mtx.GetHash(), 0));
+                AddCollateral(node, mtx);
+
+                CGhostnodeBroadcast mnb(node.addr, node.vin, node.keyCollateral.GetPubKey(), node.keyGhostnode.GetPubKey(), PROTOCOL_VERSION);
+                mnb.sigTime = GetAdjustedTime();
+                mnb.vchSig = SignMessageHash(mnb.GetSignatureHash(fNewSigs), node.keyCollateral);
+                mnb.lastPing = CGhostnodePing(node.vin);
+                mnb.lastPing.vchSig = SignMessageHash(mnb.lastPing.GetSignatureHash(fNewSigs), node.keyGhostnode);
+
+                vMnb.push_back(CDataStream(SER_NETWORK, PROTOCOL_VERSION));
+                vMnb.back() << mnb;
+                mapNodeByOutpoint[node.vin.prevout] = vNodes.size();
+                vNodes.push_back(node);
+            }
+        }
+
+        // the next pings, after which the announced ghostnodes are enabled
+        nTime += GHOSTNODE_MIN_MNP_SECONDS;
+        SetMockTime(nTime);
+        std::vector<CDataStream> vMnp;
+        for (const SimGhostnode& node : vNodes) {
+            CTxIn vin(node.vin);
+            CGhostnodePing mnp(vin);
+            mnp.vchSig = SignMessageHash(mnp.GetSignatureHash(fNewSigs), node.keyGhostnode);
+            vMnp.push_back(CDataStream(SER_NETWORK, PROTOCOL_VERSION));
+            vMnp.back() << mnp;
+        }
+        int64_t nGenerateMicros = GetTimeMicros() - nGenerateStart;
+
+        std::cout << strprintf("\n%d ghostnodes, messages generated in %.2f s, %.1f MiB resident\n", nGhostnodes,
+                               nGenerateMicros * 0.000001, (GetResidentBytes() - nResidentStart) / 1048576.0);
+        std::cout << strprintf("%-8s %8s %9s %12s %12s %14s\n", "message", "count", "accepted", "us/msg", "cpu us/msg", "memory KiB");
+
+        std::string strCommand = NetMsgType::MNANNOUNCE;
+        PhaseResult result = RunPhase("mnb", vMnb, [&](CDataStream& ss) {
+            int nListSize = mnodeman.size();
+            mnodeman.ProcessMessage(peer.get(), strCommand, ss);
+            return mnodeman.size() > nListSize;
+        });
+        PrintResult(result);
+
+        std::string strPingCommand = NetMsgType::MNPING;
+        result = RunPhase("mnp", vMnp, [&](CDataStream& ss) {
+            mnodeman.ProcessMessage(peer.get(), strPingCommand, ss);
+            return true;
+        });
+        result.nAccepted = mnodeman.CountEnabled();
+        PrintResult(result);
+
+        // the top ghostnodes of each of the next blocks vote for a payee, ranked on a copy of the
+        // list so the ranks the managers cache are not computed ahead of the votes
+        std::vector<CGhostnode> vList(*mnodeman.GetFullGhostnodeVector());
+        std::vector<CDataStream> vMnw;
+        std::vector<uint256> vVoteHashes;
+        int nMinProto = mnpayments.GetMinGhostnodePaymentsProto();
+        for (int nHeight = Tip()->nHeight + 1; nHeight <= Tip()->nHeight + SIM_VOTE_BLOCKS; nHeight++) {
+            for (const COutPoint& outpointGhostnode : GetTopGhostnodes(vList, nHeight - 100, nMinProto, MNPAYMENTS_SIGNATURES_TOTAL)) {
+                const SimGhostnode& node = vNodes[mapNodeByOutpoint[outpointGhostnode]];
+                const SimGhostnode& payee = vNodes[GetRand(vNodes.size())];
+                CGhostnodePaymentVote vote(node.vin, nHeight, GetScriptForDestination(payee.keyCollateral.GetPubKey().GetID()));
+                vote.vchSig = SignMessageHash(vote.GetSignatureHash(fNewSigs), node.keyGhostnode);
+                vVoteHashes.push_back(vote.GetHash());
+                vMnw.push_back(CDataStream(SER_NETWORK, PROTOCOL_VERSION));
+                vMnw.back() << vote;
+            }
+        }
+
+        std::string strVoteCommand = NetMsgType::GHOSTNODEPAYMENTVOTE;
+        size_t nVote = 0;
+        result = RunPhase("mnw", vMnw, [&](CDataStream& ss) {
+            mnpayments.ProcessMessage(peer.get(), strVoteCommand, ss);
+            return mnpayments.HasVerifiedPaymentVote(vVoteHashes[nVote++]);
+        });
+        PrintResult(result);
+
+        // peers asking for the whole list, each one a different address
+        std::vector<CDataStream> vDseg;
+        std::vector<std::unique_ptr<CNode> > vPeers;
+        for (int i = 0; i < SIM_LIST_REQUESTS; i++) {
+            vDseg.push_back(CDataStream(SER_NETWORK, PROTOCOL_VERSION));
+            vDseg.back() << CTxIn();
+            vPeers.push_back(MakePeer(nNextPeerId++, LookupNumeric(strprintf("31.0.0.%d", i + 1).c_str(), Params().GetDefaultPort())));
+        }
+        std::string strListCommand = NetMsgType::DSEG;
+        size_t nRequest = 0;
+        result = RunPhase("dseg", vDseg, [&](CDataStream& ss) {
+            mnodeman.ProcessMessage(vPeers[nRequest++].get(), strListCommand, ss);
+            return true;
+        });
+        PrintResult(result);
+        vPeers.clear();
+
+        // votes of the lock quorums for transactions spending outputs of different heights,
+        // validated the way CInstantSend::ProcessTxLockVote() starts
+        std::vector<CDataStream> vLockVotes;
+        {
+            LOCK(cs_main);
+            for (int i = 0; i < SIM_LOCK_REQUESTS; i++) {
+                int nPrevoutHeight = Tip()->nHeight - 10 - i;
+                COutPoint outpoint(GetRandHash(), 0);
+                pcoinsTip->AddCoin(outpoint, Coin(CTxOut(COIN, CScript() << OP_TRUE), nPrevoutHeight, false), false);
+                uint256 txHash = GetRandHash();
+
+                for (const COutPoint& outpointGhostnode : GetTopGhostnodes(vList, nPrevoutHeight + 4, MIN_INSTANTSEND_PROTO_VERSION, COutPointLock::SIGNATURES_TOTAL)) {
+                    const SimGhostnode& node = vNodes[mapNodeByOutpoint[outpointGhostnode]];
+                    CTxLockVote vote(txHash, outpoint, outpointGhostnode);
+                    vLockVotes.push_back(CDataStream(SER_NETWORK, PROTOCOL_VERSION));
+                    vLockVotes.back() << txHash << outpoint << outpointGhostnode << SignMessageHash(vote.GetSignatureHash(fNewSigs), node.keyGhostnode);
+                }
+            }
+        }
+        result = RunPhase("txlvote", vLockVotes, [&](CDataStream& ss) {
+            CTxLockVote vote;
+            ss >> vote;
+            return vote.IsValid(peer.get());
+        });
+        PrintResult(result);
+    }
+};
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    gArgs.ParseParameters(argc, argv);
+
+    if (gArgs.IsArgSet("-?") || gArgs.IsArgSet("-h") || gArgs.IsArgSet("-help")) {
+        std::cout << HelpMessageGroup(_("Options:"))
+                  << HelpMessageOpt("-?", _("Print this help message and exit"))
+                  << HelpMessageOpt("-nodes=<n>[,<n>...]", strprintf(_("Numbers of ghostnodes to simulate, one run each (default: %s)"), DEFAULT_GHOSTNODE_COUNTS));
+        return 0;
+    }
+
+    std::vector<std::string> vstrCounts;
+    boost::split(vstrCounts, gArgs.GetArg("-nodes", DEFAULT_GHOSTNODE_COUNTS), boost::is_any_of(","));
+    std::vector<int> vCounts;
+    for (const std::string& strCount : vstrCounts) {
+        int nCount = atoi(strCount);
+        if (nCount <= 0 || nCount > (1 << 20)) {
+            std::cerr << strprintf("Invalid ghostnode count: %s\n", strCount);
+            return 1;
+        }
+        vCounts.push_back(nCount);
+    }
+
+    SHA256AutoDetect();
+    SHA512AutoDetect();
+    RIPEMD160AutoDetect();
+    lyra2re_autodetect();
+    RandomInit();
+    ECC_Start();
+    SetupEnvironment();
+    SetupNetworking();
+    fPrintToDebugLog = false; // don't want to write to debug.log file
+    SelectParams(CBaseChainParams::MAIN);
+    g_lock_profile = true;
+
+    boost::thread_group threadGroup;
+    CScheduler scheduler;
+    threadGroup.create_thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+    GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
+    g_connman = std::unique_ptr<CConnman>(new CConnman(GetRand(std::numeric_limits<uint64_t>::max()), GetRand(std::numeric_limits<uint64_t>::max())));
+
+    std::cout << "Messages are processed one by one on this thread, signatures are not verified in parallel.\n"
+              << "us/msg and cpu us/msg are wall and process CPU time per message, memory the resident memory added by them.\n"
+              << "Below each message type are the three locks held longest: times taken, time held per message and the longest hold.\n";
+    {
+        GhostnodeSimulation simulation;
+        for (int nCount : vCounts)
+            simulation.Run(nCount);
+    }
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+    GetMainSignals().FlushBackgroundCallbacks();
+    GetMainSignals().UnregisterBackgroundSignalScheduler();
+    g_connman.reset();
+    pcoinsTip.reset();
+    SetMockTime(0);
+    ECC_Stop();
+}
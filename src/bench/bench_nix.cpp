@@ -4,24 +4,62 @@
 
 #include <bench/bench.h>
 
+#include <crypto/ripemd160.h>
 #include <crypto/sha256.h>
+#include <crypto/sha512.h>
+#include <crypto/Lyra2RE/Lyra2RE.h>
 #include <key.h>
 #include <validation.h>
 #include <util.h>
 #include <random.h>
 
+#include <univalue.h>
+
 #include <boost/lexical_cast.hpp>
 
+#include <fstream>
 #include <memory>
+#include <sstream>
 
 static const int64_t DEFAULT_BENCH_EVALUATIONS = 5;
 static const char* DEFAULT_BENCH_FILTER = ".*";
 static const char* DEFAULT_BENCH_SCALING = "1.0";
+static const int64_t DEFAULT_BENCH_MIN_TIME = 0;
+static const char* DEFAULT_BENCH_TOLERANCE = "10";
 static const char* DEFAULT_BENCH_PRINTER = "console";
 static const char* DEFAULT_PLOT_PLOTLYURL = "https://cdn.plot.ly/plotly-latest.min.js";
 static const int64_t DEFAULT_PLOT_WIDTH = 1024;
 static const int64_t DEFAULT_PLOT_HEIGHT = 768;
 
+/** The median of each benchmark in a -printer=json output */
+static bool ReadBaseline(const std::string& path, std::map<std::string, double>& baseline, std::string& error)
+{
+    std::ifstream file(path);
+    if (!file) {
+        error = strprintf("Cannot open baseline file %s", path);
+        return false;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+
+    UniValue json;
+    if (!json.read(contents.str()) || !json.isObject() || !json["benchmarks"].isArray()) {
+        error = strprintf("%s is not the JSON output of bench_nix -printer=json", path);
+        return false;
+    }
+    const UniValue& benchmarks = json["benchmarks"];
+    for (size_t i = 0; i < benchmarks.size(); i++) {
+        const UniValue& name = find_value(benchmarks[i], "name");
+        const UniValue& median = find_value(benchmarks[i], "median");
+        if (!name.isStr() || !median.isNum()) {
+            error = strprintf("Benchmark %u of %s has no name or median", i, path);
+            return false;
+        }
+        baseline[name.get_str()] = median.get_real();
+    }
+    return true;
+}
+
 int
 main(int argc, char** argv)
 {
@@ -33,8 +71,12 @@ main(int argc, char** argv)
                   << HelpMessageOpt("-list", _("List benchmarks without executing them. Can be combined with -scaling and -filter"))
                   << HelpMessageOpt("-evals=<n>", strprintf(_("Number of measurement evaluations to perform. (default: %u)"), DEFAULT_BENCH_EVALUATIONS))
                   << HelpMessageOpt("-filter=<regex>", strprintf(_("Regular expression filter to select benchmark by name (default: %s)"), DEFAULT_BENCH_FILTER))
+                  << HelpMessageOpt("-exclude=<regex>", _("Regular expression of benchmark names to skip, applied after -filter"))
                   << HelpMessageOpt("-scaling=<n>", strprintf(_("Scaling factor for benchmark's runtime (default: %u)"), DEFAULT_BENCH_SCALING))
-                  << HelpMessageOpt("-printer=(console|plot)", strprintf(_("Choose printer format. console: print data to console. plot: Print results as HTML graph (default: %s)"), DEFAULT_BENCH_PRINTER))
+                  << HelpMessageOpt("-min-time=<ms>", strprintf(_("Raise the iterations of benchmarks whose evaluations take less than this in total (default: %u)"), DEFAULT_BENCH_MIN_TIME))
+                  << HelpMessageOpt("-printer=(console|plot|json|csv)", strprintf(_("Choose printer format. console: print data to console. plot: Print results as HTML graph. json, csv: print results in machine-readable form (default: %s)"), DEFAULT_BENCH_PRINTER))
+                  << HelpMessageOpt("-compare=<file>", _("Compare the median of each benchmark to that in this output of -printer=json, report on stderr and exit with 1 if any is slower than -tolerance allows"))
+                  << HelpMessageOpt("-tolerance=<percent>", strprintf(_("How much slower than the baseline a benchmark may be with -compare (default: %s)"), DEFAULT_BENCH_TOLERANCE))
                   << HelpMessageOpt("-plot-plotlyurl=<uri>", strprintf(_("URL to use for plotly.js (default: %s)"), DEFAULT_PLOT_PLOTLYURL))
                   << HelpMessageOpt("-plot-width=<x>", strprintf(_("Plot width in pixel (default: %u)"), DEFAULT_PLOT_WIDTH))
                   << HelpMessageOpt("-plot-height=<x>", strprintf(_("Plot height in pixel (default: %u)"), DEFAULT_PLOT_HEIGHT));
@@ -43,18 +85,21 @@ main(int argc, char** argv)
     }
 
     SHA256AutoDetect();
+    SHA512AutoDetect();
+    RIPEMD160AutoDetect();
+    lyra2re_autodetect();
     RandomInit();
     ECC_Start();
     SetupEnvironment();
     fPrintToDebugLog = false; // don't want to write to debug.log file
 
-    int64_t evaluations = gArgs.GetArg("-evals", DEFAULT_BENCH_EVALUATIONS);
-    std::string regex_filter = gArgs.GetArg("-filter", DEFAULT_BENCH_FILTER);
-    std::string scaling_str = gArgs.GetArg("-scaling", DEFAULT_BENCH_SCALING);
-    bool is_list_only = gArgs.GetBoolArg("-list", false);
-
-    double scaling_factor = boost::lexical_cast<double>(scaling_str);
-
+    benchmark::Args args;
+    args.num_evals = gArgs.GetArg("-evals", DEFAULT_BENCH_EVALUATIONS);
+    args.regex_filter = gArgs.GetArg("-filter", DEFAULT_BENCH_FILTER);
+    args.regex_exclude = gArgs.GetArg("-exclude", "");
+    args.scaling = boost::lexical_cast<double>(gArgs.GetArg("-scaling", DEFAULT_BENCH_SCALING));
+    args.min_time = gArgs.GetArg("-min-time", DEFAULT_BENCH_MIN_TIME) / 1000.0;
+    args.is_list_only = gArgs.GetBoolArg("-list", false);
 
     std::unique_ptr<benchmark::Printer> printer(new benchmark::ConsolePrinter());
     std::string printer_arg = gArgs.GetArg("-printer", DEFAULT_BENCH_PRINTER);
@@ -63,9 +108,29 @@ main(int argc, char** argv)
             gArgs.GetArg("-plot-plotlyurl", DEFAULT_PLOT_PLOTLYURL),
             gArgs.GetArg("-plot-width", DEFAULT_PLOT_WIDTH),
             gArgs.GetArg("-plot-height", DEFAULT_PLOT_HEIGHT)));
+    } else if ("json" == printer_arg) {
+        printer.reset(new benchmark::JsonPrinter());
+    } else if ("csv" == printer_arg) {
+        printer.reset(new benchmark::CsvPrinter());
     }
 
-    benchmark::BenchRunner::RunAll(*printer, evaluations, scaling_factor, regex_filter, is_list_only);
+    int ret = 0;
+    if (gArgs.IsArgSet("-compare")) {
+        std::map<std::string, double> baseline;
+        std::string error;
+        if (!ReadBaseline(gArgs.GetArg("-compare", ""), baseline, error)) {
+            std::cerr << error << std::endl;
+            ECC_Stop();
+            return 1;
+        }
+        double tolerance = boost::lexical_cast<double>(gArgs.GetArg("-tolerance", DEFAULT_BENCH_TOLERANCE)) / 100;
+        benchmark::ComparePrinter compare(*printer, std::move(baseline), tolerance);
+        benchmark::BenchRunner::RunAll(compare, args);
+        ret = compare.GetRegressions() > 0 ? 1 : 0;
+    } else {
+        benchmark::BenchRunner::RunAll(*printer, args);
+    }
 
     ECC_Stop();
+    return ret;
 }
@@ -4,9 +4,11 @@
 
 #include <bench/bench.h>
 #include <coins.h>
+#include <crypto/common.h>
 #include <policy/policy.h>
 #include <wallet/crypter.h>
 
+#include <iostream>
 #include <vector>
 
 // FIXME: Dedup with SetupDummyInputs in test/transaction_tests.cpp.
@@ -84,4 +86,26 @@ static void CCoinsCaching(benchmark::State& state)
     }
 }
 
+// Fill a cache up to a fixed memory usage, as block connection does between flushes, and report
+// how many coins fit into a MB of -dbcache.
+static void CCoinsCacheFill(benchmark::State& state)
+{
+    static const size_t CACHE_BYTES = 16 << 20;
+    CCoinsView coinsDummy;
+    CTxOut txout(1 * CENT, CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 1) << OP_EQUALVERIFY << OP_CHECKSIG);
+    uint64_t nCoins = 0;
+    while (state.KeepRunning()) {
+        CCoinsViewCache coins(&coinsDummy);
+        uint32_t n = 0;
+        while (coins.DynamicMemoryUsage() < CACHE_BYTES) {
+            uint256 txid;
+            WriteLE32(txid.begin(), ++n);
+            coins.AddCoin(COutPoint(txid, 0), Coin(txout, 1, false), false);
+        }
+        nCoins = coins.GetCacheSize();
+    }
+    std::cout << "CCoinsCacheFill: " << nCoins / (CACHE_BYTES >> 20) << " coins per MB" << std::endl;
+}
+
 BENCHMARK(CCoinsCaching, 170 * 1000);
+BENCHMARK(CCoinsCacheFill, 2);
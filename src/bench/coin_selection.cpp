@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <bench/bench.h>
+#include <wallet/coinselection.h>
 #include <wallet/wallet.h>
 
 #include <set>
@@ -57,3 +58,89 @@ static void CoinSelection(benchmark::State& state)
 }
 
 BENCHMARK(CoinSelection, 650);
+
+static void addInputCoin(const CAmount& nValue, const CWallet& wallet, std::vector<CInputCoin>& vUtxoPool)
+{
+    static int nextLockTime = 0;
+    CMutableTransaction tx;
+    tx.nLockTime = nextLockTime++; // so all transactions get different hashes
+    tx.vout.resize(1);
+    tx.vout[0].nValue = nValue;
+    CWalletTx* wtx = new CWalletTx(&wallet, MakeTransactionRef(std::move(tx)));
+    vUtxoPool.emplace_back(wtx, 0);
+}
+
+static void clearInputCoins(std::vector<CInputCoin>& vUtxoPool)
+{
+    for (const CInputCoin& coin : vUtxoPool)
+        delete coin.walletTX;
+    vUtxoPool.clear();
+}
+
+// A wallet of many small outputs of mixed values, with a selection matching the target without
+// change deep in the search
+static void BnBManyOutputs(benchmark::State& state)
+{
+    const CWallet wallet;
+    std::vector<CInputCoin> vUtxoPool;
+    for (int i = 0; i < 10000; i++)
+        addInputCoin((i % 97 + 1) * CENT + i, wallet, vUtxoPool);
+
+    CoinSelectionParams params;
+    params.nCostOfChange = 5000;
+    params.nInputWaste = 100;
+    std::set<CInputCoin> setCoinsRet;
+    CAmount nValueRet;
+    while (state.KeepRunning()) {
+        SelectCoinsBnB(vUtxoPool, 25 * COIN + 12345, params, setCoinsRet, nValueRet);
+    }
+    clearInputCoins(vUtxoPool);
+}
+
+// Exhausting search: an unreachable target makes branch and bound visit every branch up to the limit
+static void BnBExhaustion(benchmark::State& state)
+{
+    const CWallet wallet;
+    std::vector<CInputCoin> vUtxoPool;
+    CAmount nTarget = 0;
+    for (int i = 0; i < 17; i++) {
+        addInputCoin(CAmount(1) << (17 + i), wallet, vUtxoPool);
+        addInputCoin((CAmount(1) << (17 + i)) + (CAmount(1) << (16 - i)), wallet, vUtxoPool);
+        nTarget += CAmount(1) << (17 + i);
+        if (i % 2 == 0)
+            nTarget += CAmount(1) << (16 - i);
+    }
+
+    CoinSelectionParams params;
+    params.nCostOfChange = 1;
+    std::set<CInputCoin> setCoinsRet;
+    CAmount nValueRet;
+    while (state.KeepRunning()) {
+        SelectCoinsBnB(vUtxoPool, nTarget + 1, params, setCoinsRet, nValueRet);
+    }
+    clearInputCoins(vUtxoPool);
+}
+
+// Inputs paying for a Zerocoin mint of whole denominations and its fee, without change
+static void MintDenominations(benchmark::State& state)
+{
+    const CWallet wallet;
+    std::vector<CInputCoin> vUtxoPool;
+    for (int i = 0; i < 1000; i++)
+        addInputCoin((i % 13 + 1) * COIN + (i % 7) * 10000, wallet, vUtxoPool);
+
+    CoinSelectionParams params;
+    params.nCostOfChange = 1000;
+    std::set<CInputCoin> setCoinsRet;
+    CAmount nValueRet;
+    CAmount nMintRet;
+    while (state.KeepRunning()) {
+        if (SelectCoinsMintDenominations(vUtxoPool, 5665 * COIN, 30000, params, setCoinsRet, nValueRet, nMintRet))
+            assert(nValueRet >= nMintRet + 30000 && nValueRet <= nMintRet + 30000 + params.nCostOfChange);
+    }
+    clearInputCoins(vUtxoPool);
+}
+
+BENCHMARK(BnBManyOutputs, 100);
+BENCHMARK(BnBExhaustion, 20);
+BENCHMARK(MintDenominations, 100);
@@ -4,6 +4,7 @@
 
 #include <bench/bench.h>
 #include <policy/policy.h>
+#include <random.h>
 #include <txmempool.h>
 
 #include <list>
@@ -112,3 +113,50 @@ static void MempoolEviction(benchmark::State& state)
 }
 
 BENCHMARK(MempoolEviction, 41000);
+
+// A mempool the size of a few blocks with transactions sized roughly like on
+// the NIX network: mostly small payments, some consolidations, short chains of
+// wallet change and a few zerocoin spends, each tens of kilobytes of proofs.
+// The pool is filled and trimmed back by a quarter the way LimitMempoolSize
+// does once it is full.
+static void MempoolEvictionNixSizes(benchmark::State& state)
+{
+    FastRandomContext rng(true);
+    std::vector<std::pair<CTransactionRef, CAmount>> vTxs;
+    for (int i = 0; i < 1000; i++) {
+        CMutableTransaction tx;
+        unsigned int nKind = rng.randrange(100);
+        if (nKind < 5) {
+            // zerocoin spend
+            tx.vin.resize(1);
+            tx.vin[0].prevout.SetNull();
+            tx.vin[0].scriptSig = CScript() << OP_ZEROCOINSPEND << std::vector<unsigned char>(20000 + rng.randrange(8000));
+            tx.vin[0].nSequence = 1;
+        } else {
+            tx.vin.resize(nKind < 85 ? 1 : 2 + rng.randrange(6));
+            for (CTxIn& txin : tx.vin) {
+                txin.prevout = COutPoint(rng.rand256(), rng.randrange(3));
+                txin.scriptSig = CScript() << std::vector<unsigned char>(72) << std::vector<unsigned char>(33);
+            }
+            // spend the change of the transaction before
+            if (nKind >= 95 && !vTxs.empty())
+                tx.vin[0].prevout = COutPoint(vTxs.back().first->GetHash(), 0);
+        }
+        tx.vout.resize(1 + rng.randrange(2));
+        for (CTxOut& txout : tx.vout) {
+            txout.scriptPubKey = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20) << OP_EQUALVERIFY << OP_CHECKSIG;
+            txout.nValue = 10 * COIN;
+        }
+        vTxs.emplace_back(MakeTransactionRef(tx), nKind < 5 ? 0 : 1000 + rng.randrange(20000));
+    }
+
+    CTxMemPool pool;
+    while (state.KeepRunning()) {
+        for (const auto& tx : vTxs)
+            AddTx(*tx.first, tx.second, pool);
+        pool.TrimToSize(pool.DynamicMemoryUsage() * 3 / 4);
+        pool.TrimToSize(0);
+    }
+}
+
+BENCHMARK(MempoolEvictionNixSizes, 20);
@@ -0,0 +1,40 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <univalue.h>
+
+#include <string>
+
+// A sendrawtransaction request carrying a zerocoin spend, whose hex is about 50 KB
+static void JsonReadLargeHex(benchmark::State& state)
+{
+    const std::string strRequest = "{\"method\":\"sendrawtransaction\",\"params\":[\"" + std::string(50000, 'a') + "\"],\"id\":1}";
+    while (state.KeepRunning()) {
+        UniValue request;
+        request.read(strRequest);
+    }
+}
+
+// An importmulti request with a thousand entries
+static void JsonReadImportMulti(benchmark::State& state)
+{
+    std::string strRequest = "{\"method\":\"importmulti\",\"params\":[[";
+    for (int i = 0; i < 1000; ++i) {
+        if (i > 0)
+            strRequest += ",";
+        strRequest += "{\"scriptPubKey\":{\"address\":\"NXPvBeHkZdVngF2zBYGCFbUz9Cka1BKj1Y\"},\"timestamp\":1530000000,"
+                      "\"label\":\"imported\",\"keys\":[\"0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef\"],"
+                      "\"watchonly\":false}";
+    }
+    strRequest += "]],\"id\":1}";
+    while (state.KeepRunning()) {
+        UniValue request;
+        request.read(strRequest);
+    }
+}
+
+BENCHMARK(JsonReadLargeHex, 100 * 1000);
+BENCHMARK(JsonReadImportMulti, 1000);
@@ -0,0 +1,110 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <libzerocoin/Zerocoin.h>
+#include <zerocoin/zerocoin.h>
+
+#include <cassert>
+#include <memory>
+#include <vector>
+
+// There are no NIX blocks with spends to decode here, the fixtures are made up on first use instead:
+// two real coins of one denomination and the accumulator and spend proof they allow
+namespace {
+
+struct ZerocoinFixture {
+    libzerocoin::PrivateCoin coin, otherCoin;
+    libzerocoin::Accumulator accumulator;
+    libzerocoin::SpendMetaData metaData;
+    std::unique_ptr<libzerocoin::CoinSpend> spend;
+
+    ZerocoinFixture() :
+        coin(ZCParams, libzerocoin::ZQ_ONE), otherCoin(ZCParams, libzerocoin::ZQ_ONE),
+        accumulator(ZCParams, libzerocoin::ZQ_ONE), metaData(0, uint256())
+    {
+        accumulator += coin.getPublicCoin();
+        accumulator += otherCoin.getPublicCoin();
+
+        libzerocoin::Accumulator checkpoint(ZCParams, libzerocoin::ZQ_ONE);
+        libzerocoin::AccumulatorWitness witness(ZCParams, checkpoint, coin.getPublicCoin());
+        witness.AddElement(otherCoin.getPublicCoin());
+        spend.reset(new libzerocoin::CoinSpend(ZCParams, coin, accumulator, witness, metaData));
+        spend->setVersion(coin.getVersion());
+        assert(spend->Verify(accumulator, metaData));
+    }
+};
+
+const ZerocoinFixture& GetZerocoinFixture()
+{
+    static ZerocoinFixture fixture;
+    return fixture;
+}
+
+// Public coins in the range of valid ones. They aren't prime, accumulating them costs the same anyway
+std::vector<libzerocoin::PublicCoin> MakePublicCoins(size_t nCoins)
+{
+    const CBigNum& minValue = ZCParams->accumulatorParams.minCoinValue;
+    const CBigNum& maxValue = ZCParams->accumulatorParams.maxCoinValue;
+    std::vector<libzerocoin::PublicCoin> coins;
+    for (size_t i = 0; i < nCoins; i++)
+        coins.emplace_back(ZCParams, minValue + CBigNum::randBignum(maxValue - minValue), libzerocoin::ZQ_ONE);
+    return coins;
+}
+
+}
+
+static void ZerocoinMint(benchmark::State& state)
+{
+    while (state.KeepRunning()) {
+        libzerocoin::PrivateCoin coin(ZCParams, libzerocoin::ZQ_ONE);
+    }
+}
+
+static void ZerocoinAccumulate(benchmark::State& state)
+{
+    std::vector<libzerocoin::PublicCoin> coins = MakePublicCoins(100);
+    libzerocoin::Accumulator accumulator(ZCParams, libzerocoin::ZQ_ONE);
+    size_t n = 0;
+    while (state.KeepRunning()) {
+        accumulator += coins[n];
+        if (++n == coins.size())
+            n = 0;
+    }
+}
+
+// The witness of a coin in a group of nGroupSize coins the way CZerocoinState::GetWitnessForSpend builds it,
+// accumulating every other coin of the group
+static void ZerocoinWitness(benchmark::State& state, size_t nGroupSize)
+{
+    const ZerocoinFixture& fixture = GetZerocoinFixture();
+    std::vector<libzerocoin::PublicCoin> coins = MakePublicCoins(nGroupSize - 1);
+    libzerocoin::Accumulator checkpoint(ZCParams, libzerocoin::ZQ_ONE);
+    while (state.KeepRunning()) {
+        libzerocoin::AccumulatorWitness witness(ZCParams, checkpoint, fixture.coin.getPublicCoin());
+        for (const libzerocoin::PublicCoin& coin : coins)
+            witness.AddElement(coin);
+    }
+}
+
+static void ZerocoinWitness10(benchmark::State& state) { ZerocoinWitness(state, 10); }
+static void ZerocoinWitness100(benchmark::State& state) { ZerocoinWitness(state, 100); }
+static void ZerocoinWitness1000(benchmark::State& state) { ZerocoinWitness(state, 1000); }
+
+static void ZerocoinSpendVerify(benchmark::State& state)
+{
+    const ZerocoinFixture& fixture = GetZerocoinFixture();
+    bool fValid = true;
+    while (state.KeepRunning()) {
+        fValid = fValid && fixture.spend->Verify(fixture.accumulator, fixture.metaData);
+    }
+    assert(fValid);
+}
+
+BENCHMARK(ZerocoinMint, 5);
+BENCHMARK(ZerocoinAccumulate, 1000);
+BENCHMARK(ZerocoinWitness10, 100);
+BENCHMARK(ZerocoinWitness100, 10);
+BENCHMARK(ZerocoinWitness1000, 1);
+BENCHMARK(ZerocoinSpendVerify, 5);
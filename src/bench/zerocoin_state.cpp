@@ -0,0 +1,36 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <random.h>
+#include <zerocoin/zerocoin.h>
+
+#include <unordered_set>
+#include <vector>
+
+// Lookups of coin serials the way CZerocoinState::IsUsedCoinSerial does them
+static void ZerocoinSerialLookup(benchmark::State& state)
+{
+    std::unordered_multiset<CBigNum, SaltedBigNumHasher> serials;
+    std::vector<CBigNum> queries;
+    for (int i = 0; i < 10000; i++) {
+        uint256 value = GetRandHash();
+        CBigNum serial(std::vector<unsigned char>(value.begin(), value.end()));
+        serials.insert(serial);
+        queries.push_back(serial);
+        // half of the lookups miss
+        value = GetRandHash();
+        queries.push_back(CBigNum(std::vector<unsigned char>(value.begin(), value.end())));
+    }
+
+    size_t n = 0;
+    uint64_t found = 0;
+    while (state.KeepRunning()) {
+        found += serials.count(queries[n]);
+        if (++n == queries.size())
+            n = 0;
+    }
+}
+
+BENCHMARK(ZerocoinSerialLookup, 2 * 1000 * 1000);
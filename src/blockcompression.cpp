@@ -0,0 +1,59 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockcompression.h>
+
+#include <crypto/common.h>
+#include <ghost-address/lz4.h>
+#include <ghost-address/xxhash.h>
+
+#include <string.h>
+
+void GetCompressedMessageStart(const CMessageHeader::MessageStartChars& messageStart, CMessageHeader::MessageStartChars& compressedStart)
+{
+    memcpy(compressedStart, messageStart, CMessageHeader::MESSAGE_START_SIZE);
+    compressedStart[CMessageHeader::MESSAGE_START_SIZE - 1] ^= 0xff;
+}
+
+bool IsCompressedMessageStart(const unsigned char* start, const CMessageHeader::MessageStartChars& messageStart)
+{
+    CMessageHeader::MessageStartChars compressedStart;
+    GetCompressedMessageStart(messageStart, compressedStart);
+    return memcmp(start, compressedStart, CMessageHeader::MESSAGE_START_SIZE) == 0;
+}
+
+bool CompressFrame(const char* data, size_t nSize, std::vector<char>& frame)
+{
+    frame.clear();
+    if (nSize <= COMPRESSED_FRAME_HEADER_SIZE + 1 || nSize > LZ4_MAX_INPUT_SIZE)
+        return false;
+
+    // Anything that does not fit in fewer bytes than the data is not worth storing compressed
+    frame.resize(nSize - 1);
+    int nCompressed = LZ4_compress_limitedOutput(data, frame.data() + COMPRESSED_FRAME_HEADER_SIZE, nSize, nSize - 1 - COMPRESSED_FRAME_HEADER_SIZE);
+    if (nCompressed <= 0) {
+        frame.clear();
+        return false;
+    }
+    frame.resize(COMPRESSED_FRAME_HEADER_SIZE + nCompressed);
+    WriteLE32((unsigned char*)frame.data(), nSize);
+    WriteLE32((unsigned char*)frame.data() + 4, XXH32(data, nSize, 0));
+    return true;
+}
+
+void DecompressFrame(const char* frame, size_t nFrameSize, CDataStream& stream, size_t nMaxSize)
+{
+    if (nFrameSize <= COMPRESSED_FRAME_HEADER_SIZE)
+        throw std::ios_base::failure("DecompressFrame(): frame too short");
+    uint32_t nSize = ReadLE32((const unsigned char*)frame);
+    if (nSize == 0 || nSize > nMaxSize || nSize > LZ4_MAX_INPUT_SIZE)
+        throw std::ios_base::failure("DecompressFrame(): frame size out of range");
+
+    stream.resize(nSize);
+    int nDecompressed = LZ4_decompress_safe(frame + COMPRESSED_FRAME_HEADER_SIZE, &stream[0], nFrameSize - COMPRESSED_FRAME_HEADER_SIZE, nSize);
+    if (nDecompressed < 0 || (uint32_t)nDecompressed != nSize)
+        throw std::ios_base::failure("DecompressFrame(): corrupt frame");
+    if (XXH32(&stream[0], nSize, 0) != ReadLE32((const unsigned char*)frame + 4))
+        throw std::ios_base::failure("DecompressFrame(): checksum mismatch");
+}
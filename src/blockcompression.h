@@ -0,0 +1,36 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKCOMPRESSION_H
+#define BITCOIN_BLOCKCOMPRESSION_H
+
+#include <protocol.h>
+#include <streams.h>
+
+#include <vector>
+
+/** Size of the header of a compressed frame: the size of the data and its xxHash32 checksum */
+static const unsigned int COMPRESSED_FRAME_HEADER_SIZE = 8;
+
+/**
+ * The message start written in front of the compressed records of block and undo files instead of
+ * messageStart. It differs from messageStart in the last byte only, so a scan for the first byte of
+ * messageStart finds both kinds of records.
+ */
+void GetCompressedMessageStart(const CMessageHeader::MessageStartChars& messageStart, CMessageHeader::MessageStartChars& compressedStart);
+bool IsCompressedMessageStart(const unsigned char* start, const CMessageHeader::MessageStartChars& messageStart);
+
+/**
+ * Compress nSize bytes at data into an LZ4 frame. Returns false and leaves frame empty if the frame
+ * would not be smaller than the data, which is then better stored as it is.
+ */
+bool CompressFrame(const char* data, size_t nSize, std::vector<char>& frame);
+
+/**
+ * Decompress a frame into stream and verify its checksum. Throws if the frame is corrupt or would
+ * decompress to more than nMaxSize bytes.
+ */
+void DecompressFrame(const char* frame, size_t nFrameSize, CDataStream& stream, size_t nMaxSize);
+
+#endif // BITCOIN_BLOCKCOMPRESSION_H
@@ -0,0 +1,130 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockconnectstats.h>
+
+#include <tinyformat.h>
+#include <util.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+#include <assert.h>
+#include <stdio.h>
+
+namespace {
+
+struct PhaseCounters {
+    uint64_t nCount = 0;
+    int64_t nTotalMicros = 0;
+    int64_t nMaxMicros = 0;
+    uint64_t histogram[CONNECT_PHASE_BUCKETS] = {};
+};
+
+std::mutex cs_connectstats;
+PhaseCounters phaseCounters[(int)ConnectPhase::COUNT];
+
+// The open trace, and whether an event was written to it already, guarded by cs_connectstats
+FILE* traceFile = nullptr;
+bool fTraceEmpty = true;
+
+int ThreadTraceId()
+{
+    static std::atomic<int> nNextId{1};
+    static thread_local int nId = nNextId++;
+    return nId;
+}
+
+} // namespace
+
+const char* ConnectPhaseName(ConnectPhase phase)
+{
+    switch (phase) {
+    case ConnectPhase::CONNECT_TIP: return "connecttip";
+    case ConnectPhase::READ_BLOCK: return "readblock";
+    case ConnectPhase::PREFETCH: return "prefetch";
+    case ConnectPhase::CONNECT_BLOCK: return "connectblock";
+    case ConnectPhase::CHECK_BLOCK: return "checkblock";
+    case ConnectPhase::ZEROCOIN_CHECKS: return "zerocoinchecks";
+    case ConnectPhase::FORK_CHECKS: return "forkchecks";
+    case ConnectPhase::CONNECT_TXS: return "connecttxs";
+    case ConnectPhase::GHOSTNODE_PAYMENTS: return "ghostnodepayments";
+    case ConnectPhase::VERIFY_SCRIPTS: return "verifyscripts";
+    case ConnectPhase::CONNECT_GHOST: return "connectghost";
+    case ConnectPhase::WRITE_INDEX: return "writeindex";
+    case ConnectPhase::FLUSH_VIEW: return "flushview";
+    case ConnectPhase::WRITE_CHAINSTATE: return "writechainstate";
+    case ConnectPhase::POST_CONNECT: return "postconnect";
+    case ConnectPhase::COUNT: break;
+    }
+    assert(false);
+}
+
+void RecordConnectPhase(ConnectPhase phase, int64_t nStartMicros, int64_t nEndMicros, int nHeight)
+{
+    int64_t nMicros = std::max<int64_t>(nEndMicros - nStartMicros, 0);
+    int nBucket = 0;
+    while (nBucket < CONNECT_PHASE_BUCKETS - 1 && nMicros >= ((int64_t)1 << nBucket))
+        nBucket++;
+
+    std::lock_guard<std::mutex> lock(cs_connectstats);
+    PhaseCounters& counters = phaseCounters[(int)phase];
+    counters.nCount++;
+    counters.nTotalMicros += nMicros;
+    counters.nMaxMicros = std::max(counters.nMaxMicros, nMicros);
+    counters.histogram[nBucket]++;
+
+    if (traceFile) {
+        std::string strArgs = nHeight >= 0 ? strprintf(",\"args\":{\"height\":%d}", nHeight) : "";
+        fputs(strprintf("%s{\"name\":\"%s\",\"cat\":\"validation\",\"ph\":\"X\",\"ts\":%d,\"dur\":%d,\"pid\":1,\"tid\":%d%s}",
+            fTraceEmpty ? "" : ",\n", ConnectPhaseName(phase), nStartMicros, nMicros, ThreadTraceId(), strArgs).c_str(), traceFile);
+        fTraceEmpty = false;
+        // Complete up to the last block connected, should the node not shut down cleanly
+        if (phase == ConnectPhase::CONNECT_TIP)
+            fflush(traceFile);
+    }
+}
+
+std::vector<ConnectPhaseStats> GetBlockConnectStats(bool fReset)
+{
+    std::vector<ConnectPhaseStats> ret;
+    std::lock_guard<std::mutex> lock(cs_connectstats);
+    for (int i = 0; i < (int)ConnectPhase::COUNT; i++) {
+        PhaseCounters& counters = phaseCounters[i];
+        ConnectPhaseStats stats;
+        stats.phase = (ConnectPhase)i;
+        stats.nCount = counters.nCount;
+        stats.nTotalMicros = counters.nTotalMicros;
+        stats.nMaxMicros = counters.nMaxMicros;
+        std::copy(counters.histogram, counters.histogram + CONNECT_PHASE_BUCKETS, stats.histogram);
+        ret.push_back(stats);
+        if (fReset)
+            counters = PhaseCounters();
+    }
+    return ret;
+}
+
+bool StartBlockConnectTrace(const fs::path& path)
+{
+    std::lock_guard<std::mutex> lock(cs_connectstats);
+    if (traceFile)
+        return false;
+    traceFile = fsbridge::fopen(path, "w");
+    if (!traceFile)
+        return false;
+    fputs("[\n", traceFile);
+    fTraceEmpty = true;
+    return true;
+}
+
+void StopBlockConnectTrace()
+{
+    std::lock_guard<std::mutex> lock(cs_connectstats);
+    if (!traceFile)
+        return;
+    fputs("\n]\n", traceFile);
+    fclose(traceFile);
+    traceFile = nullptr;
+}
@@ -0,0 +1,63 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKCONNECTSTATS_H
+#define BITCOIN_BLOCKCONNECTSTATS_H
+
+#include <fs.h>
+
+#include <stdint.h>
+#include <vector>
+
+/** The phases of connecting a block timed by ConnectTip, ConnectBlock and CheckBlock */
+enum class ConnectPhase {
+    CONNECT_TIP,       //!< All of ConnectTip
+    READ_BLOCK,        //!< Loading the block from disk
+    PREFETCH,          //!< Warming up the coins of its inputs
+    CONNECT_BLOCK,     //!< All of ConnectBlock, with BlockChecked
+    CHECK_BLOCK,       //!< CheckBlock again and the genesis special case
+    ZEROCOIN_CHECKS,   //!< The zerocoin transaction checks and spend proofs in CheckBlock
+    FORK_CHECKS,       //!< BIP30 and the script flags
+    CONNECT_TXS,       //!< Inputs, sequence locks, sigops and the coins updates of the transactions
+    GHOSTNODE_PAYMENTS,//!< The block value and ghostnode payee checks
+    VERIFY_SCRIPTS,    //!< From the start of the transactions until all their scripts are verified
+    CONNECT_GHOST,     //!< ConnectBlockGhost, the zerocoin state of the block
+    WRITE_INDEX,       //!< Undo data, block index validity and transaction index writes
+    FLUSH_VIEW,        //!< Flushing the block's coins view into the tip
+    WRITE_CHAINSTATE,  //!< FlushStateToDisk, if needed
+    POST_CONNECT,      //!< Mempool, tip and ghostnode payment updates after the block
+    COUNT
+};
+
+/** Number of buckets of the phase histograms, bucket i counts times below 2^i microseconds and the last one the rest */
+static const int CONNECT_PHASE_BUCKETS = 28;
+
+/** Default for -blockconnecttrace */
+static const char* const DEFAULT_BLOCK_CONNECT_TRACE = "";
+
+const char* ConnectPhaseName(ConnectPhase phase);
+
+/** Count a phase that took from nStartMicros to nEndMicros (GetTimeMicros), and trace it if a trace is open. */
+void RecordConnectPhase(ConnectPhase phase, int64_t nStartMicros, int64_t nEndMicros, int nHeight = -1);
+
+struct ConnectPhaseStats {
+    ConnectPhase phase;
+    uint64_t nCount;
+    int64_t nTotalMicros;
+    int64_t nMaxMicros;
+    uint64_t histogram[CONNECT_PHASE_BUCKETS];
+};
+
+/** The statistics of every phase since startup or the last reset, optionally zeroing them */
+std::vector<ConnectPhaseStats> GetBlockConnectStats(bool fReset = false);
+
+/**
+ * Write every phase recorded from now on to path as a complete event of the Chrome trace event
+ * format (chrome://tracing, Perfetto), one track per thread.
+ */
+bool StartBlockConnectTrace(const fs::path& path);
+/** Close the trace file, if one is open. */
+void StopBlockConnectTrace();
+
+#endif // BITCOIN_BLOCKCONNECTSTATS_H
@@ -15,6 +15,8 @@
 
 #include <unordered_map>
 
+CompactBlockStats g_compact_block_stats;
+
 CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(const CBlock& block, bool fUseWTXID) :
         nonce(GetRand(std::numeric_limits<uint64_t>::max())),
         shorttxids(block.vtx.size() - 1), prefilledtxn(1), header(block) {
@@ -45,7 +47,16 @@ uint64_t CBlockHeaderAndShortTxIDs::GetShortID(const uint256& txhash) const {
 
 
 
-ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<std::pair<uint256, CTransactionRef>>& extra_txn) {
+ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<std::pair<uint256, CTransactionRef>>& extra_txn,
+                                              const std::vector<std::pair<uint256, CTransactionRef>>& extra_spends) {
+    ReadStatus status = InitDataFromPools(cmpctblock, extra_txn, extra_spends);
+    if (status != READ_STATUS_OK)
+        g_compact_block_stats.nFailed++;
+    return status;
+}
+
+ReadStatus PartiallyDownloadedBlock::InitDataFromPools(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<std::pair<uint256, CTransactionRef>>& extra_txn,
+                                                       const std::vector<std::pair<uint256, CTransactionRef>>& extra_spends) {
     if (cmpctblock.header.IsNull() || (cmpctblock.shorttxids.empty() && cmpctblock.prefilledtxn.empty()))
         return READ_STATUS_INVALID;
     if (cmpctblock.shorttxids.size() + cmpctblock.prefilledtxn.size() > MAX_BLOCK_WEIGHT / MIN_SERIALIZABLE_TRANSACTION_WEIGHT)
@@ -131,12 +142,16 @@ ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& c
     }
     }
 
-    for (size_t i = 0; i < extra_txn.size(); i++) {
-        uint64_t shortid = cmpctblock.GetShortID(extra_txn[i].first);
+    for (const std::vector<std::pair<uint256, CTransactionRef>>* extra : {&extra_spends, &extra_txn}) {
+    for (size_t i = 0; i < extra->size() && mempool_count < shorttxids.size(); i++) {
+        const std::pair<uint256, CTransactionRef>& extra_tx = (*extra)[i];
+        if (!extra_tx.second)
+            continue;
+        uint64_t shortid = cmpctblock.GetShortID(extra_tx.first);
         std::unordered_map<uint64_t, uint16_t>::iterator idit = shorttxids.find(shortid);
         if (idit != shorttxids.end()) {
             if (!have_txn[idit->second]) {
-                txn_available[idit->second] = extra_txn[i].second;
+                txn_available[idit->second] = extra_tx.second;
                 have_txn[idit->second]  = true;
                 mempool_count++;
                 extra_count++;
@@ -148,7 +163,7 @@ ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& c
                 // Note that we don't want duplication between extra_txn and mempool to
                 // trigger this case, so we compare witness hashes first
                 if (txn_available[idit->second] &&
-                        txn_available[idit->second]->GetWitnessHash() != extra_txn[i].second->GetWitnessHash()) {
+                        txn_available[idit->second]->GetWitnessHash() != extra_tx.first) {
                     txn_available[idit->second].reset();
                     mempool_count--;
                     extra_count--;
@@ -157,9 +172,8 @@ ReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& c
         }
         // Though ideally we'd continue scanning for the two-txn-match-shortid case,
         // the performance win of an early exit here is too good to pass up and worth
-        // the extra risk.
-        if (mempool_count == shorttxids.size())
-            break;
+        // the extra risk (the loop condition stops once every short id is matched).
+    }
     }
 
     LogPrint(BCLog::CMPCTBLOCK, "Initialized PartiallyDownloadedBlock for block %s using a cmpctblock of size %lu\n", cmpctblock.header.GetHash().ToString(), GetSerializeSize(cmpctblock, SER_NETWORK, PROTOCOL_VERSION));
@@ -182,8 +196,10 @@ ReadStatus PartiallyDownloadedBlock::FillBlock(CBlock& block, const std::vector<
     size_t tx_missing_offset = 0;
     for (size_t i = 0; i < txn_available.size(); i++) {
         if (!txn_available[i]) {
-            if (vtx_missing.size() <= tx_missing_offset)
+            if (vtx_missing.size() <= tx_missing_offset) {
+                g_compact_block_stats.nFailed++;
                 return READ_STATUS_INVALID;
+            }
             block.vtx[i] = vtx_missing[tx_missing_offset++];
         } else
             block.vtx[i] = std::move(txn_available[i]);
@@ -193,11 +209,14 @@ ReadStatus PartiallyDownloadedBlock::FillBlock(CBlock& block, const std::vector<
     header.SetNull();
     txn_available.clear();
 
-    if (vtx_missing.size() != tx_missing_offset)
+    if (vtx_missing.size() != tx_missing_offset) {
+        g_compact_block_stats.nFailed++;
         return READ_STATUS_INVALID;
+    }
 
     CValidationState state;
     if (!CheckBlock(block, state, Params().GetConsensus())) {
+        g_compact_block_stats.nFailed++;
         // TODO: We really want to just check merkle tree manually here,
         // but that is expensive, and CheckBlock caches a block's
         // "checked-status" (in the CBlock?). CBlock should be able to
@@ -207,6 +226,24 @@ ReadStatus PartiallyDownloadedBlock::FillBlock(CBlock& block, const std::vector<
         return READ_STATUS_CHECKBLOCK_FAILED;
     }
 
+    g_compact_block_stats.nReconstructed++;
+    if (vtx_missing.empty())
+        g_compact_block_stats.nReconstructedNoRoundTrip++;
+    g_compact_block_stats.nTxPrefilled += prefilled_count;
+    g_compact_block_stats.nTxMempool += mempool_count - extra_count;
+    g_compact_block_stats.nTxExtra += extra_count;
+    g_compact_block_stats.nTxRequested += vtx_missing.size();
+    size_t nSpendsRequested = 0;
+    for (const auto& tx : vtx_missing)
+        if (tx->IsZerocoinSpend())
+            nSpendsRequested++;
+    size_t nSpends = 0;
+    for (const auto& tx : block.vtx)
+        if (tx->IsZerocoinSpend())
+            nSpends++;
+    g_compact_block_stats.nSpendsLocal += nSpends - nSpendsRequested;
+    g_compact_block_stats.nSpendsRequested += nSpendsRequested;
+
     LogPrint(BCLog::CMPCTBLOCK, "Successfully reconstructed block %s with %lu txn prefilled, %lu txn from mempool (incl at least %lu from extra pool) and %lu txn requested\n", hash.ToString(), prefilled_count, mempool_count, extra_count, vtx_missing.size());
     if (vtx_missing.size() < 5) {
         for (const auto& tx : vtx_missing) {
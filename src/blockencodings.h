@@ -7,6 +7,7 @@
 
 #include <primitives/block.h>
 
+#include <atomic>
 #include <memory>
 
 class CTxMemPool;
@@ -191,17 +192,36 @@ public:
     }
 };
 
+/** How compact blocks were reconstructed since startup */
+struct CompactBlockStats {
+    std::atomic<uint64_t> nReconstructed{0};            //! Blocks reconstructed
+    std::atomic<uint64_t> nReconstructedNoRoundTrip{0}; //! Of those, without requesting any transaction
+    std::atomic<uint64_t> nFailed{0};                   //! Compact blocks that could not be reconstructed
+    std::atomic<uint64_t> nTxPrefilled{0};
+    std::atomic<uint64_t> nTxMempool{0};
+    std::atomic<uint64_t> nTxExtra{0};
+    std::atomic<uint64_t> nTxRequested{0};
+    std::atomic<uint64_t> nSpendsLocal{0};              //! Zerocoin spends found in the mempool or an extra pool
+    std::atomic<uint64_t> nSpendsRequested{0};          //! Zerocoin spends that had to be requested
+};
+extern CompactBlockStats g_compact_block_stats;
+
 class PartiallyDownloadedBlock {
 protected:
     std::vector<CTransactionRef> txn_available;
     size_t prefilled_count = 0, mempool_count = 0, extra_count = 0;
     CTxMemPool* pool;
+
+    ReadStatus InitDataFromPools(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<std::pair<uint256, CTransactionRef>>& extra_txn,
+                                 const std::vector<std::pair<uint256, CTransactionRef>>& extra_spends);
 public:
     CBlockHeader header;
     explicit PartiallyDownloadedBlock(CTxMemPool* poolIn) : pool(poolIn) {}
 
-    // extra_txn is a list of extra transactions to look at, in <witness hash, reference> form
-    ReadStatus InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<std::pair<uint256, CTransactionRef>>& extra_txn);
+    // extra_txn and extra_spends are lists of extra transactions to look at, in <witness hash, reference> form.
+    // extra_spends holds zerocoin spends, which are too big to share a pool with the other transactions
+    ReadStatus InitData(const CBlockHeaderAndShortTxIDs& cmpctblock, const std::vector<std::pair<uint256, CTransactionRef>>& extra_txn,
+                        const std::vector<std::pair<uint256, CTransactionRef>>& extra_spends = std::vector<std::pair<uint256, CTransactionRef>>());
     bool IsTxAvailable(size_t index) const;
     ReadStatus FillBlock(CBlock& block, const std::vector<CTransactionRef>& vtx_missing);
 };
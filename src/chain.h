@@ -7,6 +7,7 @@
 #define BITCOIN_CHAIN_H
 
 #include <arith_uint256.h>
+#include <lazycontainer.h>
 #include <primitives/block.h>
 #include <pow.h>
 #include <tinyformat.h>
@@ -30,6 +31,11 @@ static const int64_t MAX_FUTURE_BLOCK_TIME = 2 * 60 * 60;
  */
 static const int64_t TIMESTAMP_WINDOW = MAX_FUTURE_BLOCK_TIME;
 
+enum BlockFileFlags : unsigned int {
+    //! Every block of the file was written by a node compressing blocks, or converted since
+    BLOCK_FILE_COMPRESSED = 1,
+};
+
 class CBlockFileInfo
 {
 public:
@@ -40,18 +46,33 @@ public:
     unsigned int nHeightLast;  //!< highest height of block in file
     uint64_t nTimeFirst;       //!< earliest time of block in file
     uint64_t nTimeLast;        //!< latest time of block in file
-
-    ADD_SERIALIZE_METHODS;
-
-    template <typename Stream, typename Operation>
-    inline void SerializationOp(Stream& s, Operation ser_action) {
-        READWRITE(VARINT(nBlocks));
-        READWRITE(VARINT(nSize));
-        READWRITE(VARINT(nUndoSize));
-        READWRITE(VARINT(nHeightFirst));
-        READWRITE(VARINT(nHeightLast));
-        READWRITE(VARINT(nTimeFirst));
-        READWRITE(VARINT(nTimeLast));
+    unsigned int nFlags;       //!< BlockFileFlags of the file
+
+    template <typename Stream>
+    void Serialize(Stream& s) const {
+        s << VARINT(nBlocks);
+        s << VARINT(nSize);
+        s << VARINT(nUndoSize);
+        s << VARINT(nHeightFirst);
+        s << VARINT(nHeightLast);
+        s << VARINT(nTimeFirst);
+        s << VARINT(nTimeLast);
+        s << VARINT(nFlags);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s) {
+        s >> VARINT(nBlocks);
+        s >> VARINT(nSize);
+        s >> VARINT(nUndoSize);
+        s >> VARINT(nHeightFirst);
+        s >> VARINT(nHeightLast);
+        s >> VARINT(nTimeFirst);
+        s >> VARINT(nTimeLast);
+        // Entries written before the flags were added end here
+        nFlags = 0;
+        if (!s.empty())
+            s >> VARINT(nFlags);
     }
 
      void SetNull() {
@@ -62,6 +83,7 @@ public:
          nHeightLast = 0;
          nTimeFirst = 0;
          nTimeLast = 0;
+         nFlags = 0;
      }
 
      CBlockFileInfo() {
@@ -223,14 +245,15 @@ public:
 
     //! zerocoin specific fields
     //!
-    //! Public coin values of mints in this block, ordered by serialized value of public coin
-    //! Maps <denomination,id> to vector of public coins
-    map<pair<int,int>, vector<CBigNum>> mintedPubCoins;
+    //! Public coins minted in the block are kept in the zerocoin database (see CZerocoinDB)
+    //!
+    //! Both are empty for most blocks, so they are only allocated when a block has zerocoin data
+    //!
     //! Accumulator updates. Contains only changes made by mints in this block
     //! Maps <denomination, id> to <accumulator value (CBigNum), number of such mints in this block>
-    map<pair<int,int>, pair<CBigNum,int>> accumulatorChanges;
+    lazycontainer<map<pair<int,int>, pair<CBigNum,int>>> accumulatorChanges;
     //! Values of coin serials spent in this block
-    set<CBigNum> spentSerials;
+    lazycontainer<set<CBigNum>> spentSerials;
 
     void SetNull()
     {
@@ -255,7 +278,6 @@ public:
         nNonce         = 0;
 
         //Zerocoin params
-        mintedPubCoins.clear();
         accumulatorChanges.clear();
         spentSerials.clear();
     }
@@ -394,6 +416,9 @@ class CDiskBlockIndex : public CBlockIndex
 {
 public:
     uint256 hashPrev;
+    //! Public coins minted in the block, only present in entries written by older versions. Loading
+    //! the block index moves them to the zerocoin database, new entries always have this empty
+    map<pair<int,int>, vector<CBigNum>> mintedPubCoins;
 
     CDiskBlockIndex() {
         hashPrev = uint256();
@@ -403,6 +428,24 @@ public:
         hashPrev = (pprev ? pprev->GetBlockHash() : uint256());
     }
 
+    //! Copy of the entry with or without its zerocoin data. The block index database keeps the zerocoin
+    //! data in its own record (see CDiskBlockZerocoin), so the entry is written without it.
+    CDiskBlockIndex(const CBlockIndex* pindex, bool fWithZerocoin) : CBlockIndex(pindex->GetBlockHeader()) {
+        phashBlock = pindex->phashBlock;
+        pprev      = pindex->pprev;
+        nHeight    = pindex->nHeight;
+        nFile      = pindex->nFile;
+        nDataPos   = pindex->nDataPos;
+        nUndoPos   = pindex->nUndoPos;
+        nStatus    = pindex->nStatus;
+        nTx        = pindex->nTx;
+        hashPrev = (pprev ? pprev->GetBlockHash() : uint256());
+        if (fWithZerocoin) {
+            accumulatorChanges = pindex->accumulatorChanges;
+            spentSerials       = pindex->spentSerials;
+        }
+    }
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
@@ -460,6 +503,30 @@ public:
     }
 };
 
+/**
+ * Zerocoin data of a block index entry, in its own record of the block index database. The record is
+ * only rewritten when the data changes, not on every status or position change of the entry.
+ */
+class CDiskBlockZerocoin
+{
+public:
+    map<pair<int,int>, pair<CBigNum,int>> accumulatorChanges;
+    set<CBigNum> spentSerials;
+
+    CDiskBlockZerocoin() {}
+
+    explicit CDiskBlockZerocoin(const CBlockIndex* pindex) :
+        accumulatorChanges(pindex->accumulatorChanges), spentSerials(pindex->spentSerials) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(accumulatorChanges);
+        READWRITE(spentSerials);
+    }
+};
+
 /** An in-memory indexed chain of blocks. */
 class CChain {
 private:
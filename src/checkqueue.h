@@ -8,6 +8,8 @@
 #include <sync.h>
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
 #include <vector>
 
 #include <boost/thread/condition_variable.hpp>
@@ -25,12 +27,30 @@ class CCheckQueueControl;
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * Every participant has its own work queue with its own lock. The master
+  * spreads new verifications over the work queues, and a participant whose
+  * queue is empty steals from the others. The shared mutex is only taken to
+  * go to sleep and to wake up sleeping threads.
   */
 template <typename T>
 class CCheckQueue
 {
 private:
-    //! Mutex to protect the inner state
+    //! Maximum number of work queues, more workers share them
+    static const unsigned int MAX_WORK_QUEUES = 32;
+
+    //! The verifications queued for one participant. The owner takes them from
+    //! the back, the other participants steal from the front.
+    struct WorkQueue {
+        boost::mutex mutex;
+        std::deque<T> checks;
+    };
+
+    //! Work queue 0 belongs to the master, the workers use the others
+    WorkQueue vWorkQueues[MAX_WORK_QUEUES];
+
+    //! Mutex to protect sleeping and waking up
     boost::mutex mutex;
 
     //! Worker threads block on this when out of work
@@ -39,87 +59,96 @@ private:
     //! Master thread blocks on this when out of work
     boost::condition_variable condMaster;
 
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue;
+    //! The number of worker threads (excluding the master).
+    std::atomic<unsigned int> nWorkers;
 
-    //! The number of workers (including the master) that are idle.
-    int nIdle;
-
-    //! The total number of workers (including the master).
-    int nTotal;
+    //! The number of verifications in the work queues.
+    std::atomic<unsigned int> nQueued;
 
     //! The temporary evaluation result.
-    bool fAllOk;
+    std::atomic<bool> fAllOk;
 
     /**
      * Number of verifications that haven't completed yet.
      * This includes elements that are no longer queued, but still in the
      * worker's own batches.
      */
-    unsigned int nTodo;
+    std::atomic<unsigned int> nTodo;
 
     //! The maximum number of elements to be processed in one batch
     unsigned int nBatchSize;
 
+    //! The work queue that receives the next verifications, only used by the master
+    unsigned int nNextQueue;
+
+    unsigned int NumWorkQueues() const
+    {
+        return std::min(nWorkers.load() + 1, MAX_WORK_QUEUES);
+    }
+
+    /** Move a batch of verifications into vChecks, from the own work queue or else stolen from another one. */
+    bool TakeChecks(unsigned int nOwnQueue, std::vector<T>& vChecks)
+    {
+        const unsigned int nQueues = NumWorkQueues();
+        for (unsigned int i = 0; i < nQueues; i++) {
+            WorkQueue& wq = vWorkQueues[(nOwnQueue + i) % nQueues];
+            boost::unique_lock<boost::mutex> lock(wq.mutex);
+            if (wq.checks.empty())
+                continue;
+            // Leave half of the queue to the others, so all participants finish approximately
+            // simultaneously. Don't do batches smaller than 1 or larger than nBatchSize.
+            unsigned int nNow = std::max(1U, std::min(nBatchSize, (unsigned int)wq.checks.size() / 2));
+            vChecks.resize(nNow);
+            for (T& check : vChecks) {
+                // swap jobs into the local batch vector instead of copying
+                if (i == 0) {
+                    check.swap(wq.checks.back());
+                    wq.checks.pop_back();
+                } else {
+                    check.swap(wq.checks.front());
+                    wq.checks.pop_front();
+                }
+            }
+            nQueued -= nNow;
+            return true;
+        }
+        return false;
+    }
+
     /** Internal function that does bulk of the verification work. */
     bool Loop(bool fMaster = false)
     {
-        boost::condition_variable& cond = fMaster ? condMaster : condWorker;
+        unsigned int nOwnQueue = fMaster ? 0 : 1 + nWorkers++ % (MAX_WORK_QUEUES - 1);
         std::vector<T> vChecks;
         vChecks.reserve(nBatchSize);
-        unsigned int nNow = 0;
-        bool fOk = true;
         do {
-            {
-                boost::unique_lock<boost::mutex> lock(mutex);
-                // first do the clean-up of the previous loop run (allowing us to do it in the same critsect)
-                if (nNow) {
-                    fAllOk &= fOk;
-                    nTodo -= nNow;
-                    if (nTodo == 0 && !fMaster)
-                        // We processed the last element; inform the master it can exit and return the result
-                        condMaster.notify_one();
-                } else {
-                    // first iteration
-                    nTotal++;
-                }
-                // logically, the do loop starts here
-                while (queue.empty()) {
-                    if (fMaster && nTodo == 0) {
-                        nTotal--;
-                        bool fRet = fAllOk;
-                        // reset the status for new work later
-                        if (fMaster)
-                            fAllOk = true;
-                        // return the current status
-                        return fRet;
-                    }
-                    nIdle++;
-                    cond.wait(lock); // wait
-                    nIdle--;
-                }
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for increasingly smaller batches so
-                //   all workers finish approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start helping.
-                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the mutex to be as short as possible, so swap jobs from the global
-                    // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
-                }
+            if (TakeChecks(nOwnQueue, vChecks)) {
                 // Check whether we need to do work at all
-                fOk = fAllOk;
+                bool fOk = fAllOk;
+                // execute work
+                for (T& check : vChecks)
+                    if (fOk)
+                        fOk = check();
+                const unsigned int nNow = vChecks.size();
+                vChecks.clear();
+                if (!fOk)
+                    fAllOk = false;
+                if (nTodo.fetch_sub(nNow) == nNow) {
+                    // We processed the last element; inform the master it can exit and return the result
+                    boost::unique_lock<boost::mutex> lock(mutex);
+                    condMaster.notify_one();
+                }
+                continue;
             }
-            // execute work
-            for (T& check : vChecks)
-                if (fOk)
-                    fOk = check();
-            vChecks.clear();
+
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (fMaster && nTodo == 0) {
+                // return the current status and reset it for new work later
+                return fAllOk.exchange(true);
+            }
+            // Add increments nQueued before it takes the mutex to wake us up
+            if (nQueued == 0)
+                (fMaster ? condMaster : condWorker).wait(lock);
         } while (true);
     }
 
@@ -128,7 +157,7 @@ public:
     boost::mutex ControlMutex;
 
     //! Create a new check queue
-    explicit CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), nBatchSize(nBatchSizeIn) {}
+    explicit CCheckQueue(unsigned int nBatchSizeIn) : nWorkers(0), nQueued(0), fAllOk(true), nTodo(0), nBatchSize(nBatchSizeIn), nNextQueue(0) {}
 
     //! Worker thread
     void Thread()
@@ -145,15 +174,28 @@ public:
     //! Add a batch of checks to the queue
     void Add(std::vector<T>& vChecks)
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        for (T& check : vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
+        const unsigned int nChecks = vChecks.size();
+        if (nChecks == 0)
+            return;
+        nTodo += nChecks;
+        nQueued += nChecks;
+
+        // Spread the checks over the work queues, in one piece per queue
+        const unsigned int nQueues = NumWorkQueues();
+        const unsigned int nPerQueue = (nChecks + nQueues - 1) / nQueues;
+        for (unsigned int i = 0; i < nChecks; i += nPerQueue) {
+            WorkQueue& wq = vWorkQueues[nNextQueue++ % nQueues];
+            boost::unique_lock<boost::mutex> lock(wq.mutex);
+            for (unsigned int j = i; j < std::min(nChecks, i + nPerQueue); j++) {
+                wq.checks.push_back(T());
+                vChecks[j].swap(wq.checks.back());
+            }
         }
-        nTodo += vChecks.size();
-        if (vChecks.size() == 1)
+
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (nChecks == 1)
             condWorker.notify_one();
-        else if (vChecks.size() > 1)
+        else
             condWorker.notify_all();
     }
 
@@ -0,0 +1,93 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <coinbasepayouts.h>
+
+#include <base58.h>
+#include <chainparamsbase.h>
+#include <consensus/airdropaddresses.h>
+#include <primitives/transaction.h>
+#include <script/standard.h>
+
+#include <algorithm>
+#include <assert.h>
+#include <memory>
+
+/** Number of airdrop outputs of block 1 on main net */
+static const size_t AIRDROP_PAYEES = 100;
+
+static std::unique_ptr<CCoinbasePayouts> globalCoinbasePayouts;
+
+void CCoinbasePayouts::AddPayees(const std::vector<std::string>& vAddresses, std::vector<Payee>& vPayees, PayeeIndex& index)
+{
+    for (const std::string& address : vAddresses) {
+        Payee payee;
+        payee.address = address;
+        payee.script = GetScriptForDestination(DecodeDestination(address));
+        index[payee.script].push_back(vPayees.size());
+        vPayees.push_back(payee);
+    }
+}
+
+template <typename Matches>
+bool CCoinbasePayouts::PaysAll(const CTransaction& tx, const PayeeIndex& index, size_t nPayees, Matches fMatches)
+{
+    std::vector<bool> vPaid(nPayees, false);
+    size_t nPaid = 0;
+    for (const CTxOut& txout : tx.vout) {
+        if (nPaid == nPayees)
+            break;
+        PayeeIndex::const_iterator it = index.find(txout.scriptPubKey);
+        if (it == index.end())
+            continue;
+        for (size_t n : it->second) {
+            if (!vPaid[n] && fMatches(n, txout.nValue)) {
+                vPaid[n] = true;
+                nPaid++;
+            }
+        }
+    }
+    return nPaid == nPayees;
+}
+
+CCoinbasePayouts::CCoinbasePayouts(const std::vector<std::string>& vAirdropAddresses, const std::vector<std::string>& vDevFundAddresses)
+{
+    AddPayees(vAirdropAddresses, vAirdrop, indexAirdrop);
+    AddPayees(vDevFundAddresses, vDevFund, indexDevFund);
+}
+
+bool CCoinbasePayouts::PaysAirdrop(const CTransaction& tx, const std::vector<CAmount>& vAmounts) const
+{
+    return PaysAll(tx, indexAirdrop, vAirdrop.size(), [&vAmounts](size_t n, CAmount nValue) {
+        return std::find(vAmounts.begin(), vAmounts.end(), nValue) != vAmounts.end();
+    });
+}
+
+bool CCoinbasePayouts::PaysDevFund(const CTransaction& tx, const std::vector<CAmount>& vAmounts) const
+{
+    assert(vAmounts.size() == vDevFund.size());
+    return PaysAll(tx, indexDevFund, vDevFund.size(), [&vAmounts](size_t n, CAmount nValue) {
+        return vAmounts[n] == nValue;
+    });
+}
+
+const CCoinbasePayouts& CoinbasePayouts()
+{
+    assert(globalCoinbasePayouts);
+    return *globalCoinbasePayouts;
+}
+
+void SelectCoinbasePayouts(const std::string& chain)
+{
+    if (chain == CBaseChainParams::TESTNET) {
+        globalCoinbasePayouts.reset(new CCoinbasePayouts(
+            {"2PosyBduiL7yMfBK8DZEtCBJaQF76zgE8f"},
+            {"2PosyBduiL7yMfBK8DZEtCBJaQF76zgE8f", "2WT5wFpLXoWm1H8CSgWVcq2F2LyhwKJcG1"}));
+    } else {
+        // regtest checks the main net addresses, decoded with its own prefixes
+        globalCoinbasePayouts.reset(new CCoinbasePayouts(
+            std::vector<std::string>(airdrop_addresses, airdrop_addresses + AIRDROP_PAYEES),
+            {"NVbGEghDbxPUe97oY8N5RvagQ61cHQiouW", "NWF7QNfT1b8a9dSQmVTT6hcwzwEVYVmDsG"}));
+    }
+}
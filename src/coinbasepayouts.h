@@ -0,0 +1,68 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_COINBASEPAYOUTS_H
+#define BITCOIN_COINBASEPAYOUTS_H
+
+#include <amount.h>
+#include <script/script.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+class CTransaction;
+
+/**
+ * Payees a coinbase transaction has to pay: the airdrop in block 1 and the development fund in
+ * every later block. The addresses are decoded once when the chain is selected and indexed by
+ * script, so checking a coinbase takes a single pass over its outputs.
+ */
+class CCoinbasePayouts
+{
+public:
+    struct Payee {
+        std::string address;
+        CScript script;
+    };
+
+private:
+    /** Positions of the payees in a list by their script, several payees may share one */
+    typedef std::map<CScript, std::vector<size_t> > PayeeIndex;
+
+    std::vector<Payee> vAirdrop;
+    std::vector<Payee> vDevFund;
+    PayeeIndex indexAirdrop;
+    PayeeIndex indexDevFund;
+
+    static void AddPayees(const std::vector<std::string>& vAddresses, std::vector<Payee>& vPayees, PayeeIndex& index);
+
+    /** Whether every payee is paid by an output for which fMatches(payee position, amount) holds */
+    template <typename Matches>
+    static bool PaysAll(const CTransaction& tx, const PayeeIndex& index, size_t nPayees, Matches fMatches);
+
+public:
+    CCoinbasePayouts(const std::vector<std::string>& vAirdropAddresses, const std::vector<std::string>& vDevFundAddresses);
+
+    const std::vector<Payee>& Airdrop() const { return vAirdrop; }
+    const std::vector<Payee>& DevFund() const { return vDevFund; }
+
+    /** Whether tx pays every airdrop payee one of the given amounts */
+    bool PaysAirdrop(const CTransaction& tx, const std::vector<CAmount>& vAmounts) const;
+
+    /** Whether tx pays every development fund payee the amount at its position in vAmounts */
+    bool PaysDevFund(const CTransaction& tx, const std::vector<CAmount>& vAmounts) const;
+};
+
+/**
+ * Return the payouts of the chain selected with SelectParams.
+ */
+const CCoinbasePayouts& CoinbasePayouts();
+
+/**
+ * Decode the payees of the given chain, called by SelectParams once the chain parameters are set.
+ */
+void SelectCoinbasePayouts(const std::string& chain);
+
+#endif // BITCOIN_COINBASEPAYOUTS_H
@@ -5,12 +5,14 @@
 #include <coins.h>
 
 #include <consensus/consensus.h>
+#include <metrics.h>
 #include <random.h>
 
 bool CCoinsView::GetCoin(const COutPoint &outpoint, Coin &coin) const { return false; }
 uint256 CCoinsView::GetBestBlock() const { return uint256(); }
 std::vector<uint256> CCoinsView::GetHeadBlocks() const { return std::vector<uint256>(); }
 bool CCoinsView::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) { return false; }
+bool CCoinsView::BatchWritePartial(CCoinsMap &mapCoins, const uint256 &hashBlock) { return false; }
 CCoinsViewCursor *CCoinsView::Cursor() const { return nullptr; }
 
 bool CCoinsView::HaveCoin(const COutPoint &outpoint) const
@@ -26,19 +28,29 @@ uint256 CCoinsViewBacked::GetBestBlock() const { return base->GetBestBlock(); }
 std::vector<uint256> CCoinsViewBacked::GetHeadBlocks() const { return base->GetHeadBlocks(); }
 void CCoinsViewBacked::SetBackend(CCoinsView &viewIn) { base = &viewIn; }
 bool CCoinsViewBacked::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) { return base->BatchWrite(mapCoins, hashBlock); }
+bool CCoinsViewBacked::BatchWritePartial(CCoinsMap &mapCoins, const uint256 &hashBlock) { return base->BatchWritePartial(mapCoins, hashBlock); }
 CCoinsViewCursor *CCoinsViewBacked::Cursor() const { return base->Cursor(); }
 size_t CCoinsViewBacked::EstimateSize() const { return base->EstimateSize(); }
 
 SaltedOutpointHasher::SaltedOutpointHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
 
-CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), cachedCoinsUsage(0) {}
+CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn),
+    cacheCoins(0, SaltedOutpointHasher(), std::equal_to<COutPoint>(), &cacheCoinsMemoryResource), cachedCoinsUsage(0), fTrackDirty(false), fCountMetrics(false) {}
 
 size_t CCoinsViewCache::DynamicMemoryUsage() const {
-    return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage;
+    return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage + dirtyQueue.size() * sizeof(COutPoint);
+}
+
+void CCoinsViewCache::MarkDirty(CCoinsMap::iterator it) {
+    if (fTrackDirty && !(it->second.flags & CCoinsCacheEntry::DIRTY))
+        dirtyQueue.push_back(it->first);
+    it->second.flags |= CCoinsCacheEntry::DIRTY;
 }
 
 CCoinsMap::iterator CCoinsViewCache::FetchCoin(const COutPoint &outpoint) const {
     CCoinsMap::iterator it = cacheCoins.find(outpoint);
+    if (fCountMetrics)
+        MetricAdd(it != cacheCoins.end() ? Metric::COINS_CACHE_HITS : Metric::COINS_CACHE_MISSES);
     if (it != cacheCoins.end())
         return it;
     Coin tmp;
@@ -80,7 +92,8 @@ void CCoinsViewCache::AddCoin(const COutPoint &outpoint, Coin&& coin, bool possi
         fresh = !(it->second.flags & CCoinsCacheEntry::DIRTY);
     }
     it->second.coin = std::move(coin);
-    it->second.flags |= CCoinsCacheEntry::DIRTY | (fresh ? CCoinsCacheEntry::FRESH : 0);
+    MarkDirty(it);
+    it->second.flags |= (fresh ? CCoinsCacheEntry::FRESH : 0);
     cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
 }
 
@@ -105,7 +118,7 @@ bool CCoinsViewCache::SpendCoin(const COutPoint &outpoint, Coin* moveout) {
     if (it->second.flags & CCoinsCacheEntry::FRESH) {
         cacheCoins.erase(it);
     } else {
-        it->second.flags |= CCoinsCacheEntry::DIRTY;
+        MarkDirty(it);
         it->second.coin.Clear();
     }
     return true;
@@ -132,6 +145,13 @@ bool CCoinsViewCache::HaveCoinInCache(const COutPoint &outpoint) const {
     return (it != cacheCoins.end() && !it->second.coin.IsSpent());
 }
 
+void CCoinsViewCache::AddPrefetchedCoin(const COutPoint &outpoint, Coin&& coin) {
+    assert(!coin.IsSpent());
+    std::pair<CCoinsMap::iterator, bool> ret = cacheCoins.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::forward_as_tuple(std::move(coin)));
+    if (ret.second)
+        cachedCoinsUsage += ret.first->second.coin.DynamicMemoryUsage();
+}
+
 uint256 CCoinsViewCache::GetBestBlock() const {
     if (hashBlock.IsNull())
         hashBlock = base->GetBestBlock();
@@ -155,10 +175,11 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
             if (!(it->second.flags & CCoinsCacheEntry::FRESH && it->second.coin.IsSpent())) {
                 // Otherwise we will need to create it in the parent
                 // and move the data up and mark it as dirty
-                CCoinsCacheEntry& entry = cacheCoins[it->first];
+                CCoinsMap::iterator itNew = cacheCoins.emplace(std::piecewise_construct, std::forward_as_tuple(it->first), std::tuple<>()).first;
+                CCoinsCacheEntry& entry = itNew->second;
                 entry.coin = std::move(it->second.coin);
                 cachedCoinsUsage += entry.coin.DynamicMemoryUsage();
-                entry.flags = CCoinsCacheEntry::DIRTY;
+                MarkDirty(itNew);
                 // We can mark it FRESH in the parent if it was FRESH in the child
                 // Otherwise it might have just been flushed from the parent's cache
                 // and already exist in the grandparent
@@ -187,7 +208,7 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
                 cachedCoinsUsage -= itUs->second.coin.DynamicMemoryUsage();
                 itUs->second.coin = std::move(it->second.coin);
                 cachedCoinsUsage += itUs->second.coin.DynamicMemoryUsage();
-                itUs->second.flags |= CCoinsCacheEntry::DIRTY;
+                MarkDirty(itUs);
                 // NOTE: It is possible the child has a FRESH flag here in
                 // the event the entry we found in the parent is pruned. But
                 // we must not copy that FRESH flag to the parent as that
@@ -203,10 +224,104 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
 bool CCoinsViewCache::Flush() {
     bool fOk = base->BatchWrite(cacheCoins, hashBlock);
     cacheCoins.clear();
+    dirtyQueue.clear();
     cachedCoinsUsage = 0;
+    ReallocateCache();
     return fOk;
 }
 
+void CCoinsViewCache::ReallocateCache() {
+    assert(cacheCoins.empty());
+    cacheCoins.~CCoinsMap();
+    cacheCoinsMemoryResource.~CCoinsMapMemoryResource();
+    ::new (&cacheCoinsMemoryResource) CCoinsMapMemoryResource();
+    ::new (&cacheCoins) CCoinsMap(0, SaltedOutpointHasher(), std::equal_to<COutPoint>(), &cacheCoinsMemoryResource);
+}
+
+void CCoinsViewCache::SetTrackDirty(bool fTrack) {
+    fTrackDirty = fTrack;
+    dirtyQueue.clear();
+    if (fTrackDirty) {
+        for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end(); it++) {
+            if (it->second.flags & CCoinsCacheEntry::DIRTY)
+                dirtyQueue.push_back(it->first);
+        }
+    }
+}
+
+/** Mark the entries written to the base as unmodified, spent ones are no longer needed */
+static void MarkWritten(CCoinsMap &cacheCoins, size_t &cachedCoinsUsage, const std::vector<COutPoint> &vWritten) {
+    for (const COutPoint &outpoint : vWritten) {
+        CCoinsMap::iterator it = cacheCoins.find(outpoint);
+        if (it == cacheCoins.end())
+            continue;
+        if (it->second.coin.IsSpent()) {
+            cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
+            cacheCoins.erase(it);
+        } else {
+            it->second.flags = 0;
+        }
+    }
+}
+
+bool CCoinsViewCache::WriteOldest(size_t nMaxBytes) {
+    assert(fTrackDirty);
+    CCoinsMapMemoryResource resource;
+    CCoinsMap mapWrite(0, SaltedOutpointHasher(), std::equal_to<COutPoint>(), &resource);
+    std::vector<COutPoint> vWritten;
+    size_t nBytes = 0;
+    while (!dirtyQueue.empty() && nBytes < nMaxBytes) {
+        CCoinsMap::const_iterator it = cacheCoins.find(dirtyQueue.front());
+        dirtyQueue.pop_front();
+        if (it == cacheCoins.end() || !(it->second.flags & CCoinsCacheEntry::DIRTY))
+            continue;
+        mapWrite.emplace(it->first, it->second);
+        vWritten.push_back(it->first);
+        nBytes += sizeof(COutPoint) + sizeof(Coin) + it->second.coin.DynamicMemoryUsage();
+    }
+    if (vWritten.empty())
+        return true;
+
+    if (!base->BatchWritePartial(mapWrite, hashBlock))
+        return false;
+    MarkWritten(cacheCoins, cachedCoinsUsage, vWritten);
+    return true;
+}
+
+bool CCoinsViewCache::Sync(size_t nBatchBytes) {
+    while (fTrackDirty && !dirtyQueue.empty()) {
+        if (!WriteOldest(nBatchBytes))
+            return false;
+    }
+
+    // Without tracking, or for entries the base could not take partially
+    CCoinsMapMemoryResource resource;
+    CCoinsMap mapWrite(0, SaltedOutpointHasher(), std::equal_to<COutPoint>(), &resource);
+    std::vector<COutPoint> vWritten;
+    for (CCoinsMap::const_iterator it = cacheCoins.begin(); it != cacheCoins.end(); it++) {
+        if (it->second.flags & CCoinsCacheEntry::DIRTY) {
+            mapWrite.emplace(it->first, it->second);
+            vWritten.push_back(it->first);
+        }
+    }
+    if (!base->BatchWrite(mapWrite, hashBlock))
+        return false;
+    MarkWritten(cacheCoins, cachedCoinsUsage, vWritten);
+    return true;
+}
+
+void CCoinsViewCache::Trim(size_t nTargetUsage) {
+    CCoinsMap::iterator it = cacheCoins.begin();
+    while (it != cacheCoins.end() && DynamicMemoryUsage() > nTargetUsage) {
+        if (it->second.flags == 0) {
+            cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
+            it = cacheCoins.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
 void CCoinsViewCache::Uncache(const COutPoint& hash)
 {
     CCoinsMap::iterator it = cacheCoins.find(hash);
@@ -12,6 +12,7 @@
 #include <hash.h>
 #include <memusage.h>
 #include <serialize.h>
+#include <support/allocators/pool.h>
 #include <uint256.h>
 
 #include <assert.h>
@@ -20,6 +21,7 @@
 #include <addressindex.h>
 
 
+#include <deque>
 #include <unordered_map>
 
 /**
@@ -122,7 +124,15 @@ struct CCoinsCacheEntry
     explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+/**
+ * The entries of a CCoinsMap are allocated from a pool, which saves the malloc overhead of every
+ * node and lets the same -dbcache hold more coins. The blocks are large enough for the map node
+ * around the entry on the supported standard libraries; larger nodes fall back to operator new.
+ */
+typedef PoolAllocator<std::pair<const COutPoint, CCoinsCacheEntry>,
+                      sizeof(std::pair<const COutPoint, CCoinsCacheEntry>) + sizeof(void*) * 4> CCoinsMapAllocator;
+typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher, std::equal_to<COutPoint>, CCoinsMapAllocator> CCoinsMap;
+typedef CCoinsMapAllocator::ResourceType CCoinsMapMemoryResource;
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -170,6 +180,11 @@ public:
     //! The passed mapCoins can be modified.
     virtual bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
 
+    //! Write some of the Coin changes of the state at hashBlock without moving the best block.
+    //! The view reports hashBlock as a head block until a BatchWrite completes the transition.
+    //! Returns false if the view does not support it.
+    virtual bool BatchWritePartial(CCoinsMap &mapCoins, const uint256 &hashBlock);
+
     //! Get a cursor to iterate over the whole state
     virtual CCoinsViewCursor *Cursor() const;
 
@@ -195,6 +210,7 @@ public:
     std::vector<uint256> GetHeadBlocks() const override;
     void SetBackend(CCoinsView &viewIn);
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    bool BatchWritePartial(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
     size_t EstimateSize() const override;
 };
@@ -209,18 +225,30 @@ protected:
      * declared as "const".
      */
     mutable uint256 hashBlock;
+    mutable CCoinsMapMemoryResource cacheCoinsMemoryResource;
     mutable CCoinsMap cacheCoins;
 
     /* Cached dynamic memory usage for the inner Coin objects. */
     mutable size_t cachedCoinsUsage;
 
+    /* Whether dirtyQueue is maintained, see SetTrackDirty. */
+    bool fTrackDirty;
+
+    /* Whether cache hits and misses are counted in the metrics.h counters, see SetCountMetrics. */
+    bool fCountMetrics;
+
+    /* Outpoints in the order their entries became dirty. Entries that were erased or written
+     * since are skipped when they reach the front. */
+    std::deque<COutPoint> dirtyQueue;
+
+    void MarkDirty(CCoinsMap::iterator it);
+
+    /* Recreate the empty map and its memory resource, returning the pooled memory to the system. */
+    void ReallocateCache();
+
 public:
     CCoinsViewCache(CCoinsView *baseIn);
 
-    mutable std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-    mutable std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
-    mutable std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
-
     /**
      * By deleting the copy constructor, we prevent accidentally using it when one intends to create a cache on top of a base cache.
      */
@@ -232,6 +260,7 @@ public:
     uint256 GetBestBlock() const override;
     void SetBestBlock(const uint256 &hashBlock);
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    bool BatchWritePartial(CCoinsMap &mapCoins, const uint256 &hashBlock) override { return false; }
     CCoinsViewCursor* Cursor() const override {
         throw std::logic_error("CCoinsViewCache cursor iteration not supported.");
     }
@@ -243,6 +272,12 @@ public:
      */
     bool HaveCoinInCache(const COutPoint &outpoint) const;
 
+    /**
+     * Add an unspent coin that was read from the backing view outside of this cache, as if
+     * AccessCoin had fetched it. Ignored if the outpoint is already cached.
+     */
+    void AddPrefetchedCoin(const COutPoint &outpoint, Coin&& coin);
+
     /**
      * Return a reference to Coin in the cache, or a pruned one if not found. This is
      * more efficient than GetCoin.
@@ -275,6 +310,34 @@ public:
      */
     bool Flush();
 
+    /**
+     * Keep the order in which entries are modified, so they can be written incrementally with
+     * WriteOldest instead of all at once by Flush.
+     */
+    void SetTrackDirty(bool fTrack);
+
+    //! Count the lookups answered from this cache and those passed to the backing view, for the coins tip
+    void SetCountMetrics(bool fCount) { fCountMetrics = fCount; }
+
+    /**
+     * Write the entries that have been modified the longest, about nMaxBytes of them, to the base
+     * with BatchWritePartial. The written coins stay cached as unmodified entries. Requires
+     * SetTrackDirty. If false is returned, the state of the backing view is undefined.
+     */
+    bool WriteOldest(size_t nMaxBytes);
+
+    /**
+     * Like Flush, but keeps the coins cached as unmodified entries. Writes in parts of about
+     * nBatchBytes when SetTrackDirty is on.
+     */
+    bool Sync(size_t nBatchBytes);
+
+    /** Drop unmodified entries until the memory usage is at most nTargetUsage. */
+    void Trim(size_t nTargetUsage);
+
+    //! Whether any entry may be modified since the last write to the base
+    bool HasDirtyCoins() const { return !dirtyQueue.empty(); }
+
     /**
      * Removes the UTXO with the given outpoint from the cache, if it is
      * not modified.
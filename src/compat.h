@@ -45,9 +45,15 @@
 #include <ifaddrs.h>
 #include <limits.h>
 #include <netdb.h>
+#include <poll.h>
 #include <unistd.h>
 #endif
 
+#ifndef WIN32
+// Single sockets are waited on with poll(), which has no FD_SETSIZE limit
+#define USE_POLL
+#endif
+
 #ifndef WIN32
 typedef unsigned int SOCKET;
 #include <errno.h>
@@ -157,7 +157,7 @@ int64_t GetTransactionSigOpCost(const CTransaction& tx, const CCoinsViewCache& i
     return nSigOps;
 }
 
-bool CheckTransaction(const CTransaction& tx, CValidationState& state, uint256 hashTx, bool isVerifyDB, bool fCheckDuplicateInputs, int nHeight, bool isCheckWallet, CZerocoinTxInfo *zerocoinTxInfo)
+bool CheckTransactionStructure(const CTransaction& tx, CValidationState& state, bool fCheckDuplicateInputs)
 {
     // Basic checks that don't depend on any context
     if (tx.vin.empty())
@@ -165,7 +165,7 @@ bool CheckTransaction(const CTransaction& tx, CValidationState& state, uint256 h
     if (tx.vout.empty())
         return state.DoS(10, false, REJECT_INVALID, "bad-txns-vout-empty");
     // Size limits (this doesn't take the witness into account, as that hasn't been checked for malleability)
-    if (::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS) * WITNESS_SCALE_FACTOR > MAX_BLOCK_WEIGHT)
+    if (tx.GetBaseSize() * WITNESS_SCALE_FACTOR > MAX_BLOCK_WEIGHT)
         return state.DoS(100, false, REJECT_INVALID, "bad-txns-oversize");
 
     // Check for negative or overflow output values
@@ -193,24 +193,42 @@ bool CheckTransaction(const CTransaction& tx, CValidationState& state, uint256 h
 
     if (tx.IsCoinBase())
     {
-        bool fTestNet = (Params().NetworkIDString() == CBaseChainParams::TESTNET);
         if (tx.vin[0].scriptSig.size() < 2 || tx.vin[0].scriptSig.size() > 100)
             return state.DoS(100, false, REJECT_INVALID, "bad-cb-length");
-        if (!CheckDevFundInputs(tx, state, nHeight, fTestNet))
-            return false;
     }
     else
     {
         for (const auto& txin : tx.vin)
             if (txin.prevout.IsNull() && !txin.scriptSig.IsZerocoinSpend())
                 return state.DoS(10, false, REJECT_INVALID, "bad-txns-prevout-null");
-        if (!CheckZerocoinTransaction(tx, state, hashTx, isVerifyDB, nHeight, isCheckWallet, zerocoinTxInfo))
-                    return false;
     }
 
     return true;
 }
 
+bool CheckTransactionZerocoin(const CTransaction& tx, CValidationState& state, uint256 hashTx, bool isVerifyDB, int nHeight, bool isCheckWallet, CZerocoinTxInfo *zerocoinTxInfo, std::vector<CZerocoinSpendCheck> *pvZerocoinChecks)
+{
+    if (tx.IsCoinBase())
+    {
+        bool fTestNet = (Params().NetworkIDString() == CBaseChainParams::TESTNET);
+        if (!CheckDevFundInputs(tx, state, nHeight, fTestNet))
+            return false;
+    }
+    else
+    {
+        if (!CheckZerocoinTransaction(tx, state, hashTx, isVerifyDB, nHeight, isCheckWallet, zerocoinTxInfo, pvZerocoinChecks))
+            return false;
+    }
+
+    return true;
+}
+
+bool CheckTransaction(const CTransaction& tx, CValidationState& state, uint256 hashTx, bool isVerifyDB, bool fCheckDuplicateInputs, int nHeight, bool isCheckWallet, CZerocoinTxInfo *zerocoinTxInfo, std::vector<CZerocoinSpendCheck> *pvZerocoinChecks)
+{
+    return CheckTransactionStructure(tx, state, fCheckDuplicateInputs) &&
+           CheckTransactionZerocoin(tx, state, hashTx, isVerifyDB, nHeight, isCheckWallet, zerocoinTxInfo, pvZerocoinChecks);
+}
+
 bool Consensus::CheckTxInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& inputs, int nSpendHeight, CAmount& txfee)
 {
     // are the actual inputs available?
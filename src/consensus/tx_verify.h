@@ -18,8 +18,14 @@ class CValidationState;
 
 /** Transaction validation functions */
 
-/** Context-independent validity checks */
-bool CheckTransaction(const CTransaction& tx, CValidationState& state, uint256 hashTx, bool isVerifyDB, bool fCheckDuplicateInputs=true, int nHeight = INT_MAX, bool isCheckWallet = false, CZerocoinTxInfo *zerocoinTxInfo = NULL);
+/** Context-independent checks of the structure of a transaction, which only look at the transaction itself */
+bool CheckTransactionStructure(const CTransaction& tx, CValidationState& state, bool fCheckDuplicateInputs=true);
+
+/** The development fund outputs of a coinbase and the zerocoin mints and spends of any other transaction. If pvZerocoinChecks is not NULL, zerocoin spend proofs are pushed onto it instead of being verified */
+bool CheckTransactionZerocoin(const CTransaction& tx, CValidationState& state, uint256 hashTx, bool isVerifyDB, int nHeight = INT_MAX, bool isCheckWallet = false, CZerocoinTxInfo *zerocoinTxInfo = NULL, std::vector<CZerocoinSpendCheck> *pvZerocoinChecks = NULL);
+
+/** Context-independent validity checks, CheckTransactionStructure followed by CheckTransactionZerocoin. If pvZerocoinChecks is not NULL, zerocoin spend proofs are pushed onto it instead of being verified */
+bool CheckTransaction(const CTransaction& tx, CValidationState& state, uint256 hashTx, bool isVerifyDB, bool fCheckDuplicateInputs=true, int nHeight = INT_MAX, bool isCheckWallet = false, CZerocoinTxInfo *zerocoinTxInfo = NULL, std::vector<CZerocoinSpendCheck> *pvZerocoinChecks = NULL);
 
 namespace Consensus {
 /**
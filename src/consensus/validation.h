@@ -101,13 +101,18 @@ public:
 // using only serialization with and without witness data. As witness_size
 // is equal to total_size - stripped_size, this formula is identical to:
 // weight = (stripped_size * 3) + total_size.
+// The transactions keep both sizes.
 static inline int64_t GetTransactionWeight(const CTransaction& tx)
 {
-    return ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS) * (WITNESS_SCALE_FACTOR - 1) + ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+    return (int64_t)tx.GetBaseSize() * (WITNESS_SCALE_FACTOR - 1) + tx.GetTotalSize();
 }
 static inline int64_t GetBlockWeight(const CBlock& block)
 {
-    return ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS) * (WITNESS_SCALE_FACTOR - 1) + ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION);
+    // The header and the transaction count are the same size with and without witness data
+    int64_t nWeight = (::GetSerializeSize(static_cast<const CBlockHeader&>(block), SER_NETWORK, PROTOCOL_VERSION) + GetSizeOfCompactSize(block.vtx.size())) * WITNESS_SCALE_FACTOR;
+    for (const auto& tx : block.vtx)
+        nWeight += GetTransactionWeight(*tx);
+    return nWeight;
 }
 
 #endif // BITCOIN_CONSENSUS_VALIDATION_H
@@ -0,0 +1,249 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include <config/nix-config.h>
+#endif
+
+#include <cpuprofiler.h>
+
+#include <tinyformat.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#if defined(HAVE_EXECINFO_H) && defined(HAVE_SYS_PRCTL_H)
+#include <cxxabi.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/time.h>
+#define HAVE_CPU_PROFILER 1
+#endif
+
+#ifdef HAVE_CPU_PROFILER
+
+namespace {
+
+/** One stack, written by the signal handler and read under a sequence number */
+struct ProfileSample {
+    std::atomic<uint32_t> nSeq{0}; //!< odd while the handler writes the sample, 0 before the first one
+    uint64_t nIndex;
+    int nDepth;
+    char threadName[16];
+    void* frames[CPU_PROFILE_MAX_DEPTH];
+};
+
+// The handler before ProfileSignalHandler() itself and the signal return trampoline
+const int SIGNAL_FRAMES = 2;
+
+std::mutex cs_profiler;
+int nProfileFrequency = 0;
+// Allocated on the first start and never freed, the handler may still run after a stop
+ProfileSample* profileSamples = nullptr;
+std::atomic<uint64_t> nNextSample{0};
+uint64_t nFirstSample = 0; //!< Index of the first sample since the last reset, guarded by cs_profiler
+
+void ProfileSignalHandler(int)
+{
+    int nSavedErrno = errno;
+    uint64_t nIndex = nNextSample.fetch_add(1, std::memory_order_relaxed);
+    ProfileSample& sample = profileSamples[nIndex % CPU_PROFILE_SAMPLES];
+    uint32_t nSeq = sample.nSeq.load(std::memory_order_relaxed);
+    // Another thread is still writing this slot a whole buffer ago: drop the sample
+    if ((nSeq & 1) == 0 && sample.nSeq.compare_exchange_strong(nSeq, nSeq + 1, std::memory_order_acquire)) {
+        sample.nIndex = nIndex;
+        void* frames[CPU_PROFILE_MAX_DEPTH + SIGNAL_FRAMES];
+        int nDepth = backtrace(frames, CPU_PROFILE_MAX_DEPTH + SIGNAL_FRAMES) - SIGNAL_FRAMES;
+        sample.nDepth = nDepth > 0 ? nDepth : 0;
+        memcpy(sample.frames, frames + SIGNAL_FRAMES, sample.nDepth * sizeof(void*));
+        if (prctl(PR_GET_NAME, sample.threadName, 0, 0, 0) != 0)
+            strcpy(sample.threadName, "unknown");
+        sample.nSeq.store(nSeq + 2, std::memory_order_release);
+    }
+    errno = nSavedErrno;
+}
+
+bool SetProfileTimer(int nFrequency)
+{
+    struct itimerval timer;
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_usec = nFrequency > 0 ? 1000000 / nFrequency : 0;
+    timer.it_value = timer.it_interval;
+    return setitimer(ITIMER_PROF, &timer, nullptr) == 0;
+}
+
+/** "module(symbol+offset) [address]" of backtrace_symbols() as the demangled symbol, or module+offset */
+std::string FrameName(const char* symbol)
+{
+    std::string str(symbol);
+    size_t nOpen = str.find('(');
+    size_t nPlus = str.find('+', nOpen);
+    size_t nClose = str.find(')', nOpen);
+    if (nOpen == std::string::npos || nClose == std::string::npos)
+        return str.substr(0, str.find(' '));
+
+    std::string strModule = str.substr(0, nOpen);
+    strModule = strModule.substr(strModule.rfind('/') + 1);
+    if (nPlus == std::string::npos || nPlus > nClose)
+        return strModule;
+    if (nPlus == nOpen + 1)
+        return strModule + str.substr(nPlus, nClose - nPlus);
+
+    std::string strMangled = str.substr(nOpen + 1, nPlus - nOpen - 1);
+    int nStatus = 0;
+    char* demangled = abi::__cxa_demangle(strMangled.c_str(), nullptr, nullptr, &nStatus);
+    if (nStatus == 0 && demangled) {
+        strMangled = demangled;
+    }
+    free(demangled);
+    return strMangled;
+}
+
+} // namespace
+
+bool CpuProfilerSupported()
+{
+    return true;
+}
+
+bool StartCpuProfiler(int nFrequency)
+{
+    if (nFrequency <= 0 || nFrequency > MAX_CPU_PROFILE_FREQUENCY)
+        return false;
+
+    std::lock_guard<std::mutex> lock(cs_profiler);
+    if (!profileSamples)
+        profileSamples = new ProfileSample[CPU_PROFILE_SAMPLES];
+    // The first backtrace() loads the unwinder, which is not safe in a signal handler
+    void* frame;
+    backtrace(&frame, 1);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = ProfileSignalHandler;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGPROF, &sa, nullptr) != 0)
+        return false;
+    if (!SetProfileTimer(nFrequency))
+        return false;
+    nProfileFrequency = nFrequency;
+    return true;
+}
+
+void StopCpuProfiler()
+{
+    std::lock_guard<std::mutex> lock(cs_profiler);
+    if (nProfileFrequency == 0)
+        return;
+    SetProfileTimer(0);
+    // Not the default action, a signal still pending would terminate the process
+    signal(SIGPROF, SIG_IGN);
+    nProfileFrequency = 0;
+}
+
+int GetCpuProfilerFrequency()
+{
+    std::lock_guard<std::mutex> lock(cs_profiler);
+    return nProfileFrequency;
+}
+
+std::string DumpCpuProfile(bool fReset, CpuProfileSummary& summary)
+{
+    std::lock_guard<std::mutex> lock(cs_profiler);
+    uint64_t nEnd = nNextSample.load(std::memory_order_relaxed);
+    summary.nSamples = nEnd - nFirstSample;
+    summary.nDropped = summary.nSamples;
+    if (!profileSamples) {
+        return "";
+    }
+
+    // Copy the samples out first, each one only if the handler did not touch it meanwhile
+    std::vector<std::pair<std::string, std::vector<void*> > > vStacks;
+    for (int i = 0; i < CPU_PROFILE_SAMPLES; i++) {
+        ProfileSample& sample = profileSamples[i];
+        uint32_t nSeq = sample.nSeq.load(std::memory_order_acquire);
+        if (nSeq == 0 || (nSeq & 1))
+            continue;
+        uint64_t nIndex = sample.nIndex;
+        int nDepth = sample.nDepth;
+        char threadName[16];
+        memcpy(threadName, sample.threadName, sizeof(threadName));
+        threadName[sizeof(threadName) - 1] = 0;
+        std::vector<void*> frames(sample.frames, sample.frames + nDepth);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sample.nSeq.load(std::memory_order_relaxed) != nSeq || nIndex < nFirstSample || nIndex >= nEnd)
+            continue;
+        vStacks.emplace_back(threadName, std::move(frames));
+    }
+    summary.nDropped -= vStacks.size();
+    if (fReset)
+        nFirstSample = nEnd;
+
+    // Symbolize every distinct address once
+    std::unordered_map<void*, std::string> mapNames;
+    std::vector<void*> vAddresses;
+    for (const auto& stack : vStacks) {
+        for (void* pc : stack.second) {
+            if (mapNames.emplace(pc, std::string()).second)
+                vAddresses.push_back(pc);
+        }
+    }
+    if (!vAddresses.empty()) {
+        char** symbols = backtrace_symbols(vAddresses.data(), vAddresses.size());
+        for (size_t i = 0; i < vAddresses.size(); i++)
+            mapNames[vAddresses[i]] = symbols ? FrameName(symbols[i]) : strprintf("%p", vAddresses[i]);
+        free(symbols);
+    }
+
+    std::map<std::string, uint64_t> mapCounts;
+    for (const auto& stack : vStacks) {
+        std::string strStack = stack.first;
+        for (auto it = stack.second.rbegin(); it != stack.second.rend(); ++it)
+            strStack += ";" + mapNames[*it];
+        mapCounts[strStack]++;
+    }
+
+    std::string ret;
+    for (const auto& count : mapCounts)
+        ret += strprintf("%s %u\n", count.first, count.second);
+    return ret;
+}
+
+#else
+
+bool CpuProfilerSupported()
+{
+    return false;
+}
+
+bool StartCpuProfiler(int nFrequency)
+{
+    return false;
+}
+
+void StopCpuProfiler()
+{
+}
+
+int GetCpuProfilerFrequency()
+{
+    return 0;
+}
+
+std::string DumpCpuProfile(bool fReset, CpuProfileSummary& summary)
+{
+    summary.nSamples = 0;
+    summary.nDropped = 0;
+    return "";
+}
+
+#endif // HAVE_CPU_PROFILER
@@ -0,0 +1,44 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CPUPROFILER_H
+#define BITCOIN_CPUPROFILER_H
+
+#include <stdint.h>
+#include <string>
+
+/** Default for -cpuprofile, samples per second of CPU time, 0 to not sample */
+static const int DEFAULT_CPU_PROFILE_FREQUENCY = 0;
+static const int MAX_CPU_PROFILE_FREQUENCY = 1000;
+/** Number of samples kept, older ones are overwritten */
+static const int CPU_PROFILE_SAMPLES = 16384;
+/** Frames kept of each stack, the innermost ones */
+static const int CPU_PROFILE_MAX_DEPTH = 48;
+
+/** Whether this platform can sample stacks (glibc on Linux) */
+bool CpuProfilerSupported();
+
+/**
+ * Sample the stack of the thread using the CPU nFrequency times per second of CPU time used by
+ * the process, from a SIGPROF handler, into a ring buffer of the last CPU_PROFILE_SAMPLES samples.
+ */
+bool StartCpuProfiler(int nFrequency);
+/** Stop sampling. The samples taken stay available to DumpCpuProfile(). */
+void StopCpuProfiler();
+/** The sampling frequency, 0 when not sampling */
+int GetCpuProfilerFrequency();
+
+struct CpuProfileSummary {
+    uint64_t nSamples;  //!< Samples taken since the last reset
+    uint64_t nDropped;  //!< Of those, the ones overwritten or torn before they were read
+};
+
+/**
+ * The samples since startup or the last reset in the collapsed stack format of FlameGraph
+ * (thread;outermost;...;innermost count), one line per distinct stack, optionally
+ * resetting them. Frames without a symbol are printed as module+offset, for addr2line.
+ */
+std::string DumpCpuProfile(bool fReset, CpuProfileSummary& summary);
+
+#endif // BITCOIN_CPUPROFILER_H
@@ -63,16 +63,22 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
     const int64_t ROW_LEN_INT64 = BLOCK_LEN_INT64 * nCols;
     const int64_t ROW_LEN_BYTES = ROW_LEN_INT64 * 8;
 
+    //Small matrices, such as the ones of Lyra2RE and Lyra2REv2, live on the stack
+    uint64_t stackMatrix[LYRA2_STACK_MATRIX_INT64];
+    uint64_t *stackRows[LYRA2_STACK_MATRIX_ROWS];
+    int fHeap = nRows > LYRA2_STACK_MATRIX_ROWS || nRows * ROW_LEN_INT64 > LYRA2_STACK_MATRIX_INT64;
+
     i = (int64_t) ((int64_t) nRows * (int64_t) ROW_LEN_BYTES);
-    uint64_t *wholeMatrix = malloc(i);
+    uint64_t *wholeMatrix = fHeap ? malloc(i) : stackMatrix;
     if (wholeMatrix == NULL) {
       return -1;
     }
 	memset(wholeMatrix, 0, i);
 
     //Allocates pointers to each row of the matrix
-    uint64_t **memMatrix = malloc(nRows * sizeof (uint64_t*));
+    uint64_t **memMatrix = fHeap ? malloc(nRows * sizeof (uint64_t*)) : stackRows;
     if (memMatrix == NULL) {
+      free(wholeMatrix);
       return -1;
     }
     //Places the pointers in the correct positions
@@ -123,10 +129,7 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
 
     //======================= Initializing the Sponge State ====================//
     //Sponge state: 16 uint64_t, BLOCK_LEN_INT64 words of them for the bitrate (b) and the remainder for the capacity (c)
-    uint64_t *state = malloc(16 * sizeof (uint64_t));
-    if (state == NULL) {
-      return -1;
-    }
+    uint64_t state[16];
     initState(state);
     //==========================================================================/
 
@@ -201,12 +204,13 @@ int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *
     //==========================================================================/
 
     //========================= Freeing the memory =============================//
-    free(memMatrix);
-    free(wholeMatrix);
+    if (fHeap) {
+      free(memMatrix);
+      free(wholeMatrix);
+    }
 
-    //Wiping out the sponge's internal state before freeing it
+    //Wiping out the sponge's internal state
     memset(state, 0, 16 * sizeof (uint64_t));
-    free(state);
     //==========================================================================/
 
     return 0;
@@ -232,16 +236,22 @@ int LYRA2_old(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const vo
     const int64_t ROW_LEN_INT64 = BLOCK_LEN_INT64 * nCols;
     const int64_t ROW_LEN_BYTES = ROW_LEN_INT64 * 8;
 
+    //Small matrices, such as the ones of Lyra2RE and Lyra2REv2, live on the stack
+    uint64_t stackMatrix[LYRA2_STACK_MATRIX_INT64];
+    uint64_t *stackRows[LYRA2_STACK_MATRIX_ROWS];
+    int fHeap = nRows > LYRA2_STACK_MATRIX_ROWS || nRows * ROW_LEN_INT64 > LYRA2_STACK_MATRIX_INT64;
+
     i = (int64_t) ((int64_t) nRows * (int64_t) ROW_LEN_BYTES);
-    uint64_t *wholeMatrix = malloc(i);
+    uint64_t *wholeMatrix = fHeap ? malloc(i) : stackMatrix;
     if (wholeMatrix == NULL) {
       return -1;
     }
 	memset(wholeMatrix, 0, i);
 
     //Allocates pointers to each row of the matrix
-    uint64_t **memMatrix = malloc(nRows * sizeof (uint64_t*));
+    uint64_t **memMatrix = fHeap ? malloc(nRows * sizeof (uint64_t*)) : stackRows;
     if (memMatrix == NULL) {
+      free(wholeMatrix);
       return -1;
     }
     //Places the pointers in the correct positions
@@ -292,10 +302,7 @@ int LYRA2_old(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const vo
 
     //======================= Initializing the Sponge State ====================//
     //Sponge state: 16 uint64_t, BLOCK_LEN_INT64 words of them for the bitrate (b) and the remainder for the capacity (c)
-    uint64_t *state = malloc(16 * sizeof (uint64_t));
-    if (state == NULL) {
-      return -1;
-    }
+    uint64_t state[16];
     initState(state);
     //==========================================================================/
 
@@ -370,12 +377,13 @@ int LYRA2_old(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const vo
     //==========================================================================/
 
     //========================= Freeing the memory =============================//
-    free(memMatrix);
-    free(wholeMatrix);
+    if (fHeap) {
+      free(memMatrix);
+      free(wholeMatrix);
+    }
 
-    //Wiping out the sponge's internal state before freeing it
+    //Wiping out the sponge's internal state
     memset(state, 0, 16 * sizeof (uint64_t));
-    free(state);
     //==========================================================================/
 
     return 0;
@@ -37,6 +37,10 @@ typedef unsigned char byte;
         #define BLOCK_LEN_BYTES (BLOCK_LEN_INT64 * 8)    //Block length, in bytes
 #endif
 
+//Memory matrices up to this size are kept on the stack instead of the heap
+#define LYRA2_STACK_MATRIX_INT64 1024                            //8 KiB, enough for 8 rows of 8 columns
+#define LYRA2_STACK_MATRIX_ROWS 64
+
 int LYRA2(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols);
 
 int LYRA2_old(void *K, uint64_t kLen, const void *pwd, uint64_t pwdlen, const void *salt, uint64_t saltlen, uint64_t timeCost, uint64_t nRows, uint64_t nCols);
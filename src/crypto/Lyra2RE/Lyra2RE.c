@@ -39,6 +39,7 @@
 #include "sph_keccak.h"
 #include "sph_skein.h"
 #include "Lyra2.h"
+#include "Sponge.h"
 
 void lyra2re_hash(const char* input, char* output)
 {
@@ -108,3 +109,22 @@ void lyra2re2_hash(const char* input, char* output)
     
    	memcpy(output, hashA, 32);
 }
+
+const char *lyra2re_autodetect(void)
+{
+    static char name[64];
+    const char *sponge = spongeAutoDetect();
+    const char *cubehash = sph_cubehash_autodetect();
+
+    if (strcmp(sponge, cubehash) == 0)
+        return sponge;
+    snprintf(name, sizeof(name), "%s sponge, %s cubehash", sponge, cubehash);
+    return name;
+}
+
+int lyra2re_select(const char *name)
+{
+    const char *sponge = strcmp(name, "sse2") == 0 ? "standard" : name;
+
+    return spongeSelect(sponge) && sph_cubehash_select(name);
+}
@@ -8,6 +8,15 @@ extern "C" {
 void lyra2re_hash(const char* input, char* output);
 void lyra2re2_hash(const char* input, char* output);
 
+/* Select the fastest Blake2b sponge and CubeHash code supported by the CPU.
+ * Must be called before any thread starts hashing. */
+const char *lyra2re_autodetect(void);
+
+/* Select the named code ("standard", "sse2" or "avx2") instead, for tests.
+ * "sse2" only covers CubeHash, the sponge then runs the standard code.
+ * Returns 0 if the build or the CPU lacks it. */
+int lyra2re_select(const char *name);
+
 #ifdef __cplusplus
 }
 #endif
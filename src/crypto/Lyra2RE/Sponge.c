@@ -56,7 +56,7 @@ inline void initState(uint64_t state[/*16*/]) {
  *
  * @param v     A 1024-bit (16 uint64_t) array to be processed by Blake2b's G function
  */
-inline static void blake2bLyra(uint64_t *v) {
+static void blake2bLyraGeneric(uint64_t *v) {
     ROUND_LYRA(0);
     ROUND_LYRA(1);
     ROUND_LYRA(2);
@@ -75,10 +75,117 @@ inline static void blake2bLyra(uint64_t *v) {
  * Executes a reduced version of Blake2b's G function with only one round
  * @param v     A 1024-bit (16 uint64_t) array to be processed by Blake2b's G function
  */
-inline static void reducedBlake2bLyra(uint64_t *v) {
+static void reducedBlake2bLyraGeneric(uint64_t *v) {
     ROUND_LYRA(0);
 }
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__amd64__))
+#define LYRA2_SPONGE_X86 1
+
+#include <immintrin.h>
+
+/*
+ * AVX2 version of the rounds: each row of the 4x4 state (v[0..3], v[4..7],
+ * v[8..11], v[12..15]) is one register, so the four column G functions run
+ * at once. Rotating rows b, c and d by one, two and three words lines the
+ * diagonals up as columns for the second half of the round.
+ */
+#define G_AVX2(a, b, c, d) \
+  do { \
+    a = _mm256_add_epi64(a, b); \
+    d = _mm256_shuffle_epi32(_mm256_xor_si256(d, a), _MM_SHUFFLE(2,3,0,1)); \
+    c = _mm256_add_epi64(c, d); \
+    b = _mm256_shuffle_epi8(_mm256_xor_si256(b, c), rotr24); \
+    a = _mm256_add_epi64(a, b); \
+    d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), rotr16); \
+    c = _mm256_add_epi64(c, d); \
+    b = _mm256_xor_si256(b, c); \
+    b = _mm256_xor_si256(_mm256_srli_epi64(b, 63), _mm256_add_epi64(b, b)); \
+  } while(0)
+
+#define ROUND_LYRA_AVX2(a, b, c, d) \
+  do { \
+    G_AVX2(a, b, c, d); \
+    b = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(0,3,2,1)); \
+    c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(1,0,3,2)); \
+    d = _mm256_permute4x64_epi64(d, _MM_SHUFFLE(2,1,0,3)); \
+    G_AVX2(a, b, c, d); \
+    b = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(2,1,0,3)); \
+    c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(1,0,3,2)); \
+    d = _mm256_permute4x64_epi64(d, _MM_SHUFFLE(0,3,2,1)); \
+  } while(0)
+
+__attribute__((target("avx2")))
+static void blake2bLyraRoundsAVX2(uint64_t *v, int nRounds) {
+    const __m256i rotr24 = _mm256_setr_epi8(
+        3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10,
+        3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10);
+    const __m256i rotr16 = _mm256_setr_epi8(
+        2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9,
+        2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9);
+    __m256i a = _mm256_loadu_si256((const __m256i *)(v + 0));
+    __m256i b = _mm256_loadu_si256((const __m256i *)(v + 4));
+    __m256i c = _mm256_loadu_si256((const __m256i *)(v + 8));
+    __m256i d = _mm256_loadu_si256((const __m256i *)(v + 12));
+    int i;
+    for (i = 0; i < nRounds; i++) {
+        ROUND_LYRA_AVX2(a, b, c, d);
+    }
+    _mm256_storeu_si256((__m256i *)(v + 0), a);
+    _mm256_storeu_si256((__m256i *)(v + 4), b);
+    _mm256_storeu_si256((__m256i *)(v + 8), c);
+    _mm256_storeu_si256((__m256i *)(v + 12), d);
+}
+
+static void blake2bLyraAVX2(uint64_t *v) {
+    blake2bLyraRoundsAVX2(v, 12);
+}
+
+static void reducedBlake2bLyraAVX2(uint64_t *v) {
+    blake2bLyraRoundsAVX2(v, 1);
+}
+#endif
+
+//Implementations of the rounds in use, chosen by spongeAutoDetect()
+static void (*blake2bLyra)(uint64_t *v) = blake2bLyraGeneric;
+static void (*reducedBlake2bLyra)(uint64_t *v) = reducedBlake2bLyraGeneric;
+
+/**
+ * Selects an implementation of Blake2b's rounds by name ("standard" or "avx2").
+ * Must be called before any thread uses the sponge.
+ *
+ * @return 1 if the implementation was selected, 0 if the build or the CPU lacks it
+ */
+int spongeSelect(const char *name) {
+    if (strcmp(name, "standard") == 0) {
+        blake2bLyra = blake2bLyraGeneric;
+        reducedBlake2bLyra = reducedBlake2bLyraGeneric;
+        return 1;
+    }
+#if defined(LYRA2_SPONGE_X86)
+    __builtin_cpu_init();
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+        blake2bLyra = blake2bLyraAVX2;
+        reducedBlake2bLyra = reducedBlake2bLyraAVX2;
+        return 1;
+    }
+#endif
+    return 0;
+}
+
+/**
+ * Selects the fastest implementation of Blake2b's rounds supported by the CPU.
+ * Must be called before any thread uses the sponge.
+ *
+ * @return The name of the selected implementation
+ */
+const char *spongeAutoDetect(void) {
+    if (spongeSelect("avx2"))
+        return "avx2";
+    spongeSelect("standard");
+    return "standard";
+}
+
 /**
  * Performs a squeeze operation, using Blake2b's G function as the
  * internal permutation
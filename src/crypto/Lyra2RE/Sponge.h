@@ -75,6 +75,8 @@ static inline uint64_t rotr64( const uint64_t w, const unsigned c ){
 
 //---- Housekeeping
 void initState(uint64_t state[/*16*/]);
+int spongeSelect(const char *name);
+const char *spongeAutoDetect(void);
 
 //---- Squeezes
 void squeeze(uint64_t *state, unsigned char *out, unsigned int len);
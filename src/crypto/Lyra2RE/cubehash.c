@@ -528,6 +528,155 @@ static const sph_u32 IV512[] = {
 
 #endif
 
+/*
+ * The rounds are run by one of the functions below, each processing the
+ * whole state of the context for a number of 16-round iterations. The
+ * generic one is the unrolled code above; on x86-64 the SSE2 version is
+ * the default and sph_cubehash_autodetect() switches to AVX2 when the CPU
+ * supports it. The vector versions keep x[00000..01111] and x[10000..11111]
+ * in rows of 4 (or 8) words, which turns every word swap of the CubeHash
+ * round into a register rename or a single shuffle.
+ */
+
+static void
+cubehash_rounds_generic(sph_cubehash_context *sc, int n)
+{
+	DECL_STATE
+
+	READ_STATE(sc);
+	while (n -- > 0)
+		SIXTEEN_ROUNDS;
+	WRITE_STATE(sc);
+}
+
+#if defined __GNUC__ && (defined __x86_64__ || defined __amd64__)
+
+#include <immintrin.h>
+
+#define SPH_CUBEHASH_X86   1
+
+#define ROTL32_SSE2(x, n) \
+	_mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - (n)))
+
+/*
+ * a0..a3 hold x[00000..01111], b0..b3 hold x[10000..11111]. Swapping
+ * x[00klm] with x[01klm] exchanges a0/a2 and a1/a3, swapping x[0j0lm]
+ * with x[0j1lm] exchanges a0/a1 and a2/a3; both are done by renaming.
+ */
+#define ROUND_SSE2(a0, a1, a2, a3)   do { \
+		b0 = _mm_add_epi32(a0, b0); \
+		b1 = _mm_add_epi32(a1, b1); \
+		b2 = _mm_add_epi32(a2, b2); \
+		b3 = _mm_add_epi32(a3, b3); \
+		a0 = _mm_xor_si128(ROTL32_SSE2(a0, 7), b2); \
+		a1 = _mm_xor_si128(ROTL32_SSE2(a1, 7), b3); \
+		a2 = _mm_xor_si128(ROTL32_SSE2(a2, 7), b0); \
+		a3 = _mm_xor_si128(ROTL32_SSE2(a3, 7), b1); \
+		b0 = _mm_shuffle_epi32(b0, 0x4E); \
+		b1 = _mm_shuffle_epi32(b1, 0x4E); \
+		b2 = _mm_shuffle_epi32(b2, 0x4E); \
+		b3 = _mm_shuffle_epi32(b3, 0x4E); \
+		b0 = _mm_add_epi32(a2, b0); \
+		b1 = _mm_add_epi32(a3, b1); \
+		b2 = _mm_add_epi32(a0, b2); \
+		b3 = _mm_add_epi32(a1, b3); \
+		a0 = _mm_xor_si128(ROTL32_SSE2(a0, 11), b3); \
+		a1 = _mm_xor_si128(ROTL32_SSE2(a1, 11), b2); \
+		a2 = _mm_xor_si128(ROTL32_SSE2(a2, 11), b1); \
+		a3 = _mm_xor_si128(ROTL32_SSE2(a3, 11), b0); \
+		b0 = _mm_shuffle_epi32(b0, 0xB1); \
+		b1 = _mm_shuffle_epi32(b1, 0xB1); \
+		b2 = _mm_shuffle_epi32(b2, 0xB1); \
+		b3 = _mm_shuffle_epi32(b3, 0xB1); \
+	} while (0)
+
+static void
+cubehash_rounds_sse2(sph_cubehash_context *sc, int n)
+{
+	__m128i a0, a1, a2, a3, b0, b1, b2, b3;
+	int j;
+
+	a0 = _mm_loadu_si128((const __m128i *)(sc->state +  0));
+	a1 = _mm_loadu_si128((const __m128i *)(sc->state +  4));
+	a2 = _mm_loadu_si128((const __m128i *)(sc->state +  8));
+	a3 = _mm_loadu_si128((const __m128i *)(sc->state + 12));
+	b0 = _mm_loadu_si128((const __m128i *)(sc->state + 16));
+	b1 = _mm_loadu_si128((const __m128i *)(sc->state + 20));
+	b2 = _mm_loadu_si128((const __m128i *)(sc->state + 24));
+	b3 = _mm_loadu_si128((const __m128i *)(sc->state + 28));
+	/*
+	 * After one round the word that started in aN is held by a(3-N);
+	 * two rounds bring every row back under its own name.
+	 */
+	for (j = 0; j < 8 * n; j ++) {
+		ROUND_SSE2(a0, a1, a2, a3);
+		ROUND_SSE2(a3, a2, a1, a0);
+	}
+	_mm_storeu_si128((__m128i *)(sc->state +  0), a0);
+	_mm_storeu_si128((__m128i *)(sc->state +  4), a1);
+	_mm_storeu_si128((__m128i *)(sc->state +  8), a2);
+	_mm_storeu_si128((__m128i *)(sc->state + 12), a3);
+	_mm_storeu_si128((__m128i *)(sc->state + 16), b0);
+	_mm_storeu_si128((__m128i *)(sc->state + 20), b1);
+	_mm_storeu_si128((__m128i *)(sc->state + 24), b2);
+	_mm_storeu_si128((__m128i *)(sc->state + 28), b3);
+}
+
+#define ROTL32_AVX2(x, n) \
+	_mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - (n)))
+
+/*
+ * a0/a1 hold x[00000..00111]/x[01000..01111], b0/b1 the second half of
+ * the state. The x[0j0lm]/x[0j1lm] swap exchanges the 128-bit lanes.
+ */
+#define ROUND_AVX2(a0, a1)   do { \
+		b0 = _mm256_add_epi32(a0, b0); \
+		b1 = _mm256_add_epi32(a1, b1); \
+		a0 = _mm256_xor_si256(ROTL32_AVX2(a0, 7), b1); \
+		a1 = _mm256_xor_si256(ROTL32_AVX2(a1, 7), b0); \
+		b0 = _mm256_shuffle_epi32(b0, 0x4E); \
+		b1 = _mm256_shuffle_epi32(b1, 0x4E); \
+		b0 = _mm256_add_epi32(a1, b0); \
+		b1 = _mm256_add_epi32(a0, b1); \
+		a0 = _mm256_permute4x64_epi64(ROTL32_AVX2(a0, 11), 0x4E); \
+		a1 = _mm256_permute4x64_epi64(ROTL32_AVX2(a1, 11), 0x4E); \
+		a0 = _mm256_xor_si256(a0, b1); \
+		a1 = _mm256_xor_si256(a1, b0); \
+		b0 = _mm256_shuffle_epi32(b0, 0xB1); \
+		b1 = _mm256_shuffle_epi32(b1, 0xB1); \
+	} while (0)
+
+__attribute__((target("avx2")))
+static void
+cubehash_rounds_avx2(sph_cubehash_context *sc, int n)
+{
+	__m256i a0, a1, b0, b1;
+	int j;
+
+	a0 = _mm256_loadu_si256((const __m256i *)(sc->state +  0));
+	a1 = _mm256_loadu_si256((const __m256i *)(sc->state +  8));
+	b0 = _mm256_loadu_si256((const __m256i *)(sc->state + 16));
+	b1 = _mm256_loadu_si256((const __m256i *)(sc->state + 24));
+	for (j = 0; j < 8 * n; j ++) {
+		ROUND_AVX2(a0, a1);
+		ROUND_AVX2(a1, a0);
+	}
+	_mm256_storeu_si256((__m256i *)(sc->state +  0), a0);
+	_mm256_storeu_si256((__m256i *)(sc->state +  8), a1);
+	_mm256_storeu_si256((__m256i *)(sc->state + 16), b0);
+	_mm256_storeu_si256((__m256i *)(sc->state + 24), b1);
+}
+
+static void (*cubehash_rounds)(sph_cubehash_context *, int) =
+	cubehash_rounds_sse2;
+
+#else
+
+static void (*cubehash_rounds)(sph_cubehash_context *, int) =
+	cubehash_rounds_generic;
+
+#endif
+
 static void
 cubehash_init(sph_cubehash_context *sc, const sph_u32 *iv)
 {
@@ -535,12 +684,20 @@ cubehash_init(sph_cubehash_context *sc, const sph_u32 *iv)
 	sc->ptr = 0;
 }
 
+static void
+cubehash_input_block(sph_cubehash_context *sc)
+{
+	int i;
+
+	for (i = 0; i < 8; i ++)
+		sc->state[i] ^= sph_dec32le_aligned(sc->buf + (i << 2));
+}
+
 static void
 cubehash_core(sph_cubehash_context *sc, const void *data, size_t len)
 {
 	unsigned char *buf;
 	size_t ptr;
-	DECL_STATE
 
 	buf = sc->buf;
 	ptr = sc->ptr;
@@ -551,7 +708,6 @@ cubehash_core(sph_cubehash_context *sc, const void *data, size_t len)
 		return;
 	}
 
-	READ_STATE(sc);
 	while (len > 0) {
 		size_t clen;
 
@@ -563,12 +719,11 @@ cubehash_core(sph_cubehash_context *sc, const void *data, size_t len)
 		data = (const unsigned char *)data + clen;
 		len -= clen;
 		if (ptr == sizeof sc->buf) {
-			INPUT_BLOCK;
-			SIXTEEN_ROUNDS;
+			cubehash_input_block(sc);
+			cubehash_rounds(sc, 1);
 			ptr = 0;
 		}
 	}
-	WRITE_STATE(sc);
 	sc->ptr = ptr;
 }
 
@@ -579,27 +734,55 @@ cubehash_close(sph_cubehash_context *sc, unsigned ub, unsigned n,
 	unsigned char *buf, *out;
 	size_t ptr;
 	unsigned z;
-	int i;
-	DECL_STATE
 
 	buf = sc->buf;
 	ptr = sc->ptr;
 	z = 0x80 >> n;
 	buf[ptr ++] = ((ub & -z) | z) & 0xFF;
 	memset(buf + ptr, 0, (sizeof sc->buf) - ptr);
-	READ_STATE(sc);
-	INPUT_BLOCK;
-	for (i = 0; i < 11; i ++) {
-		SIXTEEN_ROUNDS;
-		if (i == 0)
-			xv ^= SPH_C32(1);
-	}
-	WRITE_STATE(sc);
+	cubehash_input_block(sc);
+	cubehash_rounds(sc, 1);
+	sc->state[31] ^= SPH_C32(1);
+	cubehash_rounds(sc, 10);
 	out = dst;
 	for (z = 0; z < out_size_w32; z ++)
 		sph_enc32le(out + (z << 2), sc->state[z]);
 }
 
+/* see sph_cubehash.h */
+int
+sph_cubehash_select(const char *name)
+{
+	if (strcmp(name, "standard") == 0) {
+		cubehash_rounds = cubehash_rounds_generic;
+		return 1;
+	}
+#if SPH_CUBEHASH_X86
+	if (strcmp(name, "sse2") == 0) {
+		cubehash_rounds = cubehash_rounds_sse2;
+		return 1;
+	}
+	__builtin_cpu_init();
+	if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+		cubehash_rounds = cubehash_rounds_avx2;
+		return 1;
+	}
+#endif
+	return 0;
+}
+
+/* see sph_cubehash.h */
+const char *
+sph_cubehash_autodetect(void)
+{
+	if (sph_cubehash_select("avx2"))
+		return "avx2";
+	if (sph_cubehash_select("sse2"))
+		return "sse2";
+	sph_cubehash_select("standard");
+	return "standard";
+}
+
 /* see sph_cubehash.h */
 void
 sph_cubehash224_init(void *cc)
@@ -282,5 +282,24 @@ void sph_cubehash512_close(void *cc, void *dst);
 void sph_cubehash512_addbits_and_close(
 	void *cc, unsigned ub, unsigned n, void *dst);
 
+/**
+ * Select the fastest implementation of the CubeHash rounds supported by
+ * the CPU and return its name. This must be called before any thread
+ * starts hashing; without it the SSE2 (x86-64) or generic code is used.
+ *
+ * @return  the name of the selected implementation
+ */
+const char *sph_cubehash_autodetect(void);
+
+/**
+ * Select the implementation of the CubeHash rounds with the given name
+ * ("standard", "sse2" or "avx2"), so tests can check each of them. Like
+ * sph_cubehash_autodetect(), it must be called before any thread starts
+ * hashing.
+ *
+ * @return  1 if it was selected, 0 if the build or the CPU lacks it
+ */
+int sph_cubehash_select(const char *name);
+
 #endif
 
@@ -5,6 +5,7 @@
 #include <crypto/hmac_sha512.h>
 
 #include <string.h>
+#include <vector>
 
 CHMAC_SHA512::CHMAC_SHA512(const unsigned char* key, size_t keylen)
 {
@@ -32,3 +33,10 @@ void CHMAC_SHA512::Finalize(unsigned char hash[OUTPUT_SIZE])
     inner.Finalize(temp);
     outer.Write(temp, 64).Finalize(hash);
 }
+
+void CHMAC_SHA512::FinalizeMulti(const unsigned char* data, size_t len, size_t n, unsigned char* out) const
+{
+    std::vector<unsigned char> vTemp(64 * n);
+    inner.FinalizeMulti(data, len, n, vTemp.data());
+    outer.FinalizeMulti(vTemp.data(), 64, n, out);
+}
@@ -27,6 +27,8 @@ public:
         return *this;
     }
     void Finalize(unsigned char hash[OUTPUT_SIZE]);
+    /** Finalize n copies of this hasher, the i-th after writing the len bytes at data + i * len to it. out receives n * OUTPUT_SIZE bytes */
+    void FinalizeMulti(const unsigned char* data, size_t len, size_t n, unsigned char* out) const;
 };
 
 #endif // BITCOIN_CRYPTO_HMAC_SHA512_H
@@ -6,8 +6,21 @@
 
 #include <crypto/common.h>
 
+#include <assert.h>
 #include <string.h>
 
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__))
+#include <cpuid.h>
+#endif
+
+// The SIMD kernels are linked into the executables only, not into libnixconsensus
+#if defined(ENABLE_AVX2) && !defined(BUILD_NIX_INTERNAL)
+namespace ripemd160_avx2
+{
+void Transform_8way(unsigned char* out, const unsigned char* in);
+}
+#endif
+
 // Internal implementation code.
 namespace
 {
@@ -233,10 +246,78 @@ void Transform(uint32_t* s, const unsigned char* chunk)
     s[4] = t + b1 + c2;
 }
 
+/** RIPEMD-160 of a single 32-byte message. */
+void Transform32(unsigned char* out, const unsigned char* in)
+{
+    // The message padded to a block, 256 bits long
+    unsigned char buf[64] = {0};
+    memcpy(buf, in, 32);
+    buf[32] = 0x80;
+    buf[57] = 0x01;
+    uint32_t s[5];
+    Initialize(s);
+    Transform(s, buf);
+    for (int i = 0; i < 5; i++) {
+        WriteLE32(out + 4 * i, s[i]);
+    }
+}
+
 } // namespace ripemd160
 
+typedef void (*Transform32Type)(unsigned char*, const unsigned char*);
+
+/** Kernel hashing 8 messages at once, when the CPU supports it */
+Transform32Type Transform32_8way = nullptr;
+
+bool SelfTest32(Transform32Type tr, size_t ways)
+{
+    unsigned char in[32 * 8], out[20 * 8], expected[20 * 8];
+    for (size_t i = 0; i < sizeof(in); i++) {
+        in[i] = i * 7 + 1;
+    }
+    for (size_t i = 0; i < ways; i++) {
+        ripemd160::Transform32(expected + 20 * i, in + 32 * i);
+    }
+    tr(out, in);
+    return memcmp(out, expected, 20 * ways) == 0;
+}
+
 } // namespace
 
+std::string RIPEMD160AutoDetect()
+{
+    std::string ret = "standard";
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__))
+    bool have_avx = false;
+    bool have_avx2 = false;
+    uint32_t eax, ebx, ecx, edx;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        // AVX needs the OS to have enabled XSAVE as well, for it to save the registers on context switches
+        if (((ecx >> 27) & 1) && ((ecx >> 28) & 1)) {
+            uint32_t a, d;
+            __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+            have_avx = (a & 6) == 6;
+        }
+        if (__get_cpuid_max(0, nullptr) >= 7) {
+            __cpuid_count(7, 0, eax, ebx, ecx, edx);
+            have_avx2 = (ebx >> 5) & 1;
+        }
+    }
+    (void)have_avx;
+    (void)have_avx2;
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_NIX_INTERNAL)
+    if (have_avx2 && have_avx) {
+        Transform32_8way = ripemd160_avx2::Transform_8way;
+        ret += ",avx2(8way)";
+    }
+#endif
+#endif
+
+    assert(!Transform32_8way || SelfTest32(Transform32_8way, 8));
+    return ret;
+}
+
 ////// RIPEMD160
 
 CRIPEMD160::CRIPEMD160() : bytes(0)
@@ -290,3 +371,21 @@ CRIPEMD160& CRIPEMD160::Reset()
     ripemd160::Initialize(s);
     return *this;
 }
+
+void RIPEMD160_32(unsigned char* out, const unsigned char* in, size_t blocks)
+{
+    if (Transform32_8way) {
+        while (blocks >= 8) {
+            Transform32_8way(out, in);
+            out += 160;
+            in += 256;
+            blocks -= 8;
+        }
+    }
+    while (blocks) {
+        ripemd160::Transform32(out, in);
+        out += 20;
+        in += 32;
+        --blocks;
+    }
+}
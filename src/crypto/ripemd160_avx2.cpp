@@ -0,0 +1,129 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+//
+// RIPEMD-160 of eight 32-byte messages at once, one message per 32-bit lane of an AVX2 register.
+
+#include <crypto/common.h>
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+namespace ripemd160_avx2 {
+namespace {
+
+const uint32_t INIT[5] = {0x67452301ul, 0xEFCDAB89ul, 0x98BADCFEul, 0x10325476ul, 0xC3D2E1F0ul};
+
+// Message word and rotation of each round, for the left and the right line
+const int R1[80] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+    7, 4, 13, 1, 10, 6, 15, 3, 12, 0, 9, 5, 2, 14, 11, 8,
+    3, 10, 14, 4, 9, 15, 8, 1, 2, 7, 0, 6, 13, 11, 5, 12,
+    1, 9, 11, 10, 0, 8, 12, 4, 13, 3, 7, 15, 14, 5, 6, 2,
+    4, 0, 5, 9, 7, 12, 2, 10, 14, 1, 3, 8, 11, 6, 15, 13};
+const int R2[80] = {
+    5, 14, 7, 0, 9, 2, 11, 4, 13, 6, 15, 8, 1, 10, 3, 12,
+    6, 11, 3, 7, 0, 13, 5, 10, 14, 15, 8, 12, 4, 9, 1, 2,
+    15, 5, 1, 3, 7, 14, 6, 9, 11, 8, 12, 2, 10, 0, 4, 13,
+    8, 6, 4, 1, 3, 11, 15, 0, 5, 12, 2, 13, 9, 7, 10, 14,
+    12, 15, 10, 4, 1, 5, 8, 7, 6, 2, 13, 14, 0, 3, 9, 11};
+const int S1[80] = {
+    11, 14, 15, 12, 5, 8, 7, 9, 11, 13, 14, 15, 6, 7, 9, 8,
+    7, 6, 8, 13, 11, 9, 7, 15, 7, 12, 15, 9, 11, 7, 13, 12,
+    11, 13, 6, 7, 14, 9, 13, 15, 14, 8, 13, 6, 5, 12, 7, 5,
+    11, 12, 14, 15, 14, 15, 9, 8, 9, 14, 5, 6, 8, 6, 5, 12,
+    9, 15, 5, 11, 6, 8, 13, 12, 5, 12, 13, 14, 11, 8, 5, 6};
+const int S2[80] = {
+    8, 9, 9, 11, 13, 15, 15, 5, 7, 7, 8, 11, 14, 14, 12, 6,
+    9, 13, 15, 7, 12, 8, 9, 11, 7, 7, 12, 7, 6, 15, 13, 11,
+    9, 7, 15, 11, 8, 6, 6, 14, 12, 13, 5, 14, 13, 13, 7, 5,
+    15, 5, 8, 11, 14, 14, 6, 14, 6, 9, 12, 9, 12, 5, 15, 8,
+    8, 5, 12, 9, 12, 5, 14, 6, 8, 13, 6, 5, 15, 13, 11, 11};
+const uint32_t K1[5] = {0, 0x5A827999ul, 0x6ED9EBA1ul, 0x8F1BBCDCul, 0xA953FD4Eul};
+const uint32_t K2[5] = {0x50A28BE6ul, 0x5C4DD124ul, 0x6D703EF3ul, 0x7A6D76E9ul, 0};
+
+__m256i inline K(uint32_t x) { return _mm256_set1_epi32(x); }
+
+__m256i inline Add(__m256i x, __m256i y) { return _mm256_add_epi32(x, y); }
+__m256i inline Xor(__m256i x, __m256i y) { return _mm256_xor_si256(x, y); }
+__m256i inline Or(__m256i x, __m256i y) { return _mm256_or_si256(x, y); }
+__m256i inline And(__m256i x, __m256i y) { return _mm256_and_si256(x, y); }
+__m256i inline Not(__m256i x) { return Xor(x, K(0xfffffffful)); }
+__m256i inline Rol(__m256i x, int n) { return Or(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n)); }
+
+__m256i inline f1(__m256i x, __m256i y, __m256i z) { return Xor(Xor(x, y), z); }
+__m256i inline f2(__m256i x, __m256i y, __m256i z) { return Xor(z, And(x, Xor(y, z))); }
+__m256i inline f3(__m256i x, __m256i y, __m256i z) { return Xor(Or(x, Not(y)), z); }
+__m256i inline f4(__m256i x, __m256i y, __m256i z) { return Xor(y, And(z, Xor(x, y))); }
+__m256i inline f5(__m256i x, __m256i y, __m256i z) { return Xor(x, Or(y, Not(z))); }
+
+/** Boolean function j of the 16-round groups, f1 to f5. */
+__m256i inline F(int j, __m256i x, __m256i y, __m256i z)
+{
+    switch (j) {
+    case 0: return f1(x, y, z);
+    case 1: return f2(x, y, z);
+    case 2: return f3(x, y, z);
+    case 3: return f4(x, y, z);
+    default: return f5(x, y, z);
+    }
+}
+
+/** One round of a line, rotating the registers a to e along. */
+void inline Round(__m256i& a, __m256i& b, __m256i& c, __m256i& d, __m256i& e, __m256i f, __m256i x, __m256i k, int r)
+{
+    __m256i t = Add(Rol(Add(Add(a, f), Add(x, k)), r), e);
+    a = e;
+    e = d;
+    d = Rol(c, 10);
+    c = b;
+    b = t;
+}
+
+/** The little endian word at offset of each of the eight messages. */
+__m256i inline Read8(const unsigned char* in, int offset)
+{
+    return _mm256_set_epi32(ReadLE32(in + 224 + offset), ReadLE32(in + 192 + offset), ReadLE32(in + 160 + offset), ReadLE32(in + 128 + offset),
+                            ReadLE32(in + 96 + offset), ReadLE32(in + 64 + offset), ReadLE32(in + 32 + offset), ReadLE32(in + offset));
+}
+
+void inline Write8(unsigned char* out, int offset, __m256i v)
+{
+    uint32_t lanes[8];
+    _mm256_storeu_si256((__m256i*)lanes, v);
+    for (int i = 0; i < 8; i++) WriteLE32(out + 20 * i + offset, lanes[i]);
+}
+
+} // namespace
+
+void Transform_8way(unsigned char* out, const unsigned char* in)
+{
+    // The message, then its padding, a 32-byte message is 256 bits long
+    __m256i w[16];
+    for (int i = 0; i < 8; i++) w[i] = Read8(in, 4 * i);
+    w[8] = K(0x80);
+    for (int i = 9; i < 16; i++) w[i] = K(0);
+    w[14] = K(0x100);
+
+    __m256i a1 = K(INIT[0]), b1 = K(INIT[1]), c1 = K(INIT[2]), d1 = K(INIT[3]), e1 = K(INIT[4]);
+    __m256i a2 = a1, b2 = b1, c2 = c1, d2 = d1, e2 = e1;
+
+    for (int i = 0; i < 80; i++) {
+        int j = i / 16;
+        Round(a1, b1, c1, d1, e1, F(j, b1, c1, d1), w[R1[i]], K(K1[j]), S1[i]);
+        Round(a2, b2, c2, d2, e2, F(4 - j, b2, c2, d2), w[R2[i]], K(K2[j]), S2[i]);
+    }
+
+    __m256i t = Add(Add(K(INIT[1]), c1), d2);
+    Write8(out, 4, Add(Add(K(INIT[2]), d1), e2));
+    Write8(out, 8, Add(Add(K(INIT[3]), e1), a2));
+    Write8(out, 12, Add(Add(K(INIT[4]), a1), b2));
+    Write8(out, 16, Add(Add(K(INIT[0]), b1), c2));
+    Write8(out, 0, t);
+}
+
+} // namespace ripemd160_avx2
+
+#endif
@@ -19,6 +19,30 @@ void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks);
 #endif
 #endif
 
+// The SIMD kernels are linked into the executables only, not into libnixconsensus
+#if !defined(BUILD_NIX_INTERNAL)
+#if defined(ENABLE_SSE41)
+namespace sha256d64_sse41
+{
+void Transform_4way(unsigned char* out, const unsigned char* in);
+}
+#endif
+
+#if defined(ENABLE_AVX2)
+namespace sha256d64_avx2
+{
+void Transform_8way(unsigned char* out, const unsigned char* in);
+}
+#endif
+
+#if defined(ENABLE_SHANI)
+namespace sha256_shani
+{
+void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks);
+}
+#endif
+#endif
+
 // Internal implementation code.
 namespace
 {
@@ -174,21 +198,114 @@ bool SelfTest(TransformType tr) {
 
 TransformType Transform = sha256::Transform;
 
+/** Double SHA-256 of a single 64-byte message, using the selected Transform. */
+void TransformD64(unsigned char* out, const unsigned char* in)
+{
+    // Padding of a 64-byte message, which is 512 bits long
+    static const unsigned char pad1[64] = {0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                           0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x02, 0};
+    uint32_t s[8];
+    unsigned char buf[64] = {0};
+    sha256::Initialize(s);
+    Transform(s, in, 1);
+    Transform(s, pad1, 1);
+    for (int i = 0; i < 8; i++) {
+        WriteBE32(buf + 4 * i, s[i]);
+    }
+    // The 32-byte result padded to a block, 256 bits long
+    buf[32] = 0x80;
+    buf[62] = 0x01;
+    sha256::Initialize(s);
+    Transform(s, buf, 1);
+    for (int i = 0; i < 8; i++) {
+        WriteBE32(out + 4 * i, s[i]);
+    }
+}
+
+typedef void (*TransformD64Type)(unsigned char*, const unsigned char*);
+
+/** Multi-way kernels, hashing 4 and 8 messages at once, when the CPU supports them */
+TransformD64Type TransformD64_4way = nullptr;
+TransformD64Type TransformD64_8way = nullptr;
+
+bool SelfTestD64(TransformD64Type tr, size_t ways)
+{
+    unsigned char in[64 * 8], out[32 * 8], expected[32 * 8];
+    for (size_t i = 0; i < sizeof(in); i++) {
+        in[i] = i * 7 + 1;
+    }
+    for (size_t i = 0; i < ways; i++) {
+        TransformD64(expected + 32 * i, in + 64 * i);
+    }
+    tr(out, in);
+    return memcmp(out, expected, 32 * ways) == 0;
+}
+
 } // namespace
 
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__))
+/** Whether the OS saves the AVX registers on context switches */
+static bool AVXEnabled()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
+
 std::string SHA256AutoDetect()
 {
+    std::string ret = "standard";
 #if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__))
+    bool have_sse4 = false;
+    bool have_avx = false;
+    bool have_avx2 = false;
+    bool have_shani = false;
     uint32_t eax, ebx, ecx, edx;
-    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx >> 19) & 1) {
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        have_sse4 = (ecx >> 19) & 1;
+        // AVX needs the OS to have enabled XSAVE as well
+        have_avx = ((ecx >> 27) & 1) && ((ecx >> 28) & 1) && AVXEnabled();
+        if (__get_cpuid_max(0, nullptr) >= 7) {
+            __cpuid_count(7, 0, eax, ebx, ecx, edx);
+            have_avx2 = (ebx >> 5) & 1;
+            have_shani = (ebx >> 29) & 1;
+        }
+    }
+    (void)have_avx;
+    (void)have_avx2;
+    (void)have_shani;
+
+#if defined(ENABLE_SHANI) && !defined(BUILD_NIX_INTERNAL)
+    if (have_shani && have_sse4) {
+        Transform = sha256_shani::Transform;
+        ret = "shani(1way)";
+    } else
+#endif
+    if (have_sse4) {
         Transform = sha256_sse4::Transform;
-        assert(SelfTest(Transform));
-        return "sse4";
+        ret = "sse4(1way)";
     }
+
+#if defined(ENABLE_SSE41) && !defined(BUILD_NIX_INTERNAL)
+    if (have_sse4) {
+        TransformD64_4way = sha256d64_sse41::Transform_4way;
+        ret += ",sse41(4way)";
+    }
+#endif
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_NIX_INTERNAL)
+    if (have_avx2 && have_avx) {
+        TransformD64_8way = sha256d64_avx2::Transform_8way;
+        ret += ",avx2(8way)";
+    }
+#endif
 #endif
 
     assert(SelfTest(Transform));
-    return "standard";
+    assert(!TransformD64_4way || SelfTestD64(TransformD64_4way, 4));
+    assert(!TransformD64_8way || SelfTestD64(TransformD64_8way, 8));
+    return ret;
 }
 
 ////// SHA-256
@@ -247,3 +364,29 @@ CSHA256& CSHA256::Reset()
     sha256::Initialize(s);
     return *this;
 }
+
+void SHA256D64(unsigned char* out, const unsigned char* in, size_t blocks)
+{
+    if (TransformD64_8way) {
+        while (blocks >= 8) {
+            TransformD64_8way(out, in);
+            out += 256;
+            in += 512;
+            blocks -= 8;
+        }
+    }
+    if (TransformD64_4way) {
+        while (blocks >= 4) {
+            TransformD64_4way(out, in);
+            out += 128;
+            in += 256;
+            blocks -= 4;
+        }
+    }
+    while (blocks) {
+        TransformD64(out, in);
+        out += 32;
+        in += 64;
+        --blocks;
+    }
+}
@@ -0,0 +1,88 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+//
+// SHA-256 block transformation using the Intel SHA extensions. The state is kept in the ABEF/CDGH
+// layout the sha256rnds2 instruction works on, and each QuadRound runs four rounds.
+
+#include <crypto/common.h>
+
+#ifdef ENABLE_SHANI
+
+#include <stdint.h>
+#include <immintrin.h>
+
+namespace sha256_shani {
+namespace {
+
+alignas(16) const uint32_t K256[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+/** Byte order of the message words, big endian within each 32-bit lane */
+alignas(16) const uint8_t MASK[16] = {0x03, 0x02, 0x01, 0x00, 0x07, 0x06, 0x05, 0x04, 0x0b, 0x0a, 0x09, 0x08, 0x0f, 0x0e, 0x0d, 0x0c};
+
+/** Four rounds with the message words m, starting at round i. */
+void inline QuadRound(__m128i& state0, __m128i& state1, __m128i m, int i)
+{
+    const __m128i msg = _mm_add_epi32(m, _mm_load_si128((const __m128i*)(K256 + i)));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0e));
+}
+
+/** Compute the next four message words m0 from the previous sixteen m0, m1, m2 and m3. */
+__m128i inline Expand(__m128i m0, __m128i m1, __m128i m2, __m128i m3)
+{
+    const __m128i t = _mm_add_epi32(_mm_sha256msg1_epu32(m0, m1), _mm_alignr_epi8(m3, m2, 4));
+    return _mm_sha256msg2_epu32(t, m3);
+}
+
+__m128i inline Load(const unsigned char* in)
+{
+    return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)in), _mm_load_si128((const __m128i*)MASK));
+}
+
+} // namespace
+
+void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks)
+{
+    // From the ABCD and EFGH words of the state to ABEF and CDGH
+    __m128i t0 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)s), 0xb1);
+    __m128i t1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(s + 4)), 0x1b);
+    __m128i s0 = _mm_alignr_epi8(t0, t1, 8);
+    __m128i s1 = _mm_blend_epi16(t1, t0, 0xf0);
+
+    while (blocks--) {
+        const __m128i so0 = s0, so1 = s1;
+        __m128i m[4];
+
+        for (int i = 0; i < 4; i++) {
+            m[i] = Load(chunk + 16 * i);
+            QuadRound(s0, s1, m[i], 4 * i);
+        }
+        for (int i = 4; i < 16; i++) {
+            m[i & 3] = Expand(m[i & 3], m[(i + 1) & 3], m[(i + 2) & 3], m[(i + 3) & 3]);
+            QuadRound(s0, s1, m[i & 3], 4 * i);
+        }
+
+        s0 = _mm_add_epi32(s0, so0);
+        s1 = _mm_add_epi32(s1, so1);
+        chunk += 64;
+    }
+
+    // Back to ABCD and EFGH
+    t0 = _mm_shuffle_epi32(s0, 0x1b);
+    t1 = _mm_shuffle_epi32(s1, 0xb1);
+    _mm_storeu_si128((__m128i*)s, _mm_blend_epi16(t0, t1, 0xf0));
+    _mm_storeu_si128((__m128i*)(s + 4), _mm_alignr_epi8(t1, t0, 8));
+}
+
+} // namespace sha256_shani
+
+#endif
@@ -6,7 +6,21 @@
 
 #include <crypto/common.h>
 
+#include <assert.h>
 #include <string.h>
+#include <vector>
+
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__))
+#include <cpuid.h>
+#endif
+
+// The SIMD kernels are linked into the executables only, not into libnixconsensus
+#if defined(ENABLE_AVX2) && !defined(BUILD_NIX_INTERNAL)
+namespace sha512_avx2
+{
+void Transform_4way(uint64_t* s, const unsigned char* in);
+}
+#endif
 
 // Internal implementation code.
 namespace
@@ -146,8 +160,64 @@ void Transform(uint64_t* s, const unsigned char* chunk)
 
 } // namespace sha512
 
+typedef void (*Transform4wayType)(uint64_t*, const unsigned char*);
+
+/** Kernel transforming four states at once, each with its own block, when the CPU supports it */
+Transform4wayType Transform_4way = nullptr;
+
+bool SelfTest4way(Transform4wayType tr)
+{
+    uint64_t s[8 * 4], expected[8 * 4];
+    unsigned char in[128 * 4];
+    for (size_t i = 0; i < sizeof(in); i++) {
+        in[i] = i * 7 + 1;
+    }
+    for (size_t i = 0; i < 4; i++) {
+        sha512::Initialize(s + 8 * i);
+        s[8 * i] += i;
+        memcpy(expected + 8 * i, s + 8 * i, 64);
+        sha512::Transform(expected + 8 * i, in + 128 * i);
+    }
+    tr(s, in);
+    return memcmp(s, expected, sizeof(s)) == 0;
+}
+
 } // namespace
 
+std::string SHA512AutoDetect()
+{
+    std::string ret = "standard";
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__))
+    bool have_avx = false;
+    bool have_avx2 = false;
+    uint32_t eax, ebx, ecx, edx;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        // AVX needs the OS to have enabled XSAVE as well, for it to save the registers on context switches
+        if (((ecx >> 27) & 1) && ((ecx >> 28) & 1)) {
+            uint32_t a, d;
+            __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+            have_avx = (a & 6) == 6;
+        }
+        if (__get_cpuid_max(0, nullptr) >= 7) {
+            __cpuid_count(7, 0, eax, ebx, ecx, edx);
+            have_avx2 = (ebx >> 5) & 1;
+        }
+    }
+    (void)have_avx;
+    (void)have_avx2;
+
+#if defined(ENABLE_AVX2) && !defined(BUILD_NIX_INTERNAL)
+    if (have_avx2 && have_avx) {
+        Transform_4way = sha512_avx2::Transform_4way;
+        ret += ",avx2(4way)";
+    }
+#endif
+#endif
+
+    assert(!Transform_4way || SelfTest4way(Transform_4way));
+    return ret;
+}
+
 
 ////// SHA-512
 
@@ -199,6 +269,44 @@ void CSHA512::Finalize(unsigned char hash[OUTPUT_SIZE])
     WriteBE64(hash + 56, s[7]);
 }
 
+void CSHA512::FinalizeMulti(const unsigned char* data, size_t len, size_t n, unsigned char* out) const
+{
+    size_t bufsize = bytes % 128;
+    if (bufsize + len + 17 > 128) {
+        // More than one block left to process, each copy finishes on its own
+        for (size_t i = 0; i < n; i++) {
+            CSHA512(*this).Write(data + i * len, len).Finalize(out + i * OUTPUT_SIZE);
+        }
+        return;
+    }
+
+    // The last block of every copy: what is buffered, its data, then the padding and the length in bits
+    std::vector<unsigned char> vBlocks(128 * n, 0);
+    std::vector<uint64_t> vStates(8 * n);
+    for (size_t i = 0; i < n; i++) {
+        unsigned char* block = &vBlocks[128 * i];
+        memcpy(block, buf, bufsize);
+        memcpy(block + bufsize, data + i * len, len);
+        block[bufsize + len] = 0x80;
+        WriteBE64(block + 120, (bytes + len) << 3);
+        memcpy(&vStates[8 * i], s, sizeof(s));
+    }
+
+    size_t i = 0;
+    if (Transform_4way) {
+        for (; i + 4 <= n; i += 4) {
+            Transform_4way(&vStates[8 * i], &vBlocks[128 * i]);
+        }
+    }
+    for (; i < n; i++) {
+        sha512::Transform(&vStates[8 * i], &vBlocks[128 * i]);
+    }
+
+    for (i = 0; i < 8 * n; i++) {
+        WriteBE64(out + 8 * i, vStates[i]);
+    }
+}
+
 CSHA512& CSHA512::Reset()
 {
     bytes = 0;
@@ -7,6 +7,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string>
 
 /** A hasher class for SHA-512. */
 class CSHA512
@@ -22,7 +23,16 @@ public:
     CSHA512();
     CSHA512& Write(const unsigned char* data, size_t len);
     void Finalize(unsigned char hash[OUTPUT_SIZE]);
+    /** Finalize n copies of this hasher, the i-th after writing the len bytes at data + i * len to it.
+     *  out receives n * OUTPUT_SIZE bytes. When a single block is left to process, the copies are transformed together.
+     */
+    void FinalizeMulti(const unsigned char* data, size_t len, size_t n, unsigned char* out) const;
     CSHA512& Reset();
 };
 
+/** Autodetect the best available SHA512 implementation.
+ *  Returns the name of the implementation.
+ */
+std::string SHA512AutoDetect();
+
 #endif // BITCOIN_CRYPTO_SHA512_H
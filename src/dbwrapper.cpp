@@ -5,6 +5,7 @@
 #include <dbwrapper.h>
 
 #include <random.h>
+#include <tinyformat.h>
 
 #include <leveldb/cache.h>
 #include <leveldb/env.h>
@@ -71,14 +72,70 @@ public:
     }
 };
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+namespace {
+
+std::mutex cs_databases;
+//! open databases in the order they were opened
+std::vector<CDBWrapper*> vDatabases;
+//! name of the database CompactNextDatabase() compacted last
+std::string strLastCompacted;
+
+} // namespace
+
+bool ApplyDBOptionArgs(const std::string& strName, CDBOptions& dbOptions, std::string& strError)
+{
+    for (const std::string& strArg : gArgs.GetArgs("-dboption")) {
+        size_t nColon = strArg.find(':');
+        size_t nEquals = strArg.find('=', nColon == std::string::npos ? 0 : nColon);
+        int64_t nValue;
+        if (nColon == std::string::npos || nEquals == std::string::npos || !ParseInt64(strArg.substr(nEquals + 1), &nValue)) {
+            strError = strprintf("Invalid -dboption '%s', expected <database>:<setting>=<number>", strArg);
+            return false;
+        }
+        std::string strSetting = strArg.substr(nColon + 1, nEquals - nColon - 1);
+        bool fApply = strArg.substr(0, nColon) == strName;
+
+        // the ranges are the ones LevelDB itself clips the settings to
+        if (strSetting == "bloombits" && nValue >= 0 && nValue <= 64) {
+            if (fApply) dbOptions.nBloomBitsPerKey = nValue;
+        } else if (strSetting == "maxopenfiles" && nValue >= 74 && nValue <= 50000) {
+            if (fApply) dbOptions.nMaxOpenFiles = nValue;
+        } else if (strSetting == "blocksize" && nValue >= 1024 && nValue <= 4 * 1024 * 1024) {
+            if (fApply) dbOptions.nBlockSize = nValue;
+        } else if (strSetting == "compression" && (nValue == 0 || nValue == 1)) {
+            if (fApply) dbOptions.fCompression = nValue == 1;
+        } else {
+            strError = strprintf("Invalid -dboption '%s', unknown setting or value out of range", strArg);
+            return false;
+        }
+    }
+    return true;
+}
+
+/** The path below the data directory, or the whole path of a database elsewhere */
+static std::string GetDatabaseName(const fs::path& path)
+{
+    fs::path pathDataDir = GetDataDir();
+    fs::path::iterator itPath = path.begin();
+    for (fs::path::iterator itDir = pathDataDir.begin(); itDir != pathDataDir.end(); ++itDir, ++itPath) {
+        if (itPath == path.end() || *itPath != *itDir)
+            return path.generic_string();
+    }
+    fs::path pathRelative;
+    for (; itPath != path.end(); ++itPath)
+        pathRelative /= *itPath;
+    return pathRelative.generic_string();
+}
+
+static leveldb::Options GetOptions(size_t nCacheSize, const CDBOptions& dbOptions)
 {
     leveldb::Options options;
     options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
     options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
-    options.compression = leveldb::kNoCompression;
-    options.max_open_files = 64;
+    options.filter_policy = dbOptions.nBloomBitsPerKey > 0 ? leveldb::NewBloomFilterPolicy(dbOptions.nBloomBitsPerKey) : nullptr;
+    options.compression = dbOptions.fCompression ? leveldb::kSnappyCompression : leveldb::kNoCompression;
+    options.max_open_files = dbOptions.nMaxOpenFiles;
+    options.block_size = dbOptions.nBlockSize;
     options.info_log = new CBitcoinLevelDBLogger();
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
@@ -88,14 +145,18 @@ static leveldb::Options GetOptions(size_t nCacheSize)
     return options;
 }
 
-CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
+CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate, const CDBOptions& dbOptionsIn)
+    : strName(fMemory ? path.filename().string() : GetDatabaseName(path)), dbOptions(dbOptionsIn)
 {
+    std::string strError;
+    if (!ApplyDBOptionArgs(strName, dbOptions, strError))
+        throw dbwrapper_error(strError);
     penv = nullptr;
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetOptions(nCacheSize, dbOptions);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -114,9 +175,7 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
     LogPrintf("Opened LevelDB successfully\n");
 
     if (gArgs.GetBoolArg("-forcecompactdb", false)) {
-        LogPrintf("Starting database compaction of %s\n", path.string());
-        pdb->CompactRange(nullptr, nullptr);
-        LogPrintf("Finished database compaction of %s\n", path.string());
+        CompactAll();
     }
 
     // The base-case obfuscation key, which is a noop.
@@ -137,10 +196,19 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
     }
 
     LogPrintf("Using obfuscation key for %s: %s\n", path.string(), HexStr(obfuscate_key));
+
+    std::lock_guard<std::mutex> lock(cs_databases);
+    vDatabases.push_back(this);
 }
 
 CDBWrapper::~CDBWrapper()
 {
+    {
+        std::lock_guard<std::mutex> lock(cs_databases);
+        vDatabases.erase(std::remove(vDatabases.begin(), vDatabases.end(), this), vDatabases.end());
+    }
+    // wait for a compaction CompactNextDatabase() started before the database was taken off the list
+    std::lock_guard<std::mutex> lock(cs_compact);
     delete pdb;
     pdb = nullptr;
     delete options.filter_policy;
@@ -180,6 +248,49 @@ std::vector<unsigned char> CDBWrapper::CreateObfuscateKey() const
 
 }
 
+void CDBWrapper::CompactAll()
+{
+    int64_t nStart = GetTimeMillis();
+    LogPrintf("Starting database compaction of %s\n", strName);
+    pdb->CompactRange(nullptr, nullptr);
+    LogPrintf("Finished database compaction of %s in %dms\n", strName, GetTimeMillis() - nStart);
+}
+
+bool CDBWrapper::GetProperty(const std::string& strProperty, std::string& strValue) const
+{
+    return pdb->GetProperty(strProperty, &strValue);
+}
+
+void ForEachDatabase(const std::function<void(const CDBWrapper&)>& f)
+{
+    std::lock_guard<std::mutex> lock(cs_databases);
+    for (const CDBWrapper* pdbwrapper : vDatabases)
+        f(*pdbwrapper);
+}
+
+std::string CompactNextDatabase()
+{
+    CDBWrapper* pdbwrapper;
+    std::unique_lock<std::mutex> lockCompact;
+    {
+        std::lock_guard<std::mutex> lock(cs_databases);
+        if (vDatabases.empty())
+            return "";
+        size_t nNext = 0;
+        for (size_t i = 0; i < vDatabases.size(); i++) {
+            if (vDatabases[i]->strName == strLastCompacted) {
+                nNext = (i + 1) % vDatabases.size();
+                break;
+            }
+        }
+        pdbwrapper = vDatabases[nNext];
+        lockCompact = std::unique_lock<std::mutex>(pdbwrapper->cs_compact);
+        strLastCompacted = pdbwrapper->strName;
+    }
+    pdbwrapper->CompactAll();
+    return pdbwrapper->strName;
+}
+
 bool CDBWrapper::IsEmpty()
 {
     std::unique_ptr<CDBIterator> it(NewIterator());
@@ -16,8 +16,13 @@
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
 
+#include <functional>
+#include <mutex>
+
 static const size_t DBWRAPPER_PREALLOC_KEY_SIZE = 64;
 static const size_t DBWRAPPER_PREALLOC_VALUE_SIZE = 1024;
+//! -dbcompact default, minutes between idle compactions, 0 to never compact
+static const int DEFAULT_DB_COMPACT_INTERVAL = 0;
 
 class dbwrapper_error : public std::runtime_error
 {
@@ -27,6 +32,28 @@ public:
 
 class CDBWrapper;
 
+/** LevelDB settings that are tuned per database */
+struct CDBOptions
+{
+    //! Snappy-compress table blocks (needs LevelDB built with Snappy, stored uncompressed otherwise)
+    bool fCompression;
+    //! bits per key of the bloom filter, 0 for no filter (databases read by range scans only)
+    int nBloomBitsPerKey;
+    //! number of table files kept open
+    int nMaxOpenFiles;
+    //! uncompressed size of a table block, the unit read from disk and kept in the block cache
+    size_t nBlockSize;
+
+    CDBOptions() : fCompression(false), nBloomBitsPerKey(10), nMaxOpenFiles(64), nBlockSize(4096) {}
+};
+
+/**
+ * Apply the -dboption=<database>:<setting>=<value> arguments naming strName to dbOptions. Every
+ * argument is checked, so an empty strName validates them all. Returns false with strError set
+ * for a malformed one.
+ */
+bool ApplyDBOptionArgs(const std::string& strName, CDBOptions& dbOptions, std::string& strError);
+
 /** These should be considered an implementation detail of the specific database.
  */
 namespace dbwrapper_private {
@@ -176,6 +203,7 @@ public:
 class CDBWrapper
 {
     friend const std::vector<unsigned char>& dbwrapper_private::GetObfuscateKey(const CDBWrapper &w);
+    friend std::string CompactNextDatabase();
 private:
     //! custom environment this database is using (may be nullptr in case of default environment)
     leveldb::Env* penv;
@@ -209,6 +237,16 @@ private:
 
     std::vector<unsigned char> CreateObfuscateKey() const;
 
+    //! path relative to the data directory (last path component of an in-memory database), how
+    //! -dboption and getdbstats refer to the database
+    std::string strName;
+
+    //! settings the database was opened with
+    CDBOptions dbOptions;
+
+    //! held while the database is being compacted, so it is not closed underneath
+    std::mutex cs_compact;
+
 public:
     /**
      * @param[in] path        Location in the filesystem where leveldb data will be stored.
@@ -217,8 +255,10 @@ public:
      * @param[in] fWipe       If true, remove all existing data.
      * @param[in] obfuscate   If true, store data obfuscated via simple XOR. If false, XOR
      *                        with a zero'd byte array.
+     * @param[in] dbOptionsIn Compression, bloom filter, open file and block size settings,
+     *                        -dboption arguments naming the database override them.
      */
-    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false, const CDBOptions& dbOptionsIn = CDBOptions());
     ~CDBWrapper();
 
     template <typename K, typename V>
@@ -338,6 +378,26 @@ public:
         pdb->CompactRange(&slKey1, &slKey2);
     }
 
+    /**
+     * Compact the whole database, pushing every table down to the last level. Takes as long as
+     * rewriting the database; reads and writes continue meanwhile.
+     */
+    void CompactAll();
+
+    const std::string& GetName() const { return strName; }
+    const CDBOptions& GetDBOptions() const { return dbOptions; }
+
+    /** A LevelDB property such as "leveldb.stats", false if LevelDB does not know it */
+    bool GetProperty(const std::string& strProperty, std::string& strValue) const;
 };
 
+/** Call f for each open database, in the order they were opened */
+void ForEachDatabase(const std::function<void(const CDBWrapper&)>& f);
+
+/**
+ * Compact the database opened after the one compacted last time, or the first one. Returns the
+ * name of the database compacted, or an empty string when none is open.
+ */
+std::string CompactNextDatabase();
+
 #endif // BITCOIN_DBWRAPPER_H
@@ -11,6 +11,7 @@
 #include <crypto/hmac_sha512.h>
 
 #include <stdint.h>
+#include <thread>
 
 CCriticalSection cs_extKey;
 
@@ -573,6 +574,99 @@ int CStoredExtKey::SetPath(const std::vector<uint32_t> &vPath_)
     return 0;
 };
 
+static void DeriveKeyIdsRange(const CExtKeyPair &kp, uint32_t nChildIn, size_t nBegin, size_t nEnd, CKeyID *pIds)
+{
+    if (nBegin >= nEnd)
+        return;
+
+    // Public children share the chain code and parent key, their hashes are computed together
+    if (((nChildIn + nEnd - 1) >> 31) == 0 && kp.pubkey.IsValid())
+    {
+        kp.pubkey.DeriveIds(pIds + nBegin, nChildIn + nBegin, nEnd - nBegin, kp.vchChainCode);
+        return;
+    };
+
+    for (size_t i = nBegin; i < nEnd; ++i)
+    {
+        CPubKey pk;
+        if (kp.Derive(pk, nChildIn + i))
+            pIds[i] = pk.GetID();
+        else
+            pIds[i].SetNull();
+    };
+};
+
+int CStoredExtKey::DeriveKeyIds(uint32_t nChildIn, uint32_t nKeys, std::vector<CKeyID> &vIdsOut)
+{
+    if ((nChildIn >> 31) == 1 || ((nChildIn + nKeys) >> 31) == 1)
+        return errorN(1, "No more keys can be derived from master.");
+
+    // Keys below nGenerated are never looked ahead for again
+    if (nGenerated > nCacheFrom && !vCachedIds.empty())
+    {
+        size_t nDrop = std::min((size_t)(nGenerated - nCacheFrom), vCachedIds.size());
+        vCachedIds.erase(vCachedIds.begin(), vCachedIds.begin() + nDrop);
+        nCacheFrom += nDrop;
+        fCacheChanged = true;
+    };
+
+    // Only a cache the range extends is kept
+    if (nChildIn < nCacheFrom || nChildIn > nCacheFrom + vCachedIds.size())
+    {
+        vCachedIds.clear();
+        nCacheFrom = nChildIn;
+        fCacheChanged = true;
+    };
+
+    uint32_t nCacheEnd = nCacheFrom + vCachedIds.size();
+    if (nChildIn + nKeys > nCacheEnd)
+    {
+        uint32_t nDerive = std::max(nChildIn + nKeys - nCacheEnd, N_LOOKAHEAD_DERIVE_BATCH);
+        if (((nCacheEnd + nDerive) >> 31) == 1)
+            nDerive = (1u << 31) - nCacheEnd;
+        vCachedIds.resize(vCachedIds.size() + nDerive);
+        CKeyID *pIds = &vCachedIds[nCacheEnd - nCacheFrom];
+
+        int nThreads = std::min((int)(nDerive / N_LOOKAHEAD_KEYS_PER_THREAD), GetNumCores());
+        if (nThreads <= 1)
+        {
+            DeriveKeyIdsRange(kp, nCacheEnd, 0, nDerive, pIds);
+        } else
+        {
+            std::vector<std::thread> vThreads;
+            size_t nPerThread = (nDerive + nThreads - 1) / nThreads;
+            for (int t = 1; t < nThreads; ++t)
+                vThreads.emplace_back(DeriveKeyIdsRange, std::cref(kp), nCacheEnd, t * nPerThread,
+                    std::min((size_t)nDerive, (t + 1) * nPerThread), pIds);
+            DeriveKeyIdsRange(kp, nCacheEnd, 0, nPerThread, pIds);
+            for (std::thread &thread : vThreads)
+                thread.join();
+        };
+        fCacheChanged = true;
+    };
+
+    vIdsOut.assign(vCachedIds.begin() + (nChildIn - nCacheFrom), vCachedIds.begin() + (nChildIn - nCacheFrom + nKeys));
+    return 0;
+};
+
+bool CStoredExtKey::VerifyLookAheadCache()
+{
+    if (vCachedIds.empty())
+        return true;
+
+    // A cache derived from another key would miss every payment to the chain, check both ends
+    CKeyID idFirst, idLast;
+    DeriveKeyIdsRange(kp, nCacheFrom, 0, 1, &idFirst);
+    DeriveKeyIdsRange(kp, nCacheFrom + vCachedIds.size() - 1, 0, 1, &idLast);
+    if (idFirst == vCachedIds.front() && idLast == vCachedIds.back())
+        return true;
+
+    vCachedIds.clear();
+    nCacheFrom = 0;
+    fCacheChanged = true;
+    return false;
+};
+
 std::string CExtKeyAccount::GetIDString58() const
 {
     // 0th chain is always account chain
@@ -951,29 +1045,32 @@ int CExtKeyAccount::AddLookAhead(uint32_t nChain, uint32_t nKeys)
 
     AccKeyMap::const_iterator mi;
     uint32_t nChild = std::max(pc->nGenerated, pc->nLastLookAhead);
-    uint32_t nChildOut = nChild;
 
     if (LogAcceptCategory(BCLog::HDWALLET))
-        LogPrintf("%s: chain %s, keys %d, from %d.\n", __func__, pc->GetIDString58(), nKeys, nChildOut);
-
-    CKeyID keyId;
-    CPubKey pk;
-    for (uint32_t k = 0; k < nKeys; ++k)
+        LogPrintf("%s: chain %s, keys %d, from %d.\n", __func__, pc->GetIDString58(), nKeys, nChild);
+
+    // Children skipped as invalid or already in the maps count as tries
+    uint32_t nMaxTries = nKeys + 1000; // TODO: link to lookahead size
+    uint32_t nTries = 0;
+    uint32_t k = 0;
+    std::vector<CKeyID> vIds;
+    while (k < nKeys && nTries < nMaxTries)
     {
-        bool fGotKey = false;
+        // All the ids of the batch are derived together
+        uint32_t nBatch = std::min(nKeys - k, nMaxTries - nTries);
+        if (pc->DeriveKeyIds(nChild, nBatch, vIds) != 0)
+            break;
 
-        uint32_t nMaxTries = 1000; // TODO: link to lookahead size
-        for (uint32_t i = 0; i < nMaxTries; ++i) // nMaxTries > lookahead pool
+        for (uint32_t i = 0; i < nBatch && k < nKeys; ++i, ++nTries)
         {
-            if (pc->DeriveKey(pk, nChild, nChildOut, false) != 0)
+            const CKeyID &keyId = vIds[i];
+            uint32_t nChildOut = nChild + i;
+            if (keyId.IsNull())
             {
-                LogPrintf("Error: %s - DeriveKey failed, chain %d, child %d.\n", __func__, nChain, nChild);
-                nChild = nChildOut+1;
+                LogPrintf("Error: %s - DeriveKey failed, chain %d, child %d.\n", __func__, nChain, nChildOut);
                 continue;
             };
-            nChild = nChildOut+1;
 
-            keyId = pk.GetID();
             if ((mi = mapKeys.find(keyId)) != mapKeys.end())
             {
                 if (LogAcceptCategory(BCLog::HDWALLET))
@@ -984,23 +1081,19 @@ int CExtKeyAccount::AddLookAhead(uint32_t nChain, uint32_t nKeys)
             if ((mi = mapLookAhead.find(keyId)) != mapLookAhead.end())
                 continue;
 
-            fGotKey = true;
-            break;
-        };
+            mapLookAhead[keyId] = CEKAKey(nChain, nChildOut);
+            pc->nLastLookAhead = nChildOut;
+            ++k;
 
-        if (!fGotKey)
-        {
-            LogPrintf("Error: %s - DeriveKey loop failed, chain %d, child %d.\n", __func__, nChain, nChild);
-            continue;
+            if (LogAcceptCategory(BCLog::HDWALLET))
+                LogPrintf("%s: Added %s, look-ahead size %u.\n", __func__, CBitcoinAddress(keyId).ToString(), mapLookAhead.size());
         };
-
-        mapLookAhead[keyId] = CEKAKey(nChain, nChildOut);
-        pc->nLastLookAhead = nChildOut;
-
-        if (LogAcceptCategory(BCLog::HDWALLET))
-            LogPrintf("%s: Added %s, look-ahead size %u.\n", __func__, CBitcoinAddress(keyId).ToString(), mapLookAhead.size());
+        nChild += nBatch;
     };
 
+    if (k < nKeys)
+        LogPrintf("Error: %s - DeriveKey loop failed, chain %d, child %d.\n", __func__, nChain, nChild);
+
     return 0;
 };
 
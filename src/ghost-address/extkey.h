@@ -21,6 +21,8 @@ static const uint32_t BIP32_KEY_N_BYTES = 74;   // raw without id and checksum
 
 static const uint32_t MAX_KEY_PACK_SIZE = 128;
 static const uint32_t N_DEFAULT_LOOKAHEAD = 64;
+static const uint32_t N_LOOKAHEAD_DERIVE_BATCH = 256; // keys derived at once past the look ahead cache
+static const uint32_t N_LOOKAHEAD_KEYS_PER_THREAD = 64; // fewer keys than this per thread are derived on the calling thread
 
 static const uint32_t BIP44_PURPOSE = (((uint32_t)44) | (1 << 31));
 
@@ -293,6 +295,8 @@ public:
         nGenerated = 0;
         nHGenerated = 0;
         nLastLookAhead = 0;
+        nCacheFrom = 0;
+        fCacheChanged = false;
     };
 
     std::string GetIDString58() const;
@@ -372,6 +376,16 @@ public:
 
     int SetPath(const std::vector<uint32_t> &vPath_);
 
+    /**
+     * Ids of the non hardened children from nChildIn on, vIdsOut[i] is the id of child nChildIn + i,
+     * null if that child is invalid. Children past the look ahead cache are derived in parallel,
+     * N_LOOKAHEAD_DERIVE_BATCH at least, and added to it.
+     */
+    int DeriveKeyIds(uint32_t nChildIn, uint32_t nKeys, std::vector<CKeyID> &vIdsOut);
+
+    /** Check the look ahead cache read from the db against the key, clearing it if it doesn't match */
+    bool VerifyLookAheadCache();
+
     isminetype IsMine() const
     {
         if (kp.key.IsValid() || (nFlags & EAF_IS_CRYPTED))
@@ -426,6 +440,11 @@ public:
     uint32_t nHGenerated;
     uint32_t nLastLookAhead; // in memory only
 
+    // Look ahead cache, ids of the non hardened children from nCacheFrom on. Saved apart from the key
+    uint32_t nCacheFrom;
+    std::vector<CKeyID> vCachedIds;
+    bool fCacheChanged; // not saved yet
+
     mapEKValue_t mapValue;
 };
 
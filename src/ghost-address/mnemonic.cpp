@@ -21,6 +21,9 @@
 #include <ghost-address/wordlists/italian.h>
 #include <ghost-address/wordlists/korean.h>
 
+#include <mutex>
+#include <unordered_map>
+
 
 static const unsigned char *mnLanguages[] =
 {
@@ -74,6 +77,48 @@ const char *mnLanguagesTag[WLL_MAX] =
     "korean",
 };
 
+namespace {
+
+/** A wordlist split into its words, with the offset of every word by its text */
+struct WordList
+{
+    std::vector<std::string> vWords;
+    std::unordered_map<std::string, int> mapOffsets;
+};
+
+WordList wordLists[WLL_MAX];
+std::once_flag wordListsInit[WLL_MAX];
+
+/** The words of a language, split on first use. Only lines ending in \n are words, as for GetWord(). */
+const WordList &GetWordList(int nLanguage)
+{
+    std::call_once(wordListsInit[nLanguage], [nLanguage]() {
+        WordList &words = wordLists[nLanguage];
+        const char *pwl = (const char*) mnLanguages[nLanguage];
+        const char *pend = pwl + mnLanguageLens[nLanguage];
+        const char *pt;
+        while ((pt = (const char*) memchr(pwl, '\n', pend - pwl)) != nullptr)
+        {
+            words.vWords.emplace_back(pwl, pt);
+            // keep the first of any duplicates, which is what a search from the start finds
+            words.mapOffsets.emplace(words.vWords.back(), (int)words.vWords.size() - 1);
+            pwl = pt + 1;
+        };
+    });
+    return wordLists[nLanguage];
+};
+
+bool FindWordOffset(const WordList &words, const char *p, int &o)
+{
+    auto it = words.mapOffsets.find(p);
+    if (it == words.mapOffsets.end())
+        return false;
+    o = it->second;
+    return true;
+};
+
+} // namespace
+
 static void NormaliseUnicode(std::string &str)
 {
     std::u32string u32;
@@ -160,8 +205,7 @@ int MnemonicDetectLanguage(const std::string &sWordList)
     {
         strcpy(tmp, sWordList.c_str());
 
-        char *pwl = (char*) mnLanguages[l];
-        int m = mnLanguageLens[l];
+        const WordList &words = GetWordList(l);
 
         // The chinese dialects have many words in common, match full phrase
         int maxTries = (l == WLL_CHINESE_S || l == WLL_CHINESE_T) ? 24 : 8;
@@ -173,7 +217,7 @@ int MnemonicDetectLanguage(const std::string &sWordList)
         while (p != nullptr)
         {
             int ofs;
-            if (0 == GetWordOffset(p, pwl, m, ofs))
+            if (FindWordOffset(words, p, ofs))
                 nHit++;
             else
                 nMiss++;
@@ -201,7 +245,7 @@ int MnemonicEncode(int nLanguage, const std::vector<uint8_t> &vEntropy, std::str
 
     sWordList = "";
 
-    if (nLanguage < 1 || nLanguage > WLL_MAX)
+    if (nLanguage < 1 || nLanguage >= WLL_MAX)
     {
         sError = "Unknown language.";
         return errorN(1, "%s: %s", __func__, sError.c_str());
@@ -263,15 +307,13 @@ int MnemonicEncode(int nLanguage, const std::vector<uint8_t> &vEntropy, std::str
         i += 11;
     };
 
-    char *pwl = (char*) mnLanguages[nLanguage];
-    int m = mnLanguageLens[nLanguage];
+    const WordList &words = GetWordList(nLanguage);
 
     for (size_t k = 0; k < vWord.size(); ++k)
     {
         int o = vWord[k];
 
-        std::string sWord;
-        if (0 != GetWord(o, pwl, m, sWord))
+        if (o >= (int)words.vWords.size())
         {
             sError = strprintf("Word extract failed %d, language %d.", o, nLanguage);
             return errorN(3, "%s: %s", __func__, sError.c_str());
@@ -279,7 +321,7 @@ int MnemonicEncode(int nLanguage, const std::vector<uint8_t> &vEntropy, std::str
 
         if (sWordList != "")
             sWordList += " ";
-        sWordList += sWord;
+        sWordList += words.vWords[o];
     };
 
     if (nLanguage == WLL_JAPANESE)
@@ -298,7 +340,7 @@ int MnemonicDecode(int nLanguage, const std::string &sWordListIn, std::vector<ui
     if (nLanguage == -1)
         nLanguage = MnemonicDetectLanguage(sWordList);
 
-    if (nLanguage < 1 || nLanguage > WLL_MAX)
+    if (nLanguage < 1 || nLanguage >= WLL_MAX)
     {
         sError = "Unknown language.";
         return errorN(1, "%s: %s", __func__, sError.c_str());
@@ -315,8 +357,7 @@ int MnemonicDecode(int nLanguage, const std::string &sWordListIn, std::vector<ui
 
     strcpy(tmp, sWordList.c_str());
 
-    char *pwl = (char*) mnLanguages[nLanguage];
-    int m = mnLanguageLens[nLanguage];
+    const WordList &words = GetWordList(nLanguage);
 
     std::vector<int> vWordInts;
 
@@ -325,7 +366,7 @@ int MnemonicDecode(int nLanguage, const std::string &sWordListIn, std::vector<ui
     while (p != nullptr)
     {
         int ofs;
-        if (0 != GetWordOffset(p, pwl, m, ofs))
+        if (!FindWordOffset(words, p, ofs))
         {
             sError = strprintf("Unknown word: %s", p);
             return errorN(3, "%s: %s", __func__, sError.c_str());
@@ -507,20 +548,20 @@ int MnemonicAddChecksum(int nLanguageIn, const std::string &sWordListIn, std::st
 
 int MnemonicGetWord(int nLanguage, int nWord, std::string &sWord, std::string &sError)
 {
-    if (nLanguage < 1 || nLanguage > WLL_MAX)
+    if (nLanguage < 1 || nLanguage >= WLL_MAX)
     {
         sError = "Unknown language.";
         return errorN(1, "%s: %s", __func__, sError.c_str());
     };
 
-    char *pwl = (char*) mnLanguages[nLanguage];
-    int m = mnLanguageLens[nLanguage];
+    const WordList &words = GetWordList(nLanguage);
 
-    if (0 != GetWord(nWord, pwl, m, sWord))
+    if (nWord < 0 || nWord >= (int)words.vWords.size())
     {
         sError = strprintf("Word extract failed %d, language %d.", nWord, nLanguage);
         return errorN(3, "%s: %s", __func__, sError.c_str());
     };
+    sWord = words.vWords[nWord];
 
     return 0;
 };
@@ -7,17 +7,18 @@
 #include <ghost-address/stealth.h>
 //#include <ghost-address/smsg/smessage.h>
 #include <base58.h>
-#include <crypto/sha256.h>
 #include <ghost-address/keyutil.h>
 #include <key.h>
 #include <pubkey.h>
 #include <random.h>
+#include <primitives/transaction.h>
 #include <script/script.h>
 
 #include <support/allocators/secure.h>
 
 #include <cmath>
 #include <secp256k1.h>
+#include <secp256k1_ecdh.h>
 
 secp256k1_context *secp256k1_ctx_stealth = nullptr;
 
@@ -154,14 +155,9 @@ int StealthShared(const CKey &secret, const ec_point &pubkey, CKey &sharedSOut)
     secp256k1_pubkey Q;
     if (!secp256k1_ec_pubkey_parse(secp256k1_ctx_stealth, &Q, &pubkey[0], EC_COMPRESSED_SIZE))
         return errorN(1, "%s: secp256k1_ec_pubkey_parse Q failed.", __func__);
-    if (!secp256k1_ec_pubkey_tweak_mul(secp256k1_ctx_stealth, &Q, secret.begin())) // eQ
-        return errorN(1, "%s: secp256k1_ec_pubkey_tweak_mul failed.", __func__);
-
-    size_t len = 33;
-    uint8_t tmp33[33];
-    secp256k1_ec_pubkey_serialize(secp256k1_ctx_stealth, tmp33, &len, &Q, SECP256K1_EC_COMPRESSED); // Returns: 1 always.
-
-    CSHA256().Write(tmp33, 33).Finalize(sharedSOut.begin_nc());
+    // H(eQ), the hash of the compressed point is what secp256k1_ecdh returns
+    if (!secp256k1_ecdh(secp256k1_ctx_stealth, sharedSOut.begin_nc(), &Q, secret.begin()))
+        return errorN(1, "%s: secp256k1_ecdh failed.", __func__);
     return 0;
 };
 
@@ -207,15 +203,9 @@ int StealthSecret(const CKey &secret, const ec_point &pubkey, const ec_point &pk
     if (!secp256k1_ec_pubkey_parse(secp256k1_ctx_stealth, &R, &pkSpend[0], EC_COMPRESSED_SIZE))
         return errorN(1, "%s: secp256k1_ec_pubkey_parse R failed.", __func__);
 
-    // eQ
-    if (!secp256k1_ec_pubkey_tweak_mul(secp256k1_ctx_stealth, &Q, secret.begin()))
-        return errorN(1, "%s: secp256k1_ec_pubkey_tweak_mul failed.", __func__);
-
-    size_t len = 33;
-    uint8_t tmp33[33];
-    secp256k1_ec_pubkey_serialize(secp256k1_ctx_stealth, tmp33, &len, &Q, SECP256K1_EC_COMPRESSED); // Returns: 1 always.
-
-    CSHA256().Write(tmp33, 33).Finalize(sharedSOut.begin_nc());
+    // H(eQ)
+    if (!secp256k1_ecdh(secp256k1_ctx_stealth, sharedSOut.begin_nc(), &Q, secret.begin()))
+        return errorN(1, "%s: secp256k1_ecdh failed.", __func__);
 
     //if (!secp256k1_ec_seckey_verify(secp256k1_ctx_stealth, sharedSOut.begin()))
     //    return errorN(1, "%s: secp256k1_ec_seckey_verify failed.", __func__); // Start again with a new ephemeral key
@@ -233,7 +223,7 @@ int StealthSecret(const CKey &secret, const ec_point &pubkey, const ec_point &pk
         return errorN(8, "%s: pkOut.resize %u threw: %s.", __func__, EC_COMPRESSED_SIZE);
     };
 
-    len = 33;
+    size_t len = 33;
     secp256k1_ec_pubkey_serialize(secp256k1_ctx_stealth, &pkOut[0], &len, &R, SECP256K1_EC_COMPRESSED); // Returns: 1 always.
 
     return 0;
@@ -255,16 +245,10 @@ int StealthSecretSpend(const CKey &scanSecret, const ec_point &ephemPubkey, cons
     if (!secp256k1_ec_pubkey_parse(secp256k1_ctx_stealth, &P, &ephemPubkey[0], EC_COMPRESSED_SIZE))
         return errorN(1, "%s: secp256k1_ec_pubkey_parse P failed.", __func__);
 
-    // dP
-    if (!secp256k1_ec_pubkey_tweak_mul(secp256k1_ctx_stealth, &P, scanSecret.begin()))
-        return errorN(1, "%s: secp256k1_ec_pubkey_tweak_mul failed.", __func__);
-
-    size_t len = 33;
-    uint8_t tmp33[33];
+    // H(dP)
     uint8_t tmp32[32];
-    secp256k1_ec_pubkey_serialize(secp256k1_ctx_stealth, tmp33, &len, &P, SECP256K1_EC_COMPRESSED); // Returns: 1 always.
-
-    CSHA256().Write(tmp33, 33).Finalize(tmp32);
+    if (!secp256k1_ecdh(secp256k1_ctx_stealth, tmp32, &P, scanSecret.begin()))
+        return errorN(1, "%s: secp256k1_ecdh failed.", __func__);
 
     if (!secp256k1_ec_seckey_verify(secp256k1_ctx_stealth, tmp32))
         return errorN(1, "%s: secp256k1_ec_seckey_verify failed.", __func__);
@@ -314,6 +298,60 @@ int StealthSharedToPublicKey(const ec_point &pkSpend, const CKey &sharedS, ec_po
     return 0;
 };
 
+int StealthSharedBatch(const CKey &secret, const std::vector<const ec_point*> &vPubkeys, std::vector<CKey> &vSharedOut)
+{
+    vSharedOut.assign(vPubkeys.size(), CKey());
+
+    // Parse the points first, secp256k1_ecdh_batch multiplies them together
+    std::vector<secp256k1_pubkey> vPoints(vPubkeys.size());
+    std::vector<const secp256k1_pubkey*> vpPoints;
+    std::vector<size_t> vIndex;
+    vpPoints.reserve(vPubkeys.size());
+    vIndex.reserve(vPubkeys.size());
+    for (size_t i = 0; i < vPubkeys.size(); ++i)
+    {
+        const ec_point &pubkey = *vPubkeys[i];
+        if (pubkey.size() != EC_COMPRESSED_SIZE
+            || !secp256k1_ec_pubkey_parse(secp256k1_ctx_stealth, &vPoints[i], &pubkey[0], EC_COMPRESSED_SIZE))
+            continue;
+        vpPoints.push_back(&vPoints[i]);
+        vIndex.push_back(i);
+    };
+
+    std::vector<uint8_t, secure_allocator<uint8_t> > vShared(vpPoints.size() * 32);
+    if (vpPoints.empty()
+        || !secp256k1_ecdh_batch(secp256k1_ctx_stealth, vShared.data(), vpPoints.data(), vpPoints.size(), secret.begin()))
+        return 0;
+
+    for (size_t k = 0; k < vIndex.size(); ++k)
+    {
+        CKey &shared = vSharedOut[vIndex[k]];
+        memcpy(shared.begin_nc(), &vShared[k * 32], 32);
+        shared.SetFlags(true, true);
+    };
+
+    return vIndex.size();
+};
+
+bool ExtractStealthData(const CScript &script, ec_point &pkEphem, uint32_t &nPrefix, bool &fHavePrefix)
+{
+    CScript::const_iterator pc = script.begin();
+    opcodetype opcode;
+    std::vector<uint8_t> vData;
+    if (!script.GetOp(pc, opcode) || opcode != OP_RETURN)
+        return false;
+    if (!script.GetOp(pc, opcode, vData) || vData.size() < 1 + EC_COMPRESSED_SIZE || vData[0] != DO_STEALTH)
+        return false;
+
+    pkEphem.assign(vData.begin() + 1, vData.begin() + 1 + EC_COMPRESSED_SIZE);
+
+    size_t o = 1 + EC_COMPRESSED_SIZE;
+    fHavePrefix = vData.size() >= o + 5 && vData[o] == DO_STEALTH_PREFIX;
+    if (fHavePrefix)
+        memcpy(&nPrefix, &vData[o + 1], 4);
+    return true;
+};
+
 bool IsStealthAddress(const std::string &encodedAddress)
 {
     std::vector<uint8_t> raw;
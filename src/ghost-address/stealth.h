@@ -132,6 +132,14 @@ int StealthSharedToSecretSpend(const CKey &sharedS, const CKey &spendSecret, CKe
 
 int StealthSharedToPublicKey(const ec_point &pkSpend, const CKey &sharedS, ec_point &pkOut);
 
+/** StealthShared of one secret with many public keys, sharing the field inversion between them. vSharedOut[i]
+ *  is left invalid for a public key that doesn't parse. Returns the number of shared secrets computed */
+int StealthSharedBatch(const CKey &secret, const std::vector<const ec_point*> &vPubkeys, std::vector<CKey> &vSharedOut);
+
+/** Read the ephemeral public key, and the prefix if there is one, from an OP_RETURN output carrying
+ *  stealth data as MakeStealthData builds it */
+bool ExtractStealthData(const CScript &script, ec_point &pkEphem, uint32_t &nPrefix, bool &fHavePrefix);
+
 bool IsStealthAddress(const std::string &encodedAddress);
 
 inline uint32_t SetStealthMask(uint8_t nBits)
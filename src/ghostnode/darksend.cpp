@@ -4,6 +4,8 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "activeghostnode.h"
+#include "bloom.h"
+#include "checkqueue.h"
 #include "wallet/coincontrol.h"
 #include "consensus/validation.h"
 #include "darksend.h"
@@ -12,14 +14,21 @@
 #include "ghostnode-payments.h"
 #include "ghostnode-sync.h"
 #include "ghostnodeman.h"
+#include "index/collateralindex.h"
+#include "netfulfilledman.h"
 #include "script/sign.h"
 #include "txmempool.h"
 #include "util.h"
 #include "utilmoneystr.h"
 #include "net_processing.h"
 #include "netmessagemaker.h"
+#include "random.h"
+#include "scheduler.h"
+#include "script/sigcache.h"
+#include "validation.h"
 
 #include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
 
 int nPrivateSendRounds = DEFAULT_PRIVATESEND_ROUNDS;
 int nPrivateSendAmount = DEFAULT_PRIVATESEND_AMOUNT;
@@ -32,6 +41,37 @@ CDarkSendSigner darkSendSigner;
 std::map <uint256, CDarksendBroadcastTx> mapDarksendBroadcastTxes;
 std::vector <CAmount> vecPrivateSendDenominations;
 
+namespace {
+CCheckQueue<CSignedMessageCheck> ghostnodesigcheckqueue(128);
+
+/** Hashes whose signature failed a batch check, so that later batches don't verify them again */
+CCriticalSection cs_rejectedSignatures;
+CRollingBloomFilter rejectedSignatures(20000, 0.000001);
+
+/** The last queue with the denomination of it, so that a loop over the index moves on to the next denomination */
+template <typename Index>
+typename Index::const_iterator SkipDenomination(const Index &index, typename Index::const_iterator it)
+{
+    typename Index::const_iterator itLast = index.upper_bound(it->nDenom);
+    return --itLast;
+}
+} // namespace
+
+bool CSignedMessageCheck::operator()() {
+    // Always succeed, a failure would make the queue skip the rest of the batch
+    std::string strError;
+    if (!darkSendSigner.VerifyHash(pubkey, vchSig, hash, strError)) {
+        LOCK(cs_rejectedSignatures);
+        rejectedSignatures.insert(hash);
+    }
+    return true;
+}
+
+void ThreadGhostnodeSigCheck() {
+    RenameThread("nix-gnsigch");
+    ghostnodesigcheckqueue.Thread();
+}
+
 void CDarksendPool::ProcessMessage(CNode *pfrom, std::string &strCommand, CDataStream &vRecv) {
     if (fLiteMode) return; // ignore all Dash related functionality
     if (!ghostnodeSync.IsBlockchainSynced()) return;
@@ -102,9 +142,10 @@ void CDarksendPool::ProcessMessage(CNode *pfrom, std::string &strCommand, CDataS
         vRecv >> dsq;
 
         // process every dsq only once
-        BOOST_FOREACH(CDarksendQueue
-        q, vecDarksendQueue) {
-            if (q == dsq) {
+        const auto &indexByGhostnode = indexDarksendQueue.get<dsq_ghostnode>();
+        auto rangeSeen = indexByGhostnode.equal_range(dsq.vin.prevout);
+        for (auto it = rangeSeen.first; it != rangeSeen.second; ++it) {
+            if (*it == dsq) {
                 // //LogPrint("privatesend", "DSQUEUE -- %s seen\n", dsq.ToString());
                 return;
             }
@@ -136,13 +177,10 @@ void CDarksendPool::ProcessMessage(CNode *pfrom, std::string &strCommand, CDataS
                 SubmitDenominate();
             }
         } else {
-            BOOST_FOREACH(CDarksendQueue
-            q, vecDarksendQueue) {
-                if (q.vin == dsq.vin) {
-                    // no way same mn can send another "not yet ready" dsq this soon
-                    //LogPrint("privatesend", "DSQUEUE -- Ghostnode %s is sending WAY too many dsq messages\n", pmn->addr.ToString());
-                    return;
-                }
+            if (indexByGhostnode.count(dsq.vin.prevout)) {
+                // no way same mn can send another "not yet ready" dsq this soon
+                //LogPrint("privatesend", "DSQUEUE -- Ghostnode %s is sending WAY too many dsq messages\n", pmn->addr.ToString());
+                return;
             }
 
             int nThreshold = pmn->nLastDsq + mnodeman.CountEnabled(MIN_PRIVATESEND_PEER_PROTO_VERSION) / 5;
@@ -160,7 +198,7 @@ void CDarksendPool::ProcessMessage(CNode *pfrom, std::string &strCommand, CDataS
             if (pSubmittedToGhostnode && pSubmittedToGhostnode->vin.prevout == dsq.vin.prevout) {
                 dsq.fTried = true;
             }
-            vecDarksendQueue.push_back(dsq);
+            indexDarksendQueue.insert(dsq);
             dsq.Relay();
         }
 
@@ -801,13 +839,11 @@ void CDarksendPool::CheckTimeout() {
         TRY_LOCK(cs_darksend, lockDS);
         if (!lockDS) return; // it's ok to fail here, we run this quite frequently
 
-        // check mixing queue objects for timeouts
-        std::vector<CDarksendQueue>::iterator it = vecDarksendQueue.begin();
-        while (it != vecDarksendQueue.end()) {
-            if ((*it).IsExpired()) {
-                //LogPrint("privatesend", "CDarksendPool::CheckTimeout -- Removing expired queue (%s)\n", (*it).ToString());
-                it = vecDarksendQueue.erase(it);
-            } else ++it;
+        // check mixing queue objects for timeouts, the oldest come first
+        auto &indexByTime = indexDarksendQueue.get<dsq_time>();
+        while (!indexByTime.empty() && indexByTime.begin()->IsExpired()) {
+            //LogPrint("privatesend", "CDarksendPool::CheckTimeout -- Removing expired queue (%s)\n", indexByTime.begin()->ToString());
+            indexByTime.erase(indexByTime.begin());
         }
     }
 
@@ -1205,6 +1241,7 @@ bool CDarksendPool::SignFinalTransaction(const CTransaction &finalTransactionNew
     //LogPrint("CDarksendPool::SignFinalTransaction -- finalMutableTransaction=%s", finalMutableTransaction.ToString());
 
     std::vector <CTxIn> sigs;
+    std::vector <SignInput> vInputs;
 
     //make sure my inputs/outputs are present, otherwise refuse to sign
     BOOST_FOREACH(
@@ -1254,18 +1291,24 @@ bool CDarksendPool::SignFinalTransaction(const CTransaction &finalTransactionNew
                     return false;
                 }
 
-                const CKeyStore &keystore = *vpwallets.front();
+                // Signed once every entry is checked, SIGHASH_ANYONECANPAY doesn't commit to the other inputs
+                vInputs.emplace_back(nMyInputIndex, prevPubKey, 0, int(SIGHASH_ALL | SIGHASH_ANYONECANPAY));
+            }
+        }
+    }
+
+    if (!vInputs.empty()) {
+        const CKeyStore &keystore = *vpwallets.front();
 
-                //LogPrint("privatesend", "CDarksendPool::SignFinalTransaction -- Signing my input %i\n", nMyInputIndex);
-                CAmount amount;
-                if (!SignSignature(keystore, prevPubKey, finalMutableTransaction, nMyInputIndex, amount, int(SIGHASH_ALL | SIGHASH_ANYONECANPAY))) { // changes scriptSig
-                    //LogPrint("privatesend", "CDarksendPool::SignFinalTransaction -- Unable to sign my own transaction!\n");
-                    // not sure what to do here, it will timeout...?
-                }
+        //LogPrint("privatesend", "CDarksendPool::SignFinalTransaction -- Signing my %d inputs\n", (int) vInputs.size());
+        if (!ProduceSignatures(keystore, finalMutableTransaction, vInputs)) { // changes scriptSig
+            //LogPrint("privatesend", "CDarksendPool::SignFinalTransaction -- Unable to sign my own transaction!\n");
+            // not sure what to do here, it will timeout...?
+        }
 
-                sigs.push_back(finalMutableTransaction.vin[nMyInputIndex]);
-                //LogPrint("privatesend", "CDarksendPool::SignFinalTransaction -- nMyInputIndex: %d, sigs.size(): %d, scriptSig=%s\n", nMyInputIndex, (int) sigs.size(), ScriptToAsmStr(finalMutableTransaction.vin[nMyInputIndex].scriptSig));
-            }
+        for (const SignInput &input : vInputs) {
+            sigs.push_back(finalMutableTransaction.vin[input.nIn]);
+            //LogPrint("privatesend", "CDarksendPool::SignFinalTransaction -- nMyInputIndex: %d, sigs.size(): %d, scriptSig=%s\n", input.nIn, (int) sigs.size(), ScriptToAsmStr(finalMutableTransaction.vin[input.nIn].scriptSig));
         }
     }
 
@@ -1510,9 +1553,13 @@ bool CDarksendPool::DoAutomaticDenominating(bool fDryRun) {
     // don't use the queues all of the time for mixing unless we are a liquidity provider
     if (nLiquidityProvider || fUseQueue) {
 
-        // Look through the queues and see if anything matches
-        BOOST_FOREACH(CDarksendQueue & dsq, vecDarksendQueue)
+        // Look through the queues and see if anything matches, grouped by denomination so that
+        // the coins are selected once for all the queues of a denomination we can't match
+        const auto &indexByDenom = indexDarksendQueue.get<dsq_denom>();
+        for (auto itDsq = indexByDenom.begin(); itDsq != indexByDenom.end(); ++itDsq)
         {
+            const CDarksendQueue &dsq = *itDsq;
+
             // only try each queue once
             if (dsq.fTried) continue;
             dsq.fTried = true;
@@ -1530,11 +1577,12 @@ bool CDarksendPool::DoAutomaticDenominating(bool fDryRun) {
             std::vector<int> vecBits;
             if (!GetDenominationsBits(dsq.nDenom, vecBits)) {
                 // incompatible denom
+                itDsq = SkipDenomination(indexByDenom, itDsq);
                 continue;
             }
 
             // mixing rate limit i.e. nLastDsq check should already pass in DSQUEUE ProcessMessage
-            // in order for dsq to get into vecDarksendQueue, so we should be safe to mix already,
+            // in order for dsq to get into indexDarksendQueue, so we should be safe to mix already,
             // no need for additional verification here
 
             //LogPrint("privatesend", "CDarksendPool::DoAutomaticDenominating -- found valid queue: %s\n", dsq.ToString());
@@ -1546,6 +1594,7 @@ bool CDarksendPool::DoAutomaticDenominating(bool fDryRun) {
             // Try to match their denominations if possible, select at least 1 denominations
             if (!vpwallets.front()->SelectCoinsByDenominations(dsq.nDenom, vecPrivateSendDenominations[vecBits.front()], nBalanceNeedsAnonymized, vecTxInTmp, vCoinsTmp, nValueInTmp, 0, nPrivateSendRounds)) {
                 //LogPrint("CDarksendPool::DoAutomaticDenominating -- Couldn't match denominations %d %d (%s)\n", vecBits.front(), dsq.nDenom, GetDenominationsToString(dsq.nDenom));
+                itDsq = SkipDenomination(indexByDenom, itDsq);
                 continue;
             }
 
@@ -2107,7 +2156,7 @@ bool CDarksendPool::CreateNewSession(int nDenom, CTransaction txCollateral, Pool
         //LogPrint("privatesend", "CDarksendPool::CreateNewSession -- signing and relaying new queue: %s\n", dsq.ToString());
         dsq.Sign();
         dsq.Relay();
-        vecDarksendQueue.push_back(dsq);
+        indexDarksendQueue.insert(dsq);
     }
 
     vecSessionCollaterals.push_back(txCollateral);
@@ -2325,6 +2374,11 @@ bool CDarkSendSigner::IsVinAssociatedWithPubkey(const CTxIn &txin, const CPubKey
     CScript payee;
     payee = GetScriptForDestination(pubkey.GetID());
 
+    // the collateral index answers without reading the transaction from disk
+    CGhostnodeCollateral collateral;
+    if (g_collateralindex && g_collateralindex->GetCollateral(txin.prevout, collateral))
+        return collateral.scriptPubKey == payee;
+
     uint256 hash;
     CTransactionRef txRef;
     if (GetTransaction(txin.prevout.hash, txRef, Params().GetConsensus(), hash, true)) {
@@ -2346,35 +2400,68 @@ bool CDarkSendSigner::GetKeysFromSecret(std::string strSecret, CKey &keyRet, CPu
     return true;
 }
 
-bool CDarkSendSigner::SignMessage(std::string strMessage, std::vector<unsigned char> &vchSigRet, CKey key) {
+uint256 CDarkSendSigner::GetMessageHash(const std::string &strMessage) {
     CHashWriter ss(SER_GETHASH, 0);
     ss << strMessageMagic;
     ss << strMessage;
+    return ss.GetHash();
+}
 
-    return key.SignCompact(ss.GetHash(), vchSigRet);
+bool CDarkSendSigner::SignMessage(std::string strMessage, std::vector<unsigned char> &vchSigRet, CKey key) {
+    return SignHash(GetMessageHash(strMessage), vchSigRet, key);
 }
 
 bool CDarkSendSigner::VerifyMessage(CPubKey pubkey, const std::vector<unsigned char> &vchSig, std::string strMessage, std::string &strErrorRet) {
-    CHashWriter ss(SER_GETHASH, 0);
-    ss << strMessageMagic;
-    ss << strMessage;
-
-    CPubKey pubkeyFromSig;
-    if (!pubkeyFromSig.RecoverCompact(ss.GetHash(), vchSig)) {
-        strErrorRet = "Error recovering public key.";
+    if (!VerifyHash(pubkey, vchSig, GetMessageHash(strMessage), strErrorRet)) {
+        strErrorRet += strprintf(" strMessage=%s", strMessage);
         return false;
     }
+    return true;
+}
+
+bool CDarkSendSigner::SignHash(const uint256 &hash, std::vector<unsigned char> &vchSigRet, const CKey &key) {
+    return key.SignCompact(hash, vchSigRet);
+}
 
-    if (pubkeyFromSig.GetID() != pubkey.GetID()) {
-        strErrorRet = strprintf("Keys don't match: pubkey=%s, pubkeyFromSig=%s, strMessage=%s, vchSig=%s",
-                                pubkey.GetID().ToString(), pubkeyFromSig.GetID().ToString(), strMessage,
-                                EncodeBase64(&vchSig[0], vchSig.size()));
+bool CDarkSendSigner::VerifyHash(const CPubKey &pubkey, const std::vector<unsigned char> &vchSig, const uint256 &hash, std::string &strErrorRet) {
+    CKeyID keyIDFromSig;
+    if (!VerifyCompactSignature(hash, vchSig, pubkey.GetID(), &keyIDFromSig)) {
+        if (keyIDFromSig.IsNull()) {
+            strErrorRet = "Error recovering public key.";
+        } else {
+            strErrorRet = strprintf("Keys don't match: pubkey=%s, pubkeyFromSig=%s, hash=%s, vchSig=%s",
+                                    pubkey.GetID().ToString(), keyIDFromSig.ToString(), hash.ToString(),
+                                    EncodeBase64(vchSig.data(), vchSig.size()));
+        }
         return false;
     }
-
     return true;
 }
 
+bool CDarkSendSigner::IsVerifiedHash(const CPubKey& pubkey, const std::vector<unsigned char>& vchSig, const uint256& hash) {
+    return IsCachedCompactSignature(hash, vchSig, pubkey.GetID());
+}
+
+bool CDarkSendSigner::IsRejectedHash(const uint256& hash) {
+    LOCK(cs_rejectedSignatures);
+    return rejectedSignatures.contains(hash);
+}
+
+void CDarkSendSigner::VerifyMessages(std::vector<CSignedMessageCheck>& vChecks) {
+    // Skip the signatures that failed before, every message still queued would otherwise verify them again
+    {
+        LOCK(cs_rejectedSignatures);
+        vChecks.erase(std::remove_if(vChecks.begin(), vChecks.end(), [](const CSignedMessageCheck& check) {
+            return rejectedSignatures.contains(check.GetHash());
+        }), vChecks.end());
+    }
+
+    // Results end up in the cache, invalid signatures are reported when their message is processed
+    CCheckQueueControl<CSignedMessageCheck> control(nScriptCheckThreads ? &ghostnodesigcheckqueue : NULL);
+    control.Add(vChecks);
+    control.Wait();
+}
+
 bool CDarkSendEntry::AddScriptSig(const CTxIn &txin) {
     BOOST_FOREACH(CTxDSIn & txdsin, vecTxDSIn)
     {
@@ -2516,58 +2603,79 @@ void CDarksendPool::UpdatedBlockTip(const CBlockIndex *pindex) {
 }
 
 //TODO: Rename/move to core
-void ThreadCheckDarkSendPool() {
-    if (fLiteMode) return; // disable all Dash specific functionality
-
-    static bool fOneThread;
-    if (fOneThread) return;
-    fOneThread = true;
-
-    // Make this thread recognisable as the PrivateSend thread
-    RenameThread("dash-privatesend");
+/** Ghostnode maintenance only runs once the blockchain is synced */
+static bool IsGhostnodeMaintenanceDue() {
+    return ghostnodeSync.IsBlockchainSynced() && !ShutdownRequested();
+}
 
-    unsigned int nTick = 0;
-    unsigned int nDoAutoNextRun = nTick + PRIVATESEND_AUTO_TIMEOUT_MIN;
+static void CheckGhostnodes() {
+    if (!IsGhostnodeMaintenanceDue()) return;
+    mnodeman.Check();
+}
 
-    while (true) {
-        MilliSleep(1000);
+static void ManageActiveGhostnode() {
+    if (!IsGhostnodeMaintenanceDue()) return;
+    activeGhostnode.ManageState();
+}
 
-        // try to sync from all available nodes, one step at a time
-        ghostnodeSync.ProcessTick();
+static void StartManageActiveGhostnode(CScheduler* pscheduler) {
+    // wait for the blockchain, then check if we should activate or ping every few minutes
+    if (!IsGhostnodeMaintenanceDue()) {
+        pscheduler->scheduleFromNow(boost::bind(&StartManageActiveGhostnode, pscheduler), 1000, "ghostnode");
+        return;
+    }
+    activeGhostnode.ManageState();
+    pscheduler->scheduleEvery(&ManageActiveGhostnode, GHOSTNODE_MIN_MNP_SECONDS * 1000, "ghostnode");
+}
 
-        if (ghostnodeSync.IsBlockchainSynced() && !ShutdownRequested()) {
+static void CheckAndRemoveGhostnodes() {
+    if (!IsGhostnodeMaintenanceDue()) return;
+    mnodeman.ProcessGhostnodeConnections();
+    mnodeman.CheckAndRemove();
+    mnpayments.AuditPaidBlocks();
+    mnpayments.CheckAndRemove();
+    instantsend.CheckAndRemove();
+    netfulfilledman.CheckAndRemove();
+}
 
-            nTick++;
+static void DoFullVerificationStep() {
+    if (!IsGhostnodeMaintenanceDue()) return;
+    mnodeman.DoFullVerificationStep();
+}
 
-            // make sure to check all ghostnodes first
-            mnodeman.Check();
+static void CheckDarkSendPool() {
+    if (!IsGhostnodeMaintenanceDue()) return;
+    darkSendPool.CheckTimeout();
+    darkSendPool.CheckForCompleteQueue();
+}
 
-            // check if we should activate or ping every few minutes,
-            // slightly postpone first run to give net thread a chance to connect to some peers
-            if (nTick % GHOSTNODE_MIN_MNP_SECONDS == 15)
-                activeGhostnode.ManageState();
+static void DoAutomaticDenominating(CScheduler* pscheduler) {
+    if (IsGhostnodeMaintenanceDue()) {
+        darkSendPool.DoAutomaticDenominating();
+    }
+    int nDelay = PRIVATESEND_AUTO_TIMEOUT_MIN + GetRandInt(PRIVATESEND_AUTO_TIMEOUT_MAX - PRIVATESEND_AUTO_TIMEOUT_MIN);
+    pscheduler->scheduleFromNow(boost::bind(&DoAutomaticDenominating, pscheduler), nDelay * 1000, "ghostnode");
+}
 
-            if (nTick % 60 == 0) {
-                mnodeman.ProcessGhostnodeConnections();
-                mnodeman.CheckAndRemove();
-                mnpayments.CheckAndRemove();
-                instantsend.CheckAndRemove();
-            }
-            if (fGhostNode && (nTick % (60 * 5) == 0)) {
-                mnodeman.DoFullVerificationStep();
-            }
+void ScheduleDarkSendMaintenance(CScheduler& scheduler) {
+    if (fLiteMode) return; // disable all Dash specific functionality
 
-//            if(nTick % (60 * 5) == 0) {
-//                governance.DoMaintenance();
-//            }
+    // try to sync from all available nodes, one step at a time
+    ghostnodeSync.ScheduleTicks(scheduler);
 
-            darkSendPool.CheckTimeout();
-            darkSendPool.CheckForCompleteQueue();
+    // The maintenance tasks share the "ghostnode" task class, so they never run in parallel
+    // with each other, while other tasks can run on the other scheduler threads
 
-            if (nDoAutoNextRun == nTick) {
-                darkSendPool.DoAutomaticDenominating();
-                nDoAutoNextRun = nTick + PRIVATESEND_AUTO_TIMEOUT_MIN + GetRandInt(PRIVATESEND_AUTO_TIMEOUT_MAX - PRIVATESEND_AUTO_TIMEOUT_MIN);
-            }
-        }
+    // make sure to check all ghostnodes first
+    scheduler.scheduleEvery(&CheckGhostnodes, GHOSTNODE_CHECK_SECONDS * 1000, "ghostnode");
+    // slightly postpone first run to give net thread a chance to connect to some peers
+    scheduler.scheduleFromNow(boost::bind(&StartManageActiveGhostnode, &scheduler), 15 * 1000, "ghostnode");
+    scheduler.scheduleEvery(&CheckAndRemoveGhostnodes, 60 * 1000, "ghostnode");
+    if (fGhostNode) {
+        scheduler.scheduleEvery(&DoFullVerificationStep, 60 * 5 * 1000, "ghostnode");
     }
+    scheduler.scheduleEvery(&DumpGhostnodes, GHOSTNODE_CACHE_FLUSH_SECONDS * 1000, "ghostnode");
+
+    scheduler.scheduleEvery(&CheckDarkSendPool, 1000, "ghostnode");
+    scheduler.scheduleFromNow(boost::bind(&DoAutomaticDenominating, &scheduler), PRIVATESEND_AUTO_TIMEOUT_MIN * 1000, "ghostnode");
 }
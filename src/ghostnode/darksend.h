@@ -9,6 +9,9 @@
 #include "ghostnode.h"
 #include "wallet/wallet.h"
 #include <boost/foreach.hpp>
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/member.hpp>
 
 class CDarksendPool;
 class CDarkSendSigner;
@@ -138,8 +141,8 @@ public:
     int64_t nTime;
     bool fReady; //ready for submit
     std::vector<unsigned char> vchSig;
-    // memory only
-    bool fTried;
+    // memory only, not part of the queue index keys
+    mutable bool fTried;
 
     CDarksendQueue() :
         nDenom(0),
@@ -184,7 +187,7 @@ public:
     bool Relay();
 
     /// Is this queue expired?
-    bool IsExpired() { return GetTime() - nTime > PRIVATESEND_QUEUE_TIMEOUT; }
+    bool IsExpired() const { return GetTime() - nTime > PRIVATESEND_QUEUE_TIMEOUT; }
 
     std::string ToString()
     {
@@ -198,6 +201,40 @@ public:
     }
 };
 
+// CDarksendQueueIndex tag names
+struct dsq_ghostnode {};
+struct dsq_denom {};
+struct dsq_time {};
+
+/** Extracts the outpoint of the ghostnode that announced a queue */
+struct DarksendQueueOutPoint
+{
+    typedef COutPoint result_type;
+    const result_type& operator()(const CDarksendQueue& dsq) const { return dsq.vin.prevout; }
+};
+
+/**
+ * The mixing queues announced on the network, indexed by ghostnode outpoint for the DSQUEUE
+ * duplicate and rate checks, by denomination for session matching and by time for expiry.
+ */
+typedef boost::multi_index_container<
+    CDarksendQueue,
+    boost::multi_index::indexed_by<
+        boost::multi_index::ordered_non_unique<
+            boost::multi_index::tag<dsq_ghostnode>,
+            DarksendQueueOutPoint
+        >,
+        boost::multi_index::ordered_non_unique<
+            boost::multi_index::tag<dsq_denom>,
+            boost::multi_index::member<CDarksendQueue, int, &CDarksendQueue::nDenom>
+        >,
+        boost::multi_index::ordered_non_unique<
+            boost::multi_index::tag<dsq_time>,
+            boost::multi_index::member<CDarksendQueue, int64_t, &CDarksendQueue::nTime>
+        >
+    >
+> CDarksendQueueIndex;
+
 /** Helper class to store mixing transaction (tx) information.
  */
 class CDarksendBroadcastTx
@@ -236,6 +273,33 @@ public:
     bool CheckSignature(const CPubKey& pubKeyGhostnode);
 };
 
+/** A message signature to be verified on a ghostnode signature check thread */
+class CSignedMessageCheck
+{
+private:
+    CPubKey pubkey;
+    std::vector<unsigned char> vchSig;
+    uint256 hash;
+
+public:
+    CSignedMessageCheck() {}
+    CSignedMessageCheck(const CPubKey& pubkeyIn, const std::vector<unsigned char>& vchSigIn, const uint256& hashIn) :
+        pubkey(pubkeyIn), vchSig(vchSigIn), hash(hashIn) {}
+
+    bool operator()();
+
+    const uint256& GetHash() const { return hash; }
+
+    void swap(CSignedMessageCheck& check) {
+        std::swap(pubkey, check.pubkey);
+        vchSig.swap(check.vchSig);
+        std::swap(hash, check.hash);
+    }
+};
+
+/** Run an instance of the ghostnode signature checking thread */
+void ThreadGhostnodeSigCheck();
+
 /** Helper object for signing and checking signatures
  */
 class CDarkSendSigner
@@ -245,10 +309,22 @@ public:
     bool IsVinAssociatedWithPubkey(const CTxIn& vin, const CPubKey& pubkey);
     /// Set the private/public key values, returns true if successful
     bool GetKeysFromSecret(std::string strSecret, CKey& keyRet, CPubKey& pubkeyRet);
+    /// The hash SignMessage signs for a message
+    static uint256 GetMessageHash(const std::string& strMessage);
     /// Sign the message, returns true if successful
     bool SignMessage(std::string strMessage, std::vector<unsigned char>& vchSigRet, CKey key);
     /// Verify the message, returns true if succcessful
     bool VerifyMessage(CPubKey pubkey, const std::vector<unsigned char>& vchSig, std::string strMessage, std::string& strErrorRet);
+    /// Sign a hash directly, for the binary message format of SPORK_6_NEW_SIGS
+    bool SignHash(const uint256& hash, std::vector<unsigned char>& vchSigRet, const CKey& key);
+    /// Verify a signature of a hash, returns true if succcessful
+    bool VerifyHash(const CPubKey& pubkey, const std::vector<unsigned char>& vchSig, const uint256& hash, std::string& strErrorRet);
+    /// Has this signature been verified already?
+    bool IsVerifiedHash(const CPubKey& pubkey, const std::vector<unsigned char>& vchSig, const uint256& hash);
+    /// Has a signature of this hash recently failed a batch check?
+    bool IsRejectedHash(const uint256& hash);
+    /// Verify a batch of messages on the signature check threads so that VerifyMessage() finds them verified later
+    void VerifyMessages(std::vector<CSignedMessageCheck>& vChecks);
 };
 
 
@@ -306,7 +382,7 @@ private:
     mutable CCriticalSection cs_darksend;
 
     // The current mixing sessions in progress on the network
-    std::vector<CDarksendQueue> vecDarksendQueue;
+    CDarksendQueueIndex indexDarksendQueue;
     // Keep track of the used Ghostnodes
     std::vector<CTxIn> vecGhostnodesUsed;
 
@@ -461,7 +537,7 @@ public:
 
     void UnlockCoins();
 
-    int GetQueueSize() const { return vecDarksendQueue.size(); }
+    int GetQueueSize() const { return indexDarksendQueue.size(); }
     int GetState() const { return nState; }
     std::string GetStateString() const;
     std::string GetStatus();
@@ -480,6 +556,7 @@ public:
     void UpdatedBlockTip(const CBlockIndex *pindex);
 };
 
-void ThreadCheckDarkSendPool();
+/** Run the ghostnode sync, ghostnode list maintenance and PrivateSend timers on the scheduler */
+void ScheduleDarkSendMaintenance(CScheduler& scheduler);
 
 #endif
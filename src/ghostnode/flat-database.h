@@ -226,5 +226,148 @@ public:
 
 };
 
+/**
+*   Record based Dumping and Loading
+*   --------------------------------
+*   The file starts with the magic message, the network magic number and the format version,
+*   followed by one record per object: its size, its data and a hash of the data. Records are
+*   verified one by one, so a corrupted record only loses that object and a truncated tail only
+*   loses the objects after it. The whole file is read with one call. Writes go to a temporary
+*   file that replaces the old one, so a crash while writing keeps the previous snapshot.
+*/
+
+template<typename R>
+class CRecordDB
+{
+private:
+    static const uint32_t FORMAT_VERSION = 1;
+
+    boost::filesystem::path pathDB;
+    std::string strFilename;
+    std::string strMagicMessage;
+
+public:
+    CRecordDB(std::string strFilenameIn, std::string strMagicMessageIn)
+    {
+        pathDB = GetDataDir() / strFilenameIn;
+        strFilename = strFilenameIn;
+        strMagicMessage = strMagicMessageIn;
+    }
+
+    bool Write(const std::vector<R>& vRecords)
+    {
+        int64_t nStart = GetTimeMillis();
+
+        CDataStream ssObj(SER_DISK, CLIENT_VERSION);
+        ssObj << strMagicMessage; // specific magic message for this type of object
+        ssObj << FLATDATA(Params().MessageStart()); // network specific magic number
+        ssObj << FORMAT_VERSION;
+
+        CDataStream ssRecord(SER_DISK, CLIENT_VERSION);
+        for (const R& record : vRecords) {
+            ssRecord.clear();
+            ssRecord << record;
+            ssObj << (uint32_t)ssRecord.size();
+            ssObj.write(ssRecord.data(), ssRecord.size());
+            ssObj << Hash(ssRecord.begin(), ssRecord.end());
+        }
+
+        boost::filesystem::path pathTmp = pathDB;
+        pathTmp += ".new";
+        FILE *file = fopen(pathTmp.string().c_str(), "wb");
+        CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+        if (fileout.IsNull())
+            return error("%s: Failed to open file %s", __func__, pathTmp.string());
+
+        try {
+            fileout.write(ssObj.data(), ssObj.size());
+            FileCommit(fileout.Get());
+        }
+        catch (std::exception &e) {
+            return error("%s: Serialize or I/O error - %s", __func__, e.what());
+        }
+        fileout.fclose();
+
+        if (!RenameOver(pathTmp, pathDB))
+            return error("%s: Rename-into-place failed", __func__);
+
+        LogPrintf("Written %u records to %s  %dms\n", vRecords.size(), strFilename, GetTimeMillis() - nStart);
+        return true;
+    }
+
+    bool Read(std::vector<R>& vRecords)
+    {
+        int64_t nStart = GetTimeMillis();
+        vRecords.clear();
+
+        FILE *file = fopen(pathDB.string().c_str(), "rb");
+        CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull()) {
+            LogPrintf("Missing file %s, will try to recreate\n", strFilename);
+            return false;
+        }
+
+        CDataStream ssObj(SER_DISK, CLIENT_VERSION);
+        try {
+            ssObj.resize(boost::filesystem::file_size(pathDB));
+            filein.read(ssObj.data(), ssObj.size());
+        }
+        catch (std::exception &e) {
+            return error("%s: I/O error - %s", __func__, e.what());
+        }
+        filein.fclose();
+
+        unsigned char pchMsgTmp[4];
+        std::string strMagicMessageTmp;
+        uint32_t nVersion;
+        try {
+            ssObj >> strMagicMessageTmp >> FLATDATA(pchMsgTmp) >> nVersion;
+        }
+        catch (std::exception &e) {
+            return error("%s: Invalid header - %s", __func__, e.what());
+        }
+        if (strMagicMessage != strMagicMessageTmp)
+            return error("%s: Invalid magic message", __func__);
+        if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
+            return error("%s: Invalid network magic number", __func__);
+        if (nVersion != FORMAT_VERSION)
+            return error("%s: Unknown format version %u", __func__, nVersion);
+
+        size_t nCorrupted = 0;
+        while (ssObj.size() >= sizeof(uint32_t)) {
+            uint32_t nSize;
+            ssObj >> nSize;
+            if (ssObj.size() < (size_t)nSize + sizeof(uint256)) {
+                LogPrintf("%s: Truncated record in %s\n", __func__, strFilename);
+                break;
+            }
+            const char* pbegin = ssObj.data();
+            uint256 hashRecord = Hash(pbegin, pbegin + nSize);
+            R record;
+            bool fValid = memcmp(hashRecord.begin(), pbegin + nSize, sizeof(uint256)) == 0;
+            if (fValid) {
+                try {
+                    CDataStream ssRecord(pbegin, pbegin + nSize, SER_DISK, CLIENT_VERSION);
+                    ssRecord >> record;
+                    fValid = ssRecord.empty();
+                }
+                catch (std::exception &e) {
+                    fValid = false;
+                }
+            }
+            ssObj.ignore(nSize + sizeof(uint256));
+            if (fValid) {
+                vRecords.push_back(record);
+            } else {
+                nCorrupted++;
+            }
+        }
+
+        LogPrintf("Loaded %u records from %s  %dms\n", vRecords.size(), strFilename, GetTimeMillis() - nStart);
+        if (nCorrupted)
+            LogPrintf("%s: Skipped %u corrupted records in %s\n", __func__, nCorrupted, strFilename);
+        return true;
+    }
+};
 
 #endif
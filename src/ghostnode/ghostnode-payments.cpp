@@ -6,9 +6,12 @@
 #include "activeghostnode.h"
 #include "darksend.h"
 #include "ghostnode-payments.h"
+#include "ghostnode-stats.h"
 #include "ghostnode-sync.h"
 #include "ghostnodeman.h"
+#include "core_memusage.h"
 #include "netfulfilledman.h"
+#include "seeninventory.h"
 #include "spork.h"
 #include "util.h"
 #include "netmessagemaker.h"
@@ -116,6 +119,18 @@ void CGhostnodePayments::Clear() {
     LOCK2(cs_mapGhostnodeBlocks, cs_mapGhostnodePaymentVotes);
     mapGhostnodeBlocks.clear();
     mapGhostnodePaymentVotes.clear();
+    mapPaymentVotesByHeight.clear();
+    ghostnodeSeenInventory.Clear(MSG_GHOSTNODE_PAYMENT_VOTE);
+    ClearPaidIndex();
+}
+
+void CGhostnodePayments::AddSeenPaymentVote(const uint256& hash, const CGhostnodePaymentVote& vote) {
+    AssertLockHeld(cs_mapGhostnodePaymentVotes);
+    if (!mapGhostnodePaymentVotes.count(hash)) {
+        mapPaymentVotesByHeight.insert(std::make_pair(vote.nBlockHeight, hash));
+        ghostnodeSeenInventory.Add(MSG_GHOSTNODE_PAYMENT_VOTE, hash);
+    }
+    mapGhostnodePaymentVotes[hash] = vote;
 }
 
 bool CGhostnodePayments::CanVote(COutPoint outGhostnode, int nBlockHeight) {
@@ -197,6 +212,8 @@ void CGhostnodePayments::ProcessMessage(CNode *pfrom, std::string &strCommand, C
 
     if (fLiteMode) return; // disable all Dash specific functionality
 
+    CGhostnodeStatsTimer timer(GHOSTNODE_STATS_DURATION, "CGhostnodePayments::ProcessMessage");
+
     if (strCommand == NetMsgType::GHOSTNODEPAYMENTSYNC) { //Ghostnode Payments Request Sync
 
         // Ignore such requests until we are fully synced.
@@ -207,13 +224,13 @@ void CGhostnodePayments::ProcessMessage(CNode *pfrom, std::string &strCommand, C
         int nCountNeeded;
         vRecv >> nCountNeeded;
 
-        if (netfulfilledman.HasFulfilledRequest(pfrom->addr, NetMsgType::GHOSTNODEPAYMENTSYNC)) {
+        if (netfulfilledman.HasFulfilledRequest(pfrom->addr, FULFILLED_GHOSTNODE_PAYMENT_SYNC_REQUEST)) {
             // Asking for the payments list multiple times in a short period of time is no good
-            LogPrintf("GHOSTNODEPAYMENTSYNC -- peer already asked me for the list\n");
+            LogPrint(BCLog::GHOSTNODE, "GHOSTNODEPAYMENTSYNC -- peer already asked me for the list\n");
             Misbehaving(pfrom->GetId(), 20);
             return;
         }
-        netfulfilledman.AddFulfilledRequest(pfrom->addr, NetMsgType::GHOSTNODEPAYMENTSYNC);
+        netfulfilledman.AddFulfilledRequest(pfrom->addr, FULFILLED_GHOSTNODE_PAYMENT_SYNC_REQUEST);
 
         Sync(pfrom);
         //LogPrintf("mnpayments GHOSTNODEPAYMENTSYNC -- Sent Ghostnode payment votes to peer \n");
@@ -225,95 +242,150 @@ void CGhostnodePayments::ProcessMessage(CNode *pfrom, std::string &strCommand, C
 
         if (pfrom->nVersion < GetMinGhostnodePaymentsProto()) return;
 
-        if (!pCurrentBlockIndex) return;
+        ProcessPaymentVote(pfrom, vote);
 
-        uint256 nHash = vote.GetHash();
+    } else if (strCommand == NetMsgType::GHOSTNODEPAYMENTVOTES) { // Ghostnode Payments Votes sent on sync
 
-        pfrom->setAskFor.erase(nHash);
+        std::vector<CGhostnodePaymentVote> vecVotes;
+        vRecv >> vecVotes;
 
-        {
-            LOCK(cs_mapGhostnodePaymentVotes);
-            if (mapGhostnodePaymentVotes.count(nHash)) {
-                //LogPrintf("mnpayments GHOSTNODEPAYMENTVOTE -- nHeight=%d seen\n", pCurrentBlockIndex->nHeight);
-                return;
-            }
-
-            // Avoid processing same vote multiple times
-            mapGhostnodePaymentVotes[nHash] = vote;
-            // but first mark vote as non-verified,
-            // AddPaymentVote() below should take care of it if vote is actually ok
-            mapGhostnodePaymentVotes[nHash].MarkAsNotVerified();
-        }
+        if (pfrom->nVersion < GetMinGhostnodePaymentsProto()) return;
 
-        int nFirstBlock = pCurrentBlockIndex->nHeight - GetStorageLimit();
-        if (vote.nBlockHeight < nFirstBlock || vote.nBlockHeight > pCurrentBlockIndex->nHeight + 20) {
-            LogPrintf("mnpaymentsGHOSTNODEPAYMENTVOTE -- vote out of range: nFirstBlock=%d, nBlockHeight=%d, nHeight=%d\n", nFirstBlock, vote.nBlockHeight, pCurrentBlockIndex->nHeight);
+        if (vecVotes.size() > MAX_PAYMENT_VOTES_PER_MESSAGE) {
+            LogPrint(BCLog::GHOSTNODE, "GHOSTNODEPAYMENTVOTES -- too many votes: %d\n", vecVotes.size());
+            Misbehaving(pfrom->GetId(), 20);
             return;
         }
 
-        std::string strError = "";
-        if (!vote.IsValid(pfrom, pCurrentBlockIndex->nHeight, strError)) {
-            LogPrintf("mnpayments GHOSTNODEPAYMENTVOTE -- invalid message, error: %s\n", strError);
-            return;
+        // verify the signatures of the new votes at once on the signature check threads,
+        // ProcessPaymentVote() then finds them in the signature cache
+        std::vector<CSignedMessageCheck> vChecks;
+        bool fNewSigs = sporkManager.IsSporkActive(SPORK_6_NEW_SIGS);
+        BOOST_FOREACH(const CGhostnodePaymentVote& vote, vecVotes) {
+            {
+                LOCK(cs_mapGhostnodePaymentVotes);
+                if (mapGhostnodePaymentVotes.count(vote.GetHash())) continue;
+            }
+            ghostnode_info_t mnInfo = mnodeman.GetGhostnodeInfo(vote.vinGhostnode);
+            if (mnInfo.fInfoValid) {
+                vChecks.push_back(CSignedMessageCheck(mnInfo.pubKeyGhostnode, vote.vchSig, vote.GetSignatureHash(fNewSigs)));
+            }
         }
+        darkSendSigner.VerifyMessages(vChecks);
 
-        if (!CanVote(vote.vinGhostnode.prevout, vote.nBlockHeight)) {
-            LogPrintf("GHOSTNODEPAYMENTVOTE -- ghostnode already voted, ghostnode\n");
-            return;
+        BOOST_FOREACH(CGhostnodePaymentVote& vote, vecVotes) {
+            ProcessPaymentVote(pfrom, vote);
         }
+    }
+}
 
-        ghostnode_info_t mnInfo = mnodeman.GetGhostnodeInfo(vote.vinGhostnode);
-        if (!mnInfo.fInfoValid) {
-            // mn was not found, so we can't check vote, some info is probably missing
-            LogPrintf("GHOSTNODEPAYMENTVOTE -- ghostnode is missing \n");
-            mnodeman.AskForMN(pfrom, vote.vinGhostnode);
-            return;
-        }
+void CGhostnodePayments::ProcessPaymentVote(CNode *pfrom, CGhostnodePaymentVote &vote) {
+    if (!pCurrentBlockIndex) return;
 
-        int nDos = 0;
-        if (!vote.CheckSignature(mnInfo.pubKeyGhostnode, pCurrentBlockIndex->nHeight, nDos)) {
-            if (nDos) {
-                LogPrintf("GHOSTNODEPAYMENTVOTE -- ERROR: invalid signature\n");
-                Misbehaving(pfrom->GetId(), nDos);
-            } else {
-                // only warn about anything non-critical (i.e. nDos == 0) in debug mode
-                LogPrintf("mnpayments GHOSTNODEPAYMENTVOTE -- WARNING: invalid signature\n");
-            }
-            // Either our info or vote info could be outdated.
-            // In case our info is outdated, ask for an update,
-            mnodeman.AskForMN(pfrom, vote.vinGhostnode);
-            // but there is nothing we can do if vote info itself is outdated
-            // (i.e. it was signed by a mn which changed its key),
-            // so just quit here.
+    uint256 nHash = vote.GetHash();
+
+    {
+        LOCK(cs_main);
+        pfrom->setAskFor.erase(nHash);
+    }
+    pfrom->AddInventoryKnown(CInv(MSG_GHOSTNODE_PAYMENT_VOTE, nHash));
+
+    {
+        LOCK(cs_mapGhostnodePaymentVotes);
+        if (mapGhostnodePaymentVotes.count(nHash)) {
+            //LogPrintf("mnpayments GHOSTNODEPAYMENTVOTE -- nHeight=%d seen\n", pCurrentBlockIndex->nHeight);
             return;
         }
 
-        CTxDestination address1;
-        ExtractDestination(vote.payee, address1);
-        CBitcoinAddress address2(address1);
+        // Avoid processing same vote multiple times
+        AddSeenPaymentVote(nHash, vote);
+        // but first mark vote as non-verified,
+        // AddPaymentVote() below should take care of it if vote is actually ok
+        mapGhostnodePaymentVotes[nHash].MarkAsNotVerified();
+    }
 
-        //LogPrintf("mnpayments GHOSTNODEPAYMENTVOTE -- vote: address=%s, nBlockHeight=%d, nHeight=%d, prevout=%s\n", address2.ToString(), vote.nBlockHeight, pCurrentBlockIndex->nHeight, vote.vinGhostnode.prevout.ToStringShort());
+    int nFirstBlock = pCurrentBlockIndex->nHeight - GetStorageLimit();
+    if (vote.nBlockHeight < nFirstBlock || vote.nBlockHeight > pCurrentBlockIndex->nHeight + 20) {
+        LogPrint(BCLog::GHOSTNODE, "mnpaymentsGHOSTNODEPAYMENTVOTE -- vote out of range: nFirstBlock=%d, nBlockHeight=%d, nHeight=%d\n", nFirstBlock, vote.nBlockHeight, pCurrentBlockIndex->nHeight);
+        return;
+    }
+
+    std::string strError = "";
+    if (!vote.IsValid(pfrom, pCurrentBlockIndex->nHeight, strError)) {
+        LogPrint(BCLog::GHOSTNODE, "mnpayments GHOSTNODEPAYMENTVOTE -- invalid message, error: %s\n", strError);
+        return;
+    }
 
-        if (AddPaymentVote(vote)) {
-            vote.Relay();
-            ghostnodeSync.AddedPaymentVote();
+    if (!CanVote(vote.vinGhostnode.prevout, vote.nBlockHeight)) {
+        LogPrint(BCLog::GHOSTNODE, "GHOSTNODEPAYMENTVOTE -- ghostnode already voted, ghostnode\n");
+        return;
+    }
+
+    ghostnode_info_t mnInfo = mnodeman.GetGhostnodeInfo(vote.vinGhostnode);
+    if (!mnInfo.fInfoValid) {
+        // mn was not found, so we can't check vote, some info is probably missing
+        LogPrint(BCLog::GHOSTNODE, "GHOSTNODEPAYMENTVOTE -- ghostnode is missing \n");
+        mnodeman.AskForMN(pfrom, vote.vinGhostnode);
+        return;
+    }
+
+    int nDos = 0;
+    if (!vote.CheckSignature(mnInfo.pubKeyGhostnode, pCurrentBlockIndex->nHeight, nDos)) {
+        if (nDos) {
+            LogPrintf("GHOSTNODEPAYMENTVOTE -- ERROR: invalid signature\n");
+            Misbehaving(pfrom->GetId(), nDos);
+        } else {
+            // only warn about anything non-critical (i.e. nDos == 0) in debug mode
+            LogPrint(BCLog::GHOSTNODE, "mnpayments GHOSTNODEPAYMENTVOTE -- WARNING: invalid signature\n");
         }
+        // Either our info or vote info could be outdated.
+        // In case our info is outdated, ask for an update,
+        mnodeman.AskForMN(pfrom, vote.vinGhostnode);
+        // but there is nothing we can do if vote info itself is outdated
+        // (i.e. it was signed by a mn which changed its key),
+        // so just quit here.
+        return;
+    }
+
+    CTxDestination address1;
+    ExtractDestination(vote.payee, address1);
+    CBitcoinAddress address2(address1);
+
+    //LogPrintf("mnpayments GHOSTNODEPAYMENTVOTE -- vote: address=%s, nBlockHeight=%d, nHeight=%d, prevout=%s\n", address2.ToString(), vote.nBlockHeight, pCurrentBlockIndex->nHeight, vote.vinGhostnode.prevout.ToStringShort());
+
+    if (AddPaymentVote(vote)) {
+        vote.Relay();
+        ghostnodeSync.AddedPaymentVote();
     }
 }
 
+std::string CGhostnodePaymentVote::GetStrMessage() const {
+    return vinGhostnode.prevout.ToStringShort() +
+           boost::lexical_cast<std::string>(nBlockHeight) +
+           ScriptToAsmStr(payee);
+}
+
+uint256 CGhostnodePaymentVote::GetSignatureHash(bool fNewSigs) const {
+    if (!fNewSigs) return CDarkSendSigner::GetMessageHash(GetStrMessage());
+
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << vinGhostnode.prevout;
+    ss << nBlockHeight;
+    ss << *(CScriptBase*)(&payee);
+    return ss.GetHash();
+}
+
 bool CGhostnodePaymentVote::Sign() {
     std::string strError;
-    std::string strMessage = vinGhostnode.prevout.ToStringShort() +
-                             boost::lexical_cast<std::string>(nBlockHeight) +
-                             ScriptToAsmStr(payee);
+    uint256 hash = GetSignatureHash(sporkManager.IsSporkActive(SPORK_6_NEW_SIGS));
 
-    if (!darkSendSigner.SignMessage(strMessage, vchSig, activeGhostnode.keyGhostnode)) {
-        //LogPrint("CGhostnodePaymentVote::Sign -- SignMessage() failed\n");
+    if (!darkSendSigner.SignHash(hash, vchSig, activeGhostnode.keyGhostnode)) {
+        //LogPrint("CGhostnodePaymentVote::Sign -- SignHash() failed\n");
         return false;
     }
 
-    if (!darkSendSigner.VerifyMessage(activeGhostnode.pubKeyGhostnode, vchSig, strMessage, strError)) {
-        //LogPrint("CGhostnodePaymentVote::Sign -- VerifyMessage() failed, error: %s\n", strError);
+    if (!darkSendSigner.VerifyHash(activeGhostnode.pubKeyGhostnode, vchSig, hash, strError)) {
+        //LogPrint("CGhostnodePaymentVote::Sign -- VerifyHash() failed, error: %s\n", strError);
         return false;
     }
 
@@ -349,18 +421,34 @@ bool CGhostnodePayments::IsScheduled(CGhostnode &mn, int nNotBlockHeight) {
     return false;
 }
 
+void CGhostnodePayments::GetScheduledPayees(int nNotBlockHeight, std::set<CScript>& setPayeesRet) {
+    LOCK(cs_mapGhostnodeBlocks);
+
+    setPayeesRet.clear();
+    if (!pCurrentBlockIndex) return;
+
+    CScript payee;
+    for (int64_t h = pCurrentBlockIndex->nHeight; h <= pCurrentBlockIndex->nHeight + 8; h++) {
+        if (h == nNotBlockHeight) continue;
+        std::map<int, CGhostnodeBlockPayees>::iterator it = mapGhostnodeBlocks.find(h);
+        if (it != mapGhostnodeBlocks.end() && it->second.GetBestPayee(payee)) {
+            setPayeesRet.insert(payee);
+        }
+    }
+}
+
 bool CGhostnodePayments::AddPaymentVote(const CGhostnodePaymentVote &vote) {
     //LogPrintf("\nghostnode-payments CGhostnodePayments::AddPaymentVote\n");
     uint256 blockHash = uint256();
     if (!GetBlockHash(blockHash, vote.nBlockHeight - 100)){
-        LogPrintf("\nghostnode-payments CGhostnodePayments::Invalid Hash\n");
+        LogPrint(BCLog::GHOSTNODE, "ghostnode-payments CGhostnodePayments::Invalid Hash\n");
         return false;
     }
     if (HasVerifiedPaymentVote(vote.GetHash())) return false;
 
     LOCK2(cs_mapGhostnodeBlocks, cs_mapGhostnodePaymentVotes);
 
-    mapGhostnodePaymentVotes[vote.GetHash()] = vote;
+    AddSeenPaymentVote(vote.GetHash(), vote);
 
     if (!mapGhostnodeBlocks.count(vote.nBlockHeight)) {
         CGhostnodeBlockPayees blockPayees(vote.nBlockHeight);
@@ -378,6 +466,30 @@ bool CGhostnodePayments::HasVerifiedPaymentVote(uint256 hashIn) {
     return it != mapGhostnodePaymentVotes.end() && it->second.IsVerified();
 }
 
+bool CGhostnodePayments::GetVerifiedPaymentVote(const uint256& hashIn, CGhostnodePaymentVote& voteRet) {
+    LOCK(cs_mapGhostnodePaymentVotes);
+    std::map<uint256, CGhostnodePaymentVote>::iterator it = mapGhostnodePaymentVotes.find(hashIn);
+    if (it == mapGhostnodePaymentVotes.end() || !it->second.IsVerified()) return false;
+    voteRet = it->second;
+    return true;
+}
+
+void CGhostnodePayments::PushPaymentVotes(CNode* pnode, const std::vector<CGhostnodePaymentVote>& vecVotes) {
+    const CNetMsgMaker msgMaker(pnode->GetSendVersion());
+
+    if (pnode->nVersion < GHOSTNODE_PAYMENT_VOTES_VERSION) {
+        BOOST_FOREACH(const CGhostnodePaymentVote& vote, vecVotes) {
+            g_connman->PushMessage(pnode, msgMaker.Make(NetMsgType::GHOSTNODEPAYMENTVOTE, vote));
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < vecVotes.size(); i += MAX_PAYMENT_VOTES_PER_MESSAGE) {
+        std::vector<CGhostnodePaymentVote> vecBatch(vecVotes.begin() + i, vecVotes.begin() + std::min(vecVotes.size(), i + MAX_PAYMENT_VOTES_PER_MESSAGE));
+        g_connman->PushMessage(pnode, msgMaker.Make(NetMsgType::GHOSTNODEPAYMENTVOTES, vecBatch));
+    }
+}
+
 void CGhostnodeBlockPayees::AddPayee(const CGhostnodePaymentVote &vote) {
     LOCK(cs_vecPayees);
 
@@ -478,6 +590,20 @@ bool CGhostnodeBlockPayees::IsTransactionValid(const CTransaction &txNew) {
     return false;
 }
 
+bool CGhostnodeBlockPayees::IsPaidBy(const std::vector<CScript>& vecPaid) {
+    LOCK(cs_vecPayees);
+
+    bool hasValidPayee = false;
+    BOOST_FOREACH(CGhostnodePayee & payee, vecPayees)
+    {
+        if (payee.GetVoteCount() >= MNPAYMENTS_SIGNATURES_REQUIRED) {
+            if (std::find(vecPaid.begin(), vecPaid.end(), payee.GetPayee()) != vecPaid.end()) return true;
+            hasValidPayee = true;
+        }
+    }
+    return !hasValidPayee;
+}
+
 std::string CGhostnodeBlockPayees::GetRequiredPaymentsString() {
     LOCK(cs_vecPayees);
 
@@ -526,17 +652,22 @@ void CGhostnodePayments::CheckAndRemove() {
 
     int nLimit = GetStorageLimit();
 
-    std::map<uint256, CGhostnodePaymentVote>::iterator it = mapGhostnodePaymentVotes.begin();
-    while (it != mapGhostnodePaymentVotes.end()) {
-        CGhostnodePaymentVote vote = (*it).second;
+    // votes are indexed by height, so only the expired ones are visited
+    while (!mapPaymentVotesByHeight.empty()) {
+        std::multimap<int, uint256>::iterator it = mapPaymentVotesByHeight.begin();
+        if (pCurrentBlockIndex->nHeight - it->first <= nLimit) break;
+        //LogPrint("mnpayments", "CGhostnodePayments::CheckAndRemove -- Removing old Ghostnode payment: nBlockHeight=%d\n", it->first);
+        mapGhostnodePaymentVotes.erase(it->second);
+        mapGhostnodeBlocks.erase(it->first);
+        mapPaymentVotesByHeight.erase(it);
+    }
 
-        if (pCurrentBlockIndex->nHeight - vote.nBlockHeight > nLimit) {
-            //LogPrint("mnpayments", "CGhostnodePayments::CheckAndRemove -- Removing old Ghostnode payment: nBlockHeight=%d\n", vote.nBlockHeight);
-            mapGhostnodePaymentVotes.erase(it++);
-            mapGhostnodeBlocks.erase(vote.nBlockHeight);
-        } else {
-            ++it;
-        }
+    // votes too far in the future are rejected but stay in the map as seen, drop them as well
+    while (!mapPaymentVotesByHeight.empty()) {
+        std::multimap<int, uint256>::iterator it = --mapPaymentVotesByHeight.end();
+        if (it->first <= pCurrentBlockIndex->nHeight + 20) break;
+        mapGhostnodePaymentVotes.erase(it->second);
+        mapPaymentVotesByHeight.erase(it);
     }
     //LogPrint("CGhostnodePayments::CheckAndRemove -- %s\n", ToString());
 }
@@ -605,6 +736,8 @@ bool CGhostnodePayments::ProcessBlock(int nBlockHeight) {
         return false;
     }
 
+    CGhostnodeStatsTimer timer(GHOSTNODE_STATS_DURATION, "CGhostnodePayments::ProcessBlock");
+
     // We have little chances to pick the right winner if winners list is out of sync
     // but we have no choice, so we'll try. However it doesn't make sense to even try to do so
     // if we have not enough data about ghostnodes.
@@ -615,12 +748,12 @@ bool CGhostnodePayments::ProcessBlock(int nBlockHeight) {
     int nRank = mnodeman.GetGhostnodeRank(activeGhostnode.vin, nBlockHeight - 100, GetMinGhostnodePaymentsProto(), false);
 
     if (nRank == -1) {
-        LogPrintf("mnpayments CGhostnodePayments::ProcessBlock -- Unknown Ghostnode\n");
+        LogPrint(BCLog::GHOSTNODE, "mnpayments CGhostnodePayments::ProcessBlock -- Unknown Ghostnode\n");
         return false;
     }
 
     if (nRank > MNPAYMENTS_SIGNATURES_TOTAL) {
-        LogPrintf("mnpayments CGhostnodePayments::ProcessBlock -- Ghostnode not in the top %d (%d)\n", MNPAYMENTS_SIGNATURES_TOTAL, nRank);
+        LogPrint(BCLog::GHOSTNODE, "mnpayments CGhostnodePayments::ProcessBlock -- Ghostnode not in the top %d (%d)\n", MNPAYMENTS_SIGNATURES_TOTAL, nRank);
         return false;
     }
 
@@ -676,12 +809,9 @@ bool CGhostnodePaymentVote::CheckSignature(const CPubKey &pubKeyGhostnode, int n
     // do not ban by default
     nDos = 0;
 
-    std::string strMessage = vinGhostnode.prevout.ToStringShort() +
-                             boost::lexical_cast<std::string>(nBlockHeight) +
-                             ScriptToAsmStr(payee);
-
+    bool fNewSigs = sporkManager.IsSporkActive(SPORK_6_NEW_SIGS);
     std::string strError = "";
-    if (!darkSendSigner.VerifyMessage(pubKeyGhostnode, vchSig, strMessage, strError)) {
+    if (!darkSendSigner.VerifyHash(pubKeyGhostnode, vchSig, GetSignatureHash(fNewSigs), strError)) {
         // Only ban for future block vote when we are already synced.
         // Otherwise it could be the case when MN which signed this vote is using another key now
         // and we have no idea about the old one.
@@ -712,6 +842,9 @@ void CGhostnodePayments::Sync(CNode *pnode) {
     if (!pCurrentBlockIndex) return;
 
     int nInvCount = 0;
+    // peers which understand batches get the votes right away instead of an inv for each of them
+    bool fPushVotes = pnode->nVersion >= GHOSTNODE_PAYMENT_VOTES_VERSION;
+    std::vector<CGhostnodePaymentVote> vecVotes;
 
     for (int h = pCurrentBlockIndex->nHeight; h < pCurrentBlockIndex->nHeight + 20; h++) {
         if (mapGhostnodeBlocks.count(h)) {
@@ -720,14 +853,22 @@ void CGhostnodePayments::Sync(CNode *pnode) {
                 std::vector <uint256> vecVoteHashes = payee.GetVoteHashes();
                 BOOST_FOREACH(uint256 & hash, vecVoteHashes)
                 {
-                    if (!HasVerifiedPaymentVote(hash)) continue;
-                    pnode->PushInventory(CInv(MSG_GHOSTNODE_PAYMENT_VOTE, hash));
+                    if (fPushVotes) {
+                        CGhostnodePaymentVote vote;
+                        if (!GetVerifiedPaymentVote(hash, vote)) continue;
+                        vecVotes.push_back(vote);
+                    } else {
+                        if (!HasVerifiedPaymentVote(hash)) continue;
+                        pnode->PushInventory(CInv(MSG_GHOSTNODE_PAYMENT_VOTE, hash));
+                    }
                     nInvCount++;
                 }
             }
         }
     }
 
+    if (!vecVotes.empty()) PushPaymentVotes(pnode, vecVotes);
+
     //LogPrint("CGhostnodePayments::Sync -- Sent %d votes to peer %d\n", nInvCount, pnode->GetId());
     const CNetMsgMaker msgMaker(pnode->GetSendVersion());
     g_connman->PushMessage(pnode, msgMaker.Make(NetMsgType::SYNCSTATUSCOUNT, GHOSTNODE_SYNC_MNW, nInvCount));
@@ -820,11 +961,43 @@ std::string CGhostnodePayments::ToString() const {
     std::ostringstream info;
 
     info << "Votes: " << (int) mapGhostnodePaymentVotes.size() <<
-         ", Blocks: " << (int) mapGhostnodeBlocks.size();
+         ", Blocks: " << (int) mapGhostnodeBlocks.size() <<
+         ", Audited: " << nAuditedBlocks << " (" << nAuditMismatches << " mismatches)";
 
     return info.str();
 }
 
+size_t CGhostnodePayments::DynamicMemoryUsage() const
+{
+    LOCK2(cs_mapGhostnodeBlocks, cs_mapGhostnodePaymentVotes);
+    size_t nUsage = memusage::DynamicUsage(mapGhostnodePaymentVotes) + memusage::DynamicUsage(mapPaymentVotesByHeight);
+    for (const auto& vote : mapGhostnodePaymentVotes) {
+        nUsage += RecursiveDynamicUsage(vote.second.vinGhostnode) + RecursiveDynamicUsage(vote.second.payee) +
+                  memusage::DynamicUsage(vote.second.vchSig);
+    }
+    nUsage += memusage::DynamicUsage(mapGhostnodesLastVote);
+
+    nUsage += memusage::DynamicUsage(mapGhostnodeBlocks);
+    {
+        LOCK(cs_vecPayees);
+        for (const auto& block : mapGhostnodeBlocks) {
+            nUsage += memusage::DynamicUsage(block.second.vecPayees);
+            for (const CGhostnodePayee& payee : block.second.vecPayees)
+                nUsage += payee.DynamicMemoryUsage();
+        }
+    }
+
+    nUsage += memusage::DynamicUsage(mapPaidPayeesByHeight) + memusage::DynamicUsage(mapPaidHeightsByPayee);
+    for (const auto& paid : mapPaidPayeesByHeight) {
+        nUsage += memusage::DynamicUsage(paid.second);
+        for (const CScript& payee : paid.second)
+            nUsage += RecursiveDynamicUsage(payee);
+    }
+    for (const auto& paid : mapPaidHeightsByPayee)
+        nUsage += RecursiveDynamicUsage(paid.first) + memusage::DynamicUsage(paid.second);
+    return nUsage;
+}
+
 bool CGhostnodePayments::IsEnoughData() {
     float nAverageVotes = (MNPAYMENTS_SIGNATURES_TOTAL + MNPAYMENTS_SIGNATURES_REQUIRED) / 2;
     int nStorageLimit = GetStorageLimit();
@@ -841,3 +1014,159 @@ void CGhostnodePayments::UpdatedBlockTip(const CBlockIndex *pindex) {
     
     ProcessBlock(pindex->nHeight + 5);
 }
+
+void CGhostnodePayments::AddPaidBlock(const CBlock& block, const CBlockIndex* pindex) {
+    CAmount nGhostnodePayment = GetGhostnodePayment(pindex->nHeight, block.vtx[0]->GetValueOut());
+    std::vector<CScript> vecPayees;
+    BOOST_FOREACH(const CTxOut& txout, block.vtx[0]->vout) {
+        if (txout.nValue == nGhostnodePayment) {
+            vecPayees.push_back(txout.scriptPubKey);
+            mapPaidHeightsByPayee[txout.scriptPubKey].insert(pindex->nHeight);
+        }
+    }
+    if (!vecPayees.empty()) {
+        mapPaidPayeesByHeight[pindex->nHeight].swap(vecPayees);
+    }
+}
+
+void CGhostnodePayments::RemovePaidBlock(int nHeight) {
+    std::map<int, std::vector<CScript> >::iterator it = mapPaidPayeesByHeight.find(nHeight);
+    if (it == mapPaidPayeesByHeight.end()) return;
+    BOOST_FOREACH(const CScript& payee, it->second) {
+        std::map<CScript, std::set<int> >::iterator itPayee = mapPaidHeightsByPayee.find(payee);
+        if (itPayee == mapPaidHeightsByPayee.end()) continue;
+        itPayee->second.erase(nHeight);
+        if (itPayee->second.empty()) mapPaidHeightsByPayee.erase(itPayee);
+    }
+    mapPaidPayeesByHeight.erase(it);
+}
+
+void CGhostnodePayments::ClearPaidIndex() {
+    mapPaidPayeesByHeight.clear();
+    mapPaidHeightsByPayee.clear();
+    nPaidIndexBegin = 0;
+    pindexPaidIndexTip = NULL;
+}
+
+void CGhostnodePayments::BlockConnected(const CBlock& block, const CBlockIndex* pindex) {
+    if (fLiteMode) return;
+
+    int nFirstBlock = pindex->nHeight - GetStorageLimit();
+
+    LOCK(cs_mapGhostnodeBlocks);
+
+    if (!pindexPaidIndexTip || pindex->pprev != pindexPaidIndexTip) {
+        // not extending the recorded blocks, start over from this one
+        ClearPaidIndex();
+        nPaidIndexBegin = pindex->nHeight;
+    }
+    AddPaidBlock(block, pindex);
+    pindexPaidIndexTip = pindex;
+
+    // forget blocks past the storage limit
+    while (!mapPaidPayeesByHeight.empty() && mapPaidPayeesByHeight.begin()->first < nFirstBlock) {
+        RemovePaidBlock(mapPaidPayeesByHeight.begin()->first);
+    }
+    nPaidIndexBegin = std::max(nPaidIndexBegin, nFirstBlock);
+}
+
+void CGhostnodePayments::BlockDisconnected(const CBlock& block, const CBlockIndex* pindex) {
+    if (fLiteMode) return;
+
+    LOCK(cs_mapGhostnodeBlocks);
+
+    if (pindex != pindexPaidIndexTip) return;
+    RemovePaidBlock(pindex->nHeight);
+    nAuditedHeight = std::min(nAuditedHeight, pindex->nHeight - 1);
+    pindexPaidIndexTip = pindex->pprev;
+    if (!pindexPaidIndexTip || pindexPaidIndexTip->nHeight < nPaidIndexBegin) {
+        ClearPaidIndex();
+    }
+}
+
+void CGhostnodePayments::IndexPaidBlocks(const CBlockIndex* pindex, int nDepth) {
+    if (!pindex) return;
+
+    int nFirstBlock = std::max(0, pindex->nHeight - nDepth + 1);
+
+    LOCK(cs_mapGhostnodeBlocks);
+
+    // start over if the recorded blocks are not on the chain of pindex
+    if (pindexPaidIndexTip) {
+        bool fSameChain = pindexPaidIndexTip->nHeight >= pindex->nHeight ?
+                          pindexPaidIndexTip->GetAncestor(pindex->nHeight) == pindex :
+                          pindex->GetAncestor(pindexPaidIndexTip->nHeight) == pindexPaidIndexTip;
+        if (!fSameChain) ClearPaidIndex();
+    }
+    if (!pindexPaidIndexTip) {
+        nPaidIndexBegin = pindex->nHeight + 1;
+        pindexPaidIndexTip = pindex;
+    }
+
+    // blocks after the recorded ones, then blocks before them
+    std::vector<const CBlockIndex*> vToRead;
+    for (int nHeight = pindexPaidIndexTip->nHeight + 1; nHeight <= pindex->nHeight; nHeight++) {
+        vToRead.push_back(pindex->GetAncestor(nHeight));
+    }
+    for (int nHeight = nPaidIndexBegin - 1; nHeight >= nFirstBlock; nHeight--) {
+        vToRead.push_back(pindex->GetAncestor(nHeight));
+    }
+    if (vToRead.empty()) return;
+
+    BOOST_FOREACH(const CBlockIndex* pindexRead, vToRead) {
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindexRead, Params().GetConsensus())) {
+            LogPrintf("CGhostnodePayments::IndexPaidBlocks -- ReadBlockFromDisk failed at height %d\n", pindexRead->nHeight);
+            continue;
+        }
+        AddPaidBlock(block, pindexRead);
+    }
+    if (pindexPaidIndexTip->nHeight < pindex->nHeight) pindexPaidIndexTip = pindex;
+    nPaidIndexBegin = std::min(nPaidIndexBegin, nFirstBlock);
+}
+
+const CBlockIndex* CGhostnodePayments::GetLastPaidBlock(const CScript& payee, const CBlockIndex* pindex, int nHeightAfter) {
+    LOCK(cs_mapGhostnodeBlocks);
+
+    std::map<CScript, std::set<int> >::iterator it = mapPaidHeightsByPayee.find(payee);
+    if (it == mapPaidHeightsByPayee.end()) return NULL;
+
+    // newest payment first, it only counts if enough ghostnodes voted for it
+    std::set<int>::reverse_iterator rit(it->second.upper_bound(pindex->nHeight));
+    for (; rit != it->second.rend() && *rit > nHeightAfter; ++rit) {
+        std::map<int, CGhostnodeBlockPayees>::iterator itBlock = mapGhostnodeBlocks.find(*rit);
+        if (itBlock != mapGhostnodeBlocks.end() && itBlock->second.HasPayeeWithVotes(payee, 2)) {
+            return pindex->GetAncestor(*rit);
+        }
+    }
+    return NULL;
+}
+
+void CGhostnodePayments::AuditPaidBlocks() {
+    if (fLiteMode) return;
+
+    LOCK(cs_mapGhostnodeBlocks);
+
+    if (!pindexPaidIndexTip || !ghostnodeSync.IsSynced(pindexPaidIndexTip->nHeight)) return;
+
+    static const std::vector<CScript> vecNone;
+    int nFirstBlock = std::max(std::max(nAuditedHeight + 1, nPaidIndexBegin), Params().GetConsensus().nGhostnodePaymentsStartBlock);
+    int nBlocks = 0, nMismatches = 0;
+    for (int nHeight = nFirstBlock; nHeight <= pindexPaidIndexTip->nHeight; nHeight++) {
+        std::map<int, CGhostnodeBlockPayees>::iterator it = mapGhostnodeBlocks.find(nHeight);
+        if (it != mapGhostnodeBlocks.end()) {
+            std::map<int, std::vector<CScript> >::const_iterator itPaid = mapPaidPayeesByHeight.find(nHeight);
+            if (!it->second.IsPaidBy(itPaid == mapPaidPayeesByHeight.end() ? vecNone : itPaid->second))
+                nMismatches++;
+            nBlocks++;
+        }
+    }
+    nAuditedHeight = std::max(nAuditedHeight, pindexPaidIndexTip->nHeight);
+    nAuditedBlocks += nBlocks;
+    nAuditMismatches += nMismatches;
+
+    if (nMismatches > 0) {
+        LogPrintf("CGhostnodePayments::AuditPaidBlocks -- %d of %d blocks from height %d to %d did not pay a payee with enough votes\n",
+                  nMismatches, nBlocks, nFirstBlock, pindexPaidIndexTip->nHeight);
+    }
+}
@@ -11,6 +11,7 @@
 #include "key.h"
 #include "validation.h"
 #include "ghostnode.h"
+#include "memusage.h"
 #include "utilstrencodings.h"
 
 class CGhostnodePayments;
@@ -19,6 +20,8 @@ class CGhostnodeBlockPayees;
 
 static const int MNPAYMENTS_SIGNATURES_REQUIRED         = 6;
 static const int MNPAYMENTS_SIGNATURES_TOTAL            = 10;
+// maximum number of payment votes in one "mnwv" message
+static const unsigned int MAX_PAYMENT_VOTES_PER_MESSAGE = 1000;
 
 //! minimum peer version that can receive and send ghostnode payment messages,
 //  vote for ghostnode and be elected as a payment winner
@@ -72,6 +75,8 @@ public:
     std::vector<uint256> GetVoteHashes() { return vecVoteHashes; }
     int GetVoteCount() { return vecVoteHashes.size(); }
     std::string ToString() const;
+
+    size_t DynamicMemoryUsage() const { return memusage::DynamicUsage(scriptPubKey) + memusage::DynamicUsage(vecVoteHashes); }
 };
 
 // Keep track of votes for payees from ghostnodes
@@ -103,6 +108,8 @@ public:
     bool HasPayeeWithVotes(CScript payeeIn, int nVotesReq);
 
     bool IsTransactionValid(const CTransaction& txNew);
+    /// IsTransactionValid() for a block that paid the ghostnode amount to vecPaid
+    bool IsPaidBy(const std::vector<CScript>& vecPaid);
 
     std::string GetRequiredPaymentsString();
 };
@@ -149,6 +156,9 @@ public:
         return ss.GetHash();
     }
 
+    std::string GetStrMessage() const;
+    /// The hash signed by the ghostnode key: of the binary fields with SPORK_6_NEW_SIGS (fNewSigs), else of GetStrMessage()
+    uint256 GetSignatureHash(bool fNewSigs) const;
     bool Sign();
     bool CheckSignature(const CPubKey& pubKeyGhostnode, int nValidationHeight, int &nDos);
 
@@ -177,12 +187,36 @@ private:
     // Keep track of current block index
     const CBlockIndex *pCurrentBlockIndex;
 
+    // Hashes in mapGhostnodePaymentVotes by vote block height, so that old votes are removed without a full scan
+    std::multimap<int, uint256> mapPaymentVotesByHeight;
+
+    void AddSeenPaymentVote(const uint256& hash, const CGhostnodePaymentVote& vote);
+    /// Check, store and relay a single vote received from pfrom
+    void ProcessPaymentVote(CNode* pfrom, CGhostnodePaymentVote& vote);
+
+    // Outputs paying the ghostnode amount in the coinbase of the active chain blocks from
+    // nPaidIndexBegin to pindexPaidIndexTip, by height and by payee, protected by cs_mapGhostnodeBlocks
+    std::map<int, std::vector<CScript> > mapPaidPayeesByHeight;
+    std::map<CScript, std::set<int> > mapPaidHeightsByPayee;
+    int nPaidIndexBegin;
+    const CBlockIndex *pindexPaidIndexTip;
+
+    void AddPaidBlock(const CBlock& block, const CBlockIndex* pindex);
+    void RemovePaidBlock(int nHeight);
+    void ClearPaidIndex();
+
+    // Recorded blocks up to nAuditedHeight were checked against the payment votes by AuditPaidBlocks()
+    int nAuditedHeight;
+    uint64_t nAuditedBlocks;
+    uint64_t nAuditMismatches;
+
 public:
     std::map<uint256, CGhostnodePaymentVote> mapGhostnodePaymentVotes;
     std::map<int, CGhostnodeBlockPayees> mapGhostnodeBlocks;
     std::map<COutPoint, int> mapGhostnodesLastVote;
 
-    CGhostnodePayments() : nStorageCoeff(1.25), nMinBlocksToStore(5000) {}
+    CGhostnodePayments() : nStorageCoeff(1.25), nMinBlocksToStore(5000), nPaidIndexBegin(0), pindexPaidIndexTip(NULL),
+        nAuditedHeight(0), nAuditedBlocks(0), nAuditMismatches(0) {}
 
     ADD_SERIALIZE_METHODS;
 
@@ -190,12 +224,21 @@ public:
     inline void SerializationOp(Stream& s, Operation ser_action) {
         READWRITE(mapGhostnodePaymentVotes);
         READWRITE(mapGhostnodeBlocks);
+        if (ser_action.ForRead()) {
+            mapPaymentVotesByHeight.clear();
+            for (std::map<uint256, CGhostnodePaymentVote>::iterator it = mapGhostnodePaymentVotes.begin(); it != mapGhostnodePaymentVotes.end(); ++it) {
+                mapPaymentVotesByHeight.insert(std::make_pair(it->second.nBlockHeight, it->first));
+            }
+        }
     }
 
     void Clear();
 
     bool AddPaymentVote(const CGhostnodePaymentVote& vote);
     bool HasVerifiedPaymentVote(uint256 hashIn);
+    bool GetVerifiedPaymentVote(const uint256& hashIn, CGhostnodePaymentVote& voteRet);
+    /// Send votes to pnode in "mnwv" batches, or one by one to peers which don't know batches yet
+    void PushPaymentVotes(CNode* pnode, const std::vector<CGhostnodePaymentVote>& vecVotes);
     bool ProcessBlock(int nBlockHeight);
 
     void Sync(CNode* node);
@@ -205,6 +248,8 @@ public:
     bool GetBlockPayee(int nBlockHeight, CScript& payee);
     bool IsTransactionValid(const CTransaction& txNew, int nBlockHeight);
     bool IsScheduled(CGhostnode& mn, int nNotBlockHeight);
+    /// Payees scheduled in the next 8 blocks except nNotBlockHeight, the set IsScheduled() checks against
+    void GetScheduledPayees(int nNotBlockHeight, std::set<CScript>& setPayeesRet);
 
     bool CanVote(COutPoint outGhostnode, int nBlockHeight);
 
@@ -213,6 +258,8 @@ public:
     std::string GetRequiredPaymentsString(int nBlockHeight);
     void FillBlockPayee(CMutableTransaction& txNew, int nBlockHeight, CAmount blockReward, CTxOut& txoutGhostnodeRet);
     std::string ToString() const;
+    /// Estimated heap memory of the votes, the payees of the blocks and the paid index
+    size_t DynamicMemoryUsage() const;
 
     int GetBlockCount() { return mapGhostnodeBlocks.size(); }
     int GetVoteCount() { return mapGhostnodePaymentVotes.size(); }
@@ -221,6 +268,17 @@ public:
     int GetStorageLimit();
 
     void UpdatedBlockTip(const CBlockIndex *pindex);
+
+    /// Record or forget the ghostnode payments of a block connected to or disconnected from the active chain
+    void BlockConnected(const CBlock& block, const CBlockIndex* pindex);
+    void BlockDisconnected(const CBlock& block, const CBlockIndex* pindex);
+    /// Make sure the payments of the nDepth blocks up to pindex are recorded, reading missing blocks from disk
+    void IndexPaidBlocks(const CBlockIndex* pindex, int nDepth);
+    /// Highest block after nHeightAfter up to pindex that paid payee with enough votes, requires IndexPaidBlocks() first
+    const CBlockIndex* GetLastPaidBlock(const CScript& payee, const CBlockIndex* pindex, int nHeightAfter);
+    /// Once synced, check the recorded payments of the blocks connected since the last audit against the
+    /// payment votes. Blocks connected before the ghostnode list was synced had their payees accepted unchecked.
+    void AuditPaidBlocks();
 };
 
 #endif
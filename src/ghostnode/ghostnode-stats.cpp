@@ -0,0 +1,111 @@
+// Copyright (c) 2017-2018 The NIX Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "ghostnode-stats.h"
+#include "tinyformat.h"
+#include "utiltime.h"
+
+CGhostnodeStats ghostnodeStats;
+
+CGhostnodeStats::CTimingStats::CTimingStats() :
+    nCount(0),
+    nTotalMicros(0),
+    nMaxMicros(0)
+{
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+        vBuckets[i] = 0;
+}
+
+void CGhostnodeStats::CTimingStats::Add(int64_t nMicros)
+{
+    if (nMicros < 0) nMicros = 0;
+
+    nCount++;
+    nTotalMicros += nMicros;
+    nMaxMicros = std::max(nMaxMicros, nMicros);
+
+    int nBucket = 0;
+    while (nBucket < HISTOGRAM_BUCKETS - 1 && nMicros >= (int64_t(1) << nBucket))
+        nBucket++;
+    vBuckets[nBucket]++;
+}
+
+UniValue CGhostnodeStats::CTimingStats::ToJSON() const
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("count", (uint64_t)nCount));
+    obj.push_back(Pair("total_us", nTotalMicros));
+    obj.push_back(Pair("avg_us", nCount ? nTotalMicros / (int64_t)nCount : 0));
+    obj.push_back(Pair("max_us", nMaxMicros));
+
+    // only the buckets with samples, by their upper bound
+    UniValue histogram(UniValue::VOBJ);
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        if (!vBuckets[i]) continue;
+        std::string strBound = i == HISTOGRAM_BUCKETS - 1 ? "inf" : strprintf("%d", int64_t(1) << i);
+        histogram.pushKV("<" + strBound + "us", (uint64_t)vBuckets[i]);
+    }
+    obj.push_back(Pair("histogram", histogram));
+    return obj;
+}
+
+void CGhostnodeStats::AddTiming(GhostnodeStatsKind kind, const std::string& strName, int64_t nMicros)
+{
+    LOCK(cs);
+    if (kind == GHOSTNODE_STATS_LOCK_WAIT)
+        mapLockWaits[strName].Add(nMicros);
+    else
+        mapDurations[strName].Add(nMicros);
+}
+
+void CGhostnodeStats::AddMessage(const std::string& strCommand)
+{
+    LOCK(cs);
+    mapMessageCounts[strCommand]++;
+}
+
+void CGhostnodeStats::Clear()
+{
+    LOCK(cs);
+    mapDurations.clear();
+    mapLockWaits.clear();
+    mapMessageCounts.clear();
+}
+
+UniValue CGhostnodeStats::ToJSON() const
+{
+    LOCK(cs);
+
+    UniValue durations(UniValue::VOBJ);
+    for (const auto& pair : mapDurations)
+        durations.pushKV(pair.first, pair.second.ToJSON());
+
+    UniValue lockWaits(UniValue::VOBJ);
+    for (const auto& pair : mapLockWaits)
+        lockWaits.pushKV(pair.first, pair.second.ToJSON());
+
+    UniValue messages(UniValue::VOBJ);
+    for (const auto& pair : mapMessageCounts)
+        messages.pushKV(pair.first, (uint64_t)pair.second);
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("durations", durations));
+    obj.push_back(Pair("lock_waits", lockWaits));
+    obj.push_back(Pair("messages", messages));
+    return obj;
+}
+
+CGhostnodeStatsTimer::CGhostnodeStatsTimer(GhostnodeStatsKind kindIn, const char* pszNameIn) :
+    kind(kindIn),
+    pszName(pszNameIn),
+    nStart(GetTimeMicros())
+{
+}
+
+void CGhostnodeStatsTimer::Stop()
+{
+    if (!pszName) return;
+    ghostnodeStats.AddTiming(kind, pszName, GetTimeMicros() - nStart);
+    pszName = NULL;
+}
@@ -0,0 +1,75 @@
+// Copyright (c) 2017-2018 The NIX Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef GHOSTNODE_STATS_H
+#define GHOSTNODE_STATS_H
+
+#include "sync.h"
+
+#include <map>
+#include <string>
+
+#include <univalue.h>
+
+class CGhostnodeStats;
+
+extern CGhostnodeStats ghostnodeStats;
+
+enum GhostnodeStatsKind {
+    GHOSTNODE_STATS_DURATION,
+    GHOSTNODE_STATS_LOCK_WAIT
+};
+
+//
+// Timings of the ghostnode, payment and InstantSend code paths, and counts of the
+// ghostnode network messages, for the getghostnodestats RPC
+//
+class CGhostnodeStats
+{
+public:
+    // histogram buckets, bucket n counts samples of less than 2^n microseconds, the last one the rest
+    static const int HISTOGRAM_BUCKETS = 24;
+
+    struct CTimingStats
+    {
+        uint64_t nCount;
+        int64_t nTotalMicros;
+        int64_t nMaxMicros;
+        uint64_t vBuckets[HISTOGRAM_BUCKETS];
+
+        CTimingStats();
+        void Add(int64_t nMicros);
+        UniValue ToJSON() const;
+    };
+
+private:
+    mutable CCriticalSection cs;
+    std::map<std::string, CTimingStats> mapDurations;
+    std::map<std::string, CTimingStats> mapLockWaits;
+    std::map<std::string, uint64_t> mapMessageCounts;
+
+public:
+    void AddTiming(GhostnodeStatsKind kind, const std::string& strName, int64_t nMicros);
+    void AddMessage(const std::string& strCommand);
+    void Clear();
+
+    UniValue ToJSON() const;
+};
+
+/** Adds the time from construction to Stop(), or to destruction, to ghostnodeStats */
+class CGhostnodeStatsTimer
+{
+private:
+    GhostnodeStatsKind kind;
+    const char* pszName;
+    int64_t nStart;
+
+public:
+    CGhostnodeStatsTimer(GhostnodeStatsKind kindIn, const char* pszNameIn);
+    ~CGhostnodeStatsTimer() { Stop(); }
+
+    void Stop();
+};
+
+#endif
@@ -11,9 +11,11 @@
 #include "ghostnode-sync.h"
 #include "ghostnodeman.h"
 #include "netfulfilledman.h"
+#include "scheduler.h"
 #include "spork.h"
 #include "util.h"
 #include "boost/foreach.hpp"
+#include "boost/bind.hpp"
 #include "netmessagemaker.h"
 
 class CGhostnodeSync;
@@ -191,6 +193,11 @@ void CGhostnodeSync::SwitchToNextAsset() {
     }
     nRequestedGhostnodeAttempt = 0;
     nTimeAssetSyncStarted = GetTime();
+
+    // start on the next asset now instead of waiting for the next tick
+    if (pscheduler) {
+        pscheduler->scheduleFromNow(boost::bind(&CGhostnodeSync::ProcessTick, this), 0, "ghostnode");
+    }
 }
 
 std::string CGhostnodeSync::GetSyncStatus() {
@@ -232,16 +239,21 @@ void CGhostnodeSync::ClearFulfilledRequests() {
 
     BOOST_FOREACH(CNode * pnode, g_connman->vNodes)
     {
-        netfulfilledman.RemoveFulfilledRequest(pnode->addr, "spork-sync");
-        netfulfilledman.RemoveFulfilledRequest(pnode->addr, "ghostnode-list-sync");
-        netfulfilledman.RemoveFulfilledRequest(pnode->addr, "ghostnode-payment-sync");
-        netfulfilledman.RemoveFulfilledRequest(pnode->addr, "full-sync");
+        netfulfilledman.RemoveFulfilledRequest(pnode->addr, FULFILLED_SPORK_SYNC);
+        netfulfilledman.RemoveFulfilledRequest(pnode->addr, FULFILLED_GHOSTNODE_LIST_SYNC);
+        netfulfilledman.RemoveFulfilledRequest(pnode->addr, FULFILLED_GHOSTNODE_PAYMENT_SYNC);
+        netfulfilledman.RemoveFulfilledRequest(pnode->addr, FULFILLED_FULL_SYNC);
     }
 }
 
+void CGhostnodeSync::ScheduleTicks(CScheduler& scheduler) {
+    pscheduler = &scheduler;
+    scheduler.scheduleEvery(boost::bind(&CGhostnodeSync::ProcessTick, this), GHOSTNODE_SYNC_TICK_SECONDS * 1000, "ghostnode");
+}
+
 void CGhostnodeSync::ProcessTick() {
     static int nTick = 0;
-    if (nTick++ % GHOSTNODE_SYNC_TICK_SECONDS != 0) return;
+    nTick++;
     if (!pCurrentBlockIndex) return;
 
     //the actual count of ghostnodes we have currently
@@ -320,7 +332,7 @@ void CGhostnodeSync::ProcessTick() {
 
         // NORMAL NETWORK MODE - TESTNET/MAINNET
         {
-            if (netfulfilledman.HasFulfilledRequest(pnode->addr, "full-sync")) {
+            if (netfulfilledman.HasFulfilledRequest(pnode->addr, FULFILLED_FULL_SYNC)) {
                 // We already fully synced from this node recently,
                 // disconnect to free this connection slot for another peer.
                 pnode->fDisconnect = true;
@@ -330,9 +342,9 @@ void CGhostnodeSync::ProcessTick() {
 
             // SPORK : ALWAYS ASK FOR SPORKS AS WE SYNC (we skip this mode now)
 
-            if (!netfulfilledman.HasFulfilledRequest(pnode->addr, "spork-sync")) {
+            if (!netfulfilledman.HasFulfilledRequest(pnode->addr, FULFILLED_SPORK_SYNC)) {
                 // only request once from each peer
-                netfulfilledman.AddFulfilledRequest(pnode->addr, "spork-sync");
+                netfulfilledman.AddFulfilledRequest(pnode->addr, FULFILLED_SPORK_SYNC);
                 // get current network sporks
                 const CNetMsgMaker msgMaker(pnode->GetSendVersion());
                 g_connman->PushMessage(pnode, msgMaker.Make(NetMsgType::GETSPORKS));
@@ -359,8 +371,8 @@ void CGhostnodeSync::ProcessTick() {
                 }
 
                 // only request once from each peer
-                if (netfulfilledman.HasFulfilledRequest(pnode->addr, "ghostnode-list-sync")) continue;
-                netfulfilledman.AddFulfilledRequest(pnode->addr, "ghostnode-list-sync");
+                if (netfulfilledman.HasFulfilledRequest(pnode->addr, FULFILLED_GHOSTNODE_LIST_SYNC)) continue;
+                netfulfilledman.AddFulfilledRequest(pnode->addr, FULFILLED_GHOSTNODE_LIST_SYNC);
 
                 if (pnode->nVersion < mnpayments.GetMinGhostnodePaymentsProto()) continue;
                 nRequestedGhostnodeAttempt++;
@@ -403,8 +415,8 @@ void CGhostnodeSync::ProcessTick() {
                 }
 
                 // only request once from each peer
-                if (netfulfilledman.HasFulfilledRequest(pnode->addr, "ghostnode-payment-sync")) continue;
-                netfulfilledman.AddFulfilledRequest(pnode->addr, "ghostnode-payment-sync");
+                if (netfulfilledman.HasFulfilledRequest(pnode->addr, FULFILLED_GHOSTNODE_PAYMENT_SYNC)) continue;
+                netfulfilledman.AddFulfilledRequest(pnode->addr, FULFILLED_GHOSTNODE_PAYMENT_SYNC);
 
                 if (pnode->nVersion < mnpayments.GetMinGhostnodePaymentsProto()) continue;
                 nRequestedGhostnodeAttempt++;
@@ -11,6 +11,7 @@
 #include <univalue.h>
 
 class CGhostnodeSync;
+class CScheduler;
 
 static const int GHOSTNODE_SYNC_FAILED          = -1;
 static const int GHOSTNODE_SYNC_INITIAL         = 0;
@@ -55,12 +56,15 @@ private:
     // Keep track of current block index
     const CBlockIndex *pCurrentBlockIndex;
 
+    // Runs ProcessTick, set by ScheduleTicks
+    CScheduler *pscheduler;
+
     bool CheckNodeHeight(CNode* pnode, bool fDisconnectStuckNodes = false);
     void Fail();
     void ClearFulfilledRequests();
 
 public:
-    CGhostnodeSync() { Reset(); }
+    CGhostnodeSync() : pCurrentBlockIndex(NULL), pscheduler(NULL) { Reset(); }
 
     void AddedGhostnodeList() { nTimeLastGhostnodeList = GetTime(); }
     void AddedPaymentVote() { nTimeLastPaymentVote = GetTime(); }
@@ -84,6 +88,8 @@ public:
 
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
     void ProcessTick();
+    /// Run ProcessTick every GHOSTNODE_SYNC_TICK_SECONDS, and right away whenever an asset is done
+    void ScheduleTicks(CScheduler& scheduler);
 
     void UpdatedBlockTip(const CBlockIndex *pindex);
 };
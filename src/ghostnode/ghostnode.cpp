@@ -13,6 +13,8 @@
 #include "ghostnodeman.h"
 #include "util.h"
 #include "netbase.h"
+#include "spork.h"
+#include "validationinterface.h"
 
 #include <boost/lexical_cast.hpp>
 
@@ -36,7 +38,8 @@ CGhostnode::CGhostnode() :
         nPoSeBanScore(0),
         nPoSeBanHeight(0),
         fAllowMixingTx(true),
-        fUnitTest(false) {}
+        fUnitTest(false),
+        fCollateralChecked(false) {}
 
 CGhostnode::CGhostnode(CService addrNew, CTxIn vinNew, CPubKey pubKeyCollateralAddressNew, CPubKey pubKeyGhostnodeNew, int nProtocolVersionIn) :
         vin(vinNew),
@@ -57,7 +60,8 @@ CGhostnode::CGhostnode(CService addrNew, CTxIn vinNew, CPubKey pubKeyCollateralA
         nPoSeBanScore(0),
         nPoSeBanHeight(0),
         fAllowMixingTx(true),
-        fUnitTest(false) {}
+        fUnitTest(false),
+        fCollateralChecked(false) {}
 
 CGhostnode::CGhostnode(const CGhostnode &other) :
         vin(other.vin),
@@ -78,7 +82,8 @@ CGhostnode::CGhostnode(const CGhostnode &other) :
         nPoSeBanScore(other.nPoSeBanScore),
         nPoSeBanHeight(other.nPoSeBanHeight),
         fAllowMixingTx(other.fAllowMixingTx),
-        fUnitTest(other.fUnitTest) {}
+        fUnitTest(other.fUnitTest),
+        fCollateralChecked(other.fCollateralChecked) {}
 
 CGhostnode::CGhostnode(const CGhostnodeBroadcast &mnb) :
         vin(mnb.vin),
@@ -99,7 +104,8 @@ CGhostnode::CGhostnode(const CGhostnodeBroadcast &mnb) :
         nPoSeBanScore(0),
         nPoSeBanHeight(0),
         fAllowMixingTx(true),
-        fUnitTest(false) {}
+        fUnitTest(false),
+        fCollateralChecked(false) {}
 
 //CSporkManager sporkManager;
 //
@@ -119,7 +125,7 @@ bool CGhostnode::UpdateFromNewBroadcast(CGhostnodeBroadcast &mnb) {
     int nDos = 0;
     if (mnb.lastPing == CGhostnodePing() || (mnb.lastPing != CGhostnodePing() && mnb.lastPing.CheckAndUpdate(this, true, nDos))) {
         lastPing = mnb.lastPing;
-        mnodeman.mapSeenGhostnodePing.insert(std::make_pair(lastPing.GetHash(), lastPing));
+        mnodeman.AddSeenGhostnodePing(lastPing);
     }
     // if it matches our Ghostnode privkey...
     if (fGhostNode && pubKeyGhostnode == activeGhostnode.pubKeyGhostnode) {
@@ -160,6 +166,30 @@ arith_uint256 CGhostnode::CalculateScore(const uint256 &blockHash) {
 void CGhostnode::Check(bool fForce) {
     LOCK(cs);
 
+    int nActiveStatePrev = nActiveState;
+    CheckState(fForce);
+    if (nActiveState != nActiveStatePrev && !fUnitTest)
+        GetMainSignals().GhostnodeStateChanged(vin.prevout, nActiveState);
+}
+
+void CGhostnode::UpdateCollateral(bool fSpent) {
+    LOCK(cs);
+
+    int nActiveStatePrev = nActiveState;
+    if (fSpent) {
+        nActiveState = GHOSTNODE_OUTPOINT_SPENT;
+    } else if (IsOutpointSpent()) {
+        // back in the UTXO set after a reorg, let the usual checks decide again
+        nActiveState = GHOSTNODE_PRE_ENABLED;
+        CheckState(true);
+    }
+    if (nActiveState != nActiveStatePrev && !fUnitTest)
+        GetMainSignals().GhostnodeStateChanged(vin.prevout, nActiveState);
+}
+
+void CGhostnode::CheckState(bool fForce) {
+    AssertLockHeld(cs);
+
     if (ShutdownRequested()) return;
 
     if (!fForce && (GetTime() - nTimeLastChecked < GHOSTNODE_CHECK_SECONDS)) return;
@@ -172,16 +202,19 @@ void CGhostnode::Check(bool fForce) {
 
     int nHeight = 0;
     if (!fUnitTest) {
-        TRY_LOCK(cs_main, lockMain);
-        if (!lockMain) return;
-
-        Coin coin;
-        if (!pcoinsTip->GetCoin(vin.prevout, coin) ||
-            /*(unsigned int) vin.prevout.n >= coin.out || */
-            coin.out.IsNull()) {
-            nActiveState = GHOSTNODE_OUTPOINT_SPENT;
-            //LogPrint("ghostnode", "CGhostnode::Check -- Failed to find Ghostnode UTXO, ghostnode=%s\n", vin.prevout.ToStringShort());
-            return;
+        // Look the collateral up only once, CGhostnodeMan watches it from then on
+        if (!fCollateralChecked) {
+            TRY_LOCK(cs_main, lockMain);
+            if (!lockMain) return;
+
+            Coin coin;
+            if (!pcoinsTip->GetCoin(vin.prevout, coin) ||
+                coin.out.IsNull()) {
+                nActiveState = GHOSTNODE_OUTPOINT_SPENT;
+                //LogPrint("ghostnode", "CGhostnode::Check -- Failed to find Ghostnode UTXO, ghostnode=%s\n", vin.prevout.ToStringShort());
+                return;
+            }
+            fCollateralChecked = true;
         }
 
         nHeight = chainActive.Height();
@@ -396,42 +429,16 @@ void CGhostnode::UpdateLastPaid(const CBlockIndex *pindex, int nMaxBlocksToScanB
         return;
     }
 
-    const CBlockIndex *BlockReading = pindex;
-
     CScript mnpayee = GetScriptForDestination(pubKeyCollateralAddress.GetID());
     //LogPrint("ghostnode", "CGhostnode::UpdateLastPaidBlock -- searching for block with payment to %s\n", vin.prevout.ToStringShort());
 
-    LOCK(cs_mapGhostnodeBlocks);
-
-    for (int i = 0; BlockReading && BlockReading->nHeight > nBlockLastPaid && i < nMaxBlocksToScanBack; i++) {
-//        //LogPrint("mnpayments.mapGhostnodeBlocks.count(BlockReading->nHeight)=%s\n", mnpayments.mapGhostnodeBlocks.count(BlockReading->nHeight));
-//        //LogPrint("mnpayments.mapGhostnodeBlocks[BlockReading->nHeight].HasPayeeWithVotes(mnpayee, 2)=%s\n", mnpayments.mapGhostnodeBlocks[BlockReading->nHeight].HasPayeeWithVotes(mnpayee, 2));
-        if (mnpayments.mapGhostnodeBlocks.count(BlockReading->nHeight) &&
-            mnpayments.mapGhostnodeBlocks[BlockReading->nHeight].HasPayeeWithVotes(mnpayee, 2)) {
-            // //LogPrint("i=%s, BlockReading->nHeight=%s\n", i, BlockReading->nHeight);
-            CBlock block;
-            if (!ReadBlockFromDisk(block, BlockReading, Params().GetConsensus())) // shouldn't really happen
-            {
-                //LogPrint("ReadBlockFromDisk failed\n");
-                continue;
-            }
-
-            CAmount nGhostnodePayment = GetGhostnodePayment(BlockReading->nHeight, block.vtx[0]->GetValueOut());
-
-            BOOST_FOREACH(CTxOut txout, block.vtx[0]->vout)
-            if (mnpayee == txout.scriptPubKey && nGhostnodePayment == txout.nValue) {
-                nBlockLastPaid = BlockReading->nHeight;
-                nTimeLastPaid = BlockReading->nTime;
-                //LogPrint("ghostnode", "CGhostnode::UpdateLastPaidBlock -- searching for block with payment to %s -- found new %d\n", vin.prevout.ToStringShort(), nBlockLastPaid);
-                return;
-            }
-        }
-
-        if (BlockReading->pprev == NULL) {
-            assert(BlockReading);
-            break;
-        }
-        BlockReading = BlockReading->pprev;
+    // payments are recorded by mnpayments as blocks are connected, see CGhostnodePayments::IndexPaidBlocks
+    const CBlockIndex *pindexPaid = mnpayments.GetLastPaidBlock(mnpayee, pindex, std::max(nBlockLastPaid, pindex->nHeight - nMaxBlocksToScanBack));
+    if (pindexPaid) {
+        nBlockLastPaid = pindexPaid->nHeight;
+        nTimeLastPaid = pindexPaid->nTime;
+        //LogPrint("ghostnode", "CGhostnode::UpdateLastPaidBlock -- searching for block with payment to %s -- found new %d\n", vin.prevout.ToStringShort(), nBlockLastPaid);
+        return;
     }
 
     // Last payment for this ghostnode wasn't found in latest mnpayments blocks
@@ -719,23 +726,39 @@ bool CGhostnodeBroadcast::CheckOutpoint(int &nDos) {
     return true;
 }
 
+std::string CGhostnodeBroadcast::GetStrMessage() const {
+    return addr.ToString() + boost::lexical_cast<std::string>(sigTime) +
+           pubKeyCollateralAddress.GetID().ToString() + pubKeyGhostnode.GetID().ToString() +
+           boost::lexical_cast<std::string>(nProtocolVersion);
+}
+
+uint256 CGhostnodeBroadcast::GetSignatureHash(bool fNewSigs) const {
+    if (!fNewSigs) return CDarkSendSigner::GetMessageHash(GetStrMessage());
+
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << vin.prevout;
+    ss << addr;
+    ss << pubKeyCollateralAddress;
+    ss << pubKeyGhostnode;
+    ss << sigTime;
+    ss << nProtocolVersion;
+    return ss.GetHash();
+}
+
 bool CGhostnodeBroadcast::Sign(CKey &keyCollateralAddress) {
     std::string strError;
-    std::string strMessage;
 
     sigTime = GetAdjustedTime();
 
-    strMessage = addr.ToString() + boost::lexical_cast<std::string>(sigTime) +
-                 pubKeyCollateralAddress.GetID().ToString() + pubKeyGhostnode.GetID().ToString() +
-                 boost::lexical_cast<std::string>(nProtocolVersion);
+    uint256 hash = GetSignatureHash(sporkManager.IsSporkActive(SPORK_6_NEW_SIGS));
 
-    if (!darkSendSigner.SignMessage(strMessage, vchSig, keyCollateralAddress)) {
-        //LogPrint("CGhostnodeBroadcast::Sign -- SignMessage() failed\n");
+    if (!darkSendSigner.SignHash(hash, vchSig, keyCollateralAddress)) {
+        //LogPrint("CGhostnodeBroadcast::Sign -- SignHash() failed\n");
         return false;
     }
 
-    if (!darkSendSigner.VerifyMessage(pubKeyCollateralAddress, vchSig, strMessage, strError)) {
-        //LogPrint("CGhostnodeBroadcast::Sign -- VerifyMessage() failed, error: %s\n", strError);
+    if (!darkSendSigner.VerifyHash(pubKeyCollateralAddress, vchSig, hash, strError)) {
+        //LogPrint("CGhostnodeBroadcast::Sign -- VerifyHash() failed, error: %s\n", strError);
         return false;
     }
 
@@ -743,17 +766,11 @@ bool CGhostnodeBroadcast::Sign(CKey &keyCollateralAddress) {
 }
 
 bool CGhostnodeBroadcast::CheckSignature(int &nDos) {
-    std::string strMessage;
     std::string strError = "";
     nDos = 0;
 
-    strMessage = addr.ToString() + boost::lexical_cast<std::string>(sigTime) +
-                 pubKeyCollateralAddress.GetID().ToString() + pubKeyGhostnode.GetID().ToString() +
-                 boost::lexical_cast<std::string>(nProtocolVersion);
-
-    //LogPrint("ghostnode", "CGhostnodeBroadcast::CheckSignature -- strMessage: %s  pubKeyCollateralAddress address: %s  sig: %s\n", strMessage, CBitcoinAddress(pubKeyCollateralAddress.GetID()).ToString(), EncodeBase64(&vchSig[0], vchSig.size()));
-
-    if (!darkSendSigner.VerifyMessage(pubKeyCollateralAddress, vchSig, strMessage, strError)) {
+    bool fNewSigs = sporkManager.IsSporkActive(SPORK_6_NEW_SIGS);
+    if (!darkSendSigner.VerifyHash(pubKeyCollateralAddress, vchSig, GetSignatureHash(fNewSigs), strError)) {
         //LogPrint("CGhostnodeBroadcast::CheckSignature -- Got bad Ghostnode announce signature, error: %s\n", strError);
         nDos = 100;
         return false;
@@ -778,20 +795,33 @@ CGhostnodePing::CGhostnodePing(CTxIn &vinNew) {
     vchSig = std::vector < unsigned char > ();
 }
 
+std::string CGhostnodePing::GetStrMessage() const {
+    return vin.ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
+}
+
+uint256 CGhostnodePing::GetSignatureHash(bool fNewSigs) const {
+    if (!fNewSigs) return CDarkSendSigner::GetMessageHash(GetStrMessage());
+
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << vin;
+    ss << blockHash;
+    ss << sigTime;
+    return ss.GetHash();
+}
+
 bool CGhostnodePing::Sign(CKey &keyGhostnode, CPubKey &pubKeyGhostnode) {
     std::string strError;
-    std::string strGhostNodeSignMessage;
 
     sigTime = GetAdjustedTime();
-    std::string strMessage = vin.ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
+    uint256 hash = GetSignatureHash(sporkManager.IsSporkActive(SPORK_6_NEW_SIGS));
 
-    if (!darkSendSigner.SignMessage(strMessage, vchSig, keyGhostnode)) {
-        //LogPrint("CGhostnodePing::Sign -- SignMessage() failed\n");
+    if (!darkSendSigner.SignHash(hash, vchSig, keyGhostnode)) {
+        //LogPrint("CGhostnodePing::Sign -- SignHash() failed\n");
         return false;
     }
 
-    if (!darkSendSigner.VerifyMessage(pubKeyGhostnode, vchSig, strMessage, strError)) {
-        //LogPrint("CGhostnodePing::Sign -- VerifyMessage() failed, error: %s\n", strError);
+    if (!darkSendSigner.VerifyHash(pubKeyGhostnode, vchSig, hash, strError)) {
+        //LogPrint("CGhostnodePing::Sign -- VerifyHash() failed, error: %s\n", strError);
         return false;
     }
 
@@ -799,11 +829,11 @@ bool CGhostnodePing::Sign(CKey &keyGhostnode, CPubKey &pubKeyGhostnode) {
 }
 
 bool CGhostnodePing::CheckSignature(CPubKey &pubKeyGhostnode, int &nDos) {
-    std::string strMessage = vin.ToString() + blockHash.ToString() + boost::lexical_cast<std::string>(sigTime);
     std::string strError = "";
     nDos = 0;
 
-    if (!darkSendSigner.VerifyMessage(pubKeyGhostnode, vchSig, strMessage, strError)) {
+    bool fNewSigs = sporkManager.IsSporkActive(SPORK_6_NEW_SIGS);
+    if (!darkSendSigner.VerifyHash(pubKeyGhostnode, vchSig, GetSignatureHash(fNewSigs), strError)) {
         //LogPrint("CGhostnodePing::CheckSignature -- Got bad Ghostnode ping signature, ghostnode=%s, error: %s\n", vin.prevout.ToStringShort(), strError);
         nDos = 33;
         return false;
@@ -899,11 +929,7 @@ bool CGhostnodePing::CheckAndUpdate(CGhostnode *pmn, bool fFromNewBroadcast, int
     pmn->lastPing = *this;
 
     // and update ghostnodeman.mapSeenGhostnodeBroadcast.lastPing which is probably outdated
-    CGhostnodeBroadcast mnb(*pmn);
-    uint256 hash = mnb.GetHash();
-    if (mnodeman.mapSeenGhostnodeBroadcast.count(hash)) {
-        mnodeman.mapSeenGhostnodeBroadcast[hash].second.lastPing = *this;
-    }
+    mnodeman.UpdateSeenGhostnodeBroadcastPing(CGhostnodeBroadcast(*pmn).GetHash(), *this);
 
     pmn->Check(true); // force update, ignoring cache
     if (!pmn->IsEnabled()) return false;
@@ -81,6 +81,10 @@ public:
 
     bool IsExpired() { return GetTime() - sigTime > GHOSTNODE_NEW_START_REQUIRED_SECONDS; }
 
+    /// The message signed by the ghostnode key
+    std::string GetStrMessage() const;
+    /// The hash signed by the ghostnode key: of the binary fields with SPORK_6_NEW_SIGS (fNewSigs), else of GetStrMessage()
+    uint256 GetSignatureHash(bool fNewSigs) const;
     bool Sign(CKey& keyGhostnode, CPubKey& pubKeyGhostnode);
     bool CheckSignature(CPubKey& pubKeyGhostnode, int &nDos);
     bool SimpleCheck(int& nDos);
@@ -146,6 +150,8 @@ private:
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
 
+    void CheckState(bool fForce);
+
 public:
     enum state {
         GHOSTNODE_PRE_ENABLED,
@@ -177,6 +183,8 @@ public:
     int nPoSeBanHeight;
     bool fAllowMixingTx;
     bool fUnitTest;
+    // collateral found in the UTXO set once, later spends are reported by CGhostnodeMan::UpdateCollaterals
+    bool fCollateralChecked;
 
     // KEEP TRACK OF GOVERNANCE ITEMS EACH GHOSTNODE HAS VOTE UPON FOR RECALCULATION
     std::map<uint256, int> mapGovernanceObjectsVotedOn;
@@ -239,6 +247,7 @@ public:
         swap(first.nPoSeBanHeight, second.nPoSeBanHeight);
         swap(first.fAllowMixingTx, second.fAllowMixingTx);
         swap(first.fUnitTest, second.fUnitTest);
+        swap(first.fCollateralChecked, second.fCollateralChecked);
         swap(first.mapGovernanceObjectsVotedOn, second.mapGovernanceObjectsVotedOn);
     }
 
@@ -248,6 +257,8 @@ public:
     bool UpdateFromNewBroadcast(CGhostnodeBroadcast& mnb);
 
     void Check(bool fForce = false);
+    /// The collateral was spent (fSpent) or returned to the UTXO set by a block connected or disconnected at the tip
+    void UpdateCollateral(bool fSpent);
 
     bool IsBroadcastedWithin(int nSeconds) { return GetAdjustedTime() - sigTime < nSeconds; }
 
@@ -297,8 +308,8 @@ public:
 
     int GetCollateralAge();
 
-    int GetLastPaidTime() { return nTimeLastPaid; }
-    int GetLastPaidBlock() { return nBlockLastPaid; }
+    int GetLastPaidTime() const { return nTimeLastPaid; }
+    int GetLastPaidBlock() const { return nBlockLastPaid; }
     void UpdateLastPaid(const CBlockIndex *pindex, int nMaxBlocksToScanBack);
 
     // KEEP TRACK OF EACH GOVERNANCE ITEM INCASE THIS NODE GOES OFFLINE, SO WE CAN RECALC THEIR STATUS
@@ -339,6 +350,10 @@ public:
 
     CGhostnodeBroadcast() : CGhostnode(), fRecovery(false) {}
     CGhostnodeBroadcast(const CGhostnode& mn) : CGhostnode(mn), fRecovery(false) {}
+    template <typename Stream>
+    CGhostnodeBroadcast(deserialize_type, Stream& s) : CGhostnode(), fRecovery(false) {
+        Unserialize(s);
+    }
     CGhostnodeBroadcast(CService addrNew, CTxIn vinNew, CPubKey pubKeyCollateralAddressNew, CPubKey pubKeyGhostnodeNew, int nProtocolVersionIn) :
         CGhostnode(addrNew, vinNew, pubKeyCollateralAddressNew, pubKeyGhostnodeNew, nProtocolVersionIn), fRecovery(false) {}
 
@@ -373,11 +388,18 @@ public:
     bool Update(CGhostnode* pmn, int& nDos);
     bool CheckOutpoint(int& nDos);
 
+    /// The message signed by the collateral key
+    std::string GetStrMessage() const;
+    /// The hash signed by the collateral key, see CGhostnodePing::GetSignatureHash
+    uint256 GetSignatureHash(bool fNewSigs) const;
     bool Sign(CKey& keyCollateralAddress);
     bool CheckSignature(int& nDos);
     void RelayGhostNode();
 };
 
+/** Broadcasts are shared between the seen and recovery maps, and replaced rather than modified */
+typedef std::shared_ptr<const CGhostnodeBroadcast> CGhostnodeBroadcastRef;
+
 class CGhostnodeVerification
 {
 public:
@@ -5,17 +5,27 @@
 
 #include "activeghostnode.h"
 #include "addrman.h"
+#include "core_memusage.h"
 #include "darksend.h"
+#include "flat-database.h"
 #include "ghostnode-payments.h"
+#include "ghostnode-stats.h"
 #include "ghostnode-sync.h"
 #include "ghostnodeman.h"
+#include "memusage.h"
+#include "metrics.h"
 #include "netfulfilledman.h"
+#include "seeninventory.h"
+#include "spork.h"
+#include "ui_interface.h"
 #include "util.h"
 #include "netmessagemaker.h"
 
 /** Ghostnode manager */
 CGhostnodeMan mnodeman;
 
+static std::atomic<bool> fGhostnodesLoaded(false);
+
 const std::string CGhostnodeMan::SERIALIZATION_VERSION_STRING = "CGhostnodeMan-Version-4";
 
 struct CompareLastPaidBlock
@@ -79,16 +89,16 @@ void CGhostnodeIndex::Clear()
     mapReverseIndex.clear();
     nSize = 0;
 }
-struct CompareByAddr
 
+size_t CGhostnodeIndex::DynamicMemoryUsage() const
 {
-    bool operator()(const CGhostnode* t1,
-                    const CGhostnode* t2) const
-    {
-        return t1->addr < t2->addr;
-    }
-};
-
+    size_t nUsage = memusage::DynamicUsage(mapIndex) + memusage::DynamicUsage(mapReverseIndex);
+    for (const auto& index : mapIndex)
+        nUsage += RecursiveDynamicUsage(index.first);
+    for (const auto& index : mapReverseIndex)
+        nUsage += RecursiveDynamicUsage(index.second);
+    return nUsage;
+}
 void CGhostnodeIndex::RebuildIndex()
 {
     nSize = mapIndex.size();
@@ -99,10 +109,16 @@ void CGhostnodeIndex::RebuildIndex()
 
 CGhostnodeMan::CGhostnodeMan() : cs(),
   vGhostnodes(),
+  cs_snapshot(),
+  pGhostnodesSnapshot(),
+  nSnapshotTimeMillis(0),
   mAskedUsForGhostnodeList(),
   mWeAskedForGhostnodeList(),
   mWeAskedForGhostnodeListEntry(),
   mWeAskedForVerification(),
+  mWeAskedForVerificationTime(),
+  nVerifyReplyMillisTotal(0),
+  nVerifyReplies(0),
   mMnbRecoveryRequests(),
   mMnbRecoveryGoodReplies(),
   listScheduledMnbRequestConnections(),
@@ -114,8 +130,10 @@ CGhostnodeMan::CGhostnodeMan() : cs(),
   fGhostnodesRemoved(false),
 //  vecDirtyGovernanceObjectHashes(),
   nLastWatchdogVoteTime(0),
+  nDsegSinceTime(0),
   mapSeenGhostnodeBroadcast(),
   mapSeenGhostnodePing(),
+  mapSeenGhostnodeVerification(),
   nDsqCount(0)
 {}
 
@@ -127,6 +145,9 @@ bool CGhostnodeMan::Add(CGhostnode &mn)
     if (pmn == NULL) {
         //LogPrint("ghostnode", "CGhostnodeMan::Add -- Adding new Ghostnode: addr=%s, %i now\n", mn.addr.ToString(), size() + 1);
         vGhostnodes.push_back(mn);
+        AddToLookupIndexes(vGhostnodes.size() - 1);
+        UpdateMetrics();
+        mapScoredGhostnodes.clear();
         indexGhostnodes.AddGhostnodeVIN(mn.vin);
         fGhostnodesAdded = true;
         return true;
@@ -135,6 +156,22 @@ bool CGhostnodeMan::Add(CGhostnode &mn)
     return false;
 }
 
+void CGhostnodeMan::AddFromCache(std::vector<CGhostnode>& vCached)
+{
+    LOCK(cs);
+
+    BOOST_FOREACH(CGhostnode& mn, vCached) {
+        if(!Add(mn)) continue;
+        // peers announce these under the same hashes, so they are not downloaded and verified again
+        CGhostnodeBroadcastRef mnb = std::make_shared<const CGhostnodeBroadcast>(mn);
+        mapSeenGhostnodeBroadcast.insert(std::make_pair(mnb->GetHash(), std::make_pair(GetTime(), mnb)));
+        if(mn.lastPing != CGhostnodePing()) {
+            AddSeenGhostnodePing(mn.lastPing);
+        }
+        nDsegSinceTime = std::max(nDsegSinceTime, mn.sigTime);
+    }
+}
+
 void CGhostnodeMan::AskForMN(CNode* pnode, const CTxIn &vin)
 {
     if(!pnode) return;
@@ -167,12 +204,20 @@ void CGhostnodeMan::AskForMN(CNode* pnode, const CTxIn &vin)
 
 void CGhostnodeMan::Check()
 {
-    LOCK(cs);
-
 //    //LogPrint("ghostnode", "CGhostnodeMan::Check -- nLastWatchdogVoteTime=%d, IsWatchdogActive()=%d\n", nLastWatchdogVoteTime, IsWatchdogActive());
 
-    BOOST_FOREACH(CGhostnode& mn, vGhostnodes) {
-        mn.Check();
+    // Check ghostnodes in batches and release cs in between, so that payments, InstantSend
+    // and RPC callers do not have to wait for a pass over the whole list.
+    CGhostnodeStatsTimer timer(GHOSTNODE_STATS_DURATION, "CGhostnodeMan::Check");
+    for (size_t nBegin = 0; ; nBegin += CHECK_BATCH_SIZE) {
+        CGhostnodeStatsTimer waitTimer(GHOSTNODE_STATS_LOCK_WAIT, "CGhostnodeMan::Check cs");
+        LOCK(cs);
+        waitTimer.Stop();
+        if (nBegin >= vGhostnodes.size()) break;
+        size_t nEnd = std::min(nBegin + CHECK_BATCH_SIZE, vGhostnodes.size());
+        for (size_t i = nBegin; i < nEnd; i++) {
+            vGhostnodes[i].Check();
+        }
     }
 }
 
@@ -182,10 +227,13 @@ void CGhostnodeMan::CheckAndRemove()
 
     //LogPrint("CGhostnodeMan::CheckAndRemove\n");
 
+    CGhostnodeStatsTimer timer(GHOSTNODE_STATS_DURATION, "CGhostnodeMan::CheckAndRemove");
     {
         // Need LOCK2 here to ensure consistent locking order because code below locks cs_main
         // in CheckMnbAndUpdateGhostnodeList()
+        CGhostnodeStatsTimer waitTimer(GHOSTNODE_STATS_LOCK_WAIT, "CGhostnodeMan::CheckAndRemove cs_main, cs");
         LOCK2(cs_main, cs);
+        waitTimer.Stop();
 
         Check();
 
@@ -195,10 +243,9 @@ void CGhostnodeMan::CheckAndRemove()
         // ask for up to MNB_RECOVERY_MAX_ASK_ENTRIES ghostnode entries at a time
         int nAskForMnbRecovery = MNB_RECOVERY_MAX_ASK_ENTRIES;
         while(it != vGhostnodes.end()) {
-            CGhostnodeBroadcast mnb = CGhostnodeBroadcast(*it);
-            uint256 hash = mnb.GetHash();
             // If collateral was spent ...
             if ((*it).IsOutpointSpent()) {
+                uint256 hash = CGhostnodeBroadcast(*it).GetHash();
                 //LogPrint("ghostnode", "CGhostnodeMan::CheckAndRemove -- Removing Ghostnode: %s  addr=%s  %i now\n", (*it).GetStateString(), (*it).addr.ToString(), size() - 1);
 
                 // erase all of the broadcasts we've seen from this txin, ...
@@ -208,13 +255,17 @@ void CGhostnodeMan::CheckAndRemove()
                 // and finally remove it from the list
 //                it->FlagGovernanceItemsAsDirty();
                 it = vGhostnodes.erase(it);
+                RebuildLookupIndexes();
+                mapScoredGhostnodes.clear();
                 fGhostnodesRemoved = true;
             } else {
+                // only hash the broadcast for the few entries that may need recovery
+                uint256 hash;
                 bool fAsk = pCurrentBlockIndex &&
                             (nAskForMnbRecovery > 0) &&
                             ghostnodeSync.IsSynced(chainActive.Height()) &&
                             it->IsNewStartRequired() &&
-                            !IsMnbRecoveryRequested(hash);
+                            !IsMnbRecoveryRequested(hash = CGhostnodeBroadcast(*it).GetHash());
                 if(fAsk) {
                     // this mn is in a non-recoverable state and we haven't asked other nodes yet
                     std::set<CNetAddr> setRequested;
@@ -247,7 +298,7 @@ void CGhostnodeMan::CheckAndRemove()
 
         // proces replies for GHOSTNODE_NEW_START_REQUIRED ghostnodes
         //LogPrint("ghostnode", "CGhostnodeMan::CheckAndRemove -- mMnbRecoveryGoodReplies size=%d\n", (int)mMnbRecoveryGoodReplies.size());
-        std::map<uint256, std::vector<CGhostnodeBroadcast> >::iterator itMnbReplies = mMnbRecoveryGoodReplies.begin();
+        std::map<uint256, std::vector<CGhostnodeBroadcastRef> >::iterator itMnbReplies = mMnbRecoveryGoodReplies.begin();
         while(itMnbReplies != mMnbRecoveryGoodReplies.end()){
             if(mMnbRecoveryRequests[itMnbReplies->first].first < GetTime()) {
                 // all nodes we asked should have replied now
@@ -256,8 +307,9 @@ void CGhostnodeMan::CheckAndRemove()
                     //LogPrint("ghostnode", "CGhostnodeMan::CheckAndRemove -- reprocessing mnb, ghostnode=%s\n", itMnbReplies->second[0].vin.prevout.ToStringShort());
                     // mapSeenGhostnodeBroadcast.erase(itMnbReplies->first);
                     int nDos;
-                    itMnbReplies->second[0].fRecovery = true;
-                    CheckMnbAndUpdateGhostnodeList(NULL, itMnbReplies->second[0], nDos);
+                    CGhostnodeBroadcast mnb(*itMnbReplies->second[0]);
+                    mnb.fRecovery = true;
+                    CheckMnbAndUpdateGhostnodeList(NULL, mnb, nDos);
                 }
                 //LogPrint("ghostnode", "CGhostnodeMan::CheckAndRemove -- removing mnb recovery reply, ghostnode=%s, size=%d\n", itMnbReplies->second[0].vin.prevout.ToStringShort(), (int)itMnbReplies->second.size());
                 mMnbRecoveryGoodReplies.erase(itMnbReplies++);
@@ -322,6 +374,7 @@ void CGhostnodeMan::CheckAndRemove()
         std::map<CNetAddr, CGhostnodeVerification>::iterator it3 = mWeAskedForVerification.begin();
         while(it3 != mWeAskedForVerification.end()){
             if(it3->second.nBlockHeight < pCurrentBlockIndex->nHeight - MAX_POSE_BLOCKS) {
+                mWeAskedForVerificationTime.erase(it3->first);
                 mWeAskedForVerification.erase(it3++);
             } else {
                 ++it3;
@@ -330,26 +383,25 @@ void CGhostnodeMan::CheckAndRemove()
 
         // NOTE: do not expire mapSeenGhostnodeBroadcast entries here, clean them on mnb updates!
 
-        // remove expired mapSeenGhostnodePing
-        std::map<uint256, CGhostnodePing>::iterator it4 = mapSeenGhostnodePing.begin();
-        while(it4 != mapSeenGhostnodePing.end()){
-            if((*it4).second.IsExpired()) {
-                //LogPrint("ghostnode", "CGhostnodeMan::CheckAndRemove -- Removing expired Ghostnode ping: hash=%s\n", (*it4).second.GetHash().ToString());
-                mapSeenGhostnodePing.erase(it4++);
-            } else {
-                ++it4;
+        // remove expired mapSeenGhostnodePing, oldest first
+        while(!mapSeenGhostnodePingsByTime.empty()) {
+            std::multimap<int64_t, uint256>::iterator it4 = mapSeenGhostnodePingsByTime.begin();
+            std::map<uint256, CGhostnodePing>::iterator itPing = mapSeenGhostnodePing.find(it4->second);
+            if(itPing != mapSeenGhostnodePing.end()) {
+                if(!itPing->second.IsExpired()) break;
+                //LogPrint("ghostnode", "CGhostnodeMan::CheckAndRemove -- Removing expired Ghostnode ping: hash=%s\n", itPing->second.GetHash().ToString());
+                mapSeenGhostnodePing.erase(itPing);
             }
+            mapSeenGhostnodePingsByTime.erase(it4);
         }
 
-        // remove expired mapSeenGhostnodeVerification
-        std::map<uint256, CGhostnodeVerification>::iterator itv2 = mapSeenGhostnodeVerification.begin();
-        while(itv2 != mapSeenGhostnodeVerification.end()){
-            if((*itv2).second.nBlockHeight < pCurrentBlockIndex->nHeight - MAX_POSE_BLOCKS){
-                //LogPrint("ghostnode", "CGhostnodeMan::CheckAndRemove -- Removing expired Ghostnode verification: hash=%s\n", (*itv2).first.ToString());
-                mapSeenGhostnodeVerification.erase(itv2++);
-            } else {
-                ++itv2;
-            }
+        // remove expired mapSeenGhostnodeVerification, oldest first
+        while(!mapSeenGhostnodeVerificationsByHeight.empty()) {
+            std::multimap<int, uint256>::iterator itv2 = mapSeenGhostnodeVerificationsByHeight.begin();
+            if(itv2->first >= pCurrentBlockIndex->nHeight - MAX_POSE_BLOCKS) break;
+            //LogPrint("ghostnode", "CGhostnodeMan::CheckAndRemove -- Removing expired Ghostnode verification: hash=%s\n", itv2->second.ToString());
+            mapSeenGhostnodeVerification.erase(itv2->second);
+            mapSeenGhostnodeVerificationsByHeight.erase(itv2);
         }
 
         //LogPrint("CGhostnodeMan::CheckAndRemove -- %s\n", ToString());
@@ -368,17 +420,80 @@ void CGhostnodeMan::Clear()
 {
     LOCK(cs);
     vGhostnodes.clear();
+    UpdateMetrics();
+    mapScoredGhostnodes.clear();
+    mapGhostnodesByOutpoint.clear();
+    mapGhostnodesByPubKey.clear();
+    mapGhostnodesByPayee.clear();
+    mapGhostnodesByAddr.clear();
+    {
+        LOCK(cs_collaterals);
+        setWatchedCollaterals.clear();
+    }
     mAskedUsForGhostnodeList.clear();
     mWeAskedForGhostnodeList.clear();
     mWeAskedForGhostnodeListEntry.clear();
     mapSeenGhostnodeBroadcast.clear();
     mapSeenGhostnodePing.clear();
+    mapSeenGhostnodePingsByTime.clear();
+    mapSeenGhostnodeVerification.clear();
+    mapSeenGhostnodeVerificationsByHeight.clear();
+    ghostnodeSeenInventory.Clear(MSG_GHOSTNODE_PING);
+    ghostnodeSeenInventory.Clear(MSG_GHOSTNODE_VERIFY);
     nDsqCount = 0;
     nLastWatchdogVoteTime = 0;
+    nDsegSinceTime = 0;
     indexGhostnodes.Clear();
     indexGhostnodesOld.Clear();
 }
 
+std::shared_ptr<const std::vector<CGhostnode> > CGhostnodeMan::GetFullGhostnodeVector()
+{
+    // Share a recent copy, refresh it only when the list is not busy, otherwise serve the
+    // previous one. Wait for the list only if there is no copy yet.
+    {
+        LOCK(cs_snapshot);
+        if (pGhostnodesSnapshot && GetTimeMillis() - nSnapshotTimeMillis < SNAPSHOT_MAX_AGE_MILLIS) return pGhostnodesSnapshot;
+    }
+    {
+        TRY_LOCK(cs, lockGhostnodes);
+        if (lockGhostnodes) {
+            LOCK(cs_snapshot);
+            pGhostnodesSnapshot = std::make_shared<const std::vector<CGhostnode> >(vGhostnodes);
+            nSnapshotTimeMillis = GetTimeMillis();
+            return pGhostnodesSnapshot;
+        }
+    }
+    {
+        LOCK(cs_snapshot);
+        if (pGhostnodesSnapshot) return pGhostnodesSnapshot;
+    }
+    LOCK2(cs, cs_snapshot);
+    pGhostnodesSnapshot = std::make_shared<const std::vector<CGhostnode> >(vGhostnodes);
+    nSnapshotTimeMillis = GetTimeMillis();
+    return pGhostnodesSnapshot;
+}
+
+bool CGhostnodeMan::GetSeenGhostnodeBroadcast(const uint256& hash, CGhostnodeBroadcastRef& mnbRet)
+{
+    LOCK(cs);
+    std::map<uint256, std::pair<int64_t, CGhostnodeBroadcastRef> >::iterator it = mapSeenGhostnodeBroadcast.find(hash);
+    if (it == mapSeenGhostnodeBroadcast.end()) return false;
+    mnbRet = it->second.second;
+    return true;
+}
+
+void CGhostnodeMan::UpdateSeenGhostnodeBroadcastPing(const uint256& hash, const CGhostnodePing& mnp)
+{
+    AssertLockHeld(cs);
+    std::map<uint256, std::pair<int64_t, CGhostnodeBroadcastRef> >::iterator it = mapSeenGhostnodeBroadcast.find(hash);
+    if (it == mapSeenGhostnodeBroadcast.end()) return;
+    // the old broadcast may still be referenced elsewhere, replace it with an updated copy
+    CGhostnodeBroadcast mnb(*it->second.second);
+    mnb.lastPing = mnp;
+    it->second.second = std::make_shared<const CGhostnodeBroadcast>(mnb);
+}
+
 int CGhostnodeMan::CountGhostnodes(int nProtocolVersion)
 {
     LOCK(cs);
@@ -439,47 +554,82 @@ void CGhostnodeMan::DsegUpdate(CNode* pnode)
     }
     
     const CNetMsgMaker msgMaker(pnode->GetSendVersion());
-    g_connman->PushMessage(pnode, msgMaker.Make(NetMsgType::DSEG, CTxIn()));
+    if(nDsegSinceTime > 0) {
+        // we still have the list from before a restart, only ask for what changed since.
+        // Peers that do not know about this ignore the extra field and send the full list
+        g_connman->PushMessage(pnode, msgMaker.Make(NetMsgType::DSEG, CTxIn(), nDsegSinceTime - DSEG_DELTA_MARGIN_SECONDS));
+    } else {
+        g_connman->PushMessage(pnode, msgMaker.Make(NetMsgType::DSEG, CTxIn()));
+    }
     int64_t askAgain = GetTime() + DSEG_UPDATE_SECONDS;
     mWeAskedForGhostnodeList[pnode->addr] = askAgain;
 
     //LogPrint("ghostnode", "CGhostnodeMan::DsegUpdate -- asked %s for the list\n", pnode->addr.ToString());
 }
 
-CGhostnode* CGhostnodeMan::Find(const CScript &payee)
+void CGhostnodeMan::AddToLookupIndexes(size_t nPos)
 {
-    LOCK(cs);
+    AssertLockHeld(cs);
+
+    const CGhostnode& mn = vGhostnodes[nPos];
+    // insert() keeps the entry of an earlier ghostnode with the same key
+    mapGhostnodesByOutpoint.insert(std::make_pair(mn.vin.prevout, nPos));
+    mapGhostnodesByPubKey.insert(std::make_pair(mn.pubKeyGhostnode, nPos));
+    mapGhostnodesByPayee.insert(std::make_pair(GetScriptForDestination(mn.pubKeyCollateralAddress.GetID()), nPos));
+    mapGhostnodesByAddr.insert(std::make_pair(mn.addr, nPos));
+    LOCK(cs_collaterals);
+    setWatchedCollaterals.insert(mn.vin.prevout);
+}
 
-    BOOST_FOREACH(CGhostnode& mn, vGhostnodes)
+void CGhostnodeMan::RebuildLookupIndexes()
+{
+    AssertLockHeld(cs);
+
+    mapGhostnodesByOutpoint.clear();
+    mapGhostnodesByPubKey.clear();
+    mapGhostnodesByPayee.clear();
+    mapGhostnodesByAddr.clear();
     {
-        if(GetScriptForDestination(mn.pubKeyCollateralAddress.GetID()) == payee)
-            return &mn;
+        LOCK(cs_collaterals);
+        setWatchedCollaterals.clear();
     }
-    return NULL;
+    for (size_t i = 0; i < vGhostnodes.size(); i++) {
+        AddToLookupIndexes(i);
+    }
+    UpdateMetrics();
+}
+
+void CGhostnodeMan::UpdateMetrics() const
+{
+    if (this == &mnodeman)
+        MetricSet(Metric::GHOSTNODES, vGhostnodes.size());
+}
+
+CGhostnode* CGhostnodeMan::Find(const CScript &payee)
+{
+    LOCK(cs);
+
+    std::map<CScript, size_t>::const_iterator it = mapGhostnodesByPayee.find(payee);
+    if(it == mapGhostnodesByPayee.end()) return NULL;
+    return &vGhostnodes[it->second];
 }
 
 CGhostnode* CGhostnodeMan::Find(const CTxIn &vin)
 {
     LOCK(cs);
 
-    BOOST_FOREACH(CGhostnode& mn, vGhostnodes)
-    {
-        if(mn.vin.prevout == vin.prevout)
-            return &mn;
-    }
-    return NULL;
+    std::map<COutPoint, size_t>::const_iterator it = mapGhostnodesByOutpoint.find(vin.prevout);
+    if(it == mapGhostnodesByOutpoint.end()) return NULL;
+    return &vGhostnodes[it->second];
 }
 
 CGhostnode* CGhostnodeMan::Find(const CPubKey &pubKeyGhostnode)
 {
     LOCK(cs);
 
-    BOOST_FOREACH(CGhostnode& mn, vGhostnodes)
-    {
-        if(mn.pubKeyGhostnode == pubKeyGhostnode)
-            return &mn;
-    }
-    return NULL;
+    std::map<CPubKey, size_t>::const_iterator it = mapGhostnodesByPubKey.find(pubKeyGhostnode);
+    if(it == mapGhostnodesByPubKey.end()) return NULL;
+    return &vGhostnodes[it->second];
 }
 
 bool CGhostnodeMan::Get(const CPubKey& pubKeyGhostnode, CGhostnode& ghostnode)
@@ -538,6 +688,13 @@ bool CGhostnodeMan::Has(const CTxIn& vin)
 }
 
 char* CGhostnodeMan::GetNotQualifyReason(CGhostnode& mn, int nBlockHeight, bool fFilterSigTime, int nMnCount)
+{
+    std::set<CScript> setScheduledPayees;
+    mnpayments.GetScheduledPayees(nBlockHeight, setScheduledPayees);
+    return GetNotQualifyReason(mn, nBlockHeight, fFilterSigTime, nMnCount, setScheduledPayees);
+}
+
+char* CGhostnodeMan::GetNotQualifyReason(CGhostnode& mn, int nBlockHeight, bool fFilterSigTime, int nMnCount, const std::set<CScript>& setScheduledPayees)
 {
     if (!mn.IsValidForPayment()) {
         char* reasonStr = new char[256];
@@ -554,7 +711,7 @@ char* CGhostnodeMan::GetNotQualifyReason(CGhostnode& mn, int nBlockHeight, bool
         return reasonStr;
     }
     //it's in the list (up to 8 entries ahead of current block to allow propagation) -- so let's skip it
-    if (mnpayments.IsScheduled(mn, nBlockHeight)) {
+    if (setScheduledPayees.count(GetScriptForDestination(mn.pubKeyCollateralAddress.GetID()))) {
         // //LogPrint("mnpayments.IsScheduled!\n");
         char* reasonStr = new char[256];
         sprintf(reasonStr, "false: 'is scheduled'");
@@ -602,44 +759,44 @@ CGhostnode* CGhostnodeMan::GetNextGhostnodeInQueueForPayment(int nBlockHeight, b
     /*
         Make a vector with all of the last paid times
     */
-    LogPrintf("\nGhostnode InQueueForPayment \n");
     int nMnCount = CountEnabled();
-    int index = 0;
+    // the payees voted for the next blocks are the same for every ghostnode, look them up once
+    std::set<CScript> setScheduledPayees;
+    mnpayments.GetScheduledPayees(nBlockHeight, setScheduledPayees);
     BOOST_FOREACH(CGhostnode &mn, vGhostnodes)
     {
-        index += 1;
-
-        char* reasonStr = GetNotQualifyReason(mn, nBlockHeight, fFilterSigTime, nMnCount);
+        char* reasonStr = GetNotQualifyReason(mn, nBlockHeight, fFilterSigTime, nMnCount, setScheduledPayees);
         if (reasonStr != NULL) {
             //LogPrint("ghostnodeman", "Ghostnode, %s, addr(%s), qualify %s\n",
                      //mn.vin.prevout.ToStringShort(), CBitcoinAddress(mn.pubKeyCollateralAddress.GetID()).ToString(), reasonStr);
             delete [] reasonStr;
             continue;
         }
-        LogPrintf("\nNODE Last Paid\n");
         vecGhostnodeLastPaid.push_back(std::make_pair(mn.GetLastPaidBlock(), &mn));
     }
     nCount = (int)vecGhostnodeLastPaid.size();
 
     //when the network is in the process of upgrading, don't penalize nodes that recently restarted
     if(fFilterSigTime && nCount < nMnCount / 3) {
-        LogPrintf("Need Return, nCount=%s, nMnCount/3=%s\n", nCount, nMnCount/3);
+        LogPrint(BCLog::GHOSTNODE, "Need Return, nCount=%s, nMnCount/3=%s\n", nCount, nMnCount/3);
         return GetNextGhostnodeInQueueForPayment(nBlockHeight, false, nCount);
     }
 
-    // Sort them low to high
-    sort(vecGhostnodeLastPaid.begin(), vecGhostnodeLastPaid.end(), CompareLastPaidBlock());
+    // Look at 1/10 of the oldest nodes (by last payment), calculate their scores and pay the best one
+    //  -- This doesn't look at who is being paid in the +8-10 blocks, allowing for double payments very rarely
+    //  -- 1/100 payments should be a double payment on mainnet - (1/(3000/10))*2
+    //  -- (chance per block * chances before IsScheduled will fire)
+    int nTenthNetwork = nMnCount/10;
+
+    // Sort them low to high, only the oldest tenth (at least one) is looked at below
+    size_t nSorted = std::min(vecGhostnodeLastPaid.size(), (size_t)std::max(nTenthNetwork, 1));
+    std::partial_sort(vecGhostnodeLastPaid.begin(), vecGhostnodeLastPaid.begin() + nSorted, vecGhostnodeLastPaid.end(), CompareLastPaidBlock());
 
     uint256 blockHash;
     if(!GetBlockHash(blockHash, nBlockHeight - 100)) {
         LogPrintf("CGhostnode::GetNextGhostnodeInQueueForPayment -- ERROR: GetBlockHash() failed at nBlockHeight %d\n", (nBlockHeight - 100));
         return NULL;
     }
-    // Look at 1/10 of the oldest nodes (by last payment), calculate their scores and pay the best one
-    //  -- This doesn't look at who is being paid in the +8-10 blocks, allowing for double payments very rarely
-    //  -- 1/100 payments should be a double payment on mainnet - (1/(3000/10))*2
-    //  -- (chance per block * chances before IsScheduled will fire)
-    int nTenthNetwork = nMnCount/10;
     int nCountTenth = 0;
     arith_uint256 nHighest = 0;
     BOOST_FOREACH (PAIRTYPE(int, CGhostnode*)& s, vecGhostnodeLastPaid){
@@ -697,18 +854,44 @@ CGhostnode* CGhostnodeMan::FindRandomNotInVec(const std::vector<CTxIn> &vecToExc
     return NULL;
 }
 
-int CGhostnodeMan::GetGhostnodeRank(const CTxIn& vin, int nBlockHeight, int nMinProtocol, bool fOnlyActive)
+const std::vector<std::pair<int64_t, CGhostnode*> >& CGhostnodeMan::GetScoredGhostnodes(int nBlockHeight, const uint256& blockHash)
 {
-    std::vector<std::pair<int64_t, CGhostnode*> > vecGhostnodeScores;
+    AssertLockHeld(cs);
+
+    std::map<int, CScoredGhostnodes>::iterator it = mapScoredGhostnodes.find(nBlockHeight);
+    if(it != mapScoredGhostnodes.end() && it->second.blockHash == blockHash) return it->second.vecScores;
+
+    // drop the lowest height when full
+    if(it == mapScoredGhostnodes.end() && (int)mapScoredGhostnodes.size() >= MAX_SCORE_CACHE_HEIGHTS) {
+        mapScoredGhostnodes.erase(mapScoredGhostnodes.begin());
+    }
+
+    CScoredGhostnodes& scored = mapScoredGhostnodes[nBlockHeight];
+    scored.blockHash = blockHash;
+    scored.vecScores.clear();
+    scored.vecScores.reserve(vGhostnodes.size());
+    BOOST_FOREACH(CGhostnode& mn, vGhostnodes) {
+        int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
+        scored.vecScores.push_back(std::make_pair(nScore, &mn));
+    }
 
+    sort(scored.vecScores.rbegin(), scored.vecScores.rend(), CompareScoreMN());
+
+    return scored.vecScores;
+}
+
+int CGhostnodeMan::GetGhostnodeRank(const CTxIn& vin, int nBlockHeight, int nMinProtocol, bool fOnlyActive)
+{
     //make sure we know about this block
     uint256 blockHash = uint256();
     if(!GetBlockHash(blockHash, nBlockHeight)) return -1;
 
     LOCK(cs);
 
-    // scan for winner
-    BOOST_FOREACH(CGhostnode& mn, vGhostnodes) {
+    // scan for winner, ghostnodes filtered out do not take a rank
+    int nRank = 0;
+    BOOST_FOREACH (const PAIRTYPE(int64_t, CGhostnode*)& scorePair, GetScoredGhostnodes(nBlockHeight, blockHash)) {
+        CGhostnode& mn = *scorePair.second;
         if(mn.nProtocolVersion < nMinProtocol) continue;
         if(fOnlyActive) {
             if(!mn.IsEnabled()) continue;
@@ -716,17 +899,8 @@ int CGhostnodeMan::GetGhostnodeRank(const CTxIn& vin, int nBlockHeight, int nMin
         else {
             if(!mn.IsValidForPayment()) continue;
         }
-        int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
-
-        vecGhostnodeScores.push_back(std::make_pair(nScore, &mn));
-    }
-
-    sort(vecGhostnodeScores.rbegin(), vecGhostnodeScores.rend(), CompareScoreMN());
-
-    int nRank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CGhostnode*)& scorePair, vecGhostnodeScores) {
         nRank++;
-        if(scorePair.second->vin.prevout == vin.prevout) return nRank;
+        if(mn.vin.prevout == vin.prevout) return nRank;
     }
 
     return -1;
@@ -734,7 +908,6 @@ int CGhostnodeMan::GetGhostnodeRank(const CTxIn& vin, int nBlockHeight, int nMin
 
 std::vector<std::pair<int, CGhostnode> > CGhostnodeMan::GetGhostnodeRanks(int nBlockHeight, int nMinProtocol)
 {
-    std::vector<std::pair<int64_t, CGhostnode*> > vecGhostnodeScores;
     std::vector<std::pair<int, CGhostnode> > vecGhostnodeRanks;
 
     //make sure we know about this block
@@ -743,54 +916,70 @@ std::vector<std::pair<int, CGhostnode> > CGhostnodeMan::GetGhostnodeRanks(int nB
 
     LOCK(cs);
 
-    // scan for winner
-    BOOST_FOREACH(CGhostnode& mn, vGhostnodes) {
+    int nRank = 0;
+    BOOST_FOREACH (const PAIRTYPE(int64_t, CGhostnode*)& s, GetScoredGhostnodes(nBlockHeight, blockHash)) {
+        if(s.second->nProtocolVersion < nMinProtocol || !s.second->IsEnabled()) continue;
+        nRank++;
+        vecGhostnodeRanks.push_back(std::make_pair(nRank, *s.second));
+    }
 
-        if(mn.nProtocolVersion < nMinProtocol || !mn.IsEnabled()) continue;
+    return vecGhostnodeRanks;
+}
 
-        int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
+std::vector<std::pair<int, COutPoint> > CGhostnodeMan::GetGhostnodeRankOutpoints(int nBlockHeight, int nMinProtocol)
+{
+    std::vector<std::pair<int, COutPoint> > vecRanks;
 
-        vecGhostnodeScores.push_back(std::make_pair(nScore, &mn));
-    }
+    //make sure we know about this block
+    uint256 blockHash = uint256();
+    if(!GetBlockHash(blockHash, nBlockHeight)) return vecRanks;
 
-    sort(vecGhostnodeScores.rbegin(), vecGhostnodeScores.rend(), CompareScoreMN());
+    LOCK(cs);
 
     int nRank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CGhostnode*)& s, vecGhostnodeScores) {
+    BOOST_FOREACH (const PAIRTYPE(int64_t, CGhostnode*)& s, GetScoredGhostnodes(nBlockHeight, blockHash)) {
+        if(s.second->nProtocolVersion < nMinProtocol || !s.second->IsEnabled()) continue;
         nRank++;
-        vecGhostnodeRanks.push_back(std::make_pair(nRank, *s.second));
+        vecRanks.push_back(std::make_pair(nRank, s.second->vin.prevout));
     }
 
-    return vecGhostnodeRanks;
+    return vecRanks;
 }
 
-CGhostnode* CGhostnodeMan::GetGhostnodeByRank(int nRank, int nBlockHeight, int nMinProtocol, bool fOnlyActive)
+bool CGhostnodeMan::GetTopGhostnodes(int nBlockHeight, int nMinProtocol, int nCount, std::set<COutPoint>& setOutpointsRet)
 {
-    std::vector<std::pair<int64_t, CGhostnode*> > vecGhostnodeScores;
+    setOutpointsRet.clear();
+
+    //make sure we know about this block
+    uint256 blockHash = uint256();
+    if(!GetBlockHash(blockHash, nBlockHeight)) return false;
 
     LOCK(cs);
 
-    uint256 blockHash;
-    if(!GetBlockHash(blockHash, nBlockHeight)) {
-        //LogPrint("CGhostnode::GetGhostnodeByRank -- ERROR: GetBlockHash() failed at nBlockHeight %d\n", nBlockHeight);
-        return NULL;
+    // same ranking as GetGhostnodeRank with fOnlyActive
+    BOOST_FOREACH (const PAIRTYPE(int64_t, CGhostnode*)& s, GetScoredGhostnodes(nBlockHeight, blockHash)) {
+        if((int)setOutpointsRet.size() >= nCount) break;
+        if(s.second->nProtocolVersion < nMinProtocol || !s.second->IsEnabled()) continue;
+        setOutpointsRet.insert(s.second->vin.prevout);
     }
 
-    // Fill scores
-    BOOST_FOREACH(CGhostnode& mn, vGhostnodes) {
-
-        if(mn.nProtocolVersion < nMinProtocol) continue;
-        if(fOnlyActive && !mn.IsEnabled()) continue;
+    return true;
+}
 
-        int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
+CGhostnode* CGhostnodeMan::GetGhostnodeByRank(int nRank, int nBlockHeight, int nMinProtocol, bool fOnlyActive)
+{
+    LOCK(cs);
 
-        vecGhostnodeScores.push_back(std::make_pair(nScore, &mn));
+    uint256 blockHash;
+    if(!GetBlockHash(blockHash, nBlockHeight)) {
+        //LogPrint("CGhostnode::GetGhostnodeByRank -- ERROR: GetBlockHash() failed at nBlockHeight %d\n", nBlockHeight);
+        return NULL;
     }
 
-    sort(vecGhostnodeScores.rbegin(), vecGhostnodeScores.rend(), CompareScoreMN());
-
     int rank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CGhostnode*)& s, vecGhostnodeScores){
+    BOOST_FOREACH (const PAIRTYPE(int64_t, CGhostnode*)& s, GetScoredGhostnodes(nBlockHeight, blockHash)){
+        if(s.second->nProtocolVersion < nMinProtocol) continue;
+        if(fOnlyActive && !s.second->IsEnabled()) continue;
         rank++;
         if(rank == nRank) {
             return s.second;
@@ -843,6 +1032,63 @@ std::pair<CService, std::set<uint256> > CGhostnodeMan::PopScheduledMnbRequestCon
 }
 
 
+void CGhostnodeMan::VerifyQueuedSignatures(CNode* pfrom, std::vector<CSignedMessageCheck>& vChecks)
+{
+    if (!nScriptCheckThreads) return;
+
+    // copy the queued messages out, cs_vProcessMsg must not be held while waiting for cs
+    std::vector<CDataStream> vMnbStreams;
+    std::vector<CDataStream> vMnpStreams;
+    {
+        LOCK(pfrom->cs_vProcessMsg);
+        BOOST_FOREACH(const CNetMessage& msg, pfrom->vProcessMsg) {
+            if (vMnbStreams.size() + vMnpStreams.size() >= MAX_QUEUED_SIGNATURE_CHECKS) break;
+            std::string strCommand = msg.hdr.GetCommand();
+            if (strCommand == NetMsgType::MNANNOUNCE) {
+                vMnbStreams.push_back(msg.vRecv);
+            } else if (strCommand == NetMsgType::MNPING) {
+                vMnpStreams.push_back(msg.vRecv);
+            }
+        }
+    }
+
+    // ghostnode keys announced in this batch, for the pings that follow the announces
+    std::map<COutPoint, CPubKey> mapPubKeys;
+    bool fNewSigs = sporkManager.IsSporkActive(SPORK_6_NEW_SIGS);
+    BOOST_FOREACH(CDataStream& ss, vMnbStreams) {
+        CGhostnodeBroadcast mnb;
+        try {
+            ss >> mnb;
+        } catch (const std::exception&) {
+            continue;
+        }
+        vChecks.push_back(CSignedMessageCheck(mnb.pubKeyCollateralAddress, mnb.vchSig, mnb.GetSignatureHash(fNewSigs)));
+        vChecks.push_back(CSignedMessageCheck(mnb.pubKeyGhostnode, mnb.lastPing.vchSig, mnb.lastPing.GetSignatureHash(fNewSigs)));
+        mapPubKeys[mnb.vin.prevout] = mnb.pubKeyGhostnode;
+    }
+
+    {
+        LOCK(cs);
+        BOOST_FOREACH(CDataStream& ss, vMnpStreams) {
+            CGhostnodePing mnp;
+            try {
+                ss >> mnp;
+            } catch (const std::exception&) {
+                continue;
+            }
+            std::map<COutPoint, CPubKey>::iterator it = mapPubKeys.find(mnp.vin.prevout);
+            if (it != mapPubKeys.end()) {
+                vChecks.push_back(CSignedMessageCheck(it->second, mnp.vchSig, mnp.GetSignatureHash(fNewSigs)));
+            } else {
+                CGhostnode* pmn = Find(mnp.vin);
+                if (pmn) vChecks.push_back(CSignedMessageCheck(pmn->pubKeyGhostnode, mnp.vchSig, mnp.GetSignatureHash(fNewSigs)));
+            }
+        }
+    }
+
+    darkSendSigner.VerifyMessages(vChecks);
+}
+
 void CGhostnodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv)
 {
 
@@ -850,14 +1096,31 @@ void CGhostnodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
     if(fLiteMode) return; // disable all Dash specific functionality
     if(!ghostnodeSync.IsBlockchainSynced()) return;
 
+    CGhostnodeStatsTimer timer(GHOSTNODE_STATS_DURATION, "CGhostnodeMan::ProcessMessage");
+
     if (strCommand == NetMsgType::MNANNOUNCE) { //Ghostnode Broadcast
         CGhostnodeBroadcast mnb;
         vRecv >> mnb;
 
-        pfrom->setAskFor.erase(mnb.GetHash());
+        {
+            LOCK(cs_main);
+            pfrom->setAskFor.erase(mnb.GetHash());
+        }
+        pfrom->AddInventoryKnown(CInv(MSG_GHOSTNODE_ANNOUNCE, mnb.GetHash()));
 
         //LogPrint("MNANNOUNCE -- Ghostnode announce, ghostnode=%s\n", mnb.vin.prevout.ToStringShort());
 
+        // a list sync sends announces in bulk, verify the queued ones in parallel
+        bool fNewSigs = sporkManager.IsSporkActive(SPORK_6_NEW_SIGS);
+        uint256 hashSigned = mnb.GetSignatureHash(fNewSigs);
+        if (!darkSendSigner.IsVerifiedHash(mnb.pubKeyCollateralAddress, mnb.vchSig, hashSigned) &&
+            !darkSendSigner.IsRejectedHash(hashSigned)) {
+            std::vector<CSignedMessageCheck> vChecks;
+            vChecks.push_back(CSignedMessageCheck(mnb.pubKeyCollateralAddress, mnb.vchSig, hashSigned));
+            vChecks.push_back(CSignedMessageCheck(mnb.pubKeyGhostnode, mnb.lastPing.vchSig, mnb.lastPing.GetSignatureHash(fNewSigs)));
+            VerifyQueuedSignatures(pfrom, vChecks);
+        }
+
         int nDos = 0;
 
         if (CheckMnbAndUpdateGhostnodeList(pfrom, mnb, nDos)) {
@@ -877,15 +1140,37 @@ void CGhostnodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
 
         uint256 nHash = mnp.GetHash();
 
-        pfrom->setAskFor.erase(nHash);
+        {
+            LOCK(cs_main);
+            pfrom->setAskFor.erase(nHash);
+        }
+        // the sender has the ping, don't announce it back when we relay it
+        pfrom->AddInventoryKnown(CInv(MSG_GHOSTNODE_PING, nHash));
 
         //LogPrint("ghostnode", "MNPING -- Ghostnode ping, ghostnode=%s\n", mnp.vin.prevout.ToStringShort());
 
+        // pings come in bulk too, verify the queued ones in parallel before taking cs_main
+        CPubKey pubKeyGhostnode;
+        {
+            LOCK(cs);
+            CGhostnode* pmn = mapSeenGhostnodePing.count(nHash) ? NULL : Find(mnp.vin);
+            if (pmn) pubKeyGhostnode = pmn->pubKeyGhostnode;
+        }
+        uint256 hashSigned = mnp.GetSignatureHash(sporkManager.IsSporkActive(SPORK_6_NEW_SIGS));
+        if (pubKeyGhostnode.IsValid() && !darkSendSigner.IsVerifiedHash(pubKeyGhostnode, mnp.vchSig, hashSigned) &&
+            !darkSendSigner.IsRejectedHash(hashSigned)) {
+            std::vector<CSignedMessageCheck> vChecks;
+            vChecks.push_back(CSignedMessageCheck(pubKeyGhostnode, mnp.vchSig, hashSigned));
+            VerifyQueuedSignatures(pfrom, vChecks);
+        }
+
         // Need LOCK2 here to ensure consistent locking order because the CheckAndUpdate call below locks cs_main
+        CGhostnodeStatsTimer waitTimer(GHOSTNODE_STATS_LOCK_WAIT, "CGhostnodeMan::ProcessMessage MNPING cs_main, cs");
         LOCK2(cs_main, cs);
+        waitTimer.Stop();
 
         if(mapSeenGhostnodePing.count(nHash)) return; //seen
-        mapSeenGhostnodePing.insert(std::make_pair(nHash, mnp));
+        AddSeenGhostnodePing(mnp);
 
         //LogPrint("ghostnode", "MNPING -- Ghostnode ping, ghostnode=%s new\n", mnp.vin.prevout.ToStringShort());
 
@@ -919,6 +1204,12 @@ void CGhostnodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
         CTxIn vin;
         vRecv >> vin;
 
+        // optional, only send the entries announced or pinged after this time
+        int64_t nSince = 0;
+        if(!vRecv.empty()) {
+            vRecv >> nSince;
+        }
+
         //LogPrint("ghostnode", "DSEG -- Ghostnode list, ghostnode=%s\n", vin.prevout.ToStringShort());
 
         LOCK(cs);
@@ -948,16 +1239,20 @@ void CGhostnodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataS
             if (vin != CTxIn() && vin != mn.vin) continue; // asked for specific vin but we are not there yet
             if (mn.addr.IsRFC1918() || mn.addr.IsLocal()) continue; // do not send local network ghostnode
             if (mn.IsUpdateRequired()) continue; // do not send outdated ghostnodes
+            if (vin == CTxIn() && mn.sigTime <= nSince && mn.lastPing.sigTime <= nSince) continue; // peer has it already
 
             //LogPrint("ghostnode", "DSEG -- Sending Ghostnode entry: ghostnode=%s  addr=%s\n", mn.vin.prevout.ToStringShort(), mn.addr.ToString());
             CGhostnodeBroadcast mnb = CGhostnodeBroadcast(mn);
             uint256 hash = mnb.GetHash();
-            pfrom->PushInventory(CInv(MSG_GHOSTNODE_ANNOUNCE, hash));
+            // a peer that misses the announce of a newer ping asks for it with AskForMN
+            if (vin != CTxIn() || mn.sigTime > nSince) {
+                pfrom->PushInventory(CInv(MSG_GHOSTNODE_ANNOUNCE, hash));
+            }
             pfrom->PushInventory(CInv(MSG_GHOSTNODE_PING, mn.lastPing.GetHash()));
             nInvCount++;
 
             if (!mapSeenGhostnodeBroadcast.count(hash)) {
-                mapSeenGhostnodeBroadcast.insert(std::make_pair(hash, std::make_pair(GetTime(), mnb)));
+                mapSeenGhostnodeBroadcast.insert(std::make_pair(hash, std::make_pair(GetTime(), std::make_shared<const CGhostnodeBroadcast>(mnb))));
             }
 
             if (vin == mn.vin) {
@@ -1005,10 +1300,6 @@ void CGhostnodeMan::DoFullVerificationStep()
 
     std::vector<std::pair<int, CGhostnode> > vecGhostnodeRanks = GetGhostnodeRanks(pCurrentBlockIndex->nHeight - 1, MIN_POSE_PROTO_VERSION);
 
-    // Need LOCK2 here to ensure consistent locking order because the SendVerifyRequest call below locks cs_main
-    // through GetHeight() signal in ConnectNode
-    LOCK2(cs_main, cs);
-
     int nCount = 0;
 
     int nMyRank = -1;
@@ -1039,13 +1330,8 @@ void CGhostnodeMan::DoFullVerificationStep()
     int nOffset = MAX_POSE_RANK + nMyRank - 1;
     if(nOffset >= (int)vecGhostnodeRanks.size()) return;
 
-    std::vector<CGhostnode*> vSortedByAddr;
-    BOOST_FOREACH(CGhostnode& mn, vGhostnodes) {
-        vSortedByAddr.push_back(&mn);
-    }
-
-    sort(vSortedByAddr.begin(), vSortedByAddr.end(), CompareByAddr());
-
+    // vecGhostnodeRanks holds copies, so no lock is needed to pick the candidates and
+    // connecting to them does not hold up everyone else waiting for cs_main or cs
     it = vecGhostnodeRanks.begin() + nOffset;
     while(it != vecGhostnodeRanks.end()) {
         if(it->second.IsPoSeVerified() || it->second.IsPoSeBanned()) {
@@ -1061,7 +1347,7 @@ void CGhostnodeMan::DoFullVerificationStep()
         }
         //LogPrint("ghostnode", "CGhostnodeMan::DoFullVerificationStep -- Verifying ghostnode %s rank %d/%d address %s\n",
                  //   it->second.vin.prevout.ToStringShort(), it->first, nRanksTotal, it->second.addr.ToString());
-        if(SendVerifyRequest(CAddress(it->second.addr, NODE_NETWORK), vSortedByAddr)) {
+        if(SendVerifyRequest(CAddress(it->second.addr, NODE_NETWORK))) {
             nCount++;
             if(nCount >= MAX_POSE_CONNECTIONS) break;
         }
@@ -1083,7 +1369,6 @@ void CGhostnodeMan::CheckSameAddr()
     if(!ghostnodeSync.IsSynced(chainActive.Height()) || vGhostnodes.empty()) return;
 
     std::vector<CGhostnode*> vBan;
-    std::vector<CGhostnode*> vSortedByAddr;
 
     {
         LOCK(cs);
@@ -1091,13 +1376,9 @@ void CGhostnodeMan::CheckSameAddr()
         CGhostnode* pprevGhostnode = NULL;
         CGhostnode* pverifiedGhostnode = NULL;
 
-        BOOST_FOREACH(CGhostnode& mn, vGhostnodes) {
-            vSortedByAddr.push_back(&mn);
-        }
-
-        sort(vSortedByAddr.begin(), vSortedByAddr.end(), CompareByAddr());
-
-        BOOST_FOREACH(CGhostnode* pmn, vSortedByAddr) {
+        // mapGhostnodesByAddr keeps ghostnodes with the same address next to each other
+        for (std::multimap<CService, size_t>::iterator it = mapGhostnodesByAddr.begin(); it != mapGhostnodesByAddr.end(); ++it) {
+            CGhostnode* pmn = &vGhostnodes[it->second];
             // check only (pre)enabled ghostnodes
             if(!pmn->IsEnabled() && !pmn->IsPreEnabled()) continue;
             // initial step
@@ -1131,28 +1412,35 @@ void CGhostnodeMan::CheckSameAddr()
     }
 }
 
-bool CGhostnodeMan::SendVerifyRequest(const CAddress& addr, const std::vector<CGhostnode*>& vSortedByAddr)
+bool CGhostnodeMan::SendVerifyRequest(const CAddress& addr)
 {
-    if(netfulfilledman.HasFulfilledRequest(addr, strprintf("%s", NetMsgType::MNVERIFY)+"-request")) {
+    if(netfulfilledman.HasFulfilledRequest(addr, FULFILLED_MNVERIFY_REQUEST)) {
         // we already asked for verification, not a good idea to do this too often, skip it
         //LogPrint("ghostnode", "CGhostnodeMan::SendVerifyRequest -- too many requests, skipping... addr=%s\n", addr.ToString());
         return false;
     }
 
-    CNode* pnode = g_connman->ConnectNode(addr, NULL, false, true);
-    if(pnode == NULL) {
-        //LogPrint("CGhostnodeMan::SendVerifyRequest -- can't connect to node to verify it, addr=%s\n", addr.ToString());
-        return false;
+    int nBlockHeight;
+    {
+        LOCK(cs);
+        nBlockHeight = pCurrentBlockIndex->nHeight - 1;
     }
-
-    netfulfilledman.AddFulfilledRequest(addr, strprintf("%s", NetMsgType::MNVERIFY)+"-request");
-    // use random nonce, store it and require node to reply with correct one later
-    CGhostnodeVerification mnv(addr, GetRandInt(999999), pCurrentBlockIndex->nHeight - 1);
-    mWeAskedForVerification[addr] = mnv;
-    //LogPrint("CGhostnodeMan::SendVerifyRequest -- verifying node using nonce %d addr=%s\n", mnv.nonce, addr.ToString());
-    const CNetMsgMaker msgMaker(pnode->GetSendVersion());
-    g_connman->PushMessage(pnode, msgMaker.Make(NetMsgType::MNVERIFY, mnv));
-
+    // connect on a connect thread, so the requests to all the candidates are on their way together.
+    // The request only counts as fulfilled once the connection is made, as when connecting here.
+    g_connman->OpenGhostnodeConnection(addr, [this, addr, nBlockHeight](CNode* pnode) {
+        netfulfilledman.AddFulfilledRequest(addr, FULFILLED_MNVERIFY_REQUEST);
+        // use random nonce, store it and require node to reply with correct one later
+        CGhostnodeVerification mnv;
+        {
+            LOCK(cs);
+            mnv = CGhostnodeVerification(addr, GetRandInt(999999), nBlockHeight);
+            mWeAskedForVerification[addr] = mnv;
+            mWeAskedForVerificationTime[addr] = GetTimeMillis();
+        }
+        //LogPrint("CGhostnodeMan::SendVerifyRequest -- verifying node using nonce %d addr=%s\n", mnv.nonce, addr.ToString());
+        const CNetMsgMaker msgMaker(pnode->GetSendVersion());
+        g_connman->PushMessage(pnode, msgMaker.Make(NetMsgType::MNVERIFY, mnv));
+    });
 
     return true;
 }
@@ -1166,7 +1454,7 @@ void CGhostnodeMan::SendVerifyReply(CNode* pnode, CGhostnodeVerification& mnv)
         return;
     }
 
-    if(netfulfilledman.HasFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-reply")) {
+    if(netfulfilledman.HasFulfilledRequest(pnode->addr, FULFILLED_MNVERIFY_REPLY)) {
 //        // peer should not ask us that often
         //LogPrint("GhostnodeMan::SendVerifyReply -- ERROR: peer already asked me recently, peer=%d\n", pnode->GetId());
         Misbehaving(pnode->GetId(), 20);
@@ -1195,7 +1483,7 @@ void CGhostnodeMan::SendVerifyReply(CNode* pnode, CGhostnodeVerification& mnv)
 
     const CNetMsgMaker msgMaker(pnode->GetSendVersion());
     g_connman->PushMessage(pnode, msgMaker.Make(NetMsgType::MNVERIFY, mnv));
-    netfulfilledman.AddFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-reply");
+    netfulfilledman.AddFulfilledRequest(pnode->addr, FULFILLED_MNVERIFY_REPLY);
 }
 
 void CGhostnodeMan::ProcessVerifyReply(CNode* pnode, CGhostnodeVerification& mnv)
@@ -1203,7 +1491,7 @@ void CGhostnodeMan::ProcessVerifyReply(CNode* pnode, CGhostnodeVerification& mnv
     std::string strError;
 
     // did we even ask for it? if that's the case we should have matching fulfilled request
-    if(!netfulfilledman.HasFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-request")) {
+    if(!netfulfilledman.HasFulfilledRequest(pnode->addr, FULFILLED_MNVERIFY_REQUEST)) {
         //LogPrint("CGhostnodeMan::ProcessVerifyReply -- ERROR: we didn't ask for verification of %s, peer=%d\n", pnode->addr.ToString(), pnode->GetId());
         Misbehaving(pnode->GetId(), 20);
         return;
@@ -1233,7 +1521,7 @@ void CGhostnodeMan::ProcessVerifyReply(CNode* pnode, CGhostnodeVerification& mnv
     }
 
 //    // we already verified this address, why node is spamming?
-    if(netfulfilledman.HasFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-done")) {
+    if(netfulfilledman.HasFulfilledRequest(pnode->addr, FULFILLED_MNVERIFY_DONE)) {
         //LogPrint("CGhostnodeMan::ProcessVerifyReply -- ERROR: already verified %s recently\n", pnode->addr.ToString());
         Misbehaving(pnode->GetId(), 20);
         return;
@@ -1244,47 +1532,54 @@ void CGhostnodeMan::ProcessVerifyReply(CNode* pnode, CGhostnodeVerification& mnv
 
         CGhostnode* prealGhostnode = NULL;
         std::vector<CGhostnode*> vpGhostnodesToBan;
-        std::vector<CGhostnode>::iterator it = vGhostnodes.begin();
         std::string strMessage1 = strprintf("%s%d%s", pnode->addr.ToString(), mnv.nonce, blockHash.ToString());
-        while(it != vGhostnodes.end()) {
-            if(CAddress(it->addr, NODE_NETWORK) == pnode->addr) {
-                if(darkSendSigner.VerifyMessage(it->pubKeyGhostnode, mnv.vchSig1, strMessage1, strError)) {
-                    // found it!
-                    prealGhostnode = &(*it);
-                    if(!it->IsPoSeVerified()) {
-                        it->DecreasePoSeBanScore();
-                    }
-                    netfulfilledman.AddFulfilledRequest(pnode->addr, strprintf("%s", NetMsgType::MNVERIFY)+"-done");
-
-                    // we can only broadcast it if we are an activated ghostnode
-                    if(activeGhostnode.vin == CTxIn()) continue;
-                    // update ...
-                    mnv.addr = it->addr;
-                    mnv.vin1 = it->vin;
-                    mnv.vin2 = activeGhostnode.vin;
-                    std::string strMessage2 = strprintf("%s%d%s%s%s", mnv.addr.ToString(), mnv.nonce, blockHash.ToString(),
-                                            mnv.vin1.prevout.ToStringShort(), mnv.vin2.prevout.ToStringShort());
-                    // ... and sign it
-                    if(!darkSendSigner.SignMessage(strMessage2, mnv.vchSig2, activeGhostnode.keyGhostnode)) {
-                        //LogPrint("GhostnodeMan::ProcessVerifyReply -- SignMessage() failed\n");
-                        return;
-                    }
 
-                    std::string strError;
+        std::map<CNetAddr, int64_t>::iterator itTime = mWeAskedForVerificationTime.find(pnode->addr);
+        if(itTime != mWeAskedForVerificationTime.end()) {
+            nVerifyReplyMillisTotal += GetTimeMillis() - itTime->second;
+            nVerifyReplies++;
+            mWeAskedForVerificationTime.erase(itTime);
+        }
 
-                    if(!darkSendSigner.VerifyMessage(activeGhostnode.pubKeyGhostnode, mnv.vchSig2, strMessage2, strError)) {
-                        //LogPrint("GhostnodeMan::ProcessVerifyReply -- VerifyMessage() failed, error: %s\n", strError);
-                        return;
-                    }
+        // only the ghostnodes announcing this address can be the one that replied
+        std::pair<std::multimap<CService, size_t>::iterator, std::multimap<CService, size_t>::iterator> range = mapGhostnodesByAddr.equal_range(pnode->addr);
+        for(std::multimap<CService, size_t>::iterator itAddr = range.first; itAddr != range.second; ++itAddr) {
+            std::vector<CGhostnode>::iterator it = vGhostnodes.begin() + itAddr->second;
+            if(darkSendSigner.VerifyMessage(it->pubKeyGhostnode, mnv.vchSig1, strMessage1, strError)) {
+                // found it!
+                prealGhostnode = &(*it);
+                if(!it->IsPoSeVerified()) {
+                    it->DecreasePoSeBanScore();
+                }
+                netfulfilledman.AddFulfilledRequest(pnode->addr, FULFILLED_MNVERIFY_DONE);
+
+                // we can only broadcast it if we are an activated ghostnode
+                if(activeGhostnode.vin == CTxIn()) continue;
+                // update ...
+                mnv.addr = it->addr;
+                mnv.vin1 = it->vin;
+                mnv.vin2 = activeGhostnode.vin;
+                std::string strMessage2 = strprintf("%s%d%s%s%s", mnv.addr.ToString(), mnv.nonce, blockHash.ToString(),
+                                        mnv.vin1.prevout.ToStringShort(), mnv.vin2.prevout.ToStringShort());
+                // ... and sign it
+                if(!darkSendSigner.SignMessage(strMessage2, mnv.vchSig2, activeGhostnode.keyGhostnode)) {
+                    //LogPrint("GhostnodeMan::ProcessVerifyReply -- SignMessage() failed\n");
+                    return;
+                }
 
-                    mWeAskedForVerification[pnode->addr] = mnv;
-                    mnv.Relay();
+                std::string strError;
 
-                } else {
-                    vpGhostnodesToBan.push_back(&(*it));
+                if(!darkSendSigner.VerifyMessage(activeGhostnode.pubKeyGhostnode, mnv.vchSig2, strMessage2, strError)) {
+                    //LogPrint("GhostnodeMan::ProcessVerifyReply -- VerifyMessage() failed, error: %s\n", strError);
+                    return;
                 }
+
+                mWeAskedForVerification[pnode->addr] = mnv;
+                mnv.Relay();
+
+            } else {
+                vpGhostnodesToBan.push_back(&(*it));
             }
-            ++it;
         }
         // no real ghostnode found?...
         if(!prealGhostnode) {
@@ -1315,7 +1610,7 @@ void CGhostnodeMan::ProcessVerifyBroadcast(CNode* pnode, const CGhostnodeVerific
         // we already have one
         return;
     }
-    mapSeenGhostnodeVerification[mnv.GetHash()] = mnv;
+    AddSeenGhostnodeVerification(mnv);
 
     // we don't care about history
     if(mnv.nBlockHeight < pCurrentBlockIndex->nHeight - MAX_POSE_BLOCKS) {
@@ -1410,6 +1705,83 @@ void CGhostnodeMan::ProcessVerifyBroadcast(CNode* pnode, const CGhostnodeVerific
     }
 }
 
+static size_t GhostnodePingUsage(const CGhostnodePing& mnp)
+{
+    return RecursiveDynamicUsage(mnp.vin) + memusage::DynamicUsage(mnp.vchSig);
+}
+
+static size_t GhostnodeUsage(const CGhostnode& mn)
+{
+    return RecursiveDynamicUsage(mn.vin) + GhostnodePingUsage(mn.lastPing) + memusage::DynamicUsage(mn.vchSig) +
+           memusage::DynamicUsage(mn.mapGovernanceObjectsVotedOn);
+}
+
+static size_t GhostnodeVerificationUsage(const CGhostnodeVerification& mnv)
+{
+    return RecursiveDynamicUsage(mnv.vin1) + RecursiveDynamicUsage(mnv.vin2) +
+           memusage::DynamicUsage(mnv.vchSig1) + memusage::DynamicUsage(mnv.vchSig2);
+}
+
+size_t CGhostnodeMan::ListDynamicMemoryUsage()
+{
+    size_t nUsage = 0;
+    {
+        LOCK(cs);
+        nUsage += memusage::DynamicUsage(vGhostnodes);
+        for (const CGhostnode& mn : vGhostnodes)
+            nUsage += GhostnodeUsage(mn);
+        nUsage += indexGhostnodes.DynamicMemoryUsage() + indexGhostnodesOld.DynamicMemoryUsage();
+        nUsage += memusage::DynamicUsage(mapScoredGhostnodes);
+        for (const auto& scored : mapScoredGhostnodes)
+            nUsage += memusage::DynamicUsage(scored.second.vecScores);
+        nUsage += memusage::DynamicUsage(mapGhostnodesByOutpoint) + memusage::DynamicUsage(mapGhostnodesByPubKey) +
+                  memusage::DynamicUsage(mapGhostnodesByPayee) + memusage::DynamicUsage(mapGhostnodesByAddr);
+        for (const auto& payee : mapGhostnodesByPayee)
+            nUsage += RecursiveDynamicUsage(payee.first);
+    }
+
+    // a snapshot stays allocated while GetFullGhostnodeVector() callers hold it, even if it is an older list
+    LOCK(cs_snapshot);
+    if (pGhostnodesSnapshot) {
+        nUsage += memusage::DynamicUsage(pGhostnodesSnapshot) + memusage::DynamicUsage(*pGhostnodesSnapshot);
+        for (const CGhostnode& mn : *pGhostnodesSnapshot)
+            nUsage += GhostnodeUsage(mn);
+    }
+    return nUsage;
+}
+
+size_t CGhostnodeMan::SeenDynamicMemoryUsage()
+{
+    LOCK(cs);
+    size_t nUsage = memusage::DynamicUsage(mapSeenGhostnodeBroadcast);
+    for (const auto& seen : mapSeenGhostnodeBroadcast)
+        nUsage += memusage::DynamicUsage(seen.second.second) + GhostnodeUsage(*seen.second.second);
+    nUsage += memusage::DynamicUsage(mapSeenGhostnodePing) + memusage::DynamicUsage(mapSeenGhostnodePingsByTime);
+    for (const auto& seen : mapSeenGhostnodePing)
+        nUsage += GhostnodePingUsage(seen.second);
+    nUsage += memusage::DynamicUsage(mapSeenGhostnodeVerification) + memusage::DynamicUsage(mapSeenGhostnodeVerificationsByHeight);
+    for (const auto& seen : mapSeenGhostnodeVerification)
+        nUsage += GhostnodeVerificationUsage(seen.second);
+
+    // list and verification requests from and to peers, and broadcast recovery
+    nUsage += memusage::DynamicUsage(mAskedUsForGhostnodeList) + memusage::DynamicUsage(mWeAskedForGhostnodeList);
+    nUsage += memusage::DynamicUsage(mWeAskedForGhostnodeListEntry);
+    for (const auto& asked : mWeAskedForGhostnodeListEntry)
+        nUsage += memusage::DynamicUsage(asked.second);
+    nUsage += memusage::DynamicUsage(mWeAskedForVerification) + memusage::DynamicUsage(mWeAskedForVerificationTime);
+    for (const auto& asked : mWeAskedForVerification)
+        nUsage += GhostnodeVerificationUsage(asked.second);
+    nUsage += memusage::DynamicUsage(mMnbRecoveryRequests);
+    for (const auto& request : mMnbRecoveryRequests)
+        nUsage += memusage::DynamicUsage(request.second.second);
+    // the replies share the broadcasts of mapSeenGhostnodeBroadcast
+    nUsage += memusage::DynamicUsage(mMnbRecoveryGoodReplies);
+    for (const auto& replies : mMnbRecoveryGoodReplies)
+        nUsage += memusage::DynamicUsage(replies.second);
+    nUsage += memusage::DynamicUsage(listScheduledMnbRequestConnections);
+    return nUsage;
+}
+
 std::string CGhostnodeMan::ToString() const
 {
     std::ostringstream info;
@@ -1419,6 +1791,7 @@ std::string CGhostnodeMan::ToString() const
             ", peers we asked for Ghostnode list: " << (int)mWeAskedForGhostnodeList.size() <<
             ", entries in Ghostnode list we asked for: " << (int)mWeAskedForGhostnodeListEntry.size() <<
             ", ghostnode index size: " << indexGhostnodes.GetSize() <<
+            ", average verification reply time: " << (nVerifyReplies ? nVerifyReplyMillisTotal / nVerifyReplies : 0) << "ms" <<
             ", nDsqCount: " << (int)nDsqCount;
 
     return info.str();
@@ -1429,8 +1802,8 @@ void CGhostnodeMan::UpdateGhostnodeList(CGhostnodeBroadcast mnb)
     try {
         //LogPrint("CGhostnodeMan::UpdateGhostnodeList\n");
         LOCK2(cs_main, cs);
-        mapSeenGhostnodePing.insert(std::make_pair(mnb.lastPing.GetHash(), mnb.lastPing));
-        mapSeenGhostnodeBroadcast.insert(std::make_pair(mnb.GetHash(), std::make_pair(GetTime(), mnb)));
+        AddSeenGhostnodePing(mnb.lastPing);
+        mapSeenGhostnodeBroadcast.insert(std::make_pair(mnb.GetHash(), std::make_pair(GetTime(), std::make_shared<const CGhostnodeBroadcast>(mnb))));
 
         //LogPrint("CGhostnodeMan::UpdateGhostnodeList -- ghostnode=%s  addr=%s\n", mnb.vin.prevout.ToStringShort(), mnb.addr.ToString());
 
@@ -1441,10 +1814,15 @@ void CGhostnodeMan::UpdateGhostnodeList(CGhostnodeBroadcast mnb)
                 ghostnodeSync.AddedGhostnodeList();
             }
         } else {
-            CGhostnodeBroadcast mnbOld = mapSeenGhostnodeBroadcast[CGhostnodeBroadcast(*pmn).GetHash()].second;
+            uint256 hashOld = CGhostnodeBroadcast(*pmn).GetHash();
+            CPubKey pubKeyGhostnodeOld = pmn->pubKeyGhostnode;
+            CService addrOld = pmn->addr;
             if (pmn->UpdateFromNewBroadcast(mnb)) {
                 ghostnodeSync.AddedGhostnodeList();
-                mapSeenGhostnodeBroadcast.erase(mnbOld.GetHash());
+                mapSeenGhostnodeBroadcast.erase(hashOld);
+                if (pmn->pubKeyGhostnode != pubKeyGhostnodeOld || pmn->addr != addrOld) {
+                    RebuildLookupIndexes();
+                }
             }
         }
     } catch (const std::exception &e) {
@@ -1479,7 +1857,7 @@ bool CGhostnodeMan::CheckMnbAndUpdateGhostnodeList(CNode* pfrom, CGhostnodeBroad
                     // do not allow node to send same mnb multiple times in recovery mode
                     mMnbRecoveryRequests[hash].second.erase(pfrom->addr);
                     // does it have newer lastPing?
-                    if (mnb.lastPing.sigTime > mapSeenGhostnodeBroadcast[hash].second.lastPing.sigTime) {
+                    if (mnb.lastPing.sigTime > mapSeenGhostnodeBroadcast[hash].second->lastPing.sigTime) {
                         // simulate Check
                         CGhostnode mnTemp = CGhostnode(mnb);
                         mnTemp.Check();
@@ -1487,14 +1865,14 @@ bool CGhostnodeMan::CheckMnbAndUpdateGhostnodeList(CNode* pfrom, CGhostnodeBroad
                         if (mnTemp.IsValidStateForAutoStart(mnTemp.nActiveState)) {
                             // this node thinks it's a good one
                             //LogPrint("ghostnode", "CGhostnodeMan::CheckMnbAndUpdateGhostnodeList -- ghostnode=%s seen good\n", mnb.vin.prevout.ToStringShort());
-                            mMnbRecoveryGoodReplies[hash].push_back(mnb);
+                            mMnbRecoveryGoodReplies[hash].push_back(std::make_shared<const CGhostnodeBroadcast>(mnb));
                         }
                     }
                 }
             }
             return true;
         }
-        mapSeenGhostnodeBroadcast.insert(std::make_pair(hash, std::make_pair(GetTime(), mnb)));
+        mapSeenGhostnodeBroadcast.insert(std::make_pair(hash, std::make_pair(GetTime(), std::make_shared<const CGhostnodeBroadcast>(mnb))));
 
         //LogPrint("ghostnode", "CGhostnodeMan::CheckMnbAndUpdateGhostnodeList -- ghostnode=%s new\n", mnb.vin.prevout.ToStringShort());
 
@@ -1506,13 +1884,19 @@ bool CGhostnodeMan::CheckMnbAndUpdateGhostnodeList(CNode* pfrom, CGhostnodeBroad
         // search Ghostnode list
         CGhostnode *pmn = Find(mnb.vin);
         if (pmn) {
-            CGhostnodeBroadcast mnbOld = mapSeenGhostnodeBroadcast[CGhostnodeBroadcast(*pmn).GetHash()].second;
-            if (!mnb.Update(pmn, nDos)) {
+            uint256 hashOld = CGhostnodeBroadcast(*pmn).GetHash();
+            CPubKey pubKeyGhostnodeOld = pmn->pubKeyGhostnode;
+            CService addrOld = pmn->addr;
+            bool fUpdated = mnb.Update(pmn, nDos);
+            if (pmn->pubKeyGhostnode != pubKeyGhostnodeOld || pmn->addr != addrOld) {
+                RebuildLookupIndexes();
+            }
+            if (!fUpdated) {
                 //LogPrint("ghostnode", "CGhostnodeMan::CheckMnbAndUpdateGhostnodeList -- Update() failed, ghostnode=%s\n", mnb.vin.prevout.ToStringShort());
                 return false;
             }
-            if (hash != mnbOld.GetHash()) {
-                mapSeenGhostnodeBroadcast.erase(mnbOld.GetHash());
+            if (hash != hashOld) {
+                mapSeenGhostnodeBroadcast.erase(hashOld);
             }
         }
     } // end of LOCK(cs);
@@ -1561,6 +1945,8 @@ void CGhostnodeMan::UpdateLastPaid()
     //LogPrint("mnpayments", "CGhostnodeMan::UpdateLastPaid -- nHeight=%d, nMaxBlocksToScanBack=%d, IsFirstRun=%s\n",
                             // pCurrentBlockIndex->nHeight, nMaxBlocksToScanBack, IsFirstRun ? "true" : "false");
 
+    mnpayments.IndexPaidBlocks(pCurrentBlockIndex, nMaxBlocksToScanBack);
+
     BOOST_FOREACH(CGhostnode& mn, vGhostnodes) {
         mn.UpdateLastPaid(pCurrentBlockIndex, nMaxBlocksToScanBack);
     }
@@ -1663,6 +2049,36 @@ bool CGhostnodeMan::IsGhostnodePingedWithin(const CTxIn& vin, int nSeconds, int6
     return pMN->IsPingedWithin(nSeconds, nTimeToCheckAt);
 }
 
+void CGhostnodeMan::AddSeenGhostnodePing(const CGhostnodePing& mnp)
+{
+    LOCK(cs);
+    uint256 hash = mnp.GetHash();
+    if(!mapSeenGhostnodePing.insert(std::make_pair(hash, mnp)).second) return;
+    mapSeenGhostnodePingsByTime.insert(std::make_pair(mnp.sigTime, hash));
+    ghostnodeSeenInventory.Add(MSG_GHOSTNODE_PING, hash);
+
+    if(mapSeenGhostnodePing.size() > MAX_SEEN_PINGS) {
+        std::multimap<int64_t, uint256>::iterator it = mapSeenGhostnodePingsByTime.begin();
+        mapSeenGhostnodePing.erase(it->second);
+        mapSeenGhostnodePingsByTime.erase(it);
+    }
+}
+
+void CGhostnodeMan::AddSeenGhostnodeVerification(const CGhostnodeVerification& mnv)
+{
+    LOCK(cs);
+    uint256 hash = mnv.GetHash();
+    if(!mapSeenGhostnodeVerification.insert(std::make_pair(hash, mnv)).second) return;
+    mapSeenGhostnodeVerificationsByHeight.insert(std::make_pair(mnv.nBlockHeight, hash));
+    ghostnodeSeenInventory.Add(MSG_GHOSTNODE_VERIFY, hash);
+
+    if(mapSeenGhostnodeVerification.size() > MAX_SEEN_VERIFICATIONS) {
+        std::multimap<int, uint256>::iterator it = mapSeenGhostnodeVerificationsByHeight.begin();
+        mapSeenGhostnodeVerification.erase(it->second);
+        mapSeenGhostnodeVerificationsByHeight.erase(it);
+    }
+}
+
 void CGhostnodeMan::SetGhostnodeLastPing(const CTxIn& vin, const CGhostnodePing& mnp)
 {
     LOCK(cs);
@@ -1671,13 +2087,9 @@ void CGhostnodeMan::SetGhostnodeLastPing(const CTxIn& vin, const CGhostnodePing&
         return;
     }
     pMN->lastPing = mnp;
-    mapSeenGhostnodePing.insert(std::make_pair(mnp.GetHash(), mnp));
+    AddSeenGhostnodePing(mnp);
 
-    CGhostnodeBroadcast mnb(*pMN);
-    uint256 hash = mnb.GetHash();
-    if(mapSeenGhostnodeBroadcast.count(hash)) {
-        mapSeenGhostnodeBroadcast[hash].second.lastPing = mnp;
-    }
+    UpdateSeenGhostnodeBroadcastPing(CGhostnodeBroadcast(*pMN).GetHash(), mnp);
 }
 
 void CGhostnodeMan::UpdatedBlockTip(const CBlockIndex *pindex)
@@ -1693,6 +2105,34 @@ void CGhostnodeMan::UpdatedBlockTip(const CBlockIndex *pindex)
     }
 }
 
+void CGhostnodeMan::UpdateCollaterals(const CBlock& block, bool fSpent)
+{
+    AssertLockHeld(cs_main);
+
+    std::vector<COutPoint> vecOutpoints;
+    {
+        LOCK(cs_collaterals);
+        if (setWatchedCollaterals.empty()) return;
+        for (const CTransactionRef& tx : block.vtx) {
+            if (tx->IsCoinBase()) continue;
+            for (const CTxIn& txin : tx->vin) {
+                if (setWatchedCollaterals.count(txin.prevout))
+                    vecOutpoints.push_back(txin.prevout);
+            }
+        }
+    }
+    if (vecOutpoints.empty()) return;
+
+    LOCK(cs);
+    for (const COutPoint& outpoint : vecOutpoints) {
+        std::map<COutPoint, size_t>::const_iterator it = mapGhostnodesByOutpoint.find(outpoint);
+        if (it == mapGhostnodesByOutpoint.end()) continue;
+        LogPrint(BCLog::GHOSTNODE, "CGhostnodeMan::UpdateCollaterals -- collateral %s %s in block %s\n",
+                 outpoint.ToStringShort(), fSpent ? "spent" : "restored", block.GetHash().ToString());
+        vGhostnodes[it->second].UpdateCollateral(fSpent);
+    }
+}
+
 void CGhostnodeMan::NotifyGhostnodeUpdates()
 {
     // Avoid double locking
@@ -1711,8 +2151,35 @@ void CGhostnodeMan::NotifyGhostnodeUpdates()
     if(fGhostnodesRemovedLocal) {
 //        governance.UpdateCachesAndClean();
     }
+    if(fGhostnodesAddedLocal || fGhostnodesRemovedLocal) {
+        uiInterface.NotifyGhostnodeListChanged();
+    }
 
     LOCK(cs);
     fGhostnodesAdded = false;
     fGhostnodesRemoved = false;
 }
+
+bool ReadGhostnodes(std::vector<CGhostnode>& vGhostnodes)
+{
+    CRecordDB<CGhostnode> db("mncache.dat", "magicGhostnodeCache");
+    return db.Read(vGhostnodes);
+}
+
+void LoadGhostnodes(std::vector<CGhostnode>& vGhostnodes)
+{
+    if (!vGhostnodes.empty()) {
+        mnodeman.AddFromCache(vGhostnodes);
+        mnodeman.Check();
+        LogPrintf("     %s\n", mnodeman.ToString());
+    }
+    fGhostnodesLoaded = true;
+}
+
+void DumpGhostnodes()
+{
+    if (!fGhostnodesLoaded) return;
+
+    CRecordDB<CGhostnode> db("mncache.dat", "magicGhostnodeCache");
+    db.Write(*mnodeman.GetFullGhostnodeVector());
+}
@@ -12,6 +12,7 @@
 using namespace std;
 
 class CGhostnodeMan;
+class CSignedMessageCheck;
 
 extern CGhostnodeMan mnodeman;
 
@@ -63,6 +64,8 @@ public:
 
     void Clear();
 
+    size_t DynamicMemoryUsage() const;
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
@@ -97,6 +100,8 @@ private:
     static const std::string SERIALIZATION_VERSION_STRING;
 
     static const int DSEG_UPDATE_SECONDS        = 3 * 60 * 60;
+    /// Slack subtracted from the cached list time we ask peers for changes since, covers clock drift
+    static const int DSEG_DELTA_MARGIN_SECONDS  = 60 * 60;
 
     static const int LAST_PAID_SCAN_BLOCKS      = 100;
 
@@ -111,6 +116,18 @@ private:
     static const int MNB_RECOVERY_WAIT_SECONDS      = 60;
     static const int MNB_RECOVERY_RETRY_SECONDS     = 3 * 60 * 60;
 
+    /// Number of block heights whose ghostnode scores are kept
+    static const int MAX_SCORE_CACHE_HEIGHTS        = 32;
+    /// Number of ghostnodes checked per acquisition of cs in Check()
+    static const size_t CHECK_BATCH_SIZE            = 100;
+    /// Maximum number of queued messages whose signatures are verified in one batch
+    static const size_t MAX_QUEUED_SIGNATURE_CHECKS = 1000;
+    /// Hard caps on the seen ping and verification maps, the oldest entries are evicted first
+    static const size_t MAX_SEEN_PINGS              = 100000;
+    static const size_t MAX_SEEN_VERIFICATIONS      = 10000;
+    /// GetFullGhostnodeVector() callers within this time share one copy of the list
+    static const int64_t SNAPSHOT_MAX_AGE_MILLIS    = 1000;
+
 
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
@@ -120,6 +137,10 @@ private:
 
     // map to hold all MNs
     std::vector<CGhostnode> vGhostnodes;
+    // copy of vGhostnodes handed out by GetFullGhostnodeVector(), protected by cs_snapshot
+    CCriticalSection cs_snapshot;
+    std::shared_ptr<const std::vector<CGhostnode> > pGhostnodesSnapshot;
+    int64_t nSnapshotTimeMillis;
     // who's asked for the Ghostnode list and the last time
     std::map<CNetAddr, int64_t> mAskedUsForGhostnodeList;
     // who we asked for the Ghostnode list and the last time
@@ -128,10 +149,14 @@ private:
     std::map<COutPoint, std::map<CNetAddr, int64_t> > mWeAskedForGhostnodeListEntry;
     // who we asked for the ghostnode verification
     std::map<CNetAddr, CGhostnodeVerification> mWeAskedForVerification;
+    // when we asked them, and the round trip times of the replies so far
+    std::map<CNetAddr, int64_t> mWeAskedForVerificationTime;
+    int64_t nVerifyReplyMillisTotal;
+    int nVerifyReplies;
 
     // these maps are used for ghostnode recovery from GHOSTNODE_NEW_START_REQUIRED state
     std::map<uint256, std::pair< int64_t, std::set<CNetAddr> > > mMnbRecoveryRequests;
-    std::map<uint256, std::vector<CGhostnodeBroadcast> > mMnbRecoveryGoodReplies;
+    std::map<uint256, std::vector<CGhostnodeBroadcastRef> > mMnbRecoveryGoodReplies;
     std::list< std::pair<CService, uint256> > listScheduledMnbRequestConnections;
 
     int64_t nLastIndexRebuildTime;
@@ -140,6 +165,26 @@ private:
 
     CGhostnodeIndex indexGhostnodesOld;
 
+    /// All ghostnodes sorted by score for the block at a height, best first. The scores only depend on
+    /// the block hash and the ghostnode vin, entries are dropped whenever vGhostnodes is modified
+    struct CScoredGhostnodes {
+        uint256 blockHash;
+        std::vector<std::pair<int64_t, CGhostnode*> > vecScores;
+    };
+    std::map<int, CScoredGhostnodes> mapScoredGhostnodes;
+
+    /// Positions in vGhostnodes by collateral outpoint, ghostnode pubkey and payee script. When several
+    /// ghostnodes share a key the first one in vGhostnodes is kept, like the linear scans these replace
+    std::map<COutPoint, size_t> mapGhostnodesByOutpoint;
+    std::map<CPubKey, size_t> mapGhostnodesByPubKey;
+    std::map<CScript, size_t> mapGhostnodesByPayee;
+    /// Positions in vGhostnodes by address, all ghostnodes sharing an address are kept
+    std::multimap<CService, size_t> mapGhostnodesByAddr;
+    /// Collateral outpoints of vGhostnodes, consulted by UpdateCollaterals for every block connected or
+    /// disconnected at the tip. Kept under its own lock so that blocks without collaterals need not wait for cs
+    CCriticalSection cs_collaterals;
+    std::set<COutPoint> setWatchedCollaterals;
+
     /// Set when index has been rebuilt, clear when read
     bool fIndexRebuilt;
 
@@ -151,13 +196,22 @@ private:
 
     std::vector<uint256> vecDirtyGovernanceObjectHashes;
 
+    /// Hashes in mapSeenGhostnodePing by ping sigTime and in mapSeenGhostnodeVerification by block height,
+    /// so that expired entries are removed oldest first without scanning the maps
+    std::multimap<int64_t, uint256> mapSeenGhostnodePingsByTime;
+    std::multimap<int, uint256> mapSeenGhostnodeVerificationsByHeight;
+
     int64_t nLastWatchdogVoteTime;
 
+    /// Newest announce time in the list loaded from mncache.dat, 0 when there was none. DSEG requests
+    /// then only ask for the entries announced or pinged since, instead of the full list
+    int64_t nDsegSinceTime;
+
     friend class CGhostnodeSync;
 
 public:
     // Keep track of all broadcasts I've seen
-    std::map<uint256, std::pair<int64_t, CGhostnodeBroadcast> > mapSeenGhostnodeBroadcast;
+    std::map<uint256, std::pair<int64_t, CGhostnodeBroadcastRef> > mapSeenGhostnodeBroadcast;
     // Keep track of all pings I've seen
     std::map<uint256, CGhostnodePing> mapSeenGhostnodePing;
     // Keep track of all verifications I've seen
@@ -192,6 +246,14 @@ public:
         READWRITE(mapSeenGhostnodeBroadcast);
         READWRITE(mapSeenGhostnodePing);
         READWRITE(indexGhostnodes);
+        if(ser_action.ForRead()) {
+            mapScoredGhostnodes.clear();
+            RebuildLookupIndexes();
+            mapSeenGhostnodePingsByTime.clear();
+            for (std::map<uint256, CGhostnodePing>::iterator it = mapSeenGhostnodePing.begin(); it != mapSeenGhostnodePing.end(); ++it) {
+                mapSeenGhostnodePingsByTime.insert(std::make_pair(it->second.sigTime, it->first));
+            }
+        }
         if(ser_action.ForRead() && (strVersion != SERIALIZATION_VERSION_STRING)) {
             Clear();
         }
@@ -199,8 +261,25 @@ public:
 
     CGhostnodeMan();
 
+private:
+    /// Ghostnodes sorted by score for the block at nBlockHeight, computed once per block, requires cs
+    const std::vector<std::pair<int64_t, CGhostnode*> >& GetScoredGhostnodes(int nBlockHeight, const uint256& blockHash);
+
+    /// Add vGhostnodes[nPos] to the lookup indexes, requires cs
+    void AddToLookupIndexes(size_t nPos);
+    /// Rebuild the lookup indexes from vGhostnodes, after entries were removed or a ghostnode pubkey changed, requires cs
+    void RebuildLookupIndexes();
+    /// Publish the size of mnodeman to the metrics.h gauge, other instances are left out, requires cs
+    void UpdateMetrics() const;
+    /// Add the signatures of the announces and pings queued from pfrom to vChecks and verify them in parallel
+    void VerifyQueuedSignatures(CNode* pfrom, std::vector<CSignedMessageCheck>& vChecks);
+
+public:
+
     /// Add an entry
     bool Add(CGhostnode &mn);
+    /// Add the entries read from mncache.dat and mark their announces and pings as seen
+    void AddFromCache(std::vector<CGhostnode>& vCached);
 
     /// Ask (source) node for mnb
     void AskForMN(CNode *pnode, const CTxIn &vin);
@@ -286,6 +365,8 @@ public:
     ghostnode_info_t GetGhostnodeInfo(const CPubKey& pubKeyGhostnode);
 
     char* GetNotQualifyReason(CGhostnode& mn, int nBlockHeight, bool fFilterSigTime, int nMnCount);
+    /// Same as above with the payees scheduled around nBlockHeight computed by the caller
+    char* GetNotQualifyReason(CGhostnode& mn, int nBlockHeight, bool fFilterSigTime, int nMnCount, const std::set<CScript>& setScheduledPayees);
 
     /// Find an entry in the ghostnode list that is next to be paid
     CGhostnode* GetNextGhostnodeInQueueForPayment(int nBlockHeight, bool fFilterSigTime, int& nCount);
@@ -295,9 +376,19 @@ public:
     /// Find a random entry
     CGhostnode* FindRandomNotInVec(const std::vector<CTxIn> &vecToExclude, int nProtocolVersion = -1);
 
-    std::vector<CGhostnode> GetFullGhostnodeVector() { return vGhostnodes; }
+    /// Copy of the ghostnode list, may be slightly stale if the list is busy (e.g. in CheckAndRemove)
+    /// Shared copy of the ghostnode list, at most SNAPSHOT_MAX_AGE_MILLIS old unless the list was busy
+    std::shared_ptr<const std::vector<CGhostnode> > GetFullGhostnodeVector();
+    /// Seen broadcast with the given hash
+    bool GetSeenGhostnodeBroadcast(const uint256& hash, CGhostnodeBroadcastRef& mnbRet);
+    /// Replace the ping of the seen broadcast with the given hash, requires cs
+    void UpdateSeenGhostnodeBroadcastPing(const uint256& hash, const CGhostnodePing& mnp);
 
     std::vector<std::pair<int, CGhostnode> > GetGhostnodeRanks(int nBlockHeight = -1, int nMinProtocol=0);
+    /// Like GetGhostnodeRanks, but only the collateral outpoints, without copying the ghostnodes
+    std::vector<std::pair<int, COutPoint> > GetGhostnodeRankOutpoints(int nBlockHeight = -1, int nMinProtocol=0);
+    /// Outpoints of the nCount enabled ghostnodes ranked best for a block, false if the block is unknown
+    bool GetTopGhostnodes(int nBlockHeight, int nMinProtocol, int nCount, std::set<COutPoint>& setOutpointsRet);
     int GetGhostnodeRank(const CTxIn &vin, int nBlockHeight, int nMinProtocol=0, bool fOnlyActive=true);
     CGhostnode* GetGhostnodeByRank(int nRank, int nBlockHeight, int nMinProtocol=0, bool fOnlyActive=true);
 
@@ -308,7 +399,7 @@ public:
 
     void DoFullVerificationStep();
     void CheckSameAddr();
-    bool SendVerifyRequest(const CAddress& addr, const std::vector<CGhostnode*>& vSortedByAddr);
+    bool SendVerifyRequest(const CAddress& addr);
     void SendVerifyReply(CNode* pnode, CGhostnodeVerification& mnv);
     void ProcessVerifyReply(CNode* pnode, CGhostnodeVerification& mnv);
     void ProcessVerifyBroadcast(CNode* pnode, const CGhostnodeVerification& mnv);
@@ -316,6 +407,11 @@ public:
     /// Return the number of (unique) Ghostnodes
     int size() { return vGhostnodes.size(); }
 
+    /// Estimated heap memory of the ghostnode list, its indexes, score cache and snapshot
+    size_t ListDynamicMemoryUsage();
+    /// Estimated heap memory of the seen broadcasts, pings and verifications and of the list requests
+    size_t SeenDynamicMemoryUsage();
+
     std::string ToString() const;
 
     /// Update ghostnode list and maps using provided CGhostnodeBroadcast
@@ -324,6 +420,10 @@ public:
     bool CheckMnbAndUpdateGhostnodeList(CNode* pfrom, CGhostnodeBroadcast mnb, int& nDos);
     bool IsMnbRecoveryRequested(const uint256& hash) { return mMnbRecoveryRequests.count(hash); }
 
+    /// Remember a ping or a verification as seen, evicting the oldest one when the map is full
+    void AddSeenGhostnodePing(const CGhostnodePing& mnp);
+    void AddSeenGhostnodeVerification(const CGhostnodeVerification& mnv);
+
     void UpdateLastPaid();
 
     void CheckAndRebuildGhostnodeIndex();
@@ -357,6 +457,8 @@ public:
     void SetGhostnodeLastPing(const CTxIn& vin, const CGhostnodePing& mnp);
 
     void UpdatedBlockTip(const CBlockIndex *pindex);
+    /// Mark the ghostnodes whose collateral a block spends (fSpent, connected) or returns (disconnected), requires cs_main
+    void UpdateCollaterals(const CBlock& block, bool fSpent);
 
     /**
      * Called to notify CGovernanceManager that the ghostnode index has been updated.
@@ -366,4 +468,14 @@ public:
 
 };
 
+/** How often the ghostnode list is written to mncache.dat while running */
+static const int GHOSTNODE_CACHE_FLUSH_SECONDS = 15 * 60;
+
+/** Read the ghostnode list saved in mncache.dat, doesn't need the block chain */
+bool ReadGhostnodes(std::vector<CGhostnode>& vGhostnodes);
+/** Add the ghostnodes read by ReadGhostnodes() to mnodeman and check them against the chain */
+void LoadGhostnodes(std::vector<CGhostnode>& vGhostnodes);
+/** Write the ghostnode list to mncache.dat, does nothing until LoadGhostnodes() has run */
+void DumpGhostnodes();
+
 #endif
@@ -7,7 +7,9 @@
 #include "darksend.h"
 #include "instantx.h"
 #include "key.h"
+#include "metrics.h"
 #include "validation.h"
+#include "ghostnode-stats.h"
 #include "ghostnode-sync.h"
 #include "ghostnodeman.h"
 #include "net.h"
@@ -16,6 +18,7 @@
 #include "sync.h"
 #include "txmempool.h"
 #include "util.h"
+#include "validationinterface.h"
 #include "consensus/validation.h"
 
 #include <boost/algorithm/string/replace.hpp>
@@ -73,7 +76,10 @@ void CInstantSend::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataSt
 
 bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest)
 {
+    CGhostnodeStatsTimer timer(GHOSTNODE_STATS_DURATION, "CInstantSend::ProcessTxLockRequest");
+    CGhostnodeStatsTimer waitTimer(GHOSTNODE_STATS_LOCK_WAIT, "CInstantSend::ProcessTxLockRequest cs_main, cs_instantsend");
     LOCK2(cs_main, cs_instantsend);
+    waitTimer.Stop();
 
     uint256 txHash = txLockRequest.GetHash();
 
@@ -111,7 +117,7 @@ bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest)
     }
     //LogPrint("CInstantSend::ProcessTxLockRequest -- accepted, txid=%s\n", txHash.ToString());
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    std::unordered_map<uint256, CTxLockCandidate, SaltedTxidHasher>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     CTxLockCandidate& txLockCandidate = itLockCandidate->second;
     Vote(txLockCandidate);
     ProcessOrphanTxLockVotes();
@@ -133,7 +139,7 @@ bool CInstantSend::CreateTxLockCandidate(const CTxLockRequest& txLockRequest)
 
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    std::unordered_map<uint256, CTxLockCandidate, SaltedTxidHasher>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     if(itLockCandidate == mapTxLockCandidates.end()) {
         //LogPrint("CInstantSend::CreateTxLockCandidate -- new, txid=%s\n", txHash.ToString());
 
@@ -170,22 +176,13 @@ void CInstantSend::Vote(CTxLockCandidate& txLockCandidate)
 
         int nLockInputHeight = nPrevoutHeight + 4;
 
-        int n = mnodeman.GetGhostnodeRank(activeGhostnode.vin, nLockInputHeight, MIN_INSTANTSEND_PROTO_VERSION);
-
-        if(n == -1) {
-            //LogPrint("instantsend", "CInstantSend::Vote -- Unknown Ghostnode %s\n", activeGhostnode.vin.prevout.ToStringShort());
-            ++itOutpointLock;
-            continue;
-        }
-
-        int nSignaturesTotal = COutPointLock::SIGNATURES_TOTAL;
-        if(n > nSignaturesTotal) {
-            //LogPrint("instantsend", "CInstantSend::Vote -- Ghostnode not in the top %d (%d)\n", nSignaturesTotal, n);
+        if(!IsInLockQuorum(activeGhostnode.vin.prevout, nLockInputHeight)) {
+            //LogPrint("instantsend", "CInstantSend::Vote -- Ghostnode not in the top %d\n", COutPointLock::SIGNATURES_TOTAL);
             ++itOutpointLock;
             continue;
         }
 
-        //LogPrint("instantsend", "CInstantSend::Vote -- In the top %d (%d)\n", nSignaturesTotal, n);
+        //LogPrint("instantsend", "CInstantSend::Vote -- In the top %d\n", COutPointLock::SIGNATURES_TOTAL);
 
         std::map<COutPoint, std::set<uint256> >::iterator itVoted = mapVotedOutpoints.find(itOutpointLock->first);
 
@@ -194,7 +191,7 @@ void CInstantSend::Vote(CTxLockCandidate& txLockCandidate)
         bool fAlreadyVoted = false;
         if(itVoted != mapVotedOutpoints.end()) {
             BOOST_FOREACH(const uint256& hash, itVoted->second) {
-                std::map<uint256, CTxLockCandidate>::iterator it2 = mapTxLockCandidates.find(hash);
+                std::unordered_map<uint256, CTxLockCandidate, SaltedTxidHasher>::iterator it2 = mapTxLockCandidates.find(hash);
                 if(it2->second.HasGhostnodeVoted(itOutpointLock->first, activeGhostnode.vin.prevout)) {
                     // we already voted for this outpoint to be included either in the same tx or in a competing one,
                     // skip it anyway
@@ -213,14 +210,11 @@ void CInstantSend::Vote(CTxLockCandidate& txLockCandidate)
         // we haven't voted for this outpoint yet, let's try to do this now
         CTxLockVote vote(txHash, itOutpointLock->first, activeGhostnode.vin.prevout);
 
+        // Sign() verifies the signature with our ghostnode key, no need to look the key up and verify it again
         if(!vote.Sign()) {
             //LogPrint("CInstantSend::Vote -- Failed to sign consensus vote\n");
             return;
         }
-        if(!vote.CheckSignature()) {
-            //LogPrint("CInstantSend::Vote -- Signature invalid\n");
-            return;
-        }
 
         // vote constructed sucessfully, let's store and relay it
         uint256 nVoteHash = vote.GetHash();
@@ -252,7 +246,10 @@ void CInstantSend::Vote(CTxLockCandidate& txLockCandidate)
 //received a consensus vote
 bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote)
 {
+    CGhostnodeStatsTimer timer(GHOSTNODE_STATS_DURATION, "CInstantSend::ProcessTxLockVote");
+    CGhostnodeStatsTimer waitTimer(GHOSTNODE_STATS_LOCK_WAIT, "CInstantSend::ProcessTxLockVote cs_main, cs_instantsend");
     LOCK2(cs_main, cs_instantsend);
+    waitTimer.Stop();
 
     uint256 txHash = vote.GetTxHash();
 
@@ -265,14 +262,14 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote)
     // Ghostnodes will sometimes propagate votes before the transaction is known to the client,
     // will actually process only after the lock request itself has arrived
 
-    std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+    std::unordered_map<uint256, CTxLockCandidate, SaltedTxidHasher>::iterator it = mapTxLockCandidates.find(txHash);
     if(it == mapTxLockCandidates.end()) {
         if(!mapTxLockVotesOrphan.count(vote.GetHash())) {
-            mapTxLockVotesOrphan[vote.GetHash()] = vote;
+            AddOrphanTxLockVote(vote);
             //LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- Orphan vote: txid=%s  ghostnode=%s new\n",
                 //    txHash.ToString(), vote.GetGhostnodeOutpoint().ToStringShort());
             bool fReprocess = true;
-            std::map<uint256, CTxLockRequest>::iterator itLockRequest = mapLockRequestAccepted.find(txHash);
+            std::unordered_map<uint256, CTxLockRequest, SaltedTxidHasher>::iterator itLockRequest = mapLockRequestAccepted.find(txHash);
             if(itLockRequest == mapLockRequestAccepted.end()) {
                 itLockRequest = mapLockRequestRejected.find(txHash);
                 if(itLockRequest == mapLockRequestRejected.end()) {
@@ -297,7 +294,7 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote)
 
         int nGhostnodeOrphanExpireTime = GetTime() + 60*10; // keep time data for 10 minutes
         if(!mapGhostnodeOrphanVotes.count(vote.GetGhostnodeOutpoint())) {
-            mapGhostnodeOrphanVotes[vote.GetGhostnodeOutpoint()] = nGhostnodeOrphanExpireTime;
+            SetGhostnodeOrphanVoteExpiration(vote.GetGhostnodeOutpoint(), nGhostnodeOrphanExpireTime);
         } else {
             int64_t nPrevOrphanVote = mapGhostnodeOrphanVotes[vote.GetGhostnodeOutpoint()];
             if(nPrevOrphanVote > GetTime() && nPrevOrphanVote > GetAverageGhostnodeOrphanVoteTime()) {
@@ -307,7 +304,7 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote)
                 return false;
             }
             // not spamming, refresh
-            mapGhostnodeOrphanVotes[vote.GetGhostnodeOutpoint()] = nGhostnodeOrphanExpireTime;
+            SetGhostnodeOrphanVoteExpiration(vote.GetGhostnodeOutpoint(), nGhostnodeOrphanExpireTime);
         }
 
         return true;
@@ -321,7 +318,7 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote)
             if(hash != txHash) {
                 // same outpoint was already voted to be locked by another tx lock request,
                 // find out if the same mn voted on this outpoint before
-                std::map<uint256, CTxLockCandidate>::iterator it2 = mapTxLockCandidates.find(hash);
+                std::unordered_map<uint256, CTxLockCandidate, SaltedTxidHasher>::iterator it2 = mapTxLockCandidates.find(hash);
                 if(it2->second.HasGhostnodeVoted(vote.GetOutpoint(), vote.GetGhostnodeOutpoint())) {
                     // yes, it did, refuse to accept a vote to include the same outpoint in another tx
                     // from the same ghostnode.
@@ -364,7 +361,7 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote)
 void CInstantSend::ProcessOrphanTxLockVotes()
 {
     LOCK2(cs_main, cs_instantsend);
-    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.begin();
+    std::unordered_map<uint256, CTxLockVote, SaltedTxidHasher>::iterator it = mapTxLockVotesOrphan.begin();
     while(it != mapTxLockVotesOrphan.end()) {
         if(ProcessTxLockVote(NULL, it->second)) {
             mapTxLockVotesOrphan.erase(it++);
@@ -374,6 +371,23 @@ void CInstantSend::ProcessOrphanTxLockVotes()
     }
 }
 
+bool CInstantSend::IsInLockQuorum(const COutPoint& outpointGhostnode, int nLockInputHeight)
+{
+    LOCK(cs_instantsend);
+
+    std::map<int, CLockQuorum>::iterator it = mapLockQuorums.find(nLockInputHeight);
+    if(it == mapLockQuorums.end()) {
+        CLockQuorum quorum;
+        quorum.nTimeCreated = GetTime();
+        if(!mnodeman.GetTopGhostnodes(nLockInputHeight, MIN_INSTANTSEND_PROTO_VERSION, COutPointLock::SIGNATURES_TOTAL, quorum.setGhostnodes)) {
+            return false;
+        }
+        it = mapLockQuorums.insert(std::make_pair(nLockInputHeight, quorum)).first;
+    }
+
+    return it->second.setGhostnodes.count(outpointGhostnode);
+}
+
 bool CInstantSend::IsEnoughOrphanVotesForTx(const CTxLockRequest& txLockRequest)
 {
     // There could be a situation when we already have quite a lot of votes
@@ -392,7 +406,7 @@ bool CInstantSend::IsEnoughOrphanVotesForTxAndOutPoint(const uint256& txHash, co
     // Scan orphan votes to check if this outpoint has enough orphan votes to be locked in some tx.
     LOCK2(cs_main, cs_instantsend);
     int nCountVotes = 0;
-    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.begin();
+    std::unordered_map<uint256, CTxLockVote, SaltedTxidHasher>::iterator it = mapTxLockVotesOrphan.begin();
     while(it != mapTxLockVotesOrphan.end()) {
         if(it->second.GetTxHash() == txHash && it->second.GetOutpoint() == outpoint) {
             nCountVotes++;
@@ -416,6 +430,7 @@ void CInstantSend::TryToFinalizeLockCandidate(const CTxLockCandidate& txLockCand
         if(ResolveConflicts(txLockCandidate, Params().GetConsensus().nInstantSendKeepLock)) {
             LockTransactionInputs(txLockCandidate);
             UpdateLockedTransaction(txLockCandidate);
+            MetricAdd(Metric::INSTANTSEND_LOCKS);
         }
     }
 }
@@ -444,7 +459,7 @@ void CInstantSend::UpdateLockedTransaction(const CTxLockCandidate& txLockCandida
     }
 #endif
 
-//    GetMainSignals().NotifyTransactionLock(txLockCandidate.txLockRequest);
+    GetMainSignals().TransactionLocked(MakeTransactionRef(txLockCandidate.txLockRequest));
 
     //LogPrint("instantsend", "CInstantSend::UpdateLockedTransaction -- done, txid=%s\n", txHash.ToString());
 }
@@ -491,8 +506,8 @@ bool CInstantSend::ResolveConflicts(const CTxLockCandidate& txLockCandidate, int
         if(GetLockedOutPointTxHash(txin.prevout, hashConflicting) && txHash != hashConflicting) {
             // completed lock which conflicts with another completed one?
             // this means that majority of MNs in the quorum for this specific tx input are malicious!
-            std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
-            std::map<uint256, CTxLockCandidate>::iterator itLockCandidateConflicting = mapTxLockCandidates.find(hashConflicting);
+            std::unordered_map<uint256, CTxLockCandidate, SaltedTxidHasher>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+            std::unordered_map<uint256, CTxLockCandidate, SaltedTxidHasher>::iterator itLockCandidateConflicting = mapTxLockCandidates.find(hashConflicting);
             if(itLockCandidate == mapTxLockCandidates.end() || itLockCandidateConflicting == mapTxLockCandidates.end()) {
                 // safety check, should never really happen
                 //LogPrint("CInstantSend::ResolveConflicts -- ERROR: Found conflicting completed Transaction Lock, but one of txLockCandidate-s is missing, txid=%s, conflicting txid=%s\n",
@@ -503,16 +518,13 @@ bool CInstantSend::ResolveConflicts(const CTxLockCandidate& txLockCandidate, int
                 //    txHash.ToString(), hashConflicting.ToString());
             CTxLockRequest txLockRequest = itLockCandidate->second.txLockRequest;
             CTxLockRequest txLockRequestConflicting = itLockCandidateConflicting->second.txLockRequest;
-            itLockCandidate->second.SetConfirmedHeight(0); // expired
-            itLockCandidateConflicting->second.SetConfirmedHeight(0); // expired
+            SetLockCandidateConfirmedHeight(itLockCandidate->second, 0); // expired
+            SetLockCandidateConfirmedHeight(itLockCandidateConflicting->second, 0); // expired
             CheckAndRemove(); // clean up
-            // AlreadyHave should still return "true" for both of them
-            mapLockRequestRejected.insert(make_pair(txHash, txLockRequest));
-            mapLockRequestRejected.insert(make_pair(hashConflicting, txLockRequestConflicting));
+            // AlreadyHave should still return "true" for both of them, until REJECTED_REQUEST_SECONDS passed
+            AddRejectedLockRequest(txLockRequest);
+            AddRejectedLockRequest(txLockRequestConflicting);
 
-            // TODO: clean up mapLockRequestRejected later somehow
-            //       (not a big issue since we already PoSe ban malicious masternodes
-            //        and they won't be able to spam)
             // TODO: ban all malicious masternodes permanently, do not accept anything from them, ever
 
             // TODO: notify zmq+script about this double-spend attempt
@@ -559,7 +571,7 @@ int64_t CInstantSend::GetAverageGhostnodeOrphanVoteTime()
     // NOTE: should never actually call this function when mapGhostnodeOrphanVotes is empty
     if(mapGhostnodeOrphanVotes.empty()) return 0;
 
-    std::map<COutPoint, int64_t>::iterator it = mapGhostnodeOrphanVotes.begin();
+    std::unordered_map<COutPoint, int64_t, SaltedOutpointHasher>::iterator it = mapGhostnodeOrphanVotes.begin();
     int64_t total = 0;
 
     while(it != mapGhostnodeOrphanVotes.end()) {
@@ -576,13 +588,17 @@ void CInstantSend::CheckAndRemove()
 
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.begin();
+    // locks and votes confirmed below this height are expired
+    int nExpiredHeight = pCurrentBlockIndex->nHeight - Params().GetConsensus().nInstantSendKeepLock;
+    int64_t nNow = GetTime();
 
     // remove expired candidates
-    while(itLockCandidate != mapTxLockCandidates.end()) {
-        CTxLockCandidate &txLockCandidate = itLockCandidate->second;
-        uint256 txHash = txLockCandidate.GetHash();
-        if(txLockCandidate.IsExpired(pCurrentBlockIndex->nHeight)) {
+    std::multimap<int, uint256>::iterator itCandidateByHeight = mapLockCandidatesByConfirmedHeight.begin();
+    while(itCandidateByHeight != mapLockCandidatesByConfirmedHeight.end() && itCandidateByHeight->first < nExpiredHeight) {
+        std::unordered_map<uint256, CTxLockCandidate, SaltedTxidHasher>::iterator itLockCandidate = mapTxLockCandidates.find(itCandidateByHeight->second);
+        if(itLockCandidate != mapTxLockCandidates.end() && itLockCandidate->second.IsExpired(pCurrentBlockIndex->nHeight)) {
+            CTxLockCandidate &txLockCandidate = itLockCandidate->second;
+            uint256 txHash = txLockCandidate.GetHash();
             //LogPrint("CInstantSend::CheckAndRemove -- Removing expired Transaction Lock Candidate: txid=%s\n", txHash.ToString());
             std::map<COutPoint, COutPointLock>::iterator itOutpointLock = txLockCandidate.mapOutPointLocks.begin();
             while(itOutpointLock != txLockCandidate.mapOutPointLocks.end()) {
@@ -592,47 +608,118 @@ void CInstantSend::CheckAndRemove()
             }
             mapLockRequestAccepted.erase(txHash);
             mapLockRequestRejected.erase(txHash);
-            mapTxLockCandidates.erase(itLockCandidate++);
-        } else {
-            ++itLockCandidate;
+            mapTxLockCandidates.erase(itLockCandidate);
         }
+        mapLockCandidatesByConfirmedHeight.erase(itCandidateByHeight++);
     }
 
     // remove expired votes
-    std::map<uint256, CTxLockVote>::iterator itVote = mapTxLockVotes.begin();
-    while(itVote != mapTxLockVotes.end()) {
-        if(itVote->second.IsExpired(pCurrentBlockIndex->nHeight)) {
+    std::multimap<int, uint256>::iterator itVoteByHeight = mapTxLockVotesByConfirmedHeight.begin();
+    while(itVoteByHeight != mapTxLockVotesByConfirmedHeight.end() && itVoteByHeight->first < nExpiredHeight) {
+        std::unordered_map<uint256, CTxLockVote, SaltedTxidHasher>::iterator itVote = mapTxLockVotes.find(itVoteByHeight->second);
+        if(itVote != mapTxLockVotes.end() && itVote->second.IsExpired(pCurrentBlockIndex->nHeight)) {
             //LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing expired vote: txid=%s  ghostnode=%s\n",
                 //    itVote->second.GetTxHash().ToString(), itVote->second.GetGhostnodeOutpoint().ToStringShort());
-            mapTxLockVotes.erase(itVote++);
-        } else {
-            ++itVote;
+            mapTxLockVotes.erase(itVote);
         }
+        mapTxLockVotesByConfirmedHeight.erase(itVoteByHeight++);
     }
 
     // remove expired orphan votes
-    std::map<uint256, CTxLockVote>::iterator itOrphanVote = mapTxLockVotesOrphan.begin();
-    while(itOrphanVote != mapTxLockVotesOrphan.end()) {
-        if(GetTime() - itOrphanVote->second.GetTimeCreated() > ORPHAN_VOTE_SECONDS) {
+    std::multimap<int64_t, uint256>::iterator itOrphanByTime = mapTxLockVotesOrphanByTime.begin();
+    while(itOrphanByTime != mapTxLockVotesOrphanByTime.end() && nNow - itOrphanByTime->first > ORPHAN_VOTE_SECONDS) {
+        std::unordered_map<uint256, CTxLockVote, SaltedTxidHasher>::iterator itOrphanVote = mapTxLockVotesOrphan.find(itOrphanByTime->second);
+        if(itOrphanVote != mapTxLockVotesOrphan.end() && nNow - itOrphanVote->second.GetTimeCreated() > ORPHAN_VOTE_SECONDS) {
             //LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing expired orphan vote: txid=%s  ghostnode=%s\n",
                //     itOrphanVote->second.GetTxHash().ToString(), itOrphanVote->second.GetGhostnodeOutpoint().ToStringShort());
             mapTxLockVotes.erase(itOrphanVote->first);
-            mapTxLockVotesOrphan.erase(itOrphanVote++);
-        } else {
-            ++itOrphanVote;
+            mapTxLockVotesOrphan.erase(itOrphanVote);
         }
+        mapTxLockVotesOrphanByTime.erase(itOrphanByTime++);
     }
 
     // remove expired ghostnode orphan votes (DOS protection)
-    std::map<COutPoint, int64_t>::iterator itGhostnodeOrphan = mapGhostnodeOrphanVotes.begin();
-    while(itGhostnodeOrphan != mapGhostnodeOrphanVotes.end()) {
-        if(itGhostnodeOrphan->second < GetTime()) {
+    std::multimap<int64_t, COutPoint>::iterator itGhostnodeOrphanByTime = mapGhostnodeOrphanVotesByTime.begin();
+    while(itGhostnodeOrphanByTime != mapGhostnodeOrphanVotesByTime.end() && itGhostnodeOrphanByTime->first < nNow) {
+        std::unordered_map<COutPoint, int64_t, SaltedOutpointHasher>::iterator itGhostnodeOrphan = mapGhostnodeOrphanVotes.find(itGhostnodeOrphanByTime->second);
+        if(itGhostnodeOrphan != mapGhostnodeOrphanVotes.end() && itGhostnodeOrphan->second < nNow) {
             //LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing expired orphan ghostnode vote: ghostnode=%s\n",
                //     itGhostnodeOrphan->first.ToStringShort());
-            mapGhostnodeOrphanVotes.erase(itGhostnodeOrphan++);
+            mapGhostnodeOrphanVotes.erase(itGhostnodeOrphan);
+        }
+        mapGhostnodeOrphanVotesByTime.erase(itGhostnodeOrphanByTime++);
+    }
+
+    // remove old rejected lock requests, unless their candidate is still around
+    std::multimap<int64_t, uint256>::iterator itRejectedByTime = mapLockRequestRejectedByTime.begin();
+    while(itRejectedByTime != mapLockRequestRejectedByTime.end() && nNow - itRejectedByTime->first > REJECTED_REQUEST_SECONDS) {
+        if(!mapTxLockCandidates.count(itRejectedByTime->second)) {
+            mapLockRequestRejected.erase(itRejectedByTime->second);
+        }
+        mapLockRequestRejectedByTime.erase(itRejectedByTime++);
+    }
+
+    // remove quorums the ghostnode list may have changed under
+    std::map<int, CLockQuorum>::iterator itQuorum = mapLockQuorums.begin();
+    while(itQuorum != mapLockQuorums.end()) {
+        if(GetTime() - itQuorum->second.nTimeCreated > LOCK_QUORUM_SECONDS) {
+            mapLockQuorums.erase(itQuorum++);
         } else {
-            ++itGhostnodeOrphan;
+            ++itQuorum;
+        }
+    }
+}
+
+void CInstantSend::SetLockCandidateConfirmedHeight(CTxLockCandidate& txLockCandidate, int nHeight)
+{
+    AssertLockHeld(cs_instantsend);
+    txLockCandidate.SetConfirmedHeight(nHeight);
+    if(nHeight != -1) {
+        mapLockCandidatesByConfirmedHeight.insert(std::make_pair(nHeight, txLockCandidate.GetHash()));
+    }
+}
+
+void CInstantSend::SetTxLockVoteConfirmedHeight(const uint256& nVoteHash, int nHeight)
+{
+    AssertLockHeld(cs_instantsend);
+    std::unordered_map<uint256, CTxLockVote, SaltedTxidHasher>::iterator it = mapTxLockVotes.find(nVoteHash);
+    if(it == mapTxLockVotes.end()) return;
+    it->second.SetConfirmedHeight(nHeight);
+    if(nHeight != -1) {
+        mapTxLockVotesByConfirmedHeight.insert(std::make_pair(nHeight, nVoteHash));
+    }
+}
+
+void CInstantSend::AddOrphanTxLockVote(const CTxLockVote& vote)
+{
+    AssertLockHeld(cs_instantsend);
+
+    // bounded under vote spam, evict the oldest orphan votes first
+    while((int)mapTxLockVotesOrphan.size() >= MAX_ORPHAN_VOTES && !mapTxLockVotesOrphanByTime.empty()) {
+        std::multimap<int64_t, uint256>::iterator itOldest = mapTxLockVotesOrphanByTime.begin();
+        if(mapTxLockVotesOrphan.erase(itOldest->second)) {
+            mapTxLockVotes.erase(itOldest->second);
         }
+        mapTxLockVotesOrphanByTime.erase(itOldest);
+    }
+
+    uint256 nVoteHash = vote.GetHash();
+    mapTxLockVotesOrphan[nVoteHash] = vote;
+    mapTxLockVotesOrphanByTime.insert(std::make_pair(vote.GetTimeCreated(), nVoteHash));
+}
+
+void CInstantSend::SetGhostnodeOrphanVoteExpiration(const COutPoint& outpointGhostnode, int64_t nExpirationTime)
+{
+    AssertLockHeld(cs_instantsend);
+    mapGhostnodeOrphanVotes[outpointGhostnode] = nExpirationTime;
+    mapGhostnodeOrphanVotesByTime.insert(std::make_pair(nExpirationTime, outpointGhostnode));
+}
+
+void CInstantSend::AddRejectedLockRequest(const CTxLockRequest& txLockRequest)
+{
+    AssertLockHeld(cs_instantsend);
+    if(mapLockRequestRejected.insert(std::make_pair(txLockRequest.GetHash(), txLockRequest)).second) {
+        mapLockRequestRejectedByTime.insert(std::make_pair(GetTime(), txLockRequest.GetHash()));
     }
 }
 
@@ -653,7 +740,7 @@ void CInstantSend::AcceptLockRequest(const CTxLockRequest& txLockRequest)
 void CInstantSend::RejectLockRequest(const CTxLockRequest& txLockRequest)
 {
     LOCK(cs_instantsend);
-    mapLockRequestRejected.insert(make_pair(txLockRequest.GetHash(), txLockRequest));
+    AddRejectedLockRequest(txLockRequest);
 }
 
 bool CInstantSend::HasTxLockRequest(const uint256& txHash)
@@ -666,7 +753,7 @@ bool CInstantSend::GetTxLockRequest(const uint256& txHash, CTxLockRequest& txLoc
 {
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+    std::unordered_map<uint256, CTxLockCandidate, SaltedTxidHasher>::iterator it = mapTxLockCandidates.find(txHash);
     if(it == mapTxLockCandidates.end()) return false;
 
     //TODO: find a solution for calling
@@ -679,7 +766,7 @@ bool CInstantSend::GetTxLockVote(const uint256& hash, CTxLockVote& txLockVoteRet
 {
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotes.find(hash);
+    std::unordered_map<uint256, CTxLockVote, SaltedTxidHasher>::iterator it = mapTxLockVotes.find(hash);
     if(it == mapTxLockVotes.end()) return false;
     txLockVoteRet = it->second;
 
@@ -694,7 +781,7 @@ bool CInstantSend::IsInstantSendReadyToLock(const uint256& txHash)
     LOCK(cs_instantsend);
     // There must be a successfully verified lock request
     // and all outputs must be locked (i.e. have enough signatures)
-    std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
+    std::unordered_map<uint256, CTxLockCandidate, SaltedTxidHasher>::iterator it = mapTxLockCandidates.find(txHash);
     return it != mapTxLockCandidates.end() && it->second.IsAllOutPointsReady();
 }
 
@@ -706,7 +793,7 @@ bool CInstantSend::IsLockedInstantSendTransaction(const uint256& txHash)
     LOCK(cs_instantsend);
 
     // there must be a lock candidate
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    std::unordered_map<uint256, CTxLockCandidate, SaltedTxidHasher>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     if(itLockCandidate == mapTxLockCandidates.end()) return false;
 
     // which should have outpoints
@@ -731,7 +818,7 @@ int CInstantSend::GetTransactionLockSignatures(const uint256& txHash)
 
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    std::unordered_map<uint256, CTxLockCandidate, SaltedTxidHasher>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     if(itLockCandidate != mapTxLockCandidates.end()) {
         return itLockCandidate->second.CountVotes();
     }
@@ -745,7 +832,7 @@ bool CInstantSend::IsTxLockRequestTimedOut(const uint256& txHash)
 
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    std::unordered_map<uint256, CTxLockCandidate, SaltedTxidHasher>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     if (itLockCandidate != mapTxLockCandidates.end()) {
         return !itLockCandidate->second.IsAllOutPointsReady() &&
                 itLockCandidate->second.txLockRequest.IsTimedOut();
@@ -758,7 +845,7 @@ void CInstantSend::Relay(const uint256& txHash)
 {
     LOCK(cs_instantsend);
 
-    std::map<uint256, CTxLockCandidate>::const_iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    std::unordered_map<uint256, CTxLockCandidate, SaltedTxidHasher>::const_iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     if (itLockCandidate != mapTxLockCandidates.end()) {
         itLockCandidate->second.Relay();
     }
@@ -769,57 +856,100 @@ void CInstantSend::UpdatedBlockTip(const CBlockIndex *pindex)
     pCurrentBlockIndex = pindex;
 }
 
-void CInstantSend::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
+size_t CInstantSend::DynamicMemoryUsage()
 {
-    // Update lock candidates and votes if corresponding tx confirmed
-    // or went from confirmed to 0-confirmed or conflicted.
+    LOCK(cs_instantsend);
+    size_t nUsage = memusage::DynamicUsage(mapLockRequestAccepted) + memusage::DynamicUsage(mapLockRequestRejected);
+    for (const auto& request : mapLockRequestAccepted)
+        nUsage += RecursiveDynamicUsage(request.second);
+    for (const auto& request : mapLockRequestRejected)
+        nUsage += RecursiveDynamicUsage(request.second);
+    nUsage += memusage::DynamicUsage(mapTxLockVotes) + memusage::DynamicUsage(mapTxLockVotesOrphan);
+    for (const auto& vote : mapTxLockVotes)
+        nUsage += vote.second.DynamicMemoryUsage();
+    for (const auto& vote : mapTxLockVotesOrphan)
+        nUsage += vote.second.DynamicMemoryUsage();
+    nUsage += memusage::DynamicUsage(mapTxLockCandidates);
+    for (const auto& candidate : mapTxLockCandidates)
+        nUsage += candidate.second.DynamicMemoryUsage();
+
+    nUsage += memusage::DynamicUsage(mapVotedOutpoints) + memusage::DynamicUsage(mapLockedOutpoints);
+    for (const auto& voted : mapVotedOutpoints)
+        nUsage += memusage::DynamicUsage(voted.second);
+    nUsage += memusage::DynamicUsage(mapGhostnodeOrphanVotes);
+    nUsage += memusage::DynamicUsage(mapLockCandidatesByConfirmedHeight) + memusage::DynamicUsage(mapTxLockVotesByConfirmedHeight) +
+              memusage::DynamicUsage(mapTxLockVotesOrphanByTime) + memusage::DynamicUsage(mapLockRequestRejectedByTime) +
+              memusage::DynamicUsage(mapGhostnodeOrphanVotesByTime);
+    nUsage += memusage::DynamicUsage(mapLockQuorums);
+    for (const auto& quorum : mapLockQuorums)
+        nUsage += memusage::DynamicUsage(quorum.second.setGhostnodes);
+    return nUsage;
+}
 
-    if (tx.IsCoinBase()) return;
+void CInstantSend::BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex, const std::vector<CTransactionRef>& txnConflicted)
+{
+    // Update lock candidates and votes if corresponding tx confirmed or conflicted
+    SyncBlockTransactions(block->vtx, pindex->nHeight);
+    SyncBlockTransactions(txnConflicted, -1);
+}
 
-    LOCK2(cs_main, cs_instantsend);
+void CInstantSend::BlockDisconnected(const std::shared_ptr<const CBlock>& block)
+{
+    // Transactions of a disconnected block went from confirmed to 0-confirmed
+    SyncBlockTransactions(block->vtx, -1);
+}
+
+void CInstantSend::SyncBlockTransactions(const std::vector<CTransactionRef>& vtx, int nHeight)
+{
+    LOCK(cs_instantsend);
+
+    // nothing to update for blocks while InstantSend is idle
+    if(mapTxLockCandidates.empty() && mapTxLockVotesOrphan.empty()) return;
 
-    uint256 txHash = tx.GetHash();
+    std::set<uint256> setOrphanVoteTxHashes;
+    for(std::unordered_map<uint256, CTxLockVote, SaltedTxidHasher>::iterator it = mapTxLockVotesOrphan.begin(); it != mapTxLockVotesOrphan.end(); ++it) {
+        setOrphanVoteTxHashes.insert(it->second.GetTxHash());
+    }
+
+    BOOST_FOREACH(const CTransactionRef& ptx, vtx) {
+        if(ptx->IsCoinBase()) continue;
+        const uint256& txHash = ptx->GetHash();
+        if(!mapTxLockCandidates.count(txHash) && !setOrphanVoteTxHashes.count(txHash)) continue;
+        SetConfirmedHeight(txHash, nHeight, setOrphanVoteTxHashes);
+    }
+}
 
-    // When tx is 0-confirmed or conflicted, pblock is NULL and nHeightNew should be set to -1
-    CBlockIndex* pblockindex = pblock ? mapBlockIndex[pblock->GetHash()] : NULL;
-    int nHeightNew = pblockindex ? pblockindex->nHeight : -1;
+void CInstantSend::SetConfirmedHeight(const uint256& txHash, int nHeightNew, const std::set<uint256>& setOrphanVoteTxHashes)
+{
+    AssertLockHeld(cs_instantsend);
 
-    //LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d\n", txHash.ToString(), nHeightNew);
+    //LogPrint("instantsend", "CInstantSend::SetConfirmedHeight -- txid=%s nHeightNew=%d\n", txHash.ToString(), nHeightNew);
 
     // Check lock candidates
-    std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
+    std::unordered_map<uint256, CTxLockCandidate, SaltedTxidHasher>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     if(itLockCandidate != mapTxLockCandidates.end()) {
-        //LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d lock candidate updated\n",
+        //LogPrint("instantsend", "CInstantSend::SetConfirmedHeight -- txid=%s nHeightNew=%d lock candidate updated\n",
                // txHash.ToString(), nHeightNew);
-        itLockCandidate->second.SetConfirmedHeight(nHeightNew);
-        // Loop through outpoint locks
+        SetLockCandidateConfirmedHeight(itLockCandidate->second, nHeightNew);
+        // Loop through outpoint locks and update the corresponding lock votes in place
         std::map<COutPoint, COutPointLock>::iterator itOutpointLock = itLockCandidate->second.mapOutPointLocks.begin();
         while(itOutpointLock != itLockCandidate->second.mapOutPointLocks.end()) {
-            // Check corresponding lock votes
             std::vector<CTxLockVote> vVotes = itOutpointLock->second.GetVotes();
-            std::vector<CTxLockVote>::iterator itVote = vVotes.begin();
-            std::map<uint256, CTxLockVote>::iterator it;
-            while(itVote != vVotes.end()) {
-                uint256 nVoteHash = itVote->GetHash();
-                //LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d vote %s updated\n",
-                      //  txHash.ToString(), nHeightNew, nVoteHash.ToString());
-                it = mapTxLockVotes.find(nVoteHash);
-                if(it != mapTxLockVotes.end()) {
-                    it->second.SetConfirmedHeight(nHeightNew);
-                }
-                ++itVote;
+            BOOST_FOREACH(const CTxLockVote& vote, vVotes) {
+                SetTxLockVoteConfirmedHeight(vote.GetHash(), nHeightNew);
             }
             ++itOutpointLock;
         }
     }
 
     // check orphan votes
-    std::map<uint256, CTxLockVote>::iterator itOrphanVote = mapTxLockVotesOrphan.begin();
+    if(!setOrphanVoteTxHashes.count(txHash)) return;
+    std::unordered_map<uint256, CTxLockVote, SaltedTxidHasher>::iterator itOrphanVote = mapTxLockVotesOrphan.begin();
     while(itOrphanVote != mapTxLockVotesOrphan.end()) {
         if(itOrphanVote->second.GetTxHash() == txHash) {
-            //LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d vote %s updated\n",
+            //LogPrint("instantsend", "CInstantSend::SetConfirmedHeight -- txid=%s nHeightNew=%d vote %s updated\n",
                  //   txHash.ToString(), nHeightNew, itOrphanVote->first.ToString());
-            mapTxLockVotes[itOrphanVote->first].SetConfirmedHeight(nHeightNew);
+            SetTxLockVoteConfirmedHeight(itOrphanVote->first, nHeightNew);
         }
         ++itOrphanVote;
     }
@@ -970,19 +1100,10 @@ bool CTxLockVote::IsValid(CNode* pnode) const
 
     int nLockInputHeight = nPrevoutHeight + 4;
 
-    int n = mnodeman.GetGhostnodeRank(CTxIn(outpointGhostnode), nLockInputHeight, MIN_INSTANTSEND_PROTO_VERSION);
-
-    if(n == -1) {
-        //can be caused by past versions trying to vote with an invalid protocol
-        //LogPrint("instantsend", "CTxLockVote::IsValid -- Outdated ghostnode %s\n", outpointGhostnode.ToStringShort());
-        return false;
-    }
-    //LogPrint("instantsend", "CTxLockVote::IsValid -- Ghostnode %s, rank=%d\n", outpointGhostnode.ToStringShort(), n);
-
-    int nSignaturesTotal = COutPointLock::SIGNATURES_TOTAL;
-    if(n > nSignaturesTotal) {
-        //LogPrint("instantsend", "CTxLockVote::IsValid -- Ghostnode %s is not in the top %d (%d), vote hash=%s\n",
-               // outpointGhostnode.ToStringShort(), nSignaturesTotal, n, GetHash().ToString());
+    if(!instantsend.IsInLockQuorum(outpointGhostnode, nLockInputHeight)) {
+        // outdated or not in the top COutPointLock::SIGNATURES_TOTAL
+        //LogPrint("instantsend", "CTxLockVote::IsValid -- Ghostnode %s is not in the top %d, vote hash=%s\n",
+               // outpointGhostnode.ToStringShort(), COutPointLock::SIGNATURES_TOTAL, GetHash().ToString());
         return false;
     }
 
@@ -1003,10 +1124,15 @@ uint256 CTxLockVote::GetHash() const
     return ss.GetHash();
 }
 
+uint256 CTxLockVote::GetSignatureHash(bool fNewSigs) const
+{
+    if (fNewSigs) return GetHash();
+    return CDarkSendSigner::GetMessageHash(txHash.ToString() + outpoint.ToStringShort());
+}
+
 bool CTxLockVote::CheckSignature() const
 {
     std::string strError;
-    std::string strMessage = txHash.ToString() + outpoint.ToStringShort();
 
     ghostnode_info_t infoMn = mnodeman.GetGhostnodeInfo(CTxIn(outpointGhostnode));
 
@@ -1015,8 +1141,9 @@ bool CTxLockVote::CheckSignature() const
         return false;
     }
 
-    if(!darkSendSigner.VerifyMessage(infoMn.pubKeyGhostnode, vchGhostnodeSignature, strMessage, strError)) {
-        //LogPrint("CTxLockVote::CheckSignature -- VerifyMessage() failed, error: %s\n", strError);
+    bool fNewSigs = sporkManager.IsSporkActive(SPORK_6_NEW_SIGS);
+    if(!darkSendSigner.VerifyHash(infoMn.pubKeyGhostnode, vchGhostnodeSignature, GetSignatureHash(fNewSigs), strError)) {
+        //LogPrint("CTxLockVote::CheckSignature -- VerifyHash() failed, error: %s\n", strError);
         return false;
     }
 
@@ -1026,15 +1153,15 @@ bool CTxLockVote::CheckSignature() const
 bool CTxLockVote::Sign()
 {
     std::string strError;
-    std::string strMessage = txHash.ToString() + outpoint.ToStringShort();
+    uint256 hash = GetSignatureHash(sporkManager.IsSporkActive(SPORK_6_NEW_SIGS));
 
-    if(!darkSendSigner.SignMessage(strMessage, vchGhostnodeSignature, activeGhostnode.keyGhostnode)) {
-        //LogPrint("CTxLockVote::Sign -- SignMessage() failed\n");
+    if(!darkSendSigner.SignHash(hash, vchGhostnodeSignature, activeGhostnode.keyGhostnode)) {
+        //LogPrint("CTxLockVote::Sign -- SignHash() failed\n");
         return false;
     }
 
-    if(!darkSendSigner.VerifyMessage(activeGhostnode.pubKeyGhostnode, vchGhostnodeSignature, strMessage, strError)) {
-        //LogPrint("CTxLockVote::Sign -- VerifyMessage() failed, error: %s\n", strError);
+    if(!darkSendSigner.VerifyHash(activeGhostnode.pubKeyGhostnode, vchGhostnodeSignature, hash, strError)) {
+        //LogPrint("CTxLockVote::Sign -- VerifyHash() failed, error: %s\n", strError);
         return false;
     }
 
@@ -5,8 +5,14 @@
 #ifndef INSTANTX_H
 #define INSTANTX_H
 
+#include "coins.h"
+#include "core_memusage.h"
 #include "net.h"
 #include "primitives/transaction.h"
+#include "txmempool.h"
+#include "validationinterface.h"
+
+#include <unordered_map>
 
 class CTxLockVote;
 class COutPointLock;
@@ -34,27 +40,53 @@ extern bool fEnableInstantSend;
 extern int nInstantSendDepth;
 extern int nCompleteTXLocks;
 
-class CInstantSend
+class CInstantSend : public CValidationInterface
 {
 private:
     static const int ORPHAN_VOTE_SECONDS            = 60;
+    static const int LOCK_QUORUM_SECONDS            = 60;
+    static const int REJECTED_REQUEST_SECONDS       = 24 * 60 * 60;
+    static const int MAX_ORPHAN_VOTES               = 10000;
 
     // Keep track of current block index
     const CBlockIndex *pCurrentBlockIndex;
 
     // maps for AlreadyHave
-    std::map<uint256, CTxLockRequest> mapLockRequestAccepted; // tx hash - tx
-    std::map<uint256, CTxLockRequest> mapLockRequestRejected; // tx hash - tx
-    std::map<uint256, CTxLockVote> mapTxLockVotes; // vote hash - vote
-    std::map<uint256, CTxLockVote> mapTxLockVotesOrphan; // vote hash - vote
+    std::unordered_map<uint256, CTxLockRequest, SaltedTxidHasher> mapLockRequestAccepted; // tx hash - tx
+    std::unordered_map<uint256, CTxLockRequest, SaltedTxidHasher> mapLockRequestRejected; // tx hash - tx
+    std::unordered_map<uint256, CTxLockVote, SaltedTxidHasher> mapTxLockVotes; // vote hash - vote
+    std::unordered_map<uint256, CTxLockVote, SaltedTxidHasher> mapTxLockVotesOrphan; // vote hash - vote
 
-    std::map<uint256, CTxLockCandidate> mapTxLockCandidates; // tx hash - lock candidate
+    std::unordered_map<uint256, CTxLockCandidate, SaltedTxidHasher> mapTxLockCandidates; // tx hash - lock candidate
 
     std::map<COutPoint, std::set<uint256> > mapVotedOutpoints; // utxo - tx hash set
     std::map<COutPoint, uint256> mapLockedOutpoints; // utxo - tx hash
 
     //track ghostnodes who voted with no txreq (for DOS protection)
-    std::map<COutPoint, int64_t> mapGhostnodeOrphanVotes; // mn outpoint - time
+    std::unordered_map<COutPoint, int64_t, SaltedOutpointHasher> mapGhostnodeOrphanVotes; // mn outpoint - time
+
+    // expiry queues, so CheckAndRemove only visits the entries that expired. An entry stays queued when
+    // its height or time changes, it is skipped once it comes up if the map no longer agrees with it
+    std::multimap<int, uint256> mapLockCandidatesByConfirmedHeight; // confirmed height - tx hash
+    std::multimap<int, uint256> mapTxLockVotesByConfirmedHeight; // confirmed height - vote hash
+    std::multimap<int64_t, uint256> mapTxLockVotesOrphanByTime; // time created - vote hash
+    std::multimap<int64_t, uint256> mapLockRequestRejectedByTime; // time rejected - tx hash
+    std::multimap<int64_t, COutPoint> mapGhostnodeOrphanVotesByTime; // expiration time - mn outpoint
+
+    // ghostnodes allowed to vote on the outpoints with a lock input height, kept for LOCK_QUORUM_SECONDS
+    // so every vote for those outpoints does not rank the whole ghostnode list again
+    struct CLockQuorum {
+        int64_t nTimeCreated;
+        std::set<COutPoint> setGhostnodes;
+    };
+    std::map<int, CLockQuorum> mapLockQuorums; // lock input height - quorum
+
+    // update the maps above together with their expiry queues, require cs_instantsend
+    void SetLockCandidateConfirmedHeight(CTxLockCandidate& txLockCandidate, int nHeight);
+    void SetTxLockVoteConfirmedHeight(const uint256& nVoteHash, int nHeight);
+    void AddOrphanTxLockVote(const CTxLockVote& vote);
+    void SetGhostnodeOrphanVoteExpiration(const COutPoint& outpointGhostnode, int64_t nExpirationTime);
+    void AddRejectedLockRequest(const CTxLockRequest& txLockRequest);
 
     bool CreateTxLockCandidate(const CTxLockRequest& txLockRequest);
     void Vote(CTxLockCandidate& txLockCandidate);
@@ -74,6 +106,15 @@ private:
 
     bool IsInstantSendReadyToLock(const uint256 &txHash);
 
+    // set the confirmed height of a lock candidate and its votes, requires cs_instantsend
+    void SetConfirmedHeight(const uint256& txHash, int nHeight, const std::set<uint256>& setOrphanVoteTxHashes);
+    void SyncBlockTransactions(const std::vector<CTransactionRef>& vtx, int nHeight);
+
+protected:
+    // CValidationInterface, called from the background queue without cs_main
+    void BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex, const std::vector<CTransactionRef>& txnConflicted) override;
+    void BlockDisconnected(const std::shared_ptr<const CBlock>& block) override;
+
 public:
     CCriticalSection cs_instantsend;
 
@@ -90,6 +131,9 @@ public:
 
     bool GetTxLockVote(const uint256& hash, CTxLockVote& txLockVoteRet);
 
+    // is the ghostnode among the top COutPointLock::SIGNATURES_TOTAL for outpoints with this lock input height
+    bool IsInLockQuorum(const COutPoint& outpointGhostnode, int nLockInputHeight);
+
     bool GetLockedOutPointTxHash(const COutPoint& outpoint, uint256& hashRet);
 
     // verify if transaction is currently locked
@@ -105,7 +149,9 @@ public:
     void Relay(const uint256& txHash);
 
     void UpdatedBlockTip(const CBlockIndex *pindex);
-    void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
+
+    /// Estimated heap memory of the lock requests, candidates, votes and their expiry queues
+    size_t DynamicMemoryUsage();
 };
 
 class CTxLockRequest : public CMutableTransaction
@@ -185,10 +231,14 @@ public:
     void SetConfirmedHeight(int nConfirmedHeightIn) { nConfirmedHeight = nConfirmedHeightIn; }
     bool IsExpired(int nHeight) const;
 
+    /// The hash signed by the ghostnode key: GetHash() with SPORK_6_NEW_SIGS (fNewSigs), else of the vote as text
+    uint256 GetSignatureHash(bool fNewSigs) const;
     bool Sign();
     bool CheckSignature() const;
 
     void Relay() const;
+
+    size_t DynamicMemoryUsage() const { return memusage::DynamicUsage(vchGhostnodeSignature); }
 };
 
 class COutPointLock
@@ -215,6 +265,14 @@ public:
     bool IsReady() const { return CountVotes() >= SIGNATURES_REQUIRED; }
 
     void Relay() const;
+
+    size_t DynamicMemoryUsage() const
+    {
+        size_t nUsage = memusage::DynamicUsage(mapGhostnodeVotes);
+        for (const auto& vote : mapGhostnodeVotes)
+            nUsage += vote.second.DynamicMemoryUsage();
+        return nUsage;
+    }
 };
 
 class CTxLockCandidate
@@ -245,6 +303,14 @@ public:
     bool IsExpired(int nHeight) const;
 
     void Relay() const;
+
+    size_t DynamicMemoryUsage() const
+    {
+        size_t nUsage = RecursiveDynamicUsage(txLockRequest) + memusage::DynamicUsage(mapOutPointLocks);
+        for (const auto& lock : mapOutPointLocks)
+            nUsage += lock.second.DynamicMemoryUsage();
+        return nUsage;
+    }
 };
 
 #endif
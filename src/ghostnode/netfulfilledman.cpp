@@ -4,34 +4,74 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "chainparams.h"
+#include "hash.h"
 #include "netfulfilledman.h"
+#include "random.h"
 #include "util.h"
 
 CNetFulfilledRequestManager netfulfilledman;
 
-void CNetFulfilledRequestManager::AddFulfilledRequest(CAddress addr, std::string strRequest)
+std::string GetFulfilledRequestName(FulfilledRequest request)
+{
+    switch (request) {
+        case FULFILLED_SPORK_SYNC:                      return "spork-sync";
+        case FULFILLED_GHOSTNODE_LIST_SYNC:             return "ghostnode-list-sync";
+        case FULFILLED_GHOSTNODE_PAYMENT_SYNC:          return "ghostnode-payment-sync";
+        case FULFILLED_FULL_SYNC:                       return "full-sync";
+        case FULFILLED_GHOSTNODE_PAYMENT_SYNC_REQUEST:  return NetMsgType::GHOSTNODEPAYMENTSYNC;
+        case FULFILLED_MNVERIFY_REQUEST:                return strprintf("%s-request", NetMsgType::MNVERIFY);
+        case FULFILLED_MNVERIFY_REPLY:                  return strprintf("%s-reply", NetMsgType::MNVERIFY);
+        case FULFILLED_MNVERIFY_DONE:                   return strprintf("%s-done", NetMsgType::MNVERIFY);
+        default:                                        return "unknown";
+    }
+}
+
+SaltedNetAddrHasher::SaltedNetAddrHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+size_t SaltedNetAddrHasher::operator()(const CNetAddr& addr) const
+{
+    unsigned char vch[16];
+    for (int i = 0; i < 16; i++)
+        vch[i] = addr.GetByte(i);
+    return CSipHasher(k0, k1).Write(vch, sizeof(vch)).Finalize();
+}
+
+void CNetFulfilledRequestManager::SetExpiration(const CNetAddr& addr, FulfilledRequest request, int64_t nExpiration)
+{
+    AssertLockHeld(cs_mapFulfilledRequests);
+    fulfilledreqmap_t::iterator it = mapFulfilledRequests.find(addr);
+    if (it == mapFulfilledRequests.end()) {
+        fulfilledreqmapentry_t entry;
+        entry.fill(0);
+        it = mapFulfilledRequests.emplace(addr, entry).first;
+    }
+    it->second[request] = nExpiration;
+    mapFulfilledRequestsByExpiration.emplace(nExpiration, std::make_pair(addr, request));
+}
+
+void CNetFulfilledRequestManager::AddFulfilledRequest(const CNetAddr& addr, FulfilledRequest request)
 {
     LOCK(cs_mapFulfilledRequests);
-    mapFulfilledRequests[addr][strRequest] = GetTime() + Params().FulfilledRequestExpireTime();
+    SetExpiration(addr, request, GetTime() + Params().FulfilledRequestExpireTime());
 }
 
-bool CNetFulfilledRequestManager::HasFulfilledRequest(CAddress addr, std::string strRequest)
+bool CNetFulfilledRequestManager::HasFulfilledRequest(const CNetAddr& addr, FulfilledRequest request)
 {
     LOCK(cs_mapFulfilledRequests);
     fulfilledreqmap_t::iterator it = mapFulfilledRequests.find(addr);
 
     return  it != mapFulfilledRequests.end() &&
-            it->second.find(strRequest) != it->second.end() &&
-            it->second[strRequest] > GetTime();
+            it->second[request] > GetTime();
 }
 
-void CNetFulfilledRequestManager::RemoveFulfilledRequest(CAddress addr, std::string strRequest)
+void CNetFulfilledRequestManager::RemoveFulfilledRequest(const CNetAddr& addr, FulfilledRequest request)
 {
     LOCK(cs_mapFulfilledRequests);
     fulfilledreqmap_t::iterator it = mapFulfilledRequests.find(addr);
 
+    // the entry itself goes away with the request's expiration bucket
     if (it != mapFulfilledRequests.end()) {
-        it->second.erase(strRequest);
+        it->second[request] = 0;
     }
 }
 
@@ -40,22 +80,22 @@ void CNetFulfilledRequestManager::CheckAndRemove()
     LOCK(cs_mapFulfilledRequests);
 
     int64_t now = GetTime();
-    fulfilledreqmap_t::iterator it = mapFulfilledRequests.begin();
-
-    while(it != mapFulfilledRequests.end()) {
-        fulfilledreqmapentry_t::iterator it_entry = it->second.begin();
-        while(it_entry != it->second.end()) {
-            if(now > it_entry->second) {
-                it->second.erase(it_entry++);
-            } else {
-                ++it_entry;
+    std::multimap<int64_t, std::pair<CNetAddr, FulfilledRequest> >::iterator itExpiration = mapFulfilledRequestsByExpiration.begin();
+
+    while(itExpiration != mapFulfilledRequestsByExpiration.end() && now > itExpiration->first) {
+        fulfilledreqmap_t::iterator it = mapFulfilledRequests.find(itExpiration->second.first);
+        if(it != mapFulfilledRequests.end()) {
+            int64_t& nExpiration = it->second[itExpiration->second.second];
+            // renewed requests have a later bucket of their own
+            if(nExpiration <= itExpiration->first) nExpiration = 0;
+
+            bool fEmpty = true;
+            for (int64_t nTime : it->second) {
+                if(nTime != 0) fEmpty = false;
             }
+            if(fEmpty) mapFulfilledRequests.erase(it);
         }
-        if(it->second.size() == 0) {
-            mapFulfilledRequests.erase(it++);
-        } else {
-            ++it;
-        }
+        mapFulfilledRequestsByExpiration.erase(itExpiration++);
     }
 }
 
@@ -63,10 +103,46 @@ void CNetFulfilledRequestManager::Clear()
 {
     LOCK(cs_mapFulfilledRequests);
     mapFulfilledRequests.clear();
+    mapFulfilledRequestsByExpiration.clear();
+}
+
+CNetFulfilledRequestManager::fulfilledreqnamemap_t CNetFulfilledRequestManager::GetRequestsByName() const
+{
+    AssertLockHeld(cs_mapFulfilledRequests);
+    fulfilledreqnamemap_t mapRequestsByName;
+    for (const auto& pair : mapFulfilledRequests) {
+        for (int i = 0; i < FULFILLED_REQUEST_COUNT; i++) {
+            if(pair.second[i] != 0) {
+                mapRequestsByName[pair.first][GetFulfilledRequestName((FulfilledRequest)i)] = pair.second[i];
+            }
+        }
+    }
+    return mapRequestsByName;
+}
+
+void CNetFulfilledRequestManager::SetRequestsByName(const fulfilledreqnamemap_t& mapRequestsByName)
+{
+    AssertLockHeld(cs_mapFulfilledRequests);
+    std::map<std::string, FulfilledRequest> mapRequestIds;
+    for (int i = 0; i < FULFILLED_REQUEST_COUNT; i++) {
+        mapRequestIds[GetFulfilledRequestName((FulfilledRequest)i)] = (FulfilledRequest)i;
+    }
+
+    mapFulfilledRequests.clear();
+    mapFulfilledRequestsByExpiration.clear();
+    for (const auto& pair : mapRequestsByName) {
+        for (const auto& request : pair.second) {
+            std::map<std::string, FulfilledRequest>::iterator it = mapRequestIds.find(request.first);
+            // requests this version doesn't know about anymore
+            if(it == mapRequestIds.end()) continue;
+            SetExpiration(pair.first, it->second, request.second);
+        }
+    }
 }
 
 std::string CNetFulfilledRequestManager::ToString() const
 {
+    LOCK(cs_mapFulfilledRequests);
     std::ostringstream info;
     info << "Nodes with fulfilled requests: " << (int)mapFulfilledRequests.size();
     return info.str();
@@ -11,20 +11,60 @@
 #include "serialize.h"
 #include "sync.h"
 
+#include <array>
+#include <map>
+#include <unordered_map>
+
 // Fulfilled requests are used to prevent nodes from asking for the same data on sync
 // and from being banned for doing so too often.
 class CNetFulfilledRequestManager;
 extern CNetFulfilledRequestManager netfulfilledman;
 
+// Don't reorder, GetFulfilledRequestName gives the name each request is stored with on disk
+enum FulfilledRequest {
+    FULFILLED_SPORK_SYNC,
+    FULFILLED_GHOSTNODE_LIST_SYNC,
+    FULFILLED_GHOSTNODE_PAYMENT_SYNC,
+    FULFILLED_FULL_SYNC,
+    FULFILLED_GHOSTNODE_PAYMENT_SYNC_REQUEST,
+    FULFILLED_MNVERIFY_REQUEST,
+    FULFILLED_MNVERIFY_REPLY,
+    FULFILLED_MNVERIFY_DONE,
+    FULFILLED_REQUEST_COUNT
+};
+
+std::string GetFulfilledRequestName(FulfilledRequest request);
+
+class SaltedNetAddrHasher
+{
+private:
+    /** Salt */
+    const uint64_t k0, k1;
+
+public:
+    SaltedNetAddrHasher();
+
+    size_t operator()(const CNetAddr& addr) const;
+};
+
 class CNetFulfilledRequestManager
 {
 private:
-    typedef std::map<std::string, int64_t> fulfilledreqmapentry_t;
-    typedef std::map<CNetAddr, fulfilledreqmapentry_t> fulfilledreqmap_t;
+    // expiration time of every request, 0 if not fulfilled
+    typedef std::array<int64_t, FULFILLED_REQUEST_COUNT> fulfilledreqmapentry_t;
+    typedef std::unordered_map<CNetAddr, fulfilledreqmapentry_t, SaltedNetAddrHasher> fulfilledreqmap_t;
 
     //keep track of what node has/was asked for and when
     fulfilledreqmap_t mapFulfilledRequests;
-    CCriticalSection cs_mapFulfilledRequests;
+    // requests by expiration time, entries which were removed or renewed since are skipped
+    std::multimap<int64_t, std::pair<CNetAddr, FulfilledRequest> > mapFulfilledRequestsByExpiration;
+    mutable CCriticalSection cs_mapFulfilledRequests;
+
+    // on disk format, requests by name
+    typedef std::map<CNetAddr, std::map<std::string, int64_t> > fulfilledreqnamemap_t;
+    fulfilledreqnamemap_t GetRequestsByName() const;
+    void SetRequestsByName(const fulfilledreqnamemap_t& mapRequestsByName);
+    void SetExpiration(const CNetAddr& addr, FulfilledRequest request, int64_t nExpiration);
 
 public:
     CNetFulfilledRequestManager() {}
@@ -34,12 +74,15 @@ public:
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action) {
         LOCK(cs_mapFulfilledRequests);
-        READWRITE(mapFulfilledRequests);
+        fulfilledreqnamemap_t mapRequestsByName;
+        if (!ser_action.ForRead()) mapRequestsByName = GetRequestsByName();
+        READWRITE(mapRequestsByName);
+        if (ser_action.ForRead()) SetRequestsByName(mapRequestsByName);
     }
 
-    void AddFulfilledRequest(CAddress addr, std::string strRequest); // expire after 1 hour by default
-    bool HasFulfilledRequest(CAddress addr, std::string strRequest);
-    void RemoveFulfilledRequest(CAddress addr, std::string strRequest);
+    void AddFulfilledRequest(const CNetAddr& addr, FulfilledRequest request); // expire after 1 hour by default
+    bool HasFulfilledRequest(const CNetAddr& addr, FulfilledRequest request);
+    void RemoveFulfilledRequest(const CNetAddr& addr, FulfilledRequest request);
 
     void CheckAndRemove();
     void Clear();
@@ -8,9 +8,11 @@
 #include "init.h"
 #include "validation.h"
 #include "ghostnode-payments.h"
+#include "ghostnode-stats.h"
 #include "ghostnode-sync.h"
 #include "ghostnodeconfig.h"
 #include "ghostnodeman.h"
+#include "index/collateralindex.h"
 #include "rpc/server.h"
 #include "util.h"
 #include "utilmoneystr.h"
@@ -98,6 +100,73 @@ UniValue getpoolinfo(const JSONRPCRequest& req) {
     return obj;
 }
 
+UniValue getghostnodestats(const JSONRPCRequest& req) {
+
+    UniValue params = req.params;
+    bool fHelp = req.fHelp;
+    if (fHelp || params.size() > 1)
+        throw std::runtime_error(
+                "getghostnodestats ( reset )\n"
+                        "Returns timings of the ghostnode, payment and InstantSend code paths, the time spent\n"
+                        "waiting for their locks and the number of ghostnode messages received, by type.\n"
+                        "\nArguments:\n"
+                        "1. reset    (boolean, optional, default=false) Clear the statistics after returning them\n"
+                        "\nExamples:\n"
+                        + HelpExampleCli("getghostnodestats", "")
+                        + HelpExampleRpc("getghostnodestats", "true"));
+
+    UniValue obj = ghostnodeStats.ToJSON();
+
+    if (params.size() > 0 && params[0].get_bool())
+        ghostnodeStats.Clear();
+
+    return obj;
+}
+
+UniValue getghostnodecollaterals(const JSONRPCRequest& req) {
+
+    UniValue params = req.params;
+    bool fHelp = req.fHelp;
+    if (fHelp || params.size() > 0)
+        throw std::runtime_error(
+                "getghostnodecollaterals\n"
+                        "Returns the unspent outputs of the ghostnode collateral amount in the active chain, the ghostnodes\n"
+                        "the chain allows, and whether a ghostnode has been announced for each. Requires -collateralindex.\n"
+                        "\nResult:\n"
+                        "[\n"
+                        "  {\n"
+                        "    \"outpoint\": \"xxxx-n\",  (string) The collateral outpoint\n"
+                        "    \"address\": \"xxxx\",     (string) The collateral address\n"
+                        "    \"height\": n,             (numeric) The height of the block that created the collateral\n"
+                        "    \"announced\": true|false  (boolean) Whether the ghostnode list has an entry for the collateral\n"
+                        "  }\n"
+                        "  ,...\n"
+                        "]\n"
+                        "\nExamples:\n"
+                        + HelpExampleCli("getghostnodecollaterals", "")
+                        + HelpExampleRpc("getghostnodecollaterals", ""));
+
+    if (!g_collateralindex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Collateral index not enabled");
+    if (!g_collateralindex->BlockUntilSyncedToCurrentChain())
+        throw JSONRPCError(RPC_MISC_ERROR, "Collateral index is still catching up with the chain");
+
+    std::vector<std::pair<COutPoint, CGhostnodeCollateral> > collaterals;
+    if (!g_collateralindex->GetDB().ReadCollaterals(collaterals))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read the collateral index");
+
+    UniValue result(UniValue::VARR);
+    for (const std::pair<COutPoint, CGhostnodeCollateral>& collateral : collaterals) {
+        CTxDestination dest;
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("outpoint", collateral.first.ToStringShort()));
+        obj.push_back(Pair("address", ExtractDestination(collateral.second.scriptPubKey, dest) ? CBitcoinAddress(dest).ToString() : ""));
+        obj.push_back(Pair("height", collateral.second.nHeight));
+        obj.push_back(Pair("announced", mnodeman.Has(CTxIn(collateral.first))));
+        result.push_back(obj);
+    }
+    return result;
+}
 
 UniValue ghostnode(const JSONRPCRequest& req) {
     std::string strCommand;
@@ -201,10 +270,7 @@ UniValue ghostnode(const JSONRPCRequest& req) {
         int nCount;
         int nHeight;
         CGhostnode *winner = NULL;
-        {
-            LOCK(cs_main);
-            nHeight = chainActive.Height() + (strCommand == "current" ? 1 : 10);
-        }
+        nHeight = GetChainSnapshot()->Height() + (strCommand == "current" ? 1 : 10);
         mnodeman.UpdateLastPaid();
         winner = mnodeman.GetNextGhostnodeInQueueForPayment(nHeight, true, nCount);
         if (!winner) return "unknown";
@@ -423,14 +489,8 @@ UniValue ghostnode(const JSONRPCRequest& req) {
     }
 
     if (strCommand == "winners") {
-        int nHeight;
-        {
-            LOCK(cs_main);
-            CBlockIndex *pindex = chainActive.Tip();
-            if (!pindex) return NullUniValue;
-
-            nHeight = pindex->nHeight;
-        }
+        int nHeight = GetChainSnapshot()->Height();
+        if (nHeight < 0) return NullUniValue;
 
         int nLast = 10;
         std::string strFilter = "";
@@ -460,6 +520,91 @@ UniValue ghostnode(const JSONRPCRequest& req) {
     return NullUniValue;
 }
 
+/** A ghostnodelist reply and the list snapshot and height it was made from */
+struct CGhostnodeListReply {
+    std::shared_ptr<const std::vector<CGhostnode> > pGhostnodes;
+    int nHeight;
+    UniValue result;
+};
+
+//! ghostnodelist replies kept, by mode and filter
+static const size_t MAX_GHOSTNODELIST_REPLIES = 32;
+static CCriticalSection cs_ghostnodeListReplies;
+static std::map<std::pair<std::string, std::string>, CGhostnodeListReply> mapGhostnodeListReplies;
+
+/** The ghostnodelist reply for a mode. The filter is matched against the outpoint first, the mode's
+ * value is only formatted for the ghostnodes left */
+static UniValue ListGhostnodes(const std::vector<CGhostnode>& vGhostnodes, int nHeight, const std::string& strMode, const std::string& strFilter)
+{
+    UniValue obj(UniValue::VOBJ);
+    if (strMode == "rank") {
+        for (const std::pair<int, COutPoint>& rank : mnodeman.GetGhostnodeRankOutpoints()) {
+            std::string strOutpoint = rank.second.ToStringShort();
+            if (strFilter != "" && strOutpoint.find(strFilter) == std::string::npos) continue;
+            obj.push_back(Pair(strOutpoint, rank.first));
+        }
+        return obj;
+    }
+
+    if (strMode == "qualify" && nHeight < 0) return NullUniValue;
+    int nMnCount = strMode == "qualify" ? mnodeman.CountEnabled() : 0;
+
+    for (const CGhostnode& mn : vGhostnodes) {
+        std::string strOutpoint = mn.vin.prevout.ToStringShort();
+        bool fMatch = strFilter == "" || strOutpoint.find(strFilter) != std::string::npos;
+        if (strMode == "activeseconds") {
+            if (!fMatch) continue;
+            obj.push_back(Pair(strOutpoint, (int64_t)(mn.lastPing.sigTime - mn.sigTime)));
+        } else if (strMode == "addr") {
+            std::string strAddress = mn.addr.ToString();
+            if (!fMatch && strAddress.find(strFilter) == std::string::npos) continue;
+            obj.push_back(Pair(strOutpoint, strAddress));
+        } else if (strMode == "full") {
+            std::ostringstream streamFull;
+            streamFull << std::setw(18) <<
+                       mn.GetStatus() << " " <<
+                       mn.nProtocolVersion << " " <<
+                       CBitcoinAddress(mn.pubKeyCollateralAddress.GetID()).ToString() << " " <<
+                       (int64_t) mn.lastPing.sigTime << " " << std::setw(8) <<
+                       (int64_t)(mn.lastPing.sigTime - mn.sigTime) << " " << std::setw(10) <<
+                       mn.GetLastPaidTime() << " " << std::setw(6) <<
+                       mn.GetLastPaidBlock() << " " <<
+                       mn.addr.ToString();
+            std::string strFull = streamFull.str();
+            if (!fMatch && strFull.find(strFilter) == std::string::npos) continue;
+            obj.push_back(Pair(strOutpoint, strFull));
+        } else if (strMode == "lastpaidblock") {
+            if (!fMatch) continue;
+            obj.push_back(Pair(strOutpoint, mn.GetLastPaidBlock()));
+        } else if (strMode == "lastpaidtime") {
+            if (!fMatch) continue;
+            obj.push_back(Pair(strOutpoint, mn.GetLastPaidTime()));
+        } else if (strMode == "lastseen") {
+            if (!fMatch) continue;
+            obj.push_back(Pair(strOutpoint, (int64_t) mn.lastPing.sigTime));
+        } else if (strMode == "payee") {
+            std::string strPayee = CBitcoinAddress(mn.pubKeyCollateralAddress.GetID()).ToString();
+            if (!fMatch && strPayee.find(strFilter) == std::string::npos) continue;
+            obj.push_back(Pair(strOutpoint, strPayee));
+        } else if (strMode == "protocol") {
+            if (!fMatch && strFilter != strprintf("%d", mn.nProtocolVersion)) continue;
+            obj.push_back(Pair(strOutpoint, (int64_t) mn.nProtocolVersion));
+        } else if (strMode == "status") {
+            std::string strStatus = mn.GetStatus();
+            if (!fMatch && strStatus.find(strFilter) == std::string::npos) continue;
+            obj.push_back(Pair(strOutpoint, strStatus));
+        } else if (strMode == "qualify") {
+            if (!fMatch) continue;
+            // the snapshot is shared, GetNotQualifyReason needs its own copy
+            CGhostnode mnCopy(mn);
+            char* reasonStr = mnodeman.GetNotQualifyReason(mnCopy, nHeight, true, nMnCount);
+            obj.push_back(Pair(strOutpoint, (reasonStr != NULL) ? reasonStr : "true"));
+            delete[] reasonStr;
+        }
+    }
+    return obj;
+}
+
 UniValue ghostnodelist(const JSONRPCRequest &req) {
     UniValue params = req.params;
     bool fHelp = req.fHelp;
@@ -504,88 +649,27 @@ UniValue ghostnodelist(const JSONRPCRequest &req) {
         mnodeman.UpdateLastPaid();
     }
 
-    UniValue obj(UniValue::VOBJ);
-    if (strMode == "rank") {
-        std::vector <std::pair<int, CGhostnode>> vGhostnodeRanks = mnodeman.GetGhostnodeRanks();
-        BOOST_FOREACH(PAIRTYPE(int, CGhostnode) & s, vGhostnodeRanks)
-        {
-            std::string strOutpoint = s.second.vin.prevout.ToStringShort();
-            if (strFilter != "" && strOutpoint.find(strFilter) == std::string::npos) continue;
-            obj.push_back(Pair(strOutpoint, s.first));
-        }
-    } else {
-        std::vector <CGhostnode> vGhostnodes = mnodeman.GetFullGhostnodeVector();
-        BOOST_FOREACH(CGhostnode & mn, vGhostnodes)
-        {
-            std::string strOutpoint = mn.vin.prevout.ToStringShort();
-            if (strMode == "activeseconds") {
-                if (strFilter != "" && strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.push_back(Pair(strOutpoint, (int64_t)(mn.lastPing.sigTime - mn.sigTime)));
-            } else if (strMode == "addr") {
-                std::string strAddress = mn.addr.ToString();
-                if (strFilter != "" && strAddress.find(strFilter) == std::string::npos &&
-                    strOutpoint.find(strFilter) == std::string::npos)
-                    continue;
-                obj.push_back(Pair(strOutpoint, strAddress));
-            } else if (strMode == "full") {
-                std::ostringstream streamFull;
-                streamFull << std::setw(18) <<
-                           mn.GetStatus() << " " <<
-                           mn.nProtocolVersion << " " <<
-                           CBitcoinAddress(mn.pubKeyCollateralAddress.GetID()).ToString() << " " <<
-                           (int64_t) mn.lastPing.sigTime << " " << std::setw(8) <<
-                           (int64_t)(mn.lastPing.sigTime - mn.sigTime) << " " << std::setw(10) <<
-                           mn.GetLastPaidTime() << " " << std::setw(6) <<
-                           mn.GetLastPaidBlock() << " " <<
-                           mn.addr.ToString();
-                std::string strFull = streamFull.str();
-                if (strFilter != "" && strFull.find(strFilter) == std::string::npos &&
-                    strOutpoint.find(strFilter) == std::string::npos)
-                    continue;
-                obj.push_back(Pair(strOutpoint, strFull));
-            } else if (strMode == "lastpaidblock") {
-                if (strFilter != "" && strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.push_back(Pair(strOutpoint, mn.GetLastPaidBlock()));
-            } else if (strMode == "lastpaidtime") {
-                if (strFilter != "" && strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.push_back(Pair(strOutpoint, mn.GetLastPaidTime()));
-            } else if (strMode == "lastseen") {
-                if (strFilter != "" && strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.push_back(Pair(strOutpoint, (int64_t) mn.lastPing.sigTime));
-            } else if (strMode == "payee") {
-                CBitcoinAddress address(mn.pubKeyCollateralAddress.GetID());
-                std::string strPayee = address.ToString();
-                if (strFilter != "" && strPayee.find(strFilter) == std::string::npos &&
-                    strOutpoint.find(strFilter) == std::string::npos)
-                    continue;
-                obj.push_back(Pair(strOutpoint, strPayee));
-            } else if (strMode == "protocol") {
-                if (strFilter != "" && strFilter != strprintf("%d", mn.nProtocolVersion) &&
-                    strOutpoint.find(strFilter) == std::string::npos)
-                    continue;
-                obj.push_back(Pair(strOutpoint, (int64_t) mn.nProtocolVersion));
-            } else if (strMode == "status") {
-                std::string strStatus = mn.GetStatus();
-                if (strFilter != "" && strStatus.find(strFilter) == std::string::npos &&
-                    strOutpoint.find(strFilter) == std::string::npos)
-                    continue;
-                obj.push_back(Pair(strOutpoint, strStatus));
-            } else if (strMode == "qualify") {
-                int nBlockHeight;
-                {
-                    LOCK(cs_main);
-                    CBlockIndex *pindex = chainActive.Tip();
-                    if (!pindex) return NullUniValue;
-
-                    nBlockHeight = pindex->nHeight;
-                }
-                int nMnCount = mnodeman.CountEnabled();
-                char* reasonStr = mnodeman.GetNotQualifyReason(mn, nBlockHeight, true, nMnCount);
-                std::string strOutpoint = mn.vin.prevout.ToStringShort();
-                if (strFilter != "" && strOutpoint.find(strFilter) == std::string::npos) continue;
-                obj.push_back(Pair(strOutpoint, (reasonStr != NULL) ? reasonStr : "true"));
-            }
-        }
+    // A reply made from the same list snapshot at the same height is the same
+    std::shared_ptr<const std::vector<CGhostnode> > pGhostnodes = mnodeman.GetFullGhostnodeVector();
+    int nHeight = GetChainSnapshot()->Height();
+    const std::pair<std::string, std::string> key(strMode, strFilter);
+    {
+        LOCK(cs_ghostnodeListReplies);
+        std::map<std::pair<std::string, std::string>, CGhostnodeListReply>::const_iterator it = mapGhostnodeListReplies.find(key);
+        if (it != mapGhostnodeListReplies.end() && it->second.pGhostnodes == pGhostnodes && it->second.nHeight == nHeight)
+            return it->second.result;
+    }
+
+    UniValue obj = ListGhostnodes(*pGhostnodes, nHeight, strMode, strFilter);
+
+    {
+        LOCK(cs_ghostnodeListReplies);
+        if (mapGhostnodeListReplies.size() >= MAX_GHOSTNODELIST_REPLIES && !mapGhostnodeListReplies.count(key))
+            mapGhostnodeListReplies.clear();
+        CGhostnodeListReply& reply = mapGhostnodeListReplies[key];
+        reply.pGhostnodes = pGhostnodes;
+        reply.nHeight = nHeight;
+        reply.result = obj;
     }
     return obj;
 }
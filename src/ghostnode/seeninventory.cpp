@@ -0,0 +1,49 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "seeninventory.h"
+
+#include "protocol.h"
+
+CGhostnodeSeenInventory ghostnodeSeenInventory;
+
+CGhostnodeSeenInventory::CGhostnodeSeenInventory() :
+    filterSporks(1000, 0.000001),
+    filterPings(120000, 0.000001),
+    filterPaymentVotes(120000, 0.000001),
+    filterVerifications(20000, 0.000001)
+{
+}
+
+CRollingBloomFilter* CGhostnodeSeenInventory::GetFilter(int nType)
+{
+    switch (nType) {
+        case MSG_SPORK:                     return &filterSporks;
+        case MSG_GHOSTNODE_PING:            return &filterPings;
+        case MSG_GHOSTNODE_PAYMENT_VOTE:    return &filterPaymentVotes;
+        case MSG_GHOSTNODE_VERIFY:          return &filterVerifications;
+        default:                            return nullptr;
+    }
+}
+
+void CGhostnodeSeenInventory::Add(int nType, const uint256& hash)
+{
+    LOCK(cs);
+    CRollingBloomFilter* pfilter = GetFilter(nType);
+    if (pfilter) pfilter->insert(hash);
+}
+
+bool CGhostnodeSeenInventory::Contains(int nType, const uint256& hash)
+{
+    LOCK(cs);
+    CRollingBloomFilter* pfilter = GetFilter(nType);
+    return pfilter && pfilter->contains(hash);
+}
+
+void CGhostnodeSeenInventory::Clear(int nType)
+{
+    LOCK(cs);
+    CRollingBloomFilter* pfilter = GetFilter(nType);
+    if (pfilter) pfilter->reset();
+}
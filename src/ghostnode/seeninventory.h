@@ -0,0 +1,44 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SEENINVENTORY_H
+#define SEENINVENTORY_H
+
+#include "bloom.h"
+#include "sync.h"
+#include "uint256.h"
+
+class CGhostnodeSeenInventory;
+extern CGhostnodeSeenInventory ghostnodeSeenInventory;
+
+// The hashes of the sporks, ghostnode pings, payment votes and verifications this node has seen,
+// by inventory type. Every peer announces the same messages, AlreadyHave answers all but the first
+// announcement from here instead of taking the lock of the manager that stores the message.
+//
+// Hashes are added when a manager stores a message and are not removed when it drops one. The
+// managers only drop messages that are too old to be relayed, so these are not asked for again.
+// Filters forget the oldest hashes and have a false positive rate of one in a million, like the
+// recent rejects filter of transactions.
+class CGhostnodeSeenInventory
+{
+private:
+    CCriticalSection cs;
+
+    CRollingBloomFilter filterSporks;
+    CRollingBloomFilter filterPings;
+    CRollingBloomFilter filterPaymentVotes;
+    CRollingBloomFilter filterVerifications;
+
+    CRollingBloomFilter* GetFilter(int nType);
+
+public:
+    CGhostnodeSeenInventory();
+
+    void Add(int nType, const uint256& hash);
+    // Whether a message of the tracked type nType with this hash was seen, never for other types
+    bool Contains(int nType, const uint256& hash);
+    void Clear(int nType);
+};
+
+#endif
@@ -5,6 +5,7 @@
 
 #include "darksend.h"
 #include "validation.h"
+#include "seeninventory.h"
 #include "spork.h"
 #include "netmessagemaker.h"
 #include <boost/lexical_cast.hpp>
@@ -16,6 +17,50 @@ CSporkManager sporkManager;
 
 std::map<uint256, CSporkMessage> mapSporks;
 
+// value of a spork nobody signed yet, -1 for ids without a default
+int64_t CSporkManager::GetSporkDefaultValue(int nSporkID)
+{
+    switch (nSporkID) {
+        case SPORK_2_INSTANTSEND_ENABLED:               return SPORK_2_INSTANTSEND_ENABLED_DEFAULT;
+        case SPORK_3_INSTANTSEND_BLOCK_FILTERING:       return SPORK_3_INSTANTSEND_BLOCK_FILTERING_DEFAULT;
+        case SPORK_5_INSTANTSEND_MAX_VALUE:             return SPORK_5_INSTANTSEND_MAX_VALUE_DEFAULT;
+        case SPORK_6_NEW_SIGS:                          return SPORK_6_NEW_SIGS_DEFAULT;
+        case SPORK_8_GHOSTNODE_PAYMENT_ENFORCEMENT:    return SPORK_8_GHOSTNODE_PAYMENT_ENFORCEMENT_DEFAULT;
+        case SPORK_9_SUPERBLOCKS_ENABLED:               return SPORK_9_SUPERBLOCKS_ENABLED_DEFAULT;
+        case SPORK_10_GHOSTNODE_PAY_UPDATED_NODES:     return SPORK_10_GHOSTNODE_PAY_UPDATED_NODES_DEFAULT;
+        case SPORK_12_RECONSIDER_BLOCKS:                return SPORK_12_RECONSIDER_BLOCKS_DEFAULT;
+        case SPORK_13_OLD_SUPERBLOCK_FLAG:              return SPORK_13_OLD_SUPERBLOCK_FLAG_DEFAULT;
+        case SPORK_14_REQUIRE_SENTINEL_FLAG:            return SPORK_14_REQUIRE_SENTINEL_FLAG_DEFAULT;
+        default:
+            //LogPrint("spork", "CSporkManager::GetSporkDefaultValue -- Unknown Spork ID %d\n", nSporkID);
+            return -1;
+    }
+}
+
+CSporkManager::CSporkManager()
+{
+    for (int i = 0; i < SPORK_COUNT; i++) {
+        int64_t nDefault = GetSporkDefaultValue(SPORK_START + i);
+        vSporkValues[i] = nDefault;
+        // unknown sporks are off by default, see IsSporkActive
+        vSporkActiveValues[i] = nDefault == -1 ? 4070908800ULL : nDefault;
+    }
+}
+
+void CSporkManager::SetSporkActive(const CSporkMessage& spork)
+{
+    AssertLockHeld(cs);
+
+    mapSporks[spork.GetHash()] = spork;
+    ghostnodeSeenInventory.Add(MSG_SPORK, spork.GetHash());
+    mapSporksActive[spork.nSporkID] = spork;
+
+    if (spork.nSporkID >= SPORK_START && spork.nSporkID <= SPORK_END) {
+        vSporkValues[spork.nSporkID - SPORK_START] = spork.nValue;
+        vSporkActiveValues[spork.nSporkID - SPORK_START] = spork.nValue;
+    }
+}
+
 void CSporkManager::ProcessSpork(CNode* pfrom, std::string& strCommand, CDataStream& vRecv)
 {
     if(fLiteMode) return; // disable all Dash specific functionality
@@ -32,19 +77,23 @@ void CSporkManager::ProcessSpork(CNode* pfrom, std::string& strCommand, CDataStr
         {
             LOCK(cs_main);
             pfrom->setAskFor.erase(hash);
+            pfrom->AddInventoryKnown(CInv(MSG_SPORK, hash));
             if(!chainActive.Tip()) return;
             strLogMsg = strprintf("SPORK -- hash: %s id: %d value: %10d bestHeight: %d peer=%d", hash.ToString(), spork.nSporkID, spork.nValue, chainActive.Height(), pfrom->GetId());
         }
 
-        if(mapSporksActive.count(spork.nSporkID)) {
-            if (mapSporksActive[spork.nSporkID].nTimeSigned >= spork.nTimeSigned) {
-                //LogPrint("spork", "%s seen\n", strLogMsg);
-                return;
+        {
+            LOCK(cs);
+            if(mapSporksActive.count(spork.nSporkID)) {
+                if (mapSporksActive[spork.nSporkID].nTimeSigned >= spork.nTimeSigned) {
+                    //LogPrint("spork", "%s seen\n", strLogMsg);
+                    return;
+                } else {
+                    //LogPrint("%s updated\n", strLogMsg);
+                }
             } else {
-                //LogPrint("%s updated\n", strLogMsg);
+                //LogPrint("%s new\n", strLogMsg);
             }
-        } else {
-            //LogPrint("%s new\n", strLogMsg);
         }
 
         if(!spork.CheckSignature()) {
@@ -53,8 +102,12 @@ void CSporkManager::ProcessSpork(CNode* pfrom, std::string& strCommand, CDataStr
             return;
         }
 
-        mapSporks[hash] = spork;
-        mapSporksActive[spork.nSporkID] = spork;
+        {
+            LOCK(cs);
+            // another peer may have sent a newer one while we were checking the signature
+            if(mapSporksActive.count(spork.nSporkID) && mapSporksActive[spork.nSporkID].nTimeSigned >= spork.nTimeSigned) return;
+            SetSporkActive(spork);
+        }
         spork.Relay();
 
         //does a task if needed
@@ -62,12 +115,19 @@ void CSporkManager::ProcessSpork(CNode* pfrom, std::string& strCommand, CDataStr
 
     } else if (strCommand == NetMsgType::GETSPORKS) {
 
-        std::map<int, CSporkMessage>::iterator it = mapSporksActive.begin();
+        std::vector<CSporkMessage> vecSporks;
+        {
+            LOCK(cs);
+            std::map<int, CSporkMessage>::iterator it = mapSporksActive.begin();
+            while(it != mapSporksActive.end()) {
+                vecSporks.push_back(it->second);
+                it++;
+            }
+        }
 
-        while(it != mapSporksActive.end()) {
-            const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
-            g_connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SPORK, it->second));
-            it++;
+        const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+        BOOST_FOREACH(const CSporkMessage& spork, vecSporks) {
+            g_connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SPORK, spork));
         }
     }
 
@@ -110,37 +170,40 @@ bool CSporkManager::UpdateSpork(int nSporkID, int64_t nValue)
 
     if(spork.Sign(strMasterPrivKey)) {
         spork.Relay();
-        mapSporks[spork.GetHash()] = spork;
-        mapSporksActive[nSporkID] = spork;
+        LOCK(cs);
+        SetSporkActive(spork);
         return true;
     }
 
     return false;
 }
 
+bool CSporkManager::HaveSpork(const uint256& hash)
+{
+    LOCK(cs);
+    return mapSporks.count(hash);
+}
+
+bool CSporkManager::GetSporkByHash(const uint256& hash, CSporkMessage& sporkRet)
+{
+    LOCK(cs);
+    std::map<uint256, CSporkMessage>::iterator it = mapSporks.find(hash);
+    if (it == mapSporks.end()) return false;
+    sporkRet = it->second;
+    return true;
+}
+
 // grab the spork, otherwise say it's off
 bool CSporkManager::IsSporkActive(int nSporkID)
 {
-    int64_t r = -1;
-
-    if(mapSporksActive.count(nSporkID)){
-        r = mapSporksActive[nSporkID].nValue;
-    } else {
-        switch (nSporkID) {
-            case SPORK_2_INSTANTSEND_ENABLED:               r = SPORK_2_INSTANTSEND_ENABLED_DEFAULT; break;
-            case SPORK_3_INSTANTSEND_BLOCK_FILTERING:       r = SPORK_3_INSTANTSEND_BLOCK_FILTERING_DEFAULT; break;
-            case SPORK_5_INSTANTSEND_MAX_VALUE:             r = SPORK_5_INSTANTSEND_MAX_VALUE_DEFAULT; break;
-            case SPORK_8_GHOSTNODE_PAYMENT_ENFORCEMENT:    r = SPORK_8_GHOSTNODE_PAYMENT_ENFORCEMENT_DEFAULT; break;
-            case SPORK_9_SUPERBLOCKS_ENABLED:               r = SPORK_9_SUPERBLOCKS_ENABLED_DEFAULT; break;
-            case SPORK_10_GHOSTNODE_PAY_UPDATED_NODES:     r = SPORK_10_GHOSTNODE_PAY_UPDATED_NODES_DEFAULT; break;
-            case SPORK_12_RECONSIDER_BLOCKS:                r = SPORK_12_RECONSIDER_BLOCKS_DEFAULT; break;
-            case SPORK_13_OLD_SUPERBLOCK_FLAG:              r = SPORK_13_OLD_SUPERBLOCK_FLAG_DEFAULT; break;
-            case SPORK_14_REQUIRE_SENTINEL_FLAG:            r = SPORK_14_REQUIRE_SENTINEL_FLAG_DEFAULT; break;
-            default:
-                //LogPrint("spork", "CSporkManager::IsSporkActive -- Unknown Spork ID %d\n", nSporkID);
-                r = 4070908800ULL; // 2099-1-1 i.e. off by default
-                break;
-        }
+    if (nSporkID >= SPORK_START && nSporkID <= SPORK_END)
+        return vSporkActiveValues[nSporkID - SPORK_START] < GetTime();
+
+    int64_t r = 4070908800ULL; // 2099-1-1 i.e. off by default
+    {
+        LOCK(cs);
+        if(mapSporksActive.count(nSporkID))
+            r = mapSporksActive[nSporkID].nValue;
     }
 
     return r < GetTime();
@@ -149,24 +212,14 @@ bool CSporkManager::IsSporkActive(int nSporkID)
 // grab the value of the spork on the network, or the default
 int64_t CSporkManager::GetSporkValue(int nSporkID)
 {
+    if (nSporkID >= SPORK_START && nSporkID <= SPORK_END)
+        return vSporkValues[nSporkID - SPORK_START];
+
+    LOCK(cs);
     if (mapSporksActive.count(nSporkID))
         return mapSporksActive[nSporkID].nValue;
 
-    switch (nSporkID) {
-        case SPORK_2_INSTANTSEND_ENABLED:               return SPORK_2_INSTANTSEND_ENABLED_DEFAULT;
-        case SPORK_3_INSTANTSEND_BLOCK_FILTERING:       return SPORK_3_INSTANTSEND_BLOCK_FILTERING_DEFAULT;
-        case SPORK_5_INSTANTSEND_MAX_VALUE:             return SPORK_5_INSTANTSEND_MAX_VALUE_DEFAULT;
-        case SPORK_8_GHOSTNODE_PAYMENT_ENFORCEMENT:    return SPORK_8_GHOSTNODE_PAYMENT_ENFORCEMENT_DEFAULT;
-        case SPORK_9_SUPERBLOCKS_ENABLED:               return SPORK_9_SUPERBLOCKS_ENABLED_DEFAULT;
-        case SPORK_10_GHOSTNODE_PAY_UPDATED_NODES:     return SPORK_10_GHOSTNODE_PAY_UPDATED_NODES_DEFAULT;
-        case SPORK_12_RECONSIDER_BLOCKS:                return SPORK_12_RECONSIDER_BLOCKS_DEFAULT;
-        case SPORK_13_OLD_SUPERBLOCK_FLAG:              return SPORK_13_OLD_SUPERBLOCK_FLAG_DEFAULT;
-        case SPORK_14_REQUIRE_SENTINEL_FLAG:            return SPORK_14_REQUIRE_SENTINEL_FLAG_DEFAULT;
-        default:
-            //LogPrint("spork", "CSporkManager::GetSporkValue -- Unknown Spork ID %d\n", nSporkID);
-            return -1;
-    }
-
+    return -1;
 }
 
 int CSporkManager::GetSporkIDByName(std::string strName)
@@ -174,6 +227,7 @@ int CSporkManager::GetSporkIDByName(std::string strName)
     if (strName == "SPORK_2_INSTANTSEND_ENABLED")               return SPORK_2_INSTANTSEND_ENABLED;
     if (strName == "SPORK_3_INSTANTSEND_BLOCK_FILTERING")       return SPORK_3_INSTANTSEND_BLOCK_FILTERING;
     if (strName == "SPORK_5_INSTANTSEND_MAX_VALUE")             return SPORK_5_INSTANTSEND_MAX_VALUE;
+    if (strName == "SPORK_6_NEW_SIGS")                          return SPORK_6_NEW_SIGS;
     if (strName == "SPORK_8_GHOSTNODE_PAYMENT_ENFORCEMENT")    return SPORK_8_GHOSTNODE_PAYMENT_ENFORCEMENT;
     if (strName == "SPORK_9_SUPERBLOCKS_ENABLED")               return SPORK_9_SUPERBLOCKS_ENABLED;
     if (strName == "SPORK_10_GHOSTNODE_PAY_UPDATED_NODES")     return SPORK_10_GHOSTNODE_PAY_UPDATED_NODES;
@@ -191,6 +245,7 @@ std::string CSporkManager::GetSporkNameByID(int nSporkID)
         case SPORK_2_INSTANTSEND_ENABLED:               return "SPORK_2_INSTANTSEND_ENABLED";
         case SPORK_3_INSTANTSEND_BLOCK_FILTERING:       return "SPORK_3_INSTANTSEND_BLOCK_FILTERING";
         case SPORK_5_INSTANTSEND_MAX_VALUE:             return "SPORK_5_INSTANTSEND_MAX_VALUE";
+        case SPORK_6_NEW_SIGS:                          return "SPORK_6_NEW_SIGS";
         case SPORK_8_GHOSTNODE_PAYMENT_ENFORCEMENT:    return "SPORK_8_GHOSTNODE_PAYMENT_ENFORCEMENT";
         case SPORK_9_SUPERBLOCKS_ENABLED:               return "SPORK_9_SUPERBLOCKS_ENABLED";
         case SPORK_10_GHOSTNODE_PAY_UPDATED_NODES:     return "SPORK_10_GHOSTNODE_PAY_UPDATED_NODES";
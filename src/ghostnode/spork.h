@@ -9,9 +9,12 @@
 #include "hash.h"
 #include "net.h"
 #include "net_processing.h"
+#include "sync.h"
 #include "utilstrencodings.h"
 #include "util.h"
 
+#include <atomic>
+
 class CSporkMessage;
 
 /*
@@ -24,6 +27,7 @@ static const int SPORK_END                                              = 10013;
 static const int SPORK_2_INSTANTSEND_ENABLED                            = 10001;
 static const int SPORK_3_INSTANTSEND_BLOCK_FILTERING                    = 10002;
 static const int SPORK_5_INSTANTSEND_MAX_VALUE                          = 10004;
+static const int SPORK_6_NEW_SIGS                                       = 10005;
 static const int SPORK_8_GHOSTNODE_PAYMENT_ENFORCEMENT                 = 10007;
 static const int SPORK_9_SUPERBLOCKS_ENABLED                            = 10008;
 static const int SPORK_10_GHOSTNODE_PAY_UPDATED_NODES                  = 10009;
@@ -34,6 +38,7 @@ static const int SPORK_14_REQUIRE_SENTINEL_FLAG                         = 10013;
 static const int64_t SPORK_2_INSTANTSEND_ENABLED_DEFAULT                = 0;            // ON
 static const int64_t SPORK_3_INSTANTSEND_BLOCK_FILTERING_DEFAULT        = 0;            // ON
 static const int64_t SPORK_5_INSTANTSEND_MAX_VALUE_DEFAULT              = 40000;         // 40000 NIX
+static const int64_t SPORK_6_NEW_SIGS_DEFAULT                           = 4070908800ULL;// OFF
 static const int64_t SPORK_8_GHOSTNODE_PAYMENT_ENFORCEMENT_DEFAULT     = 4070908800ULL;// OFF
 static const int64_t SPORK_9_SUPERBLOCKS_ENABLED_DEFAULT                = 4070908800ULL;// OFF
 static const int64_t SPORK_10_GHOSTNODE_PAY_UPDATED_NODES_DEFAULT      = 4070908800ULL;// OFF
@@ -99,18 +104,35 @@ public:
 class CSporkManager
 {
 private:
+    static const int SPORK_COUNT = SPORK_END - SPORK_START + 1;
+
+    // protects mapSporksActive and mapSporks
+    CCriticalSection cs;
+
     std::vector<unsigned char> vchSig;
     std::string strMasterPrivKey;
     std::map<int, CSporkMessage> mapSporksActive;
 
+    // current value of every spork between SPORK_START and SPORK_END, as returned by
+    // GetSporkValue and compared by IsSporkActive (unknown ids differ in their defaults),
+    // written under cs and read without any lock
+    std::atomic<int64_t> vSporkValues[SPORK_COUNT];
+    std::atomic<int64_t> vSporkActiveValues[SPORK_COUNT];
+
+    static int64_t GetSporkDefaultValue(int nSporkID);
+    void SetSporkActive(const CSporkMessage& spork);
+
 public:
 
-    CSporkManager() {}
+    CSporkManager();
 
     void ProcessSpork(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
     void ExecuteSpork(int nSporkID, int nValue);
     bool UpdateSpork(int nSporkID, int64_t nValue);
 
+    bool HaveSpork(const uint256& hash);
+    bool GetSporkByHash(const uint256& hash, CSporkMessage& sporkRet);
+
     bool IsSporkActive(int nSporkID);
     int64_t GetSporkValue(int nSporkID);
     int GetSporkIDByName(std::string strName);
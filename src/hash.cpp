@@ -88,6 +88,27 @@ void BIP32Hash(const unsigned char chainCode[32], unsigned int nChild, unsigned
     CHMAC_SHA512(chainCode, 32).Write(&header, 1).Write(data, 32).Write(num, 4).Finalize(output);
 }
 
+void BIP32HashMulti(const unsigned char chainCode[32], unsigned int nChild, size_t n, unsigned char header, const unsigned char data[32], unsigned char* output)
+{
+    // The children only differ in the last four bytes, one HMAC key for all of them
+    std::vector<unsigned char> vData(37 * n);
+    for (size_t i = 0; i < n; i++) {
+        unsigned char* p = &vData[37 * i];
+        p[0] = header;
+        memcpy(p + 1, data, 32);
+        WriteBE32(p + 33, nChild + i);
+    }
+    CHMAC_SHA512(chainCode, 32).FinalizeMulti(vData.data(), 37, n, output);
+}
+
+void Hash160Multi(const unsigned char* input, size_t len, size_t n, unsigned char* output)
+{
+    std::vector<unsigned char> vSha(32 * n);
+    for (size_t i = 0; i < n; i++)
+        CSHA256().Write(input + i * len, len).Finalize(&vSha[32 * i]);
+    RIPEMD160_32(output, vSha.data(), n);
+}
+
 #define ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
 
 #define SIPROUND do { \
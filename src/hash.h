@@ -124,6 +124,9 @@ inline uint160 Hash160(const prevector<N, unsigned char>& vch)
     return Hash160(vch.begin(), vch.end());
 }
 
+/** Compute the 160-bit hashes of n objects of len bytes each, laid out one after the other. output receives n * 20 bytes */
+void Hash160Multi(const unsigned char* input, size_t len, size_t n, unsigned char* output);
+
 /** A writer stream (for serialization) that computes a 256-bit hash. */
 class CHashWriter
 {
@@ -212,6 +215,8 @@ unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char
 
 void BIP32Hash(const ChainCode &chainCode, unsigned int nChild, unsigned char header, const unsigned char data[32], unsigned char output[64]);
 void BIP32Hash(const unsigned char chainCode[32], unsigned int nChild, unsigned char header, const unsigned char data[32], unsigned char output[64]);
+/** BIP32Hash of the n children from nChild on, computed together. output receives n * 64 bytes */
+void BIP32HashMulti(const unsigned char chainCode[32], unsigned int nChild, size_t n, unsigned char header, const unsigned char data[32], unsigned char* output);
 /** SipHash-2-4 */
 class CSipHasher
 {
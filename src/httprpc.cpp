@@ -7,6 +7,7 @@
 #include <base58.h>
 #include <chainparams.h>
 #include <httpserver.h>
+#include <metrics.h>
 #include <rpc/protocol.h>
 #include <rpc/server.h>
 #include <random.h>
@@ -17,11 +18,36 @@
 #include <crypto/hmac_sha256.h>
 #include <stdio.h>
 
+#include <set>
+
 #include <boost/algorithm/string.hpp> // boost::trim
 
 /** WWW-Authenticate to present with 401 Unauthorized response */
 static const char* WWW_AUTH_HEADER_DATA = "Basic realm=\"jsonrpc\"";
 
+/** Methods whose replies can run to megabytes, these are written to the client as they are serialized */
+static const std::set<std::string> setStreamedMethods = {
+    "getblock", "getrawmempool", "ghostnodelist", "getaddressdeltas", "listtransactions",
+};
+
+/** Start of a JSON-RPC request body looked at for its method, to queue it by */
+static const size_t JSONRPC_WORK_KEY_PEEK_SIZE = 256;
+
+/** RPC categories queued ahead of the rest, these are latency sensitive */
+static const std::set<std::string> setHighPriorityCategories = {
+    "wallet", "mining", "generating",
+};
+
+/** Methods and categories that can keep a worker busy for long, these are queued behind the rest */
+static const std::set<std::string> setBulkCategories = {
+    "addressindex",
+};
+static const std::set<std::string> setBulkMethods = {
+    "getaddressdeltas", "getaddresstxids", "getaddressutxos", "getaddressbalance", "getaddressmempool",
+    "rescanblockchain", "importprivkey", "importaddress", "importpubkey", "importmulti", "importwallet",
+    "dumpwallet", "gettxoutsetinfo", "verifychain", "getchaintxstats",
+};
+
 /** Simple one-shot callback timer to be used by the RPC mechanism to e.g.
  * re-lock the wallet.
  */
@@ -187,6 +213,15 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 
             UniValue result = tableRPC.execute(jreq);
 
+            if (setStreamedMethods.count(jreq.strMethod)) {
+                req->WriteHeader("Content-Type", "application/json");
+                req->StartReplyChunked(HTTP_OK);
+                CJSONStreamWriter writer([req](std::string&& chunk) { req->WriteReplyChunk(std::move(chunk)); });
+                JSONRPCReplyStream(writer, result, NullUniValue, jreq.id);
+                req->EndReplyChunked();
+                return true;
+            }
+
             // Send reply
             strReply = JSONRPCReply(result, NullUniValue, jreq.id);
 
@@ -226,16 +261,56 @@ static bool InitRPCAuthentication()
     return true;
 }
 
+/** Method of a single JSON-RPC request, read from the start of its body. Batches, and
+ * requests the method isn't found in the start of, are queued by the path.
+ */
+static std::string JSONRPCWorkKey(HTTPRequest* req, const std::string &)
+{
+    std::string strBody = req->PeekBody(JSONRPC_WORK_KEY_PEEK_SIZE);
+    size_t pos = strBody.find_first_not_of(" \t\r\n");
+    if (pos == std::string::npos || strBody[pos] != '{')
+        return "";
+    pos = strBody.find("\"method\"");
+    if (pos == std::string::npos)
+        return "";
+    pos = strBody.find_first_not_of(" \t\r\n", pos + 8);
+    if (pos == std::string::npos || strBody[pos] != ':')
+        return "";
+    pos = strBody.find_first_not_of(" \t\r\n", pos + 1);
+    if (pos == std::string::npos || strBody[pos] != '"')
+        return "";
+    size_t end = strBody.find_first_of("\"\\", pos + 1);
+    if (end == std::string::npos || strBody[end] != '"')
+        return "";
+    return strBody.substr(pos + 1, end - pos - 1);
+}
+
+/** Queue the RPC methods by their category, -rpcpriority overrides these */
+static void SetRPCWorkPriorities()
+{
+    for (const std::string& strMethod : tableRPC.listCommands()) {
+        const CRPCCommand* pcmd = tableRPC[strMethod];
+        if (!pcmd)
+            continue;
+        if (setBulkMethods.count(strMethod) || setBulkCategories.count(pcmd->category))
+            SetHTTPWorkPriority(strMethod, HTTPWorkPriority::BULK);
+        else if (setHighPriorityCategories.count(pcmd->category))
+            SetHTTPWorkPriority(strMethod, HTTPWorkPriority::HIGH);
+    }
+    SetHTTPWorkPriority("sendrawtransaction", HTTPWorkPriority::HIGH);
+}
+
 bool StartHTTPRPC()
 {
     LogPrint(BCLog::RPC, "Starting HTTP RPC server\n");
     if (!InitRPCAuthentication())
         return false;
 
-    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC);
+    SetRPCWorkPriorities();
+    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC, JSONRPCWorkKey);
 #ifdef ENABLE_WALLET
     // ifdef can be removed once we switch to better endpoint support and API versioning
-    RegisterHTTPHandler("/wallet/", false, HTTPReq_JSONRPC);
+    RegisterHTTPHandler("/wallet/", false, HTTPReq_JSONRPC, JSONRPCWorkKey);
 #endif
     assert(EventBase());
     httpRPCTimerInterface = MakeUnique<HTTPRPCTimerInterface>(EventBase());
@@ -257,3 +332,28 @@ void StopHTTPRPC()
         httpRPCTimerInterface.reset();
     }
 }
+
+static bool HTTPReq_Metrics(HTTPRequest* req, const std::string&)
+{
+    if (req->GetRequestMethod() != HTTPRequest::GET) {
+        req->WriteReply(HTTP_BAD_METHOD, "The metrics endpoint handles only GET requests");
+        return false;
+    }
+    req->WriteHeader("Content-Type", "text/plain; version=0.0.4");
+    req->WriteReply(HTTP_OK, FormatMetrics());
+    return true;
+}
+
+bool StartHTTPMetrics()
+{
+    LogPrint(BCLog::RPC, "Starting HTTP metrics endpoint\n");
+    // A scrape only reads atomics, it need not wait behind RPC calls
+    SetHTTPWorkPriority("/metrics", HTTPWorkPriority::HIGH);
+    RegisterHTTPHandler("/metrics", true, HTTPReq_Metrics);
+    return true;
+}
+
+void StopHTTPMetrics()
+{
+    UnregisterHTTPHandler("/metrics", true);
+}
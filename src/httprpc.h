@@ -32,4 +32,12 @@ void InterruptREST();
  */
 void StopREST();
 
+/** Start the /metrics endpoint, serving the counters of metrics.h to Prometheus.
+ * Precondition; HTTP has been started.
+ */
+bool StartHTTPMetrics();
+/** Stop the /metrics endpoint.
+ */
+void StopHTTPMetrics();
+
 #endif
@@ -20,7 +20,10 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <signal.h>
+#include <deque>
 #include <future>
+#include <map>
+#include <mutex>
 
 #include <event2/thread.h>
 #include <event2/buffer.h>
@@ -44,8 +47,8 @@ static const size_t MAX_HEADERS_SIZE = 8192;
 class HTTPWorkItem final : public HTTPClosure
 {
 public:
-    HTTPWorkItem(std::unique_ptr<HTTPRequest> _req, const std::string &_path, const HTTPRequestHandler& _func):
-        req(std::move(_req)), path(_path), func(_func)
+    HTTPWorkItem(std::unique_ptr<HTTPRequest> _req, const std::string &_path, const HTTPRequestHandler& _func, const std::string &_key):
+        req(std::move(_req)), key(_key), priority(HTTPWorkPriority::NORMAL), nMaxRunning(0), nTimeQueued(GetTimeMicros()), path(_path), func(_func)
     {
     }
     void operator()() override
@@ -54,44 +57,81 @@ public:
     }
 
     std::unique_ptr<HTTPRequest> req;
+    //! What the request is, the RPC method or the path prefix, for its queue and limit
+    std::string key;
+    HTTPWorkPriority priority;
+    //! Requests with the key running at once at most, 0 for no limit
+    size_t nMaxRunning;
+    int64_t nTimeQueued;
 
 private:
     std::string path;
     HTTPRequestHandler func;
 };
 
-/** Simple work queue for distributing work over multiple threads.
- * Work items are simply callable objects.
+/** Work queues for distributing requests over the worker threads, by priority.
+ * A worker takes the oldest request of the highest priority queue that is
+ * below its limit of requests running at once, and whose key is below its own.
  */
-template <typename WorkItem>
-class WorkQueue
+class HTTPWorkQueue
 {
 private:
+    static const size_t QUEUE_COUNT = (size_t)HTTPWorkPriority::COUNT;
+
     /** Mutex protects entire object */
     std::mutex cs;
     std::condition_variable cond;
-    std::deque<std::unique_ptr<WorkItem>> queue;
+    std::deque<std::unique_ptr<HTTPWorkItem>> queues[QUEUE_COUNT];
+    HTTPWorkQueueStats stats[QUEUE_COUNT];
+    //! Running requests per key with a limit
+    std::map<std::string, size_t> mapRunning;
     bool running;
     size_t maxDepth;
 
+    /** Take the next request a worker may start, or nullptr */
+    std::unique_ptr<HTTPWorkItem> Take()
+    {
+        for (size_t i = 0; i < QUEUE_COUNT; i++) {
+            if (stats[i].nMaxRunning && stats[i].nRunning >= stats[i].nMaxRunning)
+                continue;
+            for (auto it = queues[i].begin(); it != queues[i].end(); ++it) {
+                const HTTPWorkItem& item = **it;
+                if (item.nMaxRunning) {
+                    auto mi = mapRunning.find(item.key);
+                    if (mi != mapRunning.end() && mi->second >= item.nMaxRunning)
+                        continue;
+                }
+                std::unique_ptr<HTTPWorkItem> ret = std::move(*it);
+                queues[i].erase(it);
+                return ret;
+            }
+        }
+        return nullptr;
+    }
+
 public:
-    explicit WorkQueue(size_t _maxDepth) : running(true),
+    HTTPWorkQueue(size_t _maxDepth, size_t maxBulkRunning) : running(true),
                                  maxDepth(_maxDepth)
     {
+        for (size_t i = 0; i < QUEUE_COUNT; i++)
+            stats[i].priority = (HTTPWorkPriority)i;
+        stats[(size_t)HTTPWorkPriority::BULK].nMaxRunning = maxBulkRunning;
     }
     /** Precondition: worker threads have all stopped (they have been joined).
      */
-    ~WorkQueue()
+    ~HTTPWorkQueue()
     {
     }
-    /** Enqueue a work item */
-    bool Enqueue(WorkItem* item)
+    /** Enqueue a work item, each queue holds up to maxDepth of them */
+    bool Enqueue(HTTPWorkItem* item)
     {
         std::unique_lock<std::mutex> lock(cs);
-        if (queue.size() >= maxDepth) {
+        size_t i = (size_t)item->priority;
+        if (queues[i].size() >= maxDepth) {
+            stats[i].nRejected++;
             return false;
         }
-        queue.emplace_back(std::unique_ptr<WorkItem>(item));
+        queues[i].emplace_back(std::unique_ptr<HTTPWorkItem>(item));
         cond.notify_one();
         return true;
     }
@@ -99,17 +139,34 @@ public:
     void Run()
     {
         while (true) {
-            std::unique_ptr<WorkItem> i;
+            std::unique_ptr<HTTPWorkItem> i;
             {
                 std::unique_lock<std::mutex> lock(cs);
-                while (running && queue.empty())
+                while (running && !(i = Take()))
                     cond.wait(lock);
                 if (!running)
                     break;
-                i = std::move(queue.front());
-                queue.pop_front();
+                stats[(size_t)i->priority].nRunning++;
+                if (i->nMaxRunning)
+                    mapRunning[i->key]++;
             }
+            int64_t nQueueMicros = GetTimeMicros() - i->nTimeQueued;
+            std::string key = i->key;
+            HTTPWorkPriority priority = i->priority;
+            bool fLimited = i->nMaxRunning != 0;
             (*i)();
+            i.reset();
+            {
+                // This worker looks for more work itself, no need to wake another
+                std::unique_lock<std::mutex> lock(cs);
+                HTTPWorkQueueStats& s = stats[(size_t)priority];
+                s.nRunning--;
+                s.nCompleted++;
+                s.nTotalQueueMicros += nQueueMicros;
+                s.nMaxQueueMicros = std::max(s.nMaxQueueMicros, nQueueMicros);
+                if (fLimited && --mapRunning[key] == 0)
+                    mapRunning.erase(key);
+            }
         }
     }
     /** Interrupt and exit loops */
@@ -119,18 +176,37 @@ public:
         running = false;
         cond.notify_all();
     }
+    std::vector<HTTPWorkQueueStats> GetStats()
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        std::vector<HTTPWorkQueueStats> ret(stats, stats + QUEUE_COUNT);
+        for (size_t i = 0; i < QUEUE_COUNT; i++)
+            ret[i].nQueued = queues[i].size();
+        return ret;
+    }
+};
+
+/** Queue and concurrency limit of the requests with a work key */
+struct HTTPWorkClass
+{
+    HTTPWorkPriority priority = HTTPWorkPriority::NORMAL;
+    //! Requests with the key running at once at most, 0 for no limit
+    size_t nMaxRunning = 0;
+    //! Priority set with -rpcpriority, which SetHTTPWorkPriority leaves
+    bool fConfigured = false;
 };
 
 struct HTTPPathHandler
 {
     HTTPPathHandler() {}
-    HTTPPathHandler(std::string _prefix, bool _exactMatch, HTTPRequestHandler _handler):
-        prefix(_prefix), exactMatch(_exactMatch), handler(_handler)
+    HTTPPathHandler(std::string _prefix, bool _exactMatch, HTTPRequestHandler _handler, HTTPWorkKeyFunction _workKey):
+        prefix(_prefix), exactMatch(_exactMatch), handler(_handler), workKey(_workKey)
     {
     }
     std::string prefix;
     bool exactMatch;
     HTTPRequestHandler handler;
+    HTTPWorkKeyFunction workKey;
 };
 
 /** HTTP module state */
@@ -142,7 +218,10 @@ struct evhttp* eventHTTP = nullptr;
 //! List of subnets to allow RPC connections from
 static std::vector<CSubNet> rpc_allow_subnets;
 //! Work queue for handling longer requests off the event loop thread
-static WorkQueue<HTTPClosure>* workQueue = nullptr;
+static HTTPWorkQueue* workQueue = nullptr;
+//! Work classes by work key
+static std::mutex cs_workClasses;
+static std::map<std::string, HTTPWorkClass> mapWorkClasses;
 //! Handlers for (sub)paths
 std::vector<HTTPPathHandler> pathHandlers;
 //! Bound listening sockets
@@ -257,12 +336,25 @@ static void http_request_cb(struct evhttp_request* req, void* arg)
 
     // Dispatch to worker thread
     if (i != iend) {
-        std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(std::move(hreq), path, i->handler));
+        std::string key;
+        if (i->workKey)
+            key = i->workKey(hreq.get(), path);
+        if (key.empty())
+            key = i->prefix;
+        std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(std::move(hreq), path, i->handler, key));
+        {
+            std::lock_guard<std::mutex> lock(cs_workClasses);
+            auto mi = mapWorkClasses.find(key);
+            if (mi != mapWorkClasses.end()) {
+                item->priority = mi->second.priority;
+                item->nMaxRunning = mi->second.nMaxRunning;
+            }
+        }
         assert(workQueue);
         if (workQueue->Enqueue(item.get()))
             item.release(); /* if true, queue took ownership */
         else {
-            LogPrintf("WARNING: request rejected because http work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n");
+            LogPrintf("WARNING: %s request rejected because http work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n", HTTPWorkPriorityName(item->priority));
             item->req->WriteReply(HTTP_INTERNAL, "Work queue depth exceeded");
         }
     } else {
@@ -327,12 +419,44 @@ static bool HTTPBindAddresses(struct evhttp* http)
 }
 
 /** Simple wrapper to set thread name and run work queue */
-static void HTTPWorkQueueRun(WorkQueue<HTTPClosure>* queue)
+static void HTTPWorkQueueRun(HTTPWorkQueue* queue)
 {
     RenameThread("bitcoin-httpworker");
     queue->Run();
 }
 
+/** Read the work classes set with -rpcpriority and -rpcmethodlimit */
+static bool InitHTTPWorkClasses()
+{
+    std::lock_guard<std::mutex> lock(cs_workClasses);
+    mapWorkClasses.clear();
+    for (const std::string& strArg : gArgs.GetArgs("-rpcpriority")) {
+        size_t pos = strArg.rfind(':');
+        HTTPWorkPriority priority;
+        if (pos == std::string::npos || pos == 0 || !ParseHTTPWorkPriority(strArg.substr(pos + 1), priority)) {
+            uiInterface.ThreadSafeMessageBox(
+                strprintf("Invalid -rpcpriority=%s, expected <method>:<high|normal|bulk>", strArg),
+                "", CClientUIInterface::MSG_ERROR);
+            return false;
+        }
+        HTTPWorkClass& workClass = mapWorkClasses[strArg.substr(0, pos)];
+        workClass.priority = priority;
+        workClass.fConfigured = true;
+    }
+    for (const std::string& strArg : gArgs.GetArgs("-rpcmethodlimit")) {
+        size_t pos = strArg.rfind(':');
+        int32_t nLimit;
+        if (pos == std::string::npos || pos == 0 || !ParseInt32(strArg.substr(pos + 1), &nLimit) || nLimit < 0) {
+            uiInterface.ThreadSafeMessageBox(
+                strprintf("Invalid -rpcmethodlimit=%s, expected <method>:<n>", strArg),
+                "", CClientUIInterface::MSG_ERROR);
+            return false;
+        }
+        mapWorkClasses[strArg.substr(0, pos)].nMaxRunning = nLimit;
+    }
+    return true;
+}
+
 /** libevent event log callback */
 static void libevent_log_cb(int severity, const char *msg)
 {
@@ -393,11 +517,18 @@ bool InitHTTPServer()
         return false;
     }
 
+    if (!InitHTTPWorkClasses())
+        return false;
+
     LogPrint(BCLog::HTTP, "Initialized HTTP server\n");
     int workQueueDepth = std::max((long)gArgs.GetArg("-rpcworkqueue", DEFAULT_HTTP_WORKQUEUE), 1L);
-    LogPrintf("HTTP: creating work queue of depth %d\n", workQueueDepth);
+    int rpcThreads = std::max((long)gArgs.GetArg("-rpcthreads", DEFAULT_HTTP_THREADS), 1L);
+    int bulkThreads = gArgs.GetArg("-rpcbulkthreads", DEFAULT_HTTP_BULK_THREADS);
+    if (bulkThreads <= 0)
+        bulkThreads = std::max(rpcThreads / 2, 1);
+    LogPrintf("HTTP: creating work queues of depth %d, running up to %d bulk requests at once\n", workQueueDepth, bulkThreads);
 
-    workQueue = new WorkQueue<HTTPClosure>(workQueueDepth);
+    workQueue = new HTTPWorkQueue(workQueueDepth, bulkThreads);
     // transfer ownership to eventBase/HTTP via .release()
     eventBase = base_ctr.release();
     eventHTTP = http_ctr.release();
@@ -523,11 +654,17 @@ void HTTPEvent::trigger(struct timeval* tv)
         evtimer_add(ev, tv); // trigger after timeval passed
 }
 HTTPRequest::HTTPRequest(struct evhttp_request* _req) : req(_req),
-                                                       replySent(false)
+                                                       replySent(false),
+                                                       replyStarted(false)
 {
 }
 HTTPRequest::~HTTPRequest()
 {
+    if (replyStarted && !replySent) {
+        // The body is cut short, but the request must still be given back
+        LogPrintf("%s: Unfinished chunked reply\n", __func__);
+        EndReplyChunked();
+    }
     if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
@@ -567,6 +704,17 @@ std::string HTTPRequest::ReadBody()
     return rv;
 }
 
+std::string HTTPRequest::PeekBody(size_t nMaxSize)
+{
+    struct evbuffer* buf = evhttp_request_get_input_buffer(req);
+    if (!buf)
+        return "";
+    std::string rv(std::min(nMaxSize, evbuffer_get_length(buf)), '\0');
+    ev_ssize_t nCopied = evbuffer_copyout(buf, &rv[0], rv.size());
+    rv.resize(nCopied > 0 ? nCopied : 0);
+    return rv;
+}
+
 void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
 {
     struct evkeyvalq* headers = evhttp_request_get_output_headers(req);
@@ -574,6 +722,22 @@ void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
     evhttp_add_header(headers, hdr.c_str(), value.c_str());
 }
 
+/** Re-enable reading from the socket once a reply was sent. This is the
+ * second part of the libevent workaround above.
+ */
+static void EnableHTTPReading(struct evhttp_request* req)
+{
+    if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
+        evhttp_connection* conn = evhttp_request_get_connection(req);
+        if (conn) {
+            bufferevent* bev = evhttp_connection_get_bufferevent(conn);
+            if (bev) {
+                bufferevent_enable(bev, EV_READ | EV_WRITE);
+            }
+        }
+    }
+}
+
 /** Closure sent to main thread to request a reply to be sent to
  * a HTTP request.
  * Replies must be sent in the main loop in the main http thread,
@@ -589,17 +753,57 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     auto req_copy = req;
     HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, nStatus]{
         evhttp_send_reply(req_copy, nStatus, nullptr, nullptr);
-        // Re-enable reading from the socket. This is the second part of the libevent
-        // workaround above.
-        if (event_get_version_number() >= 0x02010600 && event_get_version_number() < 0x02020001) {
-            evhttp_connection* conn = evhttp_request_get_connection(req_copy);
-            if (conn) {
-                bufferevent* bev = evhttp_connection_get_bufferevent(conn);
-                if (bev) {
-                    bufferevent_enable(bev, EV_READ | EV_WRITE);
-                }
-            }
-        }
+        EnableHTTPReading(req_copy);
+    });
+    ev->trigger(nullptr);
+    replySent = true;
+    req = nullptr; // transferred back to main thread
+}
+
+/** The pieces of a chunked reply are sent from the main http thread too,
+ * in the order they were written as the events are handled in the order
+ * they were triggered.
+ */
+void HTTPRequest::StartReplyChunked(int nStatus)
+{
+    assert(!replySent && !replyStarted && req);
+    auto req_copy = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, nStatus]{
+        evhttp_send_reply_start(req_copy, nStatus, nullptr);
+    });
+    ev->trigger(nullptr);
+    replyStarted = true;
+}
+
+static void FreeReplyChunk(const void*, size_t, void* chunk)
+{
+    delete static_cast<std::string*>(chunk);
+}
+
+void HTTPRequest::WriteReplyChunk(std::string&& strChunk)
+{
+    assert(replyStarted && !replySent && req);
+    if (strChunk.empty())
+        return;
+    auto req_copy = req;
+    // Handed to libevent by reference, it's freed once written to the socket
+    std::string* chunk = new std::string(std::move(strChunk));
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, chunk]{
+        struct evbuffer* evb = evbuffer_new();
+        evbuffer_add_reference(evb, chunk->data(), chunk->size(), FreeReplyChunk, chunk);
+        evhttp_send_reply_chunk(req_copy, evb);
+        evbuffer_free(evb);
+    });
+    ev->trigger(nullptr);
+}
+
+void HTTPRequest::EndReplyChunked()
+{
+    assert(replyStarted && !replySent && req);
+    auto req_copy = req;
+    HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy]{
+        evhttp_send_reply_end(req_copy);
+        EnableHTTPReading(req_copy);
     });
     ev->trigger(nullptr);
     replySent = true;
@@ -646,10 +850,10 @@ HTTPRequest::RequestMethod HTTPRequest::GetRequestMethod()
     }
 }
 
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler)
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler, const HTTPWorkKeyFunction &workKey)
 {
     LogPrint(BCLog::HTTP, "Registering HTTP handler for %s (exactmatch %d)\n", prefix, exactMatch);
-    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler));
+    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler, workKey));
 }
 
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch)
@@ -666,6 +870,48 @@ void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch)
     }
 }
 
+bool ParseHTTPWorkPriority(const std::string& str, HTTPWorkPriority& priority)
+{
+    if (str == "high")
+        priority = HTTPWorkPriority::HIGH;
+    else if (str == "normal")
+        priority = HTTPWorkPriority::NORMAL;
+    else if (str == "bulk")
+        priority = HTTPWorkPriority::BULK;
+    else
+        return false;
+    return true;
+}
+
+std::string HTTPWorkPriorityName(HTTPWorkPriority priority)
+{
+    switch (priority) {
+    case HTTPWorkPriority::HIGH:
+        return "high";
+    case HTTPWorkPriority::NORMAL:
+        return "normal";
+    case HTTPWorkPriority::BULK:
+        return "bulk";
+    default:
+        return "unknown";
+    }
+}
+
+void SetHTTPWorkPriority(const std::string& key, HTTPWorkPriority priority)
+{
+    std::lock_guard<std::mutex> lock(cs_workClasses);
+    HTTPWorkClass& workClass = mapWorkClasses[key];
+    if (!workClass.fConfigured)
+        workClass.priority = priority;
+}
+
+std::vector<HTTPWorkQueueStats> GetHTTPWorkQueueStats()
+{
+    if (!workQueue)
+        return std::vector<HTTPWorkQueueStats>();
+    return workQueue->GetStats();
+}
+
 std::string urlDecode(const std::string &urlEncoded) {
     std::string res;
     if (!urlEncoded.empty()) {
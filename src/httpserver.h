@@ -8,10 +8,13 @@
 #include <string>
 #include <stdint.h>
 #include <functional>
+#include <vector>
 
 static const int DEFAULT_HTTP_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
+//! Bulk requests running at once, 0 for half of -rpcthreads
+static const int DEFAULT_HTTP_BULK_THREADS=0;
 
 struct evhttp_request;
 struct event_base;
@@ -38,14 +41,51 @@ bool UpdateHTTPServerLogging(bool enable);
 
 /** Handler for requests to a certain HTTP path */
 typedef std::function<bool(HTTPRequest* req, const std::string &)> HTTPRequestHandler;
+/** Name of the work a request is, like its RPC method, for picking its work queue and limit */
+typedef std::function<std::string(HTTPRequest* req, const std::string &)> HTTPWorkKeyFunction;
 /** Register handler for prefix.
  * If multiple handlers match a prefix, the first-registered one will
- * be invoked.
+ * be invoked. The requests are queued by the key workKey returns for them,
+ * or by the prefix without it.
  */
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler);
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler, const HTTPWorkKeyFunction &workKey = nullptr);
 /** Unregister handler for prefix */
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
 
+/** Work queues, a worker takes from the first one with work it may start */
+enum class HTTPWorkPriority {
+    HIGH,
+    NORMAL,
+    BULK,
+    COUNT
+};
+
+/** Parse high, normal or bulk */
+bool ParseHTTPWorkPriority(const std::string& str, HTTPWorkPriority& priority);
+std::string HTTPWorkPriorityName(HTTPWorkPriority priority);
+
+/** Queue the work with this key at priority, unless -rpcpriority set it.
+ * Work without a priority is NORMAL.
+ */
+void SetHTTPWorkPriority(const std::string& key, HTTPWorkPriority priority);
+
+/** Statistics of a work queue */
+struct HTTPWorkQueueStats
+{
+    HTTPWorkPriority priority;
+    size_t nQueued = 0;
+    size_t nRunning = 0;
+    //! Requests running at once at most, 0 for no limit
+    size_t nMaxRunning = 0;
+    uint64_t nCompleted = 0;
+    uint64_t nRejected = 0;
+    //! Time the completed requests waited in the queue
+    int64_t nTotalQueueMicros = 0;
+    int64_t nMaxQueueMicros = 0;
+};
+
+std::vector<HTTPWorkQueueStats> GetHTTPWorkQueueStats();
+
 /** Return evhttp event base. This can be used by submodules to
  * queue timers or custom events.
  */
@@ -59,6 +99,7 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    bool replyStarted;
 
 public:
     explicit HTTPRequest(struct evhttp_request* req);
@@ -98,6 +139,9 @@ public:
      */
     std::string ReadBody();
 
+    /** Copy up to nMaxSize bytes of the start of the request body, without consuming it */
+    std::string PeekBody(size_t nMaxSize);
+
     /**
      * Write output header.
      *
@@ -114,6 +158,24 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Start a reply whose body is sent piecewise with WriteReplyChunk, using chunked transfer
+     * encoding where the client supports it.
+     *
+     * @note call this instead of WriteReply, and finish the reply with EndReplyChunked.
+     */
+    void StartReplyChunked(int nStatus);
+
+    /** Send a piece of the body of a reply started with StartReplyChunked */
+    void WriteReplyChunk(std::string&& strChunk);
+
+    /**
+     * Finish a reply started with StartReplyChunked.
+     *
+     * @note Like WriteReply, this gives the request back to the main thread.
+     */
+    void EndReplyChunked();
 };
 
 /** Event handler closure.
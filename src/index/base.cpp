@@ -0,0 +1,302 @@
+// Copyright (c) 2017-2018 The Bitcoin Core developers
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/base.h>
+
+#include <chainparams.h>
+#include <init.h>
+#include <tinyformat.h>
+#include <txdb.h>
+#include <ui_interface.h>
+#include <undo.h>
+#include <util.h>
+#include <validation.h>
+#include <warnings.h>
+
+#include <functional>
+
+static const int64_t SYNC_LOG_INTERVAL = 30; // seconds
+static const int64_t SYNC_LOCATOR_WRITE_INTERVAL = 30; // seconds
+
+template<typename... Args>
+static void FatalError(const char* fmt, const Args&... args)
+{
+    std::string strMessage = tfm::format(fmt, args...);
+    SetMiscWarning(strMessage);
+    LogPrintf("*** %s\n", strMessage);
+    uiInterface.ThreadSafeMessageBox(
+        _("Error: A fatal internal error occurred, see debug.log for details"),
+        "", CClientUIInterface::MSG_ERROR);
+    StartShutdown();
+}
+
+CBaseIndex::CBaseIndex() : fSynced(false), pbestBlockIndex(nullptr), fMoveFromBlockTree(false)
+{
+}
+
+CBaseIndex::~CBaseIndex()
+{
+    Interrupt();
+    Stop();
+}
+
+void CBaseIndex::Start()
+{
+    // Register before reading the best block, blocks connected from here on are either seen by
+    // the sync thread or queued for BlockConnected
+    RegisterValidationInterface(this, GetName());
+
+    CBlockLocator locator;
+    if (!GetDB().ReadBestBlock(locator)) {
+        locator.SetNull();
+        // The sync thread moves the entries of an index built by an older version to its database
+        fMoveFromBlockTree = pblocktree->ReadIndexBestBlock(GetName(), locator);
+    }
+
+    {
+        LOCK(cs_main);
+        if (locator.IsNull()) {
+            pbestBlockIndex = nullptr;
+        } else {
+            // A best block off the active chain is kept, the sync thread rewinds it
+            BlockMap::const_iterator it = mapBlockIndex.find(locator.vHave.front());
+            pbestBlockIndex = it != mapBlockIndex.end() ? it->second : FindForkInGlobalIndex(chainActive, locator);
+        }
+        fSynced = !fMoveFromBlockTree && pbestBlockIndex.load() == chainActive.Tip();
+    }
+
+    threadSync = std::thread(&TraceThread<std::function<void()> >, GetName(), std::bind(&CBaseIndex::ThreadSync, this));
+}
+
+void CBaseIndex::ThreadSync()
+{
+    const CBlockIndex* pindex = pbestBlockIndex.load();
+    if (fSynced) return;
+
+    if (fMoveFromBlockTree) {
+        LogPrintf("Moving %s out of the block tree database\n", GetName());
+        if (!GetDB().MoveFromBlockTree(*pblocktree) || !WriteBestBlock(pindex) ||
+            !pblocktree->EraseIndexBestBlock(GetName())) {
+            FatalError("%s: Failed to move index %s to its own database", __func__, GetName());
+            return;
+        }
+        fMoveFromBlockTree = false;
+    }
+
+    int64_t nLastLog = 0;
+    int64_t nLastLocatorWrite = 0;
+    while (true) {
+        if (interrupt) {
+            WriteBestBlock(pindex);
+            return;
+        }
+
+        const CBlockIndex* pindexNext = nullptr;
+        const CBlockIndex* pindexFork = nullptr;
+        bool fWait = false;
+        {
+            LOCK(cs_main);
+            if (pindex && !chainActive.Contains(pindex)) {
+                if (!chainActive.Tip() || chainActive.Tip()->nChainWork < pindex->nChainWork) {
+                    // the active chain is still being built up to the indexed block
+                    fWait = true;
+                } else {
+                    pindexFork = chainActive.FindFork(pindex);
+                }
+            } else {
+                pindexNext = pindex ? chainActive.Next(pindex) : chainActive.Genesis();
+                if (!pindexNext) {
+                    // Caught up, blocks connected from here on are handled by BlockConnected
+                    WriteBestBlock(pindex);
+                    pbestBlockIndex = pindex;
+                    fSynced = true;
+                    break;
+                }
+            }
+        }
+
+        if (fWait) {
+            interrupt.sleep_for(std::chrono::seconds(1));
+            continue;
+        }
+
+        if (pindexNext == nullptr) {
+            if (!Rewind(pindex, pindexFork)) {
+                FatalError("%s: Failed to rewind index %s to a previous chain tip", __func__, GetName());
+                return;
+            }
+            pindex = pindexFork;
+            continue;
+        }
+
+        int64_t nNow = GetTime();
+        if (nLastLog + SYNC_LOG_INTERVAL < nNow) {
+            LogPrintf("Syncing %s with block chain from height %d\n", GetName(), pindexNext->nHeight);
+            nLastLog = nNow;
+        }
+
+        if (!ProcessBlock(nullptr, pindexNext, false)) {
+            FatalError("%s: Failed to write block %s to index %s", __func__, pindexNext->GetBlockHash().ToString(), GetName());
+            return;
+        }
+        pindex = pindexNext;
+        pbestBlockIndex = pindex;
+
+        if (nLastLocatorWrite + SYNC_LOCATOR_WRITE_INTERVAL < nNow) {
+            WriteBestBlock(pindex);
+            nLastLocatorWrite = nNow;
+        }
+    }
+
+    if (pindex) {
+        LogPrintf("%s is enabled at height %d\n", GetName(), pindex->nHeight);
+    } else {
+        LogPrintf("%s is enabled\n", GetName());
+    }
+}
+
+bool CBaseIndex::ProcessBlock(const CBlock* pblockIn, const CBlockIndex* pindex, bool fErase)
+{
+    // The genesis outputs are not spendable and the block has no undo data
+    if (pindex->nHeight == 0) return true;
+
+    CBlock block;
+    if (!pblockIn) {
+        if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus()))
+            return error("%s: Failed to read block %s from disk", __func__, pindex->GetBlockHash().ToString());
+        pblockIn = &block;
+    }
+
+    CBlockUndo blockundo;
+    if (NeedsUndo()) {
+        if (!UndoReadFromDisk(blockundo, pindex))
+            return error("%s: Failed to read undo data of block %s from disk", __func__, pindex->GetBlockHash().ToString());
+        if (blockundo.vtxundo.size() + 1 != pblockIn->vtx.size())
+            return error("%s: Block %s and undo data inconsistent", __func__, pindex->GetBlockHash().ToString());
+    }
+
+    if (fErase)
+        return EraseBlock(*pblockIn, blockundo, pindex);
+    return WriteBlock(*pblockIn, blockundo, pindex);
+}
+
+bool CBaseIndex::Rewind(const CBlockIndex* pindexCurrent, const CBlockIndex* pindexNew)
+{
+    for (const CBlockIndex* pindex = pindexCurrent; pindex != pindexNew; pindex = pindex->pprev) {
+        if (!ProcessBlock(nullptr, pindex, true)) return false;
+        pbestBlockIndex = pindex->pprev;
+    }
+
+    // The entries of the new branch must never be undone with the old branch, so record the fork
+    // point before indexing it
+    return WriteBestBlock(pindexNew);
+}
+
+bool CBaseIndex::WriteBestBlock(const CBlockIndex* pindex)
+{
+    CBlockLocator locator;
+    if (pindex) {
+        LOCK(cs_main);
+        locator = chainActive.GetLocator(pindex);
+    }
+    if (!GetDB().WriteBestBlock(locator))
+        return error("%s: Failed to write locator of %s to disk", __func__, GetName());
+    return true;
+}
+
+void CBaseIndex::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex,
+                                const std::vector<CTransactionRef>& txnConflicted)
+{
+    if (!fSynced) return;
+
+    const CBlockIndex* pindexBest = pbestBlockIndex.load();
+    if (!pindexBest) {
+        if (pindex->nHeight != 0) {
+            FatalError("%s: First block connected to %s is not the genesis block (height=%d)", __func__, GetName(), pindex->nHeight);
+            return;
+        }
+    } else {
+        // Blocks queued while the sync thread caught up may already be covered
+        if (pindexBest->GetAncestor(pindex->nHeight) == pindex) return;
+
+        // After a reorg the queue may still hold blocks of the stale branch, let it clear
+        if (pindexBest->GetAncestor(pindex->nHeight - 1) != pindex->pprev) {
+            LogPrintf("%s: WARNING: Block %s does not connect to an ancestor of known best chain (tip=%s), not updating %s\n",
+                      __func__, pindex->GetBlockHash().ToString(), pindexBest->GetBlockHash().ToString(), GetName());
+            return;
+        }
+
+        if (pindexBest != pindex->pprev && !Rewind(pindexBest, pindex->pprev)) {
+            FatalError("%s: Failed to rewind index %s to a previous chain tip", __func__, GetName());
+            return;
+        }
+    }
+
+    if (!ProcessBlock(pblock.get(), pindex, false)) {
+        FatalError("%s: Failed to write block %s to index %s", __func__, pindex->GetBlockHash().ToString(), GetName());
+        return;
+    }
+    pbestBlockIndex = pindex;
+}
+
+void CBaseIndex::SetBestChain(const CBlockLocator& locator)
+{
+    if (!fSynced) return;
+
+    WriteBestBlock(pbestBlockIndex.load());
+}
+
+bool CBaseIndex::BlockUntilSyncedToCurrentChain()
+{
+    if (!fSynced) return false;
+
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pindexTip = chainActive.Tip();
+        const CBlockIndex* pindexBest = pbestBlockIndex.load();
+        if (!pindexTip || (pindexBest && pindexBest->GetAncestor(pindexTip->nHeight) == pindexTip)) return true;
+    }
+
+    LogPrintf("%s: %s is catching up on block notifications\n", __func__, GetName());
+    SyncWithValidationInterfaceQueue();
+    return true;
+}
+
+void CBaseIndex::Interrupt()
+{
+    interrupt();
+}
+
+void CBaseIndex::Stop()
+{
+    UnregisterValidationInterface(this);
+
+    if (threadSync.joinable()) {
+        threadSync.join();
+    }
+}
+
+void UpgradeInlineIndex(const std::string& strName)
+{
+    bool fInline = false;
+    if (!pblocktree->ReadFlag(strName, fInline) || !fInline) return;
+
+    CBlockLocator locator;
+    if (!pblocktree->ReadIndexBestBlock(strName, locator)) {
+        LOCK(cs_main);
+        LogPrintf("%s: %s was built inline, recording the chain tip as its best block\n", __func__, strName);
+        pblocktree->WriteIndexBestBlock(strName, chainActive.GetLocator());
+    }
+    pblocktree->WriteFlag(strName, false);
+}
+
+const CTxUndo* GetSpentOutputs(const CBlockUndo& blockundo, const CTransaction& tx, unsigned int i)
+{
+    if (i == 0 || tx.IsZerocoinSpend()) return nullptr;
+
+    const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+    if (txundo.vprevout.size() != tx.vin.size()) return nullptr;
+    return &txundo;
+}
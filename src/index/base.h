@@ -0,0 +1,108 @@
+// Copyright (c) 2017-2018 The Bitcoin Core developers
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_BASE_H
+#define BITCOIN_INDEX_BASE_H
+
+#include <primitives/block.h>
+#include <threadinterrupt.h>
+#include <validationinterface.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+class CBlockIndex;
+class CBlockUndo;
+class CTxUndo;
+class CIndexDB;
+
+/**
+ * Base class for indexes that are built from the active chain outside of ConnectBlock. Each index
+ * keeps the locator of the last block it covers in its own database, catches up from there
+ * in its own thread and then follows the tip through the validation interface. Blocks that leave
+ * the active chain are removed with their undo data before the index moves to the new branch.
+ */
+class CBaseIndex : public CValidationInterface
+{
+private:
+    /// Whether the index has caught up with the chain tip and is driven by BlockConnected
+    std::atomic<bool> fSynced;
+
+    /// The last block in the chain that the index is in sync with
+    std::atomic<const CBlockIndex*> pbestBlockIndex;
+
+    /// Whether the entries are still in the block tree database, where older versions kept them
+    bool fMoveFromBlockTree;
+
+    std::thread threadSync;
+    CThreadInterrupt interrupt;
+
+    /// Catch up with the active chain, started by Start()
+    void ThreadSync();
+
+    /// Remove the blocks after pindexNew from the index, pindexNew must be an ancestor of pindexCurrent
+    bool Rewind(const CBlockIndex* pindexCurrent, const CBlockIndex* pindexNew);
+
+    /// Read a block (and its undo data if the index needs it) and hand it to WriteBlock or EraseBlock
+    bool ProcessBlock(const CBlock* pblockIn, const CBlockIndex* pindex, bool fErase);
+
+    bool WriteBestBlock(const CBlockIndex* pindex);
+
+protected:
+    void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex,
+                        const std::vector<CTransactionRef>& txnConflicted) override;
+
+    void SetBestChain(const CBlockLocator& locator) override;
+
+    /// Whether WriteBlock and EraseBlock need the undo data of the block
+    virtual bool NeedsUndo() const { return false; }
+
+    /// Add the entries of a block connected to the indexed chain
+    virtual bool WriteBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) = 0;
+
+    /// Remove the entries of a block disconnected from the indexed chain
+    virtual bool EraseBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) = 0;
+
+    /// Name of the index, used for its best block record, thread name and log messages
+    virtual const char* GetName() const = 0;
+
+public:
+    /// The database holding the entries and the best block of the index
+    virtual CIndexDB& GetDB() const = 0;
+
+    CBaseIndex();
+    virtual ~CBaseIndex();
+
+    /// Whether the index has caught up with the chain tip
+    bool IsSynced() const { return fSynced; }
+
+    /// The last block the index has the entries of, nullptr before it started
+    const CBlockIndex* GetBestBlockIndex() const { return pbestBlockIndex; }
+
+    /// Wait until the validation interface queue has been processed, so the index covers at least
+    /// the chain tip at the time of the call. Returns false if the index is still catching up.
+    /// Must not be called with cs_main held.
+    bool BlockUntilSyncedToCurrentChain();
+
+    /// Load the best block of the index, register for validation callbacks and start catching up
+    void Start();
+
+    void Interrupt();
+
+    /// Unregister from validation callbacks and stop the sync thread
+    void Stop();
+};
+
+/**
+ * Indexes maintained inside ConnectBlock before the background indexes existed only recorded a
+ * flag. They were in sync with the chain tip, so record the tip as their best block.
+ */
+void UpgradeInlineIndex(const std::string& strName);
+
+/** The outputs spent by the transaction at position i of a block, or nullptr if it spends none from the UTXO set */
+const CTxUndo* GetSpentOutputs(const CBlockUndo& blockundo, const CTransaction& tx, unsigned int i);
+
+#endif // BITCOIN_INDEX_BASE_H
@@ -0,0 +1,108 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/blockfilterindex.h>
+
+#include <chain.h>
+#include <chainparams.h>
+#include <undo.h>
+#include <util.h>
+
+std::unique_ptr<CBlockFilterIndexer> g_blockfilterindex;
+
+CBlockFilterIndexer::CBlockFilterIndexer(BlockFilterType filterTypeIn, size_t nCacheSize, bool fMemory, bool fWipe) :
+    filterType(filterTypeIn), pdb(MakeUnique<CBlockFilterIndexDB>(nCacheSize, fMemory, fWipe))
+{
+}
+
+bool CBlockFilterIndexer::WriteGenesisFilter(const CBlockIndex* pindexGenesis)
+{
+    CBlockFilterEntry entry;
+    if (ReadEntry(pindexGenesis, entry)) return true;
+
+    BlockFilter filter(filterType, Params().GenesisBlock(), CBlockUndo());
+    entry.hash = filter.GetHash();
+    entry.header = filter.ComputeHeader(uint256());
+    entry.filter = filter.GetEncodedFilter();
+    return pdb->WriteFilter(static_cast<uint8_t>(filterType), pindexGenesis->GetBlockHash(), entry);
+}
+
+bool CBlockFilterIndexer::ReadEntry(const CBlockIndex* pindex, CBlockFilterEntry& entry) const
+{
+    return pdb->ReadFilter(static_cast<uint8_t>(filterType), pindex->GetBlockHash(), entry);
+}
+
+bool CBlockFilterIndexer::WriteBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    if (pindex->nHeight == 1 && !WriteGenesisFilter(pindex->pprev))
+        return error("%s: Failed to write the genesis block filter", __func__);
+
+    CBlockFilterEntry prev;
+    if (!ReadEntry(pindex->pprev, prev))
+        return error("%s: No filter header for block %s", __func__, pindex->pprev->GetBlockHash().ToString());
+
+    BlockFilter filter(filterType, block, blockundo);
+    CBlockFilterEntry entry;
+    entry.hash = filter.GetHash();
+    entry.header = filter.ComputeHeader(prev.header);
+    entry.filter = filter.GetEncodedFilter();
+
+    if (!pdb->WriteFilter(static_cast<uint8_t>(filterType), pindex->GetBlockHash(), entry))
+        return error("%s: Failed to write block filter", __func__);
+    return true;
+}
+
+bool CBlockFilterIndexer::EraseBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    if (!pdb->EraseFilter(static_cast<uint8_t>(filterType), pindex->GetBlockHash()))
+        return error("%s: Failed to erase block filter", __func__);
+    return true;
+}
+
+bool CBlockFilterIndexer::LookupFilter(const CBlockIndex* pindex, BlockFilter& filter) const
+{
+    CBlockFilterEntry entry;
+    if (!ReadEntry(pindex, entry)) return false;
+
+    try {
+        filter = BlockFilter(filterType, pindex->GetBlockHash(), std::move(entry.filter));
+    } catch (const std::exception& e) {
+        return error("%s: Invalid filter of block %s: %s", __func__, pindex->GetBlockHash().ToString(), e.what());
+    }
+    return true;
+}
+
+bool CBlockFilterIndexer::LookupFilterHeader(const CBlockIndex* pindex, uint256& header) const
+{
+    CBlockFilterEntry entry;
+    if (!ReadEntry(pindex, entry)) return false;
+    header = entry.header;
+    return true;
+}
+
+bool CBlockFilterIndexer::LookupFilterRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<BlockFilter>& filters) const
+{
+    if (nStartHeight < 0 || nStartHeight > pindexStop->nHeight) return false;
+
+    filters.resize(pindexStop->nHeight - nStartHeight + 1);
+    const CBlockIndex* pindex = pindexStop;
+    for (size_t i = filters.size(); i-- > 0; pindex = pindex->pprev) {
+        if (!LookupFilter(pindex, filters[i])) return false;
+    }
+    return true;
+}
+
+bool CBlockFilterIndexer::LookupFilterHashRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<uint256>& hashes) const
+{
+    if (nStartHeight < 0 || nStartHeight > pindexStop->nHeight) return false;
+
+    hashes.resize(pindexStop->nHeight - nStartHeight + 1);
+    const CBlockIndex* pindex = pindexStop;
+    for (size_t i = hashes.size(); i-- > 0; pindex = pindex->pprev) {
+        CBlockFilterEntry entry;
+        if (!ReadEntry(pindex, entry)) return false;
+        hashes[i] = entry.hash;
+    }
+    return true;
+}
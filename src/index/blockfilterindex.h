@@ -0,0 +1,57 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_BLOCKFILTERINDEX_H
+#define BITCOIN_INDEX_BLOCKFILTERINDEX_H
+
+#include <blockfilter.h>
+#include <index/base.h>
+#include <txdb.h>
+
+#include <memory>
+
+/**
+ * Block filter index (-blockfilterindex): the compact filter of every block and its filter header
+ * (BIP 157/158), served to light clients by the getcfilters, getcfheaders and getcfcheckpt messages.
+ */
+class CBlockFilterIndexer final : public CBaseIndex
+{
+private:
+    BlockFilterType filterType;
+    std::unique_ptr<CBlockFilterIndexDB> pdb;
+
+    /// Write the filter of the genesis block, which the index framework does not pass to WriteBlock
+    bool WriteGenesisFilter(const CBlockIndex* pindexGenesis);
+
+    bool ReadEntry(const CBlockIndex* pindex, CBlockFilterEntry& entry) const;
+
+protected:
+    bool NeedsUndo() const override { return true; }
+    bool WriteBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) override;
+    bool EraseBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) override;
+    const char* GetName() const override { return "blockfilterindex"; }
+
+public:
+    CBlockFilterIndexer(BlockFilterType filterTypeIn, size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    CBlockFilterIndexDB& GetDB() const override { return *pdb; }
+
+    BlockFilterType GetFilterType() const { return filterType; }
+
+    /// The filter of a block, false if the index has no entry for it
+    bool LookupFilter(const CBlockIndex* pindex, BlockFilter& filter) const;
+
+    /// The filter header of a block, false if the index has no entry for it
+    bool LookupFilterHeader(const CBlockIndex* pindex, uint256& header) const;
+
+    /// The filters of the ancestors of pindexStop from height nStartHeight up to pindexStop
+    bool LookupFilterRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<BlockFilter>& filters) const;
+
+    /// The filter hashes of the ancestors of pindexStop from height nStartHeight up to pindexStop
+    bool LookupFilterHashRange(int nStartHeight, const CBlockIndex* pindexStop, std::vector<uint256>& hashes) const;
+};
+
+extern std::unique_ptr<CBlockFilterIndexer> g_blockfilterindex;
+
+#endif // BITCOIN_INDEX_BLOCKFILTERINDEX_H
@@ -0,0 +1,84 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/collateralindex.h>
+
+#include <chain.h>
+#include <ghostnode/ghostnode.h>
+#include <undo.h>
+#include <util.h>
+
+std::unique_ptr<CCollateralIndexer> g_collateralindex;
+
+static bool IsCollateral(const CTxOut& out)
+{
+    return out.nValue == GHOSTNODE_COIN_REQUIRED * COIN;
+}
+
+CCollateralIndexer::CCollateralIndexer(size_t nCacheSize, bool fMemory, bool fWipe) :
+    pdb(MakeUnique<CCollateralIndexDB>(nCacheSize, fMemory, fWipe))
+{
+}
+
+bool CCollateralIndexer::WriteBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    std::vector<std::pair<COutPoint, CGhostnodeCollateral> > collaterals;
+
+    for (unsigned int i = 0; i < block.vtx.size(); i++)
+    {
+        const CTransaction &tx = *(block.vtx[i]);
+
+        const CTxUndo* ptxundo = GetSpentOutputs(blockundo, tx, i);
+        for (size_t j = 0; ptxundo && j < tx.vin.size(); j++)
+        {
+            // a null value deletes the spent collateral
+            if (IsCollateral(ptxundo->vprevout[j].out))
+                collaterals.push_back(std::make_pair(tx.vin[j].prevout, CGhostnodeCollateral()));
+        }
+
+        for (unsigned int k = 0; k < tx.vout.size(); k++)
+        {
+            if (IsCollateral(tx.vout[k]))
+                collaterals.push_back(std::make_pair(COutPoint(tx.GetHash(), k), CGhostnodeCollateral(tx.vout[k].scriptPubKey, pindex->nHeight)));
+        }
+    }
+
+    if (!pdb->UpdateCollaterals(collaterals))
+        return error("%s: Failed to write collateral index", __func__);
+    return true;
+}
+
+bool CCollateralIndexer::EraseBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    std::vector<std::pair<COutPoint, CGhostnodeCollateral> > collaterals;
+
+    // undo transactions in reverse order
+    for (int i = block.vtx.size() - 1; i >= 0; i--)
+    {
+        const CTransaction &tx = *(block.vtx[i]);
+
+        for (unsigned int k = tx.vout.size(); k-- > 0;)
+        {
+            if (IsCollateral(tx.vout[k]))
+                collaterals.push_back(std::make_pair(COutPoint(tx.GetHash(), k), CGhostnodeCollateral()));
+        }
+
+        const CTxUndo* ptxundo = GetSpentOutputs(blockundo, tx, i);
+        for (unsigned int j = ptxundo ? tx.vin.size() : 0; j-- > 0;)
+        {
+            const Coin &coin = ptxundo->vprevout[j];
+            if (IsCollateral(coin.out))
+                collaterals.push_back(std::make_pair(tx.vin[j].prevout, CGhostnodeCollateral(coin.out.scriptPubKey, coin.nHeight)));
+        }
+    }
+
+    if (!pdb->UpdateCollaterals(collaterals))
+        return error("%s: Failed to restore collateral index", __func__);
+    return true;
+}
+
+bool CCollateralIndexer::GetCollateral(const COutPoint& outpoint, CGhostnodeCollateral& collateral) const
+{
+    return IsSynced() && pdb->ReadCollateral(outpoint, collateral);
+}
@@ -0,0 +1,40 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_COLLATERALINDEX_H
+#define BITCOIN_INDEX_COLLATERALINDEX_H
+
+#include <index/base.h>
+#include <txdb.h>
+
+#include <memory>
+
+/**
+ * Ghostnode collateral index (-collateralindex): the unspent outputs of exactly the ghostnode
+ * collateral amount with their script and height, the list of ghostnodes the chain allows.
+ * Spent collaterals are restored from the undo data when their block is disconnected.
+ */
+class CCollateralIndexer final : public CBaseIndex
+{
+private:
+    std::unique_ptr<CCollateralIndexDB> pdb;
+
+protected:
+    bool NeedsUndo() const override { return true; }
+    bool WriteBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) override;
+    bool EraseBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) override;
+    const char* GetName() const override { return "collateralindex"; }
+
+public:
+    CCollateralIndexer(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    CCollateralIndexDB& GetDB() const override { return *pdb; }
+
+    /// The collateral at outpoint, false if it is not indexed or the index is still catching up
+    bool GetCollateral(const COutPoint& outpoint, CGhostnodeCollateral& collateral) const;
+};
+
+extern std::unique_ptr<CCollateralIndexer> g_collateralindex;
+
+#endif // BITCOIN_INDEX_COLLATERALINDEX_H
@@ -0,0 +1,272 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/insightindex.h>
+
+#include <addressindex.h>
+#include <chain.h>
+#include <spentindex.h>
+#include <undo.h>
+#include <util.h>
+#include <validation.h>
+
+#include <algorithm>
+#include <limits>
+
+std::unique_ptr<CAddressIndexer> g_addressindex;
+std::unique_ptr<CSpentIndexer> g_spentindex;
+std::unique_ptr<CTimestampIndexer> g_timestampindex;
+
+CAddressIndexer::CAddressIndexer(size_t nCacheSize, bool fMemory, bool fWipe, bool fCompression) :
+    pdb(MakeUnique<CAddressIndexDB>(nCacheSize, fMemory, fWipe, fCompression))
+{
+}
+
+bool CAddressIndexer::WriteBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
+
+    for (unsigned int i = 0; i < block.vtx.size(); i++)
+    {
+        const CTransaction &tx = *(block.vtx[i]);
+        const uint256 txHash = tx.GetHash();
+
+        const CTxUndo* ptxundo = GetSpentOutputs(blockundo, tx, i);
+        for (size_t j = 0; ptxundo && j < tx.vin.size(); j++)
+        {
+            const CTxIn &input = tx.vin[j];
+            const Coin &coin = ptxundo->vprevout[j];
+
+            std::vector<uint8_t> hashBytes;
+            int scriptType = 0;
+            if (!ExtractIndexInfo(&coin.out.scriptPubKey, scriptType, hashBytes)
+                    || scriptType <= 0)
+                continue;
+
+            uint256 hashAddress(hashBytes.data(), hashBytes.size());
+
+            // record spending activity
+            addressIndex.push_back(std::make_pair(CAddressIndexKey(scriptType, hashAddress, pindex->nHeight, i, txHash, j, true), coin.out.nValue * -1));
+            // remove address from unspent index
+            addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(scriptType, hashAddress, input.prevout.hash, input.prevout.n), CAddressUnspentValue()));
+        }
+
+        for (unsigned int k = 0; k < tx.vout.size(); k++)
+        {
+            const CScript *pScript;
+            std::vector<unsigned char> hashBytes;
+            int scriptType = 0;
+            CAmount nValue;
+            if (!ExtractIndexInfo(&tx.vout[k], scriptType, hashBytes, nValue, pScript)
+                    || scriptType == 0)
+                continue;
+
+            uint256 hashAddress(hashBytes.data(), hashBytes.size());
+
+            // record receiving activity
+            addressIndex.push_back(std::make_pair(CAddressIndexKey(scriptType, hashAddress, pindex->nHeight, i, txHash, k, false), nValue));
+            // record unspent output
+            addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(scriptType, hashAddress, txHash, k), CAddressUnspentValue(nValue, *pScript, pindex->nHeight)));
+        }
+    }
+
+    if (!pdb->WriteAddressIndex(addressIndex))
+        return error("%s: Failed to write address index", __func__);
+    if (!pdb->UpdateAddressUnspentIndex(addressUnspentIndex))
+        return error("%s: Failed to write address unspent index", __func__);
+    return true;
+}
+
+bool CAddressIndexer::EraseBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
+
+    // undo transactions in reverse order
+    for (int i = block.vtx.size() - 1; i >= 0; i--)
+    {
+        const CTransaction &tx = *(block.vtx[i]);
+        const uint256 txHash = tx.GetHash();
+
+        for (unsigned int k = tx.vout.size(); k-- > 0;)
+        {
+            const CScript *pScript;
+            std::vector<unsigned char> hashBytes;
+            int scriptType = 0;
+            CAmount nValue;
+            if (!ExtractIndexInfo(&tx.vout[k], scriptType, hashBytes, nValue, pScript)
+                    || scriptType == 0)
+                continue;
+
+            uint256 hashAddress(hashBytes.data(), hashBytes.size());
+
+            // undo receiving activity
+            addressIndex.push_back(std::make_pair(CAddressIndexKey(scriptType, hashAddress, pindex->nHeight, i, txHash, k, false), nValue));
+            // undo unspent index
+            addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(scriptType, hashAddress, txHash, k), CAddressUnspentValue()));
+        }
+
+        const CTxUndo* ptxundo = GetSpentOutputs(blockundo, tx, i);
+        for (unsigned int j = ptxundo ? tx.vin.size() : 0; j-- > 0;)
+        {
+            const CTxIn &input = tx.vin[j];
+            const Coin &coin = ptxundo->vprevout[j];
+
+            std::vector<uint8_t> hashBytes;
+            int scriptType = 0;
+            if (!ExtractIndexInfo(&coin.out.scriptPubKey, scriptType, hashBytes)
+                    || scriptType <= 0)
+                continue;
+
+            uint256 hashAddress(hashBytes.data(), hashBytes.size());
+
+            // undo spending activity
+            addressIndex.push_back(std::make_pair(CAddressIndexKey(scriptType, hashAddress, pindex->nHeight, i, txHash, j, true), coin.out.nValue * -1));
+            // restore unspent index
+            addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(scriptType, hashAddress, input.prevout.hash, input.prevout.n), CAddressUnspentValue(coin.out.nValue, coin.out.scriptPubKey, coin.nHeight)));
+        }
+    }
+
+    if (!pdb->EraseAddressIndex(addressIndex))
+        return error("%s: Failed to delete address index", __func__);
+    if (!pdb->UpdateAddressUnspentIndex(addressUnspentIndex))
+        return error("%s: Failed to write address unspent index", __func__);
+    return true;
+}
+
+CSpentIndexer::CSpentIndexer(size_t nCacheSize, bool fMemory, bool fWipe) :
+    pdb(MakeUnique<CSpentIndexDB>(nCacheSize, fMemory, fWipe))
+{
+}
+
+bool CSpentIndexer::WriteBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
+
+    for (unsigned int i = 0; i < block.vtx.size(); i++)
+    {
+        const CTransaction &tx = *(block.vtx[i]);
+        const uint256 txHash = tx.GetHash();
+
+        const CTxUndo* ptxundo = GetSpentOutputs(blockundo, tx, i);
+        for (size_t j = 0; ptxundo && j < tx.vin.size(); j++)
+        {
+            const CTxIn &input = tx.vin[j];
+            const Coin &coin = ptxundo->vprevout[j];
+
+            std::vector<uint8_t> hashBytes;
+            int scriptType = 0;
+            if (!ExtractIndexInfo(&coin.out.scriptPubKey, scriptType, hashBytes)
+                    || scriptType == 0)
+                continue;
+
+            uint256 hashAddress;
+            if (scriptType > 0)
+                hashAddress = uint256(hashBytes.data(), hashBytes.size());
+
+            // add the spent index to determine the txid and input that spent an output
+            // and to find the amount and address from an input
+            spentIndex.push_back(std::make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue(txHash, j, pindex->nHeight, coin.out.nValue, scriptType, hashAddress)));
+        }
+    }
+
+    if (!pdb->UpdateSpentIndex(spentIndex))
+        return error("%s: Failed to write spent index", __func__);
+    return true;
+}
+
+bool CSpentIndexer::EraseBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
+
+    for (unsigned int i = 0; i < block.vtx.size(); i++)
+    {
+        const CTransaction &tx = *(block.vtx[i]);
+        if (!GetSpentOutputs(blockundo, tx, i)) continue;
+
+        // a null value deletes the entry
+        for (const CTxIn &input : tx.vin)
+            spentIndex.push_back(std::make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue()));
+    }
+
+    if (!pdb->UpdateSpentIndex(spentIndex))
+        return error("%s: Failed to delete spent index", __func__);
+    return true;
+}
+
+/** The order of the timestamp index database, by time and then block hash */
+static bool CompareTimestampBlocks(const CBlockIndex* a, const CBlockIndex* b)
+{
+    if (a->nTime != b->nTime) return a->nTime < b->nTime;
+    return a->GetBlockHash() < b->GetBlockHash();
+}
+
+CTimestampIndexer::CTimestampIndexer(size_t nCacheSize, bool fMemory, bool fWipe) :
+    pdb(MakeUnique<CTimestampIndexDB>(nCacheSize, fMemory, fWipe)), fBlocksLoaded(false)
+{
+}
+
+bool CTimestampIndexer::LoadBlocks()
+{
+    AssertLockHeld(cs_blocks);
+
+    std::vector<uint256> hashes;
+    if (!pdb->ReadTimestampIndex(std::numeric_limits<unsigned int>::max(), 0, hashes))
+        return false;
+
+    // The index holds every block it was handed, block indexes are never freed while running
+    vBlocks.reserve(hashes.size());
+    {
+        LOCK(cs_main);
+        for (const uint256& hash : hashes) {
+            BlockMap::const_iterator mi = mapBlockIndex.find(hash);
+            if (mi != mapBlockIndex.end())
+                vBlocks.push_back(mi->second);
+        }
+    }
+    fBlocksLoaded = true;
+    return true;
+}
+
+bool CTimestampIndexer::GetBlockHashes(unsigned int high, unsigned int low, std::vector<uint256>& hashes)
+{
+    LOCK(cs_blocks);
+    if (!fBlocksLoaded && !LoadBlocks())
+        return false;
+
+    std::vector<const CBlockIndex*>::const_iterator it = std::lower_bound(vBlocks.begin(), vBlocks.end(), low,
+        [](const CBlockIndex* pindex, unsigned int nTime) { return pindex->nTime < nTime; });
+    for (; it != vBlocks.end() && (*it)->nTime <= high; ++it)
+        hashes.push_back((*it)->GetBlockHash());
+    return true;
+}
+
+bool CTimestampIndexer::WriteBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    // Held across the database write so a first query loading the blocks sees each one once
+    LOCK(cs_blocks);
+
+    if (!pdb->WriteTimestampIndex(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash())))
+        return error("%s: Failed to write timestamp index", __func__);
+
+    if (!pdb->WriteTimestampBlockIndex(CTimestampBlockIndexKey(pindex->GetBlockHash()), CTimestampBlockIndexValue(pindex->nTime)))
+        return error("%s: Failed to write blockhash index", __func__);
+
+    if (fBlocksLoaded) {
+        // Blocks mostly come in time order, so the search is short. A block written again after a
+        // reorg has the same database key and is not added twice.
+        std::vector<const CBlockIndex*>::iterator it = std::lower_bound(vBlocks.begin(), vBlocks.end(), pindex, CompareTimestampBlocks);
+        if (it == vBlocks.end() || *it != pindex)
+            vBlocks.insert(it, pindex);
+    }
+
+    return true;
+}
+
+bool CTimestampIndexer::EraseBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    // The timestamp index has always kept the entries of disconnected blocks
+    return true;
+}
@@ -0,0 +1,88 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_INDEX_INSIGHTINDEX_H
+#define BITCOIN_INDEX_INSIGHTINDEX_H
+
+#include <index/base.h>
+#include <sync.h>
+#include <txdb.h>
+
+#include <memory>
+#include <vector>
+
+/**
+ * Address index (-addressindex): the balance changes of every address and its unspent outputs.
+ * The spent outputs are taken from the undo data of each block.
+ */
+class CAddressIndexer final : public CBaseIndex
+{
+private:
+    std::unique_ptr<CAddressIndexDB> pdb;
+
+protected:
+    bool NeedsUndo() const override { return true; }
+    bool WriteBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) override;
+    bool EraseBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) override;
+    const char* GetName() const override { return "addressindex"; }
+
+public:
+    CAddressIndexer(size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool fCompression = false);
+
+    CAddressIndexDB& GetDB() const override { return *pdb; }
+};
+
+/** Spent index (-spentindex): the input that spent each output, with its amount and address. */
+class CSpentIndexer final : public CBaseIndex
+{
+private:
+    std::unique_ptr<CSpentIndexDB> pdb;
+
+protected:
+    bool NeedsUndo() const override { return true; }
+    bool WriteBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) override;
+    bool EraseBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) override;
+    const char* GetName() const override { return "spentindex"; }
+
+public:
+    CSpentIndexer(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    CSpentIndexDB& GetDB() const override { return *pdb; }
+};
+
+/**
+ * Timestamp index (-timestampindex): block hashes by block time. Range queries are answered from
+ * the indexed blocks kept in memory, sorted like the database by time and then hash, which is
+ * read once on the first query.
+ */
+class CTimestampIndexer final : public CBaseIndex
+{
+private:
+    std::unique_ptr<CTimestampIndexDB> pdb;
+
+    CCriticalSection cs_blocks;
+    std::vector<const CBlockIndex*> vBlocks;
+    bool fBlocksLoaded;
+
+    bool LoadBlocks();
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) override;
+    bool EraseBlock(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex) override;
+    const char* GetName() const override { return "timestampindex"; }
+
+public:
+    CTimestampIndexer(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    CTimestampIndexDB& GetDB() const override { return *pdb; }
+
+    /** The hashes of the indexed blocks with a time in [low, high], in time order */
+    bool GetBlockHashes(unsigned int high, unsigned int low, std::vector<uint256>& hashes);
+};
+
+extern std::unique_ptr<CAddressIndexer> g_addressindex;
+extern std::unique_ptr<CSpentIndexer> g_spentindex;
+extern std::unique_ptr<CTimestampIndexer> g_timestampindex;
+
+#endif // BITCOIN_INDEX_INSIGHTINDEX_H
@@ -12,14 +12,22 @@
 
 #include <addrman.h>
 #include <amount.h>
+#include <blockconnectstats.h>
+#include <cpuprofiler.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
 #include <compat/sanity.h>
+#include <crypto/Lyra2RE/Lyra2RE.h>
+#include <crypto/ripemd160.h>
+#include <crypto/sha512.h>
 #include <consensus/validation.h>
 #include <fs.h>
 #include <httpserver.h>
 #include <httprpc.h>
+#include <index/blockfilterindex.h>
+#include <index/collateralindex.h>
+#include <index/insightindex.h>
 #include <key.h>
 #include <validation.h>
 #include <miner.h>
@@ -29,6 +37,7 @@
 #include <policy/feerate.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
+#include <pow.h>
 #include <rpc/server.h>
 #include <rpc/register.h>
 #include <rpc/safemode.h>
@@ -50,6 +59,7 @@
 #include <warnings.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <future>
 #include <memory>
 
 #ifndef WIN32
@@ -86,6 +96,8 @@
 #include "ghostnode/instantx.h"
 #include "ghostnode/spork.h"
 #include "ghostnode/flat-database.h"
+#include "libzerocoin/ParallelTasksPool.h"
+#include "zerocoin/zerocoin.h"
 
 #if ENABLE_ZMQ
 #include <zmq/zmqnotificationinterface.h>
@@ -94,6 +106,7 @@
 bool fFeeEstimatesInitialized = false;
 static const bool DEFAULT_PROXYRANDOMIZE = true;
 static const bool DEFAULT_REST_ENABLE = false;
+static const bool DEFAULT_HTTP_METRICS = false;
 static const bool DEFAULT_STOPAFTERBLOCKIMPORT = false;
 
 std::unique_ptr<CConnman> g_connman;
@@ -162,6 +175,7 @@ static char *convert_str(const std::string &s) {
 
 std::atomic<bool> fRequestShutdown(false);
 std::atomic<bool> fDumpMempoolLater(false);
+static std::atomic<bool> fDumpBlockIndexLater(false);
 
 void StartShutdown()
 {
@@ -203,6 +217,11 @@ static std::unique_ptr<ECCVerifyHandle> globalVerifyHandle;
 static boost::thread_group threadGroup;
 static CScheduler scheduler;
 
+CScheduler& GetScheduler()
+{
+    return scheduler;
+}
+
 void Interrupt()
 {
     InterruptHTTPServer();
@@ -212,6 +231,16 @@ void Interrupt()
     InterruptTorControl();
     if (g_connman)
         g_connman->Interrupt();
+    if (g_addressindex)
+        g_addressindex->Interrupt();
+    if (g_spentindex)
+        g_spentindex->Interrupt();
+    if (g_timestampindex)
+        g_timestampindex->Interrupt();
+    if (g_collateralindex)
+        g_collateralindex->Interrupt();
+    if (g_blockfilterindex)
+        g_blockfilterindex->Interrupt();
 }
 
 void Shutdown()
@@ -231,6 +260,7 @@ void Shutdown()
 
     StopHTTPRPC();
     StopREST();
+    StopHTTPMetrics();
     StopRPC();
     StopHTTPServer();
 #ifdef ENABLE_WALLET
@@ -252,12 +282,18 @@ void Shutdown()
     threadGroup.interrupt_all();
     threadGroup.join_all();
 
+    StopBlockConnectTrace();
+    StopCpuProfiler();
+    DumpGhostnodes();
+
     if (fDumpMempoolLater && gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
         DumpMempool();
     }
 
     if (fFeeEstimatesInitialized)
     {
+        // Run the fee estimator updates still queued
+        GetMainSignals().FlushBackgroundCallbacks();
         ::feeEstimator.FlushUnconfirmed(::mempool);
         fs::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
         CAutoFile est_fileout(fsbridge::fopen(est_path, "wb"), SER_DISK, CLIENT_VERSION);
@@ -277,6 +313,13 @@ void Shutdown()
     // CValidationInterface callbacks, flush them...
     GetMainSignals().FlushBackgroundCallbacks();
 
+    // Stop and delete the indexes only after flushing background callbacks
+    g_addressindex.reset();
+    g_spentindex.reset();
+    g_timestampindex.reset();
+    g_collateralindex.reset();
+    g_blockfilterindex.reset();
+
     // Any future callbacks will be dropped. This should absolutely be safe - if
     // missing a callback results in an unrecoverable situation, unclean shutdown
     // would too. The only reason to do the above flushes is to let the wallet catch
@@ -288,10 +331,14 @@ void Shutdown()
         if (pcoinsTip != nullptr) {
             FlushStateToDisk();
         }
+        if (fDumpBlockIndexLater) {
+            DumpBlockIndexSnapshot();
+        }
         pcoinsTip.reset();
         pcoinscatcher.reset();
         pcoinsdbview.reset();
         pblocktree.reset();
+        pzerocoindb.reset();
     }
 #ifdef ENABLE_WALLET
     StopWallets();
@@ -322,6 +369,7 @@ void Shutdown()
     ECC_Stop_Stealth();
     ECC_Stop();
     LogPrintf("%s: done\n", __func__);
+    StopDebugLogWriter();
 }
 
 /**
@@ -380,7 +428,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-blocknotify=<cmd>", _("Execute command when the best block changes (%s in cmd is replaced by block hash)"));
     if (showDebug)
         strUsage += HelpMessageOpt("-blocksonly", strprintf(_("Whether to operate in a blocks only mode (default: %u)"), DEFAULT_BLOCKSONLY));
-    strUsage +=HelpMessageOpt("-assumevalid=<hex>", strprintf(_("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script verification (0 to verify all, default: %s, testnet: %s)"), defaultChainParams->GetConsensus().defaultAssumeValid.GetHex(), testnetChainParams->GetConsensus().defaultAssumeValid.GetHex()));
+    strUsage +=HelpMessageOpt("-assumevalid=<hex>", strprintf(_("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script and zerocoin spend proof verification (0 to verify all, default: %s, testnet: %s)"), defaultChainParams->GetConsensus().defaultAssumeValid.GetHex(), testnetChainParams->GetConsensus().defaultAssumeValid.GetHex()));
+    strUsage += HelpMessageOpt("-chainstateshards=<n>", strprintf(_("Spread the chain state over <n> databases written in parallel, for a new chain state or with -reindex-chainstate (1 to %d, default: %u)"), MAX_CHAINSTATE_SHARDS, DEFAULT_CHAINSTATE_SHARDS));
     strUsage += HelpMessageOpt("-conf=<file>", strprintf(_("Specify configuration file (default: %s)"), BITCOIN_CONF_FILENAME));
     if (mode == HMM_BITCOIND)
     {
@@ -391,7 +440,10 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory"));
     if (showDebug) {
         strUsage += HelpMessageOpt("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize));
+        strUsage += HelpMessageOpt("-dboption=<db>:<setting>=<n>", "Override a LevelDB setting of the database at the path <db> below the data directory, e.g. chainstate or blocks/index. "
+            "<setting> is bloombits (bloom filter bits per key, 0 for none), maxopenfiles, blocksize (bytes) or compression (0 or 1). Can be specified multiple times");
     }
+    strUsage += HelpMessageOpt("-dbcompact=<n>", strprintf(_("Compact one of the databases every <n> minutes while the node is idle, the databases in turn, see getdbstats (default: %u)"), DEFAULT_DB_COMPACT_INTERVAL));
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
     if (showDebug)
         strUsage += HelpMessageOpt("-feefilter", strprintf("Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER));
@@ -405,24 +457,40 @@ std::string HelpMessage(HelpMessageMode mode)
     }
     strUsage += HelpMessageOpt("-persistmempool", strprintf(_("Whether to save the mempool on shutdown and load on restart (default: %u)"), DEFAULT_PERSIST_MEMPOOL));
     strUsage += HelpMessageOpt("-blockreconstructionextratxn=<n>", strprintf(_("Extra transactions to keep in memory for compact block reconstructions (default: %u)"), DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN));
-    strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
+    strUsage += HelpMessageOpt("-blockreconstructionextraspends=<n>", strprintf(_("Extra zerocoin spends to keep in memory for compact block reconstructions (default: %u)"), DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_SPENDS));
+    strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script and zerocoin spend verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
         -GetNumCores(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS));
+    strUsage += HelpMessageOpt("-zcthreads=<n>", strprintf(_("Set the number of threads used for zerocoin proof computations (0 = same as -par, <0 = leave that many cores free, default: %d)"),
+        DEFAULT_ZEROCOIN_THREADS));
+    strUsage += HelpMessageOpt("-zcadmissionthreads=<n>", strprintf(_("Set the number of threads verifying zerocoin spends relayed by peers before they enter the memory pool (0 = verify them on the message handler thread, max: %d, default: %d)"),
+        MAX_ZEROCOIN_ADMISSION_THREADS, DEFAULT_ZEROCOIN_ADMISSION_THREADS));
+    strUsage += HelpMessageOpt("-schedulerthreads=<n>", strprintf(_("Set the number of threads running background tasks, tasks of one kind never run in parallel (1 to %d, default: %d)"),
+        MAX_SCHEDULER_THREADS, DEFAULT_SCHEDULER_THREADS));
+    strUsage += HelpMessageOpt("-maxvalidationqueue=<n>", strprintf(_("Let block validation wait for a wallet, index or other subscriber with more than <n> queued notifications (default: %u)"), DEFAULT_MAX_VALIDATION_QUEUE));
+    strUsage += HelpMessageOpt("-maxnotificationqueue=<n>", strprintf(_("Drop the oldest notifications of a best-effort subscriber like ZMQ with more than <n> queued (default: %u)"), DEFAULT_MAX_NOTIFICATION_QUEUE));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), BITCOIN_PID_FILENAME));
 #endif
     strUsage += HelpMessageOpt("-prune=<n>", strprintf(_("Reduce storage requirements by enabling pruning (deleting) of old blocks. This allows the pruneblockchain RPC to be called to delete specific blocks, and enables automatic pruning of old blocks if a target size in MiB is provided. This mode is incompatible with -txindex and -rescan. "
+            "The blocks the ghostnode payments are checked against are never pruned, the zerocoin state is kept in its own indexes. "
             "Warning: Reverting this setting requires re-downloading the entire blockchain. "
             "(default: 0 = disable pruning blocks, 1 = allow manual pruning via RPC, >%u = automatically prune block files to stay under the specified target size in MiB)"), MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024));
     strUsage += HelpMessageOpt("-reindex-chainstate", _("Rebuild chain state from the currently indexed blocks"));
+    strUsage += HelpMessageOpt("-reindex-chainstate-fast", _("Rebuild chain state from the currently indexed blocks, without validating the blocks this node validated before again: only their coins are re-applied, their zerocoin state is taken from the block index"));
     strUsage += HelpMessageOpt("-reindex", _("Rebuild chain state and block index from the blk*.dat files on disk"));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-sysperms", _("Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)"));
 #endif
     strUsage += HelpMessageOpt("-txindex", strprintf(_("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)"), DEFAULT_TXINDEX));
+    strUsage += HelpMessageOpt("-compressblocks", strprintf(_("Store new blocks and undo data compressed, and compress the existing block files in the background after startup. "
+            "Block files written this way cannot be read by versions without compression support (default: %u)"), DEFAULT_COMPRESS_BLOCKS));
 
     strUsage += HelpMessageOpt("-addressindex", strprintf(_("Maintain a full address index, used to query for the balance, txids and unspent outputs for addresses (default: %u)"), DEFAULT_ADDRESSINDEX));
+    strUsage += HelpMessageOpt("-addressindexcompression", strprintf(_("Compress the address index database, only effective when built with Snappy (default: %u)"), DEFAULT_ADDRESSINDEX_COMPRESSION));
     strUsage += HelpMessageOpt("-timestampindex", strprintf(_("Maintain a timestamp index for block hashes, used to query blocks hashes by a range of timestamps (default: %u)"), DEFAULT_TIMESTAMPINDEX));
     strUsage += HelpMessageOpt("-spentindex", strprintf(_("Maintain a full spent index, used to query the spending txid and input index for an outpoint (default: %u)"), DEFAULT_SPENTINDEX));
+    strUsage += HelpMessageOpt("-collateralindex", strprintf(_("Maintain an index of the ghostnode collaterals in the chain, used to verify ghostnode announcements without reading transactions from disk (default: %u)"), DEFAULT_COLLATERALINDEX));
+    strUsage += HelpMessageOpt("-blockfilterindex", strprintf(_("Maintain the compact filters of all blocks (BIP 157/158), used by light clients to find the blocks relevant to them (default: %u)"), DEFAULT_BLOCKFILTERINDEX));
 
     strUsage += HelpMessageGroup(_("Connection options:"));
     strUsage += HelpMessageOpt("-addnode=<ip>", _("Add a node to connect to and attempt to keep the connection open (see the `addnode` RPC command help for more info)"));
@@ -430,10 +498,12 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-bantime=<n>", strprintf(_("Number of seconds to keep misbehaving peers from reconnecting (default: %u)"), DEFAULT_MISBEHAVING_BANTIME));
     strUsage += HelpMessageOpt("-bind=<addr>", _("Bind to given address and always listen on it. Use [host]:port notation for IPv6"));
     strUsage += HelpMessageOpt("-connect=<ip>", _("Connect only to the specified node(s); -connect=0 disables automatic connections (the rules for this peer are the same as for -addnode)"));
+    strUsage += HelpMessageOpt("-connectthreads=<n>", strprintf(_("Number of threads that open outbound and ghostnode connections in parallel, 0 opens them one at a time (default: %d)"), DEFAULT_CONNECT_THREADS));
     strUsage += HelpMessageOpt("-discover", _("Discover own IP addresses (default: 1 when listening and no -externalip or -proxy)"));
     strUsage += HelpMessageOpt("-dns", _("Allow DNS lookups for -addnode, -seednode and -connect") + " " + strprintf(_("(default: %u)"), DEFAULT_NAME_LOOKUP));
     strUsage += HelpMessageOpt("-dnsseed", _("Query for peer addresses via DNS lookup, if low on addresses (default: 1 unless -connect used)"));
     strUsage += HelpMessageOpt("-externalip=<ip>", _("Specify your own public address"));
+    strUsage += HelpMessageOpt("-fastblockrelay", strprintf(_("Announce new blocks to high-bandwidth compact block peers once their proof of work and merkle root are checked, before their transactions are (default: %u)"), DEFAULT_FASTBLOCKRELAY));
     strUsage += HelpMessageOpt("-forcednsseed", strprintf(_("Always query for peer addresses via DNS lookup (default: %u)"), DEFAULT_FORCEDNSSEED));
     strUsage += HelpMessageOpt("-listen", _("Accept connections from outside (default: 1 if no -proxy or -connect)"));
     strUsage += HelpMessageOpt("-listenonion", strprintf(_("Automatically create Tor hidden service (default: %d)"), DEFAULT_LISTEN_ONION));
@@ -444,14 +514,19 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-onion=<ip:port>", strprintf(_("Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: %s)"), "-proxy"));
     strUsage += HelpMessageOpt("-onlynet=<net>", _("Only connect to nodes in network <net> (ipv4, ipv6 or onion)"));
     strUsage += HelpMessageOpt("-permitbaremultisig", strprintf(_("Relay non-P2SH multisig (default: %u)"), DEFAULT_PERMIT_BAREMULTISIG));
+    strUsage += HelpMessageOpt("-requirezcspendblockhash", strprintf(_("Only relay and mine zerocoin spends that refer to the block of their accumulator (default: %u)"), DEFAULT_REQUIRE_ZEROCOIN_SPEND_BLOCK_HASH));
     strUsage += HelpMessageOpt("-peerbloomfilters", strprintf(_("Support filtering of blocks and transaction with bloom filters (default: %u)"), DEFAULT_PEERBLOOMFILTERS));
+    strUsage += HelpMessageOpt("-peerblockfilters", strprintf(_("Serve compact block filters to peers per BIP 157, requires -blockfilterindex (default: %u)"), DEFAULT_PEERBLOCKFILTERS));
     strUsage += HelpMessageOpt("-port=<port>", strprintf(_("Listen for connections on <port> (default: %u or testnet: %u)"), defaultChainParams->GetDefaultPort(), testnetChainParams->GetDefaultPort()));
     strUsage += HelpMessageOpt("-proxy=<ip:port>", _("Connect through SOCKS5 proxy"));
     strUsage += HelpMessageOpt("-proxyrandomize", strprintf(_("Randomize credentials for every proxy connection. This enables Tor stream isolation (default: %u)"), DEFAULT_PROXYRANDOMIZE));
     strUsage += HelpMessageOpt("-seednode=<ip>", _("Connect to a node to retrieve peer addresses, and disconnect"));
+    strUsage += HelpMessageOpt("-ghostnodemsgthreads=<n>", strprintf(_("Number of threads that process the ghostnode messages of peers, 0 processes them with the other messages (0-%d, default: %d)"), MAX_GHOSTNODE_MSG_THREADS, DEFAULT_GHOSTNODE_MSG_THREADS));
+    strUsage += HelpMessageOpt("-socketevents=<mode>", strprintf(_("How to wait for the sockets of peers to become ready, one of %s (default: %s)"), GetSupportedSocketEventsModes(), GetSocketEventsModeName(GetDefaultSocketEventsMode())));
     strUsage += HelpMessageOpt("-timeout=<n>", strprintf(_("Specify connection timeout in milliseconds (minimum: 1, default: %d)"), DEFAULT_CONNECT_TIMEOUT));
     strUsage += HelpMessageOpt("-torcontrol=<ip>:<port>", strprintf(_("Tor control port to use if onion listening enabled (default: %s)"), DEFAULT_TOR_CONTROL));
     strUsage += HelpMessageOpt("-torpassword=<pass>", _("Tor control port password (default: empty)"));
+    strUsage += HelpMessageOpt("-torprebuildcircuits=<n>", strprintf(_("Number of Tor circuits to build ahead through the control port (default: %d)"), DEFAULT_TOR_PREBUILD_CIRCUITS));
 #ifdef USE_UPNP
 #if USE_UPNP
     strUsage += HelpMessageOpt("-upnp", _("Use UPnP to map the listening port (default: 1 when listening and no -proxy)"));
@@ -472,19 +547,29 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageGroup(_("ZeroMQ notification options:"));
     strUsage += HelpMessageOpt("-zmqpubhashblock=<address>", _("Enable publish hash block in <address>"));
     strUsage += HelpMessageOpt("-zmqpubhashtx=<address>", _("Enable publish hash transaction in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubhashtemplate=<address>", _("Enable publish block template change in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawblock=<address>", _("Enable publish raw block in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtx=<address>", _("Enable publish raw transaction in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubblockdisconnect=<address>", _("Enable publish block disconnect in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubhashtxlock=<address>", _("Enable publish hash of InstantSend locked transaction in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubrawtxlock=<address>", _("Enable publish raw InstantSend locked transaction in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubghostnodestate=<address>", _("Enable publish ghostnode state change in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubzerocoinmint=<address>", _("Enable publish Zerocoin mint in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubzerocoinspend=<address>", _("Enable publish Zerocoin spend in <address>"));
 #endif
 
     strUsage += HelpMessageGroup(_("Debugging/Testing options:"));
     strUsage += HelpMessageOpt("-uacomment=<cmt>", _("Append comment to the user agent string"));
     if (showDebug)
     {
+        strUsage += HelpMessageOpt("-blockconnecttrace=<file>", "Write the phases of connecting each block to <file> in Chrome trace event format, see also getblockconnectstats");
         strUsage += HelpMessageOpt("-checkblocks=<n>", strprintf(_("How many blocks to check at startup (default: %u, 0 = all)"), DEFAULT_CHECKBLOCKS));
+        strUsage += HelpMessageOpt("-checkblocksample=<n>", strprintf(_("How many blocks below -checkblocks to pick at random across the chain and check at startup, at -checklevel 2 at most (default: %u)"), DEFAULT_CHECKBLOCKSAMPLE));
         strUsage += HelpMessageOpt("-checklevel=<n>", strprintf(_("How thorough the block verification of -checkblocks is (0-4, default: %u)"), DEFAULT_CHECKLEVEL));
         strUsage += HelpMessageOpt("-checkblockindex", strprintf("Do a full consistency check for mapBlockIndex, setBlockIndexCandidates, chainActive and mapBlocksUnlinked occasionally. Also sets -checkmempool (default: %u)", defaultChainParams->DefaultConsistencyChecks()));
         strUsage += HelpMessageOpt("-checkmempool=<n>", strprintf("Run checks every <n> transactions (default: %u)", defaultChainParams->DefaultConsistencyChecks()));
         strUsage += HelpMessageOpt("-checkpoints", strprintf("Disable expensive verification for known chain history (default: %u)", DEFAULT_CHECKPOINTS_ENABLED));
+        strUsage += HelpMessageOpt("-cpuprofile=<n>", strprintf("Sample the stacks of the node's threads <n> times per second of CPU time, see dumpprofile (1-%d, default: %u)", MAX_CPU_PROFILE_FREQUENCY, DEFAULT_CPU_PROFILE_FREQUENCY));
         strUsage += HelpMessageOpt("-disablesafemode", strprintf("Disable safemode, override a real safe mode event (default: %u)", DEFAULT_DISABLE_SAFEMODE));
         strUsage += HelpMessageOpt("-deprecatedrpc=<method>", "Allows deprecated RPC method(s) to be used");
         strUsage += HelpMessageOpt("-testsafemode", strprintf("Force safe mode (default: %u)", DEFAULT_TESTSAFEMODE));
@@ -503,13 +588,20 @@ std::string HelpMessage(HelpMessageMode mode)
         _("If <category> is not supplied or if <category> = 1, output all debugging information.") + " " + _("<category> can be:") + " " + ListLogCategories() + ".");
     strUsage += HelpMessageOpt("-debugexclude=<category>", strprintf(_("Exclude debugging information for a category. Can be used in conjunction with -debug=1 to output debug logs for all categories except one or more specified categories.")));
     strUsage += HelpMessageOpt("-help-debug", _("Show all debugging options (usage: --help -help-debug)"));
+    strUsage += HelpMessageOpt("-asynclog", strprintf(_("Write the debug log from a background thread (default: %u)"), DEFAULT_ASYNCLOG));
     strUsage += HelpMessageOpt("-logips", strprintf(_("Include IP addresses in debug output (default: %u)"), DEFAULT_LOGIPS));
+    strUsage += HelpMessageOpt("-lograte=<n>", strprintf(_("Write at most <n> debug messages per second of each category, 0 for no limit (default: %u)"), DEFAULT_LOGRATE));
     strUsage += HelpMessageOpt("-logtimestamps", strprintf(_("Prepend debug output with timestamp (default: %u)"), DEFAULT_LOGTIMESTAMPS));
     if (showDebug)
     {
+        strUsage += HelpMessageOpt("-lockprofile", strprintf("Record how long locks wait for and hold their critical sections, see getlockstats (default: %u)", DEFAULT_LOCK_PROFILE));
         strUsage += HelpMessageOpt("-logtimemicros", strprintf("Add microsecond precision to debug timestamps (default: %u)", DEFAULT_LOGTIMEMICROS));
         strUsage += HelpMessageOpt("-mocktime=<n>", "Replace actual time with <n> seconds since epoch (default: 0)");
         strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf("Limit sum of signature cache and script execution cache sizes to <n> MiB (default: %u)", DEFAULT_MAX_SIG_CACHE_SIZE));
+        strUsage += HelpMessageOpt("-maxpowcachesize=<n>", strprintf("Limit proof-of-work cache size to <n> MiB (default: %u)", DEFAULT_MAX_POW_CACHE_SIZE));
+        strUsage += HelpMessageOpt("-checkzerocoinparams", strprintf("Derive the zerocoin parameters from the modulus at startup and compare them with the built-in ones (default: %u)", DEFAULT_CHECK_ZEROCOIN_PARAMS));
+        strUsage += HelpMessageOpt("-maxzerocoinspendcachesize=<n>", strprintf("Limit zerocoin spend verification cache size to <n> MiB (default: %u)", DEFAULT_MAX_ZEROCOIN_SPEND_CACHE_SIZE));
+        strUsage += HelpMessageOpt("-maxtxlookupcachesize=<n>", strprintf("Limit the cache of confirmed transactions looked up by getrawtransaction and REST to <n> MiB (default: %u)", DEFAULT_MAX_TX_LOOKUP_CACHE_SIZE));
         strUsage += HelpMessageOpt("-maxtipage=<n>", strprintf("Maximum tip age in seconds to consider node in initial block download (default: %u)", DEFAULT_MAX_TIP_AGE));
     }
     strUsage += HelpMessageOpt("-maxtxfee=<amt>", strprintf(_("Maximum total fees (in %s) to use in a single wallet transaction or raw transaction; setting this too low may abort large transactions (default: %s)"),
@@ -541,6 +633,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageGroup(_("Block creation options:"));
     strUsage += HelpMessageOpt("-blockmaxweight=<n>", strprintf(_("Set maximum BIP141 block weight (default: %d)"), DEFAULT_BLOCK_MAX_WEIGHT));
     strUsage += HelpMessageOpt("-blockmaxsize=<n>", _("Set maximum BIP141 block weight to this * 4. Deprecated, use blockmaxweight"));
+    strUsage += HelpMessageOpt("-genproclimit=<n>", strprintf(_("Set the number of threads used by generate and generatetoaddress, 0 = one per core (default: %d)"), DEFAULT_GENERATE_THREADS));
     strUsage += HelpMessageOpt("-blockmintxfee=<amt>", strprintf(_("Set lowest fee rate (in %s/kB) for transactions to be included in block creation. (default: %s)"), CURRENCY_UNIT, FormatMoney(DEFAULT_BLOCK_MIN_TX_FEE)));
     if (showDebug)
         strUsage += HelpMessageOpt("-blockversion=<n>", "Override block version to test forking scenarios");
@@ -548,6 +641,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageGroup(_("RPC server options:"));
     strUsage += HelpMessageOpt("-server", _("Accept command line and JSON-RPC commands"));
     strUsage += HelpMessageOpt("-rest", strprintf(_("Accept public REST requests (default: %u)"), DEFAULT_REST_ENABLE));
+    strUsage += HelpMessageOpt("-metrics", strprintf(_("Serve node counters in the Prometheus text format at /metrics on the RPC port, subject to -rpcallowip (default: %u)"), DEFAULT_HTTP_METRICS));
     strUsage += HelpMessageOpt("-rpcbind=<addr>[:port]", _("Bind to given address to listen for JSON-RPC connections. This option is ignored unless -rpcallowip is also passed. Port is optional and overrides -rpcport. Use [host]:port notation for IPv6. This option can be specified multiple times (default: 127.0.0.1 and ::1 i.e., localhost, or if -rpcallowip has been specified, 0.0.0.0 and :: i.e., all addresses)"));
     strUsage += HelpMessageOpt("-rpccookiefile=<loc>", _("Location of the auth cookie (default: data dir)"));
     strUsage += HelpMessageOpt("-rpcuser=<user>", _("Username for JSON-RPC connections"));
@@ -557,8 +651,12 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-rpcallowip=<ip>", _("Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times"));
     strUsage += HelpMessageOpt("-rpcserialversion", strprintf(_("Sets the serialization of raw transaction or block hex returned in non-verbose mode, non-segwit(0) or segwit(1) (default: %d)"), DEFAULT_RPC_SERIALIZE_VERSION));
     strUsage += HelpMessageOpt("-rpcthreads=<n>", strprintf(_("Set the number of threads to service RPC calls (default: %d)"), DEFAULT_HTTP_THREADS));
+    strUsage += HelpMessageOpt("-rpcpriority=<method>:<priority>", _("Queue calls to an RPC method, or requests to a REST path, at high, normal or bulk priority. This option can be specified multiple times"));
+    strUsage += HelpMessageOpt("-rpcmethodlimit=<method>:<n>", _("Run at most <n> calls to an RPC method, or requests to a REST path, at once. This option can be specified multiple times"));
+    strUsage += HelpMessageOpt("-rpcbatchthreads=<n>", strprintf(_("Execute the read-only calls of a JSON-RPC batch on up to <n> threads (default: %d)"), DEFAULT_RPC_BATCH_THREADS));
+    strUsage += HelpMessageOpt("-rpcbulkthreads=<n>", strprintf(_("Run at most <n> bulk priority RPC calls at once, 0 for half of -rpcthreads (default: %d)"), DEFAULT_HTTP_BULK_THREADS));
     if (showDebug) {
-        strUsage += HelpMessageOpt("-rpcworkqueue=<n>", strprintf("Set the depth of the work queue to service RPC calls (default: %d)", DEFAULT_HTTP_WORKQUEUE));
+        strUsage += HelpMessageOpt("-rpcworkqueue=<n>", strprintf("Set the depth of each of the work queues to service RPC calls (default: %d)", DEFAULT_HTTP_WORKQUEUE));
         strUsage += HelpMessageOpt("-rpcservertimeout=<n>", strprintf("Timeout during HTTP requests (default: %d)", DEFAULT_HTTP_SERVER_TIMEOUT));
     }
 
@@ -741,6 +839,36 @@ void ThreadImport(std::vector<fs::path> vImportFiles)
         LoadMempool();
         fDumpMempoolLater = !fRequestShutdown;
     }
+
+    // Pruning nodes keep few block files, which are compressed as they are written
+    if (fCompressBlocks && !fPruneMode)
+        CompressBlockFiles(chainparams);
+}
+
+/** Run a startup step that doesn't depend on the block chain in its own thread, while the
+ *  chain loads. WaitInitStep() joins it where its result is first needed. */
+static std::future<bool> StartInitStep(const std::string& strName, std::function<bool()> step)
+{
+    return std::async(std::launch::async, [strName, step]() {
+        RenameThread(("nix-init-" + strName).c_str());
+        int64_t nStart = GetTimeMillis();
+        bool fRet = false;
+        try {
+            fRet = step();
+        } catch (const std::exception& e) {
+            LogPrintf("%s: %s\n", strName, e.what());
+        }
+        LogPrintf(" %s %15dms (in parallel)\n", strName, GetTimeMillis() - nStart);
+        return fRet;
+    });
+}
+
+static bool WaitInitStep(const std::string& strName, std::future<bool>& step)
+{
+    int64_t nStart = GetTimeMillis();
+    bool fRet = step.get();
+    LogPrint(BCLog::BENCH, " %s waited for %dms\n", strName, GetTimeMillis() - nStart);
+    return fRet;
 }
 
 /** Sanity checks
@@ -762,6 +890,11 @@ bool InitSanityCheck(void)
         return false;
     }
 
+    if (gArgs.GetBoolArg("-checkzerocoinparams", DEFAULT_CHECK_ZEROCOIN_PARAMS) && !CheckZerocoinParams()) {
+        InitError("Zerocoin parameters sanity check failure. Aborting.");
+        return false;
+    }
+
     return true;
 }
 
@@ -777,6 +910,8 @@ bool AppInitServers()
         return false;
     if (gArgs.GetBoolArg("-rest", DEFAULT_REST_ENABLE) && !StartREST())
         return false;
+    if (gArgs.GetBoolArg("-metrics", DEFAULT_HTTP_METRICS) && !StartHTTPMetrics())
+        return false;
     if (!StartHTTPServer())
         return false;
     return true;
@@ -960,6 +1095,7 @@ void InitLogging()
     fLogTimestamps = gArgs.GetBoolArg("-logtimestamps", DEFAULT_LOGTIMESTAMPS);
     fLogTimeMicros = gArgs.GetBoolArg("-logtimemicros", DEFAULT_LOGTIMEMICROS);
     fLogIPs = gArgs.GetBoolArg("-logips", DEFAULT_LOGIPS);
+    nLogRateLimit = std::max<int64_t>(0, gArgs.GetArg("-lograte", DEFAULT_LOGRATE));
 
     LogPrintf("\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n");
     std::string version_string = FormatFullVersion();
@@ -976,6 +1112,7 @@ namespace { // Variables internal to initialization process only
 int nMaxConnections;
 int nUserMaxConnections;
 int nFD;
+SocketEventsMode socketEventsMode = SOCKETEVENTS_SELECT;
 ServiceFlags nLocalServices = ServiceFlags(NODE_NETWORK | NODE_NETWORK_LIMITED);
 
 } // namespace
@@ -1052,7 +1189,23 @@ bool AppInitParameterInteraction()
     if (gArgs.GetArg("-prune", 0)) {
         if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX))
             return InitError(_("Prune mode is incompatible with -txindex."));
-    }
+        // the background indexes read old blocks and their undo data while catching up
+        if (gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) || gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX))
+            return InitError(_("Prune mode is incompatible with -addressindex and -spentindex."));
+        if (gArgs.GetBoolArg("-collateralindex", DEFAULT_COLLATERALINDEX))
+            return InitError(_("Prune mode is incompatible with -collateralindex."));
+        if (gArgs.GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX))
+            return InitError(_("Prune mode is incompatible with -blockfilterindex."));
+    }
+
+    fCompressBlocks = gArgs.GetBoolArg("-compressblocks", DEFAULT_COMPRESS_BLOCKS);
+    fAddressIndex = gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
+    fSpentIndex = gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
+    fTimestampIndex = gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
+    fCollateralIndex = gArgs.GetBoolArg("-collateralindex", DEFAULT_COLLATERALINDEX);
+    fBlockFilterIndex = gArgs.GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX);
+    if (gArgs.GetBoolArg("-peerblockfilters", DEFAULT_PEERBLOCKFILTERS) && !fBlockFilterIndex)
+        return InitError(_("Cannot set -peerblockfilters without -blockfilterindex."));
 
     // -bind and -whitebind can't be set when not listening
     size_t nUserBind = gArgs.GetArgs("-bind").size() + gArgs.GetArgs("-whitebind").size();
@@ -1060,13 +1213,19 @@ bool AppInitParameterInteraction()
         return InitError("Cannot set -bind or -whitebind together with -listen=0");
     }
 
+    std::string strSocketEvents = gArgs.GetArg("-socketevents", GetSocketEventsModeName(GetDefaultSocketEventsMode()));
+    if (!ParseSocketEventsMode(strSocketEvents, socketEventsMode))
+        return InitError(strprintf(_("Invalid -socketevents ('%s'), choose one of %s"), strSocketEvents, GetSupportedSocketEventsModes()));
+
     // Make sure enough file descriptors are available
     int nBind = std::max(nUserBind, size_t(1));
     nUserMaxConnections = gArgs.GetArg("-maxconnections", DEFAULT_MAX_PEER_CONNECTIONS);
     nMaxConnections = std::max(nUserMaxConnections, 0);
 
-    // Trim requested connection counts, to fit into system limitations
-    nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS - MAX_ADDNODE_CONNECTIONS)), 0);
+    // Trim requested connection counts, to fit into system limitations. Only select() can't wait on
+    // sockets past FD_SETSIZE.
+    if (socketEventsMode == SOCKETEVENTS_SELECT)
+        nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS - MAX_ADDNODE_CONNECTIONS)), 0);
     nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS + MAX_ADDNODE_CONNECTIONS);
     if (nFD < MIN_CORE_FILEDESCRIPTORS)
         return InitError(_("Not enough file descriptors available."));
@@ -1128,6 +1287,7 @@ bool AppInitParameterInteraction()
         mempool.setSanityCheck(1.0 / ratio);
     }
     fCheckBlockIndex = gArgs.GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
+    g_lock_profile = gArgs.GetBoolArg("-lockprofile", DEFAULT_LOCK_PROFILE);
     fCheckpointsEnabled = gArgs.GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
 
     hashAssumeValid = uint256S(gArgs.GetArg("-assumevalid", chainparams.GetConsensus().defaultAssumeValid.GetHex()));
@@ -1174,6 +1334,25 @@ bool AppInitParameterInteraction()
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
 
+    // -zcthreads=0 follows the number of script verification threads, the zerocoin proofs of a block are
+    // verified from those threads and shouldn't compete with them for more cores than they have
+    int nZerocoinThreads = gArgs.GetArg("-zcthreads", DEFAULT_ZEROCOIN_THREADS);
+    if (nZerocoinThreads == 0)
+        nZerocoinThreads = std::max(nScriptCheckThreads, 1);
+    else if (nZerocoinThreads < 0)
+        nZerocoinThreads = std::max(nZerocoinThreads + GetNumCores(), 1);
+    libzerocoin::SetParallelTasksThreadCount(nZerocoinThreads);
+
+    CDBOptions dbOptions;
+    std::string strDBOptionError;
+    if (!ApplyDBOptionArgs("", dbOptions, strDBOptionError))
+        return InitError(strDBOptionError);
+    if (gArgs.GetArg("-dbcompact", DEFAULT_DB_COMPACT_INTERVAL) < 0)
+        return InitError(_("-dbcompact cannot be configured with a negative value."));
+    int nChainstateShards = gArgs.GetArg("-chainstateshards", DEFAULT_CHAINSTATE_SHARDS);
+    if (nChainstateShards < 1 || nChainstateShards > MAX_CHAINSTATE_SHARDS)
+        return InitError(strprintf(_("-chainstateshards must be between 1 and %d"), MAX_CHAINSTATE_SHARDS));
+
     // block pruning; get the amount of disk space (in MiB) to allot for block & undo files
     int64_t nPruneArg = gArgs.GetArg("-prune", 0);
     if (nPruneArg < 0) {
@@ -1239,6 +1418,7 @@ bool AppInitParameterInteraction()
 #endif
 
     fIsBareMultisigStd = gArgs.GetBoolArg("-permitbaremultisig", DEFAULT_PERMIT_BAREMULTISIG);
+    fRequireZerocoinSpendBlockHash = gArgs.GetBoolArg("-requirezcspendblockhash", DEFAULT_REQUIRE_ZEROCOIN_SPEND_BLOCK_HASH);
     fAcceptDatacarrier = gArgs.GetBoolArg("-datacarrier", DEFAULT_ACCEPT_DATACARRIER);
     nMaxDatacarrierBytes = gArgs.GetArg("-datacarriersize", nMaxDatacarrierBytes);
 
@@ -1247,6 +1427,8 @@ bool AppInitParameterInteraction()
 
     if (gArgs.GetBoolArg("-peerbloomfilters", DEFAULT_PEERBLOOMFILTERS))
         nLocalServices = ServiceFlags(nLocalServices | NODE_BLOOM);
+    if (gArgs.GetBoolArg("-peerblockfilters", DEFAULT_PEERBLOCKFILTERS))
+        nLocalServices = ServiceFlags(nLocalServices | NODE_COMPACT_FILTERS);
 
     if (gArgs.GetArg("-rpcserialversion", DEFAULT_RPC_SERIALIZE_VERSION) < 0)
         return InitError("rpcserialversion must be non-negative.");
@@ -1256,6 +1438,8 @@ bool AppInitParameterInteraction()
 
     nMaxTipAge = gArgs.GetArg("-maxtipage", DEFAULT_MAX_TIP_AGE);
 
+    fFastBlockRelay = gArgs.GetBoolArg("-fastblockrelay", DEFAULT_FASTBLOCKRELAY);
+
     fEnableReplacement = gArgs.GetBoolArg("-mempoolreplacement", DEFAULT_ENABLE_REPLACEMENT);
     if ((!fEnableReplacement) && gArgs.IsArgSet("-mempoolreplacement")) {
         // Minimal effort at forwards compatibility
@@ -1318,6 +1502,12 @@ bool AppInitSanityChecks()
     // Initialize elliptic curve code
     std::string sha256_algo = SHA256AutoDetect();
     LogPrintf("Using the '%s' SHA256 implementation\n", sha256_algo);
+    std::string sha512_algo = SHA512AutoDetect();
+    LogPrintf("Using the '%s' SHA512 implementation\n", sha512_algo);
+    std::string ripemd160_algo = RIPEMD160AutoDetect();
+    LogPrintf("Using the '%s' RIPEMD160 implementation\n", ripemd160_algo);
+    std::string lyra2_algo = lyra2re_autodetect();
+    LogPrintf("Using the '%s' Lyra2REv2 implementation\n", lyra2_algo);
     RandomInit();
     ECC_Start();
     ECC_Start_Stealth();
@@ -1362,6 +1552,8 @@ bool AppInitMain()
         if (!OpenDebugLog()) {
             return InitError(strprintf("Could not open debug log file %s", GetDebugLogPath().string()));
         }
+        if (gArgs.GetBoolArg("-asynclog", DEFAULT_ASYNCLOG))
+            StartDebugLogWriter();
     }
 
     if (!fLogTimestamps)
@@ -1380,20 +1572,42 @@ bool AppInitMain()
             gArgs.GetArg("-datadir", ""), fs::current_path().string());
     }
 
+    int nProfileFrequency = gArgs.GetArg("-cpuprofile", DEFAULT_CPU_PROFILE_FREQUENCY);
+    if (nProfileFrequency != 0) {
+        if (!CpuProfilerSupported())
+            return InitError(_("-cpuprofile is not supported on this platform"));
+        if (nProfileFrequency < 0 || nProfileFrequency > MAX_CPU_PROFILE_FREQUENCY || !StartCpuProfiler(nProfileFrequency))
+            return InitError(strprintf(_("Cannot sample %d times per second with -cpuprofile"), nProfileFrequency));
+        LogPrintf("Sampling stacks %d times per second of CPU time\n", nProfileFrequency);
+    }
+
     InitSignatureCache();
     InitScriptExecutionCache();
+    InitZerocoinSpendCache();
+    InitPoWCache();
+    InitTxLookupCache();
 
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
+    LogPrintf("Using %u threads for zerocoin proof computations\n", libzerocoin::GetParallelTasksStats().nThreads);
     if (nScriptCheckThreads) {
-        for (int i=0; i<nScriptCheckThreads-1; i++)
+        for (int i=0; i<nScriptCheckThreads-1; i++) {
             threadGroup.create_thread(&ThreadScriptCheck);
+            threadGroup.create_thread(&ThreadZerocoinSpendCheck);
+            threadGroup.create_thread(&ThreadPoWCheck);
+            threadGroup.create_thread(&ThreadTxStructureCheck);
+            threadGroup.create_thread(&ThreadGhostnodeSigCheck);
+        }
     }
 
-    // Start the lightweight task scheduler thread
+    // Start the lightweight task scheduler threads
+    int nSchedulerThreads = std::max(1, std::min((int)gArgs.GetArg("-schedulerthreads", DEFAULT_SCHEDULER_THREADS), MAX_SCHEDULER_THREADS));
     CScheduler::Function serviceLoop = boost::bind(&CScheduler::serviceQueue, &scheduler);
-    threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
+    for (int i = 0; i < nSchedulerThreads; i++)
+        threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop));
 
     GetMainSignals().RegisterBackgroundSignalScheduler(scheduler);
+    // Fee estimator updates run on the validation interface queue rather than under cs_main
+    mempool.SetEstimatorQueue(CallFunctionInValidationInterfaceQueue);
     GetMainSignals().RegisterWithMempoolSignals(mempool);
 
     /* Register RPC commands regardless of -server setting so they will be
@@ -1434,7 +1648,7 @@ bool AppInitMain()
     CConnman& connman = *g_connman;
 
     peerLogic.reset(new PeerLogicValidation(&connman, scheduler));
-    RegisterValidationInterface(peerLogic.get());
+    RegisterValidationInterface(peerLogic.get(), "net");
 
     // sanitize comments per BIP-0014, format user agent and check total size
     std::vector<std::string> uacomments;
@@ -1556,7 +1770,7 @@ bool AppInitMain()
     pzmqNotificationInterface = CZMQNotificationInterface::Create();
 
     if (pzmqNotificationInterface) {
-        RegisterValidationInterface(pzmqNotificationInterface);
+        RegisterValidationInterface(pzmqNotificationInterface, "zmq", ValidationQueuePolicy::DROP);
     }
 #endif
     uint64_t nMaxOutboundLimit = 0; //unlimited unless -maxuploadtarget is set
@@ -1568,8 +1782,18 @@ bool AppInitMain()
 
     // ********************************************************* Step 7: load block chain
 
+    if (gArgs.IsArgSet("-blockconnecttrace")) {
+        fs::path pathTrace = fs::path(gArgs.GetArg("-blockconnecttrace", DEFAULT_BLOCK_CONNECT_TRACE));
+        if (!pathTrace.is_complete()) pathTrace = GetDataDir() / pathTrace;
+        if (!StartBlockConnectTrace(pathTrace))
+            return InitError(strprintf(_("Cannot open block connection trace file %s"), pathTrace.string()));
+    }
+
     fReindex = gArgs.GetBoolArg("-reindex", false);
-    bool fReindexChainState = gArgs.GetBoolArg("-reindex-chainstate", false);
+    fReindexChainStateFast = !fReindex && gArgs.GetBoolArg("-reindex-chainstate-fast", false);
+    bool fReindexChainState = gArgs.GetBoolArg("-reindex-chainstate", false) || fReindexChainStateFast;
+    if (fReindexChainStateFast)
+        LogPrintf("Rebuilding the chain state, re-applying only the coins of blocks validated before\n");
 
     // cache size calculations
     int64_t nTotalCache = (gArgs.GetArg("-dbcache", nDefaultDbCache) << 20);
@@ -1578,6 +1802,18 @@ bool AppInitMain()
     int64_t nBlockTreeDBCache = nTotalCache / 8;
     nBlockTreeDBCache = std::min(nBlockTreeDBCache, (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX) ? nMaxBlockDBAndTxIndexCache : nMaxBlockDBCache) << 20);
     nTotalCache -= nBlockTreeDBCache;
+    int64_t nZerocoinDBCache = std::min(nTotalCache / 16, nMaxZerocoinDBCache << 20);
+    nTotalCache -= nZerocoinDBCache;
+    int64_t nAddressIndexDBCache = fAddressIndex ? std::min(nTotalCache / 8, nMaxAddressIndexDBCache << 20) : 0;
+    nTotalCache -= nAddressIndexDBCache;
+    int64_t nSpentIndexDBCache = fSpentIndex ? std::min(nTotalCache / 16, nMaxSpentIndexDBCache << 20) : 0;
+    nTotalCache -= nSpentIndexDBCache;
+    int64_t nTimestampIndexDBCache = fTimestampIndex ? std::min(nTotalCache / 64, nMaxTimestampIndexDBCache << 20) : 0;
+    nTotalCache -= nTimestampIndexDBCache;
+    int64_t nCollateralIndexDBCache = fCollateralIndex ? std::min(nTotalCache / 64, nMaxCollateralIndexDBCache << 20) : 0;
+    nTotalCache -= nCollateralIndexDBCache;
+    int64_t nBlockFilterIndexDBCache = fBlockFilterIndex ? std::min(nTotalCache / 32, nMaxBlockFilterIndexDBCache << 20) : 0;
+    nTotalCache -= nBlockFilterIndexDBCache;
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
@@ -1585,9 +1821,41 @@ bool AppInitMain()
     int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
+    LogPrintf("* Using %.1fMiB for zerocoin database\n", nZerocoinDBCache * (1.0 / 1024 / 1024));
+    if (fAddressIndex) {
+        LogPrintf("* Using %.1fMiB for address index database\n", nAddressIndexDBCache * (1.0 / 1024 / 1024));
+    }
+    if (fSpentIndex) {
+        LogPrintf("* Using %.1fMiB for spent index database\n", nSpentIndexDBCache * (1.0 / 1024 / 1024));
+    }
+    if (fTimestampIndex) {
+        LogPrintf("* Using %.1fMiB for timestamp index database\n", nTimestampIndexDBCache * (1.0 / 1024 / 1024));
+    }
+    if (fCollateralIndex) {
+        LogPrintf("* Using %.1fMiB for collateral index database\n", nCollateralIndexDBCache * (1.0 / 1024 / 1024));
+    }
+    if (fBlockFilterIndex) {
+        LogPrintf("* Using %.1fMiB for block filter index database\n", nBlockFilterIndexDBCache * (1.0 / 1024 / 1024));
+    }
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set (plus up to %.1fMiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
 
+    // Read the caches that don't depend on the block chain while it loads
+    std::future<bool> feeEstimatesRead = StartInitStep("fee estimates", []() {
+        fs::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
+        CAutoFile est_filein(fsbridge::fopen(est_path, "rb"), SER_DISK, CLIENT_VERSION);
+        // Allowed to fail as this file IS missing on first startup.
+        return est_filein.IsNull() || ::feeEstimator.Read(est_filein);
+    });
+    std::future<bool> fulfilledRead = StartInitStep("netfulfilled", []() {
+        CFlatDB<CNetFulfilledRequestManager> flatdb4("netfulfilled.dat", "magicFulfilledCache");
+        return flatdb4.Load(netfulfilledman);
+    });
+    std::vector<CGhostnode> vCachedGhostnodes;
+    std::future<bool> ghostnodesRead;
+    if (!gArgs.GetBoolArg("-litemode", false))
+        ghostnodesRead = StartInitStep("ghostnode cache", [&vCachedGhostnodes]() { return ReadGhostnodes(vCachedGhostnodes); });
+
     bool fLoaded = false;
     while (!fLoaded && !fRequestShutdown) {
         bool fReset = fReindex;
@@ -1606,6 +1874,8 @@ bool AppInitMain()
                 // fails if it's still open from the previous loop. Close it first:
                 pblocktree.reset();
                 pblocktree.reset(new CBlockTreeDB(nBlockTreeDBCache, false, fReset));
+                pzerocoindb.reset();
+                pzerocoindb.reset(new CZerocoinDB(nZerocoinDBCache, false, fReset));
 
                 if (fReset) {
                     pblocktree->WriteReindexing(true);
@@ -1656,7 +1926,7 @@ bool AppInitMain()
                 // At this point we're either in reindex or we've loaded a useful
                 // block tree into mapBlockIndex!
 
-                pcoinsdbview.reset(new CCoinsViewDB(nCoinDBCache, false, fReset || fReindexChainState));
+                pcoinsdbview.reset(new CCoinsViewDB(nCoinDBCache, false, fReset || fReindexChainState, gArgs.GetArg("-chainstateshards", DEFAULT_CHAINSTATE_SHARDS)));
                 pcoinscatcher.reset(new CCoinsViewErrorCatcher(pcoinsdbview.get()));
 
                 // If necessary, upgrade from older database format.
@@ -1674,6 +1944,9 @@ bool AppInitMain()
 
                 // The on-disk coinsdb is now in a good state, create the cache
                 pcoinsTip.reset(new CCoinsViewCache(pcoinscatcher.get()));
+                // FlushStateToDisk writes the coins incrementally, oldest modifications first
+                pcoinsTip->SetTrackDirty(true);
+                pcoinsTip->SetCountMetrics(true);
 
                 bool is_coinsview_empty = fReset || fReindexChainState || pcoinsTip->GetBestBlock().IsNull();
                 if (!is_coinsview_empty) {
@@ -1698,9 +1971,9 @@ bool AppInitMain()
 
                 if (!is_coinsview_empty) {
                     uiInterface.InitMessage(_("Verifying blocks..."));
-                    if (fHavePruned && gArgs.GetArg("-checkblocks", DEFAULT_CHECKBLOCKS) > MIN_BLOCKS_TO_KEEP) {
+                    if (fHavePruned && gArgs.GetArg("-checkblocks", DEFAULT_CHECKBLOCKS) > GetPruneMinBlocksToKeep()) {
                         LogPrintf("Prune: pruned datadir may not have more than %d blocks; only checking available blocks",
-                            MIN_BLOCKS_TO_KEEP);
+                            GetPruneMinBlocksToKeep());
                     }
 
                     {
@@ -1715,11 +1988,13 @@ bool AppInitMain()
                         }
                     }
 
+                    int64_t nVerifyStart = GetTimeMillis();
                     if (!CVerifyDB().VerifyDB(chainparams, pcoinsdbview.get(), gArgs.GetArg("-checklevel", DEFAULT_CHECKLEVEL),
-                                  gArgs.GetArg("-checkblocks", DEFAULT_CHECKBLOCKS))) {
+                                  gArgs.GetArg("-checkblocks", DEFAULT_CHECKBLOCKS), gArgs.GetArg("-checkblocksample", DEFAULT_CHECKBLOCKSAMPLE))) {
                         strLoadError = _("Corrupted block database detected");
                         break;
                     }
+                    LogPrintf(" verify blocks %15dms\n", GetTimeMillis() - nVerifyStart);
                 }
             } catch (const std::exception& e) {
                 LogPrintf("%s\n", e.what());
@@ -1760,15 +2035,40 @@ bool AppInitMain()
     }
     if (fLoaded) {
         LogPrintf(" block index %15dms\n", GetTimeMillis() - nStart);
+        fDumpBlockIndexLater = true;
     }
 
-    fs::path est_path = GetDataDir() / FEE_ESTIMATES_FILENAME;
-    CAutoFile est_filein(fsbridge::fopen(est_path, "rb"), SER_DISK, CLIENT_VERSION);
-    // Allowed to fail as this file IS missing on first startup.
-    if (!est_filein.IsNull())
-        ::feeEstimator.Read(est_filein);
+    WaitInitStep("fee estimates", feeEstimatesRead);
     fFeeEstimatesInitialized = true;
 
+    // ********************************************************* Step 7a: start indexers
+    // Indexes built inline before are in sync with the loaded chain, indexes turned on later
+    // catch up from the genesis block in the background
+    UpgradeInlineIndex("addressindex");
+    UpgradeInlineIndex("spentindex");
+    UpgradeInlineIndex("timestampindex");
+    if (fAddressIndex) {
+        g_addressindex = MakeUnique<CAddressIndexer>(nAddressIndexDBCache, false, fReindex,
+            gArgs.GetBoolArg("-addressindexcompression", DEFAULT_ADDRESSINDEX_COMPRESSION));
+        g_addressindex->Start();
+    }
+    if (fSpentIndex) {
+        g_spentindex = MakeUnique<CSpentIndexer>(nSpentIndexDBCache, false, fReindex);
+        g_spentindex->Start();
+    }
+    if (fTimestampIndex) {
+        g_timestampindex = MakeUnique<CTimestampIndexer>(nTimestampIndexDBCache, false, fReindex);
+        g_timestampindex->Start();
+    }
+    if (fCollateralIndex) {
+        g_collateralindex = MakeUnique<CCollateralIndexer>(nCollateralIndexDBCache, false, fReindex);
+        g_collateralindex->Start();
+    }
+    if (fBlockFilterIndex) {
+        g_blockfilterindex = MakeUnique<CBlockFilterIndexer>(BlockFilterType::BASIC, nBlockFilterIndexDBCache, false, fReindex);
+        g_blockfilterindex->Start();
+    }
+
     // ********************************************************* Step 8: load wallet
 #ifdef ENABLE_WALLET
     if (!OpenWallets())
@@ -1870,6 +2170,9 @@ bool AppInitMain()
     connOptions.nSendBufferMaxSize = 1000*gArgs.GetArg("-maxsendbuffer", DEFAULT_MAXSENDBUFFER);
     connOptions.nReceiveFloodSize = 1000*gArgs.GetArg("-maxreceivebuffer", DEFAULT_MAXRECEIVEBUFFER);
     connOptions.m_added_nodes = gArgs.GetArgs("-addnode");
+    connOptions.socketEventsMode = socketEventsMode;
+    connOptions.nGhostnodeMsgThreads = std::max(0, std::min((int)gArgs.GetArg("-ghostnodemsgthreads", DEFAULT_GHOSTNODE_MSG_THREADS), MAX_GHOSTNODE_MSG_THREADS));
+    connOptions.nConnectThreads = std::max(0, std::min((int)gArgs.GetArg("-connectthreads", DEFAULT_CONNECT_THREADS), MAX_OUTBOUND_CONNECTIONS));
 
     connOptions.nMaxOutboundTimeframe = nMaxOutboundTimeframe;
     connOptions.nMaxOutboundLimit = nMaxOutboundLimit;
@@ -1988,9 +2291,17 @@ bool AppInitMain()
 
     // ********************************************************* Step 11b: Load cache data
 
+    // Read in parallel with the block chain in step 7
+    WaitInitStep("netfulfilled", fulfilledRead);
+    if (ghostnodesRead.valid())
+        WaitInitStep("ghostnode cache", ghostnodesRead);
 
-    CFlatDB<CNetFulfilledRequestManager> flatdb4("netfulfilled.dat", "magicFulfilledCache");
-    flatdb4.Load(netfulfilledman);
+    if (!fLiteMode) {
+        uiInterface.InitMessage(_("Loading ghostnode cache..."));
+        int64_t nGhostnodesStart = GetTimeMillis();
+        LoadGhostnodes(vCachedGhostnodes);
+        LogPrintf(" ghostnodes %15dms\n", GetTimeMillis() - nGhostnodesStart);
+    }
 
 
     // ********************************************************* Step 11c: update block tip in Dash modules
@@ -2001,9 +2312,17 @@ bool AppInitMain()
     mnpayments.UpdatedBlockTip(chainActive.Tip());
     ghostnodeSync.UpdatedBlockTip(chainActive.Tip());
 
-    // ********************************************************* Step 11d: start ghostnode thread
+    if (!fLiteMode) {
+        RegisterValidationInterface(&instantsend, "instantsend");
+    }
+
+    // ********************************************************* Step 11d: schedule ghostnode maintenance
+
+    ScheduleDarkSendMaintenance(scheduler);
 
-    threadGroup.create_thread(boost::bind(&ThreadCheckDarkSendPool));
+    int nCompactInterval = gArgs.GetArg("-dbcompact", DEFAULT_DB_COMPACT_INTERVAL);
+    if (nCompactInterval > 0)
+        threadGroup.create_thread(boost::bind(&ThreadDBCompaction, nCompactInterval));
 
 
     // ********************************************************* Step 12: finished
@@ -21,6 +21,8 @@ bool ShutdownRequested();
 /** Interrupt threads */
 void Interrupt();
 void Shutdown();
+/** The scheduler running the node's background tasks */
+CScheduler& GetScheduler();
 //!Initialize the logging infrastructure
 void InitLogging();
 //!Parameter interaction: change current parameters depending on various rules
@@ -0,0 +1,80 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_LAZYCONTAINER_H
+#define BITCOIN_LAZYCONTAINER_H
+
+#include <serialize.h>
+
+#include <memory>
+#include <utility>
+
+/* Map or set that is empty for most of the objects holding one, such as the zerocoin data of
+ * block index entries.
+ *
+ * The container is allocated on the first insert and freed when it's cleared, so an empty one
+ * costs the size of a pointer instead of that of a std::map or std::set. Lookups and iteration
+ * go through const iterators; an empty container hands out those of a shared empty instance.
+ */
+template <class C>
+class lazycontainer {
+private:
+    std::unique_ptr<C> p;
+
+    static const C& Empty() { static const C empty; return empty; }
+    C& Get() { if (!p) p.reset(new C()); return *p; }
+public:
+    typedef C base;
+    typedef typename C::const_iterator const_iterator;
+    typedef typename C::const_iterator iterator;
+    typedef typename C::size_type size_type;
+    typedef typename C::key_type key_type;
+    typedef typename C::value_type value_type;
+
+    lazycontainer() {}
+    lazycontainer(const lazycontainer& other) : p(other.empty() ? nullptr : new C(*other.p)) {}
+    lazycontainer(lazycontainer&& other) = default;
+
+    lazycontainer& operator=(const lazycontainer& other) { p.reset(other.empty() ? nullptr : new C(*other.p)); return *this; }
+    lazycontainer& operator=(lazycontainer&& other) = default;
+    lazycontainer& operator=(const C& c) { p.reset(c.empty() ? nullptr : new C(c)); return *this; }
+    lazycontainer& operator=(C&& c) { p.reset(c.empty() ? nullptr : new C(std::move(c))); return *this; }
+
+    //! The contents as the underlying container
+    const C& get() const                            { return p ? *p : Empty(); }
+    operator const C&() const                       { return get(); }
+    //! Whether the container is allocated, for memory accounting
+    bool allocated() const                          { return p != nullptr; }
+
+    // lookups
+    const_iterator find(const key_type& key) const  { return get().find(key); }
+    size_type count(const key_type& key) const      { return p ? p->count(key) : 0; }
+
+    // inserts allocate the container
+    std::pair<typename C::iterator, bool> insert(const value_type& value) { return Get().insert(value); }
+    template <class B = C>
+    typename B::mapped_type& operator[](const typename B::key_type& key) { return Get()[key]; }
+
+    bool empty() const                              { return !p || p->empty(); }
+    size_type size() const                          { return p ? p->size() : 0; }
+    void clear()                                    { p.reset(); }
+    const_iterator begin() const                    { return get().begin(); }
+    const_iterator end() const                      { return get().end(); }
+
+    template <typename Stream>
+    void Serialize(Stream& s) const
+    {
+        ::Serialize(s, get());
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s)
+    {
+        C c;
+        ::Unserialize(s, c);
+        *this = std::move(c);
+    }
+};
+
+#endif // BITCOIN_LAZYCONTAINER_H
@@ -11,7 +11,9 @@
  **/
 
 #include <stdexcept>
+#include <memory>
 #include <openssl/rand.h>
+#include "ParallelTasks.h"
 #include "Zerocoin.h"
 #include "../../amount.h"
 
@@ -187,7 +189,7 @@ void PrivateCoin::mintCoinFast(const CoinDenomination denomination) {
 
 	// Manually compute a Pedersen commitment to the serial number "s" under randomness "r"
 	// C = g^s * h^r mod p
-	Bignum commitmentValue = this->params->coinCommitmentGroup.g.pow_mod(s, this->params->coinCommitmentGroup.modulus).mul_mod(this->params->coinCommitmentGroup.h.pow_mod(r, this->params->coinCommitmentGroup.modulus), this->params->coinCommitmentGroup.modulus);
+	Bignum commitmentValue = Commitment::CommitmentValue(&this->params->coinCommitmentGroup, s, r);
 
 	// Repeat this process up to MAX_COINMINT_ATTEMPTS times until
 	// we obtain a prime number
@@ -214,7 +216,7 @@ void PrivateCoin::mintCoinFast(const CoinDenomination denomination) {
 		// r = r + r_delta mod q
 		// C = C * h mod p
 		r = (r + r_delta) % this->params->coinCommitmentGroup.groupOrder;
-		commitmentValue = commitmentValue.mul_mod(this->params->coinCommitmentGroup.h.pow_mod(r_delta, this->params->coinCommitmentGroup.modulus), this->params->coinCommitmentGroup.modulus);
+		commitmentValue = commitmentValue.mul_mod(Commitment::CommitmentValue(&this->params->coinCommitmentGroup, 0, r_delta), this->params->coinCommitmentGroup.modulus);
 	}
 
 	// We only get here if we did not find a coin within
@@ -226,6 +228,30 @@ const PublicCoin& PrivateCoin::getPublicCoin() const {
 	return this->publicCoin;
 }
 
+std::vector<PrivateCoin> MintPrivateCoins(const Params* p, const std::vector<CoinDenomination>& denominations, int version) {
+	// Every coin searches for a prime commitment on its own, run the searches on the thread pool
+	std::vector<std::unique_ptr<PrivateCoin>> newCoins(denominations.size());
+	ParallelTasks mintTasks(denominations.size());
+	for (size_t i = 0; i < denominations.size(); i++)
+		mintTasks.Add([p, &denominations, version, &newCoins, i]() {
+			// failures are reported once all of the tasks are done, they share the coin vector
+			try {
+				newCoins[i].reset(new PrivateCoin(p, denominations[i], version));
+			} catch (const std::exception &) {
+			}
+		});
+	mintTasks.Wait();
+
+	std::vector<PrivateCoin> coins;
+	coins.reserve(newCoins.size());
+	for (const std::unique_ptr<PrivateCoin>& coin: newCoins) {
+		if (!coin)
+			throw ZerocoinException("Unable to mint a new Zerocoin");
+		coins.push_back(*coin);
+	}
+	return coins;
+}
+
 
 const Bignum PrivateCoin::serialNumberFromSerializedPublicKey(secp256k1_context *context, secp256k1_pubkey *pubkey)  {
     std::vector<unsigned char> pubkey_hash(32, 0);
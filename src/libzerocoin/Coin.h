@@ -191,5 +191,13 @@ private:
     void mintCoinFast(const CoinDenomination denomination);
 
 };
+/** Mints a new coin of every given denomination, the coins are generated in parallel on the libzerocoin thread pool
+ * @param p cryptographic paramters
+ * @param denominations denominations of the coins, one coin is minted for each entry
+ * @param version version of the coins
+ * @return the coins in the order of denominations
+ */
+std::vector<PrivateCoin> MintPrivateCoins(const Params* p, const std::vector<CoinDenomination>& denominations, int version = ZEROCOIN_VERSION_1);
+
 } /* namespace libzerocoin */
 #endif /* COIN_H_ */
@@ -11,16 +11,60 @@
  **/
 
 #include <stdlib.h>
+#include <map>
+#include <memory>
+#include <mutex>
 #include "Zerocoin.h"
 
 namespace libzerocoin {
 
+namespace {
+
+// Fixed-base tables of the generators of a commitment group
+struct CommitmentGroupTables {
+	Bignum g, h, modulus;
+	std::unique_ptr<CBigNumFixedBaseTable> gTable, hTable;
+
+	CommitmentGroupTables(const IntegerGroupParams* p) :
+		g(p->g), h(p->h), modulus(p->modulus),
+		gTable(new CBigNumFixedBaseTable(p->g, p->modulus, p->groupOrder.bitSize())),
+		hTable(new CBigNumFixedBaseTable(p->h, p->modulus, p->groupOrder.bitSize())) {}
+
+	bool Matches(const IntegerGroupParams* p) const {
+		return g == p->g && h == p->h && modulus == p->modulus;
+	}
+};
+
+std::mutex cs_commitmentGroupTables;
+std::map<const IntegerGroupParams*, std::shared_ptr<const CommitmentGroupTables>> commitmentGroupTables;
+
+// Tables are built the first time a group is used and kept for the life of the process
+std::shared_ptr<const CommitmentGroupTables> GetCommitmentGroupTables(const IntegerGroupParams* p) {
+	std::lock_guard<std::mutex> lock(cs_commitmentGroupTables);
+	std::shared_ptr<const CommitmentGroupTables> &tables = commitmentGroupTables[p];
+	if (!tables || !tables->Matches(p))
+		tables = std::make_shared<const CommitmentGroupTables>(p);
+	return tables;
+}
+
+}
+
 //Commitment class
 Commitment::Commitment::Commitment(const IntegerGroupParams* p,
                                    const Bignum& value): params(p), contents(value) {
 	this->randomness = Bignum::randBignum(params->groupOrder);
-	this->commitmentValue = (params->g.pow_mod(this->contents, params->modulus).mul_mod(
-	                         params->h.pow_mod(this->randomness, params->modulus), params->modulus));
+	this->commitmentValue = CommitmentValue(params, this->contents, this->randomness);
+}
+
+Commitment::Commitment(const IntegerGroupParams* p, const Bignum& value, const Bignum& r):
+	params(p), randomness(r), contents(value) {
+	this->commitmentValue = CommitmentValue(params, this->contents, this->randomness);
+}
+
+Bignum Commitment::CommitmentValue(const IntegerGroupParams* p, const Bignum& value, const Bignum& r) {
+	// g^value * h^r mod p
+	std::shared_ptr<const CommitmentGroupTables> tables = GetCommitmentGroupTables(p);
+	return CBigNumFixedBaseTable::mul_pow_mod({tables->gTable.get(), tables->hTable.get()}, {value, r});
 }
 
 const Bignum& Commitment::getCommitmentValue() const {
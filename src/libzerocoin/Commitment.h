@@ -37,6 +37,15 @@ public:
 	 * @param value the value to commit to
 	 */
 	Commitment(const IntegerGroupParams* p, const Bignum& value);
+	/**Opens a Pedersen commitment to the given value with known randomness.
+	 *
+	 * @param p the group parameters for the coin
+	 * @param value the value committed to
+	 * @param r the randomness of the commitment
+	 */
+	Commitment(const IntegerGroupParams* p, const Bignum& value, const Bignum& r);
+	/** g^value * h^r in the group p, using tables of the generators precomputed once per process */
+	static Bignum CommitmentValue(const IntegerGroupParams* p, const Bignum& value, const Bignum& r);
 	const Bignum& getCommitmentValue() const;
 	const Bignum& getRandomness() const;
 	const Bignum& getContents() const;
@@ -18,44 +18,53 @@ namespace libzerocoin {
 
 #ifdef ZEROCOIN_THREADING
 
-// Number of seconds before thread shuts down if idle
-constexpr static int secondsBeforeThreadShutdown = 10;
-
-// Simple thread pool class for using multiple cores effeciently
+// Simple thread pool class for using multiple cores effeciently. Threads are started on first use and
+// stay alive until shutdown, the number of them is set with SetParallelTasksThreadCount
 
 static class ParallelOpThreadPool {
 private:
+    struct QueuedTask {
+        boost::packaged_task<void>            task;
+        boost::chrono::steady_clock::time_point timeQueued;
+    };
+
     std::list<boost::thread>                  threads;
-    std::queue<boost::packaged_task<void>>    taskQueue;
+    std::queue<QueuedTask>                    taskQueue;
     boost::mutex                              taskQueueMutex;
     boost::condition_variable                 taskQueueCondition;
 
     bool                                      shutdown;
     size_t                                    numberOfThreads;
 
+    // statistics, protected by taskQueueMutex
+    size_t                                    nRunning;
+    uint64_t                                  nTasksCompleted;
+    int64_t                                   nTotalQueueMicros;
+    int64_t                                   nTotalRunMicros;
+
     void ThreadProc() {
         for (;;) {
-            boost::packaged_task<void> job;
+            QueuedTask job;
             {
                 boost::unique_lock<boost::mutex> lock(taskQueueMutex);
 
-                taskQueueCondition.wait_for(lock, boost::chrono::seconds(secondsBeforeThreadShutdown),
-                                            [this] { return !taskQueue.empty() || shutdown; });
-                if (taskQueue.empty()) {
-                    // Either timeout or shutdown. If it's a timeout we need to delete ourself from the thread list and detach the thread
-                    // In case of shutdown thread list will be empty and destructor will wait for this thread completion
-                    boost::thread::id currentId = boost::this_thread::get_id();
-                    auto pThread = find_if(threads.begin(), threads.end(), [=](const boost::thread &t) { return t.get_id() == currentId; });
-                    if (pThread != threads.end()) {
-                        pThread->detach();
-                        threads.erase(pThread);
-                    }
+                taskQueueCondition.wait(lock, [this] { return !taskQueue.empty() || shutdown; });
+                if (taskQueue.empty())
                     break;
-                }
                 job = std::move(taskQueue.front());
                 taskQueue.pop();
+                nRunning++;
             }
-            job();
+
+            boost::chrono::steady_clock::time_point timeStarted = boost::chrono::steady_clock::now();
+            job.task();
+            boost::chrono::steady_clock::time_point timeFinished = boost::chrono::steady_clock::now();
+
+            boost::unique_lock<boost::mutex> lock(taskQueueMutex);
+            nRunning--;
+            nTasksCompleted++;
+            nTotalQueueMicros += boost::chrono::duration_cast<boost::chrono::microseconds>(timeStarted - job.timeQueued).count();
+            nTotalRunMicros += boost::chrono::duration_cast<boost::chrono::microseconds>(timeFinished - timeStarted).count();
         }
     }
 
@@ -67,7 +76,8 @@ private:
     }
 
 public:
-    ParallelOpThreadPool() : shutdown(false), numberOfThreads(boost::thread::hardware_concurrency()) {}
+    ParallelOpThreadPool() : shutdown(false), numberOfThreads(std::max(boost::thread::hardware_concurrency(), 1u)),
+                             nRunning(0), nTasksCompleted(0), nTotalQueueMicros(0), nTotalRunMicros(0) {}
 
     ~ParallelOpThreadPool() {
         std::list<boost::thread> threadsToJoin;
@@ -89,16 +99,18 @@ public:
 
     // Post a task to the thread pool and return a future to wait for its completion
     boost::future<void> PostTask(function<void()> task) {
-        boost::packaged_task<void> packagedTask(std::move(task));
-        boost::future<void> ret = packagedTask.get_future();
+        QueuedTask queuedTask;
+        queuedTask.task = boost::packaged_task<void>(std::move(task));
+        boost::future<void> ret = queuedTask.task.get_future();
 
         taskQueueMutex.lock();
 
-        // lazy start threads on first request or after shutdown
+        // lazy start threads on first request
         if (threads.size() < numberOfThreads)
             StartThreads();
 
-        taskQueue.emplace(std::move(packagedTask));
+        queuedTask.timeQueued = boost::chrono::steady_clock::now();
+        taskQueue.emplace(std::move(queuedTask));
         taskQueueCondition.notify_one();
 
         taskQueueMutex.unlock();
@@ -106,6 +118,25 @@ public:
         return ret;
     }
 
+    // Change number of threads. Only takes effect if the threads have not been started yet
+    void SetNumberOfThreads(size_t n) {
+        boost::unique_lock<boost::mutex> lock(taskQueueMutex);
+        if (threads.empty())
+            numberOfThreads = std::max<size_t>(n, 1);
+    }
+
+    ParallelTasksStats GetStats() {
+        boost::unique_lock<boost::mutex> lock(taskQueueMutex);
+        ParallelTasksStats stats;
+        stats.nThreads = numberOfThreads;
+        stats.nQueued = taskQueue.size();
+        stats.nRunning = nRunning;
+        stats.nTasksCompleted = nTasksCompleted;
+        stats.nTotalQueueMicros = nTotalQueueMicros;
+        stats.nTotalRunMicros = nTotalRunMicros;
+        return stats;
+    }
+
 } s_parallelOpThreadPool;
 
 #else
@@ -118,6 +149,12 @@ public:
         promise.set_value();
         return promise.get_future();
     }
+
+    void SetNumberOfThreads(size_t) {}
+
+    ParallelTasksStats GetStats() {
+        return ParallelTasksStats();
+    }
 } s_parallelOpThreadPool;
 
 #endif
@@ -141,4 +178,12 @@ void ParallelTasks::Reset() {
     tasks.clear();
 }
 
+void SetParallelTasksThreadCount(int n) {
+    s_parallelOpThreadPool.SetNumberOfThreads(n > 0 ? n : std::max(boost::thread::hardware_concurrency(), 1u));
+}
+
+ParallelTasksStats GetParallelTasksStats() {
+    return s_parallelOpThreadPool.GetStats();
+}
+
 } // namespace libzerocoin
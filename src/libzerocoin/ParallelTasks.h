@@ -7,6 +7,7 @@
 #define BOOST_THREAD_PROVIDES_FUTURE
 
 #include "Zerocoin.h"
+#include "ParallelTasksPool.h"
 #include <boost/thread/future.hpp>
 #include <boost/thread.hpp>
 
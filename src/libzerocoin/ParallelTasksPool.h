@@ -0,0 +1,32 @@
+#ifndef PARALLELTASKSPOOL_H
+#define PARALLELTASKSPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Configuration and statistics of the thread pool shared by all ParallelTasks. Kept apart from
+// ParallelTasks.h so that it can be used without pulling in boost futures
+
+namespace libzerocoin {
+
+struct ParallelTasksStats {
+    size_t      nThreads;
+    size_t      nQueued;
+    size_t      nRunning;
+    uint64_t    nTasksCompleted;
+    // total time tasks spent waiting in the queue and running, in microseconds
+    int64_t     nTotalQueueMicros;
+    int64_t     nTotalRunMicros;
+
+    ParallelTasksStats() : nThreads(0), nQueued(0), nRunning(0), nTasksCompleted(0), nTotalQueueMicros(0), nTotalRunMicros(0) {}
+};
+
+// set number of threads in the pool, 0 means one per core. Has no effect once the pool is running
+void SetParallelTasksThreadCount(int n);
+
+// get statistics of the pool
+ParallelTasksStats GetParallelTasksStats();
+
+}
+
+#endif // PARALLELTASKSPOOL_H
@@ -175,6 +175,17 @@ public:
 	**/
     Params(CBigNum accumulatorModulus, uint32_t securityLevel = ZEROCOIN_DEFAULT_SECURITYLEVEL);
 
+	/** @brief Read a set of Zerocoin parameters derived and serialized before.
+	* @param strm             A stream with the serialized parameters
+	*
+	* Skips the derivation, the caller vouches that the parameters
+	* were derived from a trustworthy modulus.
+	**/
+	template<typename Stream>
+	Params(deserialize_type, Stream& strm) {
+		strm >> *this;
+	}
+
 	bool initialized;
 
 	AccumulatorAndProofParams accumulatorParams;
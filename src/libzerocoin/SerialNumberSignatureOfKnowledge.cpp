@@ -15,7 +15,8 @@
 
 namespace libzerocoin {
 
-SerialNumberSignatureOfKnowledge::SerialNumberSignatureOfKnowledge(const Params* p): params(p) { }
+SerialNumberSignatureOfKnowledge::SerialNumberSignatureOfKnowledge(const Params* p)
+    :params(p), s_notprime(p->zkp_iterations), sprime(p->zkp_iterations) { }
 
 SerialNumberSignatureOfKnowledge::SerialNumberSignatureOfKnowledge(const Params* p, const PrivateCoin& coin, const Commitment& commitmentToCoin, uint256 msghash)
     :params(p), s_notprime(p->zkp_iterations), sprime(p->zkp_iterations) {
@@ -119,6 +120,11 @@ bool SerialNumberSignatureOfKnowledge::Verify(const Bignum& coinSerialNumber, co
 	Bignum g = params->serialNumberSoKCommitmentGroup.g;
 	Bignum h = params->serialNumberSoKCommitmentGroup.h;
 
+	// One response of each kind per iteration
+	if (s_notprime.size() < params->zkp_iterations || sprime.size() < params->zkp_iterations) {
+		return false;
+	}
+
 	// Make sure that the serial number has a unique representation
 	if (coinSerialNumber < 0 || coinSerialNumber >= params->coinCommitmentGroup.groupOrder){
 		return false;
@@ -133,20 +139,28 @@ bool SerialNumberSignatureOfKnowledge::Verify(const Bignum& coinSerialNumber, co
 	vector<CBigNum> tprime(params->zkp_iterations);
 	unsigned char *hashbytes = (unsigned char*) &this->hash;
 
+	// All the bases are the same for every iteration, build their power tables once and compute
+	// both exponentiations of each step with one simultaneous multi-exponentiation
+	const Bignum& groupOrder = params->serialNumberSoKCommitmentGroup.groupOrder;
+	const Bignum& modulus = params->serialNumberSoKCommitmentGroup.modulus;
+	CBigNumPowTable aTable(a, groupOrder), bTable(b, groupOrder);
+	CBigNumPowTable gTable(g, modulus), hTable(h, modulus), commitmentTable(valueOfCommitmentToCoin, modulus);
+
     ParallelTasks challenges(params->zkp_iterations);
 
 	for(uint32_t i = 0; i < params->zkp_iterations; i++) {
-        challenges.Add([this, i, hashbytes, &b, &h, &tprime, &coinSerialNumber, &valueOfCommitmentToCoin] {
+        challenges.Add([this, i, hashbytes, &aTable, &bTable, &gTable, &hTable, &commitmentTable, &tprime, &coinSerialNumber] {
             int bit = i % 8;
             int byte = i / 8;
             bool challenge_bit = ((hashbytes[byte] >> bit) & 0x01);
             if(challenge_bit) {
-                tprime[i] = challengeCalculation(coinSerialNumber, s_notprime[i], sprime[i]);
+                // g^{a^serial b^s} h^s'
+                Bignum exp = CBigNum::mul_pow_mod({&aTable, &bTable}, {coinSerialNumber, s_notprime[i]});
+                tprime[i] = CBigNum::mul_pow_mod({&gTable, &hTable}, {exp, sprime[i]});
             } else {
-                Bignum exp = b.pow_mod(s_notprime[i], params->serialNumberSoKCommitmentGroup.groupOrder);
-                tprime[i] = ((valueOfCommitmentToCoin.pow_mod(exp, params->serialNumberSoKCommitmentGroup.modulus) % params->serialNumberSoKCommitmentGroup.modulus) *
-                             (h.pow_mod(sprime[i], params->serialNumberSoKCommitmentGroup.modulus) % params->serialNumberSoKCommitmentGroup.modulus)) %
-                            params->serialNumberSoKCommitmentGroup.modulus;
+                // C^{b^s} h^s'
+                Bignum exp = CBigNum::mul_pow_mod({&bTable}, {s_notprime[i]});
+                tprime[i] = CBigNum::mul_pow_mod({&commitmentTable, &hTable}, {exp, sprime[i]});
             }
         });
 	}
@@ -51,14 +51,32 @@ public:
 	 */
     bool Verify(const Bignum& coinSerialNumber, const Bignum& valueOfCommitmentToCoin,const uint256 msghash) const;
 
-	ADD_SERIALIZE_METHODS;
-	template <typename Stream, typename Operation>
-    inline void SerializationOp(Stream& s, Operation ser_action) {
-		READWRITE(s_notprime);
-		READWRITE(sprime);
-		READWRITE(hash);
+	template <typename Stream>
+	void Serialize(Stream& s) const {
+		s << s_notprime << sprime << hash;
+	}
+
+	/** Same format as Serialize, decoded into the response values already allocated for zkp_iterations */
+	template <typename Stream>
+	void Unserialize(Stream& s) {
+		UnserializeResponses(s, s_notprime);
+		UnserializeResponses(s, sprime);
+		s >> hash;
 	}
 private:
+	template <typename Stream>
+	static void UnserializeResponses(Stream& s, vector<Bignum>& v) {
+		unsigned int nSize = ReadCompactSize(s);
+		for (unsigned int i = 0; i < nSize; i++) {
+			// Grow as the values arrive, so a bogus size value won't cause out of memory
+			if (i == v.size())
+				v.emplace_back();
+			s >> v[i];
+		}
+		v.resize(nSize);
+	}
+
+
 	const Params* params;
 	// challenge hash
     arith_uint256 hash; //TODO For efficiency, should this be a bitset where Templates define params?
@@ -5,11 +5,13 @@
 #ifndef BITCOIN_BIGNUM_H
 #define BITCOIN_BIGNUM_H
 
+#include <algorithm>
 #include <stdexcept>
 #include <vector>
 #include <openssl/bn.h>
 
 #include "Zerocoin.h"
+#include "../prevector.h"
 #include "../arith_uint256.h"
 #include "../uint256.h"
 #include "../version.h"
@@ -23,25 +25,36 @@ public:
     explicit bignum_error(const std::string& str) : std::runtime_error(str) {}
 };
 
-/** RAII encapsulated BN_CTX (OpenSSL bignum context) */
+/**
+ * RAII encapsulated BN_CTX (OpenSSL bignum context)
+ *
+ * The context is shared by everything running on the same thread: OpenSSL functions balance their
+ * BN_CTX_start/BN_CTX_end calls, so nested users are safe and the temporaries it keeps are reused
+ * from one operation to the next instead of being allocated and freed every time.
+ */
 class CAutoBN_CTX
 {
 protected:
     BN_CTX* pctx;
     BN_CTX* operator=(BN_CTX* pnew) { return pctx = pnew; }
 
+    struct ThreadContext {
+        BN_CTX* pctx;
+        ThreadContext() : pctx(BN_CTX_new()) {}
+        ~ThreadContext() { if (pctx != NULL) BN_CTX_free(pctx); }
+    };
+
 public:
     CAutoBN_CTX()
     {
-        pctx = BN_CTX_new();
+        static thread_local ThreadContext threadContext;
+        pctx = threadContext.pctx;
         if (pctx == NULL)
             throw bignum_error("CAutoBN_CTX : BN_CTX_new() returned NULL");
     }
 
     ~CAutoBN_CTX()
     {
-        if (pctx != NULL)
-            BN_CTX_free(pctx);
     }
 
     operator BN_CTX*() { return pctx; }
@@ -51,11 +64,83 @@ public:
 };
 
 
+/**
+ * Per thread cache of Montgomery contexts for odd moduli. The zerocoin proofs do all of their
+ * exponentiations modulo a handful of fixed group moduli, caching the contexts saves redoing the
+ * Montgomery setup (R^2 mod m and -m^-1 mod 2^w) for each of them.
+ */
+class CBigNumMontCache
+{
+private:
+    static const size_t nMaxEntries = 16;
+
+    struct Entry {
+        BIGNUM* modulus;
+        BN_MONT_CTX* mont;
+    };
+
+    std::vector<Entry> entries;
+    size_t nNextEviction;
+
+    CBigNumMontCache() : nNextEviction(0) {}
+
+    ~CBigNumMontCache()
+    {
+        for (Entry &entry: entries) {
+            BN_free(entry.modulus);
+            BN_MONT_CTX_free(entry.mont);
+        }
+    }
+
+public:
+    /** Returns the Montgomery context for odd modulus m, or NULL if it couldn't be set up */
+    static BN_MONT_CTX* Get(const BIGNUM* m, BN_CTX* ctx)
+    {
+        static thread_local CBigNumMontCache cache;
+
+        for (const Entry &entry: cache.entries) {
+            if (BN_cmp(entry.modulus, m) == 0)
+                return entry.mont;
+        }
+
+        BN_MONT_CTX* mont = BN_MONT_CTX_new();
+        if (mont == NULL)
+            return NULL;
+        if (!BN_MONT_CTX_set(mont, m, ctx)) {
+            BN_MONT_CTX_free(mont);
+            return NULL;
+        }
+        BIGNUM* modulus = BN_dup(m);
+        if (modulus == NULL) {
+            BN_MONT_CTX_free(mont);
+            return NULL;
+        }
+
+        Entry entry = {modulus, mont};
+        if (cache.entries.size() < nMaxEntries) {
+            cache.entries.push_back(entry);
+        }
+        else {
+            Entry &evicted = cache.entries[cache.nNextEviction];
+            BN_free(evicted.modulus);
+            BN_MONT_CTX_free(evicted.mont);
+            evicted = entry;
+            cache.nNextEviction = (cache.nNextEviction + 1) % nMaxEntries;
+        }
+        return mont;
+    }
+};
+
+class CBigNumPowTable;
+
 /** C++ wrapper for BIGNUM (OpenSSL bignum) */class CBigNum
 {
 protected:
     BIGNUM	*bn;
 
+    //! MPI form of a number being (de)serialized, 4 size bytes and up to 1020 bytes (8160 bits) of number on the stack
+    typedef prevector<1024, unsigned char> SerBuffer;
+
     void init()
     {
         bn = BN_new();
@@ -481,23 +566,58 @@ public:
         return ToString(16);
     }
 
+    /** Length of the vector getvch returns, without building it */
+    unsigned int GetVchSize() const
+    {
+        // A sign bit and the magnitude, the MPI format adds a byte when the top bit of the magnitude is set
+        unsigned int nBits = BN_num_bits(bn);
+        return nBits == 0 ? 0 : nBits / 8 + 1;
+    }
+
     unsigned int GetSerializeSize(int nType=0, int nVersion=PROTOCOL_VERSION) const
     {
-        return ::GetSerializeSize(getvch(), nType, nVersion);
+        unsigned int nSize = GetVchSize();
+        return GetSizeOfCompactSize(nSize) + nSize;
     }
 
+    /**
+     * Serialized as the vector getvch returns, but built in a buffer on the stack for all the sizes
+     * the zerocoin proofs use, rather than in temporary vectors on the heap.
+     */
     template<typename Stream>
     void Serialize(Stream& s) const
     {
-        ::Serialize(s, getvch());
+        unsigned int nSize = GetVchSize();
+        WriteCompactSize(s, nSize);
+        if (nSize == 0)
+            return;
+        SerBuffer vch;
+        vch.resize(nSize + 4);
+        BN_bn2mpi(bn, vch.data());
+        std::reverse(vch.begin() + 4, vch.end());
+        s.write((const char*)vch.data() + 4, nSize);
     }
 
     template<typename Stream>
     void Unserialize(Stream& s)
     {
-        std::vector<unsigned char> vch;
-        ::Unserialize(s, vch);
-        setvch(vch);
+        unsigned int nSize = ReadCompactSize(s);
+        SerBuffer vch;
+        vch.resize(4);
+        vch[0] = (nSize >> 24) & 0xff;
+        vch[1] = (nSize >> 16) & 0xff;
+        vch[2] = (nSize >> 8) & 0xff;
+        vch[3] = (nSize >> 0) & 0xff;
+        // Limit size per read so bogus size value won't cause out of memory
+        for (unsigned int i = 0; i < nSize; ) {
+            unsigned int blk = std::min(nSize - i, 5000000u);
+            vch.resize(4 + i + blk);
+            s.read((char*)vch.data() + 4 + i, blk);
+            i += blk;
+        }
+        std::reverse(vch.begin() + 4, vch.end());
+        // Decodes into the limbs bn already has, growing them only when the number is larger
+        BN_mpi2bn(vch.data(), vch.size(), bn);
     }
 
     /**
@@ -544,19 +664,30 @@ public:
     CBigNum pow_mod(const CBigNum& e, const CBigNum& m) const {
         CAutoBN_CTX pctx;
         CBigNum ret;
+        // odd moduli (all of the zerocoin groups) use the cached Montgomery context
+        BN_MONT_CTX* mont = BN_is_odd(&m) ? CBigNumMontCache::Get(&m, pctx) : NULL;
         if( e < 0){
             // g^-x = (g^-1)^x
             CBigNum inv = this->inverse(m);
             CBigNum posE = e * -1;
-            if (!BN_mod_exp(&ret, &inv, &posE, &m, pctx))
+            if (!(mont ? BN_mod_exp_mont(&ret, &inv, &posE, &m, pctx, mont) : BN_mod_exp(&ret, &inv, &posE, &m, pctx)))
                 throw bignum_error("CBigNum::pow_mod: BN_mod_exp failed on negative exponent");
         }else
-        if (!BN_mod_exp(&ret, bn, &e, &m, pctx))
+        if (!(mont ? BN_mod_exp_mont(&ret, bn, &e, &m, pctx, mont) : BN_mod_exp(&ret, bn, &e, &m, pctx)))
             throw bignum_error("CBigNum::pow_mod : BN_mod_exp failed");
 
         return ret;
     }
 
+    /**
+     * Simultaneous multi-exponentiation (Straus): the product of the tables' bases raised to the
+     * corresponding exponents, modulo the common modulus of the tables. All of the bases share one
+     * chain of squarings, so a double exponentiation costs little more than a single pow_mod.
+     * @param tables precomputed tables of the bases
+     * @param exps exponents, may be negative
+     */
+    static CBigNum mul_pow_mod(const std::vector<const CBigNumPowTable*>& tables, const std::vector<CBigNum>& exps);
+
     /**
      * Calculates the inverse of this element mod m.
      * i.e. i such this*i = 1 mod m
@@ -805,6 +936,236 @@ inline bool operator<(const CBigNum& a, const CBigNum& b)  { return (BN_cmp(&a,
 inline bool operator>(const CBigNum& a, const CBigNum& b)  { return (BN_cmp(&a, &b) > 0); }
 inline std::ostream& operator<<(std::ostream &strm, const CBigNum &b) { return strm << b.ToString(10); }
 
+/**
+ * Window table of powers of a fixed base in Montgomery form, for CBigNum::mul_pow_mod. Powers of the
+ * inverse of the base are kept too for negative exponents. The table is read only once built, so one
+ * table may be shared by any number of exponentiations running on different threads.
+ */
+class CBigNumPowTable
+{
+    friend class CBigNum;
+
+public:
+    static const int nWindowBits = 5;
+
+private:
+    CBigNum base;
+    CBigNum modulus;
+    // base^i and base^-i in Montgomery form for 0 < i < 2^nWindowBits, index 0 is unused
+    std::vector<CBigNum> powers;
+    std::vector<CBigNum> inversePowers;
+    bool fMontgomery;
+    bool fHasInverse;
+
+    static void BuildPowers(std::vector<CBigNum>& result, const CBigNum& x, BN_MONT_CTX* mont, BN_CTX* pctx)
+    {
+        result.resize(1 << nWindowBits);
+        if (!BN_to_montgomery(&result[1], &x, mont, pctx))
+            throw bignum_error("CBigNumPowTable : BN_to_montgomery failed");
+        for (size_t i = 2; i < result.size(); i++) {
+            if (!BN_mod_mul_montgomery(&result[i], &result[i-1], &result[1], mont, pctx))
+                throw bignum_error("CBigNumPowTable : BN_mod_mul_montgomery failed");
+        }
+    }
+
+public:
+    CBigNumPowTable(const CBigNum& baseIn, const CBigNum& m) : base(baseIn % m), modulus(m), fMontgomery(false), fHasInverse(false)
+    {
+        CAutoBN_CTX pctx;
+        CBigNum inv;
+        // non invertible bases are only an error if they are raised to a negative power
+        fHasInverse = BN_mod_inverse(&inv, &base, &modulus, pctx) != NULL;
+
+        BN_MONT_CTX* mont = BN_is_odd(&modulus) ? CBigNumMontCache::Get(&modulus, pctx) : NULL;
+        if (mont == NULL)
+            return;
+
+        BuildPowers(powers, base, mont, pctx);
+        if (fHasInverse)
+            BuildPowers(inversePowers, inv, mont, pctx);
+        fMontgomery = true;
+    }
+
+    const CBigNum& getModulus() const { return modulus; }
+};
+
+inline CBigNum CBigNum::mul_pow_mod(const std::vector<const CBigNumPowTable*>& tables, const std::vector<CBigNum>& exps)
+{
+    if (tables.empty() || tables.size() != exps.size())
+        throw bignum_error("CBigNum::mul_pow_mod : number of tables and exponents don't match");
+
+    const CBigNum& m = tables[0]->modulus;
+    bool fMontgomery = true;
+    for (const CBigNumPowTable* table: tables) {
+        if (table->modulus != m)
+            throw bignum_error("CBigNum::mul_pow_mod : tables have different moduli");
+        fMontgomery = fMontgomery && table->fMontgomery;
+    }
+
+    CAutoBN_CTX pctx;
+    BN_MONT_CTX* mont = fMontgomery ? CBigNumMontCache::Get(&m, pctx) : NULL;
+    if (mont == NULL) {
+        // no Montgomery form for this modulus, multiply individual exponentiations
+        CBigNum ret = 1;
+        for (size_t i = 0; i < tables.size(); i++)
+            ret = ret.mul_mod(tables[i]->base.pow_mod(exps[i], m), m);
+        return ret;
+    }
+
+    // work with the absolute values of exponents and pick the table of the inverse for negative ones
+    std::vector<CBigNum> absExps(exps.size());
+    std::vector<const std::vector<CBigNum>*> powers(exps.size());
+    int nMaxBits = 0;
+    for (size_t i = 0; i < exps.size(); i++) {
+        bool fNegative = exps[i] < 0;
+        if (fNegative && !tables[i]->fHasInverse)
+            throw bignum_error("CBigNum::mul_pow_mod : negative power of non invertible base");
+        absExps[i] = fNegative ? exps[i] * -1 : exps[i];
+        powers[i] = fNegative ? &tables[i]->inversePowers : &tables[i]->powers;
+        nMaxBits = std::max(nMaxBits, absExps[i].bitSize());
+    }
+
+    const int w = CBigNumPowTable::nWindowBits;
+    CBigNum acc = 1;
+    if (!BN_to_montgomery(&acc, &acc, mont, pctx))
+        throw bignum_error("CBigNum::mul_pow_mod : BN_to_montgomery failed");
+
+    bool fStarted = false;
+    for (int pos = ((nMaxBits + w - 1) / w - 1) * w; pos >= 0; pos -= w) {
+        if (fStarted) {
+            for (int j = 0; j < w; j++) {
+                if (!BN_mod_mul_montgomery(&acc, &acc, &acc, mont, pctx))
+                    throw bignum_error("CBigNum::mul_pow_mod : BN_mod_mul_montgomery failed");
+            }
+        }
+        for (size_t i = 0; i < absExps.size(); i++) {
+            unsigned int digit = 0;
+            for (int j = w - 1; j >= 0; j--)
+                digit = (digit << 1) | (BN_is_bit_set(&absExps[i], pos + j) ? 1 : 0);
+            if (digit == 0)
+                continue;
+            if (!BN_mod_mul_montgomery(&acc, &acc, &(*powers[i])[digit], mont, pctx))
+                throw bignum_error("CBigNum::mul_pow_mod : BN_mod_mul_montgomery failed");
+            fStarted = true;
+        }
+    }
+
+    CBigNum ret;
+    if (!BN_from_montgomery(&ret, &acc, mont, pctx))
+        throw bignum_error("CBigNum::mul_pow_mod : BN_from_montgomery failed");
+    return ret;
+}
+
+/**
+ * Fixed-base comb table: base^(d*2^(w*j)) in Montgomery form for every window j of exponents up to
+ * nMaxExpBits bits and every digit d. Raising the base to a power then takes one multiplication per
+ * nonzero window and no squarings at all, at the cost of keeping (2^w-1)*nMaxExpBits/w numbers. Meant
+ * for generators used over and over for the whole life of the process. Read only once built.
+ */
+class CBigNumFixedBaseTable
+{
+public:
+    static const int nWindowBits = 5;
+
+private:
+    CBigNum base;
+    CBigNum modulus;
+    int nMaxExpBits;
+    // row j holds entries for digits 1...2^nWindowBits-1 of window j
+    std::vector<CBigNum> powers;
+    bool fMontgomery;
+
+    static const int nRowSize = (1 << nWindowBits) - 1;
+
+public:
+    CBigNumFixedBaseTable(const CBigNum& baseIn, const CBigNum& m, int nMaxExpBitsIn) :
+        base(baseIn % m), modulus(m), nMaxExpBits(nMaxExpBitsIn), fMontgomery(false)
+    {
+        CAutoBN_CTX pctx;
+        BN_MONT_CTX* mont = BN_is_odd(&modulus) ? CBigNumMontCache::Get(&modulus, pctx) : NULL;
+        if (mont == NULL || nMaxExpBits <= 0)
+            return;
+
+        int nWindows = (nMaxExpBits + nWindowBits - 1) / nWindowBits;
+        powers.resize((size_t)nWindows * nRowSize);
+        // x = base^(2^(w*j)) for the current row j
+        CBigNum x;
+        if (!BN_to_montgomery(&x, &base, mont, pctx))
+            throw bignum_error("CBigNumFixedBaseTable : BN_to_montgomery failed");
+        for (int j = 0; j < nWindows; j++) {
+            std::vector<CBigNum>::iterator row = powers.begin() + (size_t)j * nRowSize;
+            row[0] = x;
+            for (int d = 1; d < nRowSize; d++) {
+                if (!BN_mod_mul_montgomery(&row[d], &row[d-1], &x, mont, pctx))
+                    throw bignum_error("CBigNumFixedBaseTable : BN_mod_mul_montgomery failed");
+            }
+            if (!BN_mod_mul_montgomery(&x, &row[nRowSize-1], &x, mont, pctx))
+                throw bignum_error("CBigNumFixedBaseTable : BN_mod_mul_montgomery failed");
+        }
+        fMontgomery = true;
+    }
+
+    const CBigNum& getModulus() const { return modulus; }
+    int getMaxExpBits() const { return nMaxExpBits; }
+
+    /**
+     * Product of the tables' bases raised to the corresponding exponents modulo the common modulus.
+     * Negative exponents or ones wider than the table fall back to CBigNum::pow_mod.
+     */
+    static CBigNum mul_pow_mod(const std::vector<const CBigNumFixedBaseTable*>& tables, const std::vector<CBigNum>& exps)
+    {
+        if (tables.empty() || tables.size() != exps.size())
+            throw bignum_error("CBigNumFixedBaseTable::mul_pow_mod : number of tables and exponents don't match");
+
+        const CBigNum& m = tables[0]->modulus;
+        CAutoBN_CTX pctx;
+        BN_MONT_CTX* mont = NULL;
+        CBigNum acc, rest = 1;
+        bool fStarted = false;
+        for (size_t i = 0; i < tables.size(); i++) {
+            const CBigNumFixedBaseTable* table = tables[i];
+            if (table->modulus != m)
+                throw bignum_error("CBigNumFixedBaseTable::mul_pow_mod : tables have different moduli");
+
+            const CBigNum& e = exps[i];
+            if (!table->fMontgomery || e < 0 || e.bitSize() > table->nMaxExpBits) {
+                rest = rest.mul_mod(table->base.pow_mod(e, m), m);
+                continue;
+            }
+            if (mont == NULL && (mont = CBigNumMontCache::Get(&m, pctx)) == NULL)
+                throw bignum_error("CBigNumFixedBaseTable::mul_pow_mod : no Montgomery context");
+
+            int nBits = e.bitSize();
+            for (int j = 0; j * nWindowBits < nBits; j++) {
+                unsigned int digit = 0;
+                for (int b = nWindowBits - 1; b >= 0; b--)
+                    digit = (digit << 1) | (BN_is_bit_set(&e, j * nWindowBits + b) ? 1 : 0);
+                if (digit == 0)
+                    continue;
+                const CBigNum& entry = table->powers[(size_t)j * nRowSize + digit - 1];
+                if (!fStarted) {
+                    acc = entry;
+                    fStarted = true;
+                } else if (!BN_mod_mul_montgomery(&acc, &acc, &entry, mont, pctx)) {
+                    throw bignum_error("CBigNumFixedBaseTable::mul_pow_mod : BN_mod_mul_montgomery failed");
+                }
+            }
+        }
+
+        if (!fStarted)
+            return rest % m;
+        CBigNum ret;
+        if (!BN_from_montgomery(&ret, &acc, mont, pctx))
+            throw bignum_error("CBigNumFixedBaseTable::mul_pow_mod : BN_from_montgomery failed");
+        return ret.mul_mod(rest, m);
+    }
+
+    CBigNum pow_mod(const CBigNum& e) const
+    {
+        return mul_pow_mod(std::vector<const CBigNumFixedBaseTable*>(1, this), std::vector<CBigNum>(1, e));
+    }
+};
+
 typedef CBigNum Bignum;
 
 #endif
@@ -6,9 +6,12 @@
 #define BITCOIN_MEMUSAGE_H
 
 #include <indirectmap.h>
+#include <lazycontainer.h>
+#include <support/allocators/pool.h>
 
 #include <stdlib.h>
 
+#include <list>
 #include <map>
 #include <set>
 #include <vector>
@@ -71,6 +74,15 @@ private:
     X x;
 };
 
+template<typename X>
+struct stl_list_node
+{
+private:
+    void* next;
+    void* prev;
+    X x;
+};
+
 struct stl_shared_counter
 {
     /* Various platforms use different sized counters here.
@@ -116,6 +128,24 @@ static inline size_t IncrementalDynamicUsage(const std::map<X, Y, Z>& m)
     return MallocUsage(sizeof(stl_tree_node<std::pair<const X, Y> >));
 }
 
+template<typename X, typename Y>
+static inline size_t DynamicUsage(const std::multiset<X, Y>& s)
+{
+    return MallocUsage(sizeof(stl_tree_node<X>)) * s.size();
+}
+
+template<typename X, typename Y, typename Z>
+static inline size_t DynamicUsage(const std::multimap<X, Y, Z>& m)
+{
+    return MallocUsage(sizeof(stl_tree_node<std::pair<const X, Y> >)) * m.size();
+}
+
+template<typename X>
+static inline size_t DynamicUsage(const std::list<X>& l)
+{
+    return MallocUsage(sizeof(stl_list_node<X>)) * l.size();
+}
+
 // indirectmap has underlying map with pointer as key
 
 template<typename X, typename Y>
@@ -130,6 +160,14 @@ static inline size_t IncrementalDynamicUsage(const indirectmap<X, Y>& m)
     return MallocUsage(sizeof(stl_tree_node<std::pair<const X*, Y> >));
 }
 
+// lazycontainer allocates its underlying container only when not empty
+
+template<typename X>
+static inline size_t DynamicUsage(const lazycontainer<X>& c)
+{
+    return c.allocated() ? MallocUsage(sizeof(X)) + DynamicUsage(c.get()) : 0;
+}
+
 template<typename X>
 static inline size_t DynamicUsage(const std::unique_ptr<X>& p)
 {
@@ -158,12 +196,27 @@ static inline size_t DynamicUsage(const std::unordered_set<X, Y>& s)
     return MallocUsage(sizeof(unordered_node<X>)) * s.size() + MallocUsage(sizeof(void*) * s.bucket_count());
 }
 
+template<typename X, typename Y>
+static inline size_t DynamicUsage(const std::unordered_multiset<X, Y>& s)
+{
+    return MallocUsage(sizeof(unordered_node<X>)) * s.size() + MallocUsage(sizeof(void*) * s.bucket_count());
+}
+
 template<typename X, typename Y, typename Z>
 static inline size_t DynamicUsage(const std::unordered_map<X, Y, Z>& m)
 {
     return MallocUsage(sizeof(unordered_node<std::pair<const X, Y> >)) * m.size() + MallocUsage(sizeof(void*) * m.bucket_count());
 }
 
+/** Nodes from a PoolResource carry no malloc overhead, and the blocks of erased nodes are
+ *  reused by the next insertions rather than counted twice. */
+template<typename X, typename Y, typename Z, typename E, size_t MAX_BLOCK_SIZE_BYTES, size_t ALIGN_BYTES>
+static inline size_t DynamicUsage(const std::unordered_map<X, Y, Z, E, PoolAllocator<std::pair<const X, Y>, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> >& m)
+{
+    typedef PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> Resource;
+    return Resource::BlockSize(sizeof(unordered_node<std::pair<const X, Y> >)) * m.size() + MallocUsage(sizeof(void*) * m.bucket_count());
+}
+
 }
 
 #endif // BITCOIN_MEMUSAGE_H
@@ -0,0 +1,72 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <metrics.h>
+
+#include <tinyformat.h>
+
+#include <atomic>
+
+namespace {
+
+struct MetricInfo {
+    const char* name;
+    const char* type;
+    const char* help;
+    double scale; //!< Factor from the stored value to the exported one
+};
+
+const MetricInfo metricInfo[] = {
+    {"nix_blocks_connected_total", "counter", "Blocks connected to the active chain", 1},
+    {"nix_chain_height", "gauge", "Height of the active chain", 1},
+    {"nix_zerocoin_proofs_verified_total", "counter", "Zerocoin spend proofs verified", 1},
+    {"nix_zerocoin_verify_seconds_total", "counter", "Time spent verifying zerocoin spend proofs", 1e-6},
+    {"nix_zerocoin_spend_cache_hits_total", "counter", "Zerocoin spend proofs found already verified", 1},
+    {"nix_mempool_transactions", "gauge", "Transactions in the mempool", 1},
+    {"nix_mempool_bytes", "gauge", "Serialized size of the mempool transactions", 1},
+    {"nix_mempool_usage_bytes", "gauge", "Memory usage of the mempool", 1},
+    {"nix_peers_inbound", "gauge", "Connected inbound peers", 1},
+    {"nix_peers_outbound", "gauge", "Connected outbound peers", 1},
+    {"nix_ghostnodes", "gauge", "Entries of the ghostnode list", 1},
+    {"nix_instantsend_locks_total", "counter", "InstantSend transactions locked", 1},
+    {"nix_coins_cache_hits_total", "counter", "Coins found in the coins cache", 1},
+    {"nix_coins_cache_misses_total", "counter", "Coins read from the chainstate database", 1},
+    {"nix_sigcache_hits_total", "counter", "Signatures found in the signature cache", 1},
+    {"nix_sigcache_misses_total", "counter", "Signatures verified", 1},
+};
+static_assert(sizeof(metricInfo) / sizeof(metricInfo[0]) == (size_t)Metric::COUNT, "metricInfo must name every Metric");
+
+std::atomic<int64_t> metricValues[(int)Metric::COUNT];
+
+} // namespace
+
+void MetricAdd(Metric metric, int64_t nValue)
+{
+    metricValues[(int)metric].fetch_add(nValue, std::memory_order_relaxed);
+}
+
+void MetricSet(Metric metric, int64_t nValue)
+{
+    metricValues[(int)metric].store(nValue, std::memory_order_relaxed);
+}
+
+int64_t GetMetric(Metric metric)
+{
+    return metricValues[(int)metric].load(std::memory_order_relaxed);
+}
+
+std::string FormatMetrics()
+{
+    std::string ret;
+    for (int i = 0; i < (int)Metric::COUNT; i++) {
+        const MetricInfo& info = metricInfo[i];
+        int64_t nValue = metricValues[i].load(std::memory_order_relaxed);
+        ret += strprintf("# HELP %s %s\n# TYPE %s %s\n", info.name, info.help, info.name, info.type);
+        if (info.scale == 1)
+            ret += strprintf("%s %d\n", info.name, nValue);
+        else
+            ret += strprintf("%s %.6f\n", info.name, nValue * info.scale);
+    }
+    return ret;
+}
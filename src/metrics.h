@@ -0,0 +1,42 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_METRICS_H
+#define BITCOIN_METRICS_H
+
+#include <stdint.h>
+#include <string>
+
+/**
+ * Counters and gauges of the node, updated atomically where they change so that reading them
+ * (the /metrics endpoint, -metrics) takes no lock.
+ */
+enum class Metric {
+    BLOCKS_CONNECTED,         //!< Blocks connected to the active chain
+    CHAIN_HEIGHT,             //!< Height of the active chain
+    ZEROCOIN_PROOFS_VERIFIED, //!< Zerocoin spend proofs verified against an accumulator
+    ZEROCOIN_VERIFY_MICROS,   //!< Time spent verifying them
+    ZEROCOIN_CACHE_HITS,      //!< Spend proofs found in the zerocoin spend cache instead
+    MEMPOOL_TRANSACTIONS,     //!< Transactions in the mempool
+    MEMPOOL_BYTES,            //!< Their serialized size
+    MEMPOOL_USAGE,            //!< Their memory usage
+    PEERS_INBOUND,            //!< Connected inbound peers
+    PEERS_OUTBOUND,           //!< Connected outbound peers
+    GHOSTNODES,               //!< Entries of the ghostnode list
+    INSTANTSEND_LOCKS,        //!< InstantSend transactions locked
+    COINS_CACHE_HITS,         //!< Coins found in the coins tip cache
+    COINS_CACHE_MISSES,       //!< Coins the coins tip cache read from the database
+    SIGCACHE_HITS,            //!< Signatures found in the signature cache
+    SIGCACHE_MISSES,          //!< Signatures verified
+    COUNT
+};
+
+void MetricAdd(Metric metric, int64_t nValue = 1);
+void MetricSet(Metric metric, int64_t nValue);
+int64_t GetMetric(Metric metric);
+
+/** Every metric in the Prometheus text exposition format */
+std::string FormatMetrics();
+
+#endif // BITCOIN_METRICS_H
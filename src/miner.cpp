@@ -8,6 +8,7 @@
 #include <amount.h>
 #include <chain.h>
 #include <chainparams.h>
+#include <coinbasepayouts.h>
 #include <coins.h>
 #include <consensus/consensus.h>
 #include <consensus/tx_verify.h>
@@ -28,14 +29,14 @@
 #include <validationinterface.h>
 
 #include <algorithm>
+#include <atomic>
 #include <queue>
+#include <thread>
 #include <utility>
 
 #include "ghostnode/ghostnode-payments.h"
 #include "ghostnode/ghostnode-sync.h"
 
-#include "consensus/airdropaddresses.h"
-
 //////////////////////////////////////////////////////////////////////////////
 //
 // BitcoinMiner
@@ -100,6 +101,10 @@ BlockAssembler::BlockAssembler(const CChainParams& params) : BlockAssembler(para
 void BlockAssembler::resetBlock()
 {
     inBlock.clear();
+    mapModifiedTx.clear();
+    failedTx.clear();
+    fCommitmentFixed = false;
+    fLeftOut = false;
 
     // Reserve space for coinbase tx
     nBlockWeight = 4000;
@@ -109,6 +114,7 @@ void BlockAssembler::resetBlock()
     // These counters do not include coinbase tx
     nBlockTx = 0;
     nFees = 0;
+    nBlockZerocoinSpends = 0;
 }
 
 
@@ -125,6 +131,7 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
 
     if(!pblocktemplate.get())
         return nullptr;
+    ptemplate = pblocktemplate.get();
     pblock = &pblocktemplate->block; // pointer for convenience
 
     CBlockIndex* pindexPrev = chainActive.Tip();
@@ -149,28 +156,22 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
         CAmount airdropValuePerAddress = GetBlockSubsidy(nHeight, chainparams.GetConsensus())/100;
         //Subtract 38m from block
         coinbaseTx.vout[0].nValue -= GetBlockSubsidy(nHeight, chainparams.GetConsensus());
-        CScript AIRDROP_SCRIPT;
-        std::string addresses;
         CAmount amountForGhostnodes = (40000 * COIN);
+        const std::vector<CCoinbasePayouts::Payee>& vAirdrop = CoinbasePayouts().Airdrop();
         //Draw from mainnet addresses
         if (!fTestNet) {
-            for(int i = 0; i < 100; i++){
-                addresses = airdrop_addresses[i];
-                AIRDROP_SCRIPT = GetScriptForDestination(DecodeDestination(addresses));
+            for(int i = 0; i < (int)vAirdrop.size(); i++){
                 if(i < 93)
-                    coinbaseTx.vout.push_back(CTxOut(airdropValuePerAddress, CScript(AIRDROP_SCRIPT.begin(), AIRDROP_SCRIPT.end())));
+                    coinbaseTx.vout.push_back(CTxOut(airdropValuePerAddress, vAirdrop[i].script));
                 else if(i == 93)
-                    coinbaseTx.vout.push_back(CTxOut(((airdropValuePerAddress * 7)  - (240000*COIN)), CScript(AIRDROP_SCRIPT.begin(), AIRDROP_SCRIPT.end())));
+                    coinbaseTx.vout.push_back(CTxOut(((airdropValuePerAddress * 7)  - (240000*COIN)), vAirdrop[i].script));
                 else
-                    coinbaseTx.vout.push_back(CTxOut(amountForGhostnodes, CScript(AIRDROP_SCRIPT.begin(), AIRDROP_SCRIPT.end())));
+                    coinbaseTx.vout.push_back(CTxOut(amountForGhostnodes, vAirdrop[i].script));
             }
         }
         //Draw from testnet addresses
         else{
-            for(int i = 0; i < 1; i++){
-                AIRDROP_SCRIPT = GetScriptForDestination(DecodeDestination("2PosyBduiL7yMfBK8DZEtCBJaQF76zgE8f"));
-                coinbaseTx.vout.push_back(CTxOut(GetBlockSubsidy(nHeight, chainparams.GetConsensus()), CScript(AIRDROP_SCRIPT.begin(), AIRDROP_SCRIPT.end())));
-            }
+            coinbaseTx.vout.push_back(CTxOut(GetBlockSubsidy(nHeight, chainparams.GetConsensus()), vAirdrop[0].script));
         }
     }
 
@@ -179,21 +180,11 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
 
         coinbaseTx.vout[0].nValue -= DEVELOPMENT_REWARD * GetBlockSubsidy(nHeight, chainparams.GetConsensus());
 
-        CScript DEV_1_SCRIPT;
-        CScript DEV_2_SCRIPT;
-
-        if (!fTestNet) {
-            DEV_1_SCRIPT = GetScriptForDestination(DecodeDestination("NVbGEghDbxPUe97oY8N5RvagQ61cHQiouW"));
-            DEV_2_SCRIPT = GetScriptForDestination(DecodeDestination("NWF7QNfT1b8a9dSQmVTT6hcwzwEVYVmDsG"));
-        }
-        else {
-            DEV_1_SCRIPT = GetScriptForDestination(DecodeDestination("2PosyBduiL7yMfBK8DZEtCBJaQF76zgE8f"));
-            DEV_2_SCRIPT = GetScriptForDestination(DecodeDestination("2WT5wFpLXoWm1H8CSgWVcq2F2LyhwKJcG1"));
-        }
+        const std::vector<CCoinbasePayouts::Payee>& vDevFund = CoinbasePayouts().DevFund();
 
         // And give it to the dev fund
-        coinbaseTx.vout.push_back(CTxOut(0.05 * GetBlockSubsidy(nHeight, chainparams.GetConsensus()), CScript(DEV_1_SCRIPT.begin(), DEV_1_SCRIPT.end())));
-        coinbaseTx.vout.push_back(CTxOut(0.02 * GetBlockSubsidy(nHeight, chainparams.GetConsensus()), CScript(DEV_2_SCRIPT.begin(), DEV_2_SCRIPT.end())));
+        coinbaseTx.vout.push_back(CTxOut(0.05 * GetBlockSubsidy(nHeight, chainparams.GetConsensus()), vDevFund[0].script));
+        coinbaseTx.vout.push_back(CTxOut(0.02 * GetBlockSubsidy(nHeight, chainparams.GetConsensus()), vDevFund[1].script));
     }
 
 
@@ -235,6 +226,15 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     int nPackagesSelected = 0;
     int nDescendantsUpdated = 0;
     addPackageTxs(nPackagesSelected, nDescendantsUpdated);
+    // Spend slots the fee paying packages left go to spends, whose descendants then get a go at the rest of the block
+    std::vector<CTxMemPool::txiter> vSpends;
+    for (auto mi = mempool.mapTx.get<entry_time>().begin(); mi != mempool.mapTx.get<entry_time>().end(); ++mi) {
+        CTxMemPool::txiter it = mempool.mapTx.project<0>(mi);
+        if (it->GetTx().IsZerocoinSpend() && !inBlock.count(it))
+            vSpends.push_back(it);
+    }
+    if (addZerocoinSpends(std::move(vSpends)) > 0)
+        addPackageTxs(nPackagesSelected, nDescendantsUpdated, true);
 
     int64_t nTime1 = GetTimeMicros();
 
@@ -244,6 +244,7 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     coinbaseTx.vin[0].scriptSig = CScript() << nHeight << OP_0;
     pblock->vtx[0] = MakeTransactionRef(std::move(coinbaseTx));
     pblocktemplate->vchCoinbaseCommitment = GenerateCoinbaseCommitment(*pblock, pindexPrev, chainparams.GetConsensus());
+    fCommitmentFixed = true;
     pblocktemplate->vTxFees[0] = -nFees;
 
     LogPrintf("CreateNewBlock(): block weight: %u txs: %u fees: %ld sigops %d\n", GetBlockWeight(*pblock), nBlockTx, nFees, nBlockSigOpsCost);
@@ -266,6 +267,52 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     return std::move(pblocktemplate);
 }
 
+bool BlockAssembler::AddMempoolTxs(const std::vector<CTxMemPool::txiter>& vAdded)
+{
+    fLeftOut = false;
+
+    // Queue the new transactions in mapModifiedTx with their ancestor state adjusted for the ancestors
+    // already in the block. Older transactions can't descend from them, so no other package changes
+    std::vector<CTxMemPool::txiter> vSpends;
+    for (CTxMemPool::txiter it : vAdded) {
+        if (inBlock.count(it) || mapModifiedTx.count(it) || failedTx.count(it))
+            continue;
+        // A witness transaction would change the coinbase witness commitment, leave it to the next rebuild
+        if (fIncludeWitness && it->GetTx().HasWitness()) {
+            fLeftOut = true;
+            continue;
+        }
+        if (it->GetTx().IsZerocoinSpend()) {
+            vSpends.push_back(it);
+            continue;
+        }
+        CTxMemPoolModifiedEntry modEntry(it);
+        CTxMemPool::setEntries ancestors;
+        uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+        std::string dummy;
+        mempool.CalculateMemPoolAncestors(*it, ancestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
+        for (CTxMemPool::txiter parent : ancestors) {
+            if (!inBlock.count(parent))
+                continue;
+            modEntry.nSizeWithAncestors -= parent->GetTxSize();
+            modEntry.nModFeesWithAncestors -= parent->GetModifiedFee();
+            modEntry.nSigOpCostWithAncestors -= parent->GetSigOpCost();
+        }
+        mapModifiedTx.insert(modEntry);
+    }
+
+    int nPackagesSelected = 0;
+    int nDescendantsUpdated = 0;
+    addPackageTxs(nPackagesSelected, nDescendantsUpdated, true);
+    if (!vSpends.empty() && addZerocoinSpends(std::move(vSpends)) > 0)
+        addPackageTxs(nPackagesSelected, nDescendantsUpdated, true);
+
+    nLastBlockTx = nBlockTx;
+    nLastBlockWeight = nBlockWeight;
+    ptemplate->vTxFees[0] = -nFees;
+    return !fLeftOut;
+}
+
 void BlockAssembler::onlyUnconfirmed(CTxMemPool::setEntries& testSet)
 {
     for (CTxMemPool::setEntries::iterator iit = testSet.begin(); iit != testSet.end(); ) {
@@ -298,7 +345,7 @@ bool BlockAssembler::TestPackageTransactions(const CTxMemPool::setEntries& packa
     for (const CTxMemPool::txiter it : package) {
         if (!IsFinalTx(it->GetTx(), nHeight, nLockTimeCutoff))
             return false;
-        if (!fIncludeWitness && it->GetTx().HasWitness())
+        if ((!fIncludeWitness || fCommitmentFixed) && it->GetTx().HasWitness())
             return false;
     }
     return true;
@@ -307,12 +354,14 @@ bool BlockAssembler::TestPackageTransactions(const CTxMemPool::setEntries& packa
 void BlockAssembler::AddToBlock(CTxMemPool::txiter iter)
 {
     pblock->vtx.emplace_back(iter->GetSharedTx());
-    pblocktemplate->vTxFees.push_back(iter->GetFee());
-    pblocktemplate->vTxSigOpsCost.push_back(iter->GetSigOpCost());
+    ptemplate->vTxFees.push_back(iter->GetFee());
+    ptemplate->vTxSigOpsCost.push_back(iter->GetSigOpCost());
     nBlockWeight += iter->GetTxWeight();
     ++nBlockTx;
     nBlockSigOpsCost += iter->GetSigOpCost();
     nFees += iter->GetFee();
+    if (iter->GetTx().IsZerocoinSpend())
+        nBlockZerocoinSpends++;
     inBlock.insert(iter);
 
     bool fPrintPriority = gArgs.GetBoolArg("-printpriority", DEFAULT_PRINTPRIORITY);
@@ -323,8 +372,7 @@ void BlockAssembler::AddToBlock(CTxMemPool::txiter iter)
     }
 }
 
-int BlockAssembler::UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded,
-        indexed_modified_transaction_set &mapModifiedTx)
+int BlockAssembler::UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded)
 {
     int nDescendantsUpdated = 0;
     for (const CTxMemPool::txiter it : alreadyAdded) {
@@ -359,7 +407,7 @@ int BlockAssembler::UpdatePackagesForAdded(const CTxMemPool::setEntries& already
 // guaranteed to fail again, but as a belt-and-suspenders check we put it in
 // failedTx and avoid re-evaluation, since the re-evaluation would be using
 // cached size/sigops/fee values that are not actually correct.
-bool BlockAssembler::SkipMapTxEntry(CTxMemPool::txiter it, indexed_modified_transaction_set &mapModifiedTx, CTxMemPool::setEntries &failedTx)
+bool BlockAssembler::SkipMapTxEntry(CTxMemPool::txiter it)
 {
     assert (it != mempool.mapTx.end());
     return mapModifiedTx.count(it) || inBlock.count(it) || failedTx.count(it);
@@ -386,19 +434,14 @@ void BlockAssembler::SortForBlock(const CTxMemPool::setEntries& package, CTxMemP
 // Each time through the loop, we compare the best transaction in
 // mapModifiedTxs with the next transaction in the mempool to decide what
 // transaction package to work on next.
-void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpdated)
+void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpdated, bool fDescendantsOnly)
 {
-    // mapModifiedTx will store sorted packages after they are modified
-    // because some of their txs are already in the block
-    indexed_modified_transaction_set mapModifiedTx;
-    // Keep track of entries that failed inclusion, to avoid duplicate work
-    CTxMemPool::setEntries failedTx;
-
-    // Start by adding all descendants of previously added txs to mapModifiedTx
-    // and modifying them for their already included ancestors
-    UpdatePackagesForAdded(inBlock, mapModifiedTx);
-
-    CTxMemPool::indexed_transaction_set::index<ancestor_score>::type::iterator mi = mempool.mapTx.get<ancestor_score>().begin();
+    // mapModifiedTx stores sorted packages after they are modified because
+    // some of their txs are already in the block, and failedTx the entries
+    // that failed inclusion, to avoid duplicate work. Both are kept up to
+    // date by whatever adds to the block, so they carry over between calls.
+    CTxMemPool::indexed_transaction_set::index<ancestor_score>::type::iterator mi = fDescendantsOnly ?
+        mempool.mapTx.get<ancestor_score>().end() : mempool.mapTx.get<ancestor_score>().begin();
     CTxMemPool::txiter iter;
 
     // Limit the number of attempts to add transactions to the block when it is
@@ -407,14 +450,11 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
     const int64_t MAX_CONSECUTIVE_FAILURES = 1000;
     int64_t nConsecutiveFailed = 0;
 
-    unsigned int COUNT_SPEND_ZC_TX = 0;
-    unsigned int MAX_SPEND_ZC_TX_PER_BLOCK = 5;
-
     while (mi != mempool.mapTx.get<ancestor_score>().end() || !mapModifiedTx.empty())
     {
         // First try to find a new transaction in mapTx to evaluate.
         if (mi != mempool.mapTx.get<ancestor_score>().end() &&
-                SkipMapTxEntry(mempool.mapTx.project<0>(mi), mapModifiedTx, failedTx)) {
+                SkipMapTxEntry(mempool.mapTx.project<0>(mi))) {
             ++mi;
             continue;
         }
@@ -465,6 +505,7 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
         }
 
         if (!TestPackage(packageSize, packageSigOpsCost)) {
+            fLeftOut = true;
             if (fUsingModified) {
                 // Since we always look at the best entry in mapModifiedTx,
                 // we must erase failed entries so that we can consider the
@@ -491,6 +532,21 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
         onlyUnconfirmed(ancestors);
         ancestors.insert(iter);
 
+        // Spend slots are the other resource a package uses
+        unsigned int nPackageSpends = 0;
+        for (CTxMemPool::txiter it : ancestors) {
+            if (it->GetTx().IsZerocoinSpend())
+                nPackageSpends++;
+        }
+        if (nBlockZerocoinSpends + nPackageSpends > MAX_SPEND_ZC_TX_PER_BLOCK) {
+            fLeftOut = true;
+            if (fUsingModified) {
+                mapModifiedTx.get<ancestor_score>().erase(modit);
+                failedTx.insert(iter);
+            }
+            continue;
+        }
+
         // Test if all tx's are Final
         if (!TestPackageTransactions(ancestors)) {
             if (fUsingModified) {
@@ -508,13 +564,7 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
         SortForBlock(ancestors, iter, sortedEntries);
 
         for (size_t i=0; i<sortedEntries.size(); ++i) {
-            if(sortedEntries[i]->GetTx().IsZerocoinSpend()){
-                if(MAX_SPEND_ZC_TX_PER_BLOCK >= COUNT_SPEND_ZC_TX)
-                    AddToBlock(sortedEntries[i]);
-                COUNT_SPEND_ZC_TX++;
-            }
-            else
-                AddToBlock(sortedEntries[i]);
+            AddToBlock(sortedEntries[i]);
             // Erase from the modified set, if present
             mapModifiedTx.erase(sortedEntries[i]);
         }
@@ -522,8 +572,86 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected, int &nDescendantsUpda
         ++nPackagesSelected;
 
         // Update transactions that depend on each of these
-        nDescendantsUpdated += UpdatePackagesForAdded(ancestors, mapModifiedTx);
+        nDescendantsUpdated += UpdatePackagesForAdded(ancestors);
+    }
+}
+
+int BlockAssembler::addZerocoinSpends(std::vector<CTxMemPool::txiter> vSpends)
+{
+    // Spends have no in-mempool ancestors, their inputs are coins of the zerocoin accumulators
+    std::stable_sort(vSpends.begin(), vSpends.end(), [](CTxMemPool::txiter a, CTxMemPool::txiter b) {
+        return CFeeRate(a->GetModifiedFee(), a->GetTxSize()) > CFeeRate(b->GetModifiedFee(), b->GetTxSize());
+    });
+
+    CTxMemPool::setEntries added;
+    for (CTxMemPool::txiter it : vSpends) {
+        if (nBlockZerocoinSpends >= MAX_SPEND_ZC_TX_PER_BLOCK || !TestPackage(it->GetTxSize(), it->GetSigOpCost())) {
+            fLeftOut = true;
+            continue;
+        }
+        CTxMemPool::setEntries package;
+        package.insert(it);
+        if (!TestPackageTransactions(package))
+            continue;
+        AddToBlock(it);
+        added.insert(it);
     }
+    // Descendants of the spends are packages for the next addPackageTxs pass
+    UpdatePackagesForAdded(added);
+    return added.size();
+}
+
+// Hashes computed by ScanNonces and the time it spent on them, for the hash rate reported by getmininginfo
+static std::atomic<uint64_t> nMinerHashes(0);
+static std::atomic<int64_t> nMinerMicros(0);
+
+bool ScanNonces(CBlockHeader* pblock, int nHeight, uint32_t nNonceEnd, uint64_t& nMaxTries, int nThreads, const Consensus::Params& consensusParams)
+{
+    const uint32_t nNonceBegin = pblock->nNonce;
+    const uint64_t nMaxTriesIn = nMaxTries;
+    std::atomic<bool> fFound(false);
+    std::atomic<uint64_t> nTries(0);
+    uint32_t nFoundNonce = nNonceEnd;
+    int64_t nTimeStart = GetTimeMicros();
+
+    // Thread i tries the nonces nNonceBegin + i, nNonceBegin + i + nThreads, ... on its own copy of the header
+    auto scan = [&](int nThread) {
+        CBlockHeader header(*pblock);
+        for (uint64_t nNonce = (uint64_t)nNonceBegin + nThread; nNonce < nNonceEnd && !fFound.load(std::memory_order_relaxed); nNonce += nThreads) {
+            if (nTries.fetch_add(1, std::memory_order_relaxed) >= nMaxTriesIn)
+                break;
+            header.nNonce = nNonce;
+            if (CheckProofOfWork(header.GetPoWHash(nHeight), header.nBits, consensusParams)) {
+                if (!fFound.exchange(true))
+                    nFoundNonce = nNonce;
+                break;
+            }
+        }
+    };
+
+    nThreads = std::max(nThreads, 1);
+    std::vector<std::thread> threads;
+    for (int i = 1; i < nThreads; i++)
+        threads.emplace_back(scan, i);
+    scan(0);
+    for (std::thread& thread : threads)
+        thread.join();
+
+    uint64_t nDone = std::min(nTries.load(), nMaxTriesIn);
+    nMaxTries -= nDone;
+    nMinerHashes += nDone;
+    nMinerMicros += GetTimeMicros() - nTimeStart;
+
+    pblock->nNonce = nFoundNonce;
+    return fFound;
+}
+
+double GetMinerHashesPerSec()
+{
+    int64_t nMicros = nMinerMicros;
+    if (nMicros == 0)
+        return 0;
+    return nMinerHashes * 1000000.0 / nMicros;
 }
 
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce)
@@ -125,7 +125,9 @@ class BlockAssembler
 private:
     // The constructed block template
     std::unique_ptr<CBlockTemplate> pblocktemplate;
-    // A convenience pointer that always refers to the CBlock in pblocktemplate
+    // Convenience pointers that always refer to the template being built and its CBlock. They stay
+    // valid after CreateNewBlock hands the template out, so that AddMempoolTx can keep extending it
+    CBlockTemplate* ptemplate;
     CBlock* pblock;
 
     // Configuration parameters for the block size
@@ -138,7 +140,18 @@ private:
     uint64_t nBlockTx;
     uint64_t nBlockSigOpsCost;
     CAmount nFees;
+    unsigned int nBlockZerocoinSpends;
     CTxMemPool::setEntries inBlock;
+    // Set once the coinbase witness commitment is generated, witness transactions can't be appended after that
+    bool fCommitmentFixed;
+    // Set when the last selection pass left out a transaction for lack of room or spend slots
+    bool fLeftOut;
+
+    // Selection state kept for the life of the template, so that AddMempoolTxs only has to look at the new
+    // transactions: packages with ancestors in the block, with their ancestor state adjusted for them, and
+    // the packages that failed
+    indexed_modified_transaction_set mapModifiedTx;
+    CTxMemPool::setEntries failedTx;
 
     // Chain context for the block
     int nHeight;
@@ -158,6 +171,14 @@ public:
     /** Construct a new block template with coinbase to scriptPubKeyIn */
     std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn, bool fMineWitnessTx=true);
 
+    /** Append transactions that entered the memory pool after CreateNewBlock to the template it returned,
+      * without rebuilding it. The template must still be alive, the tip unchanged and no transaction removed
+      * from the memory pool since. The new transactions are selected by ancestor fee rate together with the
+      * packages the template left out, so a new child can pull in a parent that was left out, and nothing
+      * else in the memory pool is looked at again. Returns false if something did not fit, in which case
+      * rebuilding the template could select better transactions. Requires cs_main and mempool.cs */
+    bool AddMempoolTxs(const std::vector<CTxMemPool::txiter>& vAdded);
+
 private:
     // utility functions
     /** Clear the block's state and prepare for assembling a new block */
@@ -168,8 +189,14 @@ private:
     // Methods for how to add transactions to a block.
     /** Add transactions based on feerate including unconfirmed ancestors
       * Increments nPackagesSelected / nDescendantsUpdated with corresponding
-      * statistics from the package selection (for logging statistics). */
-    void addPackageTxs(int &nPackagesSelected, int &nDescendantsUpdated);
+      * statistics from the package selection (for logging statistics).
+      * With fDescendantsOnly only the packages already in mapModifiedTx are
+      * considered. */
+    void addPackageTxs(int &nPackagesSelected, int &nDescendantsUpdated, bool fDescendantsOnly = false);
+    /** Fill the zerocoin spend slots addPackageTxs left with the spends from vSpends paying the most, then
+      * the oldest, that fit. The outputs of a spend add up to the denomination of its coin, so a spend pays
+      * nothing unless prioritised and is exempt from blockMinFeeRate. Returns the number of spends added */
+    int addZerocoinSpends(std::vector<CTxMemPool::txiter> vSpends);
 
     // helper functions for addPackageTxs()
     /** Remove confirmed (inBlock) entries from given set */
@@ -183,15 +210,30 @@ private:
     bool TestPackageTransactions(const CTxMemPool::setEntries& package);
     /** Return true if given transaction from mapTx has already been evaluated,
       * or if the transaction's cached data in mapTx is incorrect. */
-    bool SkipMapTxEntry(CTxMemPool::txiter it, indexed_modified_transaction_set &mapModifiedTx, CTxMemPool::setEntries &failedTx);
+    bool SkipMapTxEntry(CTxMemPool::txiter it);
     /** Sort the package in an order that is valid to appear in a block */
     void SortForBlock(const CTxMemPool::setEntries& package, CTxMemPool::txiter entry, std::vector<CTxMemPool::txiter>& sortedEntries);
     /** Add descendants of given transactions to mapModifiedTx with ancestor
       * state updated assuming given transactions are inBlock. Returns number
       * of updated descendants. */
-    int UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded, indexed_modified_transaction_set &mapModifiedTx);
+    int UpdatePackagesForAdded(const CTxMemPool::setEntries& alreadyAdded);
 };
 
+/** Maximum number of zerocoin spends in a block template, spend slots are filled separately from block weight */
+static const unsigned int MAX_SPEND_ZC_TX_PER_BLOCK = 5;
+
+/** Default for -genproclimit, 0 means one thread per core */
+static const int DEFAULT_GENERATE_THREADS = 0;
+
+/**
+ * Search the nonces from pblock->nNonce up to nNonceEnd for one that satisfies the proof of work, splitting
+ * them across nThreads threads. At most nMaxTries hashes are computed and nMaxTries is reduced by the number
+ * done. Returns true with the nonce set in the header if one was found, otherwise the nonce is left at nNonceEnd
+ */
+bool ScanNonces(CBlockHeader* pblock, int nHeight, uint32_t nNonceEnd, uint64_t& nMaxTries, int nThreads, const Consensus::Params& consensusParams);
+/** Average hash rate of ScanNonces while it was running, in hashes per second */
+double GetMinerHashesPerSec();
+
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock* pblock, const CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
 int64_t UpdateTime(CBlockHeader* pblock, const Consensus::Params& consensusParams, const CBlockIndex* pindexPrev);
@@ -14,6 +14,7 @@
 #include <consensus/consensus.h>
 #include <crypto/common.h>
 #include <crypto/sha256.h>
+#include <metrics.h>
 #include <primitives/transaction.h>
 #include <netbase.h>
 #include <scheduler.h>
@@ -27,6 +28,15 @@
 #include <fcntl.h>
 #endif
 
+#ifdef HAVE_EPOLL
+#include <sys/epoll.h>
+#endif
+
+#ifdef HAVE_KQUEUE
+#include <sys/event.h>
+#include <sys/time.h>
+#endif
+
 #ifdef USE_UPNP
 #include <miniupnpc/miniupnpc.h>
 #include <miniupnpc/miniwget.h>
@@ -71,6 +81,22 @@ enum BindFlags {
     BF_WHITELIST    = (1U << 2),
 };
 
+/** Readiness of a socket returned by CConnman::WaitSocketEvents */
+enum SocketEventFlags {
+    SOCKET_EVENT_RECV  = (1U << 0),
+    SOCKET_EVENT_SEND  = (1U << 1),
+    SOCKET_EVENT_ERROR = (1U << 2),
+};
+
+/** How long the socket handler thread waits before it looks at the send buffers again */
+static const int SOCKET_EVENTS_TIMEOUT_MILLISECONDS = 50;
+
+/** Maximum number of ready sockets taken from epoll or kqueue in one wait, the rest are left for the next one */
+static const int MAX_SOCKET_EVENTS = 1024;
+
+/** Maximum number of queued buffers handed to the kernel in one send, well below any IOV_MAX */
+static const size_t SEND_IOV_MAX = 64;
+
 const static std::string NET_MESSAGE_COMMAND_OTHER = "*other*";
 
 static const uint64_t RANDOMIZER_ID_NETGROUP = 0x6c0edd8036ef4036ULL; // SHA256("netgroup")[0:8]
@@ -88,6 +114,17 @@ std::string strSubVersion;
 
 limitedmap<uint256, int64_t> mapAlreadyAskedFor(MAX_INV_SZ);
 
+BufferPool<CSerializeData> g_net_recv_buffers;
+BufferPool<std::vector<unsigned char>> g_net_send_buffers;
+
+/** Hand the buffer of a processed message back to g_net_recv_buffers */
+static void RecycleRecvBuffer(CDataStream& vRecv)
+{
+    CSerializeData buffer;
+    vRecv.swap(buffer);
+    g_net_recv_buffers.Put(buffer);
+}
+
 void CConnman::AddOneShot(const std::string& strDest)
 {
     LOCK(cs_vOneShots);
@@ -99,6 +136,62 @@ unsigned short GetListenPort()
     return (unsigned short)(gArgs.GetArg("-port", Params().GetDefaultPort()));
 }
 
+SocketEventsMode GetDefaultSocketEventsMode()
+{
+#if defined(HAVE_EPOLL)
+    return SOCKETEVENTS_EPOLL;
+#elif defined(HAVE_KQUEUE)
+    return SOCKETEVENTS_KQUEUE;
+#else
+    return SOCKETEVENTS_SELECT;
+#endif
+}
+
+bool ParseSocketEventsMode(const std::string& str, SocketEventsMode& mode)
+{
+    if (str == "select") {
+        mode = SOCKETEVENTS_SELECT;
+        return true;
+    }
+#ifdef HAVE_EPOLL
+    if (str == "epoll") {
+        mode = SOCKETEVENTS_EPOLL;
+        return true;
+    }
+#endif
+#ifdef HAVE_KQUEUE
+    if (str == "kqueue") {
+        mode = SOCKETEVENTS_KQUEUE;
+        return true;
+    }
+#endif
+    return false;
+}
+
+std::string GetSocketEventsModeName(SocketEventsMode mode)
+{
+    switch (mode) {
+    case SOCKETEVENTS_EPOLL:
+        return "epoll";
+    case SOCKETEVENTS_KQUEUE:
+        return "kqueue";
+    default:
+        return "select";
+    }
+}
+
+std::string GetSupportedSocketEventsModes()
+{
+    std::string strModes = "select";
+#ifdef HAVE_EPOLL
+    strModes += ", epoll";
+#endif
+#ifdef HAVE_KQUEUE
+    strModes += ", kqueue";
+#endif
+    return strModes;
+}
+
 // find 'best' local address for a particular peer
 bool GetLocal(CService& addr, const CNetAddr *paddrPeer)
 {
@@ -449,6 +542,11 @@ CNode* CConnman::ConnectNode(CAddress addrConnect, const char *pszDest, bool fCo
         CloseSocket(hSocket);
         return nullptr;
     }
+    if (socketEventsMode == SOCKETEVENTS_SELECT && !IsSelectableSocket(hSocket)) {
+        LogPrintf("Cannot create connection: non-selectable socket created (fd >= FD_SETSIZE ?)\n");
+        CloseSocket(hSocket);
+        return nullptr;
+    }
 
     // Add node
     NodeId id = GetNewNodeId();
@@ -705,12 +803,20 @@ void CNode::copyStats(CNodeStats &stats)
         LOCK(cs_vSend);
         X(mapSendBytesPerMsgCmd);
         X(nSendBytes);
+        X(nSendStallTime);
+        if (fPauseSend)
+            stats.nSendStallTime += GetTimeMicros() - nSendStallStart;
     }
     {
         LOCK(cs_vRecv);
         X(mapRecvBytesPerMsgCmd);
         X(nRecvBytes);
     }
+    X(nProcessTime);
+    {
+        LOCK(cs_processTime);
+        X(mapProcessTimePerMsgCmd);
+    }
     X(fWhitelisted);
 
     // It is common for nodes with good ping times to suddenly become lagged,
@@ -747,7 +853,7 @@ bool CNode::ReceiveMsgBytes(const char *pch, unsigned int nBytes, bool& complete
         // get current incomplete message, or create a new one
         if (vRecvMsg.empty() ||
             vRecvMsg.back().complete())
-            vRecvMsg.push_back(CNetMessage(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION));
+            vRecvMsg.emplace_back(Params().MessageStart(), SER_NETWORK, INIT_PROTO_VERSION);
 
         CNetMessage& msg = vRecvMsg.back();
 
@@ -839,6 +945,10 @@ int CNetMessage::readHeader(const char *pch, unsigned int nBytes)
     if (hdr.nMessageSize > MAX_SIZE)
         return -1;
 
+    // receive the data into a recycled buffer, up to 256 KiB of it
+    CSerializeData buffer = g_net_recv_buffers.Get(std::min(hdr.nMessageSize, 256U * 1024));
+    vRecv.swap(buffer);
+
     // switch state to reading message data
     in_data = true;
 
@@ -862,6 +972,11 @@ int CNetMessage::readData(const char *pch, unsigned int nBytes)
     return nCopy;
 }
 
+CNetMessage::~CNetMessage()
+{
+    RecycleRecvBuffer(vRecv);
+}
+
 const uint256& CNetMessage::GetMessageHash() const
 {
     assert(complete());
@@ -885,27 +1000,54 @@ size_t CConnman::SocketSendData(CNode *pnode) const
     size_t nSentSize = 0;
 
     while (it != pnode->vSendMsg.end()) {
-        const auto &data = *it;
-        assert(data.size() > pnode->nSendOffset);
+        assert(it->size() > pnode->nSendOffset);
+        size_t nBatchSize = 0;
         int nBytes = 0;
         {
             LOCK(pnode->cs_hSocket);
             if (pnode->hSocket == INVALID_SOCKET)
                 break;
-            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(data.data()) + pnode->nSendOffset, data.size() - pnode->nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+#ifdef WIN32
+            nBatchSize = it->size() - pnode->nSendOffset;
+            nBytes = send(pnode->hSocket, reinterpret_cast<const char*>(it->data()) + pnode->nSendOffset, nBatchSize, MSG_NOSIGNAL | MSG_DONTWAIT);
+#else
+            // Hand the kernel up to SEND_IOV_MAX queued messages, headers and payloads, in one call
+            struct iovec iov[SEND_IOV_MAX];
+            size_t nIov = 0;
+            size_t nOffset = pnode->nSendOffset;
+            for (auto itBatch = it; itBatch != pnode->vSendMsg.end() && nIov < SEND_IOV_MAX; ++itBatch) {
+                iov[nIov].iov_base = const_cast<unsigned char*>(itBatch->data()) + nOffset;
+                iov[nIov].iov_len = itBatch->size() - nOffset;
+                nBatchSize += iov[nIov].iov_len;
+                nIov++;
+                nOffset = 0;
+            }
+            struct msghdr msg = {};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = nIov;
+            nBytes = sendmsg(pnode->hSocket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+#endif
         }
         if (nBytes > 0) {
             pnode->nLastSend = GetSystemTimeInSeconds();
             pnode->nSendBytes += nBytes;
-            pnode->nSendOffset += nBytes;
             nSentSize += nBytes;
-            if (pnode->nSendOffset == data.size()) {
+            // Step over the messages that were sent completely
+            size_t nLeft = nBytes;
+            while (nLeft > 0) {
+                const size_t nRemaining = it->size() - pnode->nSendOffset;
+                if (nLeft < nRemaining) {
+                    pnode->nSendOffset += nLeft;
+                    break;
+                }
+                nLeft -= nRemaining;
                 pnode->nSendOffset = 0;
-                pnode->nSendSize -= data.size();
-                pnode->fPauseSend = pnode->nSendSize > nSendBufferMaxSize;
+                pnode->nSendSize -= it->size();
                 it++;
-            } else {
-                // could not send full message; stop sending more
+            }
+            pnode->SetPauseSend(pnode->nSendSize > nSendBufferMaxSize);
+            if ((size_t)nBytes < nBatchSize) {
+                // could not send everything; stop sending more
                 break;
             }
         } else {
@@ -927,6 +1069,8 @@ size_t CConnman::SocketSendData(CNode *pnode) const
         assert(pnode->nSendOffset == 0);
         assert(pnode->nSendSize == 0);
     }
+    for (auto itSent = pnode->vSendMsg.begin(); itSent != it; ++itSent)
+        g_net_send_buffers.Put(*itSent);
     pnode->vSendMsg.erase(pnode->vSendMsg.begin(), it);
     return nSentSize;
 }
@@ -943,6 +1087,7 @@ struct NodeEvictionCandidate
     bool fBloomFilter;
     CAddress addr;
     uint64_t nKeyedNetGroup;
+    int64_t nServeTime;
 };
 
 static bool ReverseCompareNodeMinPingTime(const NodeEvictionCandidate &a, const NodeEvictionCandidate &b)
@@ -1010,7 +1155,8 @@ bool CConnman::AttemptToEvictConnection()
             NodeEvictionCandidate candidate = {node->GetId(), node->nTimeConnected, node->nMinPingUsecTime,
                                                node->nLastBlockTime, node->nLastTXTime,
                                                HasAllDesirableServiceFlags(node->nServices),
-                                               node->fRelayTxes, node->pfilter != nullptr, node->addr, node->nKeyedNetGroup};
+                                               node->fRelayTxes, node->pfilter != nullptr, node->addr, node->nKeyedNetGroup,
+                                               node->nServeTime};
             vEvictionCandidates.push_back(candidate);
         }
     }
@@ -1056,8 +1202,18 @@ bool CConnman::AttemptToEvictConnection()
     // Reduce to the network group with the most connections
     vEvictionCandidates = std::move(mapNetGroupNodes[naMostConnections]);
 
-    // Disconnect from the network group with the most connections
+    // Disconnect from the network group with the most connections, the peer that takes the most
+    // time serving its requests per second connected, or the youngest one if none takes more than it
     NodeId evicted = vEvictionCandidates.front().id;
+    int64_t nNow = GetSystemTimeInSeconds();
+    double dMostServeTime = -1;
+    for (const NodeEvictionCandidate &node : vEvictionCandidates) {
+        double dServeTime = (double)node.nServeTime / std::max<int64_t>(1, nNow - node.nTimeConnected);
+        if (dServeTime > dMostServeTime) {
+            dMostServeTime = dServeTime;
+            evicted = node.id;
+        }
+    }
     LOCK(cs_vNodes);
     for (CNode* pnode : vNodes) {
         if (pnode->GetId() == evicted) {
@@ -1104,7 +1260,7 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
         return;
     }
 
-    if (!IsSelectableSocket(hSocket))
+    if (socketEventsMode == SOCKETEVENTS_SELECT && !IsSelectableSocket(hSocket))
     {
         LogPrintf("connection from %s dropped: non-selectable socket\n", addr.ToString());
         CloseSocket(hSocket);
@@ -1146,11 +1302,258 @@ void CConnman::AcceptConnection(const ListenSocket& hListenSocket) {
     {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
+        UpdatePeerMetrics();
     }
 }
 
+void CConnman::SocketEvents(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    if (socketEventsMode == SOCKETEVENTS_SELECT)
+        SocketEventsSelect(recv_set, send_set, error_set);
+    else
+        SocketEventsEdgeTriggered(recv_set, send_set, error_set);
+}
+
+void CConnman::SocketEventsSelect(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    struct timeval timeout;
+    timeout.tv_sec  = 0;
+    timeout.tv_usec = SOCKET_EVENTS_TIMEOUT_MILLISECONDS * 1000; // frequency to poll pnode->vSend
+
+    fd_set fdsetRecv;
+    fd_set fdsetSend;
+    fd_set fdsetError;
+    FD_ZERO(&fdsetRecv);
+    FD_ZERO(&fdsetSend);
+    FD_ZERO(&fdsetError);
+    SOCKET hSocketMax = 0;
+    bool have_fds = false;
+    std::vector<SOCKET> vSockets;
+
+    for (const ListenSocket& hListenSocket : vhListenSocket) {
+        FD_SET(hListenSocket.socket, &fdsetRecv);
+        hSocketMax = std::max(hSocketMax, hListenSocket.socket);
+        have_fds = true;
+        vSockets.push_back(hListenSocket.socket);
+    }
+
+    {
+        LOCK(cs_vNodes);
+        for (CNode* pnode : vNodes)
+        {
+            // Implement the following logic:
+            // * If there is data to send, select() for sending data. As this only
+            //   happens when optimistic write failed, we choose to first drain the
+            //   write buffer in this case before receiving more. This avoids
+            //   needlessly queueing received data, if the remote peer is not themselves
+            //   receiving data. This means properly utilizing TCP flow control signalling.
+            // * Otherwise, if there is space left in the receive buffer, select() for
+            //   receiving data.
+            // * Hand off all complete messages to the processor, to be handled without
+            //   blocking here.
+
+            bool select_recv = !pnode->fPauseRecv;
+            bool select_send;
+            {
+                LOCK(pnode->cs_vSend);
+                select_send = !pnode->vSendMsg.empty();
+            }
+
+            LOCK(pnode->cs_hSocket);
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+
+            FD_SET(pnode->hSocket, &fdsetError);
+            hSocketMax = std::max(hSocketMax, pnode->hSocket);
+            have_fds = true;
+            vSockets.push_back(pnode->hSocket);
+
+            if (select_send) {
+                FD_SET(pnode->hSocket, &fdsetSend);
+                continue;
+            }
+            if (select_recv) {
+                FD_SET(pnode->hSocket, &fdsetRecv);
+            }
+        }
+    }
+
+    int nSelect = select(have_fds ? hSocketMax + 1 : 0,
+                         &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+    if (interruptNet)
+        return;
+
+    if (nSelect == SOCKET_ERROR)
+    {
+        if (have_fds)
+        {
+            int nErr = WSAGetLastError();
+            LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
+            recv_set.insert(vSockets.begin(), vSockets.end());
+        }
+        interruptNet.sleep_for(std::chrono::milliseconds(SOCKET_EVENTS_TIMEOUT_MILLISECONDS));
+        return;
+    }
+
+    for (SOCKET hSocket : vSockets) {
+        if (FD_ISSET(hSocket, &fdsetRecv))
+            recv_set.insert(hSocket);
+        if (FD_ISSET(hSocket, &fdsetSend))
+            send_set.insert(hSocket);
+        if (FD_ISSET(hSocket, &fdsetError))
+            error_set.insert(hSocket);
+    }
+}
+
+/**
+ * Wait with epoll or kqueue. The sockets stay registered until they are closed, and are only reported
+ * when they become readable or writable, so the readiness is remembered in the node until recv() or
+ * send() shows it was used up. Nodes with readiness left are serviced without waiting.
+ */
+void CConnman::SocketEventsEdgeTriggered(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set)
+{
+    // Only this thread deletes nodes, so the pointers stay valid until it returns
+    std::map<SOCKET, CNode*> mapNodeSockets;
+
+    // Same order as select(): a node with data to send is not read from until it is sent
+    auto fnCollect = [&recv_set, &send_set](CNode* pnode, SOCKET hSocket) {
+        bool fSend;
+        {
+            LOCK(pnode->cs_vSend);
+            fSend = !pnode->vSendMsg.empty();
+        }
+        if (fSend) {
+            if (pnode->fCanSendData)
+                send_set.insert(hSocket);
+        } else if (!pnode->fPauseRecv && pnode->fHasRecvData) {
+            recv_set.insert(hSocket);
+        }
+    };
+
+    {
+        LOCK(cs_vNodes);
+        for (CNode* pnode : vNodes) {
+            LOCK(pnode->cs_hSocket);
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+            if (!pnode->fSocketEventsRegistered) {
+                if (!RegisterSocketEvents(pnode->hSocket, true)) {
+                    LogPrintf("socket events registration error %s\n", NetworkErrorString(WSAGetLastError()));
+                    pnode->fDisconnect = true;
+                    continue;
+                }
+                // it may have become ready before it was registered
+                pnode->fSocketEventsRegistered = true;
+                pnode->fHasRecvData = true;
+                pnode->fCanSendData = true;
+            }
+            mapNodeSockets[pnode->hSocket] = pnode;
+            fnCollect(pnode, pnode->hSocket);
+        }
+    }
+    bool fPending = !recv_set.empty() || !send_set.empty();
+
+    std::vector<std::pair<SOCKET, int>> vReady;
+    if (!WaitSocketEvents(fPending ? 0 : SOCKET_EVENTS_TIMEOUT_MILLISECONDS, vReady)) {
+        LogPrintf("socket events error %s\n", NetworkErrorString(WSAGetLastError()));
+        if (!fPending)
+            interruptNet.sleep_for(std::chrono::milliseconds(SOCKET_EVENTS_TIMEOUT_MILLISECONDS));
+        return;
+    }
+
+    for (const std::pair<SOCKET, int>& ready : vReady) {
+        std::map<SOCKET, CNode*>::iterator it = mapNodeSockets.find(ready.first);
+        if (it == mapNodeSockets.end()) {
+            // listening sockets are level-triggered
+            if (ready.second & SOCKET_EVENT_RECV)
+                recv_set.insert(ready.first);
+            continue;
+        }
+        CNode* pnode = it->second;
+        if (ready.second & (SOCKET_EVENT_RECV | SOCKET_EVENT_ERROR))
+            pnode->fHasRecvData = true;
+        if (ready.second & SOCKET_EVENT_SEND)
+            pnode->fCanSendData = true;
+        if (ready.second & SOCKET_EVENT_ERROR)
+            error_set.insert(ready.first);
+        fnCollect(pnode, ready.first);
+    }
+}
+
+bool CConnman::RegisterSocketEvents(SOCKET hSocket, bool fEdgeTriggered)
+{
+#ifdef HAVE_EPOLL
+    if (socketEventsMode == SOCKETEVENTS_EPOLL) {
+        struct epoll_event event = {};
+        event.data.fd = hSocket;
+        event.events = fEdgeTriggered ? (EPOLLIN | EPOLLOUT | EPOLLET) : EPOLLIN;
+        return epoll_ctl(hSocketEvents, EPOLL_CTL_ADD, hSocket, &event) == 0;
+    }
+#endif
+#ifdef HAVE_KQUEUE
+    if (socketEventsMode == SOCKETEVENTS_KQUEUE) {
+        struct kevent events[2];
+        EV_SET(&events[0], hSocket, EVFILT_READ, EV_ADD | (fEdgeTriggered ? EV_CLEAR : 0), 0, 0, nullptr);
+        EV_SET(&events[1], hSocket, EVFILT_WRITE, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+        return kevent(hSocketEvents, events, fEdgeTriggered ? 2 : 1, nullptr, 0, nullptr) == 0;
+    }
+#endif
+    return true;
+}
+
+bool CConnman::WaitSocketEvents(int nTimeout, std::vector<std::pair<SOCKET, int>>& vReady)
+{
+#ifdef HAVE_EPOLL
+    if (socketEventsMode == SOCKETEVENTS_EPOLL) {
+        struct epoll_event events[MAX_SOCKET_EVENTS];
+        int nEvents = epoll_wait(hSocketEvents, events, MAX_SOCKET_EVENTS, nTimeout);
+        if (nEvents < 0)
+            return WSAGetLastError() == WSAEINTR;
+        for (int i = 0; i < nEvents; i++) {
+            int nFlags = 0;
+            if (events[i].events & EPOLLIN)
+                nFlags |= SOCKET_EVENT_RECV;
+            if (events[i].events & EPOLLOUT)
+                nFlags |= SOCKET_EVENT_SEND;
+            if (events[i].events & (EPOLLERR | EPOLLHUP))
+                nFlags |= SOCKET_EVENT_ERROR;
+            vReady.emplace_back((SOCKET)events[i].data.fd, nFlags);
+        }
+        return true;
+    }
+#endif
+#ifdef HAVE_KQUEUE
+    if (socketEventsMode == SOCKETEVENTS_KQUEUE) {
+        struct kevent events[MAX_SOCKET_EVENTS];
+        struct timespec timeout;
+        timeout.tv_sec = nTimeout / 1000;
+        timeout.tv_nsec = (nTimeout % 1000) * 1000000;
+        int nEvents = kevent(hSocketEvents, nullptr, 0, events, MAX_SOCKET_EVENTS, &timeout);
+        if (nEvents < 0)
+            return WSAGetLastError() == WSAEINTR;
+        for (int i = 0; i < nEvents; i++) {
+            int nFlags = 0;
+            if (events[i].filter == EVFILT_READ)
+                nFlags |= SOCKET_EVENT_RECV;
+            if (events[i].filter == EVFILT_WRITE)
+                nFlags |= SOCKET_EVENT_SEND;
+            if (events[i].flags & (EV_EOF | EV_ERROR))
+                nFlags |= SOCKET_EVENT_ERROR;
+            vReady.emplace_back((SOCKET)events[i].ident, nFlags);
+        }
+        return true;
+    }
+#endif
+    return false;
+}
+
 void CConnman::ThreadSocketHandler()
 {
+    for (const ListenSocket& hListenSocket : vhListenSocket) {
+        if (!RegisterSocketEvents(hListenSocket.socket, false))
+            LogPrintf("socket events registration error %s\n", NetworkErrorString(WSAGetLastError()));
+    }
+
     unsigned int nPrevNodeCount = 0;
     while (!interruptNet)
     {
@@ -1167,6 +1570,7 @@ void CConnman::ThreadSocketHandler()
                 {
                     // remove from vNodes
                     vNodes.erase(remove(vNodes.begin(), vNodes.end(), pnode), vNodes.end());
+                    UpdatePeerMetrics();
 
                     // release outbound grant (if any)
                     pnode->grantOutbound.Release();
@@ -1218,91 +1622,17 @@ void CConnman::ThreadSocketHandler()
         //
         // Find which sockets have data to receive
         //
-        struct timeval timeout;
-        timeout.tv_sec  = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
-
-        for (const ListenSocket& hListenSocket : vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = std::max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
-        }
-
-        {
-            LOCK(cs_vNodes);
-            for (CNode* pnode : vNodes)
-            {
-                // Implement the following logic:
-                // * If there is data to send, select() for sending data. As this only
-                //   happens when optimistic write failed, we choose to first drain the
-                //   write buffer in this case before receiving more. This avoids
-                //   needlessly queueing received data, if the remote peer is not themselves
-                //   receiving data. This means properly utilizing TCP flow control signalling.
-                // * Otherwise, if there is space left in the receive buffer, select() for
-                //   receiving data.
-                // * Hand off all complete messages to the processor, to be handled without
-                //   blocking here.
-
-                bool select_recv = !pnode->fPauseRecv;
-                bool select_send;
-                {
-                    LOCK(pnode->cs_vSend);
-                    select_send = !pnode->vSendMsg.empty();
-                }
-
-                LOCK(pnode->cs_hSocket);
-                if (pnode->hSocket == INVALID_SOCKET)
-                    continue;
-
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = std::max(hSocketMax, pnode->hSocket);
-                have_fds = true;
-
-                if (select_send) {
-                    FD_SET(pnode->hSocket, &fdsetSend);
-                    continue;
-                }
-                if (select_recv) {
-                    FD_SET(pnode->hSocket, &fdsetRecv);
-                }
-            }
-        }
-
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-                             &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+        std::set<SOCKET> recv_set, send_set, error_set;
+        SocketEvents(recv_set, send_set, error_set);
         if (interruptNet)
             return;
 
-        if (nSelect == SOCKET_ERROR)
-        {
-            if (have_fds)
-            {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
-            }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            if (!interruptNet.sleep_for(std::chrono::milliseconds(timeout.tv_usec/1000)))
-                return;
-        }
-
         //
         // Accept new connections
         //
         for (const ListenSocket& hListenSocket : vhListenSocket)
         {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv))
+            if (hListenSocket.socket != INVALID_SOCKET && recv_set.count(hListenSocket.socket) > 0)
             {
                 AcceptConnection(hListenSocket);
             }
@@ -1333,9 +1663,9 @@ void CConnman::ThreadSocketHandler()
                 LOCK(pnode->cs_hSocket);
                 if (pnode->hSocket == INVALID_SOCKET)
                     continue;
-                recvSet = FD_ISSET(pnode->hSocket, &fdsetRecv);
-                sendSet = FD_ISSET(pnode->hSocket, &fdsetSend);
-                errorSet = FD_ISSET(pnode->hSocket, &fdsetError);
+                recvSet = recv_set.count(pnode->hSocket) > 0;
+                sendSet = send_set.count(pnode->hSocket) > 0;
+                errorSet = error_set.count(pnode->hSocket) > 0;
             }
             if (recvSet || errorSet)
             {
@@ -1350,6 +1680,9 @@ void CConnman::ThreadSocketHandler()
                 }
                 if (nBytes > 0)
                 {
+                    // An edge-triggered mode reports new data once, the socket is read until it is drained
+                    if (nBytes < (int)sizeof(pchBuf))
+                        pnode->fHasRecvData = false;
                     bool notify = false;
                     if (!pnode->ReceiveMsgBytes(pchBuf, nBytes, notify))
                         pnode->CloseSocketDisconnect();
@@ -1383,6 +1716,8 @@ void CConnman::ThreadSocketHandler()
                 {
                     // error
                     int nErr = WSAGetLastError();
+                    if (nErr == WSAEWOULDBLOCK)
+                        pnode->fHasRecvData = false;
                     if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS)
                     {
                         if (!pnode->fDisconnect)
@@ -1402,6 +1737,9 @@ void CConnman::ThreadSocketHandler()
                 if (nBytes) {
                     RecordBytesSent(nBytes);
                 }
+                // Data left means the send buffer of the socket is full
+                if (!pnode->vSendMsg.empty())
+                    pnode->fCanSendData = false;
             }
 
             //
@@ -1792,6 +2130,11 @@ void CConnman::ThreadOpenConnections(const std::vector<std::string> connect)
                 }
             }
         }
+        {
+            std::lock_guard<std::mutex> lock(mutexPendingConnects);
+            setConnected.insert(setPendingConnectGroups.begin(), setPendingConnectGroups.end());
+            nOutbound += setPendingConnectGroups.size();
+        }
 
         // Feeler Connections
         //
@@ -1868,11 +2211,84 @@ void CConnman::ThreadOpenConnections(const std::vector<std::string> connect)
                 LogPrint(BCLog::NET, "Making feeler connection to %s\n", addrConnect.ToString());
             }
 
-            OpenNetworkConnection(addrConnect, (int)setConnected.size() >= std::min(nMaxConnections - 1, 2), &grant, nullptr, false, fFeeler);
+            bool fCountFailure = (int)setConnected.size() >= std::min(nMaxConnections - 1, 2);
+            if (!threadConnect.empty()) {
+                // A connect can block for up to nConnectTimeout, or longer through a proxy, so
+                // leave it to a connect thread and go on with the next address
+                PendingConnection pending{addrConnect, std::unique_ptr<CSemaphoreGrant>(new CSemaphoreGrant()), fCountFailure, fFeeler, nullptr};
+                grant.MoveTo(*pending.grant);
+                {
+                    std::lock_guard<std::mutex> lock(mutexPendingConnects);
+                    setPendingConnectGroups.insert(addrConnect.GetGroup());
+                    vPendingConnects.push_back(std::move(pending));
+                }
+                condPendingConnects.notify_one();
+                continue;
+            }
+
+            OpenNetworkConnection(addrConnect, fCountFailure, &grant, nullptr, false, fFeeler);
         }
     }
 }
 
+void CConnman::ThreadConnect()
+{
+    while (!interruptNet)
+    {
+        std::unique_lock<std::mutex> lock(mutexPendingConnects);
+        if (vPendingConnects.empty()) {
+            condPendingConnects.wait_for(lock, std::chrono::milliseconds(500));
+            continue;
+        }
+        PendingConnection pending(std::move(vPendingConnects.front()));
+        vPendingConnects.pop_front();
+        lock.unlock();
+
+        if (pending.onConnected) {
+            ConnectGhostnode(pending.addr, pending.onConnected);
+            continue;
+        }
+
+        OpenNetworkConnection(pending.addr, pending.fCountFailure, pending.grant.get(), nullptr, false, pending.fFeeler);
+
+        lock.lock();
+        setPendingConnectGroups.erase(pending.addr.GetGroup());
+    }
+}
+
+void CConnman::OpenGhostnodeConnection(const CAddress& addrConnect, std::function<void(CNode*)> onConnected)
+{
+    if (threadConnect.empty()) {
+        ConnectGhostnode(addrConnect, onConnected);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutexPendingConnects);
+        vPendingConnects.push_back(PendingConnection{addrConnect, nullptr, false, false, std::move(onConnected)});
+    }
+    condPendingConnects.notify_one();
+}
+
+void CConnman::ConnectGhostnode(const CAddress& addrConnect, const std::function<void(CNode*)>& onConnected)
+{
+    if (interruptNet || !fNetworkActive) {
+        return;
+    }
+
+    CNode* pnode = ConnectNode(addrConnect, nullptr, false, true);
+    if (!pnode)
+        return;
+    pnode->fGhostnode = true;
+
+    m_msgproc->InitializeNode(pnode);
+    {
+        LOCK(cs_vNodes);
+        vNodes.push_back(pnode);
+        UpdatePeerMetrics();
+    }
+    onConnected(pnode);
+}
+
 std::vector<AddedNodeInfo> CConnman::GetAddedNodeInfo()
 {
     std::vector<AddedNodeInfo> ret;
@@ -1989,6 +2405,7 @@ void CConnman::OpenNetworkConnection(const CAddress& addrConnect, bool fCountFai
     {
         LOCK(cs_vNodes);
         vNodes.push_back(pnode);
+        UpdatePeerMetrics();
     }
 }
 
@@ -2041,6 +2458,51 @@ void CConnman::ThreadMessageHandler()
     }
 }
 
+void CConnman::PushGhostnodeMessage(CNode* pnode, const std::string& strCommand, CDataStream& vRecv)
+{
+    if (vGhostnodeMsgQueues.empty()) {
+        m_msgproc->ProcessGhostnodeMessage(pnode, strCommand, vRecv);
+        return;
+    }
+
+    GhostnodeMessageQueue& queue = *vGhostnodeMsgQueues[pnode->GetId() % vGhostnodeMsgQueues.size()];
+    pnode->AddRef();
+    pnode->nGhostnodeMsgQueued++;
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.messages.push_back(GhostnodeMessage{pnode, strCommand, std::move(vRecv)});
+    }
+    queue.cond.notify_one();
+}
+
+void CConnman::ThreadGhostnodeMessageHandler(GhostnodeMessageQueue& queue)
+{
+    while (!flagInterruptMsgProc)
+    {
+        std::unique_lock<std::mutex> lock(queue.mutex);
+        if (queue.messages.empty()) {
+            queue.cond.wait_until(lock, std::chrono::steady_clock::now() + std::chrono::milliseconds(100));
+            continue;
+        }
+        GhostnodeMessage message(std::move(queue.messages.front()));
+        queue.messages.pop_front();
+        lock.unlock();
+
+        CNode* pnode = message.pnode;
+        if (!pnode->fDisconnect)
+            m_msgproc->ProcessGhostnodeMessage(pnode, message.strCommand, message.vRecv);
+        RecycleRecvBuffer(message.vRecv);
+
+        // The other messages of the peer waited for its queue to drain
+        if (pnode->nGhostnodeMsgQueued-- == MAX_GHOSTNODE_MSG_QUEUE)
+            WakeMessageHandler();
+        {
+            LOCK(cs_vNodes);
+            pnode->Release();
+        }
+    }
+}
+
 
 
 
@@ -2202,6 +2664,11 @@ CConnman::CConnman(uint64_t nSeed0In, uint64_t nSeed1In) : nSeed0(nSeed0In), nSe
     nLastNodeId = 0;
     nSendBufferMaxSize = 0;
     nReceiveFloodSize = 0;
+    socketEventsMode = SOCKETEVENTS_SELECT;
+    hSocketEvents = -1;
+    nGhostnodeMsgThreads = 0;
+    nConnectThreads = 0;
+    nAddrResponseCacheExpiry = 0;
     flagInterruptMsgProc = false;
     SetTryNewOutboundPeer(false);
 
@@ -2269,6 +2736,20 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
         return false;
     }
 
+#ifdef HAVE_EPOLL
+    if (socketEventsMode == SOCKETEVENTS_EPOLL)
+        hSocketEvents = epoll_create1(EPOLL_CLOEXEC);
+#endif
+#ifdef HAVE_KQUEUE
+    if (socketEventsMode == SOCKETEVENTS_KQUEUE)
+        hSocketEvents = kqueue();
+#endif
+    if (socketEventsMode != SOCKETEVENTS_SELECT && hSocketEvents == -1) {
+        LogPrintf("Creating the %s descriptor failed with error %s, using select\n", GetSocketEventsModeName(socketEventsMode), NetworkErrorString(WSAGetLastError()));
+        socketEventsMode = SOCKETEVENTS_SELECT;
+    }
+    LogPrintf("Using %s for the sockets of peers\n", GetSocketEventsModeName(socketEventsMode));
+
     for (const auto& strDest : connOptions.vSeedNodes) {
         AddOneShot(strDest);
     }
@@ -2352,14 +2833,21 @@ bool CConnman::Start(CScheduler& scheduler, const Options& connOptions)
         }
         return false;
     }
-    if (connOptions.m_use_addrman_outgoing || !connOptions.m_specified_outgoing.empty())
+    for (int i = 0; i < nConnectThreads; i++)
+        threadConnect.emplace_back(&TraceThread<std::function<void()> >, "connect", std::function<void()>(std::bind(&CConnman::ThreadConnect, this)));
+    if (connOptions.m_use_addrman_outgoing || !connOptions.m_specified_outgoing.empty()) {
         threadOpenConnections = std::thread(&TraceThread<std::function<void()> >, "opencon", std::function<void()>(std::bind(&CConnman::ThreadOpenConnections, this, connOptions.m_specified_outgoing)));
+    }
 
     // Process messages
     threadMessageHandler = std::thread(&TraceThread<std::function<void()> >, "msghand", std::function<void()>(std::bind(&CConnman::ThreadMessageHandler, this)));
+    for (int i = 0; i < nGhostnodeMsgThreads; i++)
+        vGhostnodeMsgQueues.emplace_back(new GhostnodeMessageQueue());
+    for (int i = 0; i < nGhostnodeMsgThreads; i++)
+        threadGhostnodeMessageHandler.emplace_back(&TraceThread<std::function<void()> >, "mnmsghand", std::function<void()>(std::bind(&CConnman::ThreadGhostnodeMessageHandler, this, std::ref(*vGhostnodeMsgQueues[i]))));
 
     // Dump network addresses
-    scheduler.scheduleEvery(std::bind(&CConnman::DumpData, this), DUMP_ADDRESSES_INTERVAL * 1000);
+    scheduler.scheduleEvery(std::bind(&CConnman::DumpData, this), DUMP_ADDRESSES_INTERVAL * 1000, "net");
 
     return true;
 }
@@ -2386,9 +2874,17 @@ void CConnman::Interrupt()
         flagInterruptMsgProc = true;
     }
     condMsgProc.notify_all();
+    for (const auto& queue : vGhostnodeMsgQueues) {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->cond.notify_all();
+    }
 
     interruptNet();
     InterruptSocks5(true);
+    {
+        std::lock_guard<std::mutex> lock(mutexPendingConnects);
+        condPendingConnects.notify_all();
+    }
 
     if (semOutbound) {
         for (int i=0; i<(nMaxOutbound + nMaxFeeler); i++) {
@@ -2407,8 +2903,25 @@ void CConnman::Stop()
 {
     if (threadMessageHandler.joinable())
         threadMessageHandler.join();
+    for (std::thread& thread : threadGhostnodeMessageHandler)
+        if (thread.joinable())
+            thread.join();
+    threadGhostnodeMessageHandler.clear();
+    for (const auto& queue : vGhostnodeMsgQueues) {
+        for (GhostnodeMessage& message : queue->messages) {
+            message.pnode->nGhostnodeMsgQueued--;
+            message.pnode->Release();
+        }
+    }
+    vGhostnodeMsgQueues.clear();
     if (threadOpenConnections.joinable())
         threadOpenConnections.join();
+    for (std::thread& thread : threadConnect)
+        if (thread.joinable())
+            thread.join();
+    threadConnect.clear();
+    vPendingConnects.clear();
+    setPendingConnectGroups.clear();
     if (threadOpenAddedConnections.joinable())
         threadOpenAddedConnections.join();
     if (threadDNSAddressSeed.joinable())
@@ -2438,8 +2951,15 @@ void CConnman::Stop()
         DeleteNode(pnode);
     }
     vNodes.clear();
+    UpdatePeerMetrics();
     vNodesDisconnected.clear();
     vhListenSocket.clear();
+#if defined(HAVE_EPOLL) || defined(HAVE_KQUEUE)
+    if (hSocketEvents != -1) {
+        close(hSocketEvents);
+        hSocketEvents = -1;
+    }
+#endif
     semOutbound.reset();
     semAddnode.reset();
 }
@@ -2455,6 +2975,17 @@ void CConnman::DeleteNode(CNode* pnode)
     delete pnode;
 }
 
+void CConnman::UpdatePeerMetrics()
+{
+    int nInbound = 0;
+    for (const CNode* pnode : vNodes) {
+        if (pnode->fInbound)
+            nInbound++;
+    }
+    MetricSet(Metric::PEERS_INBOUND, nInbound);
+    MetricSet(Metric::PEERS_OUTBOUND, vNodes.size() - nInbound);
+}
+
 CConnman::~CConnman()
 {
     Interrupt();
@@ -2466,6 +2997,11 @@ size_t CConnman::GetAddressCount() const
     return addrman.size();
 }
 
+size_t CConnman::GetAddressMemoryUsage() const
+{
+    return addrman.DynamicMemoryUsage();
+}
+
 void CConnman::SetServices(const CService &addr, ServiceFlags nServices)
 {
     addrman.SetServices(addr, nServices);
@@ -2486,6 +3022,17 @@ std::vector<CAddress> CConnman::GetAddresses()
     return addrman.GetAddr();
 }
 
+std::vector<CAddress> CConnman::GetAddressesCached()
+{
+    LOCK(cs_vAddrResponseCache);
+    int64_t nNow = GetTime();
+    if (nNow >= nAddrResponseCacheExpiry) {
+        vAddrResponseCache = addrman.GetAddr();
+        nAddrResponseCacheExpiry = nNow + ADDR_RESPONSE_CACHE_INTERVAL;
+    }
+    return vAddrResponseCache;
+}
+
 bool CConnman::AddNode(const std::string& strNode)
 {
     LOCK(cs_vAddedNodes);
@@ -2690,6 +3237,7 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn
     nKeyedNetGroup(nKeyedNetGroupIn),
     addrKnown(5000, 0.001),
     filterInventoryKnown(50000, 0.000001),
+    filterTxAnnounced(10000, 0.000001),
     id(idIn),
     nLocalHostNonce(nLocalHostNonceIn),
     nLocalServices(nLocalServicesIn),
@@ -2714,12 +3262,16 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn
     fFeeler = false;
     fSuccessfullyConnected = false;
     fDisconnect = false;
+    fSocketEventsRegistered = false;
+    fHasRecvData = false;
+    fCanSendData = false;
     nRefCount = 0;
     nSendSize = 0;
     nSendOffset = 0;
     hashContinue = uint256();
     nStartingHeight = -1;
     filterInventoryKnown.reset();
+    filterTxAnnounced.reset();
     fSendMempool = false;
     fGetAddr = false;
     nNextLocalAddrSend = 0;
@@ -2741,13 +3293,21 @@ CNode::CNode(NodeId idIn, ServiceFlags nLocalServicesIn, int nMyStartingHeightIn
     nextSendTimeFeeFilter = 0;
     fPauseRecv = false;
     fPauseSend = false;
+    nGhostnodeMsgQueued = 0;
+    nProcessTime = 0;
+    nServeTime = 0;
+    nSendStallTime = 0;
+    nSendStallStart = 0;
     nProcessQueueSize = 0;
     //Ghostnode
     fGhostnode = false;
 
-    for (const std::string &msg : getAllNetMessageTypes())
+    for (const std::string &msg : getAllNetMessageTypes()) {
         mapRecvBytesPerMsgCmd[msg] = 0;
+        mapProcessTimePerMsgCmd[msg] = 0;
+    }
     mapRecvBytesPerMsgCmd[NET_MESSAGE_COMMAND_OTHER] = 0;
+    mapProcessTimePerMsgCmd[NET_MESSAGE_COMMAND_OTHER] = 0;
 
     if (fLogIPs) {
         LogPrint(BCLog::NET, "Added connection to %s peer=%d\n", addrName, id);
@@ -2761,6 +3321,42 @@ CNode::~CNode()
     CloseSocket(hSocket);
 }
 
+/** Whether a message asks us to serve data, rather than relaying something to us */
+static bool IsServeCommand(const std::string& strCommand)
+{
+    return strCommand == NetMsgType::GETDATA || strCommand == NetMsgType::GETBLOCKS ||
+           strCommand == NetMsgType::GETHEADERS || strCommand == NetMsgType::GETBLOCKTXN ||
+           strCommand == NetMsgType::GETADDR || strCommand == NetMsgType::MEMPOOL ||
+           strCommand == NetMsgType::GETCFILTERS || strCommand == NetMsgType::GETCFHEADERS ||
+           strCommand == NetMsgType::GETCFCHECKPT || strCommand == NetMsgType::GETSPORKS ||
+           strCommand == NetMsgType::DSEG || strCommand == NetMsgType::GHOSTNODEPAYMENTSYNC ||
+           strCommand == NetMsgType::MNVERIFY;
+}
+
+void CNode::AddProcessTime(const std::string& strCommand, int64_t nTime)
+{
+    nProcessTime += nTime;
+    if (IsServeCommand(strCommand))
+        nServeTime += nTime;
+    LOCK(cs_processTime);
+    mapMsgCmdSize::iterator i = mapProcessTimePerMsgCmd.find(strCommand);
+    if (i == mapProcessTimePerMsgCmd.end())
+        i = mapProcessTimePerMsgCmd.find(NET_MESSAGE_COMMAND_OTHER);
+    assert(i != mapProcessTimePerMsgCmd.end());
+    i->second += nTime;
+}
+
+void CNode::SetPauseSend(bool fPause)
+{
+    AssertLockHeld(cs_vSend);
+    if (fPause && !fPauseSend) {
+        nSendStallStart = GetTimeMicros();
+    } else if (!fPause && fPauseSend) {
+        nSendStallTime += GetTimeMicros() - nSendStallStart;
+    }
+    fPauseSend = fPause;
+}
+
 void CNode::AskFor(const CInv& inv)
 {
     if (mapAskFor.size() > MAPASKFOR_MAX_SZ || setAskFor.size() > SETASKFOR_MAX_SZ)
@@ -2824,7 +3420,7 @@ void CConnman::PushMessage(CNode* pnode, CSerializedNetMsg&& msg)
         pnode->nSendSize += nTotalSize;
 
         if (pnode->nSendSize > nSendBufferMaxSize)
-            pnode->fPauseSend = true;
+            pnode->SetPauseSend(true);
         pnode->vSendMsg.push_back(std::move(serializedHeader));
         if (nMessageSize)
             pnode->vSendMsg.push_back(std::move(msg.data));
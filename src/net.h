@@ -18,6 +18,7 @@
 #include <protocol.h>
 #include <random.h>
 #include <streams.h>
+#include <support/allocators/bufferpool.h>
 #include <sync.h>
 #include <uint256.h>
 #include <threadinterrupt.h>
@@ -83,12 +84,37 @@ static const bool DEFAULT_BLOCKSONLY = false;
 static const bool DEFAULT_FORCEDNSSEED = false;
 static const size_t DEFAULT_MAXRECEIVEBUFFER = 5 * 1000;
 static const size_t DEFAULT_MAXSENDBUFFER    = 1 * 1000;
+/** The default number of threads that process the ghostnode-layer messages */
+static const int DEFAULT_GHOSTNODE_MSG_THREADS = 1;
+/** The maximum number of threads that process the ghostnode-layer messages */
+static const int MAX_GHOSTNODE_MSG_THREADS = 8;
+/** The other messages of a peer wait while this many of its ghostnode-layer messages are queued */
+static const int MAX_GHOSTNODE_MSG_QUEUE = 1000;
+/** How long, in seconds, the addresses that answer getaddr are reused for */
+static const int64_t ADDR_RESPONSE_CACHE_INTERVAL = 10 * 60;
+/** The default number of threads that open outbound and ghostnode connections in parallel */
+static const int DEFAULT_CONNECT_THREADS = 4;
 
 // NOTE: When adjusting this, update rpcnet:setban's help ("24h")
 static const unsigned int DEFAULT_MISBEHAVING_BANTIME = 60 * 60 * 24;  // Default 24-hour ban
 
 typedef int64_t NodeId;
 
+/** How the socket handler thread waits for its sockets to become ready */
+enum SocketEventsMode {
+    SOCKETEVENTS_SELECT = 0,
+    SOCKETEVENTS_EPOLL = 1,
+    SOCKETEVENTS_KQUEUE = 2,
+};
+
+/** The most efficient mode available on this platform, the default of -socketevents */
+SocketEventsMode GetDefaultSocketEventsMode();
+/** Parse a -socketevents mode, only the modes available on this platform are accepted */
+bool ParseSocketEventsMode(const std::string& str, SocketEventsMode& mode);
+std::string GetSocketEventsModeName(SocketEventsMode mode);
+/** The modes available on this platform, for the help text */
+std::string GetSupportedSocketEventsModes();
+
 struct AddedNodeInfo
 {
     std::string strAddedNode;
@@ -145,6 +171,9 @@ public:
         bool m_use_addrman_outgoing = true;
         std::vector<std::string> m_specified_outgoing;
         std::vector<std::string> m_added_nodes;
+        SocketEventsMode socketEventsMode = SOCKETEVENTS_SELECT;
+        int nGhostnodeMsgThreads = DEFAULT_GHOSTNODE_MSG_THREADS;
+        int nConnectThreads = DEFAULT_CONNECT_THREADS;
     };
 
     void Init(const Options& connOptions) {
@@ -164,6 +193,9 @@ public:
             nMaxOutboundLimit = connOptions.nMaxOutboundLimit;
         }
         vWhitelistedRange = connOptions.vWhitelistedRange;
+        socketEventsMode = connOptions.socketEventsMode;
+        nGhostnodeMsgThreads = connOptions.nGhostnodeMsgThreads;
+        nConnectThreads = connOptions.nConnectThreads;
         {
             LOCK(cs_vAddedNodes);
             vAddedNodes = connOptions.m_added_nodes;
@@ -228,10 +260,13 @@ public:
 
     // Addrman functions
     size_t GetAddressCount() const;
+    size_t GetAddressMemoryUsage() const;
     void SetServices(const CService &addr, ServiceFlags nServices);
     void MarkAddressGood(const CAddress& addr);
     void AddNewAddresses(const std::vector<CAddress>& vAddr, const CAddress& addrFrom, int64_t nTimePenalty = 0);
     std::vector<CAddress> GetAddresses();
+    //! GetAddresses, reused for ADDR_RESPONSE_CACHE_INTERVAL so answering getaddr doesn't keep addrman busy
+    std::vector<CAddress> GetAddressesCached();
 
     // Denial-of-service detection/prevention
     // The idea is to detect peers that are behaving
@@ -314,10 +349,22 @@ public:
     unsigned int GetReceiveFloodSize() const;
 
     void WakeMessageHandler();
+    /**
+     * Hand a ghostnode-layer message over to the ghostnode message threads, so it doesn't hold up
+     * the block and transaction messages. The messages of one peer always go to the same thread and
+     * are processed in order. Without those threads the message is processed right away.
+     */
+    void PushGhostnodeMessage(CNode* pnode, const std::string& strCommand, CDataStream& vRecv);
     void RelayInv(CInv &inv, const int minProtoVersion = MIN_PEER_PROTO_VERSION);
     std::vector<CNode*> vNodes;
     mutable CCriticalSection cs_vNodes;
     CNode* ConnectNode(CAddress addrConnect, const char *pszDest, bool fCountFailure, bool fConnectToGhostnode = false);
+    /**
+     * Open a ghostnode connection on a connect thread and call onConnected there with the new node,
+     * which is already in vNodes. onConnected is not called when the connection fails. Without
+     * connect threads the connection is opened right away.
+     */
+    void OpenGhostnodeConnection(const CAddress& addrConnect, std::function<void(CNode*)> onConnected);
     CNode* FindNode(const CNetAddr& ip);
     CNode* FindNode(const CSubNet& subNet);
     CNode* FindNode(const std::string& addrName);
@@ -343,6 +390,14 @@ private:
     void ThreadMessageHandler();
     void AcceptConnection(const ListenSocket& hListenSocket);
     void ThreadSocketHandler();
+    /** Wait for the sockets of the socket handler thread, and return the ones to service */
+    void SocketEvents(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
+    void SocketEventsSelect(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
+    void SocketEventsEdgeTriggered(std::set<SOCKET>& recv_set, std::set<SOCKET>& send_set, std::set<SOCKET>& error_set);
+    /** Add a socket to hSocketEvents, peer sockets are edge-triggered and listening sockets level-triggered */
+    bool RegisterSocketEvents(SOCKET hSocket, bool fEdgeTriggered);
+    /** Wait on hSocketEvents for up to nTimeout milliseconds, the ready sockets are returned with SOCKET_EVENT_* flags */
+    bool WaitSocketEvents(int nTimeout, std::vector<std::pair<SOCKET, int>>& vReady);
     void ThreadDNSAddressSeed();
 
     uint64_t CalculateKeyedNetGroup(const CAddress& ad) const;
@@ -351,6 +406,8 @@ private:
     bool IsWhitelistedRange(const CNetAddr &addr);
 
     void DeleteNode(CNode* pnode);
+    /** Publish the peer counts to the metrics.h gauges, requires cs_vNodes */
+    void UpdatePeerMetrics();
 
     NodeId GetNewNodeId();
 
@@ -392,6 +449,9 @@ private:
     unsigned int nReceiveFloodSize;
 
     std::vector<ListenSocket> vhListenSocket;
+    SocketEventsMode socketEventsMode;
+    //! The epoll or kqueue descriptor of the socket handler thread, -1 in select mode
+    int hSocketEvents;
     std::atomic<bool> fNetworkActive;
     banmap_t setBanned;
     CCriticalSection cs_setBanned;
@@ -401,6 +461,9 @@ private:
     CCriticalSection cs_vOneShots;
     std::vector<std::string> vAddedNodes GUARDED_BY(cs_vAddedNodes);
     CCriticalSection cs_vAddedNodes;
+    std::vector<CAddress> vAddrResponseCache GUARDED_BY(cs_vAddrResponseCache);
+    int64_t nAddrResponseCacheExpiry GUARDED_BY(cs_vAddrResponseCache);
+    CCriticalSection cs_vAddrResponseCache;
     std::list<CNode*> vNodesDisconnected;
     std::atomic<NodeId> nLastNodeId;
 
@@ -435,6 +498,44 @@ private:
     std::thread threadOpenConnections;
     std::thread threadMessageHandler;
 
+    /** A ghostnode-layer message waiting for a ghostnode message thread, which holds a reference to pnode */
+    struct GhostnodeMessage {
+        CNode* pnode;
+        std::string strCommand;
+        CDataStream vRecv;
+    };
+    /** The messages of one ghostnode message thread */
+    struct GhostnodeMessageQueue {
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::deque<GhostnodeMessage> messages;
+    };
+    void ThreadGhostnodeMessageHandler(GhostnodeMessageQueue& queue);
+
+    /** An outbound connection that waits for a connect thread */
+    struct PendingConnection {
+        CAddress addr;
+        std::unique_ptr<CSemaphoreGrant> grant;
+        bool fCountFailure;
+        bool fFeeler;
+        //! Set for ghostnode connections, which take no outbound slot, called with the new node
+        std::function<void(CNode*)> onConnected;
+    };
+    void ThreadConnect();
+    void ConnectGhostnode(const CAddress& addrConnect, const std::function<void(CNode*)>& onConnected);
+
+    int nConnectThreads;
+    std::mutex mutexPendingConnects;
+    std::condition_variable condPendingConnects;
+    std::deque<PendingConnection> vPendingConnects;
+    //! Network groups of the outbound connections that are queued or being opened by the connect threads
+    std::set<std::vector<unsigned char>> setPendingConnectGroups;
+    std::vector<std::thread> threadConnect;
+
+    int nGhostnodeMsgThreads;
+    std::vector<std::unique_ptr<GhostnodeMessageQueue>> vGhostnodeMsgQueues;
+    std::vector<std::thread> threadGhostnodeMessageHandler;
+
     /** flag for deciding to connect to an extra outbound peer,
      *  in excess of nMaxOutbound
      *  This takes the place of a feeler connection */
@@ -471,6 +572,7 @@ class NetEventsInterface
 public:
     virtual bool ProcessMessages(CNode* pnode, std::atomic<bool>& interrupt) = 0;
     virtual bool SendMessages(CNode* pnode, std::atomic<bool>& interrupt) = 0;
+    virtual void ProcessGhostnodeMessage(CNode* pnode, const std::string& strCommand, CDataStream& vRecv) = 0;
     virtual void InitializeNode(CNode* pnode) = 0;
     virtual void FinalizeNode(NodeId id, bool& update_connection_time) = 0;
 };
@@ -540,6 +642,9 @@ public:
     mapMsgCmdSize mapSendBytesPerMsgCmd;
     uint64_t nRecvBytes;
     mapMsgCmdSize mapRecvBytesPerMsgCmd;
+    int64_t nProcessTime;
+    mapMsgCmdSize mapProcessTimePerMsgCmd;
+    int64_t nSendStallTime;
     bool fWhitelisted;
     double dPingTime;
     double dPingWait;
@@ -555,6 +660,11 @@ public:
 
 
 
+/** Buffers of the messages received from peers */
+extern BufferPool<CSerializeData> g_net_recv_buffers;
+/** Buffers of the messages sent to peers */
+extern BufferPool<std::vector<unsigned char>> g_net_send_buffers;
+
 class CNetMessage {
 private:
     mutable CHash256 hasher;
@@ -578,6 +688,9 @@ public:
         nDataPos = 0;
         nTime = 0;
     }
+    CNetMessage(CNetMessage&&) = default;
+    CNetMessage& operator=(CNetMessage&&) = default;
+    ~CNetMessage();
 
     bool complete() const
     {
@@ -684,10 +797,28 @@ public:
     const uint64_t nKeyedNetGroup;
     std::atomic_bool fPauseRecv;
     std::atomic_bool fPauseSend;
+    // The ghostnode-layer messages of this peer that wait for a ghostnode message thread
+    std::atomic<int> nGhostnodeMsgQueued;
+    // Only used by the socket handler thread in an edge-triggered -socketevents mode: whether the socket
+    // was registered, and the readiness that was reported for it and not used up yet
+    bool fSocketEventsRegistered;
+    bool fHasRecvData;
+    bool fCanSendData;
+    // Microseconds spent processing the messages of this peer, which includes the validation they
+    // trigger and the data served in reply
+    std::atomic<int64_t> nProcessTime;
+    // The part of nProcessTime spent on requests for data, which eviction weighs. Relayed blocks and
+    // transactions are left out, validating them is work any peer that relays them causes.
+    std::atomic<int64_t> nServeTime;
+    // Microseconds the send buffer of this peer was full, since when the current stall began
+    int64_t nSendStallTime;
+    int64_t nSendStallStart;
 protected:
 
     mapMsgCmdSize mapSendBytesPerMsgCmd;
     mapMsgCmdSize mapRecvBytesPerMsgCmd;
+    mapMsgCmdSize mapProcessTimePerMsgCmd;
+    CCriticalSection cs_processTime;
 
 public:
     uint256 hashContinue;
@@ -703,6 +834,8 @@ public:
 
     // inventory based relay
     CRollingBloomFilter filterInventoryKnown;
+    // Transactions we announced to this peer, the ancestors we may send along with a child it asks for
+    CRollingBloomFilter filterTxAnnounced;
     std::vector<CInv> vInventoryToSend;
     // Set of transaction ids we still have to announce.
     // They are sorted by the mempool before relay, so the order is not important.
@@ -857,7 +990,8 @@ public:
             }
         } else if (inv.type == MSG_BLOCK) {
             vInventoryBlockToSend.push_back(inv.hash);
-        } else {
+        } else if (!filterInventoryKnown.contains(inv.hash)) {
+            // Ghostnode inventory the peer sent us or was already announced to it is not queued again
             vInventoryToSend.push_back(inv);
         }
     }
@@ -874,6 +1008,11 @@ public:
 
     void copyStats(CNodeStats &stats);
 
+    //! Account the microseconds spent processing a message of this peer
+    void AddProcessTime(const std::string& strCommand, int64_t nTime);
+    //! Pause or resume sending to this peer, cs_vSend must be held
+    void SetPauseSend(bool fPause);
+
     ServiceFlags GetLocalServices() const
     {
         return nLocalServices;
@@ -11,6 +11,7 @@
 #include <chainparams.h>
 #include <consensus/validation.h>
 #include <hash.h>
+#include <index/blockfilterindex.h>
 #include <init.h>
 #include <validation.h>
 #include <merkleblock.h>
@@ -33,13 +34,20 @@
 #include "ghostnode/activeghostnode.h"
 #include "ghostnode/darksend.h"
 #include "ghostnode/ghostnode-payments.h"
+#include "ghostnode/ghostnode-stats.h"
 #include "ghostnode/ghostnode-sync.h"
 #include "ghostnode/ghostnodeman.h"
 #include "ghostnode/ghostnodeconfig.h"
 #include "ghostnode/netfulfilledman.h"
+#include "ghostnode/seeninventory.h"
 #include "ghostnode/instantx.h"
 #include "ghostnode/spork.h"
 #include "ghostnode/flat-database.h"
+#include "zerocoin/zerocoin.h"
+
+#include <condition_variable>
+#include <deque>
+#include <thread>
 
 #if defined(NDEBUG)
 # error "NIX cannot be compiled without assertions."
@@ -69,6 +77,9 @@ void EraseOrphansFor(NodeId peer);
 
 static size_t vExtraTxnForCompactIt GUARDED_BY(g_cs_orphans) = 0;
 static std::vector<std::pair<uint256, CTransactionRef>> vExtraTxnForCompact GUARDED_BY(g_cs_orphans);
+/** Recently relayed, rejected or replaced zerocoin spends, kept apart so their size doesn't push the other transactions out */
+static size_t vExtraSpendsForCompactIt GUARDED_BY(g_cs_orphans) = 0;
+static std::vector<std::pair<uint256, CTransactionRef>> vExtraSpendsForCompact GUARDED_BY(g_cs_orphans);
 
 static const uint64_t RANDOMIZER_ID_ADDRESS_RELAY = 0x3cac0035b5866b90ULL; // SHA256("main address relay")[0:8]
 
@@ -135,6 +146,9 @@ namespace {
     /** Number of peers from which we're downloading blocks. */
     int nPeersWithValidatedDownloads = 0;
 
+    /** How long a peer may stall block download before it is disconnected (in microseconds), protected by cs_main. */
+    int64_t nBlockStallingTimeout = BLOCK_STALLING_TIMEOUT * 1000000;
+
     /** Number of outbound peers with m_chain_sync.m_protect. */
     int g_outbound_peers_with_protect_from_disconnect = 0;
 
@@ -196,6 +210,10 @@ struct CNodeState {
     int64_t nDownloadingSince;
     int nBlocksInFlight;
     int nBlocksInFlightValidHeaders;
+    //! Average time this peer took per block it was asked for (in microseconds), or 0 before the first one.
+    int64_t nBlockDownloadTime;
+    //! How many blocks may be in flight from this peer, sized from nBlockDownloadTime.
+    int nBlocksInFlightLimit;
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload;
     //! Whether this peer wants invs or headers (when possible) for block announcements.
@@ -263,6 +281,8 @@ struct CNodeState {
         nDownloadingSince = 0;
         nBlocksInFlight = 0;
         nBlocksInFlightValidHeaders = 0;
+        nBlockDownloadTime = 0;
+        nBlocksInFlightLimit = MAX_BLOCKS_IN_TRANSIT_PER_PEER;
         fPreferredDownload = false;
         fPreferHeaders = false;
         fPreferHeaderAndIDs = false;
@@ -343,6 +363,29 @@ bool MarkBlockAsReceived(const uint256& hash) {
     return false;
 }
 
+// Requires cs_main.
+// Called when a peer delivers a block, before MarkBlockAsReceived. If we were waiting for it on this peer
+// first, the time since the previous block or the request goes into how many blocks the peer may have in flight.
+void MarkBlockAsDelivered(NodeId nodeid, const uint256& hash) {
+    std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hash);
+    if (itInFlight == mapBlocksInFlight.end() || itInFlight->second.first != nodeid)
+        return;
+    CNodeState *state = State(nodeid);
+    assert(state != nullptr);
+    if (state->vBlocksInFlight.begin() != itInFlight->second.second)
+        return;
+
+    int64_t nTime = std::max<int64_t>(1, GetTimeMicros() - state->nDownloadingSince);
+    state->nBlockDownloadTime = state->nBlockDownloadTime ? (7 * state->nBlockDownloadTime + nTime) / 8 : nTime;
+    state->nBlocksInFlightLimit = std::max<int64_t>(MIN_BLOCKS_IN_TRANSIT_PER_PEER,
+        std::min<int64_t>(MAX_BLOCKS_IN_TRANSIT_PER_PEER_ADAPTIVE, BLOCK_DOWNLOAD_TARGET_TIME * 1000000 / state->nBlockDownloadTime));
+
+    // Blocks arrive again, so let the stalling timeout return towards its default
+    if (nBlockStallingTimeout > BLOCK_STALLING_TIMEOUT * 1000000) {
+        nBlockStallingTimeout = std::max<int64_t>(BLOCK_STALLING_TIMEOUT * 1000000, nBlockStallingTimeout * 85 / 100);
+    }
+}
+
 // Requires cs_main.
 // returns false, still setting pit, if the block was already in flight from the same peer
 // pit will only be valid as long as the same cs_main lock is being held
@@ -558,6 +601,123 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<con
     }
 }
 
+/**
+ * Zerocoin spends relayed by peers that passed PreCheckZerocoinSpendForMemoryPool, waiting for their proofs to be
+ * verified on the zerocoin admission threads. Those serve the peers in turn and each peer can only have a few spends
+ * waiting, so that a burst of spends holds up neither the message handler nor the spends of other peers.
+ */
+class CZerocoinSpendAdmission
+{
+public:
+    struct Job {
+        NodeId nodeid;
+        CTransactionRef tx;
+        std::vector<CZerocoinSpendCheck> vChecks;
+    };
+
+private:
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::map<NodeId, std::deque<Job>> mapWaiting;
+    //! Spends waiting or being verified
+    std::set<uint256> setPending;
+    NodeId nLastServed;
+    bool fInterrupted;
+    std::vector<std::thread> vThreads;
+
+    /** Take the next spend to verify, from the peer after the one served last. False once interrupted */
+    bool Pop(Job& job)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [this] { return fInterrupted || !mapWaiting.empty(); });
+        if (fInterrupted)
+            return false;
+        auto it = mapWaiting.upper_bound(nLastServed);
+        if (it == mapWaiting.end())
+            it = mapWaiting.begin();
+        job = std::move(it->second.front());
+        it->second.pop_front();
+        nLastServed = it->first;
+        if (it->second.empty())
+            mapWaiting.erase(it);
+        return true;
+    }
+
+    void Done(const uint256& hash)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        setPending.erase(hash);
+    }
+
+    void Thread(CConnman* connman);
+
+public:
+    CZerocoinSpendAdmission() : nLastServed(-1), fInterrupted(false) {}
+
+    void Start(int nThreads, CConnman* connman)
+    {
+        fInterrupted = false;
+        for (int i = 0; i < nThreads; i++)
+            vThreads.emplace_back(&TraceThread<std::function<void()> >, "zcadmit", std::function<void()>(std::bind(&CZerocoinSpendAdmission::Thread, this, connman)));
+    }
+
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            fInterrupted = true;
+            mapWaiting.clear();
+        }
+        cond.notify_all();
+        for (std::thread& thread : vThreads)
+            thread.join();
+        vThreads.clear();
+        std::lock_guard<std::mutex> lock(mutex);
+        setPending.clear();
+    }
+
+    bool IsRunning() const { return !vThreads.empty(); }
+
+    /** Queue a spend from a peer for verification, false if the peer or the queue have too many waiting */
+    bool Push(NodeId nodeid, const CTransactionRef& tx, std::vector<CZerocoinSpendCheck>& vChecks)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::deque<Job>& waiting = mapWaiting[nodeid];
+            if (waiting.size() >= MAX_PENDING_ZEROCOIN_SPENDS_PER_PEER || setPending.size() >= MAX_PENDING_ZEROCOIN_SPENDS) {
+                if (waiting.empty())
+                    mapWaiting.erase(nodeid);
+                return false;
+            }
+            if (!setPending.insert(tx->GetHash()).second)
+                return true;
+            waiting.push_back(Job{nodeid, tx, std::move(vChecks)});
+        }
+        cond.notify_one();
+        return true;
+    }
+
+    bool IsPending(const uint256& hash)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return setPending.count(hash);
+    }
+
+    /** Drop the spends of a disconnected peer still waiting */
+    void RemovePeer(NodeId nodeid)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = mapWaiting.find(nodeid);
+        if (it == mapWaiting.end())
+            return;
+        for (const Job& job : it->second)
+            setPending.erase(job.tx->GetHash());
+        mapWaiting.erase(it);
+    }
+};
+
+CZerocoinSpendAdmission zerocoinSpendAdmission;
+
 } // namespace
 
 // This function is used for testing the stale tip eviction logic, see
@@ -605,6 +765,7 @@ void PeerLogicValidation::FinalizeNode(NodeId nodeid, bool& fUpdateConnectionTim
         mapBlocksInFlight.erase(entry.hash);
     }
     EraseOrphansFor(nodeid);
+    zerocoinSpendAdmission.RemovePeer(nodeid);
     nPreferredDownload -= state->fPreferredDownload;
     nPeersWithValidatedDownloads -= (state->nBlocksInFlightValidHeaders != 0);
     assert(nPeersWithValidatedDownloads >= 0);
@@ -635,6 +796,7 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats) {
         if (queue.pindex)
             stats.vHeightInFlight.push_back(queue.pindex->nHeight);
     }
+    stats.nBlocksInFlightLimit = state->nBlocksInFlightLimit;
     return true;
 }
 
@@ -645,6 +807,17 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats) {
 
 void AddToCompactExtraTransactions(const CTransactionRef& tx) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans)
 {
+    if (tx->IsZerocoinSpend()) {
+        size_t max_extra_spends = gArgs.GetArg("-blockreconstructionextraspends", DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_SPENDS);
+        if (max_extra_spends <= 0)
+            return;
+        if (!vExtraSpendsForCompact.size())
+            vExtraSpendsForCompact.resize(max_extra_spends);
+        vExtraSpendsForCompact[vExtraSpendsForCompactIt] = std::make_pair(tx->GetWitnessHash(), tx);
+        vExtraSpendsForCompactIt = (vExtraSpendsForCompactIt + 1) % max_extra_spends;
+        return;
+    }
+
     size_t max_extra_txn = gArgs.GetArg("-blockreconstructionextratxn", DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN);
     if (max_extra_txn <= 0)
         return;
@@ -815,7 +988,70 @@ PeerLogicValidation::PeerLogicValidation(CConnman* connmanIn, CScheduler &schedu
     // combine them in one function and schedule at the quicker (peer-eviction)
     // timer.
     static_assert(EXTRA_PEER_CHECK_INTERVAL < STALE_CHECK_INTERVAL, "peer eviction timer should be less than stale tip check timer");
-    scheduler.scheduleEvery(std::bind(&PeerLogicValidation::CheckForStaleTipAndEvictPeers, this, consensusParams), EXTRA_PEER_CHECK_INTERVAL * 1000);
+    scheduler.scheduleEvery(std::bind(&PeerLogicValidation::CheckForStaleTipAndEvictPeers, this, consensusParams), EXTRA_PEER_CHECK_INTERVAL * 1000, "net");
+
+    int nZerocoinAdmissionThreads = std::min((int)gArgs.GetArg("-zcadmissionthreads", DEFAULT_ZEROCOIN_ADMISSION_THREADS), MAX_ZEROCOIN_ADMISSION_THREADS);
+    if (nZerocoinAdmissionThreads > 0)
+        zerocoinSpendAdmission.Start(nZerocoinAdmissionThreads, connman);
+}
+
+PeerLogicValidation::~PeerLogicValidation() {
+    zerocoinSpendAdmission.Stop();
+}
+
+/**
+ * Second stage of admitting a zerocoin spend from a peer: verify its proofs, then add it to the memory pool, which
+ * finds them in the spend cache, and relay it. Whatever AcceptToMemoryPool rejects is handled as it is for the
+ * transactions processed on the message handler thread.
+ */
+void CZerocoinSpendAdmission::Thread(CConnman* connman)
+{
+    Job job;
+    while (Pop(job)) {
+        const uint256 hash = job.tx->GetHash();
+        CValidationState state;
+        bool fValid = true;
+        for (CZerocoinSpendCheck& check : job.vChecks) {
+            if (!check()) {
+                fValid = state.DoS(0, false, REJECT_INVALID, "bad-zerocoin-spend-proof");
+                break;
+            }
+        }
+
+        {
+            LOCK2(cs_main, g_cs_orphans);
+            std::list<CTransactionRef> lRemovedTxn;
+            if (fValid && AcceptToMemoryPool(mempool, state, job.tx, nullptr, &lRemovedTxn, false /* bypass_limits */, 0 /* nAbsurdFee */)) {
+                RelayTransaction(*job.tx, connman);
+                LogPrint(BCLog::MEMPOOL, "AcceptToMemoryPool: peer=%d: accepted zerocoin spend %s (poolsz %u txn, %u kB)\n",
+                    job.nodeid, hash.ToString(), mempool.size(), mempool.DynamicMemoryUsage() / 1000);
+            } else if (!state.CorruptionPossible()) {
+                assert(recentRejects);
+                recentRejects->insert(hash);
+            }
+            // Keep it for compact blocks even if it leaves the mempool before it is mined, or is rejected
+            AddToCompactExtraTransactions(job.tx);
+            for (const CTransactionRef& removedTx : lRemovedTxn)
+                AddToCompactExtraTransactions(removedTx);
+
+            int nDoS = 0;
+            if (state.IsInvalid(nDoS)) {
+                LogPrint(BCLog::MEMPOOLREJ, "%s from peer=%d was not accepted: %s\n", hash.ToString(), job.nodeid, FormatStateMessage(state));
+                if (state.GetRejectCode() > 0 && state.GetRejectCode() < REJECT_INTERNAL) {
+                    connman->ForNode(job.nodeid, [&](CNode* pnode) {
+                        connman->PushMessage(pnode, CNetMsgMaker(pnode->GetSendVersion()).Make(NetMsgType::REJECT, std::string(NetMsgType::TX),
+                                             (unsigned char)state.GetRejectCode(), state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), hash));
+                        return true;
+                    });
+                }
+                if (nDoS > 0)
+                    Misbehaving(job.nodeid, nDoS);
+            }
+        }
+
+        Done(hash);
+        job = Job();
+    }
 }
 
 void PeerLogicValidation::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex, const std::vector<CTransactionRef>& vtxConflicted) {
@@ -993,6 +1229,7 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 
             return recentRejects->contains(inv.hash) ||
                    mempool.exists(inv.hash) ||
+                   zerocoinSpendAdmission.IsPending(inv.hash) ||
                    pcoinsTip->HaveCoinInCache(COutPoint(inv.hash, 0)) || // Best effort: only try output 0 and 1
                    pcoinsTip->HaveCoinInCache(COutPoint(inv.hash, 1));
         }
@@ -1001,6 +1238,8 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
         return mapBlockIndex.count(inv.hash);
 
     // Ghostnode Related Inventory Messages
+    // Announcements of messages we have seen are answered without the lock of their manager,
+    // the first announcement of a new one is checked against the manager
     case MSG_TXLOCK_REQUEST:
         return instantsend.AlreadyHave(inv.hash);
 
@@ -1008,10 +1247,10 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
         return instantsend.AlreadyHave(inv.hash);
 
     case MSG_SPORK:
-        return mapSporks.count(inv.hash);
+        return ghostnodeSeenInventory.Contains(inv.type, inv.hash) || sporkManager.HaveSpork(inv.hash);
 
     case MSG_GHOSTNODE_PAYMENT_VOTE:
-        return mnpayments.mapGhostnodePaymentVotes.count(inv.hash);
+        return ghostnodeSeenInventory.Contains(inv.type, inv.hash) || mnpayments.mapGhostnodePaymentVotes.count(inv.hash);
 
     case MSG_GHOSTNODE_PAYMENT_BLOCK:
     {
@@ -1023,13 +1262,13 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
         return mnodeman.mapSeenGhostnodeBroadcast.count(inv.hash) && !mnodeman.IsMnbRecoveryRequested(inv.hash);
 
     case MSG_GHOSTNODE_PING:
-        return mnodeman.mapSeenGhostnodePing.count(inv.hash);
+        return ghostnodeSeenInventory.Contains(inv.type, inv.hash) || mnodeman.mapSeenGhostnodePing.count(inv.hash);
 
     case MSG_DSTX:
         return mapDarksendBroadcastTxes.count(inv.hash);
 
     case MSG_GHOSTNODE_VERIFY:
-        return mnodeman.mapSeenGhostnodeVerification.count(inv.hash);
+        return ghostnodeSeenInventory.Contains(inv.type, inv.hash) || mnodeman.mapSeenGhostnodeVerification.count(inv.hash);
     }
     // Don't know what it is, just say we already got one
     return true;
@@ -1071,6 +1310,17 @@ static void RelayAddress(const CAddress& addr, bool fReachable, CConnman* connma
     connman->ForEachNodeThen(std::move(sortfunc), std::move(pushfunc));
 }
 
+/** A TX message, of the serialization a big transaction keeps when the peer gets the witness data too */
+static CSerializedNetMsg MakeTxMessage(const CNetMsgMaker& msgMaker, int nSendFlags, const CTransaction& tx)
+{
+    std::shared_ptr<const std::vector<unsigned char>> serialized;
+    if (!(nSendFlags & SERIALIZE_TRANSACTION_NO_WITNESS) || !tx.HasWitness())
+        serialized = tx.GetSerialized();
+    if (serialized)
+        return msgMaker.MakeSerialized(NetMsgType::TX, *serialized);
+    return msgMaker.Make(nSendFlags, NetMsgType::TX, tx);
+}
+
 void static ProcessGetBlockData(CNode* pfrom, const Consensus::Params& consensusParams, const CInv& inv, CConnman* connman, const std::atomic<bool>& interruptMsgProc)
 {
     bool send = false;
@@ -1142,6 +1392,13 @@ void static ProcessGetBlockData(CNode* pfrom, const Consensus::Params& consensus
         std::shared_ptr<const CBlock> pblock;
         if (a_recent_block && a_recent_block->GetHash() == (*mi).second->GetBlockHash()) {
             pblock = a_recent_block;
+        } else if (inv.type == MSG_WITNESS_BLOCK) {
+            // Blocks are stored with witness data, so they can be sent as they are on disk
+            CSerializedNetMsg msg;
+            msg.command = NetMsgType::BLOCK;
+            if (!ReadRawBlockFromDisk(msg.data, (*mi).second, Params().MessageStart()))
+                assert(!"cannot load block from disk");
+            connman->PushMessage(pfrom, std::move(msg));
         } else {
             // Send block from disk
             std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
@@ -1149,7 +1406,9 @@ void static ProcessGetBlockData(CNode* pfrom, const Consensus::Params& consensus
                 assert(!"cannot load block from disk");
             pblock = pblockRead;
         }
-        if (inv.type == MSG_BLOCK)
+        if (!pblock) {
+            // already sent straight from disk
+        } else if (inv.type == MSG_BLOCK)
             connman->PushMessage(pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::BLOCK, *pblock));
         else if (inv.type == MSG_WITNESS_BLOCK)
             connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, *pblock));
@@ -1174,7 +1433,7 @@ void static ProcessGetBlockData(CNode* pfrom, const Consensus::Params& consensus
                 // however we MUST always provide at least what the remote peer needs
                 typedef std::pair<unsigned int, uint256> PairType;
                 for (PairType& pair : merkleBlock.vMatchedTxn)
-                    connman->PushMessage(pfrom, msgMaker.Make(SERIALIZE_TRANSACTION_NO_WITNESS, NetMsgType::TX, *pblock->vtx[pair.first]));
+                    connman->PushMessage(pfrom, MakeTxMessage(msgMaker, SERIALIZE_TRANSACTION_NO_WITNESS, *pblock->vtx[pair.first]));
             }
             // else
                 // no response
@@ -1213,6 +1472,51 @@ void static ProcessGetBlockData(CNode* pfrom, const Consensus::Params& consensus
     }
 }
 
+/**
+ * Send tx in a "pkgtxs" message, after those of its in-mempool ancestors that were announced to the peer and are still
+ * in mapRelay, so that it doesn't reach the peer as an orphan while it waits for them. Ancestors that were never
+ * announced to the peer are left to the inv path. Returns false, and sends nothing, when there is no such ancestor or
+ * the peer doesn't understand "pkgtxs"
+ */
+bool static PushTxPackage(CNode* pfrom, const CTransactionRef& tx, int nSendFlags, CConnman* connman) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
+{
+    if (pfrom->nVersion < PACKAGE_RELAY_VERSION || tx->IsZerocoinSpend())
+        return false;
+
+    std::vector<std::pair<uint64_t, CTransactionRef> > vAncestors;
+    {
+        LOCK(mempool.cs);
+        CTxMemPool::txiter it = mempool.mapTx.find(tx->GetHash());
+        if (it == mempool.mapTx.end() || it->GetCountWithAncestors() <= 1 || it->GetCountWithAncestors() > MAX_PACKAGE_COUNT)
+            return false;
+        CTxMemPool::setEntries setAncestors;
+        const uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+        std::string dummy;
+        mempool.CalculateMemPoolAncestors(*it, setAncestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
+        LOCK(pfrom->cs_inventory);
+        for (CTxMemPool::txiter ancestor : setAncestors) {
+            auto mi = mapRelay.find(ancestor->GetTx().GetHash());
+            if (mi != mapRelay.end() && pfrom->filterTxAnnounced.contains(mi->first))
+                vAncestors.emplace_back(ancestor->GetCountWithAncestors(), mi->second);
+        }
+    }
+    if (vAncestors.empty())
+        return false;
+
+    // A transaction has more ancestors than any of its parents: parents before children
+    std::sort(vAncestors.begin(), vAncestors.end(), [](const std::pair<uint64_t, CTransactionRef>& a, const std::pair<uint64_t, CTransactionRef>& b) {
+        return a.first < b.first;
+    });
+    std::vector<CTransactionRef> vPackage;
+    for (const std::pair<uint64_t, CTransactionRef>& ancestor : vAncestors) {
+        pfrom->AddInventoryKnown(CInv(MSG_TX, ancestor.second->GetHash()));
+        vPackage.push_back(ancestor.second);
+    }
+    vPackage.push_back(tx);
+    connman->PushMessage(pfrom, CNetMsgMaker(pfrom->GetSendVersion()).Make(nSendFlags, NetMsgType::PKGTXS, vPackage));
+    return true;
+}
+
 void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParams, CConnman* connman, const std::atomic<bool>& interruptMsgProc)
 {
     AssertLockNotHeld(cs_main);
@@ -1238,14 +1542,15 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                 auto mi = mapRelay.find(inv.hash);
                 int nSendFlags = (inv.type == MSG_TX ? SERIALIZE_TRANSACTION_NO_WITNESS : 0);
                 if (mi != mapRelay.end()) {
-                    connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::TX, *mi->second));
+                    if (!PushTxPackage(pfrom, mi->second, nSendFlags, connman))
+                        connman->PushMessage(pfrom, MakeTxMessage(msgMaker, nSendFlags, *mi->second));
                     push = true;
                 } else if (pfrom->timeLastMempoolReq) {
                     auto txinfo = mempool.info(inv.hash);
                     // To protect privacy, do not answer getdata using the mempool when
                     // that TX couldn't have been INVed in reply to a MEMPOOL request.
                     if (txinfo.tx && txinfo.nTime <= pfrom->timeLastMempoolReq) {
-                        connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::TX, *txinfo.tx));
+                        connman->PushMessage(pfrom, MakeTxMessage(msgMaker, nSendFlags, *txinfo.tx));
                         push = true;
                     }
                 }
@@ -1297,10 +1602,11 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                 }
 
                 if (!pushed && inv.type == MSG_SPORK) {
-                    if(mapSporks.count(inv.hash)) {
+                    CSporkMessage spork;
+                    if(sporkManager.GetSporkByHash(inv.hash, spork)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << mapSporks[inv.hash];
+                        ss << spork;
                         const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
                         connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::SPORK, ss));
                         pushed = true;
@@ -1322,27 +1628,27 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                     BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
                     LOCK(cs_mapGhostnodeBlocks);
                     if (mi != mapBlockIndex.end() && mnpayments.mapGhostnodeBlocks.count(mi->second->nHeight)) {
+                        std::vector<CGhostnodePaymentVote> vecVotes;
                         BOOST_FOREACH(CGhostnodePayee& payee, mnpayments.mapGhostnodeBlocks[mi->second->nHeight].vecPayees) {
                             std::vector<uint256> vecVoteHashes = payee.GetVoteHashes();
                             BOOST_FOREACH(uint256& hash, vecVoteHashes) {
-                                if(mnpayments.HasVerifiedPaymentVote(hash)) {
-                                    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                                    ss.reserve(1000);
-                                    ss << mnpayments.mapGhostnodePaymentVotes[hash];
-                                    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
-                                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::GHOSTNODEPAYMENTVOTE, ss));
+                                CGhostnodePaymentVote vote;
+                                if(mnpayments.GetVerifiedPaymentVote(hash, vote)) {
+                                    vecVotes.push_back(vote);
                                 }
                             }
                         }
+                        mnpayments.PushPaymentVotes(pfrom, vecVotes);
                         pushed = true;
                     }
                 }
 
                 if (!pushed && inv.type == MSG_GHOSTNODE_ANNOUNCE) {
-                    if(mnodeman.mapSeenGhostnodeBroadcast.count(inv.hash)){
+                    CGhostnodeBroadcastRef mnb;
+                    if(mnodeman.GetSeenGhostnodeBroadcast(inv.hash, mnb)){
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << mnodeman.mapSeenGhostnodeBroadcast[inv.hash].second;
+                        ss << *mnb;
                         const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
                         connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::MNANNOUNCE, ss));
                         pushed = true;
@@ -1438,6 +1744,152 @@ inline void static SendBlockTransactions(const CBlock& block, const BlockTransac
     connman->PushMessage(pfrom, msgMaker.Make(nSendFlags, NetMsgType::BLOCKTXN, resp));
 }
 
+/** Maximum number of compact filters that may be requested with one getcfilters. See BIP 157. */
+static constexpr uint32_t MAX_GETCFILTERS_SIZE = 1000;
+/** Maximum number of cf hashes that may be requested with one getcfheaders. See BIP 157. */
+static constexpr uint32_t MAX_GETCFHEADERS_SIZE = 2000;
+/** Interval between compact filter checkpoints. See BIP 157. */
+static constexpr int CFCHECKPT_INTERVAL = 1000;
+
+/**
+ * Validate a getcfilters, getcfheaders or getcfcheckpt request: the filter type must be the one we
+ * index and advertise, and the stop block must be in the active chain, at most max_height_diff
+ * blocks above start_height. Peers asking for a service we do not offer or for an invalid range
+ * are disconnected.
+ */
+static bool PrepareBlockFilterRequest(CNode* pfrom, uint8_t filter_type, uint32_t start_height, const uint256& stop_hash,
+                                      uint32_t max_height_diff, const CBlockIndex*& stop_index)
+{
+    if (!(pfrom->GetLocalServices() & NODE_COMPACT_FILTERS) || !g_blockfilterindex ||
+        filter_type != static_cast<uint8_t>(g_blockfilterindex->GetFilterType())) {
+        LogPrint(BCLog::NET, "peer %d requested unsupported block filter type: %d\n", pfrom->GetId(), filter_type);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator it = mapBlockIndex.find(stop_hash);
+        stop_index = it == mapBlockIndex.end() ? nullptr : it->second;
+
+        if (!stop_index || !chainActive.Contains(stop_index)) {
+            LogPrint(BCLog::NET, "peer %d requested filters for a block not in the active chain: %s\n",
+                     pfrom->GetId(), stop_hash.ToString());
+            pfrom->fDisconnect = true;
+            return false;
+        }
+    }
+
+    uint32_t stop_height = stop_index->nHeight;
+    if (start_height > stop_height) {
+        LogPrint(BCLog::NET, "peer %d sent invalid getcfilters/getcfheaders with start height %d and stop height %d\n",
+                 pfrom->GetId(), start_height, stop_height);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    if (stop_height - start_height >= max_height_diff) {
+        LogPrint(BCLog::NET, "peer %d requested too many cfilters/cfheaders: %d / %d\n",
+                 pfrom->GetId(), stop_height - start_height + 1, max_height_diff);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    return true;
+}
+
+static void ProcessGetCFilters(CNode* pfrom, CDataStream& vRecv, CConnman* connman)
+{
+    uint8_t filter_type_ser;
+    uint32_t start_height;
+    uint256 stop_hash;
+
+    vRecv >> filter_type_ser >> start_height >> stop_hash;
+
+    const CBlockIndex* stop_index;
+    if (!PrepareBlockFilterRequest(pfrom, filter_type_ser, start_height, stop_hash, MAX_GETCFILTERS_SIZE, stop_index)) {
+        return;
+    }
+
+    std::vector<BlockFilter> filters;
+    if (!g_blockfilterindex->LookupFilterRange(start_height, stop_index, filters)) {
+        LogPrint(BCLog::NET, "Failed to find block filter in index: filter_type=%s, start_height=%d, stop_hash=%s\n",
+                 BlockFilterTypeName(g_blockfilterindex->GetFilterType()), start_height, stop_hash.ToString());
+        return;
+    }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    for (const BlockFilter& filter : filters) {
+        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFILTER, filter));
+    }
+}
+
+static void ProcessGetCFHeaders(CNode* pfrom, CDataStream& vRecv, CConnman* connman)
+{
+    uint8_t filter_type_ser;
+    uint32_t start_height;
+    uint256 stop_hash;
+
+    vRecv >> filter_type_ser >> start_height >> stop_hash;
+
+    const CBlockIndex* stop_index;
+    if (!PrepareBlockFilterRequest(pfrom, filter_type_ser, start_height, stop_hash, MAX_GETCFHEADERS_SIZE, stop_index)) {
+        return;
+    }
+
+    uint256 prev_header;
+    if (start_height > 0) {
+        const CBlockIndex* const prev_block = stop_index->GetAncestor(static_cast<int>(start_height - 1));
+        if (!g_blockfilterindex->LookupFilterHeader(prev_block, prev_header)) {
+            LogPrint(BCLog::NET, "Failed to find block filter header in index: filter_type=%s, block_hash=%s\n",
+                     BlockFilterTypeName(g_blockfilterindex->GetFilterType()), prev_block->GetBlockHash().ToString());
+            return;
+        }
+    }
+
+    std::vector<uint256> filter_hashes;
+    if (!g_blockfilterindex->LookupFilterHashRange(start_height, stop_index, filter_hashes)) {
+        LogPrint(BCLog::NET, "Failed to find block filter hashes in index: filter_type=%s, start_height=%d, stop_hash=%s\n",
+                 BlockFilterTypeName(g_blockfilterindex->GetFilterType()), start_height, stop_hash.ToString());
+        return;
+    }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFHEADERS, filter_type_ser, stop_index->GetBlockHash(),
+                                              prev_header, filter_hashes));
+}
+
+static void ProcessGetCFCheckPt(CNode* pfrom, CDataStream& vRecv, CConnman* connman)
+{
+    uint8_t filter_type_ser;
+    uint256 stop_hash;
+
+    vRecv >> filter_type_ser >> stop_hash;
+
+    const CBlockIndex* stop_index;
+    if (!PrepareBlockFilterRequest(pfrom, filter_type_ser, /*start_height=*/0, stop_hash,
+                                   /*max_height_diff=*/std::numeric_limits<uint32_t>::max(), stop_index)) {
+        return;
+    }
+
+    std::vector<uint256> headers(stop_index->nHeight / CFCHECKPT_INTERVAL);
+
+    // Populate headers.
+    const CBlockIndex* block_index = stop_index;
+    for (int i = headers.size() - 1; i >= 0; i--) {
+        int height = (i + 1) * CFCHECKPT_INTERVAL;
+        block_index = block_index->GetAncestor(height);
+
+        if (!g_blockfilterindex->LookupFilterHeader(block_index, headers[i])) {
+            LogPrint(BCLog::NET, "Failed to find block filter header in index: filter_type=%s, block_hash=%s\n",
+                     BlockFilterTypeName(g_blockfilterindex->GetFilterType()), block_index->GetBlockHash().ToString());
+            return;
+        }
+    }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::CFCHECKPT, filter_type_ser, stop_index->GetBlockHash(), headers));
+}
+
 bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::vector<CBlockHeader>& headers, const CChainParams& chainparams, bool punish_duplicate_invalid)
 {
     const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
@@ -1657,6 +2109,118 @@ bool static ProcessHeadersMessage(CNode *pfrom, CConnman *connman, const std::ve
     return true;
 }
 
+/** Keep a transaction with missing inputs as an orphan and ask the peer for its parents, unless a parent was rejected */
+void static AddMissingInputsTx(CNode* pfrom, const CTransactionRef& ptx) EXCLUSIVE_LOCKS_REQUIRED(cs_main, g_cs_orphans)
+{
+    const CTransaction& tx = *ptx;
+    bool fRejectedParents = false; // It may be the case that the orphans parents have all been rejected
+    for (const CTxIn& txin : tx.vin) {
+        if (recentRejects->contains(txin.prevout.hash)) {
+            fRejectedParents = true;
+            break;
+        }
+    }
+    if (!fRejectedParents) {
+        uint32_t nFetchFlags = GetFetchFlags(pfrom);
+        for (const CTxIn& txin : tx.vin) {
+            CInv _inv(MSG_TX | nFetchFlags, txin.prevout.hash);
+            pfrom->AddInventoryKnown(_inv);
+            if (!AlreadyHave(_inv)) pfrom->AskFor(_inv);
+        }
+        AddOrphanTx(ptx, pfrom->GetId());
+
+        // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
+        unsigned int nMaxOrphanTx = (unsigned int)std::max((int64_t)0, gArgs.GetArg("-maxorphantx", DEFAULT_MAX_ORPHAN_TRANSACTIONS));
+        unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx);
+        if (nEvicted > 0) {
+            LogPrint(BCLog::MEMPOOL, "mapOrphan overflow, removed %u tx\n", nEvicted);
+        }
+    } else {
+        LogPrint(BCLog::MEMPOOL, "not keeping orphan with rejected parents %s\n",tx.GetHash().ToString());
+        // We will continue to reject this tx since it has rejected
+        // parents so avoid re-requesting it from other peers.
+        recentRejects->insert(tx.GetHash());
+    }
+}
+
+/**
+ * Try the orphans spending the outpoints in vWorkQueue, directly or through other orphans, as packages of about
+ * MAX_PACKAGE_COUNT transactions, so that a chain of orphans is accepted in a single pass, parents before children
+ */
+void static ProcessOrphanTxs(std::deque<COutPoint>& vWorkQueue, CConnman* connman, std::list<CTransactionRef>& lRemovedTxn) EXCLUSIVE_LOCKS_REQUIRED(cs_main, g_cs_orphans)
+{
+    std::set<NodeId> setMisbehaving;
+    std::set<uint256> setQueued;
+    std::vector<uint256> vEraseQueue;
+    while (!vWorkQueue.empty()) {
+        std::vector<CTransactionRef> vPackage;
+        std::vector<NodeId> vFromPeer;
+        while (!vWorkQueue.empty() && vPackage.size() < MAX_PACKAGE_COUNT) {
+            auto itByPrev = mapOrphanTransactionsByPrev.find(vWorkQueue.front());
+            vWorkQueue.pop_front();
+            if (itByPrev == mapOrphanTransactionsByPrev.end())
+                continue;
+            for (auto mi = itByPrev->second.begin();
+                 mi != itByPrev->second.end();
+                 ++mi)
+            {
+                const CTransactionRef& porphanTx = (*mi)->second.tx;
+                const uint256& orphanHash = porphanTx->GetHash();
+                NodeId fromPeer = (*mi)->second.fromPeer;
+                if (setMisbehaving.count(fromPeer) || !setQueued.insert(orphanHash).second)
+                    continue;
+                vPackage.push_back(porphanTx);
+                vFromPeer.push_back(fromPeer);
+                for (unsigned int i = 0; i < porphanTx->vout.size(); i++) {
+                    vWorkQueue.emplace_back(orphanHash, i);
+                }
+            }
+        }
+
+        // The states aren't sent back to anyone so someone can't setup nodes to counter-DoS based on orphan
+        // resolution (that is, feeding people an invalid transaction based on LegitTxX in order to get
+        // anyone relaying LegitTxX banned)
+        std::vector<CPackageTxResult> vResults;
+        AcceptPackageToMemoryPool(mempool, vPackage, vResults, &lRemovedTxn);
+        for (size_t i = 0; i < vPackage.size(); i++) {
+            const CTransaction& orphanTx = *vPackage[i];
+            const uint256& orphanHash = orphanTx.GetHash();
+            const CPackageTxResult& result = vResults[i];
+            if (result.fAccepted) {
+                LogPrint(BCLog::MEMPOOL, "   accepted orphan tx %s\n", orphanHash.ToString());
+                RelayTransaction(orphanTx, connman);
+                vEraseQueue.push_back(orphanHash);
+            }
+            else if (!result.fMissingInputs)
+            {
+                int nDos = 0;
+                if (result.state.IsInvalid(nDos) && nDos > 0)
+                {
+                    // Punish peer that gave us an invalid orphan tx
+                    Misbehaving(vFromPeer[i], nDos);
+                    setMisbehaving.insert(vFromPeer[i]);
+                    LogPrint(BCLog::MEMPOOL, "   invalid orphan tx %s\n", orphanHash.ToString());
+                }
+                // Has inputs but not accepted to mempool
+                // Probably non-standard or insufficient fee
+                LogPrint(BCLog::MEMPOOL, "   removed orphan tx %s\n", orphanHash.ToString());
+                vEraseQueue.push_back(orphanHash);
+                if (!orphanTx.HasWitness() && !result.state.CorruptionPossible()) {
+                    // Do not use rejection cache for witness transactions or
+                    // witness-stripped transactions, as they can have been malleated.
+                    // See https://github.com/bitcoin/bitcoin/issues/8279 for details.
+                    assert(recentRejects);
+                    recentRejects->insert(orphanHash);
+                }
+            }
+        }
+        mempool.check(pcoinsTip.get());
+    }
+
+    for (uint256 hash : vEraseQueue)
+        EraseOrphanTx(hash);
+}
+
 bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv, int64_t nTimeReceived, const CChainParams& chainparams, CConnman* connman, const std::atomic<bool>& interruptMsgProc)
 {
     LogPrint(BCLog::NET, "received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->GetId());
@@ -2220,6 +2784,24 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     }
 
 
+    else if (strCommand == NetMsgType::GETCFILTERS)
+    {
+        ProcessGetCFilters(pfrom, vRecv, connman);
+    }
+
+
+    else if (strCommand == NetMsgType::GETCFHEADERS)
+    {
+        ProcessGetCFHeaders(pfrom, vRecv, connman);
+    }
+
+
+    else if (strCommand == NetMsgType::GETCFCHECKPT)
+    {
+        ProcessGetCFCheckPt(pfrom, vRecv, connman);
+    }
+
+
     else if (strCommand == NetMsgType::GETHEADERS)
     {
         CBlockLocator locator;
@@ -2293,7 +2875,6 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         }
 
         std::deque<COutPoint> vWorkQueue;
-        std::vector<uint256> vEraseQueue;
         CTransactionRef ptx;
         CTxLockRequest txLockRequest;
         CDarksendBroadcastTx dstx;
@@ -2321,26 +2902,26 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         // Process custom logic, no matter if tx will be accepted to mempool later or not
         if (strCommand == NetMsgType::TXLOCKREQUEST) {
             if (!instantsend.ProcessTxLockRequest(txLockRequest)) {
-                LogPrintf("instantsend", "TXLOCKREQUEST -- failed %s\n", txLockRequest.GetHash().ToString());
+                LogPrint(BCLog::GHOSTNODE, "TXLOCKREQUEST -- failed %s\n", txLockRequest.GetHash().ToString());
                 return false;
             }
         } else if (strCommand == NetMsgType::DSTX) {
             uint256 hashTx = tx.GetHash();
 
             if (mapDarksendBroadcastTxes.count(hashTx)) {
-                LogPrintf("privatesend", "DSTX -- Already have %s, skipping...\n", hashTx.ToString());
+                LogPrint(BCLog::GHOSTNODE, "DSTX -- Already have %s, skipping...\n", hashTx.ToString());
                 return true; // not an error
             }
 
             CGhostnode *pmn = mnodeman.Find(dstx.vin);
             if (pmn == NULL) {
-                LogPrintf("privatesend", "DSTX -- Can't find ghostnode %s to verify %s\n",
+                LogPrint(BCLog::GHOSTNODE, "DSTX -- Can't find ghostnode %s to verify %s\n",
                          dstx.vin.prevout.ToStringShort(), hashTx.ToString());
                 return false;
             }
 
             if (!pmn->fAllowMixingTx) {
-                LogPrintf("privatesend", "DSTX -- Ghostnode %s is sending too many transactions %s\n",
+                LogPrint(BCLog::GHOSTNODE, "DSTX -- Ghostnode %s is sending too many transactions %s\n",
                          dstx.vin.prevout.ToStringShort(), hashTx.ToString());
                 return true;
                 // TODO: Not an error? Could it be that someone is relaying old DSTXes
@@ -2348,7 +2929,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             }
 
             if (!dstx.CheckSignature(pmn->pubKeyGhostnode)) {
-                LogPrintf("privatesend", "DSTX -- CheckSignature() failed for %s\n", hashTx.ToString());
+                LogPrint(BCLog::GHOSTNODE, "DSTX -- CheckSignature() failed for %s\n", hashTx.ToString());
                 return false;
             }
 
@@ -2356,6 +2937,10 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             pmn->fAllowMixingTx = false;
         }
 
+        // Verify the signatures before taking cs_main, AcceptToMemoryPool below then finds them in the signature cache
+        if (!tx.IsZerocoinSpend())
+            PreCheckTransactionScriptsForMemoryPool(mempool, ptx);
+
         LOCK2(cs_main, g_cs_orphans);
 
         bool fMissingInputs = false;
@@ -2366,6 +2951,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         mapAlreadyAskedFor.erase(inv.hash);
 
         std::list<CTransactionRef> lRemovedTxn;
+        std::vector<CZerocoinSpendCheck> vZerocoinChecks;
 
         if (!AlreadyHave(inv) && !tx.IsZerocoinSpend() &&
             AcceptToMemoryPool(mempool, state, ptx, &fMissingInputs, &lRemovedTxn, false /* bypass_limits */, 0 /* nAbsurdFee */)) {
@@ -2383,100 +2969,24 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 mempool.size(), mempool.DynamicMemoryUsage() / 1000);
 
             // Recursively process any orphan transactions that depended on this one
-            std::set<NodeId> setMisbehaving;
-            while (!vWorkQueue.empty()) {
-                auto itByPrev = mapOrphanTransactionsByPrev.find(vWorkQueue.front());
-                vWorkQueue.pop_front();
-                if (itByPrev == mapOrphanTransactionsByPrev.end())
-                    continue;
-                for (auto mi = itByPrev->second.begin();
-                     mi != itByPrev->second.end();
-                     ++mi)
-                {
-                    const CTransactionRef& porphanTx = (*mi)->second.tx;
-                    const CTransaction& orphanTx = *porphanTx;
-                    const uint256& orphanHash = orphanTx.GetHash();
-                    NodeId fromPeer = (*mi)->second.fromPeer;
-                    bool fMissingInputs2 = false;
-                    // Use a dummy CValidationState so someone can't setup nodes to counter-DoS based on orphan
-                    // resolution (that is, feeding people an invalid transaction based on LegitTxX in order to get
-                    // anyone relaying LegitTxX banned)
-                    CValidationState stateDummy;
-
-
-                    if (setMisbehaving.count(fromPeer))
-                        continue;
-                    if (AcceptToMemoryPool(mempool, stateDummy, porphanTx, &fMissingInputs2, &lRemovedTxn, false /* bypass_limits */, 0 /* nAbsurdFee */)) {
-                        LogPrint(BCLog::MEMPOOL, "   accepted orphan tx %s\n", orphanHash.ToString());
-                        RelayTransaction(orphanTx, connman);
-                        for (unsigned int i = 0; i < orphanTx.vout.size(); i++) {
-                            vWorkQueue.emplace_back(orphanHash, i);
-                        }
-                        vEraseQueue.push_back(orphanHash);
-                    }
-                    else if (!fMissingInputs2)
-                    {
-                        int nDos = 0;
-                        if (stateDummy.IsInvalid(nDos) && nDos > 0)
-                        {
-                            // Punish peer that gave us an invalid orphan tx
-                            Misbehaving(fromPeer, nDos);
-                            setMisbehaving.insert(fromPeer);
-                            LogPrint(BCLog::MEMPOOL, "   invalid orphan tx %s\n", orphanHash.ToString());
-                        }
-                        // Has inputs but not accepted to mempool
-                        // Probably non-standard or insufficient fee
-                        LogPrint(BCLog::MEMPOOL, "   removed orphan tx %s\n", orphanHash.ToString());
-                        vEraseQueue.push_back(orphanHash);
-                        if (!orphanTx.HasWitness() && !stateDummy.CorruptionPossible()) {
-                            // Do not use rejection cache for witness transactions or
-                            // witness-stripped transactions, as they can have been malleated.
-                            // See https://github.com/bitcoin/bitcoin/issues/8279 for details.
-                            assert(recentRejects);
-                            recentRejects->insert(orphanHash);
-                        }
-                    }
-                    mempool.check(pcoinsTip.get());
-                }
-            }
-
-            for (uint256 hash : vEraseQueue)
-                EraseOrphanTx(hash);
+            ProcessOrphanTxs(vWorkQueue, connman, lRemovedTxn);
         }
-        else if (!AlreadyHave(inv) && tx.IsZerocoinSpend() && AcceptToMemoryPool(mempool, state, ptx, &fMissingZerocoinInputs, &lRemovedTxn, false /* bypass_limits */, 0 /* nAbsurdFee */)) {
+        else if (!AlreadyHave(inv) && tx.IsZerocoinSpend() && zerocoinSpendAdmission.IsRunning() &&
+                 PreCheckZerocoinSpendForMemoryPool(mempool, state, ptx, vZerocoinChecks)) {
+            // The proofs are verified on a zerocoin admission thread, which adds the spend to the memory pool and relays it
+            if (!zerocoinSpendAdmission.Push(pfrom->GetId(), ptx, vZerocoinChecks))
+                LogPrint(BCLog::MEMPOOL, "too many zerocoin spends waiting for verification, ignoring %s from peer=%d\n", tx.GetHash().ToString(), pfrom->GetId());
+        }
+        else if (!AlreadyHave(inv) && tx.IsZerocoinSpend() && !zerocoinSpendAdmission.IsRunning() &&
+                 AcceptToMemoryPool(mempool, state, ptx, &fMissingZerocoinInputs, &lRemovedTxn, false /* bypass_limits */, 0 /* nAbsurdFee */)) {
             RelayTransaction(tx, connman);
+            // Keep it for compact blocks even if it leaves the mempool before it is mined
+            AddToCompactExtraTransactions(ptx);
 
         }
         else if (fMissingInputs)
         {
-            bool fRejectedParents = false; // It may be the case that the orphans parents have all been rejected
-            for (const CTxIn& txin : tx.vin) {
-                if (recentRejects->contains(txin.prevout.hash)) {
-                    fRejectedParents = true;
-                    break;
-                }
-            }
-            if (!fRejectedParents) {
-                uint32_t nFetchFlags = GetFetchFlags(pfrom);
-                for (const CTxIn& txin : tx.vin) {
-                    CInv _inv(MSG_TX | nFetchFlags, txin.prevout.hash);
-                    pfrom->AddInventoryKnown(_inv);
-                    if (!AlreadyHave(_inv)) pfrom->AskFor(_inv);
-                }
-                AddOrphanTx(ptx, pfrom->GetId());
-
-                // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
-                unsigned int nMaxOrphanTx = (unsigned int)std::max((int64_t)0, gArgs.GetArg("-maxorphantx", DEFAULT_MAX_ORPHAN_TRANSACTIONS));
-                unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx);
-                if (nEvicted > 0) {
-                    LogPrint(BCLog::MEMPOOL, "mapOrphan overflow, removed %u tx\n", nEvicted);
-                }
-            } else {
-                LogPrint(BCLog::MEMPOOL, "not keeping orphan with rejected parents %s\n",tx.GetHash().ToString());
-                // We will continue to reject this tx since it has rejected
-                // parents so avoid re-requesting it from other peers.
-                recentRejects->insert(tx.GetHash());
-            }
+            AddMissingInputsTx(pfrom, ptx);
         } else {
             if (!tx.HasWitness() && !state.CorruptionPossible()) {
                 // Do not use rejection cache for witness transactions or
@@ -2484,7 +2994,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 // See https://github.com/bitcoin/bitcoin/issues/8279 for details.
                 assert(recentRejects);
                 recentRejects->insert(tx.GetHash());
-                if (RecursiveDynamicUsage(*ptx) < 100000) {
+                if (tx.IsZerocoinSpend() || RecursiveDynamicUsage(*ptx) < 100000) {
                     AddToCompactExtraTransactions(ptx);
                 }
             } else if (tx.HasWitness() && RecursiveDynamicUsage(*ptx) < 100000) {
@@ -2529,6 +3039,98 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
     }
 
 
+    else if (strCommand == NetMsgType::PKGTXS)
+    {
+        // Stop processing the package early if
+        // We are in blocks only mode and peer is either not whitelisted or whitelistrelay is off
+        if (!fRelayTxes && (!pfrom->fWhitelisted || !gArgs.GetBoolArg("-whitelistrelay", DEFAULT_WHITELISTRELAY)))
+        {
+            LogPrint(BCLog::NET, "transaction package sent in violation of protocol peer=%d\n", pfrom->GetId());
+            return true;
+        }
+
+        std::vector<CTransactionRef> vPackageIn;
+        vRecv >> vPackageIn;
+        if (vPackageIn.size() > MAX_PACKAGE_COUNT)
+        {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), 20);
+            return error("message pkgtxs size() = %u", vPackageIn.size());
+        }
+
+        LOCK2(cs_main, g_cs_orphans);
+
+        std::vector<CTransactionRef> vPackage;
+        for (const CTransactionRef& ptx : vPackageIn) {
+            CInv inv(MSG_TX, ptx->GetHash());
+            pfrom->AddInventoryKnown(inv);
+            pfrom->setAskFor.erase(inv.hash);
+            mapAlreadyAskedFor.erase(inv.hash);
+            // Zerocoin spends are never sent in packages, they have no parents to come with
+            if (!AlreadyHave(inv) && !ptx->IsZerocoinSpend())
+                vPackage.push_back(ptx);
+        }
+
+        std::deque<COutPoint> vWorkQueue;
+        std::list<CTransactionRef> lRemovedTxn;
+        std::vector<CPackageTxResult> vResults;
+        AcceptPackageToMemoryPool(mempool, vPackage, vResults, &lRemovedTxn);
+        mempool.check(pcoinsTip.get());
+
+        for (size_t i = 0; i < vPackage.size(); i++) {
+            const CTransaction& tx = *vPackage[i];
+            const CPackageTxResult& result = vResults[i];
+            if (result.fAccepted) {
+                RelayTransaction(tx, connman);
+                for (unsigned int j = 0; j < tx.vout.size(); j++) {
+                    vWorkQueue.emplace_back(tx.GetHash(), j);
+                }
+                pfrom->nLastTXTime = GetTime();
+                LogPrint(BCLog::MEMPOOL, "AcceptPackageToMemoryPool: peer=%d: accepted %s (poolsz %u txn, %u kB)\n",
+                    pfrom->GetId(),
+                    tx.GetHash().ToString(),
+                    mempool.size(), mempool.DynamicMemoryUsage() / 1000);
+                continue;
+            }
+            if (result.fMissingInputs)
+                continue;
+
+            if (!tx.HasWitness() && !result.state.CorruptionPossible()) {
+                // Do not use rejection cache for witness transactions or
+                // witness-stripped transactions, as they can have been malleated.
+                // See https://github.com/bitcoin/bitcoin/issues/8279 for details.
+                assert(recentRejects);
+                recentRejects->insert(tx.GetHash());
+            }
+            int nDoS = 0;
+            if (result.state.IsInvalid(nDoS))
+            {
+                LogPrint(BCLog::MEMPOOLREJ, "%s from peer=%d was not accepted: %s\n", tx.GetHash().ToString(),
+                    pfrom->GetId(),
+                    FormatStateMessage(result.state));
+                if (result.state.GetRejectCode() > 0 && result.state.GetRejectCode() < REJECT_INTERNAL) // Never send AcceptToMemoryPool's internal codes over P2P
+                    connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::REJECT, strCommand, (unsigned char)result.state.GetRejectCode(),
+                                       result.state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), tx.GetHash()));
+                if (nDoS > 0) {
+                    Misbehaving(pfrom->GetId(), nDoS);
+                }
+            }
+        }
+
+        // After the rejected ones went to recentRejects, so that children of rejected parents aren't kept
+        for (size_t i = 0; i < vPackage.size(); i++) {
+            if (vResults[i].fMissingInputs)
+                AddMissingInputsTx(pfrom, vPackage[i]);
+        }
+
+        // Recursively process any orphan transactions that depended on the package
+        ProcessOrphanTxs(vWorkQueue, connman, lRemovedTxn);
+
+        for (const CTransactionRef& removedTx : lRemovedTxn)
+            AddToCompactExtraTransactions(removedTx);
+    }
+
+
     else if (strCommand == NetMsgType::CMPCTBLOCK && !fImporting && !fReindex) // Ignore blocks received while importing
     {
         CBlockHeaderAndShortTxIDs cmpctblock;
@@ -2642,7 +3244,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 }
 
                 PartiallyDownloadedBlock& partialBlock = *(*queuedBlockIt)->partialBlock;
-                ReadStatus status = partialBlock.InitData(cmpctblock, vExtraTxnForCompact);
+                ReadStatus status = partialBlock.InitData(cmpctblock, vExtraTxnForCompact, vExtraSpendsForCompact);
                 if (status == READ_STATUS_INVALID) {
                     MarkBlockAsReceived(pindex->GetBlockHash()); // Reset in-flight state in case of whitelist
                     Misbehaving(pfrom->GetId(), 100);
@@ -2678,7 +3280,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
                 // Optimistically try to reconstruct anyway since we might be
                 // able to without any round trips.
                 PartiallyDownloadedBlock tempBlock(&mempool);
-                ReadStatus status = tempBlock.InitData(cmpctblock, vExtraTxnForCompact);
+                ReadStatus status = tempBlock.InitData(cmpctblock, vExtraTxnForCompact, vExtraSpendsForCompact);
                 if (status != READ_STATUS_OK) {
                     // TODO: don't ignore failures
                     return true;
@@ -2866,6 +3468,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
             LOCK(cs_main);
             // Also always process if we requested the block explicitly, as we may
             // need it even though it is not a candidate for a new best tip.
+            MarkBlockAsDelivered(pfrom->GetId(), hash);
             forceProcessing |= MarkBlockAsReceived(hash);
             // mapBlockSource is only used for sending reject messages and DoS scores,
             // so the race between here and cs_main in ProcessNewBlock is fine.
@@ -2903,7 +3506,7 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         pfrom->fSentAddr = true;
 
         pfrom->vAddrToSend.clear();
-        std::vector<CAddress> vAddr = connman->GetAddresses();
+        std::vector<CAddress> vAddr = connman->GetAddressesCached();
         FastRandomContext insecure_rand;
         for (const CAddress &addr : vAddr)
             pfrom->PushAddress(addr, insecure_rand);
@@ -3094,14 +3697,8 @@ bool static ProcessMessage(CNode* pfrom, const std::string& strCommand, CDataStr
         }
 
         if (found) {
-            std::string strCommandNonConst = strCommand;
             //probably one the extensions
-            darkSendPool.ProcessMessage(pfrom, strCommandNonConst, vRecv);
-            mnodeman.ProcessMessage(pfrom, strCommandNonConst, vRecv);
-            mnpayments.ProcessMessage(pfrom, strCommandNonConst, vRecv);
-            instantsend.ProcessMessage(pfrom, strCommandNonConst, vRecv);
-            sporkManager.ProcessSpork(pfrom, strCommandNonConst, vRecv);
-            ghostnodeSync.ProcessMessage(pfrom, strCommandNonConst, vRecv);
+            connman->PushGhostnodeMessage(pfrom, strCommand, vRecv);
         } else {
             // Ignore unknown commands for extensibility
             LogPrint(BCLog::NET, "Unknown command \"%s\" from peer=%d\n", SanitizeString(strCommand), pfrom->GetId());
@@ -3156,8 +3753,11 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
     //
     bool fMoreWork = false;
 
-    if (!pfrom->vRecvGetData.empty())
+    if (!pfrom->vRecvGetData.empty()) {
+        int64_t nTimeStart = GetTimeMicros();
         ProcessGetData(pfrom, chainparams.GetConsensus(), connman, interruptMsgProc);
+        pfrom->AddProcessTime(NetMsgType::GETDATA, GetTimeMicros() - nTimeStart);
+    }
 
     if (pfrom->fDisconnect)
         return false;
@@ -3169,6 +3769,10 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
     if (pfrom->fPauseSend)
         return false;
 
+    // Let the ghostnode message threads catch up with this peer, they wake us up
+    if (pfrom->nGhostnodeMsgQueued >= MAX_GHOSTNODE_MSG_QUEUE)
+        return false;
+
     std::list<CNetMessage> msgs;
     {
         LOCK(pfrom->cs_vProcessMsg);
@@ -3216,6 +3820,7 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
 
     // Process message
     bool fRet = false;
+    int64_t nTimeStart = GetTimeMicros();
     try
     {
         fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime, chainparams, connman, interruptMsgProc);
@@ -3252,6 +3857,7 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
     } catch (...) {
         PrintExceptionContinue(nullptr, "ProcessMessages()");
     }
+    pfrom->AddProcessTime(strCommand, GetTimeMicros() - nTimeStart);
 
     if (!fRet) {
         LogPrint(BCLog::NET, "%s(%s, %u bytes) FAILED peer=%d\n", __func__, SanitizeString(strCommand), nMessageSize, pfrom->GetId());
@@ -3263,6 +3869,33 @@ bool PeerLogicValidation::ProcessMessages(CNode* pfrom, std::atomic<bool>& inter
     return fMoreWork;
 }
 
+void PeerLogicValidation::ProcessGhostnodeMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv)
+{
+    std::string strCommandNonConst = strCommand;
+    int64_t nTimeStart = GetTimeMicros();
+    try
+    {
+        ghostnodeStats.AddMessage(strCommand);
+        darkSendPool.ProcessMessage(pfrom, strCommandNonConst, vRecv);
+        mnodeman.ProcessMessage(pfrom, strCommandNonConst, vRecv);
+        mnpayments.ProcessMessage(pfrom, strCommandNonConst, vRecv);
+        instantsend.ProcessMessage(pfrom, strCommandNonConst, vRecv);
+        sporkManager.ProcessSpork(pfrom, strCommandNonConst, vRecv);
+        ghostnodeSync.ProcessMessage(pfrom, strCommandNonConst, vRecv);
+    }
+    catch (const std::ios_base::failure& e)
+    {
+        connman->PushMessage(pfrom, CNetMsgMaker(INIT_PROTO_VERSION).Make(NetMsgType::REJECT, strCommand, REJECT_MALFORMED, std::string("error parsing message")));
+        LogPrint(BCLog::NET, "%s(%s, %u bytes): Exception '%s' caught\n", __func__, SanitizeString(strCommand), vRecv.size(), e.what());
+    }
+    catch (const std::exception& e) {
+        PrintExceptionContinue(&e, "ProcessGhostnodeMessage()");
+    } catch (...) {
+        PrintExceptionContinue(nullptr, "ProcessGhostnodeMessage()");
+    }
+    pfrom->AddProcessTime(strCommand, GetTimeMicros() - nTimeStart);
+}
+
 void PeerLogicValidation::ConsiderEviction(CNode *pto, int64_t time_in_seconds)
 {
     AssertLockHeld(cs_main);
@@ -3673,6 +4306,7 @@ bool PeerLogicValidation::SendMessages(CNode* pto, std::atomic<bool>& interruptM
         //
         std::vector <CInv> vInvWait;
         std::vector<CInv> vInv;
+        bool fSendTrickle = false;
         {
             LOCK(pto->cs_inventory);
             vInv.reserve(std::max<size_t>(pto->vInventoryBlockToSend.size(), INVENTORY_BROADCAST_MAX));
@@ -3688,7 +4322,7 @@ bool PeerLogicValidation::SendMessages(CNode* pto, std::atomic<bool>& interruptM
             pto->vInventoryBlockToSend.clear();
 
             // Check whether periodic sends should happen
-            bool fSendTrickle = pto->fWhitelisted;
+            fSendTrickle = pto->fWhitelisted;
             if (pto->nNextInvSend < nNow) {
                 fSendTrickle = true;
                 // Use half the delay for outbound peers, as there is less privacy concern for them.
@@ -3725,6 +4359,7 @@ bool PeerLogicValidation::SendMessages(CNode* pto, std::atomic<bool>& interruptM
                         if (!pto->pfilter->IsRelevantAndUpdate(*txinfo.tx)) continue;
                     }
                     pto->filterInventoryKnown.insert(hash);
+                    pto->filterTxAnnounced.insert(hash);
                     vInv.push_back(inv);
                     if (vInv.size() == MAX_INV_SZ) {
                         connman->PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
@@ -3797,6 +4432,7 @@ bool PeerLogicValidation::SendMessages(CNode* pto, std::atomic<bool>& interruptM
                         vInv.clear();
                     }
                     pto->filterInventoryKnown.insert(hash);
+                    pto->filterTxAnnounced.insert(hash);
                 }
             }
         }
@@ -3808,18 +4444,26 @@ bool PeerLogicValidation::SendMessages(CNode* pto, std::atomic<bool>& interruptM
             vInvWait.reserve(pto->vInventoryToSend.size());
             BOOST_FOREACH(const CInv& inv, pto->vInventoryToSend)
             {
+                // Bursts of ghostnode inventory wait for the trickle and go out in one message,
+                // InstantSend locks and sporks are announced right away
+                if (!fSendTrickle && inv.type != MSG_TXLOCK_REQUEST && inv.type != MSG_TXLOCK_VOTE && inv.type != MSG_SPORK) {
+                    vInvWait.push_back(inv);
+                    continue;
+                }
+                if (pto->filterInventoryKnown.contains(inv.hash))
+                    continue;
                 pto->filterInventoryKnown.insert(inv.hash);
 
                 //LogPrintf("SendMessages -- queued inv: %s  index=%d peer=%d\n", inv.ToString(), vInv.size(), pto->GetId());
                 vInv.push_back(inv);
                 if (vInv.size() >= 1000)
                 {
-                    LogPrintf("SendMessages -- pushing inv's: count=%d peer=%d\n", vInv.size(), pto->GetId());
+                    LogPrint(BCLog::NET, "SendMessages -- pushing inv's: count=%d peer=%d\n", vInv.size(), pto->GetId());
                     connman->PushMessage(pto, msgMaker.Make(NetMsgType::INV, vInv));
                     vInv.clear();
                 }
             }
-            pto->vInventoryToSend = vInvWait;
+            pto->vInventoryToSend.swap(vInvWait);
         }
 
 
@@ -3828,12 +4472,17 @@ bool PeerLogicValidation::SendMessages(CNode* pto, std::atomic<bool>& interruptM
 
         // Detect whether we're stalling
         nNow = GetTimeMicros();
-        if (state.nStallingSince && state.nStallingSince < nNow - 1000000 * BLOCK_STALLING_TIMEOUT) {
+        if (state.nStallingSince && state.nStallingSince < nNow - nBlockStallingTimeout) {
             // Stalling only triggers when the block download window cannot move. During normal steady state,
             // the download window should be much larger than the to-be-downloaded set of blocks, so disconnection
             // should only happen during initial block download.
             LogPrintf("Peer=%d is stalling block download, disconnecting\n", pto->GetId());
             pto->fDisconnect = true;
+            // If our own link is what is slow, every peer looks like it stalls, so give the next one longer
+            if (nBlockStallingTimeout < MAX_BLOCK_STALLING_TIMEOUT * 1000000) {
+                nBlockStallingTimeout = std::min<int64_t>(MAX_BLOCK_STALLING_TIMEOUT * 1000000, nBlockStallingTimeout * 2);
+                LogPrint(BCLog::NET, "Increased block stalling timeout to %d seconds\n", nBlockStallingTimeout / 1000000);
+            }
             return true;
         }
         // In case there is a block that has been in flight from this peer for 2 + 0.5 * N times the block interval
@@ -3891,10 +4540,10 @@ bool PeerLogicValidation::SendMessages(CNode* pto, std::atomic<bool>& interruptM
         // Message: getdata (blocks)
         //
         std::vector<CInv> vGetData;
-        if (!pto->fClient && (fFetch || !IsInitialBlockDownload()) && state.nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+        if (!pto->fClient && (fFetch || !IsInitialBlockDownload()) && state.nBlocksInFlight < state.nBlocksInFlightLimit) {
             std::vector<const CBlockIndex*> vToDownload;
             NodeId staller = -1;
-            FindNextBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight, vToDownload, staller, consensusParams);
+            FindNextBlocksToDownload(pto->GetId(), state.nBlocksInFlightLimit - state.nBlocksInFlight, vToDownload, staller, consensusParams);
             for (const CBlockIndex *pindex : vToDownload) {
                 uint32_t nFetchFlags = GetFetchFlags(pto);
                 vGetData.push_back(CInv(MSG_BLOCK | nFetchFlags, pindex->GetBlockHash()));
@@ -3903,8 +4552,11 @@ bool PeerLogicValidation::SendMessages(CNode* pto, std::atomic<bool>& interruptM
                     pindex->nHeight, pto->GetId());
             }
             if (state.nBlocksInFlight == 0 && staller != -1) {
-                if (State(staller)->nStallingSince == 0) {
-                    State(staller)->nStallingSince = nNow;
+                CNodeState *stateStaller = State(staller);
+                if (stateStaller->nStallingSince == 0) {
+                    stateStaller->nStallingSince = nNow;
+                    // The staller holds the blocks validation waits for, so it gets fewer of the next ones
+                    stateStaller->nBlocksInFlightLimit = std::max(MIN_BLOCKS_IN_TRANSIT_PER_PEER, stateStaller->nBlocksInFlightLimit / 2);
                     LogPrint(BCLog::NET, "Stall started peer=%d\n", staller);
                 }
             }
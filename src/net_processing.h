@@ -18,6 +18,8 @@ static const int64_t ORPHAN_TX_EXPIRE_TIME = 20 * 60;
 static const int64_t ORPHAN_TX_EXPIRE_INTERVAL = 5 * 60;
 /** Default number of orphan+recently-replaced txn to keep around for block reconstruction */
 static const unsigned int DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN = 100;
+/** Default number of zerocoin spends to keep for compact block reconstruction, on top of the other transactions */
+static const unsigned int DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_SPENDS = 100;
 /** Headers download timeout expressed in microseconds
  *  Timeout = base + per_header * (expected number of headers) */
 static constexpr int64_t HEADERS_DOWNLOAD_TIMEOUT_BASE = 15 * 60 * 1000000; // 15 minutes
@@ -35,12 +37,22 @@ static constexpr int64_t EXTRA_PEER_CHECK_INTERVAL = 45;
 /** Minimum time an outbound-peer-eviction candidate must be connected for, in order to evict, in seconds */
 static constexpr int64_t MINIMUM_CONNECT_TIME = 30;
 
+/** Default for -zcadmissionthreads, threads verifying the zerocoin spends relayed by peers (0 = on the message handler thread) */
+static const int DEFAULT_ZEROCOIN_ADMISSION_THREADS = 2;
+/** Maximum number of zerocoin spend verification threads */
+static const int MAX_ZEROCOIN_ADMISSION_THREADS = 16;
+/** Maximum number of zerocoin spends from one peer waiting for verification, more are ignored */
+static const unsigned int MAX_PENDING_ZEROCOIN_SPENDS_PER_PEER = 8;
+/** Maximum number of zerocoin spends waiting for verification or being verified */
+static const unsigned int MAX_PENDING_ZEROCOIN_SPENDS = 256;
+
 class PeerLogicValidation : public CValidationInterface, public NetEventsInterface {
 private:
     CConnman* const connman;
 
 public:
     explicit PeerLogicValidation(CConnman* connman, CScheduler &scheduler);
+    ~PeerLogicValidation();
 
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected, const std::vector<CTransactionRef>& vtxConflicted) override;
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
@@ -60,6 +72,8 @@ public:
     * @return                      True if there is more work to be done
     */
     bool SendMessages(CNode* pto, std::atomic<bool>& interrupt) override;
+    /** Process a ghostnode-layer message, on a ghostnode message thread */
+    void ProcessGhostnodeMessage(CNode* pfrom, const std::string& strCommand, CDataStream& vRecv) override;
 
     void ConsiderEviction(CNode *pto, int64_t time_in_seconds);
     void CheckForStaleTipAndEvictPeers(const Consensus::Params &consensusParams);
@@ -74,6 +88,7 @@ struct CNodeStateStats {
     int nSyncHeight;
     int nCommonHeight;
     std::vector<int> vHeightInFlight;
+    int nBlocksInFlightLimit;
 };
 
 /** Get statistics from node state */
@@ -19,6 +19,8 @@ public:
     {
         CSerializedNetMsg msg;
         msg.command = std::move(sCommand);
+        // Serialize into a recycled buffer, it goes back to the pool once sent
+        msg.data = g_net_send_buffers.Get(0);
         CVectorWriter{ SER_NETWORK, nFlags | nVersion, msg.data, 0, std::forward<Args>(args)... };
         return msg;
     }
@@ -29,6 +31,16 @@ public:
         return Make(0, std::move(sCommand), std::forward<Args>(args)...);
     }
 
+    /** A message of payload bytes serialized before, copied into a recycled buffer */
+    CSerializedNetMsg MakeSerialized(std::string sCommand, const std::vector<unsigned char>& payload) const
+    {
+        CSerializedNetMsg msg;
+        msg.command = std::move(sCommand);
+        msg.data = g_net_send_buffers.Get(payload.size());
+        msg.data.assign(payload.begin(), payload.end());
+        return msg;
+    }
+
 private:
     const int nVersion;
 };
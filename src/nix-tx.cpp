@@ -22,13 +22,20 @@
 #include <utilmoneystr.h>
 #include <utilstrencodings.h>
 
+#include <atomic>
 #include <stdio.h>
+#include <thread>
 
 #include <boost/algorithm/string.hpp>
 
 static bool fCreateBlank;
-static std::map<std::string,UniValue> registers;
+static bool fBatch;
+// Registers are set by the commands of one transaction, batch jobs keep their own on each thread
+static thread_local std::map<std::string,UniValue> registers;
 static const int CONTINUE_EXECUTION=-1;
+//! Number of batch jobs read from stdin before the workers process them and their results are written
+static const size_t BATCH_JOBS_PER_ROUND = 1024;
+static const int MAX_BATCH_THREADS = 64;
 
 //
 // This function returns either one of EXIT_ codes when it's expected to stop the process or
@@ -50,20 +57,25 @@ static int AppInitRawTx(int argc, char* argv[])
     }
 
     fCreateBlank = gArgs.GetBoolArg("-create", false);
+    fBatch = gArgs.GetBoolArg("-batch", false);
 
-    if (argc<2 || gArgs.IsArgSet("-?") || gArgs.IsArgSet("-h") || gArgs.IsArgSet("-help"))
+    if ((argc<2 && !fBatch) || gArgs.IsArgSet("-?") || gArgs.IsArgSet("-h") || gArgs.IsArgSet("-help"))
     {
         // First part of help message is specific to this utility
         std::string strUsage = strprintf(_("%s nix-tx utility version"), _(PACKAGE_NAME)) + " " + FormatFullVersion() + "\n\n" +
             _("Usage:") + "\n" +
               "  nix-tx [options] <hex-tx> [commands]  " + _("Update hex-encoded nix transaction") + "\n" +
               "  nix-tx [options] -create [commands]   " + _("Create hex-encoded nix transaction") + "\n" +
+              "  nix-tx [options] -batch               " + _("Process one transaction per line of standard input") + "\n" +
               "\n";
 
         fprintf(stdout, "%s", strUsage.c_str());
 
         strUsage = HelpMessageGroup(_("Options:"));
         strUsage += HelpMessageOpt("-?", _("This help message"));
+        strUsage += HelpMessageOpt("-batch", _("Read jobs from standard input, one per line, each with the hex-encoded transaction (omitted with -create) and commands separated by whitespace. "
+            "Jobs are processed in parallel and the results, or \"error: \" lines, are written in input order"));
+        strUsage += HelpMessageOpt("-batchthreads=<n>", strprintf(_("Number of threads processing batch jobs (default: number of cores, %u to %d)"), 1, MAX_BATCH_THREADS));
         strUsage += HelpMessageOpt("-create", _("Create new, empty TX."));
         strUsage += HelpMessageOpt("-json", _("Select JSON output"));
         strUsage += HelpMessageOpt("-txid", _("Output only the hex-encoded transaction id of the resultant transaction."));
@@ -703,10 +715,12 @@ static void MutateTx(CMutableTransaction& tx, const std::string& command,
     else if (command == "outaddr")
         MutateTxAddOutAddr(tx, commandVal);
     else if (command == "outpubkey") {
-        ecc.reset(new Secp256k1Init());
+        if (!fBatch) // batch mode starts the context once for all jobs
+            ecc.reset(new Secp256k1Init());
         MutateTxAddOutPubKey(tx, commandVal);
     } else if (command == "outmultisig") {
-        ecc.reset(new Secp256k1Init());
+        if (!fBatch)
+            ecc.reset(new Secp256k1Init());
         MutateTxAddOutMultiSig(tx, commandVal);
     } else if (command == "outscript")
         MutateTxAddOutScript(tx, commandVal);
@@ -714,7 +728,8 @@ static void MutateTx(CMutableTransaction& tx, const std::string& command,
         MutateTxAddOutData(tx, commandVal);
 
     else if (command == "sign") {
-        ecc.reset(new Secp256k1Init());
+        if (!fBatch)
+            ecc.reset(new Secp256k1Init());
         MutateTxSign(tx, commandVal);
     }
 
@@ -728,37 +743,32 @@ static void MutateTx(CMutableTransaction& tx, const std::string& command,
         throw std::runtime_error("unknown command");
 }
 
-static void OutputTxJSON(const CTransaction& tx)
+static std::string FormatTxJSON(const CTransaction& tx)
 {
     UniValue entry(UniValue::VOBJ);
     TxToUniv(tx, uint256(), entry);
 
-    std::string jsonOutput = entry.write(4);
-    fprintf(stdout, "%s\n", jsonOutput.c_str());
+    return entry.write(4);
 }
 
-static void OutputTxHash(const CTransaction& tx)
+static std::string FormatTxHash(const CTransaction& tx)
 {
-    std::string strHexHash = tx.GetHash().GetHex(); // the hex-encoded transaction hash (aka the transaction id)
-
-    fprintf(stdout, "%s\n", strHexHash.c_str());
+    return tx.GetHash().GetHex(); // the hex-encoded transaction hash (aka the transaction id)
 }
 
-static void OutputTxHex(const CTransaction& tx)
+static std::string FormatTxHex(const CTransaction& tx)
 {
-    std::string strHex = EncodeHexTx(tx);
-
-    fprintf(stdout, "%s\n", strHex.c_str());
+    return EncodeHexTx(tx);
 }
 
-static void OutputTx(const CTransaction& tx)
+static std::string FormatTx(const CTransaction& tx)
 {
     if (gArgs.GetBoolArg("-json", false))
-        OutputTxJSON(tx);
+        return FormatTxJSON(tx);
     else if (gArgs.GetBoolArg("-txid", false))
-        OutputTxHash(tx);
+        return FormatTxHash(tx);
     else
-        OutputTxHex(tx);
+        return FormatTxHex(tx);
 }
 
 static std::string readStdin()
@@ -781,6 +791,54 @@ static std::string readStdin()
     return ret;
 }
 
+//
+// Applies the commands in args to the transaction in args[0] (or a new one with -create)
+// and returns the formatted result. Throws std::exception on errors.
+//
+static std::string ProcessRawTx(const std::vector<std::string>& args)
+{
+    registers.clear();
+
+    CMutableTransaction tx;
+    size_t startArg;
+
+    if (!fCreateBlank) {
+        // require at least one param
+        if (args.empty())
+            throw std::runtime_error("too few parameters");
+
+        // param: hex-encoded nix transaction
+        std::string strHexTx(args[0]);
+        if (strHexTx == "-") {               // "-" implies standard input
+            if (fBatch)
+                throw std::runtime_error("standard input holds the batch jobs");
+            strHexTx = readStdin();
+        }
+
+        if (!DecodeHexTx(tx, strHexTx, true))
+            throw std::runtime_error("invalid transaction encoding");
+
+        startArg = 1;
+    } else
+        startArg = 0;
+
+    for (size_t i = startArg; i < args.size(); i++) {
+        const std::string& arg = args[i];
+        std::string key, value;
+        size_t eqpos = arg.find('=');
+        if (eqpos == std::string::npos)
+            key = arg;
+        else {
+            key = arg.substr(0, eqpos);
+            value = arg.substr(eqpos + 1);
+        }
+
+        MutateTx(tx, key, value);
+    }
+
+    return FormatTx(tx);
+}
+
 static int CommandLineRawTx(int argc, char* argv[])
 {
     std::string strPrint;
@@ -793,41 +851,7 @@ static int CommandLineRawTx(int argc, char* argv[])
             argv++;
         }
 
-        CMutableTransaction tx;
-        int startArg;
-
-        if (!fCreateBlank) {
-            // require at least one param
-            if (argc < 2)
-                throw std::runtime_error("too few parameters");
-
-            // param: hex-encoded nix transaction
-            std::string strHexTx(argv[1]);
-            if (strHexTx == "-")                 // "-" implies standard input
-                strHexTx = readStdin();
-
-            if (!DecodeHexTx(tx, strHexTx, true))
-                throw std::runtime_error("invalid transaction encoding");
-
-            startArg = 2;
-        } else
-            startArg = 1;
-
-        for (int i = startArg; i < argc; i++) {
-            std::string arg = argv[i];
-            std::string key, value;
-            size_t eqpos = arg.find('=');
-            if (eqpos == std::string::npos)
-                key = arg;
-            else {
-                key = arg.substr(0, eqpos);
-                value = arg.substr(eqpos + 1);
-            }
-
-            MutateTx(tx, key, value);
-        }
-
-        OutputTx(tx);
+        strPrint = ProcessRawTx(std::vector<std::string>(argv + 1, argv + argc));
     }
 
     catch (const boost::thread_interrupted&) {
@@ -848,6 +872,72 @@ static int CommandLineRawTx(int argc, char* argv[])
     return nRet;
 }
 
+//
+// Reads jobs from stdin in rounds of BATCH_JOBS_PER_ROUND lines, processes each round on a pool
+// of threads sharing one secp256k1 context, and writes the results in input order. A failed job
+// writes its "error: " line in its place, the exit code is EXIT_FAILURE if any job failed.
+//
+static int BatchRawTx()
+{
+    int nThreads = gArgs.GetArg("-batchthreads", GetNumCores());
+    nThreads = std::max(1, std::min(nThreads, MAX_BATCH_THREADS));
+
+    Secp256k1Init ecc;
+
+    int nRet = 0;
+    bool fEOF = false;
+    while (!fEOF) {
+        std::vector<std::vector<std::string>> vJobs;
+        char buf[4096];
+        std::string line;
+        while (vJobs.size() < BATCH_JOBS_PER_ROUND) {
+            if (!fgets(buf, sizeof(buf), stdin)) {
+                fEOF = true;
+                break;
+            }
+            line.append(buf);
+            if (line.back() != '\n' && !feof(stdin))
+                continue; // longer than the buffer
+            boost::algorithm::trim(line);
+            if (!line.empty()) {
+                vJobs.emplace_back();
+                boost::algorithm::split(vJobs.back(), line, boost::algorithm::is_space(), boost::algorithm::token_compress_on);
+            }
+            line.clear();
+        }
+        if (ferror(stdin))
+            throw std::runtime_error("error reading stdin");
+
+        std::vector<std::string> vResults(vJobs.size());
+        std::vector<char> vFailed(vJobs.size(), 0);
+        std::atomic<size_t> nNext(0);
+        auto worker = [&]() {
+            for (size_t i = nNext++; i < vJobs.size(); i = nNext++) {
+                try {
+                    vResults[i] = ProcessRawTx(vJobs[i]);
+                } catch (const std::exception& e) {
+                    vResults[i] = std::string("error: ") + e.what();
+                    vFailed[i] = 1;
+                }
+            }
+        };
+        std::vector<std::thread> vThreads;
+        for (int i = 1; i < nThreads && (size_t)i < vJobs.size(); i++)
+            vThreads.emplace_back(worker);
+        worker();
+        for (std::thread& thread : vThreads)
+            thread.join();
+
+        for (size_t i = 0; i < vResults.size(); i++) {
+            fprintf(stdout, "%s\n", vResults[i].c_str());
+            if (vFailed[i])
+                nRet = EXIT_FAILURE;
+        }
+        fflush(stdout);
+    }
+    return nRet;
+}
+
 int main(int argc, char* argv[])
 {
     SetupEnvironment();
@@ -867,7 +957,7 @@ int main(int argc, char* argv[])
 
     int ret = EXIT_FAILURE;
     try {
-        ret = CommandLineRawTx(argc, argv);
+        ret = fBatch ? BatchRawTx() : CommandLineRawTx(argc, argv);
     }
     catch (const std::exception& e) {
         PrintExceptionContinue(&e, "CommandLineRawTx()");
@@ -12,6 +12,8 @@
 #include <txmempool.h>
 #include <util.h>
 
+#include <cmath>
+
 static constexpr double INF_FEERATE = 1e99;
 
 std::string StringForFeeEstimateHorizon(FeeEstimateHorizon horizon) {
@@ -140,8 +142,8 @@ public:
                   unsigned int bucketIndex, bool inBlock);
 
     /** Update our estimates by decaying our historical moving average and updating
-        with the data gathered from the current block */
-    void UpdateMovingAverages();
+        with the data gathered from the current block, nBlocks blocks' worth of decay at once */
+    void UpdateMovingAverages(unsigned int nBlocks = 1);
 
     /**
      * Calculate a feerate estimate.  Find the lowest value bucket (or range of buckets
@@ -166,12 +168,62 @@ public:
 
     /**
      * Read saved state of estimation data from a file and replace all internal data structures and
-     * variables with this state.
+     * variables with this state. fCompact is set for files with the averages in fixed-point form.
      */
-    void Read(CAutoFile& filein, int nFileVersion, size_t numBuckets);
+    void Read(CAutoFile& filein, bool fCompact, size_t numBuckets);
 };
 
 
+/** Version required to read fee estimate files with the averages in fixed-point form */
+static const int FEE_ESTIMATES_COMPACT_VERSION = 1000200;
+
+/** Fractional bits of the fixed-point averages. Decayed counts below 2^-16 are noise anyway */
+static const int FIXED_POINT_BITS = 16;
+
+/** Largest vector of averages in a file: there are at most 1000 buckets and 1008 periods */
+static const uint64_t MAX_FIXED_POINT_VECTOR = 1008;
+
+// The averages are non-negative and mostly small or zero, stored as VARINTs of fixed-point
+// values they take 1 to 6 bytes instead of 8
+static void WriteFixedPoint(CAutoFile& fileout, const std::vector<double>& v)
+{
+    WriteCompactSize(fileout, v.size());
+    for (double d : v) {
+        uint64_t n = d > 0 ? (uint64_t)std::llround(std::ldexp(d, FIXED_POINT_BITS)) : 0;
+        fileout << VARINT(n);
+    }
+}
+
+static void WriteFixedPoint(CAutoFile& fileout, const std::vector<std::vector<double>>& v)
+{
+    WriteCompactSize(fileout, v.size());
+    for (const std::vector<double>& w : v)
+        WriteFixedPoint(fileout, w);
+}
+
+static void ReadFixedPoint(CAutoFile& filein, std::vector<double>& v)
+{
+    uint64_t nSize = ReadCompactSize(filein);
+    if (nSize > MAX_FIXED_POINT_VECTOR)
+        throw std::runtime_error("Corrupt estimates file. Too many averages");
+    v.resize(nSize);
+    for (double& d : v) {
+        uint64_t n;
+        filein >> VARINT(n);
+        d = std::ldexp((double)n, -FIXED_POINT_BITS);
+    }
+}
+
+static void ReadFixedPoint(CAutoFile& filein, std::vector<std::vector<double>>& v)
+{
+    uint64_t nSize = ReadCompactSize(filein);
+    if (nSize > MAX_FIXED_POINT_VECTOR)
+        throw std::runtime_error("Corrupt estimates file. Too many averages");
+    v.resize(nSize);
+    for (std::vector<double>& w : v)
+        ReadFixedPoint(filein, w);
+}
+
 TxConfirmStats::TxConfirmStats(const std::vector<double>& defaultBuckets,
                                 const std::map<double, unsigned int>& defaultBucketMap,
                                unsigned int maxPeriods, double _decay, unsigned int _scale)
@@ -228,15 +280,16 @@ void TxConfirmStats::Record(int blocksToConfirm, double val)
     avg[bucketindex] += val;
 }
 
-void TxConfirmStats::UpdateMovingAverages()
+void TxConfirmStats::UpdateMovingAverages(unsigned int nBlocks)
 {
+    const double factor = nBlocks == 1 ? decay : std::pow(decay, nBlocks);
     for (unsigned int j = 0; j < buckets.size(); j++) {
         for (unsigned int i = 0; i < confAvg.size(); i++)
-            confAvg[i][j] = confAvg[i][j] * decay;
+            confAvg[i][j] = confAvg[i][j] * factor;
         for (unsigned int i = 0; i < failAvg.size(); i++)
-            failAvg[i][j] = failAvg[i][j] * decay;
-        avg[j] = avg[j] * decay;
-        txCtAvg[j] = txCtAvg[j] * decay;
+            failAvg[i][j] = failAvg[i][j] * factor;
+        avg[j] = avg[j] * factor;
+        txCtAvg[j] = txCtAvg[j] * factor;
     }
 }
 
@@ -397,13 +450,13 @@ void TxConfirmStats::Write(CAutoFile& fileout) const
 {
     fileout << decay;
     fileout << scale;
-    fileout << avg;
-    fileout << txCtAvg;
-    fileout << confAvg;
-    fileout << failAvg;
+    WriteFixedPoint(fileout, avg);
+    WriteFixedPoint(fileout, txCtAvg);
+    WriteFixedPoint(fileout, confAvg);
+    WriteFixedPoint(fileout, failAvg);
 }
 
-void TxConfirmStats::Read(CAutoFile& filein, int nFileVersion, size_t numBuckets)
+void TxConfirmStats::Read(CAutoFile& filein, bool fCompact, size_t numBuckets)
 {
     // Read data file and do some very basic sanity checking
     // buckets and bucketMap are not updated yet, so don't access them
@@ -420,15 +473,24 @@ void TxConfirmStats::Read(CAutoFile& filein, int nFileVersion, size_t numBuckets
         throw std::runtime_error("Corrupt estimates file. Scale must be non-zero");
     }
 
-    filein >> avg;
+    if (fCompact)
+        ReadFixedPoint(filein, avg);
+    else
+        filein >> avg;
     if (avg.size() != numBuckets) {
         throw std::runtime_error("Corrupt estimates file. Mismatch in feerate average bucket count");
     }
-    filein >> txCtAvg;
+    if (fCompact)
+        ReadFixedPoint(filein, txCtAvg);
+    else
+        filein >> txCtAvg;
     if (txCtAvg.size() != numBuckets) {
         throw std::runtime_error("Corrupt estimates file. Mismatch in tx count bucket count");
     }
-    filein >> confAvg;
+    if (fCompact)
+        ReadFixedPoint(filein, confAvg);
+    else
+        filein >> confAvg;
     maxPeriods = confAvg.size();
     maxConfirms = scale * maxPeriods;
 
@@ -441,7 +503,10 @@ void TxConfirmStats::Read(CAutoFile& filein, int nFileVersion, size_t numBuckets
         }
     }
 
-    filein >> failAvg;
+    if (fCompact)
+        ReadFixedPoint(filein, failAvg);
+    else
+        filein >> failAvg;
     if (maxPeriods != failAvg.size()) {
         throw std::runtime_error("Corrupt estimates file. Mismatch in confirms tracked for failures");
     }
@@ -525,7 +590,7 @@ bool CBlockPolicyEstimator::removeTx(uint256 hash, bool inBlock)
 }
 
 CBlockPolicyEstimator::CBlockPolicyEstimator()
-    : nBestSeenHeight(0), firstRecordedHeight(0), historicalFirst(0), historicalBest(0), trackedTxs(0), untrackedTxs(0)
+    : nBestSeenHeight(0), firstRecordedHeight(0), historicalFirst(0), historicalBest(0), nBlocksSkipped(0), trackedTxs(0), untrackedTxs(0)
 {
     static_assert(MIN_BUCKET_FEERATE > 0, "Min feerate must be nonzero");
     size_t bucketIndex = 0;
@@ -567,7 +632,9 @@ void CBlockPolicyEstimator::processTransaction(const CTxMemPoolEntry& entry, boo
 
     // Only want to be updating estimates when our blockchain is synced,
     // otherwise we'll miscalculate how many blocks its taking to get included.
-    if (!validFeeEstimate) {
+    // Zerocoin spends pay no fee and are mined by spend slot rather than by fee
+    // rate, counted in the lowest bucket they'd only skew the estimates there.
+    if (!validFeeEstimate || entry.GetTx().IsZerocoinSpend()) {
         untrackedTxs++;
         return;
     }
@@ -585,6 +652,21 @@ void CBlockPolicyEstimator::processTransaction(const CTxMemPoolEntry& entry, boo
     assert(bucketIndex == bucketIndex3);
 }
 
+void CBlockPolicyEstimator::skipBlock(unsigned int nBlockHeight)
+{
+    LOCK(cs_feeEstimator);
+    if (nBlockHeight <= nBestSeenHeight)
+        return;
+
+    // Nothing is tracked while the chain is catching up, so only the unconfirmed circular buffer has
+    // to keep up with the height
+    nBestSeenHeight = nBlockHeight;
+    feeStats->ClearCurrent(nBlockHeight);
+    shortStats->ClearCurrent(nBlockHeight);
+    longStats->ClearCurrent(nBlockHeight);
+    nBlocksSkipped++;
+}
+
 bool CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxMemPoolEntry* entry)
 {
     if (!removeTx(entry->GetTx().GetHash(), true)) {
@@ -635,10 +717,11 @@ void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
     shortStats->ClearCurrent(nBlockHeight);
     longStats->ClearCurrent(nBlockHeight);
 
-    // Decay all exponential averages
-    feeStats->UpdateMovingAverages();
-    shortStats->UpdateMovingAverages();
-    longStats->UpdateMovingAverages();
+    // Decay all exponential averages, for the blocks skipped since the last one too
+    feeStats->UpdateMovingAverages(1 + nBlocksSkipped);
+    shortStats->UpdateMovingAverages(1 + nBlocksSkipped);
+    longStats->UpdateMovingAverages(1 + nBlocksSkipped);
+    nBlocksSkipped = 0;
 
     unsigned int countedTxs = 0;
     // Update averages with data points from current block
@@ -900,7 +983,7 @@ bool CBlockPolicyEstimator::Write(CAutoFile& fileout) const
 {
     try {
         LOCK(cs_feeEstimator);
-        fileout << 149900; // version required to read: 0.14.99 or later
+        fileout << FEE_ESTIMATES_COMPACT_VERSION; // version required to read: averages in fixed-point form
         fileout << CLIENT_VERSION; // version that wrote the file
         fileout << nBestSeenHeight;
         if (BlockSpan() > HistoricalBlockSpan()/2) {
@@ -952,9 +1035,10 @@ bool CBlockPolicyEstimator::Read(CAutoFile& filein)
             std::unique_ptr<TxConfirmStats> fileFeeStats(new TxConfirmStats(buckets, bucketMap, MED_BLOCK_PERIODS, MED_DECAY, MED_SCALE));
             std::unique_ptr<TxConfirmStats> fileShortStats(new TxConfirmStats(buckets, bucketMap, SHORT_BLOCK_PERIODS, SHORT_DECAY, SHORT_SCALE));
             std::unique_ptr<TxConfirmStats> fileLongStats(new TxConfirmStats(buckets, bucketMap, LONG_BLOCK_PERIODS, LONG_DECAY, LONG_SCALE));
-            fileFeeStats->Read(filein, nVersionThatWrote, numBuckets);
-            fileShortStats->Read(filein, nVersionThatWrote, numBuckets);
-            fileLongStats->Read(filein, nVersionThatWrote, numBuckets);
+            const bool fCompact = nVersionRequired >= FEE_ESTIMATES_COMPACT_VERSION;
+            fileFeeStats->Read(filein, fCompact, numBuckets);
+            fileShortStats->Read(filein, fCompact, numBuckets);
+            fileLongStats->Read(filein, fCompact, numBuckets);
 
             // Fee estimates file parsed correctly
             // Copy buckets from file and refresh our bucketmap
@@ -972,6 +1056,7 @@ bool CBlockPolicyEstimator::Read(CAutoFile& filein)
             nBestSeenHeight = nFileBestSeenHeight;
             historicalFirst = nFileHistoricalFirst;
             historicalBest = nFileHistoricalBest;
+            nBlocksSkipped = 0;
         }
     }
     catch (const std::exception& e) {
@@ -194,6 +194,10 @@ public:
     void processBlock(unsigned int nBlockHeight,
                       std::vector<const CTxMemPoolEntry*>& entries);
 
+    /** Account for a block connected while the estimates are not being updated, during initial block
+     *  download. Only the height is recorded, the decay it owes is applied by the next processBlock */
+    void skipBlock(unsigned int nBlockHeight);
+
     /** Process a transaction accepted to the mempool*/
     void processTransaction(const CTxMemPoolEntry& entry, bool validFeeEstimate);
 
@@ -233,6 +237,8 @@ private:
     unsigned int firstRecordedHeight;
     unsigned int historicalFirst;
     unsigned int historicalBest;
+    // Blocks skipped since the last processBlock, whose decay is still to be applied
+    unsigned int nBlocksSkipped;
 
     struct TxStatsInfo
     {
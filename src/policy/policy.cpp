@@ -98,7 +98,9 @@ bool IsStandardTx(const CTransaction& tx, std::string& reason, const bool witnes
 
     for (const CTxIn& txin : tx.vin)
     {
-        //TODO: possible increase of zerocoin spend script size for scaling(reduce proof size and increase limit)
+        // A zerocoin spend carries its CoinSpend proof in the scriptSig, about 25 KB with the default security level,
+        // so it is exempt from the size limit of other inputs. The proof size is fixed by the spend version; a
+        // smaller proof needs a new spend version and proof system, activated by the chain, not a policy change
         if (txin.scriptSig.IsZerocoinSpend() && txin.scriptSig.size() > MAX_STANDARD_TX_WEIGHT) {
             reason = "scriptsig-size";
             return false;
@@ -7,8 +7,15 @@
 
 #include <arith_uint256.h>
 #include <chain.h>
+#include <crypto/sha256.h>
+#include <cuckoocache.h>
 #include <primitives/block.h>
+#include <random.h>
+#include <script/sigcache.h>
 #include <uint256.h>
+#include <util.h>
+
+#include <boost/thread/shared_mutex.hpp>
 
 /*Forward declarations*/
 /*********************/
@@ -41,6 +48,78 @@ bool CheckProofOfWork(uint256 hash, unsigned int nBits, const Consensus::Params&
     return true;
 }
 
+namespace {
+/**
+ * Cache of block headers whose proof of work is valid, to avoid computing the Lyra2REv2 hash of a header
+ * again when it is checked as part of the full block or when the block is read back from disk
+ */
+class CPoWCache
+{
+private:
+    //! Entries are SHA256(nonce || block hash)
+    uint256 nonce;
+    typedef CuckooCache::cache<uint256, SignatureCacheHasher> map_type;
+    map_type setValid;
+    boost::shared_mutex cs_powcache;
+
+public:
+    CPoWCache()
+    {
+        GetRandBytes(nonce.begin(), 32);
+        setValid.setup_bytes(DEFAULT_MAX_POW_CACHE_SIZE << 20);
+    }
+
+    void
+    ComputeEntry(uint256& entry, const uint256 &blockHash)
+    {
+        CSHA256().Write(nonce.begin(), 32).Write(blockHash.begin(), 32).Finalize(entry.begin());
+    }
+
+    bool
+    Get(const uint256& entry)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_powcache);
+        return setValid.contains(entry, false);
+    }
+
+    void Set(uint256& entry)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_powcache);
+        setValid.insert(entry);
+    }
+    uint32_t setup_bytes(size_t n)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_powcache);
+        return setValid.setup_bytes(n);
+    }
+};
+
+static CPoWCache powCache;
+} // namespace
+
+void InitPoWCache()
+{
+    size_t nMaxCacheSize = std::min(std::max((int64_t)0, gArgs.GetArg("-maxpowcachesize", DEFAULT_MAX_POW_CACHE_SIZE)), MAX_MAX_POW_CACHE_SIZE) * ((size_t) 1 << 20);
+    size_t nElems = powCache.setup_bytes(nMaxCacheSize);
+    LogPrintf("Using %zu MiB out of %zu requested for proof-of-work cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, nElems);
+}
+
+bool CheckBlockHeaderProofOfWork(const CBlockHeader& block, int nHeight, const Consensus::Params& params)
+{
+    // The block hash commits to nBits, so a header that passed once always passes
+    uint256 entry;
+    powCache.ComputeEntry(entry, block.GetHash());
+    if (powCache.Get(entry))
+        return true;
+
+    if (!CheckProofOfWork(block.GetPoWHash(nHeight), block.nBits, params))
+        return false;
+
+    powCache.Set(entry);
+    return true;
+}
+
 unsigned int static DarkGravityWave(const CBlockIndex* pindexLast, const Consensus::Params& params) {
 
     const arith_uint256 bnPowLimit = UintToArith256(params.powLimit);
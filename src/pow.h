@@ -9,6 +9,7 @@
 #include <consensus/params.h>
 
 #include <stdint.h>
+#include <utility>
 
 class CBlockHeader;
 class CBlockIndex;
@@ -18,4 +19,43 @@ unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHead
 /** Check whether a block hash satisfies the proof-of-work requirement specified by nBits */
 bool CheckProofOfWork(uint256 hash, unsigned int nBits, const Consensus::Params&);
 
+/** Default for -maxpowcachesize, in MiB */
+static const int64_t DEFAULT_MAX_POW_CACHE_SIZE = 8;
+/** Maximum proof-of-work cache size allowed, in MiB */
+static const int64_t MAX_MAX_POW_CACHE_SIZE = 1024;
+
+/**
+ * Check the Lyra2REv2 proof of work of a block header. Headers that pass are remembered by their
+ * hash, so a header is only run through Lyra2REv2 once however many times it is checked or re-read
+ */
+bool CheckBlockHeaderProofOfWork(const CBlockHeader& block, int nHeight, const Consensus::Params&);
+void InitPoWCache();
+
+/**
+ * Closure representing the proof-of-work check of one header of a HEADERS message.
+ * Note that this stores a reference to the header
+ */
+class CPoWCheck
+{
+private:
+    const CBlockHeader *header;
+    int nHeight;
+    const Consensus::Params *params;
+
+public:
+    CPoWCheck(): header(nullptr), nHeight(0), params(nullptr) {}
+    CPoWCheck(const CBlockHeader *headerIn, int nHeightIn, const Consensus::Params *paramsIn) :
+        header(headerIn), nHeight(nHeightIn), params(paramsIn) {}
+
+    bool operator()() {
+        return CheckBlockHeaderProofOfWork(*header, nHeight, *params);
+    }
+
+    void swap(CPoWCheck &check) {
+        std::swap(header, check.header);
+        std::swap(nHeight, check.nHeight);
+        std::swap(params, check.params);
+    }
+};
+
 #endif // BITCOIN_POW_H
@@ -10,6 +10,8 @@
 #include <stdint.h>
 #include <string.h>
 
+#include <algorithm>
+#include <atomic>
 #include <iterator>
 #include <type_traits>
 
@@ -31,6 +33,12 @@
  *
  *  The data type T must be movable by memmove/realloc(). Once we switch to C++,
  *  move constructors can be used instead.
+ *
+ *  For scalar types T the indirect array is shared between copies: it is
+ *  preceded by a reference count, copying only takes a reference, and the
+ *  array is copied by the first non-const access to a prevector that shares
+ *  it. Non-const iterators and pointers obtained before the prevector is
+ *  copied must not be written through after.
  */
 template<unsigned int N, typename T, typename Size = uint32_t, typename Diff = int32_t>
 class prevector {
@@ -154,33 +162,89 @@ private:
         };
     } _union;
 
+    //! Whether copies share the indirect array
+    static constexpr bool SHARED = std::is_scalar<T>::value;
+    //! Bytes before the indirect array holding its reference count, keeps the array aligned
+    static constexpr size_t HEADER_SIZE = SHARED ? 16 : 0;
+
     T* direct_ptr(difference_type pos) { return reinterpret_cast<T*>(_union.direct) + pos; }
     const T* direct_ptr(difference_type pos) const { return reinterpret_cast<const T*>(_union.direct) + pos; }
     T* indirect_ptr(difference_type pos) { return reinterpret_cast<T*>(_union.indirect) + pos; }
     const T* indirect_ptr(difference_type pos) const { return reinterpret_cast<const T*>(_union.indirect) + pos; }
     bool is_direct() const { return _size <= N; }
 
+    /* FIXME: Because malloc/realloc here won't call new_handler if allocation fails, assert
+        success. These should instead use an allocator or new/delete so that handlers
+        are called as necessary, but performance would be slightly degraded by doing so. */
+    static char* allocate_indirect(size_type capacity) {
+        char* p = static_cast<char*>(malloc(HEADER_SIZE + ((size_t)sizeof(T)) * capacity));
+        assert(p);
+        if (SHARED) {
+            new(static_cast<void*>(p)) std::atomic<uint32_t>(1);
+        }
+        return p + HEADER_SIZE;
+    }
+
+    static std::atomic<uint32_t>& indirect_refs(char* indirect) {
+        return *reinterpret_cast<std::atomic<uint32_t>*>(indirect - HEADER_SIZE);
+    }
+
+    static void release_indirect(char* indirect) {
+        if (!SHARED || indirect_refs(indirect).fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            free(indirect - HEADER_SIZE);
+        }
+    }
+
+    bool is_shared() const {
+        return SHARED && !is_direct() && indirect_refs(_union.indirect).load(std::memory_order_acquire) != 1;
+    }
+
+    /** Give this prevector its own copy of a shared indirect array, before writing to it. */
+    void unshare() {
+        if (is_shared()) {
+            char* new_indirect = allocate_indirect(_union.capacity);
+            memcpy(new_indirect, _union.indirect, size() * sizeof(T));
+            release_indirect(_union.indirect);
+            _union.indirect = new_indirect;
+        }
+    }
+
+    /** Take a reference to the indirect array of other, in place of the contents of this prevector. */
+    void share(const prevector<N, T, Size, Diff>& other) {
+        indirect_refs(other._union.indirect).fetch_add(1, std::memory_order_relaxed);
+        if (!is_direct()) {
+            release_indirect(_union.indirect);
+        }
+        _size = other._size;
+        _union.capacity = other._union.capacity;
+        _union.indirect = other._union.indirect;
+    }
+
     void change_capacity(size_type new_capacity) {
         if (new_capacity <= N) {
             if (!is_direct()) {
-                T* indirect = indirect_ptr(0);
-                T* src = indirect;
+                char* indirect = _union.indirect;
+                T* src = reinterpret_cast<T*>(indirect);
                 T* dst = direct_ptr(0);
                 memcpy(dst, src, size() * sizeof(T));
-                free(indirect);
+                release_indirect(indirect);
                 _size -= N + 1;
             }
         } else {
             if (!is_direct()) {
-                /* FIXME: Because malloc/realloc here won't call new_handler if allocation fails, assert
-                    success. These should instead use an allocator or new/delete so that handlers
-                    are called as necessary, but performance would be slightly degraded by doing so. */
-                _union.indirect = static_cast<char*>(realloc(_union.indirect, ((size_t)sizeof(T)) * new_capacity));
-                assert(_union.indirect);
+                if (is_shared()) {
+                    char* new_indirect = allocate_indirect(new_capacity);
+                    memcpy(new_indirect, _union.indirect, std::min<size_t>(size(), new_capacity) * sizeof(T));
+                    release_indirect(_union.indirect);
+                    _union.indirect = new_indirect;
+                } else {
+                    char* p = static_cast<char*>(realloc(_union.indirect - HEADER_SIZE, HEADER_SIZE + ((size_t)sizeof(T)) * new_capacity));
+                    assert(p);
+                    _union.indirect = p + HEADER_SIZE;
+                }
                 _union.capacity = new_capacity;
             } else {
-                char* new_indirect = static_cast<char*>(malloc(((size_t)sizeof(T)) * new_capacity));
-                assert(new_indirect);
+                char* new_indirect = allocate_indirect(new_capacity);
                 T* src = direct_ptr(0);
                 T* dst = reinterpret_cast<T*>(new_indirect);
                 memcpy(dst, src, size() * sizeof(T));
@@ -191,7 +255,13 @@ private:
         }
     }
 
-    T* item_ptr(difference_type pos) { return is_direct() ? direct_ptr(pos) : indirect_ptr(pos); }
+    T* item_ptr(difference_type pos) {
+        if (is_direct()) {
+            return direct_ptr(pos);
+        }
+        unshare();
+        return indirect_ptr(pos);
+    }
     const T* item_ptr(difference_type pos) const { return is_direct() ? direct_ptr(pos) : indirect_ptr(pos); }
 
 public:
@@ -246,6 +316,10 @@ public:
     }
 
     prevector(const prevector<N, T, Size, Diff>& other) : _size(0) {
+        if (SHARED && !other.is_direct()) {
+            share(other);
+            return;
+        }
         change_capacity(other.size());
         const_iterator it = other.begin();
         while (it != other.end()) {
@@ -263,7 +337,11 @@ public:
         if (&other == this) {
             return *this;
         }
-        resize(0);
+        if (SHARED && !other.is_direct()) {
+            share(other);
+            return *this;
+        }
+        clear();
         change_capacity(other.size());
         const_iterator it = other.begin();
         while (it != other.end()) {
@@ -337,6 +415,12 @@ public:
     }
 
     void clear() {
+        if (is_shared()) {
+            // Drop the reference rather than copying what is about to be erased
+            release_indirect(_union.indirect);
+            _size = 0;
+            return;
+        }
         resize(0);
     }
 
@@ -447,7 +531,7 @@ public:
             clear();
         }
         if (!is_direct()) {
-            free(_union.indirect);
+            release_indirect(_union.indirect);
             _union.indirect = nullptr;
         }
     }
@@ -500,7 +584,7 @@ public:
         if (is_direct()) {
             return 0;
         } else {
-            return ((size_t)(sizeof(T))) * _union.capacity;
+            return HEADER_SIZE + ((size_t)(sizeof(T))) * _union.capacity;
         }
     }
 
@@ -6,6 +6,7 @@
 #include <primitives/transaction.h>
 
 #include <hash.h>
+#include <streams.h>
 #include <tinyformat.h>
 #include <utilstrencodings.h>
 
@@ -96,6 +97,29 @@ uint256 CTransaction::ComputeHash() const
     return SerializeHash(*this, SER_GETHASH, SERIALIZE_TRANSACTION_NO_WITNESS);
 }
 
+uint256 CTransaction::ComputeZerocoinMetadataHash() const
+{
+    bool fZerocoinSpend = false;
+    for (const CTxIn& txin : vin)
+        fZerocoinSpend |= txin.scriptSig.IsZerocoinSpend();
+    if (!fZerocoinSpend)
+        return uint256();
+
+    // Same as serializing a copy without witness whose zerocoin spend inputs have been cleared
+    CHashWriter ss(SER_GETHASH, SERIALIZE_TRANSACTION_NO_WITNESS);
+    ss << nVersion;
+    WriteCompactSize(ss, vin.size());
+    for (const CTxIn& txin : vin) {
+        if (txin.scriptSig.IsZerocoinSpend())
+            ss << COutPoint() << CScript() << txin.nSequence;
+        else
+            ss << txin;
+    }
+    ss << vout;
+    ss << nLockTime;
+    return ss.GetHash();
+}
+
 uint256 CTransaction::GetWitnessHash() const
 {
     if (!HasWitness()) {
@@ -105,9 +129,12 @@ uint256 CTransaction::GetWitnessHash() const
 }
 
 /* For backward compatibility, the hash is initialized to 0. TODO: remove the need for this default constructor entirely. */
-CTransaction::CTransaction() : vin(), vout(), nVersion(CTransaction::CURRENT_VERSION), nLockTime(0), hash() {}
-CTransaction::CTransaction(const CMutableTransaction &tx) : vin(tx.vin), vout(tx.vout), nVersion(tx.nVersion), nLockTime(tx.nLockTime), hash(ComputeHash()) {}
-CTransaction::CTransaction(CMutableTransaction &&tx) : vin(std::move(tx.vin)), vout(std::move(tx.vout)), nVersion(tx.nVersion), nLockTime(tx.nLockTime), hash(ComputeHash()) {}
+CTransaction::CTransaction() : vin(), vout(), nVersion(CTransaction::CURRENT_VERSION), nLockTime(0), hash(), hashZerocoinMetadata(),
+    nBaseSize(::GetSerializeSize(*this, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS)), nTotalSize(nBaseSize) {}
+CTransaction::CTransaction(const CMutableTransaction &tx) : vin(tx.vin), vout(tx.vout), nVersion(tx.nVersion), nLockTime(tx.nLockTime), hash(ComputeHash()), hashZerocoinMetadata(ComputeZerocoinMetadataHash()),
+    nBaseSize(::GetSerializeSize(*this, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS)), nTotalSize(::GetSerializeSize(*this, SER_NETWORK, PROTOCOL_VERSION)) {}
+CTransaction::CTransaction(CMutableTransaction &&tx) : vin(std::move(tx.vin)), vout(std::move(tx.vout)), nVersion(tx.nVersion), nLockTime(tx.nLockTime), hash(ComputeHash()), hashZerocoinMetadata(ComputeZerocoinMetadataHash()),
+    nBaseSize(::GetSerializeSize(*this, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS)), nTotalSize(::GetSerializeSize(*this, SER_NETWORK, PROTOCOL_VERSION)) {}
 
 CAmount CTransaction::GetValueOut() const
 {
@@ -120,9 +147,20 @@ CAmount CTransaction::GetValueOut() const
     return nValueOut;
 }
 
-unsigned int CTransaction::GetTotalSize() const
+std::shared_ptr<const std::vector<unsigned char>> CTransaction::GetSerialized() const
 {
-    return ::GetSerializeSize(*this, SER_NETWORK, PROTOCOL_VERSION);
+    if (nTotalSize < MIN_KEEP_SERIALIZED_TX_SIZE)
+        return nullptr;
+    std::shared_ptr<const std::vector<unsigned char>> ret = std::atomic_load(&serialized);
+    if (!ret) {
+        // Two threads may both serialize it, they make the same bytes
+        std::shared_ptr<std::vector<unsigned char>> data = std::make_shared<std::vector<unsigned char>>();
+        data->reserve(nTotalSize);
+        CVectorWriter(SER_NETWORK, PROTOCOL_VERSION, *data, 0, *this);
+        ret = data;
+        std::atomic_store(&serialized, ret);
+    }
+    return ret;
 }
 
 std::string CTransaction::ToString() const
@@ -12,7 +12,11 @@
 #include <serialize.h>
 #include <uint256.h>
 
+#include <memory>
+
 static const int SERIALIZE_TRANSACTION_NO_WITNESS = 0x40000000;
+//! Transactions at least this big keep their serialization once it's been made, for serving them again
+static const unsigned int MIN_KEEP_SERIALIZED_TX_SIZE = 10000;
 static const int32_t NIX_TXN_VERSION = 2;
 
 enum OutputTypes
@@ -328,8 +332,14 @@ public:
 private:
     /** Memory only. */
     const uint256 hash;
+    const uint256 hashZerocoinMetadata;
+    const unsigned int nBaseSize;
+    const unsigned int nTotalSize;
+    //! Serialization with witness, of a big transaction once it's been asked for. Accessed atomically
+    mutable std::shared_ptr<const std::vector<unsigned char>> serialized;
 
     uint256 ComputeHash() const;
+    uint256 ComputeZerocoinMetadataHash() const;
 
 public:
     /** Construct a CTransaction that qualifies as IsNull() */
@@ -357,6 +367,14 @@ public:
         return hash;
     }
 
+    /**
+     * Hash of the transaction with the scriptSig and prevout of its zerocoin spend inputs cleared,
+     * which the spend proofs commit to. Null if the transaction has no zerocoin spend input.
+     */
+    const uint256& GetZerocoinMetadataHash() const {
+        return hashZerocoinMetadata;
+    }
+
     // Compute a hash that includes both transaction and witness data
     uint256 GetWitnessHash() const;
 
@@ -370,7 +388,16 @@ public:
      * "Total Size" defined in BIP141 and BIP144.
      * @return Total transaction size in bytes
      */
-    unsigned int GetTotalSize() const;
+    unsigned int GetTotalSize() const { return nTotalSize; }
+
+    /** Get the transaction size in bytes without witness data, "Base Size" in BIP141. */
+    unsigned int GetBaseSize() const { return nBaseSize; }
+
+    /**
+     * The serialization with witness data of a transaction of MIN_KEEP_SERIALIZED_TX_SIZE bytes or more,
+     * made the first time it is asked for and kept with the transaction. Null for smaller transactions.
+     */
+    std::shared_ptr<const std::vector<unsigned char>> GetSerialized() const;
 
     bool IsCoinBase() const
     {
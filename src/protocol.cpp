@@ -39,11 +39,19 @@ const char *SENDCMPCT="sendcmpct";
 const char *CMPCTBLOCK="cmpctblock";
 const char *GETBLOCKTXN="getblocktxn";
 const char *BLOCKTXN="blocktxn";
+const char *PKGTXS="pkgtxs";
+const char *GETCFILTERS="getcfilters";
+const char *CFILTER="cfilter";
+const char *GETCFHEADERS="getcfheaders";
+const char *CFHEADERS="cfheaders";
+const char *GETCFCHECKPT="getcfcheckpt";
+const char *CFCHECKPT="cfcheckpt";
 //Ghostnode
 const char *TXLOCKVOTE="txlvote";
 const char *SPORK = "spork";
 const char *GETSPORKS = "getsporks";
 const char *GHOSTNODEPAYMENTVOTE = "mnw";
+const char *GHOSTNODEPAYMENTVOTES = "mnwv";
 const char *GHOSTNODEPAYMENTBLOCK = "mnwb";
 const char *GHOSTNODEPAYMENTSYNC = "mnget";
 const char *MNANNOUNCE = "mnb";
@@ -110,9 +118,17 @@ const static std::string allNetMessageTypes[] = {
     NetMsgType::CMPCTBLOCK,
     NetMsgType::GETBLOCKTXN,
     NetMsgType::BLOCKTXN,
+    NetMsgType::PKGTXS,
+    NetMsgType::GETCFILTERS,
+    NetMsgType::CFILTER,
+    NetMsgType::GETCFHEADERS,
+    NetMsgType::CFHEADERS,
+    NetMsgType::GETCFCHECKPT,
+    NetMsgType::CFCHECKPT,
     //Ghostnode
     NetMsgType::TXLOCKREQUEST,
     NetMsgType::GHOSTNODEPAYMENTVOTE,
+    NetMsgType::GHOSTNODEPAYMENTVOTES,
     NetMsgType::GHOSTNODEPAYMENTBLOCK,
     NetMsgType::GHOSTNODEPAYMENTSYNC,
     NetMsgType::SPORK,
@@ -285,6 +285,37 @@ bool CPubKey::Derive(CPubKey& pubkeyChild, unsigned char ccChild[32], unsigned i
     pubkeyChild.Set(pub, pub + publen);
     return true;
 }
+void CPubKey::DeriveIds(CKeyID* pIds, unsigned int nChild, size_t n, const unsigned char cc[32]) const
+{
+    assert(IsValid());
+    assert(((nChild + n - 1) >> 31) == 0);
+    assert(begin() + 33 == end());
+    std::vector<unsigned char> vOut(64 * n);
+    BIP32HashMulti(cc, nChild, n, *begin(), begin()+1, vOut.data());
+    secp256k1_pubkey parent;
+    bool fParsed = secp256k1_ec_pubkey_parse(secp256k1_context_verify, &parent, &(*this)[0], size());
+    std::vector<unsigned char> vPub(33 * n);
+    std::vector<bool> vValid(n, false);
+    for (size_t i = 0; fParsed && i < n; i++) {
+        secp256k1_pubkey pubkey = parent;
+        if (!secp256k1_ec_pubkey_tweak_add(secp256k1_context_verify, &pubkey, &vOut[64 * i])) {
+            continue;
+        }
+        size_t publen = 33;
+        secp256k1_ec_pubkey_serialize(secp256k1_context_verify, &vPub[33 * i], &publen, &pubkey, SECP256K1_EC_COMPRESSED);
+        vValid[i] = true;
+    }
+    std::vector<unsigned char> vIds(20 * n);
+    Hash160Multi(vPub.data(), 33, n, vIds.data());
+    for (size_t i = 0; i < n; i++) {
+        if (vValid[i]) {
+            memcpy(pIds[i].begin(), &vIds[20 * i], 20);
+        } else {
+            pIds[i].SetNull();
+        }
+    }
+}
+
 /*
 void CExtPubKey::Encode(unsigned char code[BIP32_EXTKEY_SIZE]) const {
     code[0] = nDepth;
@@ -214,6 +214,9 @@ public:
     bool Derive(CPubKey& pubkeyChild, ChainCode &ccChild, unsigned int nChild, const ChainCode& cc) const;
 
     bool Derive(CPubKey& pubkeyChild, unsigned char ccChild[32], unsigned int nChild, const unsigned char cc[32]) const;
+
+    //! Key ids of the n BIP32 child pubkeys from nChild on, their hashes computed together. A child that can't be derived gets a null id.
+    void DeriveIds(CKeyID* pIds, unsigned int nChild, size_t n, const unsigned char cc[32]) const;
 };
 
 /** An encapsulated compressed public key. */
@@ -27,24 +27,32 @@
 
 class CBlockIndex;
 
-static int64_t nLastHeaderTipUpdateNotification = 0;
-static int64_t nLastBlockTipUpdateNotification = 0;
-
 ClientModel::ClientModel(OptionsModel *_optionsModel, QObject *parent) :
     QObject(parent),
     optionsModel(_optionsModel),
     peerTableModel(0),
     banTableModel(0),
-    pollTimer(0)
+    pollTimer(0),
+    pendingNumConnections(-1),
+    fPendingGhostnodeListChanged(false),
+    fDeliveryQueued(false),
+    deliveryTimer(0),
+    nLastDelivery(0)
 {
     cachedBestHeaderHeight = -1;
     cachedBestHeaderTime = -1;
+    pendingBlockTip.fPending = false;
+    pendingHeaderTip.fPending = false;
     peerTableModel = new PeerTableModel(this);
     banTableModel = new BanTableModel(this);
     pollTimer = new QTimer(this);
     connect(pollTimer, SIGNAL(timeout()), this, SLOT(updateTimer()));
     pollTimer->start(MODEL_UPDATE_DELAY);
 
+    deliveryTimer = new QTimer(this);
+    deliveryTimer->setSingleShot(true);
+    connect(deliveryTimer, SIGNAL(timeout()), this, SLOT(deliverNotifications()));
+
     subscribeToCoreSignals();
 }
 
@@ -159,6 +167,85 @@ void ClientModel::updateNumConnections(int numConnections)
     Q_EMIT numConnectionsChanged(numConnections);
 }
 
+void ClientModel::queueTipNotification(const CBlockIndex *pindex, bool fHeader)
+{
+    if (fHeader) {
+        // cache best headers time and height to reduce future cs_main locks
+        cachedBestHeaderHeight = pindex->nHeight;
+        cachedBestHeaderTime = pindex->GetBlockTime();
+    }
+    double verificationProgress = getVerificationProgress(pindex);
+
+    LOCK(cs_pending);
+    TipNotification& tip = fHeader ? pendingHeaderTip : pendingBlockTip;
+    tip.fPending = true;
+    tip.height = pindex->nHeight;
+    tip.blockDate = QDateTime::fromTime_t(pindex->GetBlockTime());
+    tip.verificationProgress = verificationProgress;
+    queueDelivery();
+}
+
+void ClientModel::queueNumConnectionsChanged(int numConnections)
+{
+    LOCK(cs_pending);
+    pendingNumConnections = numConnections;
+    queueDelivery();
+}
+
+void ClientModel::queueGhostnodeListChanged()
+{
+    LOCK(cs_pending);
+    fPendingGhostnodeListChanged = true;
+    queueDelivery();
+}
+
+void ClientModel::queueDelivery()
+{
+    AssertLockHeld(cs_pending);
+    if (fDeliveryQueued)
+        return;
+    fDeliveryQueued = true;
+    QMetaObject::invokeMethod(this, "deliverNotifications", Qt::QueuedConnection);
+}
+
+void ClientModel::deliverNotifications()
+{
+    // Keep merging until MODEL_UPDATE_DELAY has passed since the last delivery, so that
+    // a burst of notifications (initial sync, reorgs) costs the GUI a few updates a second
+    int64_t nWait = nLastDelivery + MODEL_UPDATE_DELAY - GetTimeMillis();
+    if (nWait > 0) {
+        if (!deliveryTimer->isActive())
+            deliveryTimer->start(nWait);
+        return;
+    }
+    nLastDelivery = GetTimeMillis();
+
+    TipNotification blockTip, headerTip;
+    int numConnections;
+    bool fGhostnodeListChanged;
+    {
+        LOCK(cs_pending);
+        blockTip = pendingBlockTip;
+        headerTip = pendingHeaderTip;
+        numConnections = pendingNumConnections;
+        fGhostnodeListChanged = fPendingGhostnodeListChanged;
+        pendingBlockTip.fPending = false;
+        pendingHeaderTip.fPending = false;
+        pendingNumConnections = -1;
+        fPendingGhostnodeListChanged = false;
+        fDeliveryQueued = false;
+    }
+
+    if (numConnections >= 0)
+        updateNumConnections(numConnections);
+    if (headerTip.fPending)
+        Q_EMIT numBlocksChanged(headerTip.height, headerTip.blockDate, headerTip.verificationProgress, true);
+    if (blockTip.fPending)
+        Q_EMIT numBlocksChanged(blockTip.height, blockTip.blockDate, blockTip.verificationProgress, false);
+    if (fGhostnodeListChanged)
+        Q_EMIT ghostnodeListChanged();
+}
+
 void ClientModel::updateNetworkActive(bool networkActive)
 {
     Q_EMIT networkActiveChanged(networkActive);
@@ -263,8 +350,7 @@ static void ShowProgress(ClientModel *clientmodel, const std::string &title, int
 static void NotifyNumConnectionsChanged(ClientModel *clientmodel, int newNumConnections)
 {
     // Too noisy: qDebug() << "NotifyNumConnectionsChanged: " + QString::number(newNumConnections);
-    QMetaObject::invokeMethod(clientmodel, "updateNumConnections", Qt::QueuedConnection,
-                              Q_ARG(int, newNumConnections));
+    clientmodel->queueNumConnectionsChanged(newNumConnections);
 }
 
 static void NotifyAdditionalDataSyncProgressChanged(ClientModel *clientmodel, int count, double nSyncProgress)
@@ -290,32 +376,17 @@ static void BannedListChanged(ClientModel *clientmodel)
     QMetaObject::invokeMethod(clientmodel, "updateBanlist", Qt::QueuedConnection);
 }
 
-static void BlockTipChanged(ClientModel *clientmodel, bool initialSync, const CBlockIndex *pIndex, bool fHeader)
+static void NotifyGhostnodeListChanged(ClientModel *clientmodel)
 {
-    // lock free async UI updates in case we have a new block tip
-    // during initial sync, only update the UI if the last update
-    // was > 250ms (MODEL_UPDATE_DELAY) ago
-    int64_t now = 0;
-    if (initialSync)
-        now = GetTimeMillis();
-
-    int64_t& nLastUpdateNotification = fHeader ? nLastHeaderTipUpdateNotification : nLastBlockTipUpdateNotification;
+    clientmodel->queueGhostnodeListChanged();
+}
 
-    if (fHeader) {
-        // cache best headers time and height to reduce future cs_main locks
-        clientmodel->cachedBestHeaderHeight = pIndex->nHeight;
-        clientmodel->cachedBestHeaderTime = pIndex->GetBlockTime();
-    }
-    // if we are in-sync, update the UI regardless of last update time
-    if (!initialSync || now - nLastUpdateNotification > MODEL_UPDATE_DELAY) {
-        //pass an async signal to the UI thread
-        QMetaObject::invokeMethod(clientmodel, "numBlocksChanged", Qt::QueuedConnection,
-                                  Q_ARG(int, pIndex->nHeight),
-                                  Q_ARG(QDateTime, QDateTime::fromTime_t(pIndex->GetBlockTime())),
-                                  Q_ARG(double, clientmodel->getVerificationProgress(pIndex)),
-                                  Q_ARG(bool, fHeader));
-        nLastUpdateNotification = now;
-    }
+static void BlockTipChanged(ClientModel *clientmodel, bool initialSync, const CBlockIndex *pIndex, bool fHeader)
+{
+    Q_UNUSED(initialSync);
+    // lock free async UI updates in case we have a new block tip,
+    // merged with the other tip changes until the GUI delivers them
+    clientmodel->queueTipNotification(pIndex, fHeader);
 }
 
 void ClientModel::subscribeToCoreSignals()
@@ -329,6 +400,7 @@ void ClientModel::subscribeToCoreSignals()
     uiInterface.NotifyBlockTip.connect(boost::bind(BlockTipChanged, this, _1, _2, false));
     uiInterface.NotifyHeaderTip.connect(boost::bind(BlockTipChanged, this, _1, _2, true));
     uiInterface.NotifyAdditionalDataSyncProgressChanged.connect(boost::bind(NotifyAdditionalDataSyncProgressChanged, this, _1, _2));
+    uiInterface.NotifyGhostnodeListChanged.connect(boost::bind(NotifyGhostnodeListChanged, this));
 }
 
 void ClientModel::unsubscribeFromCoreSignals()
@@ -342,4 +414,5 @@ void ClientModel::unsubscribeFromCoreSignals()
     uiInterface.NotifyBlockTip.disconnect(boost::bind(BlockTipChanged, this, _1, _2, false));
     uiInterface.NotifyHeaderTip.disconnect(boost::bind(BlockTipChanged, this, _1, _2, true));
     uiInterface.NotifyAdditionalDataSyncProgressChanged.disconnect(boost::bind(NotifyAdditionalDataSyncProgressChanged, this, _1, _2));
+    uiInterface.NotifyGhostnodeListChanged.disconnect(boost::bind(NotifyGhostnodeListChanged, this));
 }
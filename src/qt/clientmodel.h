@@ -5,6 +5,8 @@
 #ifndef BITCOIN_QT_CLIENTMODEL_H
 #define BITCOIN_QT_CLIENTMODEL_H
 
+#include <sync.h>
+
 #include <QObject>
 #include <QDateTime>
 
@@ -84,6 +86,13 @@ public:
     mutable std::atomic<int> cachedBestHeaderHeight;
     mutable std::atomic<int64_t> cachedBestHeaderTime;
 
+    /** Queue a notification from a core thread. Notifications are merged until the GUI
+        delivers them, at most once per MODEL_UPDATE_DELAY, and only the latest block and
+        header tips are delivered. */
+    void queueTipNotification(const CBlockIndex *pindex, bool fHeader);
+    void queueNumConnectionsChanged(int numConnections);
+    void queueGhostnodeListChanged();
+
 private:
     OptionsModel *optionsModel;
     PeerTableModel *peerTableModel;
@@ -91,6 +100,28 @@ private:
 
     QTimer *pollTimer;
 
+    struct TipNotification {
+        bool fPending;
+        int height;
+        QDateTime blockDate;
+        double verificationProgress;
+    };
+
+    CCriticalSection cs_pending;
+    TipNotification pendingBlockTip;
+    TipNotification pendingHeaderTip;
+    int pendingNumConnections;
+    bool fPendingGhostnodeListChanged;
+    //! A delivery is queued or scheduled, notifications are merged into it
+    bool fDeliveryQueued;
+
+    //! GUI thread only
+    QTimer *deliveryTimer;
+    int64_t nLastDelivery;
+
+    //! Queue a delivery if none is, call with cs_pending held
+    void queueDelivery();
+
     void subscribeToCoreSignals();
     void unsubscribeFromCoreSignals();
 
@@ -102,6 +133,7 @@ Q_SIGNALS:
     void alertsChanged(const QString &warnings);
     void bytesChanged(quint64 totalBytesIn, quint64 totalBytesOut);
     void additionalDataSyncProgressChanged(int count, double nSyncProgress);
+    void ghostnodeListChanged();
 
     //! Fired when a message should be reported to the user
     void message(const QString &title, const QString &message, unsigned int style);
@@ -115,6 +147,9 @@ public Q_SLOTS:
     void updateNetworkActive(bool networkActive);
     void updateAlert();
     void updateBanlist();
+
+private Q_SLOTS:
+    void deliverNotifications();
 };
 
 #endif // BITCOIN_QT_CLIENTMODEL_H
@@ -3,6 +3,7 @@
 
 #include "ghostnode/activeghostnode.h"
 #include "clientmodel.h"
+#include "ghostnodetablemodel.h"
 #include "init.h"
 #include "guiutil.h"
 #include "ghostnode/ghostnode-sync.h"
@@ -13,25 +14,18 @@
 #include "walletmodel.h"
 #include <boost/foreach.hpp>
 
+#include <QHeaderView>
 #include <QTimer>
 #include <QMessageBox>
-
-int GetOffsetFromUtc()
-{
-#if QT_VERSION < 0x050200
-    const QDateTime dateTime1 = QDateTime::currentDateTime();
-    const QDateTime dateTime2 = QDateTime(dateTime1.date(), dateTime1.time(), Qt::UTC);
-    return dateTime1.secsTo(dateTime2);
-#else
-    return QDateTime::currentDateTime().offsetFromUtc();
-#endif
-}
+#include <QSortFilterProxyModel>
 
 GhostNode::GhostNode(const PlatformStyle *platformStyle, QWidget *parent) :
     QWidget(parent),
     ui(new Ui::GhostNode),
     clientModel(0),
-    walletModel(0)
+    walletModel(0),
+    nodeModel(0),
+    nodeProxyModel(0)
 {
     ui->setupUi(this);
 
@@ -51,11 +45,27 @@ GhostNode::GhostNode(const PlatformStyle *platformStyle, QWidget *parent) :
     ui->tableWidgetMyGhostnodes->setColumnWidth(4, columnActiveWidth);
     ui->tableWidgetMyGhostnodes->setColumnWidth(5, columnLastSeenWidth);
 
-    ui->tableWidgetGhostnodes->setColumnWidth(0, columnAddressWidth);
-    ui->tableWidgetGhostnodes->setColumnWidth(1, columnProtocolWidth);
-    ui->tableWidgetGhostnodes->setColumnWidth(2, columnStatusWidth);
-    ui->tableWidgetGhostnodes->setColumnWidth(3, columnActiveWidth);
-    ui->tableWidgetGhostnodes->setColumnWidth(4, columnLastSeenWidth);
+    // The list is loaded in the model's worker thread, sorting and filtering only read the rows
+    nodeModel = new GhostnodeTableModel(this);
+    nodeProxyModel = new QSortFilterProxyModel(this);
+    nodeProxyModel->setSourceModel(nodeModel);
+    nodeProxyModel->setDynamicSortFilter(true);
+    nodeProxyModel->setSortRole(GhostnodeTableModel::SortRole);
+    nodeProxyModel->setFilterRole(GhostnodeTableModel::FilterRole);
+    ui->tableViewGhostnodes->setModel(nodeProxyModel);
+    ui->tableViewGhostnodes->verticalHeader()->hide();
+    ui->tableViewGhostnodes->sortByColumn(GhostnodeTableModel::Address, Qt::AscendingOrder);
+
+    ui->tableViewGhostnodes->setColumnWidth(GhostnodeTableModel::Address, columnAddressWidth);
+    ui->tableViewGhostnodes->setColumnWidth(GhostnodeTableModel::Protocol, columnProtocolWidth);
+    ui->tableViewGhostnodes->setColumnWidth(GhostnodeTableModel::Status, columnStatusWidth);
+    ui->tableViewGhostnodes->setColumnWidth(GhostnodeTableModel::Active, columnActiveWidth);
+    ui->tableViewGhostnodes->setColumnWidth(GhostnodeTableModel::LastSeen, columnLastSeenWidth);
+
+    connect(nodeProxyModel, SIGNAL(rowsInserted(QModelIndex,int,int)), this, SLOT(updateNodeCount()));
+    connect(nodeProxyModel, SIGNAL(rowsRemoved(QModelIndex,int,int)), this, SLOT(updateNodeCount()));
+    connect(nodeProxyModel, SIGNAL(layoutChanged()), this, SLOT(updateNodeCount()));
+    connect(nodeProxyModel, SIGNAL(modelReset()), this, SLOT(updateNodeCount()));
 
     ui->tableWidgetMyGhostnodes->setContextMenuPolicy(Qt::CustomContextMenu);
 
@@ -66,13 +76,10 @@ GhostNode::GhostNode(const PlatformStyle *platformStyle, QWidget *parent) :
     connect(startAliasAction, SIGNAL(triggered()), this, SLOT(on_startButton_clicked()));
 
     timer = new QTimer(this);
-    connect(timer, SIGNAL(timeout()), this, SLOT(updateNodeList()));
     connect(timer, SIGNAL(timeout()), this, SLOT(updateMyNodeList()));
     timer->start(1000);
 
-    fFilterUpdated = false;
-    nTimeFilterUpdated = GetTime();
-    updateNodeList();
+    updateNodeCount();
 }
 
 GhostNode::~GhostNode()
@@ -84,8 +91,8 @@ void GhostNode::setClientModel(ClientModel *model)
 {
     this->clientModel = model;
     if(model) {
-        // try to update list when Ghostnode count changes
-        connect(clientModel, SIGNAL(strGhostnodesChanged(QString)), this, SLOT(updateNodeList()));
+        // reload the list when ghostnodes are added or removed
+        connect(clientModel, SIGNAL(ghostnodeListChanged()), nodeModel, SLOT(refresh()));
     }
 }
 
@@ -233,7 +240,6 @@ void GhostNode::updateMyNodeList(bool fForce)
     if(nSecondsTillUpdate > 0 && !fForce) return;
     nTimeMyListUpdated = GetTime();
 
-    ui->tableWidgetGhostnodes->setSortingEnabled(false);
     BOOST_FOREACH(CGhostnodeConfig::CGhostnodeEntry mne, ghostnodeConfig.getEntries()) {
         int32_t nOutputIndex = 0;
         if(!ParseInt32(mne.getOutputIndex(), &nOutputIndex)) {
@@ -242,84 +248,20 @@ void GhostNode::updateMyNodeList(bool fForce)
 
         updateMyGhostnodeInfo(QString::fromStdString(mne.getAlias()), QString::fromStdString(mne.getIp()), COutPoint(uint256S(mne.getTxHash()), nOutputIndex));
     }
-    ui->tableWidgetGhostnodes->setSortingEnabled(true);
 
     // reset "timer"
     ui->secondsLabel->setText("0");
 }
 
-void GhostNode::updateNodeList()
+void GhostNode::updateNodeCount()
 {
-    TRY_LOCK(cs_mnlist, fLockAcquired);
-    if(!fLockAcquired) {
-        return;
-    }
-
-    static int64_t nTimeListUpdated = GetTime();
-
-    // to prevent high cpu usage update only once in MASTERNODELIST_UPDATE_SECONDS seconds
-    // or MASTERNODELIST_FILTER_COOLDOWN_SECONDS seconds after filter was last changed
-    int64_t nSecondsToWait = fFilterUpdated
-                            ? nTimeFilterUpdated - GetTime() + MASTERNODELIST_FILTER_COOLDOWN_SECONDS
-                            : nTimeListUpdated - GetTime() + MASTERNODELIST_UPDATE_SECONDS;
-
-    if(fFilterUpdated) ui->countLabel->setText(QString::fromStdString(strprintf("Please wait... %d", nSecondsToWait)));
-    if(nSecondsToWait > 0) return;
-
-    nTimeListUpdated = GetTime();
-    fFilterUpdated = false;
-
-    QString strToFilter;
-    ui->countLabel->setText("Updating...");
-    ui->tableWidgetGhostnodes->setSortingEnabled(false);
-    ui->tableWidgetGhostnodes->clearContents();
-    ui->tableWidgetGhostnodes->setRowCount(0);
-//    std::map<COutPoint, CGhostnode> mapGhostnodes = mnodeman.GetFullGhostnodeMap();
-    std::vector<CGhostnode> vGhostnodes = mnodeman.GetFullGhostnodeVector();
-    int offsetFromUtc = GetOffsetFromUtc();
-
-    BOOST_FOREACH(CGhostnode & mn, vGhostnodes)
-    {
-//        CGhostnode mn = mnpair.second;
-        // populate list
-        // Address, Protocol, Status, Active Seconds, Last Seen, Pub Key
-        QTableWidgetItem *addressItem = new QTableWidgetItem(QString::fromStdString(mn.addr.ToString()));
-        QTableWidgetItem *protocolItem = new QTableWidgetItem(QString::number(mn.nProtocolVersion));
-        QTableWidgetItem *statusItem = new QTableWidgetItem(QString::fromStdString(mn.GetStatus()));
-        QTableWidgetItem *activeSecondsItem = new QTableWidgetItem(QString::fromStdString(DurationToDHMS(mn.lastPing.sigTime - mn.sigTime)));
-        QTableWidgetItem *lastSeenItem = new QTableWidgetItem(QString::fromStdString(DateTimeStrFormat("%Y-%m-%d %H:%M", mn.lastPing.sigTime + offsetFromUtc)));
-        QTableWidgetItem *pubkeyItem = new QTableWidgetItem(QString::fromStdString(CBitcoinAddress(mn.pubKeyCollateralAddress.GetID()).ToString()));
-
-        if (strCurrentFilter != "")
-        {
-            strToFilter =   addressItem->text() + " " +
-                            protocolItem->text() + " " +
-                            statusItem->text() + " " +
-                            activeSecondsItem->text() + " " +
-                            lastSeenItem->text() + " " +
-                            pubkeyItem->text();
-            if (!strToFilter.contains(strCurrentFilter)) continue;
-        }
-
-        ui->tableWidgetGhostnodes->insertRow(0);
-        ui->tableWidgetGhostnodes->setItem(0, 0, addressItem);
-        ui->tableWidgetGhostnodes->setItem(0, 1, protocolItem);
-        ui->tableWidgetGhostnodes->setItem(0, 2, statusItem);
-        ui->tableWidgetGhostnodes->setItem(0, 3, activeSecondsItem);
-        ui->tableWidgetGhostnodes->setItem(0, 4, lastSeenItem);
-        ui->tableWidgetGhostnodes->setItem(0, 5, pubkeyItem);
-    }
-
-    ui->countLabel->setText(QString::number(ui->tableWidgetGhostnodes->rowCount()));
-    ui->tableWidgetGhostnodes->setSortingEnabled(true);
+    ui->countLabel->setText(QString::number(nodeProxyModel->rowCount()));
 }
 
 void GhostNode::on_filterLineEdit_textChanged(const QString &strFilterIn)
 {
-    strCurrentFilter = strFilterIn;
-    nTimeFilterUpdated = GetTime();
-    fFilterUpdated = true;
-    ui->countLabel->setText(QString::fromStdString(strprintf("Please wait... %d", MASTERNODELIST_FILTER_COOLDOWN_SECONDS)));
+    nodeProxyModel->setFilterFixedString(strFilterIn);
+    updateNodeCount();
 }
 
 void GhostNode::on_startButton_clicked()
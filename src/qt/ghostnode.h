@@ -11,18 +11,18 @@
 #include <QWidget>
 
 #define MY_MASTERNODELIST_UPDATE_SECONDS                 60
-#define MASTERNODELIST_UPDATE_SECONDS                    15
-#define MASTERNODELIST_FILTER_COOLDOWN_SECONDS            3
 
 namespace Ui {
     class GhostNode;
 }
 
 class ClientModel;
+class GhostnodeTableModel;
 class WalletModel;
 
 QT_BEGIN_NAMESPACE
 class QModelIndex;
+class QSortFilterProxyModel;
 QT_END_NAMESPACE
 
 /** Ghostnode Manager page widget */
@@ -41,13 +41,11 @@ public:
 
 private:
     QMenu *contextMenu;
-    int64_t nTimeFilterUpdated;
-    bool fFilterUpdated;
 
 public Q_SLOTS:
     void updateMyGhostnodeInfo(QString strAlias, QString strAddr, const COutPoint& outpoint);
     void updateMyNodeList(bool fForce = false);
-    void updateNodeList();
+    void updateNodeCount();
 
 Q_SIGNALS:
 
@@ -56,15 +54,12 @@ private:
     Ui::GhostNode *ui;
     ClientModel *clientModel;
     WalletModel *walletModel;
-
-    // Protects tableWidgetGhostnodes
-    CCriticalSection cs_mnlist;
+    GhostnodeTableModel *nodeModel;
+    QSortFilterProxyModel *nodeProxyModel;
 
     // Protects tableWidgetMyGhostnodes
     CCriticalSection cs_mymnlist;
 
-    QString strCurrentFilter;
-
 private Q_SLOTS:
     void showContextMenu(const QPoint &);
     void on_filterLineEdit_textChanged(const QString &strFilterIn);
@@ -0,0 +1,222 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <qt/ghostnodetablemodel.h>
+
+#include <base58.h>
+#include <ghostnode/ghostnodeman.h>
+#include <util.h>
+#include <utiltime.h>
+
+#include <QDateTime>
+#include <QTimer>
+
+#include <algorithm>
+
+int GetOffsetFromUtc()
+{
+#if QT_VERSION < 0x050200
+    const QDateTime dateTime1 = QDateTime::currentDateTime();
+    const QDateTime dateTime2 = QDateTime(dateTime1.date(), dateTime1.time(), Qt::UTC);
+    return dateTime1.secsTo(dateTime2);
+#else
+    return QDateTime::currentDateTime().offsetFromUtc();
+#endif
+}
+
+bool GhostnodeTableEntry::operator==(const GhostnodeTableEntry& other) const
+{
+    return outpoint == other.outpoint && address == other.address && nProtocolVersion == other.nProtocolVersion &&
+           status == other.status && nActiveSeconds == other.nActiveSeconds && nLastSeen == other.nLastSeen &&
+           payee == other.payee;
+}
+
+void GhostnodeListLoader::load()
+{
+    std::shared_ptr<const std::vector<CGhostnode> > pGhostnodes = mnodeman.GetFullGhostnodeVector();
+    int offsetFromUtc = GetOffsetFromUtc();
+
+    GhostnodeTableEntries entries;
+    entries.reserve(pGhostnodes->size());
+    for (const CGhostnode& mn : *pGhostnodes) {
+        GhostnodeTableEntry entry;
+        entry.outpoint = mn.vin.prevout;
+        entry.address = QString::fromStdString(mn.addr.ToString());
+        entry.nProtocolVersion = mn.nProtocolVersion;
+        entry.status = QString::fromStdString(mn.GetStatus());
+        entry.nActiveSeconds = mn.lastPing.sigTime - mn.sigTime;
+        entry.nLastSeen = mn.lastPing.sigTime;
+        entry.payee = QString::fromStdString(CBitcoinAddress(mn.pubKeyCollateralAddress.GetID()).ToString());
+        entry.active = QString::fromStdString(DurationToDHMS(entry.nActiveSeconds));
+        entry.lastSeen = QString::fromStdString(DateTimeStrFormat("%Y-%m-%d %H:%M", entry.nLastSeen + offsetFromUtc));
+        entry.filterText = entry.address + " " + QString::number(entry.nProtocolVersion) + " " + entry.status + " " +
+                           entry.active + " " + entry.lastSeen + " " + entry.payee;
+        entries.push_back(std::move(entry));
+    }
+    std::sort(entries.begin(), entries.end(), [](const GhostnodeTableEntry& a, const GhostnodeTableEntry& b) {
+        return a.outpoint < b.outpoint;
+    });
+
+    Q_EMIT loaded(entries);
+}
+
+GhostnodeTableModel::GhostnodeTableModel(QObject *parent) :
+    QAbstractTableModel(parent),
+    timer(0),
+    fLoading(false),
+    fRefreshPending(false)
+{
+    columns << tr("Address") << tr("Protocol") << tr("Status") << tr("Active") << tr("Last Seen") << tr("Payee");
+
+    qRegisterMetaType<GhostnodeTableEntries>("GhostnodeTableEntries");
+    GhostnodeListLoader *loader = new GhostnodeListLoader();
+    loader->moveToThread(&thread);
+    connect(this, SIGNAL(loadRequested()), loader, SLOT(load()));
+    connect(loader, SIGNAL(loaded(GhostnodeTableEntries)), this, SLOT(applyEntries(GhostnodeTableEntries)));
+    // Delete the loader in its thread once the thread's event loop quits
+    connect(&thread, SIGNAL(finished()), loader, SLOT(deleteLater()), Qt::DirectConnection);
+    thread.start();
+
+    // Pings and status changes are not notified, pick them up periodically
+    timer = new QTimer(this);
+    connect(timer, SIGNAL(timeout()), SLOT(refresh()));
+    timer->start(REFRESH_SECONDS * 1000);
+
+    refresh();
+}
+
+GhostnodeTableModel::~GhostnodeTableModel()
+{
+    thread.quit();
+    thread.wait();
+}
+
+void GhostnodeTableModel::refresh()
+{
+    if (fLoading) {
+        fRefreshPending = true;
+        return;
+    }
+    fLoading = true;
+    Q_EMIT loadRequested();
+}
+
+void GhostnodeTableModel::applyEntries(const GhostnodeTableEntries& entries)
+{
+    // Both lists are sorted by outpoint: merge them, removing, inserting and updating runs of rows
+    int row = 0;
+    size_t i = 0;
+    int nFirstChanged = -1;
+    auto flushChanged = [&]() {
+        if (nFirstChanged >= 0)
+            Q_EMIT dataChanged(index(nFirstChanged, 0), index(row - 1, columns.length() - 1));
+        nFirstChanged = -1;
+    };
+    while (row < (int)rows.size() || i < entries.size()) {
+        if (i == entries.size() || (row < (int)rows.size() && rows[row].outpoint < entries[i].outpoint)) {
+            flushChanged();
+            int nLast = row;
+            while (nLast + 1 < (int)rows.size() && (i == entries.size() || rows[nLast + 1].outpoint < entries[i].outpoint))
+                nLast++;
+            beginRemoveRows(QModelIndex(), row, nLast);
+            rows.erase(rows.begin() + row, rows.begin() + nLast + 1);
+            endRemoveRows();
+        } else if (row == (int)rows.size() || entries[i].outpoint < rows[row].outpoint) {
+            flushChanged();
+            size_t nEnd = i + 1;
+            while (nEnd < entries.size() && (row == (int)rows.size() || entries[nEnd].outpoint < rows[row].outpoint))
+                nEnd++;
+            beginInsertRows(QModelIndex(), row, row + (nEnd - i) - 1);
+            rows.insert(rows.begin() + row, entries.begin() + i, entries.begin() + nEnd);
+            endInsertRows();
+            row += nEnd - i;
+            i = nEnd;
+        } else {
+            if (rows[row] != entries[i]) {
+                rows[row] = entries[i];
+                if (nFirstChanged < 0)
+                    nFirstChanged = row;
+            } else {
+                flushChanged();
+            }
+            row++;
+            i++;
+        }
+    }
+    flushChanged();
+
+    fLoading = false;
+    if (fRefreshPending) {
+        fRefreshPending = false;
+        refresh();
+    }
+}
+
+int GhostnodeTableModel::rowCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+    return rows.size();
+}
+
+int GhostnodeTableModel::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+    return columns.length();
+}
+
+QVariant GhostnodeTableModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= (int)rows.size())
+        return QVariant();
+
+    const GhostnodeTableEntry& entry = rows[index.row()];
+
+    if (role == Qt::DisplayRole) {
+        switch (index.column())
+        {
+        case Address:
+            return entry.address;
+        case Protocol:
+            return entry.nProtocolVersion;
+        case Status:
+            return entry.status;
+        case Active:
+            return entry.active;
+        case LastSeen:
+            return entry.lastSeen;
+        case Payee:
+            return entry.payee;
+        }
+    } else if (role == SortRole) {
+        switch (index.column())
+        {
+        case Active:
+            return (qint64)entry.nActiveSeconds;
+        case LastSeen:
+            return (qint64)entry.nLastSeen;
+        default:
+            return data(index, Qt::DisplayRole);
+        }
+    } else if (role == FilterRole) {
+        return entry.filterText;
+    }
+
+    return QVariant();
+}
+
+QVariant GhostnodeTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section < columns.size())
+        return columns[section];
+
+    return QVariant();
+}
+
+Qt::ItemFlags GhostnodeTableModel::flags(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return 0;
+
+    return Qt::ItemIsSelectable | Qt::ItemIsEnabled;
+}
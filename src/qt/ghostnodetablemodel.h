@@ -0,0 +1,115 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_QT_GHOSTNODETABLEMODEL_H
+#define BITCOIN_QT_GHOSTNODETABLEMODEL_H
+
+#include <primitives/transaction.h>
+
+#include <QAbstractTableModel>
+#include <QMetaType>
+#include <QStringList>
+#include <QThread>
+
+#include <vector>
+
+QT_BEGIN_NAMESPACE
+class QTimer;
+QT_END_NAMESPACE
+
+/** Offset of the local time zone from UTC, in seconds */
+int GetOffsetFromUtc();
+
+/** One row of the ghostnode list, formatted by GhostnodeListLoader */
+struct GhostnodeTableEntry {
+    COutPoint outpoint;
+    QString address;
+    int nProtocolVersion;
+    QString status;
+    int64_t nActiveSeconds;
+    int64_t nLastSeen;
+    QString payee;
+    QString active;
+    QString lastSeen;
+    //! Text of all columns, matched by the filter
+    QString filterText;
+
+    bool operator==(const GhostnodeTableEntry& other) const;
+    bool operator!=(const GhostnodeTableEntry& other) const { return !(*this == other); }
+};
+
+typedef std::vector<GhostnodeTableEntry> GhostnodeTableEntries;
+Q_DECLARE_METATYPE(GhostnodeTableEntries)
+
+/** Copies and formats the ghostnode list in a worker thread, sorted by collateral outpoint */
+class GhostnodeListLoader : public QObject
+{
+    Q_OBJECT
+
+public Q_SLOTS:
+    void load();
+
+Q_SIGNALS:
+    void loaded(const GhostnodeTableEntries& entries);
+};
+
+/**
+   Qt model of the ghostnode list, for the ghostnode page. The list is reloaded off the GUI
+   thread when it changes and every GhostnodeTableModel::REFRESH_SECONDS, and only the rows
+   that differ are inserted, removed or updated. Sort and filter it with a QSortFilterProxyModel
+   on SortRole and FilterRole.
+ */
+class GhostnodeTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    explicit GhostnodeTableModel(QObject *parent = 0);
+    ~GhostnodeTableModel();
+
+    static const int REFRESH_SECONDS = 15;
+
+    enum ColumnIndex {
+        Address = 0,
+        Protocol = 1,
+        Status = 2,
+        Active = 3,
+        LastSeen = 4,
+        Payee = 5
+    };
+
+    enum RoleIndex {
+        SortRole = Qt::UserRole,
+        FilterRole
+    };
+
+    /** @name Methods overridden from QAbstractTableModel
+        @{*/
+    int rowCount(const QModelIndex &parent) const;
+    int columnCount(const QModelIndex &parent) const;
+    QVariant data(const QModelIndex &index, int role) const;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const;
+    Qt::ItemFlags flags(const QModelIndex &index) const;
+    /*@}*/
+
+public Q_SLOTS:
+    /** Reload the list, at most one load runs at a time */
+    void refresh();
+
+private Q_SLOTS:
+    void applyEntries(const GhostnodeTableEntries& entries);
+
+Q_SIGNALS:
+    void loadRequested();
+
+private:
+    QStringList columns;
+    GhostnodeTableEntries rows;
+    QThread thread;
+    QTimer *timer;
+    bool fLoading;
+    bool fRefreshPending;
+};
+
+#endif // BITCOIN_QT_GHOSTNODETABLEMODEL_H
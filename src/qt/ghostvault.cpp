@@ -15,18 +15,62 @@
 #include "editaddressdialog.h"
 #include "guiutil.h"
 #include "platformstyle.h"
+#include <validation.h>
 #include <wallet/wallet.h>
+#include <zerocoin/zerocoin.h>
 
+#include <QApplication>
 #include <QIcon>
 #include <QMenu>
 #include <QMessageBox>
 #include <QSortFilterProxyModel>
+#include <QTimer>
+
+#include <set>
+
+/** Interval of the status checks of a queued spend */
+static const int SPEND_POLL_MILLIS = 500;
+
+void GhostVaultWorker::loadMints()
+{
+    std::list<CZerocoinEntry> listPubCoin;
+    wallet->ListZerocoinEntries(listPubCoin);
+
+    QList<qint64> denominations;
+    {
+        LOCK(cs_main);
+        CZerocoinState *zerocoinState = CZerocoinState::GetZerocoinState();
+        for (const CZerocoinEntry &entry : listPubCoin) {
+            if (entry.IsUsed || entry.randomness == 0 || entry.serialNumber == 0)
+                continue;
+            int id;
+            if (zerocoinState->GetMintedCoinHeightAndId(entry.value, entry.denomination, id) > 0)
+                denominations.append(entry.denomination);
+        }
+    }
+    Q_EMIT mintsLoaded(denominations);
+}
+
+void GhostVaultWorker::mint(const QString &denomination)
+{
+    std::string strError;
+    bool fSuccess = false;
+    try {
+        fSuccess = wallet->CreateZerocoinMintModel(strError, denomination.toStdString());
+    } catch (const std::exception &e) {
+        strError = e.what();
+    }
+    Q_EMIT mintFinished(fSuccess, QString::fromStdString(strError));
+}
 
 GhostVault::GhostVault(const PlatformStyle *platformStyle, Mode mode, QWidget *parent) :
         QWidget(parent),
         ui(new Ui::GhostVault),
         model(0),
-        mode(mode){
+        mode(mode),
+        walletModel(0),
+        fBusy(false),
+        nSpendId(0){
     ui->setupUi(this);
 
     if (!platformStyle->getImagesOnButtons()) {
@@ -61,16 +105,11 @@ GhostVault::GhostVault(const PlatformStyle *platformStyle, Mode mode, QWidget *p
     ui->ghostAmount->addItem("5000");
 
     ui->convertNIXAmount->clear();
+    ui->convertNIXAmount->addItem(tr("None"));
 
-    std::vector <COutput> vCoins;
-    vpwallets.front()->ListAvailableCoinsMintCoins(vCoins, true);
-    ui->total->setText(QString::number(vCoins.size()) + tr(" Ghosted NIX"));
+    spendTimer = new QTimer(this);
+    connect(spendTimer, SIGNAL(timeout()), this, SLOT(pollSpend()));
 
-    if(vCoins.size() == 0)
-        ui->convertNIXAmount->addItem("None");
-    else
-        for(int i = 0; i < vCoins.size(); i++)
-            ui->convertNIXAmount->addItem(QString::number(vCoins[i].tx->tx->vout[vCoins[i].i].nValue));
     // Build context menu
     contextMenu = new QMenu(this);
 
@@ -80,6 +119,8 @@ GhostVault::GhostVault(const PlatformStyle *platformStyle, Mode mode, QWidget *p
 }
 
 GhostVault::~GhostVault() {
+    thread.quit();
+    thread.wait();
     delete ui;
 }
 
@@ -117,30 +158,100 @@ void GhostVault::setModel(AddressTableModel *model) {
 //    selectionChanged();
 }
 
+void GhostVault::setWalletModel(WalletModel *walletModel) {
+    this->walletModel = walletModel;
+    if (!walletModel)
+        return;
+
+    // Mint lists and mints run in the worker, spends in the wallet's zerocoin spend queue
+    qRegisterMetaType<QList<qint64> >("QList<qint64>");
+    GhostVaultWorker *worker = new GhostVaultWorker(walletModel->getWallet());
+    worker->moveToThread(&thread);
+    connect(this, SIGNAL(loadMintsRequested()), worker, SLOT(loadMints()));
+    connect(this, SIGNAL(mintRequested(QString)), worker, SLOT(mint(QString)));
+    connect(worker, SIGNAL(mintsLoaded(QList<qint64>)), this, SLOT(updateMints(QList<qint64>)));
+    connect(worker, SIGNAL(mintFinished(bool,QString)), this, SLOT(mintFinished(bool,QString)));
+    connect(&thread, SIGNAL(finished()), worker, SLOT(deleteLater()), Qt::DirectConnection);
+    thread.start();
+    connect(qApp, SIGNAL(aboutToQuit()), this, SLOT(stopWorker()));
+
+    // Mints confirm and get spent as blocks arrive
+    connect(walletModel, SIGNAL(balanceChanged(CAmount,CAmount,CAmount,CAmount,CAmount,CAmount)), this, SLOT(requestMints()));
+    requestMints();
+}
+
+void GhostVault::requestMints() {
+    Q_EMIT loadMintsRequested();
+}
+
+void GhostVault::stopWorker() {
+    spendTimer->stop();
+    thread.quit();
+    thread.wait();
+    unlockContext.reset();
+}
+
+void GhostVault::updateMints(const QList<qint64> &denominations) {
+    qint64 nTotal = 0;
+    std::set<qint64> setDenominations;
+    for (qint64 denomination : denominations) {
+        nTotal += denomination;
+        setDenominations.insert(denomination);
+    }
+    ui->total->setText(QString::number(nTotal) + tr(" Ghosted NIX"));
+
+    QString strSelected = ui->convertNIXAmount->currentText();
+    ui->convertNIXAmount->clear();
+    if (setDenominations.empty())
+        ui->convertNIXAmount->addItem(tr("None"));
+    for (qint64 denomination : setDenominations)
+        ui->convertNIXAmount->addItem(QString::number(denomination));
+    int nSelected = ui->convertNIXAmount->findText(strSelected);
+    if (nSelected >= 0)
+        ui->convertNIXAmount->setCurrentIndex(nSelected);
+}
+
+bool GhostVault::beginOperation() {
+    if (!walletModel || fBusy)
+        return false;
+    std::unique_ptr<WalletModel::UnlockContext> ctx(new WalletModel::UnlockContext(walletModel->requestUnlock()));
+    if (!ctx->isValid())
+        return false; // Unlock wallet was cancelled
+    unlockContext = std::move(ctx);
+    fBusy = true;
+    ui->ghostNIXButton->setEnabled(false);
+    ui->convertGhostButton->setEnabled(false);
+    return true;
+}
+
+void GhostVault::endOperation() {
+    unlockContext.reset();
+    fBusy = false;
+    ui->ghostNIXButton->setEnabled(true);
+    ui->convertGhostButton->setEnabled(true);
+    ui->labelProgress->clear();
+    requestMints();
+}
+
 void GhostVault::on_ghostNIXButton_clicked() {
     QString amount = ui->ghostAmount->currentText();
-    std::string denomAmount = amount.toStdString();
-    std::string stringError;
-    if(!model->ghostNIX(stringError, denomAmount)){
-        QString t = tr(stringError.c_str());
+    if (!beginOperation())
+        return;
 
+    ui->labelProgress->setText(tr("Ghosting %1 NIX...").arg(amount));
+    Q_EMIT mintRequested(amount);
+}
+
+void GhostVault::mintFinished(bool fSuccess, const QString &error) {
+    endOperation();
+    if (!fSuccess) {
         QMessageBox::critical(this, tr("Error"),
-                              tr("You cannot ghost NIX because %1").arg(t),
+                              tr("You cannot ghost NIX because %1").arg(error),
                               QMessageBox::Ok, QMessageBox::Ok);
-    }else{
+    } else {
         QMessageBox::information(this, tr("Success"),
-                                      tr("You have been successfully ghosted NIX from your wallet"),
-                                      QMessageBox::Ok, QMessageBox::Ok);
-        std::vector <COutput> vCoins;
-        (vpwallets.front())->ListAvailableCoinsMintCoins(vCoins, true);
-        ui->total->setText(QString::number(vCoins.size()) + tr(" Ghosted NIX"));
-        ui->convertNIXAmount->clear();
-        if(vCoins.size() == 0)
-            ui->convertNIXAmount->addItem("None");
-        else
-            for(int i = 0; i < vCoins.size(); i++)
-                ui->convertNIXAmount->addItem(QString::number(vCoins[i].tx->tx->vout[vCoins[i].i].nValue));
-
+                                 tr("You have been successfully ghosted NIX from your wallet"),
+                                 QMessageBox::Ok, QMessageBox::Ok);
     }
 }
 
@@ -148,32 +259,67 @@ void GhostVault::on_convertGhostButton_clicked() {
 
     QString amount = ui->convertNIXAmount->currentText();
     QString address = ui->convertGhostToThirdPartyAddress->text();
-    std::string denomAmount = amount.toStdString();
     std::string thirdPartyAddress = address.toStdString();
-    std::string stringError;
 
     if(ui->convertGhostToMeCheckBox->isChecked() == false && thirdPartyAddress == ""){
         QMessageBox::critical(this, tr("Error"),
                                       tr("Your \"Spend To\" field is empty, please check again"),
                                       QMessageBox::Ok, QMessageBox::Ok);
-    }else{
+        return;
+    }
 
-        if(!model->convertGhost(stringError, thirdPartyAddress, denomAmount)){
-            QString t = tr(stringError.c_str());
+    int64_t nAmount = amount.toLongLong() * COIN;
+    libzerocoin::CoinDenomination denomination = libzerocoin::AmountToZerocoinDenomination(nAmount);
+    if (denomination == libzerocoin::ZQ_ERROR) {
+        QMessageBox::critical(this, tr("Error"),
+                              tr("You have no confirmed ghosted NIX to convert"),
+                              QMessageBox::Ok, QMessageBox::Ok);
+        return;
+    }
+    if (!beginOperation())
+        return;
 
-            QMessageBox::critical(this, tr("Error"),
-                                  tr("You cannot convert ghosted NIX because %1").arg(t),
-                                  QMessageBox::Ok, QMessageBox::Ok);
-        }else{
-            QMessageBox::information(this, tr("Success"),
-                                          tr("You have been successfully converted your ghosted NIX from the wallet"),
-                                          QMessageBox::Ok, QMessageBox::Ok);
+    // The spend proof is built in the background, report its progress until it is committed
+    nSpendId = walletModel->getWallet()->zerocoinSpendQueue.Add(thirdPartyAddress, nAmount, denomination);
+    ui->labelProgress->setText(tr("Spend queued"));
+    spendTimer->start(SPEND_POLL_MILLIS);
 
-        }
-        ui->convertGhostToThirdPartyAddress->clear();
-        ui->convertGhostToThirdPartyAddress->setEnabled(false);
+    ui->convertGhostToThirdPartyAddress->clear();
+    ui->convertGhostToThirdPartyAddress->setEnabled(false);
+
+    ui->convertGhostToMeCheckBox->setChecked(true);
+}
+
+void GhostVault::pollSpend() {
+    CZerocoinSpendRequest request;
+    if (!walletModel->getWallet()->zerocoinSpendQueue.Get(nSpendId, request)) {
+        request.status = ZerocoinSpendStatus::FAILED;
+        request.strError = "the spend request was lost";
+    }
+
+    switch (request.status) {
+    case ZerocoinSpendStatus::QUEUED:
+        ui->labelProgress->setText(tr("Spend queued behind earlier spends"));
+        return;
+    case ZerocoinSpendStatus::PROVING:
+        ui->labelProgress->setText(tr("Building the spend proof... %1 s").arg(GetTime() - request.nTimeQueued));
+        return;
+    case ZerocoinSpendStatus::COMMITTED:
+    case ZerocoinSpendStatus::FAILED:
+        break;
+    }
 
-        ui->convertGhostToMeCheckBox->setChecked(true);
+    spendTimer->stop();
+    nSpendId = 0;
+    endOperation();
+    if (request.status == ZerocoinSpendStatus::FAILED) {
+        QMessageBox::critical(this, tr("Error"),
+                              tr("You cannot convert ghosted NIX because %1").arg(QString::fromStdString(request.strError)),
+                              QMessageBox::Ok, QMessageBox::Ok);
+    } else {
+        QMessageBox::information(this, tr("Success"),
+                                 tr("You have been successfully converted your ghosted NIX from the wallet"),
+                                 QMessageBox::Ok, QMessageBox::Ok);
     }
 }
 
@@ -5,9 +5,16 @@
 #ifndef BITCOIN_QT_GHOSTVAULT_H
 #define BITCOIN_QT_GHOSTVAULT_H
 
+#include <qt/walletmodel.h>
+
+#include <QList>
+#include <QThread>
 #include <QWidget>
 
+#include <memory>
+
 class AddressTableModel;
+class CWallet;
 class OptionsModel;
 class PlatformStyle;
 
@@ -21,8 +28,32 @@ class QMenu;
 class QModelIndex;
 class QSortFilterProxyModel;
 class QTableView;
+class QTimer;
 QT_END_NAMESPACE
 
+/** Runs the wallet calls of the ghost vault page in a worker thread */
+class GhostVaultWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit GhostVaultWorker(CWallet *wallet) : wallet(wallet) {}
+
+public Q_SLOTS:
+    /** List the spendable mints from the wallet's mint index */
+    void loadMints();
+    /** Mint a coin of the given denomination, generating it and committing the mint transaction */
+    void mint(const QString &denomination);
+
+Q_SIGNALS:
+    /** The denomination of every unspent mint in the active chain */
+    void mintsLoaded(const QList<qint64> &denominations);
+    void mintFinished(bool fSuccess, const QString &error);
+
+private:
+    CWallet *wallet;
+};
+
 /** Widget that shows a list of sending or receiving addresses.
   */
 class GhostVault : public QWidget
@@ -40,6 +71,7 @@ public:
     ~GhostVault();
 
     void setModel(AddressTableModel *model);
+    void setWalletModel(WalletModel *walletModel);
     const QString &getReturnValue() const { return returnValue; }
 
 //public Q_SLOTS:
@@ -55,6 +87,19 @@ private:
     QAction *deleteAction; // to be able to explicitly disable it
     QString newAddressToSelect;
 
+    WalletModel *walletModel;
+    QThread thread;
+    /** Keeps the wallet unlocked while a mint or spend runs */
+    std::unique_ptr<WalletModel::UnlockContext> unlockContext;
+    bool fBusy;
+    /** Id of the spend queued in the wallet's zerocoin spend queue, 0 if none */
+    uint64_t nSpendId;
+    QTimer *spendTimer;
+
+    /** Unlock the wallet for a mint or spend, if no other one is running */
+    bool beginOperation();
+    void endOperation();
+
 private Q_SLOTS:
     /** Export button clicked */
     void on_exportButton_clicked();
@@ -71,9 +116,19 @@ private Q_SLOTS:
     void contextualMenu(const QPoint &point);
     /** New entry/entries were added to address table */
     void selectNewAddress(const QModelIndex &parent, int begin, int /*end*/);
+    /** Show the balance and the spendable denominations */
+    void updateMints(const QList<qint64> &denominations);
+    void mintFinished(bool fSuccess, const QString &error);
+    /** Report the state of the queued spend */
+    void pollSpend();
+    void requestMints();
+    /** Wait for the mint in progress and relock the wallet, before the wallet model goes away */
+    void stopWorker();
 
 Q_SIGNALS:
     void sendCoins(QString addr);
+    void loadMintsRequested();
+    void mintRequested(const QString &denomination);
 };
 
 #endif // BITCOIN_QT_ADDRESSBOOKPAGE_H
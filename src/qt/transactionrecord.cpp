@@ -181,6 +181,7 @@ void TransactionRecord::updateStatus(const CWalletTx &wtx)
     status.countsForBalance = wtx.IsTrusted() && !(wtx.GetBlocksToMaturity() > 0);
     status.depth = wtx.GetDepthInMainChain();
     status.cur_num_blocks = chainActive.Height();
+    status.block = pindex;
 
     if (!CheckFinalTx(*wtx.tx))
     {
@@ -254,6 +255,16 @@ bool TransactionRecord::statusUpdateNeeded() const
     return status.cur_num_blocks != chainActive.Height() || status.needsUpdate;
 }
 
+bool TransactionRecord::updateDepth()
+{
+    AssertLockHeld(cs_main);
+    if (status.needsUpdate || status.status != TransactionStatus::Confirmed || !status.block || !chainActive.Contains(status.block))
+        return false;
+    status.depth = chainActive.Height() - status.block->nHeight + 1;
+    status.cur_num_blocks = chainActive.Height();
+    return true;
+}
+
 QString TransactionRecord::getTxID() const
 {
     return QString::fromStdString(hash.ToString());
@@ -11,6 +11,7 @@
 #include <QList>
 #include <QString>
 
+class CBlockIndex;
 class CWallet;
 class CWalletTx;
 
@@ -21,7 +22,7 @@ class TransactionStatus
 public:
     TransactionStatus():
         countsForBalance(false), sortKey(""),
-        matures_in(0), status(Offline), depth(0), open_for(0), cur_num_blocks(-1)
+        matures_in(0), status(Offline), depth(0), open_for(0), cur_num_blocks(-1), block(nullptr)
     { }
 
     enum Status {
@@ -62,6 +63,9 @@ public:
     /** Current number of blocks (to know whether cached status is still valid) */
     int cur_num_blocks;
 
+    /** Block containing the transaction, if any, when the status was computed */
+    const CBlockIndex *block;
+
     bool needsUpdate;
 };
 
@@ -141,6 +145,11 @@ public:
     /** Return whether a status update is needed.
      */
     bool statusUpdateNeeded() const;
+
+    /** Update only the depth of a confirmed transaction whose block is still in the active
+        chain, which is all that can change for it. Returns false if a full update is needed.
+     */
+    bool updateDepth();
 };
 
 #endif // BITCOIN_QT_TRANSACTIONRECORD_H
@@ -53,13 +53,27 @@ struct TxLessThan
     }
 };
 
+// Wallet notification, queued for the GUI thread
+struct TransactionNotification
+{
+    TransactionNotification() {}
+    TransactionNotification(uint256 _hash, ChangeType _status, bool _showTransaction):
+        hash(_hash), status(_status), showTransaction(_showTransaction) {}
+
+    uint256 hash;
+    ChangeType status;
+    bool showTransaction;
+};
+
 // Private implementation
 class TransactionTablePriv
 {
 public:
     TransactionTablePriv(CWallet *_wallet, TransactionTableModel *_parent) :
         wallet(_wallet),
-        parent(_parent)
+        parent(_parent),
+        fLoading(true),
+        fLoadedAny(false)
     {
     }
 
@@ -72,20 +86,49 @@ public:
      */
     QList<TransactionRecord> cachedWallet;
 
-    /* Query entire wallet anew from core.
+    /* Notifications from core threads not delivered yet. A single queued call delivers
+     * all of them, however many arrive before the GUI thread gets to it.
+     */
+    CCriticalSection cs_notifications;
+    std::vector<TransactionNotification> vNotifications;
+
+    /* Whether the loader is still appending chunks of the wallet, and the hash of the last
+     * wallet transaction it appended. Notifications of transactions past it are deferred
+     * until the loader has appended them.
      */
-    void refreshWallet()
+    bool fLoading;
+    uint256 loadedUpTo;
+    bool fLoadedAny;
+    std::vector<TransactionNotification> vDeferred;
+
+    bool isLoaded(const uint256 &hash) const
     {
-        qDebug() << "TransactionTablePriv::refreshWallet";
-        cachedWallet.clear();
+        return !fLoading || (fLoadedAny && !(loadedUpTo < hash));
+    }
+
+    void appendChunk(const QList<TransactionRecord> &records, const uint256 &lastHash, bool fDone)
+    {
+        if (!records.isEmpty())
         {
-            LOCK2(cs_main, wallet->cs_wallet);
-            for (const auto& entry : wallet->mapWallet)
-            {
-                if (TransactionRecord::showTransaction(entry.second))
-                    cachedWallet.append(TransactionRecord::decomposeTransaction(wallet, entry.second));
-            }
+            parent->beginInsertRows(QModelIndex(), cachedWallet.size(), cachedWallet.size() + records.size() - 1);
+            cachedWallet.append(records);
+            parent->endInsertRows();
+        }
+        loadedUpTo = lastHash;
+        fLoadedAny = true;
+        fLoading = !fDone;
+
+        // The chunk may have been read before or after a deferred change, replay it as an
+        // update, which inserts, removes or refreshes the rows as the wallet has it now
+        std::vector<TransactionNotification> vStillDeferred;
+        for (const TransactionNotification &notification : vDeferred)
+        {
+            if (isLoaded(notification.hash))
+                updateWallet(notification.hash, CT_UPDATED, notification.showTransaction);
+            else
+                vStillDeferred.push_back(notification);
         }
+        vDeferred.swap(vStillDeferred);
     }
 
     /* Update our model of the wallet incrementally, to synchronize our model of the wallet
@@ -97,6 +140,12 @@ public:
     {
         qDebug() << "TransactionTablePriv::updateWallet: " + QString::fromStdString(hash.ToString()) + " " + QString::number(status);
 
+        if (!isLoaded(hash))
+        {
+            vDeferred.push_back(TransactionNotification(hash, (ChangeType)status, showTransaction));
+            return;
+        }
+
         // Find bounds of this transaction in model
         QList<TransactionRecord>::iterator lower = qLowerBound(
             cachedWallet.begin(), cachedWallet.end(), hash, TxLessThan());
@@ -192,11 +241,14 @@ public:
             // If a status update is needed (blocks came in since last check),
             //  update the status of this transaction from the wallet. Otherwise,
             // simply re-use the cached status.
+            //
+            // Confirmed transactions only need their depth updated from the
+            // height of their block, which doesn't need the wallet.
             TRY_LOCK(cs_main, lockMain);
-            if(lockMain)
+            if(lockMain && rec->statusUpdateNeeded() && !rec->updateDepth())
             {
                 TRY_LOCK(wallet->cs_wallet, lockWallet);
-                if(lockWallet && rec->statusUpdateNeeded())
+                if(lockWallet)
                 {
                     std::map<uint256, CWalletTx>::iterator mi = wallet->mapWallet.find(rec->hash);
 
@@ -237,28 +289,108 @@ public:
     }
 };
 
+TransactionTableLoader::TransactionTableLoader(CWallet *_wallet) :
+    wallet(_wallet),
+    fAbort(false)
+{
+}
+
+void TransactionTableLoader::load()
+{
+    uint256 lastHash;
+    bool fDone = false;
+    while (!fDone && !fAbort)
+    {
+        QList<TransactionRecord> records;
+        LOCK2(cs_main, wallet->cs_wallet);
+        std::map<uint256, CWalletTx>::const_iterator it = lastHash.IsNull() ? wallet->mapWallet.begin() : wallet->mapWallet.upper_bound(lastHash);
+        for (int n = 0; it != wallet->mapWallet.end() && n < CHUNK_SIZE; ++it, ++n)
+        {
+            if (TransactionRecord::showTransaction(it->second))
+                records.append(TransactionRecord::decomposeTransaction(wallet, it->second));
+            lastHash = it->first;
+        }
+        fDone = it == wallet->mapWallet.end();
+        Q_EMIT chunkLoaded(records, QString::fromStdString(lastHash.GetHex()), fDone);
+    }
+}
+
 TransactionTableModel::TransactionTableModel(const PlatformStyle *_platformStyle, CWallet* _wallet, WalletModel *parent):
         QAbstractTableModel(parent),
         wallet(_wallet),
         walletModel(parent),
         priv(new TransactionTablePriv(_wallet, this)),
         fProcessingQueuedTransactions(false),
-        platformStyle(_platformStyle)
+        platformStyle(_platformStyle),
+        loader(0)
 {
     columns << QString() << QString() << tr("Date") << tr("Type") << tr("Label") << BitcoinUnits::getAmountColumnTitle(walletModel->getOptionsModel()->getDisplayUnit());
-    priv->refreshWallet();
 
     connect(walletModel->getOptionsModel(), SIGNAL(displayUnitChanged(int)), this, SLOT(updateDisplayUnit()));
 
+    // Subscribe before loading, changes to transactions not loaded yet are picked up by the loader
     subscribeToCoreSignals();
+
+    qRegisterMetaType<QList<TransactionRecord> >("QList<TransactionRecord>");
+    loader = new TransactionTableLoader(wallet);
+    loader->moveToThread(&thread);
+    connect(this, SIGNAL(loadRequested()), loader, SLOT(load()));
+    connect(loader, SIGNAL(chunkLoaded(QList<TransactionRecord>,QString,bool)), this, SLOT(appendChunk(QList<TransactionRecord>,QString,bool)));
+    // Delete the loader in its thread once the thread's event loop quits
+    connect(&thread, SIGNAL(finished()), loader, SLOT(deleteLater()), Qt::DirectConnection);
+    thread.start();
+    Q_EMIT loadRequested();
 }
 
 TransactionTableModel::~TransactionTableModel()
 {
+    loader->abort();
+    thread.quit();
+    thread.wait();
     unsubscribeFromCoreSignals();
     delete priv;
 }
 
+bool TransactionTableModel::isLoading() const
+{
+    return priv->fLoading;
+}
+
+void TransactionTableModel::appendChunk(const QList<TransactionRecord>& records, const QString& lastHash, bool fDone)
+{
+    uint256 hash;
+    hash.SetHex(lastHash.toStdString());
+
+    priv->appendChunk(records, hash, fDone);
+}
+
+void TransactionTableModel::queueNotifications(const std::vector<TransactionNotification>& notifications)
+{
+    LOCK(priv->cs_notifications);
+    bool fQueued = !priv->vNotifications.empty();
+    priv->vNotifications.insert(priv->vNotifications.end(), notifications.begin(), notifications.end());
+    if (!fQueued)
+        QMetaObject::invokeMethod(this, "processNotifications", Qt::QueuedConnection);
+}
+
+void TransactionTableModel::processNotifications()
+{
+    std::vector<TransactionNotification> notifications;
+    {
+        LOCK(priv->cs_notifications);
+        notifications.swap(priv->vNotifications);
+    }
+
+    // prevent balloon spam, show maximum 10 balloons per batch
+    for (size_t i = 0; i < notifications.size(); ++i)
+    {
+        fProcessingQueuedTransactions = notifications.size() - i > 10;
+        const TransactionNotification &notification = notifications[i];
+        priv->updateWallet(notification.hash, notification.status, notification.showTransaction);
+    }
+    fProcessingQueuedTransactions = false;
+}
+
 /** Updates the column title to "Amount (DisplayUnit)" and emits headerDataChanged() signal for table headers to react. */
 void TransactionTableModel::updateAmountColumnTitle()
 {
@@ -712,28 +844,6 @@ void TransactionTableModel::updateDisplayUnit()
 }
 
 // queue notifications to show a non freezing progress dialog e.g. for rescan
-struct TransactionNotification
-{
-public:
-    TransactionNotification() {}
-    TransactionNotification(uint256 _hash, ChangeType _status, bool _showTransaction):
-        hash(_hash), status(_status), showTransaction(_showTransaction) {}
-
-    void invoke(QObject *ttm)
-    {
-        QString strHash = QString::fromStdString(hash.GetHex());
-        qDebug() << "NotifyTransactionChanged: " + strHash + " status= " + QString::number(status);
-        QMetaObject::invokeMethod(ttm, "updateTransaction", Qt::QueuedConnection,
-                                  Q_ARG(QString, strHash),
-                                  Q_ARG(int, status),
-                                  Q_ARG(bool, showTransaction));
-    }
-private:
-    uint256 hash;
-    ChangeType status;
-    bool showTransaction;
-};
-
 static bool fQueueNotifications = false;
 static std::vector< TransactionNotification > vQueueNotifications;
 
@@ -746,13 +856,14 @@ static void NotifyTransactionChanged(TransactionTableModel *ttm, CWallet *wallet
     bool showTransaction = (inWallet && TransactionRecord::showTransaction(mi->second));
 
     TransactionNotification notification(hash, status, showTransaction);
+    qDebug() << "NotifyTransactionChanged: " + QString::fromStdString(hash.GetHex()) + " status= " + QString::number(status);
 
     if (fQueueNotifications)
     {
         vQueueNotifications.push_back(notification);
         return;
     }
-    notification.invoke(ttm);
+    ttm->queueNotifications(std::vector<TransactionNotification>(1, notification));
 }
 
 static void ShowProgress(TransactionTableModel *ttm, const std::string &title, int nProgress)
@@ -763,15 +874,7 @@ static void ShowProgress(TransactionTableModel *ttm, const std::string &title, i
     if (nProgress == 100)
     {
         fQueueNotifications = false;
-        if (vQueueNotifications.size() > 10) // prevent balloon spam, show maximum 10 balloons
-            QMetaObject::invokeMethod(ttm, "setProcessingQueuedTransactions", Qt::QueuedConnection, Q_ARG(bool, true));
-        for (unsigned int i = 0; i < vQueueNotifications.size(); ++i)
-        {
-            if (vQueueNotifications.size() - i <= 10)
-                QMetaObject::invokeMethod(ttm, "setProcessingQueuedTransactions", Qt::QueuedConnection, Q_ARG(bool, false));
-
-            vQueueNotifications[i].invoke(ttm);
-        }
+        ttm->queueNotifications(vQueueNotifications);
         std::vector<TransactionNotification >().swap(vQueueNotifications); // clear
     }
 }
@@ -6,17 +6,53 @@
 #define BITCOIN_QT_TRANSACTIONTABLEMODEL_H
 
 #include <qt/nixunits.h>
+#include <qt/transactionrecord.h>
 
 #include <QAbstractTableModel>
+#include <QList>
+#include <QMetaType>
 #include <QStringList>
+#include <QThread>
+
+#include <atomic>
+#include <vector>
 
 class PlatformStyle;
-class TransactionRecord;
 class TransactionTablePriv;
+struct TransactionNotification;
 class WalletModel;
 
 class CWallet;
 
+Q_DECLARE_METATYPE(QList<TransactionRecord>)
+
+/** Decomposes the wallet transactions in a worker thread, TransactionTableLoader::CHUNK_SIZE
+    transactions per lock of the wallet, in the (hash) order of the wallet.
+ */
+class TransactionTableLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TransactionTableLoader(CWallet *wallet);
+
+    static const int CHUNK_SIZE = 1000;
+
+    /** Stop a running load after its current chunk */
+    void abort() { fAbort = true; }
+
+public Q_SLOTS:
+    void load();
+
+Q_SIGNALS:
+    /** Records of the transactions up to and including lastHash, fDone on the last chunk */
+    void chunkLoaded(const QList<TransactionRecord>& records, const QString& lastHash, bool fDone);
+
+private:
+    CWallet *wallet;
+    std::atomic<bool> fAbort;
+};
+
 /** UI model for the transaction table of a wallet.
  */
 class TransactionTableModel : public QAbstractTableModel
@@ -80,6 +116,11 @@ public:
     QVariant headerData(int section, Qt::Orientation orientation, int role) const;
     QModelIndex index(int row, int column, const QModelIndex & parent = QModelIndex()) const;
     bool processingQueuedTransactions() const { return fProcessingQueuedTransactions; }
+    /** Whether the wallet transactions are still being loaded */
+    bool isLoading() const;
+    /** Queue notifications from a core thread. They are delivered in batches, with at
+        most one delivery queued at a time. */
+    void queueNotifications(const std::vector<TransactionNotification>& notifications);
 
 private:
     CWallet* wallet;
@@ -88,6 +129,8 @@ private:
     TransactionTablePriv *priv;
     bool fProcessingQueuedTransactions;
     const PlatformStyle *platformStyle;
+    QThread thread;
+    TransactionTableLoader *loader;
 
     void subscribeToCoreSignals();
     void unsubscribeFromCoreSignals();
@@ -114,6 +157,14 @@ public Q_SLOTS:
     /* Needed to update fProcessingQueuedTransactions through a QueuedConnection */
     void setProcessingQueuedTransactions(bool value) { fProcessingQueuedTransactions = value; }
 
+private Q_SLOTS:
+    void appendChunk(const QList<TransactionRecord>& records, const QString& lastHash, bool fDone);
+    void processNotifications();
+
+Q_SIGNALS:
+    void loadRequested();
+
+private:
     friend class TransactionTablePriv;
 };
 
@@ -50,7 +50,8 @@ WalletModel::WalletModel(const PlatformStyle *platformStyle, CWallet *_wallet, O
     recentRequestsTableModel(0),
     cachedBalance(0), cachedUnconfirmedBalance(0), cachedImmatureBalance(0),
     cachedEncryptionStatus(Unencrypted),
-    cachedNumBlocks(0)
+    cachedNumBlocks(0),
+    cachedBalanceChanges(0)
 {
     fHaveWatchOnly = wallet->HaveWatchOnly();
     fForceCheckBalanceChanged = false;
@@ -139,7 +140,12 @@ void WalletModel::pollBalanceChanged()
         // Balance and number of transactions might have changed
         cachedNumBlocks = chainActive.Height();
 
-        checkBalanceChanged();
+        // The wallet counts the changes that could affect the balances
+        uint64_t nBalanceChanges = wallet->GetBalanceChanges();
+        if (nBalanceChanges != cachedBalanceChanges) {
+            cachedBalanceChanges = nBalanceChanges;
+            checkBalanceChanged();
+        }
         if(transactionTableModel)
             transactionTableModel->updateConfirmations();
     }
@@ -498,7 +504,9 @@ static void NotifyTransactionChanged(WalletModel *walletmodel, CWallet *wallet,
     Q_UNUSED(wallet);
     Q_UNUSED(hash);
     Q_UNUSED(status);
-    QMetaObject::invokeMethod(walletmodel, "updateTransaction", Qt::QueuedConnection);
+    // Only sets a flag that pollBalanceChanged picks up, so any number of changes
+    // between two polls cost the GUI a single balance check
+    walletmodel->updateTransaction();
 }
 
 static void ShowProgress(WalletModel *walletmodel, const std::string &title, int nProgress)
@@ -11,6 +11,7 @@
 #include <support/allocators/secure.h>
 #include <univalue/include/univalue.h>
 
+#include <atomic>
 #include <map>
 #include <vector>
 
@@ -229,7 +230,7 @@ public:
 private:
     CWallet *wallet;
     bool fHaveWatchOnly;
-    bool fForceCheckBalanceChanged;
+    std::atomic<bool> fForceCheckBalanceChanged;
 
     // Wallet has an options model for wallet-specific options
     // (transaction fee, for example)
@@ -248,6 +249,7 @@ private:
     CAmount cachedWatchImmatureBalance;
     EncryptionStatus cachedEncryptionStatus;
     int cachedNumBlocks;
+    uint64_t cachedBalanceChanges;
 
     QTimer *pollTimer;
 
@@ -283,7 +285,7 @@ Q_SIGNALS:
 public Q_SLOTS:
     /* Wallet status might have changed */
     void updateStatus();
-    /* New transaction, or transaction changed status */
+    /* New transaction, or transaction changed status, safe to call from any thread */
     void updateTransaction();
     /* New, updated or removed address book entry */
     void updateAddressBook(const QString &address, const QString &label, bool isMine, const QString &purpose, int status);
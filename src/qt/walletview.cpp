@@ -130,6 +130,7 @@ void WalletView::setWalletModel(WalletModel *_walletModel)
     receiveCoinsPage->setModel(_walletModel);
     sendCoinsPage->setModel(_walletModel);
     ghostVaultPage->setModel(_walletModel->getAddressTableModel());
+    ghostVaultPage->setWalletModel(_walletModel);
     ghostnodePage->setWalletModel(_walletModel);
     usedReceivingAddressesPage->setModel(_walletModel ? _walletModel->getAddressTableModel() : nullptr);
     usedSendingAddressesPage->setModel(_walletModel ? _walletModel->getAddressTableModel() : nullptr);
@@ -165,7 +166,7 @@ void WalletView::processNewTransaction(const QModelIndex& parent, int start, int
         return;
 
     TransactionTableModel *ttm = walletModel->getTransactionTableModel();
-    if (!ttm || ttm->processingQueuedTransactions())
+    if (!ttm || ttm->processingQueuedTransactions() || ttm->isLoading())
         return;
 
     QString date = ttm->index(start, TransactionTableModel::Date, parent).data().toString();
@@ -3,9 +3,11 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <base58.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <core_io.h>
+#include <ghostnode/ghostnodeman.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
 #include <validation.h>
@@ -14,6 +16,7 @@
 #include <rpc/server.h>
 #include <streams.h>
 #include <sync.h>
+#include <txdb.h>
 #include <txmempool.h>
 #include <utilstrencodings.h>
 #include <version.h>
@@ -23,6 +26,7 @@
 #include <univalue.h>
 
 static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
+static const size_t MAX_REST_ZEROCOIN_PUBCOIN_SIZE = 1024; //hex digits of a public coin
 
 enum RetFormat {
     RF_UNDEF,
@@ -570,6 +574,287 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
     }
 }
 
+/** ETag of replies that only change with the chain tip */
+static std::string TipETag()
+{
+    const CBlockIndex* pindexTip = GetChainSnapshot()->Tip();
+    return "\"" + (pindexTip ? pindexTip->GetBlockHash().GetHex() : std::string()) + "\"";
+}
+
+/**
+ * Tag the reply with etag, or reply 304 Not Modified if the client sent it as If-None-Match.
+ * Returns whether the reply was sent.
+ */
+static bool RESTNotModified(HTTPRequest* req, const std::string& etag)
+{
+    req->WriteHeader("ETag", etag);
+    std::pair<bool, std::string> ifNoneMatch = req->GetHeader("If-None-Match");
+    if (ifNoneMatch.first && ifNoneMatch.second == etag) {
+        req->WriteReply(HTTP_NOT_MODIFIED);
+        return true;
+    }
+    return false;
+}
+
+/** Reply with the serialized data in ssData, or with the JSON from fnJSON */
+static bool RESTWriteData(HTTPRequest* req, RetFormat rf, const CDataStream& ssData, const std::function<UniValue()>& fnJSON)
+{
+    switch (rf) {
+    case RF_BINARY: {
+        std::string binaryData = ssData.str();
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, binaryData);
+        return true;
+    }
+
+    case RF_HEX: {
+        std::string strHex = HexStr(ssData.begin(), ssData.end()) + "\n";
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, strHex);
+        return true;
+    }
+
+    case RF_JSON: {
+        std::string strJSON = fnJSON().write() + "\n";
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+}
+
+static bool rest_address(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() != 1 && path.size() != 3)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Use /rest/address/<address>.<ext> or /rest/address/<address>/<start>/<end>.<ext>.");
+
+    uint256 hashBytes;
+    int type = 0;
+    if (!CBitcoinAddress(path[0]).GetIndexKey(hashBytes, type))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid address: " + path[0]);
+
+    int start = 0, end = 0;
+    if (path.size() == 3 && (!ParseInt32(path[1], &start) || !ParseInt32(path[2], &end) || start <= 0 || end < start))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid height range: " + path[1] + "/" + path[2]);
+
+    if (RESTNotModified(req, TipETag()))
+        return true;
+
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    if (!GetAddressIndex(hashBytes, type, addressIndex, start, end))
+        return RESTERR(req, HTTP_NOT_FOUND, "No information available for address");
+
+    CDataStream ssData(SER_NETWORK, PROTOCOL_VERSION);
+    ssData << addressIndex;
+
+    return RESTWriteData(req, rf, ssData, [&addressIndex]() {
+        UniValue result(UniValue::VARR);
+        for (const auto& entry : addressIndex) {
+            UniValue delta(UniValue::VOBJ);
+            delta.push_back(Pair("txid", entry.first.txhash.GetHex()));
+            delta.push_back(Pair("index", (int)entry.first.index));
+            delta.push_back(Pair("blockindex", (int)entry.first.txindex));
+            delta.push_back(Pair("height", entry.first.blockHeight));
+            delta.push_back(Pair("satoshis", entry.second));
+            result.push_back(delta);
+        }
+        return result;
+    });
+}
+
+static bool rest_address_utxos(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+
+    uint256 hashBytes;
+    int type = 0;
+    if (!CBitcoinAddress(param).GetIndexKey(hashBytes, type))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid address: " + param);
+
+    if (RESTNotModified(req, TipETag()))
+        return true;
+
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    if (!GetAddressUnspent(hashBytes, type, unspentOutputs))
+        return RESTERR(req, HTTP_NOT_FOUND, "No information available for address");
+
+    CDataStream ssData(SER_NETWORK, PROTOCOL_VERSION);
+    ssData << unspentOutputs;
+
+    return RESTWriteData(req, rf, ssData, [&unspentOutputs]() {
+        UniValue result(UniValue::VARR);
+        for (const auto& entry : unspentOutputs) {
+            UniValue output(UniValue::VOBJ);
+            output.push_back(Pair("txid", entry.first.txhash.GetHex()));
+            output.push_back(Pair("outputIndex", (int)entry.first.index));
+            output.push_back(Pair("script", HexStr(entry.second.script.begin(), entry.second.script.end())));
+            output.push_back(Pair("satoshis", entry.second.satoshis));
+            output.push_back(Pair("height", entry.second.blockHeight));
+            result.push_back(output);
+        }
+        return result;
+    });
+}
+
+static bool rest_spent(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    int32_t nOutput;
+    uint256 txid;
+    if (path.size() != 2 || !ParseHashStr(path[0], txid) || !ParseInt32(path[1], &nOutput) || nOutput < 0)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Use /rest/spent/<txid>/<n>.<ext>.");
+
+    // Spends in the mempool are looked at too
+    if (RESTNotModified(req, TipETag() + "-" + std::to_string(mempool.GetTransactionsUpdated())))
+        return true;
+
+    CSpentIndexKey key(txid, nOutput);
+    CSpentIndexValue value;
+    if (!GetSpentIndex(key, value))
+        return RESTERR(req, HTTP_NOT_FOUND, "Unable to get spent info");
+
+    CDataStream ssData(SER_NETWORK, PROTOCOL_VERSION);
+    ssData << value;
+
+    return RESTWriteData(req, rf, ssData, [&value]() {
+        UniValue result(UniValue::VOBJ);
+        result.push_back(Pair("txid", value.txid.GetHex()));
+        result.push_back(Pair("index", (int)value.inputIndex));
+        result.push_back(Pair("height", value.blockHeight));
+        return result;
+    });
+}
+
+static bool rest_ghostnodes(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+
+    // The list changes without the tip changing, so it isn't tagged
+    std::shared_ptr<const std::vector<CGhostnode> > pGhostnodes = mnodeman.GetFullGhostnodeVector();
+
+    CDataStream ssData(SER_NETWORK, PROTOCOL_VERSION);
+    ssData << *pGhostnodes;
+
+    return RESTWriteData(req, rf, ssData, [&pGhostnodes]() {
+        UniValue result(UniValue::VARR);
+        for (const CGhostnode& mn : *pGhostnodes) {
+            UniValue obj(UniValue::VOBJ);
+            obj.push_back(Pair("outpoint", mn.vin.prevout.ToStringShort()));
+            obj.push_back(Pair("status", mn.GetStatus()));
+            obj.push_back(Pair("protocol", mn.nProtocolVersion));
+            obj.push_back(Pair("payee", CBitcoinAddress(mn.pubKeyCollateralAddress.GetID()).ToString()));
+            obj.push_back(Pair("lastseen", (int64_t)mn.lastPing.sigTime));
+            obj.push_back(Pair("activeseconds", (int64_t)(mn.lastPing.sigTime - mn.sigTime)));
+            obj.push_back(Pair("lastpaidtime", mn.GetLastPaidTime()));
+            obj.push_back(Pair("lastpaidblock", mn.GetLastPaidBlock()));
+            obj.push_back(Pair("addr", mn.addr.ToString()));
+            result.push_back(obj);
+        }
+        return result;
+    });
+}
+
+static bool rest_zerocoin_block(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string hashStr;
+    const RetFormat rf = ParseDataFormat(hashStr, strURIPart);
+
+    uint256 hash;
+    if (!ParseHashStr(hashStr, hash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
+
+    // The mints of a block never change, the block hash is tag enough
+    if (RESTNotModified(req, "\"" + hashStr + "\""))
+        return true;
+
+    std::map<std::pair<int,int>, std::vector<CBigNum>> mints;
+    if (!pzerocoindb || !pzerocoindb->ReadBlockMints(hash, mints))
+        return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+
+    CDataStream ssData(SER_NETWORK, PROTOCOL_VERSION);
+    ssData << mints;
+
+    return RESTWriteData(req, rf, ssData, [&mints]() {
+        UniValue result(UniValue::VARR);
+        for (const auto& group : mints) {
+            UniValue obj(UniValue::VOBJ);
+            obj.push_back(Pair("denomination", group.first.first));
+            obj.push_back(Pair("id", group.first.second));
+            UniValue pubcoins(UniValue::VARR);
+            for (const CBigNum& pubCoin : group.second)
+                pubcoins.push_back(pubCoin.GetHex());
+            obj.push_back(Pair("pubcoins", pubcoins));
+            result.push_back(obj);
+        }
+        return result;
+    });
+}
+
+static bool rest_zerocoin_pubcoin(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string pubCoinStr;
+    const RetFormat rf = ParseDataFormat(pubCoinStr, strURIPart);
+
+    if (pubCoinStr.empty() || pubCoinStr.size() > MAX_REST_ZEROCOIN_PUBCOIN_SIZE || !IsHex(pubCoinStr))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid public coin: " + pubCoinStr);
+    CBigNum pubCoin;
+    pubCoin.SetHex(pubCoinStr);
+
+    if (RESTNotModified(req, TipETag()))
+        return true;
+
+    std::vector<CZerocoinMintInfo> info;
+    if (!pzerocoindb || !pzerocoindb->ReadMintInfo(pubCoin, info))
+        return RESTERR(req, HTTP_NOT_FOUND, pubCoinStr + " not found");
+
+    CDataStream ssData(SER_NETWORK, PROTOCOL_VERSION);
+    ssData << info;
+
+    return RESTWriteData(req, rf, ssData, [&info]() {
+        // Mints from blocks no longer in the active chain are recorded too
+        std::shared_ptr<const CChainSnapshot> chain = GetChainSnapshot();
+        UniValue result(UniValue::VARR);
+        for (const CZerocoinMintInfo& mint : info) {
+            const CBlockIndex* pindex = (*chain)[mint.nHeight];
+            UniValue obj(UniValue::VOBJ);
+            obj.push_back(Pair("denomination", mint.denomination));
+            obj.push_back(Pair("id", mint.id));
+            obj.push_back(Pair("height", mint.nHeight));
+            obj.push_back(Pair("blockhash", mint.blockHash.GetHex()));
+            obj.push_back(Pair("mainchain", pindex && pindex->GetBlockHash() == mint.blockHash));
+            result.push_back(obj);
+        }
+        return result;
+    });
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(HTTPRequest* req, const std::string& strReq);
@@ -582,12 +867,21 @@ static const struct {
       {"/rest/mempool/contents", rest_mempool_contents},
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
+      {"/rest/address/utxos/", rest_address_utxos},
+      {"/rest/address/", rest_address},
+      {"/rest/spent/", rest_spent},
+      {"/rest/ghostnodes", rest_ghostnodes},
+      {"/rest/zerocoin/block/", rest_zerocoin_block},
+      {"/rest/zerocoin/pubcoin/", rest_zerocoin_pubcoin},
 };
 
 bool StartREST()
 {
-    for (unsigned int i = 0; i < ARRAYLEN(uri_prefixes); i++)
+    for (unsigned int i = 0; i < ARRAYLEN(uri_prefixes); i++) {
+        // Don't let REST queries hold up the RPC calls
+        SetHTTPWorkPriority(uri_prefixes[i].prefix, HTTPWorkPriority::BULK);
         RegisterHTTPHandler(uri_prefixes[i].prefix, false, uri_prefixes[i].handler);
+    }
     return true;
 }
 
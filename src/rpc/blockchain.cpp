@@ -6,6 +6,8 @@
 #include <rpc/blockchain.h>
 
 #include <amount.h>
+#include <blockconnectstats.h>
+#include <blockfilter.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
@@ -24,8 +26,10 @@
 #include <util.h>
 #include <utilstrencodings.h>
 #include <hash.h>
+#include <index/blockfilterindex.h>
 #include <validationinterface.h>
 #include <warnings.h>
+#include <zerocoin/zerocoin.h>
 
 #include <stdint.h>
 
@@ -171,8 +175,7 @@ UniValue getblockcount(const JSONRPCRequest& request)
             + HelpExampleRpc("getblockcount", "")
         );
 
-    LOCK(cs_main);
-    return chainActive.Height();
+    return GetChainSnapshot()->Height();
 }
 
 UniValue getbestblockhash(const JSONRPCRequest& request)
@@ -188,8 +191,8 @@ UniValue getbestblockhash(const JSONRPCRequest& request)
             + HelpExampleRpc("getbestblockhash", "")
         );
 
-    LOCK(cs_main);
-    return chainActive.Tip()->GetBlockHash().GetHex();
+    std::shared_ptr<const CChainSnapshot> chain = GetChainSnapshot();
+    return chain->Tip()->GetBlockHash().GetHex();
 }
 
 void RPCNotifyBlockChange(bool ibd, const CBlockIndex * pindex)
@@ -352,8 +355,8 @@ UniValue getdifficulty(const JSONRPCRequest& request)
             + HelpExampleRpc("getdifficulty", "")
         );
 
-    LOCK(cs_main);
-    return GetDifficulty();
+    std::shared_ptr<const CChainSnapshot> chain = GetChainSnapshot();
+    return chain->Tip() ? GetDifficulty(chain->Tip()) : 1.0;
 }
 
 std::string EntryDescriptionString()
@@ -677,13 +680,13 @@ UniValue getblockhash(const JSONRPCRequest& request)
             + HelpExampleRpc("getblockhash", "1000")
         );
 
-    LOCK(cs_main);
+    std::shared_ptr<const CChainSnapshot> chain = GetChainSnapshot();
 
     int nHeight = request.params[0].get_int();
-    if (nHeight < 0 || nHeight > chainActive.Height())
+    if (nHeight < 0 || nHeight > chain->Height())
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
 
-    CBlockIndex* pblockindex = chainActive[nHeight];
+    const CBlockIndex* pblockindex = (*chain)[nHeight];
     return pblockindex->GetBlockHash().GetHex();
 }
 
@@ -948,9 +951,9 @@ UniValue pruneblockchain(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_MISC_ERROR, "Blockchain is too short for pruning.");
     else if (height > chainHeight)
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Blockchain is shorter than the attempted prune height.");
-    else if (height > chainHeight - MIN_BLOCKS_TO_KEEP) {
+    else if (height + GetPruneMinBlocksToKeep() > chainHeight) {
         LogPrint(BCLog::RPC, "Attempt to prune blocks close to the tip.  Retaining the minimum number of blocks.");
-        height = chainHeight - MIN_BLOCKS_TO_KEEP;
+        height = chainHeight - std::min(chainHeight, GetPruneMinBlocksToKeep());
     }
 
     PruneBlockFilesManual(height);
@@ -1646,6 +1649,348 @@ UniValue savemempool(const JSONRPCRequest& request)
     return NullUniValue;
 }
 
+UniValue dumptxoutset(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1) {
+        throw std::runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrite the unspent transaction output set of the chain tip to disk.\n"
+            "The file starts with a header naming the file format, the network, the block the set\n"
+            "belongs to and the number of coins, followed by every coin with its outpoint, in the\n"
+            "order of the chainstate database. Zerocoin and ghostnode state are not included.\n"
+            "\nArguments:\n"
+            "1. \"path\"    (string, required) Path to the output file. Relative paths are prefixed by the data directory.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"coins_written\": n,         (numeric) The number of coins written to the file\n"
+            "  \"base_hash\": \"hash\",        (string) The hash of the block the set belongs to\n"
+            "  \"base_height\": n,           (numeric) The height of that block\n"
+            "  \"hash_serialized_2\": \"hash\", (string) The serialized hash of the set, as in gettxoutsetinfo\n"
+            "  \"path\": \"path\"              (string) The absolute path of the file\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("dumptxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("dumptxoutset", "\"utxo.dat\"")
+        );
+    }
+
+    fs::path path = fs::absolute(request.params[0].get_str(), GetDataDir());
+    // Write to a temporary file and move it into place once it is complete
+    fs::path temppath = path.string() + ".incomplete";
+    if (fs::exists(path)) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists. If you are sure this is what you want, move it out of the way first");
+    }
+
+    CAutoFile afile(fsbridge::fopen(temppath, "wb"), SER_DISK, CLIENT_VERSION);
+    if (afile.IsNull()) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Unable to open " + temppath.string() + " for writing");
+    }
+
+    std::unique_ptr<CCoinsViewCursor> pcursor;
+    CCoinsStats stats;
+    uint64_t nCoinsWritten = 0;
+    try {
+        {
+            // The cursor and the statistics have to see the same chainstate
+            LOCK(cs_main);
+            FlushStateToDisk();
+            pcursor.reset(pcoinsdbview->Cursor());
+            if (!GetUTXOStats(pcoinsdbview.get(), stats)) {
+                throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+            }
+        }
+        assert(pcursor->GetBestBlock() == stats.hashBlock);
+
+        afile << CTxOutSetDumpHeader(Params(), stats.hashBlock, stats.nTransactionOutputs);
+
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            COutPoint key;
+            Coin coin;
+            if (!pcursor->GetKey(key) || !pcursor->GetValue(coin)) {
+                throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+            }
+            afile << key;
+            afile << coin;
+            nCoinsWritten++;
+            pcursor->Next();
+        }
+        afile.fclose();
+        if (nCoinsWritten != stats.nTransactionOutputs || !RenameOver(temppath, path)) {
+            throw JSONRPCError(RPC_MISC_ERROR, "Unable to write " + path.string());
+        }
+    } catch (...) {
+        // Don't leave a partial dump behind
+        afile.fclose();
+        try {
+            fs::remove(temppath);
+        } catch (const fs::filesystem_error& e) {
+            LogPrintf("%s: Unable to remove %s: %s\n", __func__, temppath.string(), e.what());
+        }
+        throw;
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("coins_written", (int64_t)nCoinsWritten));
+    ret.push_back(Pair("base_hash", stats.hashBlock.GetHex()));
+    ret.push_back(Pair("base_height", (int64_t)stats.nHeight));
+    ret.push_back(Pair("hash_serialized_2", stats.hashSerialized.GetHex()));
+    ret.push_back(Pair("path", path.string()));
+    return ret;
+}
+
+UniValue getblockconnectstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+            "getblockconnectstats ( reset )\n"
+            "Returns how long each phase of connecting blocks to the chain took, since startup or the last reset.\n"
+            "The phases nest: connecttip holds readblock, prefetch, connectblock, flushview, writechainstate and postconnect,\n"
+            "connectblock holds checkblock, forkchecks, verifyscripts, connectghost and writeindex, and verifyscripts holds\n"
+            "connecttxs and ghostnodepayments. zerocoinchecks is counted wherever CheckBlock checks a block's transactions.\n"
+            "\nArguments:\n"
+            "1. reset    (boolean, optional, default=false) Clear the statistics after returning them\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"phase\": \"xxxx\",        (string) The phase\n"
+            "    \"count\": xxxxx,         (numeric) Number of times it completed\n"
+            "    \"total\": xxxxx,         (numeric) Total time spent in it, in microseconds\n"
+            "    \"max\": xxxxx,           (numeric) Longest time, in microseconds\n"
+            "    \"histogram\": [ n, ... ] (array) Number of times below 1, 2, 4, ... microseconds, each element\n"
+            "                              counts the times between the previous bound and its own\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getblockconnectstats", "")
+            + HelpExampleRpc("getblockconnectstats", "")
+        );
+
+    bool fReset = !request.params[0].isNull() && request.params[0].get_bool();
+
+    UniValue ret(UniValue::VARR);
+    for (const ConnectPhaseStats& stats : GetBlockConnectStats(fReset)) {
+        int nLast = CONNECT_PHASE_BUCKETS - 1;
+        while (nLast > 0 && stats.histogram[nLast] == 0)
+            nLast--;
+        UniValue histogram(UniValue::VARR);
+        for (int i = 0; i <= nLast; i++)
+            histogram.push_back(stats.histogram[i]);
+
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("phase", ConnectPhaseName(stats.phase)));
+        obj.push_back(Pair("count", stats.nCount));
+        obj.push_back(Pair("total", stats.nTotalMicros));
+        obj.push_back(Pair("max", stats.nMaxMicros));
+        obj.push_back(Pair("histogram", histogram));
+        ret.push_back(obj);
+    }
+    return ret;
+}
+
+UniValue getdbstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getdbstats\n"
+            "Returns the settings and LevelDB statistics of each open database.\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"name\": \"xxxx\",          (string) Path of the database below the data directory, as -dboption names it\n"
+            "    \"bloombits\": n,          (numeric) Bloom filter bits per key, 0 for no filter\n"
+            "    \"maxopenfiles\": n,       (numeric) Number of table files kept open\n"
+            "    \"blocksize\": n,          (numeric) Size of a table block in bytes\n"
+            "    \"compression\": true|false, (boolean) Whether table blocks are compressed\n"
+            "    \"memory\": n,             (numeric) Approximate bytes used by the write buffers and the block cache\n"
+            "    \"files\": [ n, ... ],     (array) Number of table files at each level, from level 0\n"
+            "    \"stats\": \"xxxx\"          (string) Compaction statistics of each level, as printed by LevelDB\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getdbstats", "")
+            + HelpExampleRpc("getdbstats", "")
+        );
+
+    UniValue ret(UniValue::VARR);
+    ForEachDatabase([&ret](const CDBWrapper& db) {
+        const CDBOptions& dbOptions = db.GetDBOptions();
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("name", db.GetName()));
+        obj.push_back(Pair("bloombits", dbOptions.nBloomBitsPerKey));
+        obj.push_back(Pair("maxopenfiles", dbOptions.nMaxOpenFiles));
+        obj.push_back(Pair("blocksize", (uint64_t)dbOptions.nBlockSize));
+        obj.push_back(Pair("compression", dbOptions.fCompression));
+
+        std::string strValue;
+        uint64_t nMemory = 0;
+        if (db.GetProperty("leveldb.approximate-memory-usage", strValue))
+            ParseUInt64(strValue, &nMemory);
+        obj.push_back(Pair("memory", nMemory));
+        UniValue files(UniValue::VARR);
+        for (int nLevel = 0; db.GetProperty(strprintf("leveldb.num-files-at-level%d", nLevel), strValue); nLevel++) {
+            uint64_t nFiles = 0;
+            ParseUInt64(strValue, &nFiles);
+            files.push_back(nFiles);
+        }
+        obj.push_back(Pair("files", files));
+        if (!db.GetProperty("leveldb.stats", strValue))
+            strValue.clear();
+        obj.push_back(Pair("stats", strValue));
+        ret.push_back(obj);
+    });
+    return ret;
+}
+
+UniValue getblockfilter(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            "getblockfilter \"blockhash\" ( \"filtertype\" )\n"
+            "\nRetrieve a BIP 157 content filter for a particular block. Requires -blockfilterindex.\n"
+            "\nArguments:\n"
+            "1. \"blockhash\"   (string, required) The hash of the block\n"
+            "2. \"filtertype\"  (string, optional, default=\"basic\") The type name of the filter\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"filter\" : \"hex\",  (string) the hex-encoded filter data\n"
+            "  \"header\" : \"hash\"  (string) the hex-encoded filter header\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\" \"basic\"")
+            + HelpExampleRpc("getblockfilter", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\", \"basic\"")
+        );
+
+    uint256 block_hash = ParseHashV(request.params[0], "blockhash");
+    std::string filtertype_name = "basic";
+    if (!request.params[1].isNull()) {
+        filtertype_name = request.params[1].get_str();
+    }
+
+    BlockFilterType filtertype;
+    if (!BlockFilterTypeByName(filtertype_name, filtertype)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown filtertype");
+    }
+
+    if (!g_blockfilterindex || g_blockfilterindex->GetFilterType() != filtertype) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Index is not enabled for filtertype " + filtertype_name);
+    }
+
+    const CBlockIndex* block_index;
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator it = mapBlockIndex.find(block_hash);
+        if (it == mapBlockIndex.end()) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        }
+        block_index = it->second;
+    }
+
+    BlockFilter filter;
+    uint256 filter_header;
+    if (!g_blockfilterindex->LookupFilter(block_index, filter) ||
+        !g_blockfilterindex->LookupFilterHeader(block_index, filter_header)) {
+        if (!g_blockfilterindex->BlockUntilSyncedToCurrentChain()) {
+            throw JSONRPCError(RPC_MISC_ERROR, "Block filters are still in the process of being indexed.");
+        }
+        throw JSONRPCError(RPC_MISC_ERROR, "Filter not found. Block was not connected to the active chain.");
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("filter", HexStr(filter.GetEncodedFilter())));
+    ret.push_back(Pair("header", filter_header.GetHex()));
+    return ret;
+}
+
+/** Most blocks with mints getzcwitnessdata returns per call */
+static const size_t MAX_ZEROCOIN_WITNESS_DATA_BLOCKS = 1000;
+
+UniValue getzcwitnessdata(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 3 || request.params.size() > 4)
+        throw std::runtime_error(
+            "getzcwitnessdata denomination id fromheight ( toheight )\n"
+            "\nReturns what a wallet needs to bring the accumulator witnesses of its zerocoin mints forward, without the\n"
+            "full set of coins minted in the group: the accumulator value of the group before fromheight and the coins\n"
+            "minted in each later block, with the accumulator value after it. A witness is the accumulator value before\n"
+            "the block of its coin with every other coin minted since added to it. At most "
+            + std::to_string(MAX_ZEROCOIN_WITNESS_DATA_BLOCKS) + " blocks are returned,\n"
+            "continue from nextheight for more.\n"
+            "\nArguments:\n"
+            "1. denomination    (numeric, required) The coin denomination\n"
+            "2. id              (numeric, required) The coin group id\n"
+            "3. fromheight      (numeric, required) The first block height to return mints of\n"
+            "4. toheight        (numeric, optional, default=tip) The last block height to return mints of\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"checkpoint\": \"hex\",        (string) The accumulator value before fromheight\n"
+            "  \"checkpointhash\": \"hash\",   (string) The block the checkpoint value is from, absent if no coins were minted before\n"
+            "  \"blocks\": [\n"
+            "    {\n"
+            "      \"height\": n,              (numeric) The block height\n"
+            "      \"hash\": \"hash\",           (string) The block hash\n"
+            "      \"accumulator\": \"hex\",     (string) The accumulator value after the block\n"
+            "      \"mints\": [\"hex\", ...]     (array) The public coins of the group minted in the block\n"
+            "    }, ...\n"
+            "  ],\n"
+            "  \"nextheight\": n            (numeric) The height to continue from, absent if the range is complete\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getzcwitnessdata", "10 1 150000")
+            + HelpExampleRpc("getzcwitnessdata", "10, 1, 150000")
+        );
+
+    int denomination = request.params[0].get_int();
+    int id = request.params[1].get_int();
+    int fromHeight = request.params[2].get_int();
+
+    LOCK(cs_main);
+
+    int toHeight = chainActive.Height();
+    if (!request.params[3].isNull())
+        toHeight = std::min(request.params[3].get_int(), toHeight);
+    if (fromHeight < 0 || fromHeight > toHeight)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+
+    CBigNum checkpoint;
+    CBlockIndex *checkpointBlock;
+    std::vector<CZerocoinState::WitnessBlock> blocks;
+    if (!CZerocoinState::GetZerocoinState()->GetWitnessData(&chainActive, denomination, id, fromHeight, toHeight,
+                                                            MAX_ZEROCOIN_WITNESS_DATA_BLOCKS + 1, checkpoint, checkpointBlock, blocks))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "No coins minted with this denomination and id");
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("checkpoint", checkpoint.GetHex()));
+    if (checkpointBlock)
+        ret.push_back(Pair("checkpointhash", checkpointBlock->GetBlockHash().GetHex()));
+
+    // The extra block only tells where the next call continues
+    int nextHeight = -1;
+    if (blocks.size() > MAX_ZEROCOIN_WITNESS_DATA_BLOCKS) {
+        nextHeight = blocks.back().index->nHeight;
+        blocks.pop_back();
+    }
+
+    UniValue blocksArr(UniValue::VARR);
+    for (const CZerocoinState::WitnessBlock &block : blocks) {
+        UniValue blockObj(UniValue::VOBJ);
+        blockObj.push_back(Pair("height", block.index->nHeight));
+        blockObj.push_back(Pair("hash", block.index->GetBlockHash().GetHex()));
+        blockObj.push_back(Pair("accumulator", block.accumulator.GetHex()));
+        UniValue mints(UniValue::VARR);
+        for (const CBigNum &mint : block.mints)
+            mints.push_back(mint.GetHex());
+        blockObj.push_back(Pair("mints", mints));
+        blocksArr.push_back(blockObj);
+    }
+    ret.push_back(Pair("blocks", blocksArr));
+    if (nextHeight >= 0)
+        ret.push_back(Pair("nextheight", nextHeight));
+    return ret;
+}
+
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
@@ -1657,6 +2002,7 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getblockhashes",         &getblockhashes,         {"high","low"}  },
     { "blockchain",         "getblockhash",           &getblockhash,           {"height"} },
     { "blockchain",         "getblockheader",         &getblockheader,         {"blockhash","verbose"} },
+    { "blockchain",         "getblockfilter",         &getblockfilter,         {"blockhash","filtertype"} },
     { "blockchain",         "getchaintips",           &getchaintips,           {} },
     { "blockchain",         "getdifficulty",          &getdifficulty,          {} },
     { "blockchain",         "getmempoolancestors",    &getmempoolancestors,    {"txid","verbose"} },
@@ -1668,7 +2014,11 @@ static const CRPCCommand commands[] =
     { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        {"height"} },
     { "blockchain",         "savemempool",            &savemempool,            {} },
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           {"path"} },
     { "blockchain",         "verifychain",            &verifychain,            {"checklevel","nblocks"} },
+    { "blockchain",         "getblockconnectstats",   &getblockconnectstats,   {"reset"} },
+    { "blockchain",         "getdbstats",             &getdbstats,             {} },
+    { "blockchain",         "getzcwitnessdata",       &getzcwitnessdata,       {"denomination","id","fromheight","toheight"} },
 
     { "blockchain",         "preciousblock",          &preciousblock,          {"blockhash"} },
 
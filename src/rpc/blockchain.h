@@ -5,6 +5,12 @@
 #ifndef BITCOIN_RPC_BLOCKCHAIN_H
 #define BITCOIN_RPC_BLOCKCHAIN_H
 
+#include <chainparams.h>
+#include <serialize.h>
+#include <uint256.h>
+
+#include <string.h>
+
 class CBlock;
 class CBlockIndex;
 class UniValue;
@@ -33,5 +39,56 @@ UniValue mempoolToJSON(bool fVerbose = false);
 /** Block header to JSON */
 UniValue blockheaderToJSON(const CBlockIndex* blockindex);
 
+/**
+ * Header of the files written by dumptxoutset: the file format, the network and the
+ * block the coins that follow belong to.
+ */
+class CTxOutSetDumpHeader
+{
+public:
+    //! "utxo" in the first bytes of the file
+    static const uint32_t FILE_MAGIC = 0x6f787475;
+    static const uint16_t CURRENT_VERSION = 1;
+
+    uint32_t nMagic;
+    uint16_t nVersion;
+    CMessageHeader::MessageStartChars pchMessageStart;
+    uint256 hashGenesisBlock;
+    uint256 hashBlock;
+    uint64_t nCoins;
+
+    CTxOutSetDumpHeader() : nMagic(0), nVersion(0), nCoins(0)
+    {
+        memset(pchMessageStart, 0, sizeof(pchMessageStart));
+    }
+
+    CTxOutSetDumpHeader(const CChainParams& params, const uint256& hashBlockIn, uint64_t nCoinsIn) :
+        nMagic(FILE_MAGIC), nVersion(CURRENT_VERSION), hashGenesisBlock(params.GetConsensus().hashGenesisBlock),
+        hashBlock(hashBlockIn), nCoins(nCoinsIn)
+    {
+        memcpy(pchMessageStart, params.MessageStart(), sizeof(pchMessageStart));
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nMagic);
+        READWRITE(nVersion);
+        READWRITE(FLATDATA(pchMessageStart));
+        READWRITE(hashGenesisBlock);
+        READWRITE(hashBlock);
+        READWRITE(nCoins);
+    }
+
+    /** Whether this is a dump in the current format, made on the network of params */
+    bool IsValid(const CChainParams& params) const
+    {
+        return nMagic == FILE_MAGIC && nVersion == CURRENT_VERSION &&
+            memcmp(pchMessageStart, params.MessageStart(), sizeof(pchMessageStart)) == 0 &&
+            hashGenesisBlock == params.GetConsensus().hashGenesisBlock;
+    }
+};
+
 #endif
 
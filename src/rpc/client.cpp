@@ -85,6 +85,10 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "getblock", 1, "verbose" },
     { "getblockheader", 1, "verbose" },
     { "getchaintxstats", 0, "nblocks" },
+    { "getzcwitnessdata", 0, "denomination" },
+    { "getzcwitnessdata", 1, "id" },
+    { "getzcwitnessdata", 2, "fromheight" },
+    { "getzcwitnessdata", 3, "toheight" },
     { "gettransaction", 1, "include_watchonly" },
     { "getrawtransaction", 1, "verbose" },
     { "createrawtransaction", 0, "inputs" },
@@ -138,6 +142,9 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "bumpfee", 1, "options" },
     { "logging", 0, "include" },
     { "logging", 1, "exclude" },
+    { "getlockstats", 0, "reset" },
+    { "dumpprofile", 0, "reset" },
+    { "getblockconnectstats", 0, "reset" },
     { "disconnectnode", 1, "nodeid" },
     { "addwitnessaddress", 1, "p2sh" },
     // Echo with conversion (For testing only)
@@ -169,6 +176,9 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "liststealthaddresses", 0, "show_secrets"},
     { "enabletor", 0 ,""},
     { "torstatus", 0, ""},
+
+    //Ghostnode commands
+    { "getghostnodestats", 0, "reset"},
 };
 
 class CRPCConvertTable
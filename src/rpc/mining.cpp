@@ -7,10 +7,12 @@
 #include <amount.h>
 #include <chain.h>
 #include <chainparams.h>
+#include <coinbasepayouts.h>
 #include <consensus/consensus.h>
 #include <consensus/params.h>
 #include <consensus/validation.h>
 #include <core_io.h>
+#include <hash.h>
 #include <init.h>
 #include <validation.h>
 #include <miner.h>
@@ -25,12 +27,13 @@
 #include <utilstrencodings.h>
 #include <validationinterface.h>
 #include <warnings.h>
-#include <consensus/airdropaddresses.h>
 
 #ifdef ENABLE_WALLET
     #include "ghostnode/ghostnode-sync.h"
 #endif
+#include <list>
 #include <memory>
+#include <mutex>
 #include <stdint.h>
 
 unsigned int ParseConfirmTarget(const UniValue& value)
@@ -119,6 +122,9 @@ UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGen
         nHeightEnd = nHeight+nGenerate;
     }
     unsigned int nExtraNonce = 0;
+    int nThreads = gArgs.GetArg("-genproclimit", DEFAULT_GENERATE_THREADS);
+    if (nThreads <= 0)
+        nThreads = GetNumCores();
     UniValue blockHashes(UniValue::VARR);
     while (nHeight < nHeightEnd)
     {
@@ -130,14 +136,10 @@ UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGen
             LOCK(cs_main);
             IncrementExtraNonce(pblock, chainActive.Tip(), nExtraNonce);
         }
-        while (nMaxTries > 0 && pblock->nNonce < nInnerLoopCount && !CheckProofOfWork(pblock->GetPoWHash(nHeight+1), pblock->nBits, Params().GetConsensus())) {
-            ++pblock->nNonce;
-            --nMaxTries;
-        }
-        if (nMaxTries == 0) {
-            break;
-        }
-        if (pblock->nNonce == nInnerLoopCount) {
+        if (!ScanNonces(pblock, nHeight+1, nInnerLoopCount, nMaxTries, nThreads, Params().GetConsensus())) {
+            if (nMaxTries == 0) {
+                break;
+            }
             continue;
         }
         std::shared_ptr<const CBlock> shared_pblock = std::make_shared<const CBlock>(*pblock);
@@ -202,6 +204,7 @@ UniValue getmininginfo(const JSONRPCRequest& request)
             "  \"currentblocktx\": nnn,     (numeric) The last block transaction\n"
             "  \"difficulty\": xxx.xxxxx    (numeric) The current difficulty\n"
             "  \"networkhashps\": nnn,      (numeric) The network hashes per second\n"
+            "  \"hashespersec\": nnn,       (numeric) The average hashes per second of the generate RPCs while they were running\n"
             "  \"pooledtx\": n              (numeric) The size of the mempool\n"
             "  \"chain\": \"xxxx\",           (string) current network name as defined in BIP70 (main, test, regtest)\n"
             "  \"warnings\": \"...\"          (string) any network and blockchain warnings\n"
@@ -221,6 +224,7 @@ UniValue getmininginfo(const JSONRPCRequest& request)
     obj.push_back(Pair("currentblocktx",   (uint64_t)nLastBlockTx));
     obj.push_back(Pair("difficulty",       (double)GetDifficulty()));
     obj.push_back(Pair("networkhashps",    getnetworkhashps(request)));
+    obj.push_back(Pair("hashespersec",     GetMinerHashesPerSec()));
     obj.push_back(Pair("pooledtx",         (uint64_t)mempool.size()));
     obj.push_back(Pair("chain",            Params().NetworkIDString()));
     if (IsDeprecatedRPCEnabled("getmininginfo")) {
@@ -295,6 +299,62 @@ std::string gbt_vb_name(const Consensus::DeploymentPos pos) {
     return s;
 }
 
+namespace {
+/** How many of the templates getblocktemplate handed out last it can send a diff against */
+static const unsigned int MAX_RECENT_TEMPLATES = 16;
+
+/**
+ * Memory pool changes since the last block template was built. Transactions added to the pool are
+ * appended to the template instead of rebuilding it, any removal makes the template stale.
+ */
+class CBlockTemplateUpdates
+{
+private:
+    std::mutex cs;
+    std::vector<uint256> vAdded;
+    bool fStale;
+
+    void EntryAdded(CTransactionRef tx)
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        if (!fStale)
+            vAdded.push_back(tx->GetHash());
+    }
+
+    void EntryRemoved(CTransactionRef tx, MemPoolRemovalReason reason)
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        fStale = true;
+        vAdded.clear();
+    }
+
+public:
+    CBlockTemplateUpdates() : fStale(true)
+    {
+        // Never disconnected, the memory pool outlives every RPC call
+        mempool.NotifyEntryAdded.connect([this](CTransactionRef tx) { EntryAdded(tx); });
+        mempool.NotifyEntryRemoved.connect([this](CTransactionRef tx, MemPoolRemovalReason reason) { EntryRemoved(tx, reason); });
+    }
+
+    //! Start tracking changes for a freshly built template
+    void Reset()
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        fStale = false;
+        vAdded.clear();
+    }
+
+    //! Transactions added since the last call, or false if the template has to be rebuilt
+    bool TakeAdded(std::vector<uint256>& vAddedOut)
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        vAddedOut.swap(vAdded);
+        vAdded.clear();
+        return !fStale;
+    }
+};
+} // namespace
+
 UniValue getblocktemplate(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() > 1)
@@ -319,7 +379,9 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
             "       \"rules\":[            (array, optional) A list of strings\n"
             "           \"support\"          (string) client side supported softfork deployment\n"
             "           ,...\n"
-            "       ]\n"
+            "       ],\n"
+            "       \"diffsince\":\"xxxx\"   (string, optional) The templateid of a template the client still has, the data of the transactions\n"
+            "                              that were in it is left out, and the transactions that are no longer in are listed in 'removed'\n"
             "     }\n"
             "\n"
 
@@ -335,7 +397,7 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
             "  \"previousblockhash\" : \"xxxx\",     (string) The hash of current highest block\n"
             "  \"transactions\" : [                (array) contents of non-coinbase transactions that should be included in the next block\n"
             "      {\n"
-            "         \"data\" : \"xxxx\",             (string) transaction data encoded in hexadecimal (byte-for-byte)\n"
+            "         \"data\" : \"xxxx\",             (string) transaction data encoded in hexadecimal (byte-for-byte), left out if the transaction was in the 'diffsince' template\n"
             "         \"txid\" : \"xxxx\",             (string) transaction id encoded in little-endian hexadecimal\n"
             "         \"hash\" : \"xxxx\",             (string) hash encoded in little-endian hexadecimal (including witness data)\n"
             "         \"depends\" : [                (array) array of numbers \n"
@@ -349,6 +411,9 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
             "      }\n"
             "      ,...\n"
             "  ],\n"
+            "  \"templateid\" : \"xxxx\",            (string) Identifies the transactions of this template, for 'diffsince'\n"
+            "  \"diffsince\" : \"xxxx\",             (string) The 'diffsince' templateid, only present if the template is a diff against it\n"
+            "  \"removed\" : [ \"txid\", ... ],      (array of strings) The transactions of the 'diffsince' template that are not in this one\n"
             "  \"coinbaseaux\" : {                 (json object) data that should be included in the coinbase's scriptSig content\n"
             "      \"flags\" : \"xx\"                  (string) key name is to be ignored, and value included in scriptSig\n"
             "  },\n"
@@ -384,6 +449,7 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
 
     std::string strMode = "template";
     UniValue lpval = NullUniValue;
+    uint256 hashDiffSince;
     std::set<std::string> setClientRules;
     int64_t nMaxVersionPreVB = -1;
     if (!request.params[0].isNull())
@@ -399,6 +465,9 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
         else
             throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid mode");
         lpval = find_value(oparam, "longpollid");
+        const UniValue& diffval = find_value(oparam, "diffsince");
+        if (!diffval.isNull())
+            hashDiffSince = ParseHashV(diffval, "diffsince");
 
         if (strMode == "proposal")
         {
@@ -518,12 +587,34 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
     // Update block
     static CBlockIndex* pindexPrev;
     static int64_t nStart;
+    static std::unique_ptr<BlockAssembler> assembler;
     static std::unique_ptr<CBlockTemplate> pblocktemplate;
+    static CBlockTemplateUpdates templateUpdates;
+    // Set when a new mempool transaction did not fit, so a rebuild could select better ones
+    static bool fTemplateFull = false;
     // Cache whether the last invocation was with segwit support, to avoid returning
     // a segwit-block to a non-segwit caller.
     static bool fLastTemplateSupportsSegwit = true;
-    if (pindexPrev != chainActive.Tip() ||
-        (mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5) ||
+
+    // Append transactions that entered the mempool since the template was built
+    std::vector<uint256> vAdded;
+    bool fTemplateCurrent = templateUpdates.TakeAdded(vAdded);
+    if (pindexPrev == chainActive.Tip() && fTemplateCurrent && pblocktemplate) {
+        LOCK(mempool.cs);
+        std::vector<CTxMemPool::txiter> vAddedIters;
+        for (const uint256& hash : vAdded) {
+            CTxMemPool::txiter it = mempool.mapTx.find(hash);
+            if (it != mempool.mapTx.end())
+                vAddedIters.push_back(it);
+        }
+        if (!vAddedIters.empty() && !assembler->AddMempoolTxs(vAddedIters))
+            fTemplateFull = true;
+        if (!fTemplateFull)
+            nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
+    }
+
+    if (pindexPrev != chainActive.Tip() || !fTemplateCurrent ||
+        (fTemplateFull && mempool.GetTransactionsUpdated() != nTransactionsUpdatedLast && GetTime() - nStart > 5) ||
         fLastTemplateSupportsSegwit != fSupportsSegwit)
     {
         // Clear pindexPrev so future calls make a new block, despite any failures from here on
@@ -537,7 +628,10 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
 
         // Create new block
         CScript scriptDummy = CScript() << OP_TRUE;
-        pblocktemplate = BlockAssembler(Params()).CreateNewBlock(scriptDummy, fSupportsSegwit);
+        templateUpdates.Reset();
+        fTemplateFull = false;
+        assembler.reset(new BlockAssembler(Params()));
+        pblocktemplate = assembler->CreateNewBlock(scriptDummy, fSupportsSegwit);
         if (!pblocktemplate)
             throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
 
@@ -556,7 +650,41 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
 
     UniValue aCaps(UniValue::VARR); aCaps.push_back("proposal");
 
+    // Transactions of the templates recently handed out, by templateid, for clients asking for a diff against one
+    static std::list<std::pair<uint256, std::vector<uint256> > > lRecentTemplates;
+    // Hex of the transactions of the last template, a zerocoin spend alone is several kilobytes of it
+    static std::map<uint256, std::string> mapTemplateTxHex;
+
+    std::vector<uint256> vTemplateTxids;
+    CHashWriter hashTemplate(SER_GETHASH, 0);
+    hashTemplate << pblock->hashPrevBlock;
+    for (const auto& it : pblock->vtx) {
+        if (it->IsCoinBase())
+            continue;
+        vTemplateTxids.push_back(it->GetHash());
+        hashTemplate << it->GetHash();
+    }
+    const uint256 templateId = hashTemplate.GetHash();
+
+    std::set<uint256> setDiffSince;
+    bool fDiff = false;
+    if (!hashDiffSince.IsNull()) {
+        for (const auto& recent : lRecentTemplates) {
+            if (recent.first == hashDiffSince) {
+                setDiffSince.insert(recent.second.begin(), recent.second.end());
+                fDiff = true;
+                break;
+            }
+        }
+    }
+    if (lRecentTemplates.empty() || lRecentTemplates.front().first != templateId) {
+        lRecentTemplates.emplace_front(templateId, vTemplateTxids);
+        if (lRecentTemplates.size() > MAX_RECENT_TEMPLATES)
+            lRecentTemplates.pop_back();
+    }
+
     UniValue transactions(UniValue::VARR);
+    std::map<uint256, std::string> mapTxHex;
     std::map<uint256, int64_t> setTxIndex;
     int i = 0;
     for (const auto& it : pblock->vtx) {
@@ -569,7 +697,15 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
 
         UniValue entry(UniValue::VOBJ);
 
-        entry.push_back(Pair("data", EncodeHexTx(tx)));
+        const uint256 wtxHash = tx.GetWitnessHash();
+        auto hexIt = mapTemplateTxHex.find(wtxHash);
+        std::string& strHex = mapTxHex[wtxHash];
+        if (hexIt != mapTemplateTxHex.end())
+            strHex.swap(hexIt->second);
+        else
+            strHex = EncodeHexTx(tx);
+        if (!fDiff || !setDiffSince.count(txHash))
+            entry.push_back(Pair("data", strHex));
         entry.push_back(Pair("txid", txHash.GetHex()));
         entry.push_back(Pair("hash", tx.GetWitnessHash().GetHex()));
 
@@ -593,6 +729,7 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
 
         transactions.push_back(entry);
     }
+    mapTemplateTxHex.swap(mapTxHex);
 
     UniValue aux(UniValue::VOBJ);
     aux.push_back(Pair("flags", HexStr(COINBASE_FLAGS.begin(), COINBASE_FLAGS.end())));
@@ -664,6 +801,16 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
 
     result.push_back(Pair("previousblockhash", pblock->hashPrevBlock.GetHex()));
     result.push_back(Pair("transactions", transactions));
+    result.push_back(Pair("templateid", templateId.GetHex()));
+    if (fDiff) {
+        for (const uint256& txid : vTemplateTxids)
+            setDiffSince.erase(txid);
+        UniValue removed(UniValue::VARR);
+        for (const uint256& txid : setDiffSince)
+            removed.push_back(txid.GetHex());
+        result.push_back(Pair("diffsince", hashDiffSince.GetHex()));
+        result.push_back(Pair("removed", removed));
+    }
     result.push_back(Pair("coinbaseaux", aux));
     result.push_back(Pair("coinbasevalue", (int64_t)pblock->vtx[0]->vout[0].nValue));
     result.push_back(Pair("longpollid", chainActive.Tip()->GetBlockHash().GetHex() + i64tostr(nTransactionsUpdatedLast)));
@@ -696,54 +843,32 @@ UniValue getblocktemplate(const JSONRPCRequest& request)
     bool fTestNet = (Params().NetworkIDString() == CBaseChainParams::TESTNET);
 
     if(pindexPrev->nHeight + 1 == 1){
-        std::string addresses;
+        const std::vector<CCoinbasePayouts::Payee>& vAirdrop = CoinbasePayouts().Airdrop();
         UniValue airdropObj(UniValue::VOBJ);
         UniValue airdropObjTemp(UniValue::VOBJ);
         if(!fTestNet){
             airdropObj.push_back(Pair("amount", 3800000*COIN));
-            for(int i = 0; i < 100; i++){
-                addresses = airdrop_addresses[i];
-                airdropObjTemp.push_back(Pair(std::to_string(i), addresses.c_str()));
-            }
-            airdropObj.push_back(Pair("payee", airdropObjTemp));
-            result.push_back(Pair("airdrop", airdropObj));
         }
         else{
             airdropObj.push_back(Pair("amount", 380000000*COIN));
-            addresses = "2PosyBduiL7yMfBK8DZEtCBJaQF76zgE8f";
-            airdropObjTemp.push_back(Pair(std::to_string(i), addresses.c_str()));
-            airdropObj.push_back(Pair("payee", airdropObjTemp));
-            result.push_back(Pair("airdrop", airdropObj));
         }
+        for(size_t i = 0; i < vAirdrop.size(); i++){
+            airdropObjTemp.push_back(Pair(std::to_string(i), vAirdrop[i].address));
+        }
+        airdropObj.push_back(Pair("payee", airdropObjTemp));
+        result.push_back(Pair("airdrop", airdropObj));
     }
 
     if(pindexPrev->nHeight + 1 > 1){
+        const std::vector<CCoinbasePayouts::Payee>& vDevFund = CoinbasePayouts().DevFund();
         UniValue airdropObj(UniValue::VOBJ);
-        CScript DEV_1_SCRIPT;
-        CScript DEV_2_SCRIPT;
-        std::string address1;
-        std::string address2;
-        if(!fTestNet){
-            DEV_1_SCRIPT = GetScriptForDestination(DecodeDestination("NVbGEghDbxPUe97oY8N5RvagQ61cHQiouW"));
-            DEV_2_SCRIPT = GetScriptForDestination(DecodeDestination("NWF7QNfT1b8a9dSQmVTT6hcwzwEVYVmDsG"));
-            address1 = "NVbGEghDbxPUe97oY8N5RvagQ61cHQiouW";
-            address2 = "NWF7QNfT1b8a9dSQmVTT6hcwzwEVYVmDsG";
-        }
-        else{
-            DEV_1_SCRIPT = GetScriptForDestination(DecodeDestination("2PosyBduiL7yMfBK8DZEtCBJaQF76zgE8f"));
-            DEV_2_SCRIPT = GetScriptForDestination(DecodeDestination("2WT5wFpLXoWm1H8CSgWVcq2F2LyhwKJcG1"));
-            address1 = "2PosyBduiL7yMfBK8DZEtCBJaQF76zgE8f";
-            address2 = "2WT5wFpLXoWm1H8CSgWVcq2F2LyhwKJcG1";
-        }
-
-
 
-        airdropObj.push_back(Pair("dev_1", address1.c_str()));
-        airdropObj.push_back(Pair("script_1", HexStr(DEV_1_SCRIPT.begin(), DEV_1_SCRIPT.end())));
+        airdropObj.push_back(Pair("dev_1", vDevFund[0].address));
+        airdropObj.push_back(Pair("script_1", HexStr(vDevFund[0].script.begin(), vDevFund[0].script.end())));
         airdropObj.push_back(Pair("amount_1", (0.05 * GetBlockSubsidy(pindexPrev->nHeight + 1 ,Params().GetConsensus()))));
 
-        airdropObj.push_back(Pair("dev_2", address2.c_str()));
-        airdropObj.push_back(Pair("script_2", HexStr(DEV_2_SCRIPT.begin(), DEV_2_SCRIPT.end())));
+        airdropObj.push_back(Pair("dev_2", vDevFund[1].address));
+        airdropObj.push_back(Pair("script_2", HexStr(vDevFund[1].script.begin(), vDevFund[1].script.end())));
         airdropObj.push_back(Pair("amount_2", (0.02 * GetBlockSubsidy(pindexPrev->nHeight + 1 ,Params().GetConsensus()))));
 
         result.push_back(Pair("dev_fund", airdropObj));
@@ -840,7 +965,7 @@ UniValue submitblock(const JSONRPCRequest& request)
     }
 
     submitblock_StateCatcher sc(block.GetHash());
-    RegisterValidationInterface(&sc);
+    RegisterValidationInterface(&sc, "submitblock");
     bool fAccepted = ProcessNewBlock(Params(), blockptr, true, nullptr);
     UnregisterValidationInterface(&sc);
     if (fBlockPresent) {
@@ -933,6 +1058,8 @@ UniValue estimatesmartfee(const JSONRPCRequest& request)
 
     RPCTypeCheck(request.params, {UniValue::VNUM, UniValue::VSTR});
     RPCTypeCheckArgument(request.params[0], UniValue::VNUM);
+    // Let the estimator catch up with the queued updates of the blocks and transactions seen so far
+    SyncWithValidationInterfaceQueue();
     unsigned int conf_target = ParseConfirmTarget(request.params[0]);
     bool conservative = true;
     if (!request.params[1].isNull()) {
@@ -1002,6 +1129,8 @@ UniValue estimaterawfee(const JSONRPCRequest& request)
 
     RPCTypeCheck(request.params, {UniValue::VNUM, UniValue::VNUM}, true);
     RPCTypeCheckArgument(request.params[0], UniValue::VNUM);
+    // Let the estimator catch up with the queued updates of the blocks and transactions seen so far
+    SyncWithValidationInterfaceQueue();
     unsigned int conf_target = ParseConfirmTarget(request.params[0]);
     double threshold = 0.95;
     if (!request.params[1].isNull()) {
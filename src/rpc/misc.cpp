@@ -7,6 +7,7 @@
 #include <chain.h>
 #include <clientversion.h>
 #include <core_io.h>
+#include <cpuprofiler.h>
 #include <crypto/ripemd160.h>
 #include <init.h>
 #include <validation.h>
@@ -16,10 +17,17 @@
 #include <rpc/blockchain.h>
 #include <rpc/server.h>
 #include <rpc/util.h>
+#include <scheduler.h>
+#include <script/sigcache.h>
 #include <timedata.h>
 #include <util.h>
 #include <utilstrencodings.h>
+#include <validationinterface.h>
+#include "ghostnode/ghostnode-payments.h"
 #include "ghostnode/ghostnode-sync.h"
+#include "ghostnode/ghostnodeman.h"
+#include "ghostnode/instantx.h"
+#include "libzerocoin/ParallelTasksPool.h"
 #ifdef ENABLE_WALLET
 #include <wallet/rpcwallet.h>
 #include <wallet/wallet.h>
@@ -28,6 +36,7 @@
 #include <warnings.h>
 #include "txmempool.h"
 #include <uint256.h>
+#include "zerocoin/zerocoin.h"
 
 #include <stdint.h>
 #ifdef HAVE_MALLOC_INFO
@@ -222,7 +231,7 @@ UniValue ghostnodesync(const JSONRPCRequest& req)
         objStatus.push_back(Pair("IsBlockchainSynced", ghostnodeSync.IsBlockchainSynced()));
         objStatus.push_back(Pair("IsGhostnodeListSynced", ghostnodeSync.IsGhostnodeListSynced()));
         objStatus.push_back(Pair("IsWinnersListSynced", ghostnodeSync.IsWinnersListSynced()));
-        objStatus.push_back(Pair("IsSynced", ghostnodeSync.IsSynced(chainActive.Height())));
+        objStatus.push_back(Pair("IsSynced", ghostnodeSync.IsSynced(GetChainSnapshot()->Height())));
         objStatus.push_back(Pair("IsFailed", ghostnodeSync.IsFailed()));
         return objStatus;
     }
@@ -461,11 +470,7 @@ UniValue verifymessage(const JSONRPCRequest& request)
     ss << strMessageMagic;
     ss << strMessage;
 
-    CPubKey pubkey;
-    if (!pubkey.RecoverCompact(ss.GetHash(), vchSig))
-        return false;
-
-    return (pubkey.GetID() == *keyID);
+    return VerifyCompactSignature(ss.GetHash(), vchSig, *keyID);
 }
 
 UniValue signmessagewithprivkey(const JSONRPCRequest& request)
@@ -569,6 +574,39 @@ static std::string RPCMallocInfo()
 }
 #endif
 
+static UniValue RPCSubsystemMemoryInfo()
+{
+    std::vector<std::pair<std::string, size_t> > vUsage;
+    {
+        LOCK(cs_main);
+        vUsage.emplace_back("coinscache", pcoinsTip ? pcoinsTip->DynamicMemoryUsage() : 0);
+        vUsage.emplace_back("mempool", mempool.DynamicMemoryUsage());
+        vUsage.emplace_back("blockindex", BlockIndexDynamicMemoryUsage());
+        vUsage.emplace_back("zerocoinstate", CZerocoinState::GetZerocoinState()->DynamicMemoryUsage());
+    }
+    vUsage.emplace_back("txlookupcache", TxLookupCacheDynamicMemoryUsage());
+    vUsage.emplace_back("ghostnodelist", mnodeman.ListDynamicMemoryUsage());
+    vUsage.emplace_back("ghostnodeseen", mnodeman.SeenDynamicMemoryUsage());
+    vUsage.emplace_back("ghostnodepayments", mnpayments.DynamicMemoryUsage());
+    vUsage.emplace_back("instantsend", instantsend.DynamicMemoryUsage());
+    size_t nWalletUsage = 0;
+#ifdef ENABLE_WALLET
+    for (CWalletRef pwallet : vpwallets)
+        nWalletUsage += pwallet->DynamicMemoryUsage();
+#endif
+    vUsage.emplace_back("wallet", nWalletUsage);
+    vUsage.emplace_back("addrman", g_connman ? g_connman->GetAddressMemoryUsage() : 0);
+
+    UniValue obj(UniValue::VOBJ);
+    uint64_t nTotal = 0;
+    for (const auto& usage : vUsage) {
+        obj.push_back(Pair(usage.first, (uint64_t)usage.second));
+        nTotal += usage.second;
+    }
+    obj.push_back(Pair("total", nTotal));
+    return obj;
+}
+
 UniValue getmemoryinfo(const JSONRPCRequest& request)
 {
     /* Please, avoid using the word "pool" here in the RPC interface or help,
@@ -582,6 +620,7 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
             "1. \"mode\" determines what kind of information is returned. This argument is optional, the default mode is \"stats\".\n"
             "  - \"stats\" returns general statistics about memory usage in the daemon.\n"
             "  - \"mallocinfo\" returns an XML string describing low-level heap state (only available if compiled with glibc 2.10+).\n"
+            "  - \"subsystems\" returns an estimate of the heap memory held by each cache and index of the node.\n"
             "\nResult (mode \"stats\"):\n"
             "{\n"
             "  \"locked\": {               (json object) Information about locked memory manager\n"
@@ -595,6 +634,21 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
             "}\n"
             "\nResult (mode \"mallocinfo\"):\n"
             "\"<malloc version=\"1\">...\"\n"
+            "\nResult (mode \"subsystems\"):\n"
+            "{\n"
+            "  \"coinscache\": xxxxx,        (numeric) Bytes used by the UTXO cache (-dbcache)\n"
+            "  \"mempool\": xxxxx,           (numeric) Bytes used by the memory pool (-maxmempool)\n"
+            "  \"blockindex\": xxxxx,        (numeric) Bytes used by the block index and its zerocoin data\n"
+            "  \"zerocoinstate\": xxxxx,     (numeric) Bytes used by the zerocoin groups, used serials and cached mints\n"
+            "  \"txlookupcache\": xxxxx,     (numeric) Bytes used by the confirmed transactions cached for lookups (-maxtxlookupcachesize)\n"
+            "  \"ghostnodelist\": xxxxx,     (numeric) Bytes used by the ghostnode list and its indexes\n"
+            "  \"ghostnodeseen\": xxxxx,     (numeric) Bytes used by the announcements, pings and verifications seen\n"
+            "  \"ghostnodepayments\": xxxxx, (numeric) Bytes used by the ghostnode payment votes\n"
+            "  \"instantsend\": xxxxx,       (numeric) Bytes used by the InstantSend lock requests and votes\n"
+            "  \"wallet\": xxxxx,            (numeric) Bytes used by the transactions and address books of the loaded wallets\n"
+            "  \"addrman\": xxxxx,           (numeric) Bytes used by the known peer addresses\n"
+            "  \"total\": xxxxx,             (numeric) Sum of the above, the process uses more for allocator overhead and buffers\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getmemoryinfo", "")
             + HelpExampleRpc("getmemoryinfo", "")
@@ -611,11 +665,284 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
 #else
         throw JSONRPCError(RPC_INVALID_PARAMETER, "mallocinfo is only available when compiled with glibc 2.10+");
 #endif
+    } else if (mode == "subsystems") {
+        return RPCSubsystemMemoryInfo();
     } else {
         throw JSONRPCError(RPC_INVALID_PARAMETER, "unknown mode " + mode);
     }
 }
 
+UniValue getzerocointhreadsinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getzerocointhreadsinfo\n"
+            "Returns an object containing information about the threads used for zerocoin proof computations.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"threads\": xxxxx,          (numeric) Number of threads (set with -zcthreads)\n"
+            "  \"queued\": xxxxx,           (numeric) Number of tasks waiting for a thread\n"
+            "  \"running\": xxxxx,          (numeric) Number of tasks currently running\n"
+            "  \"completed\": xxxxx,        (numeric) Number of tasks completed since startup\n"
+            "  \"avgqueuetime\": xxxxx,     (numeric) Average time completed tasks spent waiting for a thread, in microseconds\n"
+            "  \"avgruntime\": xxxxx,       (numeric) Average run time of completed tasks, in microseconds\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getzerocointhreadsinfo", "")
+            + HelpExampleRpc("getzerocointhreadsinfo", "")
+        );
+
+    libzerocoin::ParallelTasksStats stats = libzerocoin::GetParallelTasksStats();
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("threads", (uint64_t)stats.nThreads));
+    obj.push_back(Pair("queued", (uint64_t)stats.nQueued));
+    obj.push_back(Pair("running", (uint64_t)stats.nRunning));
+    obj.push_back(Pair("completed", stats.nTasksCompleted));
+    obj.push_back(Pair("avgqueuetime", stats.nTasksCompleted ? stats.nTotalQueueMicros / (int64_t)stats.nTasksCompleted : 0));
+    obj.push_back(Pair("avgruntime", stats.nTasksCompleted ? stats.nTotalRunMicros / (int64_t)stats.nTasksCompleted : 0));
+    return obj;
+}
+
+UniValue getrpcqueueinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getrpcqueueinfo\n"
+            "Returns information about the work queues RPC and REST requests wait in for an HTTP worker thread.\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"priority\": \"xxxx\",       (string) The queue, high, normal or bulk (set with -rpcpriority)\n"
+            "    \"queued\": xxxxx,          (numeric) Number of requests waiting for a thread\n"
+            "    \"running\": xxxxx,         (numeric) Number of requests currently running\n"
+            "    \"maxrunning\": xxxxx,      (numeric) Number of requests running at once at most, 0 for no limit (set with -rpcbulkthreads)\n"
+            "    \"completed\": xxxxx,       (numeric) Number of requests completed since startup\n"
+            "    \"rejected\": xxxxx,        (numeric) Number of requests rejected because the queue was full\n"
+            "    \"avgqueuetime\": xxxxx,    (numeric) Average time completed requests waited for a thread, in microseconds\n"
+            "    \"maxqueuetime\": xxxxx,    (numeric) Longest time a completed request waited for a thread, in microseconds\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getrpcqueueinfo", "")
+            + HelpExampleRpc("getrpcqueueinfo", "")
+        );
+
+    UniValue ret(UniValue::VARR);
+    for (const HTTPWorkQueueStats& stats : GetHTTPWorkQueueStats()) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("priority", HTTPWorkPriorityName(stats.priority)));
+        obj.push_back(Pair("queued", (uint64_t)stats.nQueued));
+        obj.push_back(Pair("running", (uint64_t)stats.nRunning));
+        obj.push_back(Pair("maxrunning", (uint64_t)stats.nMaxRunning));
+        obj.push_back(Pair("completed", stats.nCompleted));
+        obj.push_back(Pair("rejected", stats.nRejected));
+        obj.push_back(Pair("avgqueuetime", stats.nCompleted ? stats.nTotalQueueMicros / (int64_t)stats.nCompleted : 0));
+        obj.push_back(Pair("maxqueuetime", stats.nMaxQueueMicros));
+        ret.push_back(obj);
+    }
+    return ret;
+}
+
+UniValue getschedulerinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getschedulerinfo\n"
+            "Returns information about the background task scheduler and the tasks it ran since startup, by task class.\n"
+            "Tasks of one class never run in parallel, the scheduler runs -schedulerthreads of them at once.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"queued\": xxxxx,           (numeric) Number of tasks waiting for their time or a thread\n"
+            "  \"classes\": [\n"
+            "    {\n"
+            "      \"class\": \"xxxx\",        (string) The task class, ghostnode, net, validationinterface/<subscriber>, wallet or other\n"
+            "      \"runs\": xxxxx,          (numeric) Number of tasks run\n"
+            "      \"avgtime\": xxxxx,       (numeric) Average time a task ran, in microseconds\n"
+            "      \"maxtime\": xxxxx,       (numeric) Longest time a task ran, in microseconds\n"
+            "      \"avgdelay\": xxxxx,      (numeric) Average time a task started after its scheduled time, in microseconds\n"
+            "      \"maxdelay\": xxxxx,      (numeric) Longest time a task started after its scheduled time, in microseconds\n"
+            "    }\n"
+            "    ,...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getschedulerinfo", "")
+            + HelpExampleRpc("getschedulerinfo", "")
+        );
+
+    CScheduler& scheduler = GetScheduler();
+    boost::chrono::system_clock::time_point first, last;
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("queued", (uint64_t)scheduler.getQueueInfo(first, last)));
+    UniValue classes(UniValue::VARR);
+    for (const auto& entry : scheduler.getTaskStats()) {
+        const CScheduler::TaskStats& stats = entry.second;
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("class", entry.first));
+        obj.push_back(Pair("runs", stats.nRuns));
+        obj.push_back(Pair("avgtime", stats.nRuns ? stats.nTotalMicros / (int64_t)stats.nRuns : 0));
+        obj.push_back(Pair("maxtime", stats.nMaxMicros));
+        obj.push_back(Pair("avgdelay", stats.nRuns ? stats.nTotalDelayMicros / (int64_t)stats.nRuns : 0));
+        obj.push_back(Pair("maxdelay", stats.nMaxDelayMicros));
+        classes.push_back(obj);
+    }
+    ret.push_back(Pair("classes", classes));
+    return ret;
+}
+
+UniValue getvalidationqueueinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getvalidationqueueinfo\n"
+            "Returns the notification queues of the wallets, indexes and other subscribers to block and transaction validation.\n"
+            "Block validation waits for a subscriber queue with the \"block\" policy over its bound (-maxvalidationqueue),\n"
+            "one with the \"drop\" policy (-maxnotificationqueue) drops its oldest notifications instead.\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"name\": \"xxxx\",            (string) The subscriber, e.g. wallet, zmq, net or an index\n"
+            "    \"policy\": \"xxxx\",          (string) What happens when the queue is over its bound, block or drop\n"
+            "    \"depth\": xxxxx,            (numeric) Number of notifications waiting\n"
+            "    \"maxdepth\": xxxxx,         (numeric) The bound of the queue\n"
+            "    \"peakdepth\": xxxxx,        (numeric) Most notifications that were waiting at once\n"
+            "    \"queued\": xxxxx,           (numeric) Number of notifications queued\n"
+            "    \"processed\": xxxxx,        (numeric) Number of notifications delivered\n"
+            "    \"dropped\": xxxxx,          (numeric) Number of notifications dropped\n"
+            "    \"avgtime\": xxxxx,          (numeric) Average time the subscriber took for a notification, in microseconds\n"
+            "    \"maxtime\": xxxxx,          (numeric) Longest time the subscriber took for a notification, in microseconds\n"
+            "    \"waits\": xxxxx,            (numeric) Number of times block validation waited for the queue to drain\n"
+            "    \"totalwait\": xxxxx,        (numeric) Total time block validation waited, in microseconds\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getvalidationqueueinfo", "")
+            + HelpExampleRpc("getvalidationqueueinfo", "")
+        );
+
+    UniValue ret(UniValue::VARR);
+    for (const ValidationQueueStats& stats : GetMainSignals().GetQueueStats()) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("name", stats.name));
+        obj.push_back(Pair("policy", stats.policy == ValidationQueuePolicy::DROP ? "drop" : "block"));
+        obj.push_back(Pair("depth", (uint64_t)stats.nDepth));
+        obj.push_back(Pair("maxdepth", (uint64_t)stats.nMaxDepth));
+        obj.push_back(Pair("peakdepth", (uint64_t)stats.nPeakDepth));
+        obj.push_back(Pair("queued", stats.nQueued));
+        obj.push_back(Pair("processed", stats.nProcessed));
+        obj.push_back(Pair("dropped", stats.nDropped));
+        obj.push_back(Pair("avgtime", stats.nProcessed ? stats.nTotalMicros / (int64_t)stats.nProcessed : 0));
+        obj.push_back(Pair("maxtime", stats.nMaxMicros));
+        obj.push_back(Pair("waits", stats.nWaits));
+        obj.push_back(Pair("totalwait", stats.nTotalWaitMicros));
+        ret.push_back(obj);
+    }
+    return ret;
+}
+
+static UniValue LockHistogramToJSON(const uint64_t* histogram)
+{
+    UniValue ret(UniValue::VARR);
+    int nLast = LOCK_PROFILE_BUCKETS - 1;
+    while (nLast > 0 && histogram[nLast] == 0)
+        nLast--;
+    for (int i = 0; i <= nLast; i++)
+        ret.push_back(histogram[i]);
+    return ret;
+}
+
+UniValue getlockstats(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+            "getlockstats ( reset )\n"
+            "Returns how long the locks taken at each place in the code waited for and held their critical section.\n"
+            "Nothing is recorded unless the node runs with -lockprofile.\n"
+            "\nArguments:\n"
+            "1. reset    (boolean, optional, default=false) Clear the statistics after returning them\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"enabled\": true|false,     (boolean) Whether locks are being profiled (set with -lockprofile)\n"
+            "  \"sites\": [               (array) The places locks were taken at, longest total wait first\n"
+            "    {\n"
+            "      \"lock\": \"xxxx\",         (string) The critical section, as named in the code, e.g. cs_main\n"
+            "      \"site\": \"xxxx\",         (string) The file and line of the lock\n"
+            "      \"count\": xxxxx,         (numeric) Number of times the lock was taken\n"
+            "      \"contended\": xxxxx,     (numeric) Number of times it had to wait for another thread\n"
+            "      \"totalwait\": xxxxx,     (numeric) Total time spent waiting, in microseconds\n"
+            "      \"maxwait\": xxxxx,       (numeric) Longest wait, in microseconds\n"
+            "      \"totalhold\": xxxxx,     (numeric) Total time the critical section was held, in microseconds\n"
+            "      \"maxhold\": xxxxx,       (numeric) Longest hold, in microseconds\n"
+            "      \"waithistogram\": [ n, ... ], (array) Number of waits below 1, 2, 4, ... microseconds, each element\n"
+            "                                      counts the times between the previous bound and its own\n"
+            "      \"holdhistogram\": [ n, ... ]  (array) The same for the hold times\n"
+            "    }\n"
+            "    ,...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getlockstats", "")
+            + HelpExampleCli("getlockstats", "true")
+            + HelpExampleRpc("getlockstats", "")
+        );
+
+    bool fReset = !request.params[0].isNull() && request.params[0].get_bool();
+    std::vector<LockSiteStats> vStats = GetLockStats(fReset);
+    std::sort(vStats.begin(), vStats.end(), [](const LockSiteStats& a, const LockSiteStats& b) {
+        return a.nTotalWaitMicros > b.nTotalWaitMicros;
+    });
+
+    UniValue sites(UniValue::VARR);
+    for (const LockSiteStats& stats : vStats) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("lock", stats.name));
+        obj.push_back(Pair("site", strprintf("%s:%d", stats.file, stats.line)));
+        obj.push_back(Pair("count", stats.nLocks));
+        obj.push_back(Pair("contended", stats.nContended));
+        obj.push_back(Pair("totalwait", stats.nTotalWaitMicros));
+        obj.push_back(Pair("maxwait", stats.nMaxWaitMicros));
+        obj.push_back(Pair("totalhold", stats.nTotalHoldMicros));
+        obj.push_back(Pair("maxhold", stats.nMaxHoldMicros));
+        obj.push_back(Pair("waithistogram", LockHistogramToJSON(stats.waitHistogram)));
+        obj.push_back(Pair("holdhistogram", LockHistogramToJSON(stats.holdHistogram)));
+        sites.push_back(obj);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("enabled", g_lock_profile.load()));
+    ret.push_back(Pair("sites", sites));
+    return ret;
+}
+
+UniValue dumpprofile(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 1)
+        throw std::runtime_error(
+            "dumpprofile ( reset )\n"
+            "Returns the stacks sampled since startup or the last reset in the collapsed stack format of FlameGraph,\n"
+            "one line per distinct stack: the thread name, the frames from the outermost to the innermost separated\n"
+            "by semicolons and the number of samples. Frames without a symbol are given as module+offset, for addr2line.\n"
+            "Nothing is sampled unless the node runs with -cpuprofile, and only the last " + std::to_string(CPU_PROFILE_SAMPLES) + " samples are kept.\n"
+            "\nArguments:\n"
+            "1. reset    (boolean, optional, default=false) Clear the samples after returning them\n"
+            "\nResult:\n"
+            "\"profile\"    (string) The collapsed stacks\n"
+            "\nExamples:\n"
+            + HelpExampleCli("dumpprofile", "") + "  | flamegraph.pl > nixd.svg\n"
+            + HelpExampleCli("dumpprofile", "true")
+            + HelpExampleRpc("dumpprofile", "")
+        );
+
+    bool fReset = !request.params[0].isNull() && request.params[0].get_bool();
+    CpuProfileSummary summary;
+    std::string strProfile = DumpCpuProfile(fReset, summary);
+    LogPrint(BCLog::RPC, "%s: %u samples, %u of them overwritten\n", __func__, summary.nSamples, summary.nDropped);
+    return strProfile;
+}
+
 uint32_t getCategoryMask(UniValue cats) {
     cats = cats.get_array();
     uint32_t mask = 0;
@@ -789,6 +1116,70 @@ bool timestampSort(std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> a,
     return a.second.time < b.second.time;
 }
 
+/** Order in which the address index keeps addresses, so pages can resume across addresses */
+static bool addressIndexOrder(const std::pair<uint256, int>& a, const std::pair<uint256, int>& b)
+{
+    return a.second != b.second ? a.second < b.second : a.first < b.first;
+}
+
+template <typename K>
+static std::string encodeIndexCursor(const K& key)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << key;
+    return HexStr(ss.begin(), ss.end());
+}
+
+/**
+ * Read the optional "limit" and "cursor" fields of an address index query. Returns whether the
+ * results are paged. fResume is set when keyAfter holds the last entry of the previous page.
+ */
+template <typename K>
+static bool getPageFromParams(const UniValue& params, std::vector<std::pair<uint256, int> >& addresses,
+                              size_t& nLimit, K& keyAfter, bool& fResume)
+{
+    nLimit = 0;
+    fResume = false;
+    if (!params[0].isObject())
+        return false;
+
+    UniValue limitValue = find_value(params[0].get_obj(), "limit");
+    UniValue cursorValue = find_value(params[0].get_obj(), "cursor");
+    if (limitValue.isNull())
+        return false;
+    if (!limitValue.isNum() || limitValue.get_int() <= 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Limit is expected to be a positive number");
+    nLimit = limitValue.get_int();
+
+    if (!cursorValue.isNull()) {
+        if (!cursorValue.isStr() || !IsHex(cursorValue.get_str()))
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+        CDataStream ss(ParseHex(cursorValue.get_str()), SER_DISK, CLIENT_VERSION);
+        try {
+            ss >> keyAfter;
+        } catch (const std::exception&) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+        }
+        fResume = true;
+    }
+
+    std::sort(addresses.begin(), addresses.end(), addressIndexOrder);
+    return true;
+}
+
+/** Whether a paged query resuming after keyAfter is already past the address */
+template <typename K>
+static bool isBeforeCursor(const std::pair<uint256, int>& address, const K& keyAfter, bool fResume)
+{
+    return fResume && addressIndexOrder(address, std::make_pair(keyAfter.hashBytes, (int)keyAfter.type));
+}
+
+template <typename K>
+static const K* getCursorForAddress(const std::pair<uint256, int>& address, const K& keyAfter, bool fResume)
+{
+    return fResume && address.first == keyAfter.hashBytes && address.second == (int)keyAfter.type ? &keyAfter : nullptr;
+}
+
 UniValue getaddressmempool(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 1)
@@ -872,6 +1263,8 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
                         "      \"address\"  (string) The base58check encoded address\n"
                         "      ,...\n"
                         "    ]\n"
+                        "  \"limit\" (number, optional) Return at most this many outputs, in index order instead of by height\n"
+                        "  \"cursor\" (string, optional) The cursor returned with the previous page\n"
                         "}\n"
                         "\nResult\n"
                         "[\n"
@@ -884,8 +1277,14 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
                         "    \"height\"  (number) The block height\n"
                         "  }\n"
                         "]\n"
+                        "\nResult (with limit)\n"
+                        "{\n"
+                        "  \"utxos\"  (array) The outputs as above\n"
+                        "  \"cursor\"  (string, optional) Pass it to get the next page, missing on the last page\n"
+                        "}\n"
                         "\nExamples:\n"
                 + HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"NwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
+                + HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"NwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"], \"limit\": 1000}'")
                 + HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"NwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
         );
 
@@ -895,17 +1294,62 @@ UniValue getaddressutxos(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    size_t nLimit;
+    CAddressUnspentKey keyAfter;
+    bool fResume;
+    bool fPaged = getPageFromParams(request.params, addresses, nLimit, keyAfter, fResume);
+
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    UniValue result(UniValue::VARR);
+    size_t nCount = 0;
+    bool fMore = false;
+    CAddressUnspentKey keyLast;
 
-    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressUnspent((*it).first, (*it).second, unspentOutputs)) {
+    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end() && !fMore; it++) {
+        if (isBeforeCursor(*it, keyAfter, fResume))
+            continue;
+
+        std::string address;
+        if (!getAddressFromIndex(it->second, it->first, address)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
+        }
+
+        // A page is built straight from the index, without the full set of outputs of the address
+        if (!ScanAddressUnspent(it->first, it->second, getCursorForAddress(*it, keyAfter, fResume),
+                [&](const CAddressUnspentKey& key, const CAddressUnspentValue& value) {
+                    if (!fPaged) {
+                        unspentOutputs.push_back(std::make_pair(key, value));
+                        return true;
+                    }
+                    if (nCount == nLimit) {
+                        fMore = true;
+                        return false;
+                    }
+                    UniValue output(UniValue::VOBJ);
+                    output.push_back(Pair("address", address));
+                    output.push_back(Pair("txid", key.txhash.GetHex()));
+                    output.push_back(Pair("outputIndex", (int)key.index));
+                    output.push_back(Pair("script", HexStr(value.script.begin(), value.script.end())));
+                    output.push_back(Pair("satoshis", value.satoshis));
+                    output.push_back(Pair("height", value.blockHeight));
+                    result.push_back(output);
+                    keyLast = key;
+                    nCount++;
+                    return true;
+                })) {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
     }
 
-    std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
+    if (fPaged) {
+        UniValue page(UniValue::VOBJ);
+        page.push_back(Pair("utxos", result));
+        if (fMore)
+            page.push_back(Pair("cursor", encodeIndexCursor(keyLast)));
+        return page;
+    }
 
-    UniValue result(UniValue::VARR);
+    std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
 
     for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=unspentOutputs.begin(); it!=unspentOutputs.end(); it++) {
         UniValue output(UniValue::VOBJ);
@@ -941,6 +1385,8 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
                         "    ]\n"
                         "  \"start\" (number) The start block height\n"
                         "  \"end\" (number) The end block height\n"
+                        "  \"limit\" (number, optional) Return at most this many deltas\n"
+                        "  \"cursor\" (string, optional) The cursor returned with the previous page\n"
                         "}\n"
                         "\nResult:\n"
                         "[\n"
@@ -953,8 +1399,14 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
                         "    \"address\"  (string) The base58check encoded address\n"
                         "  }\n"
                         "]\n"
+                        "\nResult (with limit)\n"
+                        "{\n"
+                        "  \"deltas\"  (array) The deltas as above\n"
+                        "  \"cursor\"  (string, optional) Pass it to get the next page, missing on the last page\n"
+                        "}\n"
                         "\nExamples:\n"
                 + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"NwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
+                + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"NwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"], \"limit\": 1000}'")
                 + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"NwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
         );
 
@@ -979,36 +1431,53 @@ UniValue getaddressdeltas(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        }
-    }
+    size_t nLimit;
+    CAddressIndexKey keyAfter;
+    bool fResume;
+    bool fPaged = getPageFromParams(request.params, addresses, nLimit, keyAfter, fResume);
 
     UniValue result(UniValue::VARR);
+    size_t nCount = 0;
+    bool fMore = false;
+    CAddressIndexKey keyLast;
+
+    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end() && !fMore; it++) {
+        if (isBeforeCursor(*it, keyAfter, fResume))
+            continue;
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
         std::string address;
-        if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
+        if (!getAddressFromIndex(it->second, it->first, address)) {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
         }
 
-        UniValue delta(UniValue::VOBJ);
-        delta.push_back(Pair("satoshis", it->second));
-        delta.push_back(Pair("txid", it->first.txhash.GetHex()));
-        delta.push_back(Pair("index", (int)it->first.index));
-        delta.push_back(Pair("blockindex", (int)it->first.txindex));
-        delta.push_back(Pair("height", it->first.blockHeight));
-        delta.push_back(Pair("address", address));
-        result.push_back(delta);
+        if (!ScanAddressIndex(it->first, it->second, start, end, getCursorForAddress(*it, keyAfter, fResume),
+                [&](const CAddressIndexKey& key, CAmount nValue) {
+                    if (fPaged && nCount == nLimit) {
+                        fMore = true;
+                        return false;
+                    }
+                    UniValue delta(UniValue::VOBJ);
+                    delta.push_back(Pair("satoshis", nValue));
+                    delta.push_back(Pair("txid", key.txhash.GetHex()));
+                    delta.push_back(Pair("index", (int)key.index));
+                    delta.push_back(Pair("blockindex", (int)key.txindex));
+                    delta.push_back(Pair("height", key.blockHeight));
+                    delta.push_back(Pair("address", address));
+                    result.push_back(delta);
+                    keyLast = key;
+                    nCount++;
+                    return true;
+                })) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+    }
+
+    if (fPaged) {
+        UniValue page(UniValue::VOBJ);
+        page.push_back(Pair("deltas", result));
+        if (fMore)
+            page.push_back(Pair("cursor", encodeIndexCursor(keyLast)));
+        return page;
     }
 
     return result;
@@ -1032,6 +1501,7 @@ UniValue getaddressbalance(const JSONRPCRequest& request)
                         "{\n"
                         "  \"balance\"  (string) The current balance in duffs\n"
                         "  \"received\"  (string) The total number of duffs received (including change)\n"
+                        "  \"txcount\"  (numeric) The number of transactions of the addresses, counted per address\n"
                         "}\n"
                         "\nExamples:\n"
                 + HelpExampleCli("getaddressbalance", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
@@ -1044,27 +1514,42 @@ UniValue getaddressbalance(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    CAmount balance = 0;
+    CAmount received = 0;
+    int64_t nTxCount = 0;
 
     for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        CAddressBalance addressBalance;
+        if (GetAddressBalance(it->first, it->second, addressBalance)) {
+            balance += addressBalance.balance;
+            received += addressBalance.received;
+            nTxCount += addressBalance.nTxCount;
+            continue;
         }
-    }
-
-    CAmount balance = 0;
-    CAmount received = 0;
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        if (it->second > 0) {
-            received += it->second;
+        // The index was built without the running totals, add up its entries
+        uint256 hashLast;
+        if (!ScanAddressIndex(it->first, it->second, 0, 0, nullptr,
+                [&](const CAddressIndexKey& key, CAmount nValue) {
+                    if (nValue > 0) {
+                        received += nValue;
+                    }
+                    balance += nValue;
+                    // The entries of a transaction are adjacent within an address
+                    if (key.txhash != hashLast) {
+                        hashLast = key.txhash;
+                        nTxCount++;
+                    }
+                    return true;
+                })) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
-        balance += it->second;
     }
 
     UniValue result(UniValue::VOBJ);
     result.push_back(Pair("balance", balance));
     result.push_back(Pair("received", received));
+    result.push_back(Pair("txcount", nTxCount));
 
     return result;
 
@@ -1085,14 +1570,22 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
                         "    ]\n"
                         "  \"start\" (number) The start block height\n"
                         "  \"end\" (number) The end block height\n"
+                        "  \"limit\" (number, optional) Return at most this many txids, by address instead of by height\n"
+                        "  \"cursor\" (string, optional) The cursor returned with the previous page\n"
                         "}\n"
                         "\nResult:\n"
                         "[\n"
                         "  \"transactionid\"  (string) The transaction id\n"
                         "  ,...\n"
                         "]\n"
+                        "\nResult (with limit)\n"
+                        "{\n"
+                        "  \"txids\"  (array) The transaction ids as above\n"
+                        "  \"cursor\"  (string, optional) Pass it to get the next page, missing on the last page\n"
+                        "}\n"
                         "\nExamples:\n"
                 + HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
+                + HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"], \"limit\": 1000}'")
                 + HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
         );
 
@@ -1113,36 +1606,60 @@ UniValue getaddresstxids(const JSONRPCRequest& request)
         }
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        }
-    }
+    size_t nLimit;
+    CAddressIndexKey keyAfter;
+    bool fResume;
+    bool fPaged = getPageFromParams(request.params, addresses, nLimit, keyAfter, fResume);
+    // A page can start at a height without an end height, unpaged queries ignore a start height given alone
+    if (fPaged && start > 0 && end <= 0)
+        end = std::numeric_limits<int>::max();
 
     std::set<std::pair<int, std::string> > txids;
     UniValue result(UniValue::VARR);
-
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        int height = it->first.blockHeight;
-        std::string txid = it->first.txhash.GetHex();
-
-        if (addresses.size() > 1) {
-            txids.insert(std::make_pair(height, txid));
-        } else {
-            if (txids.insert(std::make_pair(height, txid)).second) {
-                result.push_back(txid);
-            }
+    size_t nCount = 0;
+    bool fMore = false;
+    CAddressIndexKey keyLast;
+
+    for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end() && !fMore; it++) {
+        if (isBeforeCursor(*it, keyAfter, fResume))
+            continue;
+
+        // The entries of a transaction are adjacent within an address
+        const CAddressIndexKey* pkeyAfter = getCursorForAddress(*it, keyAfter, fResume);
+        uint256 hashLast = pkeyAfter ? pkeyAfter->txhash : uint256();
+
+        if (!ScanAddressIndex(it->first, it->second, start, end, pkeyAfter,
+                [&](const CAddressIndexKey& key, CAmount nValue) {
+                    if (key.txhash == hashLast) {
+                        keyLast = key;
+                        return true;
+                    }
+                    if (addresses.size() > 1 && !fPaged) {
+                        txids.insert(std::make_pair(key.blockHeight, key.txhash.GetHex()));
+                        return true;
+                    }
+                    if (fPaged && nCount == nLimit) {
+                        fMore = true;
+                        return false;
+                    }
+                    result.push_back(key.txhash.GetHex());
+                    hashLast = key.txhash;
+                    keyLast = key;
+                    nCount++;
+                    return true;
+                })) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
     }
 
+    if (fPaged) {
+        UniValue page(UniValue::VOBJ);
+        page.push_back(Pair("txids", result));
+        if (fMore)
+            page.push_back(Pair("cursor", encodeIndexCursor(keyLast)));
+        return page;
+    }
+
     if (addresses.size() > 1) {
         for (std::set<std::pair<int, std::string> >::const_iterator it=txids.begin(); it!=txids.end(); it++) {
             result.push_back(it->second);
@@ -1204,6 +1721,12 @@ static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
     { "control",            "getmemoryinfo",          &getmemoryinfo,          {"mode"} },
+    { "control",            "getzerocointhreadsinfo", &getzerocointhreadsinfo, {} },
+    { "control",            "getrpcqueueinfo",        &getrpcqueueinfo,        {} },
+    { "control",            "getschedulerinfo",       &getschedulerinfo,       {} },
+    { "control",            "getvalidationqueueinfo", &getvalidationqueueinfo, {} },
+    { "control",            "getlockstats",           &getlockstats,           {"reset"} },
+    { "control",            "dumpprofile",            &dumpprofile,            {"reset"} },
     { "control",            "logging",                &logging,                {"include", "exclude"}},
     { "util",               "validateaddress",        &validateaddress,        {"address"} }, /* uses wallet if enabled */
     { "util",               "createmultisig",         &createmultisig,         {"nrequired","keys"} },
@@ -4,6 +4,7 @@
 
 #include <rpc/server.h>
 
+#include <blockencodings.h>
 #include <chainparams.h>
 #include <clientversion.h>
 #include <core_io.h>
@@ -101,6 +102,7 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
             "       n,                        (numeric) The heights of blocks we're currently asking from this peer\n"
             "       ...\n"
             "    ],\n"
+            "    \"inflight_limit\": n,       (numeric) How many blocks we may ask from this peer at once, sized from how fast it delivers them\n"
             "    \"whitelisted\": true|false, (boolean) Whether the peer is whitelisted\n"
             "    \"bytessent_per_msg\": {\n"
             "       \"addr\": n,              (numeric) The total bytes sent aggregated by message type\n"
@@ -109,7 +111,14 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
             "    \"bytesrecv_per_msg\": {\n"
             "       \"addr\": n,              (numeric) The total bytes received aggregated by message type\n"
             "       ...\n"
-            "    }\n"
+            "    },\n"
+            "    \"processtime\": n,          (numeric) The seconds spent processing the messages of this peer,\n"
+            "                                including the validation they trigger and the data served in reply\n"
+            "    \"processtime_per_msg\": {\n"
+            "       \"tx\": n,                (numeric) The seconds spent processing messages aggregated by message type\n"
+            "       ...\n"
+            "    },\n"
+            "    \"sendstalltime\": n,        (numeric) The seconds the send buffer to this peer was full\n"
             "  }\n"
             "  ,...\n"
             "]\n"
@@ -167,6 +176,7 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
                 heights.push_back(height);
             }
             obj.push_back(Pair("inflight", heights));
+            obj.push_back(Pair("inflight_limit", statestats.nBlocksInFlightLimit));
         }
         obj.push_back(Pair("whitelisted", stats.fWhitelisted));
 
@@ -184,6 +194,15 @@ UniValue getpeerinfo(const JSONRPCRequest& request)
         }
         obj.push_back(Pair("bytesrecv_per_msg", recvPerMsgCmd));
 
+        obj.push_back(Pair("processtime", ((double)stats.nProcessTime) / 1e6));
+        UniValue processTimePerMsgCmd(UniValue::VOBJ);
+        for (const mapMsgCmdSize::value_type &i : stats.mapProcessTimePerMsgCmd) {
+            if (i.second > 0)
+                processTimePerMsgCmd.push_back(Pair(i.first, ((double)i.second) / 1e6));
+        }
+        obj.push_back(Pair("processtime_per_msg", processTimePerMsgCmd));
+        obj.push_back(Pair("sendstalltime", ((double)stats.nSendStallTime) / 1e6));
+
         ret.push_back(obj);
     }
 
@@ -413,6 +432,42 @@ static UniValue GetNetworksInfo()
     return networks;
 }
 
+UniValue getcompactblockinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 0)
+        throw std::runtime_error(
+            "getcompactblockinfo\n"
+            "\nReturns how compact blocks were reconstructed since startup.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"reconstructed\": n,                 (numeric) Blocks reconstructed from compact blocks\n"
+            "  \"reconstructed_no_roundtrip\": n,     (numeric) Of those, blocks that needed no getblocktxn round trip\n"
+            "  \"failed\": n,                        (numeric) Compact blocks that could not be reconstructed\n"
+            "  \"tx_prefilled\": n,                  (numeric) Transactions sent along with the compact blocks\n"
+            "  \"tx_mempool\": n,                    (numeric) Transactions found in the mempool\n"
+            "  \"tx_extra\": n,                      (numeric) Transactions found in the extra reconstruction pools\n"
+            "  \"tx_requested\": n,                  (numeric) Transactions requested from the peer\n"
+            "  \"spends_local\": n,                  (numeric) Zerocoin spends found in the mempool or the extra pools\n"
+            "  \"spends_requested\": n               (numeric) Zerocoin spends requested from the peer\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getcompactblockinfo", "")
+            + HelpExampleRpc("getcompactblockinfo", "")
+       );
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("reconstructed", g_compact_block_stats.nReconstructed.load()));
+    obj.push_back(Pair("reconstructed_no_roundtrip", g_compact_block_stats.nReconstructedNoRoundTrip.load()));
+    obj.push_back(Pair("failed", g_compact_block_stats.nFailed.load()));
+    obj.push_back(Pair("tx_prefilled", g_compact_block_stats.nTxPrefilled.load()));
+    obj.push_back(Pair("tx_mempool", g_compact_block_stats.nTxMempool.load()));
+    obj.push_back(Pair("tx_extra", g_compact_block_stats.nTxExtra.load()));
+    obj.push_back(Pair("tx_requested", g_compact_block_stats.nTxRequested.load()));
+    obj.push_back(Pair("spends_local", g_compact_block_stats.nSpendsLocal.load()));
+    obj.push_back(Pair("spends_requested", g_compact_block_stats.nSpendsRequested.load()));
+    return obj;
+}
+
 UniValue getnetworkinfo(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 0)
@@ -634,6 +689,7 @@ static const CRPCCommand commands[] =
     { "network",            "disconnectnode",         &disconnectnode,         {"address", "nodeid"} },
     { "network",            "getaddednodeinfo",       &getaddednodeinfo,       {"node"} },
     { "network",            "getnettotals",           &getnettotals,           {} },
+    { "network",            "getcompactblockinfo",    &getcompactblockinfo,    {} },
     { "network",            "getnetworkinfo",         &getnetworkinfo,         {} },
     { "network",            "setban",                 &setban,                 {"subnet", "command", "bantime", "absolute"} },
     { "network",            "listbanned",             &listbanned,             {} },
@@ -58,6 +58,90 @@ UniValue JSONRPCError(int code, const std::string& message)
     return error;
 }
 
+CJSONStreamWriter::CJSONStreamWriter(const Sink& sinkIn, size_t nChunkSizeIn) : sink(sinkIn), nChunkSize(nChunkSizeIn)
+{
+    buffer.reserve(nChunkSize);
+}
+
+void CJSONStreamWriter::Write(const UniValue& value)
+{
+    switch (value.getType()) {
+    case UniValue::VOBJ: {
+        const std::vector<std::string>& keys = value.getKeys();
+        const std::vector<UniValue>& values = value.getValues();
+        buffer += '{';
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (i > 0)
+                buffer += ',';
+            WriteString(keys[i]);
+            buffer += ':';
+            Write(values[i]);
+        }
+        buffer += '}';
+        break;
+    }
+    case UniValue::VARR: {
+        const std::vector<UniValue>& values = value.getValues();
+        buffer += '[';
+        for (size_t i = 0; i < values.size(); i++) {
+            if (i > 0)
+                buffer += ',';
+            Write(values[i]);
+        }
+        buffer += ']';
+        break;
+    }
+    case UniValue::VSTR:
+        WriteString(value.get_str());
+        break;
+    default:
+        buffer += value.write();
+        break;
+    }
+
+    if (buffer.size() >= nChunkSize)
+        Flush();
+}
+
+void CJSONStreamWriter::WriteRaw(const std::string& str)
+{
+    buffer += str;
+    if (buffer.size() >= nChunkSize)
+        Flush();
+}
+
+void CJSONStreamWriter::WriteString(const std::string& str)
+{
+    // Escaping is private to univalue, have it write a string value
+    if (str.size() < nChunkSize) {
+        buffer += UniValue(str).write();
+        return;
+    }
+    Flush();
+    sink(UniValue(str).write());
+}
+
+void CJSONStreamWriter::Flush()
+{
+    if (buffer.empty())
+        return;
+    sink(std::move(buffer));
+    buffer.clear();
+    buffer.reserve(nChunkSize);
+}
+
+void JSONRPCReplyStream(CJSONStreamWriter& writer, const UniValue& result, const UniValue& error, const UniValue& id)
+{
+    writer.WriteRaw("{\"result\":");
+    writer.Write(error.isNull() ? result : NullUniValue);
+    writer.WriteRaw(",\"error\":");
+    writer.Write(error);
+    writer.WriteRaw(",\"id\":");
+    writer.Write(id);
+    writer.WriteRaw("}\n");
+    writer.Flush();
+}
+
 /** Username used when cookie authentication is in use (arbitrary, only for
  * recognizability in debugging/logging purposes)
  */
@@ -8,6 +8,7 @@
 
 #include <fs.h>
 
+#include <functional>
 #include <list>
 #include <map>
 #include <stdint.h>
@@ -19,6 +20,7 @@
 enum HTTPStatusCode
 {
     HTTP_OK                    = 200,
+    HTTP_NOT_MODIFIED          = 304,
     HTTP_BAD_REQUEST           = 400,
     HTTP_UNAUTHORIZED          = 401,
     HTTP_FORBIDDEN             = 403,
@@ -92,6 +94,39 @@ UniValue JSONRPCReplyObj(const UniValue& result, const UniValue& error, const Un
 std::string JSONRPCReply(const UniValue& result, const UniValue& error, const UniValue& id);
 UniValue JSONRPCError(int code, const std::string& message);
 
+//! Bytes of JSON a CJSONStreamWriter buffers before handing them on
+static const size_t JSON_STREAM_CHUNK_SIZE = 64 * 1024;
+
+/**
+ * Writes JSON the way UniValue::write() does without indentation, but into a single buffer that
+ * is handed to a sink every JSON_STREAM_CHUNK_SIZE bytes, rather than into one string per level
+ * of the tree that is copied into its parent's.
+ */
+class CJSONStreamWriter
+{
+public:
+    typedef std::function<void(std::string&&)> Sink;
+
+    explicit CJSONStreamWriter(const Sink& sinkIn, size_t nChunkSizeIn = JSON_STREAM_CHUNK_SIZE);
+
+    /** Write a value */
+    void Write(const UniValue& value);
+    /** Write JSON text as it is */
+    void WriteRaw(const std::string& str);
+    /** Hand what is buffered to the sink */
+    void Flush();
+
+private:
+    Sink sink;
+    size_t nChunkSize;
+    std::string buffer;
+
+    void WriteString(const std::string& str);
+};
+
+/** Write the same reply as JSONRPCReply, without copying result into a reply object first */
+void JSONRPCReplyStream(CJSONStreamWriter& writer, const UniValue& result, const UniValue& error, const UniValue& id);
+
 /** Generate a new RPC authentication cookie and write it to disk */
 bool GenerateAuthCookie(std::string *cookie_out);
 /** Read the RPC authentication cookie from disk */
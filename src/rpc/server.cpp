@@ -20,7 +20,10 @@
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
 
+#include <atomic>
 #include <memory> // for unique_ptr
+#include <set>
+#include <thread>
 #include <unordered_map>
 
 static bool fRPCRunning = false;
@@ -159,7 +162,7 @@ std::string CRPCTable::help(const std::string& strCommand, const JSONRPCRequest&
     std::vector<std::pair<std::string, const CRPCCommand*> > vCommands;
 
     for (const auto& entry : mapCommands)
-        vCommands.push_back(make_pair(entry.second->category + entry.first, entry.second));
+        vCommands.push_back(make_pair(entry.second.pcmd->category + entry.first, entry.second.pcmd));
     sort(vCommands.begin(), vCommands.end());
 
     JSONRPCRequest jreq(helpreq);
@@ -256,6 +259,54 @@ UniValue uptime(const JSONRPCRequest& jsonRequest)
     return GetTime() - GetStartupTime();
 }
 
+UniValue getrpcinfo(const JSONRPCRequest& jsonRequest)
+{
+    if (jsonRequest.fHelp || jsonRequest.params.size() > 1)
+        throw std::runtime_error(
+                "getrpcinfo ( \"method\" )\n"
+                        "\nReturns call statistics of the RPC methods since startup.\n"
+                        "\nArguments:\n"
+                        "1. \"method\"    (string, optional) Only this method, also when it wasn't called yet\n"
+                        "\nResult:\n"
+                        "{\n"
+                        "  \"method\": {            (object) Each method called, by name\n"
+                        "    \"calls\": xxxxx,      (numeric) Number of calls\n"
+                        "    \"errors\": xxxxx,     (numeric) Number of calls that returned an error\n"
+                        "    \"avgtime\": xxxxx,    (numeric) Average time of a call, in microseconds\n"
+                        "    \"maxtime\": xxxxx,    (numeric) Longest time of a call, in microseconds\n"
+                        "  }, ...\n"
+                        "}\n"
+                        "\nExamples:\n"
+                + HelpExampleCli("getrpcinfo", "")
+                + HelpExampleCli("getrpcinfo", "\"getblockcount\"")
+                + HelpExampleRpc("getrpcinfo", "")
+        );
+
+    std::vector<std::string> vMethods;
+    if (!jsonRequest.params.empty() && !jsonRequest.params[0].isNull()) {
+        vMethods.push_back(jsonRequest.params[0].get_str());
+        if (!tableRPC[vMethods[0]])
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Method not found");
+    } else {
+        vMethods = tableRPC.listCommands();
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    for (const std::string& strMethod : vMethods) {
+        const CRPCCommandStats* stats = tableRPC.stats(strMethod);
+        uint64_t nCalls = stats->nCalls;
+        if (nCalls == 0 && vMethods.size() > 1)
+            continue;
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("calls", nCalls));
+        obj.push_back(Pair("errors", (uint64_t)stats->nErrors));
+        obj.push_back(Pair("avgtime", nCalls ? stats->nTotalMicros / (int64_t)nCalls : 0));
+        obj.push_back(Pair("maxtime", (int64_t)stats->nMaxMicros));
+        ret.push_back(Pair(strMethod, obj));
+    }
+    return ret;
+}
+
 /**
  * Call Table
  */
@@ -266,6 +317,7 @@ static const CRPCCommand vRPCCommands[] =
   { "control",            "help",                   &help,                   {"command"}  },
   { "control",            "stop",                   &stop,                   {}  },
   { "control",            "uptime",                 &uptime,                 {}  },
+  { "control",            "getrpcinfo",             &getrpcinfo,             {"method"}  },
 
   /* Address index */
   { "addressindex",       "getaddressmempool",      &getaddressmempool,      {"addresses"} },
@@ -280,6 +332,8 @@ static const CRPCCommand vRPCCommands[] =
   { "NIX Ghostnode",               "ghostnodelist",         &ghostnodelist,         {"mode", "filter"}  },
   { "NIX Ghostnode",               "ghostnodebroadcast",    &ghostnodebroadcast,    {"command"}  },
   { "NIX Ghostnode",               "getpoolinfo",            &getpoolinfo,            {}  },
+  { "NIX Ghostnode",               "getghostnodestats",      &getghostnodestats,      {"reset"}  },
+  { "NIX Ghostnode",               "getghostnodecollaterals", &getghostnodecollaterals, {}  },
 };
 
 CRPCTable::CRPCTable()
@@ -290,16 +344,50 @@ CRPCTable::CRPCTable()
         const CRPCCommand *pcmd;
 
         pcmd = &vRPCCommands[vcidx];
-        mapCommands[pcmd->name] = pcmd;
+        insertCommand(pcmd->name, pcmd);
     }
 }
 
+void CRPCCommandStats::Record(int64_t nMicros, bool fError)
+{
+    nCalls++;
+    if (fError)
+        nErrors++;
+    nTotalMicros += nMicros;
+    int64_t nMax = nMaxMicros.load();
+    while (nMicros > nMax && !nMaxMicros.compare_exchange_weak(nMax, nMicros)) {}
+}
+
+CRPCTableEntry::CRPCTableEntry(const CRPCCommand* pcmdIn) : pcmd(pcmdIn)
+{
+    for (size_t i = 0; i < pcmd->argNames.size(); i++) {
+        std::vector<std::string> vargNames;
+        boost::algorithm::split(vargNames, pcmd->argNames[i], boost::algorithm::is_any_of("|"));
+        for (const std::string& argName : vargNames)
+            mapArgPositions.emplace(argName, i);
+    }
+}
+
+void CRPCTable::insertCommand(const std::string& name, const CRPCCommand* pcmd)
+{
+    mapCommands.erase(name);
+    mapCommands.emplace(std::piecewise_construct, std::forward_as_tuple(name), std::forward_as_tuple(pcmd));
+}
+
 const CRPCCommand *CRPCTable::operator[](const std::string &name) const
 {
-    std::map<std::string, const CRPCCommand*>::const_iterator it = mapCommands.find(name);
+    auto it = mapCommands.find(name);
+    if (it == mapCommands.end())
+        return nullptr;
+    return it->second.pcmd;
+}
+
+const CRPCCommandStats *CRPCTable::stats(const std::string &name) const
+{
+    auto it = mapCommands.find(name);
     if (it == mapCommands.end())
         return nullptr;
-    return (*it).second;
+    return &it->second.stats;
 }
 
 bool CRPCTable::appendCommand(const std::string& name, const CRPCCommand* pcmd)
@@ -308,11 +396,10 @@ bool CRPCTable::appendCommand(const std::string& name, const CRPCCommand* pcmd)
         return false;
 
     // don't allow overwriting for now
-    std::map<std::string, const CRPCCommand*>::const_iterator it = mapCommands.find(name);
-    if (it != mapCommands.end())
+    if (mapCommands.count(name))
         return false;
 
-    mapCommands[name] = pcmd;
+    insertCommand(name, pcmd);
     return true;
 }
 
@@ -424,11 +511,62 @@ static UniValue JSONRPCExecOne(JSONRPCRequest jreq, const UniValue& req)
     return rpc_result;
 }
 
+/** Read-only methods, consecutive calls to these in a batch are executed in parallel */
+static const std::set<std::string> setParallelBatchMethods = {
+    "getrawtransaction", "decoderawtransaction", "decodescript", "getblock", "getblockhash", "getblockheader",
+    "gettxout", "gettxoutproof", "verifytxoutproof", "getmempoolentry", "getmempoolancestors", "getmempooldescendants",
+    "getaddressbalance", "getaddressdeltas", "getaddresstxids", "getaddressutxos", "getaddressmempool",
+    "getblockhashes", "validateaddress", "estimatesmartfee",
+};
+
+static bool IsParallelBatchRequest(const UniValue& req)
+{
+    if (!req.isObject())
+        return false;
+    const UniValue& method = find_value(req.get_obj(), "method");
+    return method.isStr() && setParallelBatchMethods.count(method.get_str());
+}
+
+/** Execute vReq[nBegin] to vReq[nEnd - 1] on up to nThreads threads, the calling one included */
+static void JSONRPCExecParallel(const JSONRPCRequest& jreq, const UniValue& vReq, size_t nBegin, size_t nEnd,
+                                std::vector<UniValue>& vRet, size_t nThreads)
+{
+    std::atomic<size_t> nNext(nBegin);
+    auto exec = [&]() {
+        for (size_t i = nNext++; i < nEnd; i = nNext++)
+            vRet[i] = JSONRPCExecOne(jreq, vReq[i]);
+    };
+
+    std::vector<std::thread> vThreads;
+    for (size_t i = 1; i < std::min(nThreads, nEnd - nBegin); i++)
+        vThreads.emplace_back(exec);
+    exec();
+    for (std::thread& thread : vThreads)
+        thread.join();
+}
+
 std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq)
 {
+    std::vector<UniValue> vRet(vReq.size());
+    size_t nThreads = std::max(1L, std::min(gArgs.GetArg("-rpcbatchthreads", DEFAULT_RPC_BATCH_THREADS), (int64_t)GetNumCores()));
+
+    // Calls that may change state, and the calls after them, see the effects of the calls before
+    size_t reqIdx = 0;
+    while (reqIdx < vReq.size()) {
+        size_t nEnd = reqIdx;
+        while (nEnd < vReq.size() && IsParallelBatchRequest(vReq[nEnd]))
+            nEnd++;
+        if (nThreads > 1 && nEnd - reqIdx > 1) {
+            JSONRPCExecParallel(jreq, vReq, reqIdx, nEnd, vRet, nThreads);
+            reqIdx = nEnd;
+        } else {
+            vRet[reqIdx] = JSONRPCExecOne(jreq, vReq[reqIdx]);
+            reqIdx++;
+        }
+    }
+
     UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(jreq, vReq[reqIdx]));
+    ret.push_backV(vRet);
 
     return ret.write() + "\n";
 }
@@ -437,48 +575,34 @@ std::string JSONRPCExecBatch(const JSONRPCRequest& jreq, const UniValue& vReq)
  * Process named arguments into a vector of positional arguments, based on the
  * passed-in specification for the RPC call's arguments.
  */
-static inline JSONRPCRequest transformNamedArguments(const JSONRPCRequest& in, const std::vector<std::string>& argNames)
-{
-    JSONRPCRequest out = in;
+static inline JSONRPCRequest transformNamedArguments(const JSONRPCRequest& in, const CRPCTableEntry& entry)
+{
+    JSONRPCRequest out;
+    out.id = in.id;
+    out.strMethod = in.strMethod;
+    out.fHelp = in.fHelp;
+    out.URI = in.URI;
+    out.authUser = in.authUser;
     out.params = UniValue(UniValue::VARR);
-    // Build a map of parameters, and remove ones that have been processed, so that we can throw a focused error if
-    // there is an unknown one.
+    // Place each named argument at the position worked out at registration, a name that has none,
+    // or an argument given twice under its aliases, is an error
     const std::vector<std::string>& keys = in.params.getKeys();
     const std::vector<UniValue>& values = in.params.getValues();
-    std::unordered_map<std::string, const UniValue*> argsIn;
+    std::vector<const UniValue*> vArgs(entry.pcmd->argNames.size(), nullptr);
+    std::vector<const std::string*> vArgKeys(entry.pcmd->argNames.size(), nullptr);
+    size_t nArgs = 0;
     for (size_t i=0; i<keys.size(); ++i) {
-        argsIn[keys[i]] = &values[i];
-    }
-    // Process expected parameters.
-    int hole = 0;
-    for (const std::string &argNamePattern: argNames) {
-        std::vector<std::string> vargNames;
-        boost::algorithm::split(vargNames, argNamePattern, boost::algorithm::is_any_of("|"));
-        auto fr = argsIn.end();
-        for (const std::string & argName : vargNames) {
-            fr = argsIn.find(argName);
-            if (fr != argsIn.end()) {
-                break;
-            }
-        }
-        if (fr != argsIn.end()) {
-            for (int i = 0; i < hole; ++i) {
-                // Fill hole between specified parameters with JSON nulls,
-                // but not at the end (for backwards compatibility with calls
-                // that act based on number of specified parameters).
-                out.params.push_back(UniValue());
-            }
-            hole = 0;
-            out.params.push_back(*fr->second);
-            argsIn.erase(fr);
-        } else {
-            hole += 1;
-        }
-    }
-    // If there are still arguments in the argsIn map, this is an error.
-    if (!argsIn.empty()) {
-        throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown named parameter " + argsIn.begin()->first);
+        auto it = entry.mapArgPositions.find(keys[i]);
+        if (it == entry.mapArgPositions.end() || (vArgKeys[it->second] && *vArgKeys[it->second] != keys[i]))
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown named parameter " + keys[i]);
+        vArgs[it->second] = &values[i];
+        vArgKeys[it->second] = &keys[i];
+        nArgs = std::max(nArgs, it->second + 1);
     }
+    // Fill holes between specified parameters with JSON nulls, but not at the end (for backwards
+    // compatibility with calls that act based on number of specified parameters).
+    for (size_t i = 0; i < nArgs; ++i)
+        out.params.push_back(vArgs[i] ? *vArgs[i] : UniValue());
     // Return request with named arguments transformed to positional arguments
     return out;
 }
@@ -493,35 +617,46 @@ UniValue CRPCTable::execute(const JSONRPCRequest &request) const
     }
 
     // Find method
-    const CRPCCommand *pcmd = tableRPC[request.strMethod];
-    if (!pcmd)
+    auto it = mapCommands.find(request.strMethod);
+    if (it == mapCommands.end())
         throw JSONRPCError(RPC_METHOD_NOT_FOUND, "Method not found");
+    const CRPCTableEntry& entry = it->second;
+    const CRPCCommand *pcmd = entry.pcmd;
 
     g_rpcSignals.PreCommand(*pcmd);
 
+    int64_t nTimeStart = GetTimeMicros();
+    UniValue result;
     try
     {
         // Execute, convert arguments to array if necessary
         if (request.params.isObject()) {
-            return pcmd->actor(transformNamedArguments(request, pcmd->argNames));
+            result = pcmd->actor(transformNamedArguments(request, entry));
         } else {
-            return pcmd->actor(request);
+            result = pcmd->actor(request);
         }
     }
     catch (const std::exception& e)
     {
+        entry.stats.Record(GetTimeMicros() - nTimeStart, true);
         throw JSONRPCError(RPC_MISC_ERROR, e.what());
     }
+    catch (...)
+    {
+        entry.stats.Record(GetTimeMicros() - nTimeStart, true);
+        throw;
+    }
+    entry.stats.Record(GetTimeMicros() - nTimeStart, false);
+    return result;
 }
 
 std::vector<std::string> CRPCTable::listCommands() const
 {
     std::vector<std::string> commandList;
-    typedef std::map<std::string, const CRPCCommand*> commandMap;
-
-    std::transform( mapCommands.begin(), mapCommands.end(),
-                   std::back_inserter(commandList),
-                   boost::bind(&commandMap::value_type::first,_1) );
+    commandList.reserve(mapCommands.size());
+    for (const auto& entry : mapCommands)
+        commandList.push_back(entry.first);
+    std::sort(commandList.begin(), commandList.end());
     return commandList;
 }
 
@@ -10,14 +10,18 @@
 #include <rpc/protocol.h>
 #include <uint256.h>
 
+#include <atomic>
 #include <list>
 #include <map>
 #include <stdint.h>
 #include <string>
+#include <unordered_map>
 
 #include <univalue.h>
 
 static const unsigned int DEFAULT_RPC_SERIALIZE_VERSION = 1;
+//! Threads executing the read-only calls of a JSON-RPC batch
+static const int64_t DEFAULT_RPC_BATCH_THREADS = 4;
 
 class CRPCCommand;
 
@@ -136,16 +140,42 @@ public:
     std::vector<std::string> argNames;
 };
 
+/** Calls to an RPC method since startup, for getrpcinfo */
+struct CRPCCommandStats
+{
+    std::atomic<uint64_t> nCalls{0};
+    std::atomic<uint64_t> nErrors{0};
+    std::atomic<int64_t> nTotalMicros{0};
+    std::atomic<int64_t> nMaxMicros{0};
+
+    void Record(int64_t nMicros, bool fError);
+};
+
+/** A command of the dispatch table, with its argument positions worked out once at registration */
+struct CRPCTableEntry
+{
+    const CRPCCommand* pcmd;
+    //! Position of each argument name, every alias of it included
+    std::unordered_map<std::string, size_t> mapArgPositions;
+    mutable CRPCCommandStats stats;
+
+    explicit CRPCTableEntry(const CRPCCommand* pcmdIn);
+};
+
 /**
  * Bitcoin RPC command dispatcher.
  */
 class CRPCTable
 {
 private:
-    std::map<std::string, const CRPCCommand*> mapCommands;
+    std::unordered_map<std::string, CRPCTableEntry> mapCommands;
+
+    void insertCommand(const std::string& name, const CRPCCommand* pcmd);
 public:
     CRPCTable();
     const CRPCCommand* operator[](const std::string& name) const;
+    /** Call statistics of a method, nullptr if there is no such method */
+    const CRPCCommandStats* stats(const std::string& name) const;
     std::string help(const std::string& name, const JSONRPCRequest& helpreq) const;
 
     /**
@@ -201,6 +231,8 @@ extern UniValue ghostnode(const JSONRPCRequest& req);
 extern UniValue ghostnodelist(const JSONRPCRequest& req);
 extern UniValue ghostnodebroadcast(const JSONRPCRequest& req);
 extern UniValue ghostnodesync(const JSONRPCRequest& req);
+extern UniValue getghostnodestats(const JSONRPCRequest& req);
+extern UniValue getghostnodecollaterals(const JSONRPCRequest& req);
 
 bool StartRPC();
 void InterruptRPC();
@@ -7,6 +7,7 @@
 #include <random.h>
 #include <reverselock.h>
 
+#include <algorithm>
 #include <assert.h>
 #include <boost/bind.hpp>
 #include <utility>
@@ -45,43 +46,64 @@ void CScheduler::serviceQueue()
                 // Use this chance to get a tiny bit more entropy
                 RandAddSeedSleep();
             }
-            while (!shouldStop() && taskQueue.empty()) {
-                // Wait until there is something to do.
+
+            // The first task whose class isn't running on another thread
+            auto it = taskQueue.begin();
+            while (it != taskQueue.end() && !it->second.taskClass.empty() && runningClasses.count(it->second.taskClass))
+                ++it;
+
+            if (it == taskQueue.end()) {
+                // Wait until there is something to do, or a task class finishes
                 newTaskScheduled.wait(lock);
+                continue;
             }
 
-            // Wait until either there is a new task, or until
-            // the time of the first item on the queue:
-
+            // Wait until either there is a new task or a task finished, or until
+            // the time of the task, then look again:
+            boost::chrono::system_clock::time_point timeToWaitFor = it->first;
+            if (timeToWaitFor > boost::chrono::system_clock::now()) {
 // wait_until needs boost 1.50 or later; older versions have timed_wait:
 #if BOOST_VERSION < 105000
-            while (!shouldStop() && !taskQueue.empty() &&
-                   newTaskScheduled.timed_wait(lock, toPosixTime(taskQueue.begin()->first))) {
-                // Keep waiting until timeout
-            }
+                newTaskScheduled.timed_wait(lock, toPosixTime(timeToWaitFor));
 #else
-            // Some boost versions have a conflicting overload of wait_until that returns void.
-            // Explicitly use a template here to avoid hitting that overload.
-            while (!shouldStop() && !taskQueue.empty()) {
-                boost::chrono::system_clock::time_point timeToWaitFor = taskQueue.begin()->first;
-                if (newTaskScheduled.wait_until<>(lock, timeToWaitFor) == boost::cv_status::timeout)
-                    break; // Exit loop after timeout, it means we reached the time of the event
-            }
+                // Some boost versions have a conflicting overload of wait_until that returns void.
+                // Explicitly use a template here to avoid hitting that overload.
+                newTaskScheduled.wait_until<>(lock, timeToWaitFor);
 #endif
-            // If there are multiple threads, the queue can empty while we're waiting (another
-            // thread may service the task we were waiting on).
-            if (shouldStop() || taskQueue.empty())
                 continue;
+            }
 
-            Function f = taskQueue.begin()->second;
-            taskQueue.erase(taskQueue.begin());
+            Task task = std::move(it->second);
+            taskQueue.erase(it);
+            if (!task.taskClass.empty())
+                runningClasses.insert(task.taskClass);
 
+            boost::chrono::system_clock::time_point start = boost::chrono::system_clock::now();
             {
                 // Unlock before calling f, so it can reschedule itself or another task
-                // without deadlocking:
+                // without deadlocking. Release the task class even if f throws.
+                struct ClassRelease {
+                    CScheduler* s;
+                    const Task& task;
+                    ~ClassRelease() {
+                        if (!task.taskClass.empty()) {
+                            s->runningClasses.erase(task.taskClass);
+                            // Tasks of this class may be waiting for it
+                            s->newTaskScheduled.notify_all();
+                        }
+                    }
+                } release{this, task};
                 reverse_lock<boost::unique_lock<boost::mutex> > rlock(lock);
-                f();
+                task.f();
             }
+            int64_t nMicros = boost::chrono::duration_cast<boost::chrono::microseconds>(boost::chrono::system_clock::now() - start).count();
+            int64_t nDelayMicros = boost::chrono::duration_cast<boost::chrono::microseconds>(start - timeToWaitFor).count();
+            TaskStats& stats = mapTaskStats[task.taskClass.empty() ? "other" : task.taskClass];
+            stats.nRuns++;
+            stats.nTotalMicros += nMicros;
+            stats.nMaxMicros = std::max(stats.nMaxMicros, nMicros);
+            stats.nTotalDelayMicros += nDelayMicros;
+            stats.nMaxDelayMicros = std::max(stats.nMaxDelayMicros, nDelayMicros);
         } catch (...) {
             --nThreadsServicingQueue;
             throw;
@@ -103,29 +125,30 @@ void CScheduler::stop(bool drain)
     newTaskScheduled.notify_all();
 }
 
-void CScheduler::schedule(CScheduler::Function f, boost::chrono::system_clock::time_point t)
+void CScheduler::schedule(CScheduler::Function f, boost::chrono::system_clock::time_point t, const std::string& taskClass)
 {
     {
         boost::unique_lock<boost::mutex> lock(newTaskMutex);
-        taskQueue.insert(std::make_pair(t, f));
+        taskQueue.insert(std::make_pair(t, Task{f, taskClass}));
     }
-    newTaskScheduled.notify_one();
+    // A thread waiting for a task of a running class can't take this one, wake them all
+    newTaskScheduled.notify_all();
 }
 
-void CScheduler::scheduleFromNow(CScheduler::Function f, int64_t deltaMilliSeconds)
+void CScheduler::scheduleFromNow(CScheduler::Function f, int64_t deltaMilliSeconds, const std::string& taskClass)
 {
-    schedule(f, boost::chrono::system_clock::now() + boost::chrono::milliseconds(deltaMilliSeconds));
+    schedule(f, boost::chrono::system_clock::now() + boost::chrono::milliseconds(deltaMilliSeconds), taskClass);
 }
 
-static void Repeat(CScheduler* s, CScheduler::Function f, int64_t deltaMilliSeconds)
+static void Repeat(CScheduler* s, CScheduler::Function f, int64_t deltaMilliSeconds, const std::string& taskClass)
 {
     f();
-    s->scheduleFromNow(boost::bind(&Repeat, s, f, deltaMilliSeconds), deltaMilliSeconds);
+    s->scheduleFromNow(boost::bind(&Repeat, s, f, deltaMilliSeconds, taskClass), deltaMilliSeconds, taskClass);
 }
 
-void CScheduler::scheduleEvery(CScheduler::Function f, int64_t deltaMilliSeconds)
+void CScheduler::scheduleEvery(CScheduler::Function f, int64_t deltaMilliSeconds, const std::string& taskClass)
 {
-    scheduleFromNow(boost::bind(&Repeat, this, f, deltaMilliSeconds), deltaMilliSeconds);
+    scheduleFromNow(boost::bind(&Repeat, this, f, deltaMilliSeconds, taskClass), deltaMilliSeconds, taskClass);
 }
 
 size_t CScheduler::getQueueInfo(boost::chrono::system_clock::time_point &first,
@@ -145,6 +168,12 @@ bool CScheduler::AreThreadsServicingQueue() const {
     return nThreadsServicingQueue;
 }
 
+std::map<std::string, CScheduler::TaskStats> CScheduler::getTaskStats() const
+{
+    boost::unique_lock<boost::mutex> lock(newTaskMutex);
+    return mapTaskStats;
+}
+
 
 void SingleThreadedSchedulerClient::MaybeScheduleProcessQueue() {
     {
@@ -155,7 +184,7 @@ void SingleThreadedSchedulerClient::MaybeScheduleProcessQueue() {
         if (m_are_callbacks_running) return;
         if (m_callbacks_pending.empty()) return;
     }
-    m_pscheduler->schedule(std::bind(&SingleThreadedSchedulerClient::ProcessQueue, this));
+    m_pscheduler->schedule(std::bind(&SingleThreadedSchedulerClient::ProcessQueue, this), boost::chrono::system_clock::now(), m_task_class);
 }
 
 void SingleThreadedSchedulerClient::ProcessQueue() {
@@ -13,6 +13,8 @@
 #include <boost/chrono/chrono.hpp>
 #include <boost/thread.hpp>
 #include <map>
+#include <set>
+#include <string>
 
 #include <sync.h>
 
@@ -33,6 +35,15 @@
 // delete t;
 // delete s; // Must be done after thread is interrupted/joined.
 //
+// Several threads may run serviceQueue. Tasks scheduled with the same
+// task class never run at the same time, tasks without a class and tasks
+// of different classes run in parallel. Run and latency statistics are
+// kept per task class.
+//
+
+/** Number of threads servicing the node's scheduler */
+static const int DEFAULT_SCHEDULER_THREADS = 2;
+static const int MAX_SCHEDULER_THREADS = 16;
 
 class CScheduler
 {
@@ -42,18 +53,26 @@ public:
 
     typedef std::function<void(void)> Function;
 
-    // Call func at/after time t
-    void schedule(Function f, boost::chrono::system_clock::time_point t=boost::chrono::system_clock::now());
+    struct TaskStats {
+        uint64_t nRuns = 0;
+        int64_t nTotalMicros = 0;  //!< Time spent running the tasks
+        int64_t nMaxMicros = 0;
+        int64_t nTotalDelayMicros = 0; //!< Time the tasks waited past their scheduled time
+        int64_t nMaxDelayMicros = 0;
+    };
+
+    // Call func at/after time t, never at the same time as another task of taskClass
+    void schedule(Function f, boost::chrono::system_clock::time_point t=boost::chrono::system_clock::now(), const std::string& taskClass="");
 
     // Convenience method: call f once deltaSeconds from now
-    void scheduleFromNow(Function f, int64_t deltaMilliSeconds);
+    void scheduleFromNow(Function f, int64_t deltaMilliSeconds, const std::string& taskClass="");
 
     // Another convenience method: call f approximately
     // every deltaSeconds forever, starting deltaSeconds from now.
     // To be more precise: every time f is finished, it
     // is rescheduled to run deltaSeconds later. If you
     // need more accurate scheduling, don't use this method.
-    void scheduleEvery(Function f, int64_t deltaMilliSeconds);
+    void scheduleEvery(Function f, int64_t deltaMilliSeconds, const std::string& taskClass="");
 
     // To keep things as simple as possible, there is no unschedule.
 
@@ -74,13 +93,24 @@ public:
     // Returns true if there are threads actively running in serviceQueue()
     bool AreThreadsServicingQueue() const;
 
+    // Returns the statistics of the tasks run so far by task class,
+    // tasks without a class are counted under "other"
+    std::map<std::string, TaskStats> getTaskStats() const;
+
 private:
-    std::multimap<boost::chrono::system_clock::time_point, Function> taskQueue;
+    struct Task {
+        Function f;
+        std::string taskClass;
+    };
+
+    std::multimap<boost::chrono::system_clock::time_point, Task> taskQueue;
     boost::condition_variable newTaskScheduled;
     mutable boost::mutex newTaskMutex;
     int nThreadsServicingQueue;
     bool stopRequested;
     bool stopWhenEmpty;
+    std::set<std::string> runningClasses;
+    std::map<std::string, TaskStats> mapTaskStats;
     bool shouldStop() const { return stopRequested || (stopWhenEmpty && taskQueue.empty()); }
 };
 
@@ -93,6 +123,7 @@ private:
 class SingleThreadedSchedulerClient {
 private:
     CScheduler *m_pscheduler;
+    std::string m_task_class;
 
     CCriticalSection m_cs_callbacks_pending;
     std::list<std::function<void (void)>> m_callbacks_pending;
@@ -102,7 +133,7 @@ private:
     void ProcessQueue();
 
 public:
-    explicit SingleThreadedSchedulerClient(CScheduler *pschedulerIn) : m_pscheduler(pschedulerIn) {}
+    explicit SingleThreadedSchedulerClient(CScheduler *pschedulerIn, const std::string& taskClass="") : m_pscheduler(pschedulerIn), m_task_class(taskClass) {}
     void AddToProcessQueue(std::function<void (void)> func);
 
     // Processes all remaining queue members on the calling thread, blocking until queue is empty
@@ -1166,6 +1166,11 @@ uint256 GetOutputsHash(const CTransaction& txTo) {
 } // namespace
 
 PrecomputedTransactionData::PrecomputedTransactionData(const CTransaction& txTo)
+{
+    Init(txTo);
+}
+
+void PrecomputedTransactionData::Init(const CTransaction& txTo)
 {
     // Cache is calculated only for transactions with witness
     if (txTo.HasWitness()) {
@@ -120,7 +120,11 @@ struct PrecomputedTransactionData
     uint256 hashPrevouts, hashSequence, hashOutputs;
     bool ready = false;
 
+    PrecomputedTransactionData() {}
     explicit PrecomputedTransactionData(const CTransaction& tx);
+
+    //! Compute the hashes for tx, left for when its scripts are actually run
+    void Init(const CTransaction& tx);
 };
 
 enum SigVersion
@@ -6,6 +6,7 @@
 #include <script/sigcache.h>
 
 #include <memusage.h>
+#include <metrics.h>
 #include <pubkey.h>
 #include <random.h>
 #include <uint256.h>
@@ -66,6 +67,48 @@ public:
  * signatureCache could be made local to VerifySignature.
 */
 static CSignatureCache signatureCache;
+
+/**
+ * Compact signatures found to recover to a key ID, for the ghostnode messages that reach us from
+ * every peer and for verifymessage
+ */
+class CCompactSignatureCache
+{
+private:
+    //! Entries are SHA256(nonce || message hash || key id || signature)
+    uint256 nonce;
+    typedef CuckooCache::cache<uint256, SignatureCacheHasher> map_type;
+    map_type setValid;
+    boost::shared_mutex cs_sigcache;
+
+public:
+    CCompactSignatureCache()
+    {
+        GetRandBytes(nonce.begin(), 32);
+        setValid.setup_bytes(COMPACT_SIG_CACHE_BYTES);
+    }
+
+    void
+    ComputeEntry(uint256& entry, const uint256 &hash, const std::vector<unsigned char>& vchSig, const CKeyID& keyID)
+    {
+        CSHA256().Write(nonce.begin(), 32).Write(hash.begin(), 32).Write(keyID.begin(), keyID.size()).Write(vchSig.data(), vchSig.size()).Finalize(entry.begin());
+    }
+
+    bool
+    Get(const uint256& entry)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
+        return setValid.contains(entry, false);
+    }
+
+    void Set(uint256& entry)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
+        setValid.insert(entry);
+    }
+};
+
+static CCompactSignatureCache compactSignatureCache;
 } // namespace
 
 // To be called once in AppInitMain/BasicTestingSetup to initialize the
@@ -84,11 +127,40 @@ bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsig
 {
     uint256 entry;
     signatureCache.ComputeEntry(entry, sighash, vchSig, pubkey);
-    if (signatureCache.Get(entry, !store))
+    if (signatureCache.Get(entry, !store)) {
+        MetricAdd(Metric::SIGCACHE_HITS);
         return true;
+    }
+    MetricAdd(Metric::SIGCACHE_MISSES);
     if (!TransactionSignatureChecker::VerifySignature(vchSig, pubkey, sighash))
         return false;
     if (store)
         signatureCache.Set(entry);
     return true;
 }
+
+bool VerifyCompactSignature(const uint256& hash, const std::vector<unsigned char>& vchSig, const CKeyID& keyID, CKeyID* pkeyIDRecovered)
+{
+    uint256 entry;
+    compactSignatureCache.ComputeEntry(entry, hash, vchSig, keyID);
+    if (compactSignatureCache.Get(entry))
+        return true;
+
+    CPubKey pubkey;
+    if (!pubkey.RecoverCompact(hash, vchSig))
+        return false;
+    if (pubkey.GetID() != keyID) {
+        if (pkeyIDRecovered)
+            *pkeyIDRecovered = pubkey.GetID();
+        return false;
+    }
+    compactSignatureCache.Set(entry);
+    return true;
+}
+
+bool IsCachedCompactSignature(const uint256& hash, const std::vector<unsigned char>& vchSig, const CKeyID& keyID)
+{
+    uint256 entry;
+    compactSignatureCache.ComputeEntry(entry, hash, vchSig, keyID);
+    return compactSignatureCache.Get(entry);
+}
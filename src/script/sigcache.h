@@ -17,6 +17,10 @@ static const unsigned int DEFAULT_MAX_SIG_CACHE_SIZE = 32;
 // Maximum sig cache size allowed
 static const int64_t MAX_MAX_SIG_CACHE_SIZE = 16384;
 
+//! Bytes of the cache of verified compact (message) signatures
+static const size_t COMPACT_SIG_CACHE_BYTES = 4 << 20;
+
+class CKeyID;
 class CPubKey;
 
 /**
@@ -53,4 +57,13 @@ public:
 
 void InitSignatureCache();
 
+/**
+ * Whether the compact signature vchSig of hash recovers to keyID. Signatures that do are remembered
+ * in a salted cache by (hash, signature, key ID), so a message relayed by several peers is only
+ * recovered once. pkeyIDRecovered, if given, receives the key a failed check recovered instead.
+ */
+bool VerifyCompactSignature(const uint256& hash, const std::vector<unsigned char>& vchSig, const CKeyID& keyID, CKeyID* pkeyIDRecovered = nullptr);
+/** Whether VerifyCompactSignature has already found vchSig a valid signature of hash by keyID */
+bool IsCachedCompactSignature(const uint256& hash, const std::vector<unsigned char>& vchSig, const CKeyID& keyID);
+
 #endif // BITCOIN_SCRIPT_SIGCACHE_H
@@ -11,6 +11,10 @@
 #include <primitives/transaction.h>
 #include <script/standard.h>
 #include <uint256.h>
+#include <util.h>
+
+#include <algorithm>
+#include <thread>
 
 
 typedef std::vector<unsigned char> valtype;
@@ -248,6 +252,52 @@ bool SignSignature(const CKeyStore &keystore, const CTransaction& txFrom, CMutab
     return SignSignature(keystore, txout.scriptPubKey, txTo, nIn, txout.nValue, nHashType);
 }
 
+static void ProduceSignaturesRange(const CKeyStore& keystore, const CTransaction& txToConst, const std::vector<SignInput>& vInputs,
+                                   size_t nBegin, size_t nEnd, std::vector<SignatureData>& vSigData, std::vector<char>& vRet)
+{
+    for (size_t i = nBegin; i < nEnd; i++) {
+        const SignInput& input = vInputs[i];
+        TransactionSignatureCreator creator(&keystore, &txToConst, input.nIn, input.amount, input.nHashType);
+        vRet[i] = ProduceSignature(creator, input.scriptPubKey, vSigData[i]);
+    }
+}
+
+bool ProduceSignatures(const CKeyStore& keystore, CMutableTransaction& txTo, const std::vector<SignInput>& vInputs, std::vector<bool>* vSigned)
+{
+    for (const SignInput& input : vInputs)
+        assert(input.nIn < txTo.vin.size());
+
+    // Every input is signed against the same copy of the transaction, not updated until all are signed
+    const CTransaction txToConst(txTo);
+    std::vector<SignatureData> vSigData(vInputs.size());
+    std::vector<char> vRet(vInputs.size(), false);
+
+    size_t nThreads = std::min(vInputs.size() / SIGN_INPUTS_PER_THREAD, (size_t)GetNumCores());
+    if (nThreads <= 1) {
+        ProduceSignaturesRange(keystore, txToConst, vInputs, 0, vInputs.size(), vSigData, vRet);
+    } else {
+        std::vector<std::thread> vThreads;
+        size_t nPerThread = (vInputs.size() + nThreads - 1) / nThreads;
+        for (size_t t = 1; t < nThreads; t++)
+            vThreads.emplace_back(ProduceSignaturesRange, std::cref(keystore), std::cref(txToConst), std::cref(vInputs),
+                t * nPerThread, std::min(vInputs.size(), (t + 1) * nPerThread), std::ref(vSigData), std::ref(vRet));
+        ProduceSignaturesRange(keystore, txToConst, vInputs, 0, nPerThread, vSigData, vRet);
+        for (std::thread& thread : vThreads)
+            thread.join();
+    }
+
+    bool fAll = true;
+    if (vSigned)
+        vSigned->assign(vInputs.size(), false);
+    for (size_t i = 0; i < vInputs.size(); i++) {
+        UpdateTransaction(txTo, vInputs[i].nIn, vSigData[i]);
+        if (vSigned)
+            (*vSigned)[i] = vRet[i];
+        fAll &= (bool)vRet[i];
+    }
+    return fAll;
+}
+
 static std::vector<valtype> CombineMultisig(const CScript& scriptPubKey, const BaseSignatureChecker& checker,
                                const std::vector<valtype>& vSolutions,
                                const std::vector<valtype>& sigs1, const std::vector<valtype>& sigs2, SigVersion sigversion)
@@ -74,6 +74,27 @@ bool ProduceSignature(const BaseSignatureCreator& creator, const CScript& script
 bool SignSignature(const CKeyStore &keystore, const CScript& fromPubKey, CMutableTransaction& txTo, unsigned int nIn, const CAmount& amount, int nHashType);
 bool SignSignature(const CKeyStore& keystore, const CTransaction& txFrom, CMutableTransaction& txTo, unsigned int nIn, int nHashType);
 
+//! Inputs signed per thread by ProduceSignatures
+static const unsigned int SIGN_INPUTS_PER_THREAD = 16;
+
+/** An input of a transaction to be signed by ProduceSignatures */
+struct SignInput {
+    unsigned int nIn;
+    CScript scriptPubKey;
+    CAmount amount;
+    int nHashType;
+
+    SignInput(unsigned int nInIn, const CScript& scriptPubKeyIn, const CAmount& amountIn, int nHashTypeIn)
+        : nIn(nInIn), scriptPubKey(scriptPubKeyIn), amount(amountIn), nHashType(nHashTypeIn) {}
+};
+
+/**
+ * Sign the inputs of txTo like SignSignature does, on more threads for transactions with many of them.
+ * The inputs are signed against the transaction as it is when called, then all updated at once.
+ * Returns whether every input could be signed. vSigned, if given, receives it per input.
+ */
+bool ProduceSignatures(const CKeyStore& keystore, CMutableTransaction& txTo, const std::vector<SignInput>& vInputs, std::vector<bool>* vSigned = nullptr);
+
 /** Combine two script signatures using a generic signature checker, intelligently, possibly with OP_0 placeholders. */
 SignatureData CombineSignatures(const CScript& scriptPubKey, const BaseSignatureChecker& checker, const SignatureData& scriptSig1, const SignatureData& scriptSig2);
 
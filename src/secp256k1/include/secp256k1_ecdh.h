@@ -24,6 +24,25 @@ SECP256K1_API SECP256K1_WARN_UNUSED_RESULT int secp256k1_ecdh(
   const unsigned char *privkey
 ) SECP256K1_ARG_NONNULL(1) SECP256K1_ARG_NONNULL(2) SECP256K1_ARG_NONNULL(3) SECP256K1_ARG_NONNULL(4);
 
+/** Compute the EC Diffie-Hellman secrets of one scalar with many points in constant time
+ *  Each secret equals the one secp256k1_ecdh computes for its point. The products are
+ *  converted back to affine coordinates together, with one field inversion per batch.
+ *  Returns: 1: exponentiation was successful
+ *           0: scalar was invalid (zero or overflow)
+ *  Args:    ctx:        pointer to a context object (cannot be NULL)
+ *  Out:     results:    an array of n 32-byte secrets, in the order of pubkeys
+ *  In:      pubkeys:    an array of n pointers to initialized public keys
+ *           n:          the number of public keys
+ *           privkey:    a 32-byte scalar with which to multiply the points
+ */
+SECP256K1_API SECP256K1_WARN_UNUSED_RESULT int secp256k1_ecdh_batch(
+  const secp256k1_context* ctx,
+  unsigned char *results,
+  const secp256k1_pubkey * const *pubkeys,
+  size_t n,
+  const unsigned char *privkey
+) SECP256K1_ARG_NONNULL(1) SECP256K1_ARG_NONNULL(2) SECP256K1_ARG_NONNULL(3) SECP256K1_ARG_NONNULL(5);
+
 #ifdef __cplusplus
 }
 #endif
@@ -10,6 +10,27 @@
 #include "include/secp256k1_ecdh.h"
 #include "ecmult_const_impl.h"
 
+/** Points multiplied before their coordinates are inverted together by secp256k1_ecdh_batch */
+#define ECDH_BATCH_SIZE 64
+
+/* Hash a point in compressed form. secp256k1_eckey_pubkey_serialize can't be used here since it
+ * does not expect its output to be secret and has a timing sidechannel. */
+static void secp256k1_ecdh_hash_point(unsigned char *result, secp256k1_ge *pt) {
+    unsigned char x[32];
+    unsigned char y[1];
+    secp256k1_sha256_t sha;
+
+    secp256k1_fe_normalize(&pt->x);
+    secp256k1_fe_normalize(&pt->y);
+    secp256k1_fe_get_b32(x, &pt->x);
+    y[0] = 0x02 | secp256k1_fe_is_odd(&pt->y);
+
+    secp256k1_sha256_initialize(&sha);
+    secp256k1_sha256_write(&sha, y, sizeof(y));
+    secp256k1_sha256_write(&sha, x, sizeof(x));
+    secp256k1_sha256_finalize(&sha, result);
+}
+
 int secp256k1_ecdh(const secp256k1_context* ctx, unsigned char *result, const secp256k1_pubkey *point, const unsigned char *scalar) {
     int ret = 0;
     int overflow = 0;
@@ -26,24 +47,9 @@ int secp256k1_ecdh(const secp256k1_context* ctx, unsigned char *result, const se
     if (overflow || secp256k1_scalar_is_zero(&s)) {
         ret = 0;
     } else {
-        unsigned char x[32];
-        unsigned char y[1];
-        secp256k1_sha256_t sha;
-
         secp256k1_ecmult_const(&res, &pt, &s);
         secp256k1_ge_set_gej(&pt, &res);
-        /* Compute a hash of the point in compressed form
-         * Note we cannot use secp256k1_eckey_pubkey_serialize here since it does not
-         * expect its output to be secret and has a timing sidechannel. */
-        secp256k1_fe_normalize(&pt.x);
-        secp256k1_fe_normalize(&pt.y);
-        secp256k1_fe_get_b32(x, &pt.x);
-        y[0] = 0x02 | secp256k1_fe_is_odd(&pt.y);
-
-        secp256k1_sha256_initialize(&sha);
-        secp256k1_sha256_write(&sha, y, sizeof(y));
-        secp256k1_sha256_write(&sha, x, sizeof(x));
-        secp256k1_sha256_finalize(&sha, result);
+        secp256k1_ecdh_hash_point(result, &pt);
         ret = 1;
     }
 
@@ -51,4 +57,53 @@ int secp256k1_ecdh(const secp256k1_context* ctx, unsigned char *result, const se
     return ret;
 }
 
+int secp256k1_ecdh_batch(const secp256k1_context* ctx, unsigned char *results, const secp256k1_pubkey * const *points, size_t n, const unsigned char *scalar) {
+    int overflow = 0;
+    size_t i, j, count;
+    secp256k1_gej res[ECDH_BATCH_SIZE];
+    secp256k1_fe zinv[ECDH_BATCH_SIZE];
+    secp256k1_fe acc;
+    secp256k1_ge pt;
+    secp256k1_scalar s;
+    VERIFY_CHECK(ctx != NULL);
+    ARG_CHECK(results != NULL);
+    ARG_CHECK(points != NULL);
+    ARG_CHECK(scalar != NULL);
+
+    secp256k1_scalar_set_b32(&s, scalar, &overflow);
+    if (overflow || secp256k1_scalar_is_zero(&s)) {
+        secp256k1_scalar_clear(&s);
+        return 0;
+    }
+
+    for (i = 0; i < n; i += count) {
+        count = n - i < ECDH_BATCH_SIZE ? n - i : ECDH_BATCH_SIZE;
+        for (j = 0; j < count; j++) {
+            secp256k1_pubkey_load(ctx, &pt, points[i + j]);
+            secp256k1_ecmult_const(&res[j], &pt, &s);
+        }
+
+        /* Montgomery's trick: invert the product of all z, then peel the inverses off one by one.
+         * A point on the curve times a valid scalar is never infinity, so no z is zero. */
+        zinv[0] = res[0].z;
+        for (j = 1; j < count; j++) {
+            secp256k1_fe_mul(&zinv[j], &zinv[j - 1], &res[j].z);
+        }
+        secp256k1_fe_inv(&acc, &zinv[count - 1]);
+        for (j = count - 1; j > 0; j--) {
+            secp256k1_fe_mul(&zinv[j], &zinv[j - 1], &acc);
+            secp256k1_fe_mul(&acc, &acc, &res[j].z);
+        }
+        zinv[0] = acc;
+
+        for (j = 0; j < count; j++) {
+            secp256k1_ge_set_gej_zinv(&pt, &res[j], &zinv[j]);
+            secp256k1_ecdh_hash_point(results + 32 * (i + j), &pt);
+        }
+    }
+
+    secp256k1_scalar_clear(&s);
+    return 1;
+}
+
 #endif /* SECP256K1_MODULE_ECDH_MAIN_H */
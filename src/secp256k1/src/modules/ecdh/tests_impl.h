@@ -96,10 +96,41 @@ void test_bad_scalar(void) {
     CHECK(secp256k1_ecdh(ctx, output, &point, s_overflow) == 1);
 }
 
+void test_ecdh_batch(void) {
+    unsigned char s_zero[32] = { 0 };
+    unsigned char s_b32[32];
+    unsigned char output_single[32];
+    unsigned char output_batch[32 * 150];
+    secp256k1_pubkey points[150];
+    const secp256k1_pubkey *ppoints[150];
+    secp256k1_scalar s;
+    size_t n, i;
+
+    for (i = 0; i < 150; ++i) {
+        random_scalar_order(&s);
+        secp256k1_scalar_get_b32(s_b32, &s);
+        CHECK(secp256k1_ec_pubkey_create(ctx, &points[i], s_b32) == 1);
+        ppoints[i] = &points[i];
+    }
+    random_scalar_order(&s);
+    secp256k1_scalar_get_b32(s_b32, &s);
+
+    /* Batches smaller than, equal to and spanning several inversion batches match secp256k1_ecdh */
+    for (n = 0; n <= 150; n += (n < 2 ? 1 : 31)) {
+        CHECK(secp256k1_ecdh_batch(ctx, output_batch, ppoints, n, s_b32) == 1);
+        for (i = 0; i < n; ++i) {
+            CHECK(secp256k1_ecdh(ctx, output_single, &points[i], s_b32) == 1);
+            CHECK(memcmp(output_single, output_batch + 32 * i, 32) == 0);
+        }
+    }
+    CHECK(secp256k1_ecdh_batch(ctx, output_batch, ppoints, 150, s_zero) == 0);
+}
+
 void run_ecdh_tests(void) {
     test_ecdh_api();
     test_ecdh_generator_basepoint();
     test_bad_scalar();
+    test_ecdh_batch();
 }
 
 #endif /* SECP256K1_MODULE_ECDH_TESTS_H */
@@ -0,0 +1,89 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_BUFFERPOOL_H
+#define BITCOIN_SUPPORT_ALLOCATORS_BUFFERPOOL_H
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+/**
+ * Recycles the storage of byte vectors, like the buffers of network messages, so that a message
+ * doesn't go through the allocator, and through the reallocations of a growing vector, every time.
+ *
+ * Free buffers are kept in NUM_CLASSES size classes, each four times as large as the one before.
+ * A class holds at most about MAX_FREE_BYTES of buffers, and vectors larger than twice the largest
+ * class are left to the allocator.
+ *
+ * Thread-safe.
+ */
+template <typename V>
+class BufferPool
+{
+public:
+    static constexpr std::size_t NUM_CLASSES = 6;
+    static constexpr std::size_t MIN_CLASS_BYTES = 256;
+    static constexpr std::size_t MAX_FREE_BYTES = 1024 * 1024;
+
+    static constexpr std::size_t ClassBytes(std::size_t c) { return MIN_CLASS_BYTES << (2 * c); }
+
+    /** Size of the largest class */
+    static constexpr std::size_t MAX_CLASS_BYTES = MIN_CLASS_BYTES << (2 * (NUM_CLASSES - 1));
+
+    /** An empty vector with room for at least nBytes, or just an empty vector above MAX_CLASS_BYTES */
+    V Get(std::size_t nBytes)
+    {
+        V v;
+        if (nBytes > MAX_CLASS_BYTES)
+            return v;
+        std::size_t c = 0;
+        while (ClassBytes(c) < nBytes)
+            c++;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_free[c].empty()) {
+                v.swap(m_free[c].back());
+                m_free[c].pop_back();
+                return v;
+            }
+        }
+        v.reserve(ClassBytes(c));
+        return v;
+    }
+
+    /** Take the storage of v back for later, v is left empty */
+    void Put(V& v)
+    {
+        const std::size_t nCapacity = v.capacity();
+        if (nCapacity >= MIN_CLASS_BYTES && nCapacity <= 2 * MAX_CLASS_BYTES) {
+            std::size_t c = NUM_CLASSES - 1;
+            while (ClassBytes(c) > nCapacity)
+                c--;
+            v.clear();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_free[c].size() < MaxFree(c)) {
+                m_free[c].emplace_back();
+                m_free[c].back().swap(v);
+                return;
+            }
+        }
+        V().swap(v);
+    }
+
+    /** Number of free buffers in class c */
+    std::size_t FreeCount(std::size_t c)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_free[c].size();
+    }
+
+private:
+    static constexpr std::size_t MaxFree(std::size_t c) { return MAX_FREE_BYTES / ClassBytes(c) > 4 ? MAX_FREE_BYTES / ClassBytes(c) : 4; }
+
+    std::mutex m_mutex;
+    std::vector<V> m_free[NUM_CLASSES];
+};
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_BUFFERPOOL_H
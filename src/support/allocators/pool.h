@@ -0,0 +1,198 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+#define BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+
+#include <array>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/**
+ * Memory resource for containers that allocate many small nodes of a few sizes, like the
+ * entries of a node based std::unordered_map.
+ *
+ * Blocks of up to MAX_BLOCK_SIZE_BYTES are carved from large chunks without any per allocation
+ * header, and freed blocks are kept in one free list per size to be reused by the next allocation
+ * of that size. Larger blocks, or blocks with a stricter alignment, such as the bucket array of a
+ * map, go to operator new.
+ *
+ * Memory is only returned to the system when the resource is destroyed. The chunks can therefore
+ * never hold more blocks than the container had at its peak.
+ *
+ * Not thread-safe, like the containers using it.
+ */
+template <std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+class PoolResource
+{
+    /** Element of a free list, stored in the freed block itself */
+    struct ListNode {
+        ListNode* m_next;
+        explicit ListNode(ListNode* next) : m_next(next) {}
+    };
+
+public:
+    /** Alignment of every pooled block, also the granularity of the block sizes */
+    static constexpr std::size_t ELEM_ALIGN_BYTES = alignof(ListNode) > ALIGN_BYTES ? alignof(ListNode) : ALIGN_BYTES;
+
+    static_assert((ELEM_ALIGN_BYTES & (ELEM_ALIGN_BYTES - 1)) == 0, "ELEM_ALIGN_BYTES must be a power of two");
+    static_assert(sizeof(ListNode) <= ELEM_ALIGN_BYTES, "a free list node must fit into a block");
+    static_assert(MAX_BLOCK_SIZE_BYTES >= ELEM_ALIGN_BYTES, "MAX_BLOCK_SIZE_BYTES too small");
+
+    /** One free list for every pooled block size, in units of ELEM_ALIGN_BYTES */
+    static constexpr std::size_t NUM_FREE_LISTS = (MAX_BLOCK_SIZE_BYTES + ELEM_ALIGN_BYTES - 1) / ELEM_ALIGN_BYTES + 1;
+
+    /** Memory a block of the given size takes from a chunk */
+    static constexpr std::size_t BlockSize(std::size_t bytes)
+    {
+        return (bytes + ELEM_ALIGN_BYTES - 1) / ELEM_ALIGN_BYTES * ELEM_ALIGN_BYTES;
+    }
+
+    /** Whether an allocation is served from the pool */
+    static constexpr bool IsPooled(std::size_t bytes, std::size_t alignment)
+    {
+        return bytes <= MAX_BLOCK_SIZE_BYTES && alignment <= ELEM_ALIGN_BYTES && bytes > 0;
+    }
+
+private:
+    const std::size_t m_chunk_size_bytes;
+
+    /** Chunks allocated so far, all of m_chunk_size_bytes */
+    std::vector<char*> m_allocated_chunks;
+
+    /** Free list per block size, indexed by the size in units of ELEM_ALIGN_BYTES */
+    std::array<ListNode*, NUM_FREE_LISTS> m_free_lists;
+
+    /** Part of the newest chunk that has not been handed out yet */
+    char* m_available_memory_it;
+    char* m_available_memory_end;
+
+    void AllocateChunk()
+    {
+        // Hand the rest of the current chunk to the free list of its size, so nothing is lost
+        std::size_t remaining = m_available_memory_end - m_available_memory_it;
+        if (remaining > 0) {
+            std::size_t index = remaining / ELEM_ALIGN_BYTES;
+            m_free_lists[index] = new (m_available_memory_it) ListNode(m_free_lists[index]);
+        }
+
+        char* chunk = static_cast<char*>(::operator new(m_chunk_size_bytes));
+        m_allocated_chunks.push_back(chunk);
+        m_available_memory_it = chunk;
+        m_available_memory_end = chunk + m_chunk_size_bytes;
+    }
+
+public:
+    explicit PoolResource(std::size_t chunk_size_bytes = 256 * 1024)
+        : m_chunk_size_bytes(BlockSize(chunk_size_bytes < MAX_BLOCK_SIZE_BYTES ? MAX_BLOCK_SIZE_BYTES : chunk_size_bytes)),
+          m_available_memory_it(nullptr), m_available_memory_end(nullptr)
+    {
+        m_free_lists.fill(nullptr);
+    }
+
+    PoolResource(const PoolResource&) = delete;
+    PoolResource& operator=(const PoolResource&) = delete;
+
+    ~PoolResource()
+    {
+        for (char* chunk : m_allocated_chunks) {
+            ::operator delete(chunk);
+        }
+    }
+
+    void* Allocate(std::size_t bytes, std::size_t alignment)
+    {
+        if (!IsPooled(bytes, alignment)) {
+            return ::operator new(bytes);
+        }
+
+        const std::size_t block_size = BlockSize(bytes);
+        ListNode*& free_list = m_free_lists[block_size / ELEM_ALIGN_BYTES];
+        if (free_list) {
+            ListNode* node = free_list;
+            free_list = node->m_next;
+            return node;
+        }
+
+        if (static_cast<std::size_t>(m_available_memory_end - m_available_memory_it) < block_size) {
+            AllocateChunk();
+        }
+        void* block = m_available_memory_it;
+        m_available_memory_it += block_size;
+        return block;
+    }
+
+    void Deallocate(void* p, std::size_t bytes, std::size_t alignment) noexcept
+    {
+        if (!IsPooled(bytes, alignment)) {
+            ::operator delete(p);
+            return;
+        }
+
+        ListNode*& free_list = m_free_lists[BlockSize(bytes) / ELEM_ALIGN_BYTES];
+        free_list = new (p) ListNode(free_list);
+    }
+
+    std::size_t NumAllocatedChunks() const { return m_allocated_chunks.size(); }
+    std::size_t ChunkSizeBytes() const { return m_chunk_size_bytes; }
+};
+
+template <std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+constexpr std::size_t PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>::ELEM_ALIGN_BYTES;
+template <std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+constexpr std::size_t PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>::NUM_FREE_LISTS;
+
+/**
+ * Allocator handing out the memory of a PoolResource. Copies, including the rebound ones a
+ * container makes for its nodes and buckets, share the resource, which must outlive them.
+ */
+template <class T, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES = alignof(T)>
+class PoolAllocator
+{
+    PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>* m_resource;
+
+    template <typename U, std::size_t M, std::size_t A>
+    friend class PoolAllocator;
+
+public:
+    typedef T value_type;
+    typedef PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> ResourceType;
+
+    PoolAllocator(ResourceType* resource) noexcept : m_resource(resource) {}
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& other) noexcept : m_resource(other.m_resource) {}
+
+    template <typename U>
+    struct rebind {
+        typedef PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> other;
+    };
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(m_resource->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        m_resource->Deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    ResourceType* resource() const noexcept { return m_resource; }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& other) const noexcept
+    {
+        return m_resource == other.m_resource;
+    }
+
+    template <typename U>
+    bool operator!=(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& other) const noexcept
+    {
+        return !(*this == other);
+    }
+};
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_POOL_H
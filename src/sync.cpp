@@ -4,7 +4,11 @@
 
 #include <sync.h>
 
+#include <chrono>
+#include <map>
+#include <memory>
 #include <set>
+#include <tuple>
 #include <util.h>
 #include <utilstrencodings.h>
 
@@ -21,6 +25,127 @@ void PrintLockContention(const char* pszName, const char* pszFile, int nLine)
 }
 #endif /* DEBUG_LOCKCONTENTION */
 
+std::atomic<bool> g_lock_profile(DEFAULT_LOCK_PROFILE);
+
+struct LockProfileSite {
+    const std::string name;
+    const std::string file;
+    const int line;
+    std::atomic<uint64_t> nLocks{0};
+    std::atomic<uint64_t> nContended{0};
+    std::atomic<int64_t> nTotalWaitMicros{0};
+    std::atomic<int64_t> nMaxWaitMicros{0};
+    std::atomic<int64_t> nTotalHoldMicros{0};
+    std::atomic<int64_t> nMaxHoldMicros{0};
+    std::atomic<uint64_t> waitHistogram[LOCK_PROFILE_BUCKETS];
+    std::atomic<uint64_t> holdHistogram[LOCK_PROFILE_BUCKETS];
+
+    LockProfileSite(const char* pszName, const char* pszFile, int nLine) : name(pszName), file(pszFile), line(nLine)
+    {
+        for (int i = 0; i < LOCK_PROFILE_BUCKETS; i++) {
+            waitHistogram[i] = 0;
+            holdHistogram[i] = 0;
+        }
+    }
+};
+
+// The name and file of a site are string literals, so their addresses identify it
+typedef std::tuple<const char*, const char*, int> LockProfileKey;
+
+struct LockProfileData {
+    std::mutex mutex;
+    std::map<LockProfileKey, std::unique_ptr<LockProfileSite>> sites;
+};
+
+// Never destroyed, global destructors can still take profiled locks
+static LockProfileData& lockprofile = *new LockProfileData();
+
+// Sites this thread has looked up already, so a lock does not wait on lockprofile.mutex to be profiled
+static thread_local std::map<LockProfileKey, LockProfileSite*> lockprofile_cache;
+
+LockProfileSite* GetLockProfileSite(const char* pszName, const char* pszFile, int nLine)
+{
+    LockProfileKey key(pszName, pszFile, nLine);
+    auto it = lockprofile_cache.find(key);
+    if (it != lockprofile_cache.end())
+        return it->second;
+
+    std::lock_guard<std::mutex> lock(lockprofile.mutex);
+    std::unique_ptr<LockProfileSite>& site = lockprofile.sites[key];
+    if (!site)
+        site.reset(new LockProfileSite(pszName, pszFile, nLine));
+    lockprofile_cache.emplace(key, site.get());
+    return site.get();
+}
+
+int64_t GetLockProfileMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int LockProfileBucket(int64_t nMicros)
+{
+    int nBucket = 0;
+    while (nBucket < LOCK_PROFILE_BUCKETS - 1 && nMicros >= ((int64_t)1 << nBucket))
+        nBucket++;
+    return nBucket;
+}
+
+static void UpdateMax(std::atomic<int64_t>& nMax, int64_t nValue)
+{
+    int64_t nPrev = nMax.load(std::memory_order_relaxed);
+    while (nValue > nPrev && !nMax.compare_exchange_weak(nPrev, nValue, std::memory_order_relaxed)) {}
+}
+
+void RecordLockWait(LockProfileSite* site, int64_t nMicros, bool fContended)
+{
+    site->nLocks.fetch_add(1, std::memory_order_relaxed);
+    if (fContended)
+        site->nContended.fetch_add(1, std::memory_order_relaxed);
+    site->nTotalWaitMicros.fetch_add(nMicros, std::memory_order_relaxed);
+    UpdateMax(site->nMaxWaitMicros, nMicros);
+    site->waitHistogram[LockProfileBucket(nMicros)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void RecordLockHold(LockProfileSite* site, int64_t nMicros)
+{
+    site->nTotalHoldMicros.fetch_add(nMicros, std::memory_order_relaxed);
+    UpdateMax(site->nMaxHoldMicros, nMicros);
+    site->holdHistogram[LockProfileBucket(nMicros)].fetch_add(1, std::memory_order_relaxed);
+}
+
+template <typename T>
+static T ReadStat(std::atomic<T>& stat, bool fReset)
+{
+    return fReset ? stat.exchange(0, std::memory_order_relaxed) : stat.load(std::memory_order_relaxed);
+}
+
+std::vector<LockSiteStats> GetLockStats(bool fReset)
+{
+    std::vector<LockSiteStats> ret;
+    std::lock_guard<std::mutex> lock(lockprofile.mutex);
+    for (const auto& entry : lockprofile.sites) {
+        LockProfileSite& site = *entry.second;
+        LockSiteStats stats;
+        stats.name = site.name;
+        stats.file = site.file;
+        stats.line = site.line;
+        stats.nLocks = ReadStat(site.nLocks, fReset);
+        stats.nContended = ReadStat(site.nContended, fReset);
+        stats.nTotalWaitMicros = ReadStat(site.nTotalWaitMicros, fReset);
+        stats.nMaxWaitMicros = ReadStat(site.nMaxWaitMicros, fReset);
+        stats.nTotalHoldMicros = ReadStat(site.nTotalHoldMicros, fReset);
+        stats.nMaxHoldMicros = ReadStat(site.nMaxHoldMicros, fReset);
+        for (int i = 0; i < LOCK_PROFILE_BUCKETS; i++) {
+            stats.waitHistogram[i] = ReadStat(site.waitHistogram[i], fReset);
+            stats.holdHistogram[i] = ReadStat(site.holdHistogram[i], fReset);
+        }
+        if (stats.nLocks > 0)
+            ret.push_back(stats);
+    }
+    return ret;
+}
+
 #ifdef DEBUG_LOCKORDER
 //
 // Early deadlock detection.
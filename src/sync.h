@@ -8,9 +8,14 @@
 
 #include <threadsafety.h>
 
+#include <atomic>
 #include <condition_variable>
+#include <string>
 #include <thread>
 #include <mutex>
+#include <vector>
+
+#include <stdint.h>
 
 
 ////////////////////////////////////////////////
@@ -112,15 +117,67 @@ typedef std::unique_lock<std::mutex> WaitableLock;
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+/** Default for -lockprofile */
+static const bool DEFAULT_LOCK_PROFILE = false;
+
+/** Whether LOCK records how long it waits for and holds each critical section, set by -lockprofile */
+extern std::atomic<bool> g_lock_profile;
+
+/** Number of buckets of the lock profile histograms, bucket i counts times below 2^i microseconds and the last one the rest */
+static const int LOCK_PROFILE_BUCKETS = 24;
+
+struct LockProfileSite;
+
+/** Wait and hold times recorded for the LOCKs of a critical section at one place in the code */
+struct LockSiteStats {
+    std::string name;
+    std::string file;
+    int line;
+    uint64_t nLocks;
+    //! Locks that could not be taken right away
+    uint64_t nContended;
+    int64_t nTotalWaitMicros;
+    int64_t nMaxWaitMicros;
+    int64_t nTotalHoldMicros;
+    int64_t nMaxHoldMicros;
+    uint64_t waitHistogram[LOCK_PROFILE_BUCKETS];
+    uint64_t holdHistogram[LOCK_PROFILE_BUCKETS];
+};
+
+LockProfileSite* GetLockProfileSite(const char* pszName, const char* pszFile, int nLine);
+int64_t GetLockProfileMicros();
+void RecordLockWait(LockProfileSite* site, int64_t nMicros, bool fContended);
+void RecordLockHold(LockProfileSite* site, int64_t nMicros);
+/** The statistics of every site locked since startup or the last reset, optionally zeroing them */
+std::vector<LockSiteStats> GetLockStats(bool fReset = false);
+
 /** Wrapper around std::unique_lock<CCriticalSection> */
 class SCOPED_LOCKABLE CCriticalBlock
 {
 private:
     std::unique_lock<CCriticalSection> lock;
+    //! Where the lock profile records this lock, if it is enabled
+    LockProfileSite* pprofile = nullptr;
+    int64_t nProfileLocked = 0;
+
+    void EnterProfiled(const char* pszName, const char* pszFile, int nLine)
+    {
+        pprofile = GetLockProfileSite(pszName, pszFile, nLine);
+        int64_t nStart = GetLockProfileMicros();
+        bool fContended = !lock.try_lock();
+        if (fContended)
+            lock.lock();
+        nProfileLocked = GetLockProfileMicros();
+        RecordLockWait(pprofile, nProfileLocked - nStart, fContended);
+    }
 
     void Enter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(lock.mutex()));
+        if (g_lock_profile.load(std::memory_order_relaxed)) {
+            EnterProfiled(pszName, pszFile, nLine);
+            return;
+        }
 #ifdef DEBUG_LOCKCONTENTION
         if (!lock.try_lock()) {
             PrintLockContention(pszName, pszFile, nLine);
@@ -162,8 +219,11 @@ public:
 
     ~CCriticalBlock() UNLOCK_FUNCTION()
     {
-        if (lock.owns_lock())
+        if (lock.owns_lock()) {
+            if (pprofile)
+                RecordLockHold(pprofile, GetLockProfileMicros() - nProfileLocked);
             LeaveCritical();
+        }
     }
 
     operator bool()
@@ -4,9 +4,13 @@
 
 #include <util.h>
 
+#include <support/allocators/bufferpool.h>
+#include <support/allocators/pool.h>
 #include <support/allocators/secure.h>
 #include <test/test_bitcoin.h>
 
+#include <unordered_map>
+
 #include <boost/test/unit_test.hpp>
 
 BOOST_FIXTURE_TEST_SUITE(allocator_tests, BasicTestingSetup)
@@ -231,4 +235,104 @@ BOOST_AUTO_TEST_CASE(lockedpool_tests_live)
     BOOST_CHECK(pool.stats().used == initial.used);
 }
 
+BOOST_AUTO_TEST_CASE(pool_resource_tests)
+{
+    PoolResource<64, 8> resource(1024);
+
+    // Pooled blocks come from one chunk until it is used up
+    void* a0 = resource.Allocate(8, 8);
+    void* a1 = resource.Allocate(20, 8);
+    BOOST_CHECK(resource.NumAllocatedChunks() == 1);
+    BOOST_CHECK(static_cast<char*>(a1) - static_cast<char*>(a0) == 8);
+
+    // A freed block is reused by the next allocation of the same size only
+    resource.Deallocate(a1, 20, 8);
+    void* a2 = resource.Allocate(8, 8);
+    BOOST_CHECK(a2 != a1);
+    void* a3 = resource.Allocate(24, 8);
+    BOOST_CHECK(a3 == a1);
+
+    // Too large or too strictly aligned blocks are not pooled
+    void* a4 = resource.Allocate(65, 8);
+    void* a5 = resource.Allocate(16, 16);
+    BOOST_CHECK(resource.NumAllocatedChunks() == 1);
+    resource.Deallocate(a4, 65, 8);
+    resource.Deallocate(a5, 16, 16);
+
+    // The rest of a used up chunk is kept for its size
+    std::vector<void*> blocks;
+    for (int i = 0; i < 1024 / 64; i++) {
+        blocks.push_back(resource.Allocate(64, 8));
+    }
+    BOOST_CHECK(resource.NumAllocatedChunks() == 2);
+    for (void* p : blocks) {
+        resource.Deallocate(p, 64, 8);
+    }
+    resource.Deallocate(a0, 8, 8);
+    resource.Deallocate(a2, 8, 8);
+    resource.Deallocate(a3, 24, 8);
+}
+
+BOOST_AUTO_TEST_CASE(pool_allocator_tests)
+{
+    typedef PoolAllocator<std::pair<const int, uint64_t>, 64> Allocator;
+    Allocator::ResourceType resource;
+    {
+        std::unordered_map<int, uint64_t, std::hash<int>, std::equal_to<int>, Allocator> map(0, std::hash<int>(), std::equal_to<int>(), &resource);
+        for (int i = 0; i < 10000; i++) {
+            map[i] = i;
+        }
+        for (int i = 0; i < 10000; i += 2) {
+            map.erase(i);
+        }
+        size_t nChunks = resource.NumAllocatedChunks();
+        // Erased nodes make room for new ones
+        for (int i = 0; i < 10000; i += 2) {
+            map[-i - 1] = i;
+        }
+        BOOST_CHECK(resource.NumAllocatedChunks() == nChunks);
+        BOOST_CHECK(map.size() == 10000);
+        BOOST_CHECK(map[9999] == 9999);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(buffer_pool_tests)
+{
+    typedef BufferPool<std::vector<unsigned char>> Pool;
+    Pool pool;
+
+    std::vector<unsigned char> v = pool.Get(1000);
+    BOOST_CHECK(v.empty());
+    BOOST_CHECK(v.capacity() >= 1000);
+    v.resize(1000);
+    const unsigned char* pData = v.data();
+
+    // The storage comes back for a request of the same class
+    pool.Put(v);
+    BOOST_CHECK(v.empty() && v.capacity() == 0);
+    BOOST_CHECK_EQUAL(pool.FreeCount(1), 1U);
+    std::vector<unsigned char> w = pool.Get(600);
+    BOOST_CHECK(w.data() == pData);
+    BOOST_CHECK(w.empty());
+    BOOST_CHECK_EQUAL(pool.FreeCount(1), 0U);
+
+    // Small and huge vectors are left to the allocator
+    std::vector<unsigned char> small(10);
+    pool.Put(small);
+    std::vector<unsigned char> huge = pool.Get(Pool::MAX_CLASS_BYTES + 1);
+    BOOST_CHECK(huge.capacity() == 0);
+    huge.resize(3 * Pool::MAX_CLASS_BYTES);
+    pool.Put(huge);
+    for (size_t c = 0; c < Pool::NUM_CLASSES; c++)
+        BOOST_CHECK_EQUAL(pool.FreeCount(c), 0U);
+
+    // The number of free buffers of a class is bounded
+    for (int i = 0; i < 10; i++) {
+        std::vector<unsigned char> b;
+        b.reserve(Pool::MAX_CLASS_BYTES);
+        pool.Put(b);
+    }
+    BOOST_CHECK_EQUAL(pool.FreeCount(Pool::NUM_CLASSES - 1), 4U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,158 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <libzerocoin/Zerocoin.h>
+
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(bignum_tests, BasicTestingSetup)
+
+namespace {
+/** Random number of up to nBits bits, negated half of the time if fSigned */
+CBigNum RandBigNum(int nBits, bool fSigned)
+{
+    CBigNum n = CBigNum::RandKBitBigum(1 + InsecureRandRange(nBits));
+    return fSigned && InsecureRandBool() ? n * -1 : n;
+}
+
+/** The moduli to check against: odd ones use Montgomery multiplication, even ones the plain fallback */
+std::vector<CBigNum> TestModuli()
+{
+    std::vector<CBigNum> vModuli = {1, 2, 3, 4, 0x10001, CBigNum(1) << 64};
+    vModuli.push_back(CBigNum::generatePrime(256));
+    vModuli.push_back(CBigNum::generatePrime(512) * CBigNum::generatePrime(512));
+    vModuli.push_back((CBigNum::RandKBitBigum(1024) << 1) + 1);
+    vModuli.push_back(CBigNum::RandKBitBigum(1024) << 1);
+    return vModuli;
+}
+
+/** The product of each base to its exponent, with pow_mod and mul_mod */
+CBigNum ReferenceMulPowMod(const std::vector<CBigNum>& vBases, const std::vector<CBigNum>& vExps, const CBigNum& m)
+{
+    CBigNum ret = CBigNum(1) % m;
+    for (size_t i = 0; i < vBases.size(); i++)
+        ret = ret.mul_mod(vBases[i].pow_mod(vExps[i], m), m);
+    return ret;
+}
+
+/** Whether base can be raised to negative powers modulo m, OpenSSL has no inverses modulo 1 */
+bool IsInvertible(const CBigNum& base, const CBigNum& m)
+{
+    return m > 1 && (base % m).gcd(m) == 1;
+}
+
+/** A random base that is invertible modulo m > 1, or 0 modulo 1 */
+CBigNum RandInvertibleBase(const CBigNum& m)
+{
+    if (m == 1)
+        return 0;
+    CBigNum base;
+    do {
+        base = CBigNum::randBignum(m);
+    } while (base.gcd(m) != 1);
+    return base;
+}
+} // namespace
+
+BOOST_AUTO_TEST_CASE(mul_pow_mod_random)
+{
+    for (const CBigNum& m : TestModuli()) {
+        for (int i = 0; i < 8; i++) {
+            size_t nBases = 1 + InsecureRandRange(3);
+            std::vector<CBigNum> vBases, vExps;
+            std::vector<CBigNumPowTable> vTables;
+            vTables.reserve(nBases);
+            for (size_t j = 0; j < nBases; j++) {
+                vBases.push_back(RandInvertibleBase(m));
+                vExps.push_back(RandBigNum(j == 0 ? 1024 : 160, m != 1));
+                vTables.emplace_back(vBases.back(), m);
+            }
+            std::vector<const CBigNumPowTable*> vTablePtrs;
+            for (const CBigNumPowTable& table : vTables)
+                vTablePtrs.push_back(&table);
+            BOOST_CHECK_EQUAL(CBigNum::mul_pow_mod(vTablePtrs, vExps), ReferenceMulPowMod(vBases, vExps, m));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(mul_pow_mod_edge_cases)
+{
+    for (const CBigNum& m : TestModuli()) {
+        // bases of 0, 1 and m - 1, and one at least as large as the modulus, which the table reduces
+        std::vector<CBigNum> vBases = {0, 1, m - 1, m + 3, m * 5 + RandInvertibleBase(m)};
+        // zero, short and window-aligned exponents of either sign
+        std::vector<CBigNum> vExps = {0, 1, -1, 2, -2, 31, 32, -33, CBigNum(1) << 160, (CBigNum(1) << 160) - 1};
+        for (const CBigNum& base : vBases) {
+            CBigNumPowTable table(base, m);
+            for (const CBigNum& e : vExps) {
+                std::vector<const CBigNumPowTable*> vTablePtrs(1, &table);
+                std::vector<CBigNum> vExp(1, e);
+                if (e < 0 && !IsInvertible(base, m)) {
+                    // both pow_mod and mul_pow_mod refuse negative powers without an inverse
+                    BOOST_CHECK_THROW(CBigNum(base % m).pow_mod(e, m), bignum_error);
+                    BOOST_CHECK_THROW(CBigNum::mul_pow_mod(vTablePtrs, vExp), bignum_error);
+                    continue;
+                }
+                BOOST_CHECK_EQUAL(CBigNum::mul_pow_mod(vTablePtrs, vExp), ReferenceMulPowMod({base % m}, vExp, m));
+            }
+        }
+    }
+
+    // tables over different moduli or a mismatched number of exponents
+    CBigNumPowTable table3(2, 3), table5(2, 5);
+    BOOST_CHECK_THROW(CBigNum::mul_pow_mod({&table3, &table5}, {1, 1}), bignum_error);
+    BOOST_CHECK_THROW(CBigNum::mul_pow_mod({&table3}, {1, 1}), bignum_error);
+}
+
+BOOST_AUTO_TEST_CASE(fixed_base_table_random)
+{
+    for (const CBigNum& m : TestModuli()) {
+        for (int nMaxExpBits : {1, 5, 7, 160, 1024}) {
+            CBigNum base = RandInvertibleBase(m), base2 = RandInvertibleBase(m);
+            CBigNumFixedBaseTable table(base, m, nMaxExpBits), table2(base2, m, 160);
+            BOOST_CHECK_EQUAL(table.getMaxExpBits(), nMaxExpBits);
+            for (int i = 0; i < 8; i++) {
+                // mostly exponents that fit in the table, some that are wider or negative and fall back
+                CBigNum e = RandBigNum(InsecureRandRange(4) == 0 ? nMaxExpBits + 64 : nMaxExpBits, m != 1 && InsecureRandRange(4) == 0);
+                CBigNum e2 = RandBigNum(160, m != 1);
+                BOOST_CHECK_EQUAL(table.pow_mod(e), base.pow_mod(e, m));
+                BOOST_CHECK_EQUAL(CBigNumFixedBaseTable::mul_pow_mod({&table, &table2}, {e, e2}),
+                    ReferenceMulPowMod({base, base2}, {e, e2}, m));
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(fixed_base_table_edge_cases)
+{
+    for (const CBigNum& m : TestModuli()) {
+        std::vector<CBigNum> vBases = {0, 1, m - 1, m + 3, m * 5 + RandInvertibleBase(m)};
+        for (int nMaxExpBits : {0, 1, 10, 64}) {
+            CBigNum nMax = (CBigNum(1) << nMaxExpBits) - 1;
+            // zero, the widest exponent the table holds, the narrowest it doesn't, and their negations
+            std::vector<CBigNum> vExps = {0, 1, -1, nMax, nMax + 1, CBigNum(1) << (nMaxExpBits + 5), nMax * -1, (nMax + 1) * -1};
+            for (const CBigNum& base : vBases) {
+                CBigNumFixedBaseTable table(base, m, nMaxExpBits);
+                CBigNumPowTable powTable(base, m);
+                for (const CBigNum& e : vExps) {
+                    if (e < 0 && !IsInvertible(base, m)) {
+                        BOOST_CHECK_THROW(table.pow_mod(e), bignum_error);
+                        continue;
+                    }
+                    CBigNum expected = CBigNum(base % m).pow_mod(e, m);
+                    BOOST_CHECK_EQUAL(table.pow_mod(e), expected);
+                    BOOST_CHECK_EQUAL(CBigNum::mul_pow_mod({&powTable}, {e}), expected);
+                }
+            }
+        }
+    }
+
+    CBigNumFixedBaseTable table3(2, 3, 8), table5(2, 5, 8);
+    BOOST_CHECK_THROW(CBigNumFixedBaseTable::mul_pow_mod({&table3, &table5}, {1, 1}), bignum_error);
+    BOOST_CHECK_THROW(CBigNumFixedBaseTable::mul_pow_mod({&table3}, {1, 1}), bignum_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -159,4 +159,20 @@ BOOST_AUTO_TEST_CASE(bip32_test3) {
     RunTest(test3);
 }
 
+BOOST_AUTO_TEST_CASE(bip32_derive_ids) {
+    std::vector<unsigned char> seed = ParseHex(test1.strHexMaster);
+    CExtKey key;
+    key.SetMaster(seed.data(), seed.size());
+    CExtPubKey pubkey = key.Neutered();
+
+    // More than the multi-way kernels take at once, with some left over
+    CKeyID ids[21];
+    pubkey.pubkey.DeriveIds(ids, 5, 21, pubkey.vchChainCode);
+    for (unsigned int i = 0; i < 21; i++) {
+        CExtPubKey child;
+        BOOST_CHECK(pubkey.Derive(child, 5 + i));
+        BOOST_CHECK(ids[i] == child.pubkey.GetID());
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
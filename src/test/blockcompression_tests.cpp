@@ -0,0 +1,85 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockcompression.h>
+
+#include <chain.h>
+#include <chainparams.h>
+#include <clientversion.h>
+#include <random.h>
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockcompression_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(frame_roundtrip)
+{
+    // Repetitive data, like the serialized scripts and bignums of blocks, shrinks
+    std::vector<char> data;
+    for (int i = 0; i < 10000; i++)
+        data.push_back((char)(i % 97));
+
+    std::vector<char> frame;
+    BOOST_CHECK(CompressFrame(data.data(), data.size(), frame));
+    BOOST_CHECK(frame.size() < data.size());
+
+    CDataStream stream(SER_DISK, CLIENT_VERSION);
+    DecompressFrame(frame.data(), frame.size(), stream, data.size());
+    BOOST_CHECK(std::vector<char>(stream.begin(), stream.end()) == data);
+
+    // Larger than allowed
+    BOOST_CHECK_THROW(DecompressFrame(frame.data(), frame.size(), stream, data.size() - 1), std::ios_base::failure);
+
+    // Any corruption of the data or the checksum is detected
+    for (size_t i : {(size_t)4, (size_t)COMPRESSED_FRAME_HEADER_SIZE, frame.size() - 1}) {
+        std::vector<char> corrupt(frame);
+        corrupt[i] ^= 1;
+        BOOST_CHECK_THROW(DecompressFrame(corrupt.data(), corrupt.size(), stream, data.size()), std::ios_base::failure);
+    }
+    BOOST_CHECK_THROW(DecompressFrame(frame.data(), COMPRESSED_FRAME_HEADER_SIZE, stream, data.size()), std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_CASE(frame_incompressible)
+{
+    // Random data does not shrink and is left to be stored as it is
+    std::vector<unsigned char> data(1000);
+    GetRandBytes(data.data(), data.size());
+    std::vector<char> frame;
+    BOOST_CHECK(!CompressFrame((const char*)data.data(), data.size(), frame));
+    BOOST_CHECK(frame.empty());
+}
+
+BOOST_AUTO_TEST_CASE(compressed_message_start)
+{
+    const CMessageHeader::MessageStartChars& messageStart = Params().MessageStart();
+    CMessageHeader::MessageStartChars compressedStart;
+    GetCompressedMessageStart(messageStart, compressedStart);
+    BOOST_CHECK(IsCompressedMessageStart(compressedStart, messageStart));
+    BOOST_CHECK(!IsCompressedMessageStart(messageStart, messageStart));
+    // Found by scanning for the first byte of the message start
+    BOOST_CHECK_EQUAL(compressedStart[0], messageStart[0]);
+}
+
+BOOST_AUTO_TEST_CASE(block_file_info_flags)
+{
+    CBlockFileInfo info;
+    info.nBlocks = 3;
+    info.nSize = 1000;
+    info.nFlags = BLOCK_FILE_COMPRESSED;
+    CDataStream stream(SER_DISK, CLIENT_VERSION);
+    stream << info;
+    CBlockFileInfo info2;
+    stream >> info2;
+    BOOST_CHECK_EQUAL(info2.nFlags, (unsigned int)BLOCK_FILE_COMPRESSED);
+
+    // Entries written before the flags existed read as uncompressed files
+    stream << VARINT(info.nBlocks) << VARINT(info.nSize) << VARINT(info.nUndoSize) << VARINT(info.nHeightFirst)
+           << VARINT(info.nHeightLast) << VARINT(info.nTimeFirst) << VARINT(info.nTimeLast);
+    stream >> info2;
+    BOOST_CHECK_EQUAL(info2.nSize, 1000U);
+    BOOST_CHECK_EQUAL(info2.nFlags, 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
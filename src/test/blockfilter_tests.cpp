@@ -0,0 +1,182 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockfilter.h>
+#include <ghost-address/stealth.h>
+#include <streams.h>
+
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockfilter_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(bitstream_reader_writer)
+{
+    std::vector<unsigned char> data;
+    {
+        CVectorWriter stream(SER_NETWORK, 0, data, 0);
+        BitStreamWriter<CVectorWriter> bitwriter(stream);
+        bitwriter.Write(0, 1);
+        bitwriter.Write(2, 2);
+        bitwriter.Write(6, 3);
+        bitwriter.Write(11, 4);
+        bitwriter.Write(1, 5);
+        bitwriter.Write(32, 6);
+        bitwriter.Write(7, 7);
+        bitwriter.Write(30497, 16);
+        bitwriter.Flush();
+    }
+    BOOST_CHECK_EQUAL(data.size(), 6U);
+
+    VectorReader stream(SER_NETWORK, 0, data, 0);
+    BitStreamReader<VectorReader> bitreader(stream);
+    BOOST_CHECK_EQUAL(bitreader.Read(1), 0U);
+    BOOST_CHECK_EQUAL(bitreader.Read(2), 2U);
+    BOOST_CHECK_EQUAL(bitreader.Read(3), 6U);
+    BOOST_CHECK_EQUAL(bitreader.Read(4), 11U);
+    BOOST_CHECK_EQUAL(bitreader.Read(5), 1U);
+    BOOST_CHECK_EQUAL(bitreader.Read(6), 32U);
+    BOOST_CHECK_EQUAL(bitreader.Read(7), 7U);
+    BOOST_CHECK_EQUAL(bitreader.Read(16), 30497U);
+    BOOST_CHECK_THROW(bitreader.Read(8), std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_CASE(gcsfilter_test)
+{
+    GCSFilter::ElementSet included_elements, excluded_elements;
+    for (int i = 0; i < 100; ++i) {
+        GCSFilter::Element element1(32);
+        element1[0] = i;
+        included_elements.insert(std::move(element1));
+
+        GCSFilter::Element element2(32);
+        element2[1] = i;
+        excluded_elements.insert(std::move(element2));
+    }
+
+    GCSFilter filter({0, 0, 10, 1 << 10}, included_elements);
+    for (const GCSFilter::Element& element : included_elements) {
+        BOOST_CHECK(filter.Match(element));
+
+        GCSFilter::ElementSet query = excluded_elements;
+        query.insert(element);
+        BOOST_CHECK(filter.MatchAny(query));
+    }
+
+    // The encoding round-trips and a truncated or padded encoding is rejected
+    GCSFilter decoded(filter.GetParams(), filter.GetEncoded());
+    BOOST_CHECK_EQUAL(decoded.GetN(), 100U);
+    BOOST_CHECK(decoded.MatchAny(included_elements));
+
+    std::vector<unsigned char> truncated(filter.GetEncoded().begin(), filter.GetEncoded().end() - 1);
+    BOOST_CHECK_THROW(GCSFilter(filter.GetParams(), truncated), std::ios_base::failure);
+    std::vector<unsigned char> padded = filter.GetEncoded();
+    padded.push_back(0);
+    BOOST_CHECK_THROW(GCSFilter(filter.GetParams(), padded), std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_CASE(gcsfilter_default_constructor)
+{
+    GCSFilter filter;
+    BOOST_CHECK_EQUAL(filter.GetN(), 0U);
+    BOOST_CHECK_EQUAL(filter.GetEncoded().size(), 1U);
+    BOOST_CHECK(!filter.Match(GCSFilter::Element(32)));
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_basic_test)
+{
+    CScript included_scripts[4], excluded_scripts[3];
+
+    // First two are outputs on a single transaction.
+    included_scripts[0] << std::vector<unsigned char>(0, 65) << OP_CHECKSIG;
+    included_scripts[1] << OP_DUP << OP_HASH160 << std::vector<unsigned char>(1, 20) << OP_EQUALVERIFY << OP_CHECKSIG;
+
+    // Third is an output of a second transaction.
+    included_scripts[2] << OP_1 << std::vector<unsigned char>(2, 33) << OP_1 << OP_CHECKMULTISIG;
+
+    // Fourth is a prevout script spent by the block.
+    included_scripts[3] << OP_0 << std::vector<unsigned char>(3, 32);
+
+    // Data and empty scripts are not included, nor are scripts the block neither creates nor spends.
+    excluded_scripts[0] << OP_RETURN << OP_4 << OP_ADD << OP_8 << OP_EQUAL;
+    excluded_scripts[2] << OP_2 << std::vector<unsigned char>(4, 33) << OP_1 << OP_CHECKMULTISIG;
+
+    // A stealth data output adds the stealth elements instead of its script.
+    CScript stealth_script;
+    std::vector<unsigned char> stealth_data(1 + 33 + 5, 0);
+    stealth_data[0] = DO_STEALTH;
+    stealth_data[1] = 0x02;
+    stealth_data[34] = DO_STEALTH_PREFIX;
+    uint32_t nPrefix = 0xA5A5A5A5;
+    memcpy(&stealth_data[35], &nPrefix, 4);
+    stealth_script << OP_RETURN << stealth_data;
+
+    CMutableTransaction tx_1;
+    tx_1.vout.emplace_back(100, included_scripts[0]);
+    tx_1.vout.emplace_back(200, included_scripts[1]);
+    tx_1.vout.emplace_back(0, excluded_scripts[0]);
+    tx_1.vout.emplace_back(0, stealth_script);
+
+    CMutableTransaction tx_2;
+    tx_2.vout.emplace_back(300, included_scripts[2]);
+    tx_2.vout.emplace_back(0, excluded_scripts[1]);
+
+    CBlock block;
+    block.vtx.push_back(MakeTransactionRef(tx_1));
+    block.vtx.push_back(MakeTransactionRef(tx_2));
+
+    CBlockUndo block_undo;
+    block_undo.vtxundo.emplace_back();
+    block_undo.vtxundo.back().vprevout.emplace_back(CTxOut(500, included_scripts[3]), 1000, true);
+
+    BlockFilter block_filter(BlockFilterType::BASIC, block, block_undo);
+    const GCSFilter& filter = block_filter.GetFilter();
+
+    for (const CScript& script : included_scripts) {
+        BOOST_CHECK(filter.Match(GCSFilter::Element(script.begin(), script.end())));
+    }
+    for (const CScript& script : excluded_scripts) {
+        BOOST_CHECK(!filter.Match(GCSFilter::Element(script.begin(), script.end())));
+    }
+    BOOST_CHECK(!filter.Match(GCSFilter::Element(stealth_script.begin(), stealth_script.end())));
+    BOOST_CHECK(filter.Match(StealthFilterElement()));
+    BOOST_CHECK(filter.Match(StealthPrefixFilterElement(8, 0x000000A5)));
+    BOOST_CHECK(filter.Match(StealthPrefixFilterElement(32, nPrefix)));
+    BOOST_CHECK(!filter.Match(StealthPrefixFilterElement(8, 0x000000A4)));
+
+    // Test serialization/unserialization.
+    BlockFilter block_filter2;
+
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << block_filter;
+    stream >> block_filter2;
+
+    BOOST_CHECK(block_filter.GetFilterType() == block_filter2.GetFilterType());
+    BOOST_CHECK(block_filter.GetBlockHash() == block_filter2.GetBlockHash());
+    BOOST_CHECK(block_filter.GetEncodedFilter() == block_filter2.GetEncodedFilter());
+
+    // The header commits to the filter and the previous header
+    uint256 header = block_filter.ComputeHeader(uint256());
+    BOOST_CHECK(header != block_filter.ComputeHeader(header));
+    BOOST_CHECK(header == block_filter2.ComputeHeader(uint256()));
+
+    BlockFilter default_ctor_block_filter;
+    BOOST_CHECK(default_ctor_block_filter.GetFilterType() == BlockFilterType::INVALID);
+    BOOST_CHECK(default_ctor_block_filter.GetBlockHash().IsNull());
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_type_names)
+{
+    BOOST_CHECK_EQUAL(BlockFilterTypeName(BlockFilterType::BASIC), "basic");
+    BOOST_CHECK_EQUAL(BlockFilterTypeName(static_cast<BlockFilterType>(255)), "");
+
+    BlockFilterType filter_type;
+    BOOST_CHECK(BlockFilterTypeByName("basic", filter_type));
+    BOOST_CHECK(filter_type == BlockFilterType::BASIC);
+
+    BOOST_CHECK(!BlockFilterTypeByName("unknown", filter_type));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
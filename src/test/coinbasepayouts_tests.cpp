@@ -0,0 +1,70 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <coinbasepayouts.h>
+#include <primitives/transaction.h>
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(coinbasepayouts_tests, BasicTestingSetup)
+
+static const std::string ADDRESS_1 = "NVbGEghDbxPUe97oY8N5RvagQ61cHQiouW";
+static const std::string ADDRESS_2 = "NWF7QNfT1b8a9dSQmVTT6hcwzwEVYVmDsG";
+
+BOOST_AUTO_TEST_CASE(coinbasepayouts_devfund)
+{
+    CCoinbasePayouts payouts({}, {ADDRESS_1, ADDRESS_2});
+    BOOST_CHECK_EQUAL(payouts.DevFund().size(), 2U);
+    BOOST_CHECK(!payouts.DevFund()[0].script.empty());
+    BOOST_CHECK(payouts.DevFund()[0].script != payouts.DevFund()[1].script);
+
+    CMutableTransaction tx;
+    tx.vout.push_back(CTxOut(50 * COIN, CScript()));
+    tx.vout.push_back(CTxOut(5 * COIN, payouts.DevFund()[0].script));
+    BOOST_CHECK(!payouts.PaysDevFund(tx, {5 * COIN, 2 * COIN}));
+
+    // the wrong amount does not count
+    tx.vout.push_back(CTxOut(3 * COIN, payouts.DevFund()[1].script));
+    BOOST_CHECK(!payouts.PaysDevFund(tx, {5 * COIN, 2 * COIN}));
+
+    tx.vout.push_back(CTxOut(2 * COIN, payouts.DevFund()[1].script));
+    BOOST_CHECK(payouts.PaysDevFund(tx, {5 * COIN, 2 * COIN}));
+
+    // the order of the outputs does not matter
+    std::swap(tx.vout[1], tx.vout[3]);
+    BOOST_CHECK(payouts.PaysDevFund(tx, {5 * COIN, 2 * COIN}));
+}
+
+BOOST_AUTO_TEST_CASE(coinbasepayouts_shared_script)
+{
+    // payees sharing a script need an output each, unless one output pays both amounts
+    CCoinbasePayouts payouts({}, {ADDRESS_1, ADDRESS_1});
+    CMutableTransaction tx;
+    tx.vout.push_back(CTxOut(5 * COIN, payouts.DevFund()[0].script));
+    BOOST_CHECK(!payouts.PaysDevFund(tx, {5 * COIN, 2 * COIN}));
+    BOOST_CHECK(payouts.PaysDevFund(tx, {5 * COIN, 5 * COIN}));
+    tx.vout.push_back(CTxOut(2 * COIN, payouts.DevFund()[1].script));
+    BOOST_CHECK(payouts.PaysDevFund(tx, {5 * COIN, 2 * COIN}));
+}
+
+BOOST_AUTO_TEST_CASE(coinbasepayouts_airdrop)
+{
+    CCoinbasePayouts payouts({ADDRESS_1, ADDRESS_2}, {});
+    CMutableTransaction tx;
+    tx.vout.push_back(CTxOut(1 * COIN, payouts.Airdrop()[0].script));
+    tx.vout.push_back(CTxOut(4 * COIN, payouts.Airdrop()[1].script));
+    BOOST_CHECK(!payouts.PaysAirdrop(tx, {1 * COIN, 2 * COIN}));
+    BOOST_CHECK(payouts.PaysAirdrop(tx, {1 * COIN, 2 * COIN, 4 * COIN}));
+    BOOST_CHECK(!payouts.PaysAirdrop(CMutableTransaction(), {}));
+}
+
+BOOST_AUTO_TEST_CASE(coinbasepayouts_selected_chain)
+{
+    BOOST_CHECK_EQUAL(CoinbasePayouts().Airdrop().size(), 100U);
+    BOOST_CHECK_EQUAL(CoinbasePayouts().DevFund().size(), 2U);
+    BOOST_CHECK_EQUAL(CoinbasePayouts().DevFund()[0].address, ADDRESS_1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -69,6 +69,11 @@ public:
             hashBestBlock_ = hashBlock;
         return true;
     }
+
+    bool BatchWritePartial(CCoinsMap& mapCoins, const uint256& hashBlock) override
+    {
+        return BatchWrite(mapCoins, uint256());
+    }
 };
 
 class CCoinsViewCacheTest : public CCoinsViewCache
@@ -586,7 +591,8 @@ void GetCoinsMapEntry(const CCoinsMap& map, CAmount& value, char& flags)
 
 void WriteCoinsViewEntry(CCoinsView& view, CAmount value, char flags)
 {
-    CCoinsMap map;
+    CCoinsMapMemoryResource resource;
+    CCoinsMap map(0, SaltedOutpointHasher(), std::equal_to<COutPoint>(), &resource);
     InsertCoinsMapEntry(map, value, flags);
     view.BatchWrite(map, {});
 }
@@ -855,4 +861,106 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_AUTO_TEST_CASE(ccoins_write_oldest)
+{
+    /* Check that WriteOldest and Sync write the modified entries in the order
+     * they were modified and keep the written coins cached as clean entries.
+     */
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache(&base);
+    cache.SetTrackDirty(true);
+    uint256 hashBlock = InsecureRand256();
+    cache.SetBestBlock(hashBlock);
+
+    std::vector<COutPoint> outpoints;
+    for (int i = 0; i < 4; i++) {
+        outpoints.push_back(COutPoint(InsecureRand256(), 0));
+        cache.AddCoin(outpoints.back(), Coin(CTxOut(VALUE1, CScript()), 1, false), false);
+    }
+
+    // a tiny limit writes exactly one entry, the oldest
+    BOOST_CHECK(cache.WriteOldest(1));
+    Coin coin;
+    BOOST_CHECK(base.GetCoin(outpoints[0], coin));
+    BOOST_CHECK(!base.GetCoin(outpoints[1], coin));
+    BOOST_CHECK_EQUAL(cache.map().at(outpoints[0]).flags, 0);
+    BOOST_CHECK_EQUAL(cache.map().at(outpoints[1]).flags, DIRTY | FRESH);
+    BOOST_CHECK(base.GetBestBlock().IsNull());
+
+    // a fresh coin spent before it was written never reaches the base
+    BOOST_CHECK(cache.SpendCoin(outpoints[1]));
+    // a written coin that is spent has to be erased from the base
+    BOOST_CHECK(cache.SpendCoin(outpoints[0]));
+    BOOST_CHECK_EQUAL(cache.map().at(outpoints[0]).flags, DIRTY);
+
+    BOOST_CHECK(cache.Sync(1));
+    BOOST_CHECK(!base.GetCoin(outpoints[0], coin) || coin.IsSpent());
+    BOOST_CHECK(!base.GetCoin(outpoints[1], coin));
+    BOOST_CHECK(base.GetCoin(outpoints[2], coin));
+    BOOST_CHECK(base.GetCoin(outpoints[3], coin));
+    BOOST_CHECK(base.GetBestBlock() == hashBlock);
+    BOOST_CHECK(!cache.HasDirtyCoins());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 2U);
+    BOOST_CHECK_EQUAL(cache.map().at(outpoints[2]).flags, 0);
+    BOOST_CHECK_EQUAL(cache.map().at(outpoints[3]).flags, 0);
+
+    cache.Trim(0);
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+    cache.SelfTest();
+}
+
+BOOST_FIXTURE_TEST_CASE(ccoinsviewdb_shards, TestingSetup)
+{
+    CCoinsViewDB dbSharded(1 << 23, true, false, 4);
+    std::map<COutPoint, Coin> mapExpected;
+    {
+        CCoinsViewCache cache(&dbSharded);
+        for (int i = 0; i < 200; i++) {
+            uint256 txid = InsecureRand256();
+            for (uint32_t n = 0; n < 3; n++) {
+                Coin coin;
+                coin.out.nValue = InsecureRand32();
+                coin.nHeight = i;
+                mapExpected[COutPoint(txid, n)] = coin;
+                cache.AddCoin(COutPoint(txid, n), std::move(coin), false);
+            }
+        }
+        cache.SetBestBlock(InsecureRand256());
+        BOOST_CHECK(cache.Flush());
+    }
+
+    // Spend some in a second flush
+    uint256 hashBest = InsecureRand256();
+    {
+        CCoinsViewCache cache(&dbSharded);
+        for (auto it = mapExpected.begin(); it != mapExpected.end();) {
+            if (InsecureRandBool()) {
+                BOOST_CHECK(cache.SpendCoin(it->first));
+                it = mapExpected.erase(it);
+            } else {
+                it++;
+            }
+        }
+        cache.SetBestBlock(hashBest);
+        BOOST_CHECK(cache.Flush());
+    }
+    BOOST_CHECK(dbSharded.GetBestBlock() == hashBest);
+    BOOST_CHECK(dbSharded.GetHeadBlocks().empty());
+
+    // The cursor visits the coins of all shards in outpoint order
+    std::unique_ptr<CCoinsViewCursor> pcursor(dbSharded.Cursor());
+    auto itExpected = mapExpected.begin();
+    for (; pcursor->Valid(); pcursor->Next(), itExpected++) {
+        COutPoint outpoint;
+        Coin coin;
+        BOOST_CHECK(pcursor->GetKey(outpoint));
+        BOOST_CHECK(pcursor->GetValue(coin));
+        BOOST_REQUIRE(itExpected != mapExpected.end());
+        BOOST_CHECK(outpoint == itExpected->first);
+        BOOST_CHECK_EQUAL(coin.out.nValue, itExpected->second.out.nValue);
+        BOOST_CHECK(dbSharded.HaveCoin(outpoint));
+    }
+    BOOST_CHECK(itExpected == mapExpected.end());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -4,12 +4,14 @@
 
 #include <crypto/aes.h>
 #include <crypto/chacha20.h>
+#include <crypto/Lyra2RE/Lyra2RE.h>
 #include <crypto/ripemd160.h>
 #include <crypto/sha1.h>
 #include <crypto/sha256.h>
 #include <crypto/sha512.h>
 #include <crypto/hmac_sha256.h>
 #include <crypto/hmac_sha512.h>
+#include <hash.h>
 #include <random.h>
 #include <utilstrencodings.h>
 #include <test/test_bitcoin.h>
@@ -56,6 +58,13 @@ void TestSHA256(const std::string &in, const std::string &hexout) { TestVector(C
 void TestSHA512(const std::string &in, const std::string &hexout) { TestVector(CSHA512(), in, ParseHex(hexout));}
 void TestRIPEMD160(const std::string &in, const std::string &hexout) { TestVector(CRIPEMD160(), in, ParseHex(hexout));}
 
+void TestLyra2RE2(const std::string &hexin, const std::string &hexout) {
+    std::vector<unsigned char> in = ParseHex(hexin), out(32);
+    BOOST_REQUIRE_EQUAL(in.size(), 80U);
+    lyra2re2_hash((const char*)in.data(), (char*)out.data());
+    BOOST_CHECK_EQUAL(HexStr(out), hexout);
+}
+
 void TestHMACSHA256(const std::string &hexkey, const std::string &hexin, const std::string &hexout) {
     std::vector<unsigned char> key = ParseHex(hexkey);
     TestVector(CHMAC_SHA256(key.data(), key.size()), ParseHex(hexin), ParseHex(hexout));
@@ -305,6 +314,108 @@ BOOST_AUTO_TEST_CASE(sha512_testvectors) {
                "37de8c3ef5459d76a52cedc02dc499a3c9ed9dedbfb3281afd9653b8a112fafc");
 }
 
+BOOST_AUTO_TEST_CASE(sha256d64)
+{
+    for (int i = 0; i <= 32; ++i) {
+        unsigned char in[64 * 32];
+        unsigned char out1[32 * 32], out2[32 * 32];
+        for (int j = 0; j < 64 * i; ++j) {
+            in[j] = InsecureRandBits(8);
+        }
+        for (int j = 0; j < i; ++j) {
+            CHash256().Write(in + 64 * j, 64).Finalize(out1 + 32 * j);
+        }
+        SHA256D64(out2, in, i);
+        BOOST_CHECK(memcmp(out1, out2, 32 * i) == 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(sha512_finalize_multi)
+{
+    unsigned char key[32], in[200 * 9];
+    for (size_t j = 0; j < sizeof(key); ++j) {
+        key[j] = InsecureRandBits(8);
+    }
+    for (size_t j = 0; j < sizeof(in); ++j) {
+        in[j] = InsecureRandBits(8);
+    }
+    // Messages ending in one more block, and ones that don't
+    for (size_t len : {0, 37, 64, 111, 112, 200}) {
+        for (size_t n = 0; n <= 9; ++n) {
+            unsigned char out1[64 * 9], out2[64 * 9];
+            CSHA512 prefix;
+            prefix.Write(key, sizeof(key));
+            for (size_t j = 0; j < n; ++j) {
+                CSHA512(prefix).Write(in + len * j, len).Finalize(out1 + 64 * j);
+            }
+            prefix.FinalizeMulti(in, len, n, out2);
+            BOOST_CHECK(memcmp(out1, out2, 64 * n) == 0);
+
+            CHMAC_SHA512 hmac(key, sizeof(key));
+            for (size_t j = 0; j < n; ++j) {
+                CHMAC_SHA512(hmac).Write(in + len * j, len).Finalize(out1 + 64 * j);
+            }
+            hmac.FinalizeMulti(in, len, n, out2);
+            BOOST_CHECK(memcmp(out1, out2, 64 * n) == 0);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ripemd160_32)
+{
+    for (int i = 0; i <= 32; ++i) {
+        unsigned char in[32 * 32];
+        unsigned char out1[20 * 32], out2[20 * 32];
+        for (int j = 0; j < 32 * i; ++j) {
+            in[j] = InsecureRandBits(8);
+        }
+        for (int j = 0; j < i; ++j) {
+            CRIPEMD160().Write(in + 32 * j, 32).Finalize(out1 + 20 * j);
+        }
+        RIPEMD160_32(out2, in, i);
+        BOOST_CHECK(memcmp(out1, out2, 20 * i) == 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(lyra2re2_testvectors)
+{
+    std::vector<unsigned char> in(80 * 16), out1(32 * 16), out2(32);
+    for (size_t j = 0; j < in.size(); ++j) {
+        in[j] = InsecureRandBits(8);
+    }
+    BOOST_REQUIRE(lyra2re_select("standard"));
+    for (size_t j = 0; j < 16; ++j) {
+        lyra2re2_hash((const char*)&in[80 * j], (char*)&out1[32 * j]);
+    }
+
+    // Every implementation the CPU supports must give the same hashes
+    for (const char* impl : {"standard", "sse2", "avx2"}) {
+        if (!lyra2re_select(impl)) {
+            BOOST_TEST_MESSAGE("lyra2re2 " << impl << " not supported, skipped");
+            continue;
+        }
+        BOOST_TEST_MESSAGE("lyra2re2 " << impl);
+        TestLyra2RE2(std::string(160, '0'),
+                     "a297c8d991274c8727f515d4b129e18ddb1c61b31c552c963efce71095baa90c");
+        TestLyra2RE2("000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+                     "202122232425262728292a2b2c2d2e2f303132333435363738393a3b3c3d3e3f"
+                     "404142434445464748494a4b4c4d4e4f",
+                     "2246faafca15a01a35c81a3f801fe8338942565bdb75a505517372aa0c7afdd0");
+        TestLyra2RE2(std::string(160, 'f'),
+                     "147d0e0cb1522cd29c501844019d2171b7eabb21cd9a413403ce6a897f0ef6ae");
+        // The main network genesis block header, whose hash meets its target
+        TestLyra2RE2("0100000000000000000000000000000000000000000000000000000000000000"
+                     "000000003d87f095f6607358306d66ffd7e0944fd97b963a9f1ca344b1443a7a"
+                     "5518c1066e44c15af0ff0f1e01141100",
+                     "894f0d3d11d55db820ba1feb5474c1c803be9682155ce169d5a6c65a31070000");
+        for (size_t j = 0; j < 16; ++j) {
+            lyra2re2_hash((const char*)&in[80 * j], (char*)out2.data());
+            BOOST_CHECK(memcmp(&out1[32 * j], out2.data(), 32) == 0);
+        }
+    }
+    lyra2re_autodetect();
+}
+
 BOOST_AUTO_TEST_CASE(hmac_sha256_testvectors) {
     // test cases 1, 2, 3, 4, 6 and 7 of RFC 4231
     TestHMACSHA256("0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b0b",
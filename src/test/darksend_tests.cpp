@@ -0,0 +1,120 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <ghostnode/activeghostnode.h>
+#include <ghostnode/darksend.h>
+#include <ghostnode/ghostnode.h>
+#include <ghostnode/ghostnodeman.h>
+#include <ghostnode/instantx.h>
+#include <ghostnode/spork.h>
+#include <key.h>
+#include <utiltime.h>
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+// SPORK_6_NEW_SIGS is off by default until a time far ahead, which the mock time can move past
+const int64_t nTimeOldSigs = SPORK_6_NEW_SIGS_DEFAULT - 60;
+const int64_t nTimeNewSigs = SPORK_6_NEW_SIGS_DEFAULT + 60;
+
+struct DarksendSigTestingSetup : public BasicTestingSetup {
+    CKey key;
+    CPubKey pubkey;
+
+    DarksendSigTestingSetup()
+    {
+        key.MakeNewKey(true);
+        pubkey = key.GetPubKey();
+    }
+
+    ~DarksendSigTestingSetup()
+    {
+        SetMockTime(0);
+    }
+};
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE(darksend_tests, DarksendSigTestingSetup)
+
+BOOST_AUTO_TEST_CASE(ghostnode_ping_signatures)
+{
+    CGhostnodePing mnp;
+    mnp.vin = CTxIn(COutPoint(InsecureRand256(), 0));
+    mnp.blockHash = InsecureRand256();
+    int nDos;
+
+    SetMockTime(nTimeOldSigs);
+    BOOST_CHECK(!sporkManager.IsSporkActive(SPORK_6_NEW_SIGS));
+    BOOST_CHECK(mnp.Sign(key, pubkey));
+    std::string strError;
+    BOOST_CHECK(darkSendSigner.VerifyMessage(pubkey, mnp.vchSig, mnp.GetStrMessage(), strError));
+    BOOST_CHECK(mnp.CheckSignature(pubkey, nDos));
+    CGhostnodePing mnpOld = mnp;
+
+    SetMockTime(nTimeNewSigs);
+    BOOST_CHECK(sporkManager.IsSporkActive(SPORK_6_NEW_SIGS));
+    BOOST_CHECK(mnp.Sign(key, pubkey));
+    BOOST_CHECK(mnp.vchSig != mnpOld.vchSig);
+    BOOST_CHECK(mnp.CheckSignature(pubkey, nDos));
+
+    // a ping signed over the text message is rejected once the spork is active
+    BOOST_CHECK(!mnpOld.CheckSignature(pubkey, nDos));
+    BOOST_CHECK_EQUAL(nDos, 33);
+}
+
+BOOST_AUTO_TEST_CASE(ghostnode_broadcast_signatures)
+{
+    CKey keyGhostnode;
+    keyGhostnode.MakeNewKey(true);
+    CGhostnodeBroadcast mnb(CService(CNetAddr(), 6214), CTxIn(COutPoint(InsecureRand256(), 0)), pubkey, keyGhostnode.GetPubKey(), PROTOCOL_VERSION);
+    int nDos;
+
+    SetMockTime(nTimeOldSigs);
+    BOOST_CHECK(mnb.Sign(key));
+    BOOST_CHECK(mnb.CheckSignature(nDos));
+    CGhostnodeBroadcast mnbOld = mnb;
+
+    SetMockTime(nTimeNewSigs);
+    BOOST_CHECK(mnb.Sign(key));
+    BOOST_CHECK(mnb.CheckSignature(nDos));
+
+    // an announce signed over the text message is rejected once the spork is active
+    BOOST_CHECK(!mnbOld.CheckSignature(nDos));
+    BOOST_CHECK_EQUAL(nDos, 100);
+
+    // the signatures cover the fields they are made over
+    mnb.nProtocolVersion++;
+    BOOST_CHECK(!mnb.CheckSignature(nDos));
+}
+
+BOOST_AUTO_TEST_CASE(txlockvote_signatures)
+{
+    COutPoint outpointGhostnode(InsecureRand256(), 0);
+    CGhostnodeBroadcast mnb(CService(CNetAddr(), 6214), CTxIn(outpointGhostnode), pubkey, pubkey, PROTOCOL_VERSION);
+    CGhostnode mn(mnb);
+    BOOST_CHECK(mnodeman.Add(mn));
+    activeGhostnode.keyGhostnode = key;
+    activeGhostnode.pubKeyGhostnode = pubkey;
+
+    CTxLockVote vote(InsecureRand256(), COutPoint(InsecureRand256(), 1), outpointGhostnode);
+
+    SetMockTime(nTimeOldSigs);
+    BOOST_CHECK(vote.Sign());
+    BOOST_CHECK(vote.CheckSignature());
+    CTxLockVote voteOld = vote;
+
+    SetMockTime(nTimeNewSigs);
+    BOOST_CHECK(vote.Sign());
+    BOOST_CHECK(vote.CheckSignature());
+
+    // a vote signed over the text message is rejected once the spork is active
+    BOOST_CHECK(!voteOld.CheckSignature());
+
+    activeGhostnode.keyGhostnode = CKey();
+    activeGhostnode.pubKeyGhostnode = CPubKey();
+    mnodeman.Clear();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -315,6 +315,37 @@ BOOST_AUTO_TEST_CASE(iterator_string_ordering)
     }
 }
 
+BOOST_AUTO_TEST_CASE(dbwrapper_options)
+{
+    std::string strError;
+    CDBOptions dbOptions;
+    for (const std::string& strArg : {"chainstate", "chainstate:blocksize", "chainstate:blocksize=x", "chainstate:blocksize=100",
+                                      "chainstate:bloombits=-1", "chainstate:cache=1", "chainstate:compression=2"}) {
+        gArgs.ForceSetArg("-dboption", strArg);
+        BOOST_CHECK(!ApplyDBOptionArgs("", dbOptions, strError));
+    }
 
+    fs::path ph = fs::temp_directory_path() / fs::unique_path();
+    gArgs.ForceSetArg("-dboption", ph.filename().string() + ":blocksize=16384");
+    {
+        CDBWrapper dbw(ph, (1 << 20), true, false, false);
+        BOOST_CHECK_EQUAL(dbw.GetName(), ph.filename().string());
+        BOOST_CHECK_EQUAL(dbw.GetDBOptions().nBlockSize, 16384U);
+        BOOST_CHECK_EQUAL(dbw.GetDBOptions().nBloomBitsPerKey, CDBOptions().nBloomBitsPerKey);
+
+        for (int i = 0; i < 1000; i++)
+            BOOST_CHECK(dbw.Write(i, InsecureRand256()));
+        int nDatabases = 0;
+        ForEachDatabase([&](const CDBWrapper& db) {
+            nDatabases++;
+            std::string strValue;
+            BOOST_CHECK(db.GetProperty("leveldb.num-files-at-level0", strValue));
+            BOOST_CHECK(!db.GetProperty("leveldb.unknown", strValue));
+        });
+        BOOST_CHECK_EQUAL(nDatabases, 1);
+        BOOST_CHECK_EQUAL(CompactNextDatabase(), dbw.GetName());
+    }
+    BOOST_CHECK_EQUAL(CompactNextDatabase(), "");
+}
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -6,6 +6,7 @@
 
 #include <base58.h>
 #include <script/script.h>
+#include <script/sigcache.h>
 #include <uint256.h>
 #include <util.h>
 #include <utilstrencodings.h>
@@ -157,4 +158,29 @@ BOOST_AUTO_TEST_CASE(key_test1)
     BOOST_CHECK(detsigc == ParseHex("2052d8a32079c11e79db95af63bb9600c5b04f21a9ca33dc129c2bfa8ac9dc1cd561d8ae5e0f6c1a16bde3719c64c2fd70e404b6428ab9a69566962e8771b5944d"));
 }
 
+BOOST_AUTO_TEST_CASE(compact_signature_cache)
+{
+    CKey key1, key2;
+    key1.MakeNewKey(true);
+    key2.MakeNewKey(true);
+    uint256 hash = GetRandHash();
+
+    std::vector<unsigned char> vchSig;
+    BOOST_CHECK(key1.SignCompact(hash, vchSig));
+
+    BOOST_CHECK(!IsCachedCompactSignature(hash, vchSig, key1.GetPubKey().GetID()));
+    BOOST_CHECK(VerifyCompactSignature(hash, vchSig, key1.GetPubKey().GetID()));
+    BOOST_CHECK(IsCachedCompactSignature(hash, vchSig, key1.GetPubKey().GetID()));
+    BOOST_CHECK(VerifyCompactSignature(hash, vchSig, key1.GetPubKey().GetID()));
+
+    // the key recovered instead is reported, and failures are not cached
+    CKeyID keyIDRecovered;
+    BOOST_CHECK(!VerifyCompactSignature(hash, vchSig, key2.GetPubKey().GetID(), &keyIDRecovered));
+    BOOST_CHECK(keyIDRecovered == key1.GetPubKey().GetID());
+    BOOST_CHECK(!IsCachedCompactSignature(hash, vchSig, key2.GetPubKey().GetID()));
+
+    // a signature of another hash
+    BOOST_CHECK(!VerifyCompactSignature(GetRandHash(), vchSig, key1.GetPubKey().GetID()));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -2,6 +2,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <coins.h>
 #include <policy/policy.h>
 #include <txmempool.h>
 #include <util.h>
@@ -571,4 +572,110 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     SetMockTime(0);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolZerocoinSerialTest)
+{
+    TestMemPoolEntryHelper entry;
+    CTxMemPool testPool;
+
+    CMutableTransaction txSpend;
+    txSpend.vin.resize(1);
+    txSpend.vin[0].scriptSig = CScript() << OP_11;
+    txSpend.vout.resize(1);
+    txSpend.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txSpend.vout[0].nValue = 10 * COIN;
+
+    CMutableTransaction txChild;
+    txChild.vin.resize(1);
+    txChild.vin[0].scriptSig = CScript() << OP_11;
+    txChild.vin[0].prevout = COutPoint(txSpend.GetHash(), 0);
+    txChild.vout.resize(1);
+    txChild.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txChild.vout[0].nValue = 9 * COIN;
+
+    std::vector<uint256> vSerials = {uint256S("01"), uint256S("02")};
+    testPool.addUnchecked(txSpend.GetHash(), entry.FromTx(txSpend));
+    testPool.addZerocoinSerials(txSpend.GetHash(), vSerials);
+    testPool.addUnchecked(txChild.GetHash(), entry.FromTx(txChild));
+
+    uint256 hashSpend;
+    BOOST_CHECK(testPool.getZerocoinSerialSpend(vSerials[1], hashSpend));
+    BOOST_CHECK(hashSpend == txSpend.GetHash());
+    BOOST_CHECK(!testPool.getZerocoinSerialSpend(uint256S("03"), hashSpend));
+
+    // A serial spent elsewhere takes the spend and its descendants out, and unindexes all its serials
+    testPool.removeZerocoinSerialConflicts({uint256S("03"), vSerials[1]});
+    BOOST_CHECK_EQUAL(testPool.size(), 0);
+    BOOST_CHECK(!testPool.getZerocoinSerialSpend(vSerials[0], hashSpend));
+
+    // Removing the spend any other way unindexes its serials too
+    testPool.addUnchecked(txSpend.GetHash(), entry.FromTx(txSpend));
+    testPool.addZerocoinSerials(txSpend.GetHash(), vSerials);
+    testPool.removeRecursive(txSpend);
+    BOOST_CHECK(!testPool.getZerocoinSerialSpend(vSerials[0], hashSpend));
+}
+
+BOOST_AUTO_TEST_CASE(MempoolAddressIndexTest)
+{
+    TestMemPoolEntryHelper entry;
+    CTxMemPool testPool;
+    CCoinsView coinsDummy;
+    CCoinsViewCache coins(&coinsDummy);
+
+    const std::vector<unsigned char> vchAddress(20, 0x42);
+    const uint256 addressHash(vchAddress.data(), vchAddress.size());
+    const CScript scriptAddress = CScript() << OP_DUP << OP_HASH160 << vchAddress << OP_EQUALVERIFY << OP_CHECKSIG;
+    const COutPoint prevout(uint256S("01"), 0);
+    coins.AddCoin(prevout, Coin(CTxOut(10 * COIN, scriptAddress), 1, false), false);
+
+    // Spends the address and pays it twice
+    CMutableTransaction tx1;
+    tx1.vin.resize(1);
+    tx1.vin[0].prevout = prevout;
+    tx1.vout.resize(2);
+    tx1.vout[0].scriptPubKey = scriptAddress;
+    tx1.vout[0].nValue = 4 * COIN;
+    tx1.vout[1].scriptPubKey = scriptAddress;
+    tx1.vout[1].nValue = 5 * COIN;
+
+    CMutableTransaction tx2;
+    tx2.vin.resize(1);
+    tx2.vin[0].prevout = COutPoint(tx1.GetHash(), 0);
+    tx2.vout.resize(1);
+    tx2.vout[0].scriptPubKey = scriptAddress;
+    tx2.vout[0].nValue = 3 * COIN;
+    coins.AddCoin(tx2.vin[0].prevout, Coin(tx1.vout[0], MEMPOOL_HEIGHT, false), false);
+
+    for (const CMutableTransaction& tx : {tx1, tx2}) {
+        testPool.addUnchecked(tx.GetHash(), entry.FromTx(tx));
+        testPool.addAddressIndex(entry.FromTx(tx), coins);
+        testPool.addSpentIndex(entry.FromTx(tx), coins);
+    }
+
+    std::vector<std::pair<uint256, int> > addresses = {std::make_pair(addressHash, 1)};
+    std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > results;
+    BOOST_CHECK(testPool.getAddressIndex(addresses, results));
+    BOOST_CHECK_EQUAL(results.size(), 5);
+    for (size_t i = 1; i < results.size(); i++)
+        BOOST_CHECK(CMempoolAddressDeltaKeyCompare()(results[i - 1].first, results[i].first));
+
+    CSpentIndexKey spentKey(tx1.GetHash(), 0);
+    CSpentIndexValue spentValue;
+    BOOST_CHECK(testPool.getSpentIndex(spentKey, spentValue));
+    BOOST_CHECK(spentValue.txid == tx2.GetHash());
+
+    // Leaving the pool unindexes a transaction
+    testPool.removeRecursive(tx2);
+    results.clear();
+    BOOST_CHECK(testPool.getAddressIndex(addresses, results));
+    BOOST_CHECK_EQUAL(results.size(), 3);
+    BOOST_CHECK(!testPool.getSpentIndex(spentKey, spentValue));
+
+    testPool.removeForBlock({MakeTransactionRef(tx1)}, 1);
+    results.clear();
+    BOOST_CHECK(testPool.getAddressIndex(addresses, results));
+    BOOST_CHECK(results.empty());
+    CSpentIndexKey spentKeyBlock(prevout.hash, prevout.n);
+    BOOST_CHECK(!testPool.getSpentIndex(spentKeyBlock, spentValue));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -185,4 +185,18 @@ BOOST_AUTO_TEST_CASE(cnode_simple_test)
     BOOST_CHECK(pnode2->fFeeler == false);
 }
 
+BOOST_AUTO_TEST_CASE(socket_events_mode)
+{
+    SocketEventsMode mode;
+    BOOST_CHECK(ParseSocketEventsMode("select", mode));
+    BOOST_CHECK_EQUAL(mode, SOCKETEVENTS_SELECT);
+    BOOST_CHECK(!ParseSocketEventsMode("", mode));
+    BOOST_CHECK(!ParseSocketEventsMode("poll", mode));
+
+    // The default is always available, and its name parses back to it
+    BOOST_CHECK(ParseSocketEventsMode(GetSocketEventsModeName(GetDefaultSocketEventsMode()), mode));
+    BOOST_CHECK_EQUAL(mode, GetDefaultSocketEventsMode());
+    BOOST_CHECK(GetSupportedSocketEventsModes().find(GetSocketEventsModeName(mode)) != std::string::npos);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,9 @@
 
 #include <policy/policy.h>
 #include <policy/fees.h>
+#include <clientversion.h>
+#include <fs.h>
+#include <streams.h>
 #include <txmempool.h>
 #include <uint256.h>
 #include <util.h>
@@ -179,4 +182,75 @@ BOOST_AUTO_TEST_CASE(BlockPolicyEstimates)
     }
 }
 
+BOOST_AUTO_TEST_CASE(BlockPolicyEstimatesQueuedAndSaved)
+{
+    // The same blocks go through a pool updating its estimator right away, and through one queueing the updates
+    CBlockPolicyEstimator feeEst, feeEstQueued;
+    CTxMemPool mpool(&feeEst), mpoolQueued(&feeEstQueued);
+    std::vector<std::function<void()>> vQueued;
+    mpoolQueued.SetEstimatorQueue([&vQueued](std::function<void()> update) { vQueued.push_back(std::move(update)); });
+    TestMemPoolEntryHelper entry;
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << OP_1;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 0LL;
+
+    // The first blocks are connected during initial block download
+    int blocknum = 0;
+    while (blocknum < 20) {
+        mpool.removeForBlock({}, ++blocknum, false);
+        mpoolQueued.removeForBlock({}, blocknum, false);
+    }
+    BOOST_CHECK_EQUAL(vQueued.size(), 20U);
+    for (const auto& update : vQueued)
+        update();
+    vQueued.clear();
+
+    while (blocknum < 120) {
+        std::vector<CTransactionRef> block;
+        for (int j = 0; j < 10; j++) {
+            for (int k = 0; k < 4; k++) {
+                tx.vin[0].prevout.n = 10000*blocknum+100*j+k;
+                uint256 hash = tx.GetHash();
+                mpool.addUnchecked(hash, entry.Fee(2000 * (j+1)).Time(GetTime()).Height(blocknum).FromTx(tx));
+                mpoolQueued.addUnchecked(hash, entry.Fee(2000 * (j+1)).Time(GetTime()).Height(blocknum).FromTx(tx));
+                // Higher fee transactions confirm in the next block, lower fee ones a block later
+                if (j >= 5 || blocknum % 2)
+                    block.push_back(mpool.get(hash));
+            }
+        }
+        mpool.removeForBlock(block, ++blocknum);
+        mpoolQueued.removeForBlock(block, blocknum);
+        // A queued update may run after the pool moved on
+        for (const auto& update : vQueued)
+            update();
+        vQueued.clear();
+    }
+    for (int i = 1; i < 10; i++)
+        BOOST_CHECK(feeEst.estimateFee(i) == feeEstQueued.estimateFee(i));
+    BOOST_CHECK(feeEst.estimateFee(2) != CFeeRate(0));
+
+    // Estimates survive being saved and read back in fixed-point form, the transactions left in the
+    // pool are recorded as failures first like on shutdown
+    feeEst.FlushUnconfirmed(mpool);
+    fs::path path = GetDataDir() / "fee_estimates_test.dat";
+    {
+        CAutoFile fileout(fsbridge::fopen(path, "wb"), SER_DISK, CLIENT_VERSION);
+        BOOST_CHECK(feeEst.Write(fileout));
+    }
+    CBlockPolicyEstimator feeEstRead;
+    {
+        CAutoFile filein(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+        BOOST_CHECK(feeEstRead.Read(filein));
+    }
+    for (int i = 1; i < 10; i++) {
+        CAmount nFee = feeEst.estimateFee(i).GetFeePerK();
+        CAmount nFeeRead = feeEstRead.estimateFee(i).GetFeePerK();
+        BOOST_CHECK(std::abs(nFee - nFeeRead) <= nFee / 1000);
+    }
+    fs::remove(path);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
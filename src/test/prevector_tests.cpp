@@ -264,4 +264,46 @@ BOOST_AUTO_TEST_CASE(PrevectorTestInt)
     }
 }
 
+BOOST_AUTO_TEST_CASE(PrevectorSharedCopy)
+{
+    prevector<28, unsigned char> a;
+    for (int i = 0; i < 1000; i++) {
+        a.push_back(i);
+    }
+    const prevector<28, unsigned char>& ca = a;
+
+    // Copies of an indirect prevector share its array until one of them is written to
+    prevector<28, unsigned char> b(a), c;
+    c = b;
+    const prevector<28, unsigned char>& cb = b;
+    const prevector<28, unsigned char>& cc = c;
+    BOOST_CHECK(cb.data() == ca.data());
+    BOOST_CHECK(cc.data() == ca.data());
+
+    b[0] = 1;
+    BOOST_CHECK(cb.data() != ca.data());
+    BOOST_CHECK(cc.data() == ca.data());
+    BOOST_CHECK_EQUAL(a[0], 0);
+    BOOST_CHECK_EQUAL(b[0], 1);
+    BOOST_CHECK(std::equal(b.begin() + 1, b.end(), a.begin() + 1));
+
+    c.push_back(7);
+    BOOST_CHECK(cc.data() != ca.data());
+    BOOST_CHECK_EQUAL(a.size(), 1000U);
+    BOOST_CHECK_EQUAL(c.size(), 1001U);
+    BOOST_CHECK_EQUAL(c.back(), 7);
+
+    // Shrinking into the direct storage and clearing leave the other copies alone
+    c = a;
+    c.resize(10);
+    c.shrink_to_fit();
+    BOOST_CHECK_EQUAL(a.size(), 1000U);
+    BOOST_CHECK(std::equal(c.begin(), c.end(), a.begin()));
+    b = a;
+    b.clear();
+    BOOST_CHECK(b.empty());
+    BOOST_CHECK_EQUAL(a.size(), 1000U);
+    BOOST_CHECK_EQUAL(a[999], (unsigned char)999);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -4,10 +4,15 @@
 
 #include <rpc/server.h>
 #include <rpc/client.h>
+#include <rpc/blockchain.h>
 
 #include <base58.h>
+#include <chainparams.h>
+#include <coins.h>
 #include <core_io.h>
 #include <netbase.h>
+#include <streams.h>
+#include <validation.h>
 
 #include <test/test_bitcoin.h>
 
@@ -345,4 +350,97 @@ BOOST_AUTO_TEST_CASE(rpc_convert_values_generatetoaddress)
     BOOST_CHECK_EQUAL(result[2].get_int(), 9);
 }
 
+BOOST_AUTO_TEST_CASE(rpc_reply_stream)
+{
+    UniValue result(UniValue::VOBJ);
+    UniValue arr(UniValue::VARR);
+    arr.push_back(1.5);
+    arr.push_back(true);
+    arr.push_back(NullUniValue);
+    arr.push_back(UniValue(UniValue::VOBJ));
+    arr.push_back(UniValue(UniValue::VARR));
+    result.push_back(Pair("values", arr));
+    result.push_back(Pair("escaped \"key\"\n", "tab\tquote\"\\\x01"));
+    result.push_back(Pair("hex", std::string(300, 'a')));
+    const UniValue id("some-id");
+
+    // Same reply in every chunk size, the pieces split as written
+    for (size_t nChunkSize : {1, 7, 64, 1024 * 1024}) {
+        std::string strReply;
+        size_t nChunks = 0;
+        CJSONStreamWriter writer([&](std::string&& chunk) {
+            strReply += chunk;
+            nChunks++;
+        }, nChunkSize);
+        JSONRPCReplyStream(writer, result, NullUniValue, id);
+        BOOST_CHECK_EQUAL(strReply, JSONRPCReply(result, NullUniValue, id));
+        BOOST_CHECK(nChunkSize > strReply.size() ? nChunks == 1 : nChunks > 1);
+    }
+
+    UniValue error = JSONRPCError(RPC_INVALID_PARAMETER, "error");
+    std::string strReply;
+    CJSONStreamWriter writer([&](std::string&& chunk) { strReply += chunk; });
+    JSONRPCReplyStream(writer, result, error, id);
+    BOOST_CHECK_EQUAL(strReply, JSONRPCReply(result, error, id));
+}
+
+BOOST_FIXTURE_TEST_CASE(rpc_dumptxoutset, TestChain100Setup)
+{
+    UniValue result = CallRPC("dumptxoutset utxo.dat");
+    fs::path path = GetDataDir() / "utxo.dat";
+    fs::path temppath = path.string() + ".incomplete";
+    BOOST_CHECK_EQUAL(find_value(result, "path").get_str(), path.string());
+    BOOST_CHECK(!fs::exists(temppath));
+
+    // Read the dump back: it holds every coin of the tip and nothing else
+    CAutoFile file(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    BOOST_REQUIRE(!file.IsNull());
+    CTxOutSetDumpHeader header;
+    file >> header;
+    BOOST_CHECK(header.IsValid(Params()));
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(header.hashBlock == chainActive.Tip()->GetBlockHash());
+        BOOST_CHECK_EQUAL(find_value(result, "base_height").get_int(), chainActive.Height());
+    }
+    BOOST_CHECK_EQUAL(find_value(result, "base_hash").get_str(), header.hashBlock.GetHex());
+    BOOST_CHECK_EQUAL(find_value(result, "coins_written").get_int64(), (int64_t)header.nCoins);
+    BOOST_CHECK_EQUAL(find_value(CallRPC("gettxoutsetinfo"), "txouts").get_int64(), (int64_t)header.nCoins);
+    BOOST_CHECK(header.nCoins > 0);
+
+    std::set<COutPoint> setOutPoints;
+    for (uint64_t i = 0; i < header.nCoins; i++) {
+        COutPoint outpoint;
+        Coin coin;
+        file >> outpoint >> coin;
+        BOOST_CHECK(setOutPoints.insert(outpoint).second);
+        LOCK(cs_main);
+        const Coin& coinTip = pcoinsTip->AccessCoin(outpoint);
+        BOOST_CHECK(!coinTip.IsSpent());
+        BOOST_CHECK(coin.out == coinTip.out);
+        BOOST_CHECK(coin.nHeight == coinTip.nHeight);
+        BOOST_CHECK(coin.fCoinBase == coinTip.fCoinBase);
+    }
+    char c;
+    BOOST_CHECK_THROW(file >> c, std::ios_base::failure);
+    file.fclose();
+
+    // A dump of another network or in another format is told apart
+    CTxOutSetDumpHeader headerOther = header;
+    headerOther.hashGenesisBlock.SetNull();
+    BOOST_CHECK(!headerOther.IsValid(Params()));
+    headerOther = header;
+    headerOther.pchMessageStart[0] ^= 0xff;
+    BOOST_CHECK(!headerOther.IsValid(Params()));
+    headerOther = header;
+    headerOther.nVersion++;
+    BOOST_CHECK(!headerOther.IsValid(Params()));
+
+    // An existing file is left alone and no temporary file stays behind
+    uintmax_t nFileSize = fs::file_size(path);
+    BOOST_CHECK_THROW(CallRPC("dumptxoutset utxo.dat"), std::runtime_error);
+    BOOST_CHECK(!fs::exists(temppath));
+    BOOST_CHECK_EQUAL(fs::file_size(path), nFileSize);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
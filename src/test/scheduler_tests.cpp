@@ -112,4 +112,46 @@ BOOST_AUTO_TEST_CASE(manythreads)
     BOOST_CHECK_EQUAL(counterSum, 200);
 }
 
+static void classTask(std::atomic<int>& running, std::atomic<int>& maxRunning)
+{
+    int n = ++running;
+    int nMax = maxRunning;
+    while (n > nMax && !maxRunning.compare_exchange_weak(nMax, n)) {}
+    MicroSleep(100);
+    --running;
+}
+
+BOOST_AUTO_TEST_CASE(taskclasses)
+{
+    // Tasks of one class never overlap, however many threads service the queue,
+    // while tasks without a class do
+    CScheduler scheduler;
+    std::atomic<int> runningA(0), maxRunningA(0), runningB(0), maxRunningB(0), running(0), maxRunning(0);
+
+    boost::chrono::system_clock::time_point now = boost::chrono::system_clock::now();
+    for (int i = 0; i < 50; i++) {
+        scheduler.schedule(boost::bind(&classTask, boost::ref(runningA), boost::ref(maxRunningA)), now, "a");
+        scheduler.schedule(boost::bind(&classTask, boost::ref(runningB), boost::ref(maxRunningB)), now, "b");
+        scheduler.schedule(boost::bind(&classTask, boost::ref(running), boost::ref(maxRunning)), now);
+    }
+
+    boost::thread_group threads;
+    for (int i = 0; i < 4; i++)
+        threads.create_thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+    scheduler.stop(true);
+    threads.join_all();
+
+    BOOST_CHECK_EQUAL(maxRunningA, 1);
+    BOOST_CHECK_EQUAL(maxRunningB, 1);
+    BOOST_CHECK(maxRunning >= 1);
+
+    std::map<std::string, CScheduler::TaskStats> stats = scheduler.getTaskStats();
+    BOOST_CHECK_EQUAL(stats.size(), 3U);
+    BOOST_CHECK_EQUAL(stats["a"].nRuns, 50U);
+    BOOST_CHECK_EQUAL(stats["b"].nRuns, 50U);
+    BOOST_CHECK_EQUAL(stats["other"].nRuns, 50U);
+    BOOST_CHECK(stats["a"].nTotalMicros >= 50 * 100);
+    BOOST_CHECK(stats["a"].nMaxDelayMicros > 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
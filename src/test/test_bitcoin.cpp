@@ -7,7 +7,10 @@
 #include <chainparams.h>
 #include <consensus/consensus.h>
 #include <consensus/validation.h>
+#include <crypto/ripemd160.h>
 #include <crypto/sha256.h>
+#include <crypto/sha512.h>
+#include <crypto/Lyra2RE/Lyra2RE.h>
 #include <validation.h>
 #include <miner.h>
 #include <net_processing.h>
@@ -40,6 +43,9 @@ extern void noui_connect();
 BasicTestingSetup::BasicTestingSetup(const std::string& chainName)
 {
         SHA256AutoDetect();
+        SHA512AutoDetect();
+        RIPEMD160AutoDetect();
+        lyra2re_autodetect();
         RandomInit();
         ECC_Start();
         SetupEnvironment();
@@ -76,6 +82,7 @@ TestingSetup::TestingSetup(const std::string& chainName) : BasicTestingSetup(cha
 
         mempool.setSanityCheck(1.0);
         pblocktree.reset(new CBlockTreeDB(1 << 20, true));
+        pzerocoindb.reset(new CZerocoinDB(1 << 20, true));
         pcoinsdbview.reset(new CCoinsViewDB(1 << 23, true));
         pcoinsTip.reset(new CCoinsViewCache(pcoinsdbview.get()));
         if (!LoadGenesisBlock(chainparams)) {
@@ -107,6 +114,7 @@ TestingSetup::~TestingSetup()
         pcoinsTip.reset();
         pcoinsdbview.reset();
         pblocktree.reset();
+        pzerocoindb.reset();
         fs::remove_all(pathTemp);
 }
 
@@ -759,4 +759,57 @@ BOOST_AUTO_TEST_CASE(test_IsStandard)
     BOOST_CHECK(!IsStandardTx(t, reason));
 }
 
+BOOST_AUTO_TEST_CASE(test_ZerocoinMetadataHash)
+{
+    CMutableTransaction mtx;
+    mtx.vin.resize(2);
+    mtx.vin[0].prevout = COutPoint(InsecureRand256(), 1);
+    mtx.vin[0].scriptSig << OP_1;
+    mtx.vin[1].scriptSig << OP_ZEROCOINSPEND << std::vector<unsigned char>(100, 0x42);
+    mtx.vin[1].nSequence = 3;
+    mtx.vin[1].scriptWitness.stack.push_back(std::vector<unsigned char>(1, 0x01));
+    mtx.vout.resize(1);
+    mtx.vout[0].nValue = 1 * COIN;
+    mtx.nLockTime = 7;
+
+    // The cached hash is the one of a copy with the zerocoin spend inputs cleared
+    CMutableTransaction txTemp = mtx;
+    txTemp.vin[1].scriptSig.clear();
+    txTemp.vin[1].prevout.SetNull();
+    BOOST_CHECK_EQUAL(CTransaction(mtx).GetZerocoinMetadataHash(), txTemp.GetHash());
+    BOOST_CHECK(CTransaction(mtx).GetZerocoinMetadataHash() != CTransaction(mtx).GetHash());
+
+    // Without zerocoin spend inputs there is nothing to commit to
+    mtx.vin.pop_back();
+    BOOST_CHECK(CTransaction(mtx).GetZerocoinMetadataHash().IsNull());
+}
+
+BOOST_AUTO_TEST_CASE(test_cached_serialization)
+{
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vin[0].prevout = COutPoint(InsecureRand256(), 1);
+    mtx.vin[0].scriptSig << OP_1;
+    mtx.vin[0].scriptWitness.stack.push_back(std::vector<unsigned char>(100, 0x01));
+    mtx.vout.resize(1);
+    mtx.vout[0].nValue = 1 * COIN;
+
+    CTransaction tx(mtx);
+    BOOST_CHECK_EQUAL(tx.GetTotalSize(), ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION));
+    BOOST_CHECK_EQUAL(tx.GetBaseSize(), ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS));
+    BOOST_CHECK(tx.GetBaseSize() < tx.GetTotalSize());
+    BOOST_CHECK(!tx.GetSerialized());
+
+    // A big transaction keeps the bytes it's serialized to
+    mtx.vout[0].scriptPubKey << std::vector<unsigned char>(MIN_KEEP_SERIALIZED_TX_SIZE, 0x42);
+    CTransaction txBig(mtx);
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << txBig;
+    std::shared_ptr<const std::vector<unsigned char>> serialized = txBig.GetSerialized();
+    BOOST_CHECK(serialized);
+    BOOST_CHECK(serialized && std::vector<unsigned char>(ss.begin(), ss.end()) == *serialized);
+    BOOST_CHECK(txBig.GetSerialized() == serialized);
+    BOOST_CHECK_EQUAL(GetTransactionWeight(txBig), ::GetSerializeSize(txBig, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS) * (WITNESS_SCALE_FACTOR - 1) + ss.size());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -5,8 +5,10 @@
 #include <validation.h>
 #include <txmempool.h>
 #include <amount.h>
+#include <chainparams.h>
 #include <consensus/validation.h>
 #include <primitives/transaction.h>
+#include <script/interpreter.h>
 #include <script/script.h>
 #include <test/test_bitcoin.h>
 
@@ -58,4 +60,87 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_reject_coinbase, TestChain100Setup)
     BOOST_CHECK_EQUAL(nDoS, 100);
 }
 
+/**
+ * Ensure that a package is accepted parents first whatever its order, and that
+ * the children of a rejected parent are not tried.
+ */
+BOOST_FIXTURE_TEST_CASE(tx_mempool_accept_package, TestChain100Setup)
+{
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    auto spend = [&](const COutPoint& prevout, CAmount nValue) {
+        CMutableTransaction tx;
+        tx.nVersion = 1;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = prevout;
+        tx.vout.resize(1);
+        tx.vout[0].nValue = nValue;
+        tx.vout[0].scriptPubKey = scriptPubKey;
+
+        std::vector<unsigned char> vchSig;
+        uint256 hash = SignatureHash(scriptPubKey, tx, 0, SIGHASH_ALL, 0, SIGVERSION_BASE);
+        BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+        vchSig.push_back((unsigned char)SIGHASH_ALL);
+        tx.vin[0].scriptSig << vchSig;
+        return MakeTransactionRef(tx);
+    };
+
+    CTransactionRef parent = spend(COutPoint(coinbaseTxns[0].GetHash(), 0), 11 * CENT);
+    CTransactionRef child = spend(COutPoint(parent->GetHash(), 0), 10 * CENT);
+    CTransactionRef grandchild = spend(COutPoint(child->GetHash(), 0), 9 * CENT);
+
+    LOCK(cs_main);
+    unsigned int initialPoolSize = mempool.size();
+
+    std::vector<CPackageTxResult> vResults;
+    BOOST_CHECK_EQUAL(AcceptPackageToMemoryPool(mempool, {grandchild, parent, child}, vResults, nullptr), 3);
+    BOOST_CHECK_EQUAL(vResults.size(), 3);
+    for (const CPackageTxResult& result : vResults)
+        BOOST_CHECK(result.fAccepted);
+    BOOST_CHECK_EQUAL(mempool.size(), initialPoolSize + 3);
+    mempool.clear();
+
+    // A parent spending a coin that doesn't exist
+    CTransactionRef orphan = spend(COutPoint(InsecureRand256(), 0), 11 * CENT);
+    CTransactionRef orphanChild = spend(COutPoint(orphan->GetHash(), 0), 10 * CENT);
+    BOOST_CHECK_EQUAL(AcceptPackageToMemoryPool(mempool, {orphanChild, orphan, orphan}, vResults, nullptr), 0);
+    BOOST_CHECK(vResults[0].fMissingInputs && vResults[0].state.IsValid());
+    BOOST_CHECK(vResults[1].fMissingInputs);
+    BOOST_CHECK_EQUAL(vResults[2].state.GetRejectReason(), "txn-already-in-package");
+    BOOST_CHECK_EQUAL(mempool.size(), initialPoolSize);
+}
+
+/**
+ * Ensure that GetTransaction answers from its cache for the confirmed transactions it read
+ * before, and forgets them once their block is disconnected.
+ */
+BOOST_FIXTURE_TEST_CASE(tx_lookup_cache, TestChain100Setup)
+{
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    const uint256 txid = coinbaseTxns.back().GetHash();
+    CTransactionRef tx;
+    uint256 hashBlock;
+
+    LOCK(cs_main);
+    CBlockIndex* pindexTip = chainActive.Tip();
+
+    // Without -txindex the transaction is only found through its block, which caches it
+    BOOST_CHECK(!GetTransaction(txid, tx, consensusParams, hashBlock));
+    BOOST_CHECK(GetTransaction(txid, tx, consensusParams, hashBlock, false, pindexTip));
+    BOOST_CHECK(hashBlock == pindexTip->GetBlockHash());
+
+    tx.reset();
+    hashBlock.SetNull();
+    BOOST_CHECK(GetTransaction(txid, tx, consensusParams, hashBlock));
+    BOOST_CHECK(tx && tx->GetHash() == txid);
+    BOOST_CHECK(hashBlock == pindexTip->GetBlockHash());
+    BOOST_CHECK(TxLookupCacheDynamicMemoryUsage() > 0);
+
+    // Disconnecting the block drops its transactions from the cache
+    CValidationState state;
+    BOOST_CHECK(InvalidateBlock(state, Params(), pindexTip));
+    BOOST_CHECK(chainActive.Tip() == pindexTip->pprev);
+    BOOST_CHECK(!GetTransaction(txid, tx, consensusParams, hashBlock));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
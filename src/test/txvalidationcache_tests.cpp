@@ -127,10 +127,12 @@ void ValidateCheckInputsForAllFlags(CMutableTransaction &tx, uint32_t failing_fl
 
         // Test the caching
         if (ret && add_to_cache) {
-            // Check that we get a cache hit if the tx was valid
+            // Check that we get a cache hit if the tx was valid, without computing the sighash data
             std::vector<CScriptCheck> scriptchecks;
-            BOOST_CHECK(CheckInputs(tx, state, pcoinsTip.get(), true, test_flags, true, add_to_cache, txdata, &scriptchecks));
+            PrecomputedTransactionData txdataHit;
+            BOOST_CHECK(CheckInputs(tx, state, pcoinsTip.get(), true, test_flags, true, add_to_cache, txdataHit, &scriptchecks));
             BOOST_CHECK(scriptchecks.empty());
+            BOOST_CHECK(!txdataHit.ready);
         } else {
             // Check that we get script executions to check, if the transaction
             // was invalid, or we didn't add to cache.
@@ -0,0 +1,126 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <uint256.h>
+#include <validationinterface.h>
+
+#include <test/test_bitcoin.h>
+
+#include <atomic>
+#include <future>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(validationinterface_tests, TestingSetup)
+
+namespace {
+
+/** Counts its Inventory notifications, the first one waits for release */
+class InventoryCounter : public CValidationInterface
+{
+public:
+    std::atomic<int> nCalls{0};
+    std::promise<void> started;
+    std::shared_future<void> release;
+
+protected:
+    void Inventory(const uint256& hash) override
+    {
+        if (nCalls++ == 0 && release.valid()) {
+            started.set_value();
+            release.wait();
+        }
+    }
+};
+
+ValidationQueueStats GetStats(const std::string& name)
+{
+    for (const ValidationQueueStats& stats : GetMainSignals().GetQueueStats()) {
+        if (stats.name == name) return stats;
+    }
+    BOOST_ERROR("no queue named " + name);
+    return ValidationQueueStats();
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE(delivery_and_barriers)
+{
+    InventoryCounter first, second;
+    RegisterValidationInterface(&first, "first");
+    RegisterValidationInterface(&second, "second");
+
+    for (int i = 0; i < 100; i++) {
+        GetMainSignals().Inventory(uint256());
+    }
+
+    // Every function runs after the notifications before it, in the order of the calls
+    std::vector<int> vOrder;
+    std::promise<void> done;
+    for (int i = 0; i < 10; i++) {
+        CallFunctionInValidationInterfaceQueue([&vOrder, &first, &second, i] {
+            BOOST_CHECK_EQUAL(first.nCalls, 100);
+            BOOST_CHECK_EQUAL(second.nCalls, 100);
+            vOrder.push_back(i);
+        });
+    }
+    CallFunctionInValidationInterfaceQueue([&done] { done.set_value(); });
+    done.get_future().wait();
+    BOOST_CHECK_EQUAL(vOrder.size(), 10U);
+    for (int i = 0; i < (int)vOrder.size(); i++) {
+        BOOST_CHECK_EQUAL(vOrder[i], i);
+    }
+
+    ValidationQueueStats stats = GetStats("first");
+    BOOST_CHECK(stats.policy == ValidationQueuePolicy::BLOCK);
+    BOOST_CHECK_EQUAL(stats.nQueued, 100U);
+    BOOST_CHECK_EQUAL(stats.nProcessed, 100U);
+    BOOST_CHECK_EQUAL(stats.nDepth, 0U);
+    BOOST_CHECK_EQUAL(stats.nDropped, 0U);
+
+    // An unregistered subscriber gets nothing more
+    UnregisterValidationInterface(&first);
+    GetMainSignals().Inventory(uint256());
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(first.nCalls, 100);
+    BOOST_CHECK_EQUAL(second.nCalls, 101);
+    UnregisterValidationInterface(&second);
+}
+
+BOOST_AUTO_TEST_CASE(best_effort_queue_drops)
+{
+    InventoryCounter slow, fast;
+    std::promise<void> release;
+    slow.release = release.get_future().share();
+    RegisterValidationInterface(&slow, "slow", ValidationQueuePolicy::DROP);
+    RegisterValidationInterface(&fast, "fast");
+
+    GetMainSignals().Inventory(uint256());
+    slow.started.get_future().wait();
+
+    // The slow subscriber keeps the newest notifications, the others get them all
+    const int nExtra = 5;
+    for (int i = 0; i < (int)DEFAULT_MAX_NOTIFICATION_QUEUE + nExtra; i++) {
+        GetMainSignals().Inventory(uint256());
+    }
+    ValidationQueueStats stats = GetStats("slow");
+    BOOST_CHECK(stats.policy == ValidationQueuePolicy::DROP);
+    BOOST_CHECK_EQUAL(stats.nDepth, DEFAULT_MAX_NOTIFICATION_QUEUE);
+    BOOST_CHECK_EQUAL(stats.nDropped, (uint64_t)nExtra);
+
+    release.set_value();
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK_EQUAL(slow.nCalls, (int)DEFAULT_MAX_NOTIFICATION_QUEUE + 1);
+    BOOST_CHECK_EQUAL(fast.nCalls, (int)DEFAULT_MAX_NOTIFICATION_QUEUE + nExtra + 1);
+    BOOST_CHECK_EQUAL(GetStats("fast").nDropped, 0U);
+
+    // Validation waits only for blocking queues, and only when over their bound
+    GetMainSignals().WaitForSubscriberQueues();
+    BOOST_CHECK_EQUAL(GetStats("fast").nWaits, 0U);
+
+    UnregisterValidationInterface(&slow);
+    UnregisterValidationInterface(&fast);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
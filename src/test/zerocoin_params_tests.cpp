@@ -0,0 +1,22 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <zerocoin/zerocoin.h>
+
+#include <test/test_bitcoin.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(zerocoin_params_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(builtin_params_match_derivation)
+{
+    BOOST_CHECK(ZCParams->initialized);
+    BOOST_CHECK(ZCParams->accumulatorParams.initialized);
+    BOOST_CHECK_EQUAL(ZCParams->accumulatorParams.accumulatorModulus.GetHex(), CBigNum(ZEROCOIN_MODULUS).GetHex());
+    BOOST_CHECK_EQUAL(ZCParams->zkp_iterations, (uint32_t)ZEROCOIN_DEFAULT_SECURITYLEVEL);
+    BOOST_CHECK(CheckZerocoinParams());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -436,6 +436,8 @@ private:
 
     /** Callback for ADD_ONION result */
     void add_onion_cb(TorControlConnection& conn, const TorControlReply& reply);
+    /** Callback for EXTENDCIRCUIT result */
+    void extendcircuit_cb(TorControlConnection& conn, const TorControlReply& reply);
     /** Callback for AUTHENTICATE result */
     void auth_cb(TorControlConnection& conn, const TorControlReply& reply);
     /** Callback for AUTHCHALLENGE result */
@@ -518,6 +520,15 @@ void TorController::add_onion_cb(TorControlConnection& _conn, const TorControlRe
     }
 }
 
+void TorController::extendcircuit_cb(TorControlConnection& _conn, const TorControlReply& reply)
+{
+    if (reply.code == 250 && !reply.lines.empty()) {
+        LogPrint(BCLog::TOR, "tor: Building circuit: %s\n", SanitizeString(reply.lines[0]));
+    } else {
+        LogPrint(BCLog::TOR, "tor: Building a circuit failed; error code %d\n", reply.code);
+    }
+}
+
 void TorController::auth_cb(TorControlConnection& _conn, const TorControlReply& reply)
 {
     if (reply.code == 250) {
@@ -540,6 +551,13 @@ void TorController::auth_cb(TorControlConnection& _conn, const TorControlReply&
         // choice.  TODO; refactor the shutdown sequence some day.
         _conn.Command(strprintf("ADD_ONION %s Port=%i,127.0.0.1:%i", private_key, GetListenPort(), GetListenPort()),
             boost::bind(&TorController::add_onion_cb, this, _1, _2));
+
+        // Have Tor build some circuits now, so that the first connections to onion peers, which
+        // the proxy connect threads open in parallel, don't each wait for a circuit of their own.
+        int nPrebuildCircuits = gArgs.GetArg("-torprebuildcircuits", DEFAULT_TOR_PREBUILD_CIRCUITS);
+        for (int i = 0; i < nPrebuildCircuits; i++) {
+            _conn.Command("EXTENDCIRCUIT 0 purpose=general", boost::bind(&TorController::extendcircuit_cb, this, _1, _2));
+        }
     } else {
         LogPrintf("tor: Authentication failed\n");
     }
@@ -12,6 +12,8 @@
 
 extern const std::string DEFAULT_TOR_CONTROL;
 static const bool DEFAULT_LISTEN_ONION = true;
+/** Number of Tor circuits built ahead for connections to onion peers */
+static const int DEFAULT_TOR_PREBUILD_CIRCUITS = 4;
 
 void StartTorControl(boost::thread_group& threadGroup, CScheduler& scheduler);
 void InterruptTorControl();
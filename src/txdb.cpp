@@ -6,6 +6,7 @@
 #include <txdb.h>
 
 #include <chainparams.h>
+#include <crypto/common.h>
 #include <hash.h>
 #include <random.h>
 #include <pow.h>
@@ -15,7 +16,13 @@
 #include <init.h>
 #include "validation.h"
 
+#include <algorithm>
+#include <exception>
+#include <map>
+#include <set>
 #include <stdint.h>
+#include <thread>
+#include <tuple>
 
 #include <boost/thread.hpp>
 
@@ -24,18 +31,30 @@ static const char DB_COINS = 'c';
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
 static const char DB_BLOCK_INDEX = 'b';
+static const char DB_BLOCK_ZEROCOIN = 'Z';
 
 static const char DB_ADDRESSINDEX = 'a';
 static const char DB_ADDRESSUNSPENTINDEX = 'u';
+static const char DB_ADDRESSBALANCE = 'A';
 static const char DB_TIMESTAMPINDEX = 's';
 static const char DB_SPENTINDEX = 'p';
 static const char DB_BLOCKHASHINDEX = 'z';
+static const char DB_COLLATERALINDEX = 'g';
+static const char DB_BLOCKFILTERINDEX = 'y';
+static const char DB_INDEX_BEST_BLOCK = 'I';
 
 static const char DB_BEST_BLOCK = 'B';
 static const char DB_HEAD_BLOCKS = 'H';
+static const char DB_COIN_SHARDS = 'N';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
+static const char DB_BLOCK_INDEX_SNAPSHOT = 'S';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_MEMPOOL_TOKEN_SALT = 'T';
+static const char DB_BLOCK_FILE_MOVE = 'K';
+
+static const char DB_ZEROCOIN_BLOCK_MINTS = 'M';
+static const char DB_ZEROCOIN_PUBCOIN = 'P';
 
 namespace {
 
@@ -61,16 +80,45 @@ struct CoinEntry {
 
 }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true) 
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe, int nShards) :
+    db(GetDataDir() / "chainstate", nCacheSize / std::max(nShards, 1), fMemory, fWipe, true)
 {
+    if (fWipe && !fMemory) {
+        // the shards of the previous database, whatever their number was
+        for (int i = 1; i < MAX_CHAINSTATE_SHARDS; i++)
+            fs::remove_all(GetDataDir() / "chainstate" / strprintf("shard%d", i));
+    }
+
+    // Databases from before sharding have no shard count and a single shard
+    int nDBShards = 1;
+    if (GetBestBlock().IsNull() && GetHeadBlocks().empty()) {
+        nDBShards = nShards;
+        db.Write(DB_COIN_SHARDS, nDBShards);
+    } else {
+        db.Read(DB_COIN_SHARDS, nDBShards);
+        if (nDBShards != nShards)
+            LogPrintf("The chainstate database has %d shards, -chainstateshards=%d takes effect with -reindex-chainstate\n", nDBShards, nShards);
+    }
+    if (nDBShards < 1 || nDBShards > MAX_CHAINSTATE_SHARDS)
+        throw dbwrapper_error(strprintf("Invalid number of chainstate shards %d", nDBShards));
+
+    for (int i = 1; i < nDBShards; i++) {
+        vShards.emplace_back(new CDBWrapper(GetDataDir() / "chainstate" / strprintf("shard%d", i), nCacheSize / nDBShards, fMemory, fWipe, true));
+    }
+}
+
+CDBWrapper &CCoinsViewDB::GetShard(const COutPoint &outpoint) const {
+    // All outputs of a transaction are in one shard, which the cursor relies on
+    size_t nShard = ReadLE64(outpoint.hash.begin()) % (vShards.size() + 1);
+    return nShard == 0 ? const_cast<CDBWrapper&>(db) : *vShards[nShard - 1];
 }
 
 bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
-    return db.Read(CoinEntry(&outpoint), coin);
+    return GetShard(outpoint).Read(CoinEntry(&outpoint), coin);
 }
 
 bool CCoinsViewDB::HaveCoin(const COutPoint &outpoint) const {
-    return db.Exists(CoinEntry(&outpoint));
+    return GetShard(outpoint).Exists(CoinEntry(&outpoint));
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const {
@@ -89,6 +137,14 @@ std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
 }
 
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    return WriteCoins(mapCoins, hashBlock, true);
+}
+
+bool CCoinsViewDB::BatchWritePartial(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    return WriteCoins(mapCoins, hashBlock, false);
+}
+
+bool CCoinsViewDB::WriteCoins(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fFinal) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
@@ -99,13 +155,16 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     uint256 old_tip = GetBestBlock();
     if (old_tip.IsNull()) {
         // We may be in the middle of replaying.
+        // The head may also be an earlier tip that coins were partially written for.
         std::vector<uint256> old_heads = GetHeadBlocks();
         if (old_heads.size() == 2) {
-            assert(old_heads[0] == hashBlock);
             old_tip = old_heads[1];
         }
     }
 
+    if (!vShards.empty())
+        return WriteShardedCoins(mapCoins, hashBlock, old_tip, fFinal);
+
     // In the first batch, mark the database as being in the middle of a
     // transition from old_tip to hashBlock.
     // A vector is used for future extensibility, as we may want to support
@@ -139,9 +198,12 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
         }
     }
 
-    // In the last batch, mark the database as consistent with hashBlock again.
-    batch.Erase(DB_HEAD_BLOCKS);
-    batch.Write(DB_BEST_BLOCK, hashBlock);
+    // In the last batch, mark the database as consistent with hashBlock again. After a partial
+    // write it stays in transition, ReplayBlocks completes it if we crash before the next write.
+    if (fFinal) {
+        batch.Erase(DB_HEAD_BLOCKS);
+        batch.Write(DB_BEST_BLOCK, hashBlock);
+    }
 
     LogPrint(BCLog::COINDB, "Writing final batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
     bool ret = db.WriteBatch(batch);
@@ -149,9 +211,94 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     return ret;
 }
 
+bool CCoinsViewDB::WriteShardedCoins(CCoinsMap &mapCoins, const uint256 &hashBlock, const uint256 &old_tip, bool fFinal) {
+    size_t batch_size = (size_t)gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
+    int crash_simulate = gArgs.GetArg("-dbcrashratio", 0);
+
+    // The shards are written without any order between them, so the transition is marked, and
+    // synced, before the first coin changes in any shard.
+    CDBBatch batch(db);
+    batch.Erase(DB_BEST_BLOCK);
+    batch.Write(DB_HEAD_BLOCKS, std::vector<uint256>{hashBlock, old_tip});
+    db.WriteBatch(batch, true);
+    batch.Clear();
+
+    std::vector<CDBWrapper*> vDBs{&db};
+    for (const auto& pshard : vShards)
+        vDBs.push_back(pshard.get());
+    std::vector<std::vector<CCoinsMap::const_iterator> > vDirty(vDBs.size());
+    size_t count = mapCoins.size();
+    size_t changed = 0;
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); it++) {
+        if (it->second.flags & CCoinsCacheEntry::DIRTY) {
+            vDirty[ReadLE64(it->first.hash.begin()) % vDBs.size()].push_back(it);
+            changed++;
+        }
+    }
+
+    // Every shard is written by a thread of its own, ending with a synced write so the coins are
+    // on disk before the best block marker below
+    auto writeShard = [&](size_t nShard) {
+        CDBWrapper& shard = *vDBs[nShard];
+        CDBBatch shardBatch(shard);
+        FastRandomContext rng;
+        for (const CCoinsMap::const_iterator& it : vDirty[nShard]) {
+            CoinEntry entry(&it->first);
+            if (it->second.coin.IsSpent())
+                shardBatch.Erase(entry);
+            else
+                shardBatch.Write(entry, it->second.coin);
+            if (shardBatch.SizeEstimate() > batch_size) {
+                LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB to %s\n", shardBatch.SizeEstimate() * (1.0 / 1048576.0), shard.GetName());
+                shard.WriteBatch(shardBatch);
+                shardBatch.Clear();
+                if (crash_simulate && rng.randrange(crash_simulate) == 0) {
+                    LogPrintf("Simulating a crash. Goodbye.\n");
+                    _Exit(0);
+                }
+            }
+        }
+        shard.WriteBatch(shardBatch, true);
+    };
+    std::vector<std::exception_ptr> vErrors(vDBs.size());
+    std::vector<std::thread> vThreads;
+    for (size_t i = 1; i < vDBs.size(); i++) {
+        vThreads.emplace_back([&, i]() {
+            try {
+                writeShard(i);
+            } catch (...) {
+                vErrors[i] = std::current_exception();
+            }
+        });
+    }
+    try {
+        writeShard(0);
+    } catch (...) {
+        vErrors[0] = std::current_exception();
+    }
+    for (std::thread& thread : vThreads)
+        thread.join();
+    for (const std::exception_ptr& error : vErrors) {
+        if (error)
+            std::rethrow_exception(error);
+    }
+    mapCoins.clear();
+
+    if (fFinal) {
+        batch.Erase(DB_HEAD_BLOCKS);
+        batch.Write(DB_BEST_BLOCK, hashBlock);
+    }
+    bool ret = db.WriteBatch(batch);
+    LogPrint(BCLog::COINDB, "Committed %u changed transaction outputs (out of %u) to %u coin database shards...\n", (unsigned int)changed, (unsigned int)count, (unsigned int)vDBs.size());
+    return ret;
+}
+
 size_t CCoinsViewDB::EstimateSize() const
 {
-    return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
+    size_t nSize = db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
+    for (const auto& pshard : vShards)
+        nSize += pshard->EstimateSize(DB_COIN, (char)(DB_COIN+1));
+    return nSize;
 }
 
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
@@ -179,27 +326,51 @@ bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
 
 CCoinsViewCursor *CCoinsViewDB::Cursor() const
 {
-    CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper&>(db).NewIterator(), GetBestBlock());
+    CCoinsViewDBCursor *i = new CCoinsViewDBCursor(GetBestBlock());
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
-    i->pcursor->Seek(DB_COIN);
+    i->AddShard(const_cast<CDBWrapper&>(db).NewIterator());
+    for (const auto& pshard : vShards)
+        i->AddShard(pshard->NewIterator());
+    i->SelectCurrent();
+    return i;
+}
+
+void CCoinsViewDBCursor::AddShard(CDBIterator* pcursorIn)
+{
+    vCursors.emplace_back(pcursorIn);
+    vKeys.emplace_back();
+    pcursorIn->Seek(DB_COIN);
     // Cache key of first record
-    if (i->pcursor->Valid()) {
-        CoinEntry entry(&i->keyTmp.second);
-        i->pcursor->GetKey(entry);
-        i->keyTmp.first = entry.key;
+    ReadKey(vCursors.size() - 1);
+}
+
+void CCoinsViewDBCursor::ReadKey(size_t nShard)
+{
+    CoinEntry entry(&vKeys[nShard].second);
+    if (!vCursors[nShard]->Valid() || !vCursors[nShard]->GetKey(entry)) {
+        vKeys[nShard].first = 0; // Invalidate cached key after last record so that Valid() and GetKey() return false
     } else {
-        i->keyTmp.first = 0; // Make sure Valid() and GetKey() return false
+        vKeys[nShard].first = entry.key;
+    }
+}
+
+void CCoinsViewDBCursor::SelectCurrent()
+{
+    // A transaction's outputs are all in one shard, comparing the txids orders the shards like one database
+    nCurrent = 0;
+    for (size_t i = 1; i < vKeys.size(); i++) {
+        if (vKeys[i].first == DB_COIN && (vKeys[nCurrent].first != DB_COIN || vKeys[i].second.hash < vKeys[nCurrent].second.hash))
+            nCurrent = i;
     }
-    return i;
 }
 
 bool CCoinsViewDBCursor::GetKey(COutPoint &key) const
 {
     // Return cached key
-    if (keyTmp.first == DB_COIN) {
-        key = keyTmp.second;
+    if (vKeys[nCurrent].first == DB_COIN) {
+        key = vKeys[nCurrent].second;
         return true;
     }
     return false;
@@ -207,214 +378,240 @@ bool CCoinsViewDBCursor::GetKey(COutPoint &key) const
 
 bool CCoinsViewDBCursor::GetValue(Coin &coin) const
 {
-    return pcursor->GetValue(coin);
+    return vCursors[nCurrent]->GetValue(coin);
 }
 
 unsigned int CCoinsViewDBCursor::GetValueSize() const
 {
-    return pcursor->GetValueSize();
+    return vCursors[nCurrent]->GetValueSize();
 }
 
 bool CCoinsViewDBCursor::Valid() const
 {
-    return keyTmp.first == DB_COIN;
+    return vKeys[nCurrent].first == DB_COIN;
 }
 
 void CCoinsViewDBCursor::Next()
 {
-    pcursor->Next();
-    CoinEntry entry(&keyTmp.second);
-    if (!pcursor->Valid() || !pcursor->GetKey(entry)) {
-        keyTmp.first = 0; // Invalidate cached key after last record so that Valid() and GetKey() return false
-    } else {
-        keyTmp.first = entry.key;
-    }
+    vCursors[nCurrent]->Next();
+    ReadKey(nCurrent);
+    if (vCursors.size() > 1)
+        SelectCurrent();
 }
 
-bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo) {
+bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo, const std::vector<const CBlockIndex*>& zerocoininfo) {
     CDBBatch batch(*this);
     for (std::vector<std::pair<int, const CBlockFileInfo*> >::const_iterator it=fileInfo.begin(); it != fileInfo.end(); it++) {
         batch.Write(std::make_pair(DB_BLOCK_FILES, it->first), *it->second);
     }
     batch.Write(DB_LAST_BLOCK, nLastFile);
     for (std::vector<const CBlockIndex*>::const_iterator it=blockinfo.begin(); it != blockinfo.end(); it++) {
-        batch.Write(std::make_pair(DB_BLOCK_INDEX, (*it)->GetBlockHash()), CDiskBlockIndex(*it));
+        batch.Write(std::make_pair(DB_BLOCK_INDEX, (*it)->GetBlockHash()), CDiskBlockIndex(*it, false));
+    }
+    for (std::vector<const CBlockIndex*>::const_iterator it=zerocoininfo.begin(); it != zerocoininfo.end(); it++) {
+        batch.Write(std::make_pair(DB_BLOCK_ZEROCOIN, (*it)->GetBlockHash()), CDiskBlockZerocoin(*it));
     }
     return WriteBatch(batch, true);
 }
 
-bool CBlockTreeDB::ReadTxIndex(const uint256 &txid, CDiskTxPos &pos) {
-    return Read(std::make_pair(DB_TXINDEX, txid), pos);
+bool CBlockTreeDB::WriteBlockFileMove(const CBlockFileMove &move) {
+    return Write(DB_BLOCK_FILE_MOVE, move, true);
 }
 
-bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<uint256,CDiskTxPos> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Write(std::make_pair(DB_TXINDEX, it->first), it->second);
-    return WriteBatch(batch);
+bool CBlockTreeDB::ReadBlockFileMove(CBlockFileMove &move) {
+    return Read(DB_BLOCK_FILE_MOVE, move);
 }
 
-bool CBlockTreeDB::ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value) {
-    return Read(make_pair(DB_SPENTINDEX, key), value);
+bool CBlockTreeDB::EraseBlockFileMove() {
+    return Erase(DB_BLOCK_FILE_MOVE, true);
 }
 
-bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect) {
+bool CBlockTreeDB::FinishBlockFileMove(const CBlockFileMove &move, const CBlockFileInfo &info, const std::vector<const CBlockIndex*> &blockinfo, const std::vector<std::pair<uint256, CDiskTxPos> > &txinfo) {
     CDBBatch batch(*this);
-    for (std::vector<std::pair<CSpentIndexKey,CSpentIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
-        if (it->second.IsNull()) {
-            batch.Erase(make_pair(DB_SPENTINDEX, it->first));
-        } else {
-            batch.Write(make_pair(DB_SPENTINDEX, it->first), it->second);
-        }
+    batch.Write(std::make_pair(DB_BLOCK_FILES, move.nFile), info);
+    for (const CBlockIndex* pindex : blockinfo) {
+        batch.Write(std::make_pair(DB_BLOCK_INDEX, pindex->GetBlockHash()), CDiskBlockIndex(pindex, false));
     }
-    return WriteBatch(batch);
-}
-
-bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
-        if (it->second.IsNull()) {
-            batch.Erase(make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
-        } else {
-            batch.Write(make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
-        }
+    for (const std::pair<uint256, CDiskTxPos>& entry : txinfo) {
+        batch.Write(std::make_pair(DB_TXINDEX, entry.first), entry.second);
     }
-    return WriteBatch(batch);
+    batch.Erase(DB_BLOCK_FILE_MOVE);
+    return WriteBatch(batch, true);
 }
 
-bool CBlockTreeDB::ReadAddressUnspentIndex(uint256 addressHash, int type,
-                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
-
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
-
-    pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
-
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char,CAddressUnspentKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
-            CAddressUnspentValue nValue;
-            if (pcursor->GetValue(nValue)) {
-                unspentOutputs.push_back(make_pair(key.second, nValue));
-                pcursor->Next();
-            } else {
-                return error("failed to get address unspent value");
-            }
-        } else {
-            break;
-        }
-    }
-
-    return true;
+bool CBlockTreeDB::ReadTxIndex(const uint256 &txid, CDiskTxPos &pos) {
+    return Read(std::make_pair(DB_TXINDEX, txid), pos);
 }
 
-bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
+bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >&vect) {
     CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-    batch.Write(make_pair(DB_ADDRESSINDEX, it->first), it->second);
+    for (std::vector<std::pair<uint256,CDiskTxPos> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
+        batch.Write(std::make_pair(DB_TXINDEX, it->first), it->second);
     return WriteBatch(batch);
 }
 
-bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
-    CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-    batch.Erase(make_pair(DB_ADDRESSINDEX, it->first));
-    return WriteBatch(batch);
+bool CBlockTreeDB::WriteIndexBestBlock(const std::string &name, const CBlockLocator &locator) {
+    return Write(std::make_pair(DB_INDEX_BEST_BLOCK, name), locator);
 }
 
-bool CBlockTreeDB::ReadAddressIndex(uint256 addressHash, int type,
-                                    std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-                                    int start, int end) {
-
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
-
-    if (start > 0 && end > 0) {
-        pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
-    } else {
-        pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
-    }
-
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char,CAddressIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && key.second.hashBytes == addressHash) {
-            if (end > 0 && key.second.blockHeight > end) {
-                break;
-            }
-            CAmount nValue;
-            if (pcursor->GetValue(nValue)) {
-                addressIndex.push_back(make_pair(key.second, nValue));
-                pcursor->Next();
-            } else {
-                return error("failed to get address index value");
-            }
-        } else {
-            break;
-        }
-    }
-
-    return true;
+bool CBlockTreeDB::ReadIndexBestBlock(const std::string &name, CBlockLocator &locator) {
+    return Read(std::make_pair(DB_INDEX_BEST_BLOCK, name), locator);
 }
 
-
-bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
-    CDBBatch batch(*this);
-    batch.Write(make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
-    return WriteBatch(batch);
+bool CBlockTreeDB::EraseIndexBestBlock(const std::string &name) {
+    return Erase(std::make_pair(DB_INDEX_BEST_BLOCK, name));
 }
 
-bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes) {
-
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
-
-    pcursor->Seek(make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(low)));
-
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        std::pair<char, CTimestampIndexKey> key;
-        if (pcursor->GetKey(key) && key.first == DB_TIMESTAMPINDEX && key.second.timestamp <= high) {
-            hashes.push_back(key.second.blockHash);
-            pcursor->Next();
-        } else {
-            break;
-        }
-    }
+bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
+    return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
+}
 
+bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
+    char ch;
+    if (!Read(std::make_pair(DB_FLAG, name), ch))
+        return false;
+    fValue = ch == '1';
     return true;
 }
 
-bool CBlockTreeDB::WriteTimestampBlockIndex(const CTimestampBlockIndexKey &blockhashIndex, const CTimestampBlockIndexValue &logicalts) {
-    CDBBatch batch(*this);
-    batch.Write(std::make_pair(DB_BLOCKHASHINDEX, blockhashIndex), logicalts);
-    return WriteBatch(batch);
+bool CBlockTreeDB::ReadMempoolTokenSalt(uint256 &salt) {
+    return Read(DB_MEMPOOL_TOKEN_SALT, salt);
 }
 
-bool CBlockTreeDB::ReadTimestampBlockIndex(const uint256 &hash, unsigned int &ltimestamp) {
+bool CBlockTreeDB::WriteMempoolTokenSalt(const uint256 &salt) {
+    return Write(DB_MEMPOOL_TOKEN_SALT, salt);
+}
 
-    CTimestampBlockIndexValue(lts);
-    if (!Read(std::make_pair(DB_BLOCKHASHINDEX, hash), lts))
-        return false;
+/** Copy a block index entry read from disk to the in-memory entry of the same hash */
+static CBlockIndex* InsertDiskBlockIndex(const uint256& hash, const CDiskBlockIndex& diskindex, std::function<CBlockIndex*(const uint256&)>& insertBlockIndex)
+{
+    CBlockIndex* pindexNew    = insertBlockIndex(hash);
+    pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
+    pindexNew->nHeight        = diskindex.nHeight;
+    pindexNew->nFile          = diskindex.nFile;
+    pindexNew->nDataPos       = diskindex.nDataPos;
+    pindexNew->nUndoPos       = diskindex.nUndoPos;
+    pindexNew->nVersion       = diskindex.nVersion;
+    pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+    pindexNew->nTime          = diskindex.nTime;
+    pindexNew->nBits          = diskindex.nBits;
+    pindexNew->nNonce         = diskindex.nNonce;
+    pindexNew->nStatus        = diskindex.nStatus;
+    pindexNew->nTx            = diskindex.nTx;
+
+    //zerocoin
+    pindexNew->accumulatorChanges = diskindex.accumulatorChanges;
+    pindexNew->spentSerials       = diskindex.spentSerials;
+    return pindexNew;
+}
 
-    ltimestamp = lts.ltimestamp;
-    return true;
+static fs::path GetBlockIndexSnapshotPath()
+{
+    return GetDataDir() / "blockindex.dat";
 }
 
+bool CBlockTreeDB::WriteBlockIndexSnapshot(const std::vector<const CBlockIndex*>& vIndex)
+{
+    // Forget the previous snapshot first, until the new one is recorded the database is used
+    if (!Erase(DB_BLOCK_INDEX_SNAPSHOT, true))
+        return error("%s: failed to erase the previous snapshot id", __func__);
+
+    const uint256 id = GetRandHash();
+    const fs::path path = GetBlockIndexSnapshotPath();
+    const fs::path pathTmp = path.string() + ".new";
+    try {
+        CAutoFile fileout(fsbridge::fopen(pathTmp, "wb"), SER_DISK, CLIENT_VERSION);
+        if (fileout.IsNull())
+            return error("%s: failed to open %s", __func__, pathTmp.string());
+
+        CHashWriter hasher(SER_DISK, CLIENT_VERSION);
+        fileout << FLATDATA(Params().MessageStart()) << BLOCK_INDEX_SNAPSHOT_VERSION << id << (uint64_t)vIndex.size();
+        hasher << FLATDATA(Params().MessageStart()) << BLOCK_INDEX_SNAPSHOT_VERSION << id << (uint64_t)vIndex.size();
+        for (const CBlockIndex* pindex : vIndex) {
+            const uint256 hash = pindex->GetBlockHash();
+            const CDiskBlockIndex diskindex(pindex);
+            fileout << hash << diskindex;
+            hasher << hash << diskindex;
+        }
+        fileout << hasher.GetHash();
+        FileCommit(fileout.Get());
+        fileout.fclose();
+    } catch (const std::exception& e) {
+        return error("%s: failed to write %s: %s", __func__, pathTmp.string(), e.what());
+    }
+    if (!RenameOver(pathTmp, path))
+        return error("%s: failed to rename %s", __func__, pathTmp.string());
 
-bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
-    return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
+    return Write(DB_BLOCK_INDEX_SNAPSHOT, id, true);
 }
 
-bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
-    char ch;
-    if (!Read(std::make_pair(DB_FLAG, name), ch))
+bool CBlockTreeDB::LoadBlockIndexSnapshot(std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+{
+    uint256 id;
+    if (!Read(DB_BLOCK_INDEX_SNAPSHOT, id))
         return false;
-    fValue = ch == '1';
+    // The snapshot only matches the database until the next write of a block index entry
+    if (!Erase(DB_BLOCK_INDEX_SNAPSHOT, true))
+        return error("%s: failed to erase the snapshot id", __func__);
+
+    // Read the whole file at once, deserializing from memory is much faster than from the file
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    {
+        CAutoFile filein(fsbridge::fopen(GetBlockIndexSnapshotPath(), "rb"), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("%s: failed to open %s", __func__, GetBlockIndexSnapshotPath().string());
+        if (fseek(filein.Get(), 0, SEEK_END) != 0)
+            return false;
+        long nSize = ftell(filein.Get());
+        if (nSize < (long)sizeof(uint256) || fseek(filein.Get(), 0, SEEK_SET) != 0)
+            return error("%s: %s is truncated", __func__, GetBlockIndexSnapshotPath().string());
+        ss.resize(nSize);
+        if (fread(&ss[0], 1, ss.size(), filein.Get()) != ss.size())
+            return error("%s: failed to read %s", __func__, GetBlockIndexSnapshotPath().string());
+    }
+
+    // Nothing is inserted before the whole snapshot is known to be intact
+    const size_t nPayload = ss.size() - sizeof(uint256);
+    uint256 hashChecksum;
+    memcpy(hashChecksum.begin(), &ss[nPayload], sizeof(uint256));
+    if (Hash(ss.begin(), ss.begin() + nPayload) != hashChecksum)
+        return error("%s: checksum mismatch", __func__);
+    ss.resize(nPayload);
+
+    try {
+        unsigned char pchMessageStart[4];
+        uint32_t nVersion;
+        uint256 idFile;
+        uint64_t nCount;
+        ss >> FLATDATA(pchMessageStart) >> nVersion >> idFile >> nCount;
+        if (memcmp(pchMessageStart, Params().MessageStart(), sizeof(pchMessageStart)) || nVersion != BLOCK_INDEX_SNAPSHOT_VERSION || idFile != id)
+            return false;
+
+        // Entries were checked when they were loaded or accepted, so proof of work is not checked again
+        for (uint64_t i = 0; i < nCount; i++) {
+            if (i % 10000 == 0)
+                boost::this_thread::interruption_point();
+            uint256 hash;
+            CDiskBlockIndex diskindex;
+            ss >> hash >> diskindex;
+            InsertDiskBlockIndex(hash, diskindex, insertBlockIndex);
+        }
+    } catch (const std::ios_base::failure& e) {
+        return error("%s: failed to deserialize: %s", __func__, e.what());
+    }
     return true;
 }
 
-bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex, CZerocoinDB *zerocoinDB)
 {
+    int64_t nStart = GetTimeMillis();
+    if (LoadBlockIndexSnapshot(insertBlockIndex)) {
+        LogPrintf("%s: loaded block index snapshot in %dms\n", __func__, GetTimeMillis() - nStart);
+        return true;
+    }
+
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
+    std::vector<std::pair<uint256, CDiskBlockIndex>> vMigrated;
 
     pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, uint256()));
 
@@ -426,28 +623,25 @@ bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams,
             CDiskBlockIndex diskindex;
             if (pcursor->GetValue(diskindex)) {
                 // Construct block index object
-                CBlockIndex* pindexNew    = insertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
-                pindexNew->nHeight        = diskindex.nHeight;
-                pindexNew->nFile          = diskindex.nFile;
-                pindexNew->nDataPos       = diskindex.nDataPos;
-                pindexNew->nUndoPos       = diskindex.nUndoPos;
-                pindexNew->nVersion       = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->nTime          = diskindex.nTime;
-                pindexNew->nBits          = diskindex.nBits;
-                pindexNew->nNonce         = diskindex.nNonce;
-                pindexNew->nStatus        = diskindex.nStatus;
-                pindexNew->nTx            = diskindex.nTx;
-
-                //zerocoin
-                pindexNew->accumulatorChanges = diskindex.accumulatorChanges;
-                pindexNew->mintedPubCoins     = diskindex.mintedPubCoins;
-                pindexNew->spentSerials       = diskindex.spentSerials;
-
-                if (!CheckProofOfWork(pindexNew->GetBlockPoWHash(), pindexNew->nBits, consensusParams))
+                CBlockIndex* pindexNew = InsertDiskBlockIndex(diskindex.GetBlockHash(), diskindex, insertBlockIndex);
+
+                if (!CheckBlockHeaderProofOfWork(pindexNew->GetBlockHeader(), pindexNew->nHeight, consensusParams))
                     return error("%s: CheckProofOfWork failed: %s", __func__, pindexNew->ToString());
 
+                // Older versions kept public coins in the block index, move them to the zerocoin database
+                bool fMigrate = false;
+                if (!diskindex.mintedPubCoins.empty()) {
+                    if (zerocoinDB == nullptr || !zerocoinDB->WriteBlockMints(pindexNew->GetBlockHash(), pindexNew->nHeight, diskindex.mintedPubCoins))
+                        return error("%s: failed to move zerocoin mints of block %s", __func__, pindexNew->GetBlockHash().ToString());
+                    diskindex.mintedPubCoins.clear();
+                    fMigrate = true;
+                }
+                // and the rest of the zerocoin data to its own record
+                if (!diskindex.accumulatorChanges.empty() || !diskindex.spentSerials.empty())
+                    fMigrate = true;
+                if (fMigrate)
+                    vMigrated.push_back(std::make_pair(pindexNew->GetBlockHash(), diskindex));
+
                 pcursor->Next();
             } else {
                 return error("%s: failed to read value", __func__);
@@ -457,9 +651,78 @@ bool CBlockTreeDB::LoadBlockIndexGuts(const Consensus::Params& consensusParams,
         }
     }
 
+    // Zerocoin data written in its own records, newer than what an entry of an older version holds
+    pcursor->Seek(std::make_pair(DB_BLOCK_ZEROCOIN, uint256()));
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, uint256> key;
+        if (!pcursor->GetKey(key) || key.first != DB_BLOCK_ZEROCOIN)
+            break;
+        CDiskBlockZerocoin diskzerocoin;
+        if (!pcursor->GetValue(diskzerocoin))
+            return error("%s: failed to read zerocoin data", __func__);
+        CBlockIndex* pindex = insertBlockIndex(key.second);
+        pindex->accumulatorChanges = std::move(diskzerocoin.accumulatorChanges);
+        pindex->spentSerials = std::move(diskzerocoin.spentSerials);
+        pcursor->Next();
+    }
+
+    if (!vMigrated.empty()) {
+        // zerocoin database has to be on disk before the mints are dropped from the block index
+        if (zerocoinDB != nullptr && !zerocoinDB->Sync())
+            return error("%s: failed to sync zerocoin database", __func__);
+        CDBBatch batch(*this);
+        for (const std::pair<uint256, CDiskBlockIndex> &migrated: vMigrated) {
+            const CBlockIndex* pindex = insertBlockIndex(migrated.first);
+            batch.Write(std::make_pair(DB_BLOCK_INDEX, migrated.first), CDiskBlockIndex(pindex, false));
+            batch.Write(std::make_pair(DB_BLOCK_ZEROCOIN, migrated.first), CDiskBlockZerocoin(pindex));
+        }
+        if (!WriteBatch(batch, true))
+            return error("%s: failed to rewrite migrated block index entries", __func__);
+        LogPrintf("%s: moved zerocoin data of %u blocks out of the block index entries\n", __func__, vMigrated.size());
+    }
+
     return true;
 }
 
+CZerocoinDB::CZerocoinDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "zerocoin", nCacheSize, fMemory, fWipe) {
+}
+
+bool CZerocoinDB::ReadBlockMints(const uint256 &blockHash, std::map<std::pair<int,int>, std::vector<CBigNum>> &mints) {
+    return Read(std::make_pair(DB_ZEROCOIN_BLOCK_MINTS, blockHash), mints);
+}
+
+bool CZerocoinDB::WriteBlockMints(const uint256 &blockHash, int nHeight, const std::map<std::pair<int,int>, std::vector<CBigNum>> &mints) {
+    CDBBatch batch(*this);
+    batch.Write(std::make_pair(DB_ZEROCOIN_BLOCK_MINTS, blockHash), mints);
+
+    // the same public coin may appear more than once, gather all of its entries before writing
+    std::map<uint256, std::vector<CZerocoinMintInfo>> mintInfo;
+    for (const auto &groupMints: mints) {
+        for (const CBigNum &pubCoin: groupMints.second) {
+            uint256 pubCoinHash = SerializeHash(pubCoin);
+            auto it = mintInfo.find(pubCoinHash);
+            if (it == mintInfo.end()) {
+                it = mintInfo.insert(std::make_pair(pubCoinHash, std::vector<CZerocoinMintInfo>())).first;
+                Read(std::make_pair(DB_ZEROCOIN_PUBCOIN, pubCoinHash), it->second);
+                // drop what a previous attempt to connect this block may have left
+                it->second.erase(std::remove_if(it->second.begin(), it->second.end(),
+                                                [&](const CZerocoinMintInfo &info) { return info.blockHash == blockHash; }),
+                                 it->second.end());
+            }
+            it->second.push_back(CZerocoinMintInfo(groupMints.first.first, groupMints.first.second, nHeight, blockHash));
+        }
+    }
+    for (const auto &info: mintInfo)
+        batch.Write(std::make_pair(DB_ZEROCOIN_PUBCOIN, info.first), info.second);
+
+    return WriteBatch(batch);
+}
+
+bool CZerocoinDB::ReadMintInfo(const CBigNum &pubCoin, std::vector<CZerocoinMintInfo> &info) {
+    return Read(std::make_pair(DB_ZEROCOIN_PUBCOIN, SerializeHash(pubCoin)), info);
+}
+
 namespace {
 
 //! Legacy class to deserialize pre-pertxout database entries without reindex.
@@ -582,3 +845,375 @@ bool CCoinsViewDB::Upgrade() {
     LogPrintf("[%s].\n", ShutdownRequested() ? "CANCELLED" : "DONE");
     return !ShutdownRequested();
 }
+
+CIndexDB::CIndexDB(const std::string &name, size_t nCacheSize, bool fMemory, bool fWipe, const CDBOptions &dbOptions) :
+    CDBWrapper(GetDataDir() / "indexes" / name, nCacheSize, fMemory, fWipe, false, dbOptions) {
+}
+
+bool CIndexDB::ReadBestBlock(CBlockLocator &locator) const {
+    return Read(DB_BEST_BLOCK, locator);
+}
+
+bool CIndexDB::WriteBestBlock(const CBlockLocator &locator) {
+    return Write(DB_BEST_BLOCK, locator);
+}
+
+/** Move the records under one key prefix from the block tree database to an index database */
+template <typename K, typename V>
+static bool MoveIndexRecords(CDBWrapper &dbFrom, CDBWrapper &dbTo, char chPrefix) {
+    std::unique_ptr<CDBIterator> pcursor(dbFrom.NewIterator());
+    CDBBatch batchFrom(dbFrom);
+    CDBBatch batchTo(dbTo);
+    size_t nCount = 0;
+
+    pcursor->Seek(chPrefix);
+    while (pcursor->Valid()) {
+        std::pair<char, K> key;
+        if (!pcursor->GetKey(key) || key.first != chPrefix)
+            break;
+        V value;
+        if (!pcursor->GetValue(value))
+            return error("%s: failed to read index record", __func__);
+        batchTo.Write(key, value);
+        batchFrom.Erase(key);
+        nCount++;
+        if (batchTo.SizeEstimate() > (size_t)nDefaultDbBatchSize) {
+            // write the copies first so an interrupted move never loses records
+            if (!dbTo.WriteBatch(batchTo) || !dbFrom.WriteBatch(batchFrom))
+                return false;
+            batchTo.Clear();
+            batchFrom.Clear();
+        }
+        pcursor->Next();
+    }
+    if (!dbTo.WriteBatch(batchTo) || !dbFrom.WriteBatch(batchFrom))
+        return false;
+
+    if (nCount > 0) {
+        LogPrintf("%s: moved %u records with prefix '%c'\n", __func__, nCount, chPrefix);
+        dbFrom.CompactRange(chPrefix, (char)(chPrefix + 1));
+    }
+    return true;
+}
+
+CAddressIndexDB::CAddressIndexDB(size_t nCacheSize, bool fMemory, bool fWipe, bool fCompression) :
+    CIndexDB("addressindex", nCacheSize, fMemory, fWipe, GetDBOptions(fCompression)) {
+    // The balances are complete when they are kept from the first block on
+    if (IsEmpty())
+        Write(std::make_pair(DB_FLAG, std::string("addressbalance")), '1');
+}
+
+CDBOptions CAddressIndexDB::GetDBOptions(bool fCompression) {
+    CDBOptions dbOptions;
+    // the address index is only read by range scans, which bloom filters do not help
+    dbOptions.nBloomBitsPerKey = 0;
+    dbOptions.fCompression = fCompression;
+    return dbOptions;
+}
+
+bool CAddressIndexDB::MoveFromBlockTree(CBlockTreeDB &blocktree) {
+    // the records kept by older versions come without balances
+    return Erase(std::make_pair(DB_FLAG, std::string("addressbalance")), true) &&
+           MoveIndexRecords<CAddressIndexKey, CAmount>(blocktree, *this, DB_ADDRESSINDEX) &&
+           MoveIndexRecords<CAddressUnspentKey, CAddressUnspentValue>(blocktree, *this, DB_ADDRESSUNSPENTINDEX);
+}
+
+bool CAddressIndexDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect) {
+    CDBBatch batch(*this);
+    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        if (it->second.IsNull()) {
+            batch.Erase(make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
+        } else {
+            batch.Write(make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
+        }
+    }
+    return WriteBatch(batch);
+}
+
+bool CAddressIndexDB::ReadAddressUnspentIndex(uint256 addressHash, int type,
+                                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
+    return ScanAddressUnspentIndex(addressHash, type, nullptr,
+        [&unspentOutputs](const CAddressUnspentKey &key, const CAddressUnspentValue &value) {
+            unspentOutputs.push_back(std::make_pair(key, value));
+            return true;
+        });
+}
+
+bool CAddressIndexDB::ScanAddressUnspentIndex(const uint256 &addressHash, int type, const CAddressUnspentKey *pkeyAfter,
+                                              const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)> &fn) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    if (pkeyAfter) {
+        pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, *pkeyAfter));
+    } else {
+        pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    }
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressUnspentKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash) {
+            if (pkeyAfter && key.second == *pkeyAfter) {
+                pcursor->Next();
+                continue;
+            }
+            CAddressUnspentValue nValue;
+            if (pcursor->GetValue(nValue)) {
+                if (!fn(key.second, nValue))
+                    break;
+                pcursor->Next();
+            } else {
+                return error("failed to get address unspent value");
+            }
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool CAddressIndexDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
+    CDBBatch batch(*this);
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
+    batch.Write(make_pair(DB_ADDRESSINDEX, it->first), it->second);
+    UpdateAddressBalances(batch, vect, false);
+    return WriteBatch(batch);
+}
+
+bool CAddressIndexDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
+    CDBBatch batch(*this);
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
+    batch.Erase(make_pair(DB_ADDRESSINDEX, it->first));
+    UpdateAddressBalances(batch, vect, true);
+    return WriteBatch(batch);
+}
+
+void CAddressIndexDB::UpdateAddressBalances(CDBBatch &batch, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fErase) {
+    // Sum the entries by address first, the batch can't be read back
+    std::map<std::pair<unsigned int, uint256>, CAddressBalance> mapDeltas;
+    std::set<std::tuple<unsigned int, uint256, uint256> > setAddressTxs;
+    for (const std::pair<CAddressIndexKey, CAmount> &entry : vect) {
+        const CAddressIndexKey &key = entry.first;
+        CAddressBalance &delta = mapDeltas[std::make_pair(key.type, key.hashBytes)];
+        delta.balance += entry.second;
+        if (entry.second > 0)
+            delta.received += entry.second;
+        if (setAddressTxs.emplace(key.type, key.hashBytes, key.txhash).second)
+            delta.nTxCount++;
+    }
+
+    for (const auto &it : mapDeltas) {
+        const CAddressIndexIteratorKey key(it.first.first, it.first.second);
+        CAddressBalance balance;
+        ReadAddressBalance(key.hashBytes, key.type, balance);
+        const int nSign = fErase ? -1 : 1;
+        balance.balance += nSign * it.second.balance;
+        balance.received += nSign * it.second.received;
+        balance.nTxCount += nSign * it.second.nTxCount;
+        if (balance.IsNull()) {
+            batch.Erase(std::make_pair(DB_ADDRESSBALANCE, key));
+        } else {
+            batch.Write(std::make_pair(DB_ADDRESSBALANCE, key), balance);
+        }
+    }
+}
+
+bool CAddressIndexDB::HasAddressBalances() {
+    return Exists(std::make_pair(DB_FLAG, std::string("addressbalance")));
+}
+
+bool CAddressIndexDB::ReadAddressBalance(const uint256 &addressHash, int type, CAddressBalance &balance) {
+    // a missing record reads as all zero
+    if (!Read(std::make_pair(DB_ADDRESSBALANCE, CAddressIndexIteratorKey(type, addressHash)), balance))
+        balance.SetNull();
+    return true;
+}
+
+bool CAddressIndexDB::ReadAddressIndex(uint256 addressHash, int type,
+                                    std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                                    int start, int end) {
+    return ScanAddressIndex(addressHash, type, start, end, nullptr,
+        [&addressIndex](const CAddressIndexKey &key, CAmount nValue) {
+            addressIndex.push_back(std::make_pair(key, nValue));
+            return true;
+        });
+}
+
+bool CAddressIndexDB::ScanAddressIndex(const uint256 &addressHash, int type, int start, int end, const CAddressIndexKey *pkeyAfter,
+                                       const std::function<bool(const CAddressIndexKey&, CAmount)> &fn) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    // Keys are ordered by height within an address, so the start of a height range and the cursor
+    // are seeks and the end height stops the scan
+    bool fHeightRange = start > 0 && end > 0;
+    if (pkeyAfter && (!fHeightRange || pkeyAfter->blockHeight >= start)) {
+        pcursor->Seek(make_pair(DB_ADDRESSINDEX, *pkeyAfter));
+    } else if (fHeightRange) {
+        pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, start)));
+    } else {
+        pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    }
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressIndexKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX && key.second.hashBytes == addressHash) {
+            if (end > 0 && key.second.blockHeight > end) {
+                break;
+            }
+            if (pkeyAfter && key.second == *pkeyAfter) {
+                pcursor->Next();
+                continue;
+            }
+            CAmount nValue;
+            if (pcursor->GetValue(nValue)) {
+                if (!fn(key.second, nValue))
+                    break;
+                pcursor->Next();
+            } else {
+                return error("failed to get address index value");
+            }
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+CSpentIndexDB::CSpentIndexDB(size_t nCacheSize, bool fMemory, bool fWipe) :
+    CIndexDB("spentindex", nCacheSize, fMemory, fWipe, CDBOptions()) {
+}
+
+bool CSpentIndexDB::MoveFromBlockTree(CBlockTreeDB &blocktree) {
+    return MoveIndexRecords<CSpentIndexKey, CSpentIndexValue>(blocktree, *this, DB_SPENTINDEX);
+}
+
+bool CSpentIndexDB::ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value) {
+    return Read(make_pair(DB_SPENTINDEX, key), value);
+}
+
+bool CSpentIndexDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect) {
+    CDBBatch batch(*this);
+    for (std::vector<std::pair<CSpentIndexKey,CSpentIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        if (it->second.IsNull()) {
+            batch.Erase(make_pair(DB_SPENTINDEX, it->first));
+        } else {
+            batch.Write(make_pair(DB_SPENTINDEX, it->first), it->second);
+        }
+    }
+    return WriteBatch(batch);
+}
+
+CTimestampIndexDB::CTimestampIndexDB(size_t nCacheSize, bool fMemory, bool fWipe) :
+    CIndexDB("timestampindex", nCacheSize, fMemory, fWipe, CDBOptions()) {
+}
+
+bool CTimestampIndexDB::MoveFromBlockTree(CBlockTreeDB &blocktree) {
+    return MoveIndexRecords<CTimestampIndexKey, int>(blocktree, *this, DB_TIMESTAMPINDEX) &&
+           MoveIndexRecords<CTimestampBlockIndexKey, CTimestampBlockIndexValue>(blocktree, *this, DB_BLOCKHASHINDEX);
+}
+
+bool CTimestampIndexDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
+    CDBBatch batch(*this);
+    batch.Write(make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
+    return WriteBatch(batch);
+}
+
+bool CTimestampIndexDB::ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(make_pair(DB_TIMESTAMPINDEX, CTimestampIndexIteratorKey(low)));
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, CTimestampIndexKey> key;
+        if (pcursor->GetKey(key) && key.first == DB_TIMESTAMPINDEX && key.second.timestamp <= high) {
+            hashes.push_back(key.second.blockHash);
+            pcursor->Next();
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool CTimestampIndexDB::WriteTimestampBlockIndex(const CTimestampBlockIndexKey &blockhashIndex, const CTimestampBlockIndexValue &logicalts) {
+    CDBBatch batch(*this);
+    batch.Write(std::make_pair(DB_BLOCKHASHINDEX, blockhashIndex), logicalts);
+    return WriteBatch(batch);
+}
+
+bool CTimestampIndexDB::ReadTimestampBlockIndex(const uint256 &hash, unsigned int &ltimestamp) {
+
+    CTimestampBlockIndexValue(lts);
+    if (!Read(std::make_pair(DB_BLOCKHASHINDEX, hash), lts))
+        return false;
+
+    ltimestamp = lts.ltimestamp;
+    return true;
+}
+
+CCollateralIndexDB::CCollateralIndexDB(size_t nCacheSize, bool fMemory, bool fWipe) :
+    CIndexDB("collateralindex", nCacheSize, fMemory, fWipe, CDBOptions()) {
+}
+
+bool CCollateralIndexDB::ReadCollateral(const COutPoint &outpoint, CGhostnodeCollateral &collateral) {
+    return Read(std::make_pair(DB_COLLATERALINDEX, outpoint), collateral);
+}
+
+bool CCollateralIndexDB::ReadCollaterals(std::vector<std::pair<COutPoint, CGhostnodeCollateral> > &vect) {
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(DB_COLLATERALINDEX);
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, COutPoint> key;
+        CGhostnodeCollateral collateral;
+        if (pcursor->GetKey(key) && key.first == DB_COLLATERALINDEX) {
+            if (!pcursor->GetValue(collateral))
+                return error("%s: failed to read value", __func__);
+            vect.push_back(std::make_pair(key.second, collateral));
+            pcursor->Next();
+        } else {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool CCollateralIndexDB::UpdateCollaterals(const std::vector<std::pair<COutPoint, CGhostnodeCollateral> > &vect) {
+    CDBBatch batch(*this);
+    for (std::vector<std::pair<COutPoint, CGhostnodeCollateral> >::const_iterator it = vect.begin(); it != vect.end(); it++) {
+        if (it->second.IsNull()) {
+            batch.Erase(std::make_pair(DB_COLLATERALINDEX, it->first));
+        } else {
+            batch.Write(std::make_pair(DB_COLLATERALINDEX, it->first), it->second);
+        }
+    }
+    return WriteBatch(batch);
+}
+
+CBlockFilterIndexDB::CBlockFilterIndexDB(size_t nCacheSize, bool fMemory, bool fWipe) :
+    CIndexDB("blockfilterindex", nCacheSize, fMemory, fWipe, CDBOptions()) {
+}
+
+bool CBlockFilterIndexDB::ReadFilter(uint8_t filterType, const uint256 &blockHash, CBlockFilterEntry &entry) {
+    return Read(std::make_pair(std::make_pair(DB_BLOCKFILTERINDEX, filterType), blockHash), entry);
+}
+
+bool CBlockFilterIndexDB::WriteFilter(uint8_t filterType, const uint256 &blockHash, const CBlockFilterEntry &entry) {
+    return Write(std::make_pair(std::make_pair(DB_BLOCKFILTERINDEX, filterType), blockHash), entry);
+}
+
+bool CBlockFilterIndexDB::EraseFilter(uint8_t filterType, const uint256 &blockHash) {
+    return Erase(std::make_pair(std::make_pair(DB_BLOCKFILTERINDEX, filterType), blockHash));
+}
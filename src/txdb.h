@@ -10,7 +10,9 @@
 #include <dbwrapper.h>
 #include <chain.h>
 
+#include <functional>
 #include <map>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -19,14 +21,20 @@
 
 class CBlockIndex;
 class CCoinsViewDBCursor;
+class CZerocoinDB;
 class uint256;
 
 //! No need to periodic flush if at least this much space still available.
 static constexpr int MAX_BLOCK_COINSDB_USAGE = 10;
+//! Version of the blockindex.dat snapshot
+static const uint32_t BLOCK_INDEX_SNAPSHOT_VERSION = 1;
 //! -dbcache default (MiB)
 static const int64_t nDefaultDbCache = 450;
 //! -dbbatchsize default (bytes)
 static const int64_t nDefaultDbBatchSize = 16 << 20;
+//! -chainstateshards default, number of databases the coins are spread over
+static const int DEFAULT_CHAINSTATE_SHARDS = 1;
+static const int MAX_CHAINSTATE_SHARDS = 16;
 //! max. -dbcache (MiB)
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 16384 : 1024;
 //! min. -dbcache (MiB)
@@ -39,6 +47,18 @@ static const int64_t nMaxBlockDBCache = 2;
 static const int64_t nMaxBlockDBAndTxIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! Max memory allocated to zerocoin DB specific cache (MiB)
+static const int64_t nMaxZerocoinDBCache = 8;
+//! Max memory allocated to address index DB specific cache (MiB)
+static const int64_t nMaxAddressIndexDBCache = 1024;
+//! Max memory allocated to spent index DB specific cache (MiB)
+static const int64_t nMaxSpentIndexDBCache = 256;
+//! Max memory allocated to timestamp index DB specific cache (MiB)
+static const int64_t nMaxTimestampIndexDBCache = 8;
+//! Max memory allocated to ghostnode collateral index DB specific cache (MiB)
+static const int64_t nMaxCollateralIndexDBCache = 8;
+//! Max memory allocated to block filter index DB specific cache (MiB)
+static const int64_t nMaxBlockFilterIndexDBCache = 64;
 
 struct CDiskTxPos : public CDiskBlockPos
 {
@@ -65,19 +85,56 @@ struct CDiskTxPos : public CDiskBlockPos
     }
 };
 
-/** CCoinsView backed by the coin database (chainstate/) */
+/**
+ * A block file rewritten with its blocks compressed, journaled in the block tree database from
+ * before it replaces the original file until the indexes point to the moved blocks.
+ */
+struct CBlockFileMove
+{
+    int nFile;
+    unsigned int nSize; //!< size of the rewritten file
+    std::vector<std::pair<unsigned int, unsigned int> > vMoved; //!< old and new position of every block
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(VARINT(nFile));
+        READWRITE(VARINT(nSize));
+        READWRITE(vMoved);
+    }
+
+    CBlockFileMove() : nFile(-1), nSize(0) {}
+};
+
+/**
+ * CCoinsView backed by the coin database (chainstate/). The coins may be spread by transaction
+ * over several databases, chainstate/ itself and chainstate/shard<n>/, which a flush writes in
+ * parallel. The best block and head blocks markers are kept in chainstate/.
+ */
 class CCoinsViewDB final : public CCoinsView
 {
 protected:
     CDBWrapper db;
+    //! the shards besides db, empty for an unsharded database
+    std::vector<std::unique_ptr<CDBWrapper> > vShards;
+
+    CDBWrapper &GetShard(const COutPoint &outpoint) const;
+    bool WriteCoins(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fFinal);
+    bool WriteShardedCoins(CCoinsMap &mapCoins, const uint256 &hashBlock, const uint256 &old_tip, bool fFinal);
 public:
-    explicit CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    /**
+     * nShards applies to a new (or wiped) database, an existing one keeps the number of shards
+     * it was created with.
+     */
+    explicit CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false, int nShards = DEFAULT_CHAINSTATE_SHARDS);
 
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
     bool HaveCoin(const COutPoint &outpoint) const override;
     uint256 GetBestBlock() const override;
     std::vector<uint256> GetHeadBlocks() const override;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    bool BatchWritePartial(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
 
     //! Attempt to update from an older database format. Returns whether an error occurred.
@@ -99,10 +156,17 @@ public:
     void Next() override;
 
 private:
-    CCoinsViewDBCursor(CDBIterator* pcursorIn, const uint256 &hashBlockIn):
-        CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn) {}
-    std::unique_ptr<CDBIterator> pcursor;
-    std::pair<char, COutPoint> keyTmp;
+    explicit CCoinsViewDBCursor(const uint256 &hashBlockIn): CCoinsViewCursor(hashBlockIn), nCurrent(0) {}
+    void AddShard(CDBIterator* pcursorIn);
+    void ReadKey(size_t nShard);
+    void SelectCurrent();
+
+    //! one cursor per shard, merged in key order
+    std::vector<std::unique_ptr<CDBIterator> > vCursors;
+    //! cached key of each cursor, the char is not DB_COIN once it is past the last coin
+    std::vector<std::pair<char, COutPoint> > vKeys;
+    //! the cursor with the lowest key
+    size_t nCurrent;
 
     friend class CCoinsViewDB;
 };
@@ -116,15 +180,112 @@ public:
     CBlockTreeDB(const CBlockTreeDB&) = delete;
     CBlockTreeDB& operator=(const CBlockTreeDB&) = delete;
 
-    bool WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo);
+    /** Write block file info and block index entries, and the zerocoin data of the entries in zerocoininfo */
+    bool WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo, const std::vector<const CBlockIndex*>& zerocoininfo);
     bool ReadBlockFileInfo(int nFile, CBlockFileInfo &info);
     bool ReadLastBlockFile(int &nFile);
     bool WriteReindexing(bool fReindexing);
     bool ReadReindexing(bool &fReindexing);
+    bool WriteBlockFileMove(const CBlockFileMove &move);
+    bool ReadBlockFileMove(CBlockFileMove &move);
+    bool EraseBlockFileMove();
+    /** Write the file info and the moved block and transaction index entries of a block file move and erase its journal entry */
+    bool FinishBlockFileMove(const CBlockFileMove &move, const CBlockFileInfo &info, const std::vector<const CBlockIndex*> &blockinfo, const std::vector<std::pair<uint256, CDiskTxPos> > &txinfo);
     bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &vect);
-    bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
-    bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect);
+    bool WriteIndexBestBlock(const std::string &name, const CBlockLocator &locator);
+    bool ReadIndexBestBlock(const std::string &name, CBlockLocator &locator);
+    bool EraseIndexBestBlock(const std::string &name);
+    bool WriteFlag(const std::string &name, bool fValue);
+    bool ReadFlag(const std::string &name, bool &fValue);
+    /** Node-local salt of the zerocoin spend tokens in mempool.dat */
+    bool ReadMempoolTokenSalt(uint256 &salt);
+    bool WriteMempoolTokenSalt(const uint256 &salt);
+    /**
+     * Write the given entries, sorted by height, to blockindex.dat and record the snapshot in the
+     * database. LoadBlockIndexGuts uses it instead of scanning the database on the next start.
+     */
+    bool WriteBlockIndexSnapshot(const std::vector<const CBlockIndex*>& vIndex);
+    bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex, CZerocoinDB *zerocoinDB);
+
+private:
+    /** Load blockindex.dat if it is still the snapshot of the database, which it stops being once loaded */
+    bool LoadBlockIndexSnapshot(std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+};
+
+/** Where and under which group a zerocoin public coin was minted */
+struct CZerocoinMintInfo
+{
+    int denomination;
+    int id;
+    int nHeight;
+    uint256 blockHash;
+
+    CZerocoinMintInfo() : denomination(0), id(0), nHeight(-1) {}
+    CZerocoinMintInfo(int denominationIn, int idIn, int nHeightIn, const uint256 &blockHashIn) :
+        denomination(denominationIn), id(idIn), nHeight(nHeightIn), blockHash(blockHashIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(denomination);
+        READWRITE(id);
+        READWRITE(nHeight);
+        READWRITE(blockHash);
+    }
+};
+
+/**
+ * Access to the zerocoin index database (zerocoin/). Keeps public coins minted in every block and
+ * an index from public coin to the mints of it, so neither has to be held in memory. Records are
+ * keyed by block hash and never rolled back on reorg, users check that the block is still active
+ */
+class CZerocoinDB : public CDBWrapper
+{
+public:
+    explicit CZerocoinDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    CZerocoinDB(const CZerocoinDB&) = delete;
+    CZerocoinDB& operator=(const CZerocoinDB&) = delete;
+
+    //! Public coins minted in the block, by <denomination, id>
+    bool ReadBlockMints(const uint256 &blockHash, std::map<std::pair<int,int>, std::vector<CBigNum>> &mints);
+    //! Store mints of the block and add them to the public coin index
+    bool WriteBlockMints(const uint256 &blockHash, int nHeight, const std::map<std::pair<int,int>, std::vector<CBigNum>> &mints);
+    //! All the recorded mints of the public coin, including ones from blocks no longer in the active chain
+    bool ReadMintInfo(const CBigNum &pubCoin, std::vector<CZerocoinMintInfo> &info);
+};
+
+/** Access to the database of a background index (indexes/<name>/), which also keeps its best block */
+class CIndexDB : public CDBWrapper
+{
+public:
+    CIndexDB(const std::string &name, size_t nCacheSize, bool fMemory, bool fWipe, const CDBOptions &dbOptions);
+
+    CIndexDB(const CIndexDB&) = delete;
+    CIndexDB& operator=(const CIndexDB&) = delete;
+
+    bool ReadBestBlock(CBlockLocator &locator) const;
+    bool WriteBestBlock(const CBlockLocator &locator);
+
+    //! Move the records that older versions kept in the block tree database
+    virtual bool MoveFromBlockTree(CBlockTreeDB &blocktree) = 0;
+};
+
+/** Access to the address index database. Only read by range scans, so it has no bloom filter */
+class CAddressIndexDB final : public CIndexDB
+{
+private:
+    static CDBOptions GetDBOptions(bool fCompression);
+    //! Add (or with fErase take back) the address index entries of a block to the address balances
+    void UpdateAddressBalances(CDBBatch &batch, const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect, bool fErase);
+
+public:
+    CAddressIndexDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool fCompression = false);
+
+    bool MoveFromBlockTree(CBlockTreeDB &blocktree) override;
+
     bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect);
     bool ReadAddressUnspentIndex(uint256 addressHash, int type,
                                  std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
@@ -134,14 +295,108 @@ public:
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                           int start = 0, int end = 0);
 
+    //! Visit the entries of an address in key order, from height start up to height end if both are
+    //! > 0, resuming after pkeyAfter if given. The scan stops early when fn returns false.
+    bool ScanAddressIndex(const uint256 &addressHash, int type, int start, int end, const CAddressIndexKey *pkeyAfter,
+                          const std::function<bool(const CAddressIndexKey&, CAmount)> &fn);
+    //! Whether the address balances cover the whole index. They don't for an index built by an older version.
+    bool HasAddressBalances();
+    //! The running totals of an address, all zero if it has no entries
+    bool ReadAddressBalance(const uint256 &addressHash, int type, CAddressBalance &balance);
+    //! Visit the unspent outputs of an address in key order, resuming after pkeyAfter if given
+    bool ScanAddressUnspentIndex(const uint256 &addressHash, int type, const CAddressUnspentKey *pkeyAfter,
+                                 const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)> &fn);
+};
+
+/** Access to the spent index database, which is read by point lookups */
+class CSpentIndexDB final : public CIndexDB
+{
+public:
+    CSpentIndexDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    bool MoveFromBlockTree(CBlockTreeDB &blocktree) override;
+
+    bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
+    bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect);
+};
+
+/** An unspent output of the ghostnode collateral amount, null to erase it from the collateral index */
+struct CGhostnodeCollateral
+{
+    CScript scriptPubKey;
+    int nHeight;
+
+    CGhostnodeCollateral() : nHeight(0) {}
+    CGhostnodeCollateral(const CScript& scriptPubKeyIn, int nHeightIn) : scriptPubKey(scriptPubKeyIn), nHeight(nHeightIn) {}
+
+    bool IsNull() const { return scriptPubKey.empty(); }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(scriptPubKey);
+        READWRITE(nHeight);
+    }
+};
+
+/** Access to the ghostnode collateral index database */
+class CCollateralIndexDB final : public CIndexDB
+{
+public:
+    CCollateralIndexDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    bool MoveFromBlockTree(CBlockTreeDB &blocktree) override { return true; }
+
+    bool ReadCollateral(const COutPoint &outpoint, CGhostnodeCollateral &collateral);
+    //! All collaterals in outpoint order
+    bool ReadCollaterals(std::vector<std::pair<COutPoint, CGhostnodeCollateral> > &vect);
+    bool UpdateCollaterals(const std::vector<std::pair<COutPoint, CGhostnodeCollateral> > &vect);
+};
+
+/** The filter of a block with its hash and the filter header committing to the filters of its ancestors (BIP 157) */
+struct CBlockFilterEntry
+{
+    uint256 hash;
+    uint256 header;
+    std::vector<unsigned char> filter;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(hash);
+        READWRITE(header);
+        READWRITE(filter);
+    }
+};
+
+/** Access to the block filter index database. Entries are keyed by filter type and block hash, so
+ *  the filters of blocks on other branches stay correct until they are disconnected */
+class CBlockFilterIndexDB final : public CIndexDB
+{
+public:
+    CBlockFilterIndexDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    bool MoveFromBlockTree(CBlockTreeDB &blocktree) override { return true; }
+
+    bool ReadFilter(uint8_t filterType, const uint256 &blockHash, CBlockFilterEntry &entry);
+    bool WriteFilter(uint8_t filterType, const uint256 &blockHash, const CBlockFilterEntry &entry);
+    bool EraseFilter(uint8_t filterType, const uint256 &blockHash);
+};
+
+/** Access to the timestamp index database */
+class CTimestampIndexDB final : public CIndexDB
+{
+public:
+    CTimestampIndexDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    bool MoveFromBlockTree(CBlockTreeDB &blocktree) override;
+
     bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &vect);
     bool ReadTimestampBlockIndex(const uint256 &hash, unsigned int &ltimestamp);
     bool WriteTimestampBlockIndex(const CTimestampBlockIndexKey &blockhashIndex, const CTimestampBlockIndexValue &logicalts);
-
-    bool WriteFlag(const std::string &name, bool fValue);
-    bool ReadFlag(const std::string &name, bool &fValue);
-    bool LoadBlockIndexGuts(const Consensus::Params& consensusParams, std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
 };
 
 #endif // BITCOIN_TXDB_H
@@ -8,6 +8,7 @@
 #include <consensus/consensus.h>
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
+#include <metrics.h>
 #include <validation.h>
 #include <policy/policy.h>
 #include <policy/fees.h>
@@ -386,6 +387,9 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
     const CTransaction& tx = newit->GetTx();
     std::set<uint256> setParentTransactions;
     for (unsigned int i = 0; i < tx.vin.size(); i++) {
+        // Zerocoin spend inputs all have a null prevout, they conflict by coin serial instead, see mapZerocoinSerials
+        if (tx.vin[i].scriptSig.IsZerocoinSpend())
+            continue;
         mapNextTx.insert(std::make_pair(&tx.vin[i].prevout, &tx));
         setParentTransactions.insert(tx.vin[i].prevout.hash);
     }
@@ -408,10 +412,17 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
 
     nTransactionsUpdated++;
     totalTxSize += entry.GetTxSize();
-    if (minerPolicyEstimator) {minerPolicyEstimator->processTransaction(entry, validFeeEstimate);}
+    if (minerPolicyEstimator) {
+        CBlockPolicyEstimator* estimator = minerPolicyEstimator;
+        if (estimatorQueue)
+            UpdateEstimator([estimator, entry, validFeeEstimate] { estimator->processTransaction(entry, validFeeEstimate); });
+        else
+            estimator->processTransaction(entry, validFeeEstimate);
+    }
 
     vTxHashes.emplace_back(tx.GetWitnessHash(), newit);
     newit->vTxHashesIdx = vTxHashes.size() - 1;
+    UpdateMetrics();
 
     return true;
 }
@@ -421,7 +432,17 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
     NotifyEntryRemoved(it->GetSharedTx(), reason);
     const uint256 hash = it->GetTx().GetHash();
     for (const CTxIn& txin : it->GetTx().vin)
-        mapNextTx.erase(txin.prevout);
+        if (!txin.scriptSig.IsZerocoinSpend())
+            mapNextTx.erase(txin.prevout);
+
+    removeSpentIndex(hash);
+
+    zerocoinSerialMapInserted::iterator zit = mapZerocoinSerialsInserted.find(hash);
+    if (zit != mapZerocoinSerialsInserted.end()) {
+        for (const uint256& serialHash : zit->second)
+            mapZerocoinSerials.erase(serialHash);
+        mapZerocoinSerialsInserted.erase(zit);
+    }
 
     if (vTxHashes.size() > 1) {
         vTxHashes[it->vTxHashesIdx] = std::move(vTxHashes.back());
@@ -438,51 +459,84 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
     mapLinks.erase(it);
     mapTx.erase(it);
     nTransactionsUpdated++;
-    if (minerPolicyEstimator) {minerPolicyEstimator->removeTx(hash, false);}
+    if (minerPolicyEstimator) {
+        CBlockPolicyEstimator* estimator = minerPolicyEstimator;
+        if (estimatorQueue)
+            UpdateEstimator([estimator, hash] { estimator->removeTx(hash, false); });
+        else
+            estimator->removeTx(hash, false);
+    }
+    UpdateMetrics();
+}
+
+void CTxMemPool::SetEstimatorQueue(std::function<void(std::function<void()>)> queue)
+{
+    LOCK(cs);
+    estimatorQueue = std::move(queue);
+}
+
+void CTxMemPool::UpdateEstimator(std::function<void()> update)
+{
+    if (estimatorQueue)
+        estimatorQueue(std::move(update));
+    else
+        update();
+}
+
+void CTxMemPool::UpdateMetrics() const
+{
+    if (this != &mempool)
+        return;
+    MetricSet(Metric::MEMPOOL_TRANSACTIONS, mapTx.size());
+    MetricSet(Metric::MEMPOOL_BYTES, totalTxSize);
+    MetricSet(Metric::MEMPOOL_USAGE, DynamicMemoryUsage());
 }
 
 void CTxMemPool::addAddressIndex(const CTxMemPoolEntry &entry, const CCoinsViewCache &view)
 {
     LOCK(cs);
     const CTransaction& tx = entry.GetTx();
-    std::vector<CMempoolAddressDeltaKey> inserted;
+    const uint256 txhash = tx.GetHash();
+    std::vector<addressDeltaMap::value_type*> inserted;
+
+    auto insert = [&](int type, const uint256 &addressHash, unsigned int index, int spending, const CMempoolAddressDelta &delta) {
+        addressDeltaMap::value_type& address = *mapAddress.emplace(CMempoolAddressKey(type, addressHash), std::vector<CMempoolAddressEntry>()).first;
+        cachedAddressIndexUsage -= memusage::DynamicUsage(address.second);
+        address.second.emplace_back(txhash, index, spending, delta);
+        cachedAddressIndexUsage += memusage::DynamicUsage(address.second);
+        // A transaction usually pays and spends an address more than once, its entries are all removed in one go
+        if (std::find(inserted.begin(), inserted.end(), &address) == inserted.end())
+            inserted.push_back(&address);
+    };
 
-    uint256 txhash = tx.GetHash();
     for (unsigned int j = 0; j < tx.vin.size(); j++) {
         const CTxIn input = tx.vin[j];
         const Coin &prevout = view.AccessCoin(input.prevout);
         if (prevout.out.scriptPubKey.IsPayToScriptHash()) {
-            vector<unsigned char> hashBytes(prevout.out.scriptPubKey.begin()+2, prevout.out.scriptPubKey.begin()+22);
-            CMempoolAddressDeltaKey key(2, uint256(hashBytes), txhash, j, 1);
-            CMempoolAddressDelta delta(entry.GetTime(), prevout.out.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(make_pair(key, delta));
-            inserted.push_back(key);
+            const uint256 hashBytes(&prevout.out.scriptPubKey[2], 20);
+            insert(2, hashBytes, j, 1, CMempoolAddressDelta(entry.GetTime(), prevout.out.nValue * -1, input.prevout.hash, input.prevout.n));
         } else if (prevout.out.scriptPubKey.IsPayToPublicKeyHash()) {
-            vector<unsigned char> hashBytes(prevout.out.scriptPubKey.begin()+3, prevout.out.scriptPubKey.begin()+23);
-            CMempoolAddressDeltaKey key(1, uint256(hashBytes), txhash, j, 1);
-            CMempoolAddressDelta delta(entry.GetTime(), prevout.out.nValue * -1, input.prevout.hash, input.prevout.n);
-            mapAddress.insert(make_pair(key, delta));
-            inserted.push_back(key);
+            const uint256 hashBytes(&prevout.out.scriptPubKey[3], 20);
+            insert(1, hashBytes, j, 1, CMempoolAddressDelta(entry.GetTime(), prevout.out.nValue * -1, input.prevout.hash, input.prevout.n));
         }
     }
 
     for (unsigned int k = 0; k < tx.vout.size(); k++) {
         const CTxOut &out = tx.vout[k];
         if (out.scriptPubKey.IsPayToScriptHash()) {
-            vector<unsigned char> hashBytes(out.scriptPubKey.begin()+2, out.scriptPubKey.begin()+22);
-            CMempoolAddressDeltaKey key(2, uint256(hashBytes), txhash, k, 0);
-            mapAddress.insert(make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
+            const uint256 hashBytes(&out.scriptPubKey[2], 20);
+            insert(2, hashBytes, k, 0, CMempoolAddressDelta(entry.GetTime(), out.nValue));
         } else if (out.scriptPubKey.IsPayToPublicKeyHash()) {
-            vector<unsigned char> hashBytes(out.scriptPubKey.begin()+3, out.scriptPubKey.begin()+23);
-            std::pair<addressDeltaMap::iterator,bool> ret;
-            CMempoolAddressDeltaKey key(1, uint256(hashBytes), txhash, k, 0);
-            mapAddress.insert(make_pair(key, CMempoolAddressDelta(entry.GetTime(), out.nValue)));
-            inserted.push_back(key);
+            const uint256 hashBytes(&out.scriptPubKey[3], 20);
+            insert(1, hashBytes, k, 0, CMempoolAddressDelta(entry.GetTime(), out.nValue));
         }
     }
 
-    mapAddressInserted.insert(make_pair(txhash, inserted));
+    if (inserted.empty())
+        return;
+    inserted.shrink_to_fit();
+    cachedAddressIndexUsage += memusage::DynamicUsage(inserted);
+    mapAddressInserted.emplace(txhash, std::move(inserted));
 }
 
 bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint256, int> > &addresses,
@@ -490,11 +544,16 @@ bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint256, int> > &addresse
 {
     LOCK(cs);
     for (std::vector<std::pair<uint256, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        addressDeltaMap::iterator ait = mapAddress.lower_bound(CMempoolAddressDeltaKey((*it).second, (*it).first));
-        while (ait != mapAddress.end() && (*ait).first.addressBytes == (*it).first && (*ait).first.type == (*it).second) {
-            results.push_back(*ait);
-            ait++;
-        }
+        addressDeltaMap::const_iterator ait = mapAddress.find(CMempoolAddressKey((*it).second, (*it).first));
+        if (ait == mapAddress.end())
+            continue;
+        const size_t nFirst = results.size();
+        for (const CMempoolAddressEntry& e : ait->second)
+            results.emplace_back(CMempoolAddressDeltaKey((*it).second, (*it).first, e.txhash, e.index, e.spending), e.delta);
+        // Same order as the ordered map this index used to be
+        std::sort(results.begin() + nFirst, results.end(), [](const std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta>& a, const std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta>& b) {
+            return CMempoolAddressDeltaKeyCompare()(a.first, b.first);
+        });
     }
     return true;
 }
@@ -502,25 +561,59 @@ bool CTxMemPool::getAddressIndex(std::vector<std::pair<uint256, int> > &addresse
 bool CTxMemPool::removeAddressIndex(const uint256 txhash)
 {
     LOCK(cs);
-    addressDeltaMapInserted::iterator it = mapAddressInserted.find(txhash);
-
-    if (it != mapAddressInserted.end()) {
-        std::vector<CMempoolAddressDeltaKey> keys = (*it).second;
-        for (std::vector<CMempoolAddressDeltaKey>::iterator mit = keys.begin(); mit != keys.end(); mit++) {
-            mapAddress.erase(*mit);
-        }
-        mapAddressInserted.erase(it);
+    txiter it = mapTx.find(txhash);
+    if (it != mapTx.end()) {
+        setEntries stage;
+        stage.insert(it);
+        removeAddressIndex(stage);
     }
 
     return true;
 }
 
+void CTxMemPool::removeAddressIndex(const setEntries &stage)
+{
+    AssertLockHeld(cs);
+    if (mapAddressInserted.empty())
+        return;
+
+    std::set<uint256> setRemove;
+    std::vector<addressDeltaMap::value_type*> vAddresses;
+    for (const txiter& it : stage) {
+        addressDeltaMapInserted::iterator iit = mapAddressInserted.find(it->GetTx().GetHash());
+        if (iit == mapAddressInserted.end())
+            continue;
+        setRemove.insert(iit->first);
+        vAddresses.insert(vAddresses.end(), iit->second.begin(), iit->second.end());
+        cachedAddressIndexUsage -= memusage::DynamicUsage(iit->second);
+        mapAddressInserted.erase(iit);
+    }
+    std::sort(vAddresses.begin(), vAddresses.end());
+    vAddresses.erase(std::unique(vAddresses.begin(), vAddresses.end()), vAddresses.end());
+
+    // One pass over the entries of each address, however many of the transactions pay it
+    for (addressDeltaMap::value_type* address : vAddresses) {
+        std::vector<CMempoolAddressEntry>& entries = address->second;
+        cachedAddressIndexUsage -= memusage::DynamicUsage(entries);
+        entries.erase(std::remove_if(entries.begin(), entries.end(), [&setRemove](const CMempoolAddressEntry& e) {
+            return setRemove.count(e.txhash) != 0;
+        }), entries.end());
+        if (entries.empty()) {
+            const CMempoolAddressKey key = address->first;
+            mapAddress.erase(key);
+            continue;
+        }
+        if (entries.size() * 2 < entries.capacity())
+            entries.shrink_to_fit();
+        cachedAddressIndexUsage += memusage::DynamicUsage(entries);
+    }
+}
+
 void CTxMemPool::addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCache &view)
 {
     LOCK(cs);
 
     const CTransaction& tx = entry.GetTx();
-    std::vector<CSpentIndexKey> inserted;
 
     uint256 txhash = tx.GetHash();
     for (unsigned int j = 0; j < tx.vin.size(); j++) {
@@ -530,10 +623,10 @@ void CTxMemPool::addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCac
         int addressType;
 
         if (prevout.out.scriptPubKey.IsPayToScriptHash()) {
-            addressHash = uint256(vector<unsigned char> (prevout.out.scriptPubKey.begin()+2, prevout.out.scriptPubKey.begin()+22));
+            addressHash = uint256(&prevout.out.scriptPubKey[2], 20);
             addressType = 2;
         } else if (prevout.out.scriptPubKey.IsPayToPublicKeyHash()) {
-            addressHash = uint256(vector<unsigned char> (prevout.out.scriptPubKey.begin()+3, prevout.out.scriptPubKey.begin()+23));
+            addressHash = uint256(&prevout.out.scriptPubKey[3], 20);
             addressType = 1;
         } else {
             addressHash.SetNull();
@@ -544,11 +637,7 @@ void CTxMemPool::addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCac
         CSpentIndexValue value = CSpentIndexValue(txhash, j, -1, prevout.out.nValue, addressType, addressHash);
 
         mapSpent.insert(make_pair(key, value));
-        inserted.push_back(key);
-
     }
-
-    mapSpentInserted.insert(make_pair(txhash, inserted));
 }
 
 bool CTxMemPool::getSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
@@ -567,14 +656,17 @@ bool CTxMemPool::getSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
 bool CTxMemPool::removeSpentIndex(const uint256 txhash)
 {
     LOCK(cs);
-    mapSpentIndexInserted::iterator it = mapSpentInserted.find(txhash);
+    if (mapSpent.empty())
+        return true;
 
-    if (it != mapSpentInserted.end()) {
-        std::vector<CSpentIndexKey> keys = (*it).second;
-        for (std::vector<CSpentIndexKey>::iterator mit = keys.begin(); mit != keys.end(); mit++) {
-            mapSpent.erase(*mit);
+    txiter it = mapTx.find(txhash);
+    if (it != mapTx.end()) {
+        // The keys are the prevouts of the transaction, no need to keep a copy of them
+        for (const CTxIn& txin : it->GetTx().vin) {
+            mapSpentIndex::iterator sit = mapSpent.find(CSpentIndexKey(txin.prevout.hash, txin.prevout.n));
+            if (sit != mapSpent.end() && sit->second.txid == txhash)
+                mapSpent.erase(sit);
         }
-        mapSpentInserted.erase(it);
     }
 
     return true;
@@ -609,6 +701,46 @@ void CTxMemPool::CalculateDescendants(txiter entryit, setEntries &setDescendants
     }
 }
 
+void CTxMemPool::addZerocoinSerials(const uint256 &txhash, const std::vector<uint256> &vSerialHashes)
+{
+    LOCK(cs);
+    for (const uint256& serialHash : vSerialHashes)
+        mapZerocoinSerials.insert(std::make_pair(serialHash, txhash));
+    std::vector<uint256>& inserted = mapZerocoinSerialsInserted[txhash];
+    inserted.insert(inserted.end(), vSerialHashes.begin(), vSerialHashes.end());
+}
+
+bool CTxMemPool::getZerocoinSerialSpend(const uint256 &serialHash, uint256 &txhash) const
+{
+    LOCK(cs);
+    zerocoinSerialMap::const_iterator it = mapZerocoinSerials.find(serialHash);
+    if (it == mapZerocoinSerials.end())
+        return false;
+    txhash = it->second;
+    return true;
+}
+
+void CTxMemPool::removeZerocoinSerialConflicts(const std::vector<uint256> &vSerialHashes)
+{
+    LOCK(cs);
+    setEntries txToRemove;
+    for (const uint256& serialHash : vSerialHashes) {
+        zerocoinSerialMap::const_iterator it = mapZerocoinSerials.find(serialHash);
+        if (it == mapZerocoinSerials.end())
+            continue;
+        txiter txit = mapTx.find(it->second);
+        if (txit != mapTx.end()) {
+            ClearPrioritisation(it->second);
+            txToRemove.insert(txit);
+        }
+    }
+    setEntries setAllRemoves;
+    for (txiter it : txToRemove) {
+        CalculateDescendants(it, setAllRemoves);
+    }
+    RemoveStaged(setAllRemoves, false, MemPoolRemovalReason::CONFLICT);
+}
+
 void CTxMemPool::removeRecursive(const CTransaction &origTx, MemPoolRemovalReason reason)
 {
     // Remove transaction from memory pool
@@ -698,7 +830,7 @@ void CTxMemPool::removeConflicts(const CTransaction &tx)
 /**
  * Called when a block is connected. Removes from mempool and updates the miner fee estimator.
  */
-void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigned int nBlockHeight)
+void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigned int nBlockHeight, bool fUpdateEstimates)
 {
     LOCK(cs);
     std::vector<const CTxMemPoolEntry*> entries;
@@ -711,7 +843,34 @@ void CTxMemPool::removeForBlock(const std::vector<CTransactionRef>& vtx, unsigne
             entries.push_back(&*i);
     }
     // Before the txs in the new block have been removed from the mempool, update policy estimates
-    if (minerPolicyEstimator) {minerPolicyEstimator->processBlock(nBlockHeight, entries);}
+    if (minerPolicyEstimator) {
+        CBlockPolicyEstimator* estimator = minerPolicyEstimator;
+        if (!fUpdateEstimates) {
+            UpdateEstimator([estimator, nBlockHeight] { estimator->skipBlock(nBlockHeight); });
+        } else if (estimatorQueue) {
+            // The entries are gone by the time a queued update runs, it gets copies
+            std::shared_ptr<std::vector<CTxMemPoolEntry>> blockEntries = std::make_shared<std::vector<CTxMemPoolEntry>>();
+            blockEntries->reserve(entries.size());
+            for (const CTxMemPoolEntry* entry : entries)
+                blockEntries->push_back(*entry);
+            UpdateEstimator([estimator, nBlockHeight, blockEntries] {
+                std::vector<const CTxMemPoolEntry*> vEntries;
+                vEntries.reserve(blockEntries->size());
+                for (const CTxMemPoolEntry& entry : *blockEntries)
+                    vEntries.push_back(&entry);
+                estimator->processBlock(nBlockHeight, vEntries);
+            });
+        } else {
+            estimator->processBlock(nBlockHeight, entries);
+        }
+    }
+    // Unindex the addresses of the whole block at once rather than one transaction at a time
+    if (!mapAddressInserted.empty()) {
+        setEntries stage;
+        for (const CTxMemPoolEntry* entry : entries)
+            stage.insert(mapTx.iterator_to(*entry));
+        removeAddressIndex(stage);
+    }
     for (const auto& tx : vtx)
     {
         txiter it = mapTx.find(tx->GetHash());
@@ -732,12 +891,19 @@ void CTxMemPool::_clear()
     mapLinks.clear();
     mapTx.clear();
     mapNextTx.clear();
+    mapZerocoinSerials.clear();
+    mapZerocoinSerialsInserted.clear();
+    mapAddress.clear();
+    mapAddressInserted.clear();
+    cachedAddressIndexUsage = 0;
+    mapSpent.clear();
     totalTxSize = 0;
     cachedInnerUsage = 0;
     lastRollingFeeUpdate = GetTime();
     blockSinceLastRollingFeeBump = false;
     rollingMinimumFeeRate = 0;
     ++nTransactionsUpdated;
+    UpdateMetrics();
 }
 
 void CTxMemPool::clear()
@@ -787,6 +953,10 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
         int64_t parentSizes = 0;
         int64_t parentSigOpCost = 0;
         for (const CTxIn &txin : tx.vin) {
+            if (txin.scriptSig.IsZerocoinSpend()) {
+                i++;
+                continue;
+            }
             // Check that every mempool transaction's inputs refer to available coins, or other mempool tx's.
             indexed_transaction_set::const_iterator it2 = mapTx.find(txin.prevout.hash);
             if (it2 != mapTx.end()) {
@@ -872,6 +1042,9 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
         assert(it2 != mapTx.end());
         assert(&tx == it->second);
     }
+    for (auto it = mapZerocoinSerials.cbegin(); it != mapZerocoinSerials.cend(); it++) {
+        assert(mapTx.count(it->second));
+    }
 
     assert(totalTxSize == checkTotal);
     assert(innerUsage == cachedInnerUsage);
@@ -1046,12 +1219,13 @@ bool CCoinsViewMemPool::GetCoin(const COutPoint &outpoint, Coin &coin) const {
 size_t CTxMemPool::DynamicMemoryUsage() const {
     LOCK(cs);
     // Estimate the overhead of mapTx to be 12 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
-    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage;
+    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + memusage::DynamicUsage(vTxHashes) + memusage::DynamicUsage(mapZerocoinSerials) + memusage::DynamicUsage(mapZerocoinSerialsInserted) + memusage::DynamicUsage(mapAddress) + memusage::DynamicUsage(mapAddressInserted) + cachedAddressIndexUsage + memusage::DynamicUsage(mapSpent) + cachedInnerUsage;
 }
 
 void CTxMemPool::RemoveStaged(setEntries &stage, bool updateDescendants, MemPoolRemovalReason reason) {
     AssertLockHeld(cs);
     UpdateForRemoveFromMempool(stage, updateDescendants);
+    removeAddressIndex(stage);
     for (const txiter& it : stage) {
         removeUnchecked(it, reason);
     }
@@ -1059,7 +1233,10 @@ void CTxMemPool::RemoveStaged(setEntries &stage, bool updateDescendants, MemPool
 
 int CTxMemPool::Expire(int64_t time) {
     LOCK(cs);
+    // The entry time index has the oldest first, usually there's nothing to expire and that's all it takes to find out
     indexed_transaction_set::index<entry_time>::type::iterator it = mapTx.get<entry_time>().begin();
+    if (it == mapTx.get<entry_time>().end() || it->GetTime() >= time)
+        return 0;
     setEntries toremove;
     while (it != mapTx.get<entry_time>().end() && it->GetTime() < time) {
         toremove.insert(mapTx.project<0>(it));
@@ -1172,16 +1349,16 @@ void CTxMemPool::TrimToSize(size_t sizelimit, std::vector<COutPoint>* pvNoSpends
         CalculateDescendants(mapTx.project<0>(it), stage);
         nTxnRemoved += stage.size();
 
-        std::vector<CTransaction> txn;
+        std::vector<CTransactionRef> txn;
         if (pvNoSpendsRemaining) {
             txn.reserve(stage.size());
             for (txiter iter : stage)
-                txn.push_back(iter->GetTx());
+                txn.push_back(iter->GetSharedTx());
         }
         RemoveStaged(stage, false, MemPoolRemovalReason::SIZELIMIT);
         if (pvNoSpendsRemaining) {
-            for (const CTransaction& tx : txn) {
-                for (const CTxIn& txin : tx.vin) {
+            for (const CTransactionRef& tx : txn) {
+                for (const CTxIn& txin : tx->vin) {
                     if (exists(txin.prevout.hash)) continue;
                     pvNoSpendsRemaining->push_back(txin.prevout);
                 }
@@ -1202,3 +1379,7 @@ bool CTxMemPool::TransactionWithinChainLimit(const uint256& txid, size_t chainLi
 }
 
 SaltedTxidHasher::SaltedTxidHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+SaltedAddressHasher::SaltedAddressHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+SaltedSpentIndexHasher::SaltedSpentIndexHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
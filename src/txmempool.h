@@ -6,9 +6,11 @@
 #ifndef BITCOIN_TXMEMPOOL_H
 #define BITCOIN_TXMEMPOOL_H
 
+#include <functional>
 #include <memory>
 #include <set>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <utility>
 #include <string>
@@ -364,6 +366,34 @@ public:
     }
 };
 
+class SaltedAddressHasher
+{
+private:
+    /** Salt */
+    const uint64_t k0, k1;
+
+public:
+    SaltedAddressHasher();
+
+    size_t operator()(const CMempoolAddressKey& key) const {
+        return SipHashUint256Extra(k0, k1, key.hash, key.type);
+    }
+};
+
+class SaltedSpentIndexHasher
+{
+private:
+    /** Salt */
+    const uint64_t k0, k1;
+
+public:
+    SaltedSpentIndexHasher();
+
+    size_t operator()(const CSpentIndexKey& key) const {
+        return SipHashUint256Extra(k0, k1, key.txid, key.outputIndex);
+    }
+};
+
 /**
  * CTxMemPool stores valid-according-to-the-current-best-chain transactions
  * that may be included in the next block.
@@ -441,6 +471,7 @@ private:
     uint32_t nCheckFrequency; //!< Value n means that n times in 2^32 we check.
     unsigned int nTransactionsUpdated; //!< Used by getblocktemplate to trigger CreateNewBlock() invocation
     CBlockPolicyEstimator* minerPolicyEstimator;
+    std::function<void(std::function<void()>)> estimatorQueue; //!< Where fee estimator updates run, empty to run them right away
 
     uint64_t totalTxSize;      //!< sum of all mempool tx's virtual sizes. Differs from serialized tx size since witness data is discounted. Defined in BIP 141.
     uint64_t cachedInnerUsage; //!< sum of dynamic memory usage of all the map elements (NOT the maps themselves)
@@ -507,17 +538,27 @@ private:
     typedef std::map<txiter, TxLinks, CompareIteratorByHash> txlinksMap;
     txlinksMap mapLinks;
 
-    typedef std::map<CMempoolAddressDeltaKey, CMempoolAddressDelta, CMempoolAddressDeltaKeyCompare> addressDeltaMap;
+    /** The outputs and spent inputs of pool transactions by address, the address is only stored once */
+    typedef std::unordered_map<CMempoolAddressKey, std::vector<CMempoolAddressEntry>, SaltedAddressHasher> addressDeltaMap;
     addressDeltaMap mapAddress;
 
-    typedef std::map<uint256, std::vector<CMempoolAddressDeltaKey> > addressDeltaMapInserted;
+    /** The addresses each transaction has entries under, as pointers to their elements of mapAddress, which are stable */
+    typedef std::unordered_map<uint256, std::vector<addressDeltaMap::value_type*>, SaltedTxidHasher> addressDeltaMapInserted;
     addressDeltaMapInserted mapAddressInserted;
 
-    typedef std::map<CSpentIndexKey, CSpentIndexValue, CSpentIndexKeyCompare> mapSpentIndex;
+    /** Memory used by the vectors of mapAddress and mapAddressInserted */
+    uint64_t cachedAddressIndexUsage;
+
+    /** The spending input of every outpoint spent in the pool, removed again from the inputs of the spending transaction */
+    typedef std::unordered_map<CSpentIndexKey, CSpentIndexValue, SaltedSpentIndexHasher> mapSpentIndex;
     mapSpentIndex mapSpent;
 
-    typedef std::map<uint256, std::vector<CSpentIndexKey> > mapSpentIndexInserted;
-    mapSpentIndexInserted mapSpentInserted;
+    /** Hash of every coin serial spent by a zerocoin spend in the pool, and the spend */
+    typedef std::map<uint256, uint256> zerocoinSerialMap;
+    zerocoinSerialMap mapZerocoinSerials;
+
+    typedef std::map<uint256, std::vector<uint256> > zerocoinSerialMapInserted;
+    zerocoinSerialMapInserted mapZerocoinSerialsInserted;
 
     void UpdateParent(txiter entry, txiter parent, bool add);
     void UpdateChild(txiter entry, txiter child, bool add);
@@ -539,6 +580,10 @@ public:
      * check does nothing.
      */
     void check(const CCoinsViewCache *pcoins) const;
+
+    /** Hand the fee estimator updates to queue instead of running them while holding the pool's lock.
+     *  The updates are queued in the order the pool makes them, so queue has to run them in order */
+    void SetEstimatorQueue(std::function<void(std::function<void()>)> queue);
     void setSanityCheck(double dFrequency = 1.0) { nCheckFrequency = static_cast<uint32_t>(dFrequency * 4294967295.0); }
 
     // addUnchecked must updated state for all ancestors of a given transaction,
@@ -556,15 +601,26 @@ public:
     bool getAddressIndex(std::vector<std::pair<uint256, int> > &addresses,
                          std::vector<std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> > &results);
     bool removeAddressIndex(const uint256 txhash);
+    /** Unindex the address entries of all these transactions at once, visiting every address involved only once */
+    void removeAddressIndex(const setEntries &stage);
 
     void addSpentIndex(const CTxMemPoolEntry &entry, const CCoinsViewCache &view);
     bool getSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
     bool removeSpentIndex(const uint256 txhash);
 
+    /** Index the coin serials spent by a zerocoin spend in the pool, they are unindexed again when it is removed */
+    void addZerocoinSerials(const uint256 &txhash, const std::vector<uint256> &vSerialHashes);
+    /** Find the spend in the pool spending the coin serial with this hash */
+    bool getZerocoinSerialSpend(const uint256 &serialHash, uint256 &txhash) const;
+    /** Remove the spends in the pool, with their descendants, that spend any of these coin serials */
+    void removeZerocoinSerialConflicts(const std::vector<uint256> &vSerialHashes);
+
     void removeRecursive(const CTransaction &tx, MemPoolRemovalReason reason = MemPoolRemovalReason::UNKNOWN);
     void removeForReorg(const CCoinsViewCache *pcoins, unsigned int nMemPoolHeight, int flags);
     void removeConflicts(const CTransaction &tx);
-    void removeForBlock(const std::vector<CTransactionRef>& vtx, unsigned int nBlockHeight);
+    /** Remove the transactions of a block connected at nBlockHeight. Without fUpdateEstimates the fee
+     *  estimator only learns the new height, for blocks connected during initial block download */
+    void removeForBlock(const std::vector<CTransactionRef>& vtx, unsigned int nBlockHeight, bool fUpdateEstimates = true);
 
     void clear();
     void _clear(); //lock free
@@ -706,6 +762,10 @@ private:
      *  removal.
      */
     void removeUnchecked(txiter entry, MemPoolRemovalReason reason = MemPoolRemovalReason::UNKNOWN);
+    /** Run a fee estimator update, or queue it if SetEstimatorQueue was called */
+    void UpdateEstimator(std::function<void()> update);
+    /** Publish the size of the node's mempool to the metrics.h gauges, other pools are left out */
+    void UpdateMetrics() const;
 };
 
 /** 
@@ -112,6 +112,9 @@ public:
     /** Banlist did change. */
     boost::signals2::signal<void (void)> BannedListChanged;
 
+    /** Ghostnodes were added to or removed from the ghostnode list. */
+    boost::signals2::signal<void (void)> NotifyGhostnodeListChanged;
+
     /** Ghostnode sync data. */
     boost::signals2::signal<void (int count, double nSyncProgress)> NotifyAdditionalDataSyncProgressChanged;
 };
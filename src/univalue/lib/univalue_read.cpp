@@ -2,6 +2,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <stdint.h>
 #include <string.h>
 #include <vector>
 #include <stdio.h>
@@ -42,6 +43,36 @@ static const char *hatoui(const char *first, const char *last,
     return first;
 }
 
+// length of the leading run of chars a string token copies as they are: 7-bit
+// ASCII other than control chars, '"' and '\\'. Scans 8 bytes at a time.
+static size_t plainStringRun(const char *raw, const char *end)
+{
+    static const uint64_t ones = 0x0101010101010101ULL;
+    static const uint64_t highs = 0x8080808080808080ULL;
+
+    const char *first = raw;
+    while (end - raw >= 8) {
+        uint64_t w;
+        memcpy(&w, raw, 8);
+        uint64_t wQuote = w ^ (ones * '"');
+        uint64_t wEscape = w ^ (ones * '\\');
+        // a byte is flagged if its high bit is set, or it's below 0x20, or it's a quote or a backslash
+        uint64_t special = (w | ((w - ones * 0x20) & ~w)
+                            | ((wQuote - ones) & ~wQuote)
+                            | ((wEscape - ones) & ~wEscape)) & highs;
+        if (special)
+            break;
+        raw += 8;
+    }
+    while (raw < end) {
+        unsigned char ch = *raw;
+        if (ch < 0x20 || ch >= 0x80 || ch == '"' || ch == '\\')
+            break;
+        raw++;
+    }
+    return raw - first;
+}
+
 enum jtokentype getJsonToken(string& tokenVal, unsigned int& consumed,
                             const char *raw, const char *end)
 {
@@ -114,8 +145,6 @@ enum jtokentype getJsonToken(string& tokenVal, unsigned int& consumed,
     case '8':
     case '9': {
         // part 1: int
-        string numStr;
-
         const char *first = raw;
 
         const char *firstDigit = first;
@@ -124,49 +153,38 @@ enum jtokentype getJsonToken(string& tokenVal, unsigned int& consumed,
         if ((*firstDigit == '0') && json_isdigit(firstDigit[1]))
             return JTOK_ERR;
 
-        numStr += *raw;                       // copy first char
-        raw++;
+        raw++;                                // first char
 
         if ((*first == '-') && (raw < end) && (!json_isdigit(*raw)))
             return JTOK_ERR;
 
-        while (raw < end && json_isdigit(*raw)) {  // copy digits
-            numStr += *raw;
+        while (raw < end && json_isdigit(*raw))  // digits
             raw++;
-        }
 
         // part 2: frac
         if (raw < end && *raw == '.') {
-            numStr += *raw;                   // copy .
-            raw++;
+            raw++;                            // .
 
             if (raw >= end || !json_isdigit(*raw))
                 return JTOK_ERR;
-            while (raw < end && json_isdigit(*raw)) { // copy digits
-                numStr += *raw;
+            while (raw < end && json_isdigit(*raw)) // digits
                 raw++;
-            }
         }
 
         // part 3: exp
         if (raw < end && (*raw == 'e' || *raw == 'E')) {
-            numStr += *raw;                   // copy E
-            raw++;
+            raw++;                            // E
 
-            if (raw < end && (*raw == '-' || *raw == '+')) { // copy +/-
-                numStr += *raw;
+            if (raw < end && (*raw == '-' || *raw == '+')) // +/-
                 raw++;
-            }
 
             if (raw >= end || !json_isdigit(*raw))
                 return JTOK_ERR;
-            while (raw < end && json_isdigit(*raw)) { // copy digits
-                numStr += *raw;
+            while (raw < end && json_isdigit(*raw)) // digits
                 raw++;
-            }
         }
 
-        tokenVal = numStr;
+        tokenVal.assign(first, raw);          // copy the number at once
         consumed = (raw - rawStart);
         return JTOK_NUMBER;
         }
@@ -174,10 +192,15 @@ enum jtokentype getJsonToken(string& tokenVal, unsigned int& consumed,
     case '"': {
         raw++;                                // skip "
 
-        string valStr;
-        JSONUTF8StringFilter writer(valStr);
+        // the string is written into tokenVal directly, plain runs such as
+        // hex data are scanned a word at a time and copied at once
+        JSONUTF8StringFilter writer(tokenVal);
 
         while (true) {
+            size_t nPlain = plainStringRun(raw, end);
+            writer.append_ascii(raw, raw + nPlain);
+            raw += nPlain;
+
             if (raw >= end || (unsigned char)*raw < 0x20)
                 return JTOK_ERR;
 
@@ -228,7 +251,6 @@ enum jtokentype getJsonToken(string& tokenVal, unsigned int& consumed,
 
         if (!writer.finalize())
             return JTOK_ERR;
-        tokenVal = valStr;
         consumed = (raw - rawStart);
         return JTOK_STRING;
         }
@@ -317,9 +339,8 @@ bool UniValue::read(const char *raw, size_t size)
                     setArray();
                 stack.push_back(this);
             } else {
-                UniValue tmpVal(utyp);
                 UniValue *top = stack.back();
-                top->values.push_back(tmpVal);
+                top->values.emplace_back(utyp);
 
                 UniValue *newTop = &(top->values.back());
                 stack.push_back(newTop);
@@ -403,14 +424,16 @@ bool UniValue::read(const char *raw, size_t size)
             }
 
         case JTOK_NUMBER: {
-            UniValue tmpVal(VNUM, tokenVal);
+            // the token text is swapped into the value rather than copied
             if (!stack.size()) {
-                *this = tmpVal;
+                typ = VNUM;
+                val.swap(tokenVal);
                 break;
             }
 
             UniValue *top = stack.back();
-            top->values.push_back(tmpVal);
+            top->values.emplace_back(VNUM);
+            top->values.back().val.swap(tokenVal);
 
             setExpect(NOT_VALUE);
             break;
@@ -419,17 +442,19 @@ bool UniValue::read(const char *raw, size_t size)
         case JTOK_STRING: {
             if (expect(OBJ_NAME)) {
                 UniValue *top = stack.back();
-                top->keys.push_back(tokenVal);
+                top->keys.emplace_back();
+                top->keys.back().swap(tokenVal);
                 clearExpect(OBJ_NAME);
                 setExpect(COLON);
             } else {
-                UniValue tmpVal(VSTR, tokenVal);
                 if (!stack.size()) {
-                    *this = tmpVal;
+                    typ = VSTR;
+                    val.swap(tokenVal);
                     break;
                 }
                 UniValue *top = stack.back();
-                top->values.push_back(tmpVal);
+                top->values.emplace_back(VSTR);
+                top->values.back().val.swap(tokenVal);
             }
 
             setExpect(NOT_VALUE);
@@ -226,6 +226,12 @@ int CLedgerDevice::GetPubKey(const std::vector<uint32_t> &vPath, CPubKey &pk, st
 {
     if (vPath.size() < 1 || vPath.size() > MAX_BIP32_PATH)
         return errorN(1, sError, __func__, _("Path depth out of range.").c_str());
+    std::map<std::vector<uint32_t>, CPubKey>::const_iterator mi = mapPubKeyCache.find(vPath);
+    if (mi != mapPubKeyCache.end())
+    {
+        pk = mi->second;
+        return 0;
+    };
     size_t lenPath = vPath.size();
     if (0 != Open())
         return errorN(1, sError, __func__, "Failed to open device.");
@@ -260,6 +266,7 @@ int CLedgerDevice::GetPubKey(const std::vector<uint32_t> &vPath, CPubKey &pk, st
     if (lenPubkey == 65 && !pk.Compress())
         return errorN(1, sError, __func__, "Pubkey compression failed.");
 
+    mapPubKeyCache[vPath] = pk;
     return 0;
 };
 
@@ -267,6 +274,12 @@ int CLedgerDevice::GetXPub(const std::vector<uint32_t> &vPath, CExtPubKey &ekp,
 {
     if (vPath.size() < 1 || vPath.size() > MAX_BIP32_PATH)
         return errorN(1, sError, __func__, _("Path depth out of range.").c_str());
+    std::map<std::vector<uint32_t>, CExtPubKey>::const_iterator mi = mapXPubCache.find(vPath);
+    if (mi != mapXPubCache.end())
+    {
+        ekp = mi->second;
+        return 0;
+    };
     size_t lenPath = vPath.size();
     if (0 != Open())
         return errorN(1, sError, __func__, "Failed to open device.");
@@ -287,8 +300,11 @@ int CLedgerDevice::GetXPub(const std::vector<uint32_t> &vPath, CExtPubKey &ekp,
     int sw;
     int result = sendApduHidHidapi(handle, 1, in, apduSize, out, sizeof(out), &sw);
 
-    // Get fingerprint
-    if (sw == SW_OK && lenPath > 1 && result > 65)
+    // Get fingerprint, unless the parent key was read before
+    std::vector<uint32_t> vPathParent(vPath.begin(), vPath.end() - 1);
+    std::map<std::vector<uint32_t>, CPubKey>::const_iterator miParent = mapPubKeyCache.find(vPathParent);
+    bool fHaveParent = miParent != mapPubKeyCache.end();
+    if (sw == SW_OK && lenPath > 1 && result > 65 && !fHaveParent)
     {
         size_t lenPathParent = lenPath-1;
         in[4] = 1 + 4 * lenPathParent; // num bytes to follow
@@ -324,18 +340,28 @@ int CLedgerDevice::GetXPub(const std::vector<uint32_t> &vPath, CExtPubKey &ekp,
     // Set fingerprint
     if (lenPath > 1)
     {
-        size_t ofs = 0;
-        size_t lenPubkey = outB[ofs++];
-        if (lenPubkey != 33 && lenPubkey != 65)
-            return errorN(1, sError, __func__, "Bad pubkey size: %d", lenPubkey);
-        CPubKey pkParent(&outB[ofs], &outB[ofs+lenPubkey]);
-
-        if (lenPubkey == 65 && !pkParent.Compress())
-            return errorN(1, sError, __func__, "Pubkey compression failed.");
+        CPubKey pkParent;
+        if (fHaveParent)
+        {
+            pkParent = miParent->second;
+        } else
+        {
+            size_t ofs = 0;
+            size_t lenPubkey = outB[ofs++];
+            if (lenPubkey != 33 && lenPubkey != 65)
+                return errorN(1, sError, __func__, "Bad pubkey size: %d", lenPubkey);
+            pkParent.Set(&outB[ofs], &outB[ofs+lenPubkey]);
+
+            if (lenPubkey == 65 && !pkParent.Compress())
+                return errorN(1, sError, __func__, "Pubkey compression failed.");
+            mapPubKeyCache[vPathParent] = pkParent;
+        };
         CKeyID id = pkParent.GetID();
         memcpy(&ekp.vchFingerprint[0], &id, 4);
     };
 
+    mapPubKeyCache[vPath] = ekp.pubkey;
+    mapXPubCache[vPath] = ekp;
     return 0;
 };
 
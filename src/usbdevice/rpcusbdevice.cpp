@@ -501,6 +501,28 @@ UniValue devicesignrawtransaction(const JSONRPCRequest &request)
     };
 
 
+    // Queue what we can sign, then have the device make all the signatures in one go
+    pDevice->ClearQueuedSignatures();
+    for (unsigned int i = 0; i < mtx.vin.size(); i++) {
+        const Coin& coin = view.AccessCoin(mtx.vin[i].prevout);
+        if (coin.IsSpent() || coin.nType != OUTPUT_STANDARD)
+            continue;
+        if (fHashSingle && i >= mtx.GetNumVOuts())
+            continue;
+
+        std::vector<uint8_t> vchAmount(8);
+        SignatureData sigdata;
+        memcpy(&vchAmount[0], &coin.out.nValue, 8);
+        ProduceSignature(DeviceSignatureCreator(pDevice, &keystore, &txConst, i, vchAmount, nHashType, true), coin.out.scriptPubKey, sigdata);
+    }
+    pDevice->sError.clear();
+    if (0 != pDevice->SignQueuedTransaction(&txConst, pDevice->sError))
+    {
+        UniValue entry(UniValue::VOBJ);
+        entry.push_back(Pair("error", pDevice->sError));
+        vErrors.push_back(entry);
+    };
+
     // Sign what we can:
     for (unsigned int i = 0; i < mtx.vin.size(); i++) {
         CTxIn& txin = mtx.vin[i];
@@ -34,6 +34,40 @@ int CUSBDevice::GetInfo(UniValue &info, std::string &sError)
     return 0;
 };
 
+void CUSBDevice::QueueSignature(const QueuedSignature &qs)
+{
+    for (const auto &q : vQueuedSignatures)
+        if (q.nIn == qs.nIn && q.vPath == qs.vPath && q.scriptCode == qs.scriptCode)
+            return;
+    vQueuedSignatures.push_back(qs);
+};
+
+int CUSBDevice::SignQueuedTransaction(const CTransaction *tx, std::string &sError)
+{
+    for (auto &qs : vQueuedSignatures)
+    {
+        if (qs.fSigned)
+            continue;
+        if (0 != SignTransaction(qs.vPath, qs.vSharedSecret, tx, qs.nIn, qs.scriptCode, qs.hashType, qs.amount, qs.sigversion, qs.vchSig, sError))
+            return 1;
+        qs.fSigned = true;
+    };
+    return 0;
+};
+
+bool CUSBDevice::GetQueuedSignature(int nIn, const std::vector<uint32_t> &vPath, const CScript &scriptCode, std::vector<uint8_t> &vchSig) const
+{
+    for (const auto &qs : vQueuedSignatures)
+    {
+        if (qs.nIn != nIn || qs.vPath != vPath || qs.scriptCode != scriptCode)
+            continue;
+        if (!qs.fSigned)
+            return false;
+        vchSig = qs.vchSig;
+        return true;
+    };
+    return false;
+};
 
 void ListDevices(std::vector<std::unique_ptr<CUSBDevice> > &vDevices)
 {
@@ -93,18 +127,13 @@ CUSBDevice *SelectDevice(std::vector<std::unique_ptr<CUSBDevice> > &vDevices, st
 };
 
 DeviceSignatureCreator::DeviceSignatureCreator(CUSBDevice *pDeviceIn, const CKeyStore *keystoreIn, const CTransaction *txToIn,
-    unsigned int nInIn, const std::vector<uint8_t> &amountIn, int nHashTypeIn)
-    : BaseSignatureCreator(keystoreIn), txTo(txToIn), nIn(nInIn), nHashType(nHashTypeIn), amount(amountIn), checker(txTo, nIn, amountIn), pDevice(pDeviceIn)
+    unsigned int nInIn, const std::vector<uint8_t> &amountIn, int nHashTypeIn, bool fQueueIn)
+    : BaseSignatureCreator(keystoreIn), txTo(txToIn), nIn(nInIn), nHashType(nHashTypeIn), amount(amountIn), checker(txTo, nIn, amountIn), pDevice(pDeviceIn), fQueue(fQueueIn)
 {
 };
 
-bool DeviceSignatureCreator::CreateSig(std::vector<unsigned char> &vchSig, const CKeyID &keyid, const CScript &scriptCode, SigVersion sigversion) const
+bool DeviceSignatureCreator::GetKeyPath(const CKeyID &keyid, std::vector<uint32_t> &vPath, std::vector<uint8_t> &vSharedSecret) const
 {
-    if (!pDevice)
-        return false;
-
-    //uint256 hash = SignatureHash(scriptCode, *txTo, nIn, nHashType, amount, sigversion);
-
     const CHDWallet *pw = dynamic_cast<const CHDWallet*>(keystore);
     if (pw)
     {
@@ -114,8 +143,6 @@ bool DeviceSignatureCreator::CreateSig(std::vector<unsigned char> &vchSig, const
         if (!pw->HaveKey(keyid, pak, pasc, pa) || !pa)
             return false;
 
-        std::vector<uint32_t> vPath;
-        std::vector<uint8_t> vSharedSecret;
         if (pak)
         {
             if (!pw->GetFullChainPath(pa, pak->nParent, vPath))
@@ -138,8 +165,6 @@ bool DeviceSignatureCreator::CreateSig(std::vector<unsigned char> &vchSig, const
         {
             return error("%s: HaveKey error.", __func__);
         };
-        if (0 != pDevice->SignTransaction(vPath, vSharedSecret, txTo, nIn, scriptCode, nHashType, amount, sigversion, vchSig, pDevice->sError))
-                return error("%s: SignTransaction faile.", __func__);
         return true;
     };
 
@@ -150,13 +175,47 @@ bool DeviceSignatureCreator::CreateSig(std::vector<unsigned char> &vchSig, const
         if (!pks->GetKey(keyid, pathkey))
             return false;
 
-        std::vector<uint8_t> vSharedSecret;
-        if (0 != pDevice->SignTransaction(pathkey.vPath, vSharedSecret, txTo, nIn, scriptCode, nHashType, amount, sigversion, vchSig, pDevice->sError))
-            return error("%s: SignTransaction failed.", __func__);
+        vPath = pathkey.vPath;
         return true;
     };
 
     return false;
 };
 
+bool DeviceSignatureCreator::CreateSig(std::vector<unsigned char> &vchSig, const CKeyID &keyid, const CScript &scriptCode, SigVersion sigversion) const
+{
+    if (!pDevice)
+        return false;
+
+    //uint256 hash = SignatureHash(scriptCode, *txTo, nIn, nHashType, amount, sigversion);
+
+    std::vector<uint32_t> vPath;
+    std::vector<uint8_t> vSharedSecret;
+    if (!GetKeyPath(keyid, vPath, vSharedSecret))
+        return false;
 
+    if (fQueue)
+    {
+        pDevice->QueueSignature(QueuedSignature(nIn, vPath, vSharedSecret, scriptCode, nHashType, amount, sigversion));
+
+        // Stand in for the signature until the device made it
+        vchSig.assign(72, '\000');
+        vchSig[0] = 0x30;
+        vchSig[1] = 69;
+        vchSig[2] = 0x02;
+        vchSig[3] = 33;
+        vchSig[4] = 0x01;
+        vchSig[4 + 33] = 0x02;
+        vchSig[5 + 33] = 32;
+        vchSig[6 + 33] = 0x01;
+        vchSig[6 + 33 + 32] = nHashType;
+        return true;
+    };
+
+    if (pDevice->GetQueuedSignature(nIn, vPath, scriptCode, vchSig))
+        return true;
+
+    if (0 != pDevice->SignTransaction(vPath, vSharedSecret, txTo, nIn, scriptCode, nHashType, amount, sigversion, vchSig, pDevice->sError))
+        return error("%s: SignTransaction failed.", __func__);
+    return true;
+};
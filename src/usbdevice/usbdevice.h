@@ -13,6 +13,7 @@
 #include <key/extkey.h>
 #include <script/sign.h>
 #include <keystore.h>
+#include <map>
 #include <memory>
 
 enum DeviceTypeID {
@@ -88,6 +89,28 @@ public:
 
 extern const DeviceType usbDeviceTypes[];
 
+/** A signature requested from a device, to be made along with the others of the transaction */
+class QueuedSignature
+{
+public:
+    QueuedSignature(int nIn_, const std::vector<uint32_t> &vPath_, const std::vector<uint8_t> &vSharedSecret_,
+        const CScript &scriptCode_, int hashType_, const std::vector<uint8_t> &amount_, SigVersion sigversion_)
+        : nIn(nIn_), vPath(vPath_), vSharedSecret(vSharedSecret_),
+          scriptCode(scriptCode_), hashType(hashType_), amount(amount_), sigversion(sigversion_)
+        {};
+
+    int nIn;
+    std::vector<uint32_t> vPath;
+    std::vector<uint8_t> vSharedSecret;
+    CScript scriptCode;
+    int hashType;
+    std::vector<uint8_t> amount;
+    SigVersion sigversion;
+
+    bool fSigned = false;
+    std::vector<uint8_t> vchSig;
+};
+
 class CUSBDevice
 {
 public:
@@ -121,6 +144,14 @@ public:
         int nIn, const CScript &scriptCode, int hashType, const std::vector<uint8_t> &amount, SigVersion sigversion,
         std::vector<uint8_t> &vchSig, std::string &sError) { return 0; };
 
+    /** Queue a signature to be made by SignQueuedTransaction */
+    void QueueSignature(const QueuedSignature &qs);
+    /** Make every queued signature of tx in one session with the device, after PrepareTransaction */
+    virtual int SignQueuedTransaction(const CTransaction *tx, std::string &sError);
+    /** Signature made by SignQueuedTransaction for input nIn, with the key at vPath */
+    bool GetQueuedSignature(int nIn, const std::vector<uint32_t> &vPath, const CScript &scriptCode, std::vector<uint8_t> &vchSig) const;
+    void ClearQueuedSignatures() { vQueuedSignatures.clear(); };
+
 
     const DeviceType *pType = nullptr;
     char cPath[128];
@@ -130,19 +161,22 @@ public:
 
 protected:
     hid_device *handle = nullptr;
+
+    std::vector<QueuedSignature> vQueuedSignatures;
+
+    // Public keys read from the device, by path, a device only ever derives the same key at a path
+    std::map<std::vector<uint32_t>, CPubKey> mapPubKeyCache;
+    std::map<std::vector<uint32_t>, CExtPubKey> mapXPubCache;
 };
 
 void ListDevices(std::vector<std::unique_ptr<CUSBDevice> > &vDevices);
 CUSBDevice *SelectDevice(std::vector<std::unique_ptr<CUSBDevice> > &vDevices, std::string &sError);
 
-/*
-class QueuedSignature
-{
-public:
-
-};
-*/
-/** A signature creator for transactions. */
+/**
+ * A signature creator for transactions.
+ * With fQueue set the signatures are only queued on the device and dummy ones returned, once the
+ * device made them all with SignQueuedTransaction the queued signatures are returned instead.
+ */
 class DeviceSignatureCreator : public BaseSignatureCreator {
     const CTransaction* txTo;
     unsigned int nIn;
@@ -150,10 +184,12 @@ class DeviceSignatureCreator : public BaseSignatureCreator {
     std::vector<uint8_t> amount;
     const TransactionSignatureChecker checker;
     CUSBDevice *pDevice;
+    bool fQueue;
 
+    bool GetKeyPath(const CKeyID &keyid, std::vector<uint32_t> &vPath, std::vector<uint8_t> &vSharedSecret) const;
 
 public:
-    DeviceSignatureCreator(CUSBDevice *pDeviceIn, const CKeyStore *keystoreIn, const CTransaction *txToIn, unsigned int nInIn, const std::vector<uint8_t> &amountIn, int nHashTypeIn=SIGHASH_ALL);
+    DeviceSignatureCreator(CUSBDevice *pDeviceIn, const CKeyStore *keystoreIn, const CTransaction *txToIn, unsigned int nInIn, const std::vector<uint8_t> &amountIn, int nHashTypeIn=SIGHASH_ALL, bool fQueueIn=false);
     const BaseSignatureChecker &Checker() const { return checker; }
 
     bool IsParticlVersion() const { return txTo && txTo->IsParticlVersion(); }
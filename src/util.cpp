@@ -70,6 +70,10 @@
 #include <malloc.h>
 #endif
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include <boost/algorithm/string/case_conv.hpp> // for to_lower()
 #include <boost/algorithm/string/predicate.hpp> // for startswith() and endswith()
 #include <boost/interprocess/sync/file_lock.hpp>
@@ -104,6 +108,7 @@ CTranslationInterface translationInterface;
 
 /** Log categories bitfield. */
 std::atomic<uint32_t> logCategories(0);
+std::atomic<uint32_t> nLogRateLimit(DEFAULT_LOGRATE);
 
 /** Init OpenSSL library multithreading support */
 static std::unique_ptr<CCriticalSection[]> ppmutexOpenSSL;
@@ -215,6 +220,23 @@ static FILE* fileout = nullptr;
 static boost::mutex* mutexDebugLog = nullptr;
 static std::list<std::string>* vMsgsBeforeOpenLog;
 
+/**
+ * With -asynclog the debug.log writes happen in a background thread: LogPrintStr
+ * appends the timestamped message to vLogQueue and the writer takes the whole
+ * queue at once, writing it with a single fwrite. Loggers only wait when more
+ * than MAX_LOG_QUEUE_BYTES are queued. threadLogWriter is leaked like fileout
+ * when the writer is not stopped.
+ */
+static const size_t MAX_LOG_QUEUE_BYTES = 8 << 20;
+static std::mutex cs_logQueue;
+static std::condition_variable condLogQueue;
+static std::condition_variable condLogSpace;
+static std::vector<std::string> vLogQueue;
+static size_t nLogQueueBytes = 0;
+static bool fLogWriterRunning = false;
+static bool fLogWriterStop = false;
+static std::thread* threadLogWriter = nullptr;
+
 static int FileWriteStr(const std::string &str, FILE *fp)
 {
     return fwrite(str.data(), 1, str.size(), fp);
@@ -294,6 +316,9 @@ const CLogCategoryDesc LogCategories[] =
     {BCLog::COINDB, "coindb"},
     {BCLog::QT, "qt"},
     {BCLog::LEVELDB, "leveldb"},
+    {BCLog::SMSG, "smsg"},
+    {BCLog::ZEROCOIN, "zerocoin"},
+    {BCLog::GHOSTNODE, "ghostnode"},
     {BCLog::ALL, "1"},
     {BCLog::ALL, "all"},
 };
@@ -345,6 +370,43 @@ std::vector<CLogCategoryActive> ListActiveLogCategories()
     return ret;
 }
 
+/** Messages of a log category in the current second of -lograte */
+struct CLogRateWindow
+{
+    std::atomic<int64_t> nSecond{0};
+    std::atomic<uint32_t> nCount{0};
+    std::atomic<uint32_t> nSuppressed{0};
+};
+
+static CLogRateWindow logRateWindows[32];
+
+bool LogAcceptRateSlow(uint32_t category)
+{
+    // A message of several categories counts against the lowest one
+    int nBit = 0;
+    while (nBit < 31 && !(category & (1U << nBit)))
+        nBit++;
+    CLogRateWindow& window = logRateWindows[nBit];
+
+    int64_t nSecond = GetTimeMillis() / 1000;
+    int64_t nWindowSecond = window.nSecond.load();
+    if (nWindowSecond != nSecond && window.nSecond.compare_exchange_strong(nWindowSecond, nSecond)) {
+        window.nCount = 0;
+        uint32_t nSuppressed = window.nSuppressed.exchange(0);
+        if (nSuppressed > 0) {
+            std::string strCategory = strprintf("0x%08x", 1U << nBit);
+            for (unsigned int i = 0; i < ARRAYLEN(LogCategories); i++) {
+                if (LogCategories[i].flag == (1U << nBit)) strCategory = LogCategories[i].category;
+            }
+            LogPrintf("Suppressed %u %s log messages over the -lograte limit\n", nSuppressed, strCategory);
+        }
+    }
+    if (window.nCount.fetch_add(1) < nLogRateLimit.load(std::memory_order_relaxed))
+        return true;
+    window.nSuppressed++;
+    return false;
+}
+
 /**
  * fStartedNewLine is a state variable held by the calling context that will
  * suppress printing of the timestamp when multiple calls are made that don't
@@ -378,6 +440,17 @@ static std::string LogTimestampStr(const std::string &str, std::atomic_bool *fSt
     return strStamped;
 }
 
+/** Reopen the log file, if requested. Must be called with mutexDebugLog held. */
+static void ReopenDebugLogIfRequested()
+{
+    if (fReopenDebugLog) {
+        fReopenDebugLog = false;
+        fs::path pathDebug = GetDebugLogPath();
+        if (fsbridge::freopen(pathDebug,"a",fileout) != nullptr)
+            setbuf(fileout, nullptr); // unbuffered
+    }
+}
+
 int LogPrintStr(const std::string &str)
 {
     int ret = 0; // Returns total number of characters written
@@ -393,6 +466,19 @@ int LogPrintStr(const std::string &str)
     }
     else if (fPrintToDebugLog)
     {
+        {
+            std::unique_lock<std::mutex> lock(cs_logQueue);
+            if (fLogWriterRunning) {
+                condLogSpace.wait(lock, [] { return nLogQueueBytes < MAX_LOG_QUEUE_BYTES; });
+                ret = strTimestamped.size();
+                nLogQueueBytes += ret;
+                vLogQueue.push_back(std::move(strTimestamped));
+                lock.unlock();
+                condLogQueue.notify_one();
+                return ret;
+            }
+        }
+
         boost::call_once(&DebugPrintInit, debugPrintInitFlag);
         boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
 
@@ -404,20 +490,85 @@ int LogPrintStr(const std::string &str)
         }
         else
         {
-            // reopen the log file, if requested
-            if (fReopenDebugLog) {
-                fReopenDebugLog = false;
-                fs::path pathDebug = GetDebugLogPath();
-                if (fsbridge::freopen(pathDebug,"a",fileout) != nullptr)
-                    setbuf(fileout, nullptr); // unbuffered
-            }
-
+            ReopenDebugLogIfRequested();
             ret = FileWriteStr(strTimestamped, fileout);
         }
     }
     return ret;
 }
 
+static void DebugLogWriterThread()
+{
+    RenameThread("nix-logwriter");
+    std::vector<std::string> vBatch;
+    std::string strBatch;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(cs_logQueue);
+            condLogQueue.wait(lock, [] { return !vLogQueue.empty() || fLogWriterStop; });
+            if (vLogQueue.empty())
+                break;
+            vBatch.swap(vLogQueue);
+            nLogQueueBytes = 0;
+        }
+        condLogSpace.notify_all();
+
+        strBatch.clear();
+        for (const std::string& strMsg : vBatch)
+            strBatch += strMsg;
+        vBatch.clear();
+
+        boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+        ReopenDebugLogIfRequested();
+        FileWriteStr(strBatch, fileout);
+    }
+}
+
+void StartDebugLogWriter()
+{
+    boost::call_once(&DebugPrintInit, debugPrintInitFlag);
+    {
+        boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+        if (fileout == nullptr)
+            return;
+    }
+
+    std::lock_guard<std::mutex> lock(cs_logQueue);
+    if (fLogWriterRunning)
+        return;
+    fLogWriterStop = false;
+    threadLogWriter = new std::thread(&DebugLogWriterThread);
+    fLogWriterRunning = true;
+}
+
+void StopDebugLogWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(cs_logQueue);
+        if (!fLogWriterRunning)
+            return;
+        fLogWriterStop = true;
+    }
+    condLogQueue.notify_one();
+    threadLogWriter->join();
+    delete threadLogWriter;
+    threadLogWriter = nullptr;
+
+    // Messages queued after the writer left are written here, later ones directly
+    std::vector<std::string> vRest;
+    {
+        std::lock_guard<std::mutex> lock(cs_logQueue);
+        fLogWriterRunning = false;
+        vRest.swap(vLogQueue);
+        nLogQueueBytes = 0;
+    }
+    condLogSpace.notify_all();
+
+    boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+    for (const std::string& strMsg : vRest)
+        FileWriteStr(strMsg, fileout);
+}
+
 /** A map that contains all the currently held directory locks. After
  * successful locking, these will be held here until the global destructor
  * cleans them up and thus automatically unlocks them, or ReleaseDirectoryLocks
@@ -868,6 +1019,16 @@ void AllocateFileRange(FILE *file, unsigned int offset, unsigned int length) {
 #endif
 }
 
+/**
+ * Tell the OS that a file is about to be read from start to end, so it reads ahead more
+ * aggressively. Advisory only, a no-op where not supported.
+ */
+void AdviseSequentialRead(FILE *file) {
+#if defined(POSIX_FADV_SEQUENTIAL)
+    posix_fadvise(fileno(file), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
 void ShrinkDebugFile()
 {
     // Amount of debug.log to save at end when shrinking (must fit in memory)
@@ -36,6 +36,8 @@ int64_t GetStartupTime();
 static const bool DEFAULT_LOGTIMEMICROS = false;
 static const bool DEFAULT_LOGIPS        = false;
 static const bool DEFAULT_LOGTIMESTAMPS = true;
+static const bool DEFAULT_ASYNCLOG      = true;
+static const unsigned int DEFAULT_LOGRATE = 0;
 extern const char * const DEFAULT_DEBUGLOGFILE;
 
 /** Signals for translation. */
@@ -64,6 +66,8 @@ extern const char * const BITCOIN_CONF_FILENAME;
 extern const char * const BITCOIN_PID_FILENAME;
 
 extern std::atomic<uint32_t> logCategories;
+/** Messages per second written for each log category, 0 for no limit (-lograte) */
+extern std::atomic<uint32_t> nLogRateLimit;
 
 /**
  * Translation function: Call Translate signal on UI interface, which returns a boost::optional result.
@@ -109,6 +113,8 @@ namespace BCLog {
         QT          = (1 << 19),
         LEVELDB     = (1 << 20),
         SMSG        = (1 << 21),
+        ZEROCOIN    = (1 << 22),
+        GHOSTNODE   = (1 << 23),
         HDWALLET    = (1 << 30),
         ALL         = ~(uint32_t)0,
     };
@@ -118,6 +124,12 @@ static inline bool LogAcceptCategory(uint32_t category)
 {
     return (logCategories.load(std::memory_order_relaxed) & category) != 0;
 }
+/** Count a message of the category against -lograte, false if it is over the limit */
+bool LogAcceptRateSlow(uint32_t category);
+static inline bool LogAcceptRate(uint32_t category)
+{
+    return nLogRateLimit.load(std::memory_order_relaxed) == 0 || LogAcceptRateSlow(category);
+}
 const boost::filesystem::path &GetBackupsDir();
 boost::filesystem::path GetGhostnodeConfigFile();
 
@@ -133,6 +145,11 @@ bool GetLogCategory(uint32_t *f, const std::string *str);
 /** Send a string to the log output */
 int LogPrintStr(const std::string &str);
 
+/** Hand the debug.log writes to a background thread, LogPrintStr only queues them (-asynclog) */
+void StartDebugLogWriter();
+/** Write the queued messages and stop the background thread, later messages are written directly */
+void StopDebugLogWriter();
+
 /** Get format string from VA_ARGS for error reporting */
 template<typename... Args> std::string FormatStringFromLogArgs(const char *fmt, const Args&... args) { return fmt; }
 
@@ -163,7 +180,7 @@ template<typename T, typename... Args> static inline void MarkUsed(const T& t, c
 } while(0)
 
 #define LogPrint(category, ...) do { \
-    if (LogAcceptCategory((category))) { \
+    if (LogAcceptCategory((category)) && LogAcceptRate((category))) { \
         LogPrintf(__VA_ARGS__); \
     } \
 } while(0)
@@ -196,6 +213,7 @@ void FileCommit(FILE *file);
 bool TruncateFile(FILE *file, unsigned int length);
 int RaiseFileDescriptorLimit(int nMinFD);
 void AllocateFileRange(FILE *file, unsigned int offset, unsigned int length);
+void AdviseSequentialRead(FILE *file);
 bool RenameOver(fs::path src, fs::path dest);
 bool LockDirectory(const fs::path& directory, const std::string lockfile_name, bool probe_only=false);
 
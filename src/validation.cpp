@@ -6,6 +6,8 @@
 #include <validation.h>
 
 #include <arith_uint256.h>
+#include <blockcompression.h>
+#include <blockconnectstats.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
@@ -16,7 +18,11 @@
 #include <consensus/validation.h>
 #include <cuckoocache.h>
 #include <hash.h>
+#include <index/insightindex.h>
+#include <core_memusage.h>
 #include <init.h>
+#include <memusage.h>
+#include <metrics.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <policy/rbf.h>
@@ -40,7 +46,9 @@
 #include <validationinterface.h>
 #include <warnings.h>
 #include <coins.h>
+#include <libzerocoin/ParallelTasks.h>
 #include <future>
+#include <list>
 #include <sstream>
 
 #include <boost/algorithm/string/replace.hpp>
@@ -85,7 +93,6 @@ CAmount GetGhostnodePayment(int nHeight, CAmount blockValue) {
 }
 
 int GetInputAge(const CTxIn &txin) {
-    LogPrintf("\n GETINPUT \n");
     CCoinsView viewDummy;
     CCoinsViewCache view(&viewDummy);
     {
@@ -99,7 +106,6 @@ int GetInputAge(const CTxIn &txin) {
 }
 
 int GetUTXOHeight(const COutPoint &outpoint) {
-        LogPrintf("\n GETUTXO \n");
     LOCK(cs_main);
     Coin coin;
     if (!pcoinsTip->GetCoin(outpoint, coin) ||
@@ -154,7 +160,6 @@ void ReprocessBlocks(int nBlocks) {
 
 bool GetUTXOCoin(const COutPoint& outpoint, Coin& coin)
 {
-        LogPrintf("\n GETUTXOCOIN \n");
     LOCK(cs_main);
     if (!pcoinsTip->GetCoin(outpoint, coin))
         return false;
@@ -312,13 +317,46 @@ CCriticalSection cs_main;
 
 BlockMap& mapBlockIndex = g_chainstate.mapBlockIndex;
 CChain& chainActive = g_chainstate.chainActive;
+
+static CCriticalSection cs_chainSnapshot;
+static std::shared_ptr<const CChainSnapshot> pChainSnapshot = std::make_shared<const CChainSnapshot>();
+
+const CBlockIndex* CChainSnapshot::operator[](int nHeightIn) const
+{
+    if (!pindexTip || nHeightIn < 0 || nHeightIn > nHeight)
+        return nullptr;
+    return pindexTip->GetAncestor(nHeightIn);
+}
+
+bool CChainSnapshot::Contains(const CBlockIndex* pindex) const
+{
+    return pindex && (*this)[pindex->nHeight] == pindex;
+}
+
+std::shared_ptr<const CChainSnapshot> GetChainSnapshot()
+{
+    LOCK(cs_chainSnapshot);
+    return pChainSnapshot;
+}
+
+/** Publish the tip of chainActive to GetChainSnapshot, after it changed */
+static void UpdateChainSnapshot()
+{
+    std::shared_ptr<CChainSnapshot> snapshot = std::make_shared<CChainSnapshot>();
+    snapshot->pindexTip = chainActive.Tip();
+    snapshot->nHeight = chainActive.Height();
+    LOCK(cs_chainSnapshot);
+    pChainSnapshot = std::move(snapshot);
+}
 CBlockIndex *pindexBestHeader = nullptr;
 CWaitableCriticalSection csBestBlock;
 CConditionVariable cvBlockChange;
 int nScriptCheckThreads = 0;
 std::atomic_bool fImporting(false);
 std::atomic_bool fReindex(false);
+bool fReindexChainStateFast = false;
 bool fTxIndex = false;
+bool fCompressBlocks = DEFAULT_COMPRESS_BLOCKS;
 bool fHavePruned = false;
 bool fPruneMode = false;
 bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
@@ -329,9 +367,12 @@ size_t nCoinCacheUsage = 5000 * 300;
 uint64_t nPruneTarget = 0;
 int64_t nMaxTipAge = DEFAULT_MAX_TIP_AGE;
 bool fEnableReplacement = DEFAULT_ENABLE_REPLACEMENT;
+bool fFastBlockRelay = DEFAULT_FASTBLOCKRELAY;
 bool fAddressIndex = false;
 bool fSpentIndex = false;
 bool fTimestampIndex = false;
+bool fCollateralIndex = false;
+bool fBlockFilterIndex = false;
 
 uint256 hashAssumeValid;
 arith_uint256 nMinimumChainWork;
@@ -368,6 +409,9 @@ namespace {
     /** Dirty block index entries. */
     std::set<CBlockIndex*> setDirtyBlockIndex;
 
+    /** Block index entries whose zerocoin data changed, it is written apart from the entry. */
+    std::set<CBlockIndex*> setDirtyBlockZerocoin;
+
     /** Dirty block file entries. */
     std::set<int> setDirtyFileInfo;
 } // anon namespace
@@ -393,6 +437,7 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 std::unique_ptr<CCoinsViewDB> pcoinsdbview;
 std::unique_ptr<CCoinsViewCache> pcoinsTip;
 std::unique_ptr<CBlockTreeDB> pblocktree;
+std::unique_ptr<CZerocoinDB> pzerocoindb;
 
 enum FlushStateMode {
     FLUSH_STATE_NONE,
@@ -539,8 +584,12 @@ static void LimitMempoolSize(CTxMemPool& pool, size_t limit, unsigned long age)
         LogPrint(BCLog::MEMPOOL, "Expired %i transactions from the memory pool\n", expired);
     }
 
+    // Trimming to just under the limit would have a full pool trimmed again for about every transaction it
+    // accepts, with the large zerocoin spends especially
+    if (pool.DynamicMemoryUsage() <= limit)
+        return;
     std::vector<COutPoint> vNoSpendsRemaining;
-    pool.TrimToSize(limit, &vNoSpendsRemaining);
+    pool.TrimToSize(limit - limit / 100 * MEMPOOL_TRIM_HYSTERESIS_PERCENT, &vNoSpendsRemaining);
     for (const COutPoint& removed : vNoSpendsRemaining)
         pcoinsTip->Uncache(removed);
 }
@@ -656,10 +705,11 @@ static bool CheckInputsFromMempoolAndCache(const CTransaction& tx, CValidationSt
 
 static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool& pool, CValidationState& state, const CTransactionRef& ptx,
                               bool* pfMissingInputs, int64_t nAcceptTime, std::list<CTransactionRef>* plTxnReplaced,
-                              bool bypass_limits, const CAmount& nAbsurdFee, std::vector<COutPoint>& coins_to_uncache)
+                              bool bypass_limits, const CAmount& nAbsurdFee, std::vector<COutPoint>& coins_to_uncache,
+                              std::vector<CZerocoinSpendCheck>* pvZerocoinChecks = nullptr)
 {
     const CTransaction& tx = *ptx;
-    LogPrintf("AcceptToMemoryPoolWorker(), tx.IsZerocoinSpend()=%s \n", tx.IsZerocoinSpend());
+    LogPrint(BCLog::MEMPOOL, "AcceptToMemoryPoolWorker(), tx.IsZerocoinSpend()=%s\n", tx.IsZerocoinSpend());
     const uint256 hash = tx.GetHash();
     AssertLockHeld(cs_main);
     LOCK(pool.cs); // mempool "read lock" (held through GetMainSignals().TransactionAddedToMempool())
@@ -667,7 +717,27 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
         *pfMissingInputs = false;
     }
 
-    if (!CheckTransaction(tx, state, hash, false))
+    // Look the coin serials of a zerocoin spend up in the pool before its proofs are verified, a spend
+    // replaying a serial the pool already has a spend for is rejected for the cost of deserializing it
+    std::vector<uint256> vZerocoinSerials;
+    if (tx.IsZerocoinSpend()) {
+        if (!GetZerocoinSpendSerialHashes(tx, vZerocoinSerials))
+            return state.DoS(100, false, REJECT_MALFORMED, "bad-zerocoin-spend");
+        std::set<uint256> setSerials;
+        for (const uint256 &serialHash : vZerocoinSerials) {
+            if (!setSerials.insert(serialHash).second)
+                return state.DoS(100, false, REJECT_INVALID, "bad-zerocoin-spend-duplicate-serial");
+            uint256 hashSpend;
+            if (pool.getZerocoinSerialSpend(serialHash, hashSpend)) {
+                if (hashSpend == hash)
+                    return state.Invalid(false, REJECT_DUPLICATE, "txn-already-in-mempool");
+                // Spends can't signal BIP 125 replacement, nSequence holds the coin group id: first seen wins
+                return state.Invalid(false, REJECT_DUPLICATE, "txn-mempool-conflict");
+            }
+        }
+    }
+
+    if (!CheckTransaction(tx, state, hash, false, true, INT_MAX, false, NULL, pvZerocoinChecks))
         return false; // state filled in by CheckTransaction
 
     // Coinbase is only valid in a block, not as a loose transaction
@@ -754,7 +824,7 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
             }
             i++;
             if (!view.HaveCoin(txin.prevout)) {
-                LogPrintf("\n Input %d, outpoint %s", i, txin.prevout.ToString());
+                LogPrint(BCLog::MEMPOOL, "AcceptToMemoryPoolWorker: missing input %d, outpoint %s\n", i, txin.prevout.ToString());
                 // Are inputs missing because we already have the tx?
                 for (size_t out = 0; out < tx.vout.size(); out++) {
                     // Optimistically just do efficient check of cache for outputs
@@ -1003,7 +1073,7 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
 
             // Check against previous transactions
             // This is done last to help prevent CPU exhaustion denial-of-service attacks.
-            PrecomputedTransactionData txdata(tx);
+            PrecomputedTransactionData txdata;
             if (!CheckInputs(tx, state, view, true, scriptVerifyFlags, true, false, txdata)) {
                 // SCRIPT_VERIFY_CLEANSTACK requires SCRIPT_VERIFY_WITNESS, so we
                 // need to turn both off, and compare against just turning off CLEANSTACK
@@ -1094,6 +1164,10 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
             }
         }
         else{
+            // Spend proofs are still to be verified, see PreCheckZerocoinSpendForMemoryPool
+            if (pvZerocoinChecks)
+                return true;
+
             LockPoints lp;
             double fSpendsCoinbase = false;
             CAmount nFees = 0;
@@ -1111,6 +1185,7 @@ static bool AcceptToMemoryPoolWorker(const CChainParams& chainparams, CTxMemPool
 
 
             pool.addUnchecked(hash, entry, setAncestors, validForFeeEstimation);
+            pool.addZerocoinSerials(hash, vZerocoinSerials);
         }
     }
 
@@ -1136,6 +1211,82 @@ static bool AcceptToMemoryPoolWithTime(const CChainParams& chainparams, CTxMemPo
     return res;
 }
 
+bool PreCheckZerocoinSpendForMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransactionRef &tx,
+                                        std::vector<CZerocoinSpendCheck> &vChecks)
+{
+    assert(tx->IsZerocoinSpend());
+    std::vector<COutPoint> coins_to_uncache;
+    bool res = AcceptToMemoryPoolWorker(Params(), pool, state, tx, nullptr, GetTime(), nullptr, false, 0, coins_to_uncache, &vChecks);
+    for (const COutPoint& hashTx : coins_to_uncache)
+        pcoinsTip->Uncache(hashTx);
+    if (!res)
+        return false;
+    for (CZerocoinSpendCheck &check : vChecks)
+        check.CopyAccumulators();
+    return true;
+}
+
+void PreCheckTransactionScriptsForMemoryPool(CTxMemPool& pool, const CTransactionRef &ptx)
+{
+    const CTransaction& tx = *ptx;
+    if (tx.IsCoinBase() || tx.IsZerocoinSpend())
+        return;
+
+    // Only the spent outputs are taken under the locks, the scripts run without them
+    std::vector<CTxOut> vSpent;
+    unsigned int scriptVerifyFlags = STANDARD_SCRIPT_VERIFY_FLAGS;
+    {
+        LOCK2(cs_main, pool.cs);
+        if (pool.exists(tx.GetHash()))
+            return;
+
+        if (!Params().RequireStandard()) {
+            scriptVerifyFlags = gArgs.GetArg("-promiscuousmempoolflags", scriptVerifyFlags);
+        }
+
+        CCoinsViewMemPool viewMemPool(pcoinsTip.get(), pool);
+        std::vector<COutPoint> coins_to_uncache;
+        vSpent.reserve(tx.vin.size());
+        for (const CTxIn& txin : tx.vin) {
+            if (!pcoinsTip->HaveCoinInCache(txin.prevout))
+                coins_to_uncache.push_back(txin.prevout);
+            Coin coin;
+            if (!viewMemPool.GetCoin(txin.prevout, coin) || coin.IsSpent())
+                break;
+            vSpent.push_back(coin.out);
+        }
+        for (const COutPoint& outpoint : coins_to_uncache)
+            pcoinsTip->Uncache(outpoint);
+    }
+
+    // Orphans and transactions that can't pay for themselves are left to AcceptToMemoryPool to turn down
+    if (vSpent.size() != tx.vin.size())
+        return;
+    CAmount nValueIn = 0;
+    for (const CTxOut& txout : vSpent) {
+        nValueIn += txout.nValue;
+        if (!MoneyRange(txout.nValue) || !MoneyRange(nValueIn))
+            return;
+    }
+    CAmount nValueOut = 0;
+    for (const CTxOut& txout : tx.vout) {
+        nValueOut += txout.nValue;
+        if (!MoneyRange(txout.nValue) || !MoneyRange(nValueOut))
+            return;
+    }
+    if (nValueIn < nValueOut)
+        return;
+
+    // The signature cache has its own lock, the checks AcceptToMemoryPool runs later under cs_main find the
+    // signatures there and skip the ECDSA verification. Stop at the first failure, the transaction is rejected anyway
+    PrecomputedTransactionData txdata(tx);
+    for (unsigned int i = 0; i < tx.vin.size(); i++) {
+        CScriptCheck check(vSpent[i], tx, i, scriptVerifyFlags, true, &txdata);
+        if (!check())
+            return;
+    }
+}
+
 bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransactionRef &tx,
                         bool* pfMissingInputs, std::list<CTransactionRef>* plTxnReplaced,
                         bool bypass_limits, const CAmount nAbsurdFee)
@@ -1144,12 +1295,92 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
     return AcceptToMemoryPoolWithTime(chainparams, pool, state, tx, pfMissingInputs, GetTime(), plTxnReplaced, bypass_limits, nAbsurdFee);
 }
 
+unsigned int AcceptPackageToMemoryPool(CTxMemPool& pool, const std::vector<CTransactionRef>& vPackage,
+                                       std::vector<CPackageTxResult>& vResults, std::list<CTransactionRef>* plTxnReplaced)
+{
+    AssertLockHeld(cs_main);
+    const CChainParams& chainparams = Params();
+    vResults.assign(vPackage.size(), CPackageTxResult());
+
+    std::map<uint256, size_t> mapIndex;
+    for (size_t i = 0; i < vPackage.size(); i++) {
+        if (!mapIndex.emplace(vPackage[i]->GetHash(), i).second)
+            vResults[i].state.Invalid(false, REJECT_DUPLICATE, "txn-already-in-package");
+    }
+
+    // Depth of every transaction in the package, a transaction can't spend one of its descendants so this ends
+    std::vector<size_t> vDepth(vPackage.size(), 0);
+    bool fChanged = true;
+    for (size_t nPass = 0; fChanged && nPass <= vPackage.size(); nPass++) {
+        fChanged = false;
+        for (size_t i = 0; i < vPackage.size(); i++) {
+            for (const CTxIn& txin : vPackage[i]->vin) {
+                auto it = mapIndex.find(txin.prevout.hash);
+                if (it != mapIndex.end() && vDepth[i] <= vDepth[it->second]) {
+                    vDepth[i] = vDepth[it->second] + 1;
+                    fChanged = true;
+                }
+            }
+        }
+    }
+    std::vector<size_t> vOrder(vPackage.size());
+    for (size_t i = 0; i < vOrder.size(); i++)
+        vOrder[i] = i;
+    std::stable_sort(vOrder.begin(), vOrder.end(), [&vDepth](size_t a, size_t b) { return vDepth[a] < vDepth[b]; });
+
+    unsigned int nAccepted = 0;
+    const int64_t nAcceptTime = GetTime();
+    {
+        LOCK(pool.cs);
+        for (size_t i : vOrder) {
+            const CTransactionRef& ptx = vPackage[i];
+            CPackageTxResult& result = vResults[i];
+            if (!result.state.IsValid())
+                continue;
+            if (ptx->IsZerocoinSpend()) {
+                result.state.Invalid(false, REJECT_NONSTANDARD, "package-zerocoin-spend");
+                continue;
+            }
+
+            bool fParentRejected = false;
+            for (const CTxIn& txin : ptx->vin) {
+                auto it = mapIndex.find(txin.prevout.hash);
+                if (it != mapIndex.end() && !vResults[it->second].fAccepted && !pool.exists(txin.prevout.hash)) {
+                    fParentRejected = true;
+                    break;
+                }
+            }
+            if (fParentRejected) {
+                result.fMissingInputs = true;
+                continue;
+            }
+
+            std::vector<COutPoint> coins_to_uncache;
+            result.fAccepted = AcceptToMemoryPoolWorker(chainparams, pool, result.state, ptx, &result.fMissingInputs, nAcceptTime, plTxnReplaced, false /* bypass_limits */, 0 /* nAbsurdFee */, coins_to_uncache);
+            if (result.fAccepted) {
+                nAccepted++;
+            } else {
+                for (const COutPoint& hashTx : coins_to_uncache)
+                    pcoinsTip->Uncache(hashTx);
+            }
+        }
+    }
+
+    // Once for the whole package rather than after every transaction
+    CValidationState stateDummy;
+    FlushStateToDisk(chainparams, stateDummy, FLUSH_STATE_PERIODIC);
+    return nAccepted;
+}
+
 bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes)
 {
     if (!fTimestampIndex)
         return error("Timestamp index not enabled");
 
-    if (!pblocktree->ReadTimestampIndex(high, low, hashes))
+    if (!g_timestampindex->BlockUntilSyncedToCurrentChain())
+        return error("Timestamp index is still being built");
+
+    if (!g_timestampindex->GetBlockHashes(high, low, hashes))
         return error("Unable to get hashes for timestamps");
 
     return true;
@@ -1164,7 +1395,10 @@ bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
     if (mempool.getSpentIndex(key, value))
         return true;
 
-    if (!pblocktree->ReadSpentIndex(key, value))
+    if (!g_spentindex->IsSynced())
+        return false;
+
+    if (!g_spentindex->GetDB().ReadSpentIndex(key, value))
         return false;
 
     return true;
@@ -1176,7 +1410,10 @@ bool GetAddressIndex(uint256 addressHash, int type,
     if (!fAddressIndex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end))
+    if (!g_addressindex->BlockUntilSyncedToCurrentChain())
+        return error("address index is still being built");
+
+    if (!g_addressindex->GetDB().ReadAddressIndex(addressHash, type, addressIndex, start, end))
         return error("unable to get txids for address");
 
     return true;
@@ -1188,12 +1425,193 @@ bool GetAddressUnspent(uint256 addressHash, int type,
     if (!fAddressIndex)
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs))
+    if (!g_addressindex->BlockUntilSyncedToCurrentChain())
+        return error("address index is still being built");
+
+    if (!g_addressindex->GetDB().ReadAddressUnspentIndex(addressHash, type, unspentOutputs))
+        return error("unable to get txids for address");
+
+    return true;
+}
+
+bool ScanAddressIndex(const uint256 &addressHash, int type, int start, int end, const CAddressIndexKey *pkeyAfter,
+                      const std::function<bool(const CAddressIndexKey&, CAmount)> &fn)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!g_addressindex->BlockUntilSyncedToCurrentChain())
+        return error("address index is still being built");
+
+    if (!g_addressindex->GetDB().ScanAddressIndex(addressHash, type, start, end, pkeyAfter, fn))
+        return error("unable to get txids for address");
+
+    return true;
+}
+
+bool GetAddressBalance(const uint256 &addressHash, int type, CAddressBalance &balance)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!g_addressindex->BlockUntilSyncedToCurrentChain())
+        return error("address index is still being built");
+
+    if (!g_addressindex->GetDB().HasAddressBalances())
+        return false;
+
+    return g_addressindex->GetDB().ReadAddressBalance(addressHash, type, balance);
+}
+
+bool ScanAddressUnspent(const uint256 &addressHash, int type, const CAddressUnspentKey *pkeyAfter,
+                        const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)> &fn)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!g_addressindex->BlockUntilSyncedToCurrentChain())
+        return error("address index is still being built");
+
+    if (!g_addressindex->GetDB().ScanAddressUnspentIndex(addressHash, type, pkeyAfter, fn))
         return error("unable to get txids for address");
 
     return true;
 }
 
+/**
+ * Read the header in front of the block or undo record at pos from filein, opened at pos.nPos - 8.
+ * A compressed record is then read and decompressed into stream and true returned, otherwise filein
+ * is left at the start of the record.
+ */
+static bool ReadCompressedRecord(CAutoFile& filein, CDataStream& stream, size_t nMaxSize)
+{
+    CMessageHeader::MessageStartChars start;
+    unsigned int nSize;
+    filein >> FLATDATA(start) >> nSize;
+    if (!IsCompressedMessageStart(start, Params().MessageStart()))
+        return false;
+    if (nSize > nMaxSize)
+        throw std::ios_base::failure("ReadCompressedRecord(): record too large");
+    std::vector<char> frame(nSize);
+    filein.read(frame.data(), nSize);
+    DecompressFrame(frame.data(), nSize, stream, nMaxSize);
+    return true;
+}
+
+/** Serialize obj into a compressed frame if -compressblocks is set and it shrinks, leave frame empty otherwise */
+template <typename T>
+static void CompressRecord(const T& obj, std::vector<char>& frame)
+{
+    frame.clear();
+    if (!fCompressBlocks)
+        return;
+    CDataStream stream(SER_DISK, CLIENT_VERSION);
+    stream << obj;
+    CompressFrame(stream.data(), stream.size(), frame);
+}
+
+namespace {
+/**
+ * Confirmed transactions recently read from disk by GetTransaction, with the hash of their block, so
+ * that explorers and wallets asking for the same transactions through the RPC and REST interfaces
+ * don't read and deserialize them again. The least recently used are evicted once the entries
+ * outgrow -maxtxlookupcachesize, and the transactions of a disconnected block are dropped.
+ * Guarded by cs_main, which GetTransaction and DisconnectTip hold.
+ */
+class CTxLookupCache
+{
+private:
+    typedef std::list<std::pair<CTransactionRef, uint256>> list_type;
+    //! most recently used first
+    list_type listTxs;
+    std::unordered_map<uint256, list_type::iterator, SaltedTxidHasher> mapTxs;
+    size_t nUsage = 0;
+    size_t nMaxUsage = DEFAULT_MAX_TX_LOOKUP_CACHE_SIZE << 20;
+
+    static size_t EntryUsage(const CTransactionRef& tx)
+    {
+        return RecursiveDynamicUsage(tx) + memusage::MallocUsage(sizeof(memusage::stl_list_node<list_type::value_type>)) +
+            memusage::MallocUsage(sizeof(memusage::unordered_node<std::pair<const uint256, list_type::iterator>>));
+    }
+
+    void Erase(std::unordered_map<uint256, list_type::iterator, SaltedTxidHasher>::iterator it)
+    {
+        nUsage -= EntryUsage(it->second->first);
+        listTxs.erase(it->second);
+        mapTxs.erase(it);
+    }
+
+public:
+    bool Get(const uint256& hash, CTransactionRef& txOut, uint256& hashBlock)
+    {
+        AssertLockHeld(cs_main);
+        auto it = mapTxs.find(hash);
+        if (it == mapTxs.end())
+            return false;
+        listTxs.splice(listTxs.begin(), listTxs, it->second);
+        txOut = it->second->first;
+        hashBlock = it->second->second;
+        return true;
+    }
+
+    void Add(const CTransactionRef& tx, const uint256& hashBlock)
+    {
+        AssertLockHeld(cs_main);
+        if (nMaxUsage == 0 || mapTxs.count(tx->GetHash()))
+            return;
+        size_t nEntryUsage = EntryUsage(tx);
+        if (nEntryUsage > nMaxUsage)
+            return;
+        while (nUsage + nEntryUsage > nMaxUsage)
+            Erase(mapTxs.find(listTxs.back().first->GetHash()));
+        listTxs.emplace_front(tx, hashBlock);
+        mapTxs.emplace(tx->GetHash(), listTxs.begin());
+        nUsage += nEntryUsage;
+    }
+
+    //! Drop the transactions of a block leaving the active chain
+    void BlockDisconnected(const CBlock& block)
+    {
+        AssertLockHeld(cs_main);
+        for (const CTransactionRef& tx : block.vtx) {
+            auto it = mapTxs.find(tx->GetHash());
+            if (it != mapTxs.end())
+                Erase(it);
+        }
+    }
+
+    void SetMaxUsage(size_t nMaxUsageIn)
+    {
+        AssertLockHeld(cs_main);
+        nMaxUsage = nMaxUsageIn;
+        while (nUsage > nMaxUsage)
+            Erase(mapTxs.find(listTxs.back().first->GetHash()));
+    }
+
+    size_t DynamicMemoryUsage() const
+    {
+        AssertLockHeld(cs_main);
+        return nUsage + memusage::MallocUsage(mapTxs.bucket_count() * sizeof(void*));
+    }
+};
+
+static CTxLookupCache txLookupCache;
+} // namespace
+
+void InitTxLookupCache()
+{
+    size_t nMaxCacheSize = std::min(std::max((int64_t)0, gArgs.GetArg("-maxtxlookupcachesize", DEFAULT_MAX_TX_LOOKUP_CACHE_SIZE)), MAX_MAX_TX_LOOKUP_CACHE_SIZE) * ((size_t) 1 << 20);
+    LOCK(cs_main);
+    txLookupCache.SetMaxUsage(nMaxCacheSize);
+    LogPrintf("Using %zu MiB for the transaction lookup cache\n", nMaxCacheSize >> 20);
+}
+
+size_t TxLookupCacheDynamicMemoryUsage()
+{
+    LOCK(cs_main);
+    return txLookupCache.DynamicMemoryUsage();
+}
+
 /**
  * Return transaction in txOut, and if it was found inside a block, its hash is placed in hashBlock.
  * If blockIndex is provided, the transaction is fetched from the corresponding block.
@@ -1211,23 +1629,36 @@ bool GetTransaction(const uint256& hash, CTransactionRef& txOut, const Consensus
             return true;
         }
 
+        if (txLookupCache.Get(hash, txOut, hashBlock))
+            return true;
+
         if (fTxIndex) {
             CDiskTxPos postx;
             if (pblocktree->ReadTxIndex(hash, postx)) {
-                CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
+                if (postx.nPos < 8)
+                    return error("%s: Invalid block position %s", __func__, postx.ToString());
+                CAutoFile file(OpenBlockFile(CDiskBlockPos(postx.nFile, postx.nPos - 8), true), SER_DISK, CLIENT_VERSION);
                 if (file.IsNull())
                     return error("%s: OpenBlockFile failed", __func__);
                 CBlockHeader header;
                 try {
-                    file >> header;
-                    fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                    file >> txOut;
+                    CDataStream stream(SER_DISK, CLIENT_VERSION);
+                    if (ReadCompressedRecord(file, stream, MAX_BLOCK_SERIALIZED_SIZE)) {
+                        stream >> header;
+                        stream.ignore(postx.nTxOffset);
+                        stream >> txOut;
+                    } else {
+                        file >> header;
+                        fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
+                        file >> txOut;
+                    }
                 } catch (const std::exception& e) {
                     return error("%s: Deserialize or I/O error - %s", __func__, e.what());
                 }
                 hashBlock = header.GetHash();
                 if (txOut->GetHash() != hash)
                     return error("%s: txid mismatch", __func__);
+                txLookupCache.Add(txOut, hashBlock);
                 return true;
             }
 
@@ -1242,12 +1673,26 @@ bool GetTransaction(const uint256& hash, CTransactionRef& txOut, const Consensus
     }
 
     if (pindexSlow) {
+        // a block given by the caller may be off the active chain, the cache only answers for the active chain
+        bool fActive = chainActive.Contains(pindexSlow);
+        if (fActive) {
+            CTransactionRef ptx;
+            uint256 hashCachedBlock;
+            if (txLookupCache.Get(hash, ptx, hashCachedBlock) && hashCachedBlock == pindexSlow->GetBlockHash()) {
+                txOut = ptx;
+                hashBlock = hashCachedBlock;
+                return true;
+            }
+        }
+
         CBlock block;
         if (ReadBlockFromDisk(block, pindexSlow, consensusParams)) {
             for (const auto& tx : block.vtx) {
                 if (tx->GetHash() == hash) {
                     txOut = tx;
                     hashBlock = pindexSlow->GetBlockHash();
+                    if (fActive)
+                        txLookupCache.Add(txOut, hashBlock);
                     return true;
                 }
             }
@@ -1267,7 +1712,8 @@ bool GetTransaction(const uint256& hash, CTransactionRef& txOut, const Consensus
 // CBlock and CBlockIndex
 //
 
-static bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
+/** Write block to disk, as the compressed frame instead if frame is not empty */
+static bool WriteBlockToDisk(const CBlock& block, const std::vector<char>& frame, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
 {
     // Open history file to append
     CAutoFile fileout(OpenBlockFile(pos), SER_DISK, CLIENT_VERSION);
@@ -1275,15 +1721,24 @@ static bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMes
         return error("WriteBlockToDisk: OpenBlockFile failed");
 
     // Write index header
-    unsigned int nSize = GetSerializeSize(fileout, block);
-    fileout << FLATDATA(messageStart) << nSize;
+    if (frame.empty()) {
+        unsigned int nSize = GetSerializeSize(fileout, block);
+        fileout << FLATDATA(messageStart) << nSize;
+    } else {
+        CMessageHeader::MessageStartChars compressedStart;
+        GetCompressedMessageStart(messageStart, compressedStart);
+        fileout << FLATDATA(compressedStart) << (unsigned int)frame.size();
+    }
 
     // Write block
     long fileOutPos = ftell(fileout.Get());
     if (fileOutPos < 0)
         return error("WriteBlockToDisk: ftell failed");
     pos.nPos = (unsigned int)fileOutPos;
-    fileout << block;
+    if (frame.empty())
+        fileout << block;
+    else
+        fileout.write(frame.data(), frame.size());
 
     return true;
 }
@@ -1292,21 +1747,27 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, int nHeight, con
 {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+    // Open history file to read, at the header in front of the block
+    if (pos.nPos < 8)
+        return error("ReadBlockFromDisk: Invalid block position %s", pos.ToString());
+    CAutoFile filein(OpenBlockFile(CDiskBlockPos(pos.nFile, pos.nPos - 8), true), SER_DISK, CLIENT_VERSION);
     if (filein.IsNull())
         return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
 
     // Read block
     try {
-        filein >> block;
+        CDataStream stream(SER_DISK, CLIENT_VERSION);
+        if (ReadCompressedRecord(filein, stream, MAX_BLOCK_SERIALIZED_SIZE))
+            stream >> block;
+        else
+            filein >> block;
     }
     catch (const std::exception& e) {
         return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
     }
 
     // Check the header
-    if (!CheckProofOfWork(block.GetPoWHash(nHeight), block.nBits, consensusParams))
+    if (!CheckBlockHeaderProofOfWork(block, nHeight, consensusParams))
         return error("ReadBlockFromDisk: Errors in block header at %s", pos.ToString());
 
     return true;
@@ -1328,6 +1789,51 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
     return true;
 }
 
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart)
+{
+    CDiskBlockPos blockPos;
+    {
+        LOCK(cs_main);
+        blockPos = pindex->GetBlockPos();
+    }
+    // Start at the magic bytes and size written in front of the block
+    if (blockPos.nPos < 8)
+        return error("%s: Invalid block position %s", __func__, blockPos.ToString());
+    blockPos.nPos -= 8;
+
+    CAutoFile filein(OpenBlockFile(blockPos, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s: OpenBlockFile failed for %s", __func__, blockPos.ToString());
+
+    try {
+        CMessageHeader::MessageStartChars blockStart;
+        unsigned int nSize;
+        filein >> FLATDATA(blockStart) >> nSize;
+        bool fCompressed = IsCompressedMessageStart(blockStart, messageStart);
+        if (!fCompressed && memcmp(blockStart, messageStart, CMessageHeader::MESSAGE_START_SIZE))
+            return error("%s: Block magic mismatch at %s", __func__, blockPos.ToString());
+        if (nSize < (fCompressed ? COMPRESSED_FRAME_HEADER_SIZE : 80) || nSize > MAX_BLOCK_SERIALIZED_SIZE)
+            return error("%s: Invalid block size %u at %s", __func__, nSize, blockPos.ToString());
+        block.resize(nSize);
+        filein.read((char*)block.data(), nSize);
+        if (fCompressed) {
+            CDataStream stream(SER_DISK, CLIENT_VERSION);
+            DecompressFrame((const char*)block.data(), nSize, stream, MAX_BLOCK_SERIALIZED_SIZE);
+            if (stream.size() < 80)
+                return error("%s: Invalid block size %u at %s", __func__, stream.size(), blockPos.ToString());
+            block.assign(stream.begin(), stream.end());
+        }
+    } catch (const std::exception& e) {
+        return error("%s: Read error - %s at %s", __func__, e.what(), blockPos.ToString());
+    }
+
+    // The header commits to the rest of the block, whose proof of work was checked when it was stored
+    if (Hash(block.begin(), block.begin() + 80) != pindex->GetBlockHash())
+        return error("%s: Block hash doesn't match index for %s at %s", __func__, pindex->ToString(), blockPos.ToString());
+
+    return true;
+}
+
 CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams)
 {
     int halvings = nHeight / consensusParams.nSubsidyHalvingInterval;
@@ -1584,6 +2090,10 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
                 return true;
             }
 
+            // Only now the scripts are going to run, a transaction found in the cache never needs its sighash data
+            if (!txdata.ready)
+                txdata.Init(tx);
+
             for (unsigned int i = 0; i < tx.vin.size(); i++) {
                 const COutPoint &prevout = tx.vin[i].prevout;
                 const Coin& coin = inputs.AccessCoin(prevout);
@@ -1637,7 +2147,8 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
 
 namespace {
 
-bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint256& hashBlock, const CMessageHeader::MessageStartChars& messageStart)
+/** Write blockundo to disk, as the compressed frame instead if frame is not empty */
+bool UndoWriteToDisk(const CBlockUndo& blockundo, const std::vector<char>& frame, CDiskBlockPos& pos, const uint256& hashBlock, const CMessageHeader::MessageStartChars& messageStart)
 {
     // Open history file to append
     CAutoFile fileout(OpenUndoFile(pos), SER_DISK, CLIENT_VERSION);
@@ -1645,15 +2156,24 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
         return error("%s: OpenUndoFile failed", __func__);
 
     // Write index header
-    unsigned int nSize = GetSerializeSize(fileout, blockundo);
-    fileout << FLATDATA(messageStart) << nSize;
+    if (frame.empty()) {
+        unsigned int nSize = GetSerializeSize(fileout, blockundo);
+        fileout << FLATDATA(messageStart) << nSize;
+    } else {
+        CMessageHeader::MessageStartChars compressedStart;
+        GetCompressedMessageStart(messageStart, compressedStart);
+        fileout << FLATDATA(compressedStart) << (unsigned int)frame.size();
+    }
 
     // Write undo data
     long fileOutPos = ftell(fileout.Get());
     if (fileOutPos < 0)
         return error("%s: ftell failed", __func__);
     pos.nPos = (unsigned int)fileOutPos;
-    fileout << blockundo;
+    if (frame.empty())
+        fileout << blockundo;
+    else
+        fileout.write(frame.data(), frame.size());
 
     // calculate & write checksum
     CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
@@ -1664,24 +2184,59 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
     return true;
 }
 
-static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
+/** Abort with a message */
+bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
+{
+    SetMiscWarning(strMessage);
+    LogPrintf("*** %s\n", strMessage);
+    uiInterface.ThreadSafeMessageBox(
+        userMessage.empty() ? _("Error: A fatal internal error occurred, see debug.log for details") : userMessage,
+        "", CClientUIInterface::MSG_ERROR);
+    StartShutdown();
+    return false;
+}
+
+bool AbortNode(CValidationState& state, const std::string& strMessage, const std::string& userMessage="")
+{
+    AbortNode(strMessage, userMessage);
+    return state.Error(strMessage);
+}
+
+} // namespace
+
+/** Read blockundo from stream and return the hash it is checksummed with, which covers hashPrevBlock too */
+template <typename Stream>
+static uint256 ReadBlockUndo(Stream& stream, CBlockUndo& blockundo, const uint256& hashPrevBlock)
+{
+    CHashVerifier<Stream> verifier(&stream); // We need a CHashVerifier as reserializing may lose data
+    verifier << hashPrevBlock;
+    verifier >> blockundo;
+    return verifier.GetHash();
+}
+
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
 {
     CDiskBlockPos pos = pindex->GetUndoPos();
     if (pos.IsNull()) {
         return error("%s: no undo data available", __func__);
     }
 
-    // Open history file to read
-    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
+    // Open history file to read, at the header in front of the undo data
+    if (pos.nPos < 8)
+        return error("%s: Invalid undo position %s", __func__, pos.ToString());
+    CAutoFile filein(OpenUndoFile(CDiskBlockPos(pos.nFile, pos.nPos - 8), true), SER_DISK, CLIENT_VERSION);
     if (filein.IsNull())
         return error("%s: OpenUndoFile failed", __func__);
 
     // Read block
     uint256 hashChecksum;
-    CHashVerifier<CAutoFile> verifier(&filein); // We need a CHashVerifier as reserializing may lose data
+    uint256 hashUndo;
     try {
-        verifier << pindex->pprev->GetBlockHash();
-        verifier >> blockundo;
+        CDataStream stream(SER_DISK, CLIENT_VERSION);
+        if (ReadCompressedRecord(filein, stream, MAX_SIZE))
+            hashUndo = ReadBlockUndo(stream, blockundo, pindex->pprev->GetBlockHash());
+        else
+            hashUndo = ReadBlockUndo(filein, blockundo, pindex->pprev->GetBlockHash());
         filein >> hashChecksum;
     }
     catch (const std::exception& e) {
@@ -1689,32 +2244,12 @@ static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
     }
 
     // Verify checksum
-    if (hashChecksum != verifier.GetHash())
+    if (hashChecksum != hashUndo)
         return error("%s: Checksum mismatch", __func__);
 
     return true;
 }
 
-/** Abort with a message */
-bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
-{
-    SetMiscWarning(strMessage);
-    LogPrintf("*** %s\n", strMessage);
-    uiInterface.ThreadSafeMessageBox(
-        userMessage.empty() ? _("Error: A fatal internal error occurred, see debug.log for details") : userMessage,
-        "", CClientUIInterface::MSG_ERROR);
-    StartShutdown();
-    return false;
-}
-
-bool AbortNode(CValidationState& state, const std::string& strMessage, const std::string& userMessage="")
-{
-    AbortNode(strMessage, userMessage);
-    return state.Error(strMessage);
-}
-
-} // namespace
-
 /**
  * Restore the UTXO in a Coin at a given COutPoint
  * @param undo The Coin to be restored.
@@ -1749,110 +2284,111 @@ int ApplyTxInUndo(Coin&& undo, CCoinsViewCache& view, const COutPoint& out)
     return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
 }
 
-/** Undo the effects of this block (with given index) on the UTXO set represented by coins.
- *  When FAILED is returned, view is left in an indeterminate state. */
-DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view)
+/**
+ * Restore the inputs spent by block into view from its undo data read from stream, and set hashUndo
+ * to the hash the undo data is checksummed with.
+ */
+template <typename Stream>
+static DisconnectResult ApplyBlockUndo(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view, Stream& stream, uint256& hashUndo)
 {
     bool fClean = true;
 
-    CBlockUndo blockUndo;
-    if (!UndoReadFromDisk(blockUndo, pindex)) {
-        error("DisconnectBlock(): failure reading undo data");
-        return DISCONNECT_FAILED;
-    }
+    CHashVerifier<Stream> verifier(&stream);
+    verifier << pindex->pprev->GetBlockHash();
 
-    if (blockUndo.vtxundo.size() + 1 != block.vtx.size()) {
+    if (ReadCompactSize(verifier) + 1 != block.vtx.size()) {
         error("DisconnectBlock(): block and undo data inconsistent");
         return DISCONNECT_FAILED;
     }
 
-    // undo transactions in reverse order
-    for (int i = block.vtx.size() - 1; i >= 0; i--) {
+    for (size_t i = 1; i < block.vtx.size(); i++) { // not coinbases
         const CTransaction &tx = *(block.vtx[i]);
-        uint256 hash = tx.GetHash();
-        bool is_coinbase = tx.IsCoinBase() || tx.IsZerocoinSpend();
+        CTxUndo txundo;
+        verifier >> txundo;
+        if (tx.IsZerocoinSpend())
+            continue;
+        if (txundo.vprevout.size() != tx.vin.size()) {
+            error("DisconnectBlock(): transaction and undo data inconsistent");
+            return DISCONNECT_FAILED;
+        }
+        for (unsigned int j = 0; j < tx.vin.size(); j++) {
+            const COutPoint &out = tx.vin[j].prevout;
+            int res = ApplyTxInUndo(std::move(txundo.vprevout[j]), view, out);
+            if (res == DISCONNECT_FAILED) return DISCONNECT_FAILED;
+            fClean = fClean && res != DISCONNECT_UNCLEAN;
+        }
+    }
 
-        // Check that all outputs are available and match the outputs in the block itself
-        // exactly.
-        for (size_t o = 0; o < tx.vout.size(); o++) {
-            if (!tx.vout[o].scriptPubKey.IsUnspendable()) {
-                COutPoint out(hash, o);
-                Coin coin;
-                bool is_spent = view.SpendCoin(out, &coin);
-                if (!is_spent || tx.vout[o] != coin.out || pindex->nHeight != coin.nHeight || is_coinbase != coin.fCoinBase) {
-                    fClean = false; // transaction output mismatch
-                    LogPrintf("Error for vout: vout: %d, amount: %d", o, tx.vout[o].nValue);
-                }
-            }
-        }
-
-        if (fAddressIndex) {
-            for (unsigned int k = tx.vout.size(); k-- > 0;) {
-                const CTxOut &out = tx.vout[k];
-
-                if (out.scriptPubKey.IsPayToScriptHash()) {
-                    vector<unsigned char> hashBytes(out.scriptPubKey.begin()+2, out.scriptPubKey.begin()+22);
-
-                    // undo receiving activity
-                    view.addressIndex.push_back(make_pair(CAddressIndexKey(2, uint256(hashBytes.data(), hashBytes.size()), pindex->nHeight, i, hash, k, false), out.nValue));
-
-                    // undo unspent index
-                    view.addressUnspentIndex.push_back(make_pair(CAddressUnspentKey(2, uint256(hashBytes.data(), hashBytes.size()), hash, k), CAddressUnspentValue()));
-
-                } else if (out.scriptPubKey.IsPayToPublicKeyHash()) {
-                    vector<unsigned char> hashBytes(out.scriptPubKey.begin()+3, out.scriptPubKey.begin()+23);
+    hashUndo = verifier.GetHash();
+    return fClean ? DISCONNECT_OK : DISCONNECT_UNCLEAN;
+}
 
-                    // undo receiving activity
-                    view.addressIndex.push_back(make_pair(CAddressIndexKey(1, uint256(hashBytes.data(), hashBytes.size()), pindex->nHeight, i, hash, k, false), out.nValue));
+/** Undo the effects of this block (with given index) on the UTXO set represented by coins.
+ *  The undo data is applied while it is read from disk, one transaction at a time.
+ *  When FAILED is returned, view is left in an indeterminate state. */
+DisconnectResult CChainState::DisconnectBlock(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& view)
+{
+    bool fClean = true;
 
-                    // undo unspent index
-                    view.addressUnspentIndex.push_back(make_pair(CAddressUnspentKey(1, uint256(hashBytes.data(), hashBytes.size()), hash, k), CAddressUnspentValue()));
+    CDiskBlockPos pos = pindex->GetUndoPos();
+    if (pos.IsNull()) {
+        error("DisconnectBlock(): no undo data available");
+        return DISCONNECT_FAILED;
+    }
 
-                } else {
-                    continue;
-                }
+    if (pos.nPos < 8) {
+        error("DisconnectBlock(): invalid undo position %s", pos.ToString());
+        return DISCONNECT_FAILED;
+    }
+    CAutoFile filein(OpenUndoFile(CDiskBlockPos(pos.nFile, pos.nPos - 8), true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        error("DisconnectBlock(): OpenUndoFile failed");
+        return DISCONNECT_FAILED;
+    }
 
-            }
+    // restore inputs, in the order the undo data is stored. Outputs created and spent within the
+    // block are restored here and spent again below, which leaves the same set as undoing the
+    // transactions in reverse order.
+    try {
+        CDataStream stream(SER_DISK, CLIENT_VERSION);
+        uint256 hashUndo;
+        int res;
+        if (ReadCompressedRecord(filein, stream, MAX_SIZE))
+            res = ApplyBlockUndo(block, pindex, view, stream, hashUndo);
+        else
+            res = ApplyBlockUndo(block, pindex, view, filein, hashUndo);
+        if (res == DISCONNECT_FAILED) return DISCONNECT_FAILED;
+        fClean = fClean && res != DISCONNECT_UNCLEAN;
 
+        uint256 hashChecksum;
+        filein >> hashChecksum;
+        if (hashChecksum != hashUndo) {
+            error("DisconnectBlock(): undo data checksum mismatch");
+            return DISCONNECT_FAILED;
         }
+    } catch (const std::exception& e) {
+        error("DisconnectBlock(): Deserialize or I/O error - %s", e.what());
+        return DISCONNECT_FAILED;
+    }
 
-        // restore inputs
-        if (i > 0 && !tx.IsZerocoinSpend()) { // not coinbases
-            CTxUndo &txundo = blockUndo.vtxundo[i-1];
-            if (txundo.vprevout.size() != tx.vin.size()) {
-                error("DisconnectBlock(): transaction and undo data inconsistent");
-                return DISCONNECT_FAILED;
-            }
-            for (unsigned int j = tx.vin.size(); j-- > 0;) {
-                const COutPoint &out = tx.vin[j].prevout;
-                int res = ApplyTxInUndo(std::move(txundo.vprevout[j]), view, out);
-                if (res == DISCONNECT_FAILED) return DISCONNECT_FAILED;
-                fClean = fClean && res != DISCONNECT_UNCLEAN;
-                const CTxIn input = tx.vin[j];
-
-                if (fSpentIndex) // undo and delete the spent index
-                    view.spentIndex.push_back(std::make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue()));
-
-                if (fAddressIndex)
-                {
-                    const Coin &coin = view.AccessCoin(tx.vin[j].prevout);
-                    const CScript *pScript = &coin.out.scriptPubKey;
-
-                    CAmount nValue = coin.out.nValue;
-                    std::vector<uint8_t> hashBytes;
-                    int scriptType = 0;
-                    if (!ExtractIndexInfo(pScript, scriptType, hashBytes)
-                            || scriptType == 0)
-                        continue;
+    // undo transactions in reverse order
+    for (int i = block.vtx.size() - 1; i >= 0; i--) {
+        const CTransaction &tx = *(block.vtx[i]);
+        uint256 hash = tx.GetHash();
+        bool is_coinbase = tx.IsCoinBase() || tx.IsZerocoinSpend();
 
-                    // undo spending activity
-                    view.addressIndex.push_back(std::make_pair(CAddressIndexKey(scriptType, uint256(hashBytes.data(), hashBytes.size()), pindex->nHeight, i, hash, j, true), nValue * -1));
-                    // restore unspent index
-                    view.addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(scriptType, uint256(hashBytes.data(), hashBytes.size()), input.prevout.hash, input.prevout.n), CAddressUnspentValue(nValue, *pScript, coin.nHeight)));
+        // Check that all outputs are available and match the outputs in the block itself
+        // exactly.
+        for (size_t o = 0; o < tx.vout.size(); o++) {
+            if (!tx.vout[o].scriptPubKey.IsUnspendable()) {
+                COutPoint out(hash, o);
+                Coin coin;
+                bool is_spent = view.SpendCoin(out, &coin);
+                if (!is_spent || tx.vout[o] != coin.out || pindex->nHeight != coin.nHeight || is_coinbase != coin.fCoinBase) {
+                    fClean = false; // transaction output mismatch
+                    LogPrintf("Error for vout: vout: %d, amount: %d", o, tx.vout[o].nValue);
                 }
-
             }
-            // At this point, all of txundo.vprevout should have been moved out.
         }
     }
 
@@ -1892,9 +2428,12 @@ static bool WriteUndoDataForBlock(const CBlockUndo& blockundo, CValidationState&
     // Write undo information to disk
     if (pindex->GetUndoPos().IsNull()) {
         CDiskBlockPos _pos;
-        if (!FindUndoPos(state, pindex->nFile, _pos, ::GetSerializeSize(blockundo, SER_DISK, CLIENT_VERSION) + 40))
+        std::vector<char> frame;
+        CompressRecord(blockundo, frame);
+        unsigned int nSize = frame.empty() ? ::GetSerializeSize(blockundo, SER_DISK, CLIENT_VERSION) : frame.size();
+        if (!FindUndoPos(state, pindex->nFile, _pos, nSize + 40))
             return error("ConnectBlock(): FindUndoPos failed");
-        if (!UndoWriteToDisk(blockundo, _pos, pindex->pprev->GetBlockHash(), chainparams.MessageStart()))
+        if (!UndoWriteToDisk(blockundo, frame, _pos, pindex->pprev->GetBlockHash(), chainparams.MessageStart()))
             return AbortNode(state, "Failed to write undo data");
 
         // update nUndoPos in block index
@@ -1916,7 +2455,7 @@ static bool WriteTxIndexDataForBlock(const CBlock& block, CValidationState& stat
     for (const CTransactionRef& tx : block.vtx)
     {
         vPos.push_back(std::make_pair(tx->GetHash(), pos));
-        pos.nTxOffset += ::GetSerializeSize(*tx, SER_DISK, CLIENT_VERSION);
+        pos.nTxOffset += tx->GetTotalSize();
     }
 
     if (!pblocktree->WriteTxIndex(vPos)) {
@@ -1926,6 +2465,51 @@ static bool WriteTxIndexDataForBlock(const CBlock& block, CValidationState& stat
     return true;
 }
 
+/**
+ * Whether a block is an ancestor of the -assumevalid block, so the expensive checks of its history
+ * can be skipped: scripts in ConnectBlock and zerocoin spend proofs in CheckBlock.
+ */
+/** Whether pindex is the last checkpoint or one of its ancestors, with checkpoints enabled */
+static bool IsCheckpointed(const CBlockIndex* pindex, const CChainParams& chainparams)
+{
+    AssertLockHeld(cs_main);
+    if (!fCheckpointsEnabled)
+        return false;
+    const CBlockIndex* pcheckpoint = Checkpoints::GetLastCheckpoint(chainparams.Checkpoints());
+    return pcheckpoint && pcheckpoint->GetAncestor(pindex->nHeight) == pindex;
+}
+
+static bool IsAssumedValid(const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+{
+    LOCK(cs_main);
+    if (hashAssumeValid.IsNull() || !pindexBestHeader)
+        return false;
+
+    // We've been configured with the hash of a block which has been externally verified to have a valid history.
+    // A suitable default value is included with the software and updated from time to time.  Because validity
+    //  relative to a piece of software is an objective fact these defaults can be easily reviewed.
+    // This setting doesn't force the selection of any particular chain but makes validating some faster by
+    //  effectively caching the result of part of the verification.
+    BlockMap::const_iterator  it = mapBlockIndex.find(hashAssumeValid);
+    if (it != mapBlockIndex.end()) {
+        if (it->second->GetAncestor(pindex->nHeight) == pindex &&
+            pindexBestHeader->GetAncestor(pindex->nHeight) == pindex &&
+            pindexBestHeader->nChainWork >= nMinimumChainWork) {
+            // This block is a member of the assumed verified chain and an ancestor of the best header.
+            // The equivalent time check discourages hash power from extorting the network via DOS attack
+            //  into accepting an invalid block through telling users they must manually set assumevalid.
+            //  Requiring a software change or burying the invalid block, regardless of the setting, makes
+            //  it hard to hide the implication of the demand.  This also avoids having release candidates
+            //  that are hardly doing any signature verification at all in testing without having to
+            //  artificially set the default assumed verified block further back.
+            // The test against nMinimumChainWork prevents the skipping when denied access to any chain at
+            //  least as good as the expected chain.
+            return GetBlockProofEquivalentTime(*pindexBestHeader, *pindex, *pindexBestHeader, consensusParams) > 60 * 60 * 24 * 7 * 2;
+        }
+    }
+    return false;
+}
+
 static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
 
 void ThreadScriptCheck() {
@@ -1933,6 +2517,80 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+static CCheckQueue<CZerocoinSpendCheck> zerocoinspendcheckqueue(1);
+
+void ThreadZerocoinSpendCheck() {
+    RenameThread("nix-zcspendch");
+    zerocoinspendcheckqueue.Thread();
+}
+
+/** How often ThreadDBCompaction() checks whether the node is idle */
+static const int DB_COMPACT_CHECK_SECONDS = 10;
+
+void ThreadDBCompaction(int nIntervalMinutes) {
+    RenameThread("nix-dbcompact");
+    // One database per interval, each in turn
+    int64_t nLastCompaction = GetTime();
+    uint256 hashLastTip;
+    while (true) {
+        MilliSleep(DB_COMPACT_CHECK_SECONDS * 1000);
+        uint256 hashTip;
+        {
+            LOCK(cs_main);
+            if (chainActive.Tip())
+                hashTip = chainActive.Tip()->GetBlockHash();
+        }
+        // A compaction rewrites the tables a block connect reads, keep it out of the way of a new tip
+        if (hashTip == hashLastTip && !IsInitialBlockDownload() && GetTime() - nLastCompaction >= nIntervalMinutes * 60) {
+            CompactNextDatabase();
+            nLastCompaction = GetTime();
+        }
+        hashLastTip = hashTip;
+    }
+}
+
+static CCheckQueue<CPoWCheck> powcheckqueue(16);
+
+void ThreadPoWCheck() {
+    RenameThread("nix-powch");
+    powcheckqueue.Thread();
+}
+
+/**
+ * Closure checking the structure of one transaction of a block, see CheckTransactionStructure.
+ * It counts the legacy sigops of the transaction as well, which CheckBlock adds up afterwards.
+ */
+class CTxStructureCheck
+{
+private:
+    const CTransaction *ptx;
+    unsigned int *pnSigOps;
+
+public:
+    CTxStructureCheck(): ptx(nullptr), pnSigOps(nullptr) {}
+    CTxStructureCheck(const CTransaction *ptxIn, unsigned int *pnSigOpsIn) : ptx(ptxIn), pnSigOps(pnSigOpsIn) {}
+
+    bool operator()() {
+        CValidationState state;
+        if (!CheckTransactionStructure(*ptx, state, true))
+            return false;
+        *pnSigOps = GetLegacySigOpCount(*ptx);
+        return true;
+    }
+
+    void swap(CTxStructureCheck &check) {
+        std::swap(ptx, check.ptx);
+        std::swap(pnSigOps, check.pnSigOps);
+    }
+};
+
+static CCheckQueue<CTxStructureCheck> txstructurecheckqueue(128);
+
+void ThreadTxStructureCheck() {
+    RenameThread("nix-txch");
+    txstructurecheckqueue.Thread();
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -2036,6 +2694,25 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
            (*pindex->phashBlock == block.GetHash()));
     int64_t nTimeStart = GetTimeMicros();
 
+    // A block this node fully validated before has its undo data on disk, and its zerocoin
+    // accumulator changes and spent serials in the block index, written in the same batch
+    // as its BLOCK_VALID_SCRIPTS. -reindex-chainstate-fast then skips CheckBlock and its spend
+    // proofs, and only re-applies the coins of the block.
+    if (fReindexChainStateFast && !fJustCheck && pindex->IsValid(BLOCK_VALID_SCRIPTS) &&
+            (pindex->nStatus & BLOCK_HAVE_UNDO) && IsInitialBlockDownload()) {
+        assert(pindex->pprev && pindex->pprev->GetBlockHash() == view.GetBestBlock());
+        nBlocksTotal++;
+        for (const CTransactionRef& tx : block.vtx) {
+            UpdateCoins(*tx, view, pindex->nHeight);
+        }
+        CZerocoinState::GetZerocoinState()->AddBlock(pindex);
+        if (!WriteTxIndexDataForBlock(block, state, pindex))
+            return false;
+        view.SetBestBlock(pindex->GetBlockHash());
+        RecordConnectPhase(ConnectPhase::CONNECT_TXS, nTimeStart, GetTimeMicros(), pindex->nHeight);
+        return true;
+    }
+
     // Check it again in case a previous version let a bad block in
     // NOTE: We don't currently (re-)invoke ContextualCheckBlock() or
     // ContextualCheckBlockHeader() here. This means that if we add a new
@@ -2066,34 +2743,11 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
     nBlocksTotal++;
 
-    bool fScriptChecks = true;
-    if (!hashAssumeValid.IsNull()) {
-        // We've been configured with the hash of a block which has been externally verified to have a valid history.
-        // A suitable default value is included with the software and updated from time to time.  Because validity
-        //  relative to a piece of software is an objective fact these defaults can be easily reviewed.
-        // This setting doesn't force the selection of any particular chain but makes validating some faster by
-        //  effectively caching the result of part of the verification.
-        BlockMap::const_iterator  it = mapBlockIndex.find(hashAssumeValid);
-        if (it != mapBlockIndex.end()) {
-            if (it->second->GetAncestor(pindex->nHeight) == pindex &&
-                pindexBestHeader->GetAncestor(pindex->nHeight) == pindex &&
-                pindexBestHeader->nChainWork >= nMinimumChainWork) {
-                // This block is a member of the assumed verified chain and an ancestor of the best header.
-                // The equivalent time check discourages hash power from extorting the network via DOS attack
-                //  into accepting an invalid block through telling users they must manually set assumevalid.
-                //  Requiring a software change or burying the invalid block, regardless of the setting, makes
-                //  it hard to hide the implication of the demand.  This also avoids having release candidates
-                //  that are hardly doing any signature verification at all in testing without having to
-                //  artificially set the default assumed verified block further back.
-                // The test against nMinimumChainWork prevents the skipping when denied access to any chain at
-                //  least as good as the expected chain.
-                fScriptChecks = (GetBlockProofEquivalentTime(*pindexBestHeader, *pindex, *pindexBestHeader, chainparams.GetConsensus()) <= 60 * 60 * 24 * 7 * 2);
-            }
-        }
-    }
+    bool fScriptChecks = !IsAssumedValid(pindex, chainparams.GetConsensus());
 
     int64_t nTime1 = GetTimeMicros(); nTimeCheck += nTime1 - nTimeStart;
     LogPrint(BCLog::BENCH, "    - Sanity checks: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime1 - nTimeStart), nTimeCheck * MICRO, nTimeCheck * MILLI / nBlocksTotal);
+    RecordConnectPhase(ConnectPhase::CHECK_BLOCK, nTimeStart, nTime1, pindex->nHeight);
 
     // Do not allow blocks that contain transactions which 'overwrite' older transactions,
     // unless those are already completely spent.
@@ -2142,6 +2796,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
     int64_t nTime2 = GetTimeMicros(); nTimeForks += nTime2 - nTime1;
     LogPrint(BCLog::BENCH, "    - Fork checks: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime2 - nTime1), nTimeForks * MICRO, nTimeForks * MILLI / nBlocksTotal);
+    RecordConnectPhase(ConnectPhase::FORK_CHECKS, nTime1, nTime2, pindex->nHeight);
 
     CBlockUndo blockundo;
 
@@ -2153,16 +2808,12 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     int64_t nSigOpsCost = 0;
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
-    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
-
-    std::vector<PrecomputedTransactionData> txdata;
-    txdata.reserve(block.vtx.size()); // Required so that pointers to individual PrecomputedTransactionData don't get invalidated
+    // Sized up front so that pointers to individual PrecomputedTransactionData don't get invalidated. CheckInputs
+    // fills each in when it runs the scripts, those of transactions accepted to the mempool before are cached
+    std::vector<PrecomputedTransactionData> txdata(block.vtx.size());
     for (unsigned int i = 0; i < block.vtx.size(); i++)
     {
         const CTransaction &tx = *(block.vtx[i]);
-        const uint256 txHash = tx.GetHash();
 
         nInputs += tx.vin.size();
 
@@ -2190,46 +2841,8 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
                 return state.DoS(100, error("%s: contains a non-BIP68-final transaction", __func__),
                                  REJECT_INVALID, "bad-txns-nonfinal");
             }
-
-            // Update spent inputs for insight
-            for (size_t j = 0; j < tx.vin.size(); j++)
-            {
-                const CTxIn input = tx.vin[j];
-
-                const Coin &coin = view.AccessCoin(input.prevout);
-                const CScript *pScript = &coin.out.scriptPubKey;
-
-                CAmount nValue = coin.out.nValue;
-                std::vector<uint8_t> hashBytes;
-                int scriptType = 0;
-
-                if (!ExtractIndexInfo(pScript, scriptType, hashBytes)
-                        || scriptType == 0)
-                    continue;
-
-                uint256 hashAddress;
-                if (scriptType > 0)
-                    hashAddress = uint256(hashBytes.data(), hashBytes.size());
-
-                if (fAddressIndex && scriptType > 0)
-                {
-                    // record spending activity
-                    view.addressIndex.push_back(std::make_pair(CAddressIndexKey(scriptType, hashAddress, pindex->nHeight, i, txHash, j, true), nValue * -1));
-                    // remove address from unspent index
-                    view.addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(scriptType, hashAddress, input.prevout.hash, input.prevout.n), CAddressUnspentValue()));
-                };
-
-                if (fSpentIndex)
-                {
-                    CAmount nValue = coin.out.nValue;
-                    // add the spent index to determine the txid and input that spent an output
-                    // and to find the amount and address from an input
-                    view.spentIndex.push_back(std::make_pair(CSpentIndexKey(input.prevout.hash, input.prevout.n), CSpentIndexValue(txHash, j, pindex->nHeight, nValue, scriptType, hashAddress)));
-                }
-            }
         }
 
-
         // GetTransactionSigOpCost counts 3 types of sigops:
         // * legacy (always)
         // * p2sh (when P2SH enabled in flags and excludes coinbase)
@@ -2239,7 +2852,6 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
             return state.DoS(100, error("ConnectBlock(): too many sigops"),
                              REJECT_INVALID, "bad-blk-sigops");
 
-        txdata.emplace_back(tx);
         if (!tx.IsCoinBase() && !tx.IsZerocoinSpend())
         {
             std::vector<CScriptCheck> vChecks;
@@ -2255,35 +2867,11 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
             blockundo.vtxundo.push_back(CTxUndo());
         }
         UpdateCoins(tx, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
-
-
-        if (fAddressIndex)
-        {
-            // Update outputs for insight
-            for (unsigned int k = 0; k < tx.vout.size(); k++)
-            {
-                const CTxOut *out = &tx.vout[k];
-
-                const CScript *pScript;
-                std::vector<unsigned char> hashBytes;
-                int scriptType = 0;
-                CAmount nValue;
-                if (!ExtractIndexInfo(out, scriptType, hashBytes, nValue, pScript)
-                        || scriptType == 0)
-                    continue;
-
-                // record receiving activity
-                view.addressIndex.push_back(std::make_pair(CAddressIndexKey(scriptType, uint256(hashBytes.data(), hashBytes.size()), pindex->nHeight, i, txHash, k, false), nValue));
-                // record unspent output
-                view.addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(scriptType, uint256(hashBytes.data(), hashBytes.size()), txHash, k), CAddressUnspentValue(nValue, *pScript, pindex->nHeight)));
-            }
-        }
-
-
     }
 
     int64_t nTime3 = GetTimeMicros(); nTimeConnect += nTime3 - nTime2;
     LogPrint(BCLog::BENCH, "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs (%.2fms/blk)]\n", (unsigned)block.vtx.size(), MILLI * (nTime3 - nTime2), MILLI * (nTime3 - nTime2) / block.vtx.size(), nInputs <= 1 ? 0 : MILLI * (nTime3 - nTime2) / (nInputs-1), nTimeConnect * MICRO, nTimeConnect * MILLI / nBlocksTotal);
+    RecordConnectPhase(ConnectPhase::CONNECT_TXS, nTime2, nTime3, pindex->nHeight);
 
     CAmount blockReward = nFees + GetBlockSubsidy(pindex->nHeight, chainparams.GetConsensus());
     if (block.vtx[0]->GetValueOut() > blockReward)
@@ -2295,16 +2883,21 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
 
 
     // Ghostnode
-    std::string strError = "";
-    if (!IsBlockValueValid(block, pindex->nHeight, blockReward, strError)) {
-        return state.DoS(0, error("ConnectBlock(): %s", strError), REJECT_INVALID, "bad-cb-amount");
-    }
+    // The payees of the blocks up to the last checkpoint are settled, and can't be checked
+    // before the ghostnode list is synced anyway. The coinbase value was checked above.
+    if (!IsCheckpointed(pindex, chainparams)) {
+        std::string strError = "";
+        if (!IsBlockValueValid(block, pindex->nHeight, blockReward, strError)) {
+            return state.DoS(0, error("ConnectBlock(): %s", strError), REJECT_INVALID, "bad-cb-amount");
+        }
 
-    if (!IsBlockPayeeValid(*block.vtx[0], pindex->nHeight, blockReward)) {
-        mapRejectedBlocks.insert(make_pair(block.GetHash(), GetTime()));
-        return state.DoS(0, error("ConnectBlock(): couldn't find ghostnode payments"),
-                         REJECT_INVALID, "bad-cb-payee");
+        if (!IsBlockPayeeValid(*block.vtx[0], pindex->nHeight, blockReward)) {
+            mapRejectedBlocks.insert(make_pair(block.GetHash(), GetTime()));
+            return state.DoS(0, error("ConnectBlock(): couldn't find ghostnode payments"),
+                             REJECT_INVALID, "bad-cb-payee");
+        }
     }
+    RecordConnectPhase(ConnectPhase::GHOSTNODE_PAYMENTS, nTime3, GetTimeMicros(), pindex->nHeight);
     // END Ghostnode
 
 
@@ -2312,14 +2905,18 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         return state.DoS(100, error("%s: CheckQueue failed", __func__), REJECT_INVALID, "block-validation-failed");
     int64_t nTime4 = GetTimeMicros(); nTimeVerify += nTime4 - nTime2;
     LogPrint(BCLog::BENCH, "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs (%.2fms/blk)]\n", nInputs - 1, MILLI * (nTime4 - nTime2), nInputs <= 1 ? 0 : MILLI * (nTime4 - nTime2) / (nInputs-1), nTimeVerify * MICRO, nTimeVerify * MILLI / nBlocksTotal);
-
+    RecordConnectPhase(ConnectPhase::VERIFY_SCRIPTS, nTime2, nTime4, pindex->nHeight);
 
     if (!ConnectBlockGhost(state, chainparams, pindex, &block))
         return false;
+    int64_t nTimeGhost = GetTimeMicros();
+    RecordConnectPhase(ConnectPhase::CONNECT_GHOST, nTime4, nTimeGhost, pindex->nHeight);
 
     if (fJustCheck)
         return true;
 
+    setDirtyBlockZerocoin.insert(pindex);
+
     if (!WriteUndoDataForBlock(blockundo, state, pindex, chainparams))
         return false;
 
@@ -2331,24 +2928,13 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     if (!WriteTxIndexDataForBlock(block, state, pindex))
         return false;
 
-
-    if (fTimestampIndex)
-    {
-
-        if (!pblocktree->WriteTimestampIndex(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash())))
-            return AbortNode(state, "Failed to write timestamp index");
-
-        if (!pblocktree->WriteTimestampBlockIndex(CTimestampBlockIndexKey(pindex->GetBlockHash()), CTimestampBlockIndexValue(pindex->nTime)))
-            return AbortNode(state, "Failed to write blockhash index");
-    }
-
-
     assert(pindex->phashBlock);
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
     int64_t nTime5 = GetTimeMicros(); nTimeIndex += nTime5 - nTime4;
     LogPrint(BCLog::BENCH, "    - Index writing: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime5 - nTime4), nTimeIndex * MICRO, nTimeIndex * MILLI / nBlocksTotal);
+    RecordConnectPhase(ConnectPhase::WRITE_INDEX, nTimeGhost, nTime5, pindex->nHeight);
 
     int64_t nTime6 = GetTimeMicros(); nTimeCallbacks += nTime6 - nTime5;
     LogPrint(BCLog::BENCH, "    - Callbacks: %.2fms [%.2fs (%.2fms/blk)]\n", MILLI * (nTime6 - nTime5), nTimeCallbacks * MICRO, nTimeCallbacks * MILLI / nBlocksTotal);
@@ -2362,6 +2948,9 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
  * if they're too large, if it's been a while since the last write,
  * or always and in all cases if we're in prune mode and are deleting files.
  */
+/** Whether coins of the current tip were written by a partial flush since the last full one */
+static bool fCoinsPartiallyWritten = false;
+
 bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &state, FlushStateMode mode, int nManualPruneHeight) {
     int64_t nMempoolUsage = mempool.DynamicMemoryUsage();
     LOCK(cs_main);
@@ -2402,6 +2991,7 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             nLastSetChain = nNow;
         }
         int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
+        size_t nBatchSize = (size_t)gArgs.GetArg("-dbbatchsize", nDefaultDbBatchSize);
         int64_t cacheSize = pcoinsTip->DynamicMemoryUsage();
         int64_t nTotalSpace = nCoinCacheUsage + std::max<int64_t>(nMempoolSizeMax - nMempoolUsage, 0);
         // The cache is large and we're within 10% and 10 MiB of the limit, but we have time now (not in the middle of a block processing).
@@ -2414,13 +3004,19 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
         bool fPeriodicFlush = mode == FLUSH_STATE_PERIODIC && nNow > nLastFlush + (int64_t)DATABASE_FLUSH_INTERVAL * 1000000;
         // Combine all conditions that result in a full cache flush.
         fDoFullFlush = (mode == FLUSH_STATE_ALWAYS) || fCacheLarge || fCacheCritical || fPeriodicFlush || fFlushForPrune;
+        // The cache is past the soft limit, write the oldest modified coins so clean ones can be dropped.
+        int64_t nCacheSoftLimit = (3 * nTotalSpace) / 4;
+        bool fPartialFlush = !fDoFullFlush && mode != FLUSH_STATE_NONE && cacheSize > nCacheSoftLimit && pcoinsTip->HasDirtyCoins();
         // Write blocks and block index to disk.
-        if (fDoFullFlush || fPeriodicWrite) {
+        if (fDoFullFlush || fPeriodicWrite || fPartialFlush) {
             // Depend on nMinDiskSpace to ensure we can write block index
             if (!CheckDiskSpace(0))
                 return state.Error("out of disk space");
             // First make sure all block and undo data is flushed to disk.
             FlushBlockFile();
+            // Zerocoin mints of the blocks have to be on disk before the block index refers to them
+            if (pzerocoindb && !pzerocoindb->Sync())
+                return AbortNode(state, "Failed to write to zerocoin database");
             // Then update all block file information (which may refer to block and undo files).
             {
                 std::vector<std::pair<int, const CBlockFileInfo*> > vFiles;
@@ -2435,7 +3031,9 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
                     vBlocks.push_back(*it);
                     setDirtyBlockIndex.erase(it++);
                 }
-                if (!pblocktree->WriteBatchSync(vFiles, nLastBlockFile, vBlocks)) {
+                std::vector<const CBlockIndex*> vZerocoin(setDirtyBlockZerocoin.begin(), setDirtyBlockZerocoin.end());
+                setDirtyBlockZerocoin.clear();
+                if (!pblocktree->WriteBatchSync(vFiles, nLastBlockFile, vBlocks, vZerocoin)) {
                     return AbortNode(state, "Failed to write to block index database");
                 }
             }
@@ -2453,10 +3051,22 @@ bool static FlushStateToDisk(const CChainParams& chainparams, CValidationState &
             // overwrite one. Still, use a conservative safety factor of 2.
             if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
                 return state.Error("out of disk space");
-            // Flush the chainstate (which may refer to block index entries).
-            if (!pcoinsTip->Flush())
+            // Flush the chainstate (which may refer to block index entries). The coins stay
+            // cached, down to half the space, so block connection does not start from a cold cache.
+            if (!pcoinsTip->Sync(nBatchSize))
                 return AbortNode(state, "Failed to write to coin database");
+            pcoinsTip->Trim(nTotalSpace / 2);
+            fCoinsPartiallyWritten = false;
             nLastFlush = nNow;
+        } else if (fPartialFlush && !pcoinsTip->GetBestBlock().IsNull()) {
+            // One batch per call keeps the pause short. Until the next full flush the database
+            // records the tip as a head block, so ReplayBlocks can finish the write after a crash.
+            if (!CheckDiskSpace(nBatchSize * 2))
+                return state.Error("out of disk space");
+            if (!pcoinsTip->WriteOldest(nBatchSize))
+                return AbortNode(state, "Failed to write to coin database");
+            fCoinsPartiallyWritten = true;
+            pcoinsTip->Trim(nTotalSpace / 2);
         }
     }
     if (fDoFullFlush || ((mode == FLUSH_STATE_ALWAYS || mode == FLUSH_STATE_PERIODIC) && nNow > nLastSetChain + (int64_t)DATABASE_WRITE_INTERVAL * 1000000)) {
@@ -2495,36 +3105,8 @@ static void DoWarning(const std::string& strWarning)
 
 bool FlushView(CCoinsViewCache *view, CValidationState& state, bool fDisconnecting)
 {
-    if (!view->Flush())
-        return false;
-
-    if (fAddressIndex)
-    {
-        if (fDisconnecting)
-        {
-            if (!pblocktree->EraseAddressIndex(view->addressIndex))
-                return AbortNode(state, "Failed to delete address index");
-        } else
-        {
-            if (!pblocktree->WriteAddressIndex(view->addressIndex))
-                return AbortNode(state, "Failed to write address index");
-        };
-
-        if (!pblocktree->UpdateAddressUnspentIndex(view->addressUnspentIndex))
-            return AbortNode(state, "Failed to write address unspent index");
-    };
-
-    if (fSpentIndex)
-    {
-        if (!pblocktree->UpdateSpentIndex(view->spentIndex))
-            return AbortNode(state, "Failed to write transaction index");
-    };
-
-    view->addressIndex.clear();
-    view->addressUnspentIndex.clear();
-    view->spentIndex.clear();
-
-    return true;
+    // The address, spent and timestamp indexes follow the chain in the background (index/insightindex.h)
+    return view->Flush();
 };
 
 /** Check warning conditions and do some notifications on new chain tip set. */
@@ -2533,6 +3115,7 @@ void static UpdateTip(const CBlockIndex *pindexNew, const CChainParams& chainPar
 
     // New best block
     mempool.AddTransactionsUpdated(1);
+    MetricSet(Metric::CHAIN_HEIGHT, pindexNew->nHeight);
 
     //ghostnode
     mnodeman.UpdatedBlockTip(pindexNew);
@@ -2601,6 +3184,10 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
 {
     CBlockIndex *pindexDelete = chainActive.Tip();
     assert(pindexDelete);
+    // ReplayBlocks only rolls back from the best block of the last full flush, so partially
+    // written coins of the block being disconnected have to be completed first
+    if (fCoinsPartiallyWritten && !FlushStateToDisk(chainparams, state, FLUSH_STATE_ALWAYS))
+        return false;
     // Read block from disk.
     std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
     CBlock& block = *pblock;
@@ -2615,6 +3202,8 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
             return error("DisconnectTip(): DisconnectBlock %s failed", pindexDelete->GetBlockHash().ToString());
         bool flushed = FlushView(&view, state, true);
         assert(flushed);
+        // roll back the zerocoin mints and spends of the block together with its coins
+        DisconnectTipGhost(block, pindexDelete);
     }
     LogPrint(BCLog::BENCH, "- Disconnect block: %.2fms\n", (GetTimeMicros() - nStart) * MILLI);
     // Write the chain state to disk, if necessary.
@@ -2635,7 +3224,11 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
     }
 
     chainActive.SetTip(pindexDelete->pprev);
+    UpdateChainSnapshot();
+    txLookupCache.BlockDisconnected(block);
 
+    mnpayments.BlockDisconnected(block, pindexDelete);
+    mnodeman.UpdateCollaterals(block, false);
     UpdateTip(pindexDelete->pprev, chainparams);
     // Let wallets know transactions went from 1-confirmed to
     // 0-confirmed or conflicted:
@@ -2644,7 +3237,71 @@ bool CChainState::DisconnectTip(CValidationState& state, const CChainParams& cha
 }
 
 static int64_t nTimeReadFromDisk = 0;
+static int64_t nTimePrefetch = 0;
 static int64_t nTimeConnectTotal = 0;
+static uint64_t nPrefetchCached = 0;
+static uint64_t nPrefetchRead = 0;
+
+/** Number of coins read from the chainstate database by one prefetch task */
+static const size_t PREFETCH_BATCH_SIZE = 64;
+
+/**
+ * Load the coins spent by a block into pcoinsTip before ConnectBlock looks them up one at a time.
+ * The coins that are not cached yet are read from the chainstate database in parallel, LevelDB
+ * allows concurrent reads. Coins created in the block itself and zerocoin spends are skipped.
+ */
+static void PrefetchBlockInputs(const CBlock& block)
+{
+    AssertLockHeld(cs_main);
+
+    std::set<uint256> setBlockTxids;
+    for (const CTransactionRef& tx : block.vtx)
+        setBlockTxids.insert(tx->GetHash());
+
+    std::vector<COutPoint> vMissing;
+    size_t nCached = 0;
+    for (const CTransactionRef& tx : block.vtx) {
+        if (tx->IsCoinBase() || tx->IsZerocoinSpend())
+            continue;
+        for (const CTxIn& txin : tx->vin) {
+            if (setBlockTxids.count(txin.prevout.hash))
+                continue;
+            if (pcoinsTip->HaveCoinInCache(txin.prevout))
+                nCached++;
+            else
+                vMissing.push_back(txin.prevout);
+        }
+    }
+
+    std::vector<Coin> vCoins(vMissing.size());
+    std::vector<char> vFound(vMissing.size(), false);
+    if (!vMissing.empty()) {
+        libzerocoin::ParallelTasks::DoNotDisturb dnd;
+        libzerocoin::ParallelTasks reads((vMissing.size() + PREFETCH_BATCH_SIZE - 1) / PREFETCH_BATCH_SIZE);
+        for (size_t nStart = 0; nStart < vMissing.size(); nStart += PREFETCH_BATCH_SIZE) {
+            size_t nEnd = std::min(nStart + PREFETCH_BATCH_SIZE, vMissing.size());
+            reads.Add([nStart, nEnd, &vMissing, &vCoins, &vFound] {
+                for (size_t i = nStart; i < nEnd; i++) {
+                    try {
+                        vFound[i] = pcoinsdbview->GetCoin(vMissing[i], vCoins[i]);
+                    } catch (const std::exception&) {
+                        // left to ConnectBlock, which reads the coin again through the error catcher
+                    }
+                }
+            });
+        }
+        reads.Wait();
+    }
+
+    for (size_t i = 0; i < vMissing.size(); i++) {
+        if (vFound[i])
+            pcoinsTip->AddPrefetchedCoin(vMissing[i], std::move(vCoins[i]));
+    }
+
+    nPrefetchCached += nCached;
+    nPrefetchRead += vMissing.size();
+    LogPrint(BCLog::BENCH, "  - Prefetch inputs: %u cached, %u read [%u cached, %u read]\n", nCached, vMissing.size(), nPrefetchCached, nPrefetchRead);
+}
 static int64_t nTimeFlush = 0;
 static int64_t nTimeChainState = 0;
 static int64_t nTimePostConnect = 0;
@@ -2739,6 +3396,11 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
     int64_t nTime3;
     LogPrint(BCLog::BENCH, "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * MILLI, nTimeReadFromDisk * MICRO);
+    RecordConnectPhase(ConnectPhase::READ_BLOCK, nTime1, nTime2, pindexNew->nHeight);
+    PrefetchBlockInputs(blockConnecting);
+    int64_t nTimePrefetched = GetTimeMicros(); nTimePrefetch += nTimePrefetched - nTime2;
+    LogPrint(BCLog::BENCH, "  - Prefetch inputs: %.2fms [%.2fs]\n", (nTimePrefetched - nTime2) * MILLI, nTimePrefetch * MICRO);
+    RecordConnectPhase(ConnectPhase::PREFETCH, nTime2, nTimePrefetched, pindexNew->nHeight);
     {
         CCoinsViewCache view(pcoinsTip.get());
         bool rv = ConnectBlock(blockConnecting, state, pindexNew, view, chainparams);
@@ -2750,26 +3412,48 @@ bool CChainState::ConnectTip(CValidationState& state, const CChainParams& chainp
         }
         nTime3 = GetTimeMicros(); nTimeConnectTotal += nTime3 - nTime2;
         LogPrint(BCLog::BENCH, "  - Connect total: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime3 - nTime2) * MILLI, nTimeConnectTotal * MICRO, nTimeConnectTotal * MILLI / nBlocksTotal);
+        RecordConnectPhase(ConnectPhase::CONNECT_BLOCK, nTimePrefetched, nTime3, pindexNew->nHeight);
         bool flushed = FlushView(&view, state, false);
         assert(flushed);
     }
     int64_t nTime4 = GetTimeMicros(); nTimeFlush += nTime4 - nTime3;
     LogPrint(BCLog::BENCH, "  - Flush: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime4 - nTime3) * MILLI, nTimeFlush * MICRO, nTimeFlush * MILLI / nBlocksTotal);
+    RecordConnectPhase(ConnectPhase::FLUSH_VIEW, nTime3, nTime4, pindexNew->nHeight);
     // Write the chain state to disk, if necessary.
     if (!FlushStateToDisk(chainparams, state, FLUSH_STATE_IF_NEEDED))
         return false;
     int64_t nTime5 = GetTimeMicros(); nTimeChainState += nTime5 - nTime4;
     LogPrint(BCLog::BENCH, "  - Writing chainstate: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime5 - nTime4) * MILLI, nTimeChainState * MICRO, nTimeChainState * MILLI / nBlocksTotal);
+    RecordConnectPhase(ConnectPhase::WRITE_CHAINSTATE, nTime4, nTime5, pindexNew->nHeight);
     // Remove conflicting transactions from the mempool.;
-    mempool.removeForBlock(blockConnecting.vtx, pindexNew->nHeight);
+    // Fee estimates are not used before the chain is synced, only their height is kept up
+    mempool.removeForBlock(blockConnecting.vtx, pindexNew->nHeight, !IsInitialBlockDownload());
+    // Zerocoin spends don't conflict by prevout, drop the ones in the pool spending a serial the block spent
+    std::vector<uint256> vBlockZerocoinSerials;
+    for (const auto& tx : blockConnecting.vtx) {
+        std::vector<uint256> vSerials;
+        if (tx->IsZerocoinSpend() && GetZerocoinSpendSerialHashes(*tx, vSerials))
+            vBlockZerocoinSerials.insert(vBlockZerocoinSerials.end(), vSerials.begin(), vSerials.end());
+    }
+    if (!vBlockZerocoinSerials.empty())
+        mempool.removeZerocoinSerialConflicts(vBlockZerocoinSerials);
     disconnectpool.removeForBlock(blockConnecting.vtx);
     // Update chainActive & related variables.
     chainActive.SetTip(pindexNew);
+    UpdateChainSnapshot();
+    // Blocks older than the payment window of the best header are never looked up, the
+    // recorded window starts over when the chain gets there
+    if (!pindexBestHeader || pindexNew->nHeight + mnpayments.GetStorageLimit() >= pindexBestHeader->nHeight)
+        mnpayments.BlockConnected(blockConnecting, pindexNew);
+    mnodeman.UpdateCollaterals(blockConnecting, true);
     UpdateTip(pindexNew, chainparams);
 
     int64_t nTime6 = GetTimeMicros(); nTimePostConnect += nTime6 - nTime5; nTimeTotal += nTime6 - nTime1;
     LogPrint(BCLog::BENCH, "  - Connect postprocess: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime5) * MILLI, nTimePostConnect * MICRO, nTimePostConnect * MILLI / nBlocksTotal);
     LogPrint(BCLog::BENCH, "- Connect block: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime1) * MILLI, nTimeTotal * MICRO, nTimeTotal * MILLI / nBlocksTotal);
+    RecordConnectPhase(ConnectPhase::POST_CONNECT, nTime5, nTime6, pindexNew->nHeight);
+    RecordConnectPhase(ConnectPhase::CONNECT_TIP, nTime1, nTime6, pindexNew->nHeight);
+    MetricAdd(Metric::BLOCKS_CONNECTED);
 
     connectTrace.BlockConnected(pindexNew, std::move(pthisBlock));
     return true;
@@ -2969,12 +3653,11 @@ bool CChainState::ActivateBestChain(CValidationState &state, const CChainParams&
     do {
         boost::this_thread::interruption_point();
 
-        if (GetMainSignals().CallbacksPending() > 10) {
-            // Block until the validation queue drains. This should largely
-            // never happen in normal operation, however may happen during
-            // reindex, causing memory blowup  if we run too far ahead.
-            SyncWithValidationInterfaceQueue();
-        }
+        // Block until the subscribers over -maxvalidationqueue drain their queues.
+        // This should largely never happen in normal operation, however may happen
+        // during reindex, causing memory blowup if we run too far ahead. Best-effort
+        // subscribers drop notifications instead of holding us up.
+        GetMainSignals().WaitForSubscriberQueues();
 
         const CBlockIndex *pindexFork;
         bool fInitialDownload;
@@ -3287,6 +3970,12 @@ static bool FindBlockPos(CDiskBlockPos &pos, unsigned int nAddSize, unsigned int
     }
 
     vinfoBlockFile[nFile].AddBlock(nHeight, nTime);
+    if (!fKnown) {
+        if (!fCompressBlocks)
+            vinfoBlockFile[nFile].nFlags &= ~BLOCK_FILE_COMPRESSED;
+        else if (pos.nPos == 0)
+            vinfoBlockFile[nFile].nFlags |= BLOCK_FILE_COMPRESSED;
+    }
     if (fKnown)
         vinfoBlockFile[nFile].nSize = std::max(pos.nPos + nAddSize, vinfoBlockFile[nFile].nSize);
     else
@@ -3360,12 +4049,28 @@ static bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state,
     }
 
     // Check proof of work matches claimed amount
-    if (fCheckPOW && !CheckProofOfWork(block.GetPoWHash(nHeight), block.nBits, consensusParams))
+    if (fCheckPOW && !CheckBlockHeaderProofOfWork(block, nHeight, consensusParams))
         return state.DoS(50, false, REJECT_INVALID, "high-hash", false, "proof of work failed");
 
     return true;
 }
 
+static bool CheckBlockMerkleRoot(const CBlock& block, CValidationState& state)
+{
+    bool mutated;
+    uint256 hashMerkleRoot2 = BlockMerkleRoot(block, &mutated);
+    if (block.hashMerkleRoot != hashMerkleRoot2)
+        return state.DoS(100, false, REJECT_INVALID, "bad-txnmrklroot", true, "hashMerkleRoot mismatch");
+
+    // Check for merkle tree malleability (CVE-2012-2459): repeating sequences
+    // of transactions in a block without affecting the merkle root of a block,
+    // while still invalidating it.
+    if (mutated)
+        return state.DoS(100, false, REJECT_INVALID, "bad-txns-duplicate", true, "duplicate transaction");
+
+    return true;
+}
+
 bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::Params& consensusParams, bool fCheckPOW, bool fCheckMerkleRoot, int nHeight, bool isVerifyDB)
 {
     // These are checks that are independent of context.
@@ -3379,18 +4084,8 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
         return false;
 
     // Check the merkle root.
-    if (fCheckMerkleRoot) {
-        bool mutated;
-        uint256 hashMerkleRoot2 = BlockMerkleRoot(block, &mutated);
-        if (block.hashMerkleRoot != hashMerkleRoot2)
-            return state.DoS(100, false, REJECT_INVALID, "bad-txnmrklroot", true, "hashMerkleRoot mismatch");
-
-        // Check for merkle tree malleability (CVE-2012-2459): repeating sequences
-        // of transactions in a block without affecting the merkle root of a block,
-        // while still invalidating it.
-        if (mutated)
-            return state.DoS(100, false, REJECT_INVALID, "bad-txns-duplicate", true, "duplicate transaction");
-    }
+    if (fCheckMerkleRoot && !CheckBlockMerkleRoot(block, state))
+        return false;
 
     // All potential-corruption validation must be done before we do any
     // transaction validation, as otherwise we may mark the header as invalid
@@ -3409,23 +4104,63 @@ bool CheckBlock(const CBlock& block, CValidationState& state, const Consensus::P
         if (block.vtx[i]->IsCoinBase())
             return state.DoS(100, false, REJECT_INVALID, "bad-cb-multiple", false, "more than one coinbase");
 
+    // Check the structure of the transactions, in parallel when there are script check threads. The
+    // parallel pass only tells whether they are all valid. If one is not, the structure of each
+    // transaction is checked again right before its zerocoin checks below, so the failure reported is
+    // the same as when every transaction is checked in order.
+    std::vector<unsigned int> vSigOps(block.vtx.size(), 0);
+    bool fStructureChecked = false;
+    if (nScriptCheckThreads) {
+        CCheckQueueControl<CTxStructureCheck> control(&txstructurecheckqueue);
+        std::vector<CTxStructureCheck> vChecks;
+        vChecks.reserve(block.vtx.size());
+        for (size_t i = 0; i < block.vtx.size(); i++)
+            vChecks.emplace_back(block.vtx[i].get(), &vSigOps[i]);
+        control.Add(vChecks);
+        fStructureChecked = control.Wait();
+    }
+
     // Check transactions
     if (nHeight == INT_MAX)
         nHeight = ZerocoinGetNHeight(block.GetBlockHeader());
     if (block.zerocoinTxInfo == NULL)
         block.zerocoinTxInfo = new CZerocoinTxInfo();
-    // Check transactions
-    for (const auto& tx : block.vtx)
-        if (!CheckTransaction(*tx, state, tx->GetHash(), isVerifyDB, true, nHeight, false, block.zerocoinTxInfo))
+    // Zerocoin spend proofs of blocks below the assumed valid block are not verified again, their serials
+    // and the accumulator bookkeeping still are
+    bool fZerocoinProofs = true;
+    {
+        LOCK(cs_main);
+        BlockMap::const_iterator mi = mapBlockIndex.find(block.GetHash());
+        if (mi != mapBlockIndex.end() && IsAssumedValid(mi->second, consensusParams))
+            fZerocoinProofs = false;
+    }
+    // Check transactions. Zerocoin spend proofs of the whole block are verified in parallel
+    int64_t nTimeZerocoin = GetTimeMicros();
+    CCheckQueueControl<CZerocoinSpendCheck> control(nScriptCheckThreads && fZerocoinProofs ? &zerocoinspendcheckqueue : nullptr);
+    for (size_t i = 0; i < block.vtx.size(); i++) {
+        const CTransactionRef& tx = block.vtx[i];
+        if (!fStructureChecked) {
+            if (!CheckTransactionStructure(*tx, state, true))
+                return state.Invalid(false, state.GetRejectCode(), state.GetRejectReason(),
+                                     strprintf("Transaction check failed (tx hash %s) %s", tx->GetHash().ToString(), state.GetDebugMessage()));
+            vSigOps[i] = GetLegacySigOpCount(*tx);
+        }
+        std::vector<CZerocoinSpendCheck> vZerocoinChecks;
+        if (!CheckTransactionZerocoin(*tx, state, tx->GetHash(), isVerifyDB, nHeight, false, block.zerocoinTxInfo, nScriptCheckThreads || !fZerocoinProofs ? &vZerocoinChecks : nullptr))
             return state.Invalid(false, state.GetRejectCode(), state.GetRejectReason(),
                                  strprintf("Transaction check failed (tx hash %s) %s", tx->GetHash().ToString(), state.GetDebugMessage()));
+        control.Add(vZerocoinChecks);
+    }
+    if (!control.Wait())
+        return state.Invalid(false, REJECT_INVALID, "bad-zerocoin-spend", "zerocoin spend verification failed");
+    RecordConnectPhase(ConnectPhase::ZEROCOIN_CHECKS, nTimeZerocoin, GetTimeMicros(), nHeight);
 
     block.zerocoinTxInfo->Complete();
 
     unsigned int nSigOps = 0;
-    for (const auto& tx : block.vtx)
+    for (unsigned int nTxSigOps : vSigOps)
     {
-        nSigOps += GetLegacySigOpCount(*tx);
+        nSigOps += nTxSigOps;
     }
     if (nSigOps * WITNESS_SCALE_FACTOR > MAX_BLOCK_SIGOPS_COST)
         return state.DoS(100, false, REJECT_INVALID, "bad-blk-sigops", false, "out-of-bounds SigOpCount");
@@ -3696,6 +4431,27 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, const CBlockIndex** ppindex, CBlockHeader *first_invalid)
 {
     if (first_invalid != nullptr) first_invalid->SetNull();
+
+    // Check the proof of work of all headers in parallel before taking cs_main. Headers that pass
+    // are in the proof-of-work cache, so the serial checks below do not hash them again and find
+    // the first invalid header if there is one
+    if (nScriptCheckThreads && headers.size() > 1) {
+        int nHeight = 0;
+        {
+            LOCK(cs_main);
+            BlockMap::iterator mi = mapBlockIndex.find(headers[0].hashPrevBlock);
+            if (mi != mapBlockIndex.end())
+                nHeight = mi->second->nHeight + 1;
+        }
+        std::vector<CPoWCheck> vChecks;
+        vChecks.reserve(headers.size());
+        for (const CBlockHeader& header : headers)
+            vChecks.push_back(CPoWCheck(&header, nHeight++, &chainparams.GetConsensus()));
+        CCheckQueueControl<CPoWCheck> control(&powcheckqueue);
+        control.Add(vChecks);
+        control.Wait();
+    }
+
     {
         LOCK(cs_main);
         for (const CBlockHeader& header : headers) {
@@ -3715,7 +4471,10 @@ bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidatio
 
 /** Store block on disk. If dbp is non-nullptr, the file is known to already reside on disk */
 static CDiskBlockPos SaveBlockToDisk(const CBlock& block, int nHeight, const CChainParams& chainparams, const CDiskBlockPos* dbp) {
-    unsigned int nBlockSize = ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
+    std::vector<char> frame;
+    if (dbp == nullptr)
+        CompressRecord(block, frame);
+    unsigned int nBlockSize = frame.empty() ? ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION) : frame.size();
     CDiskBlockPos blockPos;
     if (dbp != nullptr)
         blockPos = *dbp;
@@ -3724,7 +4483,7 @@ static CDiskBlockPos SaveBlockToDisk(const CBlock& block, int nHeight, const CCh
         return CDiskBlockPos();
     }
     if (dbp == nullptr) {
-        if (!WriteBlockToDisk(block, blockPos, chainparams.MessageStart())) {
+        if (!WriteBlockToDisk(block, frame, blockPos, chainparams.MessageStart())) {
             AbortNode("Failed to write block");
             return CDiskBlockPos();
         }
@@ -3814,10 +4573,45 @@ bool CChainState::AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CVali
     return true;
 }
 
+/**
+ * With -fastblockrelay, announce a block extending the tip to high-bandwidth compact block peers once
+ * its header is known to be valid and its proof of work and merkle root are checked, ahead of
+ * CheckBlock and its zerocoin spend proofs. Peers accept compact blocks that turn out invalid from
+ * INVALID_CB_NO_BAN_VERSION on, and the peer that sent us an invalid block is still punished when it
+ * fails validation. NewPoWValidBlock announces each height once, so AcceptBlock doesn't repeat it.
+ */
+static void RelayNewBlockEarly(const CChainParams& chainparams, const std::shared_ptr<const CBlock>& pblock)
+{
+    if (!fFastBlockRelay || pblock->fChecked)
+        return;
+
+    const CBlockIndex* pindex = nullptr;
+    {
+        LOCK(cs_main);
+        if (IsInitialBlockDownload())
+            return;
+        BlockMap::const_iterator mi = mapBlockIndex.find(pblock->GetHash());
+        if (mi == mapBlockIndex.end())
+            return;
+        pindex = mi->second;
+        if ((pindex->nStatus & (BLOCK_FAILED_MASK | BLOCK_HAVE_DATA)) || !pindex->IsValid(BLOCK_VALID_TREE) ||
+            chainActive.Tip() != pindex->pprev)
+            return;
+
+        CValidationState state;
+        if (!CheckBlockHeader(*pblock, state, chainparams.GetConsensus(), true) || !CheckBlockMerkleRoot(*pblock, state))
+            return;
+    }
+
+    GetMainSignals().NewPoWValidBlock(pindex, pblock);
+}
+
 bool ProcessNewBlock(const CChainParams& chainparams, const std::shared_ptr<const CBlock> pblock, bool fForceProcessing, bool *fNewBlock)
 {
     AssertLockNotHeld(cs_main);
 
+    RelayNewBlockEarly(chainparams, pblock);
+
     {
         CBlockIndex *pindex = nullptr;
         if (fNewBlock) *fNewBlock = false;
@@ -3933,6 +4727,16 @@ void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
     }
 }
 
+/* The number of blocks below the tip that pruning keeps */
+unsigned int GetPruneMinBlocksToKeep()
+{
+    unsigned int nKeep = MIN_BLOCKS_TO_KEEP;
+    // CGhostnodePayments::IndexPaidBlocks reads back as many blocks as the payment votes are stored for
+    if (!fLiteMode)
+        nKeep = std::max(nKeep, (unsigned int)mnpayments.GetStorageLimit());
+    return nKeep;
+}
+
 /* Calculate the block/rev files to delete based on height specified by user with RPC command pruneblockchain */
 static void FindFilesToPruneManual(std::set<int>& setFilesToPrune, int nManualPruneHeight)
 {
@@ -3942,8 +4746,11 @@ static void FindFilesToPruneManual(std::set<int>& setFilesToPrune, int nManualPr
     if (chainActive.Tip() == nullptr)
         return;
 
-    // last block to prune is the lesser of (user-specified height, MIN_BLOCKS_TO_KEEP from the tip)
-    unsigned int nLastBlockWeCanPrune = std::min((unsigned)nManualPruneHeight, chainActive.Tip()->nHeight - MIN_BLOCKS_TO_KEEP);
+    // last block to prune is the lesser of (user-specified height, GetPruneMinBlocksToKeep() from the tip)
+    unsigned int nKeep = GetPruneMinBlocksToKeep();
+    if ((unsigned int)chainActive.Tip()->nHeight <= nKeep)
+        return;
+    unsigned int nLastBlockWeCanPrune = std::min((unsigned)nManualPruneHeight, chainActive.Tip()->nHeight - nKeep);
     int count=0;
     for (int fileNumber = 0; fileNumber < nLastBlockFile; fileNumber++) {
         if (vinfoBlockFile[fileNumber].nSize == 0 || vinfoBlockFile[fileNumber].nHeightLast > nLastBlockWeCanPrune)
@@ -3972,7 +4779,7 @@ void PruneBlockFilesManual(int nManualPruneHeight)
  * Pruning functions are called from FlushStateToDisk when the global fCheckForPruning flag has been set.
  * Block and undo files are deleted in lock-step (when blk00003.dat is deleted, so is rev00003.dat.)
  * Pruning cannot take place until the longest chain is at least a certain length (100000 on mainnet, 1000 on testnet, 1000 on regtest).
- * Pruning will never delete a block within a defined distance (currently 288) from the active chain's tip.
+ * Pruning will never delete a block within a defined distance (at least 288, see GetPruneMinBlocksToKeep) from the active chain's tip.
  * The block index is updated by unsetting HAVE_DATA and HAVE_UNDO for any blocks that were stored in the deleted files.
  * A db flag records the fact that at least some block files have been pruned.
  *
@@ -3988,7 +4795,12 @@ static void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfte
         return;
     }
 
-    unsigned int nLastBlockWeCanPrune = chainActive.Tip()->nHeight - MIN_BLOCKS_TO_KEEP;
+    unsigned int nKeep = GetPruneMinBlocksToKeep();
+    if ((unsigned int)chainActive.Tip()->nHeight <= nKeep) {
+        return;
+    }
+
+    unsigned int nLastBlockWeCanPrune = chainActive.Tip()->nHeight - nKeep;
     uint64_t nCurrentUsage = CalculateCurrentUsage();
     // We don't check to prune until after we've allocated new space for files
     // So we should leave a buffer under our target to account for another allocation
@@ -4007,7 +4819,7 @@ static void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfte
             if (nCurrentUsage + nBuffer < nPruneTarget)  // are we below our target?
                 break;
 
-            // don't prune files that could have a block within MIN_BLOCKS_TO_KEEP of the main chain's tip but keep scanning
+            // don't prune files that could have a block within nKeep of the main chain's tip but keep scanning
             if (vinfoBlockFile[fileNumber].nHeightLast > nLastBlockWeCanPrune)
                 continue;
 
@@ -4093,7 +4905,7 @@ CBlockIndex * CChainState::InsertBlockIndex(const uint256& hash)
 
 bool CChainState::LoadBlockIndex(const Consensus::Params& consensus_params, CBlockTreeDB& blocktree)
 {
-    if (!blocktree.LoadBlockIndexGuts(consensus_params, [this](const uint256& hash){ return this->InsertBlockIndex(hash); }))
+    if (!blocktree.LoadBlockIndexGuts(consensus_params, [this](const uint256& hash){ return this->InsertBlockIndex(hash); }, pzerocoindb.get()))
         return false;
 
     boost::this_thread::interruption_point();
@@ -4143,6 +4955,210 @@ bool CChainState::LoadBlockIndex(const Consensus::Params& consensus_params, CBlo
     return true;
 }
 
+/** The file a block file is rewritten to before it replaces it */
+static fs::path GetBlockFileTmpPath(int nFile)
+{
+    return GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk").string() + ".tmp";
+}
+
+/** Add the transaction index entries of block that point to it at nOldPos in nFile, moved to nNewPos, to vTxPos */
+static void AddMovedTxIndex(const CBlock& block, int nFile, unsigned int nOldPos, unsigned int nNewPos, std::vector<std::pair<uint256, CDiskTxPos> >& vTxPos)
+{
+    CDiskTxPos pos(CDiskBlockPos(nFile, nNewPos), GetSizeOfCompactSize(block.vtx.size()));
+    for (const CTransactionRef& tx : block.vtx) {
+        CDiskTxPos posOld;
+        if (pblocktree->ReadTxIndex(tx->GetHash(), posOld) && posOld.nFile == nFile && posOld.nPos == nOldPos)
+            vTxPos.push_back(std::make_pair(tx->GetHash(), pos));
+        pos.nTxOffset += tx->GetTotalSize();
+    }
+}
+
+/** Find the new position of every block stored in the file of move, fails if one was left out */
+static bool FindMovedBlocks(const CBlockFileMove& move, std::vector<std::pair<CBlockIndex*, unsigned int> >& vBlocks)
+{
+    AssertLockHeld(cs_main);
+    std::map<unsigned int, unsigned int> mapMoved(move.vMoved.begin(), move.vMoved.end());
+    for (const std::pair<uint256, CBlockIndex*>& item : mapBlockIndex) {
+        CBlockIndex* pindex = item.second;
+        if (pindex->nFile != move.nFile || !(pindex->nStatus & BLOCK_HAVE_DATA))
+            continue;
+        std::map<unsigned int, unsigned int>::const_iterator it = mapMoved.find(pindex->nDataPos);
+        if (it == mapMoved.end())
+            return error("%s: Block %s was not moved", __func__, pindex->GetBlockHash().ToString());
+        vBlocks.push_back(std::make_pair(pindex, it->second));
+    }
+    return true;
+}
+
+/**
+ * Point the block index to the moved blocks found by FindMovedBlocks, and the transaction index with
+ * the entries in pvTxPos or, if null, the ones found by reading the moved blocks. Erases the journal
+ * entry of the move along.
+ */
+static bool FinishBlockFileMove(const CBlockFileMove& move, const std::vector<std::pair<CBlockIndex*, unsigned int> >& vMovedBlocks, const std::vector<std::pair<uint256, CDiskTxPos> >* pvTxPos)
+{
+    AssertLockHeld(cs_main);
+    LOCK(cs_LastBlockFile);
+
+    if (move.nFile < 0 || move.nFile >= (int)vinfoBlockFile.size())
+        return error("%s: Unknown block file %d", __func__, move.nFile);
+
+    std::vector<const CBlockIndex*> vBlocks;
+    std::vector<std::pair<uint256, CDiskTxPos> > vTxPos;
+    for (const std::pair<CBlockIndex*, unsigned int>& moved : vMovedBlocks) {
+        CBlockIndex* pindex = moved.first;
+        unsigned int nOldPos = pindex->nDataPos;
+        pindex->nDataPos = moved.second;
+        vBlocks.push_back(pindex);
+        if (fTxIndex && !pvTxPos) {
+            CBlock block;
+            if (!ReadBlockFromDisk(block, pindex, Params().GetConsensus()))
+                return error("%s: Failed to read moved block %s", __func__, pindex->GetBlockHash().ToString());
+            AddMovedTxIndex(block, move.nFile, nOldPos, moved.second, vTxPos);
+        }
+    }
+
+    vinfoBlockFile[move.nFile].nSize = move.nSize;
+    vinfoBlockFile[move.nFile].nFlags |= BLOCK_FILE_COMPRESSED;
+    if (!pblocktree->FinishBlockFileMove(move, vinfoBlockFile[move.nFile], vBlocks, pvTxPos ? *pvTxPos : vTxPos))
+        return error("%s: Failed to write the moved blocks", __func__);
+    return true;
+}
+
+/**
+ * Rewrite finished block file nFile with its blocks compressed into a temporary file, which then
+ * replaces it. The new positions of the blocks are journaled in the block tree database before,
+ * so a move interrupted before the indexes point to them is completed on the next start.
+ */
+static bool CompressBlockFile(const CChainParams& chainparams, int nFile)
+{
+    unsigned int nFileSize;
+    {
+        LOCK(cs_LastBlockFile);
+        if (nFile >= nLastBlockFile || vinfoBlockFile[nFile].nSize == 0 || (vinfoBlockFile[nFile].nFlags & BLOCK_FILE_COMPRESSED))
+            return true;
+        nFileSize = vinfoBlockFile[nFile].nSize;
+    }
+
+    FILE* file = OpenBlockFile(CDiskBlockPos(nFile, 0), true);
+    if (!file)
+        return false;
+    fs::path pathTmp = GetBlockFileTmpPath(nFile);
+    CAutoFile fileout(fsbridge::fopen(pathTmp, "wb"), SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull()) {
+        fclose(file);
+        return error("%s: Failed to open %s", __func__, pathTmp.string());
+    }
+
+    CMessageHeader::MessageStartChars compressedStart;
+    GetCompressedMessageStart(chainparams.MessageStart(), compressedStart);
+    CBlockFileMove move;
+    move.nFile = nFile;
+    std::vector<std::pair<uint256, CDiskTxPos> > vTxPos;
+    bool fChanged = false;
+    {
+        // This takes over file and calls fclose() on it in the CBufferedFile destructor
+        CBufferedFile blkdat(file, 2*MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE+8, SER_DISK, CLIENT_VERSION);
+        uint64_t nRewind = 0;
+        while (nRewind < nFileSize) {
+            boost::this_thread::interruption_point();
+
+            // Locate the next block as LoadExternalBlockFile does
+            blkdat.SetPos(nRewind);
+            nRewind++;
+            unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
+            unsigned int nSize = 0;
+            try {
+                blkdat.FindByte(chainparams.MessageStart()[0]);
+                nRewind = blkdat.GetPos()+1;
+                blkdat >> FLATDATA(buf) >> nSize;
+            } catch (const std::exception&) {
+                break;
+            }
+            bool fCompressed = IsCompressedMessageStart(buf, chainparams.MessageStart());
+            if (!fCompressed && memcmp(buf, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE))
+                continue;
+            if (nSize < (fCompressed ? COMPRESSED_FRAME_HEADER_SIZE : 80) || nSize > MAX_BLOCK_SERIALIZED_SIZE)
+                continue;
+            unsigned int nOldPos = blkdat.GetPos();
+            if (nOldPos + nSize > nFileSize)
+                break;
+
+            std::vector<char> data(nSize);
+            std::vector<char> frame;
+            CBlock block;
+            try {
+                blkdat.read(data.data(), nSize);
+                CDataStream stream(SER_DISK, CLIENT_VERSION);
+                if (fCompressed) {
+                    DecompressFrame(data.data(), nSize, stream, MAX_BLOCK_SERIALIZED_SIZE);
+                } else {
+                    stream.write(data.data(), nSize);
+                    fChanged |= CompressFrame(data.data(), nSize, frame);
+                }
+                stream >> block;
+            } catch (const std::exception& e) {
+                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+                continue;
+            }
+            nRewind = blkdat.GetPos();
+
+            const std::vector<char>& record = frame.empty() ? data : frame;
+            fileout.write((const char*)(fCompressed || !frame.empty() ? compressedStart : chainparams.MessageStart()), CMessageHeader::MESSAGE_START_SIZE);
+            fileout << (unsigned int)record.size();
+            fileout.write(record.data(), record.size());
+            move.vMoved.push_back(std::make_pair(nOldPos, move.nSize + 8));
+            if (fTxIndex)
+                AddMovedTxIndex(block, nFile, nOldPos, move.nSize + 8, vTxPos);
+            move.nSize += 8 + record.size();
+        }
+    }
+
+    if (!fChanged) {
+        // Nothing to compress, the file stays as it is
+        fileout.fclose();
+        fs::remove(pathTmp);
+        LOCK(cs_LastBlockFile);
+        vinfoBlockFile[nFile].nFlags |= BLOCK_FILE_COMPRESSED;
+        setDirtyFileInfo.insert(nFile);
+        return true;
+    }
+    FileCommit(fileout.Get());
+    fileout.fclose();
+
+    LOCK(cs_main);
+    std::vector<std::pair<CBlockIndex*, unsigned int> > vMovedBlocks;
+    if (!FindMovedBlocks(move, vMovedBlocks)) {
+        fs::remove(pathTmp);
+        return false;
+    }
+    if (!pblocktree->WriteBlockFileMove(move))
+        return error("%s: Failed to journal the move of blk%05u.dat", __func__, nFile);
+    if (!RenameOver(pathTmp, GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk"))) {
+        pblocktree->EraseBlockFileMove();
+        return error("%s: Failed to replace blk%05u.dat", __func__, nFile);
+    }
+    if (!FinishBlockFileMove(move, vMovedBlocks, &vTxPos))
+        return AbortNode("Failed to write the index of a compressed block file");
+    LogPrintf("Compressed block file blk%05u.dat from %u to %u bytes\n", nFile, nFileSize, move.nSize);
+    return true;
+}
+
+void CompressBlockFiles(const CChainParams& chainparams)
+{
+    int nFiles;
+    {
+        LOCK(cs_LastBlockFile);
+        nFiles = nLastBlockFile;
+    }
+    for (int nFile = 0; nFile < nFiles; nFile++) {
+        if (!CompressBlockFile(chainparams, nFile)) {
+            LogPrintf("%s: Failed to compress block file blk%05u.dat\n", __func__, nFile);
+            return;
+        }
+    }
+}
+
 bool static LoadBlockIndexDB(const CChainParams& chainparams)
 {
     if (!g_chainstate.LoadBlockIndex(chainparams.GetConsensus(), *pblocktree))
@@ -4197,17 +5213,22 @@ bool static LoadBlockIndexDB(const CChainParams& chainparams)
     pblocktree->ReadFlag("txindex", fTxIndex);
     LogPrintf("%s: transaction index %s\n", __func__, fTxIndex ? "enabled" : "disabled");
 
-    // Check whether we have an address index
-    pblocktree->ReadFlag("addressindex", fAddressIndex);
-    LogPrintf("%s: address index %s\n", __func__, fAddressIndex ? "enabled" : "disabled");
-
-    // Check whether we have a timestamp index
-    pblocktree->ReadFlag("timestampindex", fTimestampIndex);
-    LogPrintf("%s: timestamp index %s\n", __func__, fTimestampIndex ? "enabled" : "disabled");
-
-    // Check whether we have a spent index
-    pblocktree->ReadFlag("spentindex", fSpentIndex);
-    LogPrintf("%s: spent index %s\n", __func__, fSpentIndex ? "enabled" : "disabled");
+    // Complete the compression of a block file that was interrupted after replacing the file, or
+    // drop it if it was interrupted before
+    CBlockFileMove move;
+    if (pblocktree->ReadBlockFileMove(move)) {
+        fs::path pathTmp = GetBlockFileTmpPath(move.nFile);
+        if (fs::exists(pathTmp)) {
+            fs::remove(pathTmp);
+            pblocktree->EraseBlockFileMove();
+        } else {
+            LogPrintf("%s: completing the compression of block file blk%05u.dat\n", __func__, move.nFile);
+            LOCK(cs_main);
+            std::vector<std::pair<CBlockIndex*, unsigned int> > vMovedBlocks;
+            if (!FindMovedBlocks(move, vMovedBlocks) || !FinishBlockFileMove(move, vMovedBlocks, nullptr))
+                return false;
+        }
+    }
 
 
 
@@ -4233,6 +5254,7 @@ bool LoadChainTip(const CChainParams& chainparams)
     if (it == mapBlockIndex.end())
         return false;
     chainActive.SetTip(it->second);
+    UpdateChainSnapshot();
 
     g_chainstate.PruneBlockIndexCandidates();
 
@@ -4253,7 +5275,67 @@ CVerifyDB::~CVerifyDB()
     uiInterface.ShowProgress("", 100, false);
 }
 
-bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview, int nCheckLevel, int nCheckDepth)
+/** Number of blocks the verifier reads and checks ahead of the serial steps */
+static const size_t VERIFYDB_READ_AHEAD = 16;
+
+/** A block read ahead by the verifier, with the outcome of its context-free checks */
+struct CVerifyDBBlock {
+    CBlockIndex* pindex;
+    CBlock block;
+    CValidationState state;
+    bool fRead;
+    bool fUndo;
+
+    explicit CVerifyDBBlock(CBlockIndex* pindexIn) : pindex(pindexIn), fRead(false), fUndo(true) {}
+};
+
+/**
+ * Read the blocks in parallel and do the checks of nCheckLevel that don't depend on the chain state:
+ * the proof of work, the merkle root and the undo data. The caller holds cs_main while the tasks run,
+ * so they only use the block index entries and must not take it.
+ */
+static void ReadVerifyDBBlocks(std::vector<CVerifyDBBlock>& vBlocks, int nCheckLevel, const Consensus::Params& consensusParams)
+{
+    AssertLockHeld(cs_main);
+
+    libzerocoin::ParallelTasks::DoNotDisturb dnd;
+    libzerocoin::ParallelTasks reads(vBlocks.size());
+    for (CVerifyDBBlock& entry : vBlocks) {
+        reads.Add([&entry, nCheckLevel, &consensusParams] {
+            const CBlockIndex* pindex = entry.pindex;
+            // check level 0: read from disk, which also checks the proof of work
+            if (!ReadBlockFromDisk(entry.block, pindex->GetBlockPos(), pindex->nHeight, consensusParams) ||
+                    entry.block.GetHash() != pindex->GetBlockHash())
+                return;
+            entry.fRead = true;
+            // check level 1: the context-free part of the block validity
+            if (nCheckLevel >= 1)
+                CheckBlockMerkleRoot(entry.block, entry.state);
+            // check level 2: verify undo validity
+            if (nCheckLevel >= 2 && !pindex->GetUndoPos().IsNull()) {
+                CBlockUndo undo;
+                entry.fUndo = UndoReadFromDisk(undo, pindex);
+            }
+        });
+    }
+    reads.Wait();
+}
+
+/** Check the blocks read ahead in order, the part of CheckBlock that uses the zerocoin state is not done in parallel */
+static bool CheckVerifyDBBlock(CVerifyDBBlock& entry, int nCheckLevel, const Consensus::Params& consensusParams)
+{
+    const CBlockIndex* pindex = entry.pindex;
+    if (!entry.fRead)
+        return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+    if (nCheckLevel >= 1 && (!entry.state.IsValid() || !CheckBlock(entry.block, entry.state, consensusParams, false, false, pindex->nHeight, true)))
+        return error("%s: *** found bad block at %d, hash=%s (%s)\n", __func__,
+                     pindex->nHeight, pindex->GetBlockHash().ToString(), FormatStateMessage(entry.state));
+    if (!entry.fUndo)
+        return error("VerifyDB(): *** found bad undo data at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
+    return true;
+}
+
+bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview, int nCheckLevel, int nCheckDepth, int nSampleBlocks)
 {
     LOCK(cs_main);
     if (chainActive.Tip() == nullptr || chainActive.Tip()->pprev == nullptr)
@@ -4271,73 +5353,110 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
     CValidationState state;
     int reportDone = 0;
     LogPrintf("[0%%]...");
-    for (CBlockIndex* pindex = chainActive.Tip(); pindex && pindex->pprev; pindex = pindex->pprev)
+    CBlockIndex* pindex = chainActive.Tip();
+    bool fDone = false;
+    while (!fDone && pindex && pindex->pprev)
     {
-        boost::this_thread::interruption_point();
-        int percentageDone = std::max(1, std::min(99, (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100))));
-        if (reportDone < percentageDone/10) {
-            // report every 10% step
-            LogPrintf("[%d%%]...", percentageDone);
-            reportDone = percentageDone/10;
-        }
-        uiInterface.ShowProgress(_("Verifying blocks..."), percentageDone, false);
-        if (pindex->nHeight < chainActive.Height()-nCheckDepth)
-            break;
-        if (fPruneMode && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
-            // If pruning, only go back as far as we have data.
-            LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
-            break;
-        }
-        CBlock block;
-        // check level 0: read from disk
-        if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
-            return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
-        // check level 1: verify block validity
-        if (nCheckLevel >= 1 && !CheckBlock(block, state, chainparams.GetConsensus(), true, true, pindex->nHeight, true))
-            return error("%s: *** found bad block at %d, hash=%s (%s)\n", __func__,
-                         pindex->nHeight, pindex->GetBlockHash().ToString(), FormatStateMessage(state));
-        // check level 2: verify undo validity
-        if (nCheckLevel >= 2 && pindex) {
-            CBlockUndo undo;
-            if (!pindex->GetUndoPos().IsNull()) {
-                if (!UndoReadFromDisk(undo, pindex)) {
-                    return error("VerifyDB(): *** found bad undo data at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
-                }
+        // Read and check the next blocks ahead, up to where the verification stops
+        std::vector<CVerifyDBBlock> vBlocks;
+        vBlocks.reserve(VERIFYDB_READ_AHEAD);
+        for (; pindex && pindex->pprev && vBlocks.size() < VERIFYDB_READ_AHEAD; pindex = pindex->pprev) {
+            if (pindex->nHeight < chainActive.Height()-nCheckDepth) {
+                fDone = true;
+                break;
             }
+            if (fPruneMode && !(pindex->nStatus & BLOCK_HAVE_DATA)) {
+                // If pruning, only go back as far as we have data.
+                LogPrintf("VerifyDB(): block verification stopping at height %d (pruning, no data)\n", pindex->nHeight);
+                fDone = true;
+                break;
+            }
+            vBlocks.emplace_back(pindex);
         }
-        // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
-        if (nCheckLevel >= 3 && pindex == pindexState && (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
-            assert(coins.GetBestBlock() == pindex->GetBlockHash());
-            DisconnectResult res = g_chainstate.DisconnectBlock(block, pindex, coins);
-            if (res == DISCONNECT_FAILED) {
-                return error("VerifyDB(): *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+        ReadVerifyDBBlocks(vBlocks, nCheckLevel, chainparams.GetConsensus());
+
+        for (CVerifyDBBlock& entry : vBlocks) {
+            boost::this_thread::interruption_point();
+            int percentageDone = std::max(1, std::min(99, (int)(((double)(chainActive.Height() - entry.pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100))));
+            if (reportDone < percentageDone/10) {
+                // report every 10% step
+                LogPrintf("[%d%%]...", percentageDone);
+                reportDone = percentageDone/10;
             }
-            pindexState = pindex->pprev;
-            if (res == DISCONNECT_UNCLEAN) {
-                nGoodTransactions = 0;
-                pindexFailure = pindex;
-            } else {
-                nGoodTransactions += block.vtx.size();
+            uiInterface.ShowProgress(_("Verifying blocks..."), percentageDone, false);
+            if (!CheckVerifyDBBlock(entry, nCheckLevel, chainparams.GetConsensus()))
+                return false;
+            // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
+            if (nCheckLevel >= 3 && entry.pindex == pindexState && (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
+                assert(coins.GetBestBlock() == entry.pindex->GetBlockHash());
+                DisconnectResult res = g_chainstate.DisconnectBlock(entry.block, entry.pindex, coins);
+                if (res == DISCONNECT_FAILED) {
+                    return error("VerifyDB(): *** irrecoverable inconsistency in block data at %d, hash=%s", entry.pindex->nHeight, entry.pindex->GetBlockHash().ToString());
+                }
+                pindexState = entry.pindex->pprev;
+                if (res == DISCONNECT_UNCLEAN) {
+                    nGoodTransactions = 0;
+                    pindexFailure = entry.pindex;
+                } else {
+                    nGoodTransactions += entry.block.vtx.size();
+                }
             }
+            if (ShutdownRequested())
+                return true;
         }
-        if (ShutdownRequested())
-            return true;
     }
     if (pindexFailure)
         return error("VerifyDB(): *** coin database inconsistencies found (last %i blocks, %i good transactions before that)\n", chainActive.Height() - pindexFailure->nHeight + 1, nGoodTransactions);
 
-    // check level 4: try reconnecting blocks
+    // check level 4: try reconnecting blocks, reading the next ones ahead while they are connected
     if (nCheckLevel >= 4) {
-        CBlockIndex *pindex = pindexState;
-        while (pindex != chainActive.Tip()) {
-            boost::this_thread::interruption_point();
-            uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, 100 - (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * 50))), false);
-            pindex = chainActive.Next(pindex);
-            CBlock block;
-            if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
-                return error("VerifyDB(): *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
-            if (!g_chainstate.ConnectBlock(block, state, pindex, coins, chainparams))
-                return error("VerifyDB(): *** found unconnectable block at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+        CBlockIndex *pindexNext = chainActive.Next(pindexState);
+        while (pindexNext) {
+            std::vector<CVerifyDBBlock> vBlocks;
+            vBlocks.reserve(VERIFYDB_READ_AHEAD);
+            for (; pindexNext && vBlocks.size() < VERIFYDB_READ_AHEAD; pindexNext = chainActive.Next(pindexNext))
+                vBlocks.emplace_back(pindexNext);
+            ReadVerifyDBBlocks(vBlocks, 0, chainparams.GetConsensus());
+
+            for (CVerifyDBBlock& entry : vBlocks) {
+                boost::this_thread::interruption_point();
+                uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, 100 - (int)(((double)(chainActive.Height() - entry.pindex->nHeight)) / (double)nCheckDepth * 50))), false);
+                if (!CheckVerifyDBBlock(entry, 0, chainparams.GetConsensus()))
+                    return false;
+                if (!g_chainstate.ConnectBlock(entry.block, state, entry.pindex, coins, chainparams))
+                    return error("VerifyDB(): *** found unconnectable block at %d, hash=%s", entry.pindex->nHeight, entry.pindex->GetBlockHash().ToString());
+            }
+        }
+    }
+
+    // Blocks picked at random below the ones verified above, which go down to nSampleHeight itself.
+    // They can't be disconnected from the coins, so they are checked at level 2 at most.
+    int nSampleHeight = chainActive.Height() - nCheckDepth;
+    if (nSampleBlocks > 0 && nSampleHeight > 1) {
+        int nSampleLevel = std::min(2, nCheckLevel);
+        nSampleBlocks = std::min(nSampleBlocks, nSampleHeight - 1);
+        LogPrintf("Verifying %i blocks below height %i at level %i\n", nSampleBlocks, nSampleHeight, nSampleLevel);
+        std::set<int> setHeights;
+        while ((int)setHeights.size() < nSampleBlocks)
+            setHeights.insert(1 + GetRand(nSampleHeight - 1));
+
+        std::vector<CVerifyDBBlock> vBlocks;
+        for (std::set<int>::const_iterator it = setHeights.begin(); it != setHeights.end(); ) {
+            CBlockIndex* pindexSample = chainActive[*it++];
+            if (pindexSample->nStatus & BLOCK_HAVE_DATA)
+                vBlocks.emplace_back(pindexSample);
+            if (vBlocks.size() < VERIFYDB_READ_AHEAD && it != setHeights.end())
+                continue;
+
+            ReadVerifyDBBlocks(vBlocks, nSampleLevel, chainparams.GetConsensus());
+            for (CVerifyDBBlock& entry : vBlocks) {
+                boost::this_thread::interruption_point();
+                if (!CheckVerifyDBBlock(entry, nSampleLevel, chainparams.GetConsensus()))
+                    return false;
+            }
+            vBlocks.clear();
+            if (ShutdownRequested())
+                return true;
         }
     }
 
@@ -4345,7 +5464,7 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
     set<CBlockIndex *> changes;
     ZerocoinBuildStateFromIndex(&chainActive, changes);
     if (!changes.empty()) {
-        setDirtyBlockIndex.insert(changes.begin(), changes.end());
+        setDirtyBlockZerocoin.insert(changes.begin(), changes.end());
         FlushStateToDisk();
     }
 
@@ -4562,6 +5681,7 @@ void UnloadBlockIndex()
 {
     LOCK(cs_main);
     chainActive.SetTip(nullptr);
+    UpdateChainSnapshot();
     pindexBestInvalid = nullptr;
     pindexBestHeader = nullptr;
     mempool.clear();
@@ -4569,6 +5689,7 @@ void UnloadBlockIndex()
     vinfoBlockFile.clear();
     nLastBlockFile = 0;
     setDirtyBlockIndex.clear();
+    setDirtyBlockZerocoin.clear();
     setDirtyFileInfo.clear();
     versionbitscache.Clear();
     for (int b = 0; b < VERSIONBITS_NUM_BITS; b++) {
@@ -4584,6 +5705,21 @@ void UnloadBlockIndex()
     g_chainstate.UnloadBlockIndex();
 }
 
+size_t BlockIndexDynamicMemoryUsage()
+{
+    LOCK(cs_main);
+    size_t usage = memusage::DynamicUsage(mapBlockIndex) + memusage::MallocUsage(sizeof(CBlockIndex)) * mapBlockIndex.size();
+    for (const BlockMap::value_type& entry : mapBlockIndex) {
+        const CBlockIndex* pindex = entry.second;
+        usage += memusage::DynamicUsage(pindex->accumulatorChanges) + memusage::DynamicUsage(pindex->spentSerials);
+        for (const auto& accUpdate : pindex->accumulatorChanges)
+            usage += BigNumDynamicUsage(accUpdate.second.first);
+        for (const CBigNum& serial : pindex->spentSerials)
+            usage += BigNumDynamicUsage(serial);
+    }
+    return usage;
+}
+
 bool LoadBlockIndex(const CChainParams& chainparams)
 {
     // Load block index from databases
@@ -4606,21 +5742,6 @@ bool LoadBlockIndex(const CChainParams& chainparams)
         fTxIndex = gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX);
         pblocktree->WriteFlag("txindex", fTxIndex);
         LogPrintf("%s: transaction index %s\n", __func__, fTxIndex ? "enabled" : "disabled");
-
-        // Use the provided setting for -addressindex in the new database
-        fAddressIndex = gArgs.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
-        pblocktree->WriteFlag("addressindex", fAddressIndex);
-        LogPrintf("%s: address index %s\n", __func__, fAddressIndex ? "enabled" : "disabled");
-
-        // Use the provided setting for -timestampindex in the new database
-        fTimestampIndex = gArgs.GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
-        pblocktree->WriteFlag("timestampindex", fTimestampIndex);
-        LogPrintf("%s: timestamp index %s\n", __func__, fTimestampIndex ? "enabled" : "disabled");
-
-        // Use the provided setting for -spentindex in the new database
-        fSpentIndex = gArgs.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
-        pblocktree->WriteFlag("spentindex", fSpentIndex);
-        LogPrintf("%s: spent index %s\n", __func__, fSpentIndex ? "enabled" : "disabled");
     }
     return true;
 }
@@ -4657,116 +5778,212 @@ bool LoadGenesisBlock(const CChainParams& chainparams)
     return g_chainstate.LoadGenesisBlock(chainparams);
 }
 
+/** Number of blocks read ahead from a block file while the proof of work of the previous ones is checked */
+static const unsigned int IMPORT_POW_BATCH_SIZE = 64;
+
+namespace {
+/** A block read from a block file, waiting to be accepted */
+struct CImportedBlock
+{
+    std::shared_ptr<CBlock> pblock;
+    uint256 hash;
+    CDiskBlockPos pos;
+    //! Height derived from the parent, or -1 if the parent was not known when the block was read
+    int nHeight;
+};
+}
+
+/** Accept a block read from a block file, then the earlier read blocks that were waiting for it. Returns false to stop the import */
+static bool ImportBlock(const CChainParams& chainparams, CImportedBlock& imported, CDiskBlockPos* dbp,
+                        std::multimap<uint256, CDiskBlockPos>& mapBlocksUnknownParent, int& nLoaded)
+{
+    const std::shared_ptr<CBlock>& pblock = imported.pblock;
+    const CBlock& block = *pblock;
+    const uint256& hash = imported.hash;
+
+    // detect out of order blocks, and store them for later
+    if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
+        LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
+                block.hashPrevBlock.ToString());
+        if (dbp)
+            mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+        return true;
+    }
+
+    // process in case the block isn't known yet
+    if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
+        LOCK(cs_main);
+        CValidationState state;
+        if (g_chainstate.AcceptBlock(pblock, state, chainparams, nullptr, true, dbp, nullptr))
+            nLoaded++;
+        if (state.IsError())
+            return false;
+    } else if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
+        LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
+    }
+
+    // Activate the genesis block so normal node progress can continue
+    if (hash == chainparams.GetConsensus().hashGenesisBlock) {
+        CValidationState state;
+        if (!ActivateBestChain(state, chainparams)) {
+            return false;
+        }
+    }
+
+    NotifyHeaderTip();
+
+    // Recursively process earlier encountered successors of this block
+    std::deque<uint256> queue;
+    queue.push_back(hash);
+    while (!queue.empty()) {
+        uint256 head = queue.front();
+        queue.pop_front();
+        std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+        while (range.first != range.second) {
+            std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
+            std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
+            BlockMap::iterator miParent = mapBlockIndex.find(head);
+            const int nHeight = miParent != mapBlockIndex.end() ? miParent->second->nHeight + 1 : 0;
+            if (ReadBlockFromDisk(*pblockrecursive, it->second, nHeight, chainparams.GetConsensus()))
+            {
+                LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
+                        head.ToString());
+                LOCK(cs_main);
+                CValidationState dummy;
+                if (g_chainstate.AcceptBlock(pblockrecursive, dummy, chainparams, nullptr, true, &it->second, nullptr))
+                {
+                    nLoaded++;
+                    queue.push_back(pblockrecursive->GetHash());
+                }
+            }
+            range.first++;
+            mapBlocksUnknownParent.erase(it);
+            NotifyHeaderTip();
+        }
+    }
+    return true;
+}
+
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp)
 {
     // Map of disk positions for blocks with unknown parent (only used for reindex)
     static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
     int64_t nStart = GetTimeMillis();
 
+    AdviseSequentialRead(fileIn);
+
+    // Blocks are read and deserialized in file order on this thread. The proof of work of each
+    // batch is checked by the proof-of-work threads while the next batch is read, AcceptBlock
+    // then finds the results in the proof-of-work cache and accepts the blocks in file order.
+    std::vector<CImportedBlock> vBatch;
+    std::vector<CImportedBlock> vNext;
+    vBatch.reserve(IMPORT_POW_BATCH_SIZE);
+    vNext.reserve(IMPORT_POW_BATCH_SIZE);
+    // Heights of the blocks read from this file, their parents may not be accepted yet
+    std::map<uint256, int> mapReadHeights;
+
     int nLoaded = 0;
     try {
         // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
         CBufferedFile blkdat(fileIn, 2*MAX_BLOCK_SERIALIZED_SIZE, MAX_BLOCK_SERIALIZED_SIZE+8, SER_DISK, CLIENT_VERSION);
         uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
+        bool fEof = false;
+        while (!fEof || !vBatch.empty()) {
             boost::this_thread::interruption_point();
 
-            blkdat.SetPos(nRewind);
-            nRewind++; // start one byte further next time, in case of failure
-            blkdat.SetLimit(); // remove former limit
-            unsigned int nSize = 0;
-            try {
-                // locate a header
-                unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
-                blkdat.FindByte(chainparams.MessageStart()[0]);
-                nRewind = blkdat.GetPos()+1;
-                blkdat >> FLATDATA(buf);
-                if (memcmp(buf, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE))
-                    continue;
-                // read size
-                blkdat >> nSize;
-                if (nSize < 80 || nSize > MAX_BLOCK_SERIALIZED_SIZE)
-                    continue;
-            } catch (const std::exception&) {
-                // no valid block header found; don't complain
-                break;
-            }
-            try {
-                // read block
-                uint64_t nBlockPos = blkdat.GetPos();
-                if (dbp)
-                    dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                blkdat.SetPos(nBlockPos);
-                std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-                CBlock& block = *pblock;
-                blkdat >> block;
-                nRewind = blkdat.GetPos();
-
-                // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
-                if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
-                    LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                            block.hashPrevBlock.ToString());
-                    if (dbp)
-                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
-                    continue;
-                }
-
-                // process in case the block isn't known yet
-                if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
-                    LOCK(cs_main);
-                    CValidationState state;
-                    if (g_chainstate.AcceptBlock(pblock, state, chainparams, nullptr, true, dbp, nullptr))
-                        nLoaded++;
-                    if (state.IsError())
-                        break;
-                } else if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
-                    LogPrint(BCLog::REINDEX, "Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
+            {
+                std::vector<CPoWCheck> vChecks;
+                vChecks.reserve(vBatch.size());
+                for (const CImportedBlock& imported : vBatch) {
+                    if (imported.nHeight >= 0)
+                        vChecks.push_back(CPoWCheck(imported.pblock.get(), imported.nHeight, &chainparams.GetConsensus()));
                 }
-
-                // Activate the genesis block so normal node progress can continue
-                if (hash == chainparams.GetConsensus().hashGenesisBlock) {
-                    CValidationState state;
-                    if (!ActivateBestChain(state, chainparams)) {
+                CCheckQueueControl<CPoWCheck> control(nScriptCheckThreads && !vChecks.empty() ? &powcheckqueue : nullptr);
+                control.Add(vChecks);
+
+                while (!fEof && vNext.size() < IMPORT_POW_BATCH_SIZE && !blkdat.eof()) {
+                    boost::this_thread::interruption_point();
+
+                    blkdat.SetPos(nRewind);
+                    nRewind++; // start one byte further next time, in case of failure
+                    blkdat.SetLimit(); // remove former limit
+                    unsigned int nSize = 0;
+                    bool fCompressed = false;
+                    try {
+                        // locate a header, of an uncompressed or a compressed block
+                        unsigned char buf[CMessageHeader::MESSAGE_START_SIZE];
+                        blkdat.FindByte(chainparams.MessageStart()[0]);
+                        nRewind = blkdat.GetPos()+1;
+                        blkdat >> FLATDATA(buf);
+                        fCompressed = IsCompressedMessageStart(buf, chainparams.MessageStart());
+                        if (!fCompressed && memcmp(buf, chainparams.MessageStart(), CMessageHeader::MESSAGE_START_SIZE))
+                            continue;
+                        // read size
+                        blkdat >> nSize;
+                        if (nSize < (fCompressed ? COMPRESSED_FRAME_HEADER_SIZE : 80) || nSize > MAX_BLOCK_SERIALIZED_SIZE)
+                            continue;
+                    } catch (const std::exception&) {
+                        // no valid block header found; don't complain
+                        fEof = true;
                         break;
                     }
-                }
-
-                NotifyHeaderTip();
-
-                // Recursively process earlier encountered successors of this block
-                std::deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
-                        std::shared_ptr<CBlock> pblockrecursive = std::make_shared<CBlock>();
-                        const uint256 hash = pblockrecursive->GetHash();
-                        const int nHeight = mapBlockIndex[hash]->nHeight;
-                        if (ReadBlockFromDisk(*pblockrecursive, it->second, nHeight, chainparams.GetConsensus()))
-                        {
-                            LogPrint(BCLog::REINDEX, "%s: Processing out of order child %s of %s\n", __func__, pblockrecursive->GetHash().ToString(),
-                                    head.ToString());
-                            LOCK(cs_main);
-                            CValidationState dummy;
-                            if (g_chainstate.AcceptBlock(pblockrecursive, dummy, chainparams, nullptr, true, &it->second, nullptr))
-                            {
-                                nLoaded++;
-                                queue.push_back(pblockrecursive->GetHash());
+                    try {
+                        // read block
+                        CImportedBlock imported;
+                        uint64_t nBlockPos = blkdat.GetPos();
+                        if (dbp)
+                            imported.pos = CDiskBlockPos(dbp->nFile, nBlockPos);
+                        blkdat.SetLimit(nBlockPos + nSize);
+                        blkdat.SetPos(nBlockPos);
+                        imported.pblock = std::make_shared<CBlock>();
+                        if (fCompressed) {
+                            std::vector<char> frame(nSize);
+                            blkdat.read(frame.data(), nSize);
+                            CDataStream stream(SER_DISK, CLIENT_VERSION);
+                            DecompressFrame(frame.data(), nSize, stream, MAX_BLOCK_SERIALIZED_SIZE);
+                            stream >> *imported.pblock;
+                        } else {
+                            blkdat >> *imported.pblock;
+                        }
+                        nRewind = blkdat.GetPos();
+
+                        imported.hash = imported.pblock->GetHash();
+                        imported.nHeight = -1;
+                        if (imported.hash == chainparams.GetConsensus().hashGenesisBlock) {
+                            imported.nHeight = 0;
+                        } else {
+                            std::map<uint256, int>::const_iterator itRead = mapReadHeights.find(imported.pblock->hashPrevBlock);
+                            if (itRead != mapReadHeights.end()) {
+                                imported.nHeight = itRead->second + 1;
+                            } else {
+                                LOCK(cs_main);
+                                BlockMap::const_iterator mi = mapBlockIndex.find(imported.pblock->hashPrevBlock);
+                                if (mi != mapBlockIndex.end())
+                                    imported.nHeight = mi->second->nHeight + 1;
                             }
                         }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
-                        NotifyHeaderTip();
+                        if (imported.nHeight >= 0)
+                            mapReadHeights[imported.hash] = imported.nHeight;
+                        vNext.push_back(std::move(imported));
+                    } catch (const std::exception& e) {
+                        LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
                     }
                 }
-            } catch (const std::exception& e) {
-                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+                if (blkdat.eof())
+                    fEof = true;
+
+                control.Wait();
             }
+
+            for (CImportedBlock& imported : vBatch) {
+                if (!ImportBlock(chainparams, imported, dbp ? &imported.pos : nullptr, mapBlocksUnknownParent, nLoaded)) {
+                    vNext.clear();
+                    fEof = true;
+                    break;
+                }
+            }
+            vBatch.swap(vNext);
+            vNext.clear();
         }
     } catch (const std::runtime_error& e) {
         AbortNode(std::string("System error: ") + e.what());
@@ -4990,7 +6207,20 @@ int VersionBitsTipStateSinceHeight(const Consensus::Params& params, Consensus::D
     return VersionBitsStateSinceHeight(chainActive.Tip(), params, pos, versionbitscache);
 }
 
-static const uint64_t MEMPOOL_DUMP_VERSION = 1;
+static const uint64_t MEMPOOL_DUMP_VERSION_NO_TOKENS = 1;
+// Version 2 follows each zerocoin spend with its GetZerocoinSpendToken, or null
+static const uint64_t MEMPOOL_DUMP_VERSION = 2;
+
+// Node-local salt of the zerocoin spend tokens in mempool.dat, created on first use
+static bool GetMempoolTokenSalt(uint256& salt)
+{
+    if (!pblocktree)
+        return false;
+    if (pblocktree->ReadMempoolTokenSalt(salt))
+        return true;
+    GetStrongRandBytes(salt.begin(), 32);
+    return pblocktree->WriteMempoolTokenSalt(salt);
+}
 
 bool LoadMempool(void)
 {
@@ -5009,44 +6239,70 @@ bool LoadMempool(void)
     int64_t already_there = 0;
     int64_t nNow = GetTime();
 
+    int64_t trusted = 0;
+
+    auto accept = [&](const CTransactionRef& tx, int64_t nTime) {
+        CValidationState state;
+        LOCK(cs_main);
+        AcceptToMemoryPoolWithTime(chainparams, mempool, state, tx, nullptr /* pfMissingInputs */, nTime,
+                                   nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */);
+        if (state.IsValid()) {
+            ++count;
+        } else {
+            // mempool may contain the transaction already, e.g. from
+            // wallet(s) having loaded it while we were processing
+            // mempool transactions; consider these as valid, instead of
+            // failed, but mark them as 'already there'
+            if (mempool.exists(tx->GetHash())) {
+                ++already_there;
+            } else {
+                ++failed;
+            }
+        }
+    };
+
     try {
         uint64_t version;
         file >> version;
-        if (version != MEMPOOL_DUMP_VERSION) {
+        if (version != MEMPOOL_DUMP_VERSION && version != MEMPOOL_DUMP_VERSION_NO_TOKENS) {
             return false;
         }
+        uint256 salt;
+        bool fHaveSalt = version == MEMPOOL_DUMP_VERSION && GetMempoolTokenSalt(salt);
+        // Spends whose proofs have to be verified again, they are accepted after everything else
+        std::vector<std::pair<CTransactionRef, int64_t>> vUntrustedSpends;
+
         uint64_t num;
         file >> num;
         while (num--) {
             CTransactionRef tx;
             int64_t nTime;
             int64_t nFeeDelta;
+            uint256 token;
             file >> tx;
             file >> nTime;
             file >> nFeeDelta;
+            if (version == MEMPOOL_DUMP_VERSION && tx->IsZerocoinSpend())
+                file >> token;
 
             CAmount amountdelta = nFeeDelta;
             if (amountdelta) {
                 mempool.PrioritiseTransaction(tx->GetHash(), amountdelta);
             }
-            CValidationState state;
             if (nTime + nExpiryTimeout > nNow) {
-                LOCK(cs_main);
-                AcceptToMemoryPoolWithTime(chainparams, mempool, state, tx, nullptr /* pfMissingInputs */, nTime,
-                                           nullptr /* plTxnReplaced */, false /* bypass_limits */, 0 /* nAbsurdFee */);
-                if (state.IsValid()) {
-                    ++count;
-                } else {
-                    // mempool may contain the transaction already, e.g. from
-                    // wallet(s) having loaded it while we were processing
-                    // mempool transactions; consider these as valid, instead of
-                    // failed, but mark them as 'already there'
-                    if (mempool.exists(tx->GetHash())) {
-                        ++already_there;
-                    } else {
-                        ++failed;
+                if (tx->IsZerocoinSpend()) {
+                    bool fTrusted = false;
+                    if (fHaveSalt) {
+                        LOCK(cs_main);
+                        fTrusted = TrustZerocoinSpendToken(*tx, salt, token);
+                    }
+                    if (!fTrusted) {
+                        vUntrustedSpends.emplace_back(tx, nTime);
+                        continue;
                     }
+                    ++trusted;
                 }
+                accept(tx, nTime);
             } else {
                 ++expired;
             }
@@ -5059,12 +6315,18 @@ bool LoadMempool(void)
         for (const auto& i : mapDeltas) {
             mempool.PrioritiseTransaction(i.first, i.second);
         }
+
+        for (const auto& spend : vUntrustedSpends) {
+            accept(spend.first, spend.second);
+            if (ShutdownRequested())
+                return false;
+        }
     } catch (const std::exception& e) {
         LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", e.what());
         return false;
     }
 
-    LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there\n", count, failed, expired, already_there);
+    LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there, %i zerocoin spends not verified again\n", count, failed, expired, already_there, trusted);
     return true;
 }
 
@@ -5083,6 +6345,19 @@ bool DumpMempool(void)
         vinfo = mempool.infoAll();
     }
 
+    std::map<uint256, uint256> mapSpendTokens;
+    uint256 salt;
+    {
+        LOCK(cs_main);
+        if (GetMempoolTokenSalt(salt)) {
+            for (const auto& i : vinfo) {
+                uint256 token;
+                if (i.tx->IsZerocoinSpend() && GetZerocoinSpendToken(*i.tx, salt, token))
+                    mapSpendTokens[i.tx->GetHash()] = token;
+            }
+        }
+    }
+
     int64_t mid = GetTimeMicros();
 
     try {
@@ -5101,6 +6376,8 @@ bool DumpMempool(void)
             file << *(i.tx);
             file << (int64_t)i.nTime;
             file << (int64_t)i.nFeeDelta;
+            if (i.tx->IsZerocoinSpend())
+                file << mapSpendTokens[i.tx->GetHash()];
             mapDeltas.erase(i.tx->GetHash());
         }
 
@@ -5117,6 +6394,28 @@ bool DumpMempool(void)
     return true;
 }
 
+bool DumpBlockIndexSnapshot()
+{
+    int64_t nStart = GetTimeMillis();
+    LOCK(cs_main);
+    // Entries that are not in the database yet would make the snapshot disagree with it
+    if (!pblocktree || !setDirtyBlockIndex.empty() || !setDirtyBlockZerocoin.empty())
+        return false;
+
+    std::vector<const CBlockIndex*> vIndex;
+    vIndex.reserve(mapBlockIndex.size());
+    for (const std::pair<uint256, CBlockIndex*>& item : mapBlockIndex)
+        vIndex.push_back(item.second);
+    std::sort(vIndex.begin(), vIndex.end(), [](const CBlockIndex* a, const CBlockIndex* b) { return a->nHeight < b->nHeight; });
+
+    if (!pblocktree->WriteBlockIndexSnapshot(vIndex)) {
+        LogPrintf("Failed to dump block index. Continuing anyway.\n");
+        return false;
+    }
+    LogPrintf("Dumped block index: %u entries in %dms\n", vIndex.size(), GetTimeMillis() - nStart);
+    return true;
+}
+
 //! Guess how far we are in the verification process at the given block index
 double GuessVerificationProgress(const ChainTxData& data, const CBlockIndex *pindex) {
     if (pindex == nullptr)
@@ -12,6 +12,7 @@
 
 #include <amount.h>
 #include <coins.h>
+#include <consensus/validation.h>
 #include <fs.h>
 #include <protocol.h> // For CMessageHeader::MessageStartChars
 #include <policy/feerate.h>
@@ -21,7 +22,9 @@
 
 #include <algorithm>
 #include <exception>
+#include <functional>
 #include <map>
+#include <memory>
 #include <set>
 #include <stdint.h>
 #include <string>
@@ -35,11 +38,14 @@
 
 class CBlockIndex;
 class CBlockTreeDB;
+class CBlockUndo;
+class CZerocoinDB;
 class CChainParams;
 class CCoinsViewDB;
 class CInv;
 class CConnman;
 class CScriptCheck;
+class CZerocoinSpendCheck;
 class CBlockPolicyEstimator;
 class CTxMemPool;
 class CValidationState;
@@ -69,10 +75,18 @@ static const unsigned int DEFAULT_ANCESTOR_SIZE_LIMIT = 101;
 static const unsigned int DEFAULT_DESCENDANT_LIMIT = 25;
 /** Default for -limitdescendantsize, maximum kilobytes of in-mempool descendants */
 static const unsigned int DEFAULT_DESCENDANT_SIZE_LIMIT = 101;
+/** Most transactions AcceptPackageToMemoryPool takes at once, and a "pkgtxs" message carries */
+static const unsigned int MAX_PACKAGE_COUNT = DEFAULT_ANCESTOR_LIMIT;
 /** Default for -mempoolexpiry, expiration time for mempool transactions in hours */
 static const unsigned int DEFAULT_MEMPOOL_EXPIRY = 336;
+/** Once the mempool outgrows -maxmempool it is trimmed this many percent below it, not just under it */
+static const unsigned int MEMPOOL_TRIM_HYSTERESIS_PERCENT = 2;
 /** Maximum kilobytes for transactions to store for processing during reorg */
 static const unsigned int MAX_DISCONNECTED_TX_POOL_SIZE = 20000;
+/** Default for -maxtxlookupcachesize, in MiB */
+static const int64_t DEFAULT_MAX_TX_LOOKUP_CACHE_SIZE = 16;
+/** Maximum transaction lookup cache size allowed, in MiB */
+static const int64_t MAX_MAX_TX_LOOKUP_CACHE_SIZE = 1024;
 /** The maximum size of a blk?????.dat file (since 0.8) */
 static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 /** The pre-allocation chunk size for blk?????.dat files (since 0.8) */
@@ -84,10 +98,19 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
-/** Number of blocks that can be requested at any given time from a single peer (x4 from btc). */
+/** Number of blocks that can be requested at any given time from a single peer (x4 from btc), before its
+ *  download rate is known. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16 * TIME_MULTIPLIER;
+/** Fewest blocks that can be requested at any given time from a single peer, however slowly it delivers them. */
+static const int MIN_BLOCKS_IN_TRANSIT_PER_PEER = 2;
+/** Most blocks that can be requested at any given time from a single peer, however fast it delivers them. */
+static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER_ADAPTIVE = 64 * TIME_MULTIPLIER;
+/** A peer may have as many blocks in flight as it delivers in this many seconds. */
+static const unsigned int BLOCK_DOWNLOAD_TARGET_TIME = 4;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
 static const unsigned int BLOCK_STALLING_TIMEOUT = 2;
+/** The stalling timeout doubles, up to this many seconds, when a peer is disconnected for stalling. */
+static const unsigned int MAX_BLOCK_STALLING_TIMEOUT = 64;
 /** Number of headers sent in one getheaders result. We rely on the assumption that if a peer sends
  *  less than this number, we reached its tip. Changing this value is a protocol upgrade. */
 static const unsigned int MAX_HEADERS_RESULTS = 2000;
@@ -134,6 +157,8 @@ static const int64_t MAX_FEE_ESTIMATION_TIP_AGE = 3 * 60 * 60;
 static const bool DEFAULT_PERMIT_BAREMULTISIG = true;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
 static const bool DEFAULT_TXINDEX = true;
+/** Default for -compressblocks */
+static const bool DEFAULT_COMPRESS_BLOCKS = false;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 /** Default for -persistmempool */
 static const bool DEFAULT_PERSIST_MEMPOOL = true;
@@ -149,13 +174,19 @@ static const unsigned int MAX_BLOCKS_TO_ANNOUNCE = 8;
 static const int MAX_UNCONNECTING_HEADERS = 10;
 
 static const bool DEFAULT_PEERBLOOMFILTERS = true;
+static const bool DEFAULT_PEERBLOCKFILTERS = false;
+/** Default for -fastblockrelay */
+static const bool DEFAULT_FASTBLOCKRELAY = false;
 
 /** Default for -stopatheight */
 static const int DEFAULT_STOPATHEIGHT = 0;
 
 static const bool DEFAULT_TIMESTAMPINDEX = false;
 static const bool DEFAULT_ADDRESSINDEX = false;
+static const bool DEFAULT_ADDRESSINDEX_COMPRESSION = false;
 static const bool DEFAULT_SPENTINDEX = false;
+static const bool DEFAULT_COLLATERALINDEX = false;
+static const bool DEFAULT_BLOCKFILTERINDEX = false;
 
 struct BlockHasher
 {
@@ -175,11 +206,17 @@ extern CWaitableCriticalSection csBestBlock;
 extern CConditionVariable cvBlockChange;
 extern std::atomic_bool fImporting;
 extern std::atomic_bool fReindex;
+/** Whether -reindex-chainstate-fast re-applies only the coin changes of blocks validated before */
+extern bool fReindexChainStateFast;
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
+/** Whether new block and undo records are stored compressed */
+extern bool fCompressBlocks;
 extern bool fAddressIndex;
 extern bool fSpentIndex;
 extern bool fTimestampIndex;
+extern bool fCollateralIndex;
+extern bool fBlockFilterIndex;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern bool fCheckBlockIndex;
@@ -192,6 +229,8 @@ extern CAmount maxTxFee;
 /** If the tip is older than this (in seconds), the node is considered to be in initial block download. */
 extern int64_t nMaxTipAge;
 extern bool fEnableReplacement;
+/** Whether new tip blocks are announced to compact block peers before their transactions are checked */
+extern bool fFastBlockRelay;
 
 /** Block hash whose ancestors we will assume to have valid scripts without checking them. */
 extern uint256 hashAssumeValid;
@@ -214,11 +253,15 @@ extern bool fPruneMode;
 extern uint64_t nPruneTarget;
 /** Block files containing a block-height within MIN_BLOCKS_TO_KEEP of chainActive.Tip() will not be pruned. */
 static const unsigned int MIN_BLOCKS_TO_KEEP = 288;
+/** Block files containing a block-height within this distance of chainActive.Tip() will not be pruned either. It
+ *  is MIN_BLOCKS_TO_KEEP or more, to keep the blocks the ghostnode payment index is rebuilt from at startup. */
+unsigned int GetPruneMinBlocksToKeep();
 /** Minimum blocks required to signal NODE_NETWORK_LIMITED */
 static const unsigned int NODE_NETWORK_LIMITED_MIN_BLOCKS = 288;
 
 static const signed int DEFAULT_CHECKBLOCKS = 6;
 static const unsigned int DEFAULT_CHECKLEVEL = 3;
+static const unsigned int DEFAULT_CHECKBLOCKSAMPLE = 0;
 
 // Require that user allocate at least 550MB for block & undo files (blk???.dat and rev???.dat)
 // At 1MB per block, 288 blocks = 288MB.
@@ -278,6 +321,8 @@ FILE* OpenBlockFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 fs::path GetBlockPosFilename(const CDiskBlockPos &pos, const char *prefix);
 /** Import blocks from an external file */
 bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp = nullptr);
+/** Rewrite the finished block files that are not compressed yet with their blocks compressed */
+void CompressBlockFiles(const CChainParams& chainparams);
 /** Ensures we have a genesis block in the block tree, possibly writing one to disk. */
 bool LoadGenesisBlock(const CChainParams& chainparams);
 /** Load the block tree and coins database from disk,
@@ -287,10 +332,27 @@ bool LoadBlockIndex(const CChainParams& chainparams);
 bool LoadChainTip(const CChainParams& chainparams);
 /** Unload database information */
 void UnloadBlockIndex();
+/** Estimate of the heap memory used by the block index entries and their zerocoin data */
+size_t BlockIndexDynamicMemoryUsage();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the zerocoin spend checking thread */
+void ThreadZerocoinSpendCheck();
+/** Run an instance of the header proof-of-work checking thread */
+void ThreadPoWCheck();
+/** Run an instance of the block transaction structure checking thread */
+void ThreadTxStructureCheck();
+/**
+ * Compact one database every nIntervalMinutes (-dbcompact), the databases in turn, and only while
+ * the node is not downloading or connecting blocks
+ */
+void ThreadDBCompaction(int nIntervalMinutes);
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
+/** Size the cache of confirmed transactions GetTransaction read from disk (-maxtxlookupcachesize) */
+void InitTxLookupCache();
+/** Heap memory used by the transaction lookup cache */
+size_t TxLookupCacheDynamicMemoryUsage();
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
 bool GetTransaction(const uint256& hash, CTransactionRef& tx, const Consensus::Params& params, uint256& hashBlock, bool fAllowSlow = false, CBlockIndex* blockIndex = nullptr);
 /** Find the best known block, and make it the tip of the block chain */
@@ -326,6 +388,39 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
                         bool* pfMissingInputs, std::list<CTransactionRef>* plTxnReplaced,
                         bool bypass_limits, const CAmount nAbsurdFee);
 
+/** What became of one transaction of a package given to AcceptPackageToMemoryPool */
+struct CPackageTxResult
+{
+    CValidationState state;
+    bool fAccepted = false;
+    bool fMissingInputs = false;
+};
+
+/**
+ * (try to) add a package of dependent transactions to the memory pool, parents before children whatever their
+ * order in vPackage, holding the locks and deferring the coins cache flush across the whole package. A transaction
+ * whose parent in the package was not accepted is not tried, and reported with missing inputs. vResults gets one
+ * element per transaction of vPackage, in the same order. Zerocoin spends aren't taken, their proofs are verified
+ * on their own, see PreCheckZerocoinSpendForMemoryPool. Returns the number of transactions accepted. Requires cs_main
+ */
+unsigned int AcceptPackageToMemoryPool(CTxMemPool& pool, const std::vector<CTransactionRef>& vPackage,
+                                       std::vector<CPackageTxResult>& vResults, std::list<CTransactionRef>* plTxnReplaced);
+
+/**
+ * First stage of admitting a zerocoin spend to the memory pool: every check of AcceptToMemoryPool except for the
+ * verification of the spend proofs, which are pushed onto vChecks instead, and the spend is not added. Once the
+ * checks pass, AcceptToMemoryPool finds the proofs in the spend cache. Requires cs_main
+ */
+bool PreCheckZerocoinSpendForMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransactionRef &tx,
+                                        std::vector<CZerocoinSpendCheck> &vChecks);
+
+/**
+ * Verify the scripts of a transaction about to be given to AcceptToMemoryPool without holding cs_main, filling the
+ * signature cache so that its script checks under cs_main don't redo the signature verifications. Gives no result,
+ * AcceptToMemoryPool still runs every check. Must not be called with cs_main held
+ */
+void PreCheckTransactionScriptsForMemoryPool(CTxMemPool& pool, const CTransactionRef &tx);
+
 /** Convert CValidationState to a human-readable message for logging */
 std::string FormatStateMessage(const CValidationState &state);
 
@@ -409,7 +504,8 @@ public:
 /** Initializes the script-execution cache */
 void InitScriptExecutionCache();
 
-/** Insight functions */
+/** Insight functions. The timestamp and address lookups wait for the index to reach the chain tip,
+ *  they must not be called with cs_main held. */
 bool GetTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes);
 bool GetSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
 bool GetAddressIndex(uint256 addressHash, int type,
@@ -417,10 +513,20 @@ bool GetAddressIndex(uint256 addressHash, int type,
                      int start = 0, int end = 0);
 bool GetAddressUnspent(uint256 addressHash, int type,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
+/** Visit the address index entries one at a time instead of collecting them, see CAddressIndexDB::ScanAddressIndex */
+bool ScanAddressIndex(const uint256 &addressHash, int type, int start, int end, const CAddressIndexKey *pkeyAfter,
+                      const std::function<bool(const CAddressIndexKey&, CAmount)> &fn);
+/** The running totals of an address. False also when the address index was built without them */
+bool GetAddressBalance(const uint256 &addressHash, int type, CAddressBalance &balance);
+bool ScanAddressUnspent(const uint256 &addressHash, int type, const CAddressUnspentKey *pkeyAfter,
+                        const std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)> &fn);
 
 /** Functions for disk access for blocks */
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, int nHeight, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/** Read the block as it is serialized on disk, with witness data, without deserializing it */
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart);
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -447,7 +553,8 @@ class CVerifyDB {
 public:
     CVerifyDB();
     ~CVerifyDB();
-    bool VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview, int nCheckLevel, int nCheckDepth);
+    /** Verify the last nCheckDepth blocks at nCheckLevel, and nSampleBlocks blocks picked at random below them at level 2 at most */
+    bool VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview, int nCheckLevel, int nCheckDepth, int nSampleBlocks = 0);
 };
 
 /** Replay blocks that aren't fully applied to the database. */
@@ -468,6 +575,28 @@ bool ResetBlockFailureFlags(CBlockIndex *pindex);
 /** The currently-connected chain of blocks (protected by cs_main). */
 extern CChain& chainActive;
 
+/**
+ * chainActive as of the last block connected or disconnected, for read only callers that don't
+ * take cs_main. Block indexes are never freed while running and the ancestors of one never
+ * change, so the chain below the tip is walked with GetAncestor instead of being copied.
+ * The fields of a block index that change after it is connected, like nStatus, still need cs_main.
+ */
+struct CChainSnapshot
+{
+    const CBlockIndex* pindexTip = nullptr;
+    int nHeight = -1;
+
+    const CBlockIndex* Tip() const { return pindexTip; }
+    int Height() const { return nHeight; }
+    /** The block at nHeightIn of the chain, nullptr if out of range */
+    const CBlockIndex* operator[](int nHeightIn) const;
+    /** Whether pindex is part of the chain */
+    bool Contains(const CBlockIndex* pindex) const;
+};
+
+/** The last CChainSnapshot published, never null */
+std::shared_ptr<const CChainSnapshot> GetChainSnapshot();
+
 /** Global variable that points to the coins database (protected by cs_main) */
 extern std::unique_ptr<CCoinsViewDB> pcoinsdbview;
 
@@ -477,6 +606,9 @@ extern std::unique_ptr<CCoinsViewCache> pcoinsTip;
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern std::unique_ptr<CBlockTreeDB> pblocktree;
 
+/** Global variable that points to the zerocoin index database (protected by cs_main) */
+extern std::unique_ptr<CZerocoinDB> pzerocoindb;
+
 /**
  * Return the spend height, which is one more than the inputs.GetBestBlock().
  * While checking, GetBestBlock() refers to the parent block. (protected by cs_main)
@@ -505,6 +637,9 @@ CBlockFileInfo* GetBlockFileInfo(size_t n);
 /** Dump the mempool to disk. */
 bool DumpMempool();
 
+/** Write a snapshot of the block index that the next start loads instead of scanning the block tree database. */
+bool DumpBlockIndexSnapshot();
+
 /** Load the mempool from disk. */
 bool LoadMempool();
 
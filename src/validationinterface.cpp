@@ -13,30 +13,230 @@
 #include <util.h>
 #include <validation.h>
 
+#include <algorithm>
 #include <list>
 #include <atomic>
 #include <future>
 
-#include <boost/signals2/signal.hpp>
+#include <boost/bind.hpp>
+
+namespace {
+
+/**
+ * The notifications for one subscriber, run in order on the scheduler, one at a time.
+ * Barriers of CallFunctionInValidationInterfaceQueue and WaitForSubscriberQueues are
+ * queued alongside and never dropped.
+ */
+class SubscriberQueue : public std::enable_shared_from_this<SubscriberQueue>
+{
+public:
+    SubscriberQueue(CScheduler* pscheduler, CValidationInterface* subscriber, const std::string& name, ValidationQueuePolicy policy, size_t nMaxDepth)
+        : m_subscriber(subscriber), m_pscheduler(pscheduler), m_name(name), m_policy(policy), m_max_depth(nMaxDepth) {}
+
+    CValidationInterface* const m_subscriber;
+
+    void AddNotification(std::function<void (CValidationInterface*)> func);
+    void AddBarrier(std::function<void ()> func);
+    /** Drop the pending notifications, the subscriber is going away */
+    void Disconnect();
+    /** Run the queue empty on the calling thread, the scheduler must be stopped */
+    void EmptyQueue();
+
+    size_t Depth();
+    bool OverBound();
+    void RecordWait(int64_t nMicros);
+    ValidationQueueStats GetStats();
+
+private:
+    struct Entry {
+        std::function<void ()> func;
+        bool fNotification;
+    };
+
+    CScheduler* const m_pscheduler;
+    const std::string m_name;
+    const ValidationQueuePolicy m_policy;
+    const size_t m_max_depth;
+
+    CCriticalSection m_cs;
+    std::list<Entry> m_pending;
+    size_t m_notifications = 0;
+    bool m_running = false;
+    bool m_connected = true;
+    bool m_overflowing = false;
+    ValidationQueueStats m_stats{};
+
+    void Add(Entry&& entry);
+    void MaybeScheduleProcessQueue();
+    void ProcessQueue();
+};
+
+void SubscriberQueue::AddNotification(std::function<void (CValidationInterface*)> func)
+{
+    CValidationInterface* subscriber = m_subscriber;
+    Add(Entry{[subscriber, func] { func(subscriber); }, true});
+}
+
+void SubscriberQueue::AddBarrier(std::function<void ()> func)
+{
+    Add(Entry{std::move(func), false});
+}
+
+void SubscriberQueue::Add(Entry&& entry)
+{
+    {
+        LOCK(m_cs);
+        if (entry.fNotification) {
+            if (!m_connected) return;
+            if (m_policy == ValidationQueuePolicy::DROP && m_notifications >= m_max_depth) {
+                auto it = std::find_if(m_pending.begin(), m_pending.end(), [](const Entry& e) { return e.fNotification; });
+                if (it != m_pending.end()) {
+                    m_pending.erase(it);
+                    m_notifications--;
+                    m_stats.nDropped++;
+                }
+                if (!m_overflowing) {
+                    LogPrintf("Validation interface queue of %s is full, dropping its oldest notifications\n", m_name);
+                    m_overflowing = true;
+                }
+            }
+            m_notifications++;
+            m_stats.nQueued++;
+        }
+        m_pending.emplace_back(std::move(entry));
+        m_stats.nPeakDepth = std::max(m_stats.nPeakDepth, m_notifications);
+    }
+    MaybeScheduleProcessQueue();
+}
+
+void SubscriberQueue::MaybeScheduleProcessQueue()
+{
+    {
+        LOCK(m_cs);
+        if (m_running) return;
+        if (m_pending.empty()) return;
+    }
+    m_pscheduler->schedule(std::bind(&SubscriberQueue::ProcessQueue, shared_from_this()), boost::chrono::system_clock::now(), "validationinterface/" + m_name);
+}
+
+void SubscriberQueue::ProcessQueue()
+{
+    Entry entry;
+    {
+        LOCK(m_cs);
+        if (m_running) return;
+        if (m_pending.empty()) return;
+        m_running = true;
+
+        entry = std::move(m_pending.front());
+        m_pending.pop_front();
+        if (entry.fNotification) m_notifications--;
+        if (m_pending.empty()) m_overflowing = false;
+    }
+
+    // Clear m_running and schedule the rest even if the callback throws
+    struct RAIIRunning {
+        SubscriberQueue* queue;
+        int64_t nStart;
+        bool fNotification;
+        ~RAIIRunning() {
+            int64_t nTime = GetTimeMicros() - nStart;
+            {
+                LOCK(queue->m_cs);
+                queue->m_running = false;
+                if (fNotification) {
+                    queue->m_stats.nProcessed++;
+                    queue->m_stats.nTotalMicros += nTime;
+                    queue->m_stats.nMaxMicros = std::max(queue->m_stats.nMaxMicros, nTime);
+                }
+            }
+            queue->MaybeScheduleProcessQueue();
+        }
+    } raiirunning{this, GetTimeMicros(), entry.fNotification};
+
+    entry.func();
+}
+
+void SubscriberQueue::Disconnect()
+{
+    LOCK(m_cs);
+    m_connected = false;
+    m_pending.remove_if([](const Entry& e) { return e.fNotification; });
+    m_notifications = 0;
+}
+
+void SubscriberQueue::EmptyQueue()
+{
+    assert(!m_pscheduler->AreThreadsServicingQueue());
+    bool should_continue = true;
+    while (should_continue) {
+        ProcessQueue();
+        LOCK(m_cs);
+        should_continue = !m_pending.empty();
+    }
+}
+
+size_t SubscriberQueue::Depth()
+{
+    LOCK(m_cs);
+    return m_notifications;
+}
+
+bool SubscriberQueue::OverBound()
+{
+    LOCK(m_cs);
+    return m_policy == ValidationQueuePolicy::BLOCK && m_notifications > m_max_depth;
+}
+
+void SubscriberQueue::RecordWait(int64_t nMicros)
+{
+    LOCK(m_cs);
+    m_stats.nWaits++;
+    m_stats.nTotalWaitMicros += nMicros;
+}
+
+ValidationQueueStats SubscriberQueue::GetStats()
+{
+    LOCK(m_cs);
+    ValidationQueueStats stats = m_stats;
+    stats.name = m_name;
+    stats.policy = m_policy;
+    stats.nDepth = m_notifications;
+    stats.nMaxDepth = m_max_depth;
+    return stats;
+}
+
+} // namespace
 
 struct MainSignalsInstance {
-    boost::signals2::signal<void (const CBlockIndex *, const CBlockIndex *, bool fInitialDownload)> UpdatedBlockTip;
-    boost::signals2::signal<void (const CTransactionRef &)> TransactionAddedToMempool;
-    boost::signals2::signal<void (const std::shared_ptr<const CBlock> &, const CBlockIndex *pindex, const std::vector<CTransactionRef>&)> BlockConnected;
-    boost::signals2::signal<void (const std::shared_ptr<const CBlock> &)> BlockDisconnected;
-    boost::signals2::signal<void (const CTransactionRef &)> TransactionRemovedFromMempool;
-    boost::signals2::signal<void (const CBlockLocator &)> SetBestChain;
-    boost::signals2::signal<void (const uint256 &)> Inventory;
-    boost::signals2::signal<void (int64_t nBestBlockTime, CConnman* connman)> Broadcast;
-    boost::signals2::signal<void (const CBlock&, const CValidationState&)> BlockChecked;
-    boost::signals2::signal<void (const CBlockIndex *, const std::shared_ptr<const CBlock>&)> NewPoWValidBlock;
-
-    // We are not allowed to assume the scheduler only runs in one thread,
-    // but must ensure all callbacks happen in-order, so we end up creating
-    // our own queue here :(
-    SingleThreadedSchedulerClient m_schedulerClient;
-
-    explicit MainSignalsInstance(CScheduler *pscheduler) : m_schedulerClient(pscheduler) {}
+    CScheduler* m_pscheduler;
+    const size_t m_max_validation_queue;
+    const size_t m_max_notification_queue;
+
+    CCriticalSection m_cs_queues;
+    //! One queue per registered subscriber
+    std::vector<std::shared_ptr<SubscriberQueue>> m_queues;
+    //! Runs the functions of CallFunctionInValidationInterfaceQueue, in order
+    std::shared_ptr<SubscriberQueue> m_function_queue;
+
+    explicit MainSignalsInstance(CScheduler *pscheduler) :
+        m_pscheduler(pscheduler),
+        m_max_validation_queue(std::max<int64_t>(1, gArgs.GetArg("-maxvalidationqueue", DEFAULT_MAX_VALIDATION_QUEUE))),
+        m_max_notification_queue(std::max<int64_t>(1, gArgs.GetArg("-maxnotificationqueue", DEFAULT_MAX_NOTIFICATION_QUEUE))),
+        m_function_queue(std::make_shared<SubscriberQueue>(pscheduler, nullptr, "functions", ValidationQueuePolicy::BLOCK, 0)) {}
+
+    /** Queue func for every subscriber */
+    void Notify(std::function<void (CValidationInterface*)> func) {
+        LOCK(m_cs_queues);
+        for (const auto& queue : m_queues) {
+            queue->AddNotification(func);
+        }
+    }
+
+    std::vector<std::shared_ptr<SubscriberQueue>> GetQueues() {
+        LOCK(m_cs_queues);
+        return m_queues;
+    }
 };
 
 static CMainSignals g_signals;
@@ -52,13 +252,46 @@ void CMainSignals::UnregisterBackgroundSignalScheduler() {
 
 void CMainSignals::FlushBackgroundCallbacks() {
     if (m_internals) {
-        m_internals->m_schedulerClient.EmptyQueue();
+        // The barriers in the subscriber queues hand their functions to the function queue
+        for (const auto& queue : m_internals->GetQueues()) {
+            queue->EmptyQueue();
+        }
+        m_internals->m_function_queue->EmptyQueue();
     }
 }
 
 size_t CMainSignals::CallbacksPending() {
     if (!m_internals) return 0;
-    return m_internals->m_schedulerClient.CallbacksPending();
+    size_t nPending = 0;
+    for (const auto& queue : m_internals->GetQueues()) {
+        nPending += queue->Depth();
+    }
+    return nPending;
+}
+
+void CMainSignals::WaitForSubscriberQueues() {
+    AssertLockNotHeld(cs_main);
+    if (!m_internals) return;
+    for (const auto& queue : m_internals->GetQueues()) {
+        if (!queue->OverBound()) continue;
+        // Block until the queue drains, a full queue of blocks may hold a lot of memory
+        int64_t nStart = GetTimeMicros();
+        std::promise<void> promise;
+        queue->AddBarrier([&promise] {
+            promise.set_value();
+        });
+        promise.get_future().wait();
+        queue->RecordWait(GetTimeMicros() - nStart);
+    }
+}
+
+std::vector<ValidationQueueStats> CMainSignals::GetQueueStats() {
+    std::vector<ValidationQueueStats> vStats;
+    if (!m_internals) return vStats;
+    for (const auto& queue : m_internals->GetQueues()) {
+        vStats.push_back(queue->GetStats());
+    }
+    return vStats;
 }
 
 void CMainSignals::RegisterWithMempoolSignals(CTxMemPool& pool) {
@@ -74,50 +307,63 @@ CMainSignals& GetMainSignals()
     return g_signals;
 }
 
-void RegisterValidationInterface(CValidationInterface* pwalletIn) {
-    g_signals.m_internals->UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
-    g_signals.m_internals->TransactionAddedToMempool.connect(boost::bind(&CValidationInterface::TransactionAddedToMempool, pwalletIn, _1));
-    g_signals.m_internals->BlockConnected.connect(boost::bind(&CValidationInterface::BlockConnected, pwalletIn, _1, _2, _3));
-    g_signals.m_internals->BlockDisconnected.connect(boost::bind(&CValidationInterface::BlockDisconnected, pwalletIn, _1));
-    g_signals.m_internals->TransactionRemovedFromMempool.connect(boost::bind(&CValidationInterface::TransactionRemovedFromMempool, pwalletIn, _1));
-    g_signals.m_internals->SetBestChain.connect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
-    g_signals.m_internals->Inventory.connect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
-    g_signals.m_internals->Broadcast.connect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, _1, _2));
-    g_signals.m_internals->BlockChecked.connect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
-    g_signals.m_internals->NewPoWValidBlock.connect(boost::bind(&CValidationInterface::NewPoWValidBlock, pwalletIn, _1, _2));
+void RegisterValidationInterface(CValidationInterface* pwalletIn, const std::string& name, ValidationQueuePolicy policy) {
+    MainSignalsInstance& internals = *g_signals.m_internals;
+    size_t nMaxDepth = policy == ValidationQueuePolicy::DROP ? internals.m_max_notification_queue : internals.m_max_validation_queue;
+    LOCK(internals.m_cs_queues);
+    internals.m_queues.push_back(std::make_shared<SubscriberQueue>(internals.m_pscheduler, pwalletIn, name, policy, nMaxDepth));
 }
 
 void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
-    g_signals.m_internals->BlockChecked.disconnect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
-    g_signals.m_internals->Broadcast.disconnect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, _1, _2));
-    g_signals.m_internals->Inventory.disconnect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
-    g_signals.m_internals->SetBestChain.disconnect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
-    g_signals.m_internals->TransactionAddedToMempool.disconnect(boost::bind(&CValidationInterface::TransactionAddedToMempool, pwalletIn, _1));
-    g_signals.m_internals->BlockConnected.disconnect(boost::bind(&CValidationInterface::BlockConnected, pwalletIn, _1, _2, _3));
-    g_signals.m_internals->BlockDisconnected.disconnect(boost::bind(&CValidationInterface::BlockDisconnected, pwalletIn, _1));
-    g_signals.m_internals->TransactionRemovedFromMempool.disconnect(boost::bind(&CValidationInterface::TransactionRemovedFromMempool, pwalletIn, _1));
-    g_signals.m_internals->UpdatedBlockTip.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
-    g_signals.m_internals->NewPoWValidBlock.disconnect(boost::bind(&CValidationInterface::NewPoWValidBlock, pwalletIn, _1, _2));
+    MainSignalsInstance& internals = *g_signals.m_internals;
+    LOCK(internals.m_cs_queues);
+    for (auto it = internals.m_queues.begin(); it != internals.m_queues.end(); ) {
+        if ((*it)->m_subscriber == pwalletIn) {
+            // Pending barriers still run, the queue lives on in its scheduled task
+            (*it)->Disconnect();
+            it = internals.m_queues.erase(it);
+        } else {
+            ++it;
+        }
+    }
 }
 
 void UnregisterAllValidationInterfaces() {
     if (!g_signals.m_internals) {
         return;
     }
-    g_signals.m_internals->BlockChecked.disconnect_all_slots();
-    g_signals.m_internals->Broadcast.disconnect_all_slots();
-    g_signals.m_internals->Inventory.disconnect_all_slots();
-    g_signals.m_internals->SetBestChain.disconnect_all_slots();
-    g_signals.m_internals->TransactionAddedToMempool.disconnect_all_slots();
-    g_signals.m_internals->BlockConnected.disconnect_all_slots();
-    g_signals.m_internals->BlockDisconnected.disconnect_all_slots();
-    g_signals.m_internals->TransactionRemovedFromMempool.disconnect_all_slots();
-    g_signals.m_internals->UpdatedBlockTip.disconnect_all_slots();
-    g_signals.m_internals->NewPoWValidBlock.disconnect_all_slots();
+    MainSignalsInstance& internals = *g_signals.m_internals;
+    LOCK(internals.m_cs_queues);
+    for (const auto& queue : internals.m_queues) {
+        queue->Disconnect();
+    }
+    internals.m_queues.clear();
 }
 
 void CallFunctionInValidationInterfaceQueue(std::function<void ()> func) {
-    g_signals.m_internals->m_schedulerClient.AddToProcessQueue(std::move(func));
+    MainSignalsInstance& internals = *g_signals.m_internals;
+    std::shared_ptr<SubscriberQueue> function_queue = internals.m_function_queue;
+    LOCK(internals.m_cs_queues);
+    if (internals.m_queues.empty()) {
+        function_queue->AddBarrier(std::move(func));
+        return;
+    }
+    // The last subscriber to reach its barrier queues func. A later call's barriers come
+    // after this call's in every queue, so the functions run in the order of the calls.
+    struct Barrier {
+        std::atomic<size_t> nRemaining;
+        std::function<void ()> func;
+    };
+    std::shared_ptr<Barrier> barrier = std::make_shared<Barrier>();
+    barrier->nRemaining = internals.m_queues.size();
+    barrier->func = std::move(func);
+    for (const auto& queue : internals.m_queues) {
+        queue->AddBarrier([barrier, function_queue] {
+            if (--barrier->nRemaining == 0) {
+                function_queue->AddBarrier(std::move(barrier->func));
+            }
+        });
+    }
 }
 
 void SyncWithValidationInterfaceQueue() {
@@ -132,56 +378,77 @@ void SyncWithValidationInterfaceQueue() {
 
 void CMainSignals::MempoolEntryRemoved(CTransactionRef ptx, MemPoolRemovalReason reason) {
     if (reason != MemPoolRemovalReason::BLOCK && reason != MemPoolRemovalReason::CONFLICT) {
-        m_internals->m_schedulerClient.AddToProcessQueue([ptx, this] {
-            m_internals->TransactionRemovedFromMempool(ptx);
+        m_internals->Notify([ptx](CValidationInterface* subscriber) {
+            subscriber->TransactionRemovedFromMempool(ptx);
         });
     }
 }
 
 void CMainSignals::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) {
-    m_internals->m_schedulerClient.AddToProcessQueue([pindexNew, pindexFork, fInitialDownload, this] {
-        m_internals->UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload);
+    m_internals->Notify([pindexNew, pindexFork, fInitialDownload](CValidationInterface* subscriber) {
+        subscriber->UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload);
     });
 }
 
 void CMainSignals::TransactionAddedToMempool(const CTransactionRef &ptx) {
-    m_internals->m_schedulerClient.AddToProcessQueue([ptx, this] {
-        m_internals->TransactionAddedToMempool(ptx);
+    m_internals->Notify([ptx](CValidationInterface* subscriber) {
+        subscriber->TransactionAddedToMempool(ptx);
     });
 }
 
 void CMainSignals::BlockConnected(const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex, const std::shared_ptr<const std::vector<CTransactionRef>>& pvtxConflicted) {
-    m_internals->m_schedulerClient.AddToProcessQueue([pblock, pindex, pvtxConflicted, this] {
-        m_internals->BlockConnected(pblock, pindex, *pvtxConflicted);
+    m_internals->Notify([pblock, pindex, pvtxConflicted](CValidationInterface* subscriber) {
+        subscriber->BlockConnected(pblock, pindex, *pvtxConflicted);
     });
 }
 
 void CMainSignals::BlockDisconnected(const std::shared_ptr<const CBlock> &pblock) {
-    m_internals->m_schedulerClient.AddToProcessQueue([pblock, this] {
-        m_internals->BlockDisconnected(pblock);
+    m_internals->Notify([pblock](CValidationInterface* subscriber) {
+        subscriber->BlockDisconnected(pblock);
     });
 }
 
 void CMainSignals::SetBestChain(const CBlockLocator &locator) {
-    m_internals->m_schedulerClient.AddToProcessQueue([locator, this] {
-        m_internals->SetBestChain(locator);
+    std::shared_ptr<const CBlockLocator> plocator = std::make_shared<const CBlockLocator>(locator);
+    m_internals->Notify([plocator](CValidationInterface* subscriber) {
+        subscriber->SetBestChain(*plocator);
     });
 }
 
 void CMainSignals::Inventory(const uint256 &hash) {
-    m_internals->m_schedulerClient.AddToProcessQueue([hash, this] {
-        m_internals->Inventory(hash);
+    m_internals->Notify([hash](CValidationInterface* subscriber) {
+        subscriber->Inventory(hash);
     });
 }
 
+// The synchronous notifications are delivered on the calling thread, in the order of registration
+
 void CMainSignals::Broadcast(int64_t nBestBlockTime, CConnman* connman) {
-    m_internals->Broadcast(nBestBlockTime, connman);
+    for (const auto& queue : m_internals->GetQueues()) {
+        queue->m_subscriber->ResendWalletTransactions(nBestBlockTime, connman);
+    }
 }
 
 void CMainSignals::BlockChecked(const CBlock& block, const CValidationState& state) {
-    m_internals->BlockChecked(block, state);
+    for (const auto& queue : m_internals->GetQueues()) {
+        queue->m_subscriber->BlockChecked(block, state);
+    }
 }
 
 void CMainSignals::NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock> &block) {
-    m_internals->NewPoWValidBlock(pindex, block);
+    for (const auto& queue : m_internals->GetQueues()) {
+        queue->m_subscriber->NewPoWValidBlock(pindex, block);
+    }
+}
+
+void CMainSignals::TransactionLocked(const CTransactionRef &ptx) {
+    m_internals->Notify([ptx](CValidationInterface* subscriber) {
+        subscriber->TransactionLocked(ptx);
+    });
+}
+
+void CMainSignals::GhostnodeStateChanged(const COutPoint &outpoint, int nState) {
+    m_internals->Notify([outpoint, nState](CValidationInterface* subscriber) {
+        subscriber->GhostnodeStateChanged(outpoint, nState);
+    });
 }
@@ -10,6 +10,8 @@
 
 #include <functional>
 #include <memory>
+#include <string>
+#include <vector>
 
 class CBlock;
 class CBlockIndex;
@@ -19,15 +21,49 @@ class CConnman;
 class CReserveScript;
 class CValidationInterface;
 class CValidationState;
+class COutPoint;
 class uint256;
 class CScheduler;
 class CTxMemPool;
 enum class MemPoolRemovalReason;
 
+/** What the queue of a subscriber does when it holds more notifications than its bound */
+enum class ValidationQueuePolicy {
+    /** Block validation, outside of cs_main, until the subscriber caught up */
+    BLOCK,
+    /** Drop the oldest notifications, for best-effort subscribers like ZMQ */
+    DROP,
+};
+
+/** Default for -maxvalidationqueue */
+static const unsigned int DEFAULT_MAX_VALIDATION_QUEUE = 10;
+/** Default for -maxnotificationqueue */
+static const unsigned int DEFAULT_MAX_NOTIFICATION_QUEUE = 1000;
+
+/** The state and statistics of the notification queue of one subscriber */
+struct ValidationQueueStats {
+    std::string name;
+    ValidationQueuePolicy policy;
+    size_t nDepth;
+    size_t nMaxDepth;
+    size_t nPeakDepth;
+    uint64_t nQueued;
+    uint64_t nProcessed;
+    uint64_t nDropped;
+    int64_t nTotalMicros;
+    int64_t nMaxMicros;
+    uint64_t nWaits;
+    int64_t nTotalWaitMicros;
+};
+
 // These functions dispatch to one or all registered wallets
 
-/** Register a wallet to receive updates from core */
-void RegisterValidationInterface(CValidationInterface* pwalletIn);
+/**
+ * Register a wallet to receive updates from core. Every subscriber gets its own
+ * queue, its notifications run in order on the scheduler, in parallel with those
+ * of the other subscribers, and the name shows in the queue statistics.
+ */
+void RegisterValidationInterface(CValidationInterface* pwalletIn, const std::string& name = "other", ValidationQueuePolicy policy = ValidationQueuePolicy::BLOCK);
 /** Unregister a wallet from core */
 void UnregisterValidationInterface(CValidationInterface* pwalletIn);
 /** Unregister all wallets from core */
@@ -116,9 +152,19 @@ protected:
      * Notifies listeners that a block which builds directly on our current tip
      * has been received and connected to the headers tree, though not validated yet */
     virtual void NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& block) {};
-    friend void ::RegisterValidationInterface(CValidationInterface*);
-    friend void ::UnregisterValidationInterface(CValidationInterface*);
-    friend void ::UnregisterAllValidationInterfaces();
+    /**
+     * Notifies listeners of an InstantSend lock on a transaction completing
+     *
+     * Called on a background thread.
+     */
+    virtual void TransactionLocked(const CTransactionRef &ptx) {}
+    /**
+     * Notifies listeners of the ghostnode with collateral outpoint changing its state
+     *
+     * Called on a background thread.
+     */
+    virtual void GhostnodeStateChanged(const COutPoint &outpoint, int nState) {}
+    friend class CMainSignals;
 };
 
 struct MainSignalsInstance;
@@ -126,7 +172,7 @@ class CMainSignals {
 private:
     std::unique_ptr<MainSignalsInstance> m_internals;
 
-    friend void ::RegisterValidationInterface(CValidationInterface*);
+    friend void ::RegisterValidationInterface(CValidationInterface*, const std::string&, ValidationQueuePolicy);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
     friend void ::CallFunctionInValidationInterfaceQueue(std::function<void ()> func);
@@ -141,7 +187,14 @@ public:
     /** Call any remaining callbacks on the calling thread */
     void FlushBackgroundCallbacks();
 
+    /** Number of notifications waiting in the queues of all subscribers */
     size_t CallbacksPending();
+    /**
+     * Block until every subscriber queue with the BLOCK policy holds no more than
+     * its bound, waiting for those over it to drain. Must not be called with cs_main.
+     */
+    void WaitForSubscriberQueues();
+    std::vector<ValidationQueueStats> GetQueueStats();
 
     /** Register with mempool to call TransactionRemovedFromMempool callbacks */
     void RegisterWithMempoolSignals(CTxMemPool& pool);
@@ -157,6 +210,8 @@ public:
     void Broadcast(int64_t nBestBlockTime, CConnman* connman);
     void BlockChecked(const CBlock&, const CValidationState&);
     void NewPoWValidBlock(const CBlockIndex *, const std::shared_ptr<const CBlock>&);
+    void TransactionLocked(const CTransactionRef &);
+    void GhostnodeStateChanged(const COutPoint &, int nState);
 };
 
 CMainSignals& GetMainSignals();
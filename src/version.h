@@ -9,7 +9,7 @@
  * network protocol versioning
  */
 
-static const int PROTOCOL_VERSION = 70015;
+static const int PROTOCOL_VERSION = 70017;
 
 //! initial proto version, to be increased after version/verack negotiation
 static const int INIT_PROTO_VERSION = 209;
@@ -42,4 +42,10 @@ static const int SHORT_IDS_BLOCKS_VERSION = 70014;
 //! not banning for invalid compact blocks starts with this version
 static const int INVALID_CB_NO_BAN_VERSION = 70015;
 
+//! "mnwv" batches of ghostnode payment votes are understood starting with this version
+static const int GHOSTNODE_PAYMENT_VOTES_VERSION = 70016;
+
+//! "pkgtxs" packages of dependent transactions are understood starting with this version
+static const int PACKAGE_RELAY_VERSION = 70017;
+
 #endif // BITCOIN_VERSION_H
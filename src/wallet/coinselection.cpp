@@ -0,0 +1,129 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <wallet/coinselection.h>
+
+#include <libzerocoin/Coin.h>
+
+#include <algorithm>
+
+bool SelectCoinsBnB(std::vector<CInputCoin>& vUtxoPool, const CAmount& nTarget, const CoinSelectionParams& params,
+                     std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet, size_t nMaxTries)
+{
+    setCoinsRet.clear();
+    nValueRet = 0;
+
+    CAmount nAvailable = 0;
+    for (const CInputCoin& coin : vUtxoPool)
+        nAvailable += coin.txout.nValue;
+    if (nAvailable < nTarget)
+        return false;
+
+    std::sort(vUtxoPool.begin(), vUtxoPool.end(), [](const CInputCoin& a, const CInputCoin& b) {
+        return a.txout.nValue > b.txout.nValue;
+    });
+
+    // vCurrSelection[i] is whether vUtxoPool[i] is in the selection, for the coins decided so far
+    std::vector<bool> vCurrSelection;
+    std::vector<bool> vBestSelection;
+    vCurrSelection.reserve(vUtxoPool.size());
+    CAmount nCurrValue = 0;
+    CAmount nCurrWaste = 0;
+    CAmount nBestWaste = MAX_MONEY;
+
+    for (size_t nTries = 0; nTries < nMaxTries; nTries++) {
+        bool fBacktrack = false;
+        if (nCurrValue + nAvailable < nTarget ||
+            nCurrValue > nTarget + params.nCostOfChange ||
+            (nCurrWaste > nBestWaste && params.nInputWaste > 0)) {
+            // More inputs can't reach the target, or only make the selection worse
+            fBacktrack = true;
+        } else if (nCurrValue >= nTarget) {
+            // The excess goes to the fee
+            CAmount nWaste = nCurrWaste + nCurrValue - nTarget;
+            if (nWaste <= nBestWaste) {
+                vBestSelection = vCurrSelection;
+                vBestSelection.resize(vUtxoPool.size());
+                nBestWaste = nWaste;
+                if (nBestWaste == 0 && params.nInputWaste >= 0)
+                    break;
+            }
+            fBacktrack = true;
+        }
+
+        if (fBacktrack) {
+            // Step back to the last coin included, giving back the coins excluded after it
+            while (!vCurrSelection.empty() && !vCurrSelection.back()) {
+                vCurrSelection.pop_back();
+                nAvailable += vUtxoPool[vCurrSelection.size()].txout.nValue;
+            }
+            if (vCurrSelection.empty())
+                break; // Every branch was searched
+            // And try the branch excluding it
+            vCurrSelection.back() = false;
+            nCurrValue -= vUtxoPool[vCurrSelection.size() - 1].txout.nValue;
+            nCurrWaste -= params.nInputWaste;
+        } else {
+            const CInputCoin& coin = vUtxoPool[vCurrSelection.size()];
+            nAvailable -= coin.txout.nValue;
+            // A coin worth the same as the previous one, which was excluded, would only repeat its branches
+            if (!vCurrSelection.empty() && !vCurrSelection.back() &&
+                coin.txout.nValue == vUtxoPool[vCurrSelection.size() - 1].txout.nValue) {
+                vCurrSelection.push_back(false);
+            } else {
+                vCurrSelection.push_back(true);
+                nCurrValue += coin.txout.nValue;
+                nCurrWaste += params.nInputWaste;
+            }
+        }
+    }
+
+    if (vBestSelection.empty())
+        return false;
+
+    for (size_t i = 0; i < vBestSelection.size(); i++) {
+        if (vBestSelection[i]) {
+            setCoinsRet.insert(vUtxoPool[i]);
+            nValueRet += vUtxoPool[i].txout.nValue;
+        }
+    }
+    return true;
+}
+
+bool GetMintDenominations(CAmount nValue, std::vector<CAmount>& vDenominations)
+{
+    vDenominations.clear();
+    for (auto it = libzerocoin::denominationList.rbegin(); it != libzerocoin::denominationList.rend(); ++it) {
+        CAmount nDenom = libzerocoin::ZerocoinDenominationToAmount(*it);
+        while (nValue >= nDenom) {
+            vDenominations.push_back(nDenom);
+            nValue -= nDenom;
+        }
+    }
+    return nValue == 0;
+}
+
+bool SelectCoinsMintDenominations(std::vector<CInputCoin>& vUtxoPool, const CAmount& nMaxMint, const CAmount& nFee,
+                                  const CoinSelectionParams& params, std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet, CAmount& nMintRet)
+{
+    setCoinsRet.clear();
+    nValueRet = 0;
+    nMintRet = 0;
+
+    CAmount nAvailable = 0;
+    for (const CInputCoin& coin : vUtxoPool)
+        nAvailable += coin.txout.nValue;
+
+    const CAmount nSmallest = libzerocoin::ZerocoinDenominationToAmount(libzerocoin::denominationList.front());
+    CAmount nMint = std::min(nMaxMint, nAvailable - nFee);
+    nMint -= nMint % nSmallest;
+
+    for (int i = 0; i < MINT_SELECTION_TOTALS && nMint > 0; i++, nMint -= nSmallest) {
+        if (SelectCoinsBnB(vUtxoPool, nMint + nFee, params, setCoinsRet, nValueRet, BNB_TOTAL_TRIES / MINT_SELECTION_TOTALS)) {
+            nMintRet = nMint;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,58 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NIX_WALLET_COINSELECTION_H
+#define NIX_WALLET_COINSELECTION_H
+
+#include <amount.h>
+#include <wallet/wallet.h>
+
+#include <set>
+#include <vector>
+
+//! Selections the branch and bound search looks at before giving up
+static const size_t BNB_TOTAL_TRIES = 100000;
+//! Serialized size of an input spending a pay to pubkey hash output, like the change later would be
+static const unsigned int CHANGE_SPEND_SIZE = 148;
+//! Confirmation target the long term feerate of an input is estimated for
+static const unsigned int LONG_TERM_FEE_TARGET = 1008;
+//! Mint totals the mint denomination selection tries, from the largest down
+static const int MINT_SELECTION_TOTALS = 32;
+
+/** What selecting inputs without a change output is weighed with */
+struct CoinSelectionParams
+{
+    //! Fee of creating the change output and spending it later. A selection exceeding the target by no
+    //! more than this is better off giving the excess to the fee. 0 disables branch and bound.
+    CAmount nCostOfChange = 0;
+    //! Fee of an input at the current feerate less its fee at the long term feerate, may be negative
+    CAmount nInputWaste = 0;
+    //! Set by the selection when the coins returned don't need a change output
+    bool fUsedBnB = false;
+};
+
+/**
+ * Branch and bound search for the set of coins matching nTarget without change, as described in
+ * "An Evaluation of Coin Selection Strategies" (Erhardt 2016).
+ *
+ * Selections worth between nTarget and nTarget + nCostOfChange are compared by waste: the excess
+ * given to the fee, plus nInputWaste for each input. The coins are tried largest first, and a
+ * branch is cut as soon as it can't reach the target, exceeds the window or wastes more than the
+ * best selection found. Gives up after BNB_TOTAL_TRIES selections.
+ */
+bool SelectCoinsBnB(std::vector<CInputCoin>& vUtxoPool, const CAmount& nTarget, const CoinSelectionParams& params,
+                     std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet, size_t nMaxTries = BNB_TOTAL_TRIES);
+
+/** Split nValue in Zerocoin mint denominations, largest first. False if nValue isn't a whole number of the smallest */
+bool GetMintDenominations(CAmount nValue, std::vector<CAmount>& vDenominations);
+
+/**
+ * Select coins paying exactly for minting nMintRet worth of Zerocoin denominations plus nFee, so
+ * that the mint has no change output. The largest mint total no more than nMaxMint is tried first,
+ * then the next whole denominations down, MINT_SELECTION_TOTALS of them at most.
+ */
+bool SelectCoinsMintDenominations(std::vector<CInputCoin>& vUtxoPool, const CAmount& nMaxMint, const CAmount& nFee,
+                                  const CoinSelectionParams& params, std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet, CAmount& nMintRet);
+
+#endif // NIX_WALLET_COINSELECTION_H
@@ -170,6 +170,7 @@ bool CCryptoKeyStore::Lock()
     {
         LOCK(cs_KeyStore);
         vMasterKey.clear();
+        mapDecryptedKeys.clear();
     }
 
     NotifyStatusChanged(this);
@@ -182,39 +183,23 @@ bool CCryptoKeyStore::Unlock(const CKeyingMaterial& vMasterKeyIn)
         LOCK(cs_KeyStore);
         if (!SetCrypted())
             return false;
-        bool keyPass = false;
-        bool keyFail = false;
 
-        size_t nTries = 0;
-        CryptedKeyMap::const_iterator mi = mapCryptedKeys.begin();
-        for (; mi != mapCryptedKeys.end(); ++mi)
+        // The passphrase is checked against a single key, the others are decrypted when first used
+        for (const auto &mi : mapCryptedKeys)
         {
-            const CPubKey &vchPubKey = (*mi).second.first;
-            const std::vector<unsigned char> &vchCryptedSecret = (*mi).second.second;
+            const CPubKey &vchPubKey = mi.second.first;
+            const std::vector<unsigned char> &vchCryptedSecret = mi.second.second;
 
             if (vchCryptedSecret.size() == 0) // unexpanded key received on stealth address
                 continue;
 
-            nTries++;
             CKey key;
             if (!DecryptKey(vMasterKeyIn, vchCryptedSecret, vchPubKey, key))
-            {
-                keyFail = true;
-                break;
-            }
-            keyPass = true;
-            if (fDecryptionThoroughlyChecked)
-                break;
+                return false;
+            mapDecryptedKeys[mi.first] = key;
+            break;
         }
-        if (keyPass && keyFail)
-        {
-            LogPrintf("The wallet is probably corrupted: Some keys decrypt but not all.\n");
-            assert(false);
-        }
-        if (keyFail || (!keyPass && nTries > 0))
-            return false;
         vMasterKey = vMasterKeyIn;
-        fDecryptionThoroughlyChecked = true;
     }
     NotifyStatusChanged(this);
     return true;
@@ -251,6 +236,7 @@ bool CCryptoKeyStore::AddCryptedKey(const CPubKey &vchPubKey, const std::vector<
     }
 
     mapCryptedKeys[vchPubKey.GetID()] = make_pair(vchPubKey, vchCryptedSecret);
+    mapDecryptedKeys.erase(vchPubKey.GetID());
     ImplicitlyLearnRelatedKeyScripts(vchPubKey);
     return true;
 }
@@ -284,12 +270,30 @@ bool CCryptoKeyStore::GetKey(const CKeyID &address, CKey& keyOut) const
         return CBasicKeyStore::GetKey(address, keyOut);
     }
 
+    if (vMasterKey.empty())
+        return false;
+
+    std::map<CKeyID, CKey>::const_iterator mdi = mapDecryptedKeys.find(address);
+    if (mdi != mapDecryptedKeys.end())
+    {
+        keyOut = mdi->second;
+        return true;
+    }
+
     CryptedKeyMap::const_iterator mi = mapCryptedKeys.find(address);
     if (mi != mapCryptedKeys.end())
     {
         const CPubKey &vchPubKey = (*mi).second.first;
         const std::vector<unsigned char> &vchCryptedSecret = (*mi).second.second;
-        return DecryptKey(vMasterKey, vchCryptedSecret, vchPubKey, keyOut);
+        if (vchCryptedSecret.size() == 0)
+            return false;
+        if (!DecryptKey(vMasterKey, vchCryptedSecret, vchPubKey, keyOut))
+        {
+            LogPrintf("The wallet is probably corrupted: Key %s does not decrypt with the master key.\n", address.ToString());
+            return false;
+        }
+        mapDecryptedKeys[address] = keyOut;
+        return true;
     }
     return false;
 }
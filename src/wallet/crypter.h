@@ -125,8 +125,8 @@ private:
     //! if fUseCrypto is false, vMasterKey must be empty
     std::atomic<bool> fUseCrypto;
 
-    //! keeps track of whether Unlock has run a thorough check before
-    bool fDecryptionThoroughlyChecked;
+    //! keys decrypted on first use since the last unlock, the secrets of CKey live in locked memory
+    mutable std::map<CKeyID, CKey> mapDecryptedKeys;
     bool fOnlyMixingAllowed;
 
 protected:
@@ -139,7 +139,7 @@ protected:
     CryptedKeyMap mapCryptedKeys;
 
 public:
-    CCryptoKeyStore() : fUseCrypto(false), fDecryptionThoroughlyChecked(false)
+    CCryptoKeyStore() : fUseCrypto(false)
     {
     }
 
@@ -649,32 +649,21 @@ bool CDB::PeriodicFlush(CWalletDBWrapper& dbw)
     TRY_LOCK(bitdb.cs_db,lockDb);
     if (lockDb)
     {
-        // Don't do this if any databases are in use
-        int nRefCount = 0;
-        std::map<std::string, int>::iterator mit = env->mapFileUseCount.begin();
-        while (mit != env->mapFileUseCount.end())
-        {
-            nRefCount += (*mit).second;
-            mit++;
-        }
-
-        if (nRefCount == 0)
+        std::map<std::string, int>::iterator mi = env->mapFileUseCount.find(strFile);
+        if (mi != env->mapFileUseCount.end())
         {
             boost::this_thread::interruption_point();
-            std::map<std::string, int>::iterator mi = env->mapFileUseCount.find(strFile);
-            if (mi != env->mapFileUseCount.end())
-            {
-                LogPrint(BCLog::DB, "Flushing %s\n", strFile);
-                int64_t nStart = GetTimeMillis();
+            LogPrint(BCLog::DB, "Flushing %s\n", strFile);
+            int64_t nStart = GetTimeMillis();
 
-                // Flush wallet file so it's self contained
-                env->CloseDb(strFile);
-                env->CheckpointLSN(strFile);
+            // Move the logged changes to the wallet file. Unlike CheckpointLSN this doesn't reset the
+            // LSN of every page, which rewrites the whole file: the file only needs to be self contained
+            // when it leaves the environment, on close, backup and rewrite. Databases in use don't need
+            // to be closed for a checkpoint either.
+            env->dbenv->txn_checkpoint(0, 0, 0);
 
-                env->mapFileUseCount.erase(mi++);
-                LogPrint(BCLog::DB, "Flushed %s %dms\n", strFile, GetTimeMillis() - nStart);
-                ret = true;
-            }
+            LogPrint(BCLog::DB, "Flushed %s %dms\n", strFile, GetTimeMillis() - nStart);
+            ret = true;
         }
     }
 
@@ -10,6 +10,7 @@
 #include <utilmoneystr.h>
 #include <validation.h>
 #include <wallet/rpcwallet.h>
+#include <wallet/rescan.h>
 #include <wallet/wallet.h>
 #include <wallet/walletutil.h>
 
@@ -29,7 +30,9 @@ std::string GetWalletHelpString(bool showDebug)
                                                             CURRENCY_UNIT, FormatMoney(DEFAULT_TRANSACTION_MINFEE)));
     strUsage += HelpMessageOpt("-paytxfee=<amt>", strprintf(_("Fee (in %s/kB) to add to transactions you send (default: %s)"),
                                                             CURRENCY_UNIT, FormatMoney(payTxFee.GetFeePerK())));
+    strUsage += HelpMessageOpt("-indexedrescan", strprintf(_("Only rescan the blocks the address index has the keys and scripts of the wallet in. Payments to other script types, such as pay to pubkey and native segwit outputs, are not found (default: %u)"), DEFAULT_INDEXED_RESCAN));
     strUsage += HelpMessageOpt("-rescan", _("Rescan the block chain for missing wallet transactions on startup"));
+    strUsage += HelpMessageOpt("-rescanthreads=<n>", strprintf(_("Set the number of threads reading blocks ahead during a rescan (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"), 1, MAX_RESCAN_THREADS, DEFAULT_RESCAN_THREADS));
     strUsage += HelpMessageOpt("-salvagewallet", _("Attempt to recover private keys from a corrupt wallet on startup"));
     strUsage += HelpMessageOpt("-spendzeroconfchange", strprintf(_("Spend unconfirmed change when sending transactions (default: %u)"), DEFAULT_SPEND_ZEROCONF_CHANGE));
     strUsage += HelpMessageOpt("-txconfirmtarget=<n>", strprintf(_("If paytxfee is not set, include enough fee so transactions begin confirmation on average within n blocks (default: %u)"), DEFAULT_TX_CONFIRM_TARGET));
@@ -305,6 +308,7 @@ void FlushWallets() {
 
 void StopWallets() {
     for (CWalletRef pwallet : vpwallets) {
+        pwallet->zerocoinSpendQueue.Stop();
         pwallet->Flush(true);
     }
 }
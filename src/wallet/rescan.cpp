@@ -0,0 +1,109 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <wallet/rescan.h>
+
+#include <chainparams.h>
+#include <util.h>
+#include <validation.h>
+#include <wallet/wallet.h>
+
+#include <algorithm>
+
+int GetRescanThreads()
+{
+    int nThreads = gArgs.GetArg("-rescanthreads", DEFAULT_RESCAN_THREADS);
+    if (nThreads <= 0)
+        nThreads += GetNumCores();
+    return std::max(1, std::min(nThreads, MAX_RESCAN_THREADS));
+}
+
+CRescanReadAhead::CRescanReadAhead(const CWallet& walletIn, const CStealthScanner& stealthScannerIn, int nThreads)
+    : wallet(walletIn), stealthScanner(stealthScannerIn), fStop(false)
+{
+    for (int i = 0; i < nThreads; i++)
+        vThreads.emplace_back(&CRescanReadAhead::ThreadRead, this);
+}
+
+CRescanReadAhead::~CRescanReadAhead()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fStop = true;
+    }
+    cvWork.notify_all();
+    for (std::thread& thread : vThreads)
+        thread.join();
+}
+
+void CRescanReadAhead::Push(CBlockIndex* pindex)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.emplace_back(new CRescanBlock(pindex));
+    }
+    cvWork.notify_one();
+}
+
+size_t CRescanReadAhead::Size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return queue.size();
+}
+
+std::unique_ptr<CRescanBlock> CRescanReadAhead::Pop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (queue.empty())
+        return nullptr;
+    cvReady.wait(lock, [this] { return queue.front()->fReady; });
+    std::unique_ptr<CRescanBlock> rb = std::move(queue.front());
+    queue.pop_front();
+    return rb;
+}
+
+void CRescanReadAhead::Match(CRescanBlock& rb) const
+{
+    // Read the generation first, a key added while matching makes the block be looked at again
+    rb.nKeyGeneration = wallet.GetKeyGeneration();
+    rb.vMine.resize(rb.block.vtx.size());
+    for (size_t i = 0; i < rb.block.vtx.size(); i++)
+        rb.vMine[i] = wallet.IsMine(*rb.block.vtx[i]);
+    if (!stealthScanner.GetKeys().empty())
+        stealthScanner.Scan(rb.block.vtx, rb.vStealth);
+}
+
+void CRescanReadAhead::ThreadRead()
+{
+    RenameThread("nix-rescan");
+
+    while (true) {
+        CRescanBlock* rb = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cvWork.wait(lock, [this, &rb] {
+                if (fStop)
+                    return true;
+                auto it = std::find_if(queue.begin(), queue.end(), [](const std::unique_ptr<CRescanBlock>& p) { return !p->fClaimed; });
+                if (it == queue.end())
+                    return false;
+                rb = it->get();
+                return true;
+            });
+            if (fStop)
+                return;
+            rb->fClaimed = true;
+        }
+
+        rb->fRead = ReadBlockFromDisk(rb->block, rb->pindex, Params().GetConsensus());
+        if (rb->fRead)
+            Match(*rb);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            rb->fReady = true;
+        }
+        cvReady.notify_all();
+    }
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NIX_WALLET_RESCAN_H
+#define NIX_WALLET_RESCAN_H
+
+#include <primitives/block.h>
+#include <wallet/stealthscan.h>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class CBlockIndex;
+class CWallet;
+
+//! -rescanthreads default, 0 = one per core
+static const int DEFAULT_RESCAN_THREADS = 0;
+//! Maximum number of threads reading and matching blocks during a rescan
+static const int MAX_RESCAN_THREADS = 16;
+//! Blocks read ahead of the wallet, per thread
+static const int RESCAN_READ_AHEAD_PER_THREAD = 16;
+
+/** A block of a rescan, read and matched against the keys of the wallet ahead of being committed */
+struct CRescanBlock
+{
+    CBlockIndex* pindex;
+    bool fRead = false;                   //!< The block could be read from disk
+    CBlock block;
+    std::vector<bool> vMine;              //!< Per transaction, whether one of its outputs is mine
+    std::vector<CStealthMatch> vStealth;  //!< Outputs paying to the stealth keys of the wallet
+    uint64_t nKeyGeneration = 0;          //!< Key generation of the wallet the outputs were matched with
+
+    bool fClaimed = false;
+    bool fReady = false;
+
+    explicit CRescanBlock(CBlockIndex* pindexIn) : pindex(pindexIn) {}
+};
+
+/**
+ * Reads the blocks of a wallet rescan on worker threads, ahead of the thread committing them to the
+ * wallet in chain order, and matches their outputs against the keys of the wallet on the way.
+ *
+ * The matching only takes the keystore lock, never cs_main or cs_wallet. The committing thread then
+ * only has to look again at the transactions matched and the ones spending wallet outputs, unless a
+ * key was added to the wallet after the block was matched (see CWallet::GetKeyGeneration), in which
+ * case every transaction of the block is looked at again.
+ */
+class CRescanReadAhead
+{
+private:
+    const CWallet& wallet;
+    const CStealthScanner stealthScanner;
+
+    mutable std::mutex mutex;
+    std::condition_variable cvWork;
+    std::condition_variable cvReady;
+    std::deque<std::unique_ptr<CRescanBlock>> queue;
+    bool fStop;
+    std::vector<std::thread> vThreads;
+
+    void ThreadRead();
+    void Match(CRescanBlock& rb) const;
+
+public:
+    CRescanReadAhead(const CWallet& walletIn, const CStealthScanner& stealthScannerIn, int nThreads);
+    ~CRescanReadAhead();
+
+    /** Queue a block to be read */
+    void Push(CBlockIndex* pindex);
+    /** Number of blocks queued and not popped yet */
+    size_t Size() const;
+    /** Take the oldest block queued, waiting for it to be read. Returns nullptr if none is queued */
+    std::unique_ptr<CRescanBlock> Pop();
+};
+
+/** Number of threads to read a rescan with, from -rescanthreads */
+int GetRescanThreads();
+
+#endif // NIX_WALLET_RESCAN_H
@@ -380,6 +380,7 @@ UniValue importprunedfunds(const JSONRPCRequest& request)
     LOCK2(cs_main, pwallet->cs_wallet);
 
     if (pwallet->IsMine(*wtx.tx)) {
+        pwallet->AddChainViewBlock(mapBlockIndex[wtx.hashBlock]);
         pwallet->AddToWallet(wtx, false);
         return NullUniValue;
     }
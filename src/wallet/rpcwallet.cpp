@@ -2822,9 +2822,10 @@ UniValue getwalletinfo(const JSONRPCRequest& request)
     size_t kpExternalSize = pwallet->KeypoolCountExternalKeys();
     obj.push_back(Pair("walletname", pwallet->GetName()));
     obj.push_back(Pair("walletversion", pwallet->GetVersion()));
-    obj.push_back(Pair("balance",       ValueFromAmount(pwallet->GetBalance())));
-    obj.push_back(Pair("unconfirmed_balance", ValueFromAmount(pwallet->GetUnconfirmedBalance())));
-    obj.push_back(Pair("immature_balance",    ValueFromAmount(pwallet->GetImmatureBalance())));
+    CWalletBalances balances = pwallet->GetBalances();
+    obj.push_back(Pair("balance",       ValueFromAmount(balances.nTrusted)));
+    obj.push_back(Pair("unconfirmed_balance", ValueFromAmount(balances.nUntrusted)));
+    obj.push_back(Pair("immature_balance",    ValueFromAmount(balances.nImmature)));
     obj.push_back(Pair("txcount",       (int)pwallet->mapWallet.size()));
     obj.push_back(Pair("keypoololdest", pwallet->GetOldestKeyPoolTime()));
     obj.push_back(Pair("keypoolsize", (int64_t)kpExternalSize));
@@ -3698,7 +3699,6 @@ UniValue mintzerocoin(const JSONRPCRequest& request)
         if (strError != "")
             throw JSONRPCError(RPC_WALLET_ERROR, strError);
 
-        CWalletDB walletdb(pwalletMain->GetDBHandle());
         const unsigned char *ecdsaSecretKey = newCoin.getEcdsaSeckey();
         CZerocoinEntry zerocoinTx;
         zerocoinTx.IsUsed = false;
@@ -3711,7 +3711,7 @@ UniValue mintzerocoin(const JSONRPCRequest& request)
         LogPrintf("pubcoin=%s, isUsed=%s\n", zerocoinTx.value.GetHex(), zerocoinTx.IsUsed);
         LogPrintf("randomness=%s, serialNumber=%s\n", zerocoinTx.randomness.ToString(), zerocoinTx.serialNumber.ToString());
         pwalletMain->NotifyZerocoinChanged(pwalletMain, zerocoinTx.value.GetHex(), zerocoinTx.denomination, zerocoinTx.IsUsed ? "Used" : "New", CT_NEW);
-        if (!walletdb.WriteZerocoinEntry(zerocoinTx))
+        if (!pwalletMain->WriteZerocoinEntry(zerocoinTx))
             return false;
     } else {
         return "";
@@ -3794,6 +3794,78 @@ UniValue spendzerocoin(const JSONRPCRequest& request) {
 
 }
 
+UniValue spendzerocoinasync(const JSONRPCRequest& request) {
+
+    CWallet * const pwalletMain = GetWalletForJSONRPCRequest(request);
+
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw runtime_error(
+                "spendzerocoinasync <amount>(1,5,10,50,100,500,1000,5000) <spendtoaddress>(optional)\n"
+                "Queue a zerocoin spend, the spend proof is built and committed in the background.\n"
+                "Returns the id of the request, see getzerocoinspendstatus.\n"
+                + HelpRequiringPassphrase(pwalletMain));
+
+    int64_t nAmount = AmountFromValue(request.params[0]);
+    libzerocoin::CoinDenomination denomination = libzerocoin::AmountToZerocoinDenomination(nAmount);
+    if (denomination == libzerocoin::ZQ_ERROR)
+        throw runtime_error("spendzerocoinasync <amount>(1,5,10,50,100,500,1000,5000) <spendtoaddress>(optional)\n");
+
+    string toKey = "";
+    if (request.params.size() > 1){
+        // Address
+        toKey = request.params[1].get_str();
+        if(!IsStealthAddress(toKey))
+            if (!CBitcoinAddress(toKey).IsValid())
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "rpcwallet spendzerocoinasync(): Invalid toKey address");
+    }
+
+    if (pwalletMain->IsLocked())
+        throw JSONRPCError(RPC_WALLET_UNLOCK_NEEDED,
+                           "Error: Please enter the wallet passphrase with walletpassphrase first.");
+
+    return pwalletMain->zerocoinSpendQueue.Add(toKey, nAmount, denomination);
+}
+
+static UniValue ZerocoinSpendRequestToJSON(const CZerocoinSpendRequest &spendRequest)
+{
+    UniValue entry(UniValue::VOBJ);
+    entry.push_back(Pair("id", spendRequest.nId));
+    entry.push_back(Pair("status", ZerocoinSpendStatusString(spendRequest.status)));
+    entry.push_back(Pair("denomination", (int)spendRequest.denomination));
+    entry.push_back(Pair("address", spendRequest.toKey));
+    entry.push_back(Pair("timequeued", spendRequest.nTimeQueued));
+    if (spendRequest.status == ZerocoinSpendStatus::COMMITTED)
+        entry.push_back(Pair("txid", spendRequest.txHash.GetHex()));
+    if (spendRequest.status == ZerocoinSpendStatus::FAILED)
+        entry.push_back(Pair("error", spendRequest.strError));
+    if (spendRequest.nTimeFinished)
+        entry.push_back(Pair("timefinished", spendRequest.nTimeFinished));
+    return entry;
+}
+
+UniValue getzerocoinspendstatus(const JSONRPCRequest& request) {
+    if (request.fHelp || request.params.size() > 1)
+        throw runtime_error(
+                "getzerocoinspendstatus <id>(optional)\n"
+                "Status of a spend queued with spendzerocoinasync, or of all of the known ones without an id.\n"
+                "\nResults are Objects, each of which has:\n"
+                "{id, status(queued/proving/committed/failed), denomination, address, timequeued, txid, error, timefinished}");
+
+    CWallet * const pwalletMain = GetWalletForJSONRPCRequest(request);
+
+    if (request.params.size() > 0) {
+        CZerocoinSpendRequest spendRequest;
+        if (!pwalletMain->zerocoinSpendQueue.Get(request.params[0].get_int64(), spendRequest))
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown zerocoin spend request");
+        return ZerocoinSpendRequestToJSON(spendRequest);
+    }
+
+    UniValue results(UniValue::VARR);
+    for (const CZerocoinSpendRequest &spendRequest: pwalletMain->zerocoinSpendQueue.List())
+        results.push_back(ZerocoinSpendRequestToJSON(spendRequest));
+    return results;
+}
+
 UniValue resetmintzerocoin(const JSONRPCRequest& request) {
 
     CWallet * const pwalletMain = GetWalletForJSONRPCRequest(request);
@@ -3805,9 +3877,9 @@ UniValue resetmintzerocoin(const JSONRPCRequest& request) {
 
 
     list <CZerocoinEntry> listPubcoin;
-    CWalletDB walletdb(pwalletMain->GetDBHandle());
-    walletdb.ListPubCoin(listPubcoin);
+    pwalletMain->ListZerocoinEntries(listPubcoin);
 
+    std::vector<CZerocoinEntry> vReset;
     for(const CZerocoinEntry &zerocoinItem: listPubcoin){
         if (zerocoinItem.randomness != 0 && zerocoinItem.serialNumber != 0) {
             CZerocoinEntry zerocoinTx;
@@ -3817,9 +3889,10 @@ UniValue resetmintzerocoin(const JSONRPCRequest& request) {
             zerocoinTx.serialNumber = zerocoinItem.serialNumber;
             zerocoinTx.nHeight = -1;
             zerocoinTx.randomness = zerocoinItem.randomness;
-            walletdb.WriteZerocoinEntry(zerocoinTx);
+            vReset.push_back(zerocoinTx);
         }
     }
+    pwalletMain->WriteZerocoinEntries(vReset);
 
     return NullUniValue;
 }
@@ -3841,8 +3914,7 @@ UniValue listmintzerocoins(const JSONRPCRequest& request) {
     CWallet * const pwalletMain = GetWalletForJSONRPCRequest(request);
 
     list <CZerocoinEntry> listPubcoin;
-    CWalletDB walletdb(pwalletMain->GetDBHandle());
-    walletdb.ListPubCoin(listPubcoin);
+    pwalletMain->ListZerocoinEntries(listPubcoin);
     UniValue results(UniValue::VARR);
 
     for(const CZerocoinEntry &zerocoinItem: listPubcoin) {
@@ -3879,8 +3951,10 @@ UniValue listpubcoins(const JSONRPCRequest& request) {
     CWallet * const pwalletMain = GetWalletForJSONRPCRequest(request);
 
     list <CZerocoinEntry> listPubcoin;
-    CWalletDB walletdb(pwalletMain->GetDBHandle());
-    walletdb.ListPubCoin(listPubcoin);
+    if (denomination < 0)
+        pwalletMain->ListZerocoinEntries(listPubcoin);
+    else
+        pwalletMain->ListZerocoinEntries(denomination, listPubcoin);
     UniValue results(UniValue::VARR);
     listPubcoin.sort(CompID);
 
@@ -3918,8 +3992,7 @@ UniValue setmintzerocoinstatus(const JSONRPCRequest& request) {
     CWallet * const pwalletMain = GetWalletForJSONRPCRequest(request);
 
     list <CZerocoinEntry> listPubcoin;
-    CWalletDB walletdb(pwalletMain->GetDBHandle());
-    walletdb.ListPubCoin(listPubcoin);
+    pwalletMain->ListZerocoinEntries(listPubcoin);
 
     UniValue results(UniValue::VARR);
 
@@ -3940,7 +4013,7 @@ UniValue setmintzerocoinstatus(const JSONRPCRequest& request) {
                         ? "Used (" + std::to_string(zerocoinTx.denomination) + " mint)"
                         : "New (" + std::to_string(zerocoinTx.denomination) + " mint)";
                 pwalletMain->NotifyZerocoinChanged(pwalletMain, zerocoinTx.value.GetHex(), zerocoinTx.denomination, isUsedDenomStr, CT_UPDATED);
-                walletdb.WriteZerocoinEntry(zerocoinTx);
+                pwalletMain->WriteZerocoinEntry(zerocoinTx);
 
                 UniValue entry(UniValue::VOBJ);
                 entry.push_back(Pair("id", zerocoinTx.id));
@@ -4496,6 +4569,8 @@ static const CRPCCommand commands[] =
 //    { "NIX Ghost Protocol",             "listunghostednix", &listunspentmintzerocoins, {} },
 //    { "NIX Ghost Protocol",             "ghostnix",             &mintzerocoin,             {"amount"} },
 //    { "NIX Ghost Protocol",             "spendghostednix",            &spendzerocoin,            {"amount"} },
+//    { "NIX Ghost Protocol",             "spendghostednixasync",       &spendzerocoinasync,       {"amount","spendtoaddress"} },
+//    { "NIX Ghost Protocol",             "getghostednixspendstatus",   &getzerocoinspendstatus,   {"id"} },
 //    { "NIX Ghost Protocol",             "resetghostednix",        &resetmintzerocoin,        {} },
 //    { "NIX Ghost Protocol",             "setghostednixstatus",    &setmintzerocoinstatus,    {} },
 //    { "NIX Ghost Protocol",             "listghostednix",        &listmintzerocoins,        {} },
@@ -0,0 +1,91 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <wallet/stealthscan.h>
+
+#include <ghost-address/stealth.h>
+#include <script/standard.h>
+
+#include <map>
+#include <set>
+
+size_t CStealthScanner::Scan(const std::vector<CTransactionRef>& vtx, std::vector<CStealthMatch>& vMatches) const
+{
+    if (vKeys.empty())
+        return 0;
+
+    // Transactions carrying an ephemeral key, the same key could be reused by several
+    struct Occurrence
+    {
+        size_t nTx;
+        bool fHavePrefix;
+        uint32_t nPrefix;
+    };
+    std::map<ec_point, std::vector<Occurrence>> mapEphem;
+    // Keys the pay to pubkey hash outputs of the transactions with stealth data pay to
+    std::map<size_t, std::set<CKeyID>> mapTxKeys;
+
+    for (size_t nTx = 0; nTx < vtx.size(); nTx++) {
+        const CTransaction& tx = *vtx[nTx];
+        bool fStealthData = false;
+        for (const CTxOut& txout : tx.vout) {
+            ec_point pkEphem;
+            Occurrence occ = {nTx, false, 0};
+            if (ExtractStealthData(txout.scriptPubKey, pkEphem, occ.nPrefix, occ.fHavePrefix)) {
+                mapEphem[pkEphem].push_back(occ);
+                fStealthData = true;
+            }
+        }
+        if (!fStealthData)
+            continue;
+
+        std::set<CKeyID>& setKeys = mapTxKeys[nTx];
+        for (const CTxOut& txout : tx.vout) {
+            txnouttype type;
+            std::vector<std::vector<unsigned char>> vSolutions;
+            if (Solver(txout.scriptPubKey, type, vSolutions) && type == TX_PUBKEYHASH)
+                setKeys.insert(CKeyID(uint160(vSolutions[0])));
+        }
+    }
+    if (mapEphem.empty())
+        return 0;
+
+    size_t nShared = 0;
+    std::vector<const ec_point*> vPoints;
+    std::vector<const std::vector<Occurrence>*> vOccurrences;
+    std::vector<CKey> vShared;
+    for (size_t nKey = 0; nKey < vKeys.size(); nKey++) {
+        const CStealthScanKey& key = vKeys[nKey];
+
+        // Only the ephemeral keys carried with a matching prefix, or without one, can pay to this key
+        vPoints.clear();
+        vOccurrences.clear();
+        for (const auto& ephem : mapEphem) {
+            for (const Occurrence& occ : ephem.second) {
+                if (!occ.fHavePrefix || (occ.nPrefix & key.nPrefixMask) == (key.nPrefix & key.nPrefixMask)) {
+                    vPoints.push_back(&ephem.first);
+                    vOccurrences.push_back(&ephem.second);
+                    break;
+                }
+            }
+        }
+        if (vPoints.empty())
+            continue;
+
+        nShared += StealthSharedBatch(key.skScan, vPoints, vShared);
+        for (size_t i = 0; i < vPoints.size(); i++) {
+            if (!vShared[i].IsValid())
+                continue;
+            ec_point pkOut;
+            if (StealthSharedToPublicKey(key.pkSpend, vShared[i], pkOut) != 0)
+                continue;
+            CKeyID idKey = CPubKey(pkOut).GetID();
+            for (const Occurrence& occ : *vOccurrences[i]) {
+                if (mapTxKeys[occ.nTx].count(idKey))
+                    vMatches.push_back({vtx[occ.nTx]->GetHash(), nKey, idKey, vShared[i]});
+            }
+        }
+    }
+    return nShared;
+}
@@ -0,0 +1,58 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NIX_WALLET_STEALTHSCAN_H
+#define NIX_WALLET_STEALTHSCAN_H
+
+#include <key.h>
+#include <primitives/transaction.h>
+#include <pubkey.h>
+#include <uint256.h>
+
+#include <vector>
+
+/** A stealth key of an account, with what scanning for it needs */
+struct CStealthScanKey
+{
+    CKeyID idAccount;
+    CKeyID idStealthKey;
+    CKey skScan;
+    std::vector<uint8_t> pkSpend;
+    uint32_t nPrefixMask;
+    uint32_t nPrefix;
+};
+
+/** A transaction output paying to a stealth key */
+struct CStealthMatch
+{
+    uint256 txid;
+    size_t nKey;    //!< Index of the stealth key in the scanner
+    CKeyID idKey;   //!< Key the output pays to
+    CKey sShared;   //!< Shared secret the key derives from
+};
+
+/**
+ * Finds the outputs paying to the stealth keys of the wallet.
+ *
+ * An output pays to a stealth key when the transaction carries an ephemeral public key in an OP_RETURN
+ * output, and a key derived from it and the stealth key is one of the keys its pay to pubkey hash
+ * outputs pay to. A stealth key whose prefix doesn't match the prefix carried next to the ephemeral
+ * key is ruled out before any EC math, and the shared secrets of a stealth key are computed for all
+ * the ephemeral keys of the transactions scanned together in one batch.
+ */
+class CStealthScanner
+{
+private:
+    std::vector<CStealthScanKey> vKeys;
+
+public:
+    void SetKeys(std::vector<CStealthScanKey> vKeysIn) { vKeys = std::move(vKeysIn); }
+    const std::vector<CStealthScanKey>& GetKeys() const { return vKeys; }
+
+    /** Append the outputs of vtx paying to the stealth keys to vMatches. Returns the number of shared
+     *  secrets computed, for the transactions with stealth data that passed the prefix filter */
+    size_t Scan(const std::vector<CTransactionRef>& vtx, std::vector<CStealthMatch>& vMatches) const;
+};
+
+#endif // NIX_WALLET_STEALTHSCAN_H
@@ -18,7 +18,7 @@ WalletTestingSetup::WalletTestingSetup(const std::string& chainName):
     std::unique_ptr<CWalletDBWrapper> dbw(new CWalletDBWrapper(&bitdb, "wallet_test.dat"));
     pwalletMain = MakeUnique<CWallet>(std::move(dbw));
     pwalletMain->LoadWallet(fFirstRun);
-    RegisterValidationInterface(pwalletMain.get());
+    RegisterValidationInterface(pwalletMain.get(), "wallet");
 
     RegisterWalletRPCCommands(tableRPC);
 }
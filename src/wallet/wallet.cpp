@@ -5,13 +5,19 @@
 
 #include <wallet/wallet.h>
 
+#include <addressindex.h>
 #include <base58.h>
 #include <checkpoints.h>
 #include <chain.h>
 #include <wallet/coincontrol.h>
+#include <wallet/coinselection.h>
+#include <wallet/rescan.h>
 #include <consensus/consensus.h>
+#include <consensus/tx_verify.h>
 #include <consensus/validation.h>
+#include <core_memusage.h>
 #include <fs.h>
+#include <index/insightindex.h>
 #include <wallet/init.h>
 #include <key.h>
 #include <keystore.h>
@@ -267,14 +273,12 @@ CPubKey CWallet::GenerateNewKey(CWalletDB &walletdb, bool internal)
     return pubkey;
 }
 
-void CWallet::DeriveNewChildKey(CWalletDB &walletdb, CKeyMetadata& metadata, CKey& secret, bool internal)
+void CWallet::GetHDChainKey(CExtKey& chainChildKey, bool internal)
 {
     // for now we use a fixed keypath scheme of m/0'/0'/k
     CKey key;                      //master key seed (256bit)
     CExtKey masterKey;             //hd master key
     CExtKey accountKey;            //key at m/0'
-    CExtKey chainChildKey;         //key at m/0'/0' (external) or m/0'/1' (internal)
-    CExtKey childKey;              //key at m/0'/0'/<n>'
 
     // try to get the master key
     if (!GetKey(hdChain.masterKeyID, key))
@@ -289,6 +293,14 @@ void CWallet::DeriveNewChildKey(CWalletDB &walletdb, CKeyMetadata& metadata, CKe
     // derive m/0'/0' (external chain) OR m/0'/1' (internal chain)
     assert(internal ? CanSupportFeature(FEATURE_HD_SPLIT) : true);
     accountKey.Derive(chainChildKey, BIP32_HARDENED_KEY_LIMIT+(internal ? 1 : 0));
+}
+
+void CWallet::DeriveNewChildKey(CWalletDB &walletdb, CKeyMetadata& metadata, CKey& secret, bool internal)
+{
+    CExtKey chainChildKey;         //key at m/0'/0' (external) or m/0'/1' (internal)
+    CExtKey childKey;              //key at m/0'/0'/<n>'
+
+    GetHDChainKey(chainChildKey, internal);
 
     // derive child key at next index, skip keys already known to the wallet
     do {
@@ -313,6 +325,70 @@ void CWallet::DeriveNewChildKey(CWalletDB &walletdb, CKeyMetadata& metadata, CKe
         throw std::runtime_error(std::string(__func__) + ": Writing HD chain model failed");
 }
 
+std::vector<CPubKey> CWallet::DeriveNewChildKeys(CWalletDB &walletdb, bool internal, size_t nKeys)
+{
+    AssertLockHeld(cs_wallet); // mapKeyMetadata
+
+    CExtKey chainChildKey;
+    GetHDChainKey(chainChildKey, internal);
+    uint32_t& nChainCounter = internal ? hdChain.nInternalChainCounter : hdChain.nExternalChainCounter;
+    const uint32_t nFirstChild = nChainCounter;
+
+    // The hardened derivations and the checks of the derived keys don't depend on each other, they run over the cores
+    std::vector<CKey> vKeys(nKeys);
+    std::vector<CPubKey> vPubKeys(nKeys);
+    std::vector<char> vValid(nKeys, 0);
+    auto derive = [&](size_t nBegin, size_t nEnd) {
+        for (size_t i = nBegin; i < nEnd; i++) {
+            CExtKey childKey;
+            if (!chainChildKey.Derive(childKey, (nFirstChild + i) | BIP32_HARDENED_KEY_LIMIT))
+                continue;
+            vKeys[i] = childKey.key;
+            vPubKeys[i] = vKeys[i].GetPubKey();
+            vValid[i] = vKeys[i].VerifyPubKey(vPubKeys[i]);
+        }
+    };
+    size_t nThreads = std::min(nKeys / KEYPOOL_DERIVE_KEYS_PER_THREAD, (size_t)GetNumCores());
+    if (nThreads <= 1) {
+        derive(0, nKeys);
+    } else {
+        size_t nPerThread = (nKeys + nThreads - 1) / nThreads;
+        std::vector<std::thread> vThreads;
+        for (size_t t = 1; t < nThreads; t++)
+            vThreads.emplace_back(derive, std::min(nKeys, t * nPerThread), std::min(nKeys, (t + 1) * nPerThread));
+        derive(0, nPerThread);
+        for (std::thread& thread : vThreads)
+            thread.join();
+    }
+
+    // HD keys are compressed
+    if (CanSupportFeature(FEATURE_COMPRPUBKEY))
+        SetMinVersion(FEATURE_COMPRPUBKEY);
+
+    // Adding the keys, and encrypting them in an encrypted wallet, happens in the order of the chain
+    std::vector<CPubKey> vNewPubKeys;
+    int64_t nCreationTime = GetTime();
+    for (size_t i = 0; i < nKeys; i++) {
+        nChainCounter = nFirstChild + i + 1;
+        if (!vValid[i] || HaveKey(vPubKeys[i].GetID()))
+            continue;
+
+        CKeyMetadata metadata(nCreationTime);
+        metadata.hdKeypath = std::string(internal ? "m/0'/1'/" : "m/0'/0'/") + std::to_string(nFirstChild + i) + "'";
+        metadata.hdMasterKeyID = hdChain.masterKeyID;
+        mapKeyMetadata[vPubKeys[i].GetID()] = metadata;
+        UpdateTimeFirstKey(nCreationTime);
+
+        if (!AddKeyPubKeyWithDB(walletdb, vKeys[i], vPubKeys[i]))
+            throw std::runtime_error(std::string(__func__) + ": AddKey failed");
+        vNewPubKeys.push_back(vPubKeys[i]);
+    }
+    // update the chain model in the database
+    if (!walletdb.WriteHDChain(hdChain))
+        throw std::runtime_error(std::string(__func__) + ": Writing HD chain model failed");
+    return vNewPubKeys;
+}
+
 bool CWallet::AddKeyPubKeyWithDB(CWalletDB &walletdb, const CKey& secret, const CPubKey &pubkey)
 {
     AssertLockHeld(cs_wallet); // mapKeyMetadata
@@ -329,6 +405,7 @@ bool CWallet::AddKeyPubKeyWithDB(CWalletDB &walletdb, const CKey& secret, const
         return false;
     }
     if (needsDB) pwalletdbEncryption = nullptr;
+    nKeyGeneration++;
 
     // check if we need to remove from watch-only
     CScript script;
@@ -414,6 +491,7 @@ bool CWallet::AddCScript(const CScript& redeemScript)
 {
     if (!CCryptoKeyStore::AddCScript(redeemScript))
         return false;
+    nKeyGeneration++;
     return CWalletDB(*dbw).WriteCScript(Hash160(redeemScript), redeemScript);
 }
 
@@ -437,6 +515,7 @@ bool CWallet::AddWatchOnly(const CScript& dest)
 {
     if (!CCryptoKeyStore::AddWatchOnly(dest))
         return false;
+    nKeyGeneration++;
     const CKeyMetadata& meta = m_script_metadata[CScriptID(dest)];
     UpdateTimeFirstKey(meta.nCreateTime);
     NotifyWatchonlyChanged(true);
@@ -480,8 +559,10 @@ bool CWallet::Unlock(const SecureString& strWalletPassphrase)
                 return false;
             if (!crypter.Decrypt(pMasterKey.second.vchCryptedKey, _vMasterKey))
                 continue; // try another master key
-            if (CCryptoKeyStore::Unlock(_vMasterKey))
+            if (CCryptoKeyStore::Unlock(_vMasterKey)) {
+                ProcessLockedStealthOutputs();
                 return true;
+            }
         }
     }
     return false;
@@ -673,9 +754,57 @@ bool CWallet::IsSpent(const uint256& hash, unsigned int n) const
     return false;
 }
 
+/**
+ * Outpoint is spent by a wallet transaction at least COINBASE_MATURITY blocks
+ * deep, so it is not expected to become spendable again.
+ */
+bool CWallet::IsSpentDeeply(const COutPoint& outpoint) const
+{
+    std::pair<TxSpends::const_iterator, TxSpends::const_iterator> range;
+    range = mapTxSpends.equal_range(outpoint);
+
+    for (TxSpends::const_iterator it = range.first; it != range.second; ++it)
+    {
+        std::map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(it->second);
+        if (mit != mapWallet.end() && mit->second.GetDepthInMainChain() >= COINBASE_MATURITY)
+            return true;
+    }
+    return false;
+}
+
+void CWallet::AddChainViewBlock(const CBlockIndex* pindex)
+{
+    LOCK(cs_chainview);
+    mapChainViewHeights[pindex->GetBlockHash()] = pindex->nHeight;
+    // A rescan may run ahead of the BlockConnected notifications
+    nChainViewHeight = std::max(nChainViewHeight, pindex->nHeight);
+}
+
+int CWallet::GetBlockDepth(const uint256& hashBlock) const
+{
+    LOCK(cs_chainview);
+    auto it = mapChainViewHeights.find(hashBlock);
+    if (it == mapChainViewHeights.end())
+        return 0;
+    return nChainViewHeight - it->second + 1;
+}
+
+int CWallet::GetLastBlockHeight() const
+{
+    LOCK(cs_chainview);
+    return nChainViewHeight;
+}
+
+bool CWallet::IsFinalForNextBlock(const CTransaction& tx) const
+{
+    // As CheckFinalTx with the network-enforced flags, which don't use the median time past
+    return IsFinalTx(tx, GetLastBlockHeight() + 1, GetAdjustedTime());
+}
+
 void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
 {
     mapTxSpends.insert(std::make_pair(outpoint, wtxid));
+    InvalidateTallyCache();
 
     std::pair<TxSpends::iterator, TxSpends::iterator> range;
     range = mapTxSpends.equal_range(outpoint);
@@ -694,6 +823,62 @@ void CWallet::AddToSpends(const uint256& wtxid)
         AddToSpends(txin.prevout, wtxid);
 }
 
+void CWallet::AddToDenominatedOutpoints(const uint256& wtxid)
+{
+    auto it = mapWallet.find(wtxid);
+    assert(it != mapWallet.end());
+    const CWalletTx& thisTx = it->second;
+    for (unsigned int i = 0; i < thisTx.tx->vout.size(); i++) {
+        if (IsDenominatedAmount(thisTx.tx->vout[i].nValue)) {
+            mapDenominatedOutpoints[thisTx.tx->vout[i].nValue].insert(COutPoint(wtxid, i));
+        }
+    }
+}
+
+int CWallet::GetUnspentOutputClasses(CAmount nValue) const
+{
+    int nClasses = 0;
+    if (nValue == GHOSTNODE_COIN_REQUIRED * COIN)
+        nClasses |= UNSPENT_GHOSTNODE;
+    if (IsCollateralAmount(nValue))
+        nClasses |= UNSPENT_COLLATERAL;
+    if (IsDenominatedAmount(nValue))
+        nClasses |= UNSPENT_DENOMINATED;
+    if (!(nClasses & (UNSPENT_COLLATERAL | UNSPENT_DENOMINATED)))
+        nClasses |= UNSPENT_OTHER;
+    return nClasses;
+}
+
+void CWallet::AddToUnspentOutputs(const CWalletTx& wtx) const
+{
+    const uint256& wtxid = wtx.GetHash();
+    for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
+        if (IsMine(wtx.tx->vout[i]) == ISMINE_NO || IsSpentDeeply(COutPoint(wtxid, i)))
+            continue;
+        CUnspentOutputs& outputs = mapUnspentOutputs[wtxid];
+        outputs.setOutputs.insert(i);
+        outputs.nClasses |= GetUnspentOutputClasses(wtx.tx->vout[i].nValue);
+    }
+}
+
+void CWallet::AddToAddressOutpoints(const uint256& wtxid)
+{
+    auto it = mapWallet.find(wtxid);
+    assert(it != mapWallet.end());
+    const CWalletTx& thisTx = it->second;
+    for (unsigned int i = 0; i < thisTx.tx->vout.size(); i++) {
+        CTxDestination address;
+        if (!ExtractDestination(thisTx.tx->vout[i].scriptPubKey, address)) continue;
+
+        CAddressOutpoints& outpoints = mapAddressOutpoints[CBitcoinAddress(address)];
+        if (IsDenominatedAmount(thisTx.tx->vout[i].nValue))
+            outpoints.setDenominated.insert(COutPoint(wtxid, i));
+        else
+            outpoints.setNonDenominated.insert(COutPoint(wtxid, i));
+    }
+    InvalidateTallyCache();
+}
+
 bool CWallet::EncryptWallet(const SecureString& strWalletPassphrase)
 {
     if (IsCrypted())
@@ -948,12 +1133,31 @@ bool CWallet::GetAccountDestination(CTxDestination &dest, std::string strAccount
     return true;
 }
 
+void CWalletTx::MarkDirty()
+{
+    fCreditCached = false;
+    fAvailableCreditCached = false;
+    fImmatureCreditCached = false;
+    fWatchDebitCached = false;
+    fWatchCreditCached = false;
+    fAvailableWatchCreditCached = false;
+    fImmatureWatchCreditCached = false;
+    fDebitCached = false;
+    fChangeCached = false;
+    if (pwallet)
+        pwallet->MarkBalanceDirty(GetHash());
+}
+
 void CWallet::MarkDirty()
 {
     {
         LOCK(cs_wallet);
+        fBalancesFull = true;
+        nBalanceChanges++;
+        fUnspentOutputsFull = true;
         for (std::pair<const uint256, CWalletTx>& item : mapWallet)
             item.second.MarkDirty();
+        InvalidateTallyCache();
     }
 }
 
@@ -991,6 +1195,8 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
     LOCK(cs_wallet);
 
     CWalletDB walletdb(*dbw, "r+", fFlushOnClose);
+    // The order position and the transaction are committed together
+    CWalletDBTxn txn(walletdb);
 
     uint256 hash = wtxIn.GetHash();
 
@@ -1005,7 +1211,12 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
         wtx.nOrderPos = IncOrderPosNext(&walletdb);
         wtxOrdered.insert(std::make_pair(wtx.nOrderPos, TxPair(&wtx, nullptr)));
         wtx.nTimeSmart = ComputeTimeSmart(wtx);
+        wtx.fBalanceCounted = false;
         AddToSpends(hash);
+        AddToDenominatedOutpoints(hash);
+        AddToAddressOutpoints(hash);
+        if (!fUnspentOutputsFull)
+            AddToUnspentOutputs(wtx);
     }
 
     bool fUpdated = false;
@@ -1051,9 +1262,12 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
     if (fInsertedNew || fUpdated)
         if (!walletdb.WriteTx(wtx))
             return false;
+    if (!txn.Commit())
+        return false;
 
     // Break debit/credit balance caches:
     wtx.MarkDirty();
+    InvalidateTallyCache();
 
     // Notify UI of new or updated transaction
     NotifyTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
@@ -1077,6 +1291,8 @@ bool CWallet::LoadToWallet(const CWalletTx& wtxIn)
     wtx.BindWallet(this);
     wtxOrdered.insert(std::make_pair(wtx.nOrderPos, TxPair(&wtx, nullptr)));
     AddToSpends(hash);
+    AddToDenominatedOutpoints(hash);
+    AddToAddressOutpoints(hash);
     for (const CTxIn& txin : wtx.tx->vin) {
         auto it = mapWallet.find(txin.prevout.hash);
         if (it != mapWallet.end()) {
@@ -1090,6 +1306,78 @@ bool CWallet::LoadToWallet(const CWalletTx& wtxIn)
     return true;
 }
 
+void CWallet::LoadZerocoinEntry(const CZerocoinEntry& zerocoin)
+{
+    std::map<CBigNum, CZerocoinEntry>::iterator it = mapZerocoinEntries.find(zerocoin.value);
+    if (it != mapZerocoinEntries.end()) {
+        if (it->second.denomination != zerocoin.denomination)
+            mapZerocoinDenominations[it->second.denomination].erase(zerocoin.value);
+        it->second = zerocoin;
+    } else {
+        mapZerocoinEntries.emplace(zerocoin.value, zerocoin);
+    }
+    mapZerocoinDenominations[zerocoin.denomination].insert(zerocoin.value);
+}
+
+bool CWallet::WriteZerocoinEntry(const CZerocoinEntry& zerocoin)
+{
+    LOCK(cs_wallet);
+    if (!CWalletDB(*dbw).WriteZerocoinEntry(zerocoin))
+        return false;
+    LoadZerocoinEntry(zerocoin);
+    return true;
+}
+
+bool CWallet::WriteZerocoinEntries(const std::vector<CZerocoinEntry>& vZerocoin)
+{
+    LOCK(cs_wallet);
+    if (!CWalletDB(*dbw).WriteZerocoinEntries(vZerocoin))
+        return false;
+    for (const CZerocoinEntry& zerocoin : vZerocoin)
+        LoadZerocoinEntry(zerocoin);
+    return true;
+}
+
+bool CWallet::EraseZerocoinEntry(const CZerocoinEntry& zerocoin)
+{
+    LOCK(cs_wallet);
+    if (!CWalletDB(*dbw).EraseZerocoinEntry(zerocoin))
+        return false;
+    std::map<CBigNum, CZerocoinEntry>::iterator it = mapZerocoinEntries.find(zerocoin.value);
+    if (it != mapZerocoinEntries.end()) {
+        mapZerocoinDenominations[it->second.denomination].erase(zerocoin.value);
+        mapZerocoinEntries.erase(it);
+    }
+    return true;
+}
+
+void CWallet::ListZerocoinEntries(std::list<CZerocoinEntry>& listPubCoin) const
+{
+    LOCK(cs_wallet);
+    for (const auto& entry : mapZerocoinEntries)
+        listPubCoin.push_back(entry.second);
+}
+
+void CWallet::ListZerocoinEntries(int denomination, std::list<CZerocoinEntry>& listPubCoin) const
+{
+    LOCK(cs_wallet);
+    std::map<int, std::set<CBigNum>>::const_iterator it = mapZerocoinDenominations.find(denomination);
+    if (it == mapZerocoinDenominations.end())
+        return;
+    for (const CBigNum& pubCoin : it->second)
+        listPubCoin.push_back(mapZerocoinEntries.at(pubCoin));
+}
+
+bool CWallet::GetZerocoinEntry(const CBigNum& pubCoin, CZerocoinEntry& zerocoin) const
+{
+    LOCK(cs_wallet);
+    std::map<CBigNum, CZerocoinEntry>::const_iterator it = mapZerocoinEntries.find(pubCoin);
+    if (it == mapZerocoinEntries.end())
+        return false;
+    zerocoin = it->second;
+    return true;
+}
+
 bool CWallet::LoadToWallet(const uint256 &hash, const CTransactionRecord &rtx)
 {
     std::pair<MapRecords_t::iterator, bool> ret = mapRecords.insert(std::make_pair(hash, rtx));
@@ -1127,6 +1415,7 @@ bool CWallet::AddToWalletIfInvolvingMe(const CTransactionRef& ptx, const CBlockI
                 while (range.first != range.second) {
                     if (range.first->second != tx.GetHash()) {
                         LogPrintf("Transaction %s (in block %s) conflicts with wallet transaction %s (both spend %s:%i)\n", tx.GetHash().ToString(), pIndex->GetBlockHash().ToString(), range.first->second.ToString(), range.first->first.hash.ToString(), range.first->first.n);
+                        AddChainViewBlock(pIndex);
                         MarkConflicted(pIndex->GetBlockHash(), range.first->second);
                     }
                     range.first++;
@@ -1136,7 +1425,7 @@ bool CWallet::AddToWalletIfInvolvingMe(const CTransactionRef& ptx, const CBlockI
 
         bool fExisted = mapWallet.count(tx.GetHash()) != 0;
         if (fExisted && !fUpdate) return false;
-        if (fExisted || IsMine(tx) || IsFromMe(tx))
+        if (fExisted || IsMine(tx) || IsFromMe(tx) || setLockedStealthTxs.count(tx.GetHash()))
         {
             /* Check if any keys in the wallet keypool that were supposed to be unused
              * have appeared in a new transaction. If so, remove those keys from the keypool.
@@ -1165,8 +1454,10 @@ bool CWallet::AddToWalletIfInvolvingMe(const CTransactionRef& ptx, const CBlockI
             CWalletTx wtx(this, ptx);
 
             // Get merkle branch if transaction was found in a block
-            if (pIndex != nullptr)
+            if (pIndex != nullptr) {
                 wtx.SetMerkleBranch(pIndex, posInBlock);
+                AddChainViewBlock(pIndex);
+            }
 
             return AddToWallet(wtx, false);
         }
@@ -1176,14 +1467,14 @@ bool CWallet::AddToWalletIfInvolvingMe(const CTransactionRef& ptx, const CBlockI
 
 bool CWallet::TransactionCanBeAbandoned(const uint256& hashTx) const
 {
-    LOCK2(cs_main, cs_wallet);
+    LOCK(cs_wallet);
     const CWalletTx* wtx = GetWalletTx(hashTx);
     return wtx && !wtx->isAbandoned() && wtx->GetDepthInMainChain() <= 0 && !wtx->InMempool();
 }
 
 bool CWallet::AbandonTransaction(const uint256& hashTx)
 {
-    LOCK2(cs_main, cs_wallet);
+    LOCK(cs_wallet);
 
     CWalletDB walletdb(*dbw, "r+");
 
@@ -1238,21 +1529,16 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
             }
         }
     }
+    InvalidateTallyCache();
 
     return true;
 }
 
 void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
 {
-    LOCK2(cs_main, cs_wallet);
+    LOCK(cs_wallet);
 
-    int conflictconfirms = 0;
-    if (mapBlockIndex.count(hashBlock)) {
-        CBlockIndex* pindex = mapBlockIndex[hashBlock];
-        if (chainActive.Contains(pindex)) {
-            conflictconfirms = -(chainActive.Height() - pindex->nHeight + 1);
-        }
-    }
+    int conflictconfirms = -GetBlockDepth(hashBlock);
     // If number of conflict confirms cannot be determined, this means
     // that the block is still unknown or not yet part of the main chain,
     // for example when loading the wallet during a reindex. Do nothing in that
@@ -1301,6 +1587,7 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
             }
         }
     }
+    InvalidateTallyCache();
 }
 
 void CWallet::SyncTransaction(const CTransactionRef& ptx, const CBlockIndex *pindex, int posInBlock) {
@@ -1322,19 +1609,113 @@ void CWallet::SyncTransaction(const CTransactionRef& ptx, const CBlockIndex *pin
 
 void CWallet::TransactionAddedToMempool(const CTransactionRef& ptx) {
     LOCK2(cs_main, cs_wallet);
+    ScanStealthOutputs({ptx});
     SyncTransaction(ptx);
 
     auto it = mapWallet.find(ptx->GetHash());
     if (it != mapWallet.end()) {
         it->second.fInMempool = true;
+        MarkBalanceDirty(it->first);
+    }
+}
+
+void CWallet::UpdateStealthScanner()
+{
+    AssertLockHeld(cs_wallet);
+
+    if (fStealthKeysChanged) {
+        std::vector<CStealthScanKey> vKeys;
+        for (const auto& acc : mapExtAccounts) {
+            LOCK(acc.second->cs_account);
+            for (const auto& sk : acc.second->mapStealthKeys) {
+                const CEKAStealthKey& aks = sk.second;
+                vKeys.push_back({acc.first, sk.first, aks.skScan, aks.pkSpend, SetStealthMask(aks.nPrefixBits), aks.nPrefix});
+            }
+        }
+        stealthScanner.SetKeys(std::move(vKeys));
+        fStealthKeysChanged = false;
+    }
+}
+
+void CWallet::ScanStealthOutputs(const std::vector<CTransactionRef>& vtx)
+{
+    AssertLockHeld(cs_wallet);
+
+    UpdateStealthScanner();
+    std::vector<CStealthMatch> vMatches;
+    if (stealthScanner.GetKeys().empty() || stealthScanner.Scan(vtx, vMatches) == 0)
+        return;
+    AddStealthMatches(vMatches);
+}
+
+void CWallet::AddStealthMatches(const std::vector<CStealthMatch>& vMatches)
+{
+    AssertLockHeld(cs_wallet);
+
+    for (const CStealthMatch& match : vMatches) {
+        CStealthScanKey scanKey = stealthScanner.GetKeys()[match.nKey];
+        ExtKeyAccountMap::iterator mi = mapExtAccounts.find(scanKey.idAccount);
+        if (mi == mapExtAccounts.end())
+            continue;
+        CExtKeyAccount* sea = mi->second;
+
+        CKey sShared = match.sShared;
+        CEKASCKey asck(scanKey.idStealthKey, sShared);
+        if (!sea->mapStealthChildKeys.count(match.idKey) && 0 != ExtKeySaveKey(sea, match.idKey, asck)) {
+            LogPrintf("%s: Saving stealth key %s failed.\n", __func__, CBitcoinAddress(match.idKey).ToString());
+            continue;
+        }
+        if (HaveKey(match.idKey))
+            continue;
+
+        CKey key;
+        if (!IsLocked() && sea->GetKey(asck, key) && AddKeyPubKey(key, key.GetPubKey())) {
+            LogPrint(BCLog::HDWALLET, "%s: Found stealth output to %s in %s.\n", __func__, CBitcoinAddress(match.idKey).ToString(), match.txid.ToString());
+        } else {
+            // The wallet keeps the transaction and the shared secret, the key follows on unlock
+            setLockedStealthTxs.insert(match.txid);
+            LogPrint(BCLog::HDWALLET, "%s: Found stealth output to %s in %s, wallet locked.\n", __func__, CBitcoinAddress(match.idKey).ToString(), match.txid.ToString());
+        }
     }
 }
 
+bool CWallet::ProcessLockedStealthOutputs()
+{
+    LOCK(cs_wallet);
+
+    int nAdded = 0;
+    bool fAllAdded = true;
+    for (const auto& acc : mapExtAccounts) {
+        CExtKeyAccount* sea = acc.second;
+        LOCK(sea->cs_account);
+        for (const auto& sck : sea->mapStealthChildKeys) {
+            if (HaveKey(sck.first))
+                continue;
+            CKey key;
+            if (!sea->GetKey(sck.second, key) || !AddKeyPubKey(key, key.GetPubKey())) {
+                LogPrintf("%s: Adding stealth key %s failed.\n", __func__, CBitcoinAddress(sck.first).ToString());
+                fAllAdded = false;
+                continue;
+            }
+            nAdded++;
+        }
+    }
+    if (fAllAdded)
+        setLockedStealthTxs.clear();
+
+    if (nAdded > 0) {
+        LogPrint(BCLog::HDWALLET, "%s: Added %d stealth keys.\n", __func__, nAdded);
+        MarkDirty();
+    }
+    return fAllAdded;
+}
+
 void CWallet::TransactionRemovedFromMempool(const CTransactionRef &ptx) {
     LOCK(cs_wallet);
     auto it = mapWallet.find(ptx->GetHash());
     if (it != mapWallet.end()) {
         it->second.fInMempool = false;
+        MarkBalanceDirty(it->first);
     }
 }
 
@@ -1348,15 +1729,34 @@ void CWallet::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const
     // to abandon a transaction and then have it inadvertently cleared by
     // the notification that the conflicted transaction was evicted.
 
+    {
+        LOCK(cs_chainview);
+        nChainViewHeight = pindex->nHeight;
+    }
+
     for (const CTransactionRef& ptx : vtxConflicted) {
         SyncTransaction(ptx);
         TransactionRemovedFromMempool(ptx);
     }
+    // The stealth outputs of the whole block are looked for at once
+    ScanStealthOutputs(pblock->vtx);
     for (size_t i = 0; i < pblock->vtx.size(); i++) {
         SyncTransaction(pblock->vtx[i], pindex, i);
         TransactionRemovedFromMempool(pblock->vtx[i]);
     }
 
+    UpdateZerocoinWitnesses(pindex);
+
+    // coinbase outputs left out of the cached tallies may have matured
+    if (fAnonymizableTallyHasImmature)
+        InvalidateTallyCache();
+
+    // and the balances of the transactions not deep enough yet change with the depth
+    if (!setBalanceVolatile.empty()) {
+        setBalanceDirty.insert(setBalanceVolatile.begin(), setBalanceVolatile.end());
+        nBalanceChanges++;
+    }
+
     m_last_block_processed = pindex;
 }
 
@@ -1366,6 +1766,19 @@ void CWallet::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) {
     for (const CTransactionRef& ptx : pblock->vtx) {
         SyncTransaction(ptx);
     }
+
+    BlockMap::iterator mi = mapBlockIndex.find(pblock->GetHash());
+    if (mi != mapBlockIndex.end()) {
+        InvalidateZerocoinWitnesses(mi->second->nHeight);
+
+        LOCK(cs_chainview);
+        mapChainViewHeights.erase(pblock->GetHash());
+        nChainViewHeight = mi->second->nHeight - 1;
+    }
+
+    // Any coinbase transaction can be immature again, the balances are counted again from scratch
+    fBalancesFull = true;
+    nBalanceChanges++;
 }
 
 
@@ -1768,9 +2181,68 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, CBlock
             dProgressStart = GuessVerificationProgress(chainParams.TxData(), pindex);
             dProgressTip = GuessVerificationProgress(chainParams.TxData(), tip);
         }
-        while (pindex && !fAbortRescan)
+
+        // With -indexedrescan, up to the last block the address index covers only the blocks it has
+        // the keys and scripts of the wallet in are read
+        std::set<int> setHeights;
+        int nIndexedEnd = pindexStop ? pindexStop->nHeight : std::numeric_limits<int>::max();
+        bool fIndexed = gArgs.GetBoolArg("-indexedrescan", DEFAULT_INDEXED_RESCAN) &&
+            GetIndexedRescanHeights(pindexStart->nHeight, nIndexedEnd, setHeights);
+        if (fIndexed) {
+            LogPrintf("%s: Address index has wallet transactions in %u blocks up to height %d\n", __func__, setHeights.size(), nIndexedEnd);
+        }
+        // First block to read at or above nHeight, requires cs_main
+        auto nextBlock = [&](int nHeight) -> CBlockIndex* {
+            if (fIndexed && nHeight <= nIndexedEnd) {
+                auto it = setHeights.lower_bound(nHeight);
+                nHeight = it == setHeights.end() ? nIndexedEnd + 1 : *it;
+            }
+            if (pindexStop && nHeight > pindexStop->nHeight) {
+                return nullptr;
+            }
+            return chainActive[nHeight];
+        };
+
+        CStealthScanner scanner;
         {
-            if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0) {
+            LOCK(cs_wallet);
+            UpdateStealthScanner();
+            scanner = stealthScanner;
+        }
+        int nThreads = GetRescanThreads();
+        size_t nReadAhead = nThreads * RESCAN_READ_AHEAD_PER_THREAD;
+        CRescanReadAhead readAhead(*this, scanner, nThreads);
+        CBlockIndex* pindexQueued = nullptr;
+        int nProgressHeight = pindex->nHeight;
+
+        while (!fAbortRescan)
+        {
+            if (pindexQueued != pindexStop && readAhead.Size() < nReadAhead) {
+                LOCK(cs_main);
+                while (readAhead.Size() < nReadAhead) {
+                    CBlockIndex* pindexNext = pindexQueued ? nextBlock(pindexQueued->nHeight + 1) : nextBlock(pindexStart->nHeight);
+                    if (!pindexNext) {
+                        break;
+                    }
+                    readAhead.Push(pindexNext);
+                    pindexQueued = pindexNext;
+                    if (pindexQueued == pindexStop) {
+                        break;
+                    }
+                }
+                if (tip != chainActive.Tip()) {
+                    tip = chainActive.Tip();
+                    // in case the tip has changed, update progress max
+                    dProgressTip = GuessVerificationProgress(chainParams.TxData(), tip);
+                }
+            }
+            std::unique_ptr<CRescanBlock> rb = readAhead.Pop();
+            if (!rb) {
+                break;
+            }
+            pindex = rb->pindex;
+
+            if (pindex->nHeight / 100 != nProgressHeight / 100 && dProgressTip - dProgressStart > 0.0) {
                 double gvp = 0;
                 {
                     LOCK(cs_main);
@@ -1778,39 +2250,38 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, CBlock
                 }
                 ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((gvp - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
             }
+            nProgressHeight = pindex->nHeight;
             if (GetTime() >= nNow + 60) {
                 nNow = GetTime();
                 LOCK(cs_main);
                 LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, GuessVerificationProgress(chainParams.TxData(), pindex));
             }
 
-            CBlock block;
-            if (ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
+            if (rb->fRead) {
                 LOCK2(cs_main, cs_wallet);
-                if (pindex && !chainActive.Contains(pindex)) {
+                if (!chainActive.Contains(pindex)) {
                     // Abort scan if current block is no longer active, to prevent
                     // marking transactions as coming from the wrong block.
                     ret = pindex;
                     break;
                 }
-                for (size_t posInBlock = 0; posInBlock < block.vtx.size(); ++posInBlock) {
-                    AddToWalletIfInvolvingMe(block.vtx[posInBlock], pindex, posInBlock, fUpdate);
+                if (rb->nKeyGeneration == nKeyGeneration && !fStealthKeysChanged) {
+                    AddStealthMatches(rb->vStealth);
+                } else {
+                    ScanStealthOutputs(rb->block.vtx);
+                }
+                for (size_t posInBlock = 0; posInBlock < rb->block.vtx.size(); ++posInBlock) {
+                    const CTransactionRef& ptx = rb->block.vtx[posInBlock];
+                    // Transactions not matched, that no key added since could be matching, and that
+                    // don't touch the wallet otherwise can't be involving it
+                    if (rb->nKeyGeneration == nKeyGeneration && !rb->vMine[posInBlock] && !IsSpendingFromWallet(*ptx)) {
+                        continue;
+                    }
+                    AddToWalletIfInvolvingMe(ptx, pindex, posInBlock, fUpdate);
                 }
             } else {
                 ret = pindex;
             }
-            if (pindex == pindexStop) {
-                break;
-            }
-            {
-                LOCK(cs_main);
-                pindex = chainActive.Next(pindex);
-                if (tip != chainActive.Tip()) {
-                    tip = chainActive.Tip();
-                    // in case the tip has changed, update progress max
-                    dProgressTip = GuessVerificationProgress(chainParams.TxData(), tip);
-                }
-            }
         }
         if (pindex && fAbortRescan) {
             LogPrintf("Rescan aborted at block %d. Progress=%f\n", pindex->nHeight, GuessVerificationProgress(chainParams.TxData(), pindex));
@@ -1820,6 +2291,76 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, CBlock
     return ret;
 }
 
+bool CWallet::IsSpendingFromWallet(const CTransaction& tx) const
+{
+    AssertLockHeld(cs_wallet);
+
+    if (mapWallet.count(tx.GetHash()) || setLockedStealthTxs.count(tx.GetHash()))
+        return true;
+    for (const CTxIn& txin : tx.vin) {
+        if (mapWallet.count(txin.prevout.hash) || mapTxSpends.count(txin.prevout))
+            return true;
+    }
+    return false;
+}
+
+bool CWallet::GetIndexedRescanHeights(int nStart, int& nEnd, std::set<int>& setHeights) const
+{
+    if (!fAddressIndex || !g_addressindex)
+        return false;
+
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pindexIndexed = g_addressindex->GetBestBlockIndex();
+        if (!pindexIndexed || !chainActive.Contains(pindexIndexed) || pindexIndexed->nHeight < nStart)
+            return false;
+        nEnd = std::min(nEnd, pindexIndexed->nHeight);
+    }
+
+    std::vector<std::pair<uint256, int>> vAddresses;
+    {
+        LOCK2(cs_wallet, cs_KeyStore);
+        // The keys stealth outputs pay to aren't known before the outputs are found
+        for (const auto& acc : mapExtAccounts) {
+            if (!acc.second->mapStealthKeys.empty())
+                return false;
+        }
+        for (const CKeyID& keyID : GetKeys()) {
+            uint256 hashBytes;
+            memcpy(hashBytes.begin(), keyID.begin(), 20);
+            vAddresses.emplace_back(hashBytes, ADDR_INDT_PUBKEY_ADDRESS);
+        }
+        for (const CScriptID& scriptID : GetCScripts()) {
+            uint256 hashBytes;
+            memcpy(hashBytes.begin(), scriptID.begin(), 20);
+            vAddresses.emplace_back(hashBytes, ADDR_INDT_SCRIPT_ADDRESS);
+        }
+        for (const CScript& script : setWatchOnly) {
+            int nType;
+            std::vector<uint8_t> vHashBytes;
+            ExtractIndexInfo(&script, nType, vHashBytes);
+            if (nType == ADDR_INDT_UNKNOWN)
+                return false;
+            uint256 hashBytes;
+            memcpy(hashBytes.begin(), vHashBytes.data(), vHashBytes.size());
+            vAddresses.emplace_back(hashBytes, nType);
+        }
+    }
+
+    for (const auto& address : vAddresses) {
+        if (fAbortRescan)
+            return false;
+        if (!g_addressindex->GetDB().ScanAddressIndex(address.first, address.second, nStart, nEnd, nullptr,
+                [&setHeights](const CAddressIndexKey& key, CAmount nValue) {
+                    setHeights.insert(key.blockHeight);
+                    return true;
+                })) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void CWallet::ReacceptWalletTransactions()
 {
     // If transactions aren't being broadcasted, don't let them into local mempool either
@@ -2052,7 +2593,7 @@ bool CWalletTx::InMempool() const
 bool CWalletTx::IsTrusted() const
 {
     // Quick answer in most cases
-    if (!CheckFinalTx(*tx))
+    if (!pwallet->IsFinalForNextBlock(*tx))
         return false;
     int nDepth = GetDepthInMainChain();
     if (nDepth >= 1)
@@ -2148,94 +2689,116 @@ void CWallet::ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman
  */
 
 
-CAmount CWallet::GetBalance() const
+void CWallet::MarkBalanceDirty(const uint256& hash) const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (const auto& entry : mapWallet)
-        {
-            const CWalletTx* pcoin = &entry.second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableCredit();
+    LOCK(cs_wallet);
+    if (!fBalancesFull)
+        setBalanceDirty.insert(hash);
+    nBalanceChanges++;
+}
+
+void CWallet::UpdateTxBalances(const CWalletTx& wtx, bool fFull) const
+{
+    CWalletBalances txBalances;
+    int nDepth = wtx.GetDepthInMainChain();
+    if (wtx.IsTrusted()) {
+        txBalances.nTrusted = wtx.GetAvailableCredit();
+        txBalances.nWatchTrusted = wtx.GetAvailableWatchOnlyCredit();
+    } else if (nDepth == 0 && wtx.InMempool()) {
+        txBalances.nUntrusted = wtx.GetAvailableCredit();
+        txBalances.nWatchUntrusted = wtx.GetAvailableWatchOnlyCredit();
+    }
+    txBalances.nImmature = wtx.GetImmatureCredit();
+    txBalances.nWatchImmature = wtx.GetImmatureWatchOnlyCredit();
+
+    if (wtx.fBalanceCounted)
+        balances -= wtx.balanceCounted;
+    balances += txBalances;
+
+    // Whether a transaction is confirmed, unconfirmed or conflicted decides whether the outputs it
+    // spends are spent, and whether it is in the wallet whether its spenders are trusted
+    int nDepthClass = nDepth > 0 ? 1 : (nDepth == 0 ? 0 : -1);
+    const uint256& hash = wtx.GetHash();
+    if (!fFull && (!wtx.fBalanceCounted || nDepthClass != wtx.nBalanceDepthClass)) {
+        for (const CTxIn& txin : wtx.tx->vin) {
+            if (mapWallet.count(txin.prevout.hash))
+                setBalanceDirty.insert(txin.prevout.hash);
+        }
+        for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
+            auto range = mapTxSpends.equal_range(COutPoint(hash, i));
+            for (auto it = range.first; it != range.second; ++it)
+                setBalanceDirty.insert(it->second);
         }
     }
 
-    return nTotal;
+    wtx.fBalanceCounted = true;
+    wtx.nBalanceDepthClass = nDepthClass;
+    wtx.balanceCounted = txBalances;
+    if (nDepth < 1 || wtx.GetBlocksToMaturity() > 0)
+        setBalanceVolatile.insert(hash);
+    else
+        setBalanceVolatile.erase(hash);
 }
 
-CAmount CWallet::GetUnconfirmedBalance() const
+void CWallet::UpdateBalances() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (const auto& entry : mapWallet)
-        {
-            const CWalletTx* pcoin = &entry.second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableCredit();
+    AssertLockHeld(cs_wallet);
+
+    if (fBalancesFull) {
+        balances = CWalletBalances();
+        setBalanceDirty.clear();
+        setBalanceVolatile.clear();
+        for (const auto& entry : mapWallet) {
+            entry.second.fBalanceCounted = false;
+            UpdateTxBalances(entry.second, true);
         }
+        fBalancesFull = false;
+    }
+
+    while (!setBalanceDirty.empty()) {
+        uint256 hash = *setBalanceDirty.begin();
+        setBalanceDirty.erase(setBalanceDirty.begin());
+        auto it = mapWallet.find(hash);
+        if (it != mapWallet.end())
+            UpdateTxBalances(it->second, false);
     }
-    return nTotal;
+}
+
+CWalletBalances CWallet::GetBalances() const
+{
+    LOCK(cs_wallet);
+    UpdateBalances();
+    return balances;
+}
+
+CAmount CWallet::GetBalance() const
+{
+    return GetBalances().nTrusted;
+}
+
+CAmount CWallet::GetUnconfirmedBalance() const
+{
+    return GetBalances().nUntrusted;
 }
 
 CAmount CWallet::GetImmatureBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (const auto& entry : mapWallet)
-        {
-            const CWalletTx* pcoin = &entry.second;
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nImmature;
 }
 
 CAmount CWallet::GetWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (const auto& entry : mapWallet)
-        {
-            const CWalletTx* pcoin = &entry.second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-
-    return nTotal;
+    return GetBalances().nWatchTrusted;
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (const auto& entry : mapWallet)
-        {
-            const CWalletTx* pcoin = &entry.second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nWatchUntrusted;
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (const auto& entry : mapWallet)
-        {
-            const CWalletTx* pcoin = &entry.second;
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nWatchImmature;
 }
 
 // Calculate total balance in a different way from GetBalance. The biggest
@@ -2246,13 +2809,13 @@ CAmount CWallet::GetImmatureWatchOnlyBalance() const
 // trusted.
 CAmount CWallet::GetLegacyBalance(const isminefilter& filter, int minDepth, const std::string* account) const
 {
-    LOCK2(cs_main, cs_wallet);
+    LOCK(cs_wallet);
 
     CAmount balance = 0;
     for (const auto& entry : mapWallet) {
         const CWalletTx& wtx = entry.second;
         const int depth = wtx.GetDepthInMainChain();
-        if (depth < 0 || !CheckFinalTx(*wtx.tx) || wtx.GetBlocksToMaturity() > 0) {
+        if (depth < 0 || !IsFinalForNextBlock(*wtx.tx) || wtx.GetBlocksToMaturity() > 0) {
             continue;
         }
 
@@ -2283,7 +2846,7 @@ CAmount CWallet::GetLegacyBalance(const isminefilter& filter, int minDepth, cons
 
 CAmount CWallet::GetAvailableBalance(const CCoinControl* coinControl) const
 {
-    LOCK2(cs_main, cs_wallet);
+    LOCK(cs_wallet);
 
     CAmount balance = 0;
     std::vector<COutput> vCoins;
@@ -2301,16 +2864,55 @@ void CWallet::AvailableCoins(std::vector<COutput> &vCoins, bool fOnlySafe, const
     vCoins.clear();
 
     {
-        LOCK2(cs_main, cs_wallet);
+        LOCK(cs_wallet);
 
         CAmount nTotal = 0;
 
-        for (const auto& entry : mapWallet)
+        if (fUnspentOutputsFull) {
+            mapUnspentOutputs.clear();
+            for (const auto& entry : mapWallet)
+                AddToUnspentOutputs(entry.second);
+            fUnspentOutputsFull = false;
+        }
+
+        int nClasses = UNSPENT_ALL;
+        if (nCoinType == ONLY_DENOMINATED)
+            nClasses = UNSPENT_DENOMINATED;
+        else if (nCoinType == ONLY_NONDENOMINATED_NOT40000IFMN)
+            nClasses = UNSPENT_OTHER;
+        else if (nCoinType == ONLY_40000)
+            nClasses = UNSPENT_GHOSTNODE;
+        else if (nCoinType == ONLY_PRIVATESEND_COLLATERAL)
+            nClasses = UNSPENT_COLLATERAL;
+
+        std::map<uint256, CUnspentOutputs>::iterator itUnspent = mapUnspentOutputs.begin();
+        while (itUnspent != mapUnspentOutputs.end())
         {
+            std::map<uint256, CWalletTx>::const_iterator itWallet = mapWallet.find(itUnspent->first);
+            std::set<unsigned int>& setOutputs = itUnspent->second.setOutputs;
+            if (itWallet != mapWallet.end()) {
+                for (std::set<unsigned int>::iterator it = setOutputs.begin(); it != setOutputs.end(); ) {
+                    if (IsSpentDeeply(COutPoint(itUnspent->first, *it)))
+                        setOutputs.erase(it++);
+                    else
+                        ++it;
+                }
+            }
+            if (itWallet == mapWallet.end() || setOutputs.empty()) {
+                mapUnspentOutputs.erase(itUnspent++);
+                continue;
+            }
+            if (!(itUnspent->second.nClasses & nClasses)) {
+                ++itUnspent;
+                continue;
+            }
+            ++itUnspent;
+
+            const auto& entry = *itWallet;
             const uint256& wtxid = entry.first;
             const CWalletTx* pcoin = &entry.second;
             bool isGN = false;
-            if (!CheckFinalTx(*pcoin->tx))
+            if (!IsFinalForNextBlock(*pcoin->tx))
                 continue;
 
             if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
@@ -2366,7 +2968,7 @@ void CWallet::AvailableCoins(std::vector<COutput> &vCoins, bool fOnlySafe, const
             if (nDepth < nMinDepth || nDepth > nMaxDepth)
                 continue;
 
-            for (unsigned int i = 0; i < pcoin->tx->vout.size(); i++) {
+            for (unsigned int i : setOutputs) {
 
                 bool found = false;
                 if (nCoinType == ONLY_DENOMINATED) {
@@ -2458,7 +3060,7 @@ std::map<CTxDestination, std::vector<COutput>> CWallet::ListCoins() const
     std::vector<COutput> availableCoins;
     AvailableCoins(availableCoins);
 
-    LOCK2(cs_main, cs_wallet);
+    LOCK(cs_wallet);
     for (auto& coin : availableCoins) {
         CTxDestination address;
         if (coin.fSpendable &&
@@ -2551,7 +3153,7 @@ static void ApproximateBestSubset(const std::vector<CInputCoin>& vValue, const C
 }
 
 bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMine, const int nConfTheirs, const uint64_t nMaxAncestors, std::vector<COutput> vCoins,
-                                 std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet) const
+                                 std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet, CoinSelectionParams* params) const
 {
     setCoinsRet.clear();
     nValueRet = 0;
@@ -2560,6 +3162,9 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMin
     boost::optional<CInputCoin> coinLowestLarger;
     std::vector<CInputCoin> vValue;
     CAmount nTotalLower = 0;
+    // Every coin eligible, for the branch and bound search
+    const bool fBnB = params && params->nCostOfChange > 0;
+    std::vector<CInputCoin> vUtxoPool;
 
     random_shuffle(vCoins.begin(), vCoins.end(), GetRandInt);
 
@@ -2586,7 +3191,11 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMin
             nValueRet += coin.txout.nValue;
             return true;
         }
-        else if (coin.txout.nValue < nTargetValue + MIN_CHANGE)
+
+        if (fBnB)
+            vUtxoPool.push_back(coin);
+
+        if (coin.txout.nValue < nTargetValue + MIN_CHANGE)
         {
             vValue.push_back(coin);
             nTotalLower += coin.txout.nValue;
@@ -2597,6 +3206,12 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMin
         }
     }
 
+    if (fBnB && SelectCoinsBnB(vUtxoPool, nTargetValue, *params, setCoinsRet, nValueRet)) {
+        params->fUsedBnB = true;
+        LogPrint(BCLog::SELECTCOINS, "SelectCoins() branch and bound: %d inputs total %s\n", setCoinsRet.size(), FormatMoney(nValueRet));
+        return true;
+    }
+
     if (nTotalLower == nTargetValue)
     {
         for (const auto& input : vValue)
@@ -2656,9 +3271,24 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const int nConfMin
     return true;
 }
 
-bool CWallet::SelectCoins(const std::vector<COutput>& vAvailableCoins, const CAmount& nTargetValue, std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet, const CCoinControl* coinControl, AvailableCoinsType nCoinType, bool fUseInstantSend) const
+/** The cost of change and the waste of an input, for selecting the inputs of a transaction paying the coin_control fee */
+static CoinSelectionParams GetCoinSelectionParams(const CCoinControl& coin_control, size_t change_prototype_size, const CFeeRate& discard_rate)
+{
+    CoinSelectionParams params;
+    params.nCostOfChange = GetMinimumFee(change_prototype_size, coin_control, ::mempool, ::feeEstimator, nullptr) + discard_rate.GetFee(CHANGE_SPEND_SIZE);
+
+    CCoinControl long_term_control(coin_control);
+    long_term_control.m_confirm_target = LONG_TERM_FEE_TARGET;
+    params.nInputWaste = GetMinimumFee(CHANGE_SPEND_SIZE, coin_control, ::mempool, ::feeEstimator, nullptr) -
+                         GetMinimumFee(CHANGE_SPEND_SIZE, long_term_control, ::mempool, ::feeEstimator, nullptr);
+    return params;
+}
+
+bool CWallet::SelectCoins(const std::vector<COutput>& vAvailableCoins, const CAmount& nTargetValue, std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet, const CCoinControl* coinControl, AvailableCoinsType nCoinType, bool fUseInstantSend, CoinSelectionParams* params) const
 {
     std::vector<COutput> vCoins(vAvailableCoins);
+    if (params)
+        params->fUsedBnB = false;
 
     // coin control -> return all selected outputs (we want all selected to go into the transaction for sure)
     if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs)
@@ -2736,13 +3366,13 @@ bool CWallet::SelectCoins(const std::vector<COutput>& vAvailableCoins, const CAm
     bool fRejectLongChains = gArgs.GetBoolArg("-walletrejectlongchains", DEFAULT_WALLET_REJECT_LONG_CHAINS);
 
     bool res = nTargetValue <= nValueFromPresetInputs ||
-        SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 1, 6, 0, vCoins, setCoinsRet, nValueRet) ||
-        SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 1, 1, 0, vCoins, setCoinsRet, nValueRet) ||
-        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, 2, vCoins, setCoinsRet, nValueRet)) ||
-        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, std::min((size_t)4, nMaxChainLength/3), vCoins, setCoinsRet, nValueRet)) ||
-        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, nMaxChainLength/2, vCoins, setCoinsRet, nValueRet)) ||
-        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, nMaxChainLength, vCoins, setCoinsRet, nValueRet)) ||
-        (bSpendZeroConfChange && !fRejectLongChains && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, std::numeric_limits<uint64_t>::max(), vCoins, setCoinsRet, nValueRet));
+        SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 1, 6, 0, vCoins, setCoinsRet, nValueRet, params) ||
+        SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 1, 1, 0, vCoins, setCoinsRet, nValueRet, params) ||
+        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, 2, vCoins, setCoinsRet, nValueRet, params)) ||
+        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, std::min((size_t)4, nMaxChainLength/3), vCoins, setCoinsRet, nValueRet, params)) ||
+        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, nMaxChainLength/2, vCoins, setCoinsRet, nValueRet, params)) ||
+        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, nMaxChainLength, vCoins, setCoinsRet, nValueRet, params)) ||
+        (bSpendZeroConfChange && !fRejectLongChains && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, std::numeric_limits<uint64_t>::max(), vCoins, setCoinsRet, nValueRet, params));
 
     // because SelectCoinsMinConf clears the setCoinsRet, we now add the possible inputs to the coinset
     setCoinsRet.insert(setPresetCoins.begin(), setPresetCoins.end());
@@ -2758,23 +3388,19 @@ bool CWallet::SignTransaction(CMutableTransaction &tx)
     AssertLockHeld(cs_wallet); // mapWallet
 
     // sign the new tx
-    CTransaction txNewConst(tx);
-    int nIn = 0;
+    std::vector<SignInput> vInputs;
+    vInputs.reserve(tx.vin.size());
+    unsigned int nIn = 0;
     for (const auto& input : tx.vin) {
         std::map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(input.prevout.hash);
         if(mi == mapWallet.end() || input.prevout.n >= mi->second.tx->vout.size()) {
             return false;
         }
-        const CScript& scriptPubKey = mi->second.tx->vout[input.prevout.n].scriptPubKey;
-        const CAmount& amount = mi->second.tx->vout[input.prevout.n].nValue;
-        SignatureData sigdata;
-        if (!ProduceSignature(TransactionSignatureCreator(this, &txNewConst, nIn, amount, SIGHASH_ALL), scriptPubKey, sigdata)) {
-            return false;
-        }
-        UpdateTransaction(tx, nIn, sigdata);
+        const CTxOut& prevout = mi->second.tx->vout[input.prevout.n];
+        vInputs.emplace_back(nIn, prevout.scriptPubKey, prevout.nValue, SIGHASH_ALL);
         nIn++;
     }
-    return true;
+    return ProduceSignatures(*this, tx, vInputs);
 }
 
 bool CWallet::FundTransaction(CMutableTransaction& tx, CAmount& nFeeRet, int& nChangePosInOut, std::string& strFailReason, bool lockUnspents, const std::set<int>& setSubtractFeeFromOutputs, CCoinControl coinControl)
@@ -2796,7 +3422,7 @@ bool CWallet::FundTransaction(CMutableTransaction& tx, CAmount& nFeeRet, int& nC
 
     // Acquire the locks to prevent races to the new locked unspents between the
     // CreateTransaction call and LockCoin calls (when lockUnspents is true).
-    LOCK2(cs_main, cs_wallet);
+    LOCK(cs_wallet);
 
     CReserveKey reservekey(this);
     CWalletTx wtx;
@@ -2879,7 +3505,8 @@ bool CWallet::CreateTransaction(const std::vector<CRecipient>& vecSend, CWalletT
     // enough, that fee sniping isn't a problem yet, but by implementing a fix
     // now we ensure code won't be written that makes assumptions about
     // nLockTime that preclude a fix later.
-    txNew.nLockTime = chainActive.Height();
+    const int nLastBlockHeight = GetLastBlockHeight();
+    txNew.nLockTime = std::max(0, nLastBlockHeight);
 
     // Secondly occasionally randomly pick a nLockTime even further back, so
     // that transactions that are delayed after signing for whatever reason,
@@ -2888,14 +3515,14 @@ bool CWallet::CreateTransaction(const std::vector<CRecipient>& vecSend, CWalletT
     if (GetRandInt(10) == 0)
         txNew.nLockTime = std::max(0, (int)txNew.nLockTime - GetRandInt(100));
 
-    assert(txNew.nLockTime <= (unsigned int)chainActive.Height());
+    assert(txNew.nLockTime <= (unsigned int)std::max(0, nLastBlockHeight));
     assert(txNew.nLockTime < LOCKTIME_THRESHOLD);
     FeeCalculation feeCalc;
     CAmount nFeeNeeded;
     unsigned int nBytes;
     {
         std::set<CInputCoin> setCoins;
-        LOCK2(cs_main, cs_wallet);
+        LOCK(cs_wallet);
         {
             std::vector<COutput> vAvailableCoins;
             AvailableCoins(vAvailableCoins, true, &coin_control, false, MAX_MONEY, MAX_MONEY,0, 0, 9999999, nCoinType, fUseInstantSend);
@@ -2937,6 +3564,10 @@ bool CWallet::CreateTransaction(const std::vector<CRecipient>& vecSend, CWalletT
             size_t change_prototype_size = GetSerializeSize(change_prototype_txout, SER_DISK, 0);
 
             CFeeRate discard_rate = GetDiscardRate(::feeEstimator);
+            // Only look for a selection without change when the change could have been given to the fee
+            CoinSelectionParams coin_selection_params;
+            if (nCoinType != ONLY_DENOMINATED && nSubtractFeeFromAmount == 0)
+                coin_selection_params = GetCoinSelectionParams(coin_control, change_prototype_size, discard_rate);
             nFeeRet = 0;
             bool pick_new_inputs = true;
             CAmount nValueIn = 0;
@@ -2989,7 +3620,7 @@ bool CWallet::CreateTransaction(const std::vector<CRecipient>& vecSend, CWalletT
                 if (pick_new_inputs) {
                     nValueIn = 0;
                     setCoins.clear();
-                    if (!SelectCoins(vAvailableCoins, nValueToSelect, setCoins, nValueIn, &coin_control))
+                    if (!SelectCoins(vAvailableCoins, nValueToSelect, setCoins, nValueIn, &coin_control, ALL_COINS, false, &coin_selection_params))
                     {
                         if (nCoinType == ONLY_NOT40000IFMN) {
                             strFailReason = _("Unable to locate enough funds for this transaction that are not equal 40000 NIX.");
@@ -3015,6 +3646,10 @@ bool CWallet::CreateTransaction(const std::vector<CRecipient>& vecSend, CWalletT
                         wtxNew.mapValue["DS"] = "1";
                         // recheck skipped denominations during next mixing
                         darkSendPool.ClearSkippedDenominations();
+                    } else if (coin_selection_params.fUsedBnB) {
+                        // The excess costs less than the change would
+                        nChangePosInOut = -1;
+                        nFeeRet += nChange;
                     } else {
                         // Fill a vout to ourself
                         // TODO: pass in scriptChange instead of reservekey so
@@ -3146,6 +3781,7 @@ bool CWallet::CreateTransaction(const std::vector<CRecipient>& vecSend, CWalletT
                         CAmount minimum_value_for_change = GetDustThreshold(change_prototype_txout, discard_rate);
                         if (nFeeRet >= fee_needed_with_change + minimum_value_for_change) {
                             pick_new_inputs = false;
+                            coin_selection_params.fUsedBnB = false;
                             nFeeRet = fee_needed_with_change;
                             continue;
                         }
@@ -3197,22 +3833,16 @@ bool CWallet::CreateTransaction(const std::vector<CRecipient>& vecSend, CWalletT
 
         if (sign)
         {
-            CTransaction txNewConst(txNew);
-            int nIn = 0;
+            std::vector<SignInput> vInputs;
+            vInputs.reserve(setCoins.size());
+            unsigned int nIn = 0;
             for (const auto& coin : setCoins)
-            {
-                const CScript& scriptPubKey = coin.txout.scriptPubKey;
-                SignatureData sigdata;
+                vInputs.emplace_back(nIn++, coin.txout.scriptPubKey, coin.txout.nValue, SIGHASH_ALL);
 
-                if (!ProduceSignature(TransactionSignatureCreator(this, &txNewConst, nIn, coin.txout.nValue, SIGHASH_ALL), scriptPubKey, sigdata))
-                {
-                    strFailReason = _("Signing transaction failed");
-                    return false;
-                } else {
-                    UpdateTransaction(txNew, nIn, sigdata);
-                }
-
-                nIn++;
+            if (!ProduceSignatures(*this, txNew, vInputs))
+            {
+                strFailReason = _("Signing transaction failed");
+                return false;
             }
         }
 
@@ -3350,6 +3980,21 @@ DBErrors CWallet::LoadWallet(bool& fFirstRunRet)
     if (nLoadWalletRet != DB_LOAD_OK)
         return nLoadWalletRet;
 
+    // The wallet's view of the chain starts from the active chain, BlockConnected takes it from there
+    {
+        LOCK(cs_chainview);
+        nChainViewHeight = chainActive.Height();
+        mapChainViewHeights.clear();
+        for (const auto& entry : mapWallet) {
+            const CWalletTx& wtx = entry.second;
+            if (wtx.hashUnset())
+                continue;
+            BlockMap::const_iterator mi = mapBlockIndex.find(wtx.hashBlock);
+            if (mi != mapBlockIndex.end() && chainActive.Contains(mi->second))
+                mapChainViewHeights[wtx.hashBlock] = mi->second->nHeight;
+        }
+    }
+
     uiInterface.LoadWallet(this);
 
     return DB_LOAD_OK;
@@ -3361,6 +4006,8 @@ DBErrors CWallet::ZapSelectTx(std::vector<uint256>& vHashIn, std::vector<uint256
     DBErrors nZapSelectTxRet = CWalletDB(*dbw,"cr+").ZapSelectTx(vHashIn, vHashOut);
     for (uint256 hash : vHashOut)
         mapWallet.erase(hash);
+    fBalancesFull = true;
+    nBalanceChanges++;
 
     if (nZapSelectTxRet == DB_NEED_REWRITE)
     {
@@ -3545,6 +4192,23 @@ size_t CWallet::KeypoolCountExternalKeys()
     return setExternalKeyPool.size();
 }
 
+size_t CWallet::DynamicMemoryUsage()
+{
+    LOCK(cs_wallet);
+    size_t usage = memusage::DynamicUsage(mapWallet) + memusage::DynamicUsage(wtxOrdered) +
+                   memusage::DynamicUsage(mapTxSpends) + memusage::DynamicUsage(mapRequestCount);
+    for (const auto& entry : mapWallet) {
+        const CWalletTx& wtx = entry.second;
+        usage += RecursiveDynamicUsage(wtx.tx) + memusage::DynamicUsage(wtx.mapValue) + memusage::DynamicUsage(wtx.vOrderForm);
+    }
+    usage += memusage::DynamicUsage(mapAddressBook) + memusage::DynamicUsage(mapKeyMetadata) +
+             memusage::DynamicUsage(setInternalKeyPool) + memusage::DynamicUsage(setExternalKeyPool);
+    usage += memusage::DynamicUsage(mapZerocoinEntries);
+    for (const auto& entry : mapZerocoinEntries)
+        usage += BigNumDynamicUsage(entry.first);
+    return usage;
+}
+
 void CWallet::LoadKeyPool(int64_t nIndex, const CKeyPool &keypool)
 {
     AssertLockHeld(cs_wallet);
@@ -3589,29 +4253,59 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
             // don't create extra internal keys
             missingInternal = 0;
         }
-        bool internal = false;
+        const int64_t nMissing = missingInternal + missingExternal;
+        const bool fProgress = nMissing > KEYPOOL_TOPUP_BATCH_SIZE;
+        int64_t nAdded = 0;
+        int nProgress = 0;
+        if (fProgress)
+            ShowProgress(_("Generating keys..."), 0);
+
+        // All the keys of the top-up are written in one database transaction
         CWalletDB walletdb(*dbw);
-        for (int64_t i = missingInternal + missingExternal; i--;)
+        CWalletDBTxn txn(walletdb);
+        for (int nPass = 0; nPass < 2; nPass++)
         {
-            if (i < missingInternal) {
-                internal = true;
-            }
-
-            assert(m_max_keypool_index < std::numeric_limits<int64_t>::max()); // How in the hell did you use so many keys?
-            int64_t index = ++m_max_keypool_index;
+            // external keys first
+            bool internal = nPass == 1;
+            int64_t nMissingPass = internal ? missingInternal : missingExternal;
+            while (nMissingPass > 0)
+            {
+                std::vector<CPubKey> vPubKeys;
+                if (IsHDEnabled())
+                    vPubKeys = DeriveNewChildKeys(walletdb, CanSupportFeature(FEATURE_HD_SPLIT) ? internal : false, std::min(nMissingPass, (int64_t)KEYPOOL_TOPUP_BATCH_SIZE));
+                else
+                    vPubKeys.push_back(GenerateNewKey(walletdb, internal));
+
+                for (const CPubKey& pubkey : vPubKeys) {
+                    assert(m_max_keypool_index < std::numeric_limits<int64_t>::max()); // How in the hell did you use so many keys?
+                    int64_t index = ++m_max_keypool_index;
+
+                    if (!walletdb.WritePool(index, CKeyPool(pubkey, internal))) {
+                        throw std::runtime_error(std::string(__func__) + ": writing generated key failed");
+                    }
 
-            CPubKey pubkey(GenerateNewKey(walletdb, internal));
-            if (!walletdb.WritePool(index, CKeyPool(pubkey, internal))) {
-                throw std::runtime_error(std::string(__func__) + ": writing generated key failed");
-            }
+                    if (internal) {
+                        setInternalKeyPool.insert(index);
+                    } else {
+                        setExternalKeyPool.insert(index);
+                    }
+                    m_pool_key_to_index[pubkey.GetID()] = index;
+                }
+                nMissingPass -= vPubKeys.size();
+                nAdded += vPubKeys.size();
 
-            if (internal) {
-                setInternalKeyPool.insert(index);
-            } else {
-                setExternalKeyPool.insert(index);
+                if (fProgress && nAdded * 100 / nMissing > nProgress) {
+                    nProgress = nAdded * 100 / nMissing;
+                    ShowProgress(_("Generating keys..."), std::min(nProgress, 99));
+                }
             }
-            m_pool_key_to_index[pubkey.GetID()] = index;
         }
+        if (!txn.Commit()) {
+            throw std::runtime_error(std::string(__func__) + ": committing generated keys failed");
+        }
+        if (fProgress)
+            ShowProgress(_("Generating keys..."), 100);
+
         if (missingInternal + missingExternal > 0) {
             LogPrintf("keypool added %d keys (%d internal), size=%u (%u internal)\n", missingInternal + missingExternal, missingInternal, setInternalKeyPool.size() + setExternalKeyPool.size(), setInternalKeyPool.size());
         }
@@ -3953,18 +4647,21 @@ void CWallet::LockCoin(const COutPoint& output)
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.insert(output);
+    InvalidateTallyCache();
 }
 
 void CWallet::UnlockCoin(const COutPoint& output)
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.erase(output);
+    InvalidateTallyCache();
 }
 
 void CWallet::UnlockAllCoins()
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.clear();
+    InvalidateTallyCache();
 }
 
 bool CWallet::IsLockedCoin(uint256 hash, unsigned int n) const
@@ -4274,7 +4971,7 @@ CWallet* CWallet::CreateWalletFromFile(const std::string walletFile)
     }
 
     walletInstance->m_last_block_processed = chainActive.Tip();
-    RegisterValidationInterface(walletInstance);
+    RegisterValidationInterface(walletInstance, "wallet");
 
     if (chainActive.Tip() && chainActive.Tip() != pindexRescan)
     {
@@ -4362,7 +5059,7 @@ void CWallet::postInitProcess(CScheduler& scheduler)
 
     // Run a thread to flush wallet periodically
     if (!CWallet::fFlushScheduled.exchange(true)) {
-        scheduler.scheduleEvery(MaybeCompactWalletDB, 500);
+        scheduler.scheduleEvery(MaybeCompactWalletDB, 500, "wallet");
     }
 }
 
@@ -4399,59 +5096,25 @@ void CMerkleTx::SetMerkleBranch(const CBlockIndex* pindex, int posInBlock)
     nIndex = posInBlock;
 }
 
-int CMerkleTx::GetDepthInMainChain(const CBlockIndex *&pindexRet, bool enableIX) const {
-    int nResult;
-
+int CWalletTx::GetDepthInMainChain() const
+{
     if (hashUnset())
-        nResult = 0;
-    else {
-        AssertLockHeld(cs_main);
-
-        // Find the block it claims to be in
-        BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
-        if (mi == mapBlockIndex.end())
-            nResult = 0;
-        else {
-            CBlockIndex *pindex = (*mi).second;
-            if (!pindex || !chainActive.Contains(pindex))
-                nResult = 0;
-            else {
-                pindexRet = pindex;
-                nResult = ((nIndex == -1) ? (-1) : 1) * (chainActive.Height() - pindex->nHeight + 1);
-
-                if (nResult == 0 && !mempool.exists(GetHash()))
-                    return -1; // Not in chain, not in mempool
-            }
-        }
-    }
-
-    if (enableIX && nResult < 6 && instantsend.IsLockedInstantSendTransaction(GetHash()))
-        return nInstantSendDepth + nResult;
+        return 0;
 
-    return nResult;
+    return ((nIndex == -1) ? (-1) : 1) * pwallet->GetBlockDepth(hashBlock);
 }
 
-
-int CMerkleTx::GetDepthInMainChain(const CBlockIndex* &pindexRet) const
+int CWalletTx::GetDepthInMainChain(bool enableIX) const
 {
-    if (hashUnset())
-        return 0;
-
-    AssertLockHeld(cs_main);
+    int nResult = GetDepthInMainChain();
 
-    // Find the block it claims to be in
-    BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
-    if (mi == mapBlockIndex.end())
-        return 0;
-    CBlockIndex* pindex = (*mi).second;
-    if (!pindex || !chainActive.Contains(pindex))
-        return 0;
+    if (enableIX && nResult < 6 && instantsend.IsLockedInstantSendTransaction(GetHash()))
+        return nInstantSendDepth + nResult;
 
-    pindexRet = pindex;
-    return ((nIndex == -1) ? (-1) : 1) * (chainActive.Height() - pindex->nHeight + 1);
+    return nResult;
 }
 
-int CMerkleTx::GetBlocksToMaturity() const
+int CWalletTx::GetBlocksToMaturity() const
 {
     if (!IsCoinBase())
         return 0;
@@ -4474,6 +5137,8 @@ bool CWalletTx::AcceptToMemoryPool(const CAmount& nAbsurdFee, CValidationState&
     bool ret = ::AcceptToMemoryPool(mempool, state, tx, nullptr /* pfMissingInputs */,
                                 nullptr /* plTxnReplaced */, false /* bypass_limits */, nAbsurdFee);
     fInMempool = ret;
+    if (pwallet)
+        pwallet->MarkBalanceDirty(GetHash());
     return ret;
 }
 
@@ -4587,47 +5252,60 @@ CTxDestination CWallet::AddAndGetDestinationForScript(const CScript& script, Out
 
 bool CWallet::CreateZerocoinMintModel(string &stringError, string denomAmount) {
 
-    int64_t nAmount = 0;
     libzerocoin::CoinDenomination denomination;
     // Amount
     if (denomAmount == "1") {
         denomination = libzerocoin::ZQ_ONE;
-        nAmount = roundint64(1 * COIN);
     } else if (denomAmount == "5") {
         denomination = libzerocoin::ZQ_FIVE;
-        nAmount = roundint64(5 * COIN);
     } else if (denomAmount == "10") {
         denomination = libzerocoin::ZQ_TEN;
-        nAmount = roundint64(10 * COIN);
     } else if (denomAmount == "50") {
         denomination = libzerocoin::ZQ_FIFTY;
-        nAmount = roundint64(50 * COIN);
     } else if (denomAmount == "100") {
         denomination = libzerocoin::ZQ_ONE_HUNDRED;
-        nAmount = roundint64(100 * COIN);
     }  else if (denomAmount == "500") {
         denomination = libzerocoin::ZQ_FIVE_HUNDRED;
-        nAmount = roundint64(500 * COIN);
     } else if (denomAmount == "1000") {
         denomination = libzerocoin::ZQ_ONE_THOUSAND;
-        nAmount = roundint64(1000 * COIN);
     } else if (denomAmount == "5000") {
         denomination = libzerocoin::ZQ_FIVE_THOUSAND;
-        nAmount = roundint64(5000 * COIN);
     } else {
         return false;
     }
 
+    return CreateZerocoinMintModels(stringError, std::vector<libzerocoin::CoinDenomination>(1, denomination));
+}
+
+bool CWallet::CreateZerocoinMintModels(string &stringError, const std::vector<libzerocoin::CoinDenomination> &denominations) {
+
     // Set up the Zerocoin Params object
     libzerocoin::Params *zcParams = ZCParams;
 
     int mintVersion = 1;
 
-    // The following constructor does all the work of minting a brand
-    // new zerocoin. It stores all the private values inside the
-    // PrivateCoin object. This includes the coin secrets, which must be
-    // stored in a secure location (wallet) at the client.
-    libzerocoin::PrivateCoin newCoin(zcParams, denomination, mintVersion);
+    // MintPrivateCoins does all the work of minting brand new zerocoins,
+    // searching for the coins in parallel. It stores all the private values
+    // inside the PrivateCoin objects. This includes the coin secrets, which
+    // must be stored in a secure location (wallet) at the client.
+    std::vector<libzerocoin::PrivateCoin> newCoins;
+    try {
+        newCoins = libzerocoin::MintPrivateCoins(zcParams, denominations, mintVersion);
+    } catch (const std::exception &e) {
+        stringError = e.what();
+        return false;
+    }
+
+    for (size_t i = 0; i < newCoins.size(); i++) {
+        if (!CommitZerocoinMintModel(stringError, newCoins[i], denominations[i]))
+            return false;
+    }
+    return true;
+}
+
+bool CWallet::CommitZerocoinMintModel(string &stringError, const libzerocoin::PrivateCoin &newCoin, libzerocoin::CoinDenomination denomination) {
+
+    int64_t nAmount = libzerocoin::ZerocoinDenominationToAmount(denomination);
 
     // Get a copy of the 'public' portion of the coin. You should
     // embed this into a Zerocoin 'MINT' transaction along with a series
@@ -4660,7 +5338,7 @@ bool CWallet::CreateZerocoinMintModel(string &stringError, string denomAmount) {
         LogPrintf("pubcoin=%s, isUsed=%s\n", zerocoinTx.value.GetHex(), zerocoinTx.IsUsed);
         LogPrintf("randomness=%s, serialNumber=%s\n", zerocoinTx.randomness.ToString(), zerocoinTx.serialNumber.ToString());
         NotifyZerocoinChanged(this, zerocoinTx.value.GetHex(), zerocoinTx.denomination, zerocoinTx.IsUsed ? "Used" : "New", CT_NEW);
-        if (!CWalletDB(*dbw).WriteZerocoinEntry(zerocoinTx))
+        if (!WriteZerocoinEntry(zerocoinTx))
             return false;
         return true;
     } else {
@@ -4756,18 +5434,19 @@ bool CWallet::CreateZerocoinMintTransaction(const vector <CRecipient> &vecSend,
     wtxNew.fTimeReceivedIsTxTime = true;
     wtxNew.BindWallet(this);
     CMutableTransaction txNew;
-    txNew.nLockTime = chainActive.Height();
+    const int nLastBlockHeight = GetLastBlockHeight();
+    txNew.nLockTime = std::max(0, nLastBlockHeight);
     if (GetRandInt(10) == 0)
         txNew.nLockTime = std::max(0, (int) txNew.nLockTime - GetRandInt(100));
 
-    assert(txNew.nLockTime <= (unsigned int) chainActive.Height());
+    assert(txNew.nLockTime <= (unsigned int) std::max(0, nLastBlockHeight));
     assert(txNew.nLockTime < LOCKTIME_THRESHOLD);
     FeeCalculation feeCalc;
     CAmount nFeeNeeded;
     unsigned int nBytes;
     {
         std::set<CInputCoin> setCoins;
-        LOCK2(cs_main, cs_wallet);
+        LOCK(cs_wallet);
         {
             std::vector<COutput> vAvailableCoins;
             AvailableCoins(vAvailableCoins, true, &coinControl);
@@ -4808,6 +5487,8 @@ bool CWallet::CreateZerocoinMintTransaction(const vector <CRecipient> &vecSend,
             size_t change_prototype_size = GetSerializeSize(change_prototype_txout, SER_DISK, 0);
 
             CFeeRate discard_rate = GetDiscardRate(::feeEstimator);
+            // Mint denominations are exact, look for inputs paying for them and the fee without change
+            CoinSelectionParams coin_selection_params = GetCoinSelectionParams(coinControl, change_prototype_size, discard_rate);
             nFeeRet = payTxFee.GetFeePerK();
             bool pick_new_inputs = true;
             // Start with no fee and loop until there is enough fee
@@ -4843,7 +5524,7 @@ bool CWallet::CreateZerocoinMintTransaction(const vector <CRecipient> &vecSend,
 
                 // Choose coins to use
                 CAmount nValueIn = 0;
-                if (!SelectCoins(vAvailableCoins, nValueToSelect, setCoins, nValueIn, &coinControl)) {
+                if (!SelectCoins(vAvailableCoins, nValueToSelect, setCoins, nValueIn, &coinControl, ALL_COINS, false, &coin_selection_params)) {
                     if (nValueIn < nValueToSelect) {
                         strFailReason = _("Insufficient funds.");
                     }
@@ -4859,6 +5540,10 @@ bool CWallet::CreateZerocoinMintTransaction(const vector <CRecipient> &vecSend,
                     nChangeTemp -= nMoveToFee;
                     nFeeRet += nMoveToFee;
                 }
+                if (coin_selection_params.fUsedBnB) {
+                    nFeeRet += nChangeTemp;
+                    nChangeTemp = 0;
+                }
 
                 const CAmount nChange = nChangeTemp;
 
@@ -4989,22 +5674,16 @@ bool CWallet::CreateZerocoinMintTransaction(const vector <CRecipient> &vecSend,
 
         if (sign)
         {
-            CTransaction txNewConst(txNew);
-            int nIn = 0;
+            std::vector<SignInput> vInputs;
+            vInputs.reserve(setCoins.size());
+            unsigned int nIn = 0;
             for (const auto& coin : setCoins)
-            {
-                const CScript& scriptPubKey = coin.txout.scriptPubKey;
-                SignatureData sigdata;
-
-                if (!ProduceSignature(TransactionSignatureCreator(this, &txNewConst, nIn, coin.txout.nValue, SIGHASH_ALL), scriptPubKey, sigdata))
-                {
-                    strFailReason = _("Signing transaction failed");
-                    return false;
-                } else {
-                    UpdateTransaction(txNew, nIn, sigdata);
-                }
+                vInputs.emplace_back(nIn++, coin.txout.scriptPubKey, coin.txout.nValue, SIGHASH_ALL);
 
-                nIn++;
+            if (!ProduceSignatures(*this, txNew, vInputs))
+            {
+                strFailReason = _("Signing transaction failed");
+                return false;
             }
         }
 
@@ -5062,6 +5741,37 @@ bool CWallet::CreateZerocoinMintTransaction(CScript pubCoin, int64_t nValue, CWa
  * @param strFailReason
  * @return
  */
+namespace {
+
+// Holds the coin picked for a spend in setZerocoinSpendsInProgress until the spend transaction is built or given up
+class CZerocoinSpendReservation
+{
+private:
+    CWallet *pwallet;
+    CBigNum pubCoin;
+    bool fReserved;
+
+public:
+    CZerocoinSpendReservation(CWallet *pwalletIn) : pwallet(pwalletIn), fReserved(false) {}
+
+    void Reserve(const CBigNum &pubCoinIn)
+    {
+        AssertLockHeld(pwallet->cs_wallet);
+        pubCoin = pubCoinIn;
+        fReserved = pwallet->setZerocoinSpendsInProgress.insert(pubCoin).second;
+    }
+
+    ~CZerocoinSpendReservation()
+    {
+        if (fReserved) {
+            LOCK(pwallet->cs_wallet);
+            pwallet->setZerocoinSpendsInProgress.erase(pubCoin);
+        }
+    }
+};
+
+}
+
 bool CWallet::CreateZerocoinSpendTransaction(std::string &toKey, int64_t nValue, libzerocoin::CoinDenomination denomination,
                                              CWalletTx &wtxNew, CReserveKey &reservekey, CBigNum &coinSerial,
                                              uint256 &txHash, CBigNum &zcSelectedValue, bool &zcSelectedIsUsed,
@@ -5073,6 +5783,15 @@ bool CWallet::CreateZerocoinSpendTransaction(std::string &toKey, int64_t nValue,
 
     wtxNew.BindWallet(this);
     CMutableTransaction txNew;
+
+    libzerocoin::Params *zcParams = ZCParams;
+    CZerocoinEntry coinToUse;
+    CBigNum accumulatorValue;
+    uint256 accumulatorBlockHash;
+    std::unique_ptr<libzerocoin::AccumulatorWitness> witness;
+    int coinId = INT_MAX;
+    int coinHeight = 0;
+    CZerocoinSpendReservation reservation(this);
     {
         LOCK2(cs_main, cs_wallet);
         {
@@ -5135,29 +5854,22 @@ bool CWallet::CreateZerocoinSpendTransaction(std::string &toKey, int64_t nValue,
             if (!setParams) {
                 LogPrintf("bnTrustedModulus.SetHexBool(ZEROCOIN_MODULUS) failed");
             }
-            libzerocoin::Params *zcParams = ZCParams;
 
             // Set up the Zerocoin Params object
 
             // Select not yet used coin from the wallet with minimal possible id
 
             list <CZerocoinEntry> listPubCoin;
-            CWalletDB(*dbw).ListPubCoin(listPubCoin);
+            ListZerocoinEntries(denomination, listPubCoin);
             listPubCoin.sort(CompHeight);
-            CZerocoinEntry coinToUse;
             CZerocoinState *zerocoinState = CZerocoinState::GetZerocoinState();
 
-            CBigNum accumulatorValue;
-            uint256 accumulatorBlockHash;
-
-            int coinId = INT_MAX;
-            int coinHeight;
-
             BOOST_FOREACH(const CZerocoinEntry &minIdPubcoin, listPubCoin) {
                 if (minIdPubcoin.denomination == denomination
                         && minIdPubcoin.IsUsed == false
                         && minIdPubcoin.randomness != 0
-                        && minIdPubcoin.serialNumber != 0) {
+                        && minIdPubcoin.serialNumber != 0
+                        && setZerocoinSpendsInProgress.count(minIdPubcoin.value) == 0) {
 
                     int id;
                     coinHeight = zerocoinState->GetMintedCoinHeightAndId(minIdPubcoin.value, minIdPubcoin.denomination, id);
@@ -5182,7 +5894,6 @@ bool CWallet::CreateZerocoinSpendTransaction(std::string &toKey, int64_t nValue,
                 return false;
             }
 
-            libzerocoin::Accumulator accumulator(zcParams, accumulatorValue, denomination);
             // 2. Get pubcoin from the private coin
             libzerocoin::PublicCoin pubCoinSelected(zcParams, coinToUse.value, denomination);
 
@@ -5195,117 +5906,247 @@ bool CWallet::CreateZerocoinSpendTransaction(std::string &toKey, int64_t nValue,
                 return false;
             }
 
-            // 4. Get witness from the index
-            libzerocoin::AccumulatorWitness witness =
-                    zerocoinState->GetWitnessForSpend(&chainActive,
-                                                      chainActive.Height()-(ZEROCOIN_CONFIRM_HEIGHT),
-                                                      denomination, coinId,
-                                                      coinToUse.value);
+            // 4. Get witness, stored one is advanced to the spend height if possible
+            witness.reset(new libzerocoin::AccumulatorWitness(
+                    GetZerocoinWitness(coinToUse, coinId, chainActive.Height()-(ZEROCOIN_CONFIRM_HEIGHT))));
+
+            // Keep other spends off the coin until this one is done with it
+            reservation.Reserve(coinToUse.value);
+        }
+    }
 
-            CTxIn newTxIn;
-            newTxIn.nSequence = coinId;
-            newTxIn.scriptSig = CScript();
-            newTxIn.prevout.SetNull();
-            txNew.vin.push_back(newTxIn);
+    // The proof only depends on the accumulator and witness taken above, build it without the global locks
+    libzerocoin::Accumulator accumulator(zcParams, accumulatorValue, denomination);
+    libzerocoin::PublicCoin pubCoinSelected(zcParams, coinToUse.value, denomination);
 
-            // We use incomplete transaction hash for now as a metadata
-            libzerocoin::SpendMetaData metaData(coinId, txNew.GetHash());
+    CTxIn newTxIn;
+    newTxIn.nSequence = coinId;
+    newTxIn.scriptSig = CScript();
+    newTxIn.prevout.SetNull();
+    txNew.vin.push_back(newTxIn);
 
-            // Construct the CoinSpend object. This acts like a signature on the
-            // transaction.
-            libzerocoin::PrivateCoin privateCoin(zcParams, denomination);
+    // We use incomplete transaction hash for now as a metadata
+    libzerocoin::SpendMetaData metaData(coinId, txNew.GetHash());
 
-            int txVersion = 1;
+    // Construct the CoinSpend object. This acts like a signature on the
+    // transaction.
+    libzerocoin::PrivateCoin privateCoin(zcParams, denomination);
 
-            LogPrintf("CreateZerocoinSpendTransation: tx version=%d, tx metadata hash=%s\n", txVersion, txNew.GetHash().ToString());
+    int txVersion = 1;
 
-            privateCoin.setVersion(txVersion);
-            privateCoin.setPublicCoin(pubCoinSelected);
-            privateCoin.setRandomness(coinToUse.randomness);
-            privateCoin.setSerialNumber(coinToUse.serialNumber);
-            privateCoin.setEcdsaSeckey(coinToUse.ecdsaSecretKey);
+    LogPrintf("CreateZerocoinSpendTransation: tx version=%d, tx metadata hash=%s\n", txVersion, txNew.GetHash().ToString());
 
-            libzerocoin::CoinSpend spend(zcParams, privateCoin, accumulator, witness, metaData, accumulatorBlockHash);
-            spend.setVersion(txVersion);
+    privateCoin.setVersion(txVersion);
+    privateCoin.setPublicCoin(pubCoinSelected);
+    privateCoin.setRandomness(coinToUse.randomness);
+    privateCoin.setSerialNumber(coinToUse.serialNumber);
+    privateCoin.setEcdsaSeckey(coinToUse.ecdsaSecretKey);
 
-            // This is a sanity check. The CoinSpend object should always verify,
-            // but why not check before we put it onto the wire?
-            if (!spend.Verify(accumulator, metaData)) {
-                strFailReason = _("the spend coin transaction did not verify");
-                return false;
-            }
+    libzerocoin::CoinSpend spend(zcParams, privateCoin, accumulator, *witness, metaData, accumulatorBlockHash);
+    spend.setVersion(txVersion);
 
-            // Serialize the CoinSpend object into a buffer.
-            CDataStream serializedCoinSpend(SER_NETWORK, PROTOCOL_VERSION);
-            serializedCoinSpend << spend;
+    // This is a sanity check. The CoinSpend object should always verify,
+    // but why not check before we put it onto the wire?
+    if (!spend.Verify(accumulator, metaData)) {
+        strFailReason = _("the spend coin transaction did not verify");
+        return false;
+    }
+
+    // Serialize the CoinSpend object into a buffer.
+    CDataStream serializedCoinSpend(SER_NETWORK, PROTOCOL_VERSION);
+    serializedCoinSpend << spend;
+
+    CScript tmp = CScript() << OP_ZEROCOINSPEND << serializedCoinSpend.size();
+    tmp.insert(tmp.end(), serializedCoinSpend.begin(), serializedCoinSpend.end());
+    txNew.vin[0].scriptSig.assign(tmp.begin(), tmp.end());
 
-            CScript tmp = CScript() << OP_ZEROCOINSPEND << serializedCoinSpend.size();
-            tmp.insert(tmp.end(), serializedCoinSpend.begin(), serializedCoinSpend.end());
-            txNew.vin[0].scriptSig.assign(tmp.begin(), tmp.end());
+    // Limit size
+    if (GetTransactionWeight(txNew) >= MAX_STANDARD_TX_WEIGHT) {
+        strFailReason = _("Transaction too large");
+        return false;
+    }
 
-            // Embed the constructed transaction data in wtxNew.
-             wtxNew.SetTx(MakeTransactionRef(std::move(txNew)));
+    // Embed the constructed transaction data in wtxNew.
+    wtxNew.SetTx(MakeTransactionRef(std::move(txNew)));
+
+    {
+        LOCK(cs_wallet);
 
-            // Limit size
-            if (GetTransactionWeight(txNew) >= MAX_STANDARD_TX_WEIGHT) {
-                strFailReason = _("Transaction too large");
+        std::list <CZerocoinSpendEntry> listCoinSpendSerial;
+        CWalletDB(*dbw).ListCoinSpendSerial(listCoinSpendSerial);
+        BOOST_FOREACH(const CZerocoinSpendEntry &item, listCoinSpendSerial){
+            if (spend.getCoinSerialNumber() == item.coinSerial) {
+                // THIS SELECEDTED COIN HAS BEEN USED, SO UPDATE ITS STATUS
+                CZerocoinEntry pubCoinTx;
+                pubCoinTx.nHeight = coinHeight;
+                pubCoinTx.denomination = coinToUse.denomination;
+                pubCoinTx.id = coinId;
+                pubCoinTx.IsUsed = true;
+                pubCoinTx.randomness = coinToUse.randomness;
+                pubCoinTx.serialNumber = coinToUse.serialNumber;
+                pubCoinTx.value = coinToUse.value;
+                pubCoinTx.ecdsaSecretKey = coinToUse.ecdsaSecretKey;
+                WriteZerocoinEntry(pubCoinTx);
+                LogPrintf("CreateZerocoinSpendTransaction() -> NotifyZerocoinChanged\n");
+                LogPrintf("pubcoin=%s, isUsed=Used\n", coinToUse.value.GetHex());
+                NotifyZerocoinChanged(this, coinToUse.value.GetHex(), pubCoinTx.denomination, "Used",
+                                                   CT_UPDATED);
+                strFailReason = _("the coin spend has been used");
                 return false;
             }
+        }
 
+        coinSerial = spend.getCoinSerialNumber();
+        txHash = wtxNew.GetHash();
+        LogPrintf("txHash:\n%s", txHash.ToString());
+        zcSelectedValue = coinToUse.value;
+        zcSelectedIsUsed = coinToUse.IsUsed;
 
-            std::list <CZerocoinSpendEntry> listCoinSpendSerial;
-            CWalletDB(*dbw).ListCoinSpendSerial(listCoinSpendSerial);
-            BOOST_FOREACH(const CZerocoinSpendEntry &item, listCoinSpendSerial){
-                if (spend.getCoinSerialNumber() == item.coinSerial) {
-                    // THIS SELECEDTED COIN HAS BEEN USED, SO UPDATE ITS STATUS
-                    CZerocoinEntry pubCoinTx;
-                    pubCoinTx.nHeight = coinHeight;
-                    pubCoinTx.denomination = coinToUse.denomination;
-                    pubCoinTx.id = coinId;
-                    pubCoinTx.IsUsed = true;
-                    pubCoinTx.randomness = coinToUse.randomness;
-                    pubCoinTx.serialNumber = coinToUse.serialNumber;
-                    pubCoinTx.value = coinToUse.value;
-                    pubCoinTx.ecdsaSecretKey = coinToUse.ecdsaSecretKey;
-                    CWalletDB(*dbw).WriteZerocoinEntry(pubCoinTx);
-                    LogPrintf("CreateZerocoinSpendTransaction() -> NotifyZerocoinChanged\n");
-                    LogPrintf("pubcoin=%s, isUsed=Used\n", coinToUse.value.GetHex());
-                    NotifyZerocoinChanged(this, coinToUse.value.GetHex(), pubCoinTx.denomination, "Used",
-                                                       CT_UPDATED);
-                    strFailReason = _("the coin spend has been used");
-                    return false;
-                }
-            }
+        CZerocoinSpendEntry entry;
+        entry.coinSerial = coinSerial;
+        entry.hashTx = txHash;
+        entry.pubCoin = zcSelectedValue;
+        entry.id = coinId;
+        entry.denomination = coinToUse.denomination;
+        LogPrintf("WriteCoinSpendSerialEntry, serialNumber=%s\n", coinSerial.ToString());
+        if (!CWalletDB(*dbw).WriteCoinSpendSerialEntry(entry)) {
+            strFailReason = _("it cannot write coin serial number into wallet");
+        }
 
-            coinSerial = spend.getCoinSerialNumber();
-            txHash = wtxNew.GetHash();
-            LogPrintf("txHash:\n%s", txHash.ToString());
-            zcSelectedValue = coinToUse.value;
-            zcSelectedIsUsed = coinToUse.IsUsed;
-
-            CZerocoinSpendEntry entry;
-            entry.coinSerial = coinSerial;
-            entry.hashTx = txHash;
-            entry.pubCoin = zcSelectedValue;
-            entry.id = coinId;
-            entry.denomination = coinToUse.denomination;
-            LogPrintf("WriteCoinSpendSerialEntry, serialNumber=%s\n", coinSerial.ToString());
-            if (!CWalletDB(*dbw).WriteCoinSpendSerialEntry(entry)) {
-                strFailReason = _("it cannot write coin serial number into wallet");
-            }
+        coinToUse.IsUsed = true;
+        coinToUse.id = coinId;
+        coinToUse.nHeight = coinHeight;
+        WriteZerocoinEntry(coinToUse);
+        CWalletDB(*dbw).EraseZerocoinWitness(coinToUse.value);
+        NotifyZerocoinChanged(this, coinToUse.value.GetHex(), coinToUse.denomination, "Used",
+                                           CT_UPDATED);
+    }
+
+    return true;
+}
+
+// Bring the stored witness to nTargetHeight by accumulating the coins of its group minted in between.
+// Returns false if the witness can't be reused and has to be rebuilt from the index
+static bool AdvanceZerocoinWitness(CZerocoinWitnessEntry &entry, int nTargetHeight)
+{
+    AssertLockHeld(cs_main);
+
+    if (entry.nHeight < 0 || nTargetHeight < 0 || nTargetHeight > chainActive.Height())
+        return false;
+    const CBlockIndex *pindex = chainActive[entry.nHeight];
+    if (!pindex || pindex->GetBlockHash() != entry.blockHash)
+        return false;
+
+    libzerocoin::CoinDenomination d = (libzerocoin::CoinDenomination)entry.denomination;
+    pair<int,int> denomAndId = make_pair(entry.denomination, entry.id);
 
-            coinToUse.IsUsed = true;
-            coinToUse.id = coinId;
-            coinToUse.nHeight = coinHeight;
-            CWalletDB(*dbw).WriteZerocoinEntry(coinToUse);
-            NotifyZerocoinChanged(this, coinToUse.value.GetHex(), coinToUse.denomination, "Used",
-                                               CT_UPDATED);
+    if (nTargetHeight < entry.nHeight) {
+        // Witness is ahead of the target, it's still good if nothing was minted into the group in between
+        for (int nHeight = nTargetHeight + 1; nHeight <= entry.nHeight; nHeight++) {
+            if (chainActive[nHeight]->accumulatorChanges.count(denomAndId) > 0)
+                return false;
+        }
+    }
+    else if (nTargetHeight > entry.nHeight) {
+        libzerocoin::Accumulator accumulator(ZCParams, entry.witnessValue, d);
+        for (int nHeight = entry.nHeight + 1; nHeight <= nTargetHeight; nHeight++) {
+            const CBlockIndex *pblockindex = chainActive[nHeight];
+            if (pblockindex->accumulatorChanges.count(denomAndId) == 0)
+                continue;
+            vector<CBigNum> mints = CZerocoinState::GetZerocoinState()->GetBlockMints(pblockindex, entry.denomination, entry.id);
+            for (const CBigNum &coin: mints)
+                accumulator += libzerocoin::PublicCoin(ZCParams, coin, d);
         }
+        entry.witnessValue = accumulator.getValue();
     }
 
+    entry.nHeight = nTargetHeight;
+    entry.blockHash = chainActive[nTargetHeight]->GetBlockHash();
     return true;
 }
 
+libzerocoin::AccumulatorWitness CWallet::GetZerocoinWitness(const CZerocoinEntry &coin, int id, int maxHeight)
+{
+    AssertLockHeld(cs_main);
+
+    libzerocoin::CoinDenomination d = (libzerocoin::CoinDenomination)coin.denomination;
+    libzerocoin::PublicCoin pubCoin(ZCParams, coin.value, d);
+
+    CWalletDB walletdb(*dbw);
+    CZerocoinWitnessEntry entry;
+    if (walletdb.ReadZerocoinWitness(coin.value, entry)
+            && entry.denomination == coin.denomination
+            && entry.id == id
+            && AdvanceZerocoinWitness(entry, maxHeight)) {
+        walletdb.WriteZerocoinWitness(entry);
+        return libzerocoin::AccumulatorWitness(ZCParams, libzerocoin::Accumulator(ZCParams, entry.witnessValue, d), pubCoin);
+    }
+
+    // Nothing usable stored, build the witness from the index and keep it for later
+    libzerocoin::AccumulatorWitness witness =
+            CZerocoinState::GetZerocoinState()->GetWitnessForSpend(&chainActive, maxHeight, coin.denomination, id, coin.value);
+
+    entry.SetNull();
+    entry.pubCoin = coin.value;
+    entry.denomination = coin.denomination;
+    entry.id = id;
+    entry.witnessValue = witness.getValue();
+    entry.nHeight = maxHeight;
+    entry.blockHash = chainActive[maxHeight]->GetBlockHash();
+    walletdb.WriteZerocoinWitness(entry);
+
+    return witness;
+}
+
+void CWallet::UpdateZerocoinWitnesses(const CBlockIndex *pindexTip)
+{
+    AssertLockHeld(cs_main);
+
+    // Witnesses are kept at the height spends are made against
+    int nTargetHeight = pindexTip->nHeight - ZEROCOIN_CONFIRM_HEIGHT;
+    if (nTargetHeight < 0 || chainActive[nTargetHeight] == NULL || chainActive[nTargetHeight]->accumulatorChanges.empty())
+        return;
+
+    CZerocoinState *zerocoinState = CZerocoinState::GetZerocoinState();
+    CWalletDB walletdb(*dbw);
+
+    list <CZerocoinEntry> listPubCoin;
+    ListZerocoinEntries(listPubCoin);
+    BOOST_FOREACH(const CZerocoinEntry &coin, listPubCoin) {
+        if (coin.IsUsed) {
+            walletdb.EraseZerocoinWitness(coin.value);
+            continue;
+        }
+        if (coin.randomness == 0 || coin.serialNumber == 0)
+            continue;
+
+        int id;
+        int nMintHeight = zerocoinState->GetMintedCoinHeightAndId(coin.value, coin.denomination, id);
+        if (nMintHeight < 0 || nMintHeight > nTargetHeight)
+            continue;
+
+        CZerocoinWitnessEntry entry;
+        if (walletdb.ReadZerocoinWitness(coin.value, entry) && entry.nHeight >= nTargetHeight)
+            continue;
+
+        // Builds the witness on first confirmation (when it only spans a few blocks) and advances it afterwards
+        GetZerocoinWitness(coin, id, nTargetHeight);
+    }
+}
+
+void CWallet::InvalidateZerocoinWitnesses(int nHeight)
+{
+    CWalletDB walletdb(*dbw);
+
+    list <CZerocoinWitnessEntry> listWitness;
+    walletdb.ListZerocoinWitness(listWitness);
+    BOOST_FOREACH(const CZerocoinWitnessEntry &entry, listWitness) {
+        // Coins can't be taken out of an accumulator, witnesses past the fork point are rebuilt on the next use
+        if (entry.nHeight >= nHeight)
+            walletdb.EraseZerocoinWitness(entry.pubCoin);
+    }
+}
+
 bool CWallet::CommitZerocoinSpendTransaction(CWalletTx &wtxNew, CReserveKey &reservekey) {
     {
         LOCK2(cs_main, cs_wallet);
@@ -5436,26 +6277,12 @@ string CWallet::SpendZerocoin(std::string &toKey, int64_t nValue, libzerocoin::C
     if (!CommitZerocoinSpendTransaction(wtxNew, reservekey)) {
         LogPrintf("CommitZerocoinSpendTransaction() -> FAILED!\n");
         CZerocoinEntry pubCoinTx;
-        list <CZerocoinEntry> listPubCoin;
-        listPubCoin.clear();
-
-        CWalletDB walletdb(*dbw);
-        walletdb.ListPubCoin(listPubCoin);
-        BOOST_FOREACH(const CZerocoinEntry &pubCoinItem, listPubCoin) {
-            if (zcSelectedValue == pubCoinItem.value) {
-                pubCoinTx.id = pubCoinItem.id;
-                pubCoinTx.IsUsed = false; // having error, so set to false, to be able to use again
-                pubCoinTx.value = pubCoinItem.value;
-                pubCoinTx.nHeight = pubCoinItem.nHeight;
-                pubCoinTx.randomness = pubCoinItem.randomness;
-                pubCoinTx.serialNumber = pubCoinItem.serialNumber;
-                pubCoinTx.denomination = pubCoinItem.denomination;
-                pubCoinTx.ecdsaSecretKey = pubCoinItem.ecdsaSecretKey;
-                CWalletDB(*dbw).WriteZerocoinEntry(pubCoinTx);
-                LogPrintf("SpendZerocoin failed, re-updated status -> NotifyZerocoinChanged\n");
-                LogPrintf("pubcoin=%s, isUsed=New\n", pubCoinItem.value.GetHex());
-                NotifyZerocoinChanged(this, pubCoinItem.value.GetHex(), pubCoinItem.denomination, "New", CT_UPDATED);
-            }
+        if (GetZerocoinEntry(zcSelectedValue, pubCoinTx)) {
+            pubCoinTx.IsUsed = false; // having error, so set to false, to be able to use again
+            WriteZerocoinEntry(pubCoinTx);
+            LogPrintf("SpendZerocoin failed, re-updated status -> NotifyZerocoinChanged\n");
+            LogPrintf("pubcoin=%s, isUsed=New\n", pubCoinTx.value.GetHex());
+            NotifyZerocoinChanged(this, pubCoinTx.value.GetHex(), pubCoinTx.denomination, "New", CT_UPDATED);
         }
         CZerocoinSpendEntry entry;
         entry.coinSerial = coinSerial;
@@ -5474,15 +6301,12 @@ void CWallet::ListAvailableCoinsMintCoins(vector <COutput> &vCoins, bool fOnlyCo
     vCoins.clear();
     {
         LOCK(cs_wallet);
-        list <CZerocoinEntry> listPubCoin = list<CZerocoinEntry>();
-        CWalletDB walletdb(*dbw);
-        walletdb.ListPubCoin(listPubCoin);
-        LogPrintf("listPubCoin.size()=%s\n", listPubCoin.size());
+        LogPrintf("mapZerocoinEntries.size()=%s\n", mapZerocoinEntries.size());
         for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
             const CWalletTx *pcoin = &(*it).second;
 //            LogPrintf("pcoin=%s\n", pcoin->GetHash().ToString());
-            if (!CheckFinalTx(*pcoin->tx,0)) {
-                LogPrintf("!CheckFinalTx(*pcoin)=%s\n", !CheckFinalTx(*pcoin->tx,0));
+            if (!IsFinalForNextBlock(*pcoin->tx)) {
+                LogPrintf("!IsFinalForNextBlock(*pcoin)=%s\n", !IsFinalForNextBlock(*pcoin->tx));
                 continue;
             }
 
@@ -5514,13 +6338,10 @@ void CWallet::ListAvailableCoinsMintCoins(vector <COutput> &vCoins, bool fOnlyCo
                     pubCoin.setvch(vchZeroMint);
                     LogPrintf("Pubcoin=%s\n", pubCoin.ToString());
                     // CHECKING PROCESS
-                    BOOST_FOREACH(const CZerocoinEntry &pubCoinItem, listPubCoin) {
-//                        LogPrintf("*******\n");
-//                        LogPrintf("pubCoinItem.value=%s,\n", pubCoinItem.value.ToString());
-//                        LogPrintf("pubCoinItem.IsUsed=%s\n, ", pubCoinItem.IsUsed);
-//                        LogPrintf("pubCoinItem.randomness=%s\n, ", pubCoinItem.randomness);
-//                        LogPrintf("pubCoinItem.serialNumber=%s\n, ", pubCoinItem.serialNumber);
-                        if (pubCoinItem.value == pubCoin && pubCoinItem.IsUsed == false &&
+                    map<CBigNum, CZerocoinEntry>::const_iterator itEntry = mapZerocoinEntries.find(pubCoin);
+                    if (itEntry != mapZerocoinEntries.end()) {
+                        const CZerocoinEntry &pubCoinItem = itEntry->second;
+                        if (pubCoinItem.IsUsed == false &&
                             pubCoinItem.randomness != 0 && pubCoinItem.serialNumber != 0) {
                             vCoins.push_back(COutput(pcoin, i, nDepth, true, true, true));
                             LogPrintf("-->OK\n");
@@ -5624,6 +6445,7 @@ int CWallet::NewStealthKeyFromAccount(
 
     CKeyID idKey = aks.GetID();
     sea->mapStealthKeys[idKey] = aks;
+    fStealthKeysChanged = true;
 
     if (!pwdb->ReadExtStealthKeyPack(idAccount, sea->nPackStealth, aksPak))
     {
@@ -5891,6 +6713,7 @@ int CWallet::SaveStealthAddress(CWalletDB *pwdb, CExtKeyAccount *sea, const CEKA
         return errorN(1, "Unknown spend chain.");
 
     sea->mapStealthKeys[idKey] = akStealth;
+    fStealthKeysChanged = true;
 
     if (!pwdb->ReadExtStealthKeyPack(idAccount, sea->nPackStealth, aksPak))
     {
@@ -7480,6 +8303,8 @@ int CWallet::ExtKeyLoadAccountKeys(CWalletDB *pwdb, CExtKeyAccount *sea)
         CStoredExtKey *sek = new CStoredExtKey();
         if (pwdb->ReadExtKey(id, *sek))
         {
+            if (pwdb->ReadExtKeyLookAhead(id, *sek) && !sek->VerifyLookAheadCache())
+                LogPrintf("WARNING: Look ahead cache of key %d of account %s doesn't match, dropped\n", i, sea->GetIDString58());
             sea->vExtKeys[i] = sek;
         } else
         {
@@ -7598,6 +8423,7 @@ int CWallet::ExtKeySaveAccountToDB(CWalletDB *pwdb, const CKeyID &idAccount, CEx
     AssertLockHeld(cs_wallet);
     assert(sea);
 
+    CWalletDBTxn txn(*pwdb);
     for (size_t i = 0; i < sea->vExtKeys.size(); ++i)
     {
         CStoredExtKey *sek = sea->vExtKeys[i];
@@ -7607,6 +8433,8 @@ int CWallet::ExtKeySaveAccountToDB(CWalletDB *pwdb, const CKeyID &idAccount, CEx
 
     if (!pwdb->WriteExtAccount(idAccount, *sea))
         return errorN(1, "ExtKeySaveAccountToDB() WriteExtAccount failed.");
+    if (!txn.Commit())
+        return errorN(1, "ExtKeySaveAccountToDB() TxnCommit failed.");
 
     return 0;
 };
@@ -7644,6 +8472,7 @@ int CWallet::ExtKeyAddAccountToMaps(const CKeyID &idAccount, CExtKeyAccount *sea
     };
 
     mapExtAccounts[idAccount] = sea;
+    fStealthKeysChanged = true;
     return 0;
 };
 
@@ -7659,6 +8488,7 @@ int CWallet::ExtKeyRemoveAccountFromMapsAndFree(CExtKeyAccount *sea)
         mapExtKeys.erase(sea->vExtKeyIDs[i]);
 
     mapExtAccounts.erase(idAccount);
+    fStealthKeysChanged = true;
     sea->FreeChains();
     delete sea;
     return 0;
@@ -7767,6 +8597,7 @@ int CWallet::ExtKeyLoadAccountPacks()
         {
             nStealthKeys++;
             sea->mapStealthKeys[it->id] = it->aks;
+            fStealthKeysChanged = true;
         };
     };
 
@@ -7841,6 +8672,25 @@ int CWallet::PrepareLookahead()
         };
     };
 
+    // Save the ids derived, the next load finds them instead of deriving them again
+    CWalletDB wdb(*dbw);
+    for (it = mapExtAccounts.begin(); it != mapExtAccounts.end(); ++it)
+        ExtKeyWriteLookAheadCaches(&wdb, it->second);
+
+    return 0;
+};
+
+int CWallet::ExtKeyWriteLookAheadCaches(CWalletDB *pwdb, CExtKeyAccount *sea) const
+{
+    for (size_t i = 0; i < sea->vExtKeys.size(); ++i)
+    {
+        CStoredExtKey *sek = sea->vExtKeys[i];
+        if (!sek || !sek->fCacheChanged)
+            continue;
+        if (!pwdb->WriteExtKeyLookAhead(sea->vExtKeyIDs[i], *sek))
+            return errorN(1, "%s WriteExtKeyLookAhead failed.", __func__);
+        sek->fCacheChanged = false;
+    };
     return 0;
 };
 
@@ -7996,6 +8846,12 @@ int CWallet::ExtKeySaveKey(CWalletDB *pwdb, CExtKeyAccount *sea, const CKeyID &k
     CKeyID idChain = sea->vExtKeyIDs[nChain];
     if (!pwdb->WriteExtKey(idChain, *pc))
         return errorN(1, "%s WriteExtKey failed.", __func__);
+    if (pc->fCacheChanged)
+    {
+        if (!pwdb->WriteExtKeyLookAhead(idChain, *pc))
+            return errorN(1, "%s WriteExtKeyLookAhead failed.", __func__);
+        pc->fCacheChanged = false;
+    };
 
     if (fUpdateAcc) // only neccessary if nPack has changed
     {
@@ -8354,8 +9210,6 @@ bool CWallet::ImportStealthAddress(const CStealthAddress &sxAddr, const CKey &sk
     return true;
 };
 
-static const char * CoinDenominationStrings[] = { "0", "1", "5", "10", "50", "100", "500", "1000", "5000" };
-
 //unlock wallet and create ghost timer
 bool CWallet::EnableGhostMode(SecureString strWalletPass, string totalAmount){
 
@@ -8416,7 +9270,7 @@ void CWallet::NotifyGhostChanged(CWallet *wallet, const std::string &pubCoin, in
 bool CWallet::SpendAllZerocoins(){
 
     std::list<CZerocoinEntry> pc;
-    CWalletDB(*dbw).ListPubCoin(pc);
+    ListZerocoinEntries(pc);
     CZerocoinState *zerocoinState = CZerocoinState::GetZerocoinState();
     int coinHeight;
 
@@ -8447,16 +9301,22 @@ bool CWallet::GhostModeMintTrigger(string totalAmount){
         return error("%s: Error: Amount out of range.", __func__);
 
     //TODO: Create timer function to mint and recognize freshly finished mints to spend
+    std::vector<libzerocoin::CoinDenomination> denominations;
     denomination = libzerocoin::AmountToClosestDenomination(amount, nRemaining);
     while(denomination != libzerocoin::ZQ_ERROR){
-        if (this->IsLocked())
-            return error("%s: Error: The wallet needs to be unlocked.", __func__);
-        if(!CreateZerocoinMintModel(stringError, CoinDenominationStrings[denomination]))
-            return error("%s: Error: Failed to create zerocoin mint model - %s.", __func__, stringError);
+        denominations.push_back(denomination);
         amount = nRemaining;
         denomination = libzerocoin::AmountToClosestDenomination(amount, nRemaining);
 
     }
+    if (denominations.empty())
+        return true;
+
+    // generate all of the coins at once, their prime searches run in parallel
+    if (this->IsLocked())
+        return error("%s: Error: The wallet needs to be unlocked.", __func__);
+    if(!CreateZerocoinMintModels(stringError, denominations))
+        return error("%s: Error: Failed to create zerocoin mint model - %s.", __func__, stringError);
 
     return true;
 }
@@ -8503,7 +9363,7 @@ CAmount CWallet::GetAnonymizedBalance() const {
 
     CAmount nTotal = 0;
     {
-        LOCK2(cs_main, cs_wallet);
+        LOCK(cs_wallet);
         for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
             const CWalletTx *pcoin = &(*it).second;
 
@@ -8572,7 +9432,7 @@ CAmount CWallet::GetDenominatedBalance(bool unconfirmed) const {
 
     CAmount nTotal = 0;
     {
-        LOCK2(cs_main, cs_wallet);
+        LOCK(cs_wallet);
         for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
             const CWalletTx *pcoin = &(*it).second;
 
@@ -8639,7 +9499,7 @@ int CWallet::GetRealInputPrivateSendRounds(CTxIn txin, int nRounds) const
         // this one is denominated but there is another non-denominated output found in the same tx
         if (!fAllDenoms) {
             mDenomWtxes[hash].vout[nout].nRounds = 0;
-            LogPrintf("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
+            LogPrint(BCLog::GHOSTNODE, "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
             return mDenomWtxes[hash].vout[nout].nRounds;
         }
 
@@ -8659,7 +9519,7 @@ int CWallet::GetRealInputPrivateSendRounds(CTxIn txin, int nRounds) const
         mDenomWtxes[hash].vout[nout].nRounds = fDenomFound
                                                ? (nShortest >= 15 ? 16 : nShortest + 1) // good, we a +1 to the shortest one but only 16 rounds max allowed
                                                : 0;            // too bad, we are the fist one in that chain
-        LogPrintf("privatesend", "GetRealInputPrivateSendRounds UPDATED %s \n", hash.ToString());
+        LogPrint(BCLog::GHOSTNODE, "GetRealInputPrivateSendRounds UPDATED %s \n", hash.ToString());
         return mDenomWtxes[hash].vout[nout].nRounds;
     }
 
@@ -8699,25 +9559,18 @@ bool CWallet::IsDenominatedAmount(CAmount nInputAmount) const {
 int CWallet::CountInputsWithAmount(CAmount nInputAmount) {
     CAmount nTotal = 0;
     {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx *pcoin = &(*it).second;
-            if (pcoin->IsTrusted()) {
-                int nDepth = pcoin->GetDepthInMainChain(false);
-
-                for (unsigned int i = 0; i < pcoin->tx->vout.size(); i++) {
-                    COutput out = COutput(pcoin, i, nDepth, true, true, true);
-                    CTxIn txin = CTxIn(out.tx->GetHash(), out.i);
+        LOCK(cs_wallet);
+        std::map<CAmount, std::set<COutPoint> >::const_iterator itAmount = mapDenominatedOutpoints.find(nInputAmount);
+        if (itAmount == mapDenominatedOutpoints.end()) return 0;
 
-                    if (out.tx->tx->vout[out.i].nValue != nInputAmount) continue;
-                    if (!IsDenominatedAmount(pcoin->tx->vout[i].nValue)) continue;
-                    if (IsSpent(out.tx->GetHash(), i) || IsMine(pcoin->tx->vout[i]) != ISMINE_SPENDABLE ||
-                        !IsDenominated(txin))
-                        continue;
+        BOOST_FOREACH(const COutPoint& outpoint, itAmount->second) {
+            map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+            if (it == mapWallet.end()) continue;
+            const CWalletTx *pcoin = &(*it).second;
+            if (!pcoin->IsTrusted()) continue;
+            if (IsSpent(outpoint.hash, outpoint.n) || IsMine(pcoin->tx->vout[outpoint.n]) != ISMINE_SPENDABLE) continue;
 
-                    nTotal++;
-                }
-            }
+            nTotal++;
         }
     }
 
@@ -8871,6 +9724,48 @@ bool CWallet::ConvertList(std::vector <CTxIn> vecTxIn, std::vector <CAmount> &ve
     return true;
 }
 
+void CWallet::AvailableDenominatedCoins(std::vector<COutput>& vCoins, const std::set<CAmount>& setAmounts)
+{
+    vCoins.clear();
+
+    LOCK(cs_wallet);
+
+    BOOST_FOREACH(CAmount nAmount, setAmounts) {
+        std::map<CAmount, std::set<COutPoint> >::iterator itAmount = mapDenominatedOutpoints.find(nAmount);
+        if (itAmount == mapDenominatedOutpoints.end()) continue;
+
+        std::set<COutPoint>::iterator itOutpoint = itAmount->second.begin();
+        while (itOutpoint != itAmount->second.end()) {
+            const COutPoint& outpoint = *itOutpoint;
+            map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+            if (it == mapWallet.end()) {
+                itAmount->second.erase(itOutpoint++);
+                continue;
+            }
+            ++itOutpoint;
+
+            // same checks as AvailableCoins with fOnlySafe
+            const CWalletTx* pcoin = &(*it).second;
+            if (!IsFinalForNextBlock(*pcoin->tx)) continue;
+            if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0) continue;
+
+            int nDepth = pcoin->GetDepthInMainChain(false);
+            if (nDepth == 0 && !pcoin->InMempool()) continue;
+            if (!pcoin->IsTrusted()) continue;
+            if (nDepth == 0 && (pcoin->mapValue.count("replaces_txid") || pcoin->mapValue.count("replaced_by_txid"))) continue;
+
+            if (IsLockedCoin(outpoint.hash, outpoint.n) || IsSpent(outpoint.hash, outpoint.n)) continue;
+
+            isminetype mine = IsMine(pcoin->tx->vout[outpoint.n]);
+            if (mine == ISMINE_NO) continue;
+
+            bool fSpendableIn = (mine & ISMINE_SPENDABLE) != ISMINE_NO;
+            bool fSolvableIn = (mine & (ISMINE_SPENDABLE | ISMINE_WATCH_SOLVABLE)) != ISMINE_NO;
+            vCoins.push_back(COutput(pcoin, outpoint.n, nDepth, fSpendableIn, fSolvableIn, true));
+        }
+    }
+}
+
 bool CWallet::SelectCoinsByDenominations(int nDenom, CAmount nValueMin, CAmount nValueMax,
                                          std::vector <CTxIn> &vecTxInRet, std::vector <COutput> &vCoinsRet,
                                          CAmount &nValueRet, int nPrivateSendRoundsMin, int nPrivateSendRoundsMax) {
@@ -8878,15 +9773,20 @@ bool CWallet::SelectCoinsByDenominations(int nDenom, CAmount nValueMin, CAmount
     vCoinsRet.clear();
     nValueRet = 0;
 
-    vector <COutput> vCoins;
-    AvailableCoins(vCoins, true, NULL, false, MAX_MONEY, MAX_MONEY,0, 0, 9999999, ONLY_DENOMINATED);
-    std::random_shuffle(vCoins.rbegin(), vCoins.rend(), GetRandInt);
-
     std::vector<int> vecBits;
     if (!darkSendPool.GetDenominationsBits(nDenom, vecBits)) {
         return false;
     }
 
+    std::set<CAmount> setAmounts;
+    BOOST_FOREACH(int nBit, vecBits) {
+        setAmounts.insert(vecPrivateSendDenominations[nBit]);
+    }
+
+    vector <COutput> vCoins;
+    AvailableDenominatedCoins(vCoins, setAmounts);
+    std::random_shuffle(vCoins.rbegin(), vCoins.rend(), GetRandInt);
+
     int nDenomResult = 0;
 
     InsecureRand insecureRand;
@@ -8957,9 +9857,16 @@ bool CWallet::CreateCollateralTransaction(CMutableTransaction &txCollateral, std
     return true;
 }
 
+void CWallet::InvalidateTallyCache() const
+{
+    fAnonymizableTallyCached = false;
+    fAnonymizableTallyCachedNonDenom = false;
+    fAnonymizableTallyHasImmature = false;
+}
+
 bool CWallet::SelectCoinsGrouppedByAddresses(std::vector <CompactTallyItem> &vecTallyRet, bool fSkipDenominated,
                                              bool fAnonymizable) const {
-    LOCK2(cs_main, cs_wallet);
+    LOCK(cs_wallet);
 
     isminefilter filter = ISMINE_SPENDABLE;
 
@@ -8977,48 +9884,67 @@ bool CWallet::SelectCoinsGrouppedByAddresses(std::vector <CompactTallyItem> &vec
         }
     }
 
-    // Tally
-    map <CBitcoinAddress, CompactTallyItem> mapTally;
-    for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-        const CWalletTx &wtx = (*it).second;
-
-        if (wtx.IsCoinBase() && wtx.GetBlocksToMaturity() > 0) continue;
-        if (!fAnonymizable && !wtx.IsTrusted()) continue;
-
-        for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
-            CTxDestination address;
-            if (!ExtractDestination(wtx.tx->vout[i].scriptPubKey, address)) continue;
-
-            isminefilter mine = ::IsMine(*this, address);
-            if (!(mine & filter)) continue;
+    // Tally, one address at a time from the address index
+    vecTallyRet.clear();
+    bool fHasImmature = false;
+    std::map<CBitcoinAddress, CAddressOutpoints>::iterator itAddress = mapAddressOutpoints.begin();
+    while (itAddress != mapAddressOutpoints.end()) {
+        CTxDestination address = itAddress->first.Get();
+        isminefilter mine = ::IsMine(*this, address);
+
+        CompactTallyItem item;
+        item.address = itAddress->first;
+
+        std::set<COutPoint>* vsetOutpoints[2] = {&itAddress->second.setNonDenominated, &itAddress->second.setDenominated};
+        for (int nSet = 0; nSet < (fSkipDenominated ? 1 : 2); nSet++) {
+            std::set<COutPoint>& setOutpoints = *vsetOutpoints[nSet];
+            std::set<COutPoint>::iterator itOutpoint = setOutpoints.begin();
+            while (itOutpoint != setOutpoints.end()) {
+                const COutPoint outpoint = *itOutpoint;
+                map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+                if (it == mapWallet.end() || IsSpentDeeply(outpoint)) {
+                    setOutpoints.erase(itOutpoint++);
+                    continue;
+                }
+                ++itOutpoint;
 
-            if (IsSpent(wtx.GetHash(), i) || IsLockedCoin(wtx.GetHash(), i)) continue;
+                if (!(mine & filter)) continue;
 
-            if (fSkipDenominated && IsDenominatedAmount(wtx.tx->vout[i].nValue)) continue;
+                const CWalletTx &wtx = (*it).second;
+                if (wtx.IsCoinBase() && wtx.GetBlocksToMaturity() > 0) {
+                    fHasImmature = true;
+                    continue;
+                }
+                if (!fAnonymizable && !wtx.IsTrusted()) continue;
+
+                if (IsSpent(outpoint.hash, outpoint.n) || IsLockedCoin(outpoint.hash, outpoint.n)) continue;
+
+                const CAmount nValue = wtx.tx->vout[outpoint.n].nValue;
+                if (fAnonymizable) {
+                    // ignore collaterals
+                    if (IsCollateralAmount(nValue)) continue;
+                    if (fGhostNode && nValue == GHOSTNODE_COIN_REQUIRED * COIN) continue;
+                    // ignore outputs that are 10 times smaller then the smallest denomination
+                    // otherwise they will just lead to higher fee / lower priority
+                    if (nValue <= vecPrivateSendDenominations.back() / 10) continue;
+                    // ignore anonymized
+                    if(GetInputPrivateSendRounds(CTxIn(outpoint)) >= nPrivateSendRounds) continue;
+                }
 
-            if (fAnonymizable) {
-                // ignore collaterals
-                if (IsCollateralAmount(wtx.tx->vout[i].nValue)) continue;
-                if (fGhostNode && wtx.tx->vout[i].nValue == GHOSTNODE_COIN_REQUIRED * COIN) continue;
-                // ignore outputs that are 10 times smaller then the smallest denomination
-                // otherwise they will just lead to higher fee / lower priority
-                if (wtx.tx->vout[i].nValue <= vecPrivateSendDenominations.back() / 10) continue;
-                // ignore anonymized
-                if(GetInputPrivateSendRounds(CTxIn(wtx.GetHash(), i)) >= nPrivateSendRounds) continue;
+                item.nAmount += nValue;
+                item.vecTxIn.push_back(CTxIn(outpoint));
             }
+        }
 
-            CompactTallyItem &item = mapTally[address];
-            item.address = address;
-            item.nAmount += wtx.tx->vout[i].nValue;
-            item.vecTxIn.push_back(CTxIn(wtx.GetHash(), i));
+        if (itAddress->second.setDenominated.empty() && itAddress->second.setNonDenominated.empty()) {
+            mapAddressOutpoints.erase(itAddress++);
+        } else {
+            ++itAddress;
         }
-    }
 
-    // construct resulting vector
-    vecTallyRet.clear();
-    BOOST_FOREACH(const PAIRTYPE(CBitcoinAddress, CompactTallyItem)&item, mapTally) {
-        if (fAnonymizable && item.second.nAmount < vecPrivateSendDenominations.back()) continue;
-        vecTallyRet.push_back(item.second);
+        if (item.vecTxIn.empty()) continue;
+        if (fAnonymizable && item.nAmount < vecPrivateSendDenominations.back()) continue;
+        vecTallyRet.push_back(item);
     }
 
     // order by amounts per address, from smallest to largest
@@ -9026,6 +9952,7 @@ bool CWallet::SelectCoinsGrouppedByAddresses(std::vector <CompactTallyItem> &vec
 
     // cache anonymizable for later use
     if (fAnonymizable) {
+        if (fHasImmature) fAnonymizableTallyHasImmature = true;
         if (fSkipDenominated) {
             vecAnonymizableTallyCachedNonDenom = vecTallyRet;
             fAnonymizableTallyCachedNonDenom = true;
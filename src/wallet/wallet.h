@@ -18,6 +18,8 @@
 #include <wallet/crypter.h>
 #include <wallet/walletdb.h>
 #include <wallet/rpcwallet.h>
+#include <wallet/stealthscan.h>
+#include <wallet/zerocoinspend.h>
 
 #include <algorithm>
 #include <atomic>
@@ -49,6 +51,10 @@ extern bool bSpendZeroConfChange;
 extern bool fWalletRbf;
 
 static const unsigned int DEFAULT_KEYPOOL_SIZE = 1000;
+//! Keys a keypool top-up derives at once, a top-up of more keys reports its progress
+static const unsigned int KEYPOOL_TOPUP_BATCH_SIZE = 1000;
+//! HD keys derived per thread, fewer keys are derived on the calling thread
+static const size_t KEYPOOL_DERIVE_KEYS_PER_THREAD = 100;
 //! -paytxfee default
 static const CAmount DEFAULT_TRANSACTION_FEE = 0;
 //! -fallbackfee default
@@ -73,6 +79,8 @@ static const unsigned int DEFAULT_TX_CONFIRM_TARGET = 6;
 static const bool DEFAULT_WALLET_RBF = false;
 static const bool DEFAULT_WALLETBROADCAST = true;
 static const bool DEFAULT_DISABLE_WALLET = false;
+//! -indexedrescan default
+static const bool DEFAULT_INDEXED_RESCAN = false;
 
 extern const char * DEFAULT_WALLET_DAT;
 
@@ -87,6 +95,7 @@ class CScheduler;
 class CTxMemPool;
 class CBlockPolicyEstimator;
 class CWalletTx;
+struct CoinSelectionParams;
 struct FeeCalculation;
 enum class FeeEstimateMode;
 
@@ -123,6 +132,30 @@ struct CompactTallyItem
     }
 };
 
+/** Kinds of amount of wallet outputs, so AvailableCoins only looks at the transactions with the kind asked for */
+enum UnspentOutputClass
+{
+    UNSPENT_OTHER       = (1 << 0), //!< Neither a denomination nor a collateral amount
+    UNSPENT_DENOMINATED = (1 << 1),
+    UNSPENT_COLLATERAL  = (1 << 2),
+    UNSPENT_GHOSTNODE   = (1 << 3), //!< Ghostnode collateral
+    UNSPENT_ALL         = UNSPENT_OTHER | UNSPENT_DENOMINATED | UNSPENT_COLLATERAL | UNSPENT_GHOSTNODE,
+};
+
+/** Outputs of a wallet transaction that may be available, see CWallet::mapUnspentOutputs */
+struct CUnspentOutputs
+{
+    std::set<unsigned int> setOutputs;
+    int nClasses = 0; //!< UnspentOutputClass of the outputs
+};
+
+/** Wallet outputs paying to one destination, see CWallet::mapAddressOutpoints */
+struct CAddressOutpoints
+{
+    std::set<COutPoint> setDenominated;
+    std::set<COutPoint> setNonDenominated;
+};
+
 enum OutputRecordFlags
 {
     ORF_OWNED               = (1 << 0),
@@ -449,6 +482,49 @@ public:
     }
 };
 
+/**
+ * Accumulator witness of an unspent mint, kept up to date as blocks are connected so spends
+ * don't have to re-accumulate every coin minted into the group since the mint.
+ */
+class CZerocoinWitnessEntry
+{
+public:
+    Bignum pubCoin;
+    int denomination;
+    int id;
+    // Accumulated value of every coin of the group up to nHeight, except pubCoin itself
+    Bignum witnessValue;
+    int nHeight;
+    // Hash of the block at nHeight, the witness is only valid while it's in the active chain
+    uint256 blockHash;
+
+    CZerocoinWitnessEntry()
+    {
+        SetNull();
+    }
+
+    void SetNull()
+    {
+        pubCoin = 0;
+        denomination = 0;
+        id = 0;
+        witnessValue = 0;
+        nHeight = -1;
+        blockHash.SetNull();
+    }
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(pubCoin);
+        READWRITE(denomination);
+        READWRITE(id);
+        READWRITE(witnessValue);
+        READWRITE(nHeight);
+        READWRITE(blockHash);
+    }
+};
+
 bool CompHeight(const CZerocoinEntry & a, const CZerocoinEntry & b);
 bool CompID(const CZerocoinEntry & a, const CZerocoinEntry & b);
 
@@ -571,20 +647,6 @@ public:
 
     void SetMerkleBranch(const CBlockIndex* pIndex, int posInBlock);
 
-    /**
-     * Return depth of transaction in blockchain:
-     * <0  : conflicts with a transaction this deep in the blockchain
-     *  0  : in memory pool, waiting to be included in a block
-     * >=1 : this many blocks deep in the main chain
-     */
-    int GetDepthInMainChain(const CBlockIndex* &pindexRet) const;
-    int GetDepthInMainChain() const { const CBlockIndex *pindexRet; return GetDepthInMainChain(pindexRet); }
-
-    int GetDepthInMainChain(const CBlockIndex* &pindexRet, bool enableIX) const;
-    int GetDepthInMainChain(bool enableIX) const { const CBlockIndex *pindexRet; return GetDepthInMainChain(pindexRet, enableIX); }
-
-    bool IsInMainChain() const { const CBlockIndex *pindexRet; return GetDepthInMainChain(pindexRet) > 0; }
-    int GetBlocksToMaturity() const;
     bool hashUnset() const { return (hashBlock.IsNull() || hashBlock == ABANDON_HASH); }
     bool isAbandoned() const { return (hashBlock == ABANDON_HASH); }
     void setAbandoned() { hashBlock = ABANDON_HASH; }
@@ -597,6 +659,39 @@ public:
  * A transaction with a bunch of additional info that only the owner cares about.
  * It includes any unrecorded transactions needed to link it back to the block chain.
  */
+/** Balance totals by category, of the wallet or of one of its transactions */
+struct CWalletBalances
+{
+    CAmount nTrusted = 0;           //!< Available credit of trusted transactions
+    CAmount nUntrusted = 0;         //!< Available credit of untrusted transactions in the mempool
+    CAmount nImmature = 0;          //!< Credit of coinbase transactions not mature yet
+    CAmount nWatchTrusted = 0;
+    CAmount nWatchUntrusted = 0;
+    CAmount nWatchImmature = 0;
+
+    CWalletBalances& operator+=(const CWalletBalances& b)
+    {
+        nTrusted += b.nTrusted;
+        nUntrusted += b.nUntrusted;
+        nImmature += b.nImmature;
+        nWatchTrusted += b.nWatchTrusted;
+        nWatchUntrusted += b.nWatchUntrusted;
+        nWatchImmature += b.nWatchImmature;
+        return *this;
+    }
+
+    CWalletBalances& operator-=(const CWalletBalances& b)
+    {
+        nTrusted -= b.nTrusted;
+        nUntrusted -= b.nUntrusted;
+        nImmature -= b.nImmature;
+        nWatchTrusted -= b.nWatchTrusted;
+        nWatchUntrusted -= b.nWatchUntrusted;
+        nWatchImmature -= b.nWatchImmature;
+        return *this;
+    }
+};
+
 class CWalletTx : public CMerkleTx
 {
 private:
@@ -671,6 +766,10 @@ public:
     mutable CAmount nImmatureWatchCreditCached;
     mutable CAmount nAvailableWatchCreditCached;
     mutable CAmount nChangeCached;
+    //! Balances of the transaction counted in the totals of the wallet, see CWallet::UpdateBalances
+    mutable bool fBalanceCounted;
+    mutable int nBalanceDepthClass;
+    mutable CWalletBalances balanceCounted;
 
     CWalletTx()
     {
@@ -711,6 +810,9 @@ public:
         nAvailableWatchCreditCached = 0;
         nImmatureWatchCreditCached = 0;
         nChangeCached = 0;
+        fBalanceCounted = false;
+        nBalanceDepthClass = 0;
+        balanceCounted = CWalletBalances();
         nOrderPos = -1;
     }
 
@@ -758,18 +860,7 @@ public:
     }
 
     //! make sure balances are recalculated
-    void MarkDirty()
-    {
-        fCreditCached = false;
-        fAvailableCreditCached = false;
-        fImmatureCreditCached = false;
-        fWatchDebitCached = false;
-        fWatchCreditCached = false;
-        fAvailableWatchCreditCached = false;
-        fImmatureWatchCreditCached = false;
-        fDebitCached = false;
-        fChangeCached = false;
-    }
+    void MarkDirty();
 
     void BindWallet(CWallet *pwalletIn)
     {
@@ -798,6 +889,18 @@ public:
     // True if only scriptSigs are different
     bool IsEquivalentTo(const CWalletTx& tx) const;
 
+    /**
+     * Return depth of transaction in blockchain, as the wallet last saw the chain (see CWallet::GetBlockDepth):
+     * <0  : conflicts with a transaction this deep in the blockchain
+     *  0  : in memory pool, waiting to be included in a block
+     * >=1 : this many blocks deep in the main chain
+     */
+    int GetDepthInMainChain() const;
+    /** Same as GetDepthInMainChain, with an InstantSend locked transaction counted nInstantSendDepth blocks deeper if enableIX */
+    int GetDepthInMainChain(bool enableIX) const;
+    bool IsInMainChain() const { return GetDepthInMainChain() > 0; }
+    int GetBlocksToMaturity() const;
+
     bool InMempool() const;
     bool IsTrusted() const;
 
@@ -1001,6 +1104,8 @@ private:
     std::atomic<bool> fScanningWallet; //controlled by WalletRescanReserver
     std::mutex mutexScanning;
     friend class WalletRescanReserver;
+    //! Incremented whenever a key, script or watch-only script is added, see GetKeyGeneration
+    std::atomic<uint64_t> nKeyGeneration;
 
 
     /**
@@ -1008,7 +1113,7 @@ private:
      * all coins from coinControl are selected; Never select unconfirmed coins
      * if they are not ours
      */
-    bool SelectCoins(const std::vector<COutput>& vAvailableCoins, const CAmount& nTargetValue, std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet, const CCoinControl *coinControl = nullptr, AvailableCoinsType nCoinType = ALL_COINS, bool fUseInstantSend = false) const;
+    bool SelectCoins(const std::vector<COutput>& vAvailableCoins, const CAmount& nTargetValue, std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet, const CCoinControl *coinControl = nullptr, AvailableCoinsType nCoinType = ALL_COINS, bool fUseInstantSend = false, CoinSelectionParams* params = nullptr) const;
 
     CWalletDB *pwalletdbEncryption;
 
@@ -1026,6 +1131,53 @@ private:
     mutable std::vector<CompactTallyItem> vecAnonymizableTallyCached;
     mutable bool fAnonymizableTallyCachedNonDenom;
     mutable std::vector<CompactTallyItem> vecAnonymizableTallyCachedNonDenom;
+    //! set when a cached tally skipped an immature coinbase output, so new blocks must rebuild it
+    mutable bool fAnonymizableTallyHasImmature;
+
+    /**
+     * Balance totals of the wallet, kept up to date incrementally: a transaction whose balances may
+     * have changed is queued in setBalanceDirty (CWalletTx::MarkDirty does it), and UpdateBalances
+     * takes what it counted for it last out of the totals and adds what it counts now.
+     */
+    mutable CWalletBalances balances;
+    mutable std::set<uint256> setBalanceDirty;
+    //! Transactions unconfirmed, conflicted or with immature coinbase outputs, whose balances change with the chain tip
+    mutable std::set<uint256> setBalanceVolatile;
+    //! set when the totals must be counted again from all the transactions
+    mutable bool fBalancesFull;
+    mutable std::atomic<uint64_t> nBalanceChanges;
+    void UpdateBalances() const;
+    void UpdateTxBalances(const CWalletTx& wtx, bool fFull) const;
+
+    /**
+     * Outputs of wallet transactions by destination, with denominated outputs kept apart, so
+     * SelectCoinsGrouppedByAddresses does not group the whole wallet again. Outputs stay
+     * listed while spent, since abandoning or conflicting the spender makes them available
+     * again, and are dropped once the spending transaction is COINBASE_MATURITY deep.
+     */
+    mutable std::map<CBitcoinAddress, CAddressOutpoints> mapAddressOutpoints;
+    void AddToAddressOutpoints(const uint256& wtxid);
+
+    /**
+     * Outputs of wallet transactions with a PrivateSend denomination amount, by amount, so
+     * mixing does not scan the whole wallet for them. Users still check spent, locked and
+     * IsMine like AvailableCoins does, only outputs of transactions no longer in the wallet
+     * are dropped.
+     */
+    std::map<CAmount, std::set<COutPoint> > mapDenominatedOutpoints;
+    void AddToDenominatedOutpoints(const uint256& wtxid);
+
+    /**
+     * Outputs of wallet transactions that are mine, by transaction, so AvailableCoins only looks at
+     * the transactions with outputs left to spend rather than the whole history. Outputs stay listed
+     * while spent, since abandoning or conflicting the spender makes them available again, and are
+     * dropped once the spending transaction is COINBASE_MATURITY deep. Built again from mapWallet
+     * after MarkDirty, which the key imports call, since outputs may have become mine.
+     */
+    mutable std::map<uint256, CUnspentOutputs> mapUnspentOutputs;
+    mutable bool fUnspentOutputsFull;
+    void AddToUnspentOutputs(const CWalletTx& wtx) const;
+    int GetUnspentOutputClasses(CAmount nValue) const;
 
     /**
      * Used to keep track of spent outpoints, and
@@ -1052,6 +1204,12 @@ private:
     /* HD derive new child key (on internal or external chain) */
     void DeriveNewChildKey(CWalletDB &walletdb, CKeyMetadata& metadata, CKey& secret, bool internal = false);
 
+    /* The extended key new HD child keys are derived from, m/0'/0' (external) or m/0'/1' (internal) */
+    void GetHDChainKey(CExtKey& chainChildKey, bool internal);
+
+    /* HD derive the next nKeys child keys over the cores and add those the wallet doesn't have yet, returns their public keys */
+    std::vector<CPubKey> DeriveNewChildKeys(CWalletDB &walletdb, bool internal, size_t nKeys);
+
     std::set<int64_t> setInternalKeyPool;
     std::set<int64_t> setExternalKeyPool;
     int64_t m_max_keypool_index;
@@ -1084,6 +1242,16 @@ private:
      */
     const CBlockIndex* m_last_block_processed;
 
+    /**
+     * The wallet's own view of the chain, so that the depth of its transactions is known without cs_main: the height
+     * of the chain it last saw, and the heights of the blocks of that chain which hold or conflict with its
+     * transactions. Kept up to date by LoadWallet, rescans and BlockConnected/BlockDisconnected.
+     * Guarded by cs_chainview, which is taken last and never held while taking another lock
+     */
+    mutable CCriticalSection cs_chainview;
+    int nChainViewHeight;
+    std::map<uint256, int> mapChainViewHeights;
+
 public:
     /*
      * Main wallet lock.
@@ -1125,19 +1293,20 @@ public:
     unsigned int nMasterKeyMaxID;
 
     // Create wallet with dummy database handle
-    CWallet(): dbw(new CWalletDBWrapper())
+    CWallet(): dbw(new CWalletDBWrapper()), zerocoinSpendQueue(this)
     {
         SetNull();
     }
 
     // Create wallet with passed-in database handle
-    explicit CWallet(std::unique_ptr<CWalletDBWrapper> dbw_in) : dbw(std::move(dbw_in))
+    explicit CWallet(std::unique_ptr<CWalletDBWrapper> dbw_in) : dbw(std::move(dbw_in)), zerocoinSpendQueue(this)
     {
         SetNull();
     }
 
     ~CWallet()
     {
+        zerocoinSpendQueue.Stop();
         delete pwalletdbEncryption;
         pwalletdbEncryption = nullptr;
     }
@@ -1157,16 +1326,32 @@ public:
         fBroadcastTransactions = false;
         fAnonymizableTallyCached = false;
         fAnonymizableTallyCachedNonDenom = false;
+        fAnonymizableTallyHasImmature = false;
+        fBalancesFull = true;
+        nBalanceChanges = 0;
+        fUnspentOutputsFull = true;
         vecAnonymizableTallyCached.clear();
         vecAnonymizableTallyCachedNonDenom.clear();
         nRelockTime = 0;
         fAbortRescan = false;
         fScanningWallet = false;
+        nKeyGeneration = 0;
+        fStealthKeysChanged = true;
+        nChainViewHeight = -1;
     }
 
     std::map<uint256, CWalletTx> mapWallet;
     std::list<CAccountingEntry> laccentries;
 
+    /** Zerocoin mints of the wallet by pubcoin value, a copy of the "zerocoin" records kept in sync with the database */
+    std::map<CBigNum, CZerocoinEntry> mapZerocoinEntries;
+    /** Pubcoin values of mapZerocoinEntries by denomination */
+    std::map<int, std::set<CBigNum>> mapZerocoinDenominations;
+    /** Pubcoin values of mints whose spend proofs are being built, not to be picked by other spends */
+    std::set<CBigNum> setZerocoinSpendsInProgress;
+    /** Zerocoin spends queued to be built and committed in the background */
+    CZerocoinSpendQueue zerocoinSpendQueue;
+
     typedef std::pair<CWalletTx*, CAccountingEntry*> TxPair;
     typedef std::multimap<int64_t, TxPair > TxItems;
     TxItems wtxOrdered;
@@ -1177,6 +1362,11 @@ public:
     mutable MapWallet_t mapTempWallet;
     uint32_t nStealth, nFoundStealth; // for reporting, zero before use
     std::set<CStealthAddress> stealthAddresses;
+    /** Scanner for the stealth keys of all the accounts, rebuilt when fStealthKeysChanged is set */
+    CStealthScanner stealthScanner;
+    bool fStealthKeysChanged;
+    /** Transactions paying to stealth keys whose secret couldn't be derived yet because the wallet is locked */
+    std::set<uint256> setLockedStealthTxs;
 
     CStoredExtKey *pEKMaster;
     CKeyID idDefaultAccount;
@@ -1214,16 +1404,31 @@ public:
      * Shuffle and select coins until nTargetValue is reached while avoiding
      * small change; This method is stochastic for some inputs and upon
      * completion the coin set and corresponding actual target value is
-     * assembled
+     * assembled. With params, a selection needing no change output is
+     * searched for by branch and bound first
      */
-    bool SelectCoinsMinConf(const CAmount& nTargetValue, int nConfMine, int nConfTheirs, uint64_t nMaxAncestors, std::vector<COutput> vCoins, std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet) const;
+    bool SelectCoinsMinConf(const CAmount& nTargetValue, int nConfMine, int nConfTheirs, uint64_t nMaxAncestors, std::vector<COutput> vCoins, std::set<CInputCoin>& setCoinsRet, CAmount& nValueRet, CoinSelectionParams* params = nullptr) const;
 
+    /** AvailableCoins limited to outputs with one of the denomination amounts in setAmounts */
+    void AvailableDenominatedCoins(std::vector<COutput>& vCoins, const std::set<CAmount>& setAmounts);
     bool SelectCoinsByDenominations(int nDenom, CAmount nValueMin, CAmount nValueMax, std::vector<CTxIn>& vecTxInRet, std::vector<COutput>& vCoinsRet, CAmount& nValueRet, int nPrivateSendRoundsMin, int nPrivateSendRoundsMax);
     bool GetCollateralTxIn(CTxIn& txinRet, CAmount& nValueRet) const;
     bool SelectCoinsDark(CAmount nValueMin, CAmount nValueMax, std::vector<CTxIn>& vecTxInRet, CAmount& nValueRet, int nPrivateSendRoundsMin, int nPrivateSendRoundsMax) const;
     bool SelectCoinsGrouppedByAddresses(std::vector<CompactTallyItem>& vecTallyRet, bool fSkipDenominated = true, bool fAnonymizable = true) const;
+    /** Drop the cached anonymizable tallies, called whenever an output may have been added, spent or (un)locked */
+    void InvalidateTallyCache() const;
 
     bool IsSpent(const uint256& hash, unsigned int n) const;
+    bool IsSpentDeeply(const COutPoint& outpoint) const;
+
+    /** Record pindex, a block of the active chain holding or conflicting with a wallet transaction, in the wallet's view of the chain */
+    void AddChainViewBlock(const CBlockIndex* pindex);
+    /** Depth of the block hashBlock in the chain the wallet last saw, 0 if it isn't part of it. Doesn't need cs_main */
+    int GetBlockDepth(const uint256& hashBlock) const;
+    /** Height of the chain the wallet last saw, -1 before it saw any */
+    int GetLastBlockHeight() const;
+    /** CheckFinalTx against the chain the wallet last saw, without cs_main */
+    bool IsFinalForNextBlock(const CTransaction& tx) const;
 
     bool IsLockedCoin(uint256 hash, unsigned int n) const;
     void LockCoin(const COutPoint& output);
@@ -1243,6 +1448,9 @@ public:
      * Rescan abort properties
      */
     void AbortRescan() { fAbortRescan = true; }
+    /** Changes whenever IsMine could start matching more outputs, for the rescan read ahead to tell
+      * whether what it matched is still current */
+    uint64_t GetKeyGeneration() const { return nKeyGeneration; }
     bool IsAbortingRescan() { return fAbortRescan; }
     bool IsScanning() { return fScanningWallet; }
 
@@ -1312,17 +1520,39 @@ public:
     void MarkDirty();
     bool AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose=true);
     bool LoadToWallet(const CWalletTx& wtxIn);
+    void LoadZerocoinEntry(const CZerocoinEntry& zerocoin);
+    /** Store a zerocoin mint in the wallet database and in mapZerocoinEntries */
+    bool WriteZerocoinEntry(const CZerocoinEntry& zerocoin);
+    /** Write the entries in one database transaction */
+    bool WriteZerocoinEntries(const std::vector<CZerocoinEntry>& vZerocoin);
+    bool EraseZerocoinEntry(const CZerocoinEntry& zerocoin);
+    /** Zerocoin mints of the wallet, all of them or only those of the given denomination */
+    void ListZerocoinEntries(std::list<CZerocoinEntry>& listPubCoin) const;
+    void ListZerocoinEntries(int denomination, std::list<CZerocoinEntry>& listPubCoin) const;
+    bool GetZerocoinEntry(const CBigNum& pubCoin, CZerocoinEntry& zerocoin) const;
     void TransactionAddedToMempool(const CTransactionRef& tx) override;
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex *pindex, const std::vector<CTransactionRef>& vtxConflicted) override;
     void BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) override;
     bool AddToWalletIfInvolvingMe(const CTransactionRef& tx, const CBlockIndex* pIndex, int posInBlock, bool fUpdate);
     int64_t RescanFromTime(int64_t startTime, const WalletRescanReserver& reserver, bool update);
     CBlockIndex* ScanForWalletTransactions(CBlockIndex* pindexStart, CBlockIndex* pindexStop, const WalletRescanReserver& reserver, bool fUpdate = false);
+    /** Whether tx is in the wallet, spends a wallet output or conflicts with a wallet transaction. Requires cs_wallet */
+    bool IsSpendingFromWallet(const CTransaction& tx) const;
+    /** Heights from nStart of the blocks the address index has the keys and scripts of the wallet in.
+      * nEnd is lowered to the last block the index covers. Returns false if the index isn't available
+      * or can't find all the transactions of the wallet */
+    bool GetIndexedRescanHeights(int nStart, int& nEnd, std::set<int>& setHeights) const;
     void TransactionRemovedFromMempool(const CTransactionRef &ptx) override;
     void ReacceptWalletTransactions();
     void ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman) override;
     // ResendWalletTransactionsBefore may only be called if fBroadcastTransactions!
     std::vector<uint256> ResendWalletTransactionsBefore(int64_t nTime, CConnman* connman);
+    /** Balance totals of the wallet, all the balance getters below read them */
+    CWalletBalances GetBalances() const;
+    /** Changes whenever a balance may have changed, so pollers only query the balances when it did */
+    uint64_t GetBalanceChanges() const { return nBalanceChanges; }
+    /** Queue hash for its balances to be counted again */
+    void MarkBalanceDirty(const uint256& hash) const;
     CAmount GetBalance() const;
     CAmount GetUnconfirmedBalance() const;
     CAmount GetImmatureBalance() const;
@@ -1364,11 +1594,20 @@ public:
     bool CreateZerocoinSpendTransaction(std::string &toKey,int64_t nValue, libzerocoin::CoinDenomination denomination,
                                         CWalletTx& wtxNew, CReserveKey& reservekey, CBigNum& coinSerial, uint256& txHash, CBigNum& zcSelectedValue, bool& zcSelectedIsUsed,  std::string& strFailReason);
     bool CommitZerocoinSpendTransaction(CWalletTx& wtxNew, CReserveKey& reservekey);
+    /** Get the witness of an unspent mint at maxHeight, using and refreshing the stored witness where possible */
+    libzerocoin::AccumulatorWitness GetZerocoinWitness(const CZerocoinEntry &coin, int id, int maxHeight);
+    /** Advance the stored witnesses of unspent mints to the new spendable height */
+    void UpdateZerocoinWitnesses(const CBlockIndex *pindexTip);
+    /** Forget stored witnesses that include blocks at or above nHeight */
+    void InvalidateZerocoinWitnesses(int nHeight);
     std::string SendMoney(CScript scriptPubKey, int64_t nValue, CWalletTx& wtxNew, bool fAskFee=false);
     std::string SendMoneyToDestination(const CTxDestination &address, int64_t nValue, CWalletTx& wtxNew, bool fAskFee=false);
     std::string MintZerocoin(CScript pubCoin, int64_t nValue, CWalletTx& wtxNew, bool fAskFee=false);
     std::string SpendZerocoin(std::string &toKey, int64_t nValue, libzerocoin::CoinDenomination denomination, CWalletTx& wtxNew, CBigNum& coinSerial, uint256& txHash, CBigNum& zcSelectedValue, bool& zcSelectedIsUsed);
     bool CreateZerocoinMintModel(string &stringError, string denomAmount);
+    /** Mint a zerocoin of each of the denominations, generating the coins in parallel */
+    bool CreateZerocoinMintModels(string &stringError, const std::vector<libzerocoin::CoinDenomination> &denominations);
+    bool CommitZerocoinMintModel(string &stringError, const libzerocoin::PrivateCoin &newCoin, libzerocoin::CoinDenomination denomination);
     bool CreateZerocoinSpendModel(string &stringError, string denomAmount, string toAddr="");
     bool SetZerocoinBook(const CZerocoinEntry& zerocoinEntry);
     /**
@@ -1426,6 +1665,7 @@ public:
     int ExtKeyRemoveAccountFromMapsAndFree(const CKeyID &idAccount);
     int ExtKeyLoadAccountPacks();
     int PrepareLookahead();
+    int ExtKeyWriteLookAheadCaches(CWalletDB *pwdb, CExtKeyAccount *sea) const;
 
     int ExtKeyAppendToPack(CWalletDB *pwdb, CExtKeyAccount *sea, const CKeyID &idKey, const CEKAKey &ak, bool &fUpdateAcc) const;
     int ExtKeyAppendToPack(CWalletDB *pwdb, CExtKeyAccount *sea, const CKeyID &idKey, const CEKASCKey &asck, bool &fUpdateAcc) const;
@@ -1467,6 +1707,14 @@ public:
     bool UpdateStealthAddressIndex(const CKeyID &idK, const CStealthAddressIndexed &sxi, uint32_t &id); // Get stealth index or create new index if none found
     bool GetStealthByIndex(uint32_t sxId, CStealthAddress &sx) const;
     bool GetStealthLinked(const CKeyID &idK, CStealthAddress &sx);
+    /** Find the outputs of vtx paying to the stealth keys of the accounts and add the keys they pay to,
+      * so that they are seen as mine. Requires cs_wallet */
+    void ScanStealthOutputs(const std::vector<CTransactionRef>& vtx);
+    /** Rebuild stealthScanner if the stealth keys changed. Requires cs_wallet */
+    void UpdateStealthScanner();
+    /** Add the keys of the stealth outputs found by stealthScanner. Requires cs_wallet */
+    void AddStealthMatches(const std::vector<CStealthMatch>& vMatches);
+    /** Add the keys of the stealth outputs found while the wallet was locked */
     bool ProcessLockedStealthOutputs();
     bool ProcessLockedBlindedOutputs();
     bool CountRecords(std::string sPrefix, int64_t rv);
@@ -1568,6 +1816,9 @@ public:
         return setInternalKeyPool.size() + setExternalKeyPool.size();
     }
 
+    //! Estimate of the heap memory used by the transactions, address book and key metadata of the wallet
+    size_t DynamicMemoryUsage();
+
     //! signify that a particular wallet feature is now used. this may change nWalletVersion and nWalletMaxVersion if those are lower
     bool SetMinVersion(enum WalletFeature, CWalletDB* pwalletdbIn = nullptr, bool fExplicit = false);
 
@@ -17,6 +17,7 @@
 #include <wallet/wallet.h>
 
 #include <atomic>
+#include <thread>
 
 #include <boost/thread.hpp>
 #include <boost/foreach.hpp>
@@ -241,6 +242,56 @@ public:
     }
 };
 
+/** Check a wallet transaction read from the database and add it to the wallet */
+static bool LoadWalletTx(CWallet* pwallet, const uint256& hash, CWalletTx& wtx, CDataStream& ssValue,
+                         CWalletScanState &wss, std::string& strErr)
+{
+    CValidationState state;
+    // The height only matters to the checks of coinbase transactions. Take it from the block the
+    // wallet has the transaction in, only looking the transaction up if that block is unknown
+    int nHeight = INT_MAX;
+    if (wtx.tx->IsCoinBase()) {
+        BlockMap::iterator mi = mapBlockIndex.find(wtx.hashBlock);
+        if (mi != mapBlockIndex.end()) {
+            nHeight = mi->second->nHeight;
+        } else {
+            CTransactionRef tx;
+            uint256 hashBlock;
+            if (GetTransaction(wtx.tx->GetHash(), tx, Params().GetConsensus(), hashBlock) &&
+                (mi = mapBlockIndex.find(hashBlock)) != mapBlockIndex.end())
+                nHeight = mi->second->nHeight;
+        }
+    }
+    if (!(CheckTransaction(*wtx.tx, state, wtx.GetHash(), true, true, nHeight) && (wtx.GetHash() == hash) && state.IsValid()))
+        return false;
+
+    // Undo serialize changes in 31600
+    if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
+    {
+        if (!ssValue.empty())
+        {
+            char fTmp;
+            char fUnused;
+            ssValue >> fTmp >> fUnused >> wtx.strFromAccount;
+            strErr = strprintf("LoadWallet() upgrading tx ver=%d %d '%s' %s",
+                               wtx.fTimeReceivedIsTxTime, fTmp, wtx.strFromAccount, hash.ToString());
+            wtx.fTimeReceivedIsTxTime = fTmp;
+        }
+        else
+        {
+            strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
+            wtx.fTimeReceivedIsTxTime = 0;
+        }
+        wss.vWalletUpgrade.push_back(hash);
+    }
+
+    if (wtx.nOrderPos == -1)
+        wss.fAnyUnordered = true;
+
+    pwallet->LoadToWallet(wtx);
+    return true;
+}
+
 bool
 ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
              CWalletScanState &wss, std::string& strType, std::string& strErr)
@@ -268,48 +319,16 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
             ssKey >> hash;
             CWalletTx wtx;
             ssValue >> wtx;
-            CValidationState state;
-            int nHeight = INT_MAX;
-            if(!wtx.tx->vin.empty()){
-                const uint256& prevHash = wtx.tx->GetHash();
-                CTransactionRef tx;
-                uint256 hashBlock;
-                bool fFound = GetTransaction(prevHash, tx, Params().GetConsensus(), hashBlock);
-                if(fFound)
-                {
-                    if(mapBlockIndex.find(hashBlock) != mapBlockIndex.end())
-                    {
-                        nHeight = mapBlockIndex[hashBlock]->nHeight;
-                    }
-                }
-            }
-            if (!(CheckTransaction(*wtx.tx, state, wtx.GetHash(), true, true, nHeight) && (wtx.GetHash() == hash) && state.IsValid()))
+            if (!LoadWalletTx(pwallet, hash, wtx, ssValue, wss, strErr))
                 return false;
-
-            // Undo serialize changes in 31600
-            if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
-            {
-                if (!ssValue.empty())
-                {
-                    char fTmp;
-                    char fUnused;
-                    ssValue >> fTmp >> fUnused >> wtx.strFromAccount;
-                    strErr = strprintf("LoadWallet() upgrading tx ver=%d %d '%s' %s",
-                                       wtx.fTimeReceivedIsTxTime, fTmp, wtx.strFromAccount, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = fTmp;
-                }
-                else
-                {
-                    strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = 0;
-                }
-                wss.vWalletUpgrade.push_back(hash);
-            }
-
-            if (wtx.nOrderPos == -1)
-                wss.fAnyUnordered = true;
-
-            pwallet->LoadToWallet(wtx);
+        }
+        else if (strType == "zerocoin")
+        {
+            CBigNum value;
+            ssKey >> value;
+            CZerocoinEntry zerocoin;
+            ssValue >> zerocoin;
+            pwallet->LoadZerocoinEntry(zerocoin);
         }
         else if (strType == "acentry")
         {
@@ -527,6 +546,65 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
     return true;
 }
 
+/** A "tx" record of the wallet database, decoded apart from the other records */
+struct CWalletTxRecord
+{
+    CDataStream ssKey;
+    CDataStream ssValue;
+    uint256 hash;
+    CWalletTx wtx;
+    bool fDecoded = false;
+
+    CWalletTxRecord(CDataStream&& ssKeyIn, CDataStream&& ssValueIn) : ssKey(std::move(ssKeyIn)), ssValue(std::move(ssValueIn)) {}
+};
+
+static bool IsWalletTxRecord(const CDataStream& ssKey)
+{
+    // The key starts with the serialized type, "tx" is a compact size of 2 then the characters
+    return ssKey.size() > 3 && ssKey[0] == 2 && ssKey[1] == 't' && ssKey[2] == 'x';
+}
+
+static void DecodeWalletTxRecords(std::vector<CWalletTxRecord>& vRecords, size_t nBegin, size_t nEnd)
+{
+    for (size_t i = nBegin; i < nEnd; i++) {
+        CWalletTxRecord& record = vRecords[i];
+        try {
+            std::string strType;
+            record.ssKey >> strType >> record.hash;
+            record.ssValue >> record.wtx;
+            record.ssKey.clear();
+            record.fDecoded = true;
+        } catch (...) {
+            record.fDecoded = false;
+        }
+    }
+}
+
+/**
+ * Deserialize the transactions read from the database, on one thread per WALLET_LOAD_TXS_PER_THREAD
+ * of them up to the number of cores. Deserializing and hashing the transactions is most of the work
+ * of loading a large wallet, adding them to the wallet happens after, in the order of the records.
+ */
+static void DecodeWalletTxRecords(std::vector<CWalletTxRecord>& vRecords)
+{
+    size_t nThreads = std::min(vRecords.size() / WALLET_LOAD_TXS_PER_THREAD, (size_t)GetNumCores());
+    if (nThreads <= 1) {
+        DecodeWalletTxRecords(vRecords, 0, vRecords.size());
+        return;
+    }
+    size_t nPerThread = (vRecords.size() + nThreads - 1) / nThreads;
+    std::vector<std::thread> vThreads;
+    for (size_t t = 1; t < nThreads; t++) {
+        vThreads.emplace_back([&vRecords, t, nPerThread] {
+            RenameThread("nix-walletload");
+            DecodeWalletTxRecords(vRecords, std::min(vRecords.size(), t * nPerThread), std::min(vRecords.size(), (t + 1) * nPerThread));
+        });
+    }
+    DecodeWalletTxRecords(vRecords, 0, nPerThread);
+    for (std::thread& thread : vThreads)
+        thread.join();
+}
+
 bool CWalletDB::IsKeyType(const std::string& strType)
 {
     return (strType== "key" || strType == "wkey" ||
@@ -557,6 +635,7 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
             return DB_CORRUPT;
         }
 
+        std::vector<CWalletTxRecord> vTxRecords;
         while (true)
         {
             // Read next record
@@ -571,6 +650,12 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
                 return DB_CORRUPT;
             }
 
+            // Transactions are decoded together once all the records are read
+            if (IsWalletTxRecord(ssKey)) {
+                vTxRecords.emplace_back(std::move(ssKey), std::move(ssValue));
+                continue;
+            }
+
             // Try to be tolerant of single corrupt records:
             std::string strType, strErr;
             if (!ReadKeyValue(pwallet, ssKey, ssValue, wss, strType, strErr))
@@ -592,6 +677,28 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
                 LogPrintf("%s\n", strErr);
         }
         pcursor->close();
+
+        int64_t nStart = GetTimeMillis();
+        DecodeWalletTxRecords(vTxRecords);
+        for (CWalletTxRecord& record : vTxRecords)
+        {
+            std::string strErr;
+            bool fLoaded = false;
+            try {
+                fLoaded = record.fDecoded && LoadWalletTx(pwallet, record.hash, record.wtx, record.ssValue, wss, strErr);
+            } catch (...) {
+                fLoaded = false;
+            }
+            if (!fLoaded)
+            {
+                fNoncriticalErrors = true;
+                // Rescan if there is a bad transaction record:
+                gArgs.SoftSetBoolArg("-rescan", true);
+            }
+            if (!strErr.empty())
+                LogPrintf("%s\n", strErr);
+        }
+        LogPrintf("Loaded %u wallet transactions %dms\n", vTxRecords.size(), GetTimeMillis() - nStart);
     }
     catch (const boost::thread_interrupted&) {
         throw;
@@ -659,32 +766,39 @@ DBErrors CWalletDB::FindWalletTx(std::vector<uint256>& vTxHash, std::vector<CWal
             return DB_CORRUPT;
         }
 
+        // Only the "tx" records are read, from the first one on
+        unsigned int fFlags = DB_SET_RANGE;
         while (true)
         {
             // Read next record
             CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+            if (fFlags == DB_SET_RANGE)
+                ssKey << std::string("tx");
             CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-            int ret = batch.ReadAtCursor(pcursor, ssKey, ssValue);
+            int ret = batch.ReadAtCursor(pcursor, ssKey, ssValue, fFlags);
+            fFlags = DB_NEXT;
             if (ret == DB_NOTFOUND)
                 break;
             else if (ret != 0)
             {
                 LogPrintf("Error reading next record from wallet database\n");
+                pcursor->close();
                 return DB_CORRUPT;
             }
 
             std::string strType;
             ssKey >> strType;
-            if (strType == "tx") {
-                uint256 hash;
-                ssKey >> hash;
+            if (strType != "tx")
+                break;
+
+            uint256 hash;
+            ssKey >> hash;
 
-                CWalletTx wtx;
-                ssValue >> wtx;
+            CWalletTx wtx;
+            ssValue >> wtx;
 
-                vTxHash.push_back(hash);
-                vWtx.push_back(wtx);
-            }
+            vTxHash.push_back(hash);
+            vWtx.push_back(wtx);
         }
         pcursor->close();
     }
@@ -711,7 +825,8 @@ DBErrors CWalletDB::ZapSelectTx(std::vector<uint256>& vTxHashIn, std::vector<uin
     std::sort(vTxHash.begin(), vTxHash.end());
     std::sort(vTxHashIn.begin(), vTxHashIn.end());
 
-    // erase each matching wallet TX
+    // erase each matching wallet TX, in one database transaction
+    CWalletDBTxn txn(*this);
     bool delerror = false;
     std::vector<uint256>::iterator it = vTxHashIn.begin();
     for (uint256 hash : vTxHash) {
@@ -730,7 +845,7 @@ DBErrors CWalletDB::ZapSelectTx(std::vector<uint256>& vTxHashIn, std::vector<uin
         }
     }
 
-    if (delerror) {
+    if (!txn.Commit() || delerror) {
         return DB_CORRUPT;
     }
     return DB_LOAD_OK;
@@ -744,11 +859,14 @@ DBErrors CWalletDB::ZapWalletTx(std::vector<CWalletTx>& vWtx)
     if (err != DB_LOAD_OK)
         return err;
 
-    // erase each wallet TX
+    // erase each wallet TX, in one database transaction
+    CWalletDBTxn txn(*this);
     for (uint256& hash : vTxHash) {
         if (!EraseTx(hash))
             return DB_CORRUPT;
     }
+    if (!txn.Commit())
+        return DB_CORRUPT;
 
     return DB_LOAD_OK;
 }
@@ -893,13 +1011,67 @@ CWalletDB::ReadZerocoinAccumulator(libzerocoin::Accumulator &accumulator, libzer
 }
 
 bool CWalletDB::WriteZerocoinEntry(const CZerocoinEntry &zerocoin) {
-    return batch.Write(make_pair(string("zerocoin"), zerocoin.value), zerocoin, true);
+    return WriteIC(make_pair(string("zerocoin"), zerocoin.value), zerocoin, true);
+}
+
+bool CWalletDB::WriteZerocoinEntries(const std::vector<CZerocoinEntry> &vZerocoin) {
+    CWalletDBTxn txn(*this);
+    for (const CZerocoinEntry &zerocoin : vZerocoin) {
+        if (!WriteZerocoinEntry(zerocoin))
+            return false;
+    }
+    return txn.Commit();
 }
 
 bool CWalletDB::EraseZerocoinEntry(const CZerocoinEntry &zerocoin) {
     return batch.Erase(make_pair(string("zerocoin"), zerocoin.value));
 }
 
+bool CWalletDB::WriteZerocoinWitness(const CZerocoinWitnessEntry &witness) {
+    return batch.Write(make_pair(string("zcwitness"), witness.pubCoin), witness, true);
+}
+
+bool CWalletDB::ReadZerocoinWitness(const CBigNum &pubCoin, CZerocoinWitnessEntry &witness) {
+    return batch.Read(make_pair(string("zcwitness"), pubCoin), witness);
+}
+
+bool CWalletDB::EraseZerocoinWitness(const CBigNum &pubCoin) {
+    return batch.Erase(make_pair(string("zcwitness"), pubCoin));
+}
+
+void CWalletDB::ListZerocoinWitness(std::list <CZerocoinWitnessEntry> &listWitness) {
+    Dbc *pcursor = batch.GetCursor();
+    if (!pcursor)
+        throw runtime_error("CWalletDB::ListZerocoinWitness() : cannot create DB cursor");
+    unsigned int fFlags = DB_SET_RANGE;
+    while (true) {
+        // Read next record
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        if (fFlags == DB_SET_RANGE)
+            ssKey << make_pair(string("zcwitness"), CBigNum(0));
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        int ret = batch.ReadAtCursor(pcursor, ssKey, ssValue, fFlags);
+        fFlags = DB_NEXT;
+        if (ret == DB_NOTFOUND)
+            break;
+        else if (ret != 0) {
+            pcursor->close();
+            throw runtime_error("CWalletDB::ListZerocoinWitness() : error scanning DB");
+        }
+        // Unserialize
+        string strType;
+        ssKey >> strType;
+        if (strType != "zcwitness")
+            break;
+        CBigNum value;
+        ssKey >> value;
+        CZerocoinWitnessEntry witnessItem;
+        ssValue >> witnessItem;
+        listWitness.push_back(witnessItem);
+    }
+    pcursor->close();
+}
+
 // Check Calculated Blocked for Zerocoin
 bool CWalletDB::ReadCalculatedZCBlock(int &height) {
     height = 0;
@@ -1026,6 +1198,21 @@ bool CWalletDB::WriteExtKey(const CKeyID &identifier, const CStoredExtKey &ek32)
     return WriteIC(std::make_pair(std::string("ek32"), identifier), ek32, true);
 };
 
+bool CWalletDB::ReadExtKeyLookAhead(const CKeyID &identifier, CStoredExtKey &ek32, uint32_t nFlags)
+{
+    std::pair<uint32_t, std::vector<CKeyID> > cache;
+    if (!batch.Read(std::make_pair(std::string("elah"), identifier), cache, nFlags))
+        return false;
+    ek32.nCacheFrom = cache.first;
+    ek32.vCachedIds = std::move(cache.second);
+    return true;
+};
+
+bool CWalletDB::WriteExtKeyLookAhead(const CKeyID &identifier, const CStoredExtKey &ek32)
+{
+    return WriteIC(std::make_pair(std::string("elah"), identifier), std::make_pair(ek32.nCacheFrom, ek32.vCachedIds), true);
+};
+
 
 bool CWalletDB::ReadExtAccount(const CKeyID &identifier, CExtKeyAccount &ekAcc, uint32_t nFlags)
 {
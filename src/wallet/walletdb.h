@@ -36,6 +36,8 @@
  */
 
 static const bool DEFAULT_FLUSHWALLET = true;
+//! Wallet transactions deserialized per thread when loading the wallet, fewer use the loading thread only
+static const size_t WALLET_LOAD_TXS_PER_THREAD = 1000;
 
 class CAddressBookData;
 class CAccount;
@@ -50,6 +52,7 @@ class uint160;
 class uint256;
 class CZerocoinEntry;
 class CZerocoinSpendEntry;
+class CZerocoinWitnessEntry;
 
 /** Error statuses for the wallet database */
 enum DBErrors
@@ -415,11 +418,16 @@ public:
     bool WriteVersion(int nVersion);
 
     bool WriteZerocoinEntry(const CZerocoinEntry& zerocoin);
+    bool WriteZerocoinEntries(const std::vector<CZerocoinEntry>& vZerocoin);
     bool EraseZerocoinEntry(const CZerocoinEntry& zerocoin);
     void ListPubCoin(std::list<CZerocoinEntry>& listPubCoin);
     void ListCoinSpendSerial(std::list<CZerocoinSpendEntry>& listCoinSpendSerial);
     bool WriteCoinSpendSerialEntry(const CZerocoinSpendEntry& zerocoinSpend);
     bool EraseCoinSpendSerialEntry(const CZerocoinSpendEntry& zerocoinSpend);
+    bool WriteZerocoinWitness(const CZerocoinWitnessEntry& witness);
+    bool ReadZerocoinWitness(const CBigNum& pubCoin, CZerocoinWitnessEntry& witness);
+    bool EraseZerocoinWitness(const CBigNum& pubCoin);
+    void ListZerocoinWitness(std::list<CZerocoinWitnessEntry>& listWitness);
     bool WriteZerocoinAccumulator(libzerocoin::Accumulator accumulator, libzerocoin::CoinDenomination denomination, int pubcoinid);
     bool ReadZerocoinAccumulator(libzerocoin::Accumulator& accumulator, libzerocoin::CoinDenomination denomination, int pubcoinid);
     // bool EraseZerocoinAccumulator(libzerocoin::Accumulator& accumulator, libzerocoin::CoinDenomination denomination, int pubcoinid);
@@ -442,6 +450,10 @@ public:
     bool ReadExtKey(const CKeyID &identifier, CStoredExtKey &ek32, uint32_t nFlags=DB_READ_UNCOMMITTED);
     bool WriteExtKey(const CKeyID &identifier, const CStoredExtKey &ek32);
 
+    /** The look ahead cache of an ext key, the ids of its children already derived */
+    bool ReadExtKeyLookAhead(const CKeyID &identifier, CStoredExtKey &ek32, uint32_t nFlags=DB_READ_UNCOMMITTED);
+    bool WriteExtKeyLookAhead(const CKeyID &identifier, const CStoredExtKey &ek32);
+
     bool ReadExtAccount(const CKeyID &identifier, CExtKeyAccount &ekAcc, uint32_t nFlags=DB_READ_UNCOMMITTED);
     bool WriteExtAccount(const CKeyID &identifier, const CExtKeyAccount &ekAcc);
 
@@ -478,6 +490,33 @@ private:
     CWalletDBWrapper& m_dbw;
 };
 
+/**
+ * Groups the writes made through a CWalletDB in one database transaction, committed together with a
+ * single log write instead of one per record. Nests into a transaction the caller already began on
+ * the same CWalletDB, which then commits it. Aborted if Commit isn't called.
+ */
+class CWalletDBTxn
+{
+private:
+    CWalletDB& walletdb;
+    bool fOwned;
+    bool fDone;
+
+public:
+    explicit CWalletDBTxn(CWalletDB& walletdbIn) : walletdb(walletdbIn), fOwned(walletdb.TxnBegin()), fDone(false) {}
+    ~CWalletDBTxn()
+    {
+        if (fOwned && !fDone)
+            walletdb.TxnAbort();
+    }
+
+    bool Commit()
+    {
+        fDone = true;
+        return !fOwned || walletdb.TxnCommit();
+    }
+};
+
 bool AutoBackupWallet (CWallet* wallet, std::string strWalletFile, std::string& strBackupWarning, std::string& strBackupError);
 //! Compacts BDB state so that wallet.dat is self-contained (if there are changes)
 void MaybeCompactWalletDB();
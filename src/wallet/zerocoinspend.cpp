@@ -0,0 +1,123 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <wallet/zerocoinspend.h>
+
+#include <util.h>
+#include <utiltime.h>
+#include <wallet/wallet.h>
+
+#include <functional>
+
+std::string ZerocoinSpendStatusString(ZerocoinSpendStatus status)
+{
+    switch (status) {
+    case ZerocoinSpendStatus::QUEUED: return "queued";
+    case ZerocoinSpendStatus::PROVING: return "proving";
+    case ZerocoinSpendStatus::COMMITTED: return "committed";
+    case ZerocoinSpendStatus::FAILED: return "failed";
+    }
+    return "unknown";
+}
+
+uint64_t CZerocoinSpendQueue::Add(const std::string &toKey, int64_t nValue, libzerocoin::CoinDenomination denomination)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    CZerocoinSpendRequest &request = mapRequests[nNextId];
+    request.nId = nNextId++;
+    request.toKey = toKey;
+    request.nValue = nValue;
+    request.denomination = denomination;
+    request.nTimeQueued = GetTime();
+    queue.push_back(request.nId);
+
+    if (!fStarted) {
+        fStarted = true;
+        thread = std::thread(&TraceThread<std::function<void()> >, "zcspend",
+                             std::function<void()>(std::bind(&CZerocoinSpendQueue::ThreadSpend, this)));
+    }
+    cond.notify_one();
+    return request.nId;
+}
+
+bool CZerocoinSpendQueue::Get(uint64_t nId, CZerocoinSpendRequest &request) const
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    std::map<uint64_t, CZerocoinSpendRequest>::const_iterator it = mapRequests.find(nId);
+    if (it == mapRequests.end())
+        return false;
+    request = it->second;
+    return true;
+}
+
+std::vector<CZerocoinSpendRequest> CZerocoinSpendQueue::List() const
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    std::vector<CZerocoinSpendRequest> result;
+    result.reserve(mapRequests.size());
+    for (const auto &entry : mapRequests)
+        result.push_back(entry.second);
+    return result;
+}
+
+void CZerocoinSpendQueue::Stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!fStarted || fStop)
+            return;
+        fStop = true;
+        cond.notify_all();
+    }
+    thread.join();
+}
+
+void CZerocoinSpendQueue::ThreadSpend()
+{
+    while (true) {
+        CZerocoinSpendRequest request;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!fStop && queue.empty())
+                cond.wait(lock);
+            if (fStop)
+                return;
+            CZerocoinSpendRequest &queued = mapRequests[queue.front()];
+            queue.pop_front();
+            queued.status = ZerocoinSpendStatus::PROVING;
+            request = queued;
+        }
+
+        CWalletTx wtx;
+        CBigNum coinSerial;
+        uint256 txHash;
+        CBigNum zcSelectedValue;
+        bool zcSelectedIsUsed;
+        std::string strError;
+        try {
+            strError = pwallet->SpendZerocoin(request.toKey, request.nValue, request.denomination, wtx, coinSerial, txHash,
+                                              zcSelectedValue, zcSelectedIsUsed);
+        } catch (const std::exception &e) {
+            strError = e.what();
+        }
+
+        if (strError.empty())
+            LogPrintf("%s: spend %u committed in %s\n", __func__, request.nId, wtx.GetHash().ToString());
+        else
+            LogPrintf("%s: spend %u failed: %s\n", __func__, request.nId, strError);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        CZerocoinSpendRequest &done = mapRequests[request.nId];
+        done.status = strError.empty() ? ZerocoinSpendStatus::COMMITTED : ZerocoinSpendStatus::FAILED;
+        done.strError = strError;
+        if (strError.empty())
+            done.txHash = wtx.GetHash();
+        done.nTimeFinished = GetTime();
+        finished.push_back(request.nId);
+        if (finished.size() > nMaxFinishedRequests) {
+            mapRequests.erase(finished.front());
+            finished.pop_front();
+        }
+    }
+}
@@ -0,0 +1,88 @@
+// Copyright (c) 2018 The NIX Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef NIX_WALLET_ZEROCOINSPEND_H
+#define NIX_WALLET_ZEROCOINSPEND_H
+
+#include <uint256.h>
+#include <libzerocoin/Zerocoin.h>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class CWallet;
+
+enum class ZerocoinSpendStatus
+{
+    QUEUED,
+    PROVING,
+    COMMITTED,
+    FAILED,
+};
+
+std::string ZerocoinSpendStatusString(ZerocoinSpendStatus status);
+
+/** A spend queued with CZerocoinSpendQueue */
+struct CZerocoinSpendRequest
+{
+    uint64_t nId;
+    std::string toKey;
+    int64_t nValue;
+    libzerocoin::CoinDenomination denomination;
+    ZerocoinSpendStatus status;
+    std::string strError;
+    // hash of the committed spend transaction
+    uint256 txHash;
+    int64_t nTimeQueued;
+    int64_t nTimeFinished;
+
+    CZerocoinSpendRequest() : nId(0), nValue(0), denomination(libzerocoin::ZQ_ERROR), status(ZerocoinSpendStatus::QUEUED),
+                              nTimeQueued(0), nTimeFinished(0) {}
+};
+
+/**
+ * Spends zerocoins of a wallet one after another on a background thread. The thread builds the witness and
+ * the spend proof without cs_main or cs_wallet held and commits with CommitZerocoinSpendTransaction. Callers
+ * only queue the spend and poll its status.
+ */
+class CZerocoinSpendQueue
+{
+private:
+    CWallet *pwallet;
+
+    mutable std::mutex mutex;
+    std::condition_variable cond;
+    std::map<uint64_t, CZerocoinSpendRequest> mapRequests;
+    // ids of the requests waiting to be spent, and of the finished ones from oldest to newest
+    std::deque<uint64_t> queue;
+    std::deque<uint64_t> finished;
+    uint64_t nNextId;
+    bool fStarted;
+    bool fStop;
+    std::thread thread;
+
+    void ThreadSpend();
+
+public:
+    /** Finished requests older than this many are forgotten */
+    static const size_t nMaxFinishedRequests = 1000;
+
+    CZerocoinSpendQueue(CWallet *pwalletIn) : pwallet(pwalletIn), nNextId(1), fStarted(false), fStop(false) {}
+    ~CZerocoinSpendQueue() { Stop(); }
+
+    /** Queue a spend, starting the spend thread if needed. Returns the id of the request */
+    uint64_t Add(const std::string &toKey, int64_t nValue, libzerocoin::CoinDenomination denomination);
+    bool Get(uint64_t nId, CZerocoinSpendRequest &request) const;
+    std::vector<CZerocoinSpendRequest> List() const;
+
+    /** Stop the spend thread after the spend in progress, queued spends are left alone */
+    void Stop();
+};
+
+#endif // NIX_WALLET_ZEROCOINSPEND_H
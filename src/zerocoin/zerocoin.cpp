@@ -1,28 +1,122 @@
 #include "zerocoin.h"
+#include "zerocoin/zerocoinparams.h"
+#include "streams.h"
 #include "timedata.h"
 #include "util.h"
 #include "base58.h"
 #include "wallet/wallet.h"
 #include "wallet/walletdb.h"
+#include <algorithm>
 #include <atomic>
 #include <sstream>
 #include <chrono>
 #include <boost/foreach.hpp>
 #include "utilstrencodings.h"
-#include "consensus/airdropaddresses.h"
+#include "coinbasepayouts.h"
+#include "crypto/sha256.h"
+#include "cuckoocache.h"
+#include "random.h"
+#include "script/sigcache.h"
+#include "txdb.h"
+#include "ui_interface.h"
+#include "libzerocoin/ParallelTasks.h"
+#include "memusage.h"
+#include "metrics.h"
+#include <boost/thread/shared_mutex.hpp>
 
 using namespace std;
 using namespace boost;
 
-// btzc: add zerocoin init
-// zerocoin init
-static CBigNum bnTrustedModulus(ZEROCOIN_MODULUS);
-// Set up the Zerocoin Params object
-libzerocoin::Params *ZCParams = new libzerocoin::Params(bnTrustedModulus);
+/** Set up the Zerocoin Params object from the parameters derived from ZEROCOIN_MODULUS before */
+static libzerocoin::Params *LoadZerocoinParams()
+{
+    const char *pbegin = (const char *)zerocoin_params_serialized;
+    CDataStream ss(pbegin, pbegin + sizeof(zerocoin_params_serialized), SER_NETWORK, PROTOCOL_VERSION);
+    return new libzerocoin::Params(deserialize, ss);
+}
+
+libzerocoin::Params *ZCParams = LoadZerocoinParams();
+
+bool CheckZerocoinParams()
+{
+    libzerocoin::Params derived(CBigNum(ZEROCOIN_MODULUS));
+    CDataStream ssDerived(SER_NETWORK, PROTOCOL_VERSION);
+    ssDerived << derived;
+    CDataStream ssLoaded(SER_NETWORK, PROTOCOL_VERSION);
+    ssLoaded << *ZCParams;
+    if (ssDerived.str() == ssLoaded.str())
+        return true;
+    LogPrintf("%s: built-in zerocoin parameters differ from the derived ones %s\n", __func__, HexStr(ssDerived.begin(), ssDerived.end()));
+    return false;
+}
 
 
 static CZerocoinState zerocoinState;
 
+bool fRequireZerocoinSpendBlockHash = DEFAULT_REQUIRE_ZEROCOIN_SPEND_BLOCK_HASH;
+
+namespace {
+/**
+ * Valid CoinSpend cache, to avoid verifying zerocoin spend proofs twice for every transaction
+ * (once when accepted into memory pool, and again when accepted into the block chain)
+ */
+class CZerocoinSpendCache
+{
+private:
+    //! Entries are SHA256(SHA256(nonce || serialized CoinSpend || metadata) || accumulator value)
+    uint256 nonce;
+    typedef CuckooCache::cache<uint256, SignatureCacheHasher> map_type;
+    map_type setValid;
+    boost::shared_mutex cs_spendcache;
+
+public:
+    CZerocoinSpendCache()
+    {
+        GetRandBytes(nonce.begin(), 32);
+    }
+
+    void
+    ComputeSpendHash(uint256& spendHash, const unsigned char *pSpend, size_t nSpendSize, uint32_t pubcoinId, const uint256 &txHashForMetadata)
+    {
+        CSHA256().Write(nonce.begin(), 32).Write(pSpend, nSpendSize).Write((unsigned char*)&pubcoinId, sizeof(pubcoinId)).Write(txHashForMetadata.begin(), 32).Finalize(spendHash.begin());
+    }
+
+    void
+    ComputeEntry(uint256& entry, const uint256 &spendHash, const CBigNum &accumulatorValue)
+    {
+        std::vector<unsigned char> vchAccumulator = accumulatorValue.getvch();
+        CSHA256().Write(spendHash.begin(), 32).Write(vchAccumulator.data(), vchAccumulator.size()).Finalize(entry.begin());
+    }
+
+    bool
+    Get(const uint256& entry, const bool erase)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_spendcache);
+        return setValid.contains(entry, erase);
+    }
+
+    void Set(uint256& entry)
+    {
+        boost::unique_lock<boost::shared_mutex> lock(cs_spendcache);
+        setValid.insert(entry);
+    }
+    uint32_t setup_bytes(size_t n)
+    {
+        return setValid.setup_bytes(n);
+    }
+};
+
+static CZerocoinSpendCache zerocoinSpendCache;
+} // namespace
+
+void InitZerocoinSpendCache()
+{
+    size_t nMaxCacheSize = std::min(std::max((int64_t)0, gArgs.GetArg("-maxzerocoinspendcachesize", DEFAULT_MAX_ZEROCOIN_SPEND_CACHE_SIZE)), MAX_MAX_ZEROCOIN_SPEND_CACHE_SIZE) * ((size_t) 1 << 20);
+    size_t nElems = zerocoinSpendCache.setup_bytes(nMaxCacheSize);
+    LogPrintf("Using %zu MiB out of %zu requested for zerocoin spend cache, able to store %zu elements\n",
+            (nElems*sizeof(uint256)) >>20, nMaxCacheSize>>20, nElems);
+}
+
 static bool CheckZerocoinSpendSerial(CValidationState &state, CZerocoinTxInfo *zerocoinTxInfo, libzerocoin::CoinDenomination denomination, const CBigNum &serial, int nHeight, bool fConnectTip) {
     // check for zerocoin transaction in this block as well
     if (zerocoinTxInfo && !zerocoinTxInfo->fInfoIsComplete && zerocoinTxInfo->spentSerials.count(serial) > 0)
@@ -40,6 +134,106 @@ static bool CheckZerocoinSpendSerial(CValidationState &state, CZerocoinTxInfo *z
     return true;
 }
 
+// Verify the spend against one accumulator value, looking it up in the spend cache first.
+// Successful verifications are remembered in the spend cache if fCacheStore is set, otherwise cache hits are evicted
+static bool VerifyZerocoinSpendAccumulator(const libzerocoin::CoinSpend &spend,
+                                           const libzerocoin::SpendMetaData &metadata,
+                                           const uint256 &spendHash,
+                                           libzerocoin::CoinDenomination denomination,
+                                           const CBigNum &accumulatorValue,
+                                           bool fCacheStore) {
+    uint256 cacheEntry;
+    zerocoinSpendCache.ComputeEntry(cacheEntry, spendHash, accumulatorValue);
+    if (zerocoinSpendCache.Get(cacheEntry, !fCacheStore)) {
+        MetricAdd(Metric::ZEROCOIN_CACHE_HITS);
+        return true;
+    }
+
+    libzerocoin::Accumulator accumulator(ZCParams, accumulatorValue, denomination);
+    LogPrint(BCLog::ZEROCOIN, "CheckSpendZerocoinTransaction: accumulator=%s\n", accumulator.getValue().ToString().substr(0,15));
+    int64_t nTimeStart = GetTimeMicros();
+    bool passVerify = spend.Verify(accumulator, metadata);
+    MetricAdd(Metric::ZEROCOIN_VERIFY_MICROS, GetTimeMicros() - nTimeStart);
+    MetricAdd(Metric::ZEROCOIN_PROOFS_VERIFIED);
+    if (passVerify && fCacheStore)
+        zerocoinSpendCache.Set(cacheEntry);
+    return passVerify;
+}
+
+// Enumerate all the accumulator changes seen in the blockchain starting with index and try to verify the spend
+// against each of them. In most cases the latest accumulator value will be used for verification.
+static bool VerifyZerocoinSpend(const libzerocoin::CoinSpend &spend,
+                                const libzerocoin::SpendMetaData &metadata,
+                                const uint256 &spendHash,
+                                libzerocoin::CoinDenomination denomination,
+                                uint32_t pubcoinId,
+                                CBlockIndex *index,
+                                CBlockIndex *firstBlock,
+                                bool fSingleAccumulator,
+                                bool fCacheStore) {
+    bool passVerify = false;
+    pair<int,int> denominationAndId = make_pair(denomination, pubcoinId);
+
+    do {
+        auto accChange = index->accumulatorChanges.find(denominationAndId);
+        if (accChange != index->accumulatorChanges.end())
+            passVerify = VerifyZerocoinSpendAccumulator(spend, metadata, spendHash, denomination, accChange->second.first, fCacheStore);
+
+        if (index == firstBlock || fSingleAccumulator)
+            break;
+        else
+            index = index->pprev;
+    } while (!passVerify);
+
+    return passVerify;
+}
+
+// Block with given hash among the blocks of the coin group, that is the ancestors of its last block down to the
+// first one. Falls back to the first block of the group if there is no such block
+static CBlockIndex *FindAccumulatorBlock(const CZerocoinState::CoinGroupInfo &coinGroup, const uint256 &blockHash) {
+    BlockMap::const_iterator mi = mapBlockIndex.find(blockHash);
+    if (mi != mapBlockIndex.end()) {
+        CBlockIndex *pindex = mi->second;
+        if (pindex->nHeight >= coinGroup.firstBlock->nHeight && pindex->nHeight <= coinGroup.lastBlock->nHeight &&
+                coinGroup.lastBlock->GetAncestor(pindex->nHeight) == pindex)
+            return pindex;
+    }
+    return coinGroup.firstBlock;
+}
+
+bool CZerocoinSpendCheck::operator()() {
+    libzerocoin::SpendMetaData metadata(pubcoinId, txHashForMetadata);
+    bool passVerify = false;
+    if (fAccumulatorsCopied) {
+        for (const CBigNum &accumulatorValue : vAccumulators) {
+            if ((passVerify = VerifyZerocoinSpendAccumulator(*spend, metadata, spendHash, denomination, accumulatorValue, fCacheStore)))
+                break;
+        }
+    }
+    else {
+        passVerify = VerifyZerocoinSpend(*spend, metadata, spendHash, denomination, pubcoinId, index, firstBlock, fSingleAccumulator, fCacheStore);
+    }
+    if (!passVerify) {
+        LogPrintf("CheckSpendZerocoinTransaction: verification failed at block %d\n", nHeight);
+        return false;
+    }
+    return true;
+}
+
+void CZerocoinSpendCheck::CopyAccumulators() {
+    AssertLockHeld(cs_main);
+    pair<int,int> denominationAndId = make_pair(denomination, pubcoinId);
+    vAccumulators.clear();
+    for (CBlockIndex *pindex = index; pindex; pindex = pindex->pprev) {
+        auto accChange = pindex->accumulatorChanges.find(denominationAndId);
+        if (accChange != pindex->accumulatorChanges.end())
+            vAccumulators.push_back(accChange->second.first);
+        if (pindex == firstBlock || fSingleAccumulator)
+            break;
+    }
+    fAccumulatorsCopied = true;
+}
+
 bool CheckSpendZerocoinTransaction(const CTransaction &tx,
                                 libzerocoin::CoinDenomination targetDenomination,
                                 CValidationState &state,
@@ -47,10 +241,11 @@ bool CheckSpendZerocoinTransaction(const CTransaction &tx,
                                 bool isVerifyDB,
                                 int nHeight,
                                 bool isCheckWallet,
-                                CZerocoinTxInfo *zerocoinTxInfo) {
+                                CZerocoinTxInfo *zerocoinTxInfo,
+                                std::vector<CZerocoinSpendCheck> *pvChecks) {
 
     // Check for inputs only, everything else was checked before
-    LogPrintf("CheckSpendZerocoinTransaction denomination=%d nHeight=%d\n", targetDenomination, nHeight);
+    LogPrint(BCLog::ZEROCOIN, "CheckSpendZerocoinTransaction denomination=%d nHeight=%d\n", targetDenomination, nHeight);
 
     BOOST_FOREACH(const CTxIn &txin, tx.vin)
     {
@@ -76,9 +271,9 @@ bool CheckSpendZerocoinTransaction(const CTransaction &tx,
         CDataStream serializedCoinSpend((const char *)&*(txin.scriptSig.begin() + 4),
                                         (const char *)&*txin.scriptSig.end(),
                                         SER_NETWORK, PROTOCOL_VERSION);
-        libzerocoin::CoinSpend newSpend(ZCParams, serializedCoinSpend);
+        std::shared_ptr<libzerocoin::CoinSpend> newSpend = std::make_shared<libzerocoin::CoinSpend>(ZCParams, serializedCoinSpend);
 
-        int spendVersion = newSpend.getVersion();
+        int spendVersion = newSpend->getVersion();
         if (spendVersion != ZEROCOIN_VERSION_1) {
             return state.DoS(100,
                              false,
@@ -90,81 +285,71 @@ bool CheckSpendZerocoinTransaction(const CTransaction &tx,
 
 
         spendVersion = ZEROCOIN_VERSION_1;
-        newSpend.setVersion(ZEROCOIN_VERSION_1);
+        newSpend->setVersion(ZEROCOIN_VERSION_1);
 
 
 
         uint256 txHashForMetadata;
 
         if (spendVersion >= ZEROCOIN_VERSION_1) {
-            // Obtain the hash of the transaction sans the zerocoin part
-            CMutableTransaction txTemp = tx;
-            BOOST_FOREACH(CTxIn &txTempIn, txTemp.vin) {
-                if (txTempIn.scriptSig.IsZerocoinSpend()) {
-                    txTempIn.scriptSig.clear();
-                    txTempIn.prevout.SetNull();
-                }
-            }
-            txHashForMetadata = txTemp.GetHash();
+            // The hash of the transaction sans the zerocoin part
+            txHashForMetadata = tx.GetZerocoinMetadataHash();
         }
 
 
-        libzerocoin::SpendMetaData newMetadata(txin.nSequence, txHashForMetadata);
-
-
         CZerocoinState::CoinGroupInfo coinGroup;
         if (!zerocoinState.GetCoinGroupInfo(targetDenomination, pubcoinId, coinGroup))
                 return state.DoS(100, false, NO_MINT_ZEROCOIN, "CheckSpendZerocoinTransaction: Error: no coins were minted with such parameters at height %d", nHeight);
 
         bool passVerify = false;
         CBlockIndex *index = coinGroup.lastBlock;
-        pair<int,int> denominationAndId = make_pair(targetDenomination, pubcoinId);
 
 
-        bool spendHasBlockHash;
+        bool spendHasBlockHash = false;
 
         // Zerocoin  transaction can cointain block hash of the last mint tx seen at the moment of spend. It speeds
         // up verification
-        if (spendVersion >= ZEROCOIN_VERSION_1 && !newSpend.getAccumulatorBlockHash().IsNull()) {
+        if (spendVersion >= ZEROCOIN_VERSION_1 && !newSpend->getAccumulatorBlockHash().IsNull()) {
             spendHasBlockHash = true;
-            uint256 accumulatorBlockHash = newSpend.getAccumulatorBlockHash();
-
-            // find index for block with hash of accumulatorBlockHash or set index to the coinGroup.firstBlock if not found
-            while (index != coinGroup.firstBlock && index->GetBlockHash() != accumulatorBlockHash)
-                index = index->pprev;
+            index = FindAccumulatorBlock(coinGroup, newSpend->getAccumulatorBlockHash());
+        }
+        else if (fRequireZerocoinSpendBlockHash && zerocoinTxInfo == NULL && nHeight == INT_MAX && !isVerifyDB && !isCheckWallet) {
+            // Without the block hash every accumulator value of the group may have to be tried, don't let
+            // peers make us do that for the memory pool
+            return state.DoS(0, false, REJECT_NONSTANDARD, "zerocoin-spend-no-accumulator-block-hash");
         }
 
-        // Enumerate all the accumulator changes seen in the blockchain starting with the latest block
-        // In most cases the latest accumulator value will be used for verification
-        do {
-            if (index->accumulatorChanges.count(denominationAndId) > 0) {
-                libzerocoin::Accumulator accumulator(ZCParams,
-                                                     index->accumulatorChanges[denominationAndId].first,
-                                                     targetDenomination);
-                LogPrintf("CheckSpendZerocoinTransaction: accumulator=%s\n", accumulator.getValue().ToString().substr(0,15));
-                passVerify = newSpend.Verify(accumulator, newMetadata);
-
-            }
-
-            if (index == coinGroup.firstBlock || spendHasBlockHash)
-                break;
-            else
-                index = index->pprev;
-        } while (!passVerify);
+        uint256 spendHash;
+        zerocoinSpendCache.ComputeSpendHash(spendHash, &*(txin.scriptSig.begin() + 4), txin.scriptSig.size() - 4,
+                                            pubcoinId, txHashForMetadata);
+
+        // Only spends accepted to the memory pool are worth caching, blocks evict what they hit
+        bool fCacheStore = zerocoinTxInfo == NULL && nHeight == INT_MAX;
+        if (pvChecks) {
+            // Proof is verified later, together with the rest of the spends in the block or off the message handler thread
+            pvChecks->push_back(CZerocoinSpendCheck(newSpend, txHashForMetadata, spendHash, pubcoinId, targetDenomination,
+                                                    index, coinGroup.firstBlock, spendHasBlockHash, nHeight, fCacheStore));
+            passVerify = true;
+        }
+        else {
+            libzerocoin::SpendMetaData newMetadata(txin.nSequence, txHashForMetadata);
+            passVerify = VerifyZerocoinSpend(*newSpend, newMetadata, spendHash, targetDenomination, pubcoinId,
+                                             index, coinGroup.firstBlock, spendHasBlockHash, fCacheStore);
+        }
 
         if (passVerify) {
 
-            CBigNum serial = newSpend.getCoinSerialNumber();
+            CBigNum serial = newSpend->getCoinSerialNumber();
             // do not check for duplicates in case we've seen exact copy of this tx in this block before
             if (!(zerocoinTxInfo && zerocoinTxInfo->zcTransactions.count(hashTx) > 0)) {
-                if (!CheckZerocoinSpendSerial(state, zerocoinTxInfo, newSpend.getDenomination(), serial, nHeight, false))
+                if (!CheckZerocoinSpendSerial(state, zerocoinTxInfo, newSpend->getDenomination(), serial, nHeight, false))
                     return false;
             }
 
             if(!isVerifyDB && !isCheckWallet) {
                 if (zerocoinTxInfo && !zerocoinTxInfo->fInfoIsComplete) {
                     // add spend information to the index
-                    zerocoinTxInfo->spentSerials[serial] = (int)newSpend.getDenomination();
+                    zerocoinTxInfo->spentSerials[serial] = (int)newSpend->getDenomination();
                     zerocoinTxInfo->zcTransactions.insert(hashTx);
 
                 }
@@ -183,8 +368,7 @@ bool CheckMintZerocoinTransaction(const CTxOut &txout,
                                uint256 hashTx,
                                CZerocoinTxInfo *zerocoinTxInfo) {
 
-    LogPrintf("CheckMintZerocoinTransaction txHash = %s\n", txout.GetHash().ToString());
-    LogPrintf("nValue = %d\n", txout.nValue);
+    LogPrint(BCLog::ZEROCOIN, "CheckMintZerocoinTransaction txHash = %s nValue = %d\n", txout.GetHash().ToString(), txout.nValue);
 
     if (txout.scriptPubKey.size() < 6)
         return state.DoS(100,
@@ -255,92 +439,35 @@ bool CheckDevFundInputs(const CTransaction &tx, CValidationState &state, int nHe
     if(nHeight == INT_MAX)
         nHeight = 2;
 
+    const CCoinbasePayouts& payouts = CoinbasePayouts();
+
     // To airdrop
     if (nHeight == 1) {
 
         //Split 38m into 100 unique addresses for faster tx processing
         CAmount airdropValuePerAddress = GetBlockSubsidy(nHeight, Params().GetConsensus())/100;
 
-        bool found_1 = false;
-
-        CScript AIRDROP_SCRIPT;
-
-        std::string addresses;
-
+        std::vector<CAmount> vAmounts;
         if (!fTestNet) {
-            for(int i = 0; i < 100; i++){
-                addresses = airdrop_addresses[i];
-                AIRDROP_SCRIPT = GetScriptForDestination(DecodeDestination(addresses));
-                found_1 = false;
-                BOOST_FOREACH(const CTxOut &output, tx.vout) {
-                    //check for first 93 address with 3.8m
-                    if (output.scriptPubKey == AIRDROP_SCRIPT && output.nValue == (int64_t)(airdropValuePerAddress)) {
-                        found_1 = true;
-                        break;
-                    }
-                    //check for the stacked address
-                    else if (output.scriptPubKey == AIRDROP_SCRIPT && output.nValue == (int64_t)((airdropValuePerAddress * 7) - (240000*COIN))) {
-                        found_1 = true;
-                        break;
-                    }
-                    //check for 6 ghosnode outputs
-                    else if (output.scriptPubKey == AIRDROP_SCRIPT && output.nValue == (int64_t)(40000*COIN)) {
-                        found_1 = true;
-                        break;
-                    }
-                }
-                if (!(found_1)) {
-                    return state.DoS(100, false, REJECT_FOUNDER_REWARD_MISSING,
-                                     "CTransaction::CheckTransaction() : airdrop funds missing");
-                }
-            }
+            //first 93 addresses with 3.8m, the stacked address and 6 ghostnode outputs
+            vAmounts = {airdropValuePerAddress, (airdropValuePerAddress * 7) - (240000*COIN), 40000*COIN};
         }
-        else{
-            AIRDROP_SCRIPT = GetScriptForDestination(DecodeDestination("2PosyBduiL7yMfBK8DZEtCBJaQF76zgE8f"));
-            found_1 = false;
-            BOOST_FOREACH(const CTxOut &output, tx.vout) {
-                //check for first testnet drop
-                if (output.scriptPubKey == AIRDROP_SCRIPT && output.nValue == (int64_t)(GetBlockSubsidy(nHeight, Params().GetConsensus()))) {
-                    found_1 = true;
-                    break;
-                }
-            }
-            if (!(found_1)) {
-                return state.DoS(100, false, REJECT_FOUNDER_REWARD_MISSING,
-                                 "CTransaction::CheckTransaction() : airdrop funds missing");
-            }
+        else {
+            //first testnet drop
+            vAmounts = {GetBlockSubsidy(nHeight, Params().GetConsensus())};
+        }
+
+        if (!payouts.PaysAirdrop(tx, vAmounts)) {
+            return state.DoS(100, false, REJECT_FOUNDER_REWARD_MISSING,
+                             "CTransaction::CheckTransaction() : airdrop funds missing");
         }
 
     }
 
     if (nHeight >= 2) {
-        bool found_1 = false;
-        bool found_2 = false;
-
-        CScript DEV_1_SCRIPT;
-        CScript DEV_2_SCRIPT;
-
-        if (!fTestNet) {
-            DEV_1_SCRIPT = GetScriptForDestination(DecodeDestination("NVbGEghDbxPUe97oY8N5RvagQ61cHQiouW"));
-            DEV_2_SCRIPT = GetScriptForDestination(DecodeDestination("NWF7QNfT1b8a9dSQmVTT6hcwzwEVYVmDsG"));
-        }
-        else {
-            DEV_1_SCRIPT = GetScriptForDestination(DecodeDestination("2PosyBduiL7yMfBK8DZEtCBJaQF76zgE8f"));
-            DEV_2_SCRIPT = GetScriptForDestination(DecodeDestination("2WT5wFpLXoWm1H8CSgWVcq2F2LyhwKJcG1"));
-        }
-        //7% development fee total
-        BOOST_FOREACH(const CTxOut &output, tx.vout) {
-            //5% for first address
-            if (output.scriptPubKey == DEV_1_SCRIPT && output.nValue == (int64_t)(0.05 * GetBlockSubsidy(nHeight, Params().GetConsensus()))) {
-                found_1 = true;
-            }
-            //2% for second address
-            if (output.scriptPubKey == DEV_2_SCRIPT && output.nValue == (int64_t)(0.02 * GetBlockSubsidy(nHeight, Params().GetConsensus()))) {
-                found_2 = true;
-            }
-        }
-
-        if (!(found_1 && found_2)) {
+        //7% development fee total, 5% for the first address and 2% for the second
+        CAmount nSubsidy = GetBlockSubsidy(nHeight, Params().GetConsensus());
+        if (!payouts.PaysDevFund(tx, {(int64_t)(0.05 * nSubsidy), (int64_t)(0.02 * nSubsidy)})) {
             return state.DoS(100, false, REJECT_FOUNDER_REWARD_MISSING,
                              "CTransaction::CheckTransaction() : dev reward missing");
         }
@@ -369,13 +496,113 @@ bool CheckDevFundInputs(const CTransaction &tx, CValidationState &state, int nHe
     return true;
 }
 
+uint256 GetZerocoinSerialHash(const CBigNum &serial) {
+    std::vector<unsigned char> vch = serial.getvch();
+    return Hash(vch.begin(), vch.end());
+}
+
+bool GetZerocoinSpendSerialHashes(const CTransaction &tx, std::vector<uint256> &vSerialHashes) {
+    vSerialHashes.clear();
+    for (const CTxIn &txin : tx.vin) {
+        if (!txin.scriptSig.IsZerocoinSpend())
+            continue;
+        if (txin.scriptSig.size() < 4)
+            return false;
+        try {
+            CDataStream serializedCoinSpend((const char *)&*(txin.scriptSig.begin() + 4),
+                                            (const char *)&*txin.scriptSig.end(),
+                                            SER_NETWORK, PROTOCOL_VERSION);
+            libzerocoin::CoinSpend spend(ZCParams, serializedCoinSpend);
+            vSerialHashes.push_back(GetZerocoinSerialHash(spend.getCoinSerialNumber()));
+        } catch (const std::exception &) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Accumulator value each zerocoin spend of tx refers to. False unless every spend names an accumulator block with
+// a value for its coin group
+static bool GetZerocoinSpendAccumulators(const CTransaction &tx, std::vector<std::pair<const CTxIn *, CBigNum> > &vSpends) {
+    AssertLockHeld(cs_main);
+    for (const CTxIn &txin : tx.vin) {
+        if (!txin.scriptSig.IsZerocoinSpend())
+            continue;
+        if (txin.scriptSig.size() < 4)
+            return false;
+        try {
+            CDataStream serializedCoinSpend((const char *)&*(txin.scriptSig.begin() + 4),
+                                            (const char *)&*txin.scriptSig.end(),
+                                            SER_NETWORK, PROTOCOL_VERSION);
+            libzerocoin::CoinSpend spend(ZCParams, serializedCoinSpend);
+            if (spend.getAccumulatorBlockHash().IsNull())
+                return false;
+            CZerocoinState::CoinGroupInfo coinGroup;
+            if (!zerocoinState.GetCoinGroupInfo(spend.getDenomination(), txin.nSequence, coinGroup))
+                return false;
+            CBlockIndex *index = FindAccumulatorBlock(coinGroup, spend.getAccumulatorBlockHash());
+            auto accChange = index->accumulatorChanges.find(make_pair((int)spend.getDenomination(), (int)txin.nSequence));
+            if (accChange == index->accumulatorChanges.end())
+                return false;
+            vSpends.emplace_back(&txin, accChange->second.first);
+        } catch (const std::exception &) {
+            return false;
+        }
+    }
+    return !vSpends.empty();
+}
+
+static uint256 ComputeZerocoinSpendToken(const CTransaction &tx, const uint256 &salt, const std::vector<std::pair<const CTxIn *, CBigNum> > &vSpends) {
+    uint256 txHashForMetadata = tx.GetZerocoinMetadataHash();
+    CSHA256 hasher;
+    hasher.Write(salt.begin(), 32).Write(txHashForMetadata.begin(), 32);
+    for (const auto &spend : vSpends) {
+        const CScript &scriptSig = spend.first->scriptSig;
+        uint64_t nSpendSize = scriptSig.size() - 4;
+        std::vector<unsigned char> vchAccumulator = spend.second.getvch();
+        uint64_t nAccumulatorSize = vchAccumulator.size();
+        hasher.Write((const unsigned char *)&nSpendSize, sizeof(nSpendSize)).Write(&*(scriptSig.begin() + 4), nSpendSize);
+        hasher.Write((const unsigned char *)&spend.first->nSequence, sizeof(spend.first->nSequence));
+        hasher.Write((const unsigned char *)&nAccumulatorSize, sizeof(nAccumulatorSize)).Write(vchAccumulator.data(), nAccumulatorSize);
+    }
+    uint256 token;
+    hasher.Finalize(token.begin());
+    return token;
+}
+
+bool GetZerocoinSpendToken(const CTransaction &tx, const uint256 &salt, uint256 &token) {
+    std::vector<std::pair<const CTxIn *, CBigNum> > vSpends;
+    if (!GetZerocoinSpendAccumulators(tx, vSpends))
+        return false;
+    token = ComputeZerocoinSpendToken(tx, salt, vSpends);
+    return true;
+}
+
+bool TrustZerocoinSpendToken(const CTransaction &tx, const uint256 &salt, const uint256 &token) {
+    std::vector<std::pair<const CTxIn *, CBigNum> > vSpends;
+    if (token.IsNull() || !GetZerocoinSpendAccumulators(tx, vSpends) || ComputeZerocoinSpendToken(tx, salt, vSpends) != token)
+        return false;
+
+    uint256 txHashForMetadata = tx.GetZerocoinMetadataHash();
+    for (const auto &spend : vSpends) {
+        const CScript &scriptSig = spend.first->scriptSig;
+        uint256 spendHash, cacheEntry;
+        zerocoinSpendCache.ComputeSpendHash(spendHash, &*(scriptSig.begin() + 4), scriptSig.size() - 4,
+                                            spend.first->nSequence, txHashForMetadata);
+        zerocoinSpendCache.ComputeEntry(cacheEntry, spendHash, spend.second);
+        zerocoinSpendCache.Set(cacheEntry);
+    }
+    return true;
+}
+
 bool CheckZerocoinTransaction(const CTransaction &tx,
                               CValidationState &state,
                               uint256 hashTx,
                               bool isVerifyDB,
                               int nHeight,
                               bool isCheckWallet,
-                              CZerocoinTxInfo *zerocoinTxInfo)
+                              CZerocoinTxInfo *zerocoinTxInfo,
+                              std::vector<CZerocoinSpendCheck> *pvChecks)
 {
     // Check Mint Zerocoin Transaction
     BOOST_FOREACH(const CTxOut &txout, tx.vout) {
@@ -401,7 +628,7 @@ bool CheckZerocoinTransaction(const CTransaction &tx,
                 case libzerocoin::ZQ_FIVE_HUNDRED*COIN:
                 case libzerocoin::ZQ_ONE_THOUSAND*COIN:
                 case libzerocoin::ZQ_FIVE_THOUSAND*COIN:
-                    if(!CheckSpendZerocoinTransaction(tx, (libzerocoin::CoinDenomination)(txout.nValue / COIN), state, hashTx, isVerifyDB, nHeight, isCheckWallet, zerocoinTxInfo))
+                    if(!CheckSpendZerocoinTransaction(tx, (libzerocoin::CoinDenomination)(txout.nValue / COIN), state, hashTx, isVerifyDB, nHeight, isCheckWallet, zerocoinTxInfo, pvChecks))
                             return false;
                     break;
                 default:
@@ -439,14 +666,15 @@ bool ConnectBlockGhost(CValidationState &state, const CChainParams &chainparams,
 
 
         // Update minted values and accumulators
+        map<pair<int,int>, vector<CBigNum>> blockMints;
         BOOST_FOREACH(const PAIRTYPE(int,CBigNum) &mint, pblock->zerocoinTxInfo->mints) {
             int denomination = mint.first;
             CBigNum oldAccValue = ZCParams->accumulatorParams.accumulatorBase;
             int mintId = zerocoinState.AddMint(pindexNew, denomination, mint.second, oldAccValue);
-            LogPrintf("ConnectTipZC: mint added denomination=%d, id=%d\n", denomination, mintId);
+            LogPrint(BCLog::ZEROCOIN, "ConnectTipZC: mint added denomination=%d, id=%d\n", denomination, mintId);
             pair<int,int> denomAndId = make_pair(denomination, mintId);
 
-            pindexNew->mintedPubCoins[denomAndId].push_back(mint.second);
+            blockMints[denomAndId].push_back(mint.second);
 
             CZerocoinState::CoinGroupInfo coinGroupInfo;
             zerocoinState.GetCoinGroupInfo(denomination, mintId, coinGroupInfo);
@@ -466,6 +694,9 @@ bool ConnectBlockGhost(CValidationState &state, const CChainParams &chainparams,
                 pindexNew->accumulatorChanges[denomAndId] = make_pair(accumulator.getValue(), 1);
             }
         }
+
+        if (!blockMints.empty() && !zerocoinState.AddBlockMints(pindexNew, blockMints))
+            return state.Error("Failed to write to zerocoin database");
     }
     else {
         zerocoinState.AddBlock(pindexNew);
@@ -524,17 +755,9 @@ void CZerocoinTxInfo::Complete() {
     fInfoIsComplete = true;
 }
 
-// CZerocoinState::CBigNumHash
+// SaltedBigNumHasher
 
-std::size_t CZerocoinState::CBigNumHash::operator ()(const CBigNum &bn) const noexcept {
-    // we are operating on almost random big numbers and least significant bytes (save for few last bytes) give us a good hash
-    vector<unsigned char> bnData = bn.ToBytes();
-    if (bnData.size() < sizeof(size_t)*3)
-        // rare case, put ones like that into one hash bin
-        return 0;
-    else
-        return ((size_t*)bnData.data())[1];
-}
+SaltedBigNumHasher::SaltedBigNumHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
 
 // CZerocoinState
 
@@ -571,12 +794,6 @@ int CZerocoinState::AddMint(CBlockIndex *index, int denomination, const CBigNum
         newCoinGroup.nCoins = 1;
     }
 
-    CMintedCoinInfo coinInfo;
-    coinInfo.denomination = denomination;
-    coinInfo.id = mintId;
-    coinInfo.nHeight = index->nHeight;
-    mintedPubCoins.insert(pair<CBigNum,CMintedCoinInfo>(pubCoin, coinInfo));
-
     return mintId;
 }
 
@@ -584,6 +801,53 @@ void CZerocoinState::AddSpend(const CBigNum &serial) {
     usedCoinSerials.insert(serial);
 }
 
+bool CZerocoinState::AddBlockMints(CBlockIndex *index, const map<pair<int,int>, vector<CBigNum>> &mints) {
+    // Blocks that are only being checked (block templates) never make it to the index, don't record them
+    BlockMap::const_iterator mi = mapBlockIndex.find(index->GetBlockHash());
+    if (mi == mapBlockIndex.end() || mi->second != index)
+        return true;
+
+    if (!pzerocoindb->WriteBlockMints(index->GetBlockHash(), index->nHeight, mints))
+        return false;
+
+    LOCK(cs_blockMintsCache);
+    if (blockMintsCache.count(index->GetBlockHash()) == 0) {
+        blockMintsCacheOrder.push_back(index->GetBlockHash());
+        if (blockMintsCacheOrder.size() > nMaxBlockMintsCacheSize) {
+            blockMintsCache.erase(blockMintsCacheOrder.front());
+            blockMintsCacheOrder.pop_front();
+        }
+    }
+    blockMintsCache[index->GetBlockHash()] = mints;
+    return true;
+}
+
+vector<CBigNum> CZerocoinState::GetBlockMints(const CBlockIndex *index, int denomination, int id) {
+    pair<int,int> denomAndId = make_pair(denomination, id);
+    if (index->accumulatorChanges.count(denomAndId) == 0)
+        return vector<CBigNum>();
+
+    LOCK(cs_blockMintsCache);
+    uint256 blockHash = index->GetBlockHash();
+    auto blockMints = blockMintsCache.find(blockHash);
+    if (blockMints == blockMintsCache.end()) {
+        map<pair<int,int>, vector<CBigNum>> mints;
+        if (!pzerocoindb->ReadBlockMints(blockHash, mints)) {
+            LogPrintf("CZerocoinState: zerocoin mints of block %s are missing from the database\n", blockHash.ToString());
+            return vector<CBigNum>();
+        }
+        blockMints = blockMintsCache.insert(make_pair(blockHash, std::move(mints))).first;
+        blockMintsCacheOrder.push_back(blockHash);
+        if (blockMintsCacheOrder.size() > nMaxBlockMintsCacheSize) {
+            blockMintsCache.erase(blockMintsCacheOrder.front());
+            blockMintsCacheOrder.pop_front();
+        }
+    }
+
+    auto groupMints = blockMints->second.find(denomAndId);
+    return groupMints != blockMints->second.end() ? groupMints->second : vector<CBigNum>();
+}
+
 void CZerocoinState::AddBlock(CBlockIndex *index) {
     for(const pair<pair<int,int>, pair<CBigNum,int>> &accUpdate: index->accumulatorChanges)
     {
@@ -593,18 +857,10 @@ void CZerocoinState::AddBlock(CBlockIndex *index) {
             coinGroup.firstBlock = index;
         coinGroup.lastBlock = index;
         coinGroup.nCoins += accUpdate.second.second;
-    }
 
-    for(const pair<pair<int,int>,vector<CBigNum>> &pubCoins: index->mintedPubCoins) {
-        latestCoinIds[pubCoins.first.first] = pubCoins.first.second;
-        BOOST_FOREACH(const CBigNum &coin, pubCoins.second) {
-            CMintedCoinInfo coinInfo;
-            coinInfo.denomination = pubCoins.first.first;
-            coinInfo.id = pubCoins.first.second;
-            coinInfo.nHeight = index->nHeight;
-            mintedPubCoins.insert(pair<CBigNum,CMintedCoinInfo>(coin, coinInfo));
-        }
+        latestCoinIds[accUpdate.first.first] = accUpdate.first.second;
     }
+
     BOOST_FOREACH(const CBigNum &serial, index->spentSerials) {
         usedCoinSerials.insert(serial);
     }
@@ -635,18 +891,7 @@ void CZerocoinState::RemoveBlock(CBlockIndex *index) {
         }
     }
 
-    // roll back mints
-    for(const pair<pair<int,int>,vector<CBigNum>> &pubCoins: index->mintedPubCoins) {
-        BOOST_FOREACH(const CBigNum &coin, pubCoins.second) {
-            auto coins = mintedPubCoins.equal_range(coin);
-            auto coinIt = find_if(coins.first, coins.second, [=](const decltype(mintedPubCoins)::value_type &v) {
-                return v.second.denomination == pubCoins.first.first &&
-                        v.second.id == pubCoins.first.second;
-            });
-            assert(coinIt != mintedPubCoins.end());
-            mintedPubCoins.erase(coinIt);
-        }
-    }
+    // mints stay in the zerocoin database, lookups ignore the ones from blocks that are not in the active chain
 
     // roll back spends
     BOOST_FOREACH(const CBigNum &serial, index->spentSerials) {
@@ -667,8 +912,18 @@ bool CZerocoinState::IsUsedCoinSerial(const CBigNum &coinSerial) {
     return usedCoinSerials.count(coinSerial) != 0;
 }
 
+// Records in the zerocoin database are not rolled back on reorg, only the ones from blocks of the active chain count
+static bool IsMintInActiveChain(const CZerocoinMintInfo &mintInfo) {
+    const CBlockIndex *pindex = chainActive[mintInfo.nHeight];
+    return pindex != NULL && pindex->GetBlockHash() == mintInfo.blockHash;
+}
+
 bool CZerocoinState::HasCoin(const CBigNum &pubCoin) {
-    return mintedPubCoins.count(pubCoin) != 0;
+    vector<CZerocoinMintInfo> mints;
+    if (!pzerocoindb || !pzerocoindb->ReadMintInfo(pubCoin, mints))
+        return false;
+
+    return any_of(mints.begin(), mints.end(), IsMintInActiveChain);
 }
 
 int CZerocoinState::GetAccumulatorValueForSpend(CChain *chain, int maxHeight, int denomination, int id, CBigNum &accumulator, uint256 &blockHash) {
@@ -689,7 +944,7 @@ int CZerocoinState::GetAccumulatorValueForSpend(CChain *chain, int maxHeight, in
 
     int numberOfCoins = 0;
     for (;;) {
-        map<pair<int,int>, pair<CBigNum,int>> &accumulatorChanges = lastBlock->*accChangeField;
+        auto &accumulatorChanges = lastBlock->*accChangeField;
         if (accumulatorChanges.count(denomAndId) > 0) {
             if (lastBlock->nHeight <= maxHeight) {
                 if (numberOfCoins == 0) {
@@ -710,6 +965,46 @@ int CZerocoinState::GetAccumulatorValueForSpend(CChain *chain, int maxHeight, in
     return numberOfCoins;
 }
 
+bool CZerocoinState::GetWitnessData(CChain *chain, int denomination, int id, int fromHeight, int toHeight, size_t nMaxBlocks,
+                                    CBigNum &checkpoint, CBlockIndex *&checkpointBlock, vector<WitnessBlock> &blocks) {
+    pair<int, int> denomAndId = pair<int, int>(denomination, id);
+
+    blocks.clear();
+    auto group = coinGroups.find(denomAndId);
+    if (group == coinGroups.end() || fromHeight < 0 || fromHeight > toHeight)
+        return false;
+    const CoinGroupInfo &coinGroup = group->second;
+
+    // Latest accumulator value before fromHeight
+    checkpoint = libzerocoin::Accumulator(ZCParams, (libzerocoin::CoinDenomination)denomination).getValue();
+    checkpointBlock = NULL;
+    if (fromHeight > coinGroup.firstBlock->nHeight) {
+        CBlockIndex *block = (*chain)[std::min(fromHeight - 1, coinGroup.lastBlock->nHeight)];
+        while (block->accumulatorChanges.count(denomAndId) == 0)
+            block = block->pprev;
+        checkpoint = block->accumulatorChanges[denomAndId].first;
+        checkpointBlock = block;
+    }
+
+    // Blocks minting coins of the group from fromHeight, collected backwards
+    int lastHeight = std::min(toHeight, coinGroup.lastBlock->nHeight);
+    int firstHeight = std::max(fromHeight, coinGroup.firstBlock->nHeight);
+    for (CBlockIndex *block = (*chain)[lastHeight]; block && block->nHeight >= firstHeight; block = block->pprev) {
+        if (block->accumulatorChanges.count(denomAndId) == 0)
+            continue;
+        blocks.push_back(WitnessBlock());
+        blocks.back().index = block;
+        blocks.back().accumulator = block->accumulatorChanges[denomAndId].first;
+    }
+    std::reverse(blocks.begin(), blocks.end());
+    if (blocks.size() > nMaxBlocks)
+        blocks.resize(nMaxBlocks);
+
+    for (WitnessBlock &block : blocks)
+        block.mints = GetBlockMints(block.index, denomination, id);
+    return true;
+}
+
 libzerocoin::AccumulatorWitness CZerocoinState::GetWitnessForSpend(CChain *chain, int maxHeight, int denomination, int id, const CBigNum &pubCoin) {
     libzerocoin::CoinDenomination d = (libzerocoin::CoinDenomination)denomination;
     pair<int, int> denomAndId = pair<int, int>(denomination, id);
@@ -737,8 +1032,8 @@ libzerocoin::AccumulatorWitness CZerocoinState::GetWitnessForSpend(CChain *chain
     // Now add to the accumulator every coin minted since that moment except pubCoin
     block = coinGroup.lastBlock;
     while(true) {
-        if (block->nHeight <= maxHeight && block->mintedPubCoins.count(denomAndId) > 0) {
-            vector<CBigNum> &pubCoins = block->mintedPubCoins[denomAndId];
+        if (block->nHeight <= maxHeight && block->accumulatorChanges.count(denomAndId) > 0) {
+            vector<CBigNum> pubCoins = GetBlockMints(block, denomination, id);
             for (const CBigNum &coin: pubCoins) {
                 if (block != mintBlock || coin != pubCoin)
                     accumulator += libzerocoin::PublicCoin(ZCParams, coin, d);
@@ -754,25 +1049,52 @@ libzerocoin::AccumulatorWitness CZerocoinState::GetWitnessForSpend(CChain *chain
 }
 
 int CZerocoinState::GetMintedCoinHeightAndId(const CBigNum &pubCoin, int denomination, int &id) {
-    auto coins = mintedPubCoins.equal_range(pubCoin);
-    auto coinIt = find_if(coins.first, coins.second,
-                          [=](const decltype(mintedPubCoins)::value_type &v) { return v.second.denomination == denomination; });
+    vector<CZerocoinMintInfo> mints;
+    if (!pzerocoindb || !pzerocoindb->ReadMintInfo(pubCoin, mints))
+        return -1;
 
-    if (coinIt != mintedPubCoins.end()) {
-        id = coinIt->second.id;
-        return coinIt->second.nHeight;
+    for (const CZerocoinMintInfo &mintInfo: mints) {
+        if (mintInfo.denomination == denomination && IsMintInActiveChain(mintInfo)) {
+            id = mintInfo.id;
+            return mintInfo.nHeight;
+        }
     }
-    else
-        return -1;
+
+    return -1;
 }
 
 void CZerocoinState::Reset() {
     coinGroups.clear();
     usedCoinSerials.clear();
-    mintedPubCoins.clear();
     latestCoinIds.clear();
 }
 
+size_t BigNumDynamicUsage(const CBigNum &bn) {
+    // BN_new() allocates the structure (words pointer and four ints), the words are rounded to 8 bytes
+    return memusage::MallocUsage(sizeof(void *) + 4 * sizeof(int)) + memusage::MallocUsage((BN_num_bytes(&bn) + 7) & ~7);
+}
+
+size_t CZerocoinState::DynamicMemoryUsage() {
+    size_t usage = memusage::DynamicUsage(coinGroups) + memusage::DynamicUsage(usedCoinSerials) +
+            memusage::DynamicUsage(latestCoinIds);
+    for (const CBigNum &serial: usedCoinSerials)
+        usage += BigNumDynamicUsage(serial);
+
+    LOCK(cs_blockMintsCache);
+    usage += memusage::DynamicUsage(blockMintsCache);
+    for (const auto &blockMints: blockMintsCache) {
+        usage += memusage::DynamicUsage(blockMints.second);
+        for (const auto &groupMints: blockMints.second) {
+            usage += memusage::DynamicUsage(groupMints.second);
+            for (const CBigNum &pubCoin: groupMints.second)
+                usage += BigNumDynamicUsage(pubCoin);
+        }
+    }
+    // The deque keeps its elements in 512 byte blocks
+    usage += memusage::MallocUsage(512) * (blockMintsCacheOrder.size() * sizeof(uint256) / 512 + 1);
+    return usage;
+}
+
 CZerocoinState *CZerocoinState::GetZerocoinState() {
     return &zerocoinState;
 }
@@ -781,37 +1103,63 @@ CZerocoinState *CZerocoinState::GetZerocoinState() {
 set<CBlockIndex *> CZerocoinState::RecalculateAccumulators(CChain *chain) {
     set<CBlockIndex *> changes;
 
-    BOOST_FOREACH(const PAIRTYPE(PAIRTYPE(int,int), CoinGroupInfo) &coinGroup, coinGroups) {
-        // Skip non-modulusv2 groups
-
-        libzerocoin::Accumulator acc(&ZCParams->accumulatorParams, (libzerocoin::CoinDenomination)coinGroup.first.first);
+    // Groups are independent, recalculate them in parallel. Blocks may have mints of several groups, so new
+    // accumulator values are collected per group and applied to the index afterwards
+    typedef vector<pair<CBlockIndex *, pair<CBigNum,int>>> AccumulatorUpdates;
+    vector<pair<pair<int,int>, CoinGroupInfo>> groups(coinGroups.begin(), coinGroups.end());
+    vector<AccumulatorUpdates> updates(groups.size());
+    std::atomic<size_t> nGroupsDone(0);
+
+    libzerocoin::ParallelTasks::DoNotDisturb dnd;
+    libzerocoin::ParallelTasks recalculations(groups.size());
+
+    for (size_t i = 0; i < groups.size(); i++) {
+        recalculations.Add([this, i, chain, &groups, &updates, &nGroupsDone] {
+            const pair<int,int> &denomAndId = groups[i].first;
+            const CoinGroupInfo &coinGroup = groups[i].second;
+            libzerocoin::CoinDenomination denomination = (libzerocoin::CoinDenomination)denomAndId.first;
+
+            libzerocoin::Accumulator acc(&ZCParams->accumulatorParams, denomination);
+
+            // Try to calculate accumulator for the first batch of mints. If it doesn't match we need to recalculate the rest of it
+            CBlockIndex *block = coinGroup.firstBlock;
+            for (;;) {
+                auto accChange = block->accumulatorChanges.find(denomAndId);
+                if (accChange != block->accumulatorChanges.end()) {
+                    vector<CBigNum> pubCoins = GetBlockMints(block, denomAndId.first, denomAndId.second);
+                    BOOST_FOREACH(const CBigNum &pubCoin, pubCoins) {
+                        acc += libzerocoin::PublicCoin(ZCParams, pubCoin, denomination);
+                    }
 
-        // Try to calculate accumulator for the first batch of mints. If it doesn't match we need to recalculate the rest of it
-        CBlockIndex *block = coinGroup.second.firstBlock;
-        for (;;) {
-            if (block->accumulatorChanges.count(coinGroup.first) > 0) {
-                BOOST_FOREACH(const CBigNum &pubCoin, block->mintedPubCoins[coinGroup.first]) {
-                    acc += libzerocoin::PublicCoin(ZCParams, pubCoin, (libzerocoin::CoinDenomination)coinGroup.first.first);
-                }
+                    // First block case is special: do the check
+                    if (block == coinGroup.firstBlock) {
+                        if (acc.getValue() != accChange->second.first)
+                            // recalculation is needed
+                            LogPrint(BCLog::ZEROCOIN, "ZerocoinState: accumulator recalculation for denomination=%d, id=%d\n", denomAndId.first, denomAndId.second);
+                        else
+                            // everything's ok
+                            break;
+                    }
 
-                // First block case is special: do the check
-                if (block == coinGroup.second.firstBlock) {
-                    if (acc.getValue() != block->accumulatorChanges[coinGroup.first].first)
-                        // recalculation is needed
-                        LogPrintf("ZerocoinState: accumulator recalculation for denomination=%d, id=%d\n", coinGroup.first.first, coinGroup.first.second);
-                    else
-                        // everything's ok
-                        break;
+                    updates[i].push_back(make_pair(block, make_pair(acc.getValue(), (int)pubCoins.size())));
                 }
 
-                block->accumulatorChanges[coinGroup.first] = make_pair(acc.getValue(), (int)block->mintedPubCoins[coinGroup.first].size());
-                changes.insert(block);
+                if (block != coinGroup.lastBlock)
+                    block = (*chain)[block->nHeight+1];
+                else
+                    break;
             }
 
-            if (block != coinGroup.second.lastBlock)
-                block = (*chain)[block->nHeight+1];
-            else
-                break;
+            size_t nDone = ++nGroupsDone;
+            uiInterface.InitMessage(strprintf(_("Verifying zerocoin accumulators... (%u/%u)"), nDone, groups.size()));
+        });
+    }
+    recalculations.Wait();
+
+    for (size_t i = 0; i < groups.size(); i++) {
+        for (const pair<CBlockIndex *, pair<CBigNum,int>> &update: updates[i]) {
+            update.first->accumulatorChanges[groups[i].first] = update.second;
+            changes.insert(update.first);
         }
     }
 
@@ -827,41 +1175,13 @@ bool ZerocoinUpgradeBlockIndex(CChain *chain) {
     set<CBigNum> spentSerials;
     map<pair<int, int>, vector<CBigNum>> mintedCoins;
 
-    FILE	*blockFile = NULL;
-    int		nFile = -1;
-
     for (; blockIndex; blockIndex = chain->Next(blockIndex)) {
         CBlock	block;
-        CDiskBlockPos  pos = blockIndex->GetBlockPos();
-
-        if (pos.nFile != nFile) {
-            if (blockFile != NULL)
-                fclose(blockFile);
-            blockFile = OpenBlockFile(pos, true);
-        }
-        else {
-            fseek(blockFile, pos.nPos, SEEK_SET);
-        }
-
-        block.SetNull();
-        CAutoFile filein(blockFile, SER_DISK, CLIENT_VERSION);
-
-        if (filein.IsNull())
-            return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
-
-        try {
-            filein >> block;
-        }
-        catch (const std::exception &e) {
-            return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
-        }
-
-        filein.release();
+        // Blocks may be stored compressed, so read them the way validation does
+        if (!ReadBlockFromDisk(block, blockIndex, Params().GetConsensus()))
+            return error("%s: Failed to read block %s", __func__, blockIndex->GetBlockHash().ToString());
     }
 
-    if (blockFile != NULL)
-        fclose(blockFile);
-
     return true;
 }
 
@@ -876,12 +1196,13 @@ bool CZerocoinState::TestValidity(CChain *chain) {
         CBlockIndex *block = coinGroup.second.firstBlock;
         for (;;) {
             if (block->accumulatorChanges.count(coinGroup.first) > 0) {
-                if (block->mintedPubCoins.count(coinGroup.first) == 0) {
+                vector<CBigNum> pubCoins = GetBlockMints(block, coinGroup.first.first, coinGroup.first.second);
+                if (pubCoins.empty()) {
                     fprintf(stderr, "  no minted coins\n");
                     return false;
                 }
 
-                BOOST_FOREACH(const CBigNum &pubCoin, block->mintedPubCoins[coinGroup.first]) {
+                BOOST_FOREACH(const CBigNum &pubCoin, pubCoins) {
                     acc += libzerocoin::PublicCoin(zcParams, pubCoin, (libzerocoin::CoinDenomination)coinGroup.first.first);
                 }
 
@@ -890,7 +1211,7 @@ bool CZerocoinState::TestValidity(CChain *chain) {
                     return false;
                 }
 
-                if (block->accumulatorChanges[coinGroup.first].second != (int)block->mintedPubCoins[coinGroup.first].size()) {
+                if (block->accumulatorChanges[coinGroup.first].second != (int)pubCoins.size()) {
                     fprintf(stderr, "  number of minted coins mismatch at height %d\n", block->nHeight);
                     return false;
                 }
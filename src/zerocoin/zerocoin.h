@@ -7,17 +7,35 @@
 #include "coins.h"
 #include "chain.h"
 #include "chainparams.h"
+#include "hash.h"
 #include "libzerocoin/Zerocoin.h"
+#include <deque>
 #include <unordered_set>
 #include <unordered_map>
 #include <functional>
+#include <memory>
 
 #define ZEROCOIN_MODULUS   "C7970CEEDCC3B0754490201A7AA613CD73911081C790F5F1A8726F463550BB5B7FF0DB8E1EA1189EC72F93D1650011BD721AEEACC2ACDE32A04107F0648C2813A31F5B0B7765FF8B44B4B6FFC93384B646EB09C7CF5E8592D40EA33C80039F35B4F14A04B51F7BFD781BE4D1673164BA8EB991C2C4D730BBBE35F592BDEF524AF7E8DAEFD26C66FC02C479AF89D64D373F442709439DE66CEB955F3EA37D5159F6135809F85334B5CB1813ADDC80CD05609F10AC6A95AD65872C909525BDAD32BC729592642920F24C61DC5B3C3B7923E56B16A4D9D373D8721F24A3FC0F1B3131F55615172866BCCC30F95054C824E733A5EB6817F7BC16399D48C6361CC7E5"
 
+/** Default for -maxzerocoinspendcachesize, in MiB */
+static const int64_t DEFAULT_MAX_ZEROCOIN_SPEND_CACHE_SIZE = 2;
+/** Maximum zerocoin spend cache size allowed, in MiB */
+static const int64_t MAX_MAX_ZEROCOIN_SPEND_CACHE_SIZE = 1024;
+/** Default for -zcthreads, 0 means the same number as script verification threads */
+static const int DEFAULT_ZEROCOIN_THREADS = 0;
+/** Default for -checkzerocoinparams */
+static const bool DEFAULT_CHECK_ZEROCOIN_PARAMS = false;
+/** Default for -requirezcspendblockhash */
+static const bool DEFAULT_REQUIRE_ZEROCOIN_SPEND_BLOCK_HASH = true;
+
 // Zerocoin transaction info, added to the CBlock to ensure zerocoin mint/spend transactions got their info stored into
 // index
 // zerocoin parameters
 extern libzerocoin::Params *ZCParams;
+/** Derive the zerocoin parameters from ZEROCOIN_MODULUS and compare them with ZCParams, slow */
+bool CheckZerocoinParams();
+// Reject spends not referring to the block of their accumulator from the memory pool
+extern bool fRequireZerocoinSpendBlockHash;
 
 class CZerocoinTxInfo {
 public:
@@ -35,14 +53,97 @@ public:
     void Complete();
 };
 
+/**
+ * Closure representing one CoinSpend proof verification. CheckBlock collects these for every spend in the
+ * block and runs them on the zerocoin check queue, the same way CScriptCheck is used for scripts.
+ */
+class CZerocoinSpendCheck
+{
+private:
+    std::shared_ptr<libzerocoin::CoinSpend> spend;
+    uint256 txHashForMetadata;
+    // nonced hash of the serialized spend and its metadata, used to look the spend up in the cache
+    uint256 spendHash;
+    uint32_t pubcoinId;
+    libzerocoin::CoinDenomination denomination;
+    // latest and earliest blocks whose accumulator values may be tried
+    CBlockIndex *index;
+    CBlockIndex *firstBlock;
+    // spend refers to a particular accumulator block, don't search further back
+    bool fSingleAccumulator;
+    int nHeight;
+    // remember a successful verification in the spend cache, instead of evicting a cache hit
+    bool fCacheStore;
+    // accumulator values of the blocks from index back, copied by CopyAccumulators
+    std::vector<CBigNum> vAccumulators;
+    bool fAccumulatorsCopied;
+
+public:
+    CZerocoinSpendCheck(): pubcoinId(0), denomination(libzerocoin::ZQ_ONE), index(NULL), firstBlock(NULL), fSingleAccumulator(false), nHeight(0),
+                           fCacheStore(false), fAccumulatorsCopied(false) {}
+    CZerocoinSpendCheck(const std::shared_ptr<libzerocoin::CoinSpend> &spendIn, const uint256 &txHashForMetadataIn, const uint256 &spendHashIn,
+                        uint32_t pubcoinIdIn, libzerocoin::CoinDenomination denominationIn, CBlockIndex *indexIn, CBlockIndex *firstBlockIn,
+                        bool fSingleAccumulatorIn, int nHeightIn, bool fCacheStoreIn) :
+        spend(spendIn), txHashForMetadata(txHashForMetadataIn), spendHash(spendHashIn), pubcoinId(pubcoinIdIn), denomination(denominationIn),
+        index(indexIn), firstBlock(firstBlockIn), fSingleAccumulator(fSingleAccumulatorIn), nHeight(nHeightIn), fCacheStore(fCacheStoreIn),
+        fAccumulatorsCopied(false) {}
+
+    bool operator()();
+
+    /**
+     * Copy the accumulator values the spend may be verified against out of the block index, so that the
+     * check can run without cs_main held while blocks are connected. Requires cs_main
+     */
+    void CopyAccumulators();
+
+    void swap(CZerocoinSpendCheck &check) {
+        std::swap(spend, check.spend);
+        std::swap(txHashForMetadata, check.txHashForMetadata);
+        std::swap(spendHash, check.spendHash);
+        std::swap(pubcoinId, check.pubcoinId);
+        std::swap(denomination, check.denomination);
+        std::swap(index, check.index);
+        std::swap(firstBlock, check.firstBlock);
+        std::swap(fSingleAccumulator, check.fSingleAccumulator);
+        std::swap(nHeight, check.nHeight);
+        std::swap(fCacheStore, check.fCacheStore);
+        vAccumulators.swap(check.vAccumulators);
+        std::swap(fAccumulatorsCopied, check.fAccumulatorsCopied);
+    }
+};
+
+/** Initializes the zerocoin spend verification cache */
+void InitZerocoinSpendCache();
+
 bool CheckDevFundInputs(const CTransaction &tx, CValidationState &state, int nHeight, bool fTestNet);
+// If pvChecks is not NULL, spend proofs are not verified but pushed onto it for deferred verification
 bool CheckZerocoinTransaction(const CTransaction &tx,
     CValidationState &state,
     uint256 hashTx,
     bool isVerifyDB,
     int nHeight,
     bool isCheckWallet,
-    CZerocoinTxInfo *zerocoinTxInfo);
+    CZerocoinTxInfo *zerocoinTxInfo,
+    std::vector<CZerocoinSpendCheck> *pvChecks = NULL);
+
+/** Hash a coin serial is known by in the memory pool */
+uint256 GetZerocoinSerialHash(const CBigNum &serial);
+/**
+ * Hashes of the coin serials a transaction's zerocoin spends spend, read without verifying the spends.
+ * Returns false if a spend can't be deserialized
+ */
+bool GetZerocoinSpendSerialHashes(const CTransaction &tx, std::vector<uint256> &vSerialHashes);
+
+/**
+ * Token recording that this node verified the zerocoin spends of tx, keyed with a node-local salt and tied to the
+ * accumulator values the spends refer to. Spends that don't name their accumulator block get none. Requires cs_main
+ */
+bool GetZerocoinSpendToken(const CTransaction &tx, const uint256 &salt, uint256 &token);
+/**
+ * If token is the one GetZerocoinSpendToken gives tx against the current accumulator values, record its spends as
+ * verified in the spend cache, so that accepting tx into the memory pool doesn't verify them again. Requires cs_main
+ */
+bool TrustZerocoinSpendToken(const CTransaction &tx, const uint256 &salt, const uint256 &token);
 
 void DisconnectTipGhost(CBlock &block, CBlockIndex *pindexDelete);
 bool ConnectBlockGhost(CValidationState &state, const CChainParams &chainparams, CBlockIndex *pindexNew, const CBlock *pblock);
@@ -51,6 +152,37 @@ int ZerocoinGetNHeight(const CBlockHeader &block);
 
 bool ZerocoinBuildStateFromIndex(CChain *chain, set<CBlockIndex *> &changes);
 
+/**
+ * Salted SipHash of the value of a big number, for unordered containers of coin serials. Serials are
+ * chosen by whoever mints the coin, the salt keeps them from being picked to land in the same bucket
+ */
+class SaltedBigNumHasher
+{
+private:
+    /** Salt */
+    const uint64_t k0, k1;
+
+    /** Values up to this size are hashed without allocating */
+    static const int nMaxStackBytes = 512;
+
+public:
+    SaltedBigNumHasher();
+
+    size_t operator()(const CBigNum &bn) const {
+        unsigned char data[nMaxStackBytes];
+        int nBytes = BN_num_bytes(&bn);
+        if (nBytes > nMaxStackBytes) {
+            vector<unsigned char> bnData = bn.ToBytes();
+            return CSipHasher(k0, k1).Write(bnData.data(), bnData.size()).Finalize();
+        }
+        BN_bn2bin(&bn, data);
+        return CSipHasher(k0, k1).Write(data, nBytes).Finalize();
+    }
+};
+
+/** Heap memory of a big number: its BIGNUM structure and the words of its value */
+size_t BigNumDynamicUsage(const CBigNum &bn);
+
 /*
  * State of minted/spent coins as extracted from the index
  */
@@ -69,26 +201,19 @@ public:
     };
 
 private:
-    // Custom hash for big numbers
-    struct CBigNumHash {
-        std::size_t operator()(const CBigNum &bn) const noexcept;
-    };
-
-    struct CMintedCoinInfo {
-        int         denomination;
-        int         id;
-        int         nHeight;
-    };
-
     // Collection of coin groups. Map from <denomination,id> to CoinGroupInfo structure
     map<pair<int, int>, CoinGroupInfo> coinGroups;
     // Set of all used coin serials. Allows multiple entries for the same coin serial for historical reasons
-    unordered_multiset<CBigNum,CBigNumHash> usedCoinSerials;
-    // Set of all minted pubCoin values
-    unordered_multimap<CBigNum,CMintedCoinInfo,CBigNumHash> mintedPubCoins;
+    unordered_multiset<CBigNum,SaltedBigNumHasher> usedCoinSerials;
     // Latest IDs of coins by denomination
     map<int, int> latestCoinIds;
 
+    // Minted pubCoin values live in the zerocoin database, mints of recently used blocks are cached here
+    static const size_t nMaxBlockMintsCacheSize = 256;
+    CCriticalSection cs_blockMintsCache;
+    map<uint256, map<pair<int,int>, vector<CBigNum>>> blockMintsCache;
+    deque<uint256> blockMintsCacheOrder;
+
 public:
     CZerocoinState();
 
@@ -96,6 +221,8 @@ public:
     int AddMint(CBlockIndex *index, int denomination, const CBigNum &pubCoin, CBigNum &previousAccValue);
     // Add serial to the list of used ones
     void AddSpend(const CBigNum &serial);
+    // Store public coins minted in the block in the zerocoin database
+    bool AddBlockMints(CBlockIndex *index, const map<pair<int,int>, vector<CBigNum>> &mints);
 
     // Add everything from the block to the state
     void AddBlock(CBlockIndex *index);
@@ -110,11 +237,28 @@ public:
     // Query if there is a coin with given pubCoin value
     bool HasCoin(const CBigNum &pubCoin);
 
+    // Public coins with given denomination and id minted in the block
+    vector<CBigNum> GetBlockMints(const CBlockIndex *index, int denomination, int id);
+
     // Given denomination and id returns latest accumulator value and corresponding block hash
     // Do not take into account coins with height more than maxHeight
     // Returns number of coins satisfying conditions
     int GetAccumulatorValueForSpend(CChain *chain, int maxHeight, int denomination, int id, CBigNum &accumulator, uint256 &blockHash);
 
+    // Coins of a group minted in one block and the accumulator value after the block
+    struct WitnessBlock {
+        CBlockIndex *index;
+        CBigNum accumulator;
+        vector<CBigNum> mints;
+    };
+
+    // Data a light wallet updates the witnesses of its coins with: the accumulator value of the group before
+    // fromHeight (checkpointBlock is NULL if no coins were minted before) and the first nMaxBlocks blocks from
+    // fromHeight up to toHeight that mint coins of the group. A coin's witness is the accumulator before its
+    // block plus every other coin minted since, so it can be brought forward from any checkpoint. Requires cs_main
+    bool GetWitnessData(CChain *chain, int denomination, int id, int fromHeight, int toHeight, size_t nMaxBlocks,
+                        CBigNum &checkpoint, CBlockIndex *&checkpointBlock, vector<WitnessBlock> &blocks);
+
     // Get witness
     libzerocoin::AccumulatorWitness GetWitnessForSpend(CChain *chain, int maxHeight, int denomination, int id, const CBigNum &pubCoin);
 
@@ -124,6 +268,9 @@ public:
     // Reset to initial values
     void Reset();
 
+    // Estimate of the heap memory used by the state and the mints cache. Requires cs_main
+    size_t DynamicMemoryUsage();
+
     // Test function
     bool TestValidity(CChain *chain);
 
@@ -0,0 +1,151 @@
+#ifndef NIX_ZEROCOIN_ZEROCOINPARAMS_H
+#define NIX_ZEROCOIN_ZEROCOINPARAMS_H
+/**
+ * libzerocoin::Params for ZEROCOIN_MODULUS at ZEROCOIN_DEFAULT_SECURITYLEVEL, in
+ * network serialization, so that startup does not search for the group primes.
+ *
+ * The derivation is repeated and compared by -checkzerocoinparams and
+ * zerocoin_params_tests. On a mismatch -checkzerocoinparams logs the derived
+ * serialization, which replaces this table.
+ */
+static const unsigned char zerocoin_params_serialized[] = {
+    0x01,0x01,0xfd,0x01,0x01,0xe5,0xc7,0x1c,0x36,0xc6,0x48,0x9d,0x39,0x16,0xbc,0xf7,
+    0x17,0x68,0xeb,0xa5,0x33,0xe7,0x24,0xc8,0x54,0x50,0xf9,0x30,0xcc,0xbc,0x66,0x28,
+    0x17,0x15,0x56,0xf5,0x31,0x31,0x1b,0x0f,0xfc,0xa3,0x24,0x1f,0x72,0xd8,0x73,0xd3,
+    0xd9,0xa4,0x16,0x6b,0xe5,0x23,0x79,0x3b,0x3c,0x5b,0xdc,0x61,0x4c,0xf2,0x20,0x29,
+    0x64,0x92,0x95,0x72,0xbc,0x32,0xad,0xbd,0x25,0x95,0x90,0x2c,0x87,0x65,0xad,0x95,
+    0x6a,0xac,0x10,0x9f,0x60,0x05,0xcd,0x80,0xdc,0xad,0x13,0x18,0xcb,0xb5,0x34,0x53,
+    0xf8,0x09,0x58,0x13,0xf6,0x59,0x51,0x7d,0xa3,0x3e,0x5f,0x95,0xeb,0x6c,0xe6,0x9d,
+    0x43,0x09,0x27,0x44,0x3f,0x37,0x4d,0xd6,0x89,0xaf,0x79,0xc4,0x02,0xfc,0x66,0x6c,
+    0xd2,0xef,0xda,0xe8,0xf7,0x4a,0x52,0xef,0xbd,0x92,0xf5,0x35,0xbe,0xbb,0x30,0xd7,
+    0xc4,0xc2,0x91,0xb9,0x8e,0xba,0x64,0x31,0x67,0xd1,0xe4,0x1b,0x78,0xfd,0x7b,0x1f,
+    0xb5,0x04,0x4a,0xf1,0xb4,0x35,0x9f,0x03,0x80,0x3c,0xa3,0x0e,0xd4,0x92,0x85,0x5e,
+    0xcf,0xc7,0x09,0xeb,0x46,0xb6,0x84,0x33,0xc9,0xff,0xb6,0xb4,0x44,0x8b,0xff,0x65,
+    0x77,0x0b,0x5b,0x1f,0xa3,0x13,0x28,0x8c,0x64,0xf0,0x07,0x41,0xa0,0x32,0xde,0xac,
+    0xc2,0xac,0xee,0x1a,0x72,0xbd,0x11,0x00,0x65,0xd1,0x93,0x2f,0xc7,0x9e,0x18,0xa1,
+    0x1e,0x8e,0xdb,0xf0,0x7f,0x5b,0xbb,0x50,0x35,0x46,0x6f,0x72,0xa8,0xf1,0xf5,0x90,
+    0xc7,0x81,0x10,0x91,0x73,0xcd,0x13,0xa6,0x7a,0x1a,0x20,0x90,0x44,0x75,0xb0,0xc3,
+    0xdc,0xee,0x0c,0x97,0xc7,0x00,0x02,0xc1,0x03,0x00,0x46,0xa7,0x0b,0x1c,0x22,0xc3,
+    0x9c,0x96,0x79,0x56,0x8d,0x2e,0x99,0x99,0x8d,0xef,0xf5,0x1d,0x10,0x32,0x63,0xde,
+    0x21,0xc2,0xdb,0x04,0x59,0x6b,0xfa,0x7c,0x83,0xd7,0x04,0xf0,0x5e,0xba,0x4c,0x32,
+    0x99,0xa5,0x20,0x0d,0xbb,0x54,0xaf,0x59,0xb3,0x4a,0x90,0x22,0xad,0xeb,0xf1,0x4b,
+    0xa5,0xf5,0x0f,0x51,0x9a,0x40,0xe0,0x56,0x17,0xd4,0xc6,0x8a,0x64,0x8e,0x86,0xd5,
+    0x01,0x46,0x86,0x3a,0xc2,0x2a,0xb1,0x14,0x2d,0x0b,0x67,0x40,0x4f,0x3d,0x0c,0x46,
+    0x76,0x05,0x31,0xe8,0x8b,0x83,0x64,0x40,0xeb,0xdc,0x86,0xe3,0xf3,0xad,0x8c,0xbd,
+    0x82,0xfd,0x69,0x2e,0x57,0xd9,0x3c,0xed,0xb4,0x1d,0x3e,0xb6,0x42,0x10,0x49,0x94,
+    0x12,0x62,0x7f,0x9c,0x42,0x95,0x29,0x70,0x4e,0x79,0xce,0x96,0x97,0xad,0xe6,0xf6,
+    0x29,0x67,0xa6,0xf9,0x7f,0xf4,0x08,0x04,0x46,0x71,0xb8,0xd7,0xa5,0xed,0x0b,0xf1,
+    0x50,0xd5,0x96,0x79,0x80,0xc9,0x2e,0xf1,0x06,0xda,0xe8,0xe9,0x99,0x19,0x00,0x9b,
+    0x84,0x09,0x98,0x8c,0xd4,0x80,0x2a,0x44,0x2a,0x92,0x0a,0xfd,0x6b,0x25,0xda,0xff,
+    0x97,0xa5,0x19,0xa3,0xdf,0xff,0x13,0xaf,0xb6,0x1f,0x58,0x73,0xaa,0x7a,0x1b,0x19,
+    0x09,0x08,0x66,0xbb,0xdb,0x96,0x72,0x02,0x45,0xa9,0x5f,0x78,0xb3,0x09,0x0f,0x21,
+    0x5f,0xb2,0x38,0x2f,0xf7,0x77,0x07,0x91,0x0d,0xa8,0x1c,0xac,0xbb,0x2c,0x97,0x68,
+    0x8f,0xe4,0xf3,0xd3,0xd8,0x8d,0xda,0xf6,0xee,0x7d,0x55,0x51,0x50,0x6b,0x3c,0x72,
+    0x01,0x00,0xfd,0x00,0x01,0x3a,0xf6,0x77,0x73,0xe9,0x6c,0x96,0x75,0x50,0x70,0x8d,
+    0xd5,0x69,0x17,0x5f,0xf4,0xfc,0x93,0xe2,0x36,0x23,0x90,0x7e,0x9c,0x6b,0xf1,0x51,
+    0x5e,0x6c,0xa9,0x69,0xf2,0x76,0xf1,0x70,0x5b,0x77,0x79,0xa3,0x67,0xe9,0x18,0x2b,
+    0x36,0xcf,0xba,0xb2,0x1b,0x24,0xfe,0x8c,0x1e,0x4a,0xb8,0xf4,0x69,0xd1,0xcc,0xf6,
+    0x0e,0xad,0x69,0x93,0xd8,0x49,0x6f,0x1e,0x40,0x71,0xc1,0xf2,0x22,0xe0,0xea,0xc9,
+    0xb4,0x43,0x11,0x3c,0x95,0xf7,0x21,0xc2,0x97,0x92,0x57,0xf0,0x45,0x94,0x08,0x7b,
+    0x6e,0x5f,0xae,0x7d,0x48,0xba,0x32,0x19,0x49,0x73,0x31,0x00,0xfb,0x4d,0xd6,0x69,
+    0x48,0x02,0x36,0x29,0x6d,0x23,0x79,0x7b,0x1a,0xd6,0xca,0x71,0xec,0x66,0xb2,0x83,
+    0x87,0xc5,0x11,0xd9,0x0b,0xb0,0x45,0xbc,0x8f,0x31,0xd5,0x57,0xc9,0xd8,0x2e,0x19,
+    0xbc,0x4f,0x6b,0xb9,0x20,0xe3,0xa5,0x1e,0x7a,0x5d,0x80,0x9c,0x13,0xa5,0xc6,0x31,
+    0x96,0x8d,0xf4,0x9f,0xea,0xfb,0x2d,0x18,0x79,0x4a,0x3b,0x0d,0x81,0xed,0x04,0x7a,
+    0xe4,0x16,0xd2,0x2b,0xd9,0x90,0x1d,0xa2,0x90,0x74,0xad,0x0e,0x56,0x29,0x64,0xd3,
+    0xc7,0x91,0x06,0x44,0x67,0xda,0x0f,0x68,0x28,0x23,0x10,0xa0,0xf5,0xca,0xb2,0x69,
+    0x1d,0x2b,0xb5,0x1a,0x6b,0xe0,0x79,0x58,0x7b,0x98,0x8a,0x6b,0x63,0xcd,0xfe,0xfe,
+    0x28,0x79,0x13,0x24,0xff,0x4a,0x1e,0xce,0x68,0xb9,0x6d,0xfd,0xb0,0xff,0xca,0x72,
+    0x2b,0xfc,0x97,0xc0,0xba,0xf9,0xda,0x77,0x4d,0xbb,0xbe,0xca,0xc9,0xfe,0x4a,0x2b,
+    0x4e,0x56,0xdc,0x24,0x63,0xfd,0x00,0x01,0x02,0xd8,0x47,0xef,0xc6,0x64,0xc5,0xb5,
+    0xf7,0xb6,0xe9,0xdc,0x95,0xd3,0x8f,0xb4,0x62,0x2a,0x44,0x84,0x28,0x4e,0x74,0x36,
+    0x4f,0x8a,0xb3,0x60,0x6d,0x4b,0x6a,0x9e,0x10,0xa2,0xf6,0x3c,0x32,0x00,0x7d,0xe9,
+    0x79,0x91,0xeb,0x26,0x60,0x9a,0x64,0xe1,0x5c,0xa8,0x56,0x7f,0x80,0xec,0x34,0x02,
+    0xf0,0x16,0xb1,0x11,0xfe,0x21,0x47,0xf6,0xd0,0x0e,0xf5,0x51,0xcb,0xd7,0x0b,0x32,
+    0xee,0x28,0xf1,0x57,0x07,0x39,0xe0,0xfa,0xa4,0xc6,0x4d,0x2d,0xdc,0xbb,0x91,0x25,
+    0x66,0x00,0x0e,0xf7,0x14,0x8a,0x35,0xa0,0x73,0x10,0x9e,0xc4,0x63,0x78,0xcd,0xac,
+    0x02,0x44,0x26,0xe7,0x85,0xa5,0x22,0x8d,0xc6,0xe2,0xea,0xbf,0xa9,0xeb,0x04,0xb8,
+    0x9f,0xe0,0x4c,0x1b,0x37,0xc7,0x46,0xf1,0x50,0x45,0x57,0xb2,0x62,0xb2,0xcb,0x45,
+    0xd3,0x05,0x79,0x00,0x77,0xd4,0x39,0x4b,0x32,0x68,0x19,0xf2,0x35,0xcc,0xe0,0x29,
+    0xaa,0x4c,0x21,0x08,0xf5,0x59,0x5a,0x3b,0xd7,0x75,0x7d,0xcc,0xd2,0x61,0x10,0x7c,
+    0xb3,0xcf,0xce,0x78,0x6b,0xb7,0xb6,0x4e,0x0d,0x0f,0xa1,0xbd,0x4d,0x45,0xa4,0x11,
+    0x61,0xb1,0x52,0x92,0xfd,0x38,0x6f,0x72,0x48,0xb4,0x37,0xbd,0x4e,0x74,0x7d,0x2b,
+    0x01,0x4e,0x1d,0x49,0x11,0x77,0x39,0xd9,0xbe,0x07,0x7e,0xe4,0x4f,0x52,0x6d,0x2b,
+    0xf5,0xd3,0xd4,0x12,0xfd,0xb2,0xd2,0x81,0xf0,0x30,0xa7,0x7f,0xef,0x64,0x0c,0xea,
+    0x95,0x57,0xd2,0xec,0x0f,0xaf,0x12,0x36,0x15,0x1b,0xfb,0x52,0x3d,0xed,0x60,0x25,
+    0xbd,0xc4,0x09,0xd1,0x57,0xbe,0xa3,0x61,0x00,0x00,0x41,0x00,0x00,0x00,0x00,0x00,
+    0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+    0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+    0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
+    0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x08,0x81,0x41,0xa2,0x3b,
+    0x72,0x24,0x30,0x93,0x2b,0x8d,0x50,0xc2,0x37,0x1d,0x96,0xf7,0x97,0x60,0x2c,0x96,
+    0x9c,0xd7,0x85,0x37,0x67,0x1d,0x5f,0x6f,0x5c,0x71,0x2f,0xf8,0x38,0xe4,0x0b,0xac,
+    0x75,0x93,0xee,0xc4,0x2e,0xdd,0xe1,0x8f,0x91,0xd4,0x3f,0xe9,0xd4,0xe9,0x15,0x08,
+    0xdd,0xf5,0xe2,0xf9,0x09,0xec,0x2c,0x37,0x59,0x3d,0x9e,0x64,0x41,0x83,0x47,0x1b,
+    0x6b,0x98,0xbc,0x4b,0x89,0x82,0x7d,0xe6,0xc7,0x01,0x72,0xa4,0x29,0x77,0x03,0xd9,
+    0xa0,0x80,0x94,0xe5,0xc0,0xca,0x26,0x32,0x79,0x4e,0x26,0xae,0x72,0x5e,0x6f,0x70,
+    0x44,0x28,0x9a,0x47,0x94,0x36,0xc9,0x5d,0xf5,0x54,0x60,0x8a,0x67,0xd6,0x40,0xe3,
+    0x73,0x83,0xf8,0x17,0x8e,0x6f,0x67,0xc4,0xf7,0x6c,0xc4,0xf1,0xe5,0x00,0xa0,0x00,
+    0x00,0x00,0x80,0x00,0x00,0x00,0x00,0x81,0x62,0x41,0xdd,0xd0,0xfb,0x4f,0xf0,0x13,
+    0x56,0x44,0xfc,0x6a,0x01,0xa3,0x05,0xd1,0xb4,0x1e,0xb7,0x26,0xf8,0xd0,0x65,0xa5,
+    0xf1,0x6c,0x09,0x10,0xfe,0xec,0xf5,0x0c,0xf7,0x4d,0x55,0x17,0x1d,0x03,0xa5,0xaa,
+    0xd5,0x83,0xab,0xa9,0xd4,0xf6,0x81,0x93,0xd3,0xe5,0xa6,0xb2,0x48,0x3a,0x1e,0x29,
+    0xed,0x21,0xad,0xe7,0x2a,0x84,0x5c,0xd4,0xc6,0xdf,0x7a,0xf8,0xf2,0x1c,0x67,0xac,
+    0x39,0x1e,0xc4,0x46,0x32,0x71,0xdd,0x45,0x7f,0x33,0xda,0xa1,0xeb,0xd3,0xe7,0x63,
+    0xec,0x5c,0x91,0x29,0xc4,0x05,0xb0,0x15,0x9a,0xb2,0x63,0x82,0xfd,0xf9,0xcc,0xb3,
+    0x0f,0x25,0xd9,0xdc,0x23,0x28,0x1b,0xf9,0xb4,0x59,0xcb,0xb6,0x9a,0x01,0x50,0x8e,
+    0x25,0x79,0xfa,0x8d,0x50,0xd6,0x7f,0x9a,0x00,0x81,0x22,0x86,0xd3,0xd3,0xea,0x48,
+    0xf7,0x99,0x4f,0x41,0x97,0x4a,0x60,0x91,0xf9,0x67,0x93,0x1d,0x47,0xc1,0x88,0x3b,
+    0x32,0x6c,0xb6,0x29,0xef,0xf0,0x99,0x95,0xb7,0x92,0xd9,0xa0,0x1c,0x5e,0xfa,0x12,
+    0xda,0x6a,0xf2,0x17,0xce,0xea,0xbc,0xf7,0xbe,0x84,0x9b,0x3f,0x2e,0xf5,0xc4,0x38,
+    0x03,0x8f,0x23,0x87,0x2e,0xb3,0xb9,0xe3,0x0f,0x79,0x25,0x04,0x04,0x98,0x63,0x0e,
+    0x11,0x0d,0x14,0x54,0xb5,0xa7,0xc1,0x44,0xf7,0x4d,0x74,0x0b,0xd2,0x6f,0x0c,0x4d,
+    0x5e,0xff,0xac,0x23,0x95,0xb4,0x8e,0xe6,0xe6,0xf0,0xac,0x94,0xdc,0x6d,0xfe,0x84,
+    0x31,0xc6,0x3e,0x38,0xb7,0xeb,0x9e,0x38,0x60,0x7b,0x19,0x7b,0xee,0x25,0xb6,0x28,
+    0x97,0xa1,0xfb,0x3c,0xe2,0x9d,0x46,0xdd,0xbb,0xcc,0x00,0x81,0x41,0xa2,0x3b,0x72,
+    0x24,0x30,0x93,0x2b,0x8d,0x50,0xc2,0x37,0x1d,0x96,0xf7,0x97,0x60,0x2c,0x96,0x9c,
+    0xd7,0x85,0x37,0x67,0x1d,0x5f,0x6f,0x5c,0x71,0x2f,0xf8,0x38,0xe4,0x0b,0xac,0x75,
+    0x93,0xee,0xc4,0x2e,0xdd,0xe1,0x8f,0x91,0xd4,0x3f,0xe9,0xd4,0xe9,0x15,0x08,0xdd,
+    0xf5,0xe2,0xf9,0x09,0xec,0x2c,0x37,0x59,0x3d,0x9e,0x64,0x41,0x83,0x47,0x1b,0x6b,
+    0x98,0xbc,0x4b,0x89,0x82,0x7d,0xe6,0xc7,0x01,0x72,0xa4,0x29,0x77,0x03,0xd9,0xa0,
+    0x80,0x94,0xe5,0xc0,0xca,0x26,0x32,0x79,0x4e,0x26,0xae,0x72,0x5e,0x6f,0x70,0x44,
+    0x28,0x9a,0x47,0x94,0x36,0xc9,0x5d,0xf5,0x54,0x60,0x8a,0x67,0xd6,0x40,0xe3,0x73,
+    0x83,0xf8,0x17,0x8e,0x6f,0x67,0xc4,0xf7,0x6c,0xc4,0xf1,0xe5,0x00,0x21,0xe3,0xf9,
+    0x6a,0x57,0xe8,0xfa,0x87,0x04,0x15,0xda,0x0a,0xad,0xd7,0x64,0x83,0x4a,0x66,0x57,
+    0xb5,0x22,0x03,0xf5,0xa5,0x1a,0xf5,0xfe,0x03,0xeb,0xfc,0x39,0x3a,0xa3,0x00,0x00,
+    0x81,0x32,0x00,0x99,0x86,0x28,0xda,0x29,0x54,0x09,0xd5,0xbc,0x20,0x40,0x7d,0x85,
+    0x5e,0xa1,0xdb,0x59,0x30,0x42,0x46,0xd4,0xa5,0x82,0x44,0xf3,0x7a,0x7e,0xd1,0x91,
+    0x6c,0x34,0xe6,0x72,0x2d,0x5a,0x9c,0xc7,0xee,0x70,0x8e,0x88,0xc8,0xd4,0x89,0xd5,
+    0xdb,0xe8,0x71,0xd1,0x19,0x7c,0xad,0xc7,0x04,0xd1,0x2e,0xf8,0x85,0x46,0xed,0x2b,
+    0x4b,0x51,0xc3,0x3d,0x7e,0xe6,0x75,0xfc,0x63,0xfe,0x7e,0xeb,0xbd,0x58,0xb6,0x6c,
+    0x83,0x08,0xfc,0xc9,0x25,0xee,0x1f,0x0a,0x9b,0x48,0xee,0xaf,0x90,0x41,0x2e,0xaa,
+    0xd5,0x17,0xfa,0x59,0x43,0x73,0xfe,0xd4,0x7d,0xe1,0x3c,0x04,0xb3,0x97,0x77,0x08,
+    0x8e,0x6b,0x18,0xf2,0xf1,0x9f,0x9f,0x32,0x0d,0x66,0x7e,0x18,0x5a,0x33,0x4f,0xf7,
+    0x5a,0x75,0x81,0x39,0xd7,0x91,0x33,0xb2,0x0e,0xcf,0xe4,0x58,0x71,0x12,0x27,0x53,
+    0x48,0xc2,0xc9,0xc3,0x72,0x3e,0x7f,0x79,0x35,0x37,0x58,0x6c,0x2f,0x02,0x17,0x3a,
+    0x04,0x83,0x11,0xb0,0x65,0x90,0x6f,0x12,0x9c,0x81,0xd6,0xa4,0x3f,0xd6,0x05,0x8f,
+    0x15,0x18,0x5b,0xd1,0x85,0x81,0x50,0x13,0xe1,0x49,0xdf,0xb9,0xb2,0xe5,0x72,0x61,
+    0x6a,0x63,0x99,0x2c,0xc9,0xc6,0xa4,0xf8,0xfe,0x39,0x5b,0x69,0xd2,0xd8,0x6a,0x68,
+    0xaa,0xb1,0xa2,0x57,0x9d,0xd1,0x05,0xfd,0x69,0x0f,0x94,0xdb,0xe6,0xd3,0x36,0x27,
+    0x64,0x60,0xeb,0xd3,0x42,0xb9,0xcf,0x79,0xfa,0xf9,0x71,0x48,0x74,0xa7,0x69,0xc4,
+    0x0b,0x8c,0x18,0x80,0x77,0x86,0xdc,0x6f,0xf1,0x95,0x5a,0xd8,0xbb,0xdf,0x61,0x38,
+    0xcc,0x57,0xe2,0x05,0x82,0xaf,0x68,0x59,0xc2,0xfe,0xca,0xa2,0x67,0x89,0x06,0x3b,
+    0xc7,0x77,0x16,0x13,0x46,0xf3,0x59,0x28,0xb9,0x5a,0xe4,0x7f,0xc3,0xaf,0x34,0x62,
+    0x0b,0xbb,0xf7,0xc7,0x34,0x3b,0x07,0xf6,0xd0,0xf4,0x71,0x51,0x2c,0xed,0x72,0xbc,
+    0xb7,0xc3,0x4c,0x29,0x2b,0xd9,0xd9,0x89,0xbf,0x0a,0xbe,0xc9,0xc4,0x73,0xfe,0x16,
+    0x3f,0x5f,0xac,0xb2,0x24,0xd7,0x5c,0x2e,0x5a,0xce,0x7b,0x58,0xf7,0xfd,0x0f,0xe8,
+    0xd1,0x19,0x7e,0xfe,0x1f,0x93,0x16,0x02,0xc0,0xbd,0x2f,0xd5,0x8e,0x2f,0xc3,0x29,
+    0xf9,0x92,0x30,0x71,0x49,0x6b,0x61,0xa3,0xbc,0x80,0xdb,0x77,0xec,0x62,0x5e,0xa3,
+    0x74,0x39,0xa4,0x3d,0x25,0xee,0x7c,0x16,0xb6,0x12,0x2b,0x47,0xa0,0x99,0x05,0xb2,
+    0x49,0x8c,0xb8,0x35,0x43,0x0f,0x01,0x81,0x41,0xa2,0x3b,0x72,0x24,0x30,0x93,0x2b,
+    0x8d,0x50,0xc2,0x37,0x1d,0x96,0xf7,0x97,0x60,0x2c,0x96,0x9c,0xd7,0x85,0x37,0x67,
+    0x1d,0x5f,0x6f,0x5c,0x71,0x2f,0xf8,0x38,0xe4,0x0b,0xac,0x75,0x93,0xee,0xc4,0x2e,
+    0xdd,0xe1,0x8f,0x91,0xd4,0x3f,0xe9,0xd4,0xe9,0x15,0x08,0xdd,0xf5,0xe2,0xf9,0x09,
+    0xec,0x2c,0x37,0x59,0x3d,0x9e,0x64,0x41,0x83,0x47,0x1b,0x6b,0x98,0xbc,0x4b,0x89,
+    0x82,0x7d,0xe6,0xc7,0x01,0x72,0xa4,0x29,0x77,0x03,0xd9,0xa0,0x80,0x94,0xe5,0xc0,
+    0xca,0x26,0x32,0x79,0x4e,0x26,0xae,0x72,0x5e,0x6f,0x70,0x44,0x28,0x9a,0x47,0x94,
+    0x36,0xc9,0x5d,0xf5,0x54,0x60,0x8a,0x67,0xd6,0x40,0xe3,0x73,0x83,0xf8,0x17,0x8e,
+    0x6f,0x67,0xc4,0xf7,0x6c,0xc4,0xf1,0xe5,0x00,0x50,0x00,0x00,0x00,0x50,0x00,0x00,
+    0x00,
+};
+#endif // NIX_ZEROCOIN_ZEROCOINPARAMS_H
@@ -20,3 +20,33 @@ bool CZMQAbstractNotifier::NotifyTransaction(const CTransaction &/*transaction*/
 {
     return true;
 }
+
+bool CZMQAbstractNotifier::NotifyTemplate(const CBlockIndex * /*pindexTip*/, unsigned int /*nTransactionsUpdated*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyBlockConnected(const CBlockIndex * /*pindex*/, const std::vector<unsigned char> &/*vchBlock*/, uint32_t /*nBlockSequence*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyBlockDisconnected(const CBlock &/*block*/, uint32_t /*nBlockSequence*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyTransactionLock(const CTransaction &/*transaction*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyGhostnodeState(const COutPoint &/*outpoint*/, int /*nState*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyZerocoinTransaction(const CTransaction &/*transaction*/)
+{
+    return true;
+}
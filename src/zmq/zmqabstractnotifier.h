@@ -34,6 +34,17 @@ public:
 
     virtual bool NotifyBlock(const CBlockIndex *pindex);
     virtual bool NotifyTransaction(const CTransaction &transaction);
+    //! A new block template is available: the tip it builds on and the memory pool update counter
+    virtual bool NotifyTemplate(const CBlockIndex *pindexTip, unsigned int nTransactionsUpdated);
+    //! A block was connected, vchBlock is it serialized. Connects and disconnects are numbered by nBlockSequence
+    virtual bool NotifyBlockConnected(const CBlockIndex *pindex, const std::vector<unsigned char> &vchBlock, uint32_t nBlockSequence);
+    virtual bool NotifyBlockDisconnected(const CBlock &block, uint32_t nBlockSequence);
+    //! An InstantSend lock on the transaction completed
+    virtual bool NotifyTransactionLock(const CTransaction &transaction);
+    //! The ghostnode with collateral outpoint is in state nState now
+    virtual bool NotifyGhostnodeState(const COutPoint &outpoint, int nState);
+    //! A transaction of a connected block mints or spends zerocoins
+    virtual bool NotifyZerocoinTransaction(const CTransaction &transaction);
 
 protected:
     void *psocket;
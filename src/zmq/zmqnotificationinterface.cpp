@@ -8,14 +8,17 @@
 #include <version.h>
 #include <validation.h>
 #include <streams.h>
+#include <txmempool.h>
+#include <rpc/server.h>
 #include <util.h>
+#include <utiltime.h>
 
 void zmqError(const char *str)
 {
     LogPrint(BCLog::ZMQ, "zmq: Error: %s, errno=%s\n", str, zmq_strerror(errno));
 }
 
-CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(nullptr)
+CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(nullptr), nLastTemplateTime(0), nBlockSequence(0)
 {
 }
 
@@ -37,8 +40,15 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
 
     factories["pubhashblock"] = CZMQAbstractNotifier::Create<CZMQPublishHashBlockNotifier>;
     factories["pubhashtx"] = CZMQAbstractNotifier::Create<CZMQPublishHashTransactionNotifier>;
+    factories["pubhashtemplate"] = CZMQAbstractNotifier::Create<CZMQPublishHashTemplateNotifier>;
     factories["pubrawblock"] = CZMQAbstractNotifier::Create<CZMQPublishRawBlockNotifier>;
     factories["pubrawtx"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionNotifier>;
+    factories["pubblockdisconnect"] = CZMQAbstractNotifier::Create<CZMQPublishBlockDisconnectNotifier>;
+    factories["pubhashtxlock"] = CZMQAbstractNotifier::Create<CZMQPublishHashTransactionLockNotifier>;
+    factories["pubrawtxlock"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionLockNotifier>;
+    factories["pubghostnodestate"] = CZMQAbstractNotifier::Create<CZMQPublishGhostnodeStateNotifier>;
+    factories["pubzerocoinmint"] = CZMQAbstractNotifier::Create<CZMQPublishZerocoinMintNotifier>;
+    factories["pubzerocoinspend"] = CZMQAbstractNotifier::Create<CZMQPublishZerocoinSpendNotifier>;
 
     for (const auto& entry : factories)
     {
@@ -142,9 +152,48 @@ void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, co
             i = notifiers.erase(i);
         }
     }
+
+    NotifyTemplate(pindexNew, true);
+}
+
+void CZMQNotificationInterface::NotifyTemplate(const CBlockIndex *pindexTip, bool fNewTip)
+{
+    // Every new tip makes a new template, memory pool changes are only told about every so often
+    int64_t nNow = GetTimeMillis();
+    if (!fNewTip && nNow - nLastTemplateTime < TEMPLATE_NOTIFY_INTERVAL_MS)
+        return;
+    nLastTemplateTime = nNow;
+    const unsigned int nTransactionsUpdated = mempool.GetTransactionsUpdated();
+
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    {
+        CZMQAbstractNotifier *notifier = *i;
+        if (notifier->NotifyTemplate(pindexTip, nTransactionsUpdated))
+        {
+            i++;
+        }
+        else
+        {
+            notifier->Shutdown();
+            i = notifiers.erase(i);
+        }
+    }
 }
 
 void CZMQNotificationInterface::TransactionAddedToMempool(const CTransactionRef& ptx)
+{
+    NotifyTransaction(ptx);
+
+    const CBlockIndex *pindexTip;
+    {
+        LOCK(cs_main);
+        pindexTip = chainActive.Tip();
+    }
+    if (pindexTip)
+        NotifyTemplate(pindexTip, false);
+}
+
+void CZMQNotificationInterface::NotifyTransaction(const CTransactionRef& ptx)
 {
     // Used by BlockConnected and BlockDisconnected as well, because they're
     // all the same external callback.
@@ -165,11 +214,57 @@ void CZMQNotificationInterface::TransactionAddedToMempool(const CTransactionRef&
     }
 }
 
+bool CZMQNotificationInterface::HasNotifier(const std::string& type) const
+{
+    for (const CZMQAbstractNotifier* notifier : notifiers)
+        if (notifier->GetType() == type)
+            return true;
+    return false;
+}
+
 void CZMQNotificationInterface::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected, const std::vector<CTransactionRef>& vtxConflicted)
 {
     for (const CTransactionRef& ptx : pblock->vtx) {
         // Do a normal notify for each transaction added in the block
-        TransactionAddedToMempool(ptx);
+        NotifyTransaction(ptx);
+    }
+
+    // Publish the block connected from memory, serialized once for every raw block notifier
+    if (!IsInitialBlockDownload() && HasNotifier("pubrawblock")) {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+        ss << *pblock;
+        const std::vector<unsigned char> vchBlock(ss.begin(), ss.end());
+        const uint32_t nSequence = nBlockSequence++;
+        for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+        {
+            CZMQAbstractNotifier *notifier = *i;
+            if (notifier->NotifyBlockConnected(pindexConnected, vchBlock, nSequence))
+            {
+                i++;
+            }
+            else
+            {
+                notifier->Shutdown();
+                i = notifiers.erase(i);
+            }
+        }
+    }
+
+    for (const CTransactionRef& ptx : pblock->vtx) {
+        // The notifiers pick the mints and spends out
+        for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+        {
+            CZMQAbstractNotifier *notifier = *i;
+            if (notifier->NotifyZerocoinTransaction(*ptx))
+            {
+                i++;
+            }
+            else
+            {
+                notifier->Shutdown();
+                i = notifiers.erase(i);
+            }
+        }
     }
 }
 
@@ -177,6 +272,55 @@ void CZMQNotificationInterface::BlockDisconnected(const std::shared_ptr<const CB
 {
     for (const CTransactionRef& ptx : pblock->vtx) {
         // Do a normal notify for each transaction removed in block disconnection
-        TransactionAddedToMempool(ptx);
+        NotifyTransaction(ptx);
+    }
+
+    const uint32_t nSequence = nBlockSequence++;
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    {
+        CZMQAbstractNotifier *notifier = *i;
+        if (notifier->NotifyBlockDisconnected(*pblock, nSequence))
+        {
+            i++;
+        }
+        else
+        {
+            notifier->Shutdown();
+            i = notifiers.erase(i);
+        }
+    }
+}
+
+void CZMQNotificationInterface::TransactionLocked(const CTransactionRef& ptx)
+{
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    {
+        CZMQAbstractNotifier *notifier = *i;
+        if (notifier->NotifyTransactionLock(*ptx))
+        {
+            i++;
+        }
+        else
+        {
+            notifier->Shutdown();
+            i = notifiers.erase(i);
+        }
+    }
+}
+
+void CZMQNotificationInterface::GhostnodeStateChanged(const COutPoint& outpoint, int nState)
+{
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    {
+        CZMQAbstractNotifier *notifier = *i;
+        if (notifier->NotifyGhostnodeState(outpoint, nState))
+        {
+            i++;
+        }
+        else
+        {
+            notifier->Shutdown();
+            i = notifiers.erase(i);
+        }
     }
 }
@@ -13,6 +13,9 @@
 class CBlockIndex;
 class CZMQAbstractNotifier;
 
+/** Least time between two hashtemplate notifications for memory pool changes, a new tip is always notified */
+static const int64_t TEMPLATE_NOTIFY_INTERVAL_MS = 1000;
+
 class CZMQNotificationInterface final : public CValidationInterface
 {
 public:
@@ -29,12 +32,22 @@ protected:
     void BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected, const std::vector<CTransactionRef>& vtxConflicted) override;
     void BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) override;
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) override;
+    void TransactionLocked(const CTransactionRef& ptx) override;
+    void GhostnodeStateChanged(const COutPoint& outpoint, int nState) override;
 
 private:
     CZMQNotificationInterface();
 
+    void NotifyTransaction(const CTransactionRef& ptx);
+    void NotifyTemplate(const CBlockIndex *pindexTip, bool fNewTip);
+    bool HasNotifier(const std::string& type) const;
+
     void *pcontext;
     std::list<CZMQAbstractNotifier*> notifiers;
+    //! Time in ms of the last hashtemplate, memory pool changes are batched up for TEMPLATE_NOTIFY_INTERVAL_MS
+    int64_t nLastTemplateTime;
+    //! Number of the next block connect or disconnect published, these share one sequence so reorgs can be followed
+    uint32_t nBlockSequence;
 };
 
 #endif // BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
@@ -4,18 +4,37 @@
 
 #include <chain.h>
 #include <chainparams.h>
+#include <crypto/common.h>
 #include <streams.h>
 #include <zmq/zmqpublishnotifier.h>
 #include <validation.h>
 #include <util.h>
 #include <rpc/server.h>
+#include <zerocoin/zerocoin.h>
 
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
 static const char *MSG_HASHBLOCK = "hashblock";
 static const char *MSG_HASHTX    = "hashtx";
+static const char *MSG_HASHTEMPLATE = "hashtemplate";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
+static const char *MSG_BLOCKDISCONNECT = "blockdisconnect";
+static const char *MSG_HASHTXLOCK = "hashtxlock";
+static const char *MSG_RAWTXLOCK = "rawtxlock";
+static const char *MSG_GHOSTNODESTATE = "ghostnodestate";
+static const char *MSG_ZEROCOINMINT = "zerocoinmint";
+static const char *MSG_ZEROCOINSPEND = "zerocoinspend";
+
+//! Size of a zerocoin mint script before the public coin value
+static const size_t ZEROCOIN_MINT_SCRIPT_PREFIX_SIZE = 6;
+
+/** Write hash to data in the byte order it is shown in, like the RPCs do */
+static void WriteHashReversed(unsigned char* data, const uint256& hash)
+{
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = hash.begin()[i];
+}
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -131,13 +150,7 @@ void CZMQAbstractPublishNotifier::Shutdown()
 
 bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* data, size_t size)
 {
-    assert(psocket);
-
-    /* send three parts, command & data & a LE 4byte sequence number */
-    unsigned char msgseq[sizeof(uint32_t)];
-    WriteLE32(&msgseq[0], nSequence);
-    int rc = zmq_send_multipart(psocket, command, strlen(command), data, size, msgseq, (size_t)sizeof(uint32_t), nullptr);
-    if (rc == -1)
+    if (!SendMessage(command, data, size, nSequence))
         return false;
 
     /* increment memory only sequence number after sending */
@@ -146,6 +159,17 @@ bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* d
     return true;
 }
 
+bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* data, size_t size, uint32_t nSequenceIn)
+{
+    assert(psocket);
+
+    /* send three parts, command & data & a LE 4byte sequence number */
+    unsigned char msgseq[sizeof(uint32_t)];
+    WriteLE32(&msgseq[0], nSequenceIn);
+    int rc = zmq_send_multipart(psocket, command, strlen(command), data, size, msgseq, (size_t)sizeof(uint32_t), nullptr);
+    return rc != -1;
+}
+
 bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
 {
     uint256 hash = pindex->GetBlockHash();
@@ -166,25 +190,33 @@ bool CZMQPublishHashTransactionNotifier::NotifyTransaction(const CTransaction &t
     return SendMessage(MSG_HASHTX, data, 32);
 }
 
-bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+bool CZMQPublishHashTemplateNotifier::NotifyTemplate(const CBlockIndex *pindexTip, unsigned int nTransactionsUpdated)
 {
-    LogPrint(BCLog::ZMQ, "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
-
-    const Consensus::Params& consensusParams = Params().GetConsensus();
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-    {
-        LOCK(cs_main);
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex, consensusParams))
-        {
-            zmqError("Can't read block from disk");
-            return false;
-        }
+    uint256 hash = pindexTip->GetBlockHash();
+    LogPrint(BCLog::ZMQ, "zmq: Publish hashtemplate %s %u\n", hash.GetHex(), nTransactionsUpdated);
+    // The two parts of the getblocktemplate longpollid: tip hash, then the memory pool update counter in little endian
+    char data[36];
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = hash.begin()[i];
+    WriteLE32((unsigned char*)&data[32], nTransactionsUpdated);
+    return SendMessage(MSG_HASHTEMPLATE, data, 36);
+}
 
-        ss << block;
-    }
+bool CZMQPublishRawBlockNotifier::NotifyBlockConnected(const CBlockIndex *pindex, const std::vector<unsigned char> &vchBlock, uint32_t nBlockSequence)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
+    return SendMessage(MSG_RAWBLOCK, vchBlock.data(), vchBlock.size(), nBlockSequence);
+}
 
-    return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
+bool CZMQPublishBlockDisconnectNotifier::NotifyBlockDisconnected(const CBlock &block, uint32_t nBlockSequence)
+{
+    uint256 hash = block.GetHash();
+    LogPrint(BCLog::ZMQ, "zmq: Publish blockdisconnect %s\n", hash.GetHex());
+    // The disconnected block's hash, then the hash of its parent, the tip now
+    unsigned char data[64];
+    WriteHashReversed(data, hash);
+    WriteHashReversed(&data[32], block.hashPrevBlock);
+    return SendMessage(MSG_BLOCKDISCONNECT, data, 64, nBlockSequence);
 }
 
 bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &transaction)
@@ -195,3 +227,71 @@ bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &tr
     ss << transaction;
     return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
 }
+
+bool CZMQPublishHashTransactionLockNotifier::NotifyTransactionLock(const CTransaction &transaction)
+{
+    uint256 hash = transaction.GetHash();
+    LogPrint(BCLog::ZMQ, "zmq: Publish hashtxlock %s\n", hash.GetHex());
+    unsigned char data[32];
+    WriteHashReversed(data, hash);
+    return SendMessage(MSG_HASHTXLOCK, data, 32);
+}
+
+bool CZMQPublishRawTransactionLockNotifier::NotifyTransactionLock(const CTransaction &transaction)
+{
+    uint256 hash = transaction.GetHash();
+    LogPrint(BCLog::ZMQ, "zmq: Publish rawtxlock %s\n", hash.GetHex());
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+    ss << transaction;
+    return SendMessage(MSG_RAWTXLOCK, &(*ss.begin()), ss.size());
+}
+
+bool CZMQPublishGhostnodeStateNotifier::NotifyGhostnodeState(const COutPoint &outpoint, int nState)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish ghostnodestate %s %d\n", outpoint.ToString(), nState);
+    // Collateral txid, output index and state, both in little endian
+    unsigned char data[40];
+    WriteHashReversed(data, outpoint.hash);
+    WriteLE32(&data[32], outpoint.n);
+    WriteLE32(&data[36], nState);
+    return SendMessage(MSG_GHOSTNODESTATE, data, 40);
+}
+
+bool CZMQPublishZerocoinMintNotifier::NotifyZerocoinTransaction(const CTransaction &transaction)
+{
+    uint256 hash = transaction.GetHash();
+    for (unsigned int n = 0; n < transaction.vout.size(); n++) {
+        const CTxOut& txout = transaction.vout[n];
+        if (!txout.scriptPubKey.IsZerocoinMint() || txout.scriptPubKey.size() < ZEROCOIN_MINT_SCRIPT_PREFIX_SIZE)
+            continue;
+        LogPrint(BCLog::ZMQ, "zmq: Publish zerocoinmint %s:%u\n", hash.GetHex(), n);
+        // Txid, output index and value in little endian, then the public coin value
+        std::vector<unsigned char> data(44);
+        WriteHashReversed(&data[0], hash);
+        WriteLE32(&data[32], n);
+        WriteLE64(&data[36], txout.nValue);
+        data.insert(data.end(), txout.scriptPubKey.begin() + ZEROCOIN_MINT_SCRIPT_PREFIX_SIZE, txout.scriptPubKey.end());
+        if (!SendMessage(MSG_ZEROCOINMINT, data.data(), data.size()))
+            return false;
+    }
+    return true;
+}
+
+bool CZMQPublishZerocoinSpendNotifier::NotifyZerocoinTransaction(const CTransaction &transaction)
+{
+    uint256 hash = transaction.GetHash();
+    std::vector<uint256> vSerialHashes;
+    if (!GetZerocoinSpendSerialHashes(transaction, vSerialHashes)) {
+        zmqError("Can't read zerocoin spend");
+        return true; // Don't shut the notifier down over one transaction
+    }
+    if (vSerialHashes.empty())
+        return true;
+    LogPrint(BCLog::ZMQ, "zmq: Publish zerocoinspend %s\n", hash.GetHex());
+    // Txid, then the hashes of the coin serials spent
+    std::vector<unsigned char> data(32 * (1 + vSerialHashes.size()));
+    WriteHashReversed(&data[0], hash);
+    for (size_t i = 0; i < vSerialHashes.size(); i++)
+        WriteHashReversed(&data[32 * (i + 1)], vSerialHashes[i]);
+    return SendMessage(MSG_ZEROCOINSPEND, data.data(), data.size());
+}
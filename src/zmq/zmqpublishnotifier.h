@@ -12,7 +12,7 @@ class CBlockIndex;
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
 {
 private:
-    uint32_t nSequence; //!< upcounting per message sequence number
+    uint32_t nSequence {0U}; //!< upcounting per message sequence number
 
 public:
 
@@ -23,6 +23,8 @@ public:
           * message sequence number
     */
     bool SendMessage(const char *command, const void* data, size_t size);
+    //! Send with a sequence number counted by the caller instead
+    bool SendMessage(const char *command, const void* data, size_t size, uint32_t nSequenceIn);
 
     bool Initialize(void *pcontext) override;
     void Shutdown() override;
@@ -40,10 +42,22 @@ public:
     bool NotifyTransaction(const CTransaction &transaction) override;
 };
 
+class CZMQPublishHashTemplateNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyTemplate(const CBlockIndex *pindexTip, unsigned int nTransactionsUpdated) override;
+};
+
 class CZMQPublishRawBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex) override;
+    bool NotifyBlockConnected(const CBlockIndex *pindex, const std::vector<unsigned char> &vchBlock, uint32_t nBlockSequence) override;
+};
+
+class CZMQPublishBlockDisconnectNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyBlockDisconnected(const CBlock &block, uint32_t nBlockSequence) override;
 };
 
 class CZMQPublishRawTransactionNotifier : public CZMQAbstractPublishNotifier
@@ -52,4 +66,34 @@ public:
     bool NotifyTransaction(const CTransaction &transaction) override;
 };
 
+class CZMQPublishHashTransactionLockNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyTransactionLock(const CTransaction &transaction) override;
+};
+
+class CZMQPublishRawTransactionLockNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyTransactionLock(const CTransaction &transaction) override;
+};
+
+class CZMQPublishGhostnodeStateNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyGhostnodeState(const COutPoint &outpoint, int nState) override;
+};
+
+class CZMQPublishZerocoinMintNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyZerocoinTransaction(const CTransaction &transaction) override;
+};
+
+class CZMQPublishZerocoinSpendNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyZerocoinTransaction(const CTransaction &transaction) override;
+};
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H